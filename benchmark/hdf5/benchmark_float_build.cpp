@@ -0,0 +1,301 @@
+// Copyright (C) 2019-2023 Zilliz. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file except in compliance
+// with the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
+// or implied. See the License for the specific language governing permissions and limitations under the License.
+
+#include <gtest/gtest.h>
+#include <malloc.h>
+
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "benchmark_knowhere.h"
+#include "knowhere/comp/index_param.h"
+#include "knowhere/comp/knowhere_config.h"
+#include "knowhere/comp/local_file_manager.h"
+#include "knowhere/comp/thread_pool.h"
+#include "knowhere/dataset.h"
+
+namespace fs = std::filesystem;
+std::string kDir = fs::current_path().string() + "/diskann_test";
+std::string kRawDataPath = kDir + "/raw_data";
+std::string kL2IndexDir = kDir + "/l2_index";
+std::string kIPIndexDir = kDir + "/ip_index";
+std::string kL2IndexPrefix = kL2IndexDir + "/l2";
+std::string kIPIndexPrefix = kIPIndexDir + "/ip";
+
+void
+WriteRawDataToDisk(const std::string data_path, const float* raw_data, const uint32_t num, const uint32_t dim) {
+    std::ofstream writer(data_path.c_str(), std::ios::binary);
+    writer.write((char*)&num, sizeof(uint32_t));
+    writer.write((char*)&dim, sizeof(uint32_t));
+    writer.write((char*)raw_data, sizeof(float) * num * dim);
+    writer.close();
+}
+
+// The memory of the process, from /proc/self/status and the allocator
+struct MemoryUsage {
+    // VmRSS and VmHWM, in bytes
+    int64_t rss = 0;
+    int64_t peak_rss = 0;
+    // the bytes allocated by malloc and not freed, -1 when the allocator does not tell
+    int64_t allocated = -1;
+
+    static MemoryUsage
+    Get() {
+        MemoryUsage usage;
+        std::ifstream status("/proc/self/status");
+        std::string line;
+        while (std::getline(status, line)) {
+            if (line.rfind("VmRSS:", 0) == 0) {
+                usage.rss = std::stoll(line.substr(6)) * 1024;
+            } else if (line.rfind("VmHWM:", 0) == 0) {
+                usage.peak_rss = std::stoll(line.substr(6)) * 1024;
+            }
+        }
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+        auto info = mallinfo2();
+        usage.allocated = info.uordblks + info.hblkhd;
+#endif
+        return usage;
+    }
+
+    // starts the peak RSS over from the current RSS, so that the next peak is the one of the next phase
+    static void
+    ResetPeak() {
+        std::ofstream clear_refs("/proc/self/clear_refs");
+        clear_refs << "5";
+    }
+};
+
+// The time, peak RSS and memory growth of every phase of a build: train, add, serialize and deserialize, and the
+// Size() of the built index against the bytes it actually holds. The build threads are the global build pool, of
+// KNOWHERE_BUILD_THREADS threads or all the cores; for the scaling curve run it once per thread count:
+//   for t in 1 2 4 8 16 32; do KNOWHERE_BUILD_THREADS=$t ./benchmark_float_build; done
+class Benchmark_float_build : public Benchmark_knowhere, public ::testing::Test {
+ public:
+    void
+    test_build(const knowhere::Json& cfg) {
+        auto conf = cfg;
+        conf[knowhere::meta::NUM_BUILD_THREAD] = build_threads_;
+        auto ds_ptr = knowhere::GenDataSet(nb_, dim_, xb_);
+
+        printf("\n[%0.3f s] %s | %s | %s | threads=%d\n", get_time_diff(), ann_test_name_.c_str(),
+               index_type_.c_str(), conf.dump().c_str(), build_threads_);
+        printf("================================================================================\n");
+        auto base = MemoryUsage::Get();
+        auto index = knowhere::IndexFactory::Instance().Create(index_type_);
+        if (!phase("train", [&]() { return index.Train(*ds_ptr, conf); }) ||
+            !phase("add", [&]() { return index.Add(*ds_ptr, conf); })) {
+            return;
+        }
+        auto built = MemoryUsage::Get();
+
+        knowhere::BinarySet binset;
+        if (!phase("serialize", [&]() { return index.Serialize(binset); })) {
+            return;
+        }
+        int64_t binset_size = 0;
+        for (const auto& [name, binary] : binset.binary_map_) {
+            binset_size += binary->size;
+        }
+        report_size(index.Size(), built, base, binset_size);
+
+        index = knowhere::IndexFactory::Instance().Create(index_type_);
+        phase("deserialize", [&]() { return index.Deserialize(binset, conf); });
+        printf("================================================================================\n");
+        printf("[%.3f s] Test '%s/%s' done\n\n", get_time_diff(), ann_test_name_.c_str(), index_type_.c_str());
+    }
+
+#ifdef KNOWHERE_WITH_DISKANN
+    // DiskANN builds from and to files, its phases are the build and the load
+    void
+    test_diskann(const knowhere::Json& cfg) {
+        auto conf = cfg;
+        printf("\n[%0.3f s] %s | %s | threads=%d\n", get_time_diff(), ann_test_name_.c_str(), index_type_.c_str(),
+               build_threads_);
+        printf("================================================================================\n");
+        std::shared_ptr<knowhere::FileManager> file_manager = std::make_shared<knowhere::LocalFileManager>();
+        auto diskann_index_pack = knowhere::Pack(file_manager);
+
+        auto index = knowhere::IndexFactory::Instance().Create(index_type_, diskann_index_pack);
+        knowhere::DataSetPtr ds_ptr = nullptr;
+        if (!phase("build", [&]() { return index.Build(*ds_ptr, conf); })) {
+            return;
+        }
+        index = knowhere::IndexFactory::Instance().Create(index_type_, diskann_index_pack);
+        conf["search_cache_budget_gb"] = 0;
+        knowhere::BinarySet binset;
+        phase("load", [&]() { return index.Deserialize(binset, conf); });
+        printf("  size = %.1fMB\n", index.Size() / 1048576.0);
+        printf("================================================================================\n");
+        printf("[%.3f s] Test '%s/%s' done\n\n", get_time_diff(), ann_test_name_.c_str(), index_type_.c_str());
+    }
+#endif
+
+ private:
+    // runs and reports a phase, false when it failed
+    template <typename Func>
+    bool
+    phase(const char* name, Func&& func) {
+        MemoryUsage::ResetPeak();
+        auto before = MemoryUsage::Get();
+        CALC_TIME_SPAN(auto status = func());
+        auto after = MemoryUsage::Get();
+        if (status != knowhere::Status::success) {
+            printf("  %-12s failed, status = %d\n", name, static_cast<int>(status));
+            return false;
+        }
+        printf("  %-12s elapse = %8.3fs, peak RSS = %9.1fMB (+%.1fMB), RSS +%.1fMB\n", name, t_diff,
+               after.peak_rss / 1048576.0, (after.peak_rss - before.rss) / 1048576.0,
+               (after.rss - before.rss) / 1048576.0);
+        std::fflush(stdout);
+        return true;
+    }
+
+    void
+    report_size(int64_t size, const MemoryUsage& built, const MemoryUsage& base, int64_t binset_size) {
+        printf("  Size() = %.1fMB, binary set = %.1fMB, RSS of the index = %.1fMB", size / 1048576.0,
+               binset_size / 1048576.0, (built.rss - base.rss) / 1048576.0);
+        if (built.allocated >= 0) {
+            printf(", allocated = %.1fMB", (built.allocated - base.allocated) / 1048576.0);
+        }
+        printf("\n");
+        std::fflush(stdout);
+    }
+
+ protected:
+    void
+    SetUp() override {
+        T0_ = elapsed();
+        set_ann_test_name("sift-128-euclidean");
+        parse_ann_test_name();
+        load_hdf5_data<false>();
+
+        assert(metric_str_ == METRIC_IP_STR || metric_str_ == METRIC_L2_STR);
+        metric_type_ = (metric_str_ == METRIC_IP_STR) ? knowhere::metric::IP : knowhere::metric::L2;
+        cfg_[knowhere::meta::METRIC_TYPE] = metric_type_;
+        knowhere::KnowhereConfig::SetSimdType(knowhere::KnowhereConfig::SimdType::AUTO);
+
+        auto threads = std::getenv("KNOWHERE_BUILD_THREADS");
+        build_threads_ = threads != nullptr ? std::atoi(threads) : std::thread::hardware_concurrency();
+        knowhere::ThreadPool::InitGlobalBuildThreadPool(build_threads_);
+    }
+
+    void
+    TearDown() override {
+        free_all();
+    }
+
+ protected:
+    int32_t build_threads_;
+
+    // IVF index params
+    const int32_t NLIST_ = 1024;
+
+    // IVFPQ index params
+    const int32_t M_ = 32;
+    const int32_t NBITS_ = 8;
+
+    // HNSW index params
+    const int32_t HNSW_M_ = 16;
+    const int32_t EFCON_ = 200;
+};
+
+TEST_F(Benchmark_float_build, TEST_IDMAP) {
+    index_type_ = knowhere::IndexEnum::INDEX_FAISS_IDMAP;
+
+    knowhere::Json conf = cfg_;
+    test_build(conf);
+}
+
+TEST_F(Benchmark_float_build, TEST_IVF_FLAT) {
+    index_type_ = knowhere::IndexEnum::INDEX_FAISS_IVFFLAT;
+
+    knowhere::Json conf = cfg_;
+    conf[knowhere::indexparam::NLIST] = NLIST_;
+    test_build(conf);
+}
+
+TEST_F(Benchmark_float_build, TEST_IVF_FLAT_CC) {
+    index_type_ = knowhere::IndexEnum::INDEX_FAISS_IVFFLAT_CC;
+
+    knowhere::Json conf = cfg_;
+    conf[knowhere::indexparam::NLIST] = NLIST_;
+    test_build(conf);
+}
+
+TEST_F(Benchmark_float_build, TEST_IVF_SQ8) {
+    index_type_ = knowhere::IndexEnum::INDEX_FAISS_IVFSQ8;
+
+    knowhere::Json conf = cfg_;
+    conf[knowhere::indexparam::NLIST] = NLIST_;
+    test_build(conf);
+}
+
+TEST_F(Benchmark_float_build, TEST_IVF_PQ) {
+    index_type_ = knowhere::IndexEnum::INDEX_FAISS_IVFPQ;
+
+    knowhere::Json conf = cfg_;
+    conf[knowhere::indexparam::NLIST] = NLIST_;
+    conf[knowhere::indexparam::M] = M_;
+    conf[knowhere::indexparam::NBITS] = NBITS_;
+    test_build(conf);
+}
+
+TEST_F(Benchmark_float_build, TEST_IVF_PQ_FASTSCAN) {
+    index_type_ = knowhere::IndexEnum::INDEX_FAISS_IVFPQ_FASTSCAN;
+
+    knowhere::Json conf = cfg_;
+    conf[knowhere::indexparam::NLIST] = NLIST_;
+    conf[knowhere::indexparam::M] = M_;
+    conf[knowhere::indexparam::NBITS] = 4;
+    test_build(conf);
+}
+
+TEST_F(Benchmark_float_build, TEST_SCANN) {
+    index_type_ = knowhere::IndexEnum::INDEX_FAISS_SCANN;
+
+    knowhere::Json conf = cfg_;
+    conf[knowhere::indexparam::NLIST] = NLIST_;
+    test_build(conf);
+}
+
+TEST_F(Benchmark_float_build, TEST_HNSW) {
+    index_type_ = knowhere::IndexEnum::INDEX_HNSW;
+
+    knowhere::Json conf = cfg_;
+    conf[knowhere::indexparam::HNSW_M] = HNSW_M_;
+    conf[knowhere::indexparam::EFCONSTRUCTION] = EFCON_;
+    test_build(conf);
+}
+
+#ifdef KNOWHERE_WITH_DISKANN
+TEST_F(Benchmark_float_build, TEST_DISKANN) {
+    index_type_ = knowhere::IndexEnum::INDEX_DISKANN;
+
+    knowhere::Json conf = cfg_;
+    conf["index_prefix"] = (metric_type_ == knowhere::metric::L2 ? kL2IndexPrefix : kIPIndexPrefix);
+    conf["data_path"] = kRawDataPath;
+    conf["max_degree"] = 56;
+    conf["search_list_size"] = 128;
+    conf["pq_code_budget_gb"] = sizeof(float) * dim_ * nb_ * 0.125 / (1024 * 1024 * 1024);
+    conf["build_dram_budget_gb"] = 32.0;
+
+    fs::create_directory(kDir);
+    fs::create_directory(kL2IndexDir);
+    fs::create_directory(kIPIndexDir);
+
+    WriteRawDataToDisk(kRawDataPath, (const float*)xb_, (const uint32_t)nb_, (const uint32_t)dim_);
+    test_diskann(conf);
+}
+#endif
@@ -0,0 +1,184 @@
+// Copyright (C) 2019-2023 Zilliz. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file except in compliance
+// with the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
+// or implied. See the License for the specific language governing permissions and limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+#include "benchmark_knowhere.h"
+#include "knowhere/comp/index_param.h"
+#include "knowhere/comp/knowhere_config.h"
+#include "knowhere/comp/local_file_manager.h"
+#include "knowhere/comp/query_trace.h"
+#include "knowhere/dataset.h"
+
+namespace fs = std::filesystem;
+// put the index on the device to profile with KNOWHERE_DISKANN_DIR
+std::string kDir = std::getenv("KNOWHERE_DISKANN_DIR") != nullptr ? std::getenv("KNOWHERE_DISKANN_DIR")
+                                                                   : fs::current_path().string() + "/diskann_test";
+std::string kRawDataPath = kDir + "/raw_data";
+std::string kL2IndexDir = kDir + "/l2_index";
+std::string kIPIndexDir = kDir + "/ip_index";
+std::string kL2IndexPrefix = kL2IndexDir + "/l2";
+std::string kIPIndexPrefix = kIPIndexDir + "/ip";
+
+void
+WriteRawDataToDisk(const std::string data_path, const float* raw_data, const uint32_t num, const uint32_t dim) {
+    std::ofstream writer(data_path.c_str(), std::ios::binary);
+    writer.write((char*)&num, sizeof(uint32_t));
+    writer.write((char*)&dim, sizeof(uint32_t));
+    writer.write((char*)raw_data, sizeof(float) * num * dim);
+    writer.close();
+}
+
+// The IO profile of DiskANN over the node cache budget, the beamwidth and the search list size: recall, QPS, and the
+// IOs, bytes read, cache hit ratio and p99 latency per query from the QueryStats of every query, as the query trace
+// records them. DiskANN reads with O_DIRECT, so the page cache is never warm; the node cache is the only cache.
+// The AioContextPool can only be sized once per process, by KNOWHERE_AIO_CONTEXTS; sweep it with one run per size:
+//   for n in 8 32 128; do KNOWHERE_AIO_CONTEXTS=$n ./benchmark_float_diskann; done
+class Benchmark_float_diskann : public Benchmark_knowhere, public ::testing::Test {
+ public:
+    void
+    test_diskann(const knowhere::Json& cfg) {
+        auto conf = cfg;
+        conf[knowhere::meta::TOPK] = topk_;
+        conf[knowhere::meta::TRACE_SAMPLE_RATE] = 1.0f;
+
+        printf("\n[%0.3f s] %s | %s | k=%d, aio contexts=%s\n", get_time_diff(), ann_test_name_.c_str(),
+               index_type_.c_str(), topk_, aio_contexts_ > 0 ? std::to_string(aio_contexts_).c_str() : "default");
+        printf("================================================================================\n");
+        for (auto budget : CACHE_BUDGET_GBs_) {
+            // the node cache is filled on load
+            std::shared_ptr<knowhere::FileManager> file_manager = std::make_shared<knowhere::LocalFileManager>();
+            index_ = knowhere::IndexFactory::Instance().Create(index_type_, knowhere::Pack(file_manager));
+            conf["search_cache_budget_gb"] = budget;
+            knowhere::BinarySet binset;
+            index_.Deserialize(binset, conf);
+            for (auto beamwidth : BEAMWIDTHs_) {
+                conf["beamwidth"] = beamwidth;
+                for (auto search_list_size : SEARCH_LIST_SIZEs_) {
+                    conf["search_list_size"] = search_list_size;
+                    profile(conf, budget);
+                }
+            }
+        }
+        printf("================================================================================\n");
+        printf("[%.3f s] Test '%s/%s' done\n\n", get_time_diff(), ann_test_name_.c_str(), index_type_.c_str());
+    }
+
+ private:
+    // searches the test queries in batches of at most the capacity of the trace buffer, so that all their traces
+    // are read back
+    void
+    profile(const knowhere::Json& conf, float budget) {
+        const int32_t batch = knowhere::QueryTraceBuffer::kCapacity;
+        auto& buffer = knowhere::QueryTraceBuffer::Instance();
+        uint64_t cursor = 0;
+        buffer.Read(cursor);
+
+        double search_s = 0, hits = 0;
+        int64_t ios = 0, cache_hits = 0, bytes_read = 0;
+        std::vector<int64_t> us;
+        for (int32_t start = 0; start < nq_; start += batch) {
+            auto step = std::min(batch, nq_ - start);
+            auto ds_ptr = knowhere::GenDataSet(step, dim_, (const float*)xq_ + start * dim_);
+            CALC_TIME_SPAN(auto result = index_.Search(*ds_ptr, conf, nullptr));
+            if (!result.has_value()) {
+                printf("  budget = %5.2fGB, search failed\n", budget);
+                return;
+            }
+            search_s += t_diff;
+            hits += CalcRecall(result.value()->GetIds(), start, step, topk_) * step;
+            for (const auto& trace : buffer.Read(cursor)) {
+                ios += trace.stats.ios;
+                cache_hits += trace.stats.cache_hits;
+                bytes_read += trace.stats.bytes_read;
+                us.push_back(trace.total_us);
+            }
+        }
+        auto traced = std::max<int64_t>(us.size(), 1);
+        std::sort(us.begin(), us.end());
+        auto p99 = us.empty() ? 0 : us[std::min(us.size() - 1, static_cast<size_t>(std::ceil(us.size() * 0.99)))];
+        printf(
+            "  budget = %5.2fGB, beamwidth = %2d, search_list_size = %4d, R@ = %.4f, QPS = %8.1f, IOs = %6.1f, "
+            "KB = %7.1f, cache hit = %5.1f%%, p99 = %7.3fms\n",
+            budget, conf["beamwidth"].get<int32_t>(), conf["search_list_size"].get<int32_t>(), hits / nq_,
+            nq_ / search_s, ios * 1.0 / traced, bytes_read / 1024.0 / traced,
+            cache_hits * 100.0 / std::max<int64_t>(cache_hits + ios, 1), p99 / 1000.0);
+        std::fflush(stdout);
+    }
+
+ protected:
+    void
+    SetUp() override {
+        T0_ = elapsed();
+        set_ann_test_name("sift-128-euclidean");
+        parse_ann_test_name();
+        load_hdf5_data<false>();
+
+        assert(metric_str_ == METRIC_IP_STR || metric_str_ == METRIC_L2_STR);
+        metric_type_ = (metric_str_ == METRIC_IP_STR) ? knowhere::metric::IP : knowhere::metric::L2;
+        cfg_[knowhere::meta::METRIC_TYPE] = metric_type_;
+        knowhere::KnowhereConfig::SetSimdType(knowhere::KnowhereConfig::SimdType::AUTO);
+
+        auto aio_contexts = std::getenv("KNOWHERE_AIO_CONTEXTS");
+        if (aio_contexts != nullptr) {
+            aio_contexts_ = std::atoi(aio_contexts);
+            knowhere::KnowhereConfig::SetAioContextPool(aio_contexts_);
+        }
+    }
+
+    void
+    TearDown() override {
+        free_all();
+    }
+
+ protected:
+    const int32_t topk_ = 10;
+    int32_t aio_contexts_ = 0;
+
+    // the node cache budgets, from none to beyond the whole index of sift-1m
+    const std::vector<float> CACHE_BUDGET_GBs_ = {0, 0.05, 0.1, 0.2, 0.5, 1.0};
+    const std::vector<int32_t> BEAMWIDTHs_ = {1, 2, 4, 8, 16};
+    const std::vector<int32_t> SEARCH_LIST_SIZEs_ = {10, 20, 40, 80, 160};
+};
+
+#ifdef KNOWHERE_WITH_DISKANN
+TEST_F(Benchmark_float_diskann, TEST_DISKANN) {
+    index_type_ = knowhere::IndexEnum::INDEX_DISKANN;
+
+    knowhere::Json conf = cfg_;
+    conf["index_prefix"] = (metric_type_ == knowhere::metric::L2 ? kL2IndexPrefix : kIPIndexPrefix);
+    conf["data_path"] = kRawDataPath;
+    conf["max_degree"] = 56;
+    conf["search_list_size"] = 128;
+    conf["pq_code_budget_gb"] = sizeof(float) * dim_ * nb_ * 0.125 / (1024 * 1024 * 1024);
+    conf["build_dram_budget_gb"] = 32.0;
+
+    fs::create_directory(kDir);
+    fs::create_directory(kL2IndexDir);
+    fs::create_directory(kIPIndexDir);
+
+    WriteRawDataToDisk(kRawDataPath, (const float*)xb_, (const uint32_t)nb_, (const uint32_t)dim_);
+
+    std::shared_ptr<knowhere::FileManager> file_manager = std::make_shared<knowhere::LocalFileManager>();
+    auto diskann_index_pack = knowhere::Pack(file_manager);
+
+    index_ = knowhere::IndexFactory::Instance().Create(index_type_, diskann_index_pack);
+    printf("[%.3f s] Building all on %d vectors\n", get_time_diff(), nb_);
+    knowhere::DataSetPtr ds_ptr = nullptr;
+    index_.Build(*ds_ptr, conf);
+    test_diskann(conf);
+}
+#endif
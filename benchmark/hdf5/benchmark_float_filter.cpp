@@ -0,0 +1,223 @@
+// Copyright (C) 2019-2023 Zilliz. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file except in compliance
+// with the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
+// or implied. See the License for the specific language governing permissions and limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <vector>
+
+#include "benchmark_knowhere.h"
+#include "knowhere/comp/index_param.h"
+#include "knowhere/comp/knowhere_config.h"
+#include "knowhere/comp/local_file_manager.h"
+#include "knowhere/dataset.h"
+
+namespace fs = std::filesystem;
+std::string kDir = fs::current_path().string() + "/diskann_test";
+std::string kRawDataPath = kDir + "/raw_data";
+std::string kL2IndexDir = kDir + "/l2_index";
+std::string kIPIndexDir = kDir + "/ip_index";
+std::string kL2IndexPrefix = kL2IndexDir + "/l2";
+std::string kIPIndexPrefix = kIPIndexDir + "/ip";
+
+void
+WriteRawDataToDisk(const std::string data_path, const float* raw_data, const uint32_t num, const uint32_t dim) {
+    std::ofstream writer(data_path.c_str(), std::ios::binary);
+    writer.write((char*)&num, sizeof(uint32_t));
+    writer.write((char*)&dim, sizeof(uint32_t));
+    writer.write((char*)raw_data, sizeof(float) * num * dim);
+    writer.close();
+}
+
+// Filtered search over the filter ratios from none to 99.9% of the rows, with the filtered rows picked at random or
+// in runs of consecutive ids. For every ratio it reports the recall against a brute force search with the same
+// filter, the QPS of a batch search of all the test queries, and the latency percentiles of single query searches.
+class Benchmark_float_filter : public Benchmark_knowhere, public ::testing::Test {
+ public:
+    void
+    test_filter(const knowhere::Json& cfg) {
+        auto conf = cfg;
+        conf[knowhere::meta::TOPK] = topk_;
+        auto ds_ptr = knowhere::GenDataSet(nq_, dim_, xq_);
+
+        printf("\n[%0.3f s] %s | %s | %s | k=%d\n", get_time_diff(), ann_test_name_.c_str(), index_type_.c_str(),
+               conf.dump().c_str(), topk_);
+        printf("================================================================================\n");
+        for (auto clustered : {false, true}) {
+            for (auto per : FILTER_PERCENTs_) {
+                auto filtered = static_cast<size_t>(nb_ * per / 100);
+                auto bitset_data =
+                    clustered ? GenClusteredBitset(nb_, filtered, CLUSTER_RUN_) : GenRandomBitset(nb_, filtered);
+                knowhere::BitsetView bitset(bitset_data.data(), nb_);
+
+                auto g_result = golden_index_.Search(*ds_ptr, conf, bitset);
+                CALC_TIME_SPAN(auto result = index_.Search(*ds_ptr, conf, bitset));
+                if (!g_result.has_value() || !result.has_value()) {
+                    printf("  %s, filter = %5.1f%%, search failed\n", clustered ? "clustered" : "random   ", per);
+                    continue;
+                }
+                float recall = CalcRecall(g_result.value()->GetIds(), result.value()->GetIds(), nq_, topk_);
+                auto ms = latencies(conf, bitset);
+                printf("  %s, filter = %5.1f%%, R@ = %.4f, QPS = %9.1f, p50 = %7.3fms, p99 = %7.3fms\n",
+                       clustered ? "clustered" : "random   ", per, recall, nq_ / t_diff, ms[ms.size() / 2],
+                       ms[std::min(ms.size() - 1, static_cast<size_t>(std::ceil(ms.size() * 0.99)))]);
+                std::fflush(stdout);
+            }
+        }
+        printf("================================================================================\n");
+        printf("[%.3f s] Test '%s/%s' done\n\n", get_time_diff(), ann_test_name_.c_str(), index_type_.c_str());
+    }
+
+ private:
+    // of the first LATENCY_NQ_ test queries searched one by one, sorted, in ms
+    std::vector<double>
+    latencies(const knowhere::Json& conf, const knowhere::BitsetView& bitset) {
+        auto nq = std::min(nq_, LATENCY_NQ_);
+        std::vector<double> ms(nq);
+        for (int32_t i = 0; i < nq; i++) {
+            auto ds_ptr = knowhere::GenDataSet(1, dim_, (const float*)xq_ + i * dim_);
+            auto start = std::chrono::steady_clock::now();
+            index_.Search(*ds_ptr, conf, bitset);
+            ms[i] = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        }
+        std::sort(ms.begin(), ms.end());
+        return ms;
+    }
+
+ protected:
+    void
+    SetUp() override {
+        T0_ = elapsed();
+        set_ann_test_name("sift-128-euclidean");
+        parse_ann_test_name();
+        load_hdf5_data<false>();
+
+        assert(metric_str_ == METRIC_IP_STR || metric_str_ == METRIC_L2_STR);
+        metric_type_ = (metric_str_ == METRIC_IP_STR) ? knowhere::metric::IP : knowhere::metric::L2;
+        cfg_[knowhere::meta::METRIC_TYPE] = metric_type_;
+        knowhere::KnowhereConfig::SetSimdType(knowhere::KnowhereConfig::SimdType::AUTO);
+
+        create_golden_index(cfg_);
+    }
+
+    void
+    TearDown() override {
+        free_all();
+    }
+
+ protected:
+    const int32_t topk_ = 10;
+    const std::vector<float> FILTER_PERCENTs_ = {0, 10, 30, 50, 70, 90, 95, 98, 99, 99.5, 99.9};
+    // the length of the runs of filtered ids of a clustered filter
+    const size_t CLUSTER_RUN_ = 4096;
+    const int32_t LATENCY_NQ_ = 1000;
+
+    // IVF index params
+    const int32_t NLIST_ = 1024;
+    const int32_t NPROBE_ = 16;
+
+    // IVFPQ index params
+    const int32_t M_ = 32;
+    const int32_t NBITS_ = 8;
+
+    // HNSW index params
+    const int32_t HNSW_M_ = 16;
+    const int32_t EFCON_ = 200;
+    const int32_t EF_ = 64;
+};
+
+TEST_F(Benchmark_float_filter, TEST_IDMAP) {
+    index_type_ = knowhere::IndexEnum::INDEX_FAISS_IDMAP;
+
+    knowhere::Json conf = cfg_;
+    create_index(get_index_name({}), conf);
+    test_filter(conf);
+}
+
+TEST_F(Benchmark_float_filter, TEST_IVF_FLAT) {
+    index_type_ = knowhere::IndexEnum::INDEX_FAISS_IVFFLAT;
+
+    knowhere::Json conf = cfg_;
+    conf[knowhere::indexparam::NLIST] = NLIST_;
+    create_index(get_index_name({NLIST_}), conf);
+    conf[knowhere::indexparam::NPROBE] = NPROBE_;
+    test_filter(conf);
+}
+
+TEST_F(Benchmark_float_filter, TEST_IVF_SQ8) {
+    index_type_ = knowhere::IndexEnum::INDEX_FAISS_IVFSQ8;
+
+    knowhere::Json conf = cfg_;
+    conf[knowhere::indexparam::NLIST] = NLIST_;
+    create_index(get_index_name({NLIST_}), conf);
+    conf[knowhere::indexparam::NPROBE] = NPROBE_;
+    test_filter(conf);
+}
+
+TEST_F(Benchmark_float_filter, TEST_IVF_PQ) {
+    index_type_ = knowhere::IndexEnum::INDEX_FAISS_IVFPQ;
+
+    knowhere::Json conf = cfg_;
+    conf[knowhere::indexparam::NLIST] = NLIST_;
+    conf[knowhere::indexparam::M] = M_;
+    conf[knowhere::indexparam::NBITS] = NBITS_;
+    create_index(get_index_name({NLIST_, M_}), conf);
+    conf[knowhere::indexparam::NPROBE] = NPROBE_;
+    test_filter(conf);
+}
+
+TEST_F(Benchmark_float_filter, TEST_HNSW) {
+    index_type_ = knowhere::IndexEnum::INDEX_HNSW;
+
+    knowhere::Json conf = cfg_;
+    conf[knowhere::indexparam::HNSW_M] = HNSW_M_;
+    conf[knowhere::indexparam::EFCONSTRUCTION] = EFCON_;
+    create_index(get_index_name({HNSW_M_, EFCON_}), conf);
+    conf[knowhere::indexparam::EF] = EF_;
+    test_filter(conf);
+}
+
+#ifdef KNOWHERE_WITH_DISKANN
+TEST_F(Benchmark_float_filter, TEST_DISKANN) {
+    index_type_ = knowhere::IndexEnum::INDEX_DISKANN;
+
+    knowhere::Json conf = cfg_;
+    conf["index_prefix"] = (metric_type_ == knowhere::metric::L2 ? kL2IndexPrefix : kIPIndexPrefix);
+    conf["data_path"] = kRawDataPath;
+    conf["max_degree"] = 56;
+    conf["search_list_size"] = 128;
+    conf["pq_code_budget_gb"] = sizeof(float) * dim_ * nb_ * 0.125 / (1024 * 1024 * 1024);
+    conf["build_dram_budget_gb"] = 32.0;
+
+    fs::create_directory(kDir);
+    fs::create_directory(kL2IndexDir);
+    fs::create_directory(kIPIndexDir);
+
+    WriteRawDataToDisk(kRawDataPath, (const float*)xb_, (const uint32_t)nb_, (const uint32_t)dim_);
+
+    std::shared_ptr<knowhere::FileManager> file_manager = std::make_shared<knowhere::LocalFileManager>();
+    auto diskann_index_pack = knowhere::Pack(file_manager);
+
+    index_ = knowhere::IndexFactory::Instance().Create(index_type_, diskann_index_pack);
+    printf("[%.3f s] Building all on %d vectors\n", get_time_diff(), nb_);
+    knowhere::DataSetPtr ds_ptr = nullptr;
+    index_.Build(*ds_ptr, conf);
+
+    conf["search_cache_budget_gb"] = 0;
+    conf["beamwidth"] = 8;
+    knowhere::BinarySet binset;
+    index_.Deserialize(binset, conf);
+    conf["search_list_size"] = 2 * topk_;
+    test_filter(conf);
+}
+#endif
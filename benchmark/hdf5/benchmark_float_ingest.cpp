@@ -0,0 +1,244 @@
+// Copyright (C) 2019-2023 Zilliz. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file except in compliance
+// with the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
+// or implied. See the License for the specific language governing permissions and limitations under the License.
+
+#include <faiss/invlists/InvertedLists.h>
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <thread>
+#include <vector>
+
+#include "benchmark_knowhere.h"
+#include "knowhere/comp/index_param.h"
+#include "knowhere/comp/knowhere_config.h"
+#include "knowhere/dataset.h"
+
+// Grows an index built on the first half of the base vectors by the second half, Add by Add of BATCH_ROWS_ rows from
+// writer threads, while reader threads send the test queries at a fixed arrival rate, one per Search, from
+// BASELINE_S_ before the first Add until the last one returns. Every WINDOW_S_ of the run reports the latency
+// percentiles of the queries arrived in it, taken from their arrival, and the rows added in it; the run then reports
+// the ingest throughput and the appends to an inverted list that waited for another writer of the list.
+class Benchmark_float_ingest : public Benchmark_knowhere, public ::testing::Test {
+ public:
+    void
+    test_ingest(const knowhere::Json& cfg) {
+        auto conf = cfg;
+        conf[knowhere::meta::TOPK] = topk_;
+
+        printf("\n[%0.3f s] %s | %s | %s | k=%d\n", get_time_diff(), ann_test_name_.c_str(), index_type_.c_str(),
+               conf.dump().c_str(), topk_);
+        printf("================================================================================\n");
+        for (auto writer_num : WRITER_NUMs_) {
+            for (auto arrival_qps : ARRIVAL_QPSs_) {
+                index_ = knowhere::IndexFactory::Instance().Create(index_type_);
+                auto base_rows = nb_ / 2;
+                knowhere::DataSetPtr ds_ptr = knowhere::GenDataSet(base_rows, dim_, xb_);
+                auto stat = index_.Build(*ds_ptr, conf);
+                if (stat != knowhere::Status::success) {
+                    printf("[%.3f s] Build of '%s' failed: status %d\n", get_time_diff(), index_type_.c_str(),
+                           static_cast<int>(stat));
+                    return;
+                }
+                auto run = task(conf, base_rows, writer_num, arrival_qps);
+                report(writer_num, arrival_qps, run);
+            }
+        }
+        printf("================================================================================\n");
+        printf("[%.3f s] Test '%s/%s' done\n\n", get_time_diff(), ann_test_name_.c_str(), index_type_.c_str());
+    }
+
+ private:
+    struct Query {
+        // since the start of the run, in s
+        double arrival;
+        double ms;
+    };
+
+    struct Batch {
+        // since the start of the run, in s
+        double done;
+        int32_t rows;
+    };
+
+    struct Run {
+        std::vector<Query> queries;
+        std::vector<Batch> batches;
+        // from the first Add to the end of the last one, in s
+        double ingest_elapse;
+        int32_t failed_searches;
+        int32_t failed_adds;
+        uint64_t lock_waits;
+        double lock_wait_ms;
+    };
+
+    Run
+    task(const knowhere::Json& conf, int32_t base_rows, int32_t writer_num, double arrival_qps) {
+        using clock = std::chrono::steady_clock;
+        auto since = [](clock::time_point t0, clock::time_point t) {
+            return std::chrono::duration<double>(t - t0).count();
+        };
+        auto add_rows = nb_ - base_rows;
+        int32_t batch_total = (add_rows + BATCH_ROWS_ - 1) / BATCH_ROWS_;
+        std::atomic<int32_t> next_query{0}, next_batch{0}, writers_left{writer_num};
+        std::atomic<int32_t> failed_searches{0}, failed_adds{0};
+        std::vector<std::vector<Query>> reader_queries(READER_NUM_);
+        std::vector<std::vector<Batch>> writer_batches(writer_num);
+        auto lock_waits = faiss::ConcurrentArrayInvertedLists::writer_lock_waits.load();
+        auto lock_wait_ns = faiss::ConcurrentArrayInvertedLists::writer_lock_wait_ns.load();
+        auto t0 = clock::now();
+        auto ingest_start =
+            t0 + std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(BASELINE_S_));
+
+        auto reader = [&](int32_t r) {
+            for (int32_t i = next_query.fetch_add(1); writers_left.load() > 0; i = next_query.fetch_add(1)) {
+                auto arrival =
+                    t0 + std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(i / arrival_qps));
+                std::this_thread::sleep_until(arrival);
+                auto q = i % nq_;
+                knowhere::DataSetPtr ds_ptr = knowhere::GenDataSet(1, dim_, (const float*)xq_ + q * dim_);
+                if (!index_.Search(*ds_ptr, conf, nullptr).has_value()) {
+                    failed_searches++;
+                }
+                reader_queries[r].push_back(
+                    {since(t0, arrival), std::chrono::duration<double, std::milli>(clock::now() - arrival).count()});
+            }
+        };
+
+        auto writer = [&](int32_t w) {
+            std::this_thread::sleep_until(ingest_start);
+            for (int32_t b = next_batch.fetch_add(1); b < batch_total; b = next_batch.fetch_add(1)) {
+                auto rows = std::min(BATCH_ROWS_, add_rows - b * BATCH_ROWS_);
+                auto offset = static_cast<int64_t>(base_rows) + static_cast<int64_t>(b) * BATCH_ROWS_;
+                knowhere::DataSetPtr ds_ptr = knowhere::GenDataSet(rows, dim_, (const float*)xb_ + offset * dim_);
+                if (index_.Add(*ds_ptr, conf) != knowhere::Status::success) {
+                    failed_adds++;
+                }
+                writer_batches[w].push_back({since(t0, clock::now()), rows});
+            }
+            writers_left--;
+        };
+
+        std::vector<std::thread> thread_vector;
+        for (int32_t i = 0; i < READER_NUM_; i++) {
+            thread_vector.emplace_back(reader, i);
+        }
+        for (int32_t i = 0; i < writer_num; i++) {
+            thread_vector.emplace_back(writer, i);
+        }
+        for (auto& t : thread_vector) {
+            t.join();
+        }
+
+        Run run;
+        for (auto& queries : reader_queries) {
+            run.queries.insert(run.queries.end(), queries.begin(), queries.end());
+        }
+        for (auto& batches : writer_batches) {
+            run.batches.insert(run.batches.end(), batches.begin(), batches.end());
+        }
+        double ingest_end = 0;
+        for (auto& batch : run.batches) {
+            ingest_end = std::max(ingest_end, batch.done);
+        }
+        run.ingest_elapse = ingest_end - BASELINE_S_;
+        run.failed_searches = failed_searches;
+        run.failed_adds = failed_adds;
+        run.lock_waits = faiss::ConcurrentArrayInvertedLists::writer_lock_waits.load() - lock_waits;
+        run.lock_wait_ms = (faiss::ConcurrentArrayInvertedLists::writer_lock_wait_ns.load() - lock_wait_ns) / 1e6;
+        return run;
+    }
+
+    void
+    report(int32_t writer_num, double arrival_qps, const Run& run) {
+        auto percentile = [](const std::vector<double>& ms, double p) {
+            auto idx = static_cast<size_t>(std::ceil(p * ms.size()));
+            return ms[std::clamp<size_t>(idx, 1, ms.size()) - 1];
+        };
+        double end = 0;
+        for (auto& query : run.queries) {
+            end = std::max(end, query.arrival);
+        }
+        auto window_num = static_cast<size_t>(end / WINDOW_S_) + 1;
+        std::vector<std::vector<double>> window_ms(window_num);
+        std::vector<int64_t> window_rows(window_num, 0);
+        for (auto& query : run.queries) {
+            window_ms[static_cast<size_t>(query.arrival / WINDOW_S_)].push_back(query.ms);
+        }
+        for (auto& batch : run.batches) {
+            window_rows[std::min(static_cast<size_t>(batch.done / WINDOW_S_), window_num - 1)] += batch.rows;
+        }
+
+        printf("  writers = %2d, readers = %2d, arrival = %8.1f/s\n", writer_num, READER_NUM_, arrival_qps);
+        for (size_t w = 0; w < window_num; w++) {
+            auto& ms = window_ms[w];
+            if (ms.empty()) {
+                continue;
+            }
+            std::sort(ms.begin(), ms.end());
+            printf("    [%6.1f s] added = %8ld, searches = %6zu, p50 = %7.3fms, p99 = %7.3fms, max = %7.3fms\n",
+                   w * WINDOW_S_, window_rows[w], ms.size(), percentile(ms, 0.5), percentile(ms, 0.99), ms.back());
+        }
+        int64_t rows = 0;
+        for (auto& batch : run.batches) {
+            rows += batch.rows;
+        }
+        printf("    ingest = %9.1f rows/s, lock waits = %lu (%.3fms), failed adds = %d, failed searches = %d\n",
+               rows / run.ingest_elapse, run.lock_waits, run.lock_wait_ms, run.failed_adds, run.failed_searches);
+        std::fflush(stdout);
+    }
+
+ protected:
+    void
+    SetUp() override {
+        T0_ = elapsed();
+        set_ann_test_name("sift-128-euclidean");
+        parse_ann_test_name();
+        load_hdf5_data<false>();
+
+        assert(metric_str_ == METRIC_IP_STR || metric_str_ == METRIC_L2_STR);
+        metric_type_ = (metric_str_ == METRIC_IP_STR) ? knowhere::metric::IP : knowhere::metric::L2;
+        cfg_[knowhere::meta::METRIC_TYPE] = metric_type_;
+        knowhere::KnowhereConfig::SetSimdType(knowhere::KnowhereConfig::SimdType::AUTO);
+    }
+
+    void
+    TearDown() override {
+        free_all();
+    }
+
+ protected:
+    const int32_t topk_ = 10;
+    const int32_t READER_NUM_ = 8;
+    const std::vector<int32_t> WRITER_NUMs_ = {1, 4};
+    const std::vector<double> ARRIVAL_QPSs_ = {1000, 5000};
+    const int32_t BATCH_ROWS_ = 1000;
+    // searches alone before the first Add
+    const double BASELINE_S_ = 2.0;
+    const double WINDOW_S_ = 1.0;
+
+    // IVF index params
+    const int32_t NLIST_ = 1024;
+    const int32_t NPROBE_ = 16;
+    const int32_t SSIZE_ = 48;
+};
+
+TEST_F(Benchmark_float_ingest, TEST_IVF_FLAT_CC) {
+    index_type_ = knowhere::IndexEnum::INDEX_FAISS_IVFFLAT_CC;
+
+    knowhere::Json conf = cfg_;
+    conf[knowhere::indexparam::NLIST] = NLIST_;
+    conf[knowhere::indexparam::SSIZE] = SSIZE_;
+    conf[knowhere::indexparam::NPROBE] = NPROBE_;
+    test_ingest(conf);
+}
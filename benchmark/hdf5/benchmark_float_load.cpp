@@ -0,0 +1,394 @@
+// Copyright (C) 2019-2023 Zilliz. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file except in compliance
+// with the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
+// or implied. See the License for the specific language governing permissions and limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <thread>
+#include <vector>
+
+#include "benchmark_knowhere.h"
+#include "knowhere/comp/index_param.h"
+#include "knowhere/comp/knowhere_config.h"
+#include "knowhere/comp/local_file_manager.h"
+#include "knowhere/dataset.h"
+
+namespace fs = std::filesystem;
+std::string kDir = fs::current_path().string() + "/diskann_test";
+std::string kRawDataPath = kDir + "/raw_data";
+std::string kL2IndexDir = kDir + "/l2_index";
+std::string kIPIndexDir = kDir + "/ip_index";
+std::string kL2IndexPrefix = kL2IndexDir + "/l2";
+std::string kIPIndexPrefix = kIPIndexDir + "/ip";
+
+const int32_t GPU_DEVICE_ID = 0;
+
+void
+WriteRawDataToDisk(const std::string data_path, const float* raw_data, const uint32_t num, const uint32_t dim) {
+    std::ofstream writer(data_path.c_str(), std::ios::binary);
+    writer.write((char*)&num, sizeof(uint32_t));
+    writer.write((char*)&dim, sizeof(uint32_t));
+    writer.write((char*)raw_data, sizeof(float) * num * dim);
+    writer.close();
+}
+
+// Replays the test queries from several client threads through Index::Search, one query per call, and reports the
+// throughput and the latency percentiles. A closed loop sends the next query of a client when its last one returns,
+// an open loop sends the queries at a fixed arrival rate whatever the latency; the latency of a query is then taken
+// from its arrival, so that the time it waits for a free client counts.
+class Benchmark_float_load : public Benchmark_knowhere, public ::testing::Test {
+ public:
+    void
+    test_load(const knowhere::Json& cfg) {
+        auto conf = cfg;
+        conf[knowhere::meta::TOPK] = topk_;
+
+        // warm the caches of the index up, and check the recall of the params
+        auto ds_ptr = knowhere::GenDataSet(nq_, dim_, xq_);
+        auto result = index_.Search(*ds_ptr, conf, nullptr);
+        if (!result.has_value()) {
+            printf("[%.3f s] Search of '%s' failed: %s\n", get_time_diff(), index_type_.c_str(),
+                   result.what().c_str());
+            return;
+        }
+        float recall = CalcRecall(result.value()->GetIds(), nq_, topk_);
+
+        printf("\n[%0.3f s] %s | %s | %s | k=%d, R@=%.4f\n", get_time_diff(), ann_test_name_.c_str(),
+               index_type_.c_str(), conf.dump().c_str(), topk_, recall);
+        printf("================================================================================\n");
+        for (auto arrival_qps : ARRIVAL_QPSs_) {
+            for (auto client_num : CLIENT_NUMs_) {
+                auto latencies = task(conf, client_num, arrival_qps, nq_ * ROUNDS_);
+                report(client_num, arrival_qps, latencies);
+            }
+        }
+        printf("================================================================================\n");
+        printf("[%.3f s] Test '%s/%s' done\n\n", get_time_diff(), ann_test_name_.c_str(), index_type_.c_str());
+    }
+
+ private:
+    struct Latencies {
+        // of every query, in ms
+        std::vector<double> ms;
+        double elapse;
+    };
+
+    // arrival_qps 0 for a closed loop
+    Latencies
+    task(const knowhere::Json& conf, int32_t client_num, double arrival_qps, int32_t query_total) {
+        using clock = std::chrono::steady_clock;
+        std::atomic<int32_t> next{0};
+        std::vector<std::vector<double>> client_ms(client_num);
+        auto t0 = clock::now();
+
+        auto client = [&](int32_t c) {
+            client_ms[c].reserve(query_total / client_num + 1);
+            for (int32_t i = next.fetch_add(1); i < query_total; i = next.fetch_add(1)) {
+                auto start = clock::now();
+                if (arrival_qps > 0) {
+                    auto arrival = t0 + std::chrono::duration_cast<clock::duration>(
+                                            std::chrono::duration<double>(i / arrival_qps));
+                    std::this_thread::sleep_until(arrival);
+                    start = arrival;
+                }
+                auto q = i % nq_;
+                knowhere::DataSetPtr ds_ptr = knowhere::GenDataSet(1, dim_, (const float*)xq_ + q * dim_);
+                index_.Search(*ds_ptr, conf, nullptr);
+                client_ms[c].push_back(std::chrono::duration<double, std::milli>(clock::now() - start).count());
+            }
+        };
+
+        std::vector<std::thread> thread_vector(client_num);
+        for (int32_t i = 0; i < client_num; i++) {
+            thread_vector[i] = std::thread(client, i);
+        }
+        for (int32_t i = 0; i < client_num; i++) {
+            thread_vector[i].join();
+        }
+
+        Latencies latencies;
+        latencies.elapse = std::chrono::duration<double>(clock::now() - t0).count();
+        latencies.ms.reserve(query_total);
+        for (auto& ms : client_ms) {
+            latencies.ms.insert(latencies.ms.end(), ms.begin(), ms.end());
+        }
+        std::sort(latencies.ms.begin(), latencies.ms.end());
+        return latencies;
+    }
+
+    void
+    report(int32_t client_num, double arrival_qps, const Latencies& latencies) {
+        const auto& ms = latencies.ms;
+        auto percentile = [&](double p) {
+            auto idx = static_cast<size_t>(std::ceil(p * ms.size()));
+            return ms[std::clamp<size_t>(idx, 1, ms.size()) - 1];
+        };
+        if (arrival_qps > 0) {
+            printf("  clients = %3d, arrival = %8.1f/s, ", client_num, arrival_qps);
+        } else {
+            printf("  clients = %3d, closed loop,        ", client_num);
+        }
+        printf("QPS = %9.1f, p50 = %7.3fms, p90 = %7.3fms, p99 = %7.3fms, p999 = %7.3fms, max = %7.3fms\n",
+               ms.size() / latencies.elapse, percentile(0.5), percentile(0.9), percentile(0.99), percentile(0.999),
+               ms.back());
+        std::fflush(stdout);
+    }
+
+ protected:
+    void
+    SetUp() override {
+        T0_ = elapsed();
+        set_ann_test_name("sift-128-euclidean");
+        parse_ann_test_name();
+        load_hdf5_data<false>();
+
+        assert(metric_str_ == METRIC_IP_STR || metric_str_ == METRIC_L2_STR);
+        metric_type_ = (metric_str_ == METRIC_IP_STR) ? knowhere::metric::IP : knowhere::metric::L2;
+        cfg_[knowhere::meta::METRIC_TYPE] = metric_type_;
+        knowhere::KnowhereConfig::SetSimdType(knowhere::KnowhereConfig::SimdType::AUTO);
+#ifdef KNOWHERE_WITH_GPU
+        knowhere::KnowhereConfig::InitGPUResource(GPU_DEVICE_ID, 2);
+        cfg_[knowhere::meta::DEVICE_ID] = GPU_DEVICE_ID;
+#endif
+    }
+
+    void
+    TearDown() override {
+        free_all();
+#ifdef KNOWHERE_WITH_GPU
+        knowhere::KnowhereConfig::FreeGPUResource();
+#endif
+    }
+
+ protected:
+    const int32_t topk_ = 10;
+    // every run sends the test queries ROUNDS_ times
+    const int32_t ROUNDS_ = 2;
+    const std::vector<int32_t> CLIENT_NUMs_ = {1, 4, 16, 64};
+    // 0 for a closed loop
+    const std::vector<double> ARRIVAL_QPSs_ = {0, 1000, 5000, 20000};
+
+    // IVF index params
+    const int32_t NLIST_ = 1024;
+    const int32_t NPROBE_ = 16;
+
+    // IVFPQ index params
+    const int32_t M_ = 32;
+    const int32_t NBITS_ = 8;
+
+    // HNSW index params
+    const int32_t HNSW_M_ = 16;
+    const int32_t EFCON_ = 200;
+    const int32_t EF_ = 64;
+
+    // CAGRA index params
+    const int32_t GRAPH_DEGREE_ = 32;
+    const int32_t ITOPK_SIZE_ = 64;
+};
+
+TEST_F(Benchmark_float_load, TEST_IDMAP) {
+    index_type_ = knowhere::IndexEnum::INDEX_FAISS_IDMAP;
+
+    knowhere::Json conf = cfg_;
+    create_index(get_index_name({}), conf);
+    test_load(conf);
+}
+
+TEST_F(Benchmark_float_load, TEST_IVF_FLAT) {
+    index_type_ = knowhere::IndexEnum::INDEX_FAISS_IVFFLAT;
+
+    knowhere::Json conf = cfg_;
+    conf[knowhere::indexparam::NLIST] = NLIST_;
+    create_index(get_index_name({NLIST_}), conf);
+    conf[knowhere::indexparam::NPROBE] = NPROBE_;
+    test_load(conf);
+}
+
+TEST_F(Benchmark_float_load, TEST_IVF_FLAT_CC) {
+    index_type_ = knowhere::IndexEnum::INDEX_FAISS_IVFFLAT_CC;
+
+    knowhere::Json conf = cfg_;
+    conf[knowhere::indexparam::NLIST] = NLIST_;
+    create_index(get_index_name({NLIST_}), conf);
+    conf[knowhere::indexparam::NPROBE] = NPROBE_;
+    test_load(conf);
+}
+
+TEST_F(Benchmark_float_load, TEST_IVF_SQ8) {
+    index_type_ = knowhere::IndexEnum::INDEX_FAISS_IVFSQ8;
+
+    knowhere::Json conf = cfg_;
+    conf[knowhere::indexparam::NLIST] = NLIST_;
+    create_index(get_index_name({NLIST_}), conf);
+    conf[knowhere::indexparam::NPROBE] = NPROBE_;
+    test_load(conf);
+}
+
+TEST_F(Benchmark_float_load, TEST_IVF_PQ) {
+    index_type_ = knowhere::IndexEnum::INDEX_FAISS_IVFPQ;
+
+    knowhere::Json conf = cfg_;
+    conf[knowhere::indexparam::NLIST] = NLIST_;
+    conf[knowhere::indexparam::M] = M_;
+    conf[knowhere::indexparam::NBITS] = NBITS_;
+    create_index(get_index_name({NLIST_, M_}), conf);
+    conf[knowhere::indexparam::NPROBE] = NPROBE_;
+    test_load(conf);
+}
+
+TEST_F(Benchmark_float_load, TEST_IVF_PQ_FASTSCAN) {
+    index_type_ = knowhere::IndexEnum::INDEX_FAISS_IVFPQ_FASTSCAN;
+
+    knowhere::Json conf = cfg_;
+    conf[knowhere::indexparam::NLIST] = NLIST_;
+    conf[knowhere::indexparam::M] = M_;
+    conf[knowhere::indexparam::NBITS] = 4;
+    create_index(get_index_name({NLIST_, M_}), conf);
+    conf[knowhere::indexparam::NPROBE] = NPROBE_;
+    test_load(conf);
+}
+
+TEST_F(Benchmark_float_load, TEST_SCANN) {
+    index_type_ = knowhere::IndexEnum::INDEX_FAISS_SCANN;
+
+    knowhere::Json conf = cfg_;
+    conf[knowhere::indexparam::NLIST] = NLIST_;
+    create_index(get_index_name({NLIST_}), conf);
+    conf[knowhere::indexparam::NPROBE] = NPROBE_;
+    conf[knowhere::indexparam::REORDER_K] = topk_ * 10;
+    test_load(conf);
+}
+
+TEST_F(Benchmark_float_load, TEST_HNSW) {
+    index_type_ = knowhere::IndexEnum::INDEX_HNSW;
+
+    knowhere::Json conf = cfg_;
+    conf[knowhere::indexparam::HNSW_M] = HNSW_M_;
+    conf[knowhere::indexparam::EFCONSTRUCTION] = EFCON_;
+    create_index(get_index_name({HNSW_M_, EFCON_}), conf);
+    conf[knowhere::indexparam::EF] = EF_;
+    test_load(conf);
+}
+
+#ifdef KNOWHERE_WITH_DISKANN
+TEST_F(Benchmark_float_load, TEST_DISKANN) {
+    index_type_ = knowhere::IndexEnum::INDEX_DISKANN;
+
+    knowhere::Json conf = cfg_;
+    conf["index_prefix"] = (metric_type_ == knowhere::metric::L2 ? kL2IndexPrefix : kIPIndexPrefix);
+    conf["data_path"] = kRawDataPath;
+    conf["max_degree"] = 56;
+    conf["search_list_size"] = 128;
+    conf["pq_code_budget_gb"] = sizeof(float) * dim_ * nb_ * 0.125 / (1024 * 1024 * 1024);
+    conf["build_dram_budget_gb"] = 32.0;
+
+    fs::create_directory(kDir);
+    fs::create_directory(kL2IndexDir);
+    fs::create_directory(kIPIndexDir);
+
+    WriteRawDataToDisk(kRawDataPath, (const float*)xb_, (const uint32_t)nb_, (const uint32_t)dim_);
+
+    std::shared_ptr<knowhere::FileManager> file_manager = std::make_shared<knowhere::LocalFileManager>();
+    auto diskann_index_pack = knowhere::Pack(file_manager);
+
+    index_ = knowhere::IndexFactory::Instance().Create(index_type_, diskann_index_pack);
+    printf("[%.3f s] Building all on %d vectors\n", get_time_diff(), nb_);
+    knowhere::DataSetPtr ds_ptr = nullptr;
+    index_.Build(*ds_ptr, conf);
+
+    conf["search_cache_budget_gb"] = 0;
+    conf["beamwidth"] = 8;
+    knowhere::BinarySet binset;
+    index_.Deserialize(binset, conf);
+    conf["search_list_size"] = 2 * topk_;
+    test_load(conf);
+}
+#endif
+
+#ifdef KNOWHERE_WITH_GPU
+TEST_F(Benchmark_float_load, TEST_GPU_FLAT) {
+    index_type_ = knowhere::IndexEnum::INDEX_FAISS_GPU_IDMAP;
+
+    knowhere::Json conf = cfg_;
+    create_index(get_index_name({}), conf);
+    test_load(conf);
+}
+
+TEST_F(Benchmark_float_load, TEST_GPU_IVF_FLAT) {
+    index_type_ = knowhere::IndexEnum::INDEX_FAISS_GPU_IVFFLAT;
+
+    knowhere::Json conf = cfg_;
+    conf[knowhere::indexparam::NLIST] = NLIST_;
+    create_index(get_index_name({NLIST_}), conf);
+    conf[knowhere::indexparam::NPROBE] = NPROBE_;
+    test_load(conf);
+}
+
+TEST_F(Benchmark_float_load, TEST_GPU_IVF_SQ8) {
+    index_type_ = knowhere::IndexEnum::INDEX_FAISS_GPU_IVFSQ8;
+
+    knowhere::Json conf = cfg_;
+    conf[knowhere::indexparam::NLIST] = NLIST_;
+    create_index(get_index_name({NLIST_}), conf);
+    conf[knowhere::indexparam::NPROBE] = NPROBE_;
+    test_load(conf);
+}
+
+TEST_F(Benchmark_float_load, TEST_GPU_IVF_PQ) {
+    index_type_ = knowhere::IndexEnum::INDEX_FAISS_GPU_IVFPQ;
+
+    knowhere::Json conf = cfg_;
+    conf[knowhere::indexparam::NLIST] = NLIST_;
+    conf[knowhere::indexparam::M] = M_;
+    conf[knowhere::indexparam::NBITS] = NBITS_;
+    create_index(get_index_name({NLIST_, M_}), conf);
+    conf[knowhere::indexparam::NPROBE] = NPROBE_;
+    test_load(conf);
+}
+#endif
+
+#ifdef KNOWHERE_WITH_RAFT
+TEST_F(Benchmark_float_load, TEST_RAFT_IVF_FLAT) {
+    index_type_ = knowhere::IndexEnum::INDEX_RAFT_IVFFLAT;
+
+    knowhere::Json conf = cfg_;
+    conf[knowhere::indexparam::NLIST] = NLIST_;
+    create_index(get_index_name({NLIST_}), conf);
+    conf[knowhere::indexparam::NPROBE] = NPROBE_;
+    test_load(conf);
+}
+
+TEST_F(Benchmark_float_load, TEST_RAFT_IVF_PQ) {
+    index_type_ = knowhere::IndexEnum::INDEX_RAFT_IVFPQ;
+
+    knowhere::Json conf = cfg_;
+    conf[knowhere::indexparam::NLIST] = NLIST_;
+    conf[knowhere::indexparam::M] = M_;
+    conf[knowhere::indexparam::NBITS] = NBITS_;
+    create_index(get_index_name({NLIST_, M_}), conf);
+    conf[knowhere::indexparam::NPROBE] = NPROBE_;
+    test_load(conf);
+}
+
+TEST_F(Benchmark_float_load, TEST_RAFT_CAGRA) {
+    index_type_ = knowhere::IndexEnum::INDEX_RAFT_CAGRA;
+
+    knowhere::Json conf = cfg_;
+    conf[knowhere::indexparam::INTERMEDIATE_GRAPH_DEGREE] = GRAPH_DEGREE_ * 2;
+    conf[knowhere::indexparam::GRAPH_DEGREE] = GRAPH_DEGREE_;
+    create_index(get_index_name({GRAPH_DEGREE_}), conf);
+    conf[knowhere::indexparam::ITOPK_SIZE] = ITOPK_SIZE_;
+    test_load(conf);
+}
+#endif
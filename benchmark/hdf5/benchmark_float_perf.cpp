@@ -0,0 +1,220 @@
+// Copyright (C) 2019-2023 Zilliz. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file except in compliance
+// with the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
+// or implied. See the License for the specific language governing permissions and limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <thread>
+#include <vector>
+
+#include "benchmark_knowhere.h"
+#include "knowhere/comp/index_param.h"
+#include "knowhere/comp/knowhere_config.h"
+#include "knowhere/dataset.h"
+
+/*****************************************************
+ * Writes the recall, the QPS and the latency percentiles of every index and search param set, of REPEAT_ runs each,
+ * as JSON to $KNOWHERE_PERF_REPORT (perf_report.json by default), keyed by the CPU model of the host, for
+ * ref_logs/perf_compare.py to compare against the baseline of that CPU model.
+ *****************************************************/
+class Benchmark_float_perf : public Benchmark_knowhere, public ::testing::Test {
+ public:
+    void
+    test_ivf(const knowhere::Json& cfg) {
+        auto conf = cfg;
+        for (auto nprobe : NPROBEs_) {
+            conf[knowhere::indexparam::NPROBE] = nprobe;
+            measure(conf, {{knowhere::indexparam::NLIST, conf[knowhere::indexparam::NLIST]},
+                           {knowhere::indexparam::NPROBE, nprobe}});
+        }
+    }
+
+    void
+    test_hnsw(const knowhere::Json& cfg) {
+        auto conf = cfg;
+        for (auto ef : EFs_) {
+            conf[knowhere::indexparam::EF] = ef;
+            measure(conf, {{knowhere::indexparam::HNSW_M, conf[knowhere::indexparam::HNSW_M]},
+                           {knowhere::indexparam::EFCONSTRUCTION, conf[knowhere::indexparam::EFCONSTRUCTION]},
+                           {knowhere::indexparam::EF, ef}});
+        }
+    }
+
+ private:
+    // the recall of one batch search of all queries, then REPEAT_ runs of the queries one by one on THREAD_NUM_
+    // threads, each giving its QPS and the percentiles of the latencies of its queries
+    void
+    measure(knowhere::Json conf, const knowhere::Json& params) {
+        conf[knowhere::meta::TOPK] = topk_;
+        auto ds_ptr = knowhere::GenDataSet(nq_, dim_, xq_);
+        auto result = index_.Search(*ds_ptr, conf, nullptr);
+        ASSERT_TRUE(result.has_value());
+        float recall = CalcRecall(result.value()->GetIds(), nq_, topk_);
+
+        knowhere::Json runs = knowhere::Json::array();
+        for (int32_t r = 0; r < REPEAT_; r++) {
+            std::vector<double> latencies(nq_);
+            CALC_TIME_SPAN(task(conf, latencies));
+            std::sort(latencies.begin(), latencies.end());
+            runs.push_back({{"qps", nq_ / t_diff},
+                            {"p50_ms", percentile(latencies, 0.50)},
+                            {"p90_ms", percentile(latencies, 0.90)},
+                            {"p99_ms", percentile(latencies, 0.99)}});
+        }
+
+        printf("[%.3f s] %s | %s | %s, R@ = %.4f, QPS = %.3f, p99 = %.3fms\n", get_time_diff(), ann_test_name_.c_str(),
+               index_type_.c_str(), params.dump().c_str(), recall, runs.back()["qps"].get<double>(),
+               runs.back()["p99_ms"].get<double>());
+        std::fflush(stdout);
+
+        report_["results"].push_back({{"index", index_type_},
+                                      {"params", params},
+                                      {"nq", nq_},
+                                      {"k", topk_},
+                                      {"threads", THREAD_NUM_},
+                                      {"recall", recall},
+                                      {"runs", runs}});
+        write_report();
+    }
+
+    void
+    task(const knowhere::Json& conf, std::vector<double>& latencies) {
+        auto worker = [&](int32_t idx_start, int32_t num) {
+            num = std::min(num, nq_ - idx_start);
+            for (int32_t i = 0; i < num; i++) {
+                auto query = idx_start + i;
+                knowhere::DataSetPtr ds_ptr = knowhere::GenDataSet(1, dim_, (const float*)xq_ + query * dim_);
+                double t_start = elapsed();
+                index_.Search(*ds_ptr, conf, nullptr);
+                latencies[query] = (elapsed() - t_start) * 1000;
+            }
+        };
+
+        int32_t req_num = (nq_ + THREAD_NUM_ - 1) / THREAD_NUM_;
+        std::vector<std::thread> thread_vector(THREAD_NUM_);
+        for (int32_t i = 0; i < THREAD_NUM_; i++) {
+            thread_vector[i] = std::thread(worker, req_num * i, req_num);
+        }
+        for (int32_t i = 0; i < THREAD_NUM_; i++) {
+            thread_vector[i].join();
+        }
+    }
+
+    static double
+    percentile(const std::vector<double>& sorted, double p) {
+        auto idx = std::min(sorted.size() - 1, static_cast<size_t>(p * sorted.size()));
+        return sorted[idx];
+    }
+
+    static std::string
+    cpu_model() {
+        std::ifstream cpuinfo("/proc/cpuinfo");
+        std::string line;
+        while (std::getline(cpuinfo, line)) {
+            if (line.rfind("model name", 0) == 0) {
+                auto pos = line.find(':');
+                return pos == std::string::npos ? line : line.substr(line.find_first_not_of(' ', pos + 1));
+            }
+        }
+        return "unknown";
+    }
+
+    // the whole report is written again after every measurement, so an aborted run still leaves what it measured
+    void
+    write_report() {
+        const char* path = std::getenv("KNOWHERE_PERF_REPORT");
+        std::ofstream out(path != nullptr ? path : "perf_report.json");
+        out << report_.dump(2) << std::endl;
+    }
+
+ protected:
+    void
+    SetUp() override {
+        T0_ = elapsed();
+        set_ann_test_name("sift-128-euclidean");
+        parse_ann_test_name();
+        load_hdf5_data<false>();
+
+        assert(metric_str_ == METRIC_IP_STR || metric_str_ == METRIC_L2_STR);
+        metric_type_ = (metric_str_ == METRIC_IP_STR) ? knowhere::metric::IP : knowhere::metric::L2;
+        cfg_[knowhere::meta::METRIC_TYPE] = metric_type_;
+        knowhere::KnowhereConfig::SetSimdType(knowhere::KnowhereConfig::SimdType::AUTO);
+
+        if (report_.empty()) {
+            report_ = {{"cpu", cpu_model()},
+                       {"hardware_concurrency", std::thread::hardware_concurrency()},
+                       {"dataset", ann_test_name_},
+                       {"results", knowhere::Json::array()}};
+        }
+    }
+
+    void
+    TearDown() override {
+        free_all();
+    }
+
+ protected:
+    static inline knowhere::Json report_;
+
+    const int32_t topk_ = 100;
+    const int32_t REPEAT_ = 5;
+    const int32_t THREAD_NUM_ = 4;
+
+    // IVF index params
+    const std::vector<int32_t> NLISTs_ = {1024};
+    const std::vector<int32_t> NPROBEs_ = {16, 64};
+
+    // HNSW index params
+    const std::vector<int32_t> HNSW_Ms_ = {16};
+    const std::vector<int32_t> EFCONs_ = {200};
+    const std::vector<int32_t> EFs_ = {128, 256};
+};
+
+TEST_F(Benchmark_float_perf, TEST_IVF_FLAT) {
+    index_type_ = knowhere::IndexEnum::INDEX_FAISS_IVFFLAT;
+
+    knowhere::Json conf = cfg_;
+    for (auto nlist : NLISTs_) {
+        conf[knowhere::indexparam::NLIST] = nlist;
+        std::string index_file_name = get_index_name({nlist});
+        create_index(index_file_name, conf);
+        test_ivf(conf);
+    }
+}
+
+TEST_F(Benchmark_float_perf, TEST_IVF_SQ8) {
+    index_type_ = knowhere::IndexEnum::INDEX_FAISS_IVFSQ8;
+
+    knowhere::Json conf = cfg_;
+    for (auto nlist : NLISTs_) {
+        conf[knowhere::indexparam::NLIST] = nlist;
+        std::string index_file_name = get_index_name({nlist});
+        create_index(index_file_name, conf);
+        test_ivf(conf);
+    }
+}
+
+TEST_F(Benchmark_float_perf, TEST_HNSW) {
+    index_type_ = knowhere::IndexEnum::INDEX_HNSW;
+
+    knowhere::Json conf = cfg_;
+    for (auto M : HNSW_Ms_) {
+        conf[knowhere::indexparam::HNSW_M] = M;
+        for (auto efc : EFCONs_) {
+            conf[knowhere::indexparam::EFCONSTRUCTION] = efc;
+            std::string index_file_name = get_index_name({M, efc});
+            create_index(index_file_name, conf);
+            test_hnsw(conf);
+        }
+    }
+}
@@ -0,0 +1,148 @@
+#!/usr/bin/env python3
+"""Compares a perf report of benchmark_float_perf against the baseline of the CPU model it was measured on.
+
+A metric regresses when the mean of its runs is worse than the baseline by more than --threshold (relative) and
+Welch's t-test over the runs of both sides gives a p-value below --alpha, so noise alone does not flag it. Recall is
+deterministic per run and regresses when it drops by more than --recall-drop (absolute).
+
+    perf_compare.py perf_report.json                # compare, exit 1 on regression
+    perf_compare.py perf_report.json --update       # store the report as the baseline of its CPU model
+"""
+
+import argparse
+import json
+import math
+import os
+import re
+import sys
+
+# metric -> True if larger is better
+METRICS = {"qps": True, "p50_ms": False, "p90_ms": False, "p99_ms": False}
+
+
+def baseline_path(baseline_dir, cpu):
+    slug = re.sub(r"[^a-z0-9]+", "_", cpu.lower()).strip("_")
+    return os.path.join(baseline_dir, slug + ".json")
+
+
+def result_key(result):
+    return "%s %s nq=%d k=%d threads=%d" % (
+        result["index"], json.dumps(result["params"], sort_keys=True), result["nq"], result["k"], result["threads"])
+
+
+def mean_var(values):
+    n = len(values)
+    mean = sum(values) / n
+    var = sum((v - mean) ** 2 for v in values) / (n - 1) if n > 1 else 0.0
+    return mean, var
+
+
+def betacf(a, b, x):
+    # continued fraction of the incomplete beta function, Numerical Recipes 6.4
+    qab, qap, qam = a + b, a + 1.0, a - 1.0
+    c, d = 1.0, 1.0 - qab * x / qap
+    d = 1.0 / (d if abs(d) > 1e-30 else 1e-30)
+    h = d
+    for m in range(1, 201):
+        m2 = 2 * m
+        even = m * (b - m) * x / ((qam + m2) * (a + m2))
+        odd = -(a + m) * (qab + m) * x / ((a + m2) * (qap + m2))
+        for step, aa in enumerate((even, odd)):
+            d = 1.0 + aa * d
+            d = 1.0 / (d if abs(d) > 1e-30 else 1e-30)
+            c = 1.0 + aa / c
+            c = c if abs(c) > 1e-30 else 1e-30
+            h *= d * c
+            if step == 1 and abs(d * c - 1.0) < 3e-12:
+                return h
+    return h
+
+
+def betai(a, b, x):
+    if x <= 0.0 or x >= 1.0:
+        return 0.0 if x <= 0.0 else 1.0
+    bt = math.exp(math.lgamma(a + b) - math.lgamma(a) - math.lgamma(b) + a * math.log(x) + b * math.log(1.0 - x))
+    if x < (a + 1.0) / (a + b + 2.0):
+        return bt * betacf(a, b, x) / a
+    return 1.0 - bt * betacf(b, a, 1.0 - x) / b
+
+
+def welch_p(base, cur):
+    """the two-sided p-value of Welch's t-test of the means of two samples"""
+    if len(base) < 2 or len(cur) < 2:
+        return 0.0
+    m1, v1 = mean_var(base)
+    m2, v2 = mean_var(cur)
+    se2 = v1 / len(base) + v2 / len(cur)
+    if se2 == 0.0:
+        return 1.0 if m1 == m2 else 0.0
+    t = (m2 - m1) / math.sqrt(se2)
+    df = se2 ** 2 / ((v1 / len(base)) ** 2 / (len(base) - 1) + (v2 / len(cur)) ** 2 / (len(cur) - 1))
+    return betai(df / 2.0, 0.5, df / (df + t * t))
+
+
+def compare(baseline, report, args):
+    base_results = {result_key(r): r for r in baseline["results"]}
+    regressions = 0
+    for cur in report["results"]:
+        key = result_key(cur)
+        base = base_results.get(key)
+        if base is None:
+            print("  NEW   %s" % key)
+            continue
+        lines = []
+        if base["recall"] - cur["recall"] > args.recall_drop:
+            lines.append("recall %.4f -> %.4f" % (base["recall"], cur["recall"]))
+        for metric, larger_better in METRICS.items():
+            b = [run[metric] for run in base["runs"]]
+            c = [run[metric] for run in cur["runs"]]
+            b_mean, c_mean = mean_var(b)[0], mean_var(c)[0]
+            change = (c_mean - b_mean) / b_mean if b_mean else 0.0
+            worse = -change if larger_better else change
+            p = welch_p(b, c)
+            if worse > args.threshold and p < args.alpha:
+                lines.append("%s %.3f -> %.3f (%+.1f%%, p=%.4f)" % (metric, b_mean, c_mean, change * 100, p))
+        if lines:
+            regressions += 1
+            print("  REGR  %s\n        %s" % (key, "\n        ".join(lines)))
+        else:
+            print("  OK    %s" % key)
+    for key in base_results.keys() - {result_key(r) for r in report["results"]}:
+        print("  GONE  %s" % key)
+    return regressions
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("report", help="the JSON report of benchmark_float_perf")
+    parser.add_argument("--baseline-dir", default=os.path.join(os.path.dirname(os.path.abspath(__file__)), "baselines"))
+    parser.add_argument("--threshold", type=float, default=0.05, help="relative change a regression exceeds")
+    parser.add_argument("--alpha", type=float, default=0.01, help="p-value a regression is below")
+    parser.add_argument("--recall-drop", type=float, default=0.005, help="absolute recall drop that regresses")
+    parser.add_argument("--update", action="store_true", help="store the report as the baseline of its CPU model")
+    args = parser.parse_args()
+
+    with open(args.report) as f:
+        report = json.load(f)
+    path = baseline_path(args.baseline_dir, report["cpu"])
+
+    if args.update:
+        os.makedirs(args.baseline_dir, exist_ok=True)
+        with open(path, "w") as f:
+            json.dump(report, f, indent=2)
+        print("baseline of '%s' stored to %s" % (report["cpu"], path))
+        return 0
+
+    if not os.path.exists(path):
+        print("no baseline of '%s' at %s, store one with --update" % (report["cpu"], path))
+        return 2
+    with open(path) as f:
+        baseline = json.load(f)
+    print("comparing %s against %s (%s)" % (args.report, path, report["cpu"]))
+    regressions = compare(baseline, report, args)
+    print("%d regression(s)" % regressions)
+    return 1 if regressions else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
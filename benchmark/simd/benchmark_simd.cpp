@@ -0,0 +1,502 @@
+// Copyright (C) 2019-2023 Zilliz. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file except in compliance
+// with the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
+// or implied. See the License for the specific language governing permissions and limitations under the License.
+
+// Throughput of the simd kernels at every simd level and of the primitives around them, over dim and n. The kernels
+// are the ones SetSimdType hooks, so that a benchmark measures what the indexes call; a level the cpu lacks is
+// skipped. Keep a run with --benchmark_out=<file> --benchmark_out_format=json as the baseline, and compare a later
+// run against it with tools/compare.py of google-benchmark.
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "common/range_util.h"
+#include "faiss/utils/Heap.h"
+#include "knowhere/bitsetview.h"
+#include "knowhere/comp/knowhere_config.h"
+#include "knowhere/config.h"
+#include "knowhere/heap.h"
+#include "knowhere/utils.h"
+#include "simd/hook.h"
+
+namespace {
+
+using SimdType = knowhere::KnowhereConfig::SimdType;
+
+const std::vector<int64_t> kDims = {32, 128, 768, 1536};
+const std::vector<int64_t> kNs = {64, 4096};
+
+template <typename T>
+std::vector<T>
+RandomVector(size_t n, int seed = 42) {
+    std::mt19937 rng(seed);
+    std::vector<T> v(n);
+    if constexpr (std::is_floating_point_v<T>) {
+        std::uniform_real_distribution<T> dist(-1, 1);
+        std::generate(v.begin(), v.end(), [&]() { return dist(rng); });
+    } else {
+        std::uniform_int_distribution<int> dist(std::numeric_limits<T>::min(), std::numeric_limits<T>::max());
+        std::generate(v.begin(), v.end(), [&]() { return static_cast<T>(dist(rng)); });
+    }
+    return v;
+}
+
+std::vector<uint16_t>
+RandomHalves(size_t n, void (*convert)(uint16_t*, const float*, size_t)) {
+    auto x = RandomVector<float>(n);
+    std::vector<uint16_t> y(n);
+    convert(y.data(), x.data(), n);
+    return y;
+}
+
+// hooks the kernels of the level, false with the benchmark skipped when the cpu has not got it
+bool
+Hook(benchmark::State& state, SimdType type, const std::string& level) {
+    if (knowhere::KnowhereConfig::SetSimdType(type) != level) {
+        state.SkipWithError((level + " not supported").c_str());
+        return false;
+    }
+    return true;
+}
+
+void
+SetProcessed(benchmark::State& state, int64_t vectors, int64_t bytes_per_vector) {
+    state.SetItemsProcessed(state.iterations() * vectors);
+    state.SetBytesProcessed(state.iterations() * vectors * bytes_per_vector);
+}
+
+// a kernel of a vector and each of n vectors of dim, one call per pair
+template <typename T>
+void
+RegisterPairwise(const std::string& level, SimdType type, const char* name,
+                 float (**kernel)(const T*, const T*, size_t)) {
+    benchmark::RegisterBenchmark((level + "/" + name).c_str(),
+                                 [=](benchmark::State& state) {
+                                     if (!Hook(state, type, level)) {
+                                         return;
+                                     }
+                                     size_t d = state.range(0), n = state.range(1);
+                                     auto x = RandomVector<T>(d, 1);
+                                     auto y = RandomVector<T>(d * n, 2);
+                                     for (auto _ : state) {
+                                         for (size_t i = 0; i < n; ++i) {
+                                             benchmark::DoNotOptimize((*kernel)(x.data(), y.data() + i * d, d));
+                                         }
+                                     }
+                                     SetProcessed(state, n, d * sizeof(T));
+                                 })
+        ->ArgsProduct({kDims, kNs});
+}
+
+// a kernel of a vector and n vectors of dim in one call
+template <typename X, typename Y>
+void
+RegisterNy(const std::string& level, SimdType type, const char* name,
+           void (**kernel)(float*, const X*, const Y*, size_t, size_t), std::vector<Y> (*gen)(size_t)) {
+    benchmark::RegisterBenchmark((level + "/" + name).c_str(),
+                                 [=](benchmark::State& state) {
+                                     if (!Hook(state, type, level)) {
+                                         return;
+                                     }
+                                     size_t d = state.range(0), n = state.range(1);
+                                     auto x = RandomVector<X>(d, 1);
+                                     auto y = gen(d * n);
+                                     std::vector<float> dis(n);
+                                     for (auto _ : state) {
+                                         (*kernel)(dis.data(), x.data(), y.data(), d, n);
+                                         benchmark::DoNotOptimize(dis.data());
+                                     }
+                                     SetProcessed(state, n, d * sizeof(Y));
+                                 })
+        ->ArgsProduct({kDims, kNs});
+}
+
+// a kernel of a float vector and halves
+void
+RegisterHalves(const std::string& level, SimdType type, const char* name,
+               float (**kernel)(const float*, const uint16_t*, size_t), bool bf16) {
+    benchmark::RegisterBenchmark((level + "/" + name).c_str(),
+                                 [=](benchmark::State& state) {
+                                     if (!Hook(state, type, level)) {
+                                         return;
+                                     }
+                                     size_t d = state.range(0), n = state.range(1);
+                                     auto x = RandomVector<float>(d, 1);
+                                     auto y = RandomHalves(d * n, bf16 ? faiss::fvec_to_bf16 : faiss::fvec_to_fp16);
+                                     for (auto _ : state) {
+                                         for (size_t i = 0; i < n; ++i) {
+                                             benchmark::DoNotOptimize((*kernel)(x.data(), y.data() + i * d, d));
+                                         }
+                                     }
+                                     SetProcessed(state, n, d * sizeof(uint16_t));
+                                 })
+        ->ArgsProduct({kDims, kNs});
+}
+
+std::vector<float>
+GenFloats(size_t n) {
+    return RandomVector<float>(n, 2);
+}
+
+std::vector<int8_t>
+GenInt8s(size_t n) {
+    return RandomVector<int8_t>(n, 2);
+}
+
+std::vector<uint8_t>
+GenBytes(size_t n) {
+    return RandomVector<uint8_t>(n, 2);
+}
+
+std::vector<uint16_t>
+GenFp16s(size_t n) {
+    return RandomHalves(n, faiss::fvec_to_fp16);
+}
+
+std::vector<uint16_t>
+GenBf16s(size_t n) {
+    return RandomHalves(n, faiss::fvec_to_bf16);
+}
+
+void
+RegisterKernels(const std::string& level, SimdType type) {
+    RegisterPairwise<float>(level, type, "fvec_L2sqr", &faiss::fvec_L2sqr);
+    RegisterPairwise<float>(level, type, "fvec_inner_product", &faiss::fvec_inner_product);
+    RegisterPairwise<float>(level, type, "fvec_L1", &faiss::fvec_L1);
+    RegisterPairwise<float>(level, type, "fvec_Linf", &faiss::fvec_Linf);
+    RegisterPairwise<float>(level, type, "fvec_cosine", &faiss::fvec_cosine);
+    RegisterPairwise<int8_t>(level, type, "i8vec_L2sqr", &faiss::i8vec_L2sqr);
+    RegisterPairwise<int8_t>(level, type, "i8vec_inner_product", &faiss::i8vec_inner_product);
+    RegisterHalves(level, type, "fp16vec_L2sqr", &faiss::fp16vec_L2sqr, false);
+    RegisterHalves(level, type, "fp16vec_inner_product", &faiss::fp16vec_inner_product, false);
+    RegisterHalves(level, type, "bf16vec_L2sqr", &faiss::bf16vec_L2sqr, true);
+    RegisterHalves(level, type, "bf16vec_inner_product", &faiss::bf16vec_inner_product, true);
+
+    RegisterNy<float, float>(level, type, "fvec_L2sqr_ny", &faiss::fvec_L2sqr_ny, GenFloats);
+    RegisterNy<float, float>(level, type, "fvec_inner_products_ny", &faiss::fvec_inner_products_ny, GenFloats);
+    RegisterNy<int8_t, int8_t>(level, type, "i8vec_L2sqr_ny", &faiss::i8vec_L2sqr_ny, GenInt8s);
+    RegisterNy<int8_t, int8_t>(level, type, "i8vec_inner_products_ny", &faiss::i8vec_inner_products_ny, GenInt8s);
+    RegisterNy<float, uint16_t>(level, type, "fp16vec_L2sqr_ny", &faiss::fp16vec_L2sqr_ny, GenFp16s);
+    RegisterNy<float, uint16_t>(level, type, "fp16vec_inner_products_ny", &faiss::fp16vec_inner_products_ny, GenFp16s);
+    RegisterNy<float, uint16_t>(level, type, "bf16vec_L2sqr_ny", &faiss::bf16vec_L2sqr_ny, GenBf16s);
+    RegisterNy<float, uint16_t>(level, type, "bf16vec_inner_products_ny", &faiss::bf16vec_inner_products_ny, GenBf16s);
+    // dim is the code size in bytes for the binary kernels
+    RegisterNy<uint8_t, uint8_t>(level, type, "bvec_hamming_ny", &faiss::bvec_hamming_ny, GenBytes);
+    RegisterNy<uint8_t, uint8_t>(level, type, "bvec_jaccard_ny", &faiss::bvec_jaccard_ny, GenBytes);
+
+    benchmark::RegisterBenchmark((level + "/fvec_norm_L2sqr").c_str(),
+                                 [=](benchmark::State& state) {
+                                     if (!Hook(state, type, level)) {
+                                         return;
+                                     }
+                                     size_t d = state.range(0), n = state.range(1);
+                                     auto x = RandomVector<float>(d * n);
+                                     for (auto _ : state) {
+                                         for (size_t i = 0; i < n; ++i) {
+                                             benchmark::DoNotOptimize(faiss::fvec_norm_L2sqr(x.data() + i * d, d));
+                                         }
+                                     }
+                                     SetProcessed(state, n, d * sizeof(float));
+                                 })
+        ->ArgsProduct({kDims, kNs});
+
+    // the rows of a graph hop: n rows picked at random out of 64k
+    for (auto [name, kernel] : {std::make_pair("fvec_L2sqr_batch_indexed", &faiss::fvec_L2sqr_batch_indexed),
+                                std::make_pair("fvec_inner_product_batch_indexed",
+                                               &faiss::fvec_inner_product_batch_indexed)}) {
+        benchmark::RegisterBenchmark((level + "/" + name).c_str(),
+                                     [=](benchmark::State& state) {
+                                         if (!Hook(state, type, level)) {
+                                             return;
+                                         }
+                                         const size_t rows = 65536;
+                                         size_t d = state.range(0), n = state.range(1);
+                                         auto x = RandomVector<float>(d, 1);
+                                         auto base = RandomVector<float>(d * rows, 2);
+                                         std::vector<uint32_t> ids(n);
+                                         std::mt19937 rng(3);
+                                         std::generate(ids.begin(), ids.end(), [&]() { return rng() % rows; });
+                                         std::vector<float> dis(n);
+                                         for (auto _ : state) {
+                                             (*kernel)(dis.data(), x.data(), (const char*)base.data(), ids.data(), n,
+                                                       d, d * sizeof(float));
+                                             benchmark::DoNotOptimize(dis.data());
+                                         }
+                                         SetProcessed(state, n, d * sizeof(float));
+                                     })
+            ->ArgsProduct({kDims, {16, 64}});
+    }
+
+    for (auto [name, kernel] : {std::make_pair("fvec_L2sqr_block_16", &faiss::fvec_L2sqr_block_16),
+                                std::make_pair("fvec_inner_product_block_16", &faiss::fvec_inner_product_block_16)}) {
+        benchmark::RegisterBenchmark((level + "/" + name).c_str(),
+                                     [=](benchmark::State& state) {
+                                         if (!Hook(state, type, level)) {
+                                             return;
+                                         }
+                                         size_t d = state.range(0);
+                                         auto x = RandomVector<float>(d, 1);
+                                         auto block = RandomVector<float>(d * 16, 2);
+                                         float dis[16];
+                                         for (auto _ : state) {
+                                             (*kernel)(dis, x.data(), block.data(), d);
+                                             benchmark::DoNotOptimize(dis);
+                                         }
+                                         SetProcessed(state, 16, d * sizeof(float));
+                                     })
+            ->ArgsProduct({kDims});
+    }
+
+    benchmark::RegisterBenchmark((level + "/fvec_madd_and_argmin").c_str(),
+                                 [=](benchmark::State& state) {
+                                     if (!Hook(state, type, level)) {
+                                         return;
+                                     }
+                                     size_t n = state.range(0);
+                                     auto a = RandomVector<float>(n, 1);
+                                     auto b = RandomVector<float>(n, 2);
+                                     std::vector<float> c(n);
+                                     for (auto _ : state) {
+                                         faiss::fvec_madd(n, a.data(), 0.5f, b.data(), c.data());
+                                         benchmark::DoNotOptimize(
+                                             faiss::fvec_madd_and_argmin(n, a.data(), 0.5f, b.data(), c.data()));
+                                     }
+                                     SetProcessed(state, n, 2 * sizeof(float));
+                                 })
+        ->ArgsProduct({{1024, 65536}});
+
+    for (auto [name, convert] : {std::make_pair("fvec_to_fp16", &faiss::fvec_to_fp16),
+                                 std::make_pair("fvec_to_bf16", &faiss::fvec_to_bf16)}) {
+        benchmark::RegisterBenchmark((level + "/" + name).c_str(),
+                                     [=](benchmark::State& state) {
+                                         if (!Hook(state, type, level)) {
+                                             return;
+                                         }
+                                         size_t n = state.range(0);
+                                         auto x = RandomVector<float>(n);
+                                         std::vector<uint16_t> y(n);
+                                         for (auto _ : state) {
+                                             (*convert)(y.data(), x.data(), n);
+                                             benchmark::DoNotOptimize(y.data());
+                                         }
+                                         SetProcessed(state, n, sizeof(float));
+                                     })
+            ->ArgsProduct({{1024, 65536}});
+    }
+    for (auto [name, convert] : {std::make_pair("fp16_to_fvec", &faiss::fp16_to_fvec),
+                                 std::make_pair("bf16_to_fvec", &faiss::bf16_to_fvec)}) {
+        benchmark::RegisterBenchmark((level + "/" + name).c_str(),
+                                     [=](benchmark::State& state) {
+                                         if (!Hook(state, type, level)) {
+                                             return;
+                                         }
+                                         size_t n = state.range(0);
+                                         auto y = RandomHalves(n, faiss::fvec_to_fp16);
+                                         std::vector<float> x(n);
+                                         for (auto _ : state) {
+                                             (*convert)(x.data(), y.data(), n);
+                                             benchmark::DoNotOptimize(x.data());
+                                         }
+                                         SetProcessed(state, n, sizeof(uint16_t));
+                                     })
+            ->ArgsProduct({{1024, 65536}});
+    }
+
+    // dim is the code size in bytes
+    benchmark::RegisterBenchmark((level + "/bvec_hamming").c_str(),
+                                 [=](benchmark::State& state) {
+                                     if (!Hook(state, type, level)) {
+                                         return;
+                                     }
+                                     size_t d = state.range(0), n = state.range(1);
+                                     auto x = RandomVector<uint8_t>(d, 1);
+                                     auto y = RandomVector<uint8_t>(d * n, 2);
+                                     for (auto _ : state) {
+                                         for (size_t i = 0; i < n; ++i) {
+                                             benchmark::DoNotOptimize(faiss::bvec_hamming(x.data(), &y[i * d], d));
+                                             benchmark::DoNotOptimize(faiss::bvec_jaccard_dis(x.data(), &y[i * d], d));
+                                             benchmark::DoNotOptimize(faiss::bvec_is_subset(x.data(), &y[i * d], d));
+                                         }
+                                     }
+                                     SetProcessed(state, n, d);
+                                 })
+        ->ArgsProduct({kDims, kNs});
+
+    benchmark::RegisterBenchmark((level + "/bvec_hamming_batch_4").c_str(),
+                                 [=](benchmark::State& state) {
+                                     if (!Hook(state, type, level)) {
+                                         return;
+                                     }
+                                     size_t d = state.range(0), n = state.range(1) / 4 * 4;
+                                     auto x = RandomVector<uint8_t>(d, 1);
+                                     auto y = RandomVector<uint8_t>(d * n, 2);
+                                     float dis[4];
+                                     for (auto _ : state) {
+                                         for (size_t i = 0; i < n; i += 4) {
+                                             faiss::bvec_hamming_batch_4(x.data(), &y[i * d], &y[(i + 1) * d],
+                                                                         &y[(i + 2) * d], &y[(i + 3) * d], d, dis[0],
+                                                                         dis[1], dis[2], dis[3]);
+                                             faiss::bvec_jaccard_batch_4(x.data(), &y[i * d], &y[(i + 1) * d],
+                                                                         &y[(i + 2) * d], &y[(i + 3) * d], d, dis[0],
+                                                                         dis[1], dis[2], dis[3]);
+                                             benchmark::DoNotOptimize(dis);
+                                         }
+                                     }
+                                     SetProcessed(state, n, d);
+                                 })
+        ->ArgsProduct({kDims, kNs});
+
+    // dim is the number of PQ chunks
+    benchmark::RegisterBenchmark((level + "/pq_adc_ny").c_str(),
+                                 [=](benchmark::State& state) {
+                                     if (!Hook(state, type, level)) {
+                                         return;
+                                     }
+                                     size_t m = state.range(0), n = state.range(1);
+                                     auto codes = RandomVector<uint8_t>(m * n);
+                                     auto tables = RandomVector<float>(m * 256);
+                                     std::vector<float> dis(n);
+                                     for (auto _ : state) {
+                                         faiss::pq_adc_ny(dis.data(), codes.data(), tables.data(), n, m);
+                                         benchmark::DoNotOptimize(dis.data());
+                                     }
+                                     SetProcessed(state, n, m);
+                                 })
+        ->ArgsProduct({{8, 32, 64}, kNs});
+}
+
+void
+RegisterPrimitives() {
+    // n bits with a tenth of them set
+    benchmark::RegisterBenchmark("BitsetView::count", [](benchmark::State& state) {
+        size_t n = state.range(0);
+        std::vector<uint8_t> bits((n + 7) / 8);
+        for (size_t i = 0; i < n; i += 10) {
+            bits[i / 8] |= 1 << (i % 8);
+        }
+        knowhere::BitsetView bitset(bits.data(), n);
+        for (auto _ : state) {
+            benchmark::DoNotOptimize(bitset.count());
+        }
+        SetProcessed(state, n, 0);
+    })->ArgsProduct({{1 << 16, 1 << 24}});
+
+    benchmark::RegisterBenchmark("NormalizeVecs", [](benchmark::State& state) {
+        knowhere::KnowhereConfig::SetSimdType(SimdType::AUTO);
+        size_t d = state.range(0), n = state.range(1);
+        auto x = RandomVector<float>(d * n);
+        for (auto _ : state) {
+            benchmark::DoNotOptimize(knowhere::NormalizeVecs(x.data(), n, d));
+        }
+        SetProcessed(state, n, d * sizeof(float));
+    })->ArgsProduct({kDims, kNs});
+
+    benchmark::RegisterBenchmark("hash_vec", [](benchmark::State& state) {
+        size_t d = state.range(0);
+        auto x = RandomVector<float>(d);
+        for (auto _ : state) {
+            benchmark::DoNotOptimize(knowhere::hash_vec(x.data(), d));
+        }
+        SetProcessed(state, 1, d * sizeof(float));
+    })->ArgsProduct({kDims});
+
+    // the top k of n random distances, pushed while the heap fills and then replacing its top
+    benchmark::RegisterBenchmark("faiss::maxheap", [](benchmark::State& state) {
+        size_t k = state.range(0), n = state.range(1);
+        auto dis = RandomVector<float>(n);
+        std::vector<float> heap_dis(k);
+        std::vector<int64_t> heap_ids(k);
+        for (auto _ : state) {
+            size_t size = 0;
+            for (size_t i = 0; i < n; ++i) {
+                if (size < k) {
+                    faiss::maxheap_push(++size, heap_dis.data(), heap_ids.data(), dis[i], i);
+                } else if (dis[i] < heap_dis[0]) {
+                    faiss::maxheap_replace_top(k, heap_dis.data(), heap_ids.data(), dis[i], i);
+                }
+            }
+            benchmark::DoNotOptimize(heap_dis.data());
+        }
+        SetProcessed(state, n, sizeof(float));
+    })->ArgsProduct({{10, 100}, kNs});
+
+    benchmark::RegisterBenchmark("knowhere::ResultMaxHeap", [](benchmark::State& state) {
+        size_t k = state.range(0), n = state.range(1);
+        auto dis = RandomVector<float>(n);
+        for (auto _ : state) {
+            knowhere::ResultMaxHeap<float, int64_t> heap(k);
+            for (size_t i = 0; i < n; ++i) {
+                heap.Push(dis[i], i);
+            }
+            benchmark::DoNotOptimize(heap.Size());
+        }
+        SetProcessed(state, n, sizeof(float));
+    })->ArgsProduct({{10, 100, 4096}, kNs});
+
+    // nq queries of n results each, bounded by max_results or not
+    benchmark::RegisterBenchmark("RangeSearchResultBuilder", [](benchmark::State& state) {
+        int64_t nq = 64, n = state.range(0), max_results = state.range(1);
+        auto dis = RandomVector<float>(n);
+        knowhere::BaseConfig cfg;
+        for (auto _ : state) {
+            knowhere::RangeSearchResultBuilder results(nq, max_results, false);
+            for (int64_t q = 0; q < nq; ++q) {
+                auto writer = results.Query(q);
+                for (int64_t i = 0; i < n; ++i) {
+                    writer.Add(dis[i], i);
+                }
+            }
+            float* distances = nullptr;
+            int64_t* ids = nullptr;
+            size_t* lims = nullptr;
+            results.Build(cfg, distances, ids, lims);
+            delete[] distances;
+            delete[] ids;
+            delete[] lims;
+        }
+        SetProcessed(state, nq * n, sizeof(float) + sizeof(int64_t));
+    })->ArgsProduct({{64, 4096}, {0, 100}});
+}
+
+}  // namespace
+
+int
+main(int argc, char** argv) {
+#if defined(__x86_64__)
+    const std::vector<std::pair<std::string, SimdType>> levels = {{"AVX512", SimdType::AVX512},
+                                                                  {"AVX2", SimdType::AVX2},
+                                                                  {"SSE4_2", SimdType::SSE4_2},
+                                                                  {"GENERIC", SimdType::GENERIC}};
+#else
+    // SVE or NEON, whichever the cpu has
+    const std::vector<std::pair<std::string, SimdType>> levels = {
+        {knowhere::KnowhereConfig::SetSimdType(SimdType::AUTO), SimdType::AUTO}, {"GENERIC", SimdType::GENERIC}};
+#endif
+    for (const auto& [level, type] : levels) {
+        RegisterKernels(level, type);
+    }
+    RegisterPrimitives();
+
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+        return 1;
+    }
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
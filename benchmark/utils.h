@@ -11,9 +11,11 @@
 
 #pragma once
 
+#include <algorithm>
 #include <cstdio>
 #include <cstdlib>
 #include <fstream>
+#include <numeric>
 #include <random>
 #include <string>
 #include <vector>
@@ -82,3 +84,23 @@ GenRandomBitset(size_t n, size_t t) {
     }
     return data;
 }
+
+// Return a n-bits bitset data with t bits set to true in runs of run_len consecutive bits at random offsets, the
+// filters of rows inserted together, like a partition or a time range
+inline std::vector<uint8_t>
+GenClusteredBitset(size_t n, size_t t, size_t run_len) {
+    assert(t >= 0 && t <= n && run_len > 0);
+    size_t runs = (n + run_len - 1) / run_len;
+    std::vector<size_t> order(runs);
+    std::iota(order.begin(), order.end(), 0);
+    std::mt19937 g(42);
+    std::shuffle(order.begin(), order.end(), g);
+    std::vector<uint8_t> data((n + 8 - 1) / 8, 0);
+    size_t set = 0;
+    for (size_t r = 0; r < runs && set < t; ++r) {
+        for (size_t i = order[r] * run_len; i < std::min(n, (order[r] + 1) * run_len) && set < t; ++i, ++set) {
+            data[i >> 3] |= (0x1 << (i & 0x7));
+        }
+    }
+    return data;
+}
@@ -11,13 +11,17 @@ include_directories(${double-conversion_INCLUDE_DIRS})
 set(DISKANN_SOURCES
     thirdparty/DiskANN/src/ann_exception.cpp
     thirdparty/DiskANN/src/aux_utils.cpp
+    thirdparty/DiskANN/src/coalescing_aligned_file_reader.cpp
     thirdparty/DiskANN/src/distance.cpp
     thirdparty/DiskANN/src/index.cpp
+    thirdparty/DiskANN/src/io_uring_aligned_file_reader.cpp
     thirdparty/DiskANN/src/linux_aligned_file_reader.cpp
     thirdparty/DiskANN/src/math_utils.cpp
     thirdparty/DiskANN/src/memory_mapper.cpp
     thirdparty/DiskANN/src/partition_and_pq.cpp
     thirdparty/DiskANN/src/pq_flash_index.cpp
+    thirdparty/DiskANN/src/sector_buffer_pool.cpp
+    thirdparty/DiskANN/src/striped_aligned_file_reader.cpp
     thirdparty/DiskANN/src/logger.cpp
     thirdparty/DiskANN/src/utils.cpp)
 
@@ -4,35 +4,59 @@ knowhere_file_glob(
   thirdparty/faiss/faiss/utils/*.cpp)
 
 knowhere_file_glob(GLOB FAISS_AVX512_SRCS
-                   thirdparty/faiss/faiss/impl/*avx512.cpp)
+                   thirdparty/faiss/faiss/impl/*avx512.cpp
+                   thirdparty/faiss/faiss/impl/*avx512_vnni.cpp)
 
 list(REMOVE_ITEM FAISS_SRCS ${FAISS_AVX512_SRCS})
 
+knowhere_file_glob(GLOB FAISS_AVX512_VNNI_SRCS
+                   thirdparty/faiss/faiss/impl/*avx512_vnni.cpp)
+
+set_source_files_properties(${FAISS_AVX512_VNNI_SRCS} PROPERTIES COMPILE_OPTIONS
+                                                                 -mavx512vnni)
+
 if(__X86_64)
   set(UTILS_SRC src/simd/distances_ref.cc src/simd/hook.cc)
   set(UTILS_SSE_SRC src/simd/distances_sse.cc)
   set(UTILS_AVX_SRC src/simd/distances_avx.cc)
   set(UTILS_AVX512_SRC src/simd/distances_avx512.cc)
+  set(UTILS_AVX512_VPOPCNT_SRC src/simd/distances_avx512_vpopcnt.cc)
+  set(UTILS_AMX_SRC src/simd/distances_amx.cc)
 
   add_library(utils_sse OBJECT ${UTILS_SSE_SRC})
   add_library(utils_avx OBJECT ${UTILS_AVX_SRC})
   add_library(utils_avx512 OBJECT ${UTILS_AVX512_SRC})
+  add_library(utils_avx512_vpopcnt OBJECT ${UTILS_AVX512_VPOPCNT_SRC})
+  add_library(utils_amx OBJECT ${UTILS_AMX_SRC})
 
   target_compile_options(utils_sse PRIVATE -msse4.2)
   target_compile_options(utils_avx PRIVATE -mf16c -mavx2)
   target_compile_options(utils_avx512 PRIVATE -mf16c -mavx512f -mavx512dq
                                               -mavx512bw)
+  target_compile_options(
+    utils_avx512_vpopcnt PRIVATE -mavx512f -mavx512dq -mavx512bw
+                                 -mavx512vpopcntdq)
+  target_compile_options(utils_amx PRIVATE -mavx512f -mavx512bw -mamx-tile
+                                           -mamx-bf16)
 
   add_library(
     knowhere_utils STATIC
     ${UTILS_SRC} $<TARGET_OBJECTS:utils_sse> $<TARGET_OBJECTS:utils_avx>
-    $<TARGET_OBJECTS:utils_avx512>)
+    $<TARGET_OBJECTS:utils_avx512> $<TARGET_OBJECTS:utils_avx512_vpopcnt>
+    $<TARGET_OBJECTS:utils_amx>)
   target_link_libraries(knowhere_utils PUBLIC glog::glog)
 endif()
 
 if(__AARCH64)
-  set(UTILS_SRC src/simd/hook.cc src/simd/distances_ref.cc)
-  add_library(knowhere_utils STATIC ${UTILS_SRC})
+  set(UTILS_SRC src/simd/hook.cc src/simd/distances_ref.cc
+                src/simd/distances_neon.cc)
+  set(UTILS_SVE_SRC src/simd/distances_sve.cc)
+
+  add_library(utils_sve OBJECT ${UTILS_SVE_SRC})
+  target_compile_options(utils_sve PRIVATE -march=armv8.2-a+sve)
+
+  add_library(knowhere_utils STATIC ${UTILS_SRC}
+                                    $<TARGET_OBJECTS:utils_sve>)
   target_link_libraries(knowhere_utils PUBLIC glog::glog)
 endif()
 
@@ -29,6 +29,7 @@ class KnowhereConan(ConanFile):
         "with_asan": [True, False],
         "with_diskann": [True, False],
         "with_profiler": [True, False],
+        "with_profile_zones": [True, False],
         "with_ut": [True, False],
         "with_benchmark": [True, False],
         "with_coverage": [True, False],
@@ -40,6 +41,7 @@ class KnowhereConan(ConanFile):
         "with_asan": False,
         "with_diskann": False,
         "with_profiler": False,
+        "with_profile_zones": True,
         "with_ut": False,
         "glog:with_gflags": True,
         "prometheus-cpp:with_pull": False,
@@ -96,6 +98,7 @@ class KnowhereConan(ConanFile):
         if self.options.with_benchmark:
             self.requires("gtest/1.13.0")
             self.requires("hdf5/1.14.0")
+            self.requires("benchmark/1.7.0")
 
     @property
     def _required_boost_components(self):
@@ -153,6 +156,7 @@ class KnowhereConan(ConanFile):
         tc.variables["WITH_DISKANN"] = self.options.with_diskann
         tc.variables["WITH_RAFT"] = self.options.with_raft
         tc.variables["WITH_PROFILER"] = self.options.with_profiler
+        tc.variables["WITH_PROFILE_ZONES"] = self.options.with_profile_zones
         tc.variables["WITH_UT"] = self.options.with_ut
         tc.variables["WITH_BENCHMARK"] = self.options.with_benchmark
         tc.variables["WITH_COVERAGE"] = self.options.with_coverage
@@ -18,6 +18,8 @@
 #include <string>
 #include <vector>
 
+#include "knowhere/expected.h"
+
 namespace knowhere {
 
 struct Binary {
@@ -94,6 +96,27 @@ class BinarySet {
 };
 
 using BinarySetPtr = std::shared_ptr<BinarySet>;
+
+/**
+ * @brief The sink of a streaming serialization, see IndexNode::SerializeToFile: the entries a BinarySet would hold,
+ * each written in pieces as it is serialized rather than built in memory first. The sections are written one after
+ * the other, Begin and End around the Writes of each.
+ */
+class SectionWriter {
+ public:
+    virtual ~SectionWriter() = default;
+
+    virtual Status
+    Begin(const std::string& name) = 0;
+
+    // appends size bytes to the section begun last
+    virtual Status
+    Write(const void* data, size_t size) = 0;
+
+    virtual Status
+    End() = 0;
+};
+
 }  // namespace knowhere
 
 #endif /* BINARYSET_H */
@@ -12,11 +12,25 @@
 #ifndef BITSET_H
 #define BITSET_H
 
+#include <algorithm>
 #include <cassert>
+#include <cstdint>
+#include <cstring>
 #include <sstream>
 #include <string>
+#include <vector>
+
+#if defined(__AVX512VPOPCNTDQ__)
+#include <immintrin.h>
+#endif
 
 namespace knowhere {
+/**
+ * @brief The filter of a search over num_bits ids, a set bit filters its id out. Besides the dense bits, a filter that
+ * keeps or drops only a few of the ids is a sorted array of those, see FromAliveIds and FromFilteredIds: the caller
+ * does not build the bits of the whole segment, the tests are binary searches and the scans jump from id to id. The
+ * indexes take either form through the same calls, only data() and byte_size() are for the dense one.
+ */
 class BitsetView {
  public:
     BitsetView() = default;
@@ -28,6 +42,35 @@ class BitsetView {
     BitsetView(const std::nullptr_t) : BitsetView() {
     }
 
+    // the filter that keeps only the n sorted ids, all below num_bits, and drops the others
+    static BitsetView
+    FromAliveIds(const uint32_t* ids, size_t n, size_t num_bits) {
+        return BitsetView(Form::ALIVE_IDS, ids, n, num_bits);
+    }
+
+    // the filter that drops only the n sorted ids, all below num_bits
+    static BitsetView
+    FromFilteredIds(const uint32_t* ids, size_t n, size_t num_bits) {
+        return BitsetView(Form::FILTERED_IDS, ids, n, num_bits);
+    }
+
+    bool
+    is_dense() const {
+        return form_ == Form::DENSE;
+    }
+
+    // the ids a FromAliveIds filter keeps, nullptr for the other forms; a brute force scan runs over them rather
+    // than over all the ids
+    const uint32_t*
+    alive_ids() const {
+        return form_ == Form::ALIVE_IDS ? ids_ : nullptr;
+    }
+
+    size_t
+    num_alive_ids() const {
+        return form_ == Form::ALIVE_IDS ? num_ids_ : 0;
+    }
+
     bool
     empty() const {
         return num_bits_ == 0;
@@ -50,11 +93,17 @@ class BitsetView {
 
     bool
     test(int64_t index) const {
+        if (form_ != Form::DENSE) {
+            return test_ids(index);
+        }
         return bits_[index >> 3] & (0x1 << (index & 0x7));
     }
 
     size_t
     count() const {
+        if (form_ != Form::DENSE) {
+            return form_ == Form::ALIVE_IDS ? num_bits_ - num_ids_ : num_ids_;
+        }
         size_t ret = 0;
         auto len_uint8 = byte_size();
         auto len_uint64 = len_uint8 >> 3;
@@ -66,11 +115,26 @@ class BitsetView {
             return x;
         };
 
-        uint64_t* p_uint64 = (uint64_t*)bits_;
-        for (size_t i = 0; i < len_uint64; i++) {
-            ret += __builtin_popcountll(*p_uint64);
-            p_uint64++;
+        size_t i = 0;
+#if defined(__AVX512VPOPCNTDQ__)
+        __m512i cnt = _mm512_setzero_si512();
+        for (; i + 8 <= len_uint64; i += 8) {
+            cnt = _mm512_add_epi64(cnt, _mm512_popcnt_epi64(_mm512_loadu_si512(bits_ + (i << 3))));
+        }
+        ret += _mm512_reduce_add_epi64(cnt);
+#endif
+        // four independent sums, a single one is bound by the latency of the adds
+        size_t cnt0 = 0, cnt1 = 0, cnt2 = 0, cnt3 = 0;
+        for (; i + 4 <= len_uint64; i += 4) {
+            cnt0 += __builtin_popcountll(word(i));
+            cnt1 += __builtin_popcountll(word(i + 1));
+            cnt2 += __builtin_popcountll(word(i + 2));
+            cnt3 += __builtin_popcountll(word(i + 3));
         }
+        for (; i < len_uint64; i++) {
+            cnt0 += __builtin_popcountll(word(i));
+        }
+        ret += cnt0 + cnt1 + cnt2 + cnt3;
 
         // calculate remainder
         uint8_t* p_uint8 = (uint8_t*)bits_ + (len_uint64 << 3);
@@ -82,6 +146,122 @@ class BitsetView {
         return ret;
     }
 
+    // the ids of [from, to) that are filtered out, a popcount of 64 bits at a time
+    size_t
+    count(size_t from, size_t to) const {
+        to = std::min(to, num_bits_);
+        if (from >= to) {
+            return 0;
+        }
+        if (form_ != Form::DENSE) {
+            size_t listed = std::lower_bound(ids_, ids_ + num_ids_, to) - std::lower_bound(ids_, ids_ + num_ids_, from);
+            return form_ == Form::FILTERED_IDS ? listed : to - from - listed;
+        }
+        size_t ret = 0;
+        for (; from + 64 <= to; from += 64) {
+            ret += __builtin_popcountll(block(from, 64));
+        }
+        return ret + __builtin_popcountll(block(from, to - from));
+    }
+
+    // the bits of [from, from + n), n <= 64, as a mask with bit b for from + b; the ids past size() are not
+    // filtered, so the scans test whole blocks with one load and skip the blocks that are all filtered
+    uint64_t
+    block(size_t from, size_t n) const {
+        assert(n <= 64);
+        if (from >= num_bits_ || n == 0) {
+            return 0;
+        }
+        size_t valid = std::min(n, num_bits_ - from);
+        uint64_t valid_mask = valid == 64 ? ~uint64_t(0) : (uint64_t(1) << valid) - 1;
+        if (form_ != Form::DENSE) {
+            uint64_t listed = 0;
+            for (auto it = std::lower_bound(ids_, ids_ + num_ids_, from); it != ids_ + num_ids_ && *it < from + n;
+                 ++it) {
+                listed |= uint64_t(1) << (*it - from);
+            }
+            return (form_ == Form::FILTERED_IDS ? listed : ~listed) & valid_mask;
+        }
+        size_t first = from >> 3, shift = from & 0x7;
+        // the bits sit in at most 9 bytes, do not read past the end of the bitset
+        uint8_t buf[16] = {};
+        std::memcpy(buf, bits_ + first, std::min<size_t>(byte_size() - first, (shift + n + 7) >> 3));
+        uint64_t lo, hi;
+        std::memcpy(&lo, buf, sizeof(lo));
+        std::memcpy(&hi, buf + 8, sizeof(hi));
+        uint64_t mask = shift == 0 ? lo : (lo >> shift) | (hi << (64 - shift));
+        return mask & valid_mask;
+    }
+
+    // true if some id of [from, to) is not filtered out, false lets a scan skip the range
+    bool
+    any_unset_in(size_t from, size_t to) const {
+        if (form_ != Form::DENSE) {
+            return next_unset(from) < to;
+        }
+        for (; from < to; from += 64) {
+            size_t n = std::min<size_t>(64, to - from);
+            uint64_t full = n == 64 ? ~uint64_t(0) : (uint64_t(1) << n) - 1;
+            if (block(from, n) != full) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // the first id >= from that is not filtered out, from itself past size()
+    size_t
+    next_unset(size_t from) const {
+        if (form_ == Form::ALIVE_IDS) {
+            auto it = std::lower_bound(ids_, ids_ + num_ids_, from);
+            return it != ids_ + num_ids_ ? *it : std::max(from, num_bits_);
+        }
+        if (form_ == Form::FILTERED_IDS) {
+            return next_unlisted(from);
+        }
+        for (; from < num_bits_; from += 64) {
+            uint64_t unset = ~block(from, 64);
+            if (unset != 0) {
+                return from + __builtin_ctzll(unset);
+            }
+        }
+        return from;
+    }
+
+    // the first id >= from that is filtered out, size() if there is none
+    size_t
+    next_set(size_t from) const {
+        if (form_ == Form::FILTERED_IDS) {
+            auto it = std::lower_bound(ids_, ids_ + num_ids_, from);
+            return it != ids_ + num_ids_ ? *it : num_bits_;
+        }
+        if (form_ == Form::ALIVE_IDS) {
+            return std::min(next_unlisted(from), num_bits_);
+        }
+        for (; from < num_bits_; from += 64) {
+            uint64_t set = block(from, 64);
+            if (set != 0) {
+                return from + __builtin_ctzll(set);
+            }
+        }
+        return num_bits_;
+    }
+
+    // the filter as dense bits for the code that reads them as such, itself when it is dense, else written into buf
+    BitsetView
+    to_dense(std::vector<uint8_t>& buf) const {
+        if (form_ == Form::DENSE) {
+            return *this;
+        }
+        buf.assign(byte_size(), 0);
+        for (size_t i = 0; i < num_bits_; i += 64) {
+            size_t n = std::min<size_t>(64, num_bits_ - i);
+            uint64_t bits = block(i, n);
+            std::memcpy(buf.data() + (i >> 3), &bits, (n + 7) >> 3);
+        }
+        return BitsetView(buf.data(), num_bits_);
+    }
+
     std::string
     to_string(size_t from, size_t to) const {
         if (empty()) {
@@ -96,8 +276,47 @@ class BitsetView {
     }
 
  private:
+    enum class Form : uint8_t {
+        DENSE,
+        ALIVE_IDS,
+        FILTERED_IDS,
+    };
+
+    BitsetView(Form form, const uint32_t* ids, size_t n, size_t num_bits)
+        : num_bits_(num_bits), form_(form), ids_(ids), num_ids_(n) {
+    }
+
+    // the ids past size() are not filtered, as with the bits
+    bool
+    test_ids(int64_t index) const {
+        if (static_cast<size_t>(index) >= num_bits_) {
+            return false;
+        }
+        bool listed = std::binary_search(ids_, ids_ + num_ids_, static_cast<uint32_t>(index));
+        return form_ == Form::FILTERED_IDS ? listed : !listed;
+    }
+
+    // the first id >= from that is not in ids_
+    size_t
+    next_unlisted(size_t from) const {
+        for (auto it = std::lower_bound(ids_, ids_ + num_ids_, from); it != ids_ + num_ids_ && *it == from; ++it) {
+            ++from;
+        }
+        return from;
+    }
+
+    uint64_t
+    word(size_t i) const {
+        uint64_t w;
+        std::memcpy(&w, bits_ + (i << 3), sizeof(w));
+        return w;
+    }
+
     const uint8_t* bits_ = nullptr;
     size_t num_bits_ = 0;
+    Form form_ = Form::DENSE;
+    const uint32_t* ids_ = nullptr;
+    size_t num_ids_ = 0;
 };
 }  // namespace knowhere
 
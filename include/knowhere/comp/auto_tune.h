@@ -0,0 +1,37 @@
+// Copyright (C) 2019-2023 Zilliz. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file except in compliance
+// with the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
+// or implied. See the License for the specific language governing permissions and limitations under the License.
+
+#ifndef AUTO_TUNE_H
+#define AUTO_TUNE_H
+
+#include <vector>
+
+#include "knowhere/dataset.h"
+#include "knowhere/index.h"
+
+namespace knowhere {
+
+class AutoTune {
+ public:
+    // The table of search params by recall of the index for Index::SetTunedParams, one entry per target recall. The
+    // param that trades the cost of a search of its type for its recall, ef of HNSW, nprobe of IVF and ScaNN and
+    // search_list_size of DiskANN, is binary searched for the smallest value whose recall on the sample queries, of
+    // the k of json against a brute force search of the base rows the index holds, reaches the target; the recall of
+    // the entry is the one measured, short of the target only when the largest value is. json holds the other params
+    // of the searches. Fails with not_implemented for an index type without such a param.
+    static expected<Json>
+    Tune(const Index<IndexNode>& index, const DataSetPtr base, const DataSetPtr queries, const Json& json,
+         const std::vector<float>& target_recalls);
+};
+
+}  // namespace knowhere
+
+#endif /* AUTO_TUNE_H */
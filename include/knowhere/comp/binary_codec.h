@@ -0,0 +1,63 @@
+// Copyright (C) 2019-2023 Zilliz. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file except in compliance
+// with the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
+// or implied. See the License for the specific language governing permissions and limitations under the License.
+
+#ifndef BINARY_CODEC_H
+#define BINARY_CODEC_H
+
+#include <set>
+#include <string>
+
+#include "knowhere/binaryset.h"
+#include "knowhere/expected.h"
+
+namespace knowhere {
+
+enum class BinaryCodec {
+    LZ4 = 1,   // fast, for links where the payload is not the bottleneck
+    ZSTD = 2,  // about twice the ratio of LZ4 at a fraction of its speed
+};
+
+/**
+ * @brief Compression of the sections of a BinarySet for transfer. A compressed section is a header followed by
+ * blocks of kBlockSize bytes compressed independently, so both sides run the blocks on the build pool.
+ * Index::Deserialize decompresses such sections on its own, a compressed BinarySet loads as the raw one does.
+ */
+class BinarySetCodec {
+ public:
+    constexpr static size_t kBlockSize = 4 << 20;
+
+    /**
+     * @brief Compresses the sections of binset in place. A section stays raw when it is small, when it compresses
+     * by less than kMinSaving, or when it is named in raw_sections, which is for the sections a loader maps rather
+     * than copies.
+     *
+     * @param level the level of the codec, 0 for its default
+     */
+    static Status
+    Compress(BinarySet& binset, BinaryCodec codec, int level = 0, const std::set<std::string>& raw_sections = {});
+
+    // Replaces the compressed sections of binset by their raw bytes, the others are kept as they are.
+    static Status
+    Decompress(BinarySet& binset);
+
+    static bool
+    IsCompressed(const Binary& binary);
+
+    static bool
+    HasCompressed(const BinarySet& binset);
+
+    // a section must save at least this share of its size to be kept compressed
+    constexpr static double kMinSaving = 0.1;
+};
+
+}  // namespace knowhere
+
+#endif /* BINARY_CODEC_H */
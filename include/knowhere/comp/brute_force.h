@@ -11,17 +11,35 @@
 
 #ifndef BRUTE_FORCE_H
 #define BRUTE_FORCE_H
+#include <vector>
+
 #include "knowhere/bitsetview.h"
 #include "knowhere/dataset.h"
 #include "knowhere/factory.h"
 
 namespace knowhere {
 
+// A run of base rows laid out like the tensor of a base dataset, e.g. one fixed-size chunk of a growing segment.
+struct BaseChunk {
+    const void* data = nullptr;
+    int64_t rows = 0;
+    // id of the first row, the ids of the results and the bits of the bitset are the ones of the rows past it
+    int64_t id_offset = 0;
+    // L2 norms of the float rows for COSINE, computed by the search when null
+    const float* norms = nullptr;
+};
+
 class BruteForce {
  public:
     static expected<DataSetPtr>
     Search(const DataSetPtr base_dataset, const DataSetPtr query_dataset, const Json& config, const BitsetView& bitset);
 
+    // Searches the rows of all the chunks as one base dataset of dim of query_dataset, without copying them together:
+    // the top k of every query is kept across the chunks. Supports the L2, IP, COSINE, JACCARD and HAMMING metrics.
+    static expected<DataSetPtr>
+    Search(const std::vector<BaseChunk>& base_chunks, const DataSetPtr query_dataset, const Json& config,
+           const BitsetView& bitset);
+
     static Status
     SearchWithBuf(const DataSetPtr base_dataset, const DataSetPtr query_dataset, int64_t* ids, float* dis,
                   const Json& config, const BitsetView& bitset);
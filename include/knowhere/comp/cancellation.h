@@ -0,0 +1,122 @@
+// Copyright (C) 2019-2023 Zilliz. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file except in compliance
+// with the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
+// or implied. See the License for the specific language governing permissions and limitations under the License
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <memory>
+
+namespace knowhere {
+
+/**
+ * @brief Stops a request from the outside, by Cancel() or once its deadline passes. The search loops poll it
+ * cooperatively, a cancelled search drops the queries not started yet and cuts the running ones short.
+ *
+ * The loops of the index libraries do not take it as a parameter, they poll the token of their thread, which the
+ * index installs with a Scope around the work of each query.
+ */
+class CancellationToken {
+ public:
+    using Clock = std::chrono::steady_clock;
+
+    CancellationToken() = default;
+
+    // cancelled with the parent too
+    explicit CancellationToken(std::shared_ptr<const CancellationToken> parent) : parent_(std::move(parent)) {
+    }
+
+    CancellationToken(const CancellationToken&) = delete;
+
+    CancellationToken&
+    operator=(const CancellationToken&) = delete;
+
+    static std::shared_ptr<CancellationToken>
+    WithTimeout(std::chrono::microseconds timeout) {
+        auto token = std::make_shared<CancellationToken>();
+        token->SetDeadline(Clock::now() + timeout);
+        return token;
+    }
+
+    void
+    Cancel() {
+        cancelled_.store(true, std::memory_order_relaxed);
+    }
+
+    // only ever moves the deadline earlier
+    void
+    SetDeadline(Clock::time_point deadline) {
+        int64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline.time_since_epoch()).count();
+        int64_t current = deadline_ns_.load(std::memory_order_relaxed);
+        while (ns < current && !deadline_ns_.compare_exchange_weak(current, ns, std::memory_order_relaxed)) {
+        }
+    }
+
+    bool
+    IsCancelled() const {
+        if (cancelled_.load(std::memory_order_relaxed)) {
+            return true;
+        }
+        int64_t deadline = deadline_ns_.load(std::memory_order_relaxed);
+        if (deadline != kNoDeadline &&
+            std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count() >= deadline) {
+            // the later polls skip the clock
+            cancelled_.store(true, std::memory_order_relaxed);
+            return true;
+        }
+        return parent_ != nullptr && parent_->IsCancelled();
+    }
+
+    // the token of the calling thread, nullptr outside of a Scope
+    static const CancellationToken*
+    Current() {
+        return current_;
+    }
+
+    // whether the token of the calling thread is cancelled, false without one
+    static bool
+    CurrentCancelled() {
+        auto token = current_;
+        return token != nullptr && token->IsCancelled();
+    }
+
+    // installs a token as the one of the calling thread for the scope, a null token leaves the thread without one
+    class Scope {
+     public:
+        explicit Scope(const CancellationToken* token) : previous_(current_) {
+            current_ = token;
+        }
+
+        ~Scope() {
+            current_ = previous_;
+        }
+
+        Scope(const Scope&) = delete;
+
+        Scope&
+        operator=(const Scope&) = delete;
+
+     private:
+        const CancellationToken* previous_;
+    };
+
+ private:
+    constexpr static int64_t kNoDeadline = std::numeric_limits<int64_t>::max();
+
+    mutable std::atomic<bool> cancelled_{false};
+    std::atomic<int64_t> deadline_ns_{kNoDeadline};
+    std::shared_ptr<const CancellationToken> parent_;
+    inline static thread_local const CancellationToken* current_ = nullptr;
+};
+
+}  // namespace knowhere
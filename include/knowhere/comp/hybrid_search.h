@@ -0,0 +1,48 @@
+// Copyright (C) 2019-2023 Zilliz. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file except in compliance
+// with the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
+// or implied. See the License for the specific language governing permissions and limitations under the License.
+
+#ifndef HYBRID_SEARCH_H
+#define HYBRID_SEARCH_H
+
+#include <memory>
+
+#include "knowhere/bitsetview.h"
+#include "knowhere/comp/cancellation.h"
+#include "knowhere/dataset.h"
+#include "knowhere/index.h"
+
+namespace knowhere {
+
+// One side of a hybrid search: an index of the segment, the queries of its kind and its search config.
+struct HybridSide {
+    Index<IndexNode> index;
+    const DataSet* queries = nullptr;
+    Json json;
+};
+
+class HybridSearch {
+ public:
+    /**
+     * Searches the dense and the sparse index of one segment, whose rows share their ids, for the same nq queries, the
+     * two sides running as tasks of the global search pool, and fuses the k results of each side into one top k per
+     * query, of which the distances are the fused scores, the larger the better. json holds k and the fusion:
+     * hybrid_fusion RRF adds up weight / (rrf_k + rank) of the sides a result is found by, WEIGHTED the weighted scores
+     * of those sides, each squashed into [0, 1] by its metric first. Each side is searched with the k of json, so the
+     * caller no longer over-fetches from either; the first failing side fails the search.
+     */
+    static expected<DataSetPtr>
+    Search(const HybridSide& dense, const HybridSide& sparse, const Json& json, const BitsetView& bitset = nullptr,
+           std::shared_ptr<CancellationToken> cancellation = nullptr);
+};
+
+}  // namespace knowhere
+
+#endif /* HYBRID_SEARCH_H */
@@ -0,0 +1,132 @@
+// Copyright (C) 2019-2023 Zilliz. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file except in compliance
+// with the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
+// or implied. See the License for the specific language governing permissions and limitations under the License.
+
+#ifndef INDEX_MANAGER_H
+#define INDEX_MANAGER_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "knowhere/expected.h"
+#include "knowhere/index.h"
+
+namespace knowhere {
+
+/**
+ * @brief Keeps the heap memory of many segments, each an index in a knowhere index file, within a budget. A segment
+ * is loaded whole by its first Acquire; once the heap bytes of the loaded segments, by their GetMemoryUsage, are past
+ * the budget, the ones acquired least recently are demoted to the index mapped from its file, see enable_mmap, and
+ * evicted when mapped already or when mapping does not spare heap. A mapped segment is searched as it is and loaded
+ * whole again once that fits the budget. A segment registered built is written to its file on its first demotion.
+ *
+ * An acquired index stays valid however long the caller holds it: eviction only drops the reference of the manager,
+ * so the memory of a segment evicted while searched is freed, and no longer counted, once its searches release it.
+ * The methods may be called from any thread; the loads run outside of the lock of the manager, one at a time per
+ * segment.
+ */
+class IndexManager {
+ public:
+    enum Residency {
+        kEvicted = 0,
+        kMapped,
+        kLoaded,
+    };
+
+    struct Stats {
+        int64_t budget = 0;
+        // the heap bytes of the mapped and loaded segments, the ones the budget holds
+        int64_t heap_bytes = 0;
+        int64_t mmap_bytes = 0;
+        size_t loaded = 0;
+        size_t mapped = 0;
+        size_t evicted = 0;
+        uint64_t loads = 0;
+        uint64_t demotions = 0;
+        uint64_t evictions = 0;
+    };
+
+    explicit IndexManager(int64_t budget);
+
+    ~IndexManager();
+
+    // A segment in the index file filename, of index type index_type, loaded with json; it is not loaded until it is
+    // acquired. Fails with invalid_args for a name registered already.
+    Status
+    Register(const std::string& name, const std::string& index_type, const std::string& filename, const Json& json);
+
+    // A segment built already, counted against the budget from now on; filename is where it goes once demoted.
+    Status
+    Register(const std::string& name, const Index<IndexNode>& index, const std::string& filename, const Json& json);
+
+    Status
+    Unregister(const std::string& name);
+
+    // The index of the segment, loaded if it is not; the segments acquired least recently make room for it.
+    expected<Index<IndexNode>>
+    Acquire(const std::string& name);
+
+    // Loads the segments predicted to be queried next on the build pool, as far as they fit in the free budget: a
+    // prefetch evicts no segment, so it can not push out the ones in use. Segments loaded, being prefetched or unknown
+    // are skipped; a future is returned for each of the others, which the caller need not wait for.
+    std::vector<folly::Future<folly::Unit>>
+    Prefetch(const std::vector<std::string>& names);
+
+    Residency
+    GetResidency(const std::string& name) const;
+
+    // Demotes and evicts segments until the loaded ones fit in budget.
+    void
+    SetBudget(int64_t budget);
+
+    Stats
+    GetStats() const;
+
+ private:
+    struct Segment;
+
+    expected<Index<IndexNode>>
+    Load(const std::shared_ptr<Segment>& segment, bool make_room);
+
+    // the segment, nullptr for an unknown name
+    std::shared_ptr<Segment>
+    Find(const std::string& name) const;
+
+    // sets the index of the segment and counts its heap bytes in place of the ones of the index before
+    void
+    Account(Segment& segment, const Index<IndexNode>& index, Residency residency);
+
+    // demotes the segments acquired least recently, but keep, until the loaded ones fit in the budget
+    void
+    Fit(const Segment* keep);
+
+    // maps or evicts the segment, the caller holds its load lock; false when it can not be written to its file
+    bool
+    Demote(const std::shared_ptr<Segment>& segment);
+
+    mutable std::mutex mtx_;
+    std::unordered_map<std::string, std::shared_ptr<Segment>> segments_;
+    int64_t budget_;
+    int64_t heap_bytes_ = 0;
+    uint64_t tick_ = 0;
+    Stats counters_;
+    // the prefetches running, the destructor waits for them
+    int64_t prefetching_ = 0;
+    std::condition_variable prefetch_cv_;
+};
+
+}  // namespace knowhere
+
+#endif /* INDEX_MANAGER_H */
@@ -23,13 +23,19 @@ constexpr const char* INVALID = "";
 
 constexpr const char* INDEX_FAISS_BIN_IDMAP = "BIN_FLAT";
 constexpr const char* INDEX_FAISS_BIN_IVFFLAT = "BIN_IVF_FLAT";
+constexpr const char* INDEX_FAISS_BIN_MIH = "BIN_MIH";
 
 constexpr const char* INDEX_FAISS_IDMAP = "FLAT";
 constexpr const char* INDEX_FAISS_IVFFLAT = "IVF_FLAT";
 constexpr const char* INDEX_FAISS_IVFFLAT_CC = "IVF_FLAT_CC";
 constexpr const char* INDEX_FAISS_IVFPQ = "IVF_PQ";
+constexpr const char* INDEX_FAISS_IVFPQ_FASTSCAN = "IVF_PQ_FASTSCAN";
 constexpr const char* INDEX_FAISS_SCANN = "SCANN";
 constexpr const char* INDEX_FAISS_IVFSQ8 = "IVF_SQ8";
+constexpr const char* INDEX_FAISS_IVFSQ4 = "IVF_SQ4";
+constexpr const char* INDEX_FAISS_IVFSQ6 = "IVF_SQ6";
+constexpr const char* INDEX_FAISS_IVFSQ_FP16 = "IVF_SQ_FP16";
+constexpr const char* INDEX_FAISS_IVFRABITQ = "IVF_RABITQ";
 
 constexpr const char* INDEX_FAISS_GPU_IDMAP = "GPU_FAISS_FLAT";
 constexpr const char* INDEX_FAISS_GPU_IVFFLAT = "GPU_FAISS_IVF_FLAT";
@@ -39,10 +45,17 @@ constexpr const char* INDEX_FAISS_GPU_IVFSQ8 = "GPU_FAISS_IVF_SQ8";
 constexpr const char* INDEX_RAFT_IVFFLAT = "GPU_RAFT_IVF_FLAT";
 constexpr const char* INDEX_RAFT_IVFPQ = "GPU_RAFT_IVF_PQ";
 constexpr const char* INDEX_RAFT_CAGRA = "GPU_RAFT_CAGRA";
+constexpr const char* INDEX_RAFT_BRUTE_FORCE = "GPU_RAFT_BRUTE_FORCE";
 
 constexpr const char* INDEX_HNSW = "HNSW";
+constexpr const char* INDEX_HNSW_SQ8 = "HNSW_SQ8";
+constexpr const char* INDEX_HNSW_PQ = "HNSW_PQ";
+constexpr const char* INDEX_HNSW_PRQ = "HNSW_PRQ";
 constexpr const char* INDEX_DISKANN = "DISKANN";
 
+constexpr const char* INDEX_SPARSE_INVERTED_INDEX = "SPARSE_INVERTED_INDEX";
+constexpr const char* INDEX_SPARSE_WAND = "SPARSE_WAND";
+
 }  // namespace IndexEnum
 
 namespace meta {
@@ -57,29 +70,132 @@ constexpr const char* LIMS = "lims";
 constexpr const char* TOPK = "k";
 constexpr const char* RADIUS = "radius";
 constexpr const char* RANGE_FILTER = "range_filter";
+constexpr const char* MAX_RESULTS = "max_results";  // range search: keep the closest N hits of a query, 0 for all
 constexpr const char* INPUT_IDS = "input_ids";
 constexpr const char* OUTPUT_TENSOR = "output_tensor";
 constexpr const char* DEVICE_ID = "gpu_id";
 constexpr const char* NUM_BUILD_THREAD = "num_build_thread";
 constexpr const char* TRACE_VISIT = "trace_visit";
+constexpr const char* TRACE_SAMPLE_RATE = "trace_sample_rate";
+constexpr const char* SEARCH_TIMEOUT_MS = "search_timeout_ms";
+constexpr const char* MAX_THREADS = "max_threads";  // search: the threads of the call at once, 0 for the whole pool
+constexpr const char* ENABLE_MMAP = "enable_mmap";
+constexpr const char* MMAP_POPULATE = "mmap_populate";      // index file loads: fault the whole mapping in up front
+constexpr const char* MMAP_ADVICE = "mmap_advice";          // index file loads: NORMAL/RANDOM/SEQUENTIAL/WILLNEED
+constexpr const char* VERIFY_CHECKSUM = "verify_checksum";  // index file loads: check the section checksums
 constexpr const char* JSON_INFO = "json_info";
 constexpr const char* JSON_ID_SET = "json_id_set";
+constexpr const char* NORMS = "norms";
+constexpr const char* PARTIAL_QUERIES = "partial_queries";
+constexpr const char* TARGET_RECALL = "target_recall";  // search: the params of the tuned table, see AutoTune
 };  // namespace meta
 
 namespace indexparam {
 // IVF Params
 constexpr const char* NPROBE = "nprobe";
+constexpr const char* RANGE_NPROBE = "range_nprobe";
 constexpr const char* NLIST = "nlist";
 constexpr const char* NBITS = "nbits";  // PQ/SQ
 constexpr const char* M = "m";          // PQ param for IVFPQ
 constexpr const char* SSIZE = "ssize";
+constexpr const char* BBS = "bbs";  // block size of IVF_PQ_FASTSCAN
+constexpr const char* PRECOMPUTE_TABLE = "precompute_table";  // IVF_PQ keeps its L2 residual tables in memory
+constexpr const char* POLYSEMOUS = "polysemous";              // IVF_PQ orders its PQ centroids for Hamming
+constexpr const char* POLYSEMOUS_HT = "polysemous_ht";        // IVF_PQ skips codes at this Hamming distance
 constexpr const char* REORDER_K = "reorder_k";
+// refine vectors, ScaNN: FLAT/SQ8/FP16, IVF_RABITQ: NONE/FLAT/SQ8/FP16, HNSW_*: NONE/FP16/FP32
+constexpr const char* REFINE_TYPE = "refine_type";
+constexpr const char* REORDER_SPREAD = "reorder_spread";
+constexpr const char* ANISOTROPIC_THRESHOLD = "anisotropic_threshold";
+constexpr const char* BATCH_SEARCH_NQ = "batch_search_nq";
+constexpr const char* COLUMN_BLOCKED = "column_blocked";  // IVF_FLAT lists in blocks of 16 interleaved vectors
+constexpr const char* INVLISTS_ARENA = "invlists_arena";
+constexpr const char* HUGE_PAGES = "huge_pages";
+constexpr const char* MAX_POINTS_PER_CENTROID = "max_points_per_centroid";
+constexpr const char* CENTROIDS_FILE = "centroids_file";
+constexpr const char* QUANTIZER_TYPE = "quantizer_type";  // IVF coarse quantizer over the centroids: FLAT/HNSW
+constexpr const char* QUANTIZER_M = "quantizer_m";
+constexpr const char* QUANTIZER_EF_CONSTRUCTION = "quantizer_ef_construction";
+constexpr const char* QUANTIZER_EF = "quantizer_ef";
+constexpr const char* LIST_PRUNING = "list_pruning";
+constexpr const char* LIST_SPLIT_RATIO = "list_split_ratio";
+constexpr const char* LIST_STATS = "list_stats";  // GetIndexMeta of IVF returns the list statistics
+constexpr const char* FILTER_PROBE_THRESHOLD = "filter_probe_threshold";
+constexpr const char* PROBE_RATIO = "probe_ratio";  // IVF knn: probe the lists within this ratio of the nearest
+
+// Pre-transform Params, of HNSW, IVF_FLAT, IVF_SQ8 and IVF_PQ
+constexpr const char* PRE_TRANSFORM = "pre_transform";  // NONE/PCA/RR/OPQ
+constexpr const char* PRE_TRANSFORM_DIM = "pre_transform_dim";
+constexpr const char* PRE_TRANSFORM_M = "pre_transform_m";
+
+// Rerank Params, of IVF_SQ8 and IVF_PQ
+constexpr const char* RERANK_STORE = "rerank_store";  // NONE/FP32/FP16
+constexpr const char* RERANK_RATIO = "rerank_ratio";
+
+// Multi-vector Search Params
+constexpr const char* MULTI_VECTOR_K = "multi_vector_k";
+constexpr const char* MULTI_VECTOR_AGG = "multi_vector_agg";  // MAXSIM/SUM
+
+// Grouped Search Params
+constexpr const char* GROUP_SIZE = "group_size";
+
+// Hybrid Search Params, see HybridSearch
+constexpr const char* HYBRID_FUSION = "hybrid_fusion";  // RRF/WEIGHTED
+constexpr const char* RRF_K = "rrf_k";
+constexpr const char* DENSE_WEIGHT = "dense_weight";
+constexpr const char* SPARSE_WEIGHT = "sparse_weight";
+
+// kNN Graph Params, of HNSW and DiskANN
+constexpr const char* KNN_GRAPH = "knn_graph";  // build the graph from a kNN graph of: NONE/NN_DESCENT/CAGRA
+
+// FLAT Params
+constexpr const char* STORAGE_TYPE = "storage_type";  // FLAT vectors: FP32/FP16/BF16
 
 // HNSW Params
 constexpr const char* EFCONSTRUCTION = "efConstruction";
 constexpr const char* HNSW_M = "M";
 constexpr const char* EF = "ef";
 constexpr const char* OVERVIEW_LEVELS = "overview_levels";
+constexpr const char* SQ_TYPE = "sq_type";  // level 0 storage: NONE/SQ8/FP16
+constexpr const char* REFINE = "refine";    // keep raw vectors to re-rank quantized results
+constexpr const char* REFINE_K = "refine_k";  // HNSW_SQ8/PQ/PRQ, IVF_RABITQ re-rank refine_k * k candidates
+constexpr const char* ALIGN_LEVEL0 = "align_level0";
+constexpr const char* PREFETCH_DEPTH = "prefetch_depth";
+constexpr const char* EARLY_STOP_PATIENCE = "early_stop_patience";
+constexpr const char* FILTER_THRESHOLD = "filter_threshold";
+constexpr const char* RANGE_INIT_EF = "range_init_ef";
+constexpr const char* ENTRY_HUBS = "entry_hubs";
+constexpr const char* REORDER = "reorder";  // graph reordering: NONE/BFS/RCM/GORDER
+constexpr const char* COMPRESS_LINKS = "compress_links";
+
+// BIN_MIH Params
+constexpr const char* HASH_BITS = "hash_bits";    // bits of a hash table key
+constexpr const char* NHASH = "nhash";            // hash tables, 0 for dim / hash_bits
+constexpr const char* HASH_FLIPS = "hash_flips";  // key bits a knn search flips
+
+// DiskANN Params
+constexpr const char* SEARCH_LIST_SIZE = "search_list_size";
+
+// CAGRA Params
+constexpr const char* INTERMEDIATE_GRAPH_DEGREE = "intermediate_graph_degree";
+constexpr const char* GRAPH_DEGREE = "graph_degree";
+constexpr const char* ITOPK_SIZE = "itopk_size";
+constexpr const char* ADAPT_FOR_CPU = "adapt_for_cpu";  // also serialize as the CPU index: HNSW, IVF_FLAT/PQ/SQ8
+
+// Sparse Params
+constexpr const char* DROP_RATIO_BUILD = "drop_ratio_build";
+constexpr const char* DROP_RATIO_SEARCH = "drop_ratio_search";
+
+// GPU Params
+constexpr const char* GPU_ID = "gpu_id";
+constexpr const char* GPU_IDS = "gpu_ids";
+constexpr const char* MULTI_GPU_MODE = "multi_gpu_mode";      // over several gpu_ids: replicated/sharded
+constexpr const char* FILTER_VERSION = "filter_version";      // of the bitset, see BaseConfig::filter_version
+constexpr const char* HOST_REFINE = "host_refine";            // RAFT IVF-PQ keeps the raw vectors in host memory
+constexpr const char* REFINE_RATIO = "refine_ratio";          // candidates per result reranked on the host
+constexpr const char* BUILD_CHUNK_ROWS = "build_chunk_rows";  // rows of the data a GPU build uploads at a time
+constexpr const char* DEVICE_RESIDENT = "device_resident";    // RAFT brute force keeps the vectors on the GPU
+constexpr const char* SEARCH_TILE_ROWS = "search_tile_rows";  // rows a GPU search streams or gathers at a time
 }  // namespace indexparam
 
 using MetricType = std::string;
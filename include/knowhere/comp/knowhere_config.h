@@ -15,6 +15,8 @@
 #include <string>
 #include <vector>
 
+#include "knowhere/comp/payload_allocator.h"
+
 #ifdef KNOWHERE_WITH_DISKANN
 #include "diskann/aio_context_pool.h"
 #endif
@@ -30,16 +32,32 @@ class KnowhereConfig {
      * set SIMD type
      */
     enum SimdType {
-        AUTO = 0,  // enable all and depend on the system
-        AVX512,    // only enable AVX512
-        AVX2,      // only enable AVX2
-        SSE4_2,    // only enable SSE4_2
-        GENERIC,   // use arithmetic instead of SIMD
+        AUTO = 0,    // enable all and depend on the system
+        AVX512,      // only enable AVX512
+        AVX2,        // only enable AVX2
+        SSE4_2,      // only enable SSE4_2
+        GENERIC,     // use arithmetic instead of SIMD
+        AUTO_TUNED,  // AUTO, then time the variants of each kernel at startup and bind the fastest
+        AMX,         // AUTO, and the batched brute force and k-means blocks multiplied in AMX bf16 tiles when supported
     };
 
     static std::string
     SetSimdType(const SimdType simd_type);
 
+    /**
+     * the variant bound to each kernel after SetSimdType(AUTO_TUNED), "kernel=variant" comma separated, else the
+     * simd type
+     */
+    static std::string
+    GetSimdKernelVariants();
+
+    /**
+     * whether the IVF_SQ8 inner product searches quantize the query to int8 and score the codes with integer dot
+     * products on AVX2 and AVX512, on by default; off scores them with the float kernels
+     */
+    static void
+    SetSqInt8Query(const bool enable);
+
     /**
      * Set openblas threshold
      *   if nq < use_blas_threshold, calculated by omp
@@ -69,11 +87,15 @@ class KnowhereConfig {
     enum ClusteringType {
         K_MEANS = 0,        // k-means (default)
         K_MEANS_PLUS_PLUS,  // k-means++
+        K_MEANS_PARALLEL,   // k-means||, the seeds of k-means++ in a few parallel passes, for large k and nb
     };
 
     static void
     SetClusteringType(const ClusteringType clustering_type);
 
+    static ClusteringType
+    GetClusteringType();
+
     /**
      * The numebr of maximum parallel disk reads per thread.
      * On Linux, the default limit of `aio-max-nr` is 65536, so the product of `num_threads` and `max_events` (default
@@ -85,10 +107,32 @@ class KnowhereConfig {
     SetAioContextPool(size_t num_ctx);
 
     /**
-     * init GPU Resource
+     * Read the DiskANN indexes loaded from now on through io_uring instead of libaio, the libaio contexts and their
+     * `fs.aio-max-nr` limit are then not used at all. Each search reads through a ring of `queue_depth` entries, at
+     * most 64, into buffers registered with the ring, registering pins them against RLIMIT_MEMLOCK and falls back to
+     * plain reads when the limit is hit. With `sqpoll` a kernel thread shared by the rings of an index polls their
+     * submission queues, saving the submission syscalls at the cost of a core spinning while searches run. This
+     * function returns false, keeping libaio, if the kernel does not provide io_uring or `queue_depth` is invalid.
+     */
+    static bool
+    SetIoUringReader(size_t queue_depth, bool sqpoll);
+
+    /**
+     * The searches of all the DiskANN indexes of the process borrow their sector buffers from one pool, which grows to
+     * what the concurrent searches need and gives back the buffers idle past the recent peak. Searches wait for a
+     * buffer once the pool holds `max_size` bytes, except when no other buffer is borrowed. Use 0, the default, for no
+     * limit.
      */
     static void
-    InitGPUResource(int64_t gpu_id, int64_t res_num = 2);
+    SetDiskANNSectorBufferPool(size_t max_size);
+
+    /**
+     * init the GPU resources of a device, once for every device the GPU indexes run on, see the gpu_id and gpu_ids
+     * params; the first device is the one of the indexes that name none. Each of the `res_num` resources runs up to
+     * `streams_per_res` searches at once, each on a stream with temporary and pinned memory of its own
+     */
+    static void
+    InitGPUResource(int64_t gpu_id, int64_t res_num = 2, int64_t streams_per_res = 4);
 
     /**
      * free GPU Resource
@@ -101,6 +145,47 @@ class KnowhereConfig {
     */
     static void
     SetRaftMemPool(size_t init_size, size_t max_size);
+
+    /**
+     * Coalesce the concurrent searches of a GPU index into one search of all their queries: a search waits up to
+     * `window_us` microseconds for others with the same params and filter, up to `max_rows` queries in all, and each
+     * gets its own rows of the results. The default window of 0 does not batch.
+     */
+    static void
+    SetGpuSearchBatching(int64_t window_us, int64_t max_rows = 1024);
+
+    /**
+     * Keep the configs parsed for the searches given the `capacity` jsons searched with most recently, so that a
+     * search with one of them skips parsing and checking it; see SearchParams and Index::PrepareSearch, which does
+     * the same without the cache. The default capacity of 0 parses the json of every search.
+     */
+    static void
+    SetSearchParamsCache(size_t capacity);
+
+    /**
+     * Keep the top k of the queries of knn searches in a cache of at most `bytes`, split into `shards` of a lock of
+     * their own, so that a query searched again with the same config on the same data skips the index; see
+     * ResultCache. The searches with a bitset are only cached when their config has a filter_version. The default
+     * of 0 bytes disables it, setting it drops the results cached.
+     */
+    static void
+    SetResultCache(size_t bytes, size_t shards = 16);
+
+    /**
+     * Back the large buffers of the indexes loaded or built from now on, e.g. level 0 of HNSW and the PQ codes of
+     * DiskANN, by `huge_pages`, and bind them to `numa_node` if it is not -1; see PayloadAllocator. Reserved huge
+     * pages fall back to transparent ones when the pools run out. The default are transparent huge pages on any node.
+     */
+    static void
+    SetPayloadAllocator(PayloadAllocator::HugePages huge_pages, int numa_node = -1);
+
+    /**
+     * Log at most `messages_per_second` messages per second from each LOG_KNOWHERE_* statement, the ones past them
+     * are suppressed and counted; see LogSite. The messages are written by a log thread of their own, off the search
+     * threads. The default is 10, 0 logs every message.
+     */
+    static void
+    SetLogRateLimit(int64_t messages_per_second);
 };
 
 }  // namespace knowhere
@@ -0,0 +1,114 @@
+// Copyright (C) 2019-2023 Zilliz. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file except in compliance
+// with the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
+// or implied. See the License for the specific language governing permissions and limitations under the License
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace knowhere {
+
+/**
+ * @brief The bytes an index holds, by what it holds them for and where they reside. The indexes add up the buffers
+ * they actually allocated or mapped, at their capacity rather than at what is in use, so that the total is what the
+ * process pays for the index; mapped bytes are the ones of the file, whether the kernel has paged them in or not.
+ */
+struct MemoryUsage {
+    enum Component {
+        // the vectors or their codes, and the norms kept along with them
+        kVectors = 0,
+        // the neighbor lists of graph indexes
+        kGraph,
+        // the ids of the inverted lists of IVF indexes, their codes are kVectors
+        kLists,
+        // the coarse centroids, quantizer codebooks and the tables precomputed from them
+        kCodebooks,
+        // the caches filled by searches, e.g. of entry points or disk nodes
+        kCache,
+        // the per-thread buffers of searches kept across queries, e.g. visited lists
+        kScratch,
+        // the ids maps, locks and the index objects themselves
+        kOther,
+        kComponentNum,
+    };
+
+    enum Residency {
+        kHeap = 0,
+        kMmap,
+        kDevice,
+        kResidencyNum,
+    };
+
+    int64_t bytes[kComponentNum][kResidencyNum] = {};
+
+    void
+    Add(Component component, Residency residency, int64_t n) {
+        bytes[component][residency] += n;
+    }
+
+    int64_t
+    Of(Component component) const {
+        int64_t n = 0;
+        for (int r = 0; r < kResidencyNum; ++r) {
+            n += bytes[component][r];
+        }
+        return n;
+    }
+
+    int64_t
+    In(Residency residency) const {
+        int64_t n = 0;
+        for (int c = 0; c < kComponentNum; ++c) {
+            n += bytes[c][residency];
+        }
+        return n;
+    }
+
+    int64_t
+    Total() const {
+        int64_t n = 0;
+        for (int r = 0; r < kResidencyNum; ++r) {
+            n += In(static_cast<Residency>(r));
+        }
+        return n;
+    }
+
+    MemoryUsage&
+    operator+=(const MemoryUsage& other) {
+        for (int c = 0; c < kComponentNum; ++c) {
+            for (int r = 0; r < kResidencyNum; ++r) {
+                bytes[c][r] += other.bytes[c][r];
+            }
+        }
+        return *this;
+    }
+
+    static const char*
+    ComponentName(Component component) {
+        static const char* names[kComponentNum] = {"vectors", "graph", "lists", "codebooks",
+                                                   "cache",   "scratch", "other"};
+        return names[component];
+    }
+
+    static const char*
+    ResidencyName(Residency residency) {
+        static const char* names[kResidencyNum] = {"heap", "mmap", "device"};
+        return names[residency];
+    }
+};
+
+// A range of the memory an index maps from its file, see IndexNode::MappedRegions.
+struct MappedRegion {
+    const void* addr;
+    size_t size;
+};
+
+}  // namespace knowhere
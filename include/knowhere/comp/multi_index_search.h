@@ -0,0 +1,47 @@
+// Copyright (C) 2019-2023 Zilliz. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file except in compliance
+// with the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
+// or implied. See the License for the specific language governing permissions and limitations under the License.
+
+#ifndef MULTI_INDEX_SEARCH_H
+#define MULTI_INDEX_SEARCH_H
+
+#include <memory>
+#include <vector>
+
+#include "knowhere/bitsetview.h"
+#include "knowhere/comp/cancellation.h"
+#include "knowhere/dataset.h"
+#include "knowhere/index.h"
+
+namespace knowhere {
+
+// One segment of a multi index search.
+struct SegmentIndex {
+    Index<IndexNode> index;
+    BitsetView bitset = nullptr;
+    // added to the ids of the segment, so that the merged ids tell the segments apart
+    int64_t id_offset = 0;
+};
+
+class MultiIndexSearch {
+ public:
+    // Searches the query batch of dataset on every segment, the segments running as tasks of the global search pool,
+    // and merges their results straight into one top k per query. The results of a segment are merged query by query
+    // under a lock of the query, and only up to the first one that is no better than the current k-th distance of the
+    // query, which the segments share. json is the search config of every segment, the first failing segment fails
+    // the whole search.
+    static expected<DataSetPtr>
+    Search(const std::vector<SegmentIndex>& segments, const DataSet& dataset, const Json& json,
+           std::shared_ptr<CancellationToken> cancellation = nullptr);
+};
+
+}  // namespace knowhere
+
+#endif /* MULTI_INDEX_SEARCH_H */
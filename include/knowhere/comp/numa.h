@@ -0,0 +1,59 @@
+// Copyright (C) 2019-2023 Zilliz. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file except in compliance
+// with the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
+// or implied. See the License for the specific language governing permissions and limitations under the License
+
+#pragma once
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <vector>
+
+namespace knowhere {
+
+// the NUMA nodes of the host as sysfs lists them, a host without NUMA is a single node 0 holding every cpu
+class Numa {
+ public:
+    static int
+    NodeCount();
+
+    // the cpus of the node, empty for an unknown node
+    static const std::vector<int>&
+    NodeCpus(int node);
+
+    static int
+    TotalCpus();
+
+    // pins the thread to the cpus of the node, returns false when the node is unknown or the call failed
+    static bool
+    PinThread(pthread_t thread, int node);
+
+    /**
+     * @brief Keeps the calling thread on a node and prefers that node for the pages it allocates or first touches,
+     * so an index loaded in the scope lands in the memory of the node its searches run on. The affinity before the
+     * scope and the default memory policy are restored when it ends.
+     */
+    class ScopedNode {
+     public:
+        explicit ScopedNode(int node);
+        ~ScopedNode();
+
+        ScopedNode(const ScopedNode&) = delete;
+        ScopedNode&
+        operator=(const ScopedNode&) = delete;
+
+     private:
+        bool pinned_ = false;
+        bool policy_set_ = false;
+        cpu_set_t affinity_before_;
+    };
+};
+
+}  // namespace knowhere
@@ -0,0 +1,78 @@
+// Copyright (C) 2019-2023 Zilliz. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file except in compliance
+// with the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
+// or implied. See the License for the specific language governing permissions and limitations under the License
+
+#pragma once
+
+#include <cstddef>
+
+namespace knowhere {
+
+/**
+ * @brief The large buffers of the indexes, e.g. level 0 of HNSW or the PQ codes and node cache of DiskANN. From
+ * kMinMappedSize bytes on they are anonymous mappings rather than heap memory, so that they can be backed by huge
+ * pages, which the random accesses of the searches need to keep TLB misses down, and placed on a NUMA node; see
+ * KnowhereConfig::SetPayloadAllocator. Huge pages fall back to the next smaller ones and then to transparent huge
+ * pages when none are reserved. The buffers below kMinMappedSize come from the heap as before, Free and Reallocate
+ * take either.
+ */
+class PayloadAllocator {
+ public:
+    enum class HugePages {
+        // plain pages
+        kNone = 0,
+        // pages the kernel may promote to 2MB ones, see MADV_HUGEPAGE
+        kTransparent,
+        // pages of the hugetlbfs pools, which the host reserves
+        k2M,
+        k1G,
+    };
+
+    // what a buffer ended up backed by
+    enum Backing {
+        kHeap = 0,
+        kPages,
+        kTransparentHugePages,
+        kHugePages2M,
+        kHugePages1G,
+        kBackingNum,
+    };
+
+    static constexpr size_t kMinMappedSize = size_t(1) << 20;
+
+    // the backing of the buffers allocated from now on, and the NUMA node they are bound to, -1 for none
+    static void
+    Configure(HugePages huge_pages, int numa_node);
+
+    // size bytes aligned to align, at most a page; the mapped ones are zeroed. Null if out of memory.
+    static void*
+    Allocate(size_t size, size_t align = 64);
+
+    static void
+    Free(void* ptr);
+
+    // a buffer of size bytes that starts with the first bytes of ptr, which is freed; null if out of memory, ptr is
+    // then left as it is
+    static void*
+    Reallocate(void* ptr, size_t old_size, size_t size, size_t align = 64);
+
+    // the bytes a buffer takes, its size rounded up to its pages
+    static size_t
+    AllocatedSize(const void* ptr, size_t size);
+
+    // the bytes of the mapped buffers live, by backing; the heap ones are not counted
+    static size_t
+    AllocatedBytes(Backing backing);
+
+    static const char*
+    BackingName(Backing backing);
+};
+
+}  // namespace knowhere
@@ -0,0 +1,146 @@
+// Copyright (C) 2019-2023 Zilliz. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file except in compliance
+// with the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
+// or implied. See the License for the specific language governing permissions and limitations under the License
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#if defined(KNOWHERE_WITH_PROFILE_ZONES) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define KNOWHERE_ZONE_USDT(probe, name) DTRACE_PROBE1(knowhere, probe, name)
+#endif
+#if defined(TRACY_ENABLE) && __has_include(<tracy/Tracy.hpp>)
+#include <tracy/Tracy.hpp>
+#define KNOWHERE_ZONE_TRACY(name) ZoneScopedN(name)
+#endif
+#endif
+
+#ifndef KNOWHERE_ZONE_USDT
+#define KNOWHERE_ZONE_USDT(probe, name)
+#endif
+#ifndef KNOWHERE_ZONE_TRACY
+#define KNOWHERE_ZONE_TRACY(name)
+#endif
+
+namespace knowhere {
+
+enum class ProfileMode {
+    // the zones only fire their USDT probes, a nop unless a tracer is attached to them
+    kOff = 0,
+    // the zones also count their calls and time
+    kTiming,
+    // and the cycles and last level cache misses of their thread, when perf events can be opened
+    kCounters,
+};
+
+struct ZoneStats {
+    std::string name;
+    uint64_t calls = 0;
+    uint64_t ns = 0;
+    uint64_t cycles = 0;
+    uint64_t llc_misses = 0;
+};
+
+/**
+ * @brief Named zones around the hot sections of the indexes. A zone is a scope, see KNOWHERE_PROFILE_ZONE; it fires
+ * the knowhere:zone_begin and knowhere:zone_end USDT probes with its name, opens a Tracy zone in builds with
+ * TRACY_ENABLE, and adds to the stats of its name while the mode is not kOff. The stats are kept per thread, a zone
+ * only writes to the ones of its thread.
+ */
+class ProfileZones {
+ public:
+    static constexpr int kMaxZones = 64;
+
+    static void
+    SetMode(ProfileMode mode);
+
+    static ProfileMode
+    Mode() {
+        return mode_.load(std::memory_order_relaxed);
+    }
+
+    // the stats of the zones since the last Reset, of the threads alive and gone
+    static std::vector<ZoneStats>
+    Snapshot();
+
+    static void
+    Reset();
+
+    // the id of the zone of that name, the zone is created on the first call
+    static int
+    Register(const char* name);
+
+ private:
+    friend class ProfileScope;
+
+    struct Sample {
+        uint64_t ns;
+        uint64_t cycles;
+        uint64_t llc_misses;
+    };
+
+    static Sample
+    Begin(bool counters);
+
+    static void
+    End(int zone, const Sample& begin, bool counters);
+
+    static inline std::atomic<ProfileMode> mode_{ProfileMode::kOff};
+};
+
+class ProfileScope {
+ public:
+    ProfileScope(int zone, const char* name) : zone_(zone), name_(name), mode_(ProfileZones::Mode()) {
+        KNOWHERE_ZONE_USDT(zone_begin, name_);
+        if (mode_ != ProfileMode::kOff) {
+            begin_ = ProfileZones::Begin(mode_ == ProfileMode::kCounters);
+        }
+    }
+
+    ~ProfileScope() {
+        if (mode_ != ProfileMode::kOff) {
+            ProfileZones::End(zone_, begin_, mode_ == ProfileMode::kCounters);
+        }
+        KNOWHERE_ZONE_USDT(zone_end, name_);
+    }
+
+    ProfileScope(const ProfileScope&) = delete;
+
+    ProfileScope&
+    operator=(const ProfileScope&) = delete;
+
+ private:
+    int zone_;
+    const char* name_;
+    ProfileMode mode_;
+    ProfileZones::Sample begin_{};
+};
+
+}  // namespace knowhere
+
+#define KNOWHERE_ZONE_CONCAT_IMPL(a, b) a##b
+#define KNOWHERE_ZONE_CONCAT(a, b) KNOWHERE_ZONE_CONCAT_IMPL(a, b)
+
+// Profiles the rest of the enclosing scope as the zone `name`, a string literal. Builds without
+// KNOWHERE_WITH_PROFILE_ZONES compile it out.
+#ifdef KNOWHERE_WITH_PROFILE_ZONES
+#define KNOWHERE_PROFILE_ZONE(name)                                                                              \
+    static const int KNOWHERE_ZONE_CONCAT(knowhere_zone_id_, __LINE__) = knowhere::ProfileZones::Register(name); \
+    KNOWHERE_ZONE_TRACY(name);                                                                                   \
+    knowhere::ProfileScope KNOWHERE_ZONE_CONCAT(knowhere_zone_, __LINE__)(                                       \
+        KNOWHERE_ZONE_CONCAT(knowhere_zone_id_, __LINE__), name)
+#else
+#define KNOWHERE_PROFILE_ZONE(name)
+#endif
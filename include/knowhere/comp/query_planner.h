@@ -0,0 +1,85 @@
+// Copyright (C) 2019-2023 Zilliz. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file except in compliance
+// with the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
+// or implied. See the License for the specific language governing permissions and limitations under the License.
+
+#ifndef QUERY_PLANNER_H
+#define QUERY_PLANNER_H
+
+#include <memory>
+
+#include "knowhere/bitsetview.h"
+#include "knowhere/comp/cancellation.h"
+#include "knowhere/dataset.h"
+#include "knowhere/index.h"
+
+namespace knowhere {
+
+class QueryPlanner {
+ public:
+    enum class Plan {
+        // the search of the index
+        kIndex = 0,
+        // a scan of all the base rows, the bitset tested row by row
+        kBruteForce,
+        // a scan of the base rows the bitset keeps only, gathered into a base of their own first
+        kBruteForceAliveIds,
+    };
+
+    // The costs of the steps of the plans, in nanoseconds. The defaults are the ones of a recent x86 server; Calibrate
+    // measures the ones of the host, and the benchmarks of the suite the ones it cannot, as the disk reads.
+    struct CostModel {
+        // a distance in a sequential scan, per float dimension or per 32 bits of a binary vector
+        double distance_per_dim = 0.08;
+        // the extra cost of a distance to a row at random, the cache misses of the graph and IVF searches
+        double random_access = 60;
+        // enumerating the ids of the segment the bitset keeps, or testing them in a scan, per id
+        double bitset_per_id = 0.3;
+        // copying a gathered row, per float dimension or per 32 bits
+        double gather_per_dim = 0.05;
+        // the fixed cost of a search per query: the config, the dispatch and the result of one query
+        double index_per_query = 2000;
+        // a node read from disk by DiskANN, its share of the beam of reads it goes out with
+        double disk_read = 20000;
+        // the distances a graph search computes per candidate of its list, the mean degree of the nodes it expands
+        double graph_distances_per_candidate = 16;
+    };
+
+    static void
+    SetCostModel(const CostModel& model);
+
+    static CostModel
+    GetCostModel();
+
+    // Measures distance_per_dim, random_access, bitset_per_id and gather_per_dim on this host with micro benchmarks of
+    // a fraction of a second and sets them, the other costs are kept. Returns the model set.
+    static CostModel
+    Calibrate();
+
+    // The cheapest plan of a knn search of nq queries of json on index with bitset. The brute force plans need the
+    // base rows: with has_base the caller holds them as a base dataset, else kBruteForceAliveIds gathers them through
+    // GetVectorByIds if the index has raw data, and kBruteForce is not an option. The index types the model knows
+    // nothing of, the sparse and the GPU ones, always go to kIndex.
+    static Plan
+    Choose(const Index<IndexNode>& index, bool has_base, int64_t nq, const Json& json, const BitsetView& bitset);
+
+    // A knn search of queries by the plan Choose picks, the results the ones of index.Search up to the recall of the
+    // index: the brute force plans are exact. base, the rows of the index with the ids of their positions, may be
+    // null.
+    static expected<DataSetPtr>
+    Search(const Index<IndexNode>& index, const DataSetPtr base, const DataSetPtr queries, const Json& json,
+           const BitsetView& bitset, std::shared_ptr<CancellationToken> cancellation = nullptr);
+
+    static const char*
+    PlanName(Plan plan);
+};
+
+}  // namespace knowhere
+
+#endif /* QUERY_PLANNER_H */
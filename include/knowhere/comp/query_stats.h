@@ -0,0 +1,51 @@
+// Copyright (C) 2019-2023 Zilliz. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file except in compliance
+// with the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
+// or implied. See the License for the specific language governing permissions and limitations under the License
+
+#pragma once
+
+#include <cstdint>
+
+namespace knowhere {
+
+/**
+ * @brief The work of the query the calling thread runs. The search loops of the index libraries add to the stats of
+ * their thread, the same way they poll the CancellationToken of it; the index resets them before a query and reports
+ * them after it, see QueryMetrics in prometheus_client.h. Only the counters an index type has are non-zero.
+ */
+struct QueryStats {
+    // graph indexes: the level the descent starts from, the nodes expanded, the distances computed for their
+    // neighbors and the neighbors the bitset filtered out
+    int64_t entry_level = 0;
+    int64_t hops = 0;
+    int64_t distance_computations = 0;
+    int64_t filtered = 0;
+    // IVF indexes: the lists probed and the codes scanned in them
+    int64_t lists_scanned = 0;
+    int64_t codes_scanned = 0;
+    // disk indexes
+    int64_t ios = 0;
+    int64_t cache_hits = 0;
+    int64_t bytes_read = 0;
+    int64_t io_us = 0;
+
+    static QueryStats&
+    Current() {
+        thread_local QueryStats stats;
+        return stats;
+    }
+
+    void
+    Reset() {
+        *this = QueryStats();
+    }
+};
+
+}  // namespace knowhere
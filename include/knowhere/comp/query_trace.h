@@ -0,0 +1,106 @@
+// Copyright (C) 2019-2023 Zilliz. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file except in compliance
+// with the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
+// or implied. See the License for the specific language governing permissions and limitations under the License.
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "knowhere/comp/query_stats.h"
+
+namespace knowhere {
+
+// The compact record of one sampled query: its stats and where its time went. Unlike the feder trace_visit it holds
+// no visit, so that it can be taken from any search with any nq.
+struct QueryTrace {
+    static constexpr size_t kIndexTypeSize = 32;
+
+    // the index type, cut to fit and null terminated
+    char index_type[kIndexTypeSize];
+    // the position of the query in its search
+    int64_t query;
+    // the system clock at the start of the query, in microseconds since the epoch
+    int64_t start_us;
+    int64_t total_us;
+    // its io_us is the part of total_us spent waiting for reads
+    QueryStats stats;
+};
+
+// The traces of the latest sampled queries, written without locks by the searching threads and read by the host
+// application. A slot overwritten while it is read is skipped by the reader.
+class QueryTraceBuffer {
+ public:
+    static constexpr size_t kCapacity = 4096;
+
+    static QueryTraceBuffer&
+    Instance();
+
+    void
+    Push(const QueryTrace& trace);
+
+    // Copies the traces pushed since cursor that are still in the buffer, oldest first, and moves cursor past them.
+    // Start with cursor 0 for all of them.
+    std::vector<QueryTrace>
+    Read(uint64_t& cursor) const;
+
+ private:
+    QueryTraceBuffer();
+
+    struct Slot {
+        // odd while the slot is written, else twice the number of pushes up to and including the one in it
+        std::atomic<uint64_t> seq{0};
+        QueryTrace trace;
+    };
+
+    std::atomic<uint64_t> pushed_{0};
+    std::unique_ptr<Slot[]> slots_;
+};
+
+// Traces the query of the calling thread if it is sampled, with the QueryStats of the thread at the end of the scope.
+// A search with trace_sample_rate 0 pays one branch per query.
+class QueryTraceScope {
+ public:
+    QueryTraceScope(const std::string& index_type, float sample_rate, int64_t query)
+        : sampled_(sample_rate > 0.0f && Sampled(sample_rate)), query_(query) {
+        if (sampled_) {
+            index_type_ = index_type;
+            start_ = std::chrono::steady_clock::now();
+        }
+    }
+
+    ~QueryTraceScope() {
+        if (sampled_) {
+            Finish();
+        }
+    }
+
+    QueryTraceScope(const QueryTraceScope&) = delete;
+    QueryTraceScope&
+    operator=(const QueryTraceScope&) = delete;
+
+ private:
+    static bool
+    Sampled(float sample_rate);
+
+    void
+    Finish();
+
+    bool sampled_;
+    int64_t query_;
+    std::string index_type_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+}  // namespace knowhere
@@ -0,0 +1,111 @@
+// Copyright (C) 2019-2023 Zilliz. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file except in compliance
+// with the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
+// or implied. See the License for the specific language governing permissions and limitations under the License
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "knowhere/dataset.h"
+
+namespace knowhere {
+
+/**
+ * @brief Rows of raw vectors shared by the caller, the indexes and their wrappers rather than copied into each of
+ * them. A store is refcounted by std::shared_ptr and its rows do not move while it is referred to, so an index can
+ * keep the store of the rows it was built from, see DataSet::SetRawVectorStore, and hand out views of its rows that
+ * outlive the index. The rows are either held by the store, or are memory it only refers to, e.g. the buffer of the
+ * caller or a mapped file, kept alive by an owner.
+ */
+class RawVectorStore {
+ public:
+    // n rows of row_size bytes, dim components each, copied into the store
+    static std::shared_ptr<const RawVectorStore>
+    Copy(const void* rows, int64_t n, int64_t dim, size_t row_size);
+
+    // n rows of memory that owner keeps alive, mapped from a file or not
+    static std::shared_ptr<const RawVectorStore>
+    View(const void* rows, int64_t n, int64_t dim, size_t row_size, std::shared_ptr<const void> owner,
+         bool mapped = false);
+
+    // room for n more rows at the end of store, returned for the caller to fill. The store grows in place when it
+    // holds its rows and nothing else refers to it, else store is replaced by a copy that does.
+    static uint8_t*
+    Grow(std::shared_ptr<const RawVectorStore>& store, int64_t n);
+
+    const uint8_t*
+    Data() const {
+        return data_;
+    }
+
+    const uint8_t*
+    Row(int64_t id) const {
+        return data_ + id * row_size_;
+    }
+
+    int64_t
+    Rows() const {
+        return rows_;
+    }
+
+    int64_t
+    Dim() const {
+        return dim_;
+    }
+
+    size_t
+    RowSize() const {
+        return row_size_;
+    }
+
+    bool
+    Mapped() const {
+        return mapped_;
+    }
+
+    // the memory the store holds itself, none for a view
+    size_t
+    HeapBytes() const {
+        return heap_.capacity();
+    }
+
+ private:
+    RawVectorStore(int64_t dim, size_t row_size) : dim_(dim), row_size_(row_size) {
+    }
+
+    std::vector<uint8_t> heap_;
+    std::shared_ptr<const void> owner_;
+    const uint8_t* data_ = nullptr;
+    int64_t rows_ = 0;
+    int64_t dim_ = 0;
+    size_t row_size_ = 0;
+    bool mapped_ = false;
+};
+
+// a dataset of the rows of the store, which it keeps alive
+inline DataSetPtr
+GenDataSet(const std::shared_ptr<const RawVectorStore>& store) {
+    auto ds = GenDataSet(store->Rows(), store->Dim(), store->Data());
+    ds->SetRawVectorStore(store);
+    return ds;
+}
+
+// a dataset of n rows of the store from first on, which it keeps alive
+inline DataSetPtr
+GenDataSet(const std::shared_ptr<const RawVectorStore>& store, int64_t first, int64_t n) {
+    auto ds = GenDataSet(n, store->Dim(), store->Row(first));
+    ds->SetRawVectorStore(store);
+    return ds;
+}
+
+}  // namespace knowhere
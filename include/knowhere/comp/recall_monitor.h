@@ -0,0 +1,93 @@
+// Copyright (C) 2019-2023 Zilliz. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file except in compliance
+// with the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
+// or implied. See the License for the specific language governing permissions and limitations under the License.
+
+#ifndef RECALL_MONITOR_H
+#define RECALL_MONITOR_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "knowhere/bitsetview.h"
+#include "knowhere/dataset.h"
+
+namespace prometheus {
+class Gauge;
+}  // namespace prometheus
+
+namespace knowhere {
+
+// The recall of the live searches of an index, opted into by Index::SetRecallMonitor. A sample of the queries of the
+// knn searches is searched again by BruteForce::Search against the base rows of the segment, in the background on the
+// build pool, and the recall@k of the results of the index against the exact ones, the mean of the last window of
+// sampled queries, goes into the gauge knowhere_search_recall of the label of the monitor. A sample is dropped rather
+// than queued when the searches of the earlier ones are still running, so the monitor never falls behind the load.
+class RecallMonitor {
+ public:
+    // base holds the rows of the index with the ids of their positions, the monitor holds it; sample_rate is the share
+    // of the queries searched again, label tells the gauge of the index apart from the ones of the others
+    RecallMonitor(DataSetPtr base, float sample_rate, const std::string& label, int64_t window = 1000);
+
+    // waits for the searches in flight
+    ~RecallMonitor();
+
+    RecallMonitor(const RecallMonitor&) = delete;
+
+    RecallMonitor&
+    operator=(const RecallMonitor&) = delete;
+
+    // the rows of the index after a change of its data, e.g. Add, for the samples taken from now on
+    void
+    SetBase(DataSetPtr base);
+
+    // samples the queries of a knn search of k of metric_type with bitset and its result, copying what the search
+    // again needs, so none of them has to outlive the call
+    void
+    Observe(const DataSet& queries, const std::string& metric_type, int64_t k, const BitsetView& bitset,
+            const DataSet& result);
+
+    // the mean recall of the window, -1 before the first sampled query is searched again
+    float
+    Recall() const;
+
+    // the sampled queries searched again so far
+    int64_t
+    Samples() const;
+
+    // waits for the searches in flight
+    void
+    Wait() const;
+
+ private:
+    void
+    Record(const std::vector<float>& recalls);
+
+    float sample_rate_;
+    int64_t window_;
+    prometheus::Gauge* gauge_ = nullptr;
+
+    mutable std::mutex mtx_;
+    mutable std::condition_variable done_cv_;
+    DataSetPtr base_;
+    int64_t in_flight_ = 0;
+    // the recalls of the last window of sampled queries, a ring from next_
+    std::vector<float> recalls_;
+    size_t next_ = 0;
+    double sum_ = 0;
+    int64_t samples_ = 0;
+};
+
+}  // namespace knowhere
+
+#endif /* RECALL_MONITOR_H */
@@ -0,0 +1,77 @@
+// Copyright (C) 2019-2023 Zilliz. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file except in compliance
+// with the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
+// or implied. See the License for the specific language governing permissions and limitations under the License
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "knowhere/config.h"
+
+namespace knowhere {
+
+/**
+ * @brief A memory-bounded cache of the top k of the queries of knn searches, so that a query searched again with the
+ * same config, data and filter skips the index; see KnowhereConfig::SetResultCache, it is disabled by default. An
+ * entry is keyed by the data version of the index, see IndexNode::DataVersion, the hash of the json of the config,
+ * the filter version of the search and the hash_vec of the query; it keeps the bytes of the query to tell colliding
+ * queries apart. The entries are spread over the shards of a concurrent_cache, a hit takes no exclusive lock.
+ */
+class ResultCache {
+ public:
+    struct Key {
+        uint64_t index_version;
+        uint64_t config_hash;
+        int64_t filter_version;
+        uint64_t query_hash;
+
+        bool
+        operator==(const Key& other) const {
+            return index_version == other.index_version && config_hash == other.config_hash &&
+                   filter_version == other.filter_version && query_hash == other.query_hash;
+        }
+    };
+
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        // the bytes the entries are charged
+        size_t bytes = 0;
+    };
+
+    static bool
+    Enabled();
+
+    // copies the k results of the query into ids and distances, false on a miss
+    static bool
+    Get(const Key& key, const uint8_t* query, size_t query_size, int64_t k, int64_t* ids, float* distances);
+
+    static void
+    Put(const Key& key, const uint8_t* query, size_t query_size, int64_t k, const int64_t* ids,
+        const float* distances);
+
+    // the hash a config is keyed by, of its json
+    static uint64_t
+    HashConfig(const Json& json);
+
+    // a data version no index had before
+    static uint64_t
+    NewVersion();
+
+    // the entries are dropped, a capacity of 0 disables the cache
+    static void
+    SetCapacity(size_t bytes, size_t shards);
+
+    static Stats
+    GetStats();
+};
+
+}  // namespace knowhere
@@ -0,0 +1,133 @@
+// Copyright (C) 2019-2023 Zilliz. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file except in compliance
+// with the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
+// or implied. See the License for the specific language governing permissions and limitations under the License
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+namespace knowhere {
+
+/**
+ * @brief Per thread monotonic scratch memory for the work of one query. Alloc bumps a pointer in the blocks the
+ * thread already has, a Scope rewinds the arena to where it was when the scope began, so a search takes the same
+ * memory query after query instead of going to malloc. The blocks are kept for the next query, only the ones past
+ * kRetainedBytes are freed when the outermost scope of the thread ends.
+ */
+class ScratchArena {
+ public:
+    // the arena of the calling thread
+    static ScratchArena&
+    Local() {
+        thread_local ScratchArena arena;
+        return arena;
+    }
+
+    ScratchArena(const ScratchArena&) = delete;
+
+    ScratchArena&
+    operator=(const ScratchArena&) = delete;
+
+    // n uninitialized objects of a trivial type, valid until the enclosing scope ends
+    template <typename T>
+    T*
+    Alloc(size_t n) {
+        static_assert(std::is_trivially_destructible_v<T> && alignof(T) <= kAlignment);
+        return reinterpret_cast<T*>(AllocBytes(n * sizeof(T)));
+    }
+
+    class Scope {
+     public:
+        Scope() : arena_(Local()), block_(arena_.block_), offset_(arena_.offset_) {
+            ++arena_.depth_;
+        }
+
+        ~Scope() {
+            arena_.block_ = block_;
+            arena_.offset_ = offset_;
+            if (--arena_.depth_ == 0) {
+                arena_.Trim();
+            }
+        }
+
+        Scope(const Scope&) = delete;
+
+        Scope&
+        operator=(const Scope&) = delete;
+
+        template <typename T>
+        T*
+        Alloc(size_t n) {
+            return arena_.Alloc<T>(n);
+        }
+
+     private:
+        ScratchArena& arena_;
+        size_t block_;
+        size_t offset_;
+    };
+
+ private:
+    struct Block {
+        std::unique_ptr<char[]> data;
+        size_t size;
+    };
+
+    ScratchArena() = default;
+
+    void*
+    AllocBytes(size_t bytes) {
+        bytes = (bytes + kAlignment - 1) / kAlignment * kAlignment;
+        while (block_ < blocks_.size() && offset_ + bytes > blocks_[block_].size) {
+            ++block_;
+            offset_ = 0;
+        }
+        if (block_ == blocks_.size()) {
+            size_t size = std::max({kMinBlockBytes, bytes, blocks_.empty() ? 0 : blocks_.back().size * 2});
+            // new[] of char only guarantees the fundamental alignment, the block is over allocated to align it
+            blocks_.push_back({std::unique_ptr<char[]>(new char[size + kAlignment]), size});
+            offset_ = 0;
+        }
+        auto& block = blocks_[block_];
+        auto base = reinterpret_cast<uintptr_t>(block.data.get());
+        auto aligned = (base + kAlignment - 1) / kAlignment * kAlignment;
+        void* ptr = reinterpret_cast<char*>(aligned) + offset_;
+        offset_ += bytes;
+        return ptr;
+    }
+
+    void
+    Trim() {
+        size_t total = 0;
+        size_t keep = 0;
+        while (keep < blocks_.size() && total + blocks_[keep].size <= kRetainedBytes) {
+            total += blocks_[keep++].size;
+        }
+        blocks_.resize(std::max<size_t>(keep, 1));
+        block_ = 0;
+        offset_ = 0;
+    }
+
+    constexpr static size_t kAlignment = 64;
+    constexpr static size_t kMinBlockBytes = 64 << 10;
+    constexpr static size_t kRetainedBytes = 16 << 20;
+
+    std::vector<Block> blocks_;
+    size_t block_ = 0;
+    size_t offset_ = 0;
+    int depth_ = 0;
+};
+
+}  // namespace knowhere
@@ -0,0 +1,273 @@
+// Copyright (C) 2019-2023 Zilliz. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file except in compliance
+// with the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
+// or implied. See the License for the specific language governing permissions and limitations under the License
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "folly/futures/Future.h"
+#include "knowhere/comp/thread_pool.h"
+
+namespace knowhere {
+
+enum class TaskClass {
+    // searches someone waits on, they get the most of the free slots
+    INTERACTIVE = 0,
+    // searches run in bulk, latency does not matter much
+    BATCH = 1,
+    // index builds
+    BUILD = 2,
+};
+
+// what a TaskScheduler fails a task with when its class queue is full
+class TaskRejected : public std::runtime_error {
+ public:
+    using std::runtime_error::runtime_error;
+};
+
+/**
+ * @brief Admission in front of the thread pools. A task of a class starts once a slot is free overall and in its class,
+ * the waiting classes share the free slots by weight (stride scheduling, so a low weight class still moves while a
+ * high weight one is busy), and a task is rejected when its class already has max_queued tasks waiting. The
+ * scheduler does not own threads, it decides when a task is handed to a pool, or when a caller may go on.
+ */
+class TaskScheduler {
+ public:
+    struct ClassConfig {
+        // share of the free slots while several classes wait, at least 1
+        uint32_t weight = 1;
+        // tasks of the class running at once, 0 for no limit other than the overall one
+        uint32_t max_running = 0;
+        // tasks of the class waiting for a slot, the ones past it are rejected, 0 for no limit
+        uint32_t max_queued = 0;
+    };
+
+    explicit TaskScheduler(uint32_t max_running) : max_running_(std::max<uint32_t>(1, max_running)) {
+        classes_[static_cast<size_t>(TaskClass::INTERACTIVE)].config = {16, 0, 0};
+        classes_[static_cast<size_t>(TaskClass::BATCH)].config = {4, 0, 0};
+        classes_[static_cast<size_t>(TaskClass::BUILD)].config = {1, std::max<uint32_t>(1, max_running_ / 4), 0};
+    }
+
+    TaskScheduler(const TaskScheduler&) = delete;
+
+    TaskScheduler&
+    operator=(const TaskScheduler&) = delete;
+
+    void
+    Configure(TaskClass task_class, ClassConfig config) {
+        config.weight = std::max<uint32_t>(1, config.weight);
+        std::vector<folly::Func> launches;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            Class(task_class).config = config;
+            Dispatch(launches);
+        }
+        Launch(launches);
+    }
+
+    void
+    SetMaxRunning(uint32_t max_running) {
+        std::vector<folly::Func> launches;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            max_running_ = std::max<uint32_t>(1, max_running);
+            Dispatch(launches);
+        }
+        Launch(launches);
+    }
+
+    ClassConfig
+    GetConfig(TaskClass task_class) const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return Class(task_class).config;
+    }
+
+    uint32_t
+    Running(TaskClass task_class) const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return Class(task_class).running;
+    }
+
+    size_t
+    Queued(TaskClass task_class) const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return Class(task_class).queue.size();
+    }
+
+    /**
+     * @brief Runs func on the pool once the class gets a slot.
+     *
+     * @return the future of func, failed with TaskRejected when the class queue is full
+     */
+    template <typename Func>
+    auto
+    Submit(TaskClass task_class, std::shared_ptr<ThreadPool> pool, Func&& func) {
+        using R = std::invoke_result_t<Func>;
+        auto promise = std::make_shared<folly::Promise<R>>();
+        auto future = promise->getFuture();
+        auto launch = [this, task_class, pool, promise, func = std::forward<Func>(func)]() mutable {
+            try {
+                pool->push([this, task_class, promise, func = std::move(func)]() mutable {
+                    promise->setWith(std::move(func));
+                    Finish(task_class);
+                });
+            } catch (...) {
+                // the task never reached the pool, its slot is given back here rather than when it ends
+                promise->setException(folly::exception_wrapper(std::current_exception()));
+                Finish(task_class);
+            }
+        };
+        bool admitted = Enqueue(task_class, std::move(launch));
+        if (!admitted) {
+            promise->setException(TaskRejected("task scheduler queue is full"));
+        }
+        return future;
+    }
+
+    /**
+     * @brief Runs func in the calling thread once the class gets a slot, for the work that has to stay on its thread.
+     *
+     * @throw TaskRejected when the class queue is full
+     */
+    template <typename Func>
+    auto
+    Run(TaskClass task_class, Func&& func) {
+        struct Grant {
+            std::mutex mutex;
+            std::condition_variable cv;
+            bool granted = false;
+        };
+        auto grant = std::make_shared<Grant>();
+        bool admitted = Enqueue(task_class, [grant]() {
+            std::lock_guard<std::mutex> lock(grant->mutex);
+            grant->granted = true;
+            grant->cv.notify_one();
+        });
+        if (!admitted) {
+            throw TaskRejected("task scheduler queue is full");
+        }
+        {
+            std::unique_lock<std::mutex> lock(grant->mutex);
+            grant->cv.wait(lock, [&] { return grant->granted; });
+        }
+        struct Release {
+            TaskScheduler* scheduler;
+            TaskClass task_class;
+            ~Release() {
+                scheduler->Finish(task_class);
+            }
+        } release{this, task_class};
+        return func();
+    }
+
+ private:
+    struct ClassState {
+        ClassConfig config;
+        uint32_t running = 0;
+        // stride scheduling pass, the waiting class with the smallest one goes next
+        uint64_t pass = 0;
+        std::deque<folly::Func> queue;
+    };
+
+    ClassState&
+    Class(TaskClass task_class) {
+        return classes_[static_cast<size_t>(task_class)];
+    }
+
+    const ClassState&
+    Class(TaskClass task_class) const {
+        return classes_[static_cast<size_t>(task_class)];
+    }
+
+    bool
+    Enqueue(TaskClass task_class, folly::Func launch) {
+        std::vector<folly::Func> launches;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto& state = Class(task_class);
+            if (state.config.max_queued > 0 && state.queue.size() >= state.config.max_queued) {
+                return false;
+            }
+            if (state.queue.empty()) {
+                // a class coming back from idle starts level with the others rather than with the credit it saved
+                state.pass = std::max(state.pass, virtual_time_);
+            }
+            state.queue.push_back(std::move(launch));
+            Dispatch(launches);
+        }
+        Launch(launches);
+        return true;
+    }
+
+    void
+    Finish(TaskClass task_class) {
+        std::vector<folly::Func> launches;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            --Class(task_class).running;
+            --running_;
+            Dispatch(launches);
+        }
+        Launch(launches);
+    }
+
+    // takes the launches of the tasks that got a slot, under the lock
+    void
+    Dispatch(std::vector<folly::Func>& launches) {
+        while (running_ < max_running_) {
+            ClassState* next = nullptr;
+            for (auto& state : classes_) {
+                if (state.queue.empty() ||
+                    (state.config.max_running > 0 && state.running >= state.config.max_running)) {
+                    continue;
+                }
+                if (next == nullptr || state.pass < next->pass) {
+                    next = &state;
+                }
+            }
+            if (next == nullptr) {
+                return;
+            }
+            virtual_time_ = next->pass;
+            next->pass += kStride / next->config.weight;
+            ++next->running;
+            ++running_;
+            launches.push_back(std::move(next->queue.front()));
+            next->queue.pop_front();
+        }
+    }
+
+    static void
+    Launch(std::vector<folly::Func>& launches) {
+        for (auto& launch : launches) {
+            launch();
+        }
+    }
+
+    constexpr static uint64_t kStride = 1 << 20;
+
+    mutable std::mutex mutex_;
+    std::array<ClassState, 3> classes_;
+    uint32_t max_running_;
+    uint32_t running_ = 0;
+    uint64_t virtual_time_ = 0;
+};
+
+}  // namespace knowhere
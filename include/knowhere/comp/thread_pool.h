@@ -14,23 +14,108 @@
 #include <omp.h>
 #include <pthread.h>
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
 #include <utility>
+#include <vector>
 
 #include "folly/executors/CPUThreadPoolExecutor.h"
 #include "folly/futures/Future.h"
+#include "knowhere/comp/cancellation.h"
+#include "knowhere/comp/numa.h"
+#include "knowhere/comp/work_stealing_executor.h"
 #include "knowhere/log.h"
 
+namespace prometheus {
+class Histogram;
+}  // namespace prometheus
+
 namespace knowhere {
 
+// see prometheus_client.h
+prometheus::Histogram&
+ThreadPoolQueueWaitHistogram(const std::string& pool);
+void
+ObserveQueueWait(prometheus::Histogram& histogram, std::chrono::steady_clock::time_point enqueued);
+
+class TaskScheduler;
+
+enum class ExecutorType {
+    // one bounded MPMC queue shared by all of the threads, the submitters block while it is full
+    SHARED_QUEUE,
+    // a deque per thread with stealing, see WorkStealingExecutor
+    WORK_STEALING,
+};
+
 class ThreadPool {
  private:
+    // the threads of a search call left to its parallel_for tasks, see ScopedParallelism
+    struct Parallelism {
+        explicit Parallelism(int64_t max_threads) : limit(max_threads), free(max_threads - 1) {
+        }
+
+        // takes up to n threads, as many as are free
+        int64_t
+        Acquire(int64_t n) {
+            auto current = free.load();
+            int64_t taken;
+            do {
+                taken = std::min(n, current);
+                if (taken <= 0) {
+                    return 0;
+                }
+            } while (!free.compare_exchange_weak(current, current - taken));
+            return taken;
+        }
+
+        void
+        Release(int64_t n) {
+            free.fetch_add(n);
+        }
+
+        const int64_t limit;
+        std::atomic<int64_t> free;
+    };
+
+    // installs the budget of the search a thread works for, the tasks of a parallel_for take the one of the caller
+    class ParallelismScope {
+     public:
+        explicit ParallelismScope(Parallelism* parallelism) : previous_(current_parallelism_) {
+            current_parallelism_ = parallelism;
+        }
+
+        ~ParallelismScope() {
+            current_parallelism_ = previous_;
+        }
+
+        ParallelismScope(const ParallelismScope&) = delete;
+
+        ParallelismScope&
+        operator=(const ParallelismScope&) = delete;
+
+     private:
+        Parallelism* previous_;
+    };
+
     class LowPriorityThreadFactory : public folly::NamedThreadFactory {
      public:
-        using folly::NamedThreadFactory::NamedThreadFactory;
+        // the threads are pinned to numa_node when it is not -1
+        LowPriorityThreadFactory(folly::StringPiece prefix, int numa_node = -1)
+            : folly::NamedThreadFactory(prefix), numa_node_(numa_node) {
+        }
         std::thread
         newThread(folly::Func&& func) override {
             auto thread = folly::NamedThreadFactory::newThread(std::move(func));
+            if (numa_node_ >= 0) {
+                Numa::PinThread(thread.native_handle(), numa_node_);
+            }
             sched_param sch_params;
             int policy = SCHED_FIFO;
             sch_params.sched_priority = sched_get_priority_min(policy);
@@ -44,16 +129,31 @@ class ThreadPool {
             }
             return thread;
         }
+
+     private:
+        int numa_node_;
     };
 
  public:
-    explicit ThreadPool(uint32_t num_threads)
-        : pool_(folly::CPUThreadPoolExecutor(
-              num_threads,
-              std::make_unique<
-                  folly::LifoSemMPMCQueue<folly::CPUThreadPoolExecutor::CPUTask, folly::QueueBehaviorIfFull::BLOCK>>(
-                  num_threads * kTaskQueueFactor),
-              std::make_shared<LowPriorityThreadFactory>("LowPrioKWPool"))) {
+    // name labels the queue wait metric of the pool, knowhere_thread_pool_queue_wait
+    explicit ThreadPool(uint32_t num_threads, ExecutorType executor_type = ExecutorType::SHARED_QUEUE,
+                        int numa_node = -1, const std::string& name = "other")
+        : executor_type_(executor_type), queue_wait_(&ThreadPoolQueueWaitHistogram(name)) {
+        auto thread_factory = std::make_shared<LowPriorityThreadFactory>("LowPrioKWPool", numa_node);
+        if (executor_type == ExecutorType::WORK_STEALING) {
+            auto pool = std::make_unique<WorkStealingExecutor>(num_threads, std::move(thread_factory));
+            num_threads_ = pool->numThreads();
+            pool_ = std::move(pool);
+        } else {
+            auto pool = std::make_unique<folly::CPUThreadPoolExecutor>(
+                num_threads,
+                std::make_unique<
+                    folly::LifoSemMPMCQueue<folly::CPUThreadPoolExecutor::CPUTask, folly::QueueBehaviorIfFull::BLOCK>>(
+                    num_threads * kTaskQueueFactor),
+                std::move(thread_factory));
+            num_threads_ = pool->numThreads();
+            pool_ = std::move(pool);
+        }
     }
 
     ThreadPool(const ThreadPool&) = delete;
@@ -69,13 +169,148 @@ class ThreadPool {
     template <typename Func, typename... Args>
     auto
     push(Func&& func, Args&&... args) {
-        return folly::makeSemiFuture().via(&pool_).then(
-            [func = std::forward<Func>(func), &args...](auto&&) mutable { return func(std::forward<Args>(args)...); });
+        return folly::makeSemiFuture().via(pool_.get()).then(
+            [func = std::forward<Func>(func), &args..., queue_wait = queue_wait_,
+             enqueued = std::chrono::steady_clock::now()](auto&&) mutable {
+                ObserveQueueWait(*queue_wait, enqueued);
+                return func(std::forward<Args>(args)...);
+            });
+    }
+
+    /**
+     * @brief Run fn(i) for every i in [begin, end) on the pool and the calling thread, and wait for all of them. The
+     * ids are handed out in chunks of at least grain ids, about kChunksPerThread chunks per thread, to the caller and
+     * to at most one task per other thread, so a batch costs a few tasks and one latch rather than a future per id.
+     * The caller only waits for the tasks that got ids, a task the pool starts after the ids ran out does nothing, so
+     * a parallel_for nested in a task of the same pool can not deadlock it. The first exception thrown by fn is
+     * rethrown once every chunk handed out ended; the ids left are skipped. fn runs under the cancellation token of
+     * the caller, it is up to fn to poll it, and under its ScopedParallelism, which bounds the tasks to the threads
+     * left in the budget.
+     */
+    template <typename Func>
+    void
+    parallel_for(int64_t begin, int64_t end, int64_t grain, Func&& fn) {
+        if (begin >= end) {
+            return;
+        }
+        struct Batch {
+            int64_t end;
+            int64_t chunk;
+            std::atomic<int64_t> next;
+            std::atomic<bool> failed{false};
+            std::mutex mutex;
+            std::condition_variable done;
+            // the threads inside the chunk loop, a thread enters before it takes ids so that the caller sees it
+            int64_t active = 0;
+            std::exception_ptr error;
+            const CancellationToken* cancellation;
+            Parallelism* parallelism;
+        };
+        const int64_t n = end - begin;
+        const int64_t threads = std::max<int64_t>(1, concurrency());
+        const int64_t chunk = std::max<int64_t>({1, grain, n / (threads * kChunksPerThread)});
+        // the tasks take threads of the budget of the caller, the ones it has left, and give them back once done
+        auto parallelism = current_parallelism_;
+        int64_t tasks = std::min(threads, (n + chunk - 1) / chunk) - 1;
+        if (parallelism != nullptr) {
+            tasks = parallelism->Acquire(tasks);
+        }
+        auto batch = std::make_shared<Batch>();
+        batch->end = end;
+        batch->chunk = chunk;
+        batch->next = begin;
+        batch->cancellation = CancellationToken::Current();
+        batch->parallelism = parallelism;
+        auto run = [](Batch* batch, auto& fn) {
+            CancellationToken::Scope scope(batch->cancellation);
+            ParallelismScope parallelism_scope(batch->parallelism);
+            {
+                std::lock_guard<std::mutex> lock(batch->mutex);
+                ++batch->active;
+            }
+            try {
+                for (int64_t i0 = batch->next.fetch_add(batch->chunk); i0 < batch->end && !batch->failed;
+                     i0 = batch->next.fetch_add(batch->chunk)) {
+                    for (int64_t i = i0, i1 = std::min(batch->end, i0 + batch->chunk); i < i1; ++i) {
+                        fn(i);
+                    }
+                }
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(batch->mutex);
+                if (!batch->error) {
+                    batch->error = std::current_exception();
+                }
+                batch->failed = true;
+            }
+            std::lock_guard<std::mutex> lock(batch->mutex);
+            if (--batch->active == 0) {
+                batch->done.notify_all();
+            }
+        };
+        auto enqueued = std::chrono::steady_clock::now();
+        for (int64_t t = 0; t < tasks; ++t) {
+            // fn is only called while the caller waits, a late task finds no ids left and does not touch it
+            pool_->add([batch, &fn, run, queue_wait = queue_wait_, enqueued] {
+                ObserveQueueWait(*queue_wait, enqueued);
+                run(batch.get(), fn);
+            });
+        }
+        run(batch.get(), fn);
+        std::unique_lock<std::mutex> lock(batch->mutex);
+        batch->done.wait(lock, [&] { return batch->active == 0; });
+        if (parallelism != nullptr) {
+            parallelism->Release(tasks);
+        }
+        if (batch->error) {
+            std::rethrow_exception(batch->error);
+        }
     }
 
     [[nodiscard]] int32_t
     size() const noexcept {
-        return pool_.numThreads();
+        return num_threads_;
+    }
+
+    // the threads a parallel_for of the calling thread may run on, the pool size bounded by the ScopedParallelism of
+    // the search the thread works for
+    [[nodiscard]] int32_t
+    concurrency() const noexcept {
+        if (current_parallelism_ == nullptr) {
+            return num_threads_;
+        }
+        return std::max<int32_t>(1, std::min<int64_t>(num_threads_, current_parallelism_->limit));
+    }
+
+    /**
+     * @brief Bounds the threads one search call keeps busy at once to max_threads, so that a batch of many queries can
+     * not take the whole pool and starve the interactive searches while it runs. The parallel_for calls of the calling
+     * thread, and of the tasks they run, nested ones included, share the budget: the calling thread holds one thread
+     * of it, and every parallel_for takes the threads its tasks run on out of what is left, so a query split in parts
+     * for a small nq only gets the threads the queries do not use. A max_threads of 0, or a thread already under the
+     * budget of an outer call, MultiIndexSearch over segments searched with it for one, leaves it as it is.
+     */
+    class ScopedParallelism {
+     public:
+        explicit ScopedParallelism(int64_t max_threads) {
+            if (max_threads > 0 && current_parallelism_ == nullptr) {
+                parallelism_ = std::make_unique<Parallelism>(max_threads);
+                scope_.emplace(parallelism_.get());
+            }
+        }
+
+        ScopedParallelism(const ScopedParallelism&) = delete;
+
+        ScopedParallelism&
+        operator=(const ScopedParallelism&) = delete;
+
+     private:
+        std::unique_ptr<Parallelism> parallelism_;
+        std::optional<ParallelismScope> scope_;
+    };
+
+    [[nodiscard]] ExecutorType
+    executor_type() const noexcept {
+        return executor_type_;
     }
 
     /**
@@ -110,9 +345,11 @@ class ThreadPool {
      * @brief Set the threads number to the global search thread pool of knowhere
      *
      * @param num_threads
+     * @param executor_type the executor the pool runs its tasks on, only applied before the pool is first used
      */
     static void
-    InitGlobalSearchThreadPool(uint32_t num_threads) {
+    InitGlobalSearchThreadPool(uint32_t num_threads, ExecutorType executor_type = ExecutorType::SHARED_QUEUE) {
+        global_search_executor_type_ = executor_type;
         InitThreadPool(num_threads, global_search_thread_pool_size_);
         LOG_KNOWHERE_WARNING_ << "Global Search ThreadPool has already been initialized with threads num: "
                               << global_search_thread_pool_size_;
@@ -131,7 +368,8 @@ class ThreadPool {
             LOG_KNOWHERE_WARNING_ << "Global Search ThreadPool has not been initialized yet, init it with threads num: "
                                   << global_search_thread_pool_size_;
         }
-        static auto pool = std::make_shared<ThreadPool>(global_build_thread_pool_size_);
+        static auto pool =
+            std::make_shared<ThreadPool>(global_build_thread_pool_size_, ExecutorType::SHARED_QUEUE, -1, "build");
         return pool;
     }
 
@@ -142,10 +380,69 @@ class ThreadPool {
             LOG_KNOWHERE_WARNING_ << "Global Search ThreadPool has not been initialized yet, init it with threads num: "
                                   << global_search_thread_pool_size_;
         }
-        static auto pool = std::make_shared<ThreadPool>(global_search_thread_pool_size_);
+        static auto pool = std::make_shared<ThreadPool>(global_search_thread_pool_size_,
+                                                        global_search_executor_type_.load(), -1, "search");
         return pool;
     }
 
+    /**
+     * @brief Give every NUMA node a search pool of its own with the threads pinned to the node, the global search
+     * threads split by the cpus of each node. An index loaded afterwards gets a home node, its memory is allocated on
+     * it and its searches run on the pool of it, see Index::Deserialize. Nothing changes on a single node host.
+     */
+    static void
+    EnableNumaSearchPools(bool enable) {
+        numa_search_pools_ = enable;
+        LOG_KNOWHERE_INFO_ << "numa search pools " << (enable ? "enabled" : "disabled") << ", numa nodes "
+                           << Numa::NodeCount();
+    }
+
+    /**
+     * @brief The home node of an index being loaded: the requested node, or the next one round robin for -1.
+     *
+     * @return the node, or -1 when the numa search pools are disabled, the host has a single node or the requested
+     * node does not exist
+     */
+    static int
+    SearchNumaNode(int requested) {
+        if (!numa_search_pools_ || Numa::NodeCount() <= 1) {
+            return -1;
+        }
+        if (requested >= 0) {
+            return requested < Numa::NodeCount() ? requested : -1;
+        }
+        return next_numa_node_.fetch_add(1) % Numa::NodeCount();
+    }
+
+    static std::shared_ptr<ThreadPool>
+    GetGlobalSearchThreadPool(int numa_node) {
+        if (numa_node < 0 || numa_node >= Numa::NodeCount()) {
+            return GetGlobalSearchThreadPool();
+        }
+        if (global_search_thread_pool_size_ == 0) {
+            InitThreadPool(std::thread::hardware_concurrency(), global_search_thread_pool_size_);
+        }
+        static std::vector<std::shared_ptr<ThreadPool>> pools(Numa::NodeCount());
+        std::lock_guard<std::mutex> lock(global_thread_pool_mutex_);
+        auto& pool = pools[numa_node];
+        if (pool == nullptr) {
+            auto threads = std::max<uint32_t>(
+                1, static_cast<uint64_t>(global_search_thread_pool_size_) * Numa::NodeCpus(numa_node).size() /
+                       std::max(1, Numa::TotalCpus()));
+            LOG_KNOWHERE_INFO_ << "init search thread pool of numa node " << numa_node << " with threads num: "
+                               << threads;
+            pool = std::make_shared<ThreadPool>(threads, global_search_executor_type_.load(), numa_node, "search");
+        }
+        return pool;
+    }
+
+    /**
+     * @brief Get the global task scheduler of knowhere, the admission of the interactive, batch and build tasks into
+     * the pools, see TaskScheduler. It allows as many tasks at once as the host has cpus.
+     */
+    static std::shared_ptr<TaskScheduler>
+    GetGlobalTaskScheduler();
+
     class ScopedOmpSetter {
         int omp_before;
 
@@ -158,11 +455,47 @@ class ThreadPool {
         }
     };
 
+    /**
+     * @brief Bounds the OpenMP regions of a build, the faiss ones included, to num_threads when it is given, else to
+     * the share of the global build threads the build gets among the builds running at once, so that concurrent
+     * builds split the build pool sizing rather than each spawning a thread per core.
+     */
+    class ScopedBuildOmpSetter {
+        ScopedOmpSetter setter_;
+
+        static int
+        Enter(const std::optional<int32_t>& num_threads) {
+            auto builds = ++running_builds_;
+            if (num_threads.has_value()) {
+                return num_threads.value();
+            }
+            return std::max<int32_t>(1, GetGlobalBuildThreadPool()->size() / builds);
+        }
+
+     public:
+        explicit ScopedBuildOmpSetter(const std::optional<int32_t>& num_threads = std::nullopt)
+            : setter_(Enter(num_threads)) {
+        }
+        ~ScopedBuildOmpSetter() {
+            --running_builds_;
+        }
+    };
+
  private:
-    folly::CPUThreadPoolExecutor pool_;
+    std::unique_ptr<folly::Executor> pool_;
+    int32_t num_threads_ = 0;
+    ExecutorType executor_type_;
+    prometheus::Histogram* queue_wait_;
     inline static uint32_t global_build_thread_pool_size_ = 0;
     inline static uint32_t global_search_thread_pool_size_ = 0;
+    inline static std::atomic<ExecutorType> global_search_executor_type_ = ExecutorType::SHARED_QUEUE;
+    inline static std::atomic<bool> numa_search_pools_ = false;
+    inline static std::atomic<uint32_t> next_numa_node_ = 0;
     inline static std::mutex global_thread_pool_mutex_;
+    inline static std::atomic<int32_t> running_builds_ = 0;
+    inline static thread_local Parallelism* current_parallelism_ = nullptr;
     constexpr static size_t kTaskQueueFactor = 16;
+    // the chunks of a parallel_for per thread, enough for the threads to even out uneven ids
+    constexpr static int64_t kChunksPerThread = 8;
 };
 }  // namespace knowhere
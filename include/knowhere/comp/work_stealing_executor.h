@@ -0,0 +1,256 @@
+// Copyright (C) 2019-2023 Zilliz. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file except in compliance
+// with the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
+// or implied. See the License for the specific language governing permissions and limitations under the License
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "folly/Executor.h"
+#include "folly/executors/thread_factory/ThreadFactory.h"
+#include "knowhere/log.h"
+
+namespace knowhere {
+
+/**
+ * @brief Chase-Lev deque: the owner pushes and pops at the bottom, any other thread steals from the top. The ring
+ * grows when full, the rings it outgrew are kept until the deque dies since a thief may still read them.
+ */
+template <typename T>
+class ChaseLevDeque {
+ public:
+    explicit ChaseLevDeque(int64_t capacity = 256) : ring_(new Ring(capacity)) {
+        rings_.emplace_back(ring_.load(std::memory_order_relaxed));
+    }
+
+    ChaseLevDeque(const ChaseLevDeque&) = delete;
+
+    ChaseLevDeque&
+    operator=(const ChaseLevDeque&) = delete;
+
+    // owner only
+    void
+    Push(T* item) {
+        auto b = bottom_.load(std::memory_order_relaxed);
+        auto t = top_.load(std::memory_order_acquire);
+        auto ring = ring_.load(std::memory_order_relaxed);
+        if (b - t > ring->capacity - 1) {
+            ring = Grow(ring, t, b);
+        }
+        ring->Put(b, item);
+        // publishes the item to the thieves, a release store rather than a fence that sanitizers can not follow
+        bottom_.store(b + 1, std::memory_order_release);
+    }
+
+    // owner only, the last pushed item first
+    T*
+    Pop() {
+        auto b = bottom_.load(std::memory_order_relaxed) - 1;
+        auto ring = ring_.load(std::memory_order_relaxed);
+        bottom_.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        auto t = top_.load(std::memory_order_relaxed);
+        if (t > b) {
+            bottom_.store(b + 1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        T* item = ring->Get(b);
+        if (t == b) {
+            // the last item, raced against the thieves
+            if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                item = nullptr;
+            }
+            bottom_.store(b + 1, std::memory_order_relaxed);
+        }
+        return item;
+    }
+
+    // any thread, the first pushed item first; nullptr when empty or when another thread won the item
+    T*
+    Steal() {
+        auto t = top_.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        auto b = bottom_.load(std::memory_order_acquire);
+        if (t >= b) {
+            return nullptr;
+        }
+        T* item = ring_.load(std::memory_order_acquire)->Get(t);
+        if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+            return nullptr;
+        }
+        return item;
+    }
+
+    bool
+    Empty() const {
+        return bottom_.load(std::memory_order_relaxed) <= top_.load(std::memory_order_relaxed);
+    }
+
+ private:
+    struct Ring {
+        explicit Ring(int64_t capacity) : capacity(capacity), mask(capacity - 1), slots(new std::atomic<T*>[capacity]) {
+        }
+        T*
+        Get(int64_t i) const {
+            return slots[i & mask].load(std::memory_order_relaxed);
+        }
+        void
+        Put(int64_t i, T* item) {
+            slots[i & mask].store(item, std::memory_order_relaxed);
+        }
+        const int64_t capacity;
+        const int64_t mask;
+        std::unique_ptr<std::atomic<T*>[]> slots;
+    };
+
+    Ring*
+    Grow(Ring* ring, int64_t t, int64_t b) {
+        auto bigger = new Ring(ring->capacity * 2);
+        for (auto i = t; i < b; ++i) {
+            bigger->Put(i, ring->Get(i));
+        }
+        rings_.emplace_back(bigger);
+        ring_.store(bigger, std::memory_order_release);
+        return bigger;
+    }
+
+    alignas(64) std::atomic<int64_t> top_{0};
+    alignas(64) std::atomic<int64_t> bottom_{0};
+    std::atomic<Ring*> ring_;
+    std::vector<std::unique_ptr<Ring>> rings_;
+};
+
+/**
+ * @brief An executor with a Chase-Lev deque per worker. A task added from one of its workers goes to that worker's
+ * deque and is run by it first, the last added first, so nested tasks stay on the thread whose cache holds their
+ * data. A task added from outside goes to a shared injection queue that never blocks the caller. An idle worker takes
+ * from its own deque, then from the injection queue, then steals the oldest task of another worker before it sleeps.
+ */
+class WorkStealingExecutor : public folly::Executor {
+ public:
+    WorkStealingExecutor(uint32_t num_threads, std::shared_ptr<folly::ThreadFactory> thread_factory)
+        : workers_(std::max<uint32_t>(1, num_threads)) {
+        threads_.reserve(workers_.size());
+        for (size_t i = 0; i < workers_.size(); ++i) {
+            threads_.emplace_back(thread_factory->newThread([this, i] { Run(i); }));
+        }
+    }
+
+    ~WorkStealingExecutor() override {
+        {
+            std::lock_guard<std::mutex> lock(sleep_mutex_);
+            stop_ = true;
+        }
+        wake_.notify_all();
+        for (auto& thread : threads_) {
+            thread.join();
+        }
+    }
+
+    void
+    add(folly::Func func) override {
+        auto task = new folly::Func(std::move(func));
+        if (current_ == this) {
+            workers_[current_index_].deque.Push(task);
+        } else {
+            std::lock_guard<std::mutex> lock(inject_mutex_);
+            inject_.push_back(task);
+        }
+        pending_.fetch_add(1, std::memory_order_seq_cst);
+        if (sleepers_.load(std::memory_order_seq_cst) > 0) {
+            std::lock_guard<std::mutex> lock(sleep_mutex_);
+            wake_.notify_one();
+        }
+    }
+
+    [[nodiscard]] int32_t
+    numThreads() const noexcept {
+        return static_cast<int32_t>(workers_.size());
+    }
+
+ private:
+    struct Worker {
+        ChaseLevDeque<folly::Func> deque;
+    };
+
+    folly::Func*
+    Take(size_t index) {
+        if (auto task = workers_[index].deque.Pop()) {
+            return task;
+        }
+        {
+            std::lock_guard<std::mutex> lock(inject_mutex_);
+            if (!inject_.empty()) {
+                auto task = inject_.front();
+                inject_.pop_front();
+                return task;
+            }
+        }
+        for (size_t k = 1; k < workers_.size(); ++k) {
+            if (auto task = workers_[(index + k) % workers_.size()].deque.Steal()) {
+                return task;
+            }
+        }
+        return nullptr;
+    }
+
+    void
+    Run(size_t index) {
+        current_ = this;
+        current_index_ = index;
+        while (true) {
+            auto task = Take(index);
+            if (task == nullptr) {
+                std::unique_lock<std::mutex> lock(sleep_mutex_);
+                sleepers_.fetch_add(1, std::memory_order_seq_cst);
+                wake_.wait(lock, [this] { return stop_ || pending_.load(std::memory_order_seq_cst) > 0; });
+                sleepers_.fetch_sub(1, std::memory_order_relaxed);
+                if (stop_ && pending_.load(std::memory_order_seq_cst) == 0) {
+                    break;
+                }
+                continue;
+            }
+            pending_.fetch_sub(1, std::memory_order_relaxed);
+            std::unique_ptr<folly::Func> owned(task);
+            try {
+                (*owned)();
+            } catch (const std::exception& e) {
+                LOG_KNOWHERE_ERROR_ << "work stealing executor task threw: " << e.what();
+            } catch (...) {
+                LOG_KNOWHERE_ERROR_ << "work stealing executor task threw an unknown exception";
+            }
+        }
+        current_ = nullptr;
+    }
+
+    std::vector<Worker> workers_;
+    std::vector<std::thread> threads_;
+    std::mutex inject_mutex_;
+    std::deque<folly::Func*> inject_;
+    // the tasks added and not taken yet, the workers sleep only while it is 0
+    std::atomic<int64_t> pending_{0};
+    std::atomic<int32_t> sleepers_{0};
+    std::mutex sleep_mutex_;
+    std::condition_variable wake_;
+    bool stop_ = false;
+    inline static thread_local WorkStealingExecutor* current_ = nullptr;
+    inline static thread_local size_t current_index_ = 0;
+};
+
+}  // namespace knowhere
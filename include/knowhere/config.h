@@ -17,6 +17,7 @@
 #include <iostream>
 #include <limits>
 #include <list>
+#include <memory>
 #include <optional>
 #include <sstream>
 #include <thread>
@@ -24,6 +25,7 @@
 #include <unordered_set>
 #include <variant>
 
+#include "knowhere/comp/cancellation.h"
 #include "knowhere/expected.h"
 #include "knowhere/log.h"
 #include "nlohmann/json.hpp"
@@ -496,9 +498,53 @@ class BaseConfig : public Config {
     CFG_INT num_build_thread;
     CFG_FLOAT radius;
     CFG_FLOAT range_filter;
+    // a range search keeps the closest max_results hits of every query, 0 for all of them
+    CFG_INT max_results;
     CFG_BOOL trace_visit;
+    // the fraction of the queries traced into the QueryTraceBuffer, see query_trace.h
+    CFG_FLOAT trace_sample_rate;
     CFG_BOOL enable_mmap;
     CFG_BOOL for_tuning;
+    CFG_INT numa_node;
+    // a search running past it fails with search_cancelled, 0 for no limit
+    CFG_FLOAT search_timeout_ms;
+    // the threads of the search pool a search call keeps busy at once, 0 for all of them, see
+    // ThreadPool::ScopedParallelism
+    CFG_INT max_threads;
+    // identifies the bitset of a search, the caller gives a new one whenever the bits change: the result cache only
+    // caches the searches with a bitset given one, the GPU indexes keep the bitset of a version on the device
+    CFG_INT filter_version;
+    // not read from json, set by Index::Search and friends from search_timeout_ms and the token of the caller; the
+    // search loops poll it and give up once it is cancelled
+    std::shared_ptr<CancellationToken> cancellation;
+    // not read from json, set by Index::SearchWithBuf and Index::RangeSearchWithBuf; the buffers of the caller a search
+    // writes its results into instead of arrays of its own, the result dataset then does not own them. A knn search
+    // writes nq * k ids and distances, a range search nq + 1 lims and up to result_capacity ids and distances.
+    int64_t* result_ids = nullptr;
+    float* result_distances = nullptr;
+    size_t* result_lims = nullptr;
+    size_t result_capacity = 0;
+    CFG_BOOL mmap_populate;
+    CFG_STRING mmap_advice;
+    CFG_BOOL verify_checksum;
+    // the transform of the vectors ahead of the indexes wrapped by IndexNodePreTransformWrapper
+    CFG_STRING pre_transform;
+    CFG_INT pre_transform_dim;
+    CFG_INT pre_transform_m;
+    // the raw vectors the indexes wrapped by IndexNodeRefineWrapper rerank their candidates against
+    CFG_STRING rerank_store;
+    CFG_FLOAT rerank_ratio;
+    // the hits per query vector, and how they add up per document, of Index::MultiVectorSearch
+    CFG_INT multi_vector_k;
+    CFG_STRING multi_vector_agg;
+    // the results per group of Index::GroupedSearch
+    CFG_INT group_size;
+    // a search takes the params of the table of Index::SetTunedParams for this recall
+    CFG_FLOAT target_recall;
+    // not read from json, set by Index::DeserializeFromFile when the index is a section of a knowhere index file: the
+    // bytes of the file the index reads, a file_size of 0 is the whole file
+    size_t file_offset = 0;
+    size_t file_size = 0;
     KNOHWERE_DECLARE_CONFIG(BaseConfig) {
         KNOWHERE_CONFIG_DECLARE_FIELD(metric_type).set_default("L2").description("metric type").for_train_and_search();
         KNOWHERE_CONFIG_DECLARE_FIELD(k)
@@ -519,16 +565,105 @@ class BaseConfig : public Config {
             .set_default(defaultRangeFilter)
             .description("result filter for range search")
             .for_range_search();
+        KNOWHERE_CONFIG_DECLARE_FIELD(max_results)
+            .set_default(0)
+            .description("closest hits a range search keeps per query, 0 for all")
+            .set_range(0, std::numeric_limits<CFG_INT::value_type>::max())
+            .for_range_search();
         KNOWHERE_CONFIG_DECLARE_FIELD(trace_visit)
             .set_default(false)
             .description("trace visit for feder")
             .for_search()
             .for_range_search();
+        KNOWHERE_CONFIG_DECLARE_FIELD(trace_sample_rate)
+            .set_default(0)
+            .description("fraction of the queries whose stats and time are recorded in the query trace buffer")
+            .set_range(0, 1)
+            .for_search()
+            .for_range_search();
         KNOWHERE_CONFIG_DECLARE_FIELD(enable_mmap)
             .set_default(false)
             .description("enable mmap for load index")
             .for_deserialize_from_file();
         KNOWHERE_CONFIG_DECLARE_FIELD(for_tuning).set_default(false).description("for tuning").for_search();
+        KNOWHERE_CONFIG_DECLARE_FIELD(numa_node)
+            .set_default(-1)
+            .description("home numa node of the index when the numa search pools are enabled, -1 for round robin")
+            .set_range(-1, std::numeric_limits<CFG_INT::value_type>::max())
+            .for_deserialize()
+            .for_deserialize_from_file();
+        KNOWHERE_CONFIG_DECLARE_FIELD(mmap_populate)
+            .set_default(false)
+            .description("fault the mapping of a knowhere index file in on load rather than on first access")
+            .for_deserialize_from_file();
+        KNOWHERE_CONFIG_DECLARE_FIELD(mmap_advice)
+            .set_default("NORMAL")
+            .description("madvise of the mapping of a knowhere index file, NORMAL/RANDOM/SEQUENTIAL/WILLNEED")
+            .for_deserialize_from_file();
+        KNOWHERE_CONFIG_DECLARE_FIELD(verify_checksum)
+            .set_default(true)
+            .description("check the sections of a knowhere index file against their checksums on load")
+            .for_deserialize_from_file();
+        KNOWHERE_CONFIG_DECLARE_FIELD(search_timeout_ms)
+            .set_default(0)
+            .description("time after which a search gives up, 0 for no limit")
+            .set_range(0, std::numeric_limits<CFG_FLOAT::value_type>::max())
+            .for_search()
+            .for_range_search();
+        KNOWHERE_CONFIG_DECLARE_FIELD(max_threads)
+            .set_default(0)
+            .description("threads a search uses at once, 0 for the whole search pool")
+            .set_range(0, std::numeric_limits<CFG_INT::value_type>::max())
+            .for_search()
+            .for_range_search();
+        KNOWHERE_CONFIG_DECLARE_FIELD(filter_version)
+            .set_default(-1)
+            .description("version of the bitset of the search, -1 for none: it is neither cached nor kept on the gpu")
+            .set_range(-1, std::numeric_limits<CFG_INT::value_type>::max())
+            .for_search();
+        KNOWHERE_CONFIG_DECLARE_FIELD(pre_transform)
+            .set_default("NONE")
+            .description("transform of the vectors ahead of HNSW, IVF_FLAT, IVF_SQ8 and IVF_PQ, NONE/PCA/RR/OPQ, "
+                         "PCA for L2 only")
+            .for_train();
+        KNOWHERE_CONFIG_DECLARE_FIELD(pre_transform_dim)
+            .set_default(0)
+            .description("dim of the transformed vectors, 0 keeps the dim")
+            .set_range(0, std::numeric_limits<CFG_INT::value_type>::max())
+            .for_train();
+        KNOWHERE_CONFIG_DECLARE_FIELD(pre_transform_m)
+            .set_default(8)
+            .description("sub-spaces the OPQ rotation balances, pre_transform_dim must be a multiple of it")
+            .set_range(1, 65536)
+            .for_train();
+        KNOWHERE_CONFIG_DECLARE_FIELD(rerank_store)
+            .set_default("NONE")
+            .description("raw vectors kept to rerank the candidates of IVF_SQ8 and IVF_PQ, NONE/FP32/FP16")
+            .for_train();
+        KNOWHERE_CONFIG_DECLARE_FIELD(rerank_ratio)
+            .set_default(1.0)
+            .description("candidates per result searched then reranked by their exact distances")
+            .set_range(1.0, 64.0)
+            .for_search();
+        KNOWHERE_CONFIG_DECLARE_FIELD(multi_vector_k)
+            .set_default(0)
+            .description("rows a multi-vector search finds per query vector, 0 for k")
+            .set_range(0, std::numeric_limits<CFG_INT::value_type>::max())
+            .for_search();
+        KNOWHERE_CONFIG_DECLARE_FIELD(multi_vector_agg)
+            .set_default("MAXSIM")
+            .description("score of a document in a multi-vector search, MAXSIM/SUM of the similarities of its hits")
+            .for_search();
+        KNOWHERE_CONFIG_DECLARE_FIELD(group_size)
+            .set_default(1)
+            .description("results a grouped search keeps per group")
+            .set_range(1, std::numeric_limits<CFG_INT::value_type>::max())
+            .for_search();
+        KNOWHERE_CONFIG_DECLARE_FIELD(target_recall)
+            .set_default(0)
+            .description("recall the search params of the tuned table of the index are taken for, 0 for none")
+            .set_range(0, 1)
+            .for_search();
     }
 
     virtual Status
@@ -12,7 +12,9 @@
 #ifndef DATASET_H
 #define DATASET_H
 
+#include <algorithm>
 #include <any>
+#include <atomic>
 #include <map>
 #include <memory>
 #include <mutex>
@@ -24,76 +26,111 @@
 
 namespace knowhere {
 
+class RawVectorStore;
+
+// The type of the components of the dense rows of a dataset. An index node that has no native path for a type gets
+// its rows converted to FLOAT32 by Index, see IndexNode::SupportsDataType.
+enum class DataType : uint8_t {
+    FLOAT32 = 0,
+    FP16 = 1,
+    BF16 = 2,
+    INT8 = 3,
+    UINT8 = 4,
+};
+
+inline size_t
+DataTypeSize(DataType type) {
+    switch (type) {
+        case DataType::FP16:
+        case DataType::BF16:
+            return 2;
+        case DataType::INT8:
+        case DataType::UINT8:
+            return 1;
+        default:
+            return 4;
+    }
+}
+
+/**
+ * @brief The vectors of a request or the results of a search. The fields every search reads and writes, rows, dim,
+ * tensor, ids, distances, lims, norms and the partial query count, are typed atomic members, so their getters take
+ * no lock and do no lookup; only the rare string fields, the feder json and the deprecated Set/Get, live in a map
+ * behind a mutex.
+ */
 class DataSet {
  public:
     typedef std::variant<const float*, const size_t*, const int64_t*, const void*, int64_t, std::string, std::any> Var;
     DataSet() = default;
     ~DataSet() {
-        if (!is_owner) {
+        if (!is_owner_.load(std::memory_order_acquire)) {
             return;
         }
-        for (auto&& x : this->data_) {
-            {
-                auto ptr = std::get_if<0>(&x.second);
-                if (ptr != nullptr) {
-                    delete[] * ptr;
-                }
-            }
-            {
-                auto ptr = std::get_if<1>(&x.second);
-                if (ptr != nullptr) {
-                    delete[] * ptr;
-                }
-            }
-            {
-                auto ptr = std::get_if<2>(&x.second);
-                if (ptr != nullptr) {
-                    delete[] * ptr;
-                }
-            }
-            {
-                auto ptr = std::get_if<3>(&x.second);
-                if (ptr != nullptr) {
-                    delete[](char*)(*ptr);
-                }
-            }
-        }
+        delete[] distance_.load(std::memory_order_acquire);
+        delete[] norms_.load(std::memory_order_acquire);
+        delete[] lims_.load(std::memory_order_acquire);
+        delete[] ids_.load(std::memory_order_acquire);
+        delete[](char*) tensor_.load(std::memory_order_acquire);
     }
 
+    DataSet(const DataSet&) = delete;
+
+    DataSet&
+    operator=(const DataSet&) = delete;
+
     void
     SetDistance(const float* dis) {
-        std::unique_lock lock(mutex_);
-        this->data_[meta::DISTANCE] = Var(std::in_place_index<0>, dis);
+        distance_.store(dis, std::memory_order_release);
     }
 
     void
     SetLims(const size_t* lims) {
-        std::unique_lock lock(mutex_);
-        this->data_[meta::LIMS] = Var(std::in_place_index<1>, lims);
+        lims_.store(lims, std::memory_order_release);
     }
 
     void
     SetIds(const int64_t* ids) {
-        std::unique_lock lock(mutex_);
-        this->data_[meta::IDS] = Var(std::in_place_index<2>, ids);
+        ids_.store(ids, std::memory_order_release);
     }
 
     void
     SetTensor(const void* tensor) {
-        std::unique_lock lock(mutex_);
-        this->data_[meta::TENSOR] = Var(std::in_place_index<3>, tensor);
+        tensor_.store(tensor, std::memory_order_release);
     }
 
     void
     SetRows(const int64_t rows) {
-        std::unique_lock lock(mutex_);
-        this->data_[meta::ROWS] = Var(std::in_place_index<4>, rows);
+        rows_.store(rows, std::memory_order_release);
     }
 
     void
     SetDim(const int64_t dim) {
-        std::unique_lock lock(mutex_);
-        this->data_[meta::DIM] = Var(std::in_place_index<4>, dim);
+        dim_.store(dim, std::memory_order_release);
+    }
+
+    // L2 norms of the rows of the tensor, e.g. kept with a growing segment, COSINE brute force searches then do not
+    // compute them
+    void
+    SetNorms(const float* norms) {
+        norms_.store(norms, std::memory_order_release);
+    }
+
+    // number of queries whose search stopped on its budget before converging, their results are the best found so far
+    void
+    SetPartialQueries(const int64_t n) {
+        partial_queries_.store(n, std::memory_order_release);
+    }
+
+    // the tensor holds sparse rows in CSR rather than dense ones, see GenSparseDataSet
+    void
+    SetIsSparse(bool is_sparse) {
+        is_sparse_.store(is_sparse, std::memory_order_release);
+    }
+
+    // the type of the components of the dense rows of the tensor, FLOAT32 unless set
+    void
+    SetDataType(DataType type) {
+        data_type_.store(type, std::memory_order_release);
     }
 
     void
@@ -110,68 +147,52 @@ class DataSet {
 
     const float*
     GetDistance() const {
-        std::shared_lock lock(mutex_);
-        auto it = this->data_.find(meta::DISTANCE);
-        if (it != this->data_.end()) {
-            const float* res = *std::get_if<0>(&it->second);
-            return res;
-        }
-        return nullptr;
+        return distance_.load(std::memory_order_acquire);
+    }
+
+    const float*
+    GetNorms() const {
+        return norms_.load(std::memory_order_acquire);
     }
 
     const size_t*
     GetLims() const {
-        std::shared_lock lock(mutex_);
-        auto it = this->data_.find(meta::LIMS);
-        if (it != this->data_.end()) {
-            const size_t* res = *std::get_if<1>(&it->second);
-            return res;
-        }
-        return nullptr;
+        return lims_.load(std::memory_order_acquire);
     }
 
     const int64_t*
     GetIds() const {
-        std::shared_lock lock(mutex_);
-        auto it = this->data_.find(meta::IDS);
-        if (it != this->data_.end()) {
-            const int64_t* res = *std::get_if<2>(&it->second);
-            return res;
-        }
-        return nullptr;
+        return ids_.load(std::memory_order_acquire);
     }
 
     const void*
     GetTensor() const {
-        std::shared_lock lock(mutex_);
-        auto it = this->data_.find(meta::TENSOR);
-        if (it != this->data_.end()) {
-            const void* res = *std::get_if<3>(&it->second);
-            return res;
-        }
-        return nullptr;
+        return tensor_.load(std::memory_order_acquire);
     }
 
     int64_t
     GetRows() const {
-        std::shared_lock lock(mutex_);
-        auto it = this->data_.find(meta::ROWS);
-        if (it != this->data_.end()) {
-            int64_t res = *std::get_if<4>(&it->second);
-            return res;
-        }
-        return 0;
+        return rows_.load(std::memory_order_acquire);
     }
 
     int64_t
     GetDim() const {
-        std::shared_lock lock(mutex_);
-        auto it = this->data_.find(meta::DIM);
-        if (it != this->data_.end()) {
-            int64_t res = *std::get_if<4>(&it->second);
-            return res;
-        }
-        return 0;
+        return dim_.load(std::memory_order_acquire);
+    }
+
+    int64_t
+    GetPartialQueries() const {
+        return partial_queries_.load(std::memory_order_acquire);
+    }
+
+    bool
+    IsSparse() const {
+        return is_sparse_.load(std::memory_order_acquire);
+    }
+
+    DataType
+    GetDataType() const {
+        return data_type_.load(std::memory_order_acquire);
     }
 
     std::string
@@ -198,8 +219,19 @@ class DataSet {
 
     void
     SetIsOwner(bool is_owner) {
-        std::unique_lock lock(mutex_);
-        this->is_owner = is_owner;
+        is_owner_.store(is_owner, std::memory_order_release);
+    }
+
+    // The store the rows of the tensor are in, which the dataset keeps alive: an index that keeps the raw vectors
+    // may then refer to the store rather than copy them, see RawVectorStore.
+    void
+    SetRawVectorStore(std::shared_ptr<const RawVectorStore> store) {
+        std::atomic_store(&raw_vector_store_, std::move(store));
+    }
+
+    std::shared_ptr<const RawVectorStore>
+    GetRawVectorStore() const {
+        return std::atomic_load(&raw_vector_store_);
     }
 
     // deprecated API
@@ -222,22 +254,58 @@ class DataSet {
     }
 
  private:
+    std::atomic<const float*> distance_{nullptr};
+    std::atomic<const float*> norms_{nullptr};
+    std::atomic<const size_t*> lims_{nullptr};
+    std::atomic<const int64_t*> ids_{nullptr};
+    std::atomic<const void*> tensor_{nullptr};
+    std::atomic<int64_t> rows_{0};
+    std::atomic<int64_t> dim_{0};
+    std::atomic<int64_t> partial_queries_{0};
+    std::atomic<bool> is_owner_{true};
+    std::atomic<bool> is_sparse_{false};
+    std::atomic<DataType> data_type_{DataType::FLOAT32};
+    std::shared_ptr<const RawVectorStore> raw_vector_store_;
+
     mutable std::shared_mutex mutex_;
     std::map<std::string, Var> data_;
-    bool is_owner = true;
 };
 using DataSetPtr = std::shared_ptr<DataSet>;
 
 inline DataSetPtr
-GenDataSet(const int64_t nb, const int64_t dim, const void* xb) {
+GenDataSet(const int64_t nb, const int64_t dim, const void* xb, DataType type = DataType::FLOAT32) {
     auto ret_ds = std::make_shared<DataSet>();
     ret_ds->SetRows(nb);
     ret_ds->SetDim(dim);
     ret_ds->SetTensor(xb);
+    ret_ds->SetDataType(type);
     ret_ds->SetIsOwner(false);
     return ret_ds;
 }
 
+/**
+ * @brief A dataset of sparse rows in CSR, of which dim is the number of dimensions, one past the largest index. The
+ * rows are copied into one block the dataset owns: the rows + 1 int64_t offsets of the rows into the entries, which
+ * start at 0, then the int32_t indices and the float values of the entries, offsets[rows] of each.
+ */
+inline DataSetPtr
+GenSparseDataSet(const int64_t rows, const int64_t dim, const int64_t* offsets, const int32_t* indices,
+                 const float* values) {
+    auto nnz = offsets[rows];
+    auto tensor = new char[(rows + 1) * sizeof(int64_t) + nnz * (sizeof(int32_t) + sizeof(float))];
+    auto p = tensor;
+    p = std::copy_n(reinterpret_cast<const char*>(offsets), (rows + 1) * sizeof(int64_t), p);
+    p = std::copy_n(reinterpret_cast<const char*>(indices), nnz * sizeof(int32_t), p);
+    std::copy_n(reinterpret_cast<const char*>(values), nnz * sizeof(float), p);
+    auto ret_ds = std::make_shared<DataSet>();
+    ret_ds->SetRows(rows);
+    ret_ds->SetDim(dim);
+    ret_ds->SetTensor(tensor);
+    ret_ds->SetIsSparse(true);
+    ret_ds->SetIsOwner(true);
+    return ret_ds;
+}
+
 #ifdef NOT_COMPILE_FOR_SWIG
 // TOOD: python wheel build error for this API, need check
 inline DataSetPtr
@@ -12,6 +12,11 @@
 #ifndef DEVICE_BITSET_H
 #define DEVICE_BITSET_H
 
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <vector>
+
 #include "knowhere/bitsetview.h"
 #include "raft/core/device_mdarray.hpp"
 #include "raft/core/device_resources.hpp"
@@ -76,15 +81,120 @@ struct DeviceBitset {
     }
 
     auto
-    view() {
+    view() const {
         return DeviceBitsetView{storage_.data_handle(), num_bits_};
     }
 
+    // copies the bytes [offset, offset + size) of the host bits over those on the device
+    void
+    CopyRange(raft::device_resources& res, const uint8_t* host, size_t offset, size_t size) {
+        raft::copy(storage_.data_handle() + offset, host + offset, size, res.get_stream());
+    }
+
  private:
     raft::device_vector<uint8_t> storage_;
     size_t num_bits_;
 };
 
+// The filters of an index on its device, kept across searches by the filter_version param of the caller: a search
+// with the version of a kept filter uploads nothing, one with a new version rewrites the least recently used filter
+// not in use and uploads only the chunks of bits that differ from it. The caller promises that the bits of a version
+// never change; a search with no version, a negative one, uploads its filter as it would without the cache.
+class DeviceBitsetCache {
+ public:
+    explicit DeviceBitsetCache(size_t capacity = 4) : capacity_(capacity) {
+    }
+
+    // the filter on the device of res, ready for the streams of all the searches once returned
+    std::shared_ptr<const DeviceBitset>
+    Get(raft::device_resources& res, int device, BitsetView const& bitset, int64_t version) {
+        if (version < 0 || bitset.empty()) {
+            return Upload(res, bitset);
+        }
+        std::shared_ptr<Entry> entry;
+        {
+            std::lock_guard lock(mutex_);
+            ++clock_;
+            for (auto& e : entries_) {
+                if (e->ready && e->version == version && e->device == device && e->num_bits == bitset.size()) {
+                    e->last_used = clock_;
+                    return std::shared_ptr<const DeviceBitset>(e, e->bits.get());
+                }
+            }
+            entry = Evict();
+            if (entry == nullptr) {
+                // all the filters are in use by other searches
+                return Upload(res, bitset);
+            }
+            entry->ready = false;
+            entry->version = version;
+            entry->last_used = clock_;
+        }
+
+        if (entry->bits == nullptr || entry->device != device || entry->num_bits != bitset.size()) {
+            entry->bits = Upload(res, bitset);
+            entry->host.assign(bitset.data(), bitset.data() + bitset.byte_size());
+            entry->device = device;
+            entry->num_bits = bitset.size();
+        } else {
+            auto bytes = bitset.byte_size();
+            for (size_t offset = 0; offset < bytes; offset += kChunkSize) {
+                auto size = std::min(kChunkSize, bytes - offset);
+                if (std::memcmp(entry->host.data() + offset, bitset.data() + offset, size) != 0) {
+                    entry->bits->CopyRange(res, bitset.data(), offset, size);
+                    std::memcpy(entry->host.data() + offset, bitset.data() + offset, size);
+                }
+            }
+            res.sync_stream();
+        }
+
+        std::lock_guard lock(mutex_);
+        entry->ready = true;
+        return std::shared_ptr<const DeviceBitset>(entry, entry->bits.get());
+    }
+
+ private:
+    static constexpr size_t kChunkSize = 64 * 1024;
+
+    struct Entry {
+        int64_t version = -1;
+        int device = -1;
+        size_t num_bits = 0;
+        std::shared_ptr<DeviceBitset> bits;
+        // the bits on the device as the host last sent them
+        std::vector<uint8_t> host;
+        uint64_t last_used = 0;
+        bool ready = false;
+    };
+
+    static std::shared_ptr<DeviceBitset>
+    Upload(raft::device_resources& res, BitsetView const& bitset) {
+        auto bits = std::make_shared<DeviceBitset>(res, bitset);
+        res.sync_stream();
+        return bits;
+    }
+
+    // a new entry while there is room, else the least recently used one no search holds; with mutex_ held
+    std::shared_ptr<Entry>
+    Evict() {
+        if (entries_.size() < capacity_) {
+            return entries_.emplace_back(std::make_shared<Entry>());
+        }
+        std::shared_ptr<Entry> lru;
+        for (auto& e : entries_) {
+            if (e.use_count() == 1 && (lru == nullptr || e->last_used < lru->last_used)) {
+                lru = e;
+            }
+        }
+        return lru;
+    }
+
+    size_t capacity_;
+    std::mutex mutex_;
+    uint64_t clock_ = 0;
+    std::vector<std::shared_ptr<Entry>> entries_;
+};
+
 }  // namespace knowhere
 
 #endif /* DEVICE_BITSET_H */
@@ -39,6 +39,9 @@ enum class Status {
     arithmetic_overflow = 17,
     raft_inner_error = 18,
     invalid_binary_set = 19,
+    too_many_requests = 20,
+    search_cancelled = 21,
+    invalid_index_file = 22,
 };
 
 template <typename T>
@@ -13,6 +13,7 @@
 #define FILEMANAGER_H
 #include <optional>
 #include <string>
+#include <vector>
 
 namespace knowhere {
 
@@ -35,6 +36,24 @@ class FileManager {
     virtual bool
     LoadFile(const std::string& filename) noexcept = 0;
 
+    /**
+     * @brief Load files to the local disk, listed in the order they are needed. A remote FileManager should fetch
+     * them concurrently, and a large file in concurrent ranged parts, rather than one whole file after the other as
+     * this default does.
+     *
+     * @param filenames
+     * @return false if any error, or return true.
+     */
+    virtual bool
+    LoadFiles(const std::vector<std::string>& filenames) noexcept {
+        for (auto& filename : filenames) {
+            if (!LoadFile(filename)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
     /**
      * @brief Add file to FileManager to manipulate it.
      *
@@ -11,52 +11,180 @@
 
 #pragma once
 
+#include <algorithm>
+#include <limits>
 #include <optional>
-#include <queue>
 #include <utility>
+#include <vector>
 
 namespace knowhere {
 
-// Maintain intermediate top-k results via maxheap
-// TODO: this naive implementation might be optimzed later
-//     1. Based on top-k and pushed element count to swtich strategy
-//     2. Combine `pop` and `push` operation to `replace`
+// Keeps the k closest of the results pushed, Pop returns them farthest first. The way they are kept is chosen by k:
+// - a sorted array for a tiny k, where shifting a few results costs less than the branches of a heap;
+// - a binary heap that replaces its top in place for a medium k;
+// - for a large k, a buffer of up to 2 * k results that a quickselect trims back to the k closest once full; the
+//   results not closer than the k-th closest of the last trim are dropped right away, so that most pushes are a
+//   compare and an append. The buffer becomes a heap on the first Pop or Size.
+// Results as far as the k-th closest kept do not replace it, ties between the results kept are broken by id.
 template <typename DisT, typename IdT>
 class ResultMaxHeap {
  public:
-    ResultMaxHeap(size_t k) : k_(k){};
+    static constexpr size_t kSortedMaxK = 16;
+    static constexpr size_t kBufferedMinK = 1024;
+
+    ResultMaxHeap(size_t k)
+        : k_(k), strategy_(k <= kSortedMaxK ? Strategy::kSorted : k < kBufferedMinK ? Strategy::kHeap
+                                                                                     : Strategy::kBuffered) {
+        results_.reserve(strategy_ == Strategy::kBuffered ? 2 * k : k);
+        if (k == 0) {
+            // nothing is closer
+            bounded_ = true;
+            bound_ = std::numeric_limits<DisT>::lowest();
+        }
+    }
 
     inline std::optional<std::pair<DisT, IdT>>
     Pop() {
-        if (pq.empty()) {
+        if (strategy_ == Strategy::kBuffered) {
+            ToHeap();
+        }
+        if (results_.empty()) {
             return std::nullopt;
         }
-        std::optional<std::pair<DisT, IdT>> res = pq.top();
-        pq.pop();
+        if (strategy_ == Strategy::kHeap) {
+            std::pop_heap(results_.begin(), results_.end());
+        }
+        std::optional<std::pair<DisT, IdT>> res = results_.back();
+        results_.pop_back();
+        // fewer than k are kept now, any result pushed is kept again
+        bounded_ = false;
         return res;
     }
 
     inline void
     Push(DisT dis, IdT id) {
-        if (pq.size() < k_) {
-            pq.emplace(dis, id);
+        // most of the results of a large search are dropped here, whatever the strategy
+        if (bounded_ && !(dis < bound_)) {
             return;
         }
-
-        if (dis < pq.top().first) {
-            pq.pop();
-            pq.emplace(dis, id);
+        switch (strategy_) {
+            case Strategy::kSorted:
+                PushSorted(dis, id);
+                break;
+            case Strategy::kHeap:
+                PushHeap(dis, id);
+                break;
+            case Strategy::kBuffered:
+                PushBuffered(dis, id);
+                break;
         }
     }
 
     inline size_t
     Size() {
-        return pq.size();
+        if (strategy_ == Strategy::kBuffered) {
+            ToHeap();
+        }
+        return results_.size();
     }
 
  private:
+    enum class Strategy {
+        kSorted,
+        kHeap,
+        kBuffered,
+    };
+
+    // closest first
+    inline void
+    PushSorted(DisT dis, IdT id) {
+        if (results_.size() == k_) {
+            results_.pop_back();
+        }
+        std::pair<DisT, IdT> res(dis, id);
+        size_t i = results_.size();
+        results_.push_back(res);
+        for (; i > 0 && res < results_[i - 1]; --i) {
+            results_[i] = results_[i - 1];
+        }
+        results_[i] = res;
+        if (results_.size() == k_) {
+            Bound(results_.back().first);
+        }
+    }
+
+    inline void
+    PushHeap(DisT dis, IdT id) {
+        if (results_.size() < k_) {
+            results_.emplace_back(dis, id);
+            std::push_heap(results_.begin(), results_.end());
+            if (results_.size() == k_) {
+                Bound(results_.front().first);
+            }
+            return;
+        }
+        // sifts the result down from the top rather than popping the top and pushing the result
+        std::pair<DisT, IdT> res(dis, id);
+        size_t n = results_.size(), i = 0;
+        while (true) {
+            size_t child = 2 * i + 1;
+            if (child >= n) {
+                break;
+            }
+            if (child + 1 < n && results_[child] < results_[child + 1]) {
+                ++child;
+            }
+            if (!(res < results_[child])) {
+                break;
+            }
+            results_[i] = results_[child];
+            i = child;
+        }
+        results_[i] = res;
+        Bound(results_.front().first);
+    }
+
+    inline void
+    PushBuffered(DisT dis, IdT id) {
+        results_.emplace_back(dis, id);
+        if (results_.size() == 2 * k_) {
+            Trim();
+        }
+    }
+
+    // keeps the k closest of the buffer
+    void
+    Trim() {
+        std::nth_element(results_.begin(), results_.begin() + k_ - 1, results_.end());
+        results_.resize(k_);
+        // the results before the k-th are not farther
+        Bound(results_.back().first);
+    }
+
+    void
+    ToHeap() {
+        if (results_.size() > k_) {
+            Trim();
+        }
+        std::make_heap(results_.begin(), results_.end());
+        strategy_ = Strategy::kHeap;
+        if (results_.size() == k_) {
+            Bound(results_.front().first);
+        }
+    }
+
+    // the distance of the farthest result kept once there are k, or of the k-th closest of the last trim
+    inline void
+    Bound(DisT bound) {
+        bounded_ = true;
+        bound_ = bound;
+    }
+
     size_t k_;
-    std::priority_queue<std::pair<DisT, IdT>> pq;
+    Strategy strategy_;
+    std::vector<std::pair<DisT, IdT>> results_;
+    bool bounded_ = false;
+    DisT bound_{};
 };
 
 }  // namespace knowhere
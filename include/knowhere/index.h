@@ -13,13 +13,28 @@
 #define INDEX_H
 
 #include "knowhere/binaryset.h"
+#include "knowhere/comp/cancellation.h"
 #include "knowhere/config.h"
 #include "knowhere/dataset.h"
 #include "knowhere/expected.h"
 #include "knowhere/index_node.h"
+#include "knowhere/search_params.h"
 
 namespace knowhere {
 
+// the next batch of rows of a chunked build, null once there are none left
+using DataSetProducer = std::function<DataSetPtr()>;
+
+// One query of a MixedSearch.
+struct MixedQuery {
+    int64_t k = 0;
+    // the filter of the query among the filters of the search, -1 for none
+    int32_t filter = -1;
+    // the params of the query among the params of the search, e.g. its ef or nprobe, laid over the json of the
+    // search; -1 for the json as it is
+    int32_t params = -1;
+};
+
 template <typename T1>
 class Index {
  public:
@@ -124,36 +139,212 @@ class Index {
     Status
     Add(const DataSet& dataset, const Json& json);
 
+    /**
+     * Builds the index from the batches of rows that producer returns one after the other, e.g. paged in from object
+     * storage, rather than from one tensor of all of them. The index is trained on train_dataset, a sample of the
+     * rows, or on the first batch if none is given; then every batch is added while the producer loads the next one
+     * in the background, so that at most two batches are in memory besides the index itself. The indexes that can not
+     * add to a trained index, e.g. DiskANN, return its error.
+     */
+    Status
+    BuildChunked(const DataSetProducer& producer, const Json& json, const DataSet* train_dataset = nullptr);
+
+    Status
+    DeleteByIds(const DataSet& dataset);
+
+    /**
+     * Appends the rows of others to this index, the way compacting segments would train and build an index over the
+     * union of their data again, but at a fraction of its cost: IVF indexes trained with the same quantizer, e.g. the
+     * segments built from one centroids_file, concatenate their inverted lists; an HNSW graph inserts the vectors of
+     * the others, so that the largest index is best merged into. The ids of others[i] are shifted by the Count of this
+     * index and of others[0..i); json is loaded as the config of a build. Fails with invalid_args for indexes of
+     * another type, dim, metric or training, and not_implemented for the index types and the mapped indexes that can
+     * not be appended to.
+     */
+    Status
+    Merge(const std::vector<Index<T1>>& others, const Json& json);
+
+    // A search gives up with search_cancelled once the cancellation token, or the search_timeout_ms of the config,
+    // fires; the token may be cancelled from any thread while the search runs.
+    expected<DataSetPtr>
+    Search(const DataSet& dataset, const Json& json, const BitsetView& bitset,
+           std::shared_ptr<CancellationToken> cancellation = nullptr) const;
+
+    // Search writing the nq * k results into the buffers of the caller rather than into arrays the result owns.
+    Status
+    SearchWithBuf(const DataSet& dataset, const Json& json, const BitsetView& bitset, int64_t* ids, float* dis,
+                  std::shared_ptr<CancellationToken> cancellation = nullptr) const;
+
     expected<DataSetPtr>
-    Search(const DataSet& dataset, const Json& json, const BitsetView& bitset) const;
+    RangeSearch(const DataSet& dataset, const Json& json, const BitsetView& bitset,
+                std::shared_ptr<CancellationToken> cancellation = nullptr) const;
 
+    // RangeSearch writing the nq + 1 lims and up to capacity ids and distances into the buffers of the caller, the
+    // dataset returned points into them. Results that do not fit the capacity come back in arrays the dataset owns,
+    // its lims then tell the capacity needed.
+    expected<DataSetPtr>
+    RangeSearchWithBuf(const DataSet& dataset, const Json& json, const BitsetView& bitset, int64_t* ids, float* dis,
+                       size_t capacity, size_t* lims, std::shared_ptr<CancellationToken> cancellation = nullptr) const;
+
+    // The config of Search, or of RangeSearch with range_search, parsed and checked once for the searches of many
+    // requests: the searches given the params skip parsing the json, see SearchParams. Fails as the searches with
+    // the json would.
+    expected<SearchParamsPtr>
+    PrepareSearch(const Json& json, bool range_search = false) const;
+
+    expected<DataSetPtr>
+    Search(const DataSet& dataset, const SearchParams& params, const BitsetView& bitset,
+           std::shared_ptr<CancellationToken> cancellation = nullptr) const;
+
+    Status
+    SearchWithBuf(const DataSet& dataset, const SearchParams& params, const BitsetView& bitset, int64_t* ids,
+                  float* dis, std::shared_ptr<CancellationToken> cancellation = nullptr) const;
+
+    expected<DataSetPtr>
+    RangeSearch(const DataSet& dataset, const SearchParams& params, const BitsetView& bitset,
+                std::shared_ptr<CancellationToken> cancellation = nullptr) const;
+
+    expected<DataSetPtr>
+    RangeSearchWithBuf(const DataSet& dataset, const SearchParams& params, const BitsetView& bitset, int64_t* ids,
+                       float* dis, size_t capacity, size_t* lims,
+                       std::shared_ptr<CancellationToken> cancellation = nullptr) const;
+
+    /**
+     * A late interaction search over documents of several vectors each, e.g. the token vectors of passages. The rows
+     * of the dataset are the vectors of the queries, its lims tell where each query starts, up to a last lim at the
+     * rows; without lims every row is a query. doc_ids gives the document of every row of the index, Count() of
+     * them. Every query vector is searched for its multi_vector_k rows, k when 0, and the similarities of the hits
+     * add up per document: the best hit of the document per query vector for MAXSIM, all of its hits for SUM. The
+     * result holds the k documents of the highest scores per query, their ids and scores. For the similarities of IP
+     * and COSINE only.
+     */
     expected<DataSetPtr>
-    RangeSearch(const DataSet& dataset, const Json& json, const BitsetView& bitset) const;
+    MultiVectorSearch(const DataSet& dataset, const Json& json, const BitsetView& bitset, const int64_t* doc_ids,
+                      std::shared_ptr<CancellationToken> cancellation = nullptr) const;
+
+    /**
+     * A search for the k groups nearest to every query, e.g. the authors of the rows, with up to group_size results
+     * each; group_ids gives the group of every row of the index, Count() of them. The results of the iterator of the
+     * query, see AnnIterator, go into the groups they belong to as they come, a group counting once it has its first
+     * result, until k groups are full or the index has no results left; once k groups are found the iteration goes
+     * on for a bounded number of results only to fill them. The result holds k * group_size ids and distances per
+     * query, group by group in the order of their nearest results, -1 for the places of groups not filled.
+     */
+    expected<DataSetPtr>
+    GroupedSearch(const DataSet& dataset, const Json& json, const BitsetView& bitset, const int64_t* group_ids,
+                  std::shared_ptr<CancellationToken> cancellation = nullptr) const;
+
+    /**
+     * A batch of the queries of many requests, each with its own k, filter and search params, see MixedQuery. The
+     * queries of the same k, filter and params are searched together, as one group; the groups run as tasks of the
+     * global search pool, on at most half of its threads so that the searches of the groups keep threads for their
+     * own tasks. The results of query i are lims[i]..lims[i + 1] of the ids and distances, its k of them, all in one
+     * allocation; a group of consecutive queries writes straight into them. Every config is checked before the first
+     * search, the first group to fail fails the whole search. For dense queries only.
+     */
+    expected<DataSetPtr>
+    MixedSearch(const DataSet& dataset, const Json& json, const std::vector<MixedQuery>& queries,
+                const std::vector<BitsetView>& filters, const std::vector<Json>& params,
+                std::shared_ptr<CancellationToken> cancellation = nullptr) const;
+
+    // An iterator per query over the results of a search, nearest first, for the pages past the first k; see
+    // IndexIterator. The index, the dataset and the data of the bitset must outlive the iterators.
+    expected<std::vector<IndexIteratorPtr>>
+    AnnIterator(const DataSet& dataset, const Json& json, const BitsetView& bitset) const;
+
+    // Search and RangeSearch completing in the background, the config is checked before returning. The dataset and the
+    // data of the bitset must outlive the future.
+    folly::Future<expected<DataSetPtr>>
+    SearchAsync(const DataSet& dataset, const Json& json, const BitsetView& bitset,
+                std::shared_ptr<CancellationToken> cancellation = nullptr) const;
+
+    folly::Future<expected<DataSetPtr>>
+    RangeSearchAsync(const DataSet& dataset, const Json& json, const BitsetView& bitset,
+                     std::shared_ptr<CancellationToken> cancellation = nullptr) const;
 
     expected<DataSetPtr>
     GetVectorByIds(const DataSet& dataset) const;
 
+    folly::Future<expected<DataSetPtr>>
+    GetVectorByIdsAsync(const DataSet& dataset) const;
+
     bool
     HasRawData(const std::string& metric_type) const;
 
     expected<DataSetPtr>
     GetIndexMeta(const Json& json) const;
 
+    /**
+     * The search params by recall of the index, e.g. found by AutoTune::Tune: an array of {"recall": r, "params":
+     * {...}}. A search with target_recall takes the params of the lowest recall of the table that reaches it, or of
+     * the highest recall, for the params its json does not set itself. The table is serialized with the index; an
+     * empty one removes it.
+     */
+    Status
+    SetTunedParams(const Json& table);
+
+    Json
+    TunedParams() const;
+
+    // Opts the knn searches of the index into the recall monitoring of monitor, see comp/recall_monitor.h, a null
+    // monitor opts them out. The monitor is not serialized with the index, and its base rows are the caller's to keep
+    // in step with the data of the index.
+    void
+    SetRecallMonitor(std::shared_ptr<RecallMonitor> monitor);
+
+    std::shared_ptr<RecallMonitor>
+    GetRecallMonitor() const;
+
     Status
     Serialize(BinarySet& binset) const;
 
+    // Serialize into a knowhere index file, one format for every index type that DeserializeFromFile maps back. The
+    // indexes that stream their sections, see IndexNode::SerializeToFile, are written without a copy in memory, with
+    // direct_io bypassing the page cache.
+    Status
+    SerializeToFile(const std::string& filename, bool direct_io = false) const;
+
     Status
     Deserialize(const BinarySet& binset, const Json& json = {});
 
+    // Reads a knowhere index file, or the file format of the index itself.
     Status
     DeserializeFromFile(const std::string& filename, const Json& json = {});
 
+    /**
+     * Publishes the index into the POSIX shared memory object name as a knowhere index file, so that the processes of
+     * the host Attach it with zero copy rather than each deserialize a copy of their own. It stays until Unpublish,
+     * the indexes attached to it outlive that.
+     */
+    Status
+    Publish(const std::string& name) const;
+
+    // Loads the index published as name by mapping it read only, DeserializeFromFile with enable_mmap set
+    Status
+    Attach(const std::string& name, const Json& json = {});
+
+    static Status
+    Unpublish(const std::string& name);
+
+    /**
+     * Faults the memory the index maps from its file in ahead of its searches, at most budget bytes of it and all of
+     * it for 0, see IndexNode::Warmup; then searches queries, if given, with json to fill the caches of the index,
+     * e.g. the entry points of HNSW or the nodes of DiskANN. For the first searches after a load from a file mapped
+     * with enable_mmap, which would otherwise take their page faults one by one.
+     */
+    Status
+    Warmup(int64_t budget = 0, const DataSet* queries = nullptr, const Json& json = {},
+           const WarmupProgress& progress = nullptr) const;
+
     int64_t
     Dim() const;
 
     int64_t
     Size() const;
 
+    MemoryUsage
+    GetMemoryUsage() const;
+
     int64_t
     Count() const;
 
@@ -0,0 +1,83 @@
+// Copyright (C) 2019-2023 Zilliz. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file except in compliance
+// with the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
+// or implied. See the License for the specific language governing permissions and limitations under the License.
+
+#ifndef INDEX_ITERATOR_H
+#define INDEX_ITERATOR_H
+
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "knowhere/dataset.h"
+#include "knowhere/expected.h"
+
+namespace knowhere {
+
+/**
+ * @brief The results of a search for one query, nearest first, a batch at a time. The search keeps its state between
+ * the batches, so that the next page costs only the work past the previous ones rather than a search with a larger k.
+ *
+ * An index feeds the results it finds into a heap through Refill, and Next returns the top of the heap once no later
+ * Refill may find a closer one; how far that holds is up to the index, the order is as approximate as its search.
+ */
+class IndexIterator {
+ public:
+    virtual ~IndexIterator() = default;
+
+    IndexIterator(const IndexIterator&) = delete;
+
+    IndexIterator&
+    operator=(const IndexIterator&) = delete;
+
+    /**
+     * @brief The next up to n results as a dataset of one row of ids and distances, fewer only once the search has
+     * none left; a dataset of none then ends the iteration.
+     */
+    expected<DataSetPtr>
+    Next(int64_t n);
+
+ protected:
+    // is_ip: a larger distance is a closer result
+    explicit IndexIterator(bool is_ip) : is_ip_(is_ip) {
+    }
+
+    // Finds more results and adds them through Push, wanted is the number Next still misses. Sets exhausted once the
+    // search has none left to find.
+    virtual Status
+    Refill(int64_t wanted, bool& exhausted) = 0;
+
+    // Whether a later Refill may still find a result closer than distance, the top of the heap waits until not.
+    virtual bool
+    MayFindCloser(float distance) const {
+        return false;
+    }
+
+    void
+    Push(float distance, int64_t id);
+
+    bool
+    Closer(float a, float b) const {
+        return is_ip_ ? a > b : a < b;
+    }
+
+ private:
+    bool is_ip_;
+    bool exhausted_ = false;
+    // the results found and not returned yet, a heap with the closest on top
+    std::vector<std::pair<float, int64_t>> heap_;
+};
+
+using IndexIteratorPtr = std::shared_ptr<IndexIterator>;
+
+}  // namespace knowhere
+
+#endif /* INDEX_ITERATOR_H */
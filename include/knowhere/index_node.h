@@ -12,15 +12,31 @@
 #ifndef INDEX_NODE_H
 #define INDEX_NODE_H
 
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "folly/futures/Future.h"
 #include "knowhere/binaryset.h"
 #include "knowhere/bitsetview.h"
+#include "knowhere/comp/memory_usage.h"
+#include "knowhere/comp/recall_monitor.h"
+#include "knowhere/comp/result_cache.h"
 #include "knowhere/config.h"
 #include "knowhere/dataset.h"
 #include "knowhere/expected.h"
+#include "knowhere/index_iterator.h"
 #include "knowhere/object.h"
 
 namespace knowhere {
 
+class ThreadPool;
+
+// the bytes warmed up so far and the bytes to warm up in total
+using WarmupProgress = std::function<void(int64_t done, int64_t total)>;
+
 class IndexNode : public Object {
  public:
     virtual Status
@@ -35,30 +51,87 @@ class IndexNode : public Object {
     virtual Status
     Add(const DataSet& dataset, const Config& cfg) = 0;
 
+    // Soft-deletes the ids of `dataset`, they are excluded from later searches.
+    virtual Status
+    DeleteByIds(const DataSet& dataset) {
+        return Status::not_implemented;
+    }
+
+    // Appends the rows of others, indexes of the type of this one, to it without training or building it again, e.g.
+    // to compact segments; see Index::Merge. The rows of others[i] take the ids after the ones of this index and of
+    // others[0..i). others are left as they are.
+    virtual Status
+    Merge(const std::vector<const IndexNode*>& others, const Config& cfg) {
+        return Status::not_implemented;
+    }
+
     virtual expected<DataSetPtr>
     Search(const DataSet& dataset, const Config& cfg, const BitsetView& bitset) const = 0;
 
     virtual expected<DataSetPtr>
     RangeSearch(const DataSet& dataset, const Config& cfg, const BitsetView& bitset) const = 0;
 
+    // An iterator per query of the dataset over the results of a search, see IndexIterator. The index, the dataset
+    // and the data of the bitset must outlive the iterators. An index without iterators of its own returns
+    // not_implemented, Index::AnnIterator then pages through searches of a growing k instead.
+    virtual expected<std::vector<IndexIteratorPtr>>
+    AnnIterator(const DataSet& dataset, const Config& cfg, const BitsetView& bitset) const {
+        return expected<std::vector<IndexIteratorPtr>>::Err(Status::not_implemented, "no iterator for " + Type());
+    }
+
     virtual expected<DataSetPtr>
     GetVectorByIds(const DataSet& dataset) const = 0;
 
+    // Search completing in the background on the search pool of the index, the calling thread does not wait on it. The
+    // index, the dataset, the config and the data of the bitset must outlive the future.
+    virtual folly::Future<expected<DataSetPtr>>
+    SearchAsync(const DataSet& dataset, const Config& cfg, const BitsetView& bitset) const;
+
+    // RangeSearch completing in the background, with the lifetimes of SearchAsync.
+    virtual folly::Future<expected<DataSetPtr>>
+    RangeSearchAsync(const DataSet& dataset, const Config& cfg, const BitsetView& bitset) const;
+
+    // GetVectorByIds completing in the background, so that it can run behind the next search. The index must outlive
+    // the future, the dataset need not. Indexes without an asynchronous read path complete it before returning.
+    virtual folly::Future<expected<DataSetPtr>>
+    GetVectorByIdsAsync(const DataSet& dataset) const {
+        return folly::makeFuture(GetVectorByIds(dataset));
+    }
+
     virtual bool
     HasRawData(const std::string& metric_type) const = 0;
 
+    // Whether Train, Add and the searches of the node read dense rows of the type as they are. Index converts the rows
+    // of the types a node does not read to FLOAT32 before they reach it.
+    virtual bool
+    SupportsDataType(DataType type) const {
+        return type == DataType::FLOAT32;
+    }
+
     virtual expected<DataSetPtr>
     GetIndexMeta(const Config& cfg) const = 0;
 
     virtual Status
     Serialize(BinarySet& binset) const = 0;
 
+    // Writes the sections Serialize would append to a BinarySet straight to writer as they are serialized, without
+    // a copy of the whole index in memory; see Index::SerializeToFile, which falls back to Serialize otherwise.
+    virtual Status
+    SerializeToFile(SectionWriter& writer) const {
+        return Status::not_implemented;
+    }
+
     virtual Status
     Deserialize(const BinarySet& binset, const Config& config) = 0;
 
     virtual Status
     DeserializeFromFile(const std::string& filename, const Config& config) = 0;
 
+    // Moves the searches of the index onto another pool, the one of the NUMA node its memory was loaded on.
+    virtual void
+    SetSearchPool(std::shared_ptr<ThreadPool> pool) {
+    }
+
     virtual std::unique_ptr<BaseConfig>
     CreateConfig() const = 0;
 
@@ -68,16 +141,89 @@ class IndexNode : public Object {
     virtual int64_t
     Size() const = 0;
 
+    // The memory the index holds by component and residency. Indexes that do not account for it report their Size()
+    // as heap memory of no particular component.
+    virtual MemoryUsage
+    GetMemoryUsage() const {
+        MemoryUsage usage;
+        usage.Add(MemoryUsage::kOther, MemoryUsage::kHeap, Size());
+        return usage;
+    }
+
+    // The ranges of the memory the index maps from its file, in the order a search reads them first, e.g. the upper
+    // layers of a graph before its bottom layer; none for an index held in memory.
+    virtual void
+    MappedRegions(std::vector<MappedRegion>& regions) const {
+    }
+
+    // Faults the mapped memory of the index in ahead of its searches, at most budget bytes of it in the order of
+    // MappedRegions, all of it for a budget of 0; see Index::Warmup. progress is told the bytes faulted in so far out
+    // of the ones to fault in, from any thread of the search pool but never from two at once.
+    virtual Status
+    Warmup(int64_t budget, const WarmupProgress& progress) const;
+
     virtual int64_t
     Count() const = 0;
 
     virtual std::string
     Type() const = 0;
 
+    // identifies the data of the index for the result cache: a version no index had before, renewed by Index on
+    // every change of the data, e.g. Build, Add or Deserialize, so that the results cached before are not hit again
+    uint64_t
+    DataVersion() const {
+        return data_version_.load(std::memory_order_acquire);
+    }
+
+    void
+    RenewDataVersion() {
+        data_version_.store(ResultCache::NewVersion(), std::memory_order_release);
+    }
+
+    // the table of search params by recall of Index::SetTunedParams, see comp/auto_tune.h
+    Json
+    TunedParams() const {
+        std::lock_guard<std::mutex> lock(tuned_params_mtx_);
+        return tuned_params_;
+    }
+
+    void
+    SetTunedParams(Json table) {
+        std::lock_guard<std::mutex> lock(tuned_params_mtx_);
+        tuned_params_ = std::move(table);
+    }
+
+    // the monitor of the recall of the knn searches of Index::SetRecallMonitor, null without one
+    std::shared_ptr<RecallMonitor>
+    GetRecallMonitor() const {
+        return std::atomic_load(&recall_monitor_);
+    }
+
+    void
+    SetRecallMonitor(std::shared_ptr<RecallMonitor> monitor) {
+        std::atomic_store(&recall_monitor_, std::move(monitor));
+    }
+
     virtual ~IndexNode() {
     }
+
+ protected:
+    // the pool SearchAsync and RangeSearchAsync run on, the global search pool unless the index has one of its own
+    virtual std::shared_ptr<ThreadPool>
+    AsyncSearchPool() const;
+
+ private:
+    std::atomic<uint64_t> data_version_{ResultCache::NewVersion()};
+    mutable std::mutex tuned_params_mtx_;
+    Json tuned_params_;
+    std::shared_ptr<RecallMonitor> recall_monitor_;
 };
 
+// A config of the node with the params of cfg, for a wrapper calling the node it wraps with params of its own, e.g. a
+// k of its own; the result buffers of the caller are not copied.
+std::unique_ptr<BaseConfig>
+CopyConfig(const IndexNode& node, const Config& cfg);
+
 }  // namespace knowhere
 
 #endif /* INDEX_NODE_H */
@@ -0,0 +1,184 @@
+// Copyright (C) 2019-2023 Zilliz. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file except in compliance
+// with the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
+// or implied. See the License for the specific language governing permissions and limitations under the License.
+
+#ifndef INDEX_NODE_BATCHING_WRAPPER_H
+#define INDEX_NODE_BATCHING_WRAPPER_H
+
+#include <memory>
+#include <mutex>
+
+#include "knowhere/index_node.h"
+
+namespace knowhere {
+
+// Coalesces the concurrent searches of the index into one search of all their queries, for the GPU indexes whose
+// launches only pay off with many queries. The first search waits up to the window of SetBatching for others with the
+// same params and the same filter, then runs the batch and hands each search its own rows of the results. Searches that
+// cannot join, writing into buffers of their own, cancellable or traced, and the other calls go straight through.
+class IndexNodeBatchingWrapper : public IndexNode {
+ public:
+    explicit IndexNodeBatchingWrapper(std::unique_ptr<IndexNode> index_node);
+
+    // Searches wait up to window_us microseconds for a batch of up to max_rows queries, a window of 0, the default,
+    // does not batch. It applies to all the batching indexes of the process.
+    static void
+    SetBatching(int64_t window_us, int64_t max_rows);
+
+    Status
+    Train(const DataSet& dataset, const Config& cfg) override {
+        return index_node_->Train(dataset, cfg);
+    }
+
+    Status
+    Add(const DataSet& dataset, const Config& cfg) override {
+        return index_node_->Add(dataset, cfg);
+    }
+
+    Status
+    DeleteByIds(const DataSet& dataset) override {
+        return index_node_->DeleteByIds(dataset);
+    }
+
+    // others wrapped the same way are merged by the nodes they wrap
+    Status
+    Merge(const std::vector<const IndexNode*>& others, const Config& cfg) override {
+        std::vector<const IndexNode*> nodes;
+        for (auto other : others) {
+            auto wrapper = dynamic_cast<const IndexNodeBatchingWrapper*>(other);
+            nodes.push_back(wrapper != nullptr ? wrapper->index_node_.get() : other);
+        }
+        return index_node_->Merge(nodes, cfg);
+    }
+
+    expected<DataSetPtr>
+    Search(const DataSet& dataset, const Config& cfg, const BitsetView& bitset) const override;
+
+    expected<DataSetPtr>
+    RangeSearch(const DataSet& dataset, const Config& cfg, const BitsetView& bitset) const override {
+        return index_node_->RangeSearch(dataset, cfg, bitset);
+    }
+
+    // the caller does not wait on an async search, there is nothing to gain from holding it back for others
+    folly::Future<expected<DataSetPtr>>
+    SearchAsync(const DataSet& dataset, const Config& cfg, const BitsetView& bitset) const override {
+        return index_node_->SearchAsync(dataset, cfg, bitset);
+    }
+
+    folly::Future<expected<DataSetPtr>>
+    RangeSearchAsync(const DataSet& dataset, const Config& cfg, const BitsetView& bitset) const override {
+        return index_node_->RangeSearchAsync(dataset, cfg, bitset);
+    }
+
+    expected<std::vector<IndexIteratorPtr>>
+    AnnIterator(const DataSet& dataset, const Config& cfg, const BitsetView& bitset) const override {
+        return index_node_->AnnIterator(dataset, cfg, bitset);
+    }
+
+    expected<DataSetPtr>
+    GetVectorByIds(const DataSet& dataset) const override {
+        return index_node_->GetVectorByIds(dataset);
+    }
+
+    folly::Future<expected<DataSetPtr>>
+    GetVectorByIdsAsync(const DataSet& dataset) const override {
+        return index_node_->GetVectorByIdsAsync(dataset);
+    }
+
+    bool
+    HasRawData(const std::string& metric_type) const override {
+        return index_node_->HasRawData(metric_type);
+    }
+
+    expected<DataSetPtr>
+    GetIndexMeta(const Config& cfg) const override {
+        return index_node_->GetIndexMeta(cfg);
+    }
+
+    Status
+    Serialize(BinarySet& binset) const override {
+        return index_node_->Serialize(binset);
+    }
+
+    Status
+    SerializeToFile(SectionWriter& writer) const override {
+        return index_node_->SerializeToFile(writer);
+    }
+
+    Status
+    Deserialize(const BinarySet& binset, const Config& config) override {
+        return index_node_->Deserialize(binset, config);
+    }
+
+    Status
+    DeserializeFromFile(const std::string& filename, const Config& config) override {
+        return index_node_->DeserializeFromFile(filename, config);
+    }
+
+    void
+    SetSearchPool(std::shared_ptr<ThreadPool> pool) override {
+        index_node_->SetSearchPool(std::move(pool));
+    }
+
+    std::unique_ptr<BaseConfig>
+    CreateConfig() const override {
+        return index_node_->CreateConfig();
+    }
+
+    int64_t
+    Dim() const override {
+        return index_node_->Dim();
+    }
+
+    int64_t
+    Size() const override {
+        return index_node_->Size();
+    }
+
+    MemoryUsage
+    GetMemoryUsage() const override {
+        return index_node_->GetMemoryUsage();
+    }
+
+    void
+    MappedRegions(std::vector<MappedRegion>& regions) const override {
+        index_node_->MappedRegions(regions);
+    }
+
+    Status
+    Warmup(int64_t budget, const WarmupProgress& progress) const override {
+        return index_node_->Warmup(budget, progress);
+    }
+
+    int64_t
+    Count() const override {
+        return index_node_->Count();
+    }
+
+    std::string
+    Type() const override {
+        return index_node_->Type();
+    }
+
+ private:
+    struct Batch;
+
+    expected<DataSetPtr>
+    RunBatch(Batch& batch) const;
+
+    std::unique_ptr<IndexNode> index_node_;
+    // the batch the searches arriving now join, nullptr while none is collecting
+    mutable std::mutex mutex_;
+    mutable std::shared_ptr<Batch> open_;
+};
+
+}  // namespace knowhere
+
+#endif /* INDEX_NODE_BATCHING_WRAPPER_H */
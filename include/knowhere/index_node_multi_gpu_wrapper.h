@@ -0,0 +1,148 @@
+// Copyright (C) 2019-2023 Zilliz. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file except in compliance
+// with the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
+// or implied. See the License for the specific language governing permissions and limitations under the License.
+
+#ifndef INDEX_NODE_MULTI_GPU_WRAPPER_H
+#define INDEX_NODE_MULTI_GPU_WRAPPER_H
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "knowhere/index_node.h"
+
+namespace knowhere {
+
+// Spreads a GPU index over the devices of the gpu_ids param, an index of the inner type on each. With multi_gpu_mode
+// replicated, each device holds a copy of the index built on the first one and the searches go round-robin over the
+// copies. With sharded, each device holds an index of a contiguous part of the vectors, the searches run on all the
+// shards at once and their results merge on the host. An index of a single device is the inner index as it is.
+class IndexNodeMultiGpuWrapper : public IndexNode {
+ public:
+    using NodeFactory = std::function<std::unique_ptr<IndexNode>()>;
+
+    explicit IndexNodeMultiGpuWrapper(NodeFactory make_node);
+
+    Status
+    Build(const DataSet& dataset, const Config& cfg) override;
+
+    Status
+    Train(const DataSet& dataset, const Config& cfg) override;
+
+    Status
+    Add(const DataSet& dataset, const Config& cfg) override;
+
+    Status
+    DeleteByIds(const DataSet& dataset) override;
+
+    expected<DataSetPtr>
+    Search(const DataSet& dataset, const Config& cfg, const BitsetView& bitset) const override;
+
+    expected<DataSetPtr>
+    RangeSearch(const DataSet& dataset, const Config& cfg, const BitsetView& bitset) const override;
+
+    // the shards have no iterator over all of them, Index::AnnIterator then pages through searches
+    expected<std::vector<IndexIteratorPtr>>
+    AnnIterator(const DataSet& dataset, const Config& cfg, const BitsetView& bitset) const override;
+
+    expected<DataSetPtr>
+    GetVectorByIds(const DataSet& dataset) const override;
+
+    bool
+    HasRawData(const std::string& metric_type) const override {
+        return nodes_[0]->HasRawData(metric_type);
+    }
+
+    expected<DataSetPtr>
+    GetIndexMeta(const Config& cfg) const override {
+        return nodes_[0]->GetIndexMeta(cfg);
+    }
+
+    Status
+    Serialize(BinarySet& binset) const override;
+
+    Status
+    Deserialize(const BinarySet& binset, const Config& config) override;
+
+    Status
+    DeserializeFromFile(const std::string& filename, const Config& config) override;
+
+    void
+    SetSearchPool(std::shared_ptr<ThreadPool> pool) override {
+        for (auto& node : nodes_) {
+            node->SetSearchPool(pool);
+        }
+    }
+
+    std::unique_ptr<BaseConfig>
+    CreateConfig() const override {
+        return nodes_[0]->CreateConfig();
+    }
+
+    int64_t
+    Dim() const override {
+        return nodes_[0]->Dim();
+    }
+
+    int64_t
+    Size() const override;
+
+    MemoryUsage
+    GetMemoryUsage() const override;
+
+    int64_t
+    Count() const override;
+
+    std::string
+    Type() const override {
+        return nodes_[0]->Type();
+    }
+
+ private:
+    // picks the replica of a search, the node itself without replicas
+    const IndexNode&
+    NextReplica() const {
+        return *nodes_[next_.fetch_add(1, std::memory_order_relaxed) % nodes_.size()];
+    }
+
+    bool
+    Sharded() const {
+        return sharded_ && nodes_.size() > 1;
+    }
+
+    // back to the single node of the default device
+    void
+    Reset();
+
+    Status
+    BuildShards(const DataSet& dataset, const Config& cfg, const std::vector<int64_t>& devices,
+                Status (IndexNode::*step)(const DataSet&, const Config&));
+
+    Status
+    Replicate(const std::vector<int64_t>& devices);
+
+    // the index of the shard holding the id
+    size_t
+    ShardOf(int64_t id) const;
+
+    NodeFactory make_node_;
+    // a node per device, a single one without gpu_ids
+    std::vector<std::unique_ptr<IndexNode>> nodes_;
+    std::vector<int64_t> devices_;
+    bool sharded_ = false;
+    // the id of the first vector of every shard
+    std::vector<int64_t> offsets_;
+    mutable std::atomic<size_t> next_{0};
+};
+
+}  // namespace knowhere
+
+#endif /* INDEX_NODE_MULTI_GPU_WRAPPER_H */
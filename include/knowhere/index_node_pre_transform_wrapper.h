@@ -0,0 +1,151 @@
+// Copyright (C) 2019-2023 Zilliz. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file except in compliance
+// with the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
+// or implied. See the License for the specific language governing permissions and limitations under the License.
+
+#ifndef INDEX_NODE_PRE_TRANSFORM_WRAPPER_H
+#define INDEX_NODE_PRE_TRANSFORM_WRAPPER_H
+
+#include <memory>
+
+#include "knowhere/index_node.h"
+
+namespace faiss {
+struct VectorTransform;
+}  // namespace faiss
+
+namespace knowhere {
+
+// Puts a linear transform of the float vectors in front of the index, chosen by the pre_transform param of the build:
+// a PCA, a random rotation or an OPQ rotation, to pre_transform_dim dims. The build trains the transform on its rows
+// and the index holds the transformed vectors; the rows added and the queries are transformed in batch, a GEMM, before
+// they reach it. The transform is serialized as the pre_transform binary next to the index, an index built without
+// one, or deserialized from a file of its own format, passes every call straight through.
+class IndexNodePreTransformWrapper : public IndexNode {
+ public:
+    explicit IndexNodePreTransformWrapper(std::unique_ptr<IndexNode> index_node);
+
+    ~IndexNodePreTransformWrapper() override;
+
+    Status
+    Build(const DataSet& dataset, const Config& cfg) override;
+
+    Status
+    Train(const DataSet& dataset, const Config& cfg) override;
+
+    Status
+    Add(const DataSet& dataset, const Config& cfg) override;
+
+    Status
+    DeleteByIds(const DataSet& dataset) override {
+        return index_node_->DeleteByIds(dataset);
+    }
+
+    // others wrapped the same way are merged by the nodes they wrap, they must have the very same transform
+    Status
+    Merge(const std::vector<const IndexNode*>& others, const Config& cfg) override;
+
+    expected<DataSetPtr>
+    Search(const DataSet& dataset, const Config& cfg, const BitsetView& bitset) const override;
+
+    expected<DataSetPtr>
+    RangeSearch(const DataSet& dataset, const Config& cfg, const BitsetView& bitset) const override;
+
+    folly::Future<expected<DataSetPtr>>
+    SearchAsync(const DataSet& dataset, const Config& cfg, const BitsetView& bitset) const override;
+
+    folly::Future<expected<DataSetPtr>>
+    RangeSearchAsync(const DataSet& dataset, const Config& cfg, const BitsetView& bitset) const override;
+
+    // the iterators would outlive the transformed queries, Index::AnnIterator then pages through searches
+    expected<std::vector<IndexIteratorPtr>>
+    AnnIterator(const DataSet& dataset, const Config& cfg, const BitsetView& bitset) const override;
+
+    // the vectors of a transform that keeps the dim are transformed back, the others are not implemented
+    expected<DataSetPtr>
+    GetVectorByIds(const DataSet& dataset) const override;
+
+    // the vectors transformed back are off by rounding, only an index without a transform has raw data
+    bool
+    HasRawData(const std::string& metric_type) const override {
+        return transform_ == nullptr && index_node_->HasRawData(metric_type);
+    }
+
+    expected<DataSetPtr>
+    GetIndexMeta(const Config& cfg) const override {
+        return index_node_->GetIndexMeta(cfg);
+    }
+
+    Status
+    Serialize(BinarySet& binset) const override;
+
+    Status
+    SerializeToFile(SectionWriter& writer) const override;
+
+    Status
+    Deserialize(const BinarySet& binset, const Config& config) override;
+
+    Status
+    DeserializeFromFile(const std::string& filename, const Config& config) override;
+
+    void
+    SetSearchPool(std::shared_ptr<ThreadPool> pool) override {
+        index_node_->SetSearchPool(std::move(pool));
+    }
+
+    std::unique_ptr<BaseConfig>
+    CreateConfig() const override {
+        return index_node_->CreateConfig();
+    }
+
+    int64_t
+    Dim() const override;
+
+    int64_t
+    Size() const override;
+
+    MemoryUsage
+    GetMemoryUsage() const override;
+
+    void
+    MappedRegions(std::vector<MappedRegion>& regions) const override {
+        index_node_->MappedRegions(regions);
+    }
+
+    Status
+    Warmup(int64_t budget, const WarmupProgress& progress) const override {
+        return index_node_->Warmup(budget, progress);
+    }
+
+    int64_t
+    Count() const override {
+        return index_node_->Count();
+    }
+
+    std::string
+    Type() const override {
+        return index_node_->Type();
+    }
+
+ private:
+    // trains the transform of the pre_transform params on the rows, none for NONE
+    Status
+    TrainTransform(const DataSet& dataset, const Config& cfg);
+
+    // the rows transformed, in a dataset that owns them
+    DataSetPtr
+    Transform(const DataSet& dataset) const;
+
+    std::unique_ptr<IndexNode> index_node_;
+    std::unique_ptr<faiss::VectorTransform> transform_;
+};
+
+}  // namespace knowhere
+
+#endif /* INDEX_NODE_PRE_TRANSFORM_WRAPPER_H */
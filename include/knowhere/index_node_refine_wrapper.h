@@ -0,0 +1,168 @@
+// Copyright (C) 2019-2023 Zilliz. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file except in compliance
+// with the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
+// or implied. See the License for the specific language governing permissions and limitations under the License.
+
+#ifndef INDEX_NODE_REFINE_WRAPPER_H
+#define INDEX_NODE_REFINE_WRAPPER_H
+
+#include <memory>
+
+#include "knowhere/comp/raw_vector_store.h"
+#include "knowhere/index_node.h"
+
+namespace knowhere {
+
+// Reranks the candidates of an index of approximate distances by their exact ones. With the rerank_store param of the
+// build, FP32 or FP16, the wrapper keeps the raw vectors of the rows by their internal ids; a search asks the index
+// for rerank_ratio times k candidates, computes their distances to the rows of the store, gathered in the order of
+// the ids so that the reads go page by page, and keeps the closest k. A range search keeps the hits of the index that
+// are in range by their exact distances. The store is serialized as the rerank_store binary next to the index and a
+// knowhere index file loaded with enable_mmap reads it in place from the mapping; an index built without one, or
+// deserialized from a file of its own format, passes every call straight through. An FP32 store built from a dataset
+// of a RawVectorStore is that store rather than a copy of its rows, until an Add appends to it.
+class IndexNodeRefineWrapper : public IndexNode {
+ public:
+    explicit IndexNodeRefineWrapper(std::unique_ptr<IndexNode> index_node);
+
+    ~IndexNodeRefineWrapper() override;
+
+    Status
+    Build(const DataSet& dataset, const Config& cfg) override;
+
+    Status
+    Train(const DataSet& dataset, const Config& cfg) override;
+
+    Status
+    Add(const DataSet& dataset, const Config& cfg) override;
+
+    Status
+    DeleteByIds(const DataSet& dataset) override {
+        return index_node_->DeleteByIds(dataset);
+    }
+
+    // the stores of others wrapped the same way follow this one, as their rows follow its rows in the merged index
+    Status
+    Merge(const std::vector<const IndexNode*>& others, const Config& cfg) override;
+
+    expected<DataSetPtr>
+    Search(const DataSet& dataset, const Config& cfg, const BitsetView& bitset) const override;
+
+    expected<DataSetPtr>
+    RangeSearch(const DataSet& dataset, const Config& cfg, const BitsetView& bitset) const override;
+
+    // the iterators of the index, by its approximate distances
+    expected<std::vector<IndexIteratorPtr>>
+    AnnIterator(const DataSet& dataset, const Config& cfg, const BitsetView& bitset) const override {
+        return index_node_->AnnIterator(dataset, cfg, bitset);
+    }
+
+    // the vectors of an FP32 store come from it, as a view of the store when the ids are consecutive, the others from
+    // the index
+    expected<DataSetPtr>
+    GetVectorByIds(const DataSet& dataset) const override;
+
+    bool
+    HasRawData(const std::string& metric_type) const override;
+
+    expected<DataSetPtr>
+    GetIndexMeta(const Config& cfg) const override {
+        return index_node_->GetIndexMeta(cfg);
+    }
+
+    Status
+    Serialize(BinarySet& binset) const override;
+
+    Status
+    SerializeToFile(SectionWriter& writer) const override;
+
+    Status
+    Deserialize(const BinarySet& binset, const Config& config) override;
+
+    Status
+    DeserializeFromFile(const std::string& filename, const Config& config) override;
+
+    void
+    SetSearchPool(std::shared_ptr<ThreadPool> pool) override;
+
+    std::unique_ptr<BaseConfig>
+    CreateConfig() const override {
+        return index_node_->CreateConfig();
+    }
+
+    int64_t
+    Dim() const override {
+        return index_node_->Dim();
+    }
+
+    int64_t
+    Size() const override;
+
+    MemoryUsage
+    GetMemoryUsage() const override;
+
+    // the regions of the index, then the store when it is mapped
+    void
+    MappedRegions(std::vector<MappedRegion>& regions) const override;
+
+    int64_t
+    Count() const override {
+        return index_node_->Count();
+    }
+
+    std::string
+    Type() const override {
+        return index_node_->Type();
+    }
+
+ private:
+    enum class StoreType { kNone = 0, kFp32 = 1, kFp16 = 2 };
+
+    void
+    ClearStore();
+
+    // an empty store of the rerank_store param, for the rows of the dataset
+    Status
+    ResetStore(const DataSet& dataset, const Config& cfg);
+
+    // whether the rows of the dataset fit the store
+    Status
+    CheckRows(const DataSet& dataset) const;
+
+    // the rows of the dataset at the end of the store, in its type
+    void
+    AppendRows(const DataSet& dataset);
+
+    // room for n more rows at the end of the store, copying a store shared or mapped into memory first
+    uint8_t*
+    GrowStore(int64_t n);
+
+    size_t
+    RowSize() const;
+
+    const uint8_t*
+    StoreData() const;
+
+    // the exact distances of the query to the n rows of ids, sorted ascending
+    void
+    ComputeDistances(const float* query, const uint32_t* ids, size_t n, bool is_ip, bool is_cosine,
+                     float* distances) const;
+
+    std::unique_ptr<IndexNode> index_node_;
+    std::shared_ptr<ThreadPool> search_pool_;
+    StoreType store_type_ = StoreType::kNone;
+    int64_t store_dim_ = 0;
+    int64_t store_rows_ = 0;
+    // held in memory, mapped from the binary it was read from, or the store of the rows built from
+    std::shared_ptr<const RawVectorStore> store_;
+};
+
+}  // namespace knowhere
+
+#endif /* INDEX_NODE_REFINE_WRAPPER_H */
@@ -12,43 +12,75 @@
 #ifndef INDEX_NODE_THREAD_POOL_WRAPPER_H
 #define INDEX_NODE_THREAD_POOL_WRAPPER_H
 
+#include "knowhere/comp/task_scheduler.h"
 #include "knowhere/index_node.h"
 
 namespace knowhere {
 
 class ThreadPool;
+// Runs the searches of the index on a pool of its own, admitted by the global task scheduler as task_class. The
+// builds stay on the calling thread, admitted as TaskClass::BUILD. A rejected call fails with too_many_requests.
 class IndexNodeThreadPoolWrapper : public IndexNode {
  public:
-    IndexNodeThreadPoolWrapper(std::unique_ptr<IndexNode> index_node, size_t pool_size);
+    IndexNodeThreadPoolWrapper(std::unique_ptr<IndexNode> index_node, size_t pool_size,
+                               TaskClass task_class = TaskClass::INTERACTIVE);
 
-    IndexNodeThreadPoolWrapper(std::unique_ptr<IndexNode> index_node, std::shared_ptr<ThreadPool> thread_pool);
+    IndexNodeThreadPoolWrapper(std::unique_ptr<IndexNode> index_node, std::shared_ptr<ThreadPool> thread_pool,
+                               TaskClass task_class = TaskClass::INTERACTIVE);
 
     Status
-    Train(const DataSet& dataset, const Config& cfg) override {
-        return index_node_->Train(dataset, cfg);
-    }
+    Train(const DataSet& dataset, const Config& cfg) override;
+
+    Status
+    Add(const DataSet& dataset, const Config& cfg) override;
 
     Status
-    Add(const DataSet& dataset, const Config& cfg) override {
-        return index_node_->Add(dataset, cfg);
+    DeleteByIds(const DataSet& dataset) override {
+        return index_node_->DeleteByIds(dataset);
     }
 
+    // others wrapped the same way are merged by the nodes they wrap
+    Status
+    Merge(const std::vector<const IndexNode*>& others, const Config& cfg) override;
+
     expected<DataSetPtr>
     Search(const DataSet& dataset, const Config& cfg, const BitsetView& bitset) const override;
 
     expected<DataSetPtr>
     RangeSearch(const DataSet& dataset, const Config& cfg, const BitsetView& bitset) const override;
 
+    folly::Future<expected<DataSetPtr>>
+    SearchAsync(const DataSet& dataset, const Config& cfg, const BitsetView& bitset) const override;
+
+    folly::Future<expected<DataSetPtr>>
+    RangeSearchAsync(const DataSet& dataset, const Config& cfg, const BitsetView& bitset) const override;
+
+    // the batches of the iterators run on the calling thread, each is a fraction of a search
+    expected<std::vector<IndexIteratorPtr>>
+    AnnIterator(const DataSet& dataset, const Config& cfg, const BitsetView& bitset) const override {
+        return index_node_->AnnIterator(dataset, cfg, bitset);
+    }
+
     expected<DataSetPtr>
     GetVectorByIds(const DataSet& dataset) const override {
         return index_node_->GetVectorByIds(dataset);
     }
 
+    folly::Future<expected<DataSetPtr>>
+    GetVectorByIdsAsync(const DataSet& dataset) const override {
+        return index_node_->GetVectorByIdsAsync(dataset);
+    }
+
     bool
     HasRawData(const std::string& metric_type) const override {
         return index_node_->HasRawData(metric_type);
     }
 
+    bool
+    SupportsDataType(DataType type) const override {
+        return index_node_->SupportsDataType(type);
+    }
+
     expected<DataSetPtr>
     GetIndexMeta(const Config& cfg) const override {
         return index_node_->GetIndexMeta(cfg);
@@ -59,6 +91,11 @@ class IndexNodeThreadPoolWrapper : public IndexNode {
         return index_node_->Serialize(binset);
     }
 
+    Status
+    SerializeToFile(SectionWriter& writer) const override {
+        return index_node_->SerializeToFile(writer);
+    }
+
     Status
     Deserialize(const BinarySet& binset, const Config& config) override {
         return index_node_->Deserialize(binset, config);
@@ -69,6 +106,11 @@ class IndexNodeThreadPoolWrapper : public IndexNode {
         return index_node_->DeserializeFromFile(filename, config);
     }
 
+    void
+    SetSearchPool(std::shared_ptr<ThreadPool> pool) override {
+        index_node_->SetSearchPool(std::move(pool));
+    }
+
     std::unique_ptr<BaseConfig>
     CreateConfig() const override {
         return index_node_->CreateConfig();
@@ -84,6 +126,21 @@ class IndexNodeThreadPoolWrapper : public IndexNode {
         return index_node_->Size();
     }
 
+    MemoryUsage
+    GetMemoryUsage() const override {
+        return index_node_->GetMemoryUsage();
+    }
+
+    void
+    MappedRegions(std::vector<MappedRegion>& regions) const override {
+        index_node_->MappedRegions(regions);
+    }
+
+    Status
+    Warmup(int64_t budget, const WarmupProgress& progress) const override {
+        return index_node_->Warmup(budget, progress);
+    }
+
     int64_t
     Count() const override {
         return index_node_->Count();
@@ -97,6 +154,7 @@ class IndexNodeThreadPoolWrapper : public IndexNode {
  private:
     std::unique_ptr<IndexNode> index_node_;
     std::shared_ptr<ThreadPool> thread_pool_;
+    TaskClass task_class_;
 };
 
 }  // namespace knowhere
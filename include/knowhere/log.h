@@ -18,8 +18,13 @@
 #include <sys/prctl.h>
 #endif
 
+#include <atomic>
+#include <chrono>
 #include <cstdarg>
+#include <cstdint>
 #include <memory>
+#include <sstream>
+#include <string>
 
 #include "glog/logging.h"
 #define KNOWHERE_MODULE_NAME "KNOWHERE"
@@ -31,12 +36,135 @@
 
 #define LOG_KNOWHERE_TRACE_ DLOG(INFO) << KNOWHERE_MODULE_FUNCTION
 #define LOG_KNOWHERE_DEBUG_ DLOG(INFO) << KNOWHERE_MODULE_FUNCTION
-#define LOG_KNOWHERE_INFO_ LOG(INFO) << KNOWHERE_MODULE_FUNCTION
-#define LOG_KNOWHERE_WARNING_ LOG(WARNING) << KNOWHERE_MODULE_FUNCTION
-#define LOG_KNOWHERE_ERROR_ LOG(ERROR) << KNOWHERE_MODULE_FUNCTION
-#define LOG_KNOWHERE_FATAL_ LOG(FATAL) << KNOWHERE_MODULE_FUNCTION
+
+// The site of a log statement if it may log now, see LogSite, else null: the statement then formats nothing.
+#define KNOWHERE_LOG_GATE_()                                             \
+    ([]() -> knowhere::LogSite* {                                        \
+        static knowhere::LogSite knowhere_log_site(__FILE__, __LINE__);  \
+        return knowhere_log_site.Allow() ? &knowhere_log_site : nullptr; \
+    }())
+
+// A log statement of level queued for the log thread rather than written by the calling one, see AsyncLogMessage.
+#define KNOWHERE_ASYNC_LOG_(level)                                                          \
+    for (auto knowhere_log_site_ = KNOWHERE_LOG_GATE_(); knowhere_log_site_ != nullptr; \
+         knowhere_log_site_ = nullptr)                                                  \
+    knowhere::AsyncLogMessage(*knowhere_log_site_, level).stream()
+
+#define LOG_KNOWHERE_INFO_ KNOWHERE_ASYNC_LOG_(knowhere::LogLevel::kInfo) << KNOWHERE_MODULE_FUNCTION
+#define LOG_KNOWHERE_WARNING_ KNOWHERE_ASYNC_LOG_(knowhere::LogLevel::kWarning) << KNOWHERE_MODULE_FUNCTION
+#define LOG_KNOWHERE_ERROR_ KNOWHERE_ASYNC_LOG_(knowhere::LogLevel::kError) << KNOWHERE_MODULE_FUNCTION
+// a fatal message is written at once, after the ones queued before it
+#define LOG_KNOWHERE_FATAL_ (knowhere::FlushLogs(), LOG(FATAL)) << KNOWHERE_MODULE_FUNCTION
 
 namespace knowhere {
+
+enum class LogLevel : int {
+    kInfo = 0,
+    kWarning,
+    kError,
+};
+
+/**
+ * A log statement of the LOG_KNOWHERE_* macros, one per line of the code. It logs at most the messages of
+ * SetLogRateLimit per second, the ones past them are suppressed, counted, and not formatted at all; the next message
+ * of the site tells how many of its messages went before. A storm of failing searches thus costs every search two
+ * atomic operations rather than the formatting and the IO of its message.
+ */
+class LogSite {
+ public:
+    LogSite(const char* file, int line) : file_(file), line_(line) {
+    }
+
+    bool
+    Allow() {
+        auto limit = RateLimit().load(std::memory_order_relaxed);
+        if (limit <= 0) {
+            return true;
+        }
+        auto since_epoch = std::chrono::steady_clock::now().time_since_epoch();
+        int64_t now = std::chrono::duration_cast<std::chrono::seconds>(since_epoch).count();
+        auto window = window_.load(std::memory_order_relaxed);
+        if (window != now && window_.compare_exchange_strong(window, now, std::memory_order_relaxed)) {
+            logged_.store(0, std::memory_order_relaxed);
+        }
+        if (logged_.fetch_add(1, std::memory_order_relaxed) < limit) {
+            return true;
+        }
+        suppressed_.fetch_add(1, std::memory_order_relaxed);
+        SuppressedCount().fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    // the messages of the site suppressed since the last one logged, reset by the call
+    int64_t
+    TakeSuppressed() {
+        return suppressed_.exchange(0, std::memory_order_relaxed);
+    }
+
+    const char*
+    file() const {
+        return file_;
+    }
+
+    int
+    line() const {
+        return line_;
+    }
+
+    // the messages per second of a site, 0 for no limit
+    static std::atomic<int64_t>&
+    RateLimit();
+
+    // the messages of all the sites suppressed so far
+    static std::atomic<int64_t>&
+    SuppressedCount();
+
+ private:
+    const char* file_;
+    int line_;
+    std::atomic<int64_t> window_{0};
+    std::atomic<int64_t> logged_{0};
+    std::atomic<int64_t> suppressed_{0};
+};
+
+/**
+ * A message of a log statement, formatted by the calling thread and queued at the end of the statement for the log
+ * thread, which writes it through glog with the file and line of the site. The queue is a bounded lock-free ring:
+ * nothing a search logs waits for the glog mutex or the IO, a message that finds the ring full is dropped and
+ * counted instead.
+ */
+class AsyncLogMessage {
+ public:
+    AsyncLogMessage(LogSite& site, LogLevel level);
+
+    ~AsyncLogMessage();
+
+    std::ostream&
+    stream() {
+        return stream_;
+    }
+
+ private:
+    LogSite& site_;
+    LogLevel level_;
+    std::ostringstream stream_;
+};
+
+// the messages per second of every log site, 0 for no limit; 10 by default
+void
+SetLogRateLimit(int64_t messages_per_second);
+
+// waits until the log thread has written the messages queued so far
+void
+FlushLogs();
+
+// the messages suppressed by the rate limit and dropped on a full queue so far
+int64_t
+LogSuppressedCount();
+
+int64_t
+LogDroppedCount();
+
 class KnowhereException : public std::exception {
  public:
     explicit KnowhereException(std::string msg);
@@ -19,9 +19,11 @@
 #include <prometheus/summary.h>
 #include <prometheus/text_serializer.h>
 
+#include <chrono>
 #include <memory>
 #include <string>
 
+#include "knowhere/comp/query_stats.h"
 #include "knowhere/log.h"
 
 namespace knowhere {
@@ -70,6 +72,21 @@ extern const std::unique_ptr<PrometheusClient> prometheusClient;
         prometheus::BuildHistogram().Name(#name).Help(desc).Register(knowhere::prometheusClient->GetRegistry()); \
     prometheus::Histogram& name = name##_family.Add({}, knowhere::buckets);
 
+// a family of histograms told apart by their labels, see the Get*Histogram() functions
+#define DEFINE_PROMETHEUS_HISTOGRAM_FAMILY(name, desc)                                                           \
+    prometheus::Family<prometheus::Histogram>& name =                                                            \
+        prometheus::BuildHistogram().Name(#name).Help(desc).Register(knowhere::prometheusClient->GetRegistry());
+
+// a family of counters told apart by their labels, see the Get*Counter() functions
+#define DEFINE_PROMETHEUS_COUNTER_FAMILY(name, desc)                                                           \
+    prometheus::Family<prometheus::Counter>& name =                                                            \
+        prometheus::BuildCounter().Name(#name).Help(desc).Register(knowhere::prometheusClient->GetRegistry());
+
+// a family of gauges told apart by their labels, see the Get*Gauge() functions
+#define DEFINE_PROMETHEUS_GAUGE_FAMILY(name, desc)                                                           \
+    prometheus::Family<prometheus::Gauge>& name =                                                            \
+        prometheus::BuildGauge().Name(#name).Help(desc).Register(knowhere::prometheusClient->GetRegistry());
+
 #define DECLARE_PROMETHEUS_GAUGE(name_gauge) extern prometheus::Gauge& name_gauge;
 #define DECLARE_PROMETHEUS_COUNTER(name_counter) extern prometheus::Counter& name_counter;
 #define DECLARE_PROMETHEUS_HISTOGRAM(name_histogram) extern prometheus::Histogram& name_histogram;
@@ -80,4 +97,67 @@ DECLARE_PROMETHEUS_COUNTER(knowhere_range_search_count);
 DECLARE_PROMETHEUS_HISTOGRAM(knowhere_search_topk);
 DECLARE_PROMETHEUS_HISTOGRAM(knowhere_search_latency);
 DECLARE_PROMETHEUS_HISTOGRAM(knowhere_range_search_latency);
+DECLARE_PROMETHEUS_GAUGE(knowhere_diskann_sector_pool_bytes);
+DECLARE_PROMETHEUS_GAUGE(knowhere_diskann_sector_pool_borrowed_bytes);
+DECLARE_PROMETHEUS_COUNTER(knowhere_diskann_sector_pool_waits);
+DECLARE_PROMETHEUS_COUNTER(knowhere_diskann_sector_pool_remote_borrows);
+
+// the latency of an operation of an index type in ms, op is one of build, train, add, search and range_search
+prometheus::Histogram&
+GetOpLatencyHistogram(const std::string& index_type, const std::string& op);
+
+// the time the tasks of the thread pools named pool wait in their queue, see ThreadPool
+prometheus::Histogram&
+ThreadPoolQueueWaitHistogram(const std::string& pool);
+
+void
+ObserveQueueWait(prometheus::Histogram& histogram, std::chrono::steady_clock::time_point enqueued);
+
+// The histograms of the work of the queries of an index type, a node looks them up once per search and observes the
+// QueryStats of each of its queries.
+struct QueryMetrics {
+    prometheus::Histogram& hops;
+    prometheus::Histogram& distance_computations;
+    prometheus::Histogram& lists_scanned;
+    prometheus::Histogram& codes_scanned;
+    prometheus::Histogram& ios;
+    prometheus::Histogram& cache_hits;
+    prometheus::Histogram& bytes_read;
+
+    // the counters of the kinds of search the query ran: graph if it made hops, IVF if it scanned lists, disk if it
+    // read or hit the cache
+    void
+    Observe(const QueryStats& stats) const;
+};
+
+const QueryMetrics&
+GetQueryMetrics(const std::string& index_type);
+
+// the recall@k of the searches of an index that a RecallMonitor measures, index the label of the monitor
+prometheus::Gauge&
+GetSearchRecallGauge(const std::string& index);
+
+// The metrics of the GPU searches of an index type, see GpuStageTimer: the device time of their stages in us, the host
+// time they wait for the device in us, and the bytes they copy each way, those of the builds included.
+struct GpuMetrics {
+    prometheus::Histogram& h2d_latency;
+    prometheus::Histogram& kernel_latency;
+    prometheus::Histogram& slice_latency;
+    prometheus::Histogram& d2h_latency;
+    prometheus::Histogram& sync_wait;
+    prometheus::Counter& h2d_bytes;
+    prometheus::Counter& d2h_bytes;
+};
+
+const GpuMetrics&
+GetGpuMetrics(const std::string& index_type);
+
+// the bytes of the GPU memory pool named pool of a device, kind is reserved for the bytes the pool holds and used for
+// the ones allocated out of it
+prometheus::Gauge&
+GetGpuPoolBytesGauge(int64_t device, const std::string& pool, const std::string& kind);
+
+// the faiss resources of a device that GPUResMgr has handed out and not got back
+prometheus::Gauge&
+GetGpuResourcesInUseGauge(int64_t device);
 }  // namespace knowhere
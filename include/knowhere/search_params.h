@@ -0,0 +1,93 @@
+// Copyright (C) 2019-2023 Zilliz. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file except in compliance
+// with the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
+// or implied. See the License for the specific language governing permissions and limitations under the License.
+
+#ifndef SEARCH_PARAMS_H
+#define SEARCH_PARAMS_H
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "knowhere/config.h"
+
+namespace knowhere {
+
+/**
+ * @brief The config of the searches, or of the range searches, of an index type parsed and checked once, see
+ * Index::PrepareSearch. A search with the params leases a config parsed from their json rather than parsing the json
+ * again; the params keep the configs of the searches done with them for the next ones, as many as ran at once. The
+ * params may be shared by the searches of any thread and any index of their type.
+ */
+class SearchParams {
+ public:
+    SearchParams(std::string index_type, PARAM_TYPE param_type, Json json);
+
+    const std::string&
+    IndexType() const {
+        return index_type_;
+    }
+
+    PARAM_TYPE
+    ParamType() const {
+        return param_type_;
+    }
+
+    const Json&
+    GetJson() const {
+        return json_;
+    }
+
+    // the hash of the json, see ResultCache::HashConfig
+    uint64_t
+    ConfigHash() const {
+        return config_hash_;
+    }
+
+    // a config kept by the params, nullptr when all of them are leased. Released, it goes back to the params with the
+    // fields a search sets cleared, e.g. its cancellation and result buffers.
+    std::shared_ptr<BaseConfig>
+    Lease() const;
+
+    // leases cfg, a config just parsed from the json of the params, which keep it once released
+    std::shared_ptr<BaseConfig>
+    Lease(std::unique_ptr<BaseConfig> cfg) const;
+
+    /**
+     * The params of the json in the search params cache, created on a miss, nullptr when the cache is disabled. The
+     * cache keeps the params of up to `capacity` jsons, evicting the ones not searched with lately, for the searches
+     * given a json rather than params; such a search then only dumps the json to look its params up. The default
+     * capacity of 0 disables it, see KnowhereConfig::SetSearchParamsCache.
+     */
+    static std::shared_ptr<SearchParams>
+    Cached(const std::string& index_type, PARAM_TYPE param_type, const Json& json);
+
+    static void
+    SetCacheCapacity(size_t capacity);
+
+ private:
+    struct Pool {
+        std::mutex mtx;
+        std::vector<std::unique_ptr<BaseConfig>> configs;
+    };
+
+    std::string index_type_;
+    PARAM_TYPE param_type_;
+    Json json_;
+    uint64_t config_hash_;
+    std::shared_ptr<Pool> pool_;
+};
+
+using SearchParamsPtr = std::shared_ptr<SearchParams>;
+
+}  // namespace knowhere
+
+#endif /* SEARCH_PARAMS_H */
@@ -32,12 +32,25 @@ NormalizeVec(float* x, int32_t d);
 extern std::vector<float>
 NormalizeVecs(float* x, size_t rows, int32_t dim);
 
+// NormalizeVecs on the build pool, for the rows of a build; the searches normalize their queries with NormalizeVecs
+// in the thread they run in
+extern std::vector<float>
+ParallelNormalizeVecs(float* x, size_t rows, int32_t dim);
+
 extern void
 Normalize(const DataSet& dataset);
 
 std::unique_ptr<float[]>
 CopyAndNormalizeFloatVec(const float* x, int32_t dim);
 
+// n components of the type to floats
+extern void
+ConvertToFloat(const void* x, DataType type, size_t n, float* out);
+
+// the dense rows of the dataset converted to FLOAT32, with a copy of its ids and norms, in a dataset that owns them
+extern DataSetPtr
+ConvertToFloat(const DataSet& dataset);
+
 constexpr inline uint64_t seed = 0xc70f6907UL;
 
 inline uint64_t
@@ -14,11 +14,16 @@ def CreateBitSet(bits_num):
 def ArrayToDataSet(arr):
     if arr.ndim == 1:
         return swigknowhere.Array2DataSetIds(arr)
-    if arr.ndim == 2:
+    if arr.ndim == 2 and arr.dtype in (np.int32, np.float32):
+        # the tensor of the dataset is the buffer of the array, no copy is made for a contiguous one: the dataset
+        # holds the array
+        arr = np.ascontiguousarray(arr)
         if arr.dtype == np.int32:
-            return swigknowhere.Array2DataSetI(arr)
-        if arr.dtype == np.float32:
-            return swigknowhere.Array2DataSetF(arr)
+            ds = swigknowhere.Array2DataSetI(arr)
+        else:
+            ds = swigknowhere.Array2DataSetF(arr)
+        ds._array = arr
+        return ds
     raise ValueError(
         """
         ArrayToDataSet only support numpy array dtype float32 and int32.
@@ -73,3 +78,51 @@ def GetVectorDataSetToArray(ans):
     data = np.zeros([rows, dim]).astype(np.float32)
     swigknowhere.DataSetTensor2Array(ans, data)
     return data
+
+
+def DataSetToArrayView(ans):
+    """The distances and the int64 ids of a knn search, read only views over the buffers of the result."""
+    return swigknowhere.DataSetDistanceView(ans), swigknowhere.DataSetIdsView(ans)
+
+
+def RangeSearchDataSetToArrayView(ans):
+    """The distances and the ids of every query of a range search, read only views over the buffers of the result."""
+    lims = swigknowhere.DataSetLimsView(ans)
+    dis = swigknowhere.DataSetDistanceView(ans)
+    ids = swigknowhere.DataSetIdsView(ans)
+    rows = len(lims) - 1
+    return (
+        [dis[lims[i] : lims[i + 1]] for i in range(rows)],
+        [ids[lims[i] : lims[i + 1]] for i in range(rows)],
+    )
+
+
+def GetVectorDataSetToArrayView(ans):
+    """The float vectors of GetVectorByIds, a read only view over the tensor of the result."""
+    return swigknowhere.DataSetTensorView(ans)
+
+
+class SearchFuture:
+    """A search running in the background, see SearchAsync: result() waits for it."""
+
+    def __init__(self, fut, *refs):
+        self._fut = fut
+        # the query arrays and the bitset stay alive until the search is done
+        self._refs = refs
+        self._result = None
+
+    def done(self):
+        return self._result is not None or self._fut.Ready()
+
+    def result(self):
+        if self._result is None:
+            self._result = self._fut.Get()
+            self._refs = None
+        return self._result
+
+
+def SearchAsync(idx, dataset, config, bitset=None):
+    """Starts a search of dataset on idx and returns at once, a SearchFuture whose result() is the (DataSet, Status)
+    pair Search returns. Many searches may be in flight at once, bitset is a BitSet or None."""
+    view = bitset.GetBitSetView() if bitset is not None else GetNullBitSetView()
+    return SearchFuture(idx.SearchAsync(dataset, config, view), dataset, bitset)
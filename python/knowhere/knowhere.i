@@ -94,6 +94,8 @@ del Enum
    $1 = &default_json_str;
 %}
 
+%newobject IndexWrap::SearchAsync;
+
 %inline %{
 
 class GILReleaser {
@@ -106,6 +108,42 @@ public:
     PyThreadState* save;
 };
 
+class SearchFuture {
+ public:
+#ifndef SWIG
+    SearchFuture(folly::Future<knowhere::expected<knowhere::DataSetPtr>>&& fut, knowhere::DataSetPtr dataset)
+        : fut_(std::move(fut)), dataset_(std::move(dataset)) {
+    }
+#endif
+
+    bool
+    Ready() {
+        return fut_.isReady();
+    }
+
+    // waits for the search, once: the future is spent then
+    knowhere::DataSetPtr
+    Get(knowhere::Status& status) {
+        GILReleaser rel;
+        if (!fut_.valid()) {
+            status = knowhere::Status::invalid_args;
+            return nullptr;
+        }
+        auto res = std::move(fut_).get();
+        dataset_ = nullptr;
+        if (res.has_value()) {
+            status = knowhere::Status::success;
+            return res.value();
+        }
+        status = res.error();
+        return nullptr;
+    }
+
+ private:
+    folly::Future<knowhere::expected<knowhere::DataSetPtr>> fut_;
+    knowhere::DataSetPtr dataset_;
+};
+
 class IndexWrap {
  public:
     IndexWrap(const std::string& name) {
@@ -150,6 +188,14 @@ class IndexWrap {
         }
     }
 
+    // the search runs on the search pool of knowhere, the GIL is not held meanwhile; the data of the bitset must
+    // outlive the future, the dataset is held by it
+    SearchFuture*
+    SearchAsync(knowhere::DataSetPtr dataset, const std::string& json, const knowhere::BitsetView& bitset) {
+        GILReleaser rel;
+        return new SearchFuture(idx.SearchAsync(*dataset, knowhere::Json::parse(json), bitset), dataset);
+    }
+
     knowhere::DataSetPtr
     RangeSearch(knowhere::DataSetPtr dataset, const std::string& json, const knowhere::BitsetView& bitset, knowhere::Status& status){
         GILReleaser rel;
@@ -294,6 +340,57 @@ knowhere::DataSetPtr GetNullDataSet() {
     return nullptr;
 }
 
+// A read only NumPy array over a buffer of result, which the array holds until it goes away, so no copy is made.
+PyObject*
+DataSetBufferView(knowhere::DataSetPtr result, const void* data, int type, int64_t rows, int64_t dim) {
+    npy_intp dims[2] = {static_cast<npy_intp>(rows), static_cast<npy_intp>(dim)};
+    int nd = dim < 0 ? 1 : 2;
+    auto arr = PyArray_SimpleNewFromData(nd, dims, type, const_cast<void*>(data));
+    if (arr == nullptr) {
+        return nullptr;
+    }
+    auto holder = PyCapsule_New(new knowhere::DataSetPtr(std::move(result)), nullptr, [](PyObject* capsule) {
+        delete static_cast<knowhere::DataSetPtr*>(PyCapsule_GetPointer(capsule, nullptr));
+    });
+    if (holder == nullptr || PyArray_SetBaseObject(reinterpret_cast<PyArrayObject*>(arr), holder) != 0) {
+        Py_XDECREF(holder);
+        Py_DECREF(arr);
+        return nullptr;
+    }
+    PyArray_CLEARFLAGS(reinterpret_cast<PyArrayObject*>(arr), NPY_ARRAY_WRITEABLE);
+    return arr;
+}
+
+// the ids and the distances of a knn search, rows by k, or of a range search, flat over the lims
+PyObject*
+DataSetIdsView(knowhere::DataSetPtr result) {
+    auto lims = result->GetLims();
+    if (lims != nullptr) {
+        return DataSetBufferView(result, result->GetIds(), NPY_INT64, lims[result->GetRows()], -1);
+    }
+    return DataSetBufferView(result, result->GetIds(), NPY_INT64, result->GetRows(), result->GetDim());
+}
+
+PyObject*
+DataSetDistanceView(knowhere::DataSetPtr result) {
+    auto lims = result->GetLims();
+    if (lims != nullptr) {
+        return DataSetBufferView(result, result->GetDistance(), NPY_FLOAT32, lims[result->GetRows()], -1);
+    }
+    return DataSetBufferView(result, result->GetDistance(), NPY_FLOAT32, result->GetRows(), result->GetDim());
+}
+
+PyObject*
+DataSetLimsView(knowhere::DataSetPtr result) {
+    static_assert(sizeof(size_t) == sizeof(uint64_t), "lims are 64 bit");
+    return DataSetBufferView(result, result->GetLims(), NPY_UINT64, result->GetRows() + 1, -1);
+}
+
+PyObject*
+DataSetTensorView(knowhere::DataSetPtr result) {
+    return DataSetBufferView(result, result->GetTensor(), NPY_FLOAT32, result->GetRows(), result->GetDim());
+}
+
 void
 DataSet2Array(knowhere::DataSetPtr result, float* dis, int nq_1, int k_1, int* ids, int nq_2, int k_2) {
     GILReleaser rel;
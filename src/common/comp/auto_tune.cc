@@ -0,0 +1,148 @@
+// Copyright (C) 2019-2023 Zilliz. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file except in compliance
+// with the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
+// or implied. See the License for the specific language governing permissions and limitations under the License.
+
+#include "knowhere/comp/auto_tune.h"
+
+#include <algorithm>
+#include <map>
+#include <string>
+
+#include "knowhere/comp/brute_force.h"
+#include "knowhere/comp/index_param.h"
+#include "knowhere/log.h"
+
+namespace knowhere {
+
+namespace {
+
+// the largest ef and search_list_size tried
+constexpr int64_t kMaxSearchList = 4096;
+
+struct TunedParam {
+    const char* name = nullptr;
+    int64_t min = 0;
+    int64_t max = 0;
+};
+
+TunedParam
+TunedParamOf(const std::string& type, const Json& json, int64_t k) {
+    if (type.rfind(IndexEnum::INDEX_HNSW, 0) == 0) {
+        return {indexparam::EF, k, std::max(k, kMaxSearchList)};
+    }
+    if (type == IndexEnum::INDEX_DISKANN) {
+        return {indexparam::SEARCH_LIST_SIZE, k, std::max(k, kMaxSearchList)};
+    }
+    if (type.rfind("IVF", 0) == 0 || type == IndexEnum::INDEX_FAISS_SCANN) {
+        int64_t nlist = json.contains(indexparam::NLIST) ? json[indexparam::NLIST].get<int64_t>() : 128;
+        return {indexparam::NPROBE, 1, nlist};
+    }
+    return {};
+}
+
+// the share of the k nearest ids of the ground truth among the ones of the result
+float
+Recall(const DataSet& ground_truth, const DataSet& result) {
+    auto nq = result.GetRows();
+    auto k = result.GetDim();
+    auto gt_k = ground_truth.GetDim();
+    int64_t matched = 0;
+    std::vector<int64_t> gt_ids;
+    std::vector<int64_t> ids;
+    for (int64_t i = 0; i < nq; ++i) {
+        gt_ids.assign(ground_truth.GetIds() + i * gt_k, ground_truth.GetIds() + i * gt_k + k);
+        ids.assign(result.GetIds() + i * k, result.GetIds() + (i + 1) * k);
+        std::sort(gt_ids.begin(), gt_ids.end());
+        std::sort(ids.begin(), ids.end());
+        for (size_t a = 0, b = 0; a < gt_ids.size() && b < ids.size();) {
+            if (gt_ids[a] == ids[b]) {
+                matched += ids[b] >= 0;
+                ++a;
+                ++b;
+            } else if (gt_ids[a] < ids[b]) {
+                ++a;
+            } else {
+                ++b;
+            }
+        }
+    }
+    return nq * k > 0 ? static_cast<float>(matched) / (nq * k) : 1.0f;
+}
+
+}  // namespace
+
+expected<Json>
+AutoTune::Tune(const Index<IndexNode>& index, const DataSetPtr base, const DataSetPtr queries, const Json& json,
+               const std::vector<float>& target_recalls) {
+    int64_t k = json.contains(meta::TOPK) ? json[meta::TOPK].get<int64_t>() : 10;
+    auto param = TunedParamOf(index.Type(), json, k);
+    if (param.name == nullptr) {
+        return expected<Json>::Err(Status::not_implemented, "no search param to tune for " + index.Type());
+    }
+    auto gt = BruteForce::Search(base, queries, json, nullptr);
+    if (!gt.has_value()) {
+        return expected<Json>::Err(gt.error(), gt.what());
+    }
+
+    Json search_json(json);
+    search_json.erase(meta::TARGET_RECALL);
+    std::map<int64_t, float> recalls;
+    auto recall_of = [&](int64_t value) -> expected<float> {
+        auto it = recalls.find(value);
+        if (it != recalls.end()) {
+            return it->second;
+        }
+        search_json[param.name] = value;
+        auto res = index.Search(*queries, search_json, nullptr);
+        if (!res.has_value()) {
+            return expected<float>::Err(res.error(), res.what());
+        }
+        auto recall = Recall(*gt.value(), *res.value());
+        LOG_KNOWHERE_INFO_ << "auto tune " << index.Type() << ": " << param.name << " " << value << " recall "
+                           << recall;
+        return recalls[value] = recall;
+    };
+
+    std::vector<float> targets(target_recalls);
+    std::sort(targets.begin(), targets.end());
+    Json table = Json::array();
+    int64_t lo = param.min;
+    for (auto target : targets) {
+        // the recall grows with the param, the value of a lower target bounds the ones of the higher
+        int64_t hi = param.max;
+        auto recall = recall_of(hi);
+        if (!recall.has_value()) {
+            return expected<Json>::Err(recall.error(), recall.what());
+        }
+        while (lo < hi && recall.value() >= target) {
+            auto mid = lo + (hi - lo) / 2;
+            auto mid_recall = recall_of(mid);
+            if (!mid_recall.has_value()) {
+                return expected<Json>::Err(mid_recall.error(), mid_recall.what());
+            }
+            if (mid_recall.value() >= target) {
+                hi = mid;
+            } else {
+                lo = mid + 1;
+            }
+        }
+        lo = hi;
+        if (!table.empty() && table.back()["params"][param.name] == hi) {
+            continue;
+        }
+        Json entry;
+        entry["recall"] = recalls[hi];
+        entry["params"][param.name] = hi;
+        table.push_back(std::move(entry));
+    }
+    return table;
+}
+
+}  // namespace knowhere
@@ -0,0 +1,205 @@
+// Copyright (C) 2019-2023 Zilliz. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file except in compliance
+// with the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
+// or implied. See the License for the specific language governing permissions and limitations under the License.
+
+#include "knowhere/comp/binary_codec.h"
+
+#include <folly/compression/Compression.h>
+
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "knowhere/comp/thread_pool.h"
+#include "knowhere/log.h"
+
+namespace knowhere {
+
+namespace {
+
+constexpr char kMagic[4] = {'K', 'N', 'W', 'Z'};
+// sections below this size are not worth a header and a task per block
+constexpr int64_t kMinSectionSize = 64 << 10;
+
+// followed by the compressed size of every block and then the blocks, little endian
+struct SectionHeader {
+    char magic[4];
+    uint8_t codec;
+    uint8_t reserved[3];
+    uint32_t block_size;
+    uint32_t blocks;
+    uint64_t raw_size;
+};
+static_assert(sizeof(SectionHeader) == 24);
+
+expected<folly::io::CodecType>
+CodecType(uint8_t codec) {
+    folly::io::CodecType type;
+    switch (static_cast<BinaryCodec>(codec)) {
+        case BinaryCodec::LZ4:
+            type = folly::io::CodecType::LZ4;
+            break;
+        case BinaryCodec::ZSTD:
+            type = folly::io::CodecType::ZSTD;
+            break;
+        default:
+            return expected<folly::io::CodecType>::Err(Status::invalid_args,
+                                                       "unknown binary codec " + std::to_string(codec));
+    }
+    if (!folly::io::hasCodec(type)) {
+        return expected<folly::io::CodecType>::Err(Status::not_implemented,
+                                                   "binary codec " + std::to_string(codec) + " not built in");
+    }
+    return type;
+}
+
+bool
+ReadHeader(const Binary& binary, SectionHeader& header) {
+    if (binary.size < static_cast<int64_t>(sizeof(header))) {
+        return false;
+    }
+    std::memcpy(&header, binary.data.get(), sizeof(header));
+    return std::memcmp(header.magic, kMagic, sizeof(kMagic)) == 0 && header.block_size > 0 &&
+           header.blocks == (header.raw_size + header.block_size - 1) / header.block_size &&
+           sizeof(header) + header.blocks * sizeof(uint64_t) <= static_cast<uint64_t>(binary.size);
+}
+
+}  // namespace
+
+bool
+BinarySetCodec::IsCompressed(const Binary& binary) {
+    SectionHeader header;
+    return ReadHeader(binary, header);
+}
+
+bool
+BinarySetCodec::HasCompressed(const BinarySet& binset) {
+    for (auto& [name, binary] : binset.binary_map_) {
+        if (binary != nullptr && IsCompressed(*binary)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+Status
+BinarySetCodec::Compress(BinarySet& binset, BinaryCodec codec, int level, const std::set<std::string>& raw_sections) {
+    auto type = CodecType(static_cast<uint8_t>(codec));
+    if (!type.has_value()) {
+        LOG_KNOWHERE_ERROR_ << type.what();
+        return type.error();
+    }
+    if (level == 0) {
+        level = folly::io::COMPRESSION_LEVEL_DEFAULT;
+    }
+    auto pool = ThreadPool::GetGlobalBuildThreadPool();
+    for (auto& [name, binary] : binset.binary_map_) {
+        if (binary == nullptr || binary->size < kMinSectionSize || raw_sections.count(name) != 0 ||
+            IsCompressed(*binary)) {
+            continue;
+        }
+        const size_t raw_size = binary->size;
+        const int64_t blocks = (raw_size + kBlockSize - 1) / kBlockSize;
+        std::vector<std::string> compressed(blocks);
+        try {
+            pool->parallel_for(0, blocks, 1, [&](int64_t b) {
+                // a codec is not thread safe, one per block costs little next to compressing kBlockSize bytes
+                auto c = folly::io::getCodec(type.value(), level);
+                size_t offset = b * kBlockSize;
+                auto data = reinterpret_cast<const char*>(binary->data.get()) + offset;
+                compressed[b] = c->compress(folly::StringPiece(data, std::min(kBlockSize, raw_size - offset)));
+            });
+        } catch (const std::exception& e) {
+            LOG_KNOWHERE_ERROR_ << "failed to compress section " << name << ": " << e.what();
+            return Status::invalid_binary_set;
+        }
+
+        size_t size = sizeof(SectionHeader) + blocks * sizeof(uint64_t);
+        for (auto& block : compressed) {
+            size += block.size();
+        }
+        if (size > raw_size * (1 - kMinSaving)) {
+            continue;
+        }
+        std::shared_ptr<uint8_t[]> data(new uint8_t[size]);
+        SectionHeader header;
+        std::memset(&header, 0, sizeof(header));
+        std::memcpy(header.magic, kMagic, sizeof(kMagic));
+        header.codec = static_cast<uint8_t>(codec);
+        header.block_size = kBlockSize;
+        header.blocks = blocks;
+        header.raw_size = raw_size;
+        std::memcpy(data.get(), &header, sizeof(header));
+        auto sizes = data.get() + sizeof(header);
+        auto out = sizes + blocks * sizeof(uint64_t);
+        for (int64_t b = 0; b < blocks; ++b) {
+            uint64_t block_size = compressed[b].size();
+            std::memcpy(sizes + b * sizeof(uint64_t), &block_size, sizeof(block_size));
+            std::memcpy(out, compressed[b].data(), block_size);
+            out += block_size;
+        }
+        binary = std::make_shared<Binary>();
+        binary->data = data;
+        binary->size = size;
+    }
+    return Status::success;
+}
+
+Status
+BinarySetCodec::Decompress(BinarySet& binset) {
+    auto pool = ThreadPool::GetGlobalBuildThreadPool();
+    for (auto& [name, binary] : binset.binary_map_) {
+        SectionHeader header;
+        if (binary == nullptr || !ReadHeader(*binary, header)) {
+            continue;
+        }
+        auto type = CodecType(header.codec);
+        if (!type.has_value()) {
+            LOG_KNOWHERE_ERROR_ << "section " << name << ": " << type.what();
+            return type.error();
+        }
+        const int64_t blocks = header.blocks;
+        auto sizes = binary->data.get() + sizeof(header);
+        std::vector<uint64_t> offsets(blocks + 1, sizeof(header) + blocks * sizeof(uint64_t));
+        for (int64_t b = 0; b < blocks; ++b) {
+            uint64_t block_size;
+            std::memcpy(&block_size, sizes + b * sizeof(uint64_t), sizeof(block_size));
+            offsets[b + 1] = offsets[b] + block_size;
+        }
+        if (offsets[blocks] != static_cast<uint64_t>(binary->size)) {
+            LOG_KNOWHERE_ERROR_ << "corrupted compressed section " << name;
+            return Status::invalid_binary_set;
+        }
+        std::shared_ptr<uint8_t[]> data(new uint8_t[header.raw_size]);
+        try {
+            pool->parallel_for(0, blocks, 1, [&](int64_t b) {
+                auto c = folly::io::getCodec(type.value());
+                uint64_t offset = b * header.block_size;
+                uint64_t raw_size = std::min<uint64_t>(header.block_size, header.raw_size - offset);
+                auto in = reinterpret_cast<const char*>(binary->data.get()) + offsets[b];
+                auto block = c->uncompress(folly::StringPiece(in, offsets[b + 1] - offsets[b]), raw_size);
+                if (block.size() != raw_size) {
+                    throw std::runtime_error("block " + std::to_string(b) + " decompressed to a wrong size");
+                }
+                std::memcpy(data.get() + offset, block.data(), raw_size);
+            });
+        } catch (const std::exception& e) {
+            LOG_KNOWHERE_ERROR_ << "failed to decompress section " << name << ": " << e.what();
+            return Status::invalid_binary_set;
+        }
+        binary = std::make_shared<Binary>();
+        binary->data = data;
+        binary->size = header.raw_size;
+    }
+    return Status::success;
+}
+
+}  // namespace knowhere
@@ -11,11 +11,17 @@
 
 #include "knowhere/comp/brute_force.h"
 
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <memory>
 #include <vector>
 
+#include "common/knn_util.h"
 #include "common/metric.h"
 #include "common/range_util.h"
 #include "faiss/MetricType.h"
+#include "faiss/utils/Heap.h"
 #include "faiss/utils/binary_distances.h"
 #include "faiss/utils/distances.h"
 #include "knowhere/comp/thread_pool.h"
@@ -30,6 +36,55 @@ namespace knowhere {
 
 class BruteForceConfig : public BaseConfig {};
 
+namespace {
+
+// enough float queries are searched in slices through the blocked BLAS path rather than one by one
+bool
+UseKnnBatchSearch(faiss::MetricType metric, int64_t nq) {
+    return (metric == faiss::METRIC_L2 || metric == faiss::METRIC_INNER_PRODUCT) && nq >= kKnnBatchMinQueries;
+}
+
+// The bits of the rows of a chunk: a view into bitset when it is dense, starts the chunk on a byte and covers it, else
+// a copy shifted into buf, the rows past the end of bitset are not filtered.
+BitsetView
+ChunkBitset(const BitsetView& bitset, const BaseChunk& chunk, std::vector<uint8_t>& buf) {
+    if (bitset.empty()) {
+        return nullptr;
+    }
+    auto begin = static_cast<size_t>(chunk.id_offset);
+    auto rows = static_cast<size_t>(chunk.rows);
+    if (bitset.is_dense() && begin % 8 == 0 && begin + rows <= bitset.size()) {
+        return BitsetView(bitset.data() + begin / 8, rows);
+    }
+    buf.assign((rows + 7) / 8, 0);
+    for (size_t i = 0; i < rows; i += 64) {
+        size_t n = std::min<size_t>(64, rows - i);
+        uint64_t bits = bitset.block(begin + i, n);
+        std::memcpy(buf.data() + i / 8, &bits, (n + 7) / 8);
+    }
+    return BitsetView(buf.data(), rows);
+}
+
+// Merges the sorted top k of rows queries found in one chunk into their heaps, shifting the ids by the chunk offset.
+template <typename C>
+void
+MergeChunkResult(int64_t rows, int64_t k, int64_t id_offset, const float* chunk_distances,
+                 const int64_t* chunk_labels, float* distances, int64_t* labels) {
+    for (int64_t i = 0; i < rows; ++i) {
+        auto heap_distances = distances + i * k;
+        auto heap_labels = labels + i * k;
+        for (int64_t j = i * k; j < (i + 1) * k; ++j) {
+            // the rest of the query is no better
+            if (chunk_labels[j] < 0 || !C::cmp(heap_distances[0], chunk_distances[j])) {
+                break;
+            }
+            faiss::heap_replace_top<C>(k, heap_distances, heap_labels, chunk_distances[j], chunk_labels[j] + id_offset);
+        }
+    }
+}
+
+}  // namespace
+
 expected<DataSetPtr>
 BruteForce::Search(const DataSetPtr base_dataset, const DataSetPtr query_dataset, const Json& config,
                    const BitsetView& bitset) {
@@ -54,78 +109,243 @@ BruteForce::Search(const DataSetPtr base_dataset, const DataSetPtr query_dataset
     }
     faiss::MetricType faiss_metric_type = result.value();
     bool is_cosine = IsMetricType(metric_str, metric::COSINE);
+    auto base_norms = base_dataset->GetNorms();
 
     int topk = cfg.k.value();
     auto labels = new int64_t[nq * topk];
     auto distances = new float[nq * topk];
 
+    if (UseKnnBatchSearch(faiss_metric_type, nq)) {
+        try {
+            KnnBatchSearch((const float*)xb, nb, (const float*)xq, nq, dim, topk, faiss_metric_type, is_cosine,
+                           distances, labels, bitset, base_norms);
+        } catch (const std::exception& e) {
+            std::unique_ptr<int64_t[]> auto_delete_labels(labels);
+            std::unique_ptr<float[]> auto_delete_distances(distances);
+            LOG_KNOWHERE_WARNING_ << "faiss inner error: " << e.what();
+            return expected<DataSetPtr>::Err(Status::faiss_inner_error, e.what());
+        }
+        return GenResultDataSet(nq, cfg.k.value(), labels, distances);
+    }
+
     auto pool = ThreadPool::GetGlobalSearchThreadPool();
-    std::vector<folly::Future<Status>> futs;
-    futs.reserve(nq);
-    for (int i = 0; i < nq; ++i) {
-        futs.emplace_back(pool->push([&, index = i] {
-            ThreadPool::ScopedOmpSetter setter(1);
-            auto cur_labels = labels + topk * index;
-            auto cur_distances = distances + topk * index;
-            switch (faiss_metric_type) {
-                case faiss::METRIC_L2: {
-                    auto cur_query = (const float*)xq + dim * index;
-                    faiss::float_maxheap_array_t buf{(size_t)1, (size_t)topk, cur_labels, cur_distances};
-                    faiss::knn_L2sqr(cur_query, (const float*)xb, dim, 1, nb, &buf, nullptr, bitset);
-                    break;
-                }
-                case faiss::METRIC_INNER_PRODUCT: {
-                    auto cur_query = (const float*)xq + dim * index;
-                    faiss::float_minheap_array_t buf{(size_t)1, (size_t)topk, cur_labels, cur_distances};
-                    if (is_cosine) {
-                        auto copied_query = CopyAndNormalizeFloatVec(cur_query, dim);
-                        faiss::knn_cosine(copied_query.get(), (const float*)xb, dim, 1, nb, &buf, bitset);
+    std::atomic<Status> ret = Status::success;
+    pool->parallel_for(0, nq, 1, [&](int64_t index) {
+        ThreadPool::ScopedOmpSetter setter(1);
+        auto cur_labels = labels + topk * index;
+        auto cur_distances = distances + topk * index;
+        switch (faiss_metric_type) {
+            case faiss::METRIC_L2: {
+                auto cur_query = (const float*)xq + dim * index;
+                faiss::float_maxheap_array_t buf{(size_t)1, (size_t)topk, cur_labels, cur_distances};
+                faiss::knn_L2sqr(cur_query, (const float*)xb, dim, 1, nb, &buf, nullptr, bitset);
+                break;
+            }
+            case faiss::METRIC_INNER_PRODUCT: {
+                auto cur_query = (const float*)xq + dim * index;
+                faiss::float_minheap_array_t buf{(size_t)1, (size_t)topk, cur_labels, cur_distances};
+                if (is_cosine) {
+                    // the cosine kernels divide by the query norm, the query is not normalized first
+                    if (base_norms != nullptr) {
+                        faiss::knn_cosine_blas(cur_query, (const float*)xb, dim, 1, nb, &buf, base_norms, bitset);
                     } else {
-                        faiss::knn_inner_product(cur_query, (const float*)xb, dim, 1, nb, &buf, bitset);
+                        faiss::knn_cosine(cur_query, (const float*)xb, dim, 1, nb, &buf, bitset);
                     }
-                    break;
+                } else {
+                    faiss::knn_inner_product(cur_query, (const float*)xb, dim, 1, nb, &buf, bitset);
                 }
-                case faiss::METRIC_Jaccard: {
-                    auto cur_query = (const uint8_t*)xq + (dim / 8) * index;
-                    faiss::float_maxheap_array_t res = {size_t(1), size_t(topk), cur_labels, cur_distances};
-                    binary_knn_hc(faiss::METRIC_Jaccard, &res, cur_query, (const uint8_t*)xb, nb, dim / 8, bitset);
-                    break;
+                break;
+            }
+            case faiss::METRIC_Jaccard: {
+                auto cur_query = (const uint8_t*)xq + (dim / 8) * index;
+                faiss::float_maxheap_array_t res = {size_t(1), size_t(topk), cur_labels, cur_distances};
+                binary_knn_hc(faiss::METRIC_Jaccard, &res, cur_query, (const uint8_t*)xb, nb, dim / 8, bitset);
+                break;
+            }
+            case faiss::METRIC_Hamming: {
+                auto cur_query = (const uint8_t*)xq + (dim / 8) * index;
+                std::vector<int32_t> int_distances(topk);
+                faiss::int_maxheap_array_t res = {size_t(1), size_t(topk), cur_labels, int_distances.data()};
+                binary_knn_hc(faiss::METRIC_Hamming, &res, (const uint8_t*)cur_query, (const uint8_t*)xb, nb,
+                              dim / 8, bitset);
+                for (int i = 0; i < topk; ++i) {
+                    cur_distances[i] = int_distances[i];
                 }
-                case faiss::METRIC_Hamming: {
-                    auto cur_query = (const uint8_t*)xq + (dim / 8) * index;
-                    std::vector<int32_t> int_distances(topk);
-                    faiss::int_maxheap_array_t res = {size_t(1), size_t(topk), cur_labels, int_distances.data()};
-                    binary_knn_hc(faiss::METRIC_Hamming, &res, (const uint8_t*)cur_query, (const uint8_t*)xb, nb,
-                                  dim / 8, bitset);
-                    for (int i = 0; i < topk; ++i) {
-                        cur_distances[i] = int_distances[i];
+                break;
+            }
+            case faiss::METRIC_Substructure:
+            case faiss::METRIC_Superstructure: {
+                // only matched ids will be chosen, not to use heap
+                auto cur_query = (const uint8_t*)xq + (dim / 8) * index;
+                binary_knn_mc(faiss_metric_type, cur_query, (const uint8_t*)xb, 1, nb, topk, dim / 8, cur_distances,
+                              cur_labels, bitset);
+                break;
+            }
+            default: {
+                LOG_KNOWHERE_ERROR_ << "Invalid metric type: " << cfg.metric_type.value();
+                ret = Status::invalid_metric_type;
+                return;
+            }
+        }
+    });
+    if (ret != Status::success) {
+        return expected<DataSetPtr>::Err(ret, "failed to brute force search");
+    }
+    return GenResultDataSet(nq, cfg.k.value(), labels, distances);
+}
+
+expected<DataSetPtr>
+BruteForce::Search(const std::vector<BaseChunk>& base_chunks, const DataSetPtr query_dataset, const Json& config,
+                   const BitsetView& bitset) {
+    auto xq = query_dataset->GetTensor();
+    auto nq = query_dataset->GetRows();
+    auto dim = query_dataset->GetDim();
+
+    BruteForceConfig cfg;
+    std::string msg;
+    auto status = Config::Load(cfg, config, knowhere::SEARCH, &msg);
+    if (status != Status::success) {
+        return expected<DataSetPtr>::Err(status, msg);
+    }
+
+    std::string metric_str = cfg.metric_type.value();
+    auto result = Str2FaissMetricType(metric_str);
+    if (result.error() != Status::success) {
+        return expected<DataSetPtr>::Err(result.error(), result.what());
+    }
+    faiss::MetricType faiss_metric_type = result.value();
+    bool is_cosine = IsMetricType(metric_str, metric::COSINE);
+    if (faiss_metric_type != faiss::METRIC_L2 && faiss_metric_type != faiss::METRIC_INNER_PRODUCT &&
+        faiss_metric_type != faiss::METRIC_Jaccard && faiss_metric_type != faiss::METRIC_Hamming) {
+        return expected<DataSetPtr>::Err(Status::invalid_metric_type,
+                                         "chunked brute force search does not support metric " + metric_str);
+    }
+    bool is_max_heap = faiss_metric_type != faiss::METRIC_INNER_PRODUCT;
+
+    std::vector<std::vector<uint8_t>> bitset_bufs(base_chunks.size());
+    std::vector<BitsetView> chunk_bitsets(base_chunks.size());
+    for (size_t c = 0; c < base_chunks.size(); ++c) {
+        chunk_bitsets[c] = ChunkBitset(bitset, base_chunks[c], bitset_bufs[c]);
+    }
+
+    int64_t topk = cfg.k.value();
+    auto labels = new int64_t[nq * topk];
+    auto distances = new float[nq * topk];
+
+    auto pool = ThreadPool::GetGlobalSearchThreadPool();
+    bool batch = UseKnnBatchSearch(faiss_metric_type, nq);
+    int64_t threads = std::max<int64_t>(1, pool->size());
+    int64_t slice = batch ? std::max<int64_t>(kKnnBatchMinQueries, (nq + threads - 1) / threads) : 1;
+    std::vector<folly::Future<Status>> futs;
+    futs.reserve((nq + slice - 1) / slice);
+    for (int64_t begin = 0; begin < nq; begin += slice) {
+        futs.emplace_back(pool->push([&, begin, end = std::min(nq, begin + slice)] {
+            ThreadPool::ScopedOmpSetter setter(1);
+            auto rows = static_cast<size_t>(end - begin);
+            auto cur_labels = labels + begin * topk;
+            auto cur_distances = distances + begin * topk;
+            if (is_max_heap) {
+                faiss::float_maxheap_array_t{rows, (size_t)topk, cur_labels, cur_distances}.heapify();
+            } else {
+                faiss::float_minheap_array_t{rows, (size_t)topk, cur_labels, cur_distances}.heapify();
+            }
+            std::vector<int64_t> chunk_labels(rows * topk);
+            std::vector<float> chunk_distances(rows * topk);
+            std::vector<int32_t> int_distances(faiss_metric_type == faiss::METRIC_Hamming ? rows * topk : 0);
+            try {
+                for (size_t c = 0; c < base_chunks.size(); ++c) {
+                    auto& chunk = base_chunks[c];
+                    if (chunk.rows <= 0) {
+                        continue;
+                    }
+                    auto& chunk_bitset = chunk_bitsets[c];
+                    switch (faiss_metric_type) {
+                        case faiss::METRIC_L2: {
+                            auto cur_query = (const float*)xq + dim * begin;
+                            faiss::float_maxheap_array_t buf{rows, (size_t)topk, chunk_labels.data(),
+                                                             chunk_distances.data()};
+                            if (batch) {
+                                faiss::knn_L2sqr_blas(cur_query, (const float*)chunk.data, dim, rows, chunk.rows,
+                                                      &buf, nullptr, chunk_bitset);
+                            } else {
+                                faiss::knn_L2sqr(cur_query, (const float*)chunk.data, dim, rows, chunk.rows, &buf,
+                                                 nullptr, chunk_bitset);
+                            }
+                            break;
+                        }
+                        case faiss::METRIC_INNER_PRODUCT: {
+                            auto cur_query = (const float*)xq + dim * begin;
+                            faiss::float_minheap_array_t buf{rows, (size_t)topk, chunk_labels.data(),
+                                                             chunk_distances.data()};
+                            if (is_cosine && (batch || chunk.norms != nullptr)) {
+                                faiss::knn_cosine_blas(cur_query, (const float*)chunk.data, dim, rows, chunk.rows,
+                                                       &buf, chunk.norms, chunk_bitset);
+                            } else if (is_cosine) {
+                                faiss::knn_cosine(cur_query, (const float*)chunk.data, dim, rows, chunk.rows, &buf,
+                                                  chunk_bitset);
+                            } else if (batch) {
+                                faiss::knn_inner_product_blas(cur_query, (const float*)chunk.data, dim, rows,
+                                                              chunk.rows, &buf, chunk_bitset);
+                            } else {
+                                faiss::knn_inner_product(cur_query, (const float*)chunk.data, dim, rows, chunk.rows,
+                                                         &buf, chunk_bitset);
+                            }
+                            break;
+                        }
+                        case faiss::METRIC_Jaccard: {
+                            auto cur_query = (const uint8_t*)xq + (dim / 8) * begin;
+                            faiss::float_maxheap_array_t res{rows, (size_t)topk, chunk_labels.data(),
+                                                             chunk_distances.data()};
+                            binary_knn_hc(faiss::METRIC_Jaccard, &res, cur_query, (const uint8_t*)chunk.data,
+                                          chunk.rows, dim / 8, chunk_bitset);
+                            break;
+                        }
+                        case faiss::METRIC_Hamming: {
+                            auto cur_query = (const uint8_t*)xq + (dim / 8) * begin;
+                            faiss::int_maxheap_array_t res{rows, (size_t)topk, chunk_labels.data(),
+                                                           int_distances.data()};
+                            binary_knn_hc(faiss::METRIC_Hamming, &res, cur_query, (const uint8_t*)chunk.data,
+                                          chunk.rows, dim / 8, chunk_bitset);
+                            std::copy(int_distances.begin(), int_distances.end(), chunk_distances.begin());
+                            break;
+                        }
+                        default:
+                            return Status::invalid_metric_type;
+                    }
+                    if (is_max_heap) {
+                        MergeChunkResult<faiss::CMax<float, int64_t>>(rows, topk, chunk.id_offset,
+                                                                      chunk_distances.data(), chunk_labels.data(),
+                                                                      cur_distances, cur_labels);
+                    } else {
+                        MergeChunkResult<faiss::CMin<float, int64_t>>(rows, topk, chunk.id_offset,
+                                                                      chunk_distances.data(), chunk_labels.data(),
+                                                                      cur_distances, cur_labels);
                     }
-                    break;
-                }
-                case faiss::METRIC_Substructure:
-                case faiss::METRIC_Superstructure: {
-                    // only matched ids will be chosen, not to use heap
-                    auto cur_query = (const uint8_t*)xq + (dim / 8) * index;
-                    binary_knn_mc(faiss_metric_type, cur_query, (const uint8_t*)xb, 1, nb, topk, dim / 8, cur_distances,
-                                  cur_labels, bitset);
-                    break;
-                }
-                default: {
-                    LOG_KNOWHERE_ERROR_ << "Invalid metric type: " << cfg.metric_type.value();
-                    return Status::invalid_metric_type;
                 }
+            } catch (const std::exception& e) {
+                LOG_KNOWHERE_WARNING_ << "faiss inner error: " << e.what();
+                return Status::faiss_inner_error;
+            }
+            if (is_max_heap) {
+                faiss::float_maxheap_array_t{rows, (size_t)topk, cur_labels, cur_distances}.reorder();
+            } else {
+                faiss::float_minheap_array_t{rows, (size_t)topk, cur_labels, cur_distances}.reorder();
             }
             return Status::success;
         }));
     }
     for (auto& fut : futs) {
         fut.wait();
+    }
+    for (auto& fut : futs) {
         auto ret = fut.result().value();
         if (ret != Status::success) {
+            std::unique_ptr<int64_t[]> auto_delete_labels(labels);
+            std::unique_ptr<float[]> auto_delete_distances(distances);
             return expected<DataSetPtr>::Err(ret, "failed to brute force search");
         }
     }
-    return GenResultDataSet(nq, cfg.k.value(), labels, distances);
+    return GenResultDataSet(nq, topk, labels, distances);
 }
 
 Status
@@ -148,75 +368,84 @@ BruteForce::SearchWithBuf(const DataSetPtr base_dataset, const DataSetPtr query_
     }
     faiss::MetricType faiss_metric_type = result.value();
     bool is_cosine = IsMetricType(metric_str, metric::COSINE);
+    auto base_norms = base_dataset->GetNorms();
 
     int topk = cfg.k.value();
     auto labels = ids;
     auto distances = dis;
 
+    if (UseKnnBatchSearch(faiss_metric_type, nq)) {
+        try {
+            KnnBatchSearch((const float*)xb, nb, (const float*)xq, nq, dim, topk, faiss_metric_type, is_cosine,
+                           distances, labels, bitset, base_norms);
+        } catch (const std::exception& e) {
+            LOG_KNOWHERE_WARNING_ << "faiss inner error: " << e.what();
+            return Status::faiss_inner_error;
+        }
+        return Status::success;
+    }
+
     auto pool = ThreadPool::GetGlobalSearchThreadPool();
-    std::vector<folly::Future<Status>> futs;
-    futs.reserve(nq);
-    for (int i = 0; i < nq; ++i) {
-        futs.emplace_back(pool->push([&, index = i] {
-            ThreadPool::ScopedOmpSetter setter(1);
-            auto cur_labels = labels + topk * index;
-            auto cur_distances = distances + topk * index;
-            switch (faiss_metric_type) {
-                case faiss::METRIC_L2: {
-                    auto cur_query = (const float*)xq + dim * index;
-                    faiss::float_maxheap_array_t buf{(size_t)1, (size_t)topk, cur_labels, cur_distances};
-                    faiss::knn_L2sqr(cur_query, (const float*)xb, dim, 1, nb, &buf, nullptr, bitset);
-                    break;
-                }
-                case faiss::METRIC_INNER_PRODUCT: {
-                    auto cur_query = (const float*)xq + dim * index;
-                    faiss::float_minheap_array_t buf{(size_t)1, (size_t)topk, cur_labels, cur_distances};
-                    if (is_cosine) {
-                        auto copied_query = CopyAndNormalizeFloatVec(cur_query, dim);
-                        faiss::knn_cosine(copied_query.get(), (const float*)xb, dim, 1, nb, &buf, bitset);
+    std::atomic<Status> ret = Status::success;
+    pool->parallel_for(0, nq, 1, [&](int64_t index) {
+        ThreadPool::ScopedOmpSetter setter(1);
+        auto cur_labels = labels + topk * index;
+        auto cur_distances = distances + topk * index;
+        switch (faiss_metric_type) {
+            case faiss::METRIC_L2: {
+                auto cur_query = (const float*)xq + dim * index;
+                faiss::float_maxheap_array_t buf{(size_t)1, (size_t)topk, cur_labels, cur_distances};
+                faiss::knn_L2sqr(cur_query, (const float*)xb, dim, 1, nb, &buf, nullptr, bitset);
+                break;
+            }
+            case faiss::METRIC_INNER_PRODUCT: {
+                auto cur_query = (const float*)xq + dim * index;
+                faiss::float_minheap_array_t buf{(size_t)1, (size_t)topk, cur_labels, cur_distances};
+                if (is_cosine) {
+                    // the cosine kernels divide by the query norm, the query is not normalized first
+                    if (base_norms != nullptr) {
+                        faiss::knn_cosine_blas(cur_query, (const float*)xb, dim, 1, nb, &buf, base_norms, bitset);
                     } else {
-                        faiss::knn_inner_product(cur_query, (const float*)xb, dim, 1, nb, &buf, bitset);
+                        faiss::knn_cosine(cur_query, (const float*)xb, dim, 1, nb, &buf, bitset);
                     }
-                    break;
+                } else {
+                    faiss::knn_inner_product(cur_query, (const float*)xb, dim, 1, nb, &buf, bitset);
                 }
-                case faiss::METRIC_Jaccard: {
-                    auto cur_query = (const uint8_t*)xq + (dim / 8) * index;
-                    faiss::float_maxheap_array_t res = {size_t(1), size_t(topk), cur_labels, cur_distances};
-                    binary_knn_hc(faiss::METRIC_Jaccard, &res, cur_query, (const uint8_t*)xb, nb, dim / 8, bitset);
-                    break;
-                }
-                case faiss::METRIC_Hamming: {
-                    auto cur_query = (const uint8_t*)xq + (dim / 8) * index;
-                    std::vector<int32_t> int_distances(topk);
-                    faiss::int_maxheap_array_t res = {size_t(1), size_t(topk), cur_labels, int_distances.data()};
-                    binary_knn_hc(faiss::METRIC_Hamming, &res, (const uint8_t*)cur_query, (const uint8_t*)xb, nb,
-                                  dim / 8, bitset);
-                    for (int i = 0; i < topk; ++i) {
-                        cur_distances[i] = int_distances[i];
-                    }
-                    break;
-                }
-                case faiss::METRIC_Substructure:
-                case faiss::METRIC_Superstructure: {
-                    // only matched ids will be chosen, not to use heap
-                    auto cur_query = (const uint8_t*)xq + (dim / 8) * index;
-                    binary_knn_mc(faiss_metric_type, cur_query, (const uint8_t*)xb, 1, nb, topk, dim / 8, cur_distances,
-                                  cur_labels, bitset);
-                    break;
-                }
-                default: {
-                    LOG_KNOWHERE_ERROR_ << "Invalid metric type: " << cfg.metric_type.value();
-                    return Status::invalid_metric_type;
+                break;
+            }
+            case faiss::METRIC_Jaccard: {
+                auto cur_query = (const uint8_t*)xq + (dim / 8) * index;
+                faiss::float_maxheap_array_t res = {size_t(1), size_t(topk), cur_labels, cur_distances};
+                binary_knn_hc(faiss::METRIC_Jaccard, &res, cur_query, (const uint8_t*)xb, nb, dim / 8, bitset);
+                break;
+            }
+            case faiss::METRIC_Hamming: {
+                auto cur_query = (const uint8_t*)xq + (dim / 8) * index;
+                std::vector<int32_t> int_distances(topk);
+                faiss::int_maxheap_array_t res = {size_t(1), size_t(topk), cur_labels, int_distances.data()};
+                binary_knn_hc(faiss::METRIC_Hamming, &res, (const uint8_t*)cur_query, (const uint8_t*)xb, nb,
+                              dim / 8, bitset);
+                for (int i = 0; i < topk; ++i) {
+                    cur_distances[i] = int_distances[i];
                 }
+                break;
             }
-            return Status::success;
-        }));
-    }
-    for (auto& fut : futs) {
-        fut.wait();
-        auto ret = fut.result().value();
-        RETURN_IF_ERROR(ret);
-    }
+            case faiss::METRIC_Substructure:
+            case faiss::METRIC_Superstructure: {
+                // only matched ids will be chosen, not to use heap
+                auto cur_query = (const uint8_t*)xq + (dim / 8) * index;
+                binary_knn_mc(faiss_metric_type, cur_query, (const uint8_t*)xb, 1, nb, topk, dim / 8, cur_distances,
+                              cur_labels, bitset);
+                break;
+            }
+            default: {
+                LOG_KNOWHERE_ERROR_ << "Invalid metric type: " << cfg.metric_type.value();
+                ret = Status::invalid_metric_type;
+                return;
+            }
+        }
+    });
+    return ret;
     return Status::success;
 }
 
@@ -248,85 +477,62 @@ BruteForce::RangeSearch(const DataSetPtr base_dataset, const DataSetPtr query_da
     bool is_cosine = IsMetricType(metric_str, metric::COSINE);
 
     auto radius = cfg.radius.value();
-    bool is_ip = false;
+    bool is_ip = faiss_metric_type == faiss::METRIC_INNER_PRODUCT;
     float range_filter = cfg.range_filter.value();
 
     auto pool = ThreadPool::GetGlobalSearchThreadPool();
 
-    std::vector<std::vector<int64_t>> result_id_array(nq);
-    std::vector<std::vector<float>> result_dist_array(nq);
-    std::vector<size_t> result_size(nq);
-    std::vector<size_t> result_lims(nq + 1);
-    std::vector<folly::Future<Status>> futs;
-    futs.reserve(nq);
-    for (int i = 0; i < nq; ++i) {
-        futs.emplace_back(pool->push([&, index = i] {
-            ThreadPool::ScopedOmpSetter setter(1);
-            faiss::RangeSearchResult res(1);
-            switch (faiss_metric_type) {
-                case faiss::METRIC_L2: {
-                    auto cur_query = (const float*)xq + dim * index;
-                    faiss::range_search_L2sqr(cur_query, (const float*)xb, dim, 1, nb, radius, &res, bitset);
-                    break;
-                }
-                case faiss::METRIC_INNER_PRODUCT: {
-                    is_ip = true;
-                    auto cur_query = (const float*)xq + dim * index;
-                    if (is_cosine) {
-                        auto copied_query = CopyAndNormalizeFloatVec(cur_query, dim);
-                        faiss::range_search_cosine(copied_query.get(), (const float*)xb, dim, 1, nb, radius, &res,
-                                                   bitset);
-                    } else {
-                        faiss::range_search_inner_product(cur_query, (const float*)xb, dim, 1, nb, radius, &res,
-                                                          bitset);
-                    }
-                    break;
-                }
-                case faiss::METRIC_Jaccard: {
-                    auto cur_query = (const uint8_t*)xq + (dim / 8) * index;
-                    faiss::binary_range_search<faiss::CMin<float, int64_t>, float>(
-                        faiss::METRIC_Jaccard, cur_query, (const uint8_t*)xb, 1, nb, radius, dim / 8, &res, bitset);
-                    break;
-                }
-                case faiss::METRIC_Hamming: {
-                    auto cur_query = (const uint8_t*)xq + (dim / 8) * index;
-                    faiss::binary_range_search<faiss::CMin<int, int64_t>, int>(faiss::METRIC_Hamming, cur_query,
-                                                                               (const uint8_t*)xb, 1, nb, (int)radius,
-                                                                               dim / 8, &res, bitset);
-                    break;
-                }
-                default: {
-                    LOG_KNOWHERE_ERROR_ << "Invalid metric type: " << cfg.metric_type.value();
-                    return Status::invalid_metric_type;
+    RangeSearchResultBuilder results(nq, cfg.max_results.value(), is_ip);
+    std::atomic<Status> ret = Status::success;
+    pool->parallel_for(0, nq, 1, [&](int64_t index) {
+        ThreadPool::ScopedOmpSetter setter(1);
+        faiss::RangeSearchResult res(1);
+        switch (faiss_metric_type) {
+            case faiss::METRIC_L2: {
+                auto cur_query = (const float*)xq + dim * index;
+                faiss::range_search_L2sqr(cur_query, (const float*)xb, dim, 1, nb, radius, &res, bitset);
+                break;
+            }
+            case faiss::METRIC_INNER_PRODUCT: {
+                auto cur_query = (const float*)xq + dim * index;
+                if (is_cosine) {
+                    faiss::range_search_cosine(cur_query, (const float*)xb, dim, 1, nb, radius, &res, bitset);
+                } else {
+                    faiss::range_search_inner_product(cur_query, (const float*)xb, dim, 1, nb, radius, &res,
+                                                      bitset);
                 }
+                break;
             }
-            auto elem_cnt = res.lims[1];
-            result_dist_array[index].resize(elem_cnt);
-            result_id_array[index].resize(elem_cnt);
-            result_size[index] = elem_cnt;
-            for (size_t j = 0; j < elem_cnt; j++) {
-                result_dist_array[index][j] = res.distances[j];
-                result_id_array[index][j] = res.labels[j];
+            case faiss::METRIC_Jaccard: {
+                auto cur_query = (const uint8_t*)xq + (dim / 8) * index;
+                faiss::binary_range_search<faiss::CMin<float, int64_t>, float>(
+                    faiss::METRIC_Jaccard, cur_query, (const uint8_t*)xb, 1, nb, radius, dim / 8, &res, bitset);
+                break;
             }
-            if (cfg.range_filter.value() != defaultRangeFilter) {
-                FilterRangeSearchResultForOneNq(result_dist_array[index], result_id_array[index], is_ip, radius,
-                                                range_filter);
+            case faiss::METRIC_Hamming: {
+                auto cur_query = (const uint8_t*)xq + (dim / 8) * index;
+                faiss::binary_range_search<faiss::CMin<int, int64_t>, int>(faiss::METRIC_Hamming, cur_query,
+                                                                           (const uint8_t*)xb, 1, nb, (int)radius,
+                                                                           dim / 8, &res, bitset);
+                break;
+            }
+            default: {
+                LOG_KNOWHERE_ERROR_ << "Invalid metric type: " << cfg.metric_type.value();
+                ret = Status::invalid_metric_type;
+                return;
             }
-            return Status::success;
-        }));
-    }
-    for (auto& fut : futs) {
-        fut.wait();
-        auto ret = fut.result().value();
-        if (ret != Status::success) {
-            return expected<DataSetPtr>::Err(ret, "failed to brute force search");
         }
+        results.Query(index).Append(res.distances, res.labels, res.lims[1],
+                                    cfg.range_filter.value() != defaultRangeFilter, is_ip, radius, range_filter);
+    });
+    if (ret != Status::success) {
+        return expected<DataSetPtr>::Err(ret, "failed to brute force search");
     }
 
     int64_t* ids = nullptr;
     float* distances = nullptr;
     size_t* lims = nullptr;
-    GetRangeSearchResult(result_dist_array, result_id_array, is_ip, nq, radius, range_filter, distances, ids, lims);
+    results.Build(cfg, distances, ids, lims);
     return GenResultDataSet(nq, ids, distances, lims);
 }
 }  // namespace knowhere
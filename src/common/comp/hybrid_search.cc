@@ -0,0 +1,188 @@
+// Copyright (C) 2019-2023 Zilliz. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file except in compliance
+// with the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
+// or implied. See the License for the specific language governing permissions and limitations under the License.
+
+#include "knowhere/comp/hybrid_search.h"
+
+#include <strings.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "faiss/utils/Heap.h"
+#include "knowhere/comp/index_param.h"
+#include "knowhere/comp/thread_pool.h"
+#include "knowhere/config.h"
+#include "knowhere/expected.h"
+#include "knowhere/log.h"
+#include "knowhere/utils.h"
+
+namespace knowhere {
+
+namespace {
+
+class HybridSearchConfig : public BaseConfig {
+ public:
+    CFG_STRING hybrid_fusion;
+    CFG_INT rrf_k;
+    CFG_FLOAT dense_weight;
+    CFG_FLOAT sparse_weight;
+    KNOHWERE_DECLARE_CONFIG(HybridSearchConfig) {
+        KNOWHERE_CONFIG_DECLARE_FIELD(hybrid_fusion)
+            .set_default("RRF")
+            .description("how the scores of the dense and the sparse results add up, RRF/WEIGHTED")
+            .for_search();
+        KNOWHERE_CONFIG_DECLARE_FIELD(rrf_k)
+            .set_default(60)
+            .description("the rank offset of RRF, a result of rank r scores weight / (rrf_k + r)")
+            .set_range(0, std::numeric_limits<CFG_INT::value_type>::max())
+            .for_search();
+        KNOWHERE_CONFIG_DECLARE_FIELD(dense_weight)
+            .set_default(1.0f)
+            .description("the weight of the dense results")
+            .set_range(0.0f, std::numeric_limits<CFG_FLOAT::value_type>::max())
+            .for_search();
+        KNOWHERE_CONFIG_DECLARE_FIELD(sparse_weight)
+            .set_default(1.0f)
+            .description("the weight of the sparse results")
+            .set_range(0.0f, std::numeric_limits<CFG_FLOAT::value_type>::max())
+            .for_search();
+    }
+};
+
+// the score of a distance of the metric in [0, 1], the larger the better
+float
+Squash(float distance, bool similarity, bool cosine) {
+    if (cosine) {
+        return (1.0f + distance) * 0.5f;
+    }
+    if (similarity) {
+        return 0.5f + std::atan(distance) / static_cast<float>(M_PI);
+    }
+    return 1.0f - 2.0f * std::atan(distance) / static_cast<float>(M_PI);
+}
+
+}  // namespace
+
+expected<DataSetPtr>
+HybridSearch::Search(const HybridSide& dense, const HybridSide& sparse, const Json& json, const BitsetView& bitset,
+                     std::shared_ptr<CancellationToken> cancellation) {
+    HybridSearchConfig cfg;
+    std::string msg;
+    auto status = Config::Load(cfg, json, knowhere::SEARCH, &msg);
+    if (status != Status::success) {
+        return expected<DataSetPtr>::Err(status, msg);
+    }
+    // both sides share the budget of the call, their searches run under it
+    ThreadPool::ScopedParallelism parallelism(cfg.max_threads.value());
+    auto& fusion = cfg.hybrid_fusion.value();
+    bool rrf = !strcasecmp(fusion.c_str(), "RRF");
+    if (!rrf && strcasecmp(fusion.c_str(), "WEIGHTED")) {
+        return expected<DataSetPtr>::Err(Status::invalid_args, "invalid hybrid_fusion " + fusion);
+    }
+    if (dense.queries == nullptr || sparse.queries == nullptr ||
+        dense.queries->GetRows() != sparse.queries->GetRows()) {
+        return expected<DataSetPtr>::Err(Status::invalid_args, "the sides of a hybrid search need the same queries");
+    }
+    auto nq = dense.queries->GetRows();
+    int64_t k = cfg.k.value();
+
+    // both sides search for k, their results come best first
+    const std::array<const HybridSide*, 2> sides = {&dense, &sparse};
+    const std::array<float, 2> weights = {cfg.dense_weight.value(), cfg.sparse_weight.value()};
+    std::array<DataSetPtr, 2> results;
+    std::mutex error_mutex;
+    expected<DataSetPtr> error = expected<DataSetPtr>::OK();
+    std::atomic<bool> failed = false;
+    ThreadPool::GetGlobalSearchThreadPool()->parallel_for(0, sides.size(), 1, [&](int64_t s) {
+        auto& side = *sides[s];
+        if (failed.load(std::memory_order_relaxed) || side.index.Count() == 0) {
+            return;
+        }
+        auto side_json = side.json;
+        side_json[meta::TOPK] = k;
+        auto res = side.index.Search(*side.queries, side_json, bitset, cancellation);
+        if (!res.has_value()) {
+            std::lock_guard<std::mutex> lock(error_mutex);
+            if (!failed.exchange(true)) {
+                error = res;
+            }
+            return;
+        }
+        results[s] = res.value();
+    });
+    if (failed.load()) {
+        return error;
+    }
+
+    // the metric of each side squashes its distances for WEIGHTED
+    std::array<std::pair<bool, bool>, 2> metrics;
+    for (size_t s = 0; s < sides.size(); ++s) {
+        auto& side_json = sides[s]->json;
+        std::string metric = side_json.contains(meta::METRIC_TYPE) ? side_json[meta::METRIC_TYPE].get<std::string>()
+                                                                   : std::string(metric::L2);
+        bool cosine = IsMetricType(metric, metric::COSINE);
+        metrics[s] = {cosine || IsMetricType(metric, metric::IP), cosine};
+    }
+
+    auto ids = std::make_unique<int64_t[]>(nq * k);
+    auto distances = std::make_unique<float[]>(nq * k);
+    using C = faiss::CMin<float, int64_t>;
+    ThreadPool::GetGlobalSearchThreadPool()->parallel_for(0, nq, 64, [&](int64_t i) {
+        // the scores of the results of both sides, those found by both summed up once sorted by id
+        std::vector<std::pair<int64_t, float>> scored;
+        scored.reserve(2 * k);
+        for (size_t s = 0; s < sides.size(); ++s) {
+            if (results[s] == nullptr) {
+                continue;
+            }
+            auto side_k = results[s]->GetDim();
+            auto side_ids = results[s]->GetIds() + i * side_k;
+            auto side_dis = results[s]->GetDistance() + i * side_k;
+            int64_t rank = 0;
+            for (int64_t j = 0; j < side_k; ++j) {
+                if (side_ids[j] < 0) {
+                    continue;
+                }
+                ++rank;
+                auto score = rrf ? 1.0f / (cfg.rrf_k.value() + rank)
+                                 : Squash(side_dis[j], metrics[s].first, metrics[s].second);
+                scored.emplace_back(side_ids[j], weights[s] * score);
+            }
+        }
+        std::sort(scored.begin(), scored.end());
+
+        auto heap_ids = ids.get() + i * k;
+        auto heap_dis = distances.get() + i * k;
+        faiss::heap_heapify<C>(k, heap_dis, heap_ids);
+        for (size_t j = 0; j < scored.size();) {
+            auto id = scored[j].first;
+            float score = 0;
+            for (; j < scored.size() && scored[j].first == id; ++j) {
+                score += scored[j].second;
+            }
+            if (C::cmp(heap_dis[0], score)) {
+                faiss::heap_replace_top<C>(k, heap_dis, heap_ids, score, id);
+            }
+        }
+        faiss::heap_reorder<C>(k, heap_dis, heap_ids);
+    });
+    return GenResultDataSet(nq, k, ids.release(), distances.release());
+}
+
+}  // namespace knowhere
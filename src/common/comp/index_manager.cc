@@ -0,0 +1,345 @@
+// Copyright (C) 2019-2023 Zilliz. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file except in compliance
+// with the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
+// or implied. See the License for the specific language governing permissions and limitations under the License.
+
+#include "knowhere/comp/index_manager.h"
+
+#include <filesystem>
+#include <limits>
+#include <unordered_set>
+
+#include "knowhere/comp/index_param.h"
+#include "knowhere/comp/thread_pool.h"
+#include "knowhere/factory.h"
+#include "knowhere/log.h"
+
+namespace knowhere {
+
+struct IndexManager::Segment {
+    std::string name;
+    std::string index_type;
+    std::string filename;
+    Json json;
+
+    // the fields below are guarded by the lock of the manager, and only changed under the load lock as well
+    Index<IndexNode> index;
+    Residency residency = kEvicted;
+    bool on_disk = true;
+    bool removed = false;
+    bool prefetching = false;
+    int64_t heap_bytes = 0;
+    int64_t mmap_bytes = 0;
+    // the heap bytes of the segment loaded whole the last time, 0 before its first load
+    int64_t loaded_bytes = 0;
+    uint64_t last_access = 0;
+
+    // held by the loads, demotions and evictions of the segment
+    std::mutex load_mtx;
+};
+
+namespace {
+
+// what a load of the segment is expected to take, the bytes of its file before it was ever loaded
+int64_t
+ExpectedBytes(int64_t loaded_bytes, const std::string& filename) {
+    if (loaded_bytes > 0) {
+        return loaded_bytes;
+    }
+    std::error_code ec;
+    auto size = std::filesystem::file_size(filename, ec);
+    return ec ? 0 : static_cast<int64_t>(size);
+}
+
+expected<Index<IndexNode>>
+LoadIndex(const std::string& index_type, const std::string& filename, const Json& json, bool mmap) {
+    auto index = IndexFactory::Instance().Create(index_type);
+    Json load_json = json;
+    load_json[meta::ENABLE_MMAP] = mmap;
+    auto status = index.DeserializeFromFile(filename, load_json);
+    if (status != Status::success) {
+        return expected<Index<IndexNode>>::Err(status, "failed to load " + index_type + " from " + filename);
+    }
+    return index;
+}
+
+}  // namespace
+
+IndexManager::IndexManager(int64_t budget) : budget_(budget) {
+}
+
+IndexManager::~IndexManager() {
+    std::unique_lock lock(mtx_);
+    prefetch_cv_.wait(lock, [this]() { return prefetching_ == 0; });
+}
+
+Status
+IndexManager::Register(const std::string& name, const std::string& index_type, const std::string& filename,
+                       const Json& json) {
+    auto segment = std::make_shared<Segment>();
+    segment->name = name;
+    segment->index_type = index_type;
+    segment->filename = filename;
+    segment->json = json;
+    std::lock_guard lock(mtx_);
+    if (!segments_.emplace(name, segment).second) {
+        LOG_KNOWHERE_ERROR_ << "segment " << name << " is registered already";
+        return Status::invalid_args;
+    }
+    return Status::success;
+}
+
+Status
+IndexManager::Register(const std::string& name, const Index<IndexNode>& index, const std::string& filename,
+                       const Json& json) {
+    auto segment = std::make_shared<Segment>();
+    segment->name = name;
+    segment->index_type = index.Type();
+    segment->filename = filename;
+    segment->json = json;
+    segment->on_disk = false;
+    {
+        std::lock_guard lock(mtx_);
+        if (!segments_.emplace(name, segment).second) {
+            LOG_KNOWHERE_ERROR_ << "segment " << name << " is registered already";
+            return Status::invalid_args;
+        }
+        Account(*segment, index, kLoaded);
+        segment->loaded_bytes = segment->heap_bytes;
+        segment->last_access = ++tick_;
+    }
+    Fit(segment.get());
+    return Status::success;
+}
+
+Status
+IndexManager::Unregister(const std::string& name) {
+    auto segment = Find(name);
+    if (segment == nullptr) {
+        return Status::invalid_args;
+    }
+    std::lock_guard load(segment->load_mtx);
+    std::lock_guard lock(mtx_);
+    Account(*segment, Index<IndexNode>(), kEvicted);
+    segment->removed = true;
+    segments_.erase(name);
+    return Status::success;
+}
+
+expected<Index<IndexNode>>
+IndexManager::Acquire(const std::string& name) {
+    std::shared_ptr<Segment> segment;
+    {
+        std::lock_guard lock(mtx_);
+        auto it = segments_.find(name);
+        if (it == segments_.end()) {
+            return expected<Index<IndexNode>>::Err(Status::invalid_args, "segment " + name + " is not registered");
+        }
+        segment = it->second;
+        segment->last_access = ++tick_;
+        if (segment->residency == kLoaded) {
+            return segment->index;
+        }
+    }
+    return Load(segment, true);
+}
+
+std::vector<folly::Future<folly::Unit>>
+IndexManager::Prefetch(const std::vector<std::string>& names) {
+    std::vector<folly::Future<folly::Unit>> futs;
+    for (auto& name : names) {
+        std::shared_ptr<Segment> segment;
+        {
+            std::lock_guard lock(mtx_);
+            auto it = segments_.find(name);
+            if (it == segments_.end() || it->second->residency == kLoaded || it->second->prefetching) {
+                continue;
+            }
+            segment = it->second;
+            segment->prefetching = true;
+            ++prefetching_;
+        }
+        futs.emplace_back(ThreadPool::GetGlobalBuildThreadPool()->push([this, segment]() {
+            Load(segment, false);
+            std::lock_guard lock(mtx_);
+            segment->prefetching = false;
+            if (--prefetching_ == 0) {
+                prefetch_cv_.notify_all();
+            }
+        }));
+    }
+    return futs;
+}
+
+IndexManager::Residency
+IndexManager::GetResidency(const std::string& name) const {
+    std::lock_guard lock(mtx_);
+    auto it = segments_.find(name);
+    return it == segments_.end() ? kEvicted : it->second->residency;
+}
+
+void
+IndexManager::SetBudget(int64_t budget) {
+    {
+        std::lock_guard lock(mtx_);
+        budget_ = budget;
+    }
+    Fit(nullptr);
+}
+
+IndexManager::Stats
+IndexManager::GetStats() const {
+    std::lock_guard lock(mtx_);
+    Stats stats = counters_;
+    stats.budget = budget_;
+    stats.heap_bytes = heap_bytes_;
+    for (auto& [name, segment] : segments_) {
+        stats.mmap_bytes += segment->mmap_bytes;
+        stats.loaded += segment->residency == kLoaded;
+        stats.mapped += segment->residency == kMapped;
+        stats.evicted += segment->residency == kEvicted;
+    }
+    return stats;
+}
+
+// A load of the segment whole. Without make_room, as for a prefetch, the segment is only loaded when it fits in the
+// free budget; with it, a mapped segment is searched mapped rather than pushing out others to load it whole.
+expected<Index<IndexNode>>
+IndexManager::Load(const std::shared_ptr<Segment>& segment, bool make_room) {
+    std::lock_guard load(segment->load_mtx);
+    {
+        std::lock_guard lock(mtx_);
+        if (segment->removed) {
+            return expected<Index<IndexNode>>::Err(Status::invalid_args,
+                                                   "segment " + segment->name + " is not registered");
+        }
+        if (segment->residency == kLoaded) {
+            return segment->index;
+        }
+        auto expected_bytes = ExpectedBytes(segment->loaded_bytes, segment->filename);
+        bool fits = heap_bytes_ - segment->heap_bytes + expected_bytes <= budget_;
+        if (!fits && segment->residency == kMapped) {
+            return segment->index;
+        }
+        if (!fits && !make_room) {
+            return expected<Index<IndexNode>>::Err(Status::invalid_args, "no room for segment " + segment->name);
+        }
+    }
+
+    auto index = LoadIndex(segment->index_type, segment->filename, segment->json, false);
+    if (!index.has_value()) {
+        LOG_KNOWHERE_WARNING_ << "segment " << segment->name << ": " << index.what();
+        return index;
+    }
+    {
+        std::lock_guard lock(mtx_);
+        auto heap_bytes = index.value().GetMemoryUsage().In(MemoryUsage::kHeap);
+        if (!make_room && heap_bytes_ - segment->heap_bytes + heap_bytes > budget_) {
+            // larger than its file told, the prefetch is dropped rather than pushing out others
+            segment->loaded_bytes = heap_bytes;
+            return expected<Index<IndexNode>>::Err(Status::invalid_args, "no room for segment " + segment->name);
+        }
+        Account(*segment, index.value(), kLoaded);
+        segment->loaded_bytes = segment->heap_bytes;
+        ++counters_.loads;
+    }
+    if (make_room) {
+        Fit(segment.get());
+    }
+    return index;
+}
+
+std::shared_ptr<IndexManager::Segment>
+IndexManager::Find(const std::string& name) const {
+    std::lock_guard lock(mtx_);
+    auto it = segments_.find(name);
+    return it == segments_.end() ? nullptr : it->second;
+}
+
+void
+IndexManager::Account(Segment& segment, const Index<IndexNode>& index, Residency residency) {
+    heap_bytes_ -= segment.heap_bytes;
+    segment.heap_bytes = 0;
+    segment.mmap_bytes = 0;
+    if (residency != kEvicted) {
+        auto usage = index.GetMemoryUsage();
+        segment.heap_bytes = usage.In(MemoryUsage::kHeap);
+        segment.mmap_bytes = usage.In(MemoryUsage::kMmap);
+    }
+    heap_bytes_ += segment.heap_bytes;
+    segment.index = Index<IndexNode>(index);
+    segment.residency = residency;
+}
+
+void
+IndexManager::Fit(const Segment* keep) {
+    // the segments that could not be demoted, e.g. failing to be written, are not picked again
+    std::unordered_set<const Segment*> skipped;
+    while (true) {
+        std::shared_ptr<Segment> victim;
+        std::unique_lock<std::mutex> victim_load;
+        {
+            std::lock_guard lock(mtx_);
+            if (heap_bytes_ <= budget_) {
+                return;
+            }
+            auto oldest = std::numeric_limits<uint64_t>::max();
+            for (auto& [name, segment] : segments_) {
+                if (segment.get() == keep || segment->residency == kEvicted || segment->heap_bytes == 0 ||
+                    segment->last_access >= oldest || skipped.count(segment.get()) > 0) {
+                    continue;
+                }
+                // a segment busy loading is passed over rather than waited for under the lock
+                std::unique_lock<std::mutex> load(segment->load_mtx, std::try_to_lock);
+                if (!load.owns_lock()) {
+                    continue;
+                }
+                victim = segment;
+                victim_load = std::move(load);
+                oldest = segment->last_access;
+            }
+        }
+        if (victim == nullptr) {
+            return;
+        }
+        if (!Demote(victim)) {
+            skipped.insert(victim.get());
+        }
+    }
+}
+
+bool
+IndexManager::Demote(const std::shared_ptr<Segment>& segment) {
+    // the index only changes under the load lock, which the caller holds
+    if (!segment->on_disk) {
+        auto status = segment->index.SerializeToFile(segment->filename);
+        if (status != Status::success) {
+            LOG_KNOWHERE_WARNING_ << "segment " << segment->name << " can not be written to " << segment->filename
+                                  << ", kept loaded";
+            return false;
+        }
+        std::lock_guard lock(mtx_);
+        segment->on_disk = true;
+    }
+    if (segment->residency == kLoaded) {
+        auto mapped = LoadIndex(segment->index_type, segment->filename, segment->json, true);
+        if (mapped.has_value() && mapped.value().GetMemoryUsage().In(MemoryUsage::kHeap) < segment->heap_bytes) {
+            std::lock_guard lock(mtx_);
+            Account(*segment, mapped.value(), kMapped);
+            ++counters_.demotions;
+            return true;
+        }
+    }
+    std::lock_guard lock(mtx_);
+    Account(*segment, Index<IndexNode>(), kEvicted);
+    ++counters_.evictions;
+    return true;
+}
+
+}  // namespace knowhere
@@ -15,10 +15,15 @@
 
 #ifdef KNOWHERE_WITH_DISKANN
 #include "diskann/aio_context_pool.h"
+#include "diskann/io_uring_aligned_file_reader.h"
+#include "diskann/sector_buffer_pool.h"
 #endif
 #include "faiss/Clustering.h"
 #include "faiss/utils/distances.h"
+#include "knowhere/comp/result_cache.h"
+#include "knowhere/index_node_batching_wrapper.h"
 #include "knowhere/log.h"
+#include "knowhere/search_params.h"
 #ifdef KNOWHERE_WITH_GPU
 #include "index/gpu/gpu_res_mgr.h"
 #endif
@@ -55,11 +60,18 @@ KnowhereConfig::ShowVersion() {
 std::string
 KnowhereConfig::SetSimdType(const SimdType simd_type) {
 #ifdef __x86_64__
-    if (simd_type == SimdType::AUTO) {
+    // AMX is bound over AVX512 only, AVX512 is what it falls back to
+    faiss::use_amx = simd_type == SimdType::AMX;
+    if (simd_type == SimdType::AUTO || simd_type == SimdType::AUTO_TUNED) {
         faiss::use_avx512 = true;
         faiss::use_avx2 = true;
         faiss::use_sse4_2 = true;
-        LOG_KNOWHERE_INFO_ << "FAISS expect simdType::AUTO";
+        LOG_KNOWHERE_INFO_ << "FAISS expect simdType::" << (simd_type == SimdType::AUTO ? "AUTO" : "AUTO_TUNED");
+    } else if (simd_type == SimdType::AMX) {
+        faiss::use_avx512 = true;
+        faiss::use_avx2 = true;
+        faiss::use_sse4_2 = true;
+        LOG_KNOWHERE_INFO_ << "FAISS expect simdType::AMX";
     } else if (simd_type == SimdType::AVX512) {
         faiss::use_avx512 = true;
         faiss::use_avx2 = true;
@@ -81,13 +93,37 @@ KnowhereConfig::SetSimdType(const SimdType simd_type) {
         faiss::use_sse4_2 = false;
         LOG_KNOWHERE_INFO_ << "FAISS expect simdType::GENERIC";
     }
+#elif defined(__aarch64__)
+    // the x86 types have no arm counterpart, all but GENERIC let the hook pick SVE or NEON
+    faiss::use_sve = simd_type != SimdType::GENERIC;
+    faiss::use_neon = simd_type != SimdType::GENERIC;
+    LOG_KNOWHERE_INFO_ << "FAISS expect simdType::" << (simd_type == SimdType::GENERIC ? "GENERIC" : "AUTO");
 #endif
     std::string simd_str;
-    faiss::fvec_hook(simd_str);
-    LOG_KNOWHERE_INFO_ << "FAISS hook " << simd_str;
+    if (simd_type == SimdType::AUTO_TUNED) {
+        // the dims of the unrolled kernels, the dims the collections use the most
+        faiss::fvec_hook_tuned(simd_str, {128, 256, 384, 512, 768, 1024, 1536});
+        LOG_KNOWHERE_INFO_ << "FAISS hook " << simd_str << " tuned " << faiss::fvec_hook_variants();
+    } else {
+        faiss::fvec_hook(simd_str);
+        LOG_KNOWHERE_INFO_ << "FAISS hook " << simd_str;
+    }
     return simd_str;
 }
 
+std::string
+KnowhereConfig::GetSimdKernelVariants() {
+    return faiss::fvec_hook_variants();
+}
+
+void
+KnowhereConfig::SetSqInt8Query(const bool enable) {
+#ifdef __x86_64__
+    faiss::use_sq_int8_query = enable;
+    LOG_KNOWHERE_INFO_ << "Set faiss::use_sq_int8_query to " << enable;
+#endif
+}
+
 void
 KnowhereConfig::SetBlasThreshold(const int64_t use_blas_threshold) {
     LOG_KNOWHERE_INFO_ << "Set faiss::distance_compute_blas_threshold to " << use_blas_threshold;
@@ -121,6 +157,21 @@ KnowhereConfig::SetClusteringType(const ClusteringType clustering_type) {
         case ClusteringType::K_MEANS_PLUS_PLUS:
             faiss::clustering_type = faiss::ClusteringType::K_MEANS_PLUS_PLUS;
             break;
+        case ClusteringType::K_MEANS_PARALLEL:
+            faiss::clustering_type = faiss::ClusteringType::K_MEANS_PARALLEL;
+            break;
+    }
+}
+
+KnowhereConfig::ClusteringType
+KnowhereConfig::GetClusteringType() {
+    switch (faiss::clustering_type) {
+        case faiss::ClusteringType::K_MEANS_PLUS_PLUS:
+            return ClusteringType::K_MEANS_PLUS_PLUS;
+        case faiss::ClusteringType::K_MEANS_PARALLEL:
+            return ClusteringType::K_MEANS_PARALLEL;
+        default:
+            return ClusteringType::K_MEANS;
     }
 }
 
@@ -132,11 +183,28 @@ KnowhereConfig::SetAioContextPool(size_t num_ctx) {
     return true;
 }
 
+bool
+KnowhereConfig::SetIoUringReader(size_t queue_depth, bool sqpoll) {
+#ifdef KNOWHERE_WITH_DISKANN
+    return IoUringAlignedFileReader::InitGlobalConfig(queue_depth, sqpoll);
+#endif
+    return true;
+}
+
+void
+KnowhereConfig::SetDiskANNSectorBufferPool(size_t max_size) {
+#ifdef KNOWHERE_WITH_DISKANN
+    LOG_KNOWHERE_INFO_ << "set diskann sector buffer pool size to " << max_size;
+    diskann::SectorBufferPool::instance().set_capacity(max_size);
+#endif
+}
+
 void
-KnowhereConfig::InitGPUResource(int64_t gpu_id, int64_t res_num) {
+KnowhereConfig::InitGPUResource(int64_t gpu_id, int64_t res_num, int64_t streams_per_res) {
 #ifdef KNOWHERE_WITH_GPU
-    LOG_KNOWHERE_INFO_ << "init GPU resource for gpu id " << gpu_id << ", resource num " << res_num;
-    knowhere::GPUParams gpu_params(res_num);
+    LOG_KNOWHERE_INFO_ << "init GPU resource for gpu id " << gpu_id << ", resource num " << res_num
+                       << ", streams per resource " << streams_per_res;
+    knowhere::GPUParams gpu_params(res_num, streams_per_res);
     knowhere::GPUResMgr::GetInstance().InitDevice(gpu_id, gpu_params);
     knowhere::GPUResMgr::GetInstance().Init();
 #endif
@@ -156,4 +224,34 @@ KnowhereConfig::SetRaftMemPool(size_t init_size, size_t max_size) {
 #endif
 }
 
+void
+KnowhereConfig::SetGpuSearchBatching(int64_t window_us, int64_t max_rows) {
+    IndexNodeBatchingWrapper::SetBatching(window_us, max_rows);
+}
+
+void
+KnowhereConfig::SetSearchParamsCache(size_t capacity) {
+    LOG_KNOWHERE_INFO_ << "Set search params cache capacity: " << capacity;
+    SearchParams::SetCacheCapacity(capacity);
+}
+
+void
+KnowhereConfig::SetResultCache(size_t bytes, size_t shards) {
+    LOG_KNOWHERE_INFO_ << "Set result cache: " << bytes << " bytes in " << shards << " shards";
+    ResultCache::SetCapacity(bytes, shards);
+}
+
+void
+KnowhereConfig::SetPayloadAllocator(PayloadAllocator::HugePages huge_pages, int numa_node) {
+    LOG_KNOWHERE_INFO_ << "Set payload allocator: huge pages " << static_cast<int>(huge_pages) << ", numa node "
+                       << numa_node;
+    PayloadAllocator::Configure(huge_pages, numa_node);
+}
+
+void
+KnowhereConfig::SetLogRateLimit(int64_t messages_per_second) {
+    LOG_KNOWHERE_INFO_ << "Set log rate limit: " << messages_per_second << " messages per second per site";
+    knowhere::SetLogRateLimit(messages_per_second);
+}
+
 }  // namespace knowhere
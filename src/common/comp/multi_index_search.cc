@@ -0,0 +1,132 @@
+// Copyright (C) 2019-2023 Zilliz. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file except in compliance
+// with the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
+// or implied. See the License for the specific language governing permissions and limitations under the License.
+
+#include "knowhere/comp/multi_index_search.h"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "common/metric.h"
+#include "faiss/utils/Heap.h"
+#include "knowhere/comp/thread_pool.h"
+#include "knowhere/config.h"
+#include "knowhere/expected.h"
+#include "knowhere/log.h"
+
+namespace knowhere {
+
+namespace {
+
+class MultiIndexSearchConfig : public BaseConfig {};
+
+template <typename C>
+expected<DataSetPtr>
+SearchAndMerge(const std::vector<SegmentIndex>& segments, const DataSet& dataset, const Json& json, int64_t k,
+               std::shared_ptr<CancellationToken> cancellation) {
+    auto nq = dataset.GetRows();
+    auto ids = std::make_unique<int64_t[]>(nq * k);
+    auto distances = std::make_unique<float[]>(nq * k);
+    for (int64_t i = 0; i < nq; ++i) {
+        faiss::heap_heapify<C>(k, distances.get() + i * k, ids.get() + i * k);
+    }
+    // the top of the heap of every query, read without its lock to drop the results that can not enter it
+    std::vector<std::atomic<float>> kth(nq);
+    for (auto& dis : kth) {
+        dis.store(C::neutral(), std::memory_order_relaxed);
+    }
+    std::vector<std::mutex> locks(nq);
+
+    std::mutex error_mutex;
+    expected<DataSetPtr> error = expected<DataSetPtr>::OK();
+    std::atomic<bool> failed = false;
+    ThreadPool::GetGlobalSearchThreadPool()->parallel_for(0, segments.size(), 1, [&](int64_t s) {
+        auto& segment = segments[s];
+        if (failed.load(std::memory_order_relaxed) || segment.index.Count() == 0) {
+            return;
+        }
+        auto res = segment.index.Search(dataset, json, segment.bitset, cancellation);
+        if (!res.has_value()) {
+            std::lock_guard<std::mutex> lock(error_mutex);
+            if (!failed.exchange(true)) {
+                error = res;
+            }
+            return;
+        }
+        auto seg_ids = res.value()->GetIds();
+        auto seg_dis = res.value()->GetDistance();
+        auto seg_k = res.value()->GetDim();
+        for (int64_t i = 0; i < nq; ++i) {
+            // the results of a query come best first, the ones past the first that can not enter the heap neither can
+            int64_t n = 0;
+            while (n < seg_k && seg_ids[i * seg_k + n] >= 0 &&
+                   C::cmp(kth[i].load(std::memory_order_relaxed), seg_dis[i * seg_k + n])) {
+                ++n;
+            }
+            if (n == 0) {
+                continue;
+            }
+            std::lock_guard<std::mutex> lock(locks[i]);
+            auto heap_dis = distances.get() + i * k;
+            auto heap_ids = ids.get() + i * k;
+            for (int64_t j = 0; j < n; ++j) {
+                auto dis = seg_dis[i * seg_k + j];
+                if (!C::cmp(heap_dis[0], dis)) {
+                    break;
+                }
+                faiss::heap_replace_top<C>(k, heap_dis, heap_ids, dis, seg_ids[i * seg_k + j] + segment.id_offset);
+            }
+            kth[i].store(heap_dis[0], std::memory_order_relaxed);
+        }
+    });
+    if (failed.load()) {
+        return error;
+    }
+
+    for (int64_t i = 0; i < nq; ++i) {
+        faiss::heap_reorder<C>(k, distances.get() + i * k, ids.get() + i * k);
+        // the slots no segment filled
+        for (int64_t j = 0; j < k; ++j) {
+            if (ids[i * k + j] < 0) {
+                distances[i * k + j] = C::neutral();
+            }
+        }
+    }
+    return GenResultDataSet(nq, k, ids.release(), distances.release());
+}
+
+}  // namespace
+
+expected<DataSetPtr>
+MultiIndexSearch::Search(const std::vector<SegmentIndex>& segments, const DataSet& dataset, const Json& json,
+                         std::shared_ptr<CancellationToken> cancellation) {
+    MultiIndexSearchConfig cfg;
+    std::string msg;
+    auto status = Config::Load(cfg, json, knowhere::SEARCH, &msg);
+    if (status != Status::success) {
+        return expected<DataSetPtr>::Err(status, msg);
+    }
+    // the segments share the budget of the call, their searches run under it
+    ThreadPool::ScopedParallelism parallelism(cfg.max_threads.value());
+    auto metric = Str2FaissMetricType(cfg.metric_type.value());
+    if (metric.error() != Status::success) {
+        return expected<DataSetPtr>::Err(metric.error(), metric.what());
+    }
+    int64_t k = cfg.k.value();
+    if (metric.value() == faiss::METRIC_INNER_PRODUCT) {
+        return SearchAndMerge<faiss::CMin<float, int64_t>>(segments, dataset, json, k, std::move(cancellation));
+    }
+    return SearchAndMerge<faiss::CMax<float, int64_t>>(segments, dataset, json, k, std::move(cancellation));
+}
+
+}  // namespace knowhere
@@ -0,0 +1,167 @@
+// Copyright (C) 2019-2023 Zilliz. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file except in compliance
+// with the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
+// or implied. See the License for the specific language governing permissions and limitations under the License
+
+#include "knowhere/comp/numa.h"
+
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include "knowhere/log.h"
+
+namespace knowhere {
+
+namespace {
+
+// linux/mempolicy.h, not every toolchain ships it
+constexpr int kMpolDefault = 0;
+constexpr int kMpolPreferred = 1;
+
+// "0-3,8,10-11" as sysfs writes a cpu list
+std::vector<int>
+ParseCpuList(const std::string& list) {
+    std::vector<int> cpus;
+    std::stringstream ss(list);
+    std::string range;
+    while (std::getline(ss, range, ',')) {
+        if (range.empty() || range == "\n") {
+            continue;
+        }
+        auto dash = range.find('-');
+        int first = std::stoi(range.substr(0, dash));
+        int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+        for (int cpu = first; cpu <= last; ++cpu) {
+            cpus.push_back(cpu);
+        }
+    }
+    return cpus;
+}
+
+std::vector<std::vector<int>>
+ReadNodes() {
+    std::vector<std::vector<int>> nodes;
+    for (int node = 0;; ++node) {
+        std::ifstream file("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+        if (!file.is_open()) {
+            break;
+        }
+        std::string list;
+        std::getline(file, list);
+        try {
+            nodes.push_back(ParseCpuList(list));
+        } catch (const std::exception&) {
+            LOG_KNOWHERE_WARNING_ << "failed to parse the cpus of numa node " << node << ": " << list;
+            nodes.clear();
+            break;
+        }
+    }
+    if (nodes.empty()) {
+        std::vector<int> cpus(std::thread::hardware_concurrency());
+        for (size_t cpu = 0; cpu < cpus.size(); ++cpu) {
+            cpus[cpu] = cpu;
+        }
+        nodes.push_back(std::move(cpus));
+    }
+    return nodes;
+}
+
+const std::vector<std::vector<int>>&
+Nodes() {
+    static const auto nodes = ReadNodes();
+    return nodes;
+}
+
+bool
+NodeCpuSet(int node, cpu_set_t& set) {
+    if (node < 0 || node >= Numa::NodeCount() || Numa::NodeCpus(node).empty()) {
+        return false;
+    }
+    CPU_ZERO(&set);
+    for (auto cpu : Numa::NodeCpus(node)) {
+        CPU_SET(cpu, &set);
+    }
+    return true;
+}
+
+}  // namespace
+
+int
+Numa::NodeCount() {
+    return Nodes().size();
+}
+
+const std::vector<int>&
+Numa::NodeCpus(int node) {
+    static const std::vector<int> none;
+    if (node < 0 || node >= NodeCount()) {
+        return none;
+    }
+    return Nodes()[node];
+}
+
+int
+Numa::TotalCpus() {
+    int total = 0;
+    for (auto& cpus : Nodes()) {
+        total += cpus.size();
+    }
+    return total;
+}
+
+bool
+Numa::PinThread(pthread_t thread, int node) {
+    cpu_set_t set;
+    if (!NodeCpuSet(node, set)) {
+        return false;
+    }
+    int en = pthread_setaffinity_np(thread, sizeof(set), &set);
+    if (en) {
+        LOG_KNOWHERE_WARNING_ << "failed to pin thread to numa node " << node << ": " << std::strerror(en);
+        return false;
+    }
+    return true;
+}
+
+Numa::ScopedNode::ScopedNode(int node) {
+    cpu_set_t set;
+    if (!NodeCpuSet(node, set)) {
+        return;
+    }
+    if (pthread_getaffinity_np(pthread_self(), sizeof(affinity_before_), &affinity_before_) == 0) {
+        pinned_ = pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+    }
+    unsigned long mask = 0;
+    if (node < static_cast<int>(sizeof(mask) * 8)) {
+        mask = 1UL << node;
+        policy_set_ = syscall(SYS_set_mempolicy, kMpolPreferred, &mask, sizeof(mask) * 8 + 1) == 0;
+    }
+    if (!pinned_ || !policy_set_) {
+        LOG_KNOWHERE_WARNING_ << "numa node " << node << " only partly applied, pinned " << pinned_
+                              << ", memory policy " << policy_set_;
+    }
+}
+
+Numa::ScopedNode::~ScopedNode() {
+    if (policy_set_) {
+        syscall(SYS_set_mempolicy, kMpolDefault, nullptr, 0);
+    }
+    if (pinned_) {
+        pthread_setaffinity_np(pthread_self(), sizeof(affinity_before_), &affinity_before_);
+    }
+}
+
+}  // namespace knowhere
@@ -0,0 +1,192 @@
+// Copyright (C) 2019-2023 Zilliz. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file except in compliance
+// with the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
+// or implied. See the License for the specific language governing permissions and limitations under the License
+
+#include "knowhere/comp/payload_allocator.h"
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <unordered_map>
+
+#include "knowhere/log.h"
+
+namespace knowhere {
+
+namespace {
+
+// linux/mempolicy.h and linux/mman.h, not every toolchain ships them
+constexpr int kMpolPreferred = 1;
+constexpr int kHugeShift = 26;
+
+constexpr size_t kPageSize = size_t(4) << 10;
+constexpr size_t kHugePageSize2M = size_t(2) << 20;
+constexpr size_t kHugePageSize1G = size_t(1) << 30;
+
+struct Mapping {
+    size_t length;
+    PayloadAllocator::Backing backing;
+};
+
+struct State {
+    std::atomic<PayloadAllocator::HugePages> huge_pages{PayloadAllocator::HugePages::kTransparent};
+    std::atomic<int> numa_node{-1};
+    std::atomic<size_t> bytes[PayloadAllocator::kBackingNum] = {};
+    std::mutex mutex;
+    std::unordered_map<const void*, Mapping> mappings;
+};
+
+State&
+GetState() {
+    static State state;
+    return state;
+}
+
+size_t
+RoundUp(size_t x, size_t align) {
+    return (x + align - 1) / align * align;
+}
+
+// a mapping of hugetlbfs pages of page_size, or null when the pool has not enough of them
+void*
+MapHugePages(size_t length, size_t page_size) {
+#ifdef MAP_HUGETLB
+    int shift = page_size == kHugePageSize1G ? 30 : 21;
+    void* ptr = mmap(nullptr, length, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | (shift << kHugeShift), -1, 0);
+    return ptr == MAP_FAILED ? nullptr : ptr;
+#else
+    return nullptr;
+#endif
+}
+
+}  // namespace
+
+void
+PayloadAllocator::Configure(HugePages huge_pages, int numa_node) {
+    auto& state = GetState();
+    state.huge_pages.store(huge_pages);
+    state.numa_node.store(numa_node);
+}
+
+void*
+PayloadAllocator::Allocate(size_t size, size_t align) {
+    auto& state = GetState();
+    if (size < kMinMappedSize) {
+        return aligned_alloc(align, RoundUp(std::max<size_t>(size, 1), align));
+    }
+
+    // the largest pages asked for that the pools have, then plain pages
+    auto huge_pages = state.huge_pages.load();
+    void* ptr = nullptr;
+    Mapping mapping{0, kPages};
+    if (huge_pages == HugePages::k1G) {
+        mapping = {RoundUp(size, kHugePageSize1G), kHugePages1G};
+        ptr = MapHugePages(mapping.length, kHugePageSize1G);
+    }
+    if (ptr == nullptr && (huge_pages == HugePages::k1G || huge_pages == HugePages::k2M)) {
+        mapping = {RoundUp(size, kHugePageSize2M), kHugePages2M};
+        ptr = MapHugePages(mapping.length, kHugePageSize2M);
+    }
+    if (ptr == nullptr) {
+        mapping = {RoundUp(size, huge_pages == HugePages::kNone ? kPageSize : kHugePageSize2M), kPages};
+        ptr = mmap(nullptr, mapping.length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (ptr == MAP_FAILED) {
+            LOG_KNOWHERE_WARNING_ << "failed to map " << mapping.length << " bytes: " << std::strerror(errno);
+            return nullptr;
+        }
+#ifdef MADV_HUGEPAGE
+        if (huge_pages != HugePages::kNone && madvise(ptr, mapping.length, MADV_HUGEPAGE) == 0) {
+            mapping.backing = kTransparentHugePages;
+        }
+#endif
+    }
+
+    // the pages are not touched yet, the policy applies to all of them; preferred rather than bound, so that a full
+    // node spills to the others instead of failing
+    int node = state.numa_node.load();
+    if (node >= 0 && node < static_cast<int>(sizeof(unsigned long) * 8)) {
+        unsigned long mask = 1UL << node;
+        if (syscall(SYS_mbind, ptr, mapping.length, kMpolPreferred, &mask, sizeof(mask) * 8 + 1, 0) != 0) {
+            LOG_KNOWHERE_WARNING_ << "failed to bind " << mapping.length << " bytes to numa node " << node << ": "
+                                  << std::strerror(errno);
+        }
+    }
+
+    state.bytes[mapping.backing].fetch_add(mapping.length);
+    std::scoped_lock lock(state.mutex);
+    state.mappings.emplace(ptr, mapping);
+    return ptr;
+}
+
+void
+PayloadAllocator::Free(void* ptr) {
+    if (ptr == nullptr) {
+        return;
+    }
+    auto& state = GetState();
+    Mapping mapping{0, kHeap};
+    {
+        std::scoped_lock lock(state.mutex);
+        auto it = state.mappings.find(ptr);
+        if (it != state.mappings.end()) {
+            mapping = it->second;
+            state.mappings.erase(it);
+        }
+    }
+    if (mapping.backing == kHeap) {
+        free(ptr);
+        return;
+    }
+    munmap(ptr, mapping.length);
+    state.bytes[mapping.backing].fetch_sub(mapping.length);
+}
+
+void*
+PayloadAllocator::Reallocate(void* ptr, size_t old_size, size_t size, size_t align) {
+    void* grown = Allocate(size, align);
+    if (grown == nullptr) {
+        return nullptr;
+    }
+    if (ptr != nullptr) {
+        std::memcpy(grown, ptr, std::min(old_size, size));
+        Free(ptr);
+    }
+    return grown;
+}
+
+size_t
+PayloadAllocator::AllocatedSize(const void* ptr, size_t size) {
+    auto& state = GetState();
+    std::scoped_lock lock(state.mutex);
+    auto it = state.mappings.find(ptr);
+    return it != state.mappings.end() ? it->second.length : size;
+}
+
+size_t
+PayloadAllocator::AllocatedBytes(Backing backing) {
+    return GetState().bytes[backing].load();
+}
+
+const char*
+PayloadAllocator::BackingName(Backing backing) {
+    static const char* names[kBackingNum] = {"heap", "pages", "transparent_huge_pages", "huge_pages_2m",
+                                             "huge_pages_1g"};
+    return names[backing];
+}
+
+}  // namespace knowhere
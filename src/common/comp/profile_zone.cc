@@ -0,0 +1,242 @@
+// Copyright (C) 2019-2023 Zilliz. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file except in compliance
+// with the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
+// or implied. See the License for the specific language governing permissions and limitations under the License.
+
+#include "knowhere/comp/profile_zone.h"
+
+#include <chrono>
+#include <mutex>
+#include <unordered_set>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "knowhere/log.h"
+
+namespace knowhere {
+
+namespace {
+
+struct Counters {
+    std::atomic<uint64_t> calls{0};
+    std::atomic<uint64_t> ns{0};
+    std::atomic<uint64_t> cycles{0};
+    std::atomic<uint64_t> llc_misses{0};
+
+    // only called by the thread the counters are of, so the adds need not be atomic
+    void
+    Add(uint64_t n_ns, uint64_t n_cycles, uint64_t n_llc_misses) {
+        calls.store(calls.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        ns.store(ns.load(std::memory_order_relaxed) + n_ns, std::memory_order_relaxed);
+        cycles.store(cycles.load(std::memory_order_relaxed) + n_cycles, std::memory_order_relaxed);
+        llc_misses.store(llc_misses.load(std::memory_order_relaxed) + n_llc_misses, std::memory_order_relaxed);
+    }
+
+    void
+    Clear() {
+        calls.store(0, std::memory_order_relaxed);
+        ns.store(0, std::memory_order_relaxed);
+        cycles.store(0, std::memory_order_relaxed);
+        llc_misses.store(0, std::memory_order_relaxed);
+    }
+};
+
+void
+Accumulate(ZoneStats& stats, const Counters& counters) {
+    stats.calls += counters.calls.load(std::memory_order_relaxed);
+    stats.ns += counters.ns.load(std::memory_order_relaxed);
+    stats.cycles += counters.cycles.load(std::memory_order_relaxed);
+    stats.llc_misses += counters.llc_misses.load(std::memory_order_relaxed);
+}
+
+struct ThreadZones;
+
+struct Registry {
+    std::mutex mtx;
+    std::vector<std::string> names;
+    std::unordered_set<ThreadZones*> threads;
+    // the stats of the threads that are gone
+    ZoneStats retired[ProfileZones::kMaxZones];
+
+    static Registry&
+    Instance() {
+        static auto registry = new Registry();
+        return *registry;
+    }
+};
+
+// the stats and the perf events of a thread
+struct ThreadZones {
+    Counters zones[ProfileZones::kMaxZones];
+    int cycles_fd = -1;
+    int llc_misses_fd = -1;
+    bool perf_opened = false;
+
+    ThreadZones() {
+        auto& registry = Registry::Instance();
+        std::lock_guard lock(registry.mtx);
+        registry.threads.insert(this);
+    }
+
+    ~ThreadZones() {
+        auto& registry = Registry::Instance();
+        {
+            std::lock_guard lock(registry.mtx);
+            for (int i = 0; i < ProfileZones::kMaxZones; ++i) {
+                Accumulate(registry.retired[i], zones[i]);
+            }
+            registry.threads.erase(this);
+        }
+#ifdef __linux__
+        if (llc_misses_fd >= 0) {
+            close(llc_misses_fd);
+        }
+        if (cycles_fd >= 0) {
+            close(cycles_fd);
+        }
+#endif
+    }
+
+    static ThreadZones&
+    Local() {
+        thread_local ThreadZones zones;
+        return zones;
+    }
+
+    // the cycles and LLC misses of the thread so far, zero when the events can not be opened, e.g. for
+    // perf_event_paranoid or in a container without them
+    void
+    ReadCounters(uint64_t& cycles, uint64_t& llc_misses) {
+        cycles = 0;
+        llc_misses = 0;
+#ifdef __linux__
+        if (!perf_opened) {
+            perf_opened = true;
+            cycles_fd = Open(PERF_COUNT_HW_CPU_CYCLES, -1);
+            if (cycles_fd >= 0) {
+                llc_misses_fd = Open(PERF_COUNT_HW_CACHE_MISSES, cycles_fd);
+            } else {
+                LOG_KNOWHERE_WARNING_ << "profile zones can not open the perf events of the thread, errno " << errno;
+            }
+        }
+        if (cycles_fd < 0) {
+            return;
+        }
+        // PERF_FORMAT_GROUP: the number of events, then their values in the order they joined the group
+        uint64_t values[3] = {0, 0, 0};
+        if (read(cycles_fd, values, sizeof(values)) > 0) {
+            cycles = values[1];
+            llc_misses = values[0] > 1 ? values[2] : 0;
+        }
+#endif
+    }
+
+ private:
+#ifdef __linux__
+    static int
+    Open(uint64_t config, int group_fd) {
+        perf_event_attr attr{};
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = config;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP;
+        return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, 0));
+    }
+#endif
+};
+
+}  // namespace
+
+void
+ProfileZones::SetMode(ProfileMode mode) {
+    mode_.store(mode, std::memory_order_relaxed);
+}
+
+int
+ProfileZones::Register(const char* name) {
+    auto& registry = Registry::Instance();
+    std::lock_guard lock(registry.mtx);
+    for (size_t i = 0; i < registry.names.size(); ++i) {
+        if (registry.names[i] == name) {
+            return static_cast<int>(i);
+        }
+    }
+    if (registry.names.size() == kMaxZones) {
+        LOG_KNOWHERE_WARNING_ << "profile zone " << name << " is past the " << kMaxZones << " zones, not counted";
+        return -1;
+    }
+    registry.names.emplace_back(name);
+    return static_cast<int>(registry.names.size() - 1);
+}
+
+std::vector<ZoneStats>
+ProfileZones::Snapshot() {
+    auto& registry = Registry::Instance();
+    std::lock_guard lock(registry.mtx);
+    std::vector<ZoneStats> stats(registry.names.size());
+    for (size_t i = 0; i < stats.size(); ++i) {
+        stats[i] = registry.retired[i];
+        stats[i].name = registry.names[i];
+        for (auto thread : registry.threads) {
+            Accumulate(stats[i], thread->zones[i]);
+        }
+    }
+    return stats;
+}
+
+void
+ProfileZones::Reset() {
+    auto& registry = Registry::Instance();
+    std::lock_guard lock(registry.mtx);
+    for (int i = 0; i < kMaxZones; ++i) {
+        registry.retired[i] = ZoneStats();
+        // a zone ending meanwhile may be lost or kept
+        for (auto thread : registry.threads) {
+            thread->zones[i].Clear();
+        }
+    }
+}
+
+ProfileZones::Sample
+ProfileZones::Begin(bool counters) {
+    Sample sample{};
+    if (counters) {
+        ThreadZones::Local().ReadCounters(sample.cycles, sample.llc_misses);
+    }
+    sample.ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now().time_since_epoch())
+                    .count();
+    return sample;
+}
+
+void
+ProfileZones::End(int zone, const Sample& begin, bool counters) {
+    if (zone < 0) {
+        return;
+    }
+    uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                      std::chrono::steady_clock::now().time_since_epoch())
+                      .count();
+    auto& local = ThreadZones::Local();
+    uint64_t cycles = 0, llc_misses = 0;
+    if (counters) {
+        local.ReadCounters(cycles, llc_misses);
+        cycles = begin.cycles <= cycles ? cycles - begin.cycles : 0;
+        llc_misses = begin.llc_misses <= llc_misses ? llc_misses - begin.llc_misses : 0;
+    }
+    local.zones[zone].Add(ns - begin.ns, cycles, llc_misses);
+}
+
+}  // namespace knowhere
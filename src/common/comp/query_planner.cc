@@ -0,0 +1,324 @@
+// Copyright (C) 2019-2023 Zilliz. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file except in compliance
+// with the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
+// or implied. See the License for the specific language governing permissions and limitations under the License.
+
+#include "knowhere/comp/query_planner.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <limits>
+#include <mutex>
+#include <numeric>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "knowhere/comp/brute_force.h"
+#include "knowhere/comp/index_param.h"
+#include "knowhere/log.h"
+#include "knowhere/utils.h"
+#include "simd/hook.h"
+
+namespace knowhere {
+
+namespace {
+
+// the ef and search_list_size of a search that sets none, as the configs of HNSW and DiskANN adjust them
+constexpr int64_t kDefaultSearchList = 16;
+// the nlist and nprobe of the IVF configs
+constexpr int64_t kDefaultNlist = 128;
+constexpr int64_t kDefaultNprobe = 8;
+
+std::mutex cost_model_mutex;
+QueryPlanner::CostModel cost_model;
+
+enum class IndexFamily { kFlat, kGraph, kDisk, kIvf, kUnknown };
+
+IndexFamily
+FamilyOf(const std::string& type) {
+    if (type == IndexEnum::INDEX_FAISS_IDMAP || type == IndexEnum::INDEX_FAISS_BIN_IDMAP) {
+        return IndexFamily::kFlat;
+    }
+    if (type.rfind(IndexEnum::INDEX_HNSW, 0) == 0) {
+        return IndexFamily::kGraph;
+    }
+    if (type == IndexEnum::INDEX_DISKANN) {
+        return IndexFamily::kDisk;
+    }
+    if (type.rfind("IVF", 0) == 0 || type == IndexEnum::INDEX_FAISS_BIN_IVFFLAT ||
+        type == IndexEnum::INDEX_FAISS_SCANN) {
+        return IndexFamily::kIvf;
+    }
+    return IndexFamily::kUnknown;
+}
+
+bool
+IsBinaryMetric(const std::string& metric) {
+    return IsMetricType(metric, metric::HAMMING) || IsMetricType(metric, metric::JACCARD) ||
+           IsMetricType(metric, metric::SUBSTRUCTURE) || IsMetricType(metric, metric::SUPERSTRUCTURE);
+}
+
+int64_t
+JsonInt(const Json& json, const char* key, int64_t fallback) {
+    return json.contains(key) && json[key].is_number_integer() ? json[key].get<int64_t>() : fallback;
+}
+
+// the cost of a knn search of nq queries by the index, of the family of the index type
+double
+IndexCost(const QueryPlanner::CostModel& model, IndexFamily family, const Json& json, double n, double alive,
+          double nq, int64_t k, double distance, bool filtered) {
+    // a filtered graph search expands candidates until it holds ef alive ones
+    double alive_ratio = n > 0 ? std::max(alive / n, 1.0 / n) : 1.0;
+    double bit = filtered ? model.bitset_per_id : 0;
+    switch (family) {
+        case IndexFamily::kFlat:
+            return nq * n * distance + (filtered ? n * bit : 0);
+        case IndexFamily::kGraph: {
+            double ef = std::max(JsonInt(json, indexparam::EF, std::max(k, kDefaultSearchList)), k);
+            double distances = std::min(ef / alive_ratio * model.graph_distances_per_candidate, 2 * n);
+            return nq * (model.index_per_query + distances * (distance + model.random_access + bit));
+        }
+        case IndexFamily::kDisk: {
+            double list = std::max(JsonInt(json, indexparam::SEARCH_LIST_SIZE, std::max(k, kDefaultSearchList)), k);
+            double reads = std::min(list / alive_ratio, n);
+            double distances = reads * model.graph_distances_per_candidate;
+            return nq * (model.index_per_query + reads * model.disk_read + distances * (distance + bit));
+        }
+        case IndexFamily::kIvf: {
+            double nlist = JsonInt(json, indexparam::NLIST, kDefaultNlist);
+            nlist = std::max(1.0, std::min(nlist, std::max(n, 1.0)));
+            double nprobe = std::min<double>(JsonInt(json, indexparam::NPROBE, kDefaultNprobe), nlist);
+            double scanned = n * nprobe / nlist;
+            // the lists probed do not hold k alive rows, the index falls short of k where the scans do not
+            if (scanned * alive_ratio < k && alive >= k) {
+                return std::numeric_limits<double>::infinity();
+            }
+            return nq * (model.index_per_query + nlist * distance + nprobe * model.random_access +
+                         scanned * (distance + bit));
+        }
+        default:
+            return 0;
+    }
+}
+
+// the alive ids of the n first ones of bitset, enumerated by next_unset
+std::vector<int64_t>
+AliveIds(const BitsetView& bitset, size_t n) {
+    std::vector<int64_t> ids;
+    ids.reserve(n - std::min(n, bitset.count()));
+    for (size_t id = bitset.next_unset(0); id < n; id = bitset.next_unset(id + 1)) {
+        ids.push_back(id);
+    }
+    return ids;
+}
+
+template <typename Fn>
+double
+TimeNs(Fn&& fn) {
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+}
+
+}  // namespace
+
+void
+QueryPlanner::SetCostModel(const CostModel& model) {
+    std::lock_guard<std::mutex> lock(cost_model_mutex);
+    cost_model = model;
+}
+
+QueryPlanner::CostModel
+QueryPlanner::GetCostModel() {
+    std::lock_guard<std::mutex> lock(cost_model_mutex);
+    return cost_model;
+}
+
+QueryPlanner::CostModel
+QueryPlanner::Calibrate() {
+    // a base of 64 MB, well past the caches, scanned in order and at random
+    constexpr size_t dim = 128;
+    constexpr size_t rows = (64 << 20) / (dim * sizeof(float));
+    constexpr size_t seq_rows = 4096;
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+    std::vector<float> base(rows * dim);
+    for (auto& v : base) {
+        v = dist(rng);
+    }
+    std::vector<float> query(base.begin(), base.begin() + dim);
+    std::vector<size_t> order(rows);
+    std::iota(order.begin(), order.end(), 0);
+    std::shuffle(order.begin(), order.end(), rng);
+    volatile float sink = 0;
+
+    auto model = GetCostModel();
+    // the rows of the sequential scan stay in the cache over the rounds, as the blocks of a brute force scan do
+    double seq_ns = std::numeric_limits<double>::max();
+    for (int round = 0; round < 8; ++round) {
+        seq_ns = std::min(seq_ns, TimeNs([&] {
+                              float sum = 0;
+                              for (size_t i = 0; i < seq_rows; ++i) {
+                                  sum += faiss::fvec_L2sqr(query.data(), base.data() + i * dim, dim);
+                              }
+                              sink = sink + sum;
+                          }));
+    }
+    model.distance_per_dim = seq_ns / (seq_rows * dim);
+
+    auto rand_ns = TimeNs([&] {
+        float sum = 0;
+        for (auto i : order) {
+            sum += faiss::fvec_L2sqr(query.data(), base.data() + i * dim, dim);
+        }
+        sink = sink + sum;
+    });
+    model.random_access = std::max(0.0, rand_ns / rows - dim * model.distance_per_dim);
+
+    // a bitset keeping half the rows, enumerated and gathered as kBruteForceAliveIds does
+    std::vector<uint8_t> bits(rows / 8);
+    for (auto& b : bits) {
+        b = rng();
+    }
+    BitsetView bitset(bits.data(), rows);
+    std::vector<int64_t> ids;
+    model.bitset_per_id = TimeNs([&] { ids = AliveIds(bitset, rows); }) / rows;
+    std::vector<float> gathered(ids.size() * dim);
+    auto gather_ns = TimeNs([&] {
+        for (size_t i = 0; i < ids.size(); ++i) {
+            std::memcpy(gathered.data() + i * dim, base.data() + ids[i] * dim, dim * sizeof(float));
+        }
+        sink = sink + gathered[ids.size() / 2 * dim];
+    });
+    model.gather_per_dim = ids.empty() ? model.gather_per_dim : gather_ns / (ids.size() * dim);
+
+    LOG_KNOWHERE_INFO_ << "query planner calibrated: distance per dim " << model.distance_per_dim
+                       << " ns, random access " << model.random_access << " ns, bitset per id "
+                       << model.bitset_per_id << " ns, gather per dim " << model.gather_per_dim << " ns";
+    SetCostModel(model);
+    return model;
+}
+
+QueryPlanner::Plan
+QueryPlanner::Choose(const Index<IndexNode>& index, bool has_base, int64_t nq, const Json& json,
+                     const BitsetView& bitset) {
+    auto family = FamilyOf(index.Type());
+    if (family == IndexFamily::kUnknown || !json.contains(meta::METRIC_TYPE)) {
+        return Plan::kIndex;
+    }
+    auto metric = json[meta::METRIC_TYPE].get<std::string>();
+    bool gather_by_ids = !has_base;
+    if (gather_by_ids && !index.HasRawData(metric)) {
+        return Plan::kIndex;
+    }
+
+    auto model = GetCostModel();
+    double n = index.Count();
+    double filtered_out = bitset.empty() ? 0 : std::min<double>(bitset.count(), n);
+    double alive = n - filtered_out;
+    int64_t k = JsonInt(json, meta::TOPK, 10);
+    double dims = IsBinaryMetric(metric) ? index.Dim() / 32.0 : index.Dim();
+    double distance = dims * model.distance_per_dim;
+
+    double index_cost = IndexCost(model, family, json, n, alive, nq, k, distance, filtered_out > 0);
+    double brute_force_cost = gather_by_ids ? std::numeric_limits<double>::infinity()
+                                            : nq * n * distance + (filtered_out > 0 ? n * model.bitset_per_id : 0);
+    double fetch = gather_by_ids ? (family == IndexFamily::kDisk ? model.disk_read : model.random_access) : 0;
+    double alive_cost = filtered_out > 0 ? n * model.bitset_per_id + alive * (dims * model.gather_per_dim + fetch) +
+                                               nq * alive * distance
+                                         : std::numeric_limits<double>::infinity();
+
+    // ties go to the index, the brute force plans only win by their own costs
+    auto plan = Plan::kIndex;
+    double best = index_cost;
+    if (brute_force_cost < best) {
+        plan = Plan::kBruteForce;
+        best = brute_force_cost;
+    }
+    if (alive_cost < best) {
+        plan = Plan::kBruteForceAliveIds;
+        best = alive_cost;
+    }
+    LOG_KNOWHERE_DEBUG_ << "query planner " << index.Type() << " rows " << n << " alive " << alive << " nq " << nq
+                        << " k " << k << ": index " << index_cost << " ns, brute force " << brute_force_cost
+                        << " ns, alive ids " << alive_cost << " ns, plan " << PlanName(plan);
+    return plan;
+}
+
+expected<DataSetPtr>
+QueryPlanner::Search(const Index<IndexNode>& index, const DataSetPtr base, const DataSetPtr queries, const Json& json,
+                     const BitsetView& bitset, std::shared_ptr<CancellationToken> cancellation) {
+    auto plan = Choose(index, base != nullptr, queries->GetRows(), json, bitset);
+    if (plan == Plan::kIndex) {
+        return index.Search(*queries, json, bitset, std::move(cancellation));
+    }
+    if (cancellation != nullptr && cancellation->IsCancelled()) {
+        return expected<DataSetPtr>::Err(Status::search_cancelled, "search cancelled");
+    }
+    if (plan == Plan::kBruteForce) {
+        return BruteForce::Search(base, queries, json, bitset);
+    }
+
+    auto ids = AliveIds(bitset, index.Count());
+    auto dim = index.Dim();
+    bool is_binary = IsBinaryMetric(json[meta::METRIC_TYPE].get<std::string>());
+    size_t row_bytes = is_binary ? (dim + 7) / 8 : dim * sizeof(float);
+    DataSetPtr alive_base;
+    std::vector<uint8_t> gathered;
+    if (base != nullptr) {
+        gathered.resize(ids.size() * row_bytes);
+        auto data = static_cast<const uint8_t*>(base->GetTensor());
+        for (size_t i = 0; i < ids.size(); ++i) {
+            std::memcpy(gathered.data() + i * row_bytes, data + ids[i] * row_bytes, row_bytes);
+        }
+        alive_base = std::make_shared<DataSet>();
+        alive_base->SetRows(ids.size());
+        alive_base->SetDim(dim);
+        alive_base->SetTensor(gathered.data());
+        alive_base->SetIsOwner(false);
+    } else {
+        auto fetched = index.GetVectorByIds(*GenIdsDataSet(ids.size(), ids.data()));
+        if (!fetched.has_value()) {
+            return expected<DataSetPtr>::Err(fetched.error(), fetched.what());
+        }
+        alive_base = fetched.value();
+        alive_base->SetDim(dim);
+    }
+
+    auto res = BruteForce::Search(alive_base, queries, json, nullptr);
+    if (!res.has_value()) {
+        return res;
+    }
+    // the ids of the results are the positions among the alive rows
+    auto res_ids = const_cast<int64_t*>(res.value()->GetIds());
+    auto len = res.value()->GetRows() * res.value()->GetDim();
+    for (int64_t i = 0; i < len; ++i) {
+        if (res_ids[i] >= 0) {
+            res_ids[i] = ids[res_ids[i]];
+        }
+    }
+    return res;
+}
+
+const char*
+QueryPlanner::PlanName(Plan plan) {
+    switch (plan) {
+        case Plan::kIndex:
+            return "index";
+        case Plan::kBruteForce:
+            return "brute_force";
+        case Plan::kBruteForceAliveIds:
+            return "brute_force_alive_ids";
+    }
+    return "unknown";
+}
+
+}  // namespace knowhere
@@ -0,0 +1,86 @@
+// Copyright (C) 2019-2023 Zilliz. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file except in compliance
+// with the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
+// or implied. See the License for the specific language governing permissions and limitations under the License.
+
+#include "knowhere/comp/query_trace.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace knowhere {
+
+QueryTraceBuffer::QueryTraceBuffer() : slots_(std::make_unique<Slot[]>(kCapacity)) {
+}
+
+QueryTraceBuffer&
+QueryTraceBuffer::Instance() {
+    static QueryTraceBuffer buffer;
+    return buffer;
+}
+
+void
+QueryTraceBuffer::Push(const QueryTrace& trace) {
+    auto n = pushed_.fetch_add(1, std::memory_order_relaxed) + 1;
+    auto& slot = slots_[(n - 1) % kCapacity];
+    // a writer lapped by n - kCapacity further pushes may still be in the slot, its trace is then lost
+    slot.seq.store(n * 2 - 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    std::memcpy(&slot.trace, &trace, sizeof(QueryTrace));
+    slot.seq.store(n * 2, std::memory_order_release);
+}
+
+std::vector<QueryTrace>
+QueryTraceBuffer::Read(uint64_t& cursor) const {
+    auto pushed = pushed_.load(std::memory_order_acquire);
+    auto first = std::max<uint64_t>(cursor, pushed > kCapacity ? pushed - kCapacity : 0);
+    std::vector<QueryTrace> traces;
+    traces.reserve(pushed - std::min(first, pushed));
+    for (auto n = first + 1; n <= pushed; ++n) {
+        const auto& slot = slots_[(n - 1) % kCapacity];
+        QueryTrace trace;
+        if (slot.seq.load(std::memory_order_acquire) != n * 2) {
+            continue;
+        }
+        std::memcpy(&trace, &slot.trace, sizeof(QueryTrace));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.seq.load(std::memory_order_relaxed) == n * 2) {
+            traces.push_back(trace);
+        }
+    }
+    cursor = std::max(cursor, pushed);
+    return traces;
+}
+
+bool
+QueryTraceScope::Sampled(float sample_rate) {
+    // xorshift of the thread, seeded by the address of its state
+    thread_local uint64_t state = reinterpret_cast<uintptr_t>(&state) | 1;
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return static_cast<float>(state >> 40) < sample_rate * static_cast<float>(uint64_t{1} << 24);
+}
+
+void
+QueryTraceScope::Finish() {
+    auto elapsed = std::chrono::steady_clock::now() - start_;
+    QueryTrace trace;
+    std::memset(&trace, 0, sizeof(QueryTrace));
+    index_type_.copy(trace.index_type, QueryTrace::kIndexTypeSize - 1);
+    trace.query = query_;
+    trace.total_us = std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+    trace.start_us = std::chrono::duration_cast<std::chrono::microseconds>(
+                         (std::chrono::system_clock::now() - elapsed).time_since_epoch())
+                         .count();
+    trace.stats = QueryStats::Current();
+    QueryTraceBuffer::Instance().Push(trace);
+}
+
+}  // namespace knowhere
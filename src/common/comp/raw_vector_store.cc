@@ -0,0 +1,55 @@
+// Copyright (C) 2019-2023 Zilliz. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file except in compliance
+// with the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
+// or implied. See the License for the specific language governing permissions and limitations under the License
+
+#include "knowhere/comp/raw_vector_store.h"
+
+#include <cstring>
+
+namespace knowhere {
+
+std::shared_ptr<const RawVectorStore>
+RawVectorStore::Copy(const void* rows, int64_t n, int64_t dim, size_t row_size) {
+    std::shared_ptr<RawVectorStore> store(new RawVectorStore(dim, row_size));
+    store->heap_.resize(n * row_size);
+    if (n > 0) {
+        std::memcpy(store->heap_.data(), rows, n * row_size);
+    }
+    store->data_ = store->heap_.data();
+    store->rows_ = n;
+    return store;
+}
+
+std::shared_ptr<const RawVectorStore>
+RawVectorStore::View(const void* rows, int64_t n, int64_t dim, size_t row_size, std::shared_ptr<const void> owner,
+                     bool mapped) {
+    std::shared_ptr<RawVectorStore> store(new RawVectorStore(dim, row_size));
+    store->owner_ = std::move(owner);
+    store->data_ = static_cast<const uint8_t*>(rows);
+    store->rows_ = n;
+    store->mapped_ = mapped;
+    return store;
+}
+
+uint8_t*
+RawVectorStore::Grow(std::shared_ptr<const RawVectorStore>& store, int64_t n) {
+    if (store.use_count() != 1 || store->owner_ != nullptr || store->data_ != store->heap_.data()) {
+        store = Copy(store->data_, store->rows_, store->dim_, store->row_size_);
+    }
+    // the stores are created mutable by Copy and View, this one is referred to by store alone
+    auto grown = const_cast<RawVectorStore*>(store.get());
+    grown->heap_.resize((grown->rows_ + n) * grown->row_size_);
+    grown->data_ = grown->heap_.data();
+    auto rows = grown->heap_.data() + grown->rows_ * grown->row_size_;
+    grown->rows_ += n;
+    return rows;
+}
+
+}  // namespace knowhere
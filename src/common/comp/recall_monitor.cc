@@ -0,0 +1,191 @@
+// Copyright (C) 2019-2023 Zilliz. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file except in compliance
+// with the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
+// or implied. See the License for the specific language governing permissions and limitations under the License.
+
+#include "knowhere/comp/recall_monitor.h"
+
+#include <algorithm>
+#include <cstring>
+#include <random>
+#include <utility>
+
+#include "knowhere/comp/brute_force.h"
+#include "knowhere/comp/index_param.h"
+#include "knowhere/comp/thread_pool.h"
+#include "knowhere/log.h"
+#include "knowhere/prometheus_client.h"
+#include "knowhere/utils.h"
+
+namespace knowhere {
+
+namespace {
+
+// the batches of sampled queries searched again at once, the samples past them are dropped
+constexpr int64_t kMaxInFlight = 2;
+
+bool
+IsBinaryMetric(const std::string& metric) {
+    return IsMetricType(metric, metric::HAMMING) || IsMetricType(metric, metric::JACCARD) ||
+           IsMetricType(metric, metric::SUBSTRUCTURE) || IsMetricType(metric, metric::SUPERSTRUCTURE);
+}
+
+// the share of the valid ids of the k first of gt found among the k first of res, -1 without valid ones
+float
+QueryRecall(const int64_t* gt, const int64_t* res, int64_t k) {
+    int64_t valid = 0;
+    int64_t found = 0;
+    for (int64_t i = 0; i < k; ++i) {
+        if (gt[i] < 0) {
+            continue;
+        }
+        ++valid;
+        found += std::find(res, res + k, gt[i]) != res + k;
+    }
+    return valid > 0 ? static_cast<float>(found) / valid : -1.0f;
+}
+
+}  // namespace
+
+RecallMonitor::RecallMonitor(DataSetPtr base, float sample_rate, const std::string& label, int64_t window)
+    : sample_rate_(sample_rate),
+      window_(std::max<int64_t>(1, window)),
+      gauge_(&GetSearchRecallGauge(label)),
+      base_(std::move(base)) {
+    recalls_.reserve(window_);
+}
+
+RecallMonitor::~RecallMonitor() {
+    Wait();
+}
+
+void
+RecallMonitor::SetBase(DataSetPtr base) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    base_ = std::move(base);
+}
+
+void
+RecallMonitor::Observe(const DataSet& queries, const std::string& metric_type, int64_t k, const BitsetView& bitset,
+                       const DataSet& result) {
+    if (sample_rate_ <= 0 || queries.GetTensor() == nullptr || queries.GetDataType() != DataType::FLOAT32 ||
+        result.GetLims() != nullptr) {
+        return;
+    }
+    auto nq = queries.GetRows();
+    thread_local std::mt19937_64 rng(std::random_device{}());
+    std::uniform_real_distribution<float> coin(0.0f, 1.0f);
+    std::vector<int64_t> sampled;
+    for (int64_t i = 0; i < nq; ++i) {
+        if (coin(rng) < sample_rate_) {
+            sampled.push_back(i);
+        }
+    }
+    if (sampled.empty()) {
+        return;
+    }
+
+    DataSetPtr base;
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (base_ == nullptr || in_flight_ >= kMaxInFlight) {
+            return;
+        }
+        base = base_;
+        ++in_flight_;
+    }
+
+    // the sampled queries and their results, and the filter, are copied for the search in the background
+    auto dim = queries.GetDim();
+    size_t row_bytes = IsBinaryMetric(metric_type) ? (dim + 7) / 8 : dim * sizeof(float);
+    auto res_k = std::min<int64_t>(k, result.GetDim());
+    auto rows = static_cast<int64_t>(sampled.size());
+    auto xq = std::make_shared<std::vector<uint8_t>>(rows * row_bytes);
+    auto res_ids = std::make_shared<std::vector<int64_t>>(rows * res_k);
+    auto tensor = static_cast<const uint8_t*>(queries.GetTensor());
+    for (int64_t r = 0; r < rows; ++r) {
+        std::memcpy(xq->data() + r * row_bytes, tensor + sampled[r] * row_bytes, row_bytes);
+        std::copy_n(result.GetIds() + sampled[r] * result.GetDim(), res_k, res_ids->data() + r * res_k);
+    }
+    auto bits = std::make_shared<std::vector<uint8_t>>();
+    size_t num_bits = bitset.size();
+    if (!bitset.empty()) {
+        auto dense = bitset.to_dense(*bits);
+        if (dense.data() != bits->data()) {
+            bits->assign(dense.data(), dense.data() + dense.byte_size());
+        }
+    }
+
+    Json json;
+    json[meta::METRIC_TYPE] = metric_type;
+    json[meta::TOPK] = res_k;
+    json[meta::DIM] = dim;
+    ThreadPool::GetGlobalBuildThreadPool()->push([this, base, xq, res_ids, bits, num_bits, rows, dim, res_k, json] {
+        std::vector<float> recalls;
+        try {
+            auto query_ds = GenDataSet(rows, dim, xq->data());
+            BitsetView filter = bits->empty() ? BitsetView(nullptr) : BitsetView(bits->data(), num_bits);
+            auto gt = BruteForce::Search(base, query_ds, json, filter);
+            if (gt.has_value()) {
+                for (int64_t r = 0; r < rows; ++r) {
+                    auto recall = QueryRecall(gt.value()->GetIds() + r * res_k, res_ids->data() + r * res_k, res_k);
+                    if (recall >= 0) {
+                        recalls.push_back(recall);
+                    }
+                }
+            } else {
+                LOG_KNOWHERE_WARNING_ << "recall monitor brute force search failed: " << gt.what();
+            }
+        } catch (const std::exception& e) {
+            LOG_KNOWHERE_WARNING_ << "recall monitor brute force search failed: " << e.what();
+        }
+        Record(recalls);
+    });
+}
+
+void
+RecallMonitor::Record(const std::vector<float>& recalls) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    for (auto recall : recalls) {
+        if (static_cast<int64_t>(recalls_.size()) < window_) {
+            recalls_.push_back(recall);
+        } else {
+            sum_ -= recalls_[next_];
+            recalls_[next_] = recall;
+            next_ = (next_ + 1) % window_;
+        }
+        sum_ += recall;
+        ++samples_;
+    }
+    if (!recalls_.empty()) {
+        gauge_->Set(sum_ / recalls_.size());
+    }
+    --in_flight_;
+    done_cv_.notify_all();
+}
+
+float
+RecallMonitor::Recall() const {
+    std::lock_guard<std::mutex> lock(mtx_);
+    return recalls_.empty() ? -1.0f : static_cast<float>(sum_ / recalls_.size());
+}
+
+int64_t
+RecallMonitor::Samples() const {
+    std::lock_guard<std::mutex> lock(mtx_);
+    return samples_;
+}
+
+void
+RecallMonitor::Wait() const {
+    std::unique_lock<std::mutex> lock(mtx_);
+    done_cv_.wait(lock, [this] { return in_flight_ == 0; });
+}
+
+}  // namespace knowhere
@@ -0,0 +1,117 @@
+// Copyright (C) 2019-2023 Zilliz. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file except in compliance
+// with the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
+// or implied. See the License for the specific language governing permissions and limitations under the License.
+
+#include "knowhere/comp/result_cache.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "common/lru_cache.h"
+
+namespace knowhere {
+
+namespace {
+
+struct KeyHash {
+    size_t
+    operator()(const ResultCache::Key& key) const {
+        uint64_t h = key.index_version;
+        h = h * 0x9e3779b97f4a7c15ULL + key.config_hash;
+        h = h * 0x9e3779b97f4a7c15ULL + static_cast<uint64_t>(key.filter_version);
+        h = h * 0x9e3779b97f4a7c15ULL + key.query_hash;
+        return h;
+    }
+};
+
+struct CachedResult {
+    std::vector<uint8_t> query;
+    std::vector<int64_t> ids;
+    std::vector<float> distances;
+};
+
+using Cache = concurrent_cache<ResultCache::Key, std::shared_ptr<const CachedResult>, KeyHash>;
+
+std::shared_ptr<Cache> cache;
+std::atomic<bool> cache_enabled{false};
+std::atomic<uint64_t> hits{0};
+std::atomic<uint64_t> misses{0};
+std::atomic<uint64_t> next_version{1};
+
+}  // namespace
+
+bool
+ResultCache::Enabled() {
+    return cache_enabled.load(std::memory_order_relaxed);
+}
+
+bool
+ResultCache::Get(const Key& key, const uint8_t* query, size_t query_size, int64_t k, int64_t* ids,
+                 float* distances) {
+    auto c = std::atomic_load(&cache);
+    std::shared_ptr<const CachedResult> entry;
+    if (c == nullptr || !c->try_get(key, entry) || entry->ids.size() != static_cast<size_t>(k) ||
+        entry->query.size() != query_size || std::memcmp(entry->query.data(), query, query_size) != 0) {
+        misses.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    std::copy(entry->ids.begin(), entry->ids.end(), ids);
+    std::copy(entry->distances.begin(), entry->distances.end(), distances);
+    hits.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+void
+ResultCache::Put(const Key& key, const uint8_t* query, size_t query_size, int64_t k, const int64_t* ids,
+                 const float* distances) {
+    auto c = std::atomic_load(&cache);
+    if (c == nullptr) {
+        return;
+    }
+    auto entry = std::make_shared<CachedResult>();
+    entry->query.assign(query, query + query_size);
+    entry->ids.assign(ids, ids + k);
+    entry->distances.assign(distances, distances + k);
+    // the entry, its arrays and the node of the lru list and of the map that hold it
+    size_t charge = sizeof(CachedResult) + query_size + k * (sizeof(int64_t) + sizeof(float)) + 2 * sizeof(Key) +
+                    8 * sizeof(void*);
+    c->put(key, std::move(entry), charge);
+}
+
+uint64_t
+ResultCache::HashConfig(const Json& json) {
+    return std::hash<std::string>{}(json.dump());
+}
+
+uint64_t
+ResultCache::NewVersion() {
+    return next_version.fetch_add(1, std::memory_order_relaxed);
+}
+
+void
+ResultCache::SetCapacity(size_t bytes, size_t shards) {
+    std::atomic_store(&cache, bytes > 0 ? std::make_shared<Cache>(bytes, shards) : nullptr);
+    cache_enabled.store(bytes > 0, std::memory_order_relaxed);
+}
+
+ResultCache::Stats
+ResultCache::GetStats() {
+    Stats stats;
+    stats.hits = hits.load(std::memory_order_relaxed);
+    stats.misses = misses.load(std::memory_order_relaxed);
+    auto c = std::atomic_load(&cache);
+    stats.bytes = c != nullptr ? c->charge() : 0;
+    return stats;
+}
+
+}  // namespace knowhere
@@ -0,0 +1,173 @@
+// Copyright (C) 2019-2023 Zilliz. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file except in compliance
+// with the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
+// or implied. See the License for the specific language governing permissions and limitations under the License.
+
+#ifndef GPU_METRICS_H
+#define GPU_METRICS_H
+
+#include <cuda_runtime.h>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <type_traits>
+#include <vector>
+
+#include "knowhere/prometheus_client.h"
+
+namespace knowhere {
+
+// The device time of the stages of a GPU search, by timing events recorded around the work of a stage on its stream,
+// and the bytes of its copies, into the GpuMetrics of the index type. The events are read by Flush once the host has
+// waited for the streams, so the timing adds no wait of its own; the waits are timed on the host, as the sync stage.
+// The events come from a pool of the thread, and a failure to record or read them only loses the sample, never fails
+// the search.
+class GpuStageTimer {
+ public:
+    enum Stage { kH2D, kKernel, kSlice, kD2H };
+
+    explicit GpuStageTimer(const GpuMetrics& metrics) : metrics_(metrics) {
+    }
+
+    ~GpuStageTimer() {
+        Flush();
+    }
+
+    GpuStageTimer(const GpuStageTimer&) = delete;
+    GpuStageTimer&
+    operator=(const GpuStageTimer&) = delete;
+
+    // runs fn, which queues the work of stage on stream, between the two events of a span, and returns what it does
+    template <typename Fn>
+    auto
+    Time(Stage stage, cudaStream_t stream, Fn&& fn) {
+        auto span = Begin(stage, stream);
+        if constexpr (std::is_void_v<std::invoke_result_t<Fn>>) {
+            fn();
+            End(span, stream);
+        } else {
+            auto result = fn();
+            End(span, stream);
+            return result;
+        }
+    }
+
+    // runs fn, which waits for the device, as the sync stage, then reads the spans that are done
+    template <typename Fn>
+    void
+    Sync(Fn&& fn) {
+        auto begin = std::chrono::steady_clock::now();
+        fn();
+        metrics_.sync_wait.Observe(
+            std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - begin).count());
+        Flush();
+    }
+
+    void
+    H2D(size_t bytes) {
+        metrics_.h2d_bytes.Increment(bytes);
+    }
+
+    void
+    D2H(size_t bytes) {
+        metrics_.d2h_bytes.Increment(bytes);
+    }
+
+    // observes the spans of which the device is done and gives the events of all of them back to the pool, the ones
+    // the device is not done with are dropped
+    void
+    Flush() {
+        for (auto& span : spans_) {
+            float ms = 0;
+            if (span.ended && cudaEventQuery(span.end) == cudaSuccess &&
+                cudaEventElapsedTime(&ms, span.begin, span.end) == cudaSuccess) {
+                Histogram(span.stage).Observe(ms * 1000);
+            }
+            auto& pool = Pool(span.device);
+            pool.push_back(span.begin);
+            pool.push_back(span.end);
+        }
+        spans_.clear();
+    }
+
+ private:
+    struct Span {
+        Stage stage;
+        int device;
+        cudaEvent_t begin;
+        cudaEvent_t end;
+        bool ended;
+    };
+
+    // the timing events of the current device a thread reuses from search to search, they live as long as the thread
+    static std::vector<cudaEvent_t>&
+    Pool(int device) {
+        thread_local std::map<int, std::vector<cudaEvent_t>> pools;
+        return pools[device];
+    }
+
+    static bool
+    TakeEvent(int device, cudaEvent_t& event) {
+        auto& pool = Pool(device);
+        if (!pool.empty()) {
+            event = pool.back();
+            pool.pop_back();
+            return true;
+        }
+        return cudaEventCreate(&event) == cudaSuccess;
+    }
+
+    // the index of the span in spans_, or -1 when it could not be recorded
+    int64_t
+    Begin(Stage stage, cudaStream_t stream) {
+        Span span{stage, 0, nullptr, nullptr, false};
+        if (cudaGetDevice(&span.device) != cudaSuccess || !TakeEvent(span.device, span.begin)) {
+            return -1;
+        }
+        if (!TakeEvent(span.device, span.end)) {
+            Pool(span.device).push_back(span.begin);
+            return -1;
+        }
+        spans_.push_back(span);
+        if (cudaEventRecord(span.begin, stream) != cudaSuccess) {
+            return -1;
+        }
+        return spans_.size() - 1;
+    }
+
+    void
+    End(int64_t span, cudaStream_t stream) {
+        if (span >= 0) {
+            spans_[span].ended = cudaEventRecord(spans_[span].end, stream) == cudaSuccess;
+        }
+    }
+
+    prometheus::Histogram&
+    Histogram(Stage stage) const {
+        switch (stage) {
+            case kH2D:
+                return metrics_.h2d_latency;
+            case kKernel:
+                return metrics_.kernel_latency;
+            case kSlice:
+                return metrics_.slice_latency;
+            default:
+                return metrics_.d2h_latency;
+        }
+    }
+
+    const GpuMetrics& metrics_;
+    std::vector<Span> spans_;
+};
+
+}  // namespace knowhere
+
+#endif /* GPU_METRICS_H */
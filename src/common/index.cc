@@ -11,10 +11,32 @@
 
 #include "knowhere/index.h"
 
+#include <strings.h>
+
+#include <algorithm>
+#include <atomic>
+#include <future>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <numeric>
+#include <tuple>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+
+#include "io/index_file.h"
+#include "knowhere/comp/binary_codec.h"
+#include "knowhere/comp/numa.h"
+#include "knowhere/comp/profile_zone.h"
+#include "knowhere/comp/result_cache.h"
+#include "knowhere/comp/thread_pool.h"
 #include "knowhere/comp/time_recorder.h"
 #include "knowhere/dataset.h"
 #include "knowhere/expected.h"
 #include "knowhere/log.h"
+#include "knowhere/search_params.h"
+#include "knowhere/utils.h"
 
 #ifdef NOT_COMPILE_FOR_SWIG
 #include "knowhere/prometheus_client.h"
@@ -25,6 +47,7 @@ namespace knowhere {
 inline Status
 LoadConfig(BaseConfig* cfg, const Json& json, knowhere::PARAM_TYPE param_type, const std::string& method,
            std::string* const msg = nullptr) {
+    KNOWHERE_PROFILE_ZONE("config.load");
     Json json_(json);
     auto res = Config::FormatAndCheck(*cfg, json_, msg);
     LOG_KNOWHERE_DEBUG_ << method << " config dump: " << json_.dump();
@@ -32,96 +55,1130 @@ LoadConfig(BaseConfig* cfg, const Json& json, knowhere::PARAM_TYPE param_type, c
     return Config::Load(*cfg, json_, param_type, msg);
 }
 
+// renews the data version of the index once the change of its data in the scope is done, see IndexNode::DataVersion
+struct ScopedDataChange {
+    IndexNode& node;
+
+    ~ScopedDataChange() {
+        node.RenewDataVersion();
+    }
+};
+
+// The rows the node reads of the dataset: the dataset itself if the node reads its type, otherwise its rows converted
+// to FLOAT32 into converted, which must outlive the use of them.
+inline const DataSet&
+NodeDataSet(const IndexNode& node, const DataSet& dataset, DataSetPtr& converted) {
+    auto type = dataset.GetDataType();
+    if (type == DataType::FLOAT32 || dataset.IsSparse() || dataset.GetTensor() == nullptr ||
+        node.SupportsDataType(type)) {
+        return dataset;
+    }
+    converted = ConvertToFloat(dataset);
+    return *converted;
+}
+
 template <typename T>
 inline Status
 Index<T>::Build(const DataSet& dataset, const Json& json) {
+    ScopedDataChange change{*this->node};
     auto cfg = this->node->CreateConfig();
     RETURN_IF_ERROR(LoadConfig(cfg.get(), json, knowhere::TRAIN, "Build"));
     RETURN_IF_ERROR(cfg->CheckAndAdjustForBuild());
 
+    DataSetPtr converted;
+    auto& rows = NodeDataSet(*this->node, dataset, converted);
+
 #ifdef NOT_COMPILE_FOR_SWIG
     knowhere_build_count.Increment();
+    TimeRecorder rc("Build");
+    auto status = this->node->Build(rows, *cfg);
+    GetOpLatencyHistogram(Type(), "build").Observe(rc.ElapseFromBegin("done") * 0.001);
+    return status;
+#else
+    return this->node->Build(rows, *cfg);
 #endif
-    return this->node->Build(dataset, *cfg);
 }
 
 template <typename T>
 inline Status
 Index<T>::Train(const DataSet& dataset, const Json& json) {
+    ScopedDataChange change{*this->node};
     auto cfg = this->node->CreateConfig();
     RETURN_IF_ERROR(LoadConfig(cfg.get(), json, knowhere::TRAIN, "Train"));
-    return this->node->Train(dataset, *cfg);
+
+    DataSetPtr converted;
+    auto& rows = NodeDataSet(*this->node, dataset, converted);
+
+#ifdef NOT_COMPILE_FOR_SWIG
+    TimeRecorder rc("Train");
+    auto status = this->node->Train(rows, *cfg);
+    GetOpLatencyHistogram(Type(), "train").Observe(rc.ElapseFromBegin("done") * 0.001);
+    return status;
+#else
+    return this->node->Train(rows, *cfg);
+#endif
 }
 
 template <typename T>
 inline Status
 Index<T>::Add(const DataSet& dataset, const Json& json) {
+    ScopedDataChange change{*this->node};
     auto cfg = this->node->CreateConfig();
     RETURN_IF_ERROR(LoadConfig(cfg.get(), json, knowhere::TRAIN, "Add"));
-    return this->node->Add(dataset, *cfg);
+
+    DataSetPtr converted;
+    auto& rows = NodeDataSet(*this->node, dataset, converted);
+
+#ifdef NOT_COMPILE_FOR_SWIG
+    TimeRecorder rc("Add");
+    auto status = this->node->Add(rows, *cfg);
+    GetOpLatencyHistogram(Type(), "add").Observe(rc.ElapseFromBegin("done") * 0.001);
+    return status;
+#else
+    return this->node->Add(rows, *cfg);
+#endif
 }
 
 template <typename T>
-inline expected<DataSetPtr>
-Index<T>::Search(const DataSet& dataset, const Json& json, const BitsetView& bitset) const {
+inline Status
+Index<T>::BuildChunked(const DataSetProducer& producer, const Json& json, const DataSet* train_dataset) {
+    ScopedDataChange change{*this->node};
     auto cfg = this->node->CreateConfig();
-    std::string msg;
-    const Status load_status = LoadConfig(cfg.get(), json, knowhere::SEARCH, "Search", &msg);
-    if (load_status != Status::success) {
-        return expected<DataSetPtr>::Err(load_status, msg);
+    RETURN_IF_ERROR(LoadConfig(cfg.get(), json, knowhere::TRAIN, "BuildChunked"));
+    RETURN_IF_ERROR(cfg->CheckAndAdjustForBuild());
+
+#ifdef NOT_COMPILE_FOR_SWIG
+    knowhere_build_count.Increment();
+    TimeRecorder rc("BuildChunked");
+#endif
+    // an exception of the producer fails the build rather than escape it
+    auto next = [&producer](Status& status) -> DataSetPtr {
+        try {
+            return producer();
+        } catch (std::exception& e) {
+            LOG_KNOWHERE_ERROR_ << "failed to produce the rows of a chunked build: " << e.what();
+            status = Status::invalid_args;
+            return nullptr;
+        }
+    };
+    auto produced = Status::success;
+    auto chunk = next(produced);
+    RETURN_IF_ERROR(produced);
+    if (chunk == nullptr && train_dataset == nullptr) {
+        LOG_KNOWHERE_ERROR_ << "no rows to build the index from";
+        return Status::empty_index;
     }
-    const Status search_status = cfg->CheckAndAdjustForSearch(&msg);
-    if (search_status != Status::success) {
-        return expected<DataSetPtr>::Err(search_status, msg);
+    DataSetPtr converted;
+    auto& train_rows = NodeDataSet(*this->node, train_dataset != nullptr ? *train_dataset : *chunk, converted);
+    RETURN_IF_ERROR(this->node->Train(train_rows, *cfg));
+    while (chunk != nullptr) {
+        auto loading = std::async(std::launch::async, next, std::ref(produced));
+        auto added = this->node->Add(NodeDataSet(*this->node, *chunk, converted), *cfg);
+        // the batch is released before the next one is taken, two at most are alive
+        chunk.reset();
+        converted.reset();
+        chunk = loading.get();
+        RETURN_IF_ERROR(added);
+        RETURN_IF_ERROR(produced);
     }
+#ifdef NOT_COMPILE_FOR_SWIG
+    GetOpLatencyHistogram(Type(), "build").Observe(rc.ElapseFromBegin("done") * 0.001);
+#endif
+    return Status::success;
+}
+
+inline Status
+LoadSearchConfig(BaseConfig* cfg, const Json& json, std::string* const msg) {
+    RETURN_IF_ERROR(LoadConfig(cfg, json, knowhere::SEARCH, "Search", msg));
+    return cfg->CheckAndAdjustForSearch(msg);
+}
+
+inline Status
+LoadRangeSearchConfig(BaseConfig* cfg, const Json& json, std::string* const msg) {
+    RETURN_IF_ERROR(LoadConfig(cfg, json, knowhere::RANGE_SEARCH, "RangeSearch", msg));
+    auto status = cfg->CheckAndAdjustForRangeSearch();
+    if (status != Status::success) {
+        *msg = "invalid params for range search";
+    }
+    return status;
+}
+
+// the token the search polls: the one of the caller, bounded by the search_timeout_ms of the config
+inline std::shared_ptr<CancellationToken>
+SearchCancellation(const BaseConfig& cfg, std::shared_ptr<CancellationToken> cancellation) {
+    auto timeout_ms = cfg.search_timeout_ms.value_or(0);
+    if (timeout_ms <= 0) {
+        return cancellation;
+    }
+    auto token = std::make_shared<CancellationToken>(std::move(cancellation));
+    token->SetDeadline(CancellationToken::Clock::now() +
+                       std::chrono::microseconds(static_cast<int64_t>(timeout_ms * 1000)));
+    return token;
+}
+
+inline Status
+LoadSearchConfig(BaseConfig* cfg, const Json& json, PARAM_TYPE param_type, std::string* const msg) {
+    return param_type == knowhere::RANGE_SEARCH ? LoadRangeSearchConfig(cfg, json, msg)
+                                                : LoadSearchConfig(cfg, json, msg);
+}
+
+// a config of the params: one they keep, else one parsed from their json
+inline Status
+LeaseSearchConfig(const IndexNode& node, const SearchParams& params, std::shared_ptr<BaseConfig>& cfg,
+                  std::string* const msg) {
+    cfg = params.Lease();
+    if (cfg != nullptr) {
+        return Status::success;
+    }
+    std::unique_ptr<BaseConfig> parsed = node.CreateConfig();
+    RETURN_IF_ERROR(LoadSearchConfig(parsed.get(), params.GetJson(), params.ParamType(), msg));
+    cfg = params.Lease(std::move(parsed));
+    return Status::success;
+}
+
+// the config of a search given params, which must be the ones of the index type and of the kind of the search
+inline Status
+LeaseSearchConfig(const IndexNode& node, const SearchParams& params, PARAM_TYPE param_type,
+                  std::shared_ptr<BaseConfig>& cfg, std::string* const msg) {
+    if (params.IndexType() != node.Type() || params.ParamType() != param_type) {
+        *msg = "search params prepared for another index type or kind of search: " + params.IndexType();
+        return Status::invalid_args;
+    }
+    return LeaseSearchConfig(node, params, cfg, msg);
+}
+
+constexpr const char* kTunedParamsBinary = "tuned_params";
+
+// The json of a search with the params of the tuned table of the node for its target_recall in place of it, see
+// Index::SetTunedParams: the ones of the lowest recall that reaches it, or of the highest recall, for the params the
+// json does not set itself. A target_recall out of range is left for the config to reject.
+inline Json
+WithTunedParams(const IndexNode& node, const Json& json) {
+    auto it = json.find(meta::TARGET_RECALL);
+    if (it == json.end() || !it->is_number() || it->get<float>() < 0 || it->get<float>() > 1) {
+        return json;
+    }
+    auto target = it->get<float>();
+    Json tuned(json);
+    tuned.erase(meta::TARGET_RECALL);
+    auto table = node.TunedParams();
+    if (target == 0) {
+        return tuned;
+    }
+    if (!table.is_array() || table.empty()) {
+        LOG_KNOWHERE_WARNING_ << "target_recall of a search of an index without tuned params";
+        return tuned;
+    }
+    const Json* entry = &table.back();
+    for (const auto& e : table) {
+        if (e["recall"].get<float>() >= target) {
+            entry = &e;
+            break;
+        }
+    }
+    for (const auto& [key, value] : (*entry)["params"].items()) {
+        if (!tuned.contains(key)) {
+            tuned[key] = value;
+        }
+    }
+    return tuned;
+}
+
+// the tuned table kept with the index, none when the binset has none
+inline Status
+ReadTunedParams(IndexNode& node, const BinarySet& binset) {
+    auto binary = binset.GetByName(kTunedParamsBinary);
+    if (binary == nullptr) {
+        node.SetTunedParams(Json());
+        return Status::success;
+    }
+    try {
+        auto data = reinterpret_cast<const char*>(binary->data.get());
+        node.SetTunedParams(Json::parse(data, data + binary->size));
+    } catch (const std::exception& e) {
+        LOG_KNOWHERE_ERROR_ << "invalid tuned params: " << e.what();
+        return Status::invalid_binary_set;
+    }
+    return Status::success;
+}
+
+// the config of a search given a json: leased from the params of the json in the search params cache when it is
+// enabled, else parsed from the json
+inline Status
+GetSearchConfig(const IndexNode& node, const Json& json, PARAM_TYPE param_type, std::shared_ptr<BaseConfig>& cfg,
+                std::string* const msg) {
+    if (json.contains(meta::TARGET_RECALL)) {
+        auto tuned = WithTunedParams(node, json);
+        if (!tuned.contains(meta::TARGET_RECALL)) {
+            return GetSearchConfig(node, tuned, param_type, cfg, msg);
+        }
+    }
+    auto params = SearchParams::Cached(node.Type(), param_type, json);
+    if (params != nullptr) {
+        return LeaseSearchConfig(node, *params, cfg, msg);
+    }
+    std::shared_ptr<BaseConfig> parsed = node.CreateConfig();
+    RETURN_IF_ERROR(LoadSearchConfig(parsed.get(), json, param_type, msg));
+    cfg = std::move(parsed);
+    return Status::success;
+}
+
+inline expected<DataSetPtr>
+SearchWithConfig(const IndexNode& node, const DataSet& dataset, BaseConfig& cfg, const BitsetView& bitset,
+                 std::shared_ptr<CancellationToken> cancellation) {
+    cfg.cancellation = SearchCancellation(cfg, std::move(cancellation));
+    ThreadPool::ScopedParallelism parallelism(cfg.max_threads.value());
+    DataSetPtr converted;
+    auto& queries = NodeDataSet(node, dataset, converted);
 
 #ifdef NOT_COMPILE_FOR_SWIG
     TimeRecorder rc("Search");
-    auto res = this->node->Search(dataset, *cfg, bitset);
+    auto res = node.Search(queries, cfg, bitset);
     auto span = rc.ElapseFromBegin("done");
     span *= 0.001;  // convert to ms
     knowhere_search_latency.Observe(span);
+    GetOpLatencyHistogram(node.Type(), "search").Observe(span);
     knowhere_search_count.Increment();
-    knowhere_search_topk.Observe(cfg->k.value());
+    knowhere_search_topk.Observe(cfg.k.value());
 #else
-    auto res = this->node->Search(dataset, *cfg, bitset);
+    auto res = node.Search(queries, cfg, bitset);
 #endif
+    if (res.has_value()) {
+        if (auto monitor = node.GetRecallMonitor()) {
+            monitor->Observe(queries, cfg.metric_type.value(), cfg.k.value(), bitset, *res.value());
+        }
+    }
     return res;
 }
 
-template <typename T>
+// the results of a knn search into the buffers of the caller
+inline Status
+CopyToBuffers(const expected<DataSetPtr>& res, int64_t* ids, float* dis) {
+    if (!res.has_value()) {
+        return res.error();
+    }
+    // the indexes that do not write into the buffers of the caller return arrays of their own
+    auto& result = res.value();
+    if (result->GetIds() != ids) {
+        auto len = result->GetRows() * result->GetDim();
+        std::copy_n(result->GetIds(), len, ids);
+        std::copy_n(result->GetDistance(), len, dis);
+    }
+    return Status::success;
+}
+
+inline Status
+SearchWithConfig(const IndexNode& node, const DataSet& dataset, BaseConfig& cfg, const BitsetView& bitset,
+                 int64_t* ids, float* dis, std::shared_ptr<CancellationToken> cancellation) {
+    cfg.result_ids = ids;
+    cfg.result_distances = dis;
+    return CopyToBuffers(SearchWithConfig(node, dataset, cfg, bitset, std::move(cancellation)), ids, dis);
+}
+
+// the metrics of the binary vectors, dim bits per row rather than dim floats
+inline bool
+IsBinaryMetric(const std::string& metric) {
+    return IsMetricType(metric, metric::HAMMING) || IsMetricType(metric, metric::JACCARD) ||
+           IsMetricType(metric, metric::SUBSTRUCTURE) || IsMetricType(metric, metric::SUPERSTRUCTURE);
+}
+
+// A knn search of the queries that miss the result cache only, the results of the others are copied from it; the
+// queries searched go into it then. The searches with a bitset are only cached under a filter version, and the ones
+// cut short, or tracing their visits, not at all, nor the sparse ones or the ones of queries other than FLOAT32.
 inline expected<DataSetPtr>
-Index<T>::RangeSearch(const DataSet& dataset, const Json& json, const BitsetView& bitset) const {
-    auto cfg = this->node->CreateConfig();
-    std::string msg;
-    auto status = LoadConfig(cfg.get(), json, knowhere::RANGE_SEARCH, "RangeSearch", &msg);
-    if (status != Status::success) {
-        return expected<DataSetPtr>::Err(status, std::move(msg));
+SearchWithResultCache(const IndexNode& node, const DataSet& dataset, BaseConfig& cfg, const BitsetView& bitset,
+                      uint64_t config_hash, std::shared_ptr<CancellationToken> cancellation) {
+    auto filter_version = cfg.filter_version.value();
+    if ((!bitset.empty() && filter_version < 0) || cfg.trace_visit.value() || dataset.IsSparse() ||
+        dataset.GetDataType() != DataType::FLOAT32) {
+        return SearchWithConfig(node, dataset, cfg, bitset, std::move(cancellation));
     }
-    status = cfg->CheckAndAdjustForRangeSearch();
-    if (status != Status::success) {
-        return expected<DataSetPtr>::Err(status, "invalid params for range search");
+    bool is_binary = IsBinaryMetric(cfg.metric_type.value());
+    auto nq = dataset.GetRows();
+    auto dim = dataset.GetDim();
+    auto k = cfg.k.value();
+    size_t row_size = is_binary ? dim / 8 : dim * sizeof(float);
+    auto xq = static_cast<const uint8_t*>(dataset.GetTensor());
+    auto row = [&](int64_t i) { return xq + i * row_size; };
+
+    ResultCache::Key key{node.DataVersion(), config_hash, filter_version, 0};
+    std::vector<uint64_t> hashes(nq);
+    auto ids = std::make_unique<int64_t[]>(nq * k);
+    auto dis = std::make_unique<float[]>(nq * k);
+    std::vector<int64_t> misses;
+    int64_t partial_queries = 0;
+    for (int64_t i = 0; i < nq; ++i) {
+        hashes[i] = is_binary ? hash_binary_vec(row(i), dim) : hash_vec(reinterpret_cast<const float*>(row(i)), dim);
+        key.query_hash = hashes[i];
+        if (!ResultCache::Get(key, row(i), row_size, k, ids.get() + i * k, dis.get() + i * k)) {
+            misses.push_back(i);
+        }
+    }
+
+    if (!misses.empty()) {
+        const DataSet* queries = &dataset;
+        DataSetPtr miss_ds;
+        std::unique_ptr<uint8_t[]> miss_rows;
+        if (static_cast<int64_t>(misses.size()) < nq) {
+            miss_rows = std::make_unique<uint8_t[]>(misses.size() * row_size);
+            for (size_t m = 0; m < misses.size(); ++m) {
+                std::copy_n(row(misses[m]), row_size, miss_rows.get() + m * row_size);
+            }
+            miss_ds = GenDataSet(misses.size(), dim, miss_rows.get());
+            queries = miss_ds.get();
+        }
+        // the results are merged into arrays of their own rather than into the buffers of the caller
+        auto result_ids = std::exchange(cfg.result_ids, nullptr);
+        auto result_distances = std::exchange(cfg.result_distances, nullptr);
+        auto res = SearchWithConfig(node, *queries, cfg, bitset, std::move(cancellation));
+        cfg.result_ids = result_ids;
+        cfg.result_distances = result_distances;
+        if (!res.has_value()) {
+            return res;
+        }
+        partial_queries = res.value()->GetPartialQueries();
+        auto res_ids = res.value()->GetIds();
+        auto res_dis = res.value()->GetDistance();
+        for (size_t m = 0; m < misses.size(); ++m) {
+            auto i = misses[m];
+            std::copy_n(res_ids + m * k, k, ids.get() + i * k);
+            std::copy_n(res_dis + m * k, k, dis.get() + i * k);
+            if (partial_queries == 0) {
+                key.query_hash = hashes[i];
+                ResultCache::Put(key, row(i), row_size, k, res_ids + m * k, res_dis + m * k);
+            }
+        }
     }
+    auto merged = GenResultDataSet(nq, k, ids.release(), dis.release());
+    merged->SetPartialQueries(partial_queries);
+    return merged;
+}
+
+inline expected<DataSetPtr>
+RangeSearchWithConfig(const IndexNode& node, const DataSet& dataset, BaseConfig& cfg, const BitsetView& bitset,
+                      std::shared_ptr<CancellationToken> cancellation) {
+    cfg.cancellation = SearchCancellation(cfg, std::move(cancellation));
+    ThreadPool::ScopedParallelism parallelism(cfg.max_threads.value());
+    DataSetPtr converted;
+    auto& queries = NodeDataSet(node, dataset, converted);
 
 #ifdef NOT_COMPILE_FOR_SWIG
     TimeRecorder rc("Range Search");
-    auto res = this->node->RangeSearch(dataset, *cfg, bitset);
+    auto res = node.RangeSearch(queries, cfg, bitset);
     auto span = rc.ElapseFromBegin("done");
     span *= 0.001;  // convert to ms
     knowhere_range_search_latency.Observe(span);
+    GetOpLatencyHistogram(node.Type(), "range_search").Observe(span);
     knowhere_range_search_count.Increment();
 #else
-    auto res = this->node->RangeSearch(dataset, *cfg, bitset);
+    auto res = node.RangeSearch(queries, cfg, bitset);
 #endif
     return res;
 }
 
+inline expected<DataSetPtr>
+RangeSearchWithConfig(const IndexNode& node, const DataSet& dataset, BaseConfig& cfg, const BitsetView& bitset,
+                      int64_t* ids, float* dis, size_t capacity, size_t* lims,
+                      std::shared_ptr<CancellationToken> cancellation) {
+    cfg.result_ids = ids;
+    cfg.result_distances = dis;
+    cfg.result_lims = lims;
+    cfg.result_capacity = capacity;
+    return RangeSearchWithConfig(node, dataset, cfg, bitset, std::move(cancellation));
+}
+
+template <typename T>
+inline expected<SearchParamsPtr>
+Index<T>::PrepareSearch(const Json& json, bool range_search) const {
+    auto param_type = range_search ? knowhere::RANGE_SEARCH : knowhere::SEARCH;
+    auto params = std::make_shared<SearchParams>(Type(), param_type, WithTunedParams(*this->node, json));
+    // parsed and checked now so that a bad json fails here rather than in the searches, the config is kept for them
+    std::shared_ptr<BaseConfig> cfg;
+    std::string msg;
+    const Status status = LeaseSearchConfig(*this->node, *params, cfg, &msg);
+    if (status != Status::success) {
+        return expected<SearchParamsPtr>::Err(status, std::move(msg));
+    }
+    return params;
+}
+
+template <typename T>
+inline expected<DataSetPtr>
+Index<T>::Search(const DataSet& dataset, const Json& json, const BitsetView& bitset,
+                 std::shared_ptr<CancellationToken> cancellation) const {
+    std::shared_ptr<BaseConfig> cfg;
+    std::string msg;
+    const Status status = GetSearchConfig(*this->node, json, knowhere::SEARCH, cfg, &msg);
+    if (status != Status::success) {
+        return expected<DataSetPtr>::Err(status, msg);
+    }
+    if (ResultCache::Enabled()) {
+        return SearchWithResultCache(*this->node, dataset, *cfg, bitset, ResultCache::HashConfig(json),
+                                     std::move(cancellation));
+    }
+    return SearchWithConfig(*this->node, dataset, *cfg, bitset, std::move(cancellation));
+}
+
+template <typename T>
+inline expected<DataSetPtr>
+Index<T>::Search(const DataSet& dataset, const SearchParams& params, const BitsetView& bitset,
+                 std::shared_ptr<CancellationToken> cancellation) const {
+    std::shared_ptr<BaseConfig> cfg;
+    std::string msg;
+    const Status status = LeaseSearchConfig(*this->node, params, knowhere::SEARCH, cfg, &msg);
+    if (status != Status::success) {
+        return expected<DataSetPtr>::Err(status, msg);
+    }
+    if (ResultCache::Enabled()) {
+        return SearchWithResultCache(*this->node, dataset, *cfg, bitset, params.ConfigHash(), std::move(cancellation));
+    }
+    return SearchWithConfig(*this->node, dataset, *cfg, bitset, std::move(cancellation));
+}
+
+template <typename T>
+inline Status
+Index<T>::SearchWithBuf(const DataSet& dataset, const Json& json, const BitsetView& bitset, int64_t* ids, float* dis,
+                        std::shared_ptr<CancellationToken> cancellation) const {
+    std::shared_ptr<BaseConfig> cfg;
+    std::string msg;
+    RETURN_IF_ERROR(GetSearchConfig(*this->node, json, knowhere::SEARCH, cfg, &msg));
+    if (ResultCache::Enabled()) {
+        return CopyToBuffers(SearchWithResultCache(*this->node, dataset, *cfg, bitset, ResultCache::HashConfig(json),
+                                                   std::move(cancellation)),
+                             ids, dis);
+    }
+    return SearchWithConfig(*this->node, dataset, *cfg, bitset, ids, dis, std::move(cancellation));
+}
+
+template <typename T>
+inline Status
+Index<T>::SearchWithBuf(const DataSet& dataset, const SearchParams& params, const BitsetView& bitset, int64_t* ids,
+                        float* dis, std::shared_ptr<CancellationToken> cancellation) const {
+    std::shared_ptr<BaseConfig> cfg;
+    std::string msg;
+    RETURN_IF_ERROR(LeaseSearchConfig(*this->node, params, knowhere::SEARCH, cfg, &msg));
+    if (ResultCache::Enabled()) {
+        return CopyToBuffers(
+            SearchWithResultCache(*this->node, dataset, *cfg, bitset, params.ConfigHash(), std::move(cancellation)),
+            ids, dis);
+    }
+    return SearchWithConfig(*this->node, dataset, *cfg, bitset, ids, dis, std::move(cancellation));
+}
+
+template <typename T>
+inline expected<DataSetPtr>
+Index<T>::RangeSearch(const DataSet& dataset, const Json& json, const BitsetView& bitset,
+                      std::shared_ptr<CancellationToken> cancellation) const {
+    std::shared_ptr<BaseConfig> cfg;
+    std::string msg;
+    const Status status = GetSearchConfig(*this->node, json, knowhere::RANGE_SEARCH, cfg, &msg);
+    if (status != Status::success) {
+        return expected<DataSetPtr>::Err(status, std::move(msg));
+    }
+    return RangeSearchWithConfig(*this->node, dataset, *cfg, bitset, std::move(cancellation));
+}
+
+template <typename T>
+inline expected<DataSetPtr>
+Index<T>::RangeSearch(const DataSet& dataset, const SearchParams& params, const BitsetView& bitset,
+                      std::shared_ptr<CancellationToken> cancellation) const {
+    std::shared_ptr<BaseConfig> cfg;
+    std::string msg;
+    const Status status = LeaseSearchConfig(*this->node, params, knowhere::RANGE_SEARCH, cfg, &msg);
+    if (status != Status::success) {
+        return expected<DataSetPtr>::Err(status, std::move(msg));
+    }
+    return RangeSearchWithConfig(*this->node, dataset, *cfg, bitset, std::move(cancellation));
+}
+
+template <typename T>
+inline expected<DataSetPtr>
+Index<T>::RangeSearchWithBuf(const DataSet& dataset, const Json& json, const BitsetView& bitset, int64_t* ids,
+                             float* dis, size_t capacity, size_t* lims,
+                             std::shared_ptr<CancellationToken> cancellation) const {
+    std::shared_ptr<BaseConfig> cfg;
+    std::string msg;
+    const Status status = GetSearchConfig(*this->node, json, knowhere::RANGE_SEARCH, cfg, &msg);
+    if (status != Status::success) {
+        return expected<DataSetPtr>::Err(status, std::move(msg));
+    }
+    return RangeSearchWithConfig(*this->node, dataset, *cfg, bitset, ids, dis, capacity, lims,
+                                 std::move(cancellation));
+}
+
+template <typename T>
+inline expected<DataSetPtr>
+Index<T>::RangeSearchWithBuf(const DataSet& dataset, const SearchParams& params, const BitsetView& bitset,
+                             int64_t* ids, float* dis, size_t capacity, size_t* lims,
+                             std::shared_ptr<CancellationToken> cancellation) const {
+    std::shared_ptr<BaseConfig> cfg;
+    std::string msg;
+    const Status status = LeaseSearchConfig(*this->node, params, knowhere::RANGE_SEARCH, cfg, &msg);
+    if (status != Status::success) {
+        return expected<DataSetPtr>::Err(status, std::move(msg));
+    }
+    return RangeSearchWithConfig(*this->node, dataset, *cfg, bitset, ids, dis, capacity, lims,
+                                 std::move(cancellation));
+}
+
+// The k documents of the highest scores of every query from the hits of its vectors, see Index::MultiVectorSearch:
+// the hits of a query vector are sorted by document, so that a pass over them gives the best or the sum of the hits of
+// every document, which goes into the scores of the query.
+inline DataSetPtr
+AggregateDocuments(const DataSet& hits, const size_t* lims, int64_t nq, const int64_t* doc_ids, int64_t rows, int64_t k,
+                   bool max_sim) {
+    auto hit_k = hits.GetDim();
+    auto hit_ids = hits.GetIds();
+    auto hit_scores = hits.GetDistance();
+    auto ids = std::make_unique<int64_t[]>(nq * k);
+    auto scores = std::make_unique<float[]>(nq * k);
+    ThreadPool::GetGlobalSearchThreadPool()->parallel_for(0, nq, 1, [&](int64_t q) {
+        std::unordered_map<int64_t, float> doc_scores;
+        std::vector<std::pair<int64_t, float>> vector_hits;
+        for (auto v = lims[q]; v < lims[q + 1]; ++v) {
+            vector_hits.clear();
+            for (int64_t j = 0; j < hit_k; ++j) {
+                auto id = hit_ids[v * hit_k + j];
+                if (id >= 0 && id < rows) {
+                    vector_hits.emplace_back(doc_ids[id], hit_scores[v * hit_k + j]);
+                }
+            }
+            std::sort(vector_hits.begin(), vector_hits.end(), [](const auto& a, const auto& b) {
+                return a.first < b.first || (a.first == b.first && a.second > b.second);
+            });
+            for (size_t j = 0; j < vector_hits.size(); ++j) {
+                if (!max_sim || j == 0 || vector_hits[j].first != vector_hits[j - 1].first) {
+                    doc_scores[vector_hits[j].first] += vector_hits[j].second;
+                }
+            }
+        }
+        std::vector<std::pair<int64_t, float>> docs(doc_scores.begin(), doc_scores.end());
+        auto top = std::min<size_t>(k, docs.size());
+        std::partial_sort(docs.begin(), docs.begin() + top, docs.end(),
+                          [](const auto& a, const auto& b) { return a.second > b.second; });
+        for (size_t j = 0; j < static_cast<size_t>(k); ++j) {
+            ids[q * k + j] = j < top ? docs[j].first : -1;
+            scores[q * k + j] = j < top ? docs[j].second : -std::numeric_limits<float>::infinity();
+        }
+    });
+    return GenResultDataSet(nq, k, ids.release(), scores.release());
+}
+
+template <typename T>
+inline expected<DataSetPtr>
+Index<T>::MultiVectorSearch(const DataSet& dataset, const Json& json, const BitsetView& bitset, const int64_t* doc_ids,
+                            std::shared_ptr<CancellationToken> cancellation) const {
+    std::shared_ptr<BaseConfig> cfg;
+    std::string msg;
+    Status status = GetSearchConfig(*this->node, json, knowhere::SEARCH, cfg, &msg);
+    if (status != Status::success) {
+        return expected<DataSetPtr>::Err(status, std::move(msg));
+    }
+    auto metric = cfg->metric_type.value();
+    if (!IsMetricType(metric, metric::IP) && !IsMetricType(metric, metric::COSINE)) {
+        return expected<DataSetPtr>::Err(Status::invalid_metric_type,
+                                         "multi-vector search adds up similarities, not the distances of " + metric);
+    }
+    auto& agg = cfg->multi_vector_agg.value();
+    bool max_sim = !strcasecmp(agg.c_str(), "MAXSIM");
+    if (!max_sim && strcasecmp(agg.c_str(), "SUM")) {
+        return expected<DataSetPtr>::Err(Status::invalid_args, "invalid multi_vector_agg " + agg);
+    }
+    if (doc_ids == nullptr) {
+        return expected<DataSetPtr>::Err(Status::invalid_args, "multi-vector search without doc ids");
+    }
+    int64_t k = cfg->k.value();
+    int64_t hit_k = cfg->multi_vector_k.value() > 0 ? cfg->multi_vector_k.value() : k;
+
+    // the queries end where the lims reach the rows
+    auto rows = dataset.GetRows();
+    auto lims = dataset.GetLims();
+    std::vector<size_t> row_lims;
+    if (lims == nullptr) {
+        row_lims.resize(rows + 1);
+        std::iota(row_lims.begin(), row_lims.end(), 0);
+        lims = row_lims.data();
+    }
+    int64_t nq = 0;
+    for (; lims[nq] < static_cast<size_t>(rows); ++nq) {
+        if (lims[nq + 1] < lims[nq]) {
+            return expected<DataSetPtr>::Err(Status::invalid_args, "lims of the queries not ascending");
+        }
+    }
+    if (lims[0] != 0 || lims[nq] != static_cast<size_t>(rows)) {
+        return expected<DataSetPtr>::Err(Status::invalid_args, "lims of the queries do not span the rows");
+    }
+
+    // the config of the search of the query vectors, of their k rather than the k of documents
+    std::shared_ptr<BaseConfig> hit_cfg = cfg;
+    if (hit_k != k) {
+        Json hit_json(json);
+        hit_json[meta::TOPK] = hit_k;
+        status = GetSearchConfig(*this->node, hit_json, knowhere::SEARCH, hit_cfg, &msg);
+        if (status != Status::success) {
+            return expected<DataSetPtr>::Err(status, std::move(msg));
+        }
+    }
+    auto hits = SearchWithConfig(*this->node, dataset, *hit_cfg, bitset, std::move(cancellation));
+    if (!hits.has_value()) {
+        return hits;
+    }
+    auto res = AggregateDocuments(*hits.value(), lims, nq, doc_ids, this->node->Count(), k, max_sim);
+    res->SetPartialQueries(hits.value()->GetPartialQueries() > 0 ? nq : 0);
+    return res;
+}
+
+// Once the k groups of a grouped search are found, the results it goes through to fill them are bounded to this many
+// times the results it returns.
+constexpr int64_t kGroupedSearchFillFactor = 16;
+
+template <typename T>
+inline expected<DataSetPtr>
+Index<T>::GroupedSearch(const DataSet& dataset, const Json& json, const BitsetView& bitset, const int64_t* group_ids,
+                        std::shared_ptr<CancellationToken> cancellation) const {
+    std::shared_ptr<BaseConfig> cfg;
+    std::string msg;
+    const Status status = GetSearchConfig(*this->node, json, knowhere::SEARCH, cfg, &msg);
+    if (status != Status::success) {
+        return expected<DataSetPtr>::Err(status, std::move(msg));
+    }
+    if (group_ids == nullptr) {
+        return expected<DataSetPtr>::Err(Status::invalid_args, "grouped search without group ids");
+    }
+    auto iterators = AnnIterator(dataset, json, bitset);
+    if (!iterators.has_value()) {
+        return expected<DataSetPtr>::Err(iterators.error(), iterators.what());
+    }
+    auto token = SearchCancellation(*cfg, std::move(cancellation));
+    auto metric = cfg->metric_type.value();
+    bool is_ip = IsMetricType(metric, metric::IP) || IsMetricType(metric, metric::COSINE);
+    auto nq = dataset.GetRows();
+    auto rows = this->node->Count();
+    size_t k = cfg->k.value();
+    size_t group_size = cfg->group_size.value();
+    int64_t len = k * group_size;
+    int64_t batch = std::max<int64_t>(len, 64);
+
+    auto ids = std::make_unique<int64_t[]>(nq * len);
+    auto distances = std::make_unique<float[]>(nq * len);
+    // the first query to fail fails the search
+    std::mutex error_mtx;
+    Status error = Status::success;
+    std::string error_msg;
+    ThreadPool::GetGlobalSearchThreadPool()->parallel_for(0, nq, 1, [&](int64_t q) {
+        auto& iterator = iterators.value()[q];
+        std::unordered_map<int64_t, size_t> group_index;
+        std::vector<std::vector<std::pair<int64_t, float>>> groups;
+        size_t full = 0;
+        int64_t seen = 0;
+        while (full < k && (groups.size() < k || seen < kGroupedSearchFillFactor * len)) {
+            if (token != nullptr && token->IsCancelled()) {
+                std::lock_guard<std::mutex> lock(error_mtx);
+                error = Status::search_cancelled;
+                error_msg = "grouped search cancelled";
+                return;
+            }
+            auto next = iterator->Next(batch);
+            if (!next.has_value()) {
+                std::lock_guard<std::mutex> lock(error_mtx);
+                error = next.error();
+                error_msg = next.what();
+                return;
+            }
+            auto count = next.value()->GetDim();
+            auto next_ids = next.value()->GetIds();
+            auto next_distances = next.value()->GetDistance();
+            for (int64_t i = 0; i < count && full < k; ++i) {
+                if (next_ids[i] < 0 || next_ids[i] >= rows) {
+                    continue;
+                }
+                auto [it, inserted] = group_index.try_emplace(group_ids[next_ids[i]], groups.size());
+                if (inserted) {
+                    if (groups.size() == k) {
+                        group_index.erase(it);
+                        continue;
+                    }
+                    groups.emplace_back();
+                }
+                auto& group = groups[it->second];
+                if (group.size() < group_size) {
+                    group.emplace_back(next_ids[i], next_distances[i]);
+                    full += group.size() == group_size;
+                }
+            }
+            seen += count;
+            if (count < batch) {
+                break;
+            }
+        }
+        auto worst = is_ip ? -std::numeric_limits<float>::infinity() : std::numeric_limits<float>::infinity();
+        for (size_t g = 0; g < k; ++g) {
+            for (size_t j = 0; j < group_size; ++j) {
+                auto pos = q * len + g * group_size + j;
+                bool found = g < groups.size() && j < groups[g].size();
+                ids[pos] = found ? groups[g][j].first : -1;
+                distances[pos] = found ? groups[g][j].second : worst;
+            }
+        }
+    });
+    if (error != Status::success) {
+        return expected<DataSetPtr>::Err(error, std::move(error_msg));
+    }
+    return GenResultDataSet(nq, len, ids.release(), distances.release());
+}
+
+template <typename T>
+inline expected<DataSetPtr>
+Index<T>::MixedSearch(const DataSet& dataset, const Json& json, const std::vector<MixedQuery>& queries,
+                      const std::vector<BitsetView>& filters, const std::vector<Json>& params,
+                      std::shared_ptr<CancellationToken> cancellation) const {
+    auto nq = dataset.GetRows();
+    if (dataset.IsSparse()) {
+        return expected<DataSetPtr>::Err(Status::not_implemented, "mixed search of sparse queries");
+    }
+    if (static_cast<int64_t>(queries.size()) != nq) {
+        return expected<DataSetPtr>::Err(Status::invalid_args, "mixed search with a query per row expected");
+    }
+    // the queries of a group share their k, filter and params, a group goes through its queries in order
+    std::map<std::tuple<int64_t, int32_t, int32_t>, size_t> group_of;
+    std::vector<std::vector<int64_t>> groups;
+    auto lims = std::make_unique<size_t[]>(nq + 1);
+    lims[0] = 0;
+    for (int64_t i = 0; i < nq; ++i) {
+        auto& q = queries[i];
+        if (q.k <= 0 || q.filter < -1 || q.filter >= static_cast<int64_t>(filters.size()) || q.params < -1 ||
+            q.params >= static_cast<int64_t>(params.size())) {
+            return expected<DataSetPtr>::Err(Status::invalid_args,
+                                             "invalid k, filter or params of mixed query " + std::to_string(i));
+        }
+        lims[i + 1] = lims[i] + q.k;
+        auto [it, inserted] = group_of.try_emplace(std::make_tuple(q.k, q.filter, q.params), groups.size());
+        if (inserted) {
+            groups.emplace_back();
+        }
+        groups[it->second].push_back(i);
+    }
+    if (nq == 0) {
+        return GenResultDataSet(0, new int64_t[0], new float[0], lims.release());
+    }
+
+    // the configs of the groups, checked before any of them searches
+    std::vector<std::shared_ptr<BaseConfig>> cfgs(groups.size());
+    for (const auto& [key, g] : group_of) {
+        Json group_json(json);
+        if (std::get<2>(key) >= 0) {
+            group_json.update(params[std::get<2>(key)]);
+        }
+        group_json[meta::TOPK] = std::get<0>(key);
+        std::string msg;
+        const Status status = GetSearchConfig(*this->node, group_json, knowhere::SEARCH, cfgs[g], &msg);
+        if (status != Status::success) {
+            return expected<DataSetPtr>::Err(status, std::move(msg));
+        }
+    }
+
+    auto dim = dataset.GetDim();
+    auto type = dataset.GetDataType();
+    size_t row_size = IsBinaryMetric(cfgs[0]->metric_type.value()) ? dim / 8 : dim * DataTypeSize(type);
+    auto xq = static_cast<const uint8_t*>(dataset.GetTensor());
+    auto ids = std::make_unique<int64_t[]>(lims[nq]);
+    auto distances = std::make_unique<float[]>(lims[nq]);
+
+    std::mutex error_mtx;
+    expected<DataSetPtr> error = expected<DataSetPtr>::OK();
+    std::atomic<bool> failed = false;
+    std::atomic<int64_t> partial_queries = 0;
+    auto search_group = [&](size_t g) {
+        if (failed.load(std::memory_order_relaxed)) {
+            return;
+        }
+        auto& members = groups[g];
+        auto& cfg = *cfgs[g];
+        int64_t n = members.size();
+        int64_t k = cfg.k.value();
+        auto& q = queries[members[0]];
+        BitsetView bitset = q.filter >= 0 ? filters[q.filter] : BitsetView();
+        // the queries of a run of the batch are searched in place and write straight into their results, the others
+        // are gathered and their results scattered
+        const uint8_t* rows = xq + members[0] * row_size;
+        std::unique_ptr<uint8_t[]> gathered;
+        if (members.back() - members.front() + 1 == n) {
+            cfg.result_ids = ids.get() + lims[members[0]];
+            cfg.result_distances = distances.get() + lims[members[0]];
+        } else {
+            gathered = std::make_unique<uint8_t[]>(n * row_size);
+            for (int64_t j = 0; j < n; ++j) {
+                std::copy_n(xq + members[j] * row_size, row_size, gathered.get() + j * row_size);
+            }
+            rows = gathered.get();
+        }
+        auto group_ds = GenDataSet(n, dim, rows, type);
+        auto res = SearchWithConfig(*this->node, *group_ds, cfg, bitset, cancellation);
+        if (!res.has_value()) {
+            std::lock_guard<std::mutex> lock(error_mtx);
+            if (!failed.exchange(true)) {
+                error = res;
+            }
+            return;
+        }
+        partial_queries += res.value()->GetPartialQueries();
+        auto res_ids = res.value()->GetIds();
+        auto res_dis = res.value()->GetDistance();
+        for (int64_t j = 0; j < n; ++j) {
+            auto i = members[j];
+            // the indexes that do not write into the buffers given return arrays of their own
+            if (res_ids + j * k != ids.get() + lims[i]) {
+                std::copy_n(res_ids + j * k, k, ids.get() + lims[i]);
+                std::copy_n(res_dis + j * k, k, distances.get() + lims[i]);
+            }
+        }
+    };
+    auto pool = ThreadPool::GetGlobalSearchThreadPool();
+    int64_t width = std::min<int64_t>(groups.size(), pool->size() / 2);
+    if (width <= 1) {
+        for (size_t g = 0; g < groups.size(); ++g) {
+            search_group(g);
+        }
+    } else {
+        std::atomic<size_t> next = 0;
+        pool->parallel_for(0, width, 1, [&](int64_t) {
+            for (size_t g = next.fetch_add(1); g < groups.size(); g = next.fetch_add(1)) {
+                search_group(g);
+            }
+        });
+    }
+    if (failed.load()) {
+        return error;
+    }
+    auto res = GenResultDataSet(nq, ids.release(), distances.release(), lims.release());
+    res->SetPartialQueries(partial_queries.load());
+    return res;
+}
+
+// The iterator of an index without one of its own: every Refill searches for twice the results of the one before and
+// keeps those not returned yet, so the searches are a few for any number of pages rather than one per page.
+template <typename T>
+class SearchPagingIterator : public IndexIterator {
+ public:
+    SearchPagingIterator(const Index<T>& index, DataSetPtr query, const Json& json, const BitsetView& bitset,
+                         bool is_ip)
+        : IndexIterator(is_ip), index_(index), query_(std::move(query)), json_(json), bitset_(bitset) {
+    }
+
+ protected:
+    Status
+    Refill(int64_t wanted, bool& exhausted) override {
+        int64_t k = std::max<int64_t>(2 * k_, static_cast<int64_t>(seen_.size()) + wanted);
+        json_[meta::TOPK] = k;
+        auto res = index_.Search(*query_, json_, bitset_);
+        if (!res.has_value()) {
+            LOG_KNOWHERE_WARNING_ << "iterator search failed: " << res.what();
+            return res.error();
+        }
+        auto ids = res.value()->GetIds();
+        auto distances = res.value()->GetDistance();
+        int64_t found = 0;
+        for (int64_t i = 0; i < k; ++i) {
+            if (ids[i] < 0) {
+                continue;
+            }
+            ++found;
+            if (seen_.insert(ids[i]).second) {
+                Push(distances[i], ids[i]);
+            }
+        }
+        k_ = k;
+        exhausted = found < k || k >= index_.Count();
+        return Status::success;
+    }
+
+ private:
+    Index<T> index_;
+    DataSetPtr query_;
+    Json json_;
+    BitsetView bitset_;
+    int64_t k_ = 0;
+    std::unordered_set<int64_t> seen_;
+};
+
+// The iterator of a node over queries converted to FLOAT32 for it, which it keeps alive as long as the iterator is.
+class ConvertedQueryIterator : public IndexIterator {
+ public:
+    ConvertedQueryIterator(IndexIteratorPtr iterator, DataSetPtr queries, bool is_ip)
+        : IndexIterator(is_ip), iterator_(std::move(iterator)), queries_(std::move(queries)) {
+    }
+
+ protected:
+    Status
+    Refill(int64_t wanted, bool& exhausted) override {
+        auto res = iterator_->Next(wanted);
+        if (!res.has_value()) {
+            return res.error();
+        }
+        auto count = res.value()->GetDim();
+        auto ids = res.value()->GetIds();
+        auto distances = res.value()->GetDistance();
+        for (int64_t i = 0; i < count; ++i) {
+            Push(distances[i], ids[i]);
+        }
+        exhausted = count < wanted;
+        return Status::success;
+    }
+
+ private:
+    IndexIteratorPtr iterator_;
+    DataSetPtr queries_;
+};
+
+template <typename T>
+inline expected<std::vector<IndexIteratorPtr>>
+Index<T>::AnnIterator(const DataSet& dataset, const Json& json_in, const BitsetView& bitset) const {
+    auto json = WithTunedParams(*this->node, json_in);
+    auto cfg = this->node->CreateConfig();
+    std::string msg;
+    const Status status = LoadSearchConfig(cfg.get(), json, &msg);
+    if (status != Status::success) {
+        return expected<std::vector<IndexIteratorPtr>>::Err(status, msg);
+    }
+    auto metric = cfg->metric_type.value();
+    bool is_ip = IsMetricType(metric, metric::IP) || IsMetricType(metric, metric::COSINE);
+    DataSetPtr converted;
+    auto res = this->node->AnnIterator(NodeDataSet(*this->node, dataset, converted), *cfg, bitset);
+    if (res.has_value() && converted != nullptr) {
+        std::vector<IndexIteratorPtr> iterators;
+        iterators.reserve(res.value().size());
+        for (auto& iterator : res.value()) {
+            iterators.push_back(std::make_shared<ConvertedQueryIterator>(iterator, converted, is_ip));
+        }
+        return iterators;
+    }
+    if (res.has_value() || res.error() != Status::not_implemented) {
+        return res;
+    }
+
+    bool is_binary = IsBinaryMetric(metric);
+    auto dim = dataset.GetDim();
+    auto type = dataset.GetDataType();
+    size_t row_size = is_binary ? dim / 8 : dim * DataTypeSize(type);
+    std::vector<IndexIteratorPtr> iterators(dataset.GetRows());
+    for (size_t i = 0; i < iterators.size(); ++i) {
+        auto query = GenDataSet(1, dim, static_cast<const uint8_t*>(dataset.GetTensor()) + i * row_size, type);
+        iterators[i] = std::make_shared<SearchPagingIterator<T>>(*this, query, json, bitset, is_ip);
+    }
+    return iterators;
+}
+
+template <typename T>
+inline folly::Future<expected<DataSetPtr>>
+Index<T>::SearchAsync(const DataSet& dataset, const Json& json, const BitsetView& bitset,
+                      std::shared_ptr<CancellationToken> cancellation) const {
+    std::shared_ptr<BaseConfig> cfg;
+    std::string msg;
+    const Status status = GetSearchConfig(*this->node, json, knowhere::SEARCH, cfg, &msg);
+    if (status != Status::success) {
+        return folly::makeFuture(expected<DataSetPtr>::Err(status, msg));
+    }
+    cfg->cancellation = SearchCancellation(*cfg, std::move(cancellation));
+    DataSetPtr converted;
+    auto& queries = NodeDataSet(*this->node, dataset, converted);
+
+    // the continuation holds the config and the converted queries until the search is done with them
+#ifdef NOT_COMPILE_FOR_SWIG
+    auto rc = std::make_shared<TimeRecorder>("Search Async");
+    auto latency = &GetOpLatencyHistogram(Type(), "search");
+    return this->node->SearchAsync(queries, *cfg, bitset)
+        .thenValue([cfg, converted, rc, latency](expected<DataSetPtr>&& res) {
+            auto span = rc->ElapseFromBegin("done");
+            span *= 0.001;  // convert to ms
+            knowhere_search_latency.Observe(span);
+            latency->Observe(span);
+            knowhere_search_count.Increment();
+            knowhere_search_topk.Observe(cfg->k.value());
+            return std::move(res);
+        });
+#else
+    return this->node->SearchAsync(queries, *cfg, bitset).thenValue([cfg, converted](expected<DataSetPtr>&& res) {
+        return std::move(res);
+    });
+#endif
+}
+
+template <typename T>
+inline folly::Future<expected<DataSetPtr>>
+Index<T>::RangeSearchAsync(const DataSet& dataset, const Json& json, const BitsetView& bitset,
+                           std::shared_ptr<CancellationToken> cancellation) const {
+    std::shared_ptr<BaseConfig> cfg;
+    std::string msg;
+    const Status status = GetSearchConfig(*this->node, json, knowhere::RANGE_SEARCH, cfg, &msg);
+    if (status != Status::success) {
+        return folly::makeFuture(expected<DataSetPtr>::Err(status, std::move(msg)));
+    }
+    cfg->cancellation = SearchCancellation(*cfg, std::move(cancellation));
+    DataSetPtr converted;
+    auto& queries = NodeDataSet(*this->node, dataset, converted);
+
+#ifdef NOT_COMPILE_FOR_SWIG
+    auto rc = std::make_shared<TimeRecorder>("Range Search Async");
+    auto latency = &GetOpLatencyHistogram(Type(), "range_search");
+    return this->node->RangeSearchAsync(queries, *cfg, bitset)
+        .thenValue([cfg, converted, rc, latency](expected<DataSetPtr>&& res) {
+            auto span = rc->ElapseFromBegin("done");
+            span *= 0.001;  // convert to ms
+            knowhere_range_search_latency.Observe(span);
+            latency->Observe(span);
+            knowhere_range_search_count.Increment();
+            return std::move(res);
+        });
+#else
+    return this->node->RangeSearchAsync(queries, *cfg, bitset).thenValue([cfg, converted](expected<DataSetPtr>&& res) {
+        return std::move(res);
+    });
+#endif
+}
+
+template <typename T>
+inline Status
+Index<T>::DeleteByIds(const DataSet& dataset) {
+    ScopedDataChange change{*this->node};
+    return this->node->DeleteByIds(dataset);
+}
+
+template <typename T>
+inline Status
+Index<T>::Merge(const std::vector<Index<T>>& others, const Json& json) {
+    std::vector<const IndexNode*> nodes;
+    for (auto& other : others) {
+        if (other.node == nullptr || other.node == this->node || other.Type() != Type()) {
+            LOG_KNOWHERE_ERROR_ << "can only merge other indexes of type " << Type();
+            return Status::invalid_args;
+        }
+        nodes.push_back(other.node);
+    }
+    ScopedDataChange change{*this->node};
+    auto cfg = this->node->CreateConfig();
+    RETURN_IF_ERROR(LoadConfig(cfg.get(), json, knowhere::TRAIN, "Merge"));
+#ifdef NOT_COMPILE_FOR_SWIG
+    TimeRecorder rc("Merge");
+    auto status = this->node->Merge(nodes, *cfg);
+    GetOpLatencyHistogram(Type(), "merge").Observe(rc.ElapseFromBegin("done") * 0.001);
+    return status;
+#else
+    return this->node->Merge(nodes, *cfg);
+#endif
+}
+
 template <typename T>
 inline expected<DataSetPtr>
 Index<T>::GetVectorByIds(const DataSet& dataset) const {
     return this->node->GetVectorByIds(dataset);
 }
 
+template <typename T>
+inline folly::Future<expected<DataSetPtr>>
+Index<T>::GetVectorByIdsAsync(const DataSet& dataset) const {
+    return this->node->GetVectorByIdsAsync(dataset);
+}
+
 template <typename T>
 inline bool
 Index<T>::HasRawData(const std::string& metric_type) const {
@@ -140,15 +1197,123 @@ Index<T>::GetIndexMeta(const Json& json) const {
     return this->node->GetIndexMeta(*cfg);
 }
 
+template <typename T>
+inline Status
+Index<T>::SetTunedParams(const Json& table) {
+    if (!table.is_array()) {
+        LOG_KNOWHERE_ERROR_ << "tuned params not an array";
+        return Status::invalid_args;
+    }
+    for (const auto& entry : table) {
+        if (!entry.is_object() || !entry.contains("recall") || !entry["recall"].is_number() ||
+            !entry.contains("params") || !entry["params"].is_object()) {
+            LOG_KNOWHERE_ERROR_ << "invalid tuned params entry " << entry.dump();
+            return Status::invalid_args;
+        }
+    }
+    Json sorted(table);
+    std::stable_sort(sorted.begin(), sorted.end(), [](const Json& a, const Json& b) {
+        return a["recall"].get<float>() < b["recall"].get<float>();
+    });
+    this->node->SetTunedParams(std::move(sorted));
+    return Status::success;
+}
+
+template <typename T>
+inline Json
+Index<T>::TunedParams() const {
+    return this->node->TunedParams();
+}
+
+template <typename T>
+inline void
+Index<T>::SetRecallMonitor(std::shared_ptr<RecallMonitor> monitor) {
+    this->node->SetRecallMonitor(std::move(monitor));
+}
+
+template <typename T>
+inline std::shared_ptr<RecallMonitor>
+Index<T>::GetRecallMonitor() const {
+    return this->node->GetRecallMonitor();
+}
+
 template <typename T>
 inline Status
 Index<T>::Serialize(BinarySet& binset) const {
-    return this->node->Serialize(binset);
+    RETURN_IF_ERROR(this->node->Serialize(binset));
+    auto table = this->node->TunedParams();
+    if (table.is_array() && !table.empty()) {
+        auto dump = table.dump();
+        std::shared_ptr<uint8_t[]> data(new uint8_t[dump.size()]);
+        std::memcpy(data.get(), dump.data(), dump.size());
+        binset.Append(kTunedParamsBinary, data, dump.size());
+    }
+    return Status::success;
+}
+
+template <typename T>
+inline Status
+Index<T>::SerializeToFile(const std::string& filename, bool direct_io) const {
+    IndexFile::Writer writer;
+    RETURN_IF_ERROR(writer.Open(filename, direct_io));
+    auto streamed = this->node->SerializeToFile(writer);
+    if (streamed == Status::not_implemented) {
+        // the sections of the BinarySet in the order IndexFile::Write writes them
+        BinarySet binset;
+        RETURN_IF_ERROR(Serialize(binset));
+        for (auto& [name, binary] : binset.binary_map_) {
+            RETURN_IF_ERROR(writer.Begin(name));
+            RETURN_IF_ERROR(writer.Write(binary->data.get(), binary->size));
+            RETURN_IF_ERROR(writer.End());
+        }
+        return writer.Close();
+    }
+    RETURN_IF_ERROR(streamed);
+    auto table = this->node->TunedParams();
+    if (table.is_array() && !table.empty()) {
+        auto dump = table.dump();
+        RETURN_IF_ERROR(writer.Begin(kTunedParamsBinary));
+        RETURN_IF_ERROR(writer.Write(dump.data(), dump.size()));
+        RETURN_IF_ERROR(writer.End());
+    }
+    return writer.Close();
+}
+
+// A knowhere index file is mapped whole and its sections read through Deserialize. With enable_mmap, a file holding
+// the section of the index alone goes to DeserializeFromFile instead, so the index maps its section in place as it
+// maps a file of its own; an index without DeserializeFromFile falls back to the mapped Deserialize.
+inline Status
+DeserializeIndexFile(IndexNode& node, const std::string& filename, const Json& json, BaseConfig& cfg) {
+    std::vector<IndexFile::Section> sections;
+    RETURN_IF_ERROR(IndexFile::ReadTable(filename, sections));
+    node.SetTunedParams(Json());
+    if (cfg.enable_mmap.value_or(false) && sections.size() == 1 && sections[0].name == node.Type()) {
+        if (cfg.verify_checksum.value_or(true)) {
+            RETURN_IF_ERROR(IndexFile::Verify(filename, sections[0]));
+        }
+        cfg.file_offset = sections[0].offset;
+        cfg.file_size = sections[0].size;
+        auto status = node.DeserializeFromFile(filename, cfg);
+        if (status != Status::not_implemented) {
+            return status;
+        }
+        cfg.file_offset = 0;
+        cfg.file_size = 0;
+    }
+    auto deserialize_cfg = node.CreateConfig();
+    RETURN_IF_ERROR(LoadConfig(deserialize_cfg.get(), json, knowhere::DESERIALIZE, "Deserialize"));
+    // tells the sections that can be read in place that the mapping outlives the load
+    deserialize_cfg->enable_mmap = cfg.enable_mmap;
+    BinarySet binset;
+    RETURN_IF_ERROR(IndexFile::Map(filename, cfg, binset));
+    RETURN_IF_ERROR(ReadTunedParams(node, binset));
+    return node.Deserialize(binset, *deserialize_cfg);
 }
 
 template <typename T>
 inline Status
 Index<T>::Deserialize(const BinarySet& binset, const Json& json) {
+    ScopedDataChange change{*this->node};
     Json json_(json);
     auto cfg = this->node->CreateConfig();
     {
@@ -162,12 +1327,34 @@ Index<T>::Deserialize(const BinarySet& binset, const Json& json) {
     if (res != Status::success) {
         return res;
     }
-    return this->node->Deserialize(binset, *cfg);
+    // the compressed sections of a BinarySet for transfer are decompressed into a copy of it, the caller's is const
+    auto load = [&]() -> Status {
+        if (!BinarySetCodec::HasCompressed(binset)) {
+            RETURN_IF_ERROR(ReadTunedParams(*this->node, binset));
+            return this->node->Deserialize(binset, *cfg);
+        }
+        BinarySet raw = binset;
+        RETURN_IF_ERROR(BinarySetCodec::Decompress(raw));
+        RETURN_IF_ERROR(ReadTunedParams(*this->node, raw));
+        return this->node->Deserialize(raw, *cfg);
+    };
+    // the memory of the index goes to its home node, whose pool runs its searches
+    auto numa_node = ThreadPool::SearchNumaNode(cfg->numa_node.value());
+    if (numa_node < 0) {
+        return load();
+    }
+    {
+        Numa::ScopedNode scoped_node(numa_node);
+        RETURN_IF_ERROR(load());
+    }
+    this->node->SetSearchPool(ThreadPool::GetGlobalSearchThreadPool(numa_node));
+    return Status::success;
 }
 
 template <typename T>
 inline Status
 Index<T>::DeserializeFromFile(const std::string& filename, const Json& json) {
+    ScopedDataChange change{*this->node};
     Json json_(json);
     auto cfg = this->node->CreateConfig();
     {
@@ -181,7 +1368,65 @@ Index<T>::DeserializeFromFile(const std::string& filename, const Json& json) {
     if (res != Status::success) {
         return res;
     }
-    return this->node->DeserializeFromFile(filename, *cfg);
+    auto load = [&]() {
+        if (IndexFile::Is(filename)) {
+            return DeserializeIndexFile(*this->node, filename, json, *cfg);
+        }
+        return this->node->DeserializeFromFile(filename, *cfg);
+    };
+    // the memory of the index goes to its home node, whose pool runs its searches
+    auto numa_node = ThreadPool::SearchNumaNode(cfg->numa_node.value());
+    if (numa_node < 0) {
+        return load();
+    }
+    {
+        Numa::ScopedNode scoped_node(numa_node);
+        RETURN_IF_ERROR(load());
+    }
+    this->node->SetSearchPool(ThreadPool::GetGlobalSearchThreadPool(numa_node));
+    return Status::success;
+}
+
+template <typename T>
+inline Status
+Index<T>::Publish(const std::string& name) const {
+    BinarySet binset;
+    RETURN_IF_ERROR(Serialize(binset));
+    return IndexFile::Publish(name, binset);
+}
+
+template <typename T>
+inline Status
+Index<T>::Attach(const std::string& name, const Json& json) {
+    Json json_(json);
+    json_[meta::ENABLE_MMAP] = true;
+    return DeserializeFromFile(IndexFile::SharedMemoryPath(name), json_);
+}
+
+template <typename T>
+inline Status
+Index<T>::Unpublish(const std::string& name) {
+    return IndexFile::Unpublish(name);
+}
+
+template <typename T>
+inline Status
+Index<T>::Warmup(int64_t budget, const DataSet* queries, const Json& json, const WarmupProgress& progress) const {
+#ifdef NOT_COMPILE_FOR_SWIG
+    TimeRecorder rc("Warmup");
+#endif
+    RETURN_IF_ERROR(this->node->Warmup(budget, progress));
+    if (queries != nullptr && queries->GetRows() > 0) {
+        // only what the searches read is of interest, not their results
+        auto res = Search(*queries, json, nullptr);
+        if (!res.has_value()) {
+            return res.error();
+        }
+    }
+#ifdef NOT_COMPILE_FOR_SWIG
+    GetOpLatencyHistogram(Type(), "warmup").Observe(rc.ElapseFromBegin("done") * 0.001);
+#endif
+    return Status::success;
 }
 
 template <typename T>
@@ -196,6 +1441,12 @@ Index<T>::Size() const {
     return this->node->Size();
 }
 
+template <typename T>
+inline MemoryUsage
+Index<T>::GetMemoryUsage() const {
+    return this->node->GetMemoryUsage();
+}
+
 template <typename T>
 inline int64_t
 Index<T>::Count() const {
@@ -0,0 +1,58 @@
+// Copyright (C) 2019-2023 Zilliz. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file except in compliance
+// with the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
+// or implied. See the License for the specific language governing permissions and limitations under the License.
+
+#include "knowhere/index_iterator.h"
+
+#include <algorithm>
+
+namespace knowhere {
+
+void
+IndexIterator::Push(float distance, int64_t id) {
+    heap_.emplace_back(distance, id);
+    auto farther = [this](const auto& a, const auto& b) { return Closer(b.first, a.first); };
+    std::push_heap(heap_.begin(), heap_.end(), farther);
+}
+
+expected<DataSetPtr>
+IndexIterator::Next(int64_t n) {
+    if (n <= 0) {
+        return expected<DataSetPtr>::Err(Status::invalid_args, "the batch of an iterator must hold a result at least");
+    }
+    auto farther = [this](const auto& a, const auto& b) { return Closer(b.first, a.first); };
+    std::vector<std::pair<float, int64_t>> batch;
+    batch.reserve(n);
+    while (static_cast<int64_t>(batch.size()) < n) {
+        if (!heap_.empty() && (exhausted_ || !MayFindCloser(heap_.front().first))) {
+            std::pop_heap(heap_.begin(), heap_.end(), farther);
+            batch.push_back(heap_.back());
+            heap_.pop_back();
+            continue;
+        }
+        if (exhausted_) {
+            break;
+        }
+        auto status = Refill(n - batch.size(), exhausted_);
+        if (status != Status::success) {
+            return expected<DataSetPtr>::Err(status, "iterator failed to search for more results");
+        }
+    }
+
+    auto ids = new int64_t[batch.size()];
+    auto distances = new float[batch.size()];
+    for (size_t i = 0; i < batch.size(); ++i) {
+        distances[i] = batch[i].first;
+        ids[i] = batch[i].second;
+    }
+    return GenResultDataSet(1, batch.size(), ids, distances);
+}
+
+}  // namespace knowhere
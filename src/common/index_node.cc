@@ -0,0 +1,126 @@
+// Copyright (C) 2019-2023 Zilliz. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file except in compliance
+// with the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
+// or implied. See the License for the specific language governing permissions and limitations under the License.
+
+#include "knowhere/index_node.h"
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <mutex>
+#include <variant>
+
+#include "knowhere/comp/thread_pool.h"
+#include "knowhere/log.h"
+
+namespace knowhere {
+
+std::unique_ptr<BaseConfig>
+CopyConfig(const IndexNode& node, const Config& cfg) {
+    auto copy = node.CreateConfig();
+    for (const auto& [name, entry] : cfg.__DICT__) {
+        auto it = copy->__DICT__.find(name);
+        if (it == copy->__DICT__.end() || it->second.index() != entry.index()) {
+            continue;
+        }
+        std::visit(
+            [&to = it->second](const auto& e) {
+                using E = std::decay_t<decltype(e)>;
+                *std::get<E>(to).val = *e.val;
+            },
+            entry);
+    }
+    const auto& base = static_cast<const BaseConfig&>(cfg);
+    copy->cancellation = base.cancellation;
+    copy->file_offset = base.file_offset;
+    copy->file_size = base.file_size;
+    return copy;
+}
+
+folly::Future<expected<DataSetPtr>>
+IndexNode::SearchAsync(const DataSet& dataset, const Config& cfg, const BitsetView& bitset) const {
+    // the search runs its own parallel_for on the same pool, the pool thread joins it rather than blocking
+    return AsyncSearchPool()->push([this, &dataset, &cfg, bitset]() {
+        ThreadPool::ScopedParallelism parallelism(static_cast<const BaseConfig&>(cfg).max_threads.value());
+        return Search(dataset, cfg, bitset);
+    });
+}
+
+folly::Future<expected<DataSetPtr>>
+IndexNode::RangeSearchAsync(const DataSet& dataset, const Config& cfg, const BitsetView& bitset) const {
+    return AsyncSearchPool()->push([this, &dataset, &cfg, bitset]() {
+        ThreadPool::ScopedParallelism parallelism(static_cast<const BaseConfig&>(cfg).max_threads.value());
+        return RangeSearch(dataset, cfg, bitset);
+    });
+}
+
+// The regions are cut to the budget and into chunks the search pool faults in, touching a byte of every page, after
+// the kernel was told to read them ahead; the reads of the threads and of the read ahead overlap.
+Status
+IndexNode::Warmup(int64_t budget, const WarmupProgress& progress) const {
+    constexpr uintptr_t kChunkSize = 1 << 20;
+    const uintptr_t page = sysconf(_SC_PAGESIZE);
+    std::vector<MappedRegion> regions;
+    MappedRegions(regions);
+    std::vector<std::pair<uintptr_t, uintptr_t>> chunks;
+    int64_t total = 0;
+    for (auto& region : regions) {
+        if (budget > 0 && total >= budget) {
+            break;
+        }
+        auto begin = reinterpret_cast<uintptr_t>(region.addr);
+        auto end = begin + region.size;
+        if (budget > 0) {
+            end = std::min<uintptr_t>(end, begin + (budget - total));
+        }
+        if (begin == end) {
+            continue;
+        }
+        total += end - begin;
+        // madvise takes the address of a page, the region starts anywhere in the mapping
+        auto page_begin = begin / page * page;
+        if (madvise(reinterpret_cast<void*>(page_begin), end - page_begin, MADV_WILLNEED) != 0) {
+            LOG_KNOWHERE_WARNING_ << "madvise WILLNEED failed: " << std::strerror(errno);
+        }
+        for (auto chunk = page_begin; chunk < end; chunk += kChunkSize) {
+            chunks.emplace_back(std::max(chunk, begin), std::min(chunk + kChunkSize, end));
+        }
+    }
+    if (chunks.empty()) {
+        return Status::success;
+    }
+
+    std::mutex progress_mtx;
+    int64_t done = 0;
+    AsyncSearchPool()->parallel_for(0, chunks.size(), 1, [&](int64_t c) {
+        auto [begin, end] = chunks[c];
+        uint8_t sum = 0;
+        for (auto addr = begin / page * page; addr < end; addr += page) {
+            sum ^= *reinterpret_cast<const volatile uint8_t*>(std::max(addr, begin));
+        }
+        (void)sum;
+        if (progress) {
+            std::lock_guard lock(progress_mtx);
+            done += end - begin;
+            progress(done, total);
+        }
+    });
+    return Status::success;
+}
+
+std::shared_ptr<ThreadPool>
+IndexNode::AsyncSearchPool() const {
+    return ThreadPool::GetGlobalSearchThreadPool();
+}
+
+}  // namespace knowhere
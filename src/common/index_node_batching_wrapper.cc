@@ -0,0 +1,206 @@
+// Copyright (C) 2019-2023 Zilliz. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file except in compliance
+// with the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
+// or implied. See the License for the specific language governing permissions and limitations under the License.
+
+#include "knowhere/index_node_batching_wrapper.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <future>
+#include <typeinfo>
+#include <variant>
+#include <vector>
+
+#include "knowhere/config.h"
+#include "knowhere/log.h"
+
+namespace knowhere {
+
+namespace {
+
+std::atomic<int64_t> batching_window_us{0};
+std::atomic<int64_t> batching_max_rows{1024};
+
+// a batch runs with the params of its first search, the others must have the same values for all of them
+bool
+SameParams(const Config& a, const Config& b) {
+    if (typeid(a) != typeid(b) || a.__DICT__.size() != b.__DICT__.size()) {
+        return false;
+    }
+    for (const auto& [name, entry] : a.__DICT__) {
+        auto it = b.__DICT__.find(name);
+        if (it == b.__DICT__.end() || it->second.index() != entry.index()) {
+            return false;
+        }
+        auto same = std::visit(
+            [&other = it->second](const auto& e) {
+                using E = std::decay_t<decltype(e)>;
+                return *e.val == *std::get<E>(other).val;
+            },
+            entry);
+        if (!same) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// the searches of a batch share the filter of the first one, which holds for no filter or the very same one
+bool
+SameFilter(const BitsetView& a, const BitsetView& b) {
+    if (a.empty() || b.empty()) {
+        return a.empty() && b.empty();
+    }
+    return a.is_dense() && b.is_dense() && a.data() == b.data() && a.size() == b.size();
+}
+
+}  // namespace
+
+struct IndexNodeBatchingWrapper::Batch {
+    struct Request {
+        const DataSet* dataset;
+        std::promise<expected<DataSetPtr>> result;
+    };
+
+    Batch(const Config& cfg, const BitsetView& bitset, int64_t dim) : cfg(cfg), bitset(bitset), dim(dim) {
+    }
+
+    // those of the first search, which waits for the batch to run and so outlives it
+    const Config& cfg;
+    BitsetView bitset;
+    int64_t dim;
+    int64_t rows = 0;
+    // the first is the search running the batch
+    std::vector<Request> requests;
+    // set once the batch stops taking searches, either full or past the window
+    bool closed = false;
+    std::condition_variable full;
+};
+
+IndexNodeBatchingWrapper::IndexNodeBatchingWrapper(std::unique_ptr<IndexNode> index_node)
+    : index_node_(std::move(index_node)) {
+}
+
+void
+IndexNodeBatchingWrapper::SetBatching(int64_t window_us, int64_t max_rows) {
+    LOG_KNOWHERE_INFO_ << "search batching window " << window_us << " us, max rows " << max_rows;
+    batching_window_us.store(std::max<int64_t>(window_us, 0));
+    batching_max_rows.store(std::max<int64_t>(max_rows, 1));
+}
+
+expected<DataSetPtr>
+IndexNodeBatchingWrapper::Search(const DataSet& dataset, const Config& cfg, const BitsetView& bitset) const {
+    auto window_us = batching_window_us.load();
+    auto max_rows = batching_max_rows.load();
+    auto rows = dataset.GetRows();
+    auto dim = dataset.GetDim();
+    const auto& base_cfg = static_cast<const BaseConfig&>(cfg);
+    if (window_us == 0 || rows >= max_rows || base_cfg.cancellation != nullptr || base_cfg.result_ids != nullptr ||
+        base_cfg.trace_visit.value_or(false) || dataset.IsSparse()) {
+        return index_node_->Search(dataset, cfg, bitset);
+    }
+
+    std::unique_lock lock(mutex_);
+    if (open_ != nullptr) {
+        auto& batch = *open_;
+        if (batch.dim != dim || !SameFilter(batch.bitset, bitset) || !SameParams(batch.cfg, cfg)) {
+            lock.unlock();
+            return index_node_->Search(dataset, cfg, bitset);
+        }
+        if (batch.rows + rows <= max_rows) {
+            batch.requests.push_back({&dataset, {}});
+            auto result = batch.requests.back().result.get_future();
+            batch.rows += rows;
+            if (batch.rows == max_rows) {
+                batch.closed = true;
+                open_ = nullptr;
+                batch.full.notify_one();
+            }
+            lock.unlock();
+            return result.get();
+        }
+        // no room left, the batch runs as it is and this search starts the next one
+        batch.closed = true;
+        open_ = nullptr;
+        batch.full.notify_one();
+    }
+
+    auto batch = std::make_shared<Batch>(cfg, bitset, dim);
+    batch->requests.push_back({&dataset, {}});
+    batch->rows = rows;
+    open_ = batch;
+    batch->full.wait_for(lock, std::chrono::microseconds(window_us), [&batch]() { return batch->closed; });
+    if (open_ == batch) {
+        open_ = nullptr;
+    }
+    batch->closed = true;
+    lock.unlock();
+    return RunBatch(*batch);
+}
+
+expected<DataSetPtr>
+IndexNodeBatchingWrapper::RunBatch(Batch& batch) const {
+    auto& requests = batch.requests;
+    if (requests.size() == 1) {
+        return index_node_->Search(*requests[0].dataset, batch.cfg, batch.bitset);
+    }
+
+    expected<DataSetPtr> res = expected<DataSetPtr>::Err(Status::invalid_args, "search batch did not run");
+    try {
+        std::vector<float> queries(batch.rows * batch.dim);
+        auto row_bytes = batch.dim * sizeof(float);
+        int64_t offset = 0;
+        for (const auto& request : requests) {
+            auto rows = request.dataset->GetRows();
+            std::memcpy(queries.data() + offset * batch.dim, request.dataset->GetTensor(), rows * row_bytes);
+            offset += rows;
+        }
+        auto query = GenDataSet(batch.rows, batch.dim, queries.data());
+        res = index_node_->Search(*query, batch.cfg, batch.bitset);
+    } catch (...) {
+        for (size_t i = 1; i < requests.size(); ++i) {
+            requests[i].result.set_exception(std::current_exception());
+        }
+        throw;
+    }
+    if (!res.has_value()) {
+        for (size_t i = 1; i < requests.size(); ++i) {
+            requests[i].result.set_value(expected<DataSetPtr>::Err(res.error(), res.what()));
+        }
+        return res;
+    }
+
+    // every search gets its own rows of the results, as if it had run alone
+    const auto& all = res.value();
+    auto k = all->GetDim();
+    auto all_ids = all->GetIds();
+    auto all_distances = all->GetDistance();
+    expected<DataSetPtr> first = expected<DataSetPtr>::Err(Status::invalid_args, "search batch is empty");
+    int64_t offset = 0;
+    for (size_t i = 0; i < requests.size(); ++i) {
+        auto rows = requests[i].dataset->GetRows();
+        auto ids = new int64_t[rows * k];
+        auto distances = new float[rows * k];
+        std::memcpy(ids, all_ids + offset * k, rows * k * sizeof(int64_t));
+        std::memcpy(distances, all_distances + offset * k, rows * k * sizeof(float));
+        offset += rows;
+        auto ds = GenResultDataSet(rows, k, ids, distances);
+        if (i == 0) {
+            first = ds;
+        } else {
+            requests[i].result.set_value(ds);
+        }
+    }
+    return first;
+}
+
+}  // namespace knowhere
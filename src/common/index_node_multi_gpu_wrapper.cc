@@ -0,0 +1,560 @@
+// Copyright (C) 2019-2023 Zilliz. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file except in compliance
+// with the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
+// or implied. See the License for the specific language governing permissions and limitations under the License.
+
+#include "knowhere/index_node_multi_gpu_wrapper.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <thread>
+#include <variant>
+
+#include "common/knn_util.h"
+#include "common/range_util.h"
+#include "knowhere/comp/index_param.h"
+#include "knowhere/log.h"
+#include "knowhere/utils.h"
+
+namespace knowhere {
+
+namespace {
+
+constexpr const char* kMetaSuffix = "_multi_gpu";
+constexpr const char* kShardSuffix = "_shard_";
+
+std::vector<int64_t>
+DeviceList(const Config& cfg) {
+    std::vector<int64_t> devices;
+    auto it = cfg.__DICT__.find(indexparam::GPU_IDS);
+    if (it != cfg.__DICT__.end()) {
+        if (auto entry = std::get_if<Entry<CFG_LIST>>(&it->second); entry != nullptr && entry->val->has_value()) {
+            devices.assign(entry->val->value().begin(), entry->val->value().end());
+        }
+    }
+    return devices;
+}
+
+std::string
+MultiGpuMode(const Config& cfg) {
+    auto it = cfg.__DICT__.find(indexparam::MULTI_GPU_MODE);
+    if (it != cfg.__DICT__.end()) {
+        if (auto entry = std::get_if<Entry<CFG_STRING>>(&it->second); entry != nullptr) {
+            return entry->val->value_or("replicated");
+        }
+    }
+    return "replicated";
+}
+
+// points the config of a node at the single device it runs on
+void
+SetDevice(BaseConfig& cfg, int64_t device) {
+    if (auto it = cfg.__DICT__.find(indexparam::GPU_IDS); it != cfg.__DICT__.end()) {
+        if (auto entry = std::get_if<Entry<CFG_LIST>>(&it->second)) {
+            *entry->val = std::list<int>{static_cast<int>(device)};
+        }
+    }
+    if (auto it = cfg.__DICT__.find(indexparam::GPU_ID); it != cfg.__DICT__.end()) {
+        if (auto entry = std::get_if<Entry<CFG_INT>>(&it->second)) {
+            *entry->val = static_cast<int32_t>(device);
+        }
+    }
+}
+
+// runs fn for the devices side by side, the builds and loads of different devices do not wait on each other
+Status
+ForEachDevice(size_t n, const std::function<Status(size_t)>& fn) {
+    std::vector<Status> status(n, Status::success);
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < n; ++i) {
+        threads.emplace_back([&, i]() { status[i] = fn(i); });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    for (auto s : status) {
+        RETURN_IF_ERROR(s);
+    }
+    return Status::success;
+}
+
+bool
+IsIp(const Config& cfg) {
+    const auto& metric = static_cast<const BaseConfig&>(cfg).metric_type.value();
+    return IsMetricType(metric, metric::IP) || IsMetricType(metric, metric::COSINE);
+}
+
+}  // namespace
+
+IndexNodeMultiGpuWrapper::IndexNodeMultiGpuWrapper(NodeFactory make_node) : make_node_(std::move(make_node)) {
+    Reset();
+}
+
+void
+IndexNodeMultiGpuWrapper::Reset() {
+    nodes_.clear();
+    nodes_.push_back(make_node_());
+    devices_.clear();
+    offsets_.assign(1, 0);
+    sharded_ = false;
+}
+
+Status
+IndexNodeMultiGpuWrapper::Build(const DataSet& dataset, const Config& cfg) {
+    auto devices = DeviceList(cfg);
+    if (devices.size() <= 1) {
+        return nodes_[0]->Build(dataset, cfg);
+    }
+    if (nodes_.size() > 1) {
+        LOG_KNOWHERE_WARNING_ << "index is already trained";
+        return Status::index_already_trained;
+    }
+    auto mode = MultiGpuMode(cfg);
+    if (mode == "sharded") {
+        return BuildShards(dataset, cfg, devices, &IndexNode::Build);
+    }
+    if (mode != "replicated") {
+        LOG_KNOWHERE_WARNING_ << "invalid multi_gpu_mode " << mode;
+        return Status::invalid_args;
+    }
+    auto first = CopyConfig(*nodes_[0], cfg);
+    SetDevice(*first, devices[0]);
+    RETURN_IF_ERROR(nodes_[0]->Build(dataset, *first));
+    return Replicate(devices);
+}
+
+Status
+IndexNodeMultiGpuWrapper::Train(const DataSet& dataset, const Config& cfg) {
+    auto devices = DeviceList(cfg);
+    if (devices.size() <= 1) {
+        return nodes_[0]->Train(dataset, cfg);
+    }
+    if (nodes_.size() > 1) {
+        LOG_KNOWHERE_WARNING_ << "index is already trained";
+        return Status::index_already_trained;
+    }
+    auto mode = MultiGpuMode(cfg);
+    if (mode == "sharded") {
+        return BuildShards(dataset, cfg, devices, &IndexNode::Train);
+    }
+    if (mode != "replicated") {
+        LOG_KNOWHERE_WARNING_ << "invalid multi_gpu_mode " << mode;
+        return Status::invalid_args;
+    }
+    auto first = CopyConfig(*nodes_[0], cfg);
+    SetDevice(*first, devices[0]);
+    RETURN_IF_ERROR(nodes_[0]->Train(dataset, *first));
+    return Replicate(devices);
+}
+
+Status
+IndexNodeMultiGpuWrapper::BuildShards(const DataSet& dataset, const Config& cfg, const std::vector<int64_t>& devices,
+                                      Status (IndexNode::*step)(const DataSet&, const Config&)) {
+    auto rows = dataset.GetRows();
+    auto dim = dataset.GetDim();
+    auto n = static_cast<int64_t>(devices.size());
+    // the shards hold multiples of 8 vectors, a filter then splits between bytes
+    auto per_shard = std::max<int64_t>(8, ((rows + n - 1) / n + 7) / 8 * 8);
+    auto shards = std::max<int64_t>(1, (rows + per_shard - 1) / per_shard);
+    auto data = static_cast<const float*>(dataset.GetTensor());
+
+    std::vector<std::unique_ptr<IndexNode>> nodes(shards);
+    for (auto& node : nodes) {
+        node = make_node_();
+    }
+    Status done = ForEachDevice(shards, [&](size_t i) {
+        auto begin = static_cast<int64_t>(i) * per_shard;
+        auto part = GenDataSet(std::min(per_shard, rows - begin), dim, data + begin * dim);
+        auto shard_cfg = CopyConfig(*nodes[i], cfg);
+        SetDevice(*shard_cfg, devices[i]);
+        return ((*nodes[i]).*step)(*part, *shard_cfg);
+    });
+    RETURN_IF_ERROR(done);
+
+    nodes_ = std::move(nodes);
+    devices_.assign(devices.begin(), devices.begin() + shards);
+    offsets_.resize(shards);
+    for (int64_t i = 0; i < shards; ++i) {
+        offsets_[i] = i * per_shard;
+    }
+    sharded_ = true;
+    return Status::success;
+}
+
+Status
+IndexNodeMultiGpuWrapper::Replicate(const std::vector<int64_t>& devices) {
+    BinarySet binset;
+    RETURN_IF_ERROR(nodes_[0]->Serialize(binset));
+    std::vector<std::unique_ptr<IndexNode>> replicas(devices.size() - 1);
+    for (auto& replica : replicas) {
+        replica = make_node_();
+    }
+    Status done = ForEachDevice(replicas.size(), [&](size_t i) {
+        auto load_cfg = replicas[i]->CreateConfig();
+        SetDevice(*load_cfg, devices[i + 1]);
+        return replicas[i]->Deserialize(binset, *load_cfg);
+    });
+    RETURN_IF_ERROR(done);
+
+    for (auto& replica : replicas) {
+        nodes_.push_back(std::move(replica));
+    }
+    devices_ = devices;
+    sharded_ = false;
+    return Status::success;
+}
+
+Status
+IndexNodeMultiGpuWrapper::Add(const DataSet& dataset, const Config& cfg) {
+    if (nodes_.size() == 1) {
+        return nodes_[0]->Add(dataset, cfg);
+    }
+    if (!Sharded()) {
+        // the copies take the same vectors in the same order, they stay the same
+        return ForEachDevice(nodes_.size(), [&](size_t i) {
+            auto node_cfg = CopyConfig(*nodes_[i], cfg);
+            SetDevice(*node_cfg, devices_[i]);
+            return nodes_[i]->Add(dataset, *node_cfg);
+        });
+    }
+
+    // into freshly trained shards the vectors go by the offsets of the shards, later ones to the last shard, which
+    // holds the largest ids
+    auto rows = dataset.GetRows();
+    auto dim = dataset.GetDim();
+    auto data = static_cast<const float*>(dataset.GetTensor());
+    bool fresh = Count() == 0;
+    return ForEachDevice(nodes_.size(), [&](size_t i) {
+        int64_t begin = 0, end = rows;
+        if (fresh) {
+            begin = std::min(offsets_[i], rows);
+            end = i + 1 < offsets_.size() ? std::min(offsets_[i + 1], rows) : rows;
+        } else if (i + 1 < nodes_.size()) {
+            return Status::success;
+        }
+        if (begin == end) {
+            return Status::success;
+        }
+        auto part = GenDataSet(end - begin, dim, data + begin * dim);
+        auto node_cfg = CopyConfig(*nodes_[i], cfg);
+        SetDevice(*node_cfg, devices_[i]);
+        return nodes_[i]->Add(*part, *node_cfg);
+    });
+}
+
+size_t
+IndexNodeMultiGpuWrapper::ShardOf(int64_t id) const {
+    return std::upper_bound(offsets_.begin(), offsets_.end(), id) - offsets_.begin() - 1;
+}
+
+Status
+IndexNodeMultiGpuWrapper::DeleteByIds(const DataSet& dataset) {
+    if (!Sharded()) {
+        for (auto& node : nodes_) {
+            RETURN_IF_ERROR(node->DeleteByIds(dataset));
+        }
+        return Status::success;
+    }
+    std::vector<std::vector<int64_t>> local(nodes_.size());
+    auto ids = dataset.GetIds();
+    for (int64_t i = 0; i < dataset.GetRows(); ++i) {
+        if (ids[i] >= 0) {
+            auto shard = ShardOf(ids[i]);
+            local[shard].push_back(ids[i] - offsets_[shard]);
+        }
+    }
+    for (size_t i = 0; i < nodes_.size(); ++i) {
+        if (!local[i].empty()) {
+            RETURN_IF_ERROR(nodes_[i]->DeleteByIds(*GenIdsDataSet(local[i].size(), local[i].data())));
+        }
+    }
+    return Status::success;
+}
+
+expected<DataSetPtr>
+IndexNodeMultiGpuWrapper::Search(const DataSet& dataset, const Config& cfg, const BitsetView& bitset) const {
+    if (!Sharded()) {
+        return NextReplica().Search(dataset, cfg, bitset);
+    }
+    const auto& base = static_cast<const BaseConfig&>(cfg);
+    auto nq = dataset.GetRows();
+    auto k = base.k.value();
+    auto n = nodes_.size();
+    // the shards write arrays of their own, the merge writes the buffers of the caller
+    auto shard_cfg = CopyConfig(*nodes_[0], cfg);
+    std::vector<uint8_t> dense_bits;
+    auto dense = bitset.to_dense(dense_bits);
+    std::vector<BitsetView> filters(n);
+    for (size_t i = 0; i < n; ++i) {
+        if (static_cast<size_t>(offsets_[i]) < dense.size()) {
+            auto count = std::min<size_t>(dense.size() - offsets_[i], nodes_[i]->Count());
+            filters[i] = BitsetView(dense.data() + offsets_[i] / 8, count);
+        }
+    }
+    std::vector<folly::Future<expected<DataSetPtr>>> futures;
+    for (size_t i = 0; i < n; ++i) {
+        futures.push_back(nodes_[i]->SearchAsync(dataset, *shard_cfg, filters[i]));
+    }
+    std::vector<expected<DataSetPtr>> results;
+    for (auto& future : futures) {
+        results.push_back(std::move(future).get());
+    }
+    for (const auto& res : results) {
+        if (!res.has_value()) {
+            return res;
+        }
+    }
+
+    // the k closest of the n * k the shards found for every query
+    bool is_ip = IsIp(cfg);
+    auto closer = [is_ip](const std::pair<float, int64_t>& a, const std::pair<float, int64_t>& b) {
+        return is_ip ? a.first > b.first : a.first < b.first;
+    };
+    KnnResultBuffers buffers(base, nq * k);
+    std::vector<std::pair<float, int64_t>> candidates;
+    for (int64_t q = 0; q < nq; ++q) {
+        candidates.clear();
+        for (size_t i = 0; i < n; ++i) {
+            const auto& res = results[i].value();
+            auto shard_k = res->GetDim();
+            auto ids = res->GetIds() + q * shard_k;
+            auto distances = res->GetDistance() + q * shard_k;
+            for (int64_t j = 0; j < shard_k; ++j) {
+                if (ids[j] >= 0) {
+                    candidates.emplace_back(distances[j], ids[j] + offsets_[i]);
+                }
+            }
+        }
+        auto found = std::min<size_t>(k, candidates.size());
+        std::partial_sort(candidates.begin(), candidates.begin() + found, candidates.end(), closer);
+        for (int64_t j = 0; j < k; ++j) {
+            auto pos = q * k + j;
+            if (static_cast<size_t>(j) < found) {
+                buffers.distances[pos] = candidates[j].first;
+                buffers.ids[pos] = candidates[j].second;
+            } else {
+                buffers.distances[pos] = is_ip ? -std::numeric_limits<float>::infinity()
+                                               : std::numeric_limits<float>::infinity();
+                buffers.ids[pos] = -1;
+            }
+        }
+    }
+    return buffers.ToDataSet(nq, k);
+}
+
+expected<DataSetPtr>
+IndexNodeMultiGpuWrapper::RangeSearch(const DataSet& dataset, const Config& cfg, const BitsetView& bitset) const {
+    if (!Sharded()) {
+        return NextReplica().RangeSearch(dataset, cfg, bitset);
+    }
+    const auto& base = static_cast<const BaseConfig&>(cfg);
+    auto nq = dataset.GetRows();
+    auto n = nodes_.size();
+    auto shard_cfg = CopyConfig(*nodes_[0], cfg);
+    std::vector<uint8_t> dense_bits;
+    auto dense = bitset.to_dense(dense_bits);
+    std::vector<BitsetView> filters(n);
+    for (size_t i = 0; i < n; ++i) {
+        if (static_cast<size_t>(offsets_[i]) < dense.size()) {
+            auto count = std::min<size_t>(dense.size() - offsets_[i], nodes_[i]->Count());
+            filters[i] = BitsetView(dense.data() + offsets_[i] / 8, count);
+        }
+    }
+    std::vector<folly::Future<expected<DataSetPtr>>> futures;
+    for (size_t i = 0; i < n; ++i) {
+        futures.push_back(nodes_[i]->RangeSearchAsync(dataset, *shard_cfg, filters[i]));
+    }
+    std::vector<expected<DataSetPtr>> results;
+    for (auto& future : futures) {
+        results.push_back(std::move(future).get());
+    }
+    for (const auto& res : results) {
+        if (!res.has_value()) {
+            return res;
+        }
+    }
+
+    // the shards kept the hits in range, with max_results the builder keeps the closest of all of them
+    RangeSearchResultBuilder builder(nq, base.max_results.value_or(0), IsIp(cfg));
+    for (int64_t q = 0; q < nq; ++q) {
+        auto writer = builder.Query(q);
+        for (size_t i = 0; i < n; ++i) {
+            const auto& res = results[i].value();
+            auto lims = res->GetLims();
+            for (auto j = lims[q]; j < lims[q + 1]; ++j) {
+                writer.Add(res->GetDistance()[j], res->GetIds()[j] + offsets_[i]);
+            }
+        }
+    }
+    float* distances = nullptr;
+    int64_t* ids = nullptr;
+    size_t* lims = nullptr;
+    auto owned = builder.Build(base, distances, ids, lims);
+    auto res = GenResultDataSet(nq, ids, distances, lims);
+    res->SetIsOwner(owned);
+    return res;
+}
+
+expected<std::vector<IndexIteratorPtr>>
+IndexNodeMultiGpuWrapper::AnnIterator(const DataSet& dataset, const Config& cfg, const BitsetView& bitset) const {
+    if (Sharded()) {
+        return expected<std::vector<IndexIteratorPtr>>::Err(Status::not_implemented,
+                                                            "no iterator over the shards of " + Type());
+    }
+    return NextReplica().AnnIterator(dataset, cfg, bitset);
+}
+
+expected<DataSetPtr>
+IndexNodeMultiGpuWrapper::GetVectorByIds(const DataSet& dataset) const {
+    if (!Sharded()) {
+        return NextReplica().GetVectorByIds(dataset);
+    }
+    auto rows = dataset.GetRows();
+    auto dim = Dim();
+    auto ids = dataset.GetIds();
+    std::vector<std::vector<int64_t>> local(nodes_.size());
+    std::vector<std::vector<int64_t>> where(nodes_.size());
+    for (int64_t i = 0; i < rows; ++i) {
+        if (ids[i] < 0) {
+            return expected<DataSetPtr>::Err(Status::invalid_args, "invalid id " + std::to_string(ids[i]));
+        }
+        auto shard = ShardOf(ids[i]);
+        local[shard].push_back(ids[i] - offsets_[shard]);
+        where[shard].push_back(i);
+    }
+    std::unique_ptr<float[]> data(new float[rows * dim]);
+    for (size_t i = 0; i < nodes_.size(); ++i) {
+        if (local[i].empty()) {
+            continue;
+        }
+        auto res = nodes_[i]->GetVectorByIds(*GenIdsDataSet(local[i].size(), local[i].data()));
+        if (!res.has_value()) {
+            return res;
+        }
+        auto tensor = static_cast<const float*>(res.value()->GetTensor());
+        for (size_t j = 0; j < where[i].size(); ++j) {
+            std::memcpy(data.get() + where[i][j] * dim, tensor + j * dim, dim * sizeof(float));
+        }
+    }
+    return GenResultDataSet(rows, dim, data.release());
+}
+
+Status
+IndexNodeMultiGpuWrapper::Serialize(BinarySet& binset) const {
+    if (nodes_.size() == 1) {
+        return nodes_[0]->Serialize(binset);
+    }
+    if (Sharded()) {
+        for (size_t i = 0; i < nodes_.size(); ++i) {
+            BinarySet shard;
+            RETURN_IF_ERROR(nodes_[i]->Serialize(shard));
+            for (auto& [name, binary] : shard.binary_map_) {
+                binset.Append(name + kShardSuffix + std::to_string(i), binary);
+            }
+        }
+    } else {
+        // a single copy, a host loading it without the meta serves it from one device
+        RETURN_IF_ERROR(nodes_[0]->Serialize(binset));
+    }
+
+    // sharded, the number of nodes, their devices and the offsets of the shards
+    std::vector<int64_t> meta = {sharded_ ? 1 : 0, static_cast<int64_t>(nodes_.size())};
+    meta.insert(meta.end(), devices_.begin(), devices_.end());
+    meta.insert(meta.end(), offsets_.begin(), offsets_.end());
+    meta.resize(2 + 2 * nodes_.size());
+    std::shared_ptr<uint8_t[]> data(new uint8_t[meta.size() * sizeof(int64_t)]);
+    std::memcpy(data.get(), meta.data(), meta.size() * sizeof(int64_t));
+    binset.Append(Type() + kMetaSuffix, data, meta.size() * sizeof(int64_t));
+    return Status::success;
+}
+
+Status
+IndexNodeMultiGpuWrapper::Deserialize(const BinarySet& binset, const Config& config) {
+    Reset();
+    auto meta_binary = binset.GetByName(Type() + kMetaSuffix);
+    if (meta_binary == nullptr) {
+        return nodes_[0]->Deserialize(binset, config);
+    }
+    auto words = meta_binary->size / static_cast<int64_t>(sizeof(int64_t));
+    std::vector<int64_t> meta(words);
+    std::memcpy(meta.data(), meta_binary->data.get(), words * sizeof(int64_t));
+    if (words < 2 || meta[1] < 1 || words != 2 + 2 * meta[1]) {
+        LOG_KNOWHERE_ERROR_ << "Invalid multi-GPU meta in binary set.";
+        return Status::invalid_binary_set;
+    }
+    auto n = meta[1];
+    sharded_ = meta[0] != 0;
+    devices_.assign(meta.begin() + 2, meta.begin() + 2 + n);
+    offsets_.assign(meta.begin() + 2 + n, meta.end());
+    nodes_.resize(n);
+    for (auto& node : nodes_) {
+        if (node == nullptr) {
+            node = make_node_();
+        }
+    }
+
+    Status loaded = ForEachDevice(n, [&](size_t i) {
+        auto node_cfg = CopyConfig(*nodes_[i], config);
+        SetDevice(*node_cfg, devices_[i]);
+        if (!sharded_) {
+            return nodes_[i]->Deserialize(binset, *node_cfg);
+        }
+        BinarySet shard;
+        auto suffix = kShardSuffix + std::to_string(i);
+        for (auto& [name, binary] : binset.binary_map_) {
+            if (name.size() > suffix.size() && name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0) {
+                shard.Append(name.substr(0, name.size() - suffix.size()), binary);
+            }
+        }
+        return nodes_[i]->Deserialize(shard, *node_cfg);
+    });
+    if (loaded != Status::success) {
+        Reset();
+    }
+    return loaded;
+}
+
+Status
+IndexNodeMultiGpuWrapper::DeserializeFromFile(const std::string& filename, const Config& config) {
+    Reset();
+    return nodes_[0]->DeserializeFromFile(filename, config);
+}
+
+int64_t
+IndexNodeMultiGpuWrapper::Size() const {
+    int64_t size = 0;
+    for (auto& node : nodes_) {
+        size += node->Size();
+    }
+    return size;
+}
+
+MemoryUsage
+IndexNodeMultiGpuWrapper::GetMemoryUsage() const {
+    MemoryUsage usage;
+    for (auto& node : nodes_) {
+        usage += node->GetMemoryUsage();
+    }
+    return usage;
+}
+
+int64_t
+IndexNodeMultiGpuWrapper::Count() const {
+    if (!Sharded()) {
+        return nodes_[0]->Count();
+    }
+    int64_t count = 0;
+    for (auto& node : nodes_) {
+        count += node->Count();
+    }
+    return count;
+}
+
+}  // namespace knowhere
@@ -0,0 +1,315 @@
+// Copyright (C) 2019-2023 Zilliz. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file except in compliance
+// with the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
+// or implied. See the License for the specific language governing permissions and limitations under the License.
+
+#include "knowhere/index_node_pre_transform_wrapper.h"
+
+#include <strings.h>
+
+#include <typeinfo>
+
+#include "faiss/VectorTransform.h"
+#include "faiss/index_io.h"
+#include "io/FaissIO.h"
+#include "knowhere/comp/index_param.h"
+#include "knowhere/log.h"
+#include "knowhere/utils.h"
+
+namespace knowhere {
+
+namespace {
+
+constexpr const char* kPreTransformBinary = "pre_transform";
+
+// the transforms are all linear, equal when their matrices and biases are
+bool
+SameTransform(const faiss::VectorTransform* a, const faiss::VectorTransform* b) {
+    if (a == nullptr || b == nullptr) {
+        return a == b;
+    }
+    auto la = dynamic_cast<const faiss::LinearTransform*>(a);
+    auto lb = dynamic_cast<const faiss::LinearTransform*>(b);
+    return la != nullptr && lb != nullptr && typeid(*la) == typeid(*lb) && la->d_in == lb->d_in &&
+           la->d_out == lb->d_out && la->A == lb->A && la->b == lb->b;
+}
+
+int64_t
+TransformBytes(const faiss::VectorTransform* transform) {
+    auto linear = dynamic_cast<const faiss::LinearTransform*>(transform);
+    if (linear == nullptr) {
+        return 0;
+    }
+    auto floats = linear->A.capacity() + linear->b.capacity();
+    if (auto pca = dynamic_cast<const faiss::PCAMatrix*>(linear)) {
+        floats += pca->mean.capacity() + pca->eigenvalues.capacity() + pca->PCAMat.capacity();
+    }
+    return sizeof(*linear) + floats * sizeof(float);
+}
+
+}  // namespace
+
+IndexNodePreTransformWrapper::IndexNodePreTransformWrapper(std::unique_ptr<IndexNode> index_node)
+    : index_node_(std::move(index_node)) {
+}
+
+IndexNodePreTransformWrapper::~IndexNodePreTransformWrapper() = default;
+
+Status
+IndexNodePreTransformWrapper::TrainTransform(const DataSet& dataset, const Config& cfg) {
+    const auto& base_cfg = static_cast<const BaseConfig&>(cfg);
+    auto& type = base_cfg.pre_transform.value();
+    transform_ = nullptr;
+    if (!strcasecmp(type.c_str(), "NONE")) {
+        return Status::success;
+    }
+    if (dataset.IsSparse()) {
+        LOG_KNOWHERE_ERROR_ << "pre_transform " << type << " of sparse rows";
+        return Status::invalid_args;
+    }
+    auto rows = dataset.GetRows();
+    auto dim = dataset.GetDim();
+    auto dim_out = base_cfg.pre_transform_dim.value() > 0 ? base_cfg.pre_transform_dim.value() : dim;
+    std::unique_ptr<faiss::VectorTransform> transform;
+    if (!strcasecmp(type.c_str(), "PCA")) {
+        // the centering of the PCA keeps the L2 distances only
+        if (!IsMetricType(base_cfg.metric_type.value(), metric::L2)) {
+            LOG_KNOWHERE_ERROR_ << "pre_transform PCA only supports metric L2, not " << base_cfg.metric_type.value();
+            return Status::invalid_metric_type;
+        }
+        if (dim_out > dim) {
+            LOG_KNOWHERE_ERROR_ << "pre_transform_dim(" << dim_out << ") of PCA larger than dim(" << dim << ")";
+            return Status::invalid_args;
+        }
+        transform = std::make_unique<faiss::PCAMatrix>(dim, dim_out);
+    } else if (!strcasecmp(type.c_str(), "RR")) {
+        transform = std::make_unique<faiss::RandomRotationMatrix>(dim, dim_out);
+    } else if (!strcasecmp(type.c_str(), "OPQ")) {
+        auto m = base_cfg.pre_transform_m.value();
+        if (dim_out % m != 0) {
+            LOG_KNOWHERE_ERROR_ << "pre_transform_dim(" << dim_out << ") of OPQ not a multiple of pre_transform_m("
+                                << m << ")";
+            return Status::invalid_args;
+        }
+        transform = std::make_unique<faiss::OPQMatrix>(dim, m, dim_out);
+    } else {
+        LOG_KNOWHERE_ERROR_ << "invalid pre_transform " << type;
+        return Status::invalid_args;
+    }
+    try {
+        transform->train(rows, static_cast<const float*>(dataset.GetTensor()));
+    } catch (const std::exception& e) {
+        LOG_KNOWHERE_WARNING_ << "faiss inner error: " << e.what();
+        return Status::faiss_inner_error;
+    }
+    transform_ = std::move(transform);
+    return Status::success;
+}
+
+DataSetPtr
+IndexNodePreTransformWrapper::Transform(const DataSet& dataset) const {
+    auto rows = dataset.GetRows();
+    auto transformed = transform_->apply(rows, static_cast<const float*>(dataset.GetTensor()));
+    return GenResultDataSet(rows, transform_->d_out, transformed);
+}
+
+Status
+IndexNodePreTransformWrapper::Build(const DataSet& dataset, const Config& cfg) {
+    RETURN_IF_ERROR(TrainTransform(dataset, cfg));
+    if (transform_ == nullptr) {
+        return index_node_->Build(dataset, cfg);
+    }
+    // the rows are transformed once for the training and the adding
+    return index_node_->Build(*Transform(dataset), cfg);
+}
+
+Status
+IndexNodePreTransformWrapper::Train(const DataSet& dataset, const Config& cfg) {
+    RETURN_IF_ERROR(TrainTransform(dataset, cfg));
+    if (transform_ == nullptr) {
+        return index_node_->Train(dataset, cfg);
+    }
+    return index_node_->Train(*Transform(dataset), cfg);
+}
+
+Status
+IndexNodePreTransformWrapper::Add(const DataSet& dataset, const Config& cfg) {
+    if (transform_ == nullptr) {
+        return index_node_->Add(dataset, cfg);
+    }
+    return index_node_->Add(*Transform(dataset), cfg);
+}
+
+Status
+IndexNodePreTransformWrapper::Merge(const std::vector<const IndexNode*>& others, const Config& cfg) {
+    std::vector<const IndexNode*> nodes;
+    for (auto other : others) {
+        auto wrapper = dynamic_cast<const IndexNodePreTransformWrapper*>(other);
+        if (!SameTransform(transform_.get(), wrapper != nullptr ? wrapper->transform_.get() : nullptr)) {
+            LOG_KNOWHERE_ERROR_ << "can not merge indexes of different pre-transforms";
+            return Status::invalid_args;
+        }
+        nodes.push_back(wrapper != nullptr ? wrapper->index_node_.get() : other);
+    }
+    return index_node_->Merge(nodes, cfg);
+}
+
+expected<DataSetPtr>
+IndexNodePreTransformWrapper::Search(const DataSet& dataset, const Config& cfg, const BitsetView& bitset) const {
+    if (transform_ == nullptr) {
+        return index_node_->Search(dataset, cfg, bitset);
+    }
+    return index_node_->Search(*Transform(dataset), cfg, bitset);
+}
+
+expected<DataSetPtr>
+IndexNodePreTransformWrapper::RangeSearch(const DataSet& dataset, const Config& cfg, const BitsetView& bitset) const {
+    if (transform_ == nullptr) {
+        return index_node_->RangeSearch(dataset, cfg, bitset);
+    }
+    return index_node_->RangeSearch(*Transform(dataset), cfg, bitset);
+}
+
+// the transformed queries live until the search completes
+folly::Future<expected<DataSetPtr>>
+IndexNodePreTransformWrapper::SearchAsync(const DataSet& dataset, const Config& cfg, const BitsetView& bitset) const {
+    if (transform_ == nullptr) {
+        return index_node_->SearchAsync(dataset, cfg, bitset);
+    }
+    auto query = Transform(dataset);
+    return index_node_->SearchAsync(*query, cfg, bitset).thenValue([query](expected<DataSetPtr>&& res) {
+        return std::move(res);
+    });
+}
+
+folly::Future<expected<DataSetPtr>>
+IndexNodePreTransformWrapper::RangeSearchAsync(const DataSet& dataset, const Config& cfg,
+                                               const BitsetView& bitset) const {
+    if (transform_ == nullptr) {
+        return index_node_->RangeSearchAsync(dataset, cfg, bitset);
+    }
+    auto query = Transform(dataset);
+    return index_node_->RangeSearchAsync(*query, cfg, bitset).thenValue([query](expected<DataSetPtr>&& res) {
+        return std::move(res);
+    });
+}
+
+expected<std::vector<IndexIteratorPtr>>
+IndexNodePreTransformWrapper::AnnIterator(const DataSet& dataset, const Config& cfg, const BitsetView& bitset) const {
+    if (transform_ == nullptr) {
+        return index_node_->AnnIterator(dataset, cfg, bitset);
+    }
+    return expected<std::vector<IndexIteratorPtr>>::Err(Status::not_implemented,
+                                                         "no iterator for a pre-transformed " + Type());
+}
+
+expected<DataSetPtr>
+IndexNodePreTransformWrapper::GetVectorByIds(const DataSet& dataset) const {
+    if (transform_ == nullptr) {
+        return index_node_->GetVectorByIds(dataset);
+    }
+    if (transform_->d_in != transform_->d_out) {
+        return expected<DataSetPtr>::Err(Status::not_implemented,
+                                         "the vectors of a pre-transform to another dim are not kept");
+    }
+    auto res = index_node_->GetVectorByIds(dataset);
+    if (!res.has_value()) {
+        return res;
+    }
+    auto rows = res.value()->GetRows();
+    auto vectors = new float[rows * transform_->d_in];
+    try {
+        transform_->reverse_transform(rows, static_cast<const float*>(res.value()->GetTensor()), vectors);
+    } catch (const std::exception& e) {
+        delete[] vectors;
+        LOG_KNOWHERE_WARNING_ << "faiss inner error: " << e.what();
+        return expected<DataSetPtr>::Err(Status::faiss_inner_error, e.what());
+    }
+    return GenResultDataSet(rows, transform_->d_in, vectors);
+}
+
+Status
+IndexNodePreTransformWrapper::Serialize(BinarySet& binset) const {
+    RETURN_IF_ERROR(index_node_->Serialize(binset));
+    if (transform_ == nullptr) {
+        return Status::success;
+    }
+    try {
+        auto [data, size] =
+            SerializeToMemory([&](MemoryIOWriter& writer) { faiss::write_VectorTransform(transform_.get(), &writer); });
+        binset.Append(kPreTransformBinary, data, size);
+    } catch (const std::exception& e) {
+        LOG_KNOWHERE_WARNING_ << "faiss inner error: " << e.what();
+        return Status::faiss_inner_error;
+    }
+    return Status::success;
+}
+
+// the sections of the inner node are streamed, the transform, small, is written after them from memory
+Status
+IndexNodePreTransformWrapper::SerializeToFile(SectionWriter& writer) const {
+    RETURN_IF_ERROR(index_node_->SerializeToFile(writer));
+    if (transform_ == nullptr) {
+        return Status::success;
+    }
+    try {
+        auto [data, size] =
+            SerializeToMemory([&](MemoryIOWriter& memory) { faiss::write_VectorTransform(transform_.get(), &memory); });
+        RETURN_IF_ERROR(writer.Begin(kPreTransformBinary));
+        RETURN_IF_ERROR(writer.Write(data.get(), size));
+        return writer.End();
+    } catch (const std::exception& e) {
+        LOG_KNOWHERE_WARNING_ << "faiss inner error: " << e.what();
+        return Status::faiss_inner_error;
+    }
+}
+
+Status
+IndexNodePreTransformWrapper::Deserialize(const BinarySet& binset, const Config& config) {
+    transform_ = nullptr;
+    auto binary = binset.GetByName(kPreTransformBinary);
+    if (binary != nullptr) {
+        MemoryIOReader reader;
+        reader.total = binary->size;
+        reader.data_ = binary->data.get();
+        try {
+            transform_.reset(faiss::read_VectorTransform(&reader));
+        } catch (const std::exception& e) {
+            LOG_KNOWHERE_WARNING_ << "faiss inner error: " << e.what();
+            return Status::faiss_inner_error;
+        }
+    }
+    return index_node_->Deserialize(binset, config);
+}
+
+// a file of the format of the index itself holds the index alone, a pre-transformed index is a knowhere index file
+Status
+IndexNodePreTransformWrapper::DeserializeFromFile(const std::string& filename, const Config& config) {
+    transform_ = nullptr;
+    return index_node_->DeserializeFromFile(filename, config);
+}
+
+int64_t
+IndexNodePreTransformWrapper::Dim() const {
+    return transform_ != nullptr ? transform_->d_in : index_node_->Dim();
+}
+
+int64_t
+IndexNodePreTransformWrapper::Size() const {
+    return index_node_->Size() + TransformBytes(transform_.get());
+}
+
+MemoryUsage
+IndexNodePreTransformWrapper::GetMemoryUsage() const {
+    auto usage = index_node_->GetMemoryUsage();
+    usage.Add(MemoryUsage::kCodebooks, MemoryUsage::kHeap, TransformBytes(transform_.get()));
+    return usage;
+}
+
+}  // namespace knowhere
@@ -0,0 +1,516 @@
+// Copyright (C) 2019-2023 Zilliz. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file except in compliance
+// with the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
+// or implied. See the License for the specific language governing permissions and limitations under the License.
+
+#include "knowhere/index_node_refine_wrapper.h"
+
+#include <strings.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <numeric>
+
+#include "common/knn_util.h"
+#include "common/range_util.h"
+#include "knowhere/comp/index_param.h"
+#include "knowhere/comp/thread_pool.h"
+#include "knowhere/log.h"
+#include "knowhere/utils.h"
+#include "simd/hook.h"
+
+namespace knowhere {
+
+namespace {
+
+constexpr const char* kRerankStoreBinary = "rerank_store";
+
+// ahead of the rows of the rerank_store binary
+struct StoreHeader {
+    int64_t type;
+    int64_t dim;
+    int64_t rows;
+};
+
+// the rows are gathered by 32 bit ids, see fvec_L2sqr_batch_indexed
+constexpr int64_t kMaxStoreRows = std::numeric_limits<uint32_t>::max();
+
+}  // namespace
+
+IndexNodeRefineWrapper::IndexNodeRefineWrapper(std::unique_ptr<IndexNode> index_node)
+    : index_node_(std::move(index_node)), search_pool_(ThreadPool::GetGlobalSearchThreadPool()) {
+}
+
+IndexNodeRefineWrapper::~IndexNodeRefineWrapper() = default;
+
+void
+IndexNodeRefineWrapper::ClearStore() {
+    store_type_ = StoreType::kNone;
+    store_dim_ = 0;
+    store_rows_ = 0;
+    store_ = nullptr;
+}
+
+Status
+IndexNodeRefineWrapper::ResetStore(const DataSet& dataset, const Config& cfg) {
+    const auto& base_cfg = static_cast<const BaseConfig&>(cfg);
+    auto& type = base_cfg.rerank_store.value();
+    ClearStore();
+    if (!strcasecmp(type.c_str(), "NONE")) {
+        return Status::success;
+    }
+    if (dataset.IsSparse()) {
+        LOG_KNOWHERE_ERROR_ << "rerank_store " << type << " of sparse rows";
+        return Status::invalid_args;
+    }
+    if (!strcasecmp(type.c_str(), "FP32")) {
+        store_type_ = StoreType::kFp32;
+    } else if (!strcasecmp(type.c_str(), "FP16")) {
+        store_type_ = StoreType::kFp16;
+    } else {
+        LOG_KNOWHERE_ERROR_ << "invalid rerank_store " << type;
+        return Status::invalid_args;
+    }
+    store_dim_ = dataset.GetDim();
+    store_ = RawVectorStore::Copy(nullptr, 0, store_dim_, RowSize());
+    return Status::success;
+}
+
+size_t
+IndexNodeRefineWrapper::RowSize() const {
+    return store_dim_ * (store_type_ == StoreType::kFp16 ? sizeof(uint16_t) : sizeof(float));
+}
+
+const uint8_t*
+IndexNodeRefineWrapper::StoreData() const {
+    return store_->Data();
+}
+
+uint8_t*
+IndexNodeRefineWrapper::GrowStore(int64_t n) {
+    auto rows = RawVectorStore::Grow(store_, n);
+    store_rows_ += n;
+    return rows;
+}
+
+Status
+IndexNodeRefineWrapper::CheckRows(const DataSet& dataset) const {
+    if (dataset.GetDim() != store_dim_) {
+        LOG_KNOWHERE_ERROR_ << "dim(" << dataset.GetDim() << ") of the rows differs from the one of the rerank store("
+                            << store_dim_ << ")";
+        return Status::invalid_args;
+    }
+    if (store_rows_ + dataset.GetRows() > kMaxStoreRows) {
+        LOG_KNOWHERE_ERROR_ << "the rerank store holds at most " << kMaxStoreRows << " rows";
+        return Status::invalid_args;
+    }
+    return Status::success;
+}
+
+void
+IndexNodeRefineWrapper::AppendRows(const DataSet& dataset) {
+    auto rows = dataset.GetRows();
+    auto vectors = static_cast<const float*>(dataset.GetTensor());
+    auto store = GrowStore(rows);
+    if (store_type_ == StoreType::kFp32) {
+        std::memcpy(store, vectors, rows * RowSize());
+    } else {
+        faiss::fvec_to_fp16(reinterpret_cast<uint16_t*>(store), vectors, rows * store_dim_);
+    }
+}
+
+Status
+IndexNodeRefineWrapper::Build(const DataSet& dataset, const Config& cfg) {
+    RETURN_IF_ERROR(ResetStore(dataset, cfg));
+    if (store_type_ == StoreType::kNone) {
+        return index_node_->Build(dataset, cfg);
+    }
+    RETURN_IF_ERROR(CheckRows(dataset));
+    RETURN_IF_ERROR(index_node_->Build(dataset, cfg));
+    // the rows of a store of the caller are shared rather than copied
+    auto shared = dataset.GetRawVectorStore();
+    if (store_type_ == StoreType::kFp32 && shared != nullptr && shared->Data() == dataset.GetTensor() &&
+        shared->Rows() == dataset.GetRows() && shared->RowSize() == RowSize()) {
+        store_ = std::move(shared);
+        store_rows_ = store_->Rows();
+        return Status::success;
+    }
+    AppendRows(dataset);
+    return Status::success;
+}
+
+Status
+IndexNodeRefineWrapper::Train(const DataSet& dataset, const Config& cfg) {
+    RETURN_IF_ERROR(ResetStore(dataset, cfg));
+    return index_node_->Train(dataset, cfg);
+}
+
+Status
+IndexNodeRefineWrapper::Add(const DataSet& dataset, const Config& cfg) {
+    if (store_type_ == StoreType::kNone) {
+        return index_node_->Add(dataset, cfg);
+    }
+    RETURN_IF_ERROR(CheckRows(dataset));
+    RETURN_IF_ERROR(index_node_->Add(dataset, cfg));
+    AppendRows(dataset);
+    return Status::success;
+}
+
+Status
+IndexNodeRefineWrapper::Merge(const std::vector<const IndexNode*>& others, const Config& cfg) {
+    std::vector<const IndexNode*> nodes;
+    std::vector<const IndexNodeRefineWrapper*> wrappers;
+    int64_t rows = store_rows_;
+    for (auto other : others) {
+        auto wrapper = dynamic_cast<const IndexNodeRefineWrapper*>(other);
+        auto type = wrapper != nullptr ? wrapper->store_type_ : StoreType::kNone;
+        if (type != store_type_ || (type != StoreType::kNone && wrapper->store_dim_ != store_dim_)) {
+            LOG_KNOWHERE_ERROR_ << "can not merge indexes of different rerank stores";
+            return Status::invalid_args;
+        }
+        if (wrapper != nullptr) {
+            wrappers.push_back(wrapper);
+            rows += wrapper->store_rows_;
+        }
+        nodes.push_back(wrapper != nullptr ? wrapper->index_node_.get() : other);
+    }
+    if (rows > kMaxStoreRows) {
+        LOG_KNOWHERE_ERROR_ << "the rerank store holds at most " << kMaxStoreRows << " rows";
+        return Status::invalid_args;
+    }
+    RETURN_IF_ERROR(index_node_->Merge(nodes, cfg));
+    if (store_type_ == StoreType::kNone) {
+        return Status::success;
+    }
+    for (auto wrapper : wrappers) {
+        std::memcpy(GrowStore(wrapper->store_rows_), wrapper->StoreData(), wrapper->store_rows_ * RowSize());
+    }
+    return Status::success;
+}
+
+// With COSINE the query is normalized and the inner products are divided by the norms of the rows, the store keeps
+// the rows as they were added.
+void
+IndexNodeRefineWrapper::ComputeDistances(const float* query, const uint32_t* ids, size_t n, bool is_ip,
+                                         bool is_cosine, float* distances) const {
+    auto base = reinterpret_cast<const char*>(StoreData());
+    auto row_size = RowSize();
+    if (store_type_ == StoreType::kFp32) {
+        if (is_ip) {
+            faiss::fvec_inner_product_batch_indexed(distances, query, base, ids, n, store_dim_, row_size);
+        } else {
+            faiss::fvec_L2sqr_batch_indexed(distances, query, base, ids, n, store_dim_, row_size);
+        }
+        if (is_cosine) {
+            for (size_t i = 0; i < n; ++i) {
+                auto row = reinterpret_cast<const float*>(base + ids[i] * row_size);
+                auto norm = faiss::fvec_norm_L2sqr(row, store_dim_);
+                distances[i] = norm > 0 ? distances[i] / std::sqrt(norm) : 0;
+            }
+        }
+        return;
+    }
+    std::vector<float> row(is_cosine ? store_dim_ : 0);
+    for (size_t i = 0; i < n; ++i) {
+        auto code = reinterpret_cast<const uint16_t*>(base + ids[i] * row_size);
+        if (i + 1 < n) {
+            __builtin_prefetch(base + ids[i + 1] * row_size);
+        }
+        if (is_cosine) {
+            faiss::fp16_to_fvec(row.data(), code, store_dim_);
+            auto norm = faiss::fvec_norm_L2sqr(row.data(), store_dim_);
+            distances[i] = norm > 0 ? faiss::fvec_inner_product(query, row.data(), store_dim_) / std::sqrt(norm) : 0;
+        } else if (is_ip) {
+            distances[i] = faiss::fp16vec_inner_product(query, code, store_dim_);
+        } else {
+            distances[i] = faiss::fp16vec_L2sqr(query, code, store_dim_);
+        }
+    }
+}
+
+expected<DataSetPtr>
+IndexNodeRefineWrapper::Search(const DataSet& dataset, const Config& cfg, const BitsetView& bitset) const {
+    if (store_type_ == StoreType::kNone) {
+        return index_node_->Search(dataset, cfg, bitset);
+    }
+    const auto& base_cfg = static_cast<const BaseConfig&>(cfg);
+    auto nq = dataset.GetRows();
+    auto dim = dataset.GetDim();
+    auto xq = static_cast<const float*>(dataset.GetTensor());
+    int64_t k = base_cfg.k.value();
+    auto candidate_k = std::max<int64_t>(
+        k, std::min<int64_t>(std::ceil(k * base_cfg.rerank_ratio.value()), std::numeric_limits<int32_t>::max()));
+    bool is_cosine = IsMetricType(base_cfg.metric_type.value(), metric::COSINE);
+    bool is_ip = is_cosine || IsMetricType(base_cfg.metric_type.value(), metric::IP);
+
+    // the candidates go into arrays of the index rather than into the buffers of the caller
+    auto inner_cfg = CopyConfig(*index_node_, cfg);
+    inner_cfg->k = static_cast<int32_t>(candidate_k);
+    auto candidates = index_node_->Search(dataset, *inner_cfg, bitset);
+    if (!candidates.has_value()) {
+        return candidates;
+    }
+    auto candidate_ids = candidates.value()->GetIds();
+
+    KnnResultBuffers buffers(base_cfg, nq * k);
+    try {
+        search_pool_->parallel_for(0, nq, 1, [&](int64_t i) {
+            auto query = xq + i * dim;
+            std::unique_ptr<float[]> copied_query = nullptr;
+            if (is_cosine) {
+                copied_query = CopyAndNormalizeFloatVec(query, dim);
+                query = copied_query.get();
+            }
+            // in the order of the ids, the rows of the store are read front to back
+            std::vector<uint32_t> ids;
+            ids.reserve(candidate_k);
+            for (int64_t j = 0; j < candidate_k; ++j) {
+                auto id = candidate_ids[i * candidate_k + j];
+                if (id >= 0 && id < store_rows_) {
+                    ids.push_back(static_cast<uint32_t>(id));
+                }
+            }
+            std::sort(ids.begin(), ids.end());
+            std::vector<float> distances(ids.size());
+            ComputeDistances(query, ids.data(), ids.size(), is_ip, is_cosine, distances.data());
+
+            std::vector<size_t> order(ids.size());
+            std::iota(order.begin(), order.end(), 0);
+            auto top = std::min<size_t>(k, order.size());
+            std::partial_sort(order.begin(), order.begin() + top, order.end(), [&](size_t a, size_t b) {
+                return is_ip ? distances[a] > distances[b] : distances[a] < distances[b];
+            });
+            auto res_ids = buffers.ids + i * k;
+            auto res_distances = buffers.distances + i * k;
+            for (size_t j = 0; j < top; ++j) {
+                res_ids[j] = ids[order[j]];
+                res_distances[j] = distances[order[j]];
+            }
+            std::fill(res_ids + top, res_ids + k, -1);
+            std::fill(res_distances + top, res_distances + k,
+                      is_ip ? -std::numeric_limits<float>::infinity() : std::numeric_limits<float>::infinity());
+        });
+    } catch (const std::exception& e) {
+        buffers.Free();
+        LOG_KNOWHERE_WARNING_ << "rerank error: " << e.what();
+        return expected<DataSetPtr>::Err(Status::faiss_inner_error, e.what());
+    }
+    auto res = buffers.ToDataSet(nq, k);
+    res->SetPartialQueries(candidates.value()->GetPartialQueries());
+    return res;
+}
+
+// The index finds every hit in range by its approximate distances, max_results cuts them by the exact ones.
+expected<DataSetPtr>
+IndexNodeRefineWrapper::RangeSearch(const DataSet& dataset, const Config& cfg, const BitsetView& bitset) const {
+    if (store_type_ == StoreType::kNone) {
+        return index_node_->RangeSearch(dataset, cfg, bitset);
+    }
+    const auto& base_cfg = static_cast<const BaseConfig&>(cfg);
+    auto nq = dataset.GetRows();
+    auto dim = dataset.GetDim();
+    auto xq = static_cast<const float*>(dataset.GetTensor());
+    float radius = base_cfg.radius.value();
+    float range_filter = base_cfg.range_filter.value();
+    bool filter = range_filter != defaultRangeFilter;
+    bool is_cosine = IsMetricType(base_cfg.metric_type.value(), metric::COSINE);
+    bool is_ip = is_cosine || IsMetricType(base_cfg.metric_type.value(), metric::IP);
+
+    auto inner_cfg = CopyConfig(*index_node_, cfg);
+    inner_cfg->max_results = 0;
+    auto candidates = index_node_->RangeSearch(dataset, *inner_cfg, bitset);
+    if (!candidates.has_value()) {
+        return candidates;
+    }
+    auto candidate_ids = candidates.value()->GetIds();
+    auto candidate_lims = candidates.value()->GetLims();
+
+    int64_t* ids = nullptr;
+    float* distances = nullptr;
+    size_t* lims = nullptr;
+    bool owned = true;
+    RangeSearchResultBuilder results(nq, base_cfg.max_results.value(), is_ip);
+    try {
+        search_pool_->parallel_for(0, nq, 1, [&](int64_t i) {
+            auto query = xq + i * dim;
+            std::unique_ptr<float[]> copied_query = nullptr;
+            if (is_cosine) {
+                copied_query = CopyAndNormalizeFloatVec(query, dim);
+                query = copied_query.get();
+            }
+            std::vector<uint32_t> hits;
+            for (auto j = candidate_lims[i]; j < candidate_lims[i + 1]; ++j) {
+                if (candidate_ids[j] >= 0 && candidate_ids[j] < store_rows_) {
+                    hits.push_back(static_cast<uint32_t>(candidate_ids[j]));
+                }
+            }
+            std::sort(hits.begin(), hits.end());
+            std::vector<float> hit_distances(hits.size());
+            ComputeDistances(query, hits.data(), hits.size(), is_ip, is_cosine, hit_distances.data());
+            auto writer = results.Query(i);
+            for (size_t j = 0; j < hits.size(); ++j) {
+                auto d = hit_distances[j];
+                bool in_range = filter ? distance_in_range(d, radius, range_filter, is_ip)
+                                       : (is_ip ? d > radius : d < radius);
+                if (in_range) {
+                    writer.Add(d, hits[j]);
+                }
+            }
+        });
+        owned = results.Build(base_cfg, distances, ids, lims);
+    } catch (const std::exception& e) {
+        LOG_KNOWHERE_WARNING_ << "rerank error: " << e.what();
+        return expected<DataSetPtr>::Err(Status::faiss_inner_error, e.what());
+    }
+    auto res = GenResultDataSet(nq, ids, distances, lims);
+    res->SetIsOwner(owned);
+    res->SetPartialQueries(candidates.value()->GetPartialQueries());
+    return res;
+}
+
+expected<DataSetPtr>
+IndexNodeRefineWrapper::GetVectorByIds(const DataSet& dataset) const {
+    if (store_type_ != StoreType::kFp32) {
+        return index_node_->GetVectorByIds(dataset);
+    }
+    auto rows = dataset.GetRows();
+    auto ids = dataset.GetIds();
+    // consecutive rows are a view of the store, which the result keeps alive
+    bool consecutive = rows > 0 && ids[0] >= 0 && ids[0] + rows <= store_rows_;
+    for (int64_t i = 1; i < rows && consecutive; ++i) {
+        consecutive = ids[i] == ids[0] + i;
+    }
+    if (consecutive) {
+        return GenDataSet(store_, ids[0], rows);
+    }
+    auto vectors = std::make_unique<float[]>(rows * store_dim_);
+    for (int64_t i = 0; i < rows; ++i) {
+        if (ids[i] < 0 || ids[i] >= store_rows_) {
+            return expected<DataSetPtr>::Err(Status::invalid_args, "id " + std::to_string(ids[i]) + " out of range");
+        }
+        std::memcpy(vectors.get() + i * store_dim_, StoreData() + ids[i] * RowSize(), RowSize());
+    }
+    return GenResultDataSet(rows, store_dim_, vectors.release());
+}
+
+bool
+IndexNodeRefineWrapper::HasRawData(const std::string& metric_type) const {
+    return store_type_ == StoreType::kFp32 || index_node_->HasRawData(metric_type);
+}
+
+Status
+IndexNodeRefineWrapper::Serialize(BinarySet& binset) const {
+    RETURN_IF_ERROR(index_node_->Serialize(binset));
+    if (store_type_ == StoreType::kNone) {
+        return Status::success;
+    }
+    StoreHeader header{static_cast<int64_t>(store_type_), store_dim_, store_rows_};
+    auto bytes = store_rows_ * RowSize();
+    std::shared_ptr<uint8_t[]> data(new uint8_t[sizeof(header) + bytes]);
+    std::memcpy(data.get(), &header, sizeof(header));
+    std::memcpy(data.get() + sizeof(header), StoreData(), bytes);
+    binset.Append(kRerankStoreBinary, data, sizeof(header) + bytes);
+    return Status::success;
+}
+
+// the sections of the inner node are streamed, then the store, without the copy Serialize makes of it
+Status
+IndexNodeRefineWrapper::SerializeToFile(SectionWriter& writer) const {
+    RETURN_IF_ERROR(index_node_->SerializeToFile(writer));
+    if (store_type_ == StoreType::kNone) {
+        return Status::success;
+    }
+    StoreHeader header{static_cast<int64_t>(store_type_), store_dim_, store_rows_};
+    RETURN_IF_ERROR(writer.Begin(kRerankStoreBinary));
+    RETURN_IF_ERROR(writer.Write(&header, sizeof(header)));
+    RETURN_IF_ERROR(writer.Write(StoreData(), store_rows_ * RowSize()));
+    return writer.End();
+}
+
+// The binset of a knowhere index file is its mapping, see DeserializeIndexFile: with enable_mmap the store is read in
+// place, else it is copied.
+Status
+IndexNodeRefineWrapper::Deserialize(const BinarySet& binset, const Config& config) {
+    ClearStore();
+    auto binary = binset.GetByName(kRerankStoreBinary);
+    if (binary != nullptr) {
+        StoreHeader header;
+        if (binary->size < static_cast<int64_t>(sizeof(header))) {
+            LOG_KNOWHERE_ERROR_ << "truncated rerank store";
+            return Status::invalid_binary_set;
+        }
+        std::memcpy(&header, binary->data.get(), sizeof(header));
+        auto type = static_cast<StoreType>(header.type);
+        if (type != StoreType::kFp32 && type != StoreType::kFp16) {
+            LOG_KNOWHERE_ERROR_ << "invalid rerank store type " << header.type;
+            return Status::invalid_binary_set;
+        }
+        store_type_ = type;
+        store_dim_ = header.dim;
+        if (header.rows < 0 || header.rows > kMaxStoreRows ||
+            binary->size != static_cast<int64_t>(sizeof(header) + header.rows * RowSize())) {
+            store_type_ = StoreType::kNone;
+            store_dim_ = 0;
+            LOG_KNOWHERE_ERROR_ << "rerank store of " << binary->size << " bytes does not hold " << header.rows
+                                << " rows";
+            return Status::invalid_binary_set;
+        }
+        store_rows_ = header.rows;
+        const auto& base_cfg = static_cast<const BaseConfig&>(config);
+        auto rows = binary->data.get() + sizeof(header);
+        if (base_cfg.enable_mmap.value_or(false)) {
+            store_ = RawVectorStore::View(rows, store_rows_, store_dim_, RowSize(), binary, true);
+        } else {
+            store_ = RawVectorStore::Copy(rows, store_rows_, store_dim_, RowSize());
+        }
+    }
+    return index_node_->Deserialize(binset, config);
+}
+
+// a file of the format of the index itself holds the index alone, a reranked index is a knowhere index file
+Status
+IndexNodeRefineWrapper::DeserializeFromFile(const std::string& filename, const Config& config) {
+    ClearStore();
+    return index_node_->DeserializeFromFile(filename, config);
+}
+
+void
+IndexNodeRefineWrapper::SetSearchPool(std::shared_ptr<ThreadPool> pool) {
+    search_pool_ = pool;
+    index_node_->SetSearchPool(std::move(pool));
+}
+
+// a store shared with the caller is memory of the caller
+int64_t
+IndexNodeRefineWrapper::Size() const {
+    return index_node_->Size() + (store_ != nullptr ? store_->HeapBytes() : 0);
+}
+
+MemoryUsage
+IndexNodeRefineWrapper::GetMemoryUsage() const {
+    auto usage = index_node_->GetMemoryUsage();
+    if (store_ != nullptr && store_->Mapped()) {
+        usage.Add(MemoryUsage::kVectors, MemoryUsage::kMmap, store_rows_ * RowSize());
+    } else if (store_ != nullptr) {
+        usage.Add(MemoryUsage::kVectors, MemoryUsage::kHeap, store_->HeapBytes());
+    }
+    return usage;
+}
+
+void
+IndexNodeRefineWrapper::MappedRegions(std::vector<MappedRegion>& regions) const {
+    index_node_->MappedRegions(regions);
+    if (store_ != nullptr && store_->Mapped()) {
+        regions.push_back({store_->Data(), static_cast<size_t>(store_rows_ * RowSize())});
+    }
+}
+
+}  // namespace knowhere
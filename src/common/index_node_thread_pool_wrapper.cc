@@ -11,8 +11,10 @@
 
 #include "knowhere/index_node_thread_pool_wrapper.h"
 
+#include "knowhere/comp/task_scheduler.h"
 #include "knowhere/comp/thread_pool.h"
 #include "knowhere/index_node.h"
+#include "knowhere/log.h"
 
 namespace knowhere {
 
@@ -20,29 +22,98 @@ namespace {
 
 std::shared_ptr<ThreadPool>
 GlobalThreadPool(size_t pool_size) {
-    static std::shared_ptr<ThreadPool> pool = std::make_shared<ThreadPool>(pool_size);
+    static std::shared_ptr<ThreadPool> pool =
+        std::make_shared<ThreadPool>(pool_size, ExecutorType::SHARED_QUEUE, -1, "gpu_search");
     return pool;
 }
 
 }  // namespace
 
-IndexNodeThreadPoolWrapper::IndexNodeThreadPoolWrapper(std::unique_ptr<IndexNode> index_node, size_t pool_size)
-    : IndexNodeThreadPoolWrapper(std::move(index_node), GlobalThreadPool(pool_size)) {
+IndexNodeThreadPoolWrapper::IndexNodeThreadPoolWrapper(std::unique_ptr<IndexNode> index_node, size_t pool_size,
+                                                       TaskClass task_class)
+    : IndexNodeThreadPoolWrapper(std::move(index_node), GlobalThreadPool(pool_size), task_class) {
 }
 
 IndexNodeThreadPoolWrapper::IndexNodeThreadPoolWrapper(std::unique_ptr<IndexNode> index_node,
-                                                       std::shared_ptr<ThreadPool> thread_pool)
-    : index_node_(std::move(index_node)), thread_pool_(thread_pool) {
+                                                       std::shared_ptr<ThreadPool> thread_pool, TaskClass task_class)
+    : index_node_(std::move(index_node)), thread_pool_(thread_pool), task_class_(task_class) {
+}
+
+Status
+IndexNodeThreadPoolWrapper::Train(const DataSet& dataset, const Config& cfg) {
+    try {
+        return ThreadPool::GetGlobalTaskScheduler()->Run(TaskClass::BUILD,
+                                                         [&]() { return this->index_node_->Train(dataset, cfg); });
+    } catch (const TaskRejected& e) {
+        LOG_KNOWHERE_WARNING_ << "train rejected: " << e.what();
+        return Status::too_many_requests;
+    }
+}
+
+Status
+IndexNodeThreadPoolWrapper::Add(const DataSet& dataset, const Config& cfg) {
+    try {
+        return ThreadPool::GetGlobalTaskScheduler()->Run(TaskClass::BUILD,
+                                                         [&]() { return this->index_node_->Add(dataset, cfg); });
+    } catch (const TaskRejected& e) {
+        LOG_KNOWHERE_WARNING_ << "add rejected: " << e.what();
+        return Status::too_many_requests;
+    }
+}
+
+Status
+IndexNodeThreadPoolWrapper::Merge(const std::vector<const IndexNode*>& others, const Config& cfg) {
+    std::vector<const IndexNode*> nodes;
+    for (auto other : others) {
+        auto wrapper = dynamic_cast<const IndexNodeThreadPoolWrapper*>(other);
+        nodes.push_back(wrapper != nullptr ? wrapper->index_node_.get() : other);
+    }
+    try {
+        return ThreadPool::GetGlobalTaskScheduler()->Run(TaskClass::BUILD,
+                                                         [&]() { return this->index_node_->Merge(nodes, cfg); });
+    } catch (const TaskRejected& e) {
+        LOG_KNOWHERE_WARNING_ << "merge rejected: " << e.what();
+        return Status::too_many_requests;
+    }
 }
 
 expected<DataSetPtr>
 IndexNodeThreadPoolWrapper::Search(const DataSet& dataset, const Config& cfg, const BitsetView& bitset) const {
-    return thread_pool_->push([&]() { return this->index_node_->Search(dataset, cfg, bitset); }).get();
+    return SearchAsync(dataset, cfg, bitset).get();
 }
 
 expected<DataSetPtr>
 IndexNodeThreadPoolWrapper::RangeSearch(const DataSet& dataset, const Config& cfg, const BitsetView& bitset) const {
-    return thread_pool_->push([&]() { return this->index_node_->RangeSearch(dataset, cfg, bitset); }).get();
+    return RangeSearchAsync(dataset, cfg, bitset).get();
+}
+
+folly::Future<expected<DataSetPtr>>
+IndexNodeThreadPoolWrapper::SearchAsync(const DataSet& dataset, const Config& cfg, const BitsetView& bitset) const {
+    return ThreadPool::GetGlobalTaskScheduler()
+        ->Submit(task_class_, thread_pool_,
+                 [this, &dataset, &cfg, bitset]() {
+                     // the search runs on a thread of the pool, the budget of the caller does not follow it there
+                     ThreadPool::ScopedParallelism parallelism(static_cast<const BaseConfig&>(cfg).max_threads.value());
+                     return this->index_node_->Search(dataset, cfg, bitset);
+                 })
+        .thenError(folly::tag_t<TaskRejected>{}, [](const TaskRejected& e) {
+            return expected<DataSetPtr>::Err(Status::too_many_requests, e.what());
+        });
+}
+
+folly::Future<expected<DataSetPtr>>
+IndexNodeThreadPoolWrapper::RangeSearchAsync(const DataSet& dataset, const Config& cfg,
+                                             const BitsetView& bitset) const {
+    return ThreadPool::GetGlobalTaskScheduler()
+        ->Submit(task_class_, thread_pool_,
+                 [this, &dataset, &cfg, bitset]() {
+                     // the search runs on a thread of the pool, the budget of the caller does not follow it there
+                     ThreadPool::ScopedParallelism parallelism(static_cast<const BaseConfig&>(cfg).max_threads.value());
+                     return this->index_node_->RangeSearch(dataset, cfg, bitset);
+                 })
+        .thenError(folly::tag_t<TaskRejected>{}, [](const TaskRejected& e) {
+            return expected<DataSetPtr>::Err(Status::too_many_requests, e.what());
+        });
 }
 
 }  // namespace knowhere
@@ -0,0 +1,133 @@
+// Copyright (C) 2019-2023 Zilliz. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file except in compliance
+// with the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
+// or implied. See the License for the specific language governing permissions and limitations under the License.
+
+#include "common/knn_util.h"
+
+#include <strings.h>
+
+#include <algorithm>
+#include <limits>
+#include <memory>
+#include <vector>
+
+#include "faiss/IndexNNDescent.h"
+#include "faiss/utils/Heap.h"
+#include "faiss/utils/distances.h"
+#include "knowhere/comp/index_param.h"
+#include "knowhere/comp/thread_pool.h"
+#include "knowhere/log.h"
+#include "knowhere/utils.h"
+
+namespace knowhere {
+
+void
+KnnBatchSearch(const float* xb, int64_t nb, const float* xq, int64_t nq, int64_t dim, int64_t k,
+               faiss::MetricType metric, bool is_cosine, float* distances, int64_t* labels, const BitsetView& bitset,
+               const float* base_norms) {
+    // the base norms are computed once rather than by every slice
+    std::unique_ptr<float[]> computed_norms = nullptr;
+    if (metric == faiss::METRIC_L2) {
+        computed_norms = std::make_unique<float[]>(nb);
+        faiss::fvec_norms_L2sqr(computed_norms.get(), xb, dim, nb);
+        base_norms = computed_norms.get();
+    } else if (is_cosine && base_norms == nullptr) {
+        computed_norms = std::make_unique<float[]>(nb);
+        faiss::fvec_norms_L2(computed_norms.get(), xb, dim, nb);
+        base_norms = computed_norms.get();
+    }
+
+    auto pool = ThreadPool::GetGlobalSearchThreadPool();
+    int64_t threads = std::max<int64_t>(1, pool->size());
+    int64_t slice = std::max<int64_t>(kKnnBatchMinQueries, (nq + threads - 1) / threads);
+    std::vector<folly::Future<folly::Unit>> futs;
+    futs.reserve((nq + slice - 1) / slice);
+    for (int64_t begin = 0; begin < nq; begin += slice) {
+        futs.emplace_back(pool->push([&, begin, end = std::min(nq, begin + slice)] {
+            ThreadPool::ScopedOmpSetter setter(1);
+            auto rows = static_cast<size_t>(end - begin);
+            auto cur_query = xq + begin * dim;
+            auto cur_labels = labels + begin * k;
+            auto cur_distances = distances + begin * k;
+            if (metric == faiss::METRIC_L2) {
+                faiss::float_maxheap_array_t buf{rows, (size_t)k, cur_labels, cur_distances};
+                faiss::knn_L2sqr_blas(cur_query, xb, dim, rows, nb, &buf, base_norms, bitset);
+            } else if (is_cosine) {
+                faiss::float_minheap_array_t buf{rows, (size_t)k, cur_labels, cur_distances};
+                faiss::knn_cosine_blas(cur_query, xb, dim, rows, nb, &buf, base_norms, bitset);
+            } else {
+                faiss::float_minheap_array_t buf{rows, (size_t)k, cur_labels, cur_distances};
+                faiss::knn_inner_product_blas(cur_query, xb, dim, rows, nb, &buf, bitset);
+            }
+        }));
+    }
+    for (auto& fut : futs) {
+        fut.wait();
+    }
+    for (auto& fut : futs) {
+        fut.result().value();
+    }
+}
+
+bool
+IsValidKnnGraph(const std::string& source) {
+    return !strcasecmp(source.c_str(), kKnnGraphNone) || !strcasecmp(source.c_str(), kKnnGraphNNDescent) ||
+           !strcasecmp(source.c_str(), kKnnGraphCagra);
+}
+
+expected<std::vector<uint32_t>>
+BuildKnnGraph(const float* data, int64_t rows, int64_t dim, int64_t k, const std::string& metric_type,
+              const std::string& source) {
+    using Result = expected<std::vector<uint32_t>>;
+    bool is_cosine = IsMetricType(metric_type, metric::COSINE);
+    bool is_ip = IsMetricType(metric_type, metric::IP);
+    if (!is_cosine && !is_ip && !IsMetricType(metric_type, metric::L2)) {
+        return Result::Err(Status::invalid_metric_type, "no kNN graph of metric " + metric_type);
+    }
+    if (!strcasecmp(source.c_str(), kKnnGraphCagra)) {
+#ifdef KNOWHERE_WITH_RAFT
+        if (is_ip) {
+            return Result::Err(Status::invalid_metric_type, "the CAGRA kNN graph is of L2 or COSINE");
+        }
+        return BuildCagraKnnGraph(data, rows, dim, k, is_cosine);
+#else
+        return Result::Err(Status::not_implemented, "the CAGRA kNN graph needs knowhere built with RAFT");
+#endif
+    }
+    if (strcasecmp(source.c_str(), kKnnGraphNNDescent)) {
+        return Result::Err(Status::invalid_args, "invalid kNN graph source " + source);
+    }
+    if (rows > std::numeric_limits<int>::max()) {
+        return Result::Err(Status::invalid_args, "NN-Descent over more than 2^31 rows");
+    }
+    // the pools of NN-Descent only fill up to k neighbors when the rows are many more than k
+    if (rows < 4 * (k + 50)) {
+        return std::vector<uint32_t>();
+    }
+    // cosine is the inner product of the normalized vectors
+    std::vector<float> normalized;
+    if (is_cosine) {
+        normalized.assign(data, data + rows * dim);
+        ParallelNormalizeVecs(normalized.data(), rows, dim);
+        data = normalized.data();
+    }
+    try {
+        ThreadPool::ScopedOmpSetter setter(ThreadPool::GetGlobalBuildThreadPool()->size());
+        faiss::IndexNNDescentFlat index(dim, k, is_ip || is_cosine ? faiss::METRIC_INNER_PRODUCT : faiss::METRIC_L2);
+        index.add(rows, data);
+        auto& final_graph = index.nndescent.final_graph;
+        return std::vector<uint32_t>(final_graph.begin(), final_graph.end());
+    } catch (const std::exception& e) {
+        LOG_KNOWHERE_WARNING_ << "faiss inner error: " << e.what();
+        return Result::Err(Status::faiss_inner_error, e.what());
+    }
+}
+
+}  // namespace knowhere
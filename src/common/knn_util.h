@@ -0,0 +1,100 @@
+// Copyright (C) 2019-2023 Zilliz. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file except in compliance
+// with the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
+// or implied. See the License for the specific language governing permissions and limitations under the License.
+
+#pragma once
+
+#include <faiss/MetricType.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "knowhere/bitsetview.h"
+#include "knowhere/config.h"
+#include "knowhere/dataset.h"
+#include "knowhere/expected.h"
+
+namespace knowhere {
+
+// Below this many queries every query is searched by its own task of the search pool, a matrix multiplication does
+// not pay off.
+constexpr int64_t kKnnBatchMinQueries = 32;
+
+// Searches nq float queries among the nb contiguous base rows, for L2 or IP, in slices of at least
+// kKnnBatchMinQueries queries, one task of the search pool per slice. Each slice goes through the blocked BLAS path
+// of faiss: the distances of a tile of queries to a tile of base rows come from one sgemm and are merged into the
+// heaps of the slice before the next tile. With is_cosine the inner products are divided by the query norms and the
+// base norms, base_norms when given, the queries are not copied. Throws what faiss throws.
+void
+KnnBatchSearch(const float* xb, int64_t nb, const float* xq, int64_t nq, int64_t dim, int64_t k,
+               faiss::MetricType metric, bool is_cosine, float* distances, int64_t* labels, const BitsetView& bitset,
+               const float* base_norms = nullptr);
+
+// The sources of the approximate kNN graph a graph index may be built from, NONE builds it by inserts.
+constexpr const char* kKnnGraphNone = "NONE";
+constexpr const char* kKnnGraphNNDescent = "NN_DESCENT";
+constexpr const char* kKnnGraphCagra = "CAGRA";
+
+bool
+IsValidKnnGraph(const std::string& source);
+
+// An approximate kNN graph of the rows float vectors, k neighbor ids a row, closest first, for a graph index to prune
+// into its own graph instead of searching the neighbors of every insert: NN_DESCENT runs the NN-Descent of faiss on
+// the threads of OpenMP, CAGRA builds the graph of CAGRA on the GPU, L2 and COSINE only. The graph is empty when there
+// are too few rows for NN-Descent to fill k neighbors, the index then builds by inserts.
+expected<std::vector<uint32_t>>
+BuildKnnGraph(const float* data, int64_t rows, int64_t dim, int64_t k, const std::string& metric_type,
+              const std::string& source);
+
+#ifdef KNOWHERE_WITH_RAFT
+// the graph of CAGRA of the rows, of k neighbors; in cagra.cu
+expected<std::vector<uint32_t>>
+BuildCagraKnnGraph(const float* data, int64_t rows, int64_t dim, int64_t k, bool is_cosine);
+#endif
+
+// The nq * k ids and distances a knn search writes: the buffers of the caller when the config carries them, else new
+// arrays the result dataset takes over.
+struct KnnResultBuffers {
+    int64_t* ids = nullptr;
+    float* distances = nullptr;
+    bool owned = true;
+
+    KnnResultBuffers(const BaseConfig& cfg, int64_t len) {
+        if (cfg.result_ids != nullptr && cfg.result_distances != nullptr) {
+            ids = cfg.result_ids;
+            distances = cfg.result_distances;
+            owned = false;
+        } else {
+            ids = new int64_t[len];
+            distances = new float[len];
+        }
+    }
+
+    // for the failing paths, frees the arrays it allocated
+    void
+    Free() {
+        if (owned) {
+            delete[] ids;
+            delete[] distances;
+        }
+        ids = nullptr;
+        distances = nullptr;
+    }
+
+    DataSetPtr
+    ToDataSet(int64_t nq, int64_t k) const {
+        auto res = GenResultDataSet(nq, k, ids, distances);
+        res->SetIsOwner(owned);
+        return res;
+    }
+};
+
+}  // namespace knowhere
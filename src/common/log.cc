@@ -10,8 +10,198 @@
 // or implied. See the License for the specific language governing permissions and limitations under the License.
 
 #include "knowhere/log.h"
+
+#include <thread>
+#include <utility>
+
 namespace knowhere {
 
+namespace {
+
+constexpr int64_t kDefaultLogRateLimit = 10;
+// the messages queued for the log thread, a power of 2
+constexpr size_t kLogQueueCapacity = 4096;
+constexpr auto kLogThreadIdle = std::chrono::milliseconds(1);
+
+std::atomic<int64_t> dropped_count{0};
+// false until the queue is up and again once it is gone, the messages of the static initializers and destructors
+// around it are written at once
+std::atomic<bool> log_queue_alive{false};
+
+struct LogEntry {
+    const char* file = nullptr;
+    int line = 0;
+    LogLevel level = LogLevel::kInfo;
+    std::string text;
+};
+
+void
+WriteLog(const LogEntry& entry) {
+    switch (entry.level) {
+        case LogLevel::kInfo:
+            google::LogMessage(entry.file, entry.line, google::GLOG_INFO).stream() << entry.text;
+            break;
+        case LogLevel::kWarning:
+            google::LogMessage(entry.file, entry.line, google::GLOG_WARNING).stream() << entry.text;
+            break;
+        default:
+            google::LogMessage(entry.file, entry.line, google::GLOG_ERROR).stream() << entry.text;
+            break;
+    }
+}
+
+// A bounded multi-producer queue of the messages, drained by the log thread; a slot is published by its sequence
+// number, so no producer ever waits for another or for the log thread.
+class LogQueue {
+ public:
+    static LogQueue&
+    Instance() {
+        static LogQueue queue;
+        return queue;
+    }
+
+    ~LogQueue() {
+        stop_.store(true, std::memory_order_release);
+        thread_.join();
+        log_queue_alive.store(false, std::memory_order_release);
+        while (Pop()) {
+        }
+    }
+
+    bool
+    Push(LogEntry&& entry) {
+        auto pos = head_.load(std::memory_order_relaxed);
+        while (true) {
+            auto& slot = slots_[pos & (kLogQueueCapacity - 1)];
+            auto seq = slot.seq.load(std::memory_order_acquire);
+            auto diff = static_cast<int64_t>(seq) - static_cast<int64_t>(pos);
+            if (diff == 0) {
+                if (head_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    slot.entry = std::move(entry);
+                    slot.seq.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = head_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    void
+    Flush() {
+        if (std::this_thread::get_id() == thread_.get_id()) {
+            return;
+        }
+        auto target = head_.load(std::memory_order_acquire);
+        while (written_.load(std::memory_order_acquire) < target) {
+            std::this_thread::sleep_for(kLogThreadIdle);
+        }
+    }
+
+ private:
+    struct Slot {
+        std::atomic<size_t> seq{0};
+        LogEntry entry;
+    };
+
+    LogQueue() : slots_(new Slot[kLogQueueCapacity]) {
+        for (size_t i = 0; i < kLogQueueCapacity; ++i) {
+            slots_[i].seq.store(i, std::memory_order_relaxed);
+        }
+        thread_ = std::thread([this] {
+            SetThreadName("knowhere_log");
+            while (!stop_.load(std::memory_order_acquire)) {
+                if (!Pop()) {
+                    std::this_thread::sleep_for(kLogThreadIdle);
+                }
+            }
+        });
+        log_queue_alive.store(true, std::memory_order_release);
+    }
+
+    // writes the next message, the log thread only
+    bool
+    Pop() {
+        auto pos = written_.load(std::memory_order_relaxed);
+        auto& slot = slots_[pos & (kLogQueueCapacity - 1)];
+        if (slot.seq.load(std::memory_order_acquire) != pos + 1) {
+            return false;
+        }
+        LogEntry entry = std::move(slot.entry);
+        slot.seq.store(pos + kLogQueueCapacity, std::memory_order_release);
+        WriteLog(entry);
+        written_.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    std::unique_ptr<Slot[]> slots_;
+    alignas(64) std::atomic<size_t> head_{0};
+    alignas(64) std::atomic<size_t> written_{0};
+    std::atomic<bool> stop_{false};
+    std::thread thread_;
+};
+
+}  // namespace
+
+std::atomic<int64_t>&
+LogSite::RateLimit() {
+    static std::atomic<int64_t> limit{kDefaultLogRateLimit};
+    return limit;
+}
+
+std::atomic<int64_t>&
+LogSite::SuppressedCount() {
+    static std::atomic<int64_t> count{0};
+    return count;
+}
+
+AsyncLogMessage::AsyncLogMessage(LogSite& site, LogLevel level) : site_(site), level_(level) {
+}
+
+AsyncLogMessage::~AsyncLogMessage() {
+    auto suppressed = site_.TakeSuppressed();
+    if (suppressed > 0) {
+        stream_ << " [" << suppressed << " messages of this site suppressed before]";
+    }
+    LogEntry entry{site_.file(), site_.line(), level_, stream_.str()};
+    if (!log_queue_alive.load(std::memory_order_acquire)) {
+        // the first message starts the log thread, a message around static destruction is written at once
+        static std::atomic<bool> started{false};
+        if (started.exchange(true)) {
+            WriteLog(entry);
+            return;
+        }
+        LogQueue::Instance();
+    }
+    if (!LogQueue::Instance().Push(std::move(entry))) {
+        dropped_count.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void
+SetLogRateLimit(int64_t messages_per_second) {
+    LogSite::RateLimit().store(messages_per_second, std::memory_order_relaxed);
+}
+
+void
+FlushLogs() {
+    if (log_queue_alive.load(std::memory_order_acquire)) {
+        LogQueue::Instance().Flush();
+    }
+}
+
+int64_t
+LogSuppressedCount() {
+    return LogSite::SuppressedCount().load(std::memory_order_relaxed);
+}
+
+int64_t
+LogDroppedCount() {
+    return dropped_count.load(std::memory_order_relaxed);
+}
+
 KnowhereException::KnowhereException(std::string msg) : msg_(std::move(msg)) {
 }
 
@@ -11,14 +11,21 @@
 
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
 #include <list>
+#include <memory>
 #include <mutex>
 #include <shared_mutex>
 #include <unordered_map>
+#include <vector>
 
 namespace knowhere {
 
-template <typename key_t, typename value_t>
+// The capacity is the total charge of the entries, every entry is charged 1 unless put with a charge of its own, e.g.
+// its bytes. The least recently used entries are evicted until the ones left fit.
+template <typename key_t, typename value_t, typename hash_t = std::hash<key_t>>
 class lru_cache {
  public:
     using key_value_pair_t = std::pair<key_t, value_t>;
@@ -28,19 +35,23 @@ class lru_cache {
     }
 
     void
-    put(const key_t& key, const value_t& value) {
+    put(const key_t& key, const value_t& value, size_t charge = 1) {
         std::unique_lock lk(mtx);
         auto it = map.find(key);
         list.push_front(key_value_pair_t(key, value));
         if (it != map.end()) {
-            list.erase(it->second);
+            total_charge -= it->second.charge;
+            list.erase(it->second.entry);
             map.erase(it);
         }
-        map[key] = list.begin();
-        if (map.size() > capacity) {
+        map[key] = {list.begin(), charge};
+        total_charge += charge;
+        while (total_charge > capacity && !list.empty()) {
             auto last = list.end();
             last--;
-            map.erase(last->first);
+            auto victim = map.find(last->first);
+            total_charge -= victim->second.charge;
+            map.erase(victim);
             list.pop_back();
         }
     }
@@ -52,18 +63,214 @@ class lru_cache {
         if (it == map.end()) {
             return false;
         } else {
-            list.splice(list.begin(), list, it->second);
-            val = it->second->second;
+            list.splice(list.begin(), list, it->second.entry);
+            val = it->second.entry->second;
             return true;
         }
     }
 
+    // the bytes of the entries and of the buckets, at the node sizes of libstdc++
+    size_t
+    memory_size() {
+        std::unique_lock lk(mtx);
+        return list.size() * (sizeof(key_value_pair_t) + 2 * sizeof(void*)) +
+               map.size() * (sizeof(std::pair<const key_t, slot_t>) + 2 * sizeof(void*)) +
+               map.bucket_count() * sizeof(void*);
+    }
+
+    // the total charge of the entries
+    size_t
+    charge() {
+        std::unique_lock lk(mtx);
+        return total_charge;
+    }
+
+    void
+    clear() {
+        std::unique_lock lk(mtx);
+        map.clear();
+        list.clear();
+        total_charge = 0;
+    }
+
  private:
+    struct slot_t {
+        list_iterator_t entry;
+        size_t charge;
+    };
+
     std::list<key_value_pair_t> list;
-    std::unordered_map<key_t, list_iterator_t> map;
+    std::unordered_map<key_t, slot_t, hash_t> map;
     size_t capacity;
+    size_t total_charge = 0;
     std::mutex mtx;
     constexpr static size_t kDefaultSize = 10000;
 };
 
+// A cache evicting by CLOCK, an approximation of LRU whose hits need no exclusive lock: a hit takes the lock shared
+// and marks the entry referenced rather than moving it. The entries are kept in a ring a hand sweeps when the total
+// charge is past the capacity, giving the referenced ones a second chance and evicting the first one that is not. An
+// entry just put is not referenced, so the ones hit again outlive the ones seen only once.
+template <typename key_t, typename value_t, typename hash_t = std::hash<key_t>>
+class clock_cache {
+ public:
+    clock_cache(size_t cap = kDefaultSize) : capacity(cap) {
+    }
+
+    void
+    put(const key_t& key, const value_t& value, size_t charge = 1) {
+        std::unique_lock lk(mtx);
+        auto it = map.find(key);
+        if (it != map.end()) {
+            auto node = it->second;
+            node->value = value;
+            total_charge = total_charge - node->charge + charge;
+            node->charge = charge;
+            node->referenced.store(true, std::memory_order_relaxed);
+        } else {
+            ring.emplace_back(std::make_unique<node_t>(key, value, charge));
+            map.emplace(key, ring.back().get());
+            total_charge += charge;
+        }
+        while (total_charge > capacity && !ring.empty()) {
+            hand %= ring.size();
+            auto& node = ring[hand];
+            if (node->referenced.load(std::memory_order_relaxed)) {
+                node->referenced.store(false, std::memory_order_relaxed);
+                ++hand;
+                continue;
+            }
+            // the last node of the ring takes the place of the victim, the hand looks at it next
+            total_charge -= node->charge;
+            map.erase(node->key);
+            node = std::move(ring.back());
+            ring.pop_back();
+        }
+    }
+
+    bool
+    try_get(const key_t& key, value_t& val) {
+        std::shared_lock lk(mtx);
+        auto it = map.find(key);
+        if (it == map.end()) {
+            return false;
+        }
+        auto node = it->second;
+        // only the first hit since the hand passed writes the line of the node
+        if (!node->referenced.load(std::memory_order_relaxed)) {
+            node->referenced.store(true, std::memory_order_relaxed);
+        }
+        val = node->value;
+        return true;
+    }
+
+    // the bytes of the entries and of the buckets, at the node sizes of libstdc++
+    size_t
+    memory_size() {
+        std::shared_lock lk(mtx);
+        return ring.capacity() * sizeof(std::unique_ptr<node_t>) + ring.size() * sizeof(node_t) +
+               map.size() * (sizeof(std::pair<const key_t, node_t*>) + 2 * sizeof(void*)) +
+               map.bucket_count() * sizeof(void*);
+    }
+
+    // the total charge of the entries
+    size_t
+    charge() {
+        std::shared_lock lk(mtx);
+        return total_charge;
+    }
+
+    void
+    clear() {
+        std::unique_lock lk(mtx);
+        map.clear();
+        ring.clear();
+        hand = 0;
+        total_charge = 0;
+    }
+
+ private:
+    struct node_t {
+        node_t(const key_t& k, const value_t& v, size_t c) : key(k), value(v), charge(c) {
+        }
+
+        key_t key;
+        value_t value;
+        size_t charge;
+        std::atomic<bool> referenced{false};
+    };
+
+    std::vector<std::unique_ptr<node_t>> ring;
+    std::unordered_map<key_t, node_t*, hash_t> map;
+    size_t hand = 0;
+    size_t capacity;
+    size_t total_charge = 0;
+    std::shared_mutex mtx;
+    constexpr static size_t kDefaultSize = 10000;
+};
+
+// A clock_cache split into shards by the hash of the keys, every shard behind a lock of its own, for the caches looked
+// up by many threads at once, e.g. by every query of a search. The capacity is spread evenly over the shards, an entry
+// is evicted by the hand of its shard. There are no more shards than the capacity.
+template <typename key_t, typename value_t, typename hash_t = std::hash<key_t>>
+class concurrent_cache {
+ public:
+    using shard_t = clock_cache<key_t, value_t, hash_t>;
+
+    concurrent_cache(size_t cap = kDefaultSize, size_t num_shards = kDefaultShards) {
+        num_shards = std::clamp<size_t>(num_shards, 1, std::max<size_t>(cap, 1));
+        shards.reserve(num_shards);
+        for (size_t i = 0; i < num_shards; ++i) {
+            shards.emplace_back(std::make_unique<shard_t>((cap + num_shards - 1) / num_shards));
+        }
+    }
+
+    void
+    put(const key_t& key, const value_t& value, size_t charge = 1) {
+        shard(key).put(key, value, charge);
+    }
+
+    bool
+    try_get(const key_t& key, value_t& val) {
+        return shard(key).try_get(key, val);
+    }
+
+    size_t
+    memory_size() {
+        size_t size = shards.size() * sizeof(shard_t);
+        for (auto& s : shards) {
+            size += s->memory_size();
+        }
+        return size;
+    }
+
+    size_t
+    charge() {
+        size_t total = 0;
+        for (auto& s : shards) {
+            total += s->charge();
+        }
+        return total;
+    }
+
+    void
+    clear() {
+        for (auto& s : shards) {
+            s->clear();
+        }
+    }
+
+ private:
+    shard_t&
+    shard(const key_t& key) {
+        // the buckets of the shards take the low bits of the hash, the shards the high ones
+        uint64_t h = hash_t{}(key) * 0x9e3779b97f4a7c15ULL;
+        return *shards[(h >> 32) % shards.size()];
+    }
+
+    std::vector<std::unique_ptr<shard_t>> shards;
+    constexpr static size_t kDefaultSize = 10000;
+    constexpr static size_t kDefaultShards = 16;
+};
+
 }  // namespace knowhere
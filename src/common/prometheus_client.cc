@@ -11,11 +11,21 @@
 
 #include "knowhere/prometheus_client.h"
 
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+
 namespace knowhere {
 
 const prometheus::Histogram::BucketBoundaries buckets = {1,   2,    4,    8,    16,   32,    64,    128,  256,
                                                          512, 1024, 2048, 4096, 8192, 16384, 32768, 65536};
 
+// 4KB to 64MB
+const prometheus::Histogram::BucketBoundaries bytes_buckets = {1 << 12, 1 << 13, 1 << 14, 1 << 15, 1 << 16,
+                                                               1 << 17, 1 << 18, 1 << 19, 1 << 20, 1 << 21,
+                                                               1 << 22, 1 << 23, 1 << 24, 1 << 25, 1 << 26};
+
 const std::unique_ptr<PrometheusClient> prometheusClient = std::make_unique<PrometheusClient>();
 
 /*******************************************************************************
@@ -31,5 +41,120 @@ DEFINE_PROMETHEUS_COUNTER(knowhere_range_search_count, "knowhere range search co
 DEFINE_PROMETHEUS_HISTOGRAM(knowhere_search_topk, "knowhere search topk")
 DEFINE_PROMETHEUS_HISTOGRAM(knowhere_search_latency, "search latency in knowhere (ms)")
 DEFINE_PROMETHEUS_HISTOGRAM(knowhere_range_search_latency, "range search latency in knowhere (ms)")
+DEFINE_PROMETHEUS_GAUGE(knowhere_diskann_sector_pool_bytes, "bytes of the diskann sector buffer pool")
+DEFINE_PROMETHEUS_GAUGE(knowhere_diskann_sector_pool_borrowed_bytes,
+                        "bytes of the diskann sector buffer pool borrowed by searches")
+DEFINE_PROMETHEUS_COUNTER(knowhere_diskann_sector_pool_waits,
+                          "diskann searches that waited for the sector buffer pool capacity")
+DEFINE_PROMETHEUS_COUNTER(knowhere_diskann_sector_pool_remote_borrows,
+                          "diskann searches served a sector buffer of another numa node")
+DEFINE_PROMETHEUS_HISTOGRAM_FAMILY(knowhere_op_latency, "latency of the operations of an index type in knowhere (ms)")
+DEFINE_PROMETHEUS_HISTOGRAM_FAMILY(knowhere_thread_pool_queue_wait,
+                                   "time the tasks of a thread pool wait in its queue (us)")
+DEFINE_PROMETHEUS_HISTOGRAM_FAMILY(knowhere_query_hops, "nodes a graph search expands per query")
+DEFINE_PROMETHEUS_HISTOGRAM_FAMILY(knowhere_query_distance_computations, "distances a graph search computes per query")
+DEFINE_PROMETHEUS_HISTOGRAM_FAMILY(knowhere_query_lists_scanned, "inverted lists an ivf search scans per query")
+DEFINE_PROMETHEUS_HISTOGRAM_FAMILY(knowhere_query_codes_scanned, "codes an ivf search scans per query")
+DEFINE_PROMETHEUS_HISTOGRAM_FAMILY(knowhere_query_ios, "reads a disk search issues per query")
+DEFINE_PROMETHEUS_HISTOGRAM_FAMILY(knowhere_query_cache_hits, "nodes a disk search finds in its cache per query")
+DEFINE_PROMETHEUS_HISTOGRAM_FAMILY(knowhere_query_bytes_read, "bytes a disk search reads per query")
+DEFINE_PROMETHEUS_GAUGE_FAMILY(knowhere_search_recall,
+                               "recall@k of the sampled queries of an index against a brute force search")
+DEFINE_PROMETHEUS_HISTOGRAM_FAMILY(knowhere_gpu_stage_latency,
+                                   "device time of a stage of the gpu searches of an index type (us)")
+DEFINE_PROMETHEUS_COUNTER_FAMILY(knowhere_gpu_transfer_bytes, "bytes an index type copies between host and gpu")
+DEFINE_PROMETHEUS_GAUGE_FAMILY(knowhere_gpu_pool_bytes, "bytes of a gpu memory pool of a device")
+DEFINE_PROMETHEUS_GAUGE_FAMILY(knowhere_gpu_resources_in_use, "faiss gpu resources of a device taken by the indexes")
+
+prometheus::Histogram&
+GetOpLatencyHistogram(const std::string& index_type, const std::string& op) {
+    return knowhere_op_latency.Add({{"index_type", index_type}, {"op", op}}, buckets);
+}
+
+prometheus::Histogram&
+ThreadPoolQueueWaitHistogram(const std::string& pool) {
+    return knowhere_thread_pool_queue_wait.Add({{"pool", pool}}, buckets);
+}
+
+void
+ObserveQueueWait(prometheus::Histogram& histogram, std::chrono::steady_clock::time_point enqueued) {
+    auto wait = std::chrono::steady_clock::now() - enqueued;
+    histogram.Observe(std::chrono::duration<double, std::micro>(wait).count());
+}
+
+void
+QueryMetrics::Observe(const QueryStats& stats) const {
+    if (stats.hops > 0) {
+        hops.Observe(stats.hops);
+        distance_computations.Observe(stats.distance_computations);
+    }
+    if (stats.lists_scanned > 0) {
+        lists_scanned.Observe(stats.lists_scanned);
+        codes_scanned.Observe(stats.codes_scanned);
+    }
+    if (stats.ios > 0 || stats.cache_hits > 0) {
+        ios.Observe(stats.ios);
+        cache_hits.Observe(stats.cache_hits);
+        bytes_read.Observe(stats.bytes_read);
+    }
+}
+
+const QueryMetrics&
+GetQueryMetrics(const std::string& index_type) {
+    static std::mutex mutex;
+    // the families keep their histograms for good, so do the metrics of an index type
+    static std::map<std::string, QueryMetrics> metrics;
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = metrics.find(index_type);
+    if (it == metrics.end()) {
+        const prometheus::Labels labels = {{"index_type", index_type}};
+        it = metrics
+                 .emplace(index_type, QueryMetrics{knowhere_query_hops.Add(labels, buckets),
+                                                   knowhere_query_distance_computations.Add(labels, buckets),
+                                                   knowhere_query_lists_scanned.Add(labels, buckets),
+                                                   knowhere_query_codes_scanned.Add(labels, buckets),
+                                                   knowhere_query_ios.Add(labels, buckets),
+                                                   knowhere_query_cache_hits.Add(labels, buckets),
+                                                   knowhere_query_bytes_read.Add(labels, bytes_buckets)})
+                 .first;
+    }
+    return it->second;
+}
+
+prometheus::Gauge&
+GetSearchRecallGauge(const std::string& index) {
+    return knowhere_search_recall.Add({{"index", index}});
+}
+
+const GpuMetrics&
+GetGpuMetrics(const std::string& index_type) {
+    static std::mutex mutex;
+    static std::map<std::string, GpuMetrics> metrics;
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = metrics.find(index_type);
+    if (it == metrics.end()) {
+        auto stage = [&](const std::string& name) -> prometheus::Histogram& {
+            return knowhere_gpu_stage_latency.Add({{"index_type", index_type}, {"stage", name}}, buckets);
+        };
+        auto transfer = [&](const std::string& direction) -> prometheus::Counter& {
+            return knowhere_gpu_transfer_bytes.Add({{"index_type", index_type}, {"direction", direction}});
+        };
+        it = metrics
+                 .emplace(index_type, GpuMetrics{stage("h2d"), stage("kernel"), stage("slice"), stage("d2h"),
+                                                 stage("sync"), transfer("h2d"), transfer("d2h")})
+                 .first;
+    }
+    return it->second;
+}
+
+prometheus::Gauge&
+GetGpuPoolBytesGauge(int64_t device, const std::string& pool, const std::string& kind) {
+    return knowhere_gpu_pool_bytes.Add({{"device", std::to_string(device)}, {"pool", pool}, {"kind", kind}});
+}
+
+prometheus::Gauge&
+GetGpuResourcesInUseGauge(int64_t device) {
+    return knowhere_gpu_resources_in_use.Add({{"device", std::to_string(device)}});
+}
 
 }  // namespace knowhere
@@ -0,0 +1,144 @@
+/**
+ * SPDX-FileCopyrightText: Copyright (c) 2023,NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef RAFT_RESULTS_CUH
+#define RAFT_RESULTS_CUH
+
+#include <cstdint>
+#include <limits>
+
+#include "knowhere/device_bitset.h"
+#include "raft/core/device_mdarray.hpp"
+#include "raft/core/device_resources.hpp"
+
+namespace knowhere {
+
+namespace raft_detail {
+struct raft_results {
+    raft_results(raft::device_resources& res)
+        : ids_{raft::make_device_matrix<std::int64_t, std::int64_t>(res, 0, 0)},
+          dists_{raft::make_device_matrix<float, std::int64_t>(res, 0, 0)} {
+    }
+    raft_results(raft::device_resources& res, std::int64_t rows, std::int64_t k)
+        : ids_{raft::make_device_matrix<std::int64_t, std::int64_t>(res, rows, k)},
+          dists_{raft::make_device_matrix<float, std::int64_t>(res, rows, k)} {
+    }
+    auto
+    ids() {
+        return ids_.view();
+    }
+    auto
+    dists() {
+        return dists_.view();
+    }
+    auto
+    ids_data() {
+        return ids_.data_handle();
+    }
+    auto
+    dists_data() {
+        return dists_.data_handle();
+    }
+
+    auto
+    rows() const {
+        return ids_.extent(0);
+    }
+    auto
+    k() const {
+        return ids_.extent(1);
+    }
+
+ private:
+    raft::device_matrix<std::int64_t, std::int64_t> ids_;
+    raft::device_matrix<float, std::int64_t> dists_;
+};
+
+// a template, so that every translation unit including this header may instantiate the kernel
+template <typename IdxT>
+__global__ void
+postprocess_device_results(bool* enough_valid, IdxT* ids, float* dists, int64_t rows, int k, int target_k,
+                           DeviceBitsetView bitset) {
+    __shared__ int invalid_count[1];
+    for (auto row_index = blockIdx.x; row_index < rows; row_index += gridDim.x) {
+        if (threadIdx.x == 0) {
+            invalid_count[0] = 0;
+        }
+        __syncthreads();
+        // First, replace all invalid IDs with -1
+        for (auto col_index = threadIdx.x; col_index < k; col_index += blockDim.x) {
+            auto elem_index = row_index * k + col_index;
+            auto cur_id = ids[elem_index];
+            auto invalid_id = bitset.test(cur_id);
+            if (invalid_id) {  // TODO(wphicks): assuming the branch is worth it here;
+                               // should analyze perf.
+                atomicAdd_block(invalid_count, 1);
+            }
+            invalid_id |= cur_id == std::numeric_limits<IdxT>::max();
+            ids[elem_index] = int(invalid_id) * -1 + int(!invalid_id) * ids[elem_index];
+        }
+        __syncthreads();
+
+        // Now move all valid results to the front of the row
+        auto cur_valid_index = row_index * k;
+        for (auto col_index = 0; col_index < k; ++col_index) {
+            auto elem_index = row_index * k + col_index;
+            // Just do one row per block for now; can improve this later
+            if (ids[elem_index] != -1 && threadIdx.x == 0) {
+                // Swap valid id to an earlier place in the row
+                ids[cur_valid_index] = ids[elem_index];
+                if (elem_index != cur_valid_index) {
+                    ids[elem_index] = -1;
+                    // Only count elements invalidated by the bitset. These are the
+                    // elements that will require a swap as opposed to just appearing at
+                    // the end of the row
+                }
+                dists[cur_valid_index++] = dists[elem_index];
+            }
+        }
+        // Check if we have enough valid results
+        if (threadIdx.x == 0) {
+            enough_valid[row_index] = (k - invalid_count[0] >= target_k);
+        }
+    }
+}
+
+/* The following kernel is used to copy data from one row-major 2D array to
+ * another. If the input array has more columns than the output array, the
+ * rows will be truncated to the length of the output array. Similarly, the
+ * number of rows will be truncated if the output has fewer rows. If the output
+ * array has more rows/columns than the input, the output will be padded with
+ * entries of -1. */
+template <typename T, typename IndexT>
+__global__ void
+slice(T* out, T* in, IndexT out_rows, IndexT out_cols, IndexT in_rows, IndexT in_cols) {
+    for (auto i = blockIdx.x * blockDim.x + threadIdx.x; i < out_rows * out_cols; i += blockDim.x * gridDim.x) {
+        auto row_index = i / out_cols;
+        auto col_index = i % out_cols;
+        if (row_index < in_rows && col_index < in_cols) {
+            out[i] = in[row_index * in_cols + col_index];
+        } else {
+            out[i] = -1;
+        }
+    }
+}
+
+}  // namespace raft_detail
+
+}  // namespace knowhere
+
+#endif /* RAFT_RESULTS_CUH */
@@ -1,21 +1,29 @@
 #include <cuda_runtime.h>
 
+#include <algorithm>
+#include <array>
 #include <atomic>
 #include <cstddef>
+#include <cstdint>
 #include <cstdlib>
+#include <cstring>
 #include <map>
 #include <memory>
 #include <mutex>
 #include <optional>
 #include <sstream>
+#include <utility>
 #include <vector>
 
 #include "knowhere/log.h"
+#include "knowhere/prometheus_client.h"
 #include "raft/core/device_resources.hpp"
 #include "rmm/cuda_stream_pool.hpp"
+#include "rmm/device_uvector.hpp"
 #include "rmm/mr/device/cuda_memory_resource.hpp"
 #include "rmm/mr/device/per_device_resource.hpp"
 #include "rmm/mr/device/pool_memory_resource.hpp"
+#include "rmm/mr/device/statistics_resource_adaptor.hpp"
 #include "thrust/optional.h"
 
 namespace raft_utils {
@@ -50,6 +58,9 @@ struct device_setter {
 
 inline auto raft_mutex = std::mutex{};
 
+// the streams of a device builds run on, apart from the ones of the searches
+inline constexpr std::size_t build_streams = 2;
+
 struct gpu_resources {
     gpu_resources(std::optional<std::size_t> streams_per_device = std::nullopt)
         : streams_per_device_{streams_per_device.value_or([]() {
@@ -73,6 +84,7 @@ struct gpu_resources {
           max_mem_pool_size_{} {
     }
     ~gpu_resources() {
+        stats_resources_.clear();
         memory_resources_.clear();
     }
 
@@ -91,6 +103,7 @@ struct gpu_resources {
         if (stream_iter == stream_pools_.end()) {
             auto scoped_device = device_setter{device_id};
             stream_pools_[device_id] = std::make_shared<rmm::cuda_stream_pool>(streams_per_device_);
+            build_stream_pools_[device_id] = std::make_shared<rmm::cuda_stream_pool>(build_streams);
 
             // Set up device memory pool for this device
             if (!init_mem_pool_size_.has_value() && !max_mem_pool_size_.has_value()) {
@@ -113,11 +126,29 @@ struct gpu_resources {
                 memory_resources_[device_id] =
                     std::make_unique<rmm::mr::pool_memory_resource<rmm::mr::cuda_memory_resource>>(
                         &upstream_mr_, init_mem_pool_size_, max_mem_pool_size_);
-                rmm::mr::set_current_device_resource(memory_resources_[device_id].get());
+                // the allocations are counted on their way to the pool, see report_pool
+                auto& stats = stats_resources_[device_id];
+                stats.mr = std::make_unique<pool_stats_mr>(memory_resources_[device_id].get());
+                stats.used = &knowhere::GetGpuPoolBytesGauge(device_id, "rmm", "used");
+                stats.reserved = &knowhere::GetGpuPoolBytesGauge(device_id, "rmm", "reserved");
+                rmm::mr::set_current_device_resource(stats.mr.get());
             }
         }
     }
 
+    // sets the gauges of the bytes the RMM pool of the device holds and the ones allocated out of it
+    void
+    report_pool(int device_id = get_current_device()) {
+        auto lock = std::lock_guard{raft_mutex};
+        auto iter = stats_resources_.find(device_id);
+        if (iter == stats_resources_.end()) {
+            return;
+        }
+        auto& stats = iter->second;
+        stats.used->Set(stats.mr->get_bytes_counter().value);
+        stats.reserved->Set(memory_resources_[device_id]->pool_size());
+    }
+
     auto
     get_streams_per_device() const {
         return streams_per_device_;
@@ -128,10 +159,25 @@ struct gpu_resources {
         return stream_pools_[device_id]->get_stream(thread_id % streams_per_device_);
     }
 
+    auto
+    get_build_stream_view(int device_id = get_current_device(), std::size_t thread_id = get_thread_id()) {
+        return build_stream_pools_[device_id]->get_stream(thread_id % build_streams);
+    }
+
  private:
+    using pool_stats_mr =
+        rmm::mr::statistics_resource_adaptor<rmm::mr::pool_memory_resource<rmm::mr::cuda_memory_resource>>;
+    struct pool_stats {
+        std::unique_ptr<pool_stats_mr> mr;
+        prometheus::Gauge* used = nullptr;
+        prometheus::Gauge* reserved = nullptr;
+    };
+
     std::size_t streams_per_device_;
     std::map<int, std::shared_ptr<rmm::cuda_stream_pool>> stream_pools_;
+    std::map<int, std::shared_ptr<rmm::cuda_stream_pool>> build_stream_pools_;
     std::map<int, std::unique_ptr<rmm::mr::pool_memory_resource<rmm::mr::cuda_memory_resource>>> memory_resources_;
+    std::map<int, pool_stats> stats_resources_;
     rmm::mr::cuda_memory_resource upstream_mr_;
     thrust::optional<std::size_t> init_mem_pool_size_;
     thrust::optional<std::size_t> max_mem_pool_size_;
@@ -161,10 +207,161 @@ get_raft_resources(int device_id = get_current_device()) {
     return *all_resources[device_id];
 }
 
+/**
+ * @brief The resources a thread builds an index on, on a build stream of the device: the kernels and copies of a
+ * build interleave with those of the searches instead of queueing ahead of them on a shared stream.
+ */
+inline auto&
+get_build_resources(int device_id = get_current_device()) {
+    thread_local auto all_resources = std::map<int, std::unique_ptr<raft::device_resources>>{};
+
+    auto iter = all_resources.find(device_id);
+    if (iter == all_resources.end()) {
+        auto scoped_device = device_setter{device_id};
+        iter = all_resources
+                   .emplace(device_id, std::make_unique<raft::device_resources>(
+                                           get_gpu_resources().get_build_stream_view(device_id), nullptr,
+                                           rmm::mr::get_current_device_resource()))
+                   .first;
+    }
+    return *iter->second;
+}
+
+// the streams a search pipelines its sub-batches over, see get_pipeline_resources
+inline constexpr std::size_t pipeline_streams = 4;
+
+/**
+ * @brief The resources of the slot-th stream a thread pipelines a search over, slot < pipeline_streams. Slot 0 is
+ * get_raft_resources(), the other slots run on other streams of the pool of the device, so that the copies and the
+ * kernels of the sub-batches of one search overlap.
+ */
+inline auto&
+get_pipeline_resources(std::size_t slot, int device_id = get_current_device()) {
+    if (slot == 0) {
+        return get_raft_resources(device_id);
+    }
+    thread_local auto all_resources = std::map<std::pair<int, std::size_t>, std::unique_ptr<raft::device_resources>>{};
+
+    auto key = std::make_pair(device_id, slot);
+    auto iter = all_resources.find(key);
+    if (iter == all_resources.end()) {
+        auto scoped_device = device_setter{device_id};
+        auto stream = get_gpu_resources().get_stream_view(device_id, get_thread_id() * pipeline_streams + slot);
+        iter = all_resources
+                   .emplace(key, std::make_unique<raft::device_resources>(stream, nullptr,
+                                                                          rmm::mr::get_current_device_resource()))
+                   .first;
+    }
+    return *iter->second;
+}
+
+/**
+ * @brief A page-locked host buffer a thread reuses from search to search, grown on demand. Copies between the device
+ * and pinned memory run asynchronously at full bandwidth, from pageable memory they are staged and synchronous.
+ */
+struct pinned_buffer {
+    pinned_buffer() = default;
+    pinned_buffer(const pinned_buffer&) = delete;
+    pinned_buffer&
+    operator=(const pinned_buffer&) = delete;
+
+    ~pinned_buffer() {
+        if (data_ != nullptr) {
+            RAFT_CUDA_TRY_NO_THROW(cudaFreeHost(data_));
+        }
+    }
+
+    void*
+    get(std::size_t bytes) {
+        if (bytes > size_) {
+            if (data_ != nullptr) {
+                RAFT_CUDA_TRY(cudaFreeHost(data_));
+                data_ = nullptr;
+                size_ = 0;
+            }
+            RAFT_CUDA_TRY(cudaMallocHost(&data_, bytes));
+            size_ = bytes;
+        }
+        return data_;
+    }
+
+ private:
+    void* data_ = nullptr;
+    std::size_t size_ = 0;
+};
+
+// the pinned buffer of the slot-th pipeline stream of the thread
+inline void*
+get_pinned_buffer(std::size_t slot, std::size_t bytes) {
+    thread_local auto buffers = std::array<pinned_buffer, pipeline_streams>{};
+    return buffers[slot].get(bytes);
+}
+
+struct cuda_event {
+    cuda_event() {
+        RAFT_CUDA_TRY(cudaEventCreateWithFlags(&event_, cudaEventDisableTiming));
+    }
+    cuda_event(const cuda_event&) = delete;
+    cuda_event&
+    operator=(const cuda_event&) = delete;
+
+    ~cuda_event() {
+        RAFT_CUDA_TRY_NO_THROW(cudaEventDestroy(event_));
+    }
+
+    cudaEvent_t
+    get() const {
+        return event_;
+    }
+
+ private:
+    cudaEvent_t event_;
+};
+
+/**
+ * @brief Uploads the rows x dim host matrix data to the device chunk_rows rows at a time and calls
+ * consume(first_row, chunk, chunk_rows) for each chunk, which queues its work on the stream of res and is done with
+ * chunk when the stream gets there. The chunks go through two pinned buffers: the host copies a chunk into one while
+ * the device uploads and consumes the one before, and the device never holds more than two chunks of the data.
+ */
+template <typename Consume>
+inline void
+stream_to_device(raft::device_resources& res, const float* data, std::int64_t rows, std::int64_t dim,
+                 std::int64_t chunk_rows, Consume&& consume) {
+    auto stream = res.get_stream();
+    chunk_rows = std::max<std::int64_t>(1, std::min(chunk_rows, rows));
+    auto chunk_size = static_cast<std::size_t>(chunk_rows * dim);
+    std::array<pinned_buffer, 2> host;
+    std::array<rmm::device_uvector<float>, 2> device{rmm::device_uvector<float>(chunk_size, stream),
+                                                     rmm::device_uvector<float>(chunk_size, stream)};
+    // recorded on the stream once the chunk of a slot is consumed, the slot takes the next chunk after that
+    std::array<cuda_event, 2> consumed;
+    for (std::int64_t first = 0, i = 0; first < rows; first += chunk_rows, ++i) {
+        auto slot = i & 1;
+        if (i >= 2) {
+            RAFT_CUDA_TRY(cudaEventSynchronize(consumed[slot].get()));
+        }
+        auto n = std::min(chunk_rows, rows - first);
+        auto bytes = static_cast<std::size_t>(n * dim) * sizeof(float);
+        auto* pinned = host[slot].get(bytes);
+        std::memcpy(pinned, data + first * dim, bytes);
+        RAFT_CUDA_TRY(cudaMemcpyAsync(device[slot].data(), pinned, bytes, cudaMemcpyHostToDevice, stream.value()));
+        consume(first, static_cast<const float*>(device[slot].data()), n);
+        RAFT_CUDA_TRY(cudaEventRecord(consumed[slot].get(), stream.value()));
+    }
+    res.sync_stream();
+}
+
 inline void
 set_mem_pool_size(size_t init_size, size_t max_size) {
     LOG_KNOWHERE_INFO_ << "Set GPU pool size: init size " << init_size << ", max size " << max_size;
     get_gpu_resources().set_pool_size(init_size, max_size);
 }
 
+// the gauges of the RMM pool of the device, the GPU indexes call it after their searches and builds
+inline void
+report_memory_pool(int device_id = get_current_device()) {
+    get_gpu_resources().report_pool(device_id);
+}
+
 };  // namespace raft_utils
@@ -12,8 +12,11 @@
 #include "range_util.h"
 
 #include <algorithm>
+#include <atomic>
 #include <cinttypes>
 
+#include "knowhere/comp/profile_zone.h"
+#include "knowhere/comp/thread_pool.h"
 #include "knowhere/log.h"
 namespace knowhere {
 
@@ -58,6 +61,7 @@ void
 GetRangeSearchResult(const faiss::RangeSearchResult& res, const bool is_ip, const int64_t nq, const float radius,
                      const float range_filter, float*& distances, int64_t*& labels, size_t*& lims,
                      const BitsetView& bitset) {
+    KNOWHERE_PROFILE_ZONE("result.range_build");
     auto total_valid = CountValidRangeSearchResult(res, is_ip, nq, radius, range_filter, lims);
     LOG_KNOWHERE_DEBUG_ << "Range search: is_ip " << (is_ip ? "True" : "False") << ", radius " << radius
                         << ", range_filter " << range_filter << ", total result num " << total_valid;
@@ -65,12 +69,11 @@ GetRangeSearchResult(const faiss::RangeSearchResult& res, const bool is_ip, cons
     distances = new float[total_valid];
     labels = new int64_t[total_valid];
 
-#pragma omp parallel for
-    for (auto i = 0; i < nq; i++) {
+    ThreadPool::GetGlobalSearchThreadPool()->parallel_for(0, nq, 1, [&](int64_t i) {
         FilterRangeSearchResultForOneNq(res.lims[i + 1] - res.lims[i], res.distances + res.lims[i],
                                         res.labels + res.lims[i], is_ip, radius, range_filter, lims[i + 1] - lims[i],
                                         distances + lims[i], labels + lims[i], bitset);
-    }
+    });
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -101,6 +104,7 @@ void
 GetRangeSearchResult(const std::vector<std::vector<float>>& result_distances,
                      const std::vector<std::vector<int64_t>>& result_labels, const bool is_ip, const int64_t nq,
                      const float radius, const float range_filter, float*& distances, int64_t*& labels, size_t*& lims) {
+    KNOWHERE_PROFILE_ZONE("result.range_build");
     KNOWHERE_THROW_IF_NOT_FMT(result_distances.size() == (size_t)nq, "result distances size %ld not equal to %" SCNd64,
                               result_distances.size(), nq);
     KNOWHERE_THROW_IF_NOT_FMT(result_labels.size() == (size_t)nq, "result labels size %ld not equal to %" SCNd64,
@@ -126,4 +130,123 @@ GetRangeSearchResult(const std::vector<std::vector<float>>& result_distances,
     }
 }
 
+RangeSearchResultBuilder::RangeSearchResultBuilder(int64_t nq, int64_t max_results, bool is_ip)
+    : queries_(nq), max_results_(max_results), is_ip_(is_ip) {
+    static std::atomic<uint64_t> generations{0};
+    generation_ = ++generations;
+}
+
+RangeSearchResultBuilder::Writer::~Writer() {
+    size_t end = buffer_.ids.size();
+    if (max_results_ > 0) {
+        // heap sort, the farthest result goes to the back each round
+        for (size_t last = end; last > begin_ + 1; --last) {
+            Swap(begin_, last - 1);
+            SiftDown(begin_, last - 1);
+        }
+    }
+    builder_.queries_[query_] = {&buffer_, begin_, end - begin_};
+}
+
+void
+RangeSearchResultBuilder::Writer::AddBounded(float distance, int64_t id) {
+    if (!Full()) {
+        buffer_.distances.push_back(distance);
+        buffer_.ids.push_back(id);
+        for (size_t pos = buffer_.ids.size() - 1; pos > begin_;) {
+            size_t parent = begin_ + (pos - begin_ - 1) / 2;
+            if (!Farther(pos, parent)) {
+                break;
+            }
+            Swap(pos, parent);
+            pos = parent;
+        }
+        return;
+    }
+    if (is_ip_ ? distance <= Bound() : distance >= Bound()) {
+        return;
+    }
+    buffer_.distances[begin_] = distance;
+    buffer_.ids[begin_] = id;
+    SiftDown(begin_, buffer_.ids.size());
+}
+
+void
+RangeSearchResultBuilder::Writer::SiftDown(size_t pos, size_t end) {
+    while (true) {
+        size_t child = begin_ + 2 * (pos - begin_) + 1;
+        if (child >= end) {
+            return;
+        }
+        if (child + 1 < end && Farther(child + 1, child)) {
+            ++child;
+        }
+        if (!Farther(child, pos)) {
+            return;
+        }
+        Swap(pos, child);
+        pos = child;
+    }
+}
+
+RangeSearchResultBuilder::Buffer&
+RangeSearchResultBuilder::LocalBuffer() {
+    thread_local uint64_t cached_generation = 0;
+    thread_local Buffer* cached_buffer = nullptr;
+    if (cached_generation != generation_) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        buffers_.push_back(std::make_unique<Buffer>());
+        cached_buffer = buffers_.back().get();
+        cached_generation = generation_;
+    }
+    return *cached_buffer;
+}
+
+bool
+RangeSearchResultBuilder::Build(const BaseConfig& cfg, float*& distances, int64_t*& ids, size_t*& lims) const {
+    const int64_t nq = queries_.size();
+    size_t total = 0;
+    for (auto& query : queries_) {
+        total += query.count;
+    }
+    bool owned = cfg.result_lims == nullptr || cfg.result_ids == nullptr || cfg.result_distances == nullptr ||
+                 total > cfg.result_capacity;
+    if (owned) {
+        if (cfg.result_lims != nullptr) {
+            LOG_KNOWHERE_DEBUG_ << "Range search: " << total << " results do not fit the buffers of "
+                                << cfg.result_capacity;
+        }
+        lims = new size_t[nq + 1];
+        distances = new float[total];
+        ids = new int64_t[total];
+    } else {
+        lims = cfg.result_lims;
+        distances = cfg.result_distances;
+        ids = cfg.result_ids;
+    }
+    lims[0] = 0;
+    for (int64_t i = 0; i < nq; i++) {
+        lims[i + 1] = lims[i] + queries_[i].count;
+    }
+    LOG_KNOWHERE_DEBUG_ << "Range search: total result num " << total;
+
+    auto copy = [&](int64_t i) {
+        auto& query = queries_[i];
+        if (query.count > 0) {
+            std::copy_n(query.buffer->distances.data() + query.begin, query.count, distances + lims[i]);
+            std::copy_n(query.buffer->ids.data() + query.begin, query.count, ids + lims[i]);
+        }
+    };
+    // a task per query costs more than copying a few results
+    constexpr size_t kParallelCopyResults = 1 << 16;
+    if (total < kParallelCopyResults) {
+        for (int64_t i = 0; i < nq; i++) {
+            copy(i);
+        }
+    } else {
+        ThreadPool::GetGlobalSearchThreadPool()->parallel_for(0, nq, 1, copy);
+    }
+    return owned;
+}
+
 }  // namespace knowhere
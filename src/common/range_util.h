@@ -13,9 +13,12 @@
 
 #include <faiss/impl/AuxIndexStructures.h>
 
+#include <memory>
+#include <mutex>
 #include <vector>
 
 #include "knowhere/bitsetview.h"
+#include "knowhere/config.h"
 
 namespace knowhere {
 
@@ -38,4 +41,135 @@ GetRangeSearchResult(const std::vector<std::vector<float>>& result_distances,
                      const std::vector<std::vector<int64_t>>& result_labels, const bool is_ip, const int64_t nq,
                      const float radius, const float range_filter, float*& distances, int64_t*& labels, size_t*& lims);
 
+/**
+ * @brief Collects the results of a range search query by query and lays them out in the final arrays. The threads
+ * running the queries append their results to buffers of their own, one per thread rather than a vector per query;
+ * Build then takes the lims as a prefix sum of the counts and copies every query into place in one parallel pass.
+ *
+ * With max_results, see BaseConfig, the results of a query are a bounded heap in the buffer that keeps the closest
+ * of them, and they come out sorted closest first.
+ */
+class RangeSearchResultBuilder {
+    struct Buffer {
+        std::vector<float> distances;
+        std::vector<int64_t> ids;
+    };
+
+ public:
+    explicit RangeSearchResultBuilder(int64_t nq, int64_t max_results = 0, bool is_ip = false);
+
+    RangeSearchResultBuilder(const RangeSearchResultBuilder&) = delete;
+
+    RangeSearchResultBuilder&
+    operator=(const RangeSearchResultBuilder&) = delete;
+
+    // The results of one query, from the thread running it. They count once the writer is destroyed, a query that
+    // never had one has none.
+    class Writer {
+     public:
+        Writer(RangeSearchResultBuilder& builder, int64_t query)
+            : builder_(builder),
+              query_(query),
+              buffer_(builder.LocalBuffer()),
+              begin_(buffer_.ids.size()),
+              max_results_(builder.max_results_),
+              is_ip_(builder.is_ip_) {
+        }
+
+        Writer(const Writer&) = delete;
+
+        Writer&
+        operator=(const Writer&) = delete;
+
+        ~Writer();
+
+        void
+        Add(float distance, int64_t id) {
+            if (max_results_ == 0) {
+                buffer_.distances.push_back(distance);
+                buffer_.ids.push_back(id);
+            } else {
+                AddBounded(distance, id);
+            }
+        }
+
+        // the n results of which the distances are in range, all of them without filter
+        void
+        Append(const float* distances, const int64_t* ids, size_t n, bool filter, bool is_ip, float radius,
+               float range_filter) {
+            for (size_t i = 0; i < n; ++i) {
+                if (!filter || distance_in_range(distances[i], radius, range_filter, is_ip)) {
+                    Add(distances[i], ids[i]);
+                }
+            }
+        }
+
+        // whether the query holds max_results results, a result must then be closer than Bound() to be kept
+        bool
+        Full() const {
+            return max_results_ > 0 && buffer_.ids.size() - begin_ >= max_results_;
+        }
+
+        float
+        Bound() const {
+            return buffer_.distances[begin_];
+        }
+
+     private:
+        bool
+        Farther(size_t a, size_t b) const {
+            auto& d = buffer_.distances;
+            return is_ip_ ? d[a] < d[b] : d[a] > d[b];
+        }
+
+        void
+        Swap(size_t a, size_t b) {
+            std::swap(buffer_.distances[a], buffer_.distances[b]);
+            std::swap(buffer_.ids[a], buffer_.ids[b]);
+        }
+
+        void
+        AddBounded(float distance, int64_t id);
+
+        // the heap of the query in [begin_, end), the farthest result on top
+        void
+        SiftDown(size_t pos, size_t end);
+
+        RangeSearchResultBuilder& builder_;
+        int64_t query_;
+        Buffer& buffer_;
+        size_t begin_;
+        size_t max_results_;
+        bool is_ip_;
+    };
+
+    Writer
+    Query(int64_t query) {
+        return Writer(*this, query);
+    }
+
+    // Into the buffers the config carries, see Index::RangeSearchWithBuf, when the results fit them, else into new
+    // arrays. Returns whether the arrays are new, the result dataset owns those.
+    bool
+    Build(const BaseConfig& cfg, float*& distances, int64_t*& ids, size_t*& lims) const;
+
+ private:
+    struct Slot {
+        const Buffer* buffer = nullptr;
+        size_t begin = 0;
+        size_t count = 0;
+    };
+
+    Buffer&
+    LocalBuffer();
+
+    std::vector<Slot> queries_;
+    size_t max_results_;
+    bool is_ip_;
+    std::mutex mutex_;
+    std::vector<std::unique_ptr<Buffer>> buffers_;
+    // tells the builders apart for the buffer a thread caches, the address of a builder may be reused
+    uint64_t generation_;
+};
+
 }  // namespace knowhere
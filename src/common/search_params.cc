@@ -0,0 +1,93 @@
+// Copyright (C) 2019-2023 Zilliz. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file except in compliance
+// with the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
+// or implied. See the License for the specific language governing permissions and limitations under the License.
+
+#include "knowhere/search_params.h"
+
+#include <atomic>
+
+#include "common/lru_cache.h"
+#include "knowhere/comp/result_cache.h"
+
+namespace knowhere {
+
+namespace {
+
+using SearchParamsCache = concurrent_cache<std::string, SearchParamsPtr>;
+
+std::shared_ptr<SearchParamsCache> search_params_cache;
+std::atomic<bool> search_params_cache_enabled{false};
+// few, the cache holds few jsons
+constexpr size_t kCacheShards = 4;
+
+}  // namespace
+
+SearchParams::SearchParams(std::string index_type, PARAM_TYPE param_type, Json json)
+    : index_type_(std::move(index_type)),
+      param_type_(param_type),
+      json_(std::move(json)),
+      config_hash_(ResultCache::HashConfig(json_)),
+      pool_(std::make_shared<Pool>()) {
+}
+
+std::shared_ptr<BaseConfig>
+SearchParams::Lease() const {
+    std::unique_ptr<BaseConfig> cfg;
+    {
+        std::lock_guard lock(pool_->mtx);
+        if (pool_->configs.empty()) {
+            return nullptr;
+        }
+        cfg = std::move(pool_->configs.back());
+        pool_->configs.pop_back();
+    }
+    return Lease(std::move(cfg));
+}
+
+std::shared_ptr<BaseConfig>
+SearchParams::Lease(std::unique_ptr<BaseConfig> cfg) const {
+    // the configs go back to the pool even when the params are gone meanwhile, the pool then frees them
+    return std::shared_ptr<BaseConfig>(cfg.release(), [pool = pool_](BaseConfig* cfg) {
+        cfg->cancellation = nullptr;
+        cfg->result_ids = nullptr;
+        cfg->result_distances = nullptr;
+        cfg->result_lims = nullptr;
+        cfg->result_capacity = 0;
+        std::lock_guard lock(pool->mtx);
+        pool->configs.emplace_back(cfg);
+    });
+}
+
+SearchParamsPtr
+SearchParams::Cached(const std::string& index_type, PARAM_TYPE param_type, const Json& json) {
+    if (!search_params_cache_enabled.load(std::memory_order_relaxed)) {
+        return nullptr;
+    }
+    auto cache = std::atomic_load(&search_params_cache);
+    if (cache == nullptr) {
+        return nullptr;
+    }
+    auto key = index_type + '\0' + std::to_string(param_type) + '\0' + json.dump();
+    SearchParamsPtr params;
+    if (!cache->try_get(key, params)) {
+        params = std::make_shared<SearchParams>(index_type, param_type, json);
+        cache->put(key, params);
+    }
+    return params;
+}
+
+void
+SearchParams::SetCacheCapacity(size_t capacity) {
+    std::atomic_store(&search_params_cache,
+                      capacity > 0 ? std::make_shared<SearchParamsCache>(capacity, kCacheShards) : nullptr);
+    search_params_cache_enabled.store(capacity > 0, std::memory_order_relaxed);
+}
+
+}  // namespace knowhere
@@ -15,6 +15,7 @@
 #include <cmath>
 #include <cstdint>
 
+#include "knowhere/comp/thread_pool.h"
 #include "knowhere/log.h"
 #include "simd/hook.h"
 
@@ -22,6 +23,13 @@ namespace knowhere {
 
 const float FloatAccuracy = 0.00001;
 
+namespace {
+
+// the floats a task of ParallelNormalizeVecs or ConvertToFloat handles at least, a handful of microseconds of work
+constexpr int64_t kNormalizeGrainFloats = int64_t(1) << 16;
+
+}  // namespace
+
 float
 NormalizeVec(float* x, int32_t d) {
     float norm_l2_sqr = faiss::fvec_norm_L2sqr(x, d);
@@ -45,6 +53,16 @@ NormalizeVecs(float* x, size_t rows, int32_t dim) {
     return norms;
 }
 
+std::vector<float>
+ParallelNormalizeVecs(float* x, size_t rows, int32_t dim) {
+    std::vector<float> norms(rows);
+    int64_t grain = std::max<int64_t>(1, kNormalizeGrainFloats / std::max<int32_t>(dim, 1));
+    ThreadPool::GetGlobalBuildThreadPool()->parallel_for(0, rows, grain, [&](int64_t i) {
+        norms[i] = NormalizeVec(x + i * dim, dim);
+    });
+    return norms;
+}
+
 void
 Normalize(const DataSet& dataset) {
     auto rows = dataset.GetRows();
@@ -53,9 +71,7 @@ Normalize(const DataSet& dataset) {
 
     LOG_KNOWHERE_DEBUG_ << "vector normalize, rows " << rows << ", dim " << dim;
 
-    for (int32_t i = 0; i < rows; i++) {
-        NormalizeVec(data + i * dim, dim);
-    }
+    ParallelNormalizeVecs(data, rows, dim);
 }
 
 std::unique_ptr<float[]>
@@ -66,4 +82,52 @@ CopyAndNormalizeFloatVec(const float* x, int32_t dim) {
     return x_norm;
 }
 
+void
+ConvertToFloat(const void* x, DataType type, size_t n, float* out) {
+    switch (type) {
+        case DataType::FP16:
+            faiss::fp16_to_fvec(out, (const uint16_t*)x, n);
+            break;
+        case DataType::BF16:
+            faiss::bf16_to_fvec(out, (const uint16_t*)x, n);
+            break;
+        case DataType::INT8:
+            std::copy_n((const int8_t*)x, n, out);
+            break;
+        case DataType::UINT8:
+            std::copy_n((const uint8_t*)x, n, out);
+            break;
+        default:
+            std::copy_n((const float*)x, n, out);
+            break;
+    }
+}
+
+DataSetPtr
+ConvertToFloat(const DataSet& dataset) {
+    auto rows = dataset.GetRows();
+    auto dim = dataset.GetDim();
+    auto type = dataset.GetDataType();
+    auto data = (const char*)dataset.GetTensor();
+    auto tensor = new float[rows * dim];
+    auto row_size = dim * DataTypeSize(type);
+    int64_t grain = std::max<int64_t>(1, kNormalizeGrainFloats / std::max<int64_t>(dim, 1));
+    ThreadPool::GetGlobalSearchThreadPool()->parallel_for(0, rows, grain, [&](int64_t i) {
+        ConvertToFloat(data + i * row_size, type, dim, tensor + i * dim);
+    });
+
+    auto ret_ds = GenResultDataSet(rows, dim, tensor);
+    if (auto ids = dataset.GetIds(); ids != nullptr) {
+        auto ids_copy = new int64_t[rows];
+        std::copy_n(ids, rows, ids_copy);
+        ret_ds->SetIds(ids_copy);
+    }
+    if (auto norms = dataset.GetNorms(); norms != nullptr) {
+        auto norms_copy = new float[rows];
+        std::copy_n(norms, rows, norms_copy);
+        ret_ds->SetNorms(norms_copy);
+    }
+    return ret_ds;
+}
+
 }  // namespace knowhere
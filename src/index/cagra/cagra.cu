@@ -1,16 +1,69 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <vector>
+
 #include "cagra_config.h"
+#include "common/gpu_metrics.h"
+#include "common/knn_util.h"
+#include "common/raft/raft_results.cuh"
 #include "common/raft/raft_utils.h"
 #include "common/raft_metric.h"
+#include "common/range_util.h"
+#include "faiss/utils/distances.h"
+#include "index/hnsw/hnsw_graph.h"
+#include "knowhere/comp/index_param.h"
+#include "knowhere/device_bitset.h"
+#include "knowhere/factory.h"
 #include "knowhere/index_node.h"
+#include "knowhere/index_node_batching_wrapper.h"
+#include "knowhere/index_node_multi_gpu_wrapper.h"
+#include "knowhere/index_node_thread_pool_wrapper.h"
 #include "knowhere/log.h"
+#include "knowhere/utils.h"
 #include "raft/neighbors/cagra.cuh"
 #include "raft/neighbors/cagra_serialize.cuh"
+#include "thrust/logical.h"
+
+constexpr uint32_t cuda_concurrent_size = 16;
+
 namespace knowhere {
 
 using idx_type = uint32_t;
 
 using cagra_index = raft::neighbors::experimental::cagra::index<float, idx_type>;
 
+namespace cagra_detail {
+// the largest k a search asks CAGRA for, filtered searches grow their k up to it
+auto constexpr static const MAX_CAGRA_K = 1024;
+
+// The ids of CAGRA to the ids of knowhere. An id past the index, a slot the search could not fill, becomes the largest
+// int64, which postprocess_device_results drops.
+__global__ void
+widen_ids(int64_t* out, const idx_type* in, int64_t n, int64_t counts) {
+    for (auto i = int64_t{blockIdx.x} * blockDim.x + threadIdx.x; i < n; i += int64_t{blockDim.x} * gridDim.x) {
+        out[i] = in[i] < counts ? int64_t{in[i]} : std::numeric_limits<int64_t>::max();
+    }
+}
+
+// copies the first dim columns of the rows ids of in, of which the rows are in_stride apart
+__global__ void
+gather_rows(float* out, const float* in, const int64_t* ids, int64_t rows, int64_t dim, int64_t in_stride) {
+    for (auto i = int64_t{blockIdx.x} * blockDim.x + threadIdx.x; i < rows * dim;
+         i += int64_t{blockDim.x} * gridDim.x) {
+        out[i] = in[ids[i / dim] * in_stride + i % dim];
+    }
+}
+}  // namespace cagra_detail
+
+/**
+ * CAGRA builds an L2 graph only. Inner products are searched on vectors with one more dimension, sqrt(M - |x|^2) for a
+ * base vector, M the largest squared norm, and 0 for a query: the L2 distance between them is |q|^2 + M - 2 q.x, the
+ * closer the larger the inner product, which the search turns back into q.x. COSINE is the same on normalized vectors.
+ */
 class CagraIndexNode : public IndexNode {
  public:
     CagraIndexNode(const Object& object) : devs_{}, gpu_index_{} {
@@ -27,34 +80,80 @@ class CagraIndexNode : public IndexNode {
             LOG_KNOWHERE_WARNING_ << "Cagra implementation is single-GPU only" << std::endl;
             return Status::raft_inner_error;
         }
-        auto metric = Str2RaftMetricType(cagra_cfg.metric_type.value());
-        if (!metric.has_value()) {
-            LOG_KNOWHERE_WARNING_ << "please check metric value: " << cagra_cfg.metric_type.value();
-            return metric.error();
-        }
-        if (metric.value() != raft::distance::DistanceType::L2Expanded) {
-            LOG_KNOWHERE_WARNING_ << "only support L2Expanded metric type";
+        auto& metric_type = cagra_cfg.metric_type.value();
+        bool is_cosine = IsMetricType(metric_type, metric::COSINE);
+        bool is_ip = is_cosine || IsMetricType(metric_type, metric::IP);
+        if (!is_ip && !IsMetricType(metric_type, metric::L2)) {
+            LOG_KNOWHERE_WARNING_ << "selected metric not supported in CAGRA: " << metric_type;
             return Status::invalid_metric_type;
         }
-        devs_.insert(devs_.begin(), cagra_cfg.gpu_ids.value().begin(), cagra_cfg.gpu_ids.value().end());
-        auto scoped_device = raft_utils::device_setter{*cagra_cfg.gpu_ids.begin()};
-        auto build_params = raft::neighbors::experimental::cagra::index_params{};
-        build_params.intermediate_graph_degree = cagra_cfg.intermediate_graph_degree.value();
-        build_params.graph_degree = cagra_cfg.graph_degree.value();
-        build_params.metric = metric.value();
-        auto& res = raft_utils::get_raft_resources();
         auto rows = dataset.GetRows();
         auto dim = dataset.GetDim();
         auto* data = reinterpret_cast<float const*>(dataset.GetTensor());
-        auto data_gpu = raft::make_device_matrix<float, idx_type>(res, rows, dim);
-        RAFT_CUDA_TRY(cudaMemcpyAsync(data_gpu.data_handle(), data, data_gpu.size() * sizeof(float), cudaMemcpyDefault,
-                                      res.get_stream().value()));
-        gpu_index_ = raft::neighbors::experimental::cagra::build(
-            res, build_params,
-            raft::make_device_matrix_view<const float, idx_type>((const float*)data_gpu.data_handle(), rows, dim));
-        this->dim_ = dim;
-        this->counts_ = rows;
-        res.sync_stream();
+        auto build_dim = is_ip ? dim + 1 : dim;
+
+        std::vector<float> normalized;
+        std::vector<float> extra;
+        float max_norm_sq = 0.0f;
+        if (is_cosine) {
+            normalized.assign(data, data + rows * dim);
+            NormalizeVecs(normalized.data(), rows, dim);
+            data = normalized.data();
+        }
+        if (is_ip) {
+            extra.resize(rows);
+            for (int64_t i = 0; i < rows; ++i) {
+                extra[i] = faiss::fvec_norm_L2sqr(data + i * dim, dim);
+                max_norm_sq = std::max(max_norm_sq, extra[i]);
+            }
+            for (auto& x : extra) {
+                x = std::sqrt(std::max(0.0f, max_norm_sq - x));
+            }
+        }
+
+        try {
+            devs_.assign(cagra_cfg.gpu_ids.value().begin(), cagra_cfg.gpu_ids.value().end());
+            auto scoped_device = raft_utils::device_setter{devs_[0]};
+            raft_utils::init_gpu_resources();
+            auto& res = raft_utils::get_build_resources();
+            auto build_params = raft::neighbors::experimental::cagra::index_params{};
+            build_params.intermediate_graph_degree = cagra_cfg.intermediate_graph_degree.value();
+            build_params.graph_degree = cagra_cfg.graph_degree.value();
+            build_params.metric = raft::distance::DistanceType::L2Expanded;
+            auto data_gpu = raft::make_device_matrix<float, idx_type>(res, rows, build_dim);
+            // the graph is built over all the data on the device, it only arrives through pinned memory in chunks
+            raft_utils::stream_to_device(
+                res, data, rows, dim, cagra_cfg.build_chunk_rows.value(),
+                [&](int64_t first, const float* chunk, int64_t n) {
+                    RAFT_CUDA_TRY(cudaMemcpy2DAsync(data_gpu.data_handle() + first * build_dim,
+                                                    build_dim * sizeof(float), chunk, dim * sizeof(float),
+                                                    dim * sizeof(float), n, cudaMemcpyDeviceToDevice,
+                                                    res.get_stream().value()));
+                });
+            if (is_ip) {
+                RAFT_CUDA_TRY(cudaMemcpy2DAsync(data_gpu.data_handle() + dim, build_dim * sizeof(float), extra.data(),
+                                                sizeof(float), sizeof(float), rows, cudaMemcpyDefault,
+                                                res.get_stream().value()));
+            }
+            gpu_index_ = raft::neighbors::experimental::cagra::build(
+                res, build_params,
+                raft::make_device_matrix_view<const float, idx_type>((const float*)data_gpu.data_handle(), rows,
+                                                                     build_dim));
+            res.sync_stream();
+            GetGpuMetrics(Type()).h2d_bytes.Increment(rows * build_dim * sizeof(float));
+            raft_utils::report_memory_pool();
+        } catch (std::exception& e) {
+            LOG_KNOWHERE_WARNING_ << "RAFT inner error, " << e.what();
+            gpu_index_.reset();
+            return Status::raft_inner_error;
+        }
+        dim_ = dim;
+        counts_ = rows;
+        is_ip_ = is_ip;
+        is_cosine_ = is_cosine;
+        max_norm_sq_ = max_norm_sq;
+        adapt_for_cpu_ = cagra_cfg.adapt_for_cpu.value();
+        return Status::success;
     }
 
     Status
@@ -64,58 +163,110 @@ class CagraIndexNode : public IndexNode {
 
     expected<DataSetPtr>
     Search(const DataSet& dataset, const Config& cfg, const BitsetView& bitset) const override {
+        if (!gpu_index_) {
+            LOG_KNOWHERE_WARNING_ << "search on empty index";
+            return expected<DataSetPtr>::Err(Status::empty_index, "index not loaded");
+        }
         auto cagra_cfg = static_cast<const CagraConfig&>(cfg);
         auto rows = dataset.GetRows();
-        auto dim = dataset.GetDim();
-        auto* data = reinterpret_cast<float const*>(dataset.GetTensor());
-        auto output_size = rows * cagra_cfg.k.value();
-        auto ids = std::unique_ptr<idx_type[]>(new idx_type[output_size]);
-        auto dis = std::unique_ptr<float[]>(new float[output_size]);
-        try {
-            auto scoped_device = raft_utils::device_setter{devs_[0]};
-            auto& res_ = raft_utils::get_raft_resources();
-
-            auto data_gpu = raft::make_device_matrix<float, idx_type>(res_, rows, dim);
-            raft::copy(data_gpu.data_handle(), data, data_gpu.size(), res_.get_stream());
-
-            auto search_params = raft::neighbors::experimental::cagra::search_params{};
-            search_params.max_queries = cagra_cfg.max_queries.value();
-            auto ids_dev = raft::make_device_matrix<idx_type, idx_type>(*res_, rows, cagra_cfg.k.value());
-            auto dis_dev = raft::make_device_matrix<float, idx_type>(*res_, rows, cagra_cfg.k.value());
-            raft::neighbors::experimental::cagra::search(res_, search_params, *gpu_index_,
-                                                         raft::make_const_mdspan(data_gpu.view()), ids_dev.view(),
-                                                         dis_dev.view());
-
-            raft::copy(ids.get(), ids_dev.data_handle(), output_size, res_.get_stream());
-            raft::copy(dis.get(), dis_dev.data_handle(), output_size, res_.get_stream());
-            res_.sync_stream();
-
-        } catch (std::exception& e) {
-            LOG_KNOWHERE_WARNING_ << "RAFT inner error, " << e.what();
-            return Status::raft_inner_error;
+        auto k = cagra_cfg.k.value();
+        KnnResultBuffers buffers(cagra_cfg, rows * k);
+        auto status = SearchOnDevice(reinterpret_cast<const float*>(dataset.GetTensor()), rows, k, cagra_cfg, bitset,
+                                     buffers.ids, buffers.distances);
+        if (status != Status::success) {
+            buffers.Free();
+            return expected<DataSetPtr>::Err(status, "CAGRA search failed");
         }
-        return Status::not_implemented;
-        //        return GenResultDataSet(rows, cagra_cfg.k, ids.release(), dis.release());
+        return buffers.ToDataSet(rows, k);
     }
 
+    // A knn search of the largest k CAGRA takes, or max_results, of which the hits in range are kept: a query finds
+    // at most that many.
     expected<DataSetPtr>
     RangeSearch(const DataSet& dataset, const Config& cfg, const BitsetView& bitset) const override {
-        return Status::not_implemented;
+        if (!gpu_index_) {
+            LOG_KNOWHERE_WARNING_ << "range search on empty index";
+            return expected<DataSetPtr>::Err(Status::empty_index, "index not loaded");
+        }
+        auto cagra_cfg = static_cast<const CagraConfig&>(cfg);
+        auto rows = dataset.GetRows();
+        int64_t max_results = cagra_cfg.max_results.value();
+        int64_t k = max_results > 0 ? std::min<int64_t>(max_results, cagra_detail::MAX_CAGRA_K)
+                                    : cagra_detail::MAX_CAGRA_K;
+        k = std::min(k, counts_);
+        std::vector<int64_t> knn_ids(rows * k);
+        std::vector<float> knn_dis(rows * k);
+        auto status = SearchOnDevice(reinterpret_cast<const float*>(dataset.GetTensor()), rows, k, cagra_cfg, bitset,
+                                     knn_ids.data(), knn_dis.data());
+        if (status != Status::success) {
+            return expected<DataSetPtr>::Err(status, "CAGRA search failed");
+        }
+
+        float radius = cagra_cfg.radius.value();
+        float range_filter = cagra_cfg.range_filter.value();
+        if (range_filter == defaultRangeFilter) {
+            range_filter = is_ip_ ? std::numeric_limits<float>::infinity() : -std::numeric_limits<float>::infinity();
+        }
+        RangeSearchResultBuilder results(rows, max_results, is_ip_);
+        for (int64_t i = 0; i < rows; ++i) {
+            auto ids = knn_ids.data() + i * k;
+            auto n = std::find(ids, ids + k, -1) - ids;
+            results.Query(i).Append(knn_dis.data() + i * k, ids, n, true, is_ip_, radius, range_filter);
+        }
+        int64_t* ids = nullptr;
+        float* distances = nullptr;
+        size_t* lims = nullptr;
+        auto owned = results.Build(cagra_cfg, distances, ids, lims);
+        auto res = GenResultDataSet(rows, ids, distances, lims);
+        res->SetIsOwner(owned);
+        return res;
     }
 
     expected<DataSetPtr>
     GetVectorByIds(const DataSet& dataset) const override {
-        return Status::not_implemented;
+        if (!gpu_index_) {
+            return expected<DataSetPtr>::Err(Status::empty_index, "index not loaded");
+        }
+        if (is_cosine_) {
+            return expected<DataSetPtr>::Err(Status::not_implemented, "CAGRA holds COSINE vectors normalized");
+        }
+        auto rows = dataset.GetRows();
+        auto ids = dataset.GetIds();
+        for (int64_t i = 0; i < rows; ++i) {
+            if (ids[i] < 0 || ids[i] >= counts_) {
+                return expected<DataSetPtr>::Err(Status::invalid_args, "id out of range");
+            }
+        }
+        auto data = std::make_unique<float[]>(rows * dim_);
+        try {
+            auto scoped_device = raft_utils::device_setter{devs_[0]};
+            auto& res = raft_utils::get_raft_resources();
+            auto ids_gpu = raft::make_device_vector<int64_t, int64_t>(res, rows);
+            raft::copy(ids_gpu.data_handle(), ids, rows, res.get_stream());
+            auto out_gpu = raft::make_device_matrix<float, int64_t>(res, rows, dim_);
+            auto vectors = gpu_index_->dataset();
+            if (rows > 0) {
+                cagra_detail::gather_rows<<<1024, 256, 0, res.get_stream().value()>>>(
+                    out_gpu.data_handle(), vectors.data_handle(), ids_gpu.data_handle(), rows, dim_,
+                    vectors.stride(0));
+            }
+            raft::copy(data.get(), out_gpu.data_handle(), rows * dim_, res.get_stream());
+            res.sync_stream();
+        } catch (std::exception& e) {
+            LOG_KNOWHERE_WARNING_ << "RAFT inner error, " << e.what();
+            return expected<DataSetPtr>::Err(Status::raft_inner_error, e.what());
+        }
+        return GenResultDataSet(rows, dim_, data.release());
     }
 
     bool
     HasRawData(const std::string& metric_type) const override {
-        return false;
+        return !IsMetricType(metric_type, metric::COSINE);
     }
 
     expected<DataSetPtr>
     GetIndexMeta(const Config& cfg) const override {
-        return Status::not_implemented;
+        return expected<DataSetPtr>::Err(Status::not_implemented, "GetIndexMeta not implemented");
     }
 
     Status
@@ -129,6 +280,10 @@ class CagraIndexNode : public IndexNode {
         os.write((char*)(&this->dim_), sizeof(this->dim_));
         os.write((char*)(&this->counts_), sizeof(this->counts_));
         os.write((char*)(&this->devs_[0]), sizeof(this->devs_[0]));
+        os.write((char*)(&this->is_ip_), sizeof(this->is_ip_));
+        os.write((char*)(&this->is_cosine_), sizeof(this->is_cosine_));
+        os.write((char*)(&this->max_norm_sq_), sizeof(this->max_norm_sq_));
+        os.write((char*)(&this->adapt_for_cpu_), sizeof(this->adapt_for_cpu_));
 
         auto scoped_device = raft_utils::device_setter{devs_[0]};
         rmm::mr::cuda_memory_resource mr;
@@ -142,6 +297,9 @@ class CagraIndexNode : public IndexNode {
 
         memcpy(index_binary.get(), buf.str().c_str(), buf.str().size());
         binset.Append(this->Type(), index_binary, buf.str().size());
+        if (adapt_for_cpu_) {
+            return SerializeForCpu(res, binset);
+        }
         return Status::success;
     }
 
@@ -153,6 +311,14 @@ class CagraIndexNode : public IndexNode {
             LOG_KNOWHERE_ERROR_ << "Invalid binary set.";
             return Status::invalid_binary_set;
         }
+        int devices = 0;
+        if (cudaGetDeviceCount(&devices) != cudaSuccess || devices == 0) {
+            LOG_KNOWHERE_ERROR_ << "No GPU to load CAGRA on"
+                                << (binset.Contains(IndexEnum::INDEX_HNSW)
+                                        ? ", load the binary set as " + std::string(IndexEnum::INDEX_HNSW) + " instead"
+                                        : ", build it with adapt_for_cpu to serve it on CPU");
+            return Status::raft_inner_error;
+        }
         buf.sputn((char*)binary->data.get(), binary->size);
         std::istream is(&buf);
 
@@ -160,11 +326,21 @@ class CagraIndexNode : public IndexNode {
         is.read((char*)(&this->counts_), sizeof(this->counts_));
         this->devs_.resize(1);
         is.read((char*)(&this->devs_[0]), sizeof(this->devs_[0]));
+        is.read((char*)(&this->is_ip_), sizeof(this->is_ip_));
+        is.read((char*)(&this->is_cosine_), sizeof(this->is_cosine_));
+        is.read((char*)(&this->max_norm_sq_), sizeof(this->max_norm_sq_));
+        is.read((char*)(&this->adapt_for_cpu_), sizeof(this->adapt_for_cpu_));
+        auto& cagra_cfg = static_cast<const knowhere::CagraConfig&>(config);
+        if (cagra_cfg.gpu_id.value() >= 0) {
+            this->devs_[0] = cagra_cfg.gpu_id.value();
+        }
         auto scoped_device = raft_utils::device_setter{devs_[0]};
 
+        raft_utils::init_gpu_resources();
         auto& res = raft_utils::get_raft_resources();
 
         cagra_index index_ = raft::neighbors::experimental::cagra::deserialize<float, idx_type>(res, is);
+        res.sync_stream();
         is.sync();
         gpu_index_ = cagra_index(std::move(index_));
 
@@ -173,6 +349,8 @@ class CagraIndexNode : public IndexNode {
 
     Status
     DeserializeFromFile(const std::string& filename, const Config& config) override {
+        LOG_KNOWHERE_ERROR_ << "RaftCagraIndex doesn't support Deserialization from file.";
+        return Status::not_implemented;
     }
 
     std::unique_ptr<BaseConfig>
@@ -187,7 +365,21 @@ class CagraIndexNode : public IndexNode {
 
     int64_t
     Size() const override {
-        return 0;
+        if (!gpu_index_) {
+            return 0;
+        }
+        return counts_ * ((is_ip_ ? dim_ + 1 : dim_) * sizeof(float) + gpu_index_->graph_degree() * sizeof(idx_type));
+    }
+
+    MemoryUsage
+    GetMemoryUsage() const override {
+        MemoryUsage usage;
+        if (!gpu_index_) {
+            return usage;
+        }
+        usage.Add(MemoryUsage::kVectors, MemoryUsage::kDevice, counts_ * (is_ip_ ? dim_ + 1 : dim_) * sizeof(float));
+        usage.Add(MemoryUsage::kGraph, MemoryUsage::kDevice, counts_ * gpu_index_->graph_degree() * sizeof(idx_type));
+        return usage;
     }
 
     int64_t
@@ -197,14 +389,194 @@ class CagraIndexNode : public IndexNode {
 
     std::string
     Type() const override {
-        return knowhere::IndexEnum::INDEX_RAFT_IVFFLAT;
+        return knowhere::IndexEnum::INDEX_RAFT_CAGRA;
     }
 
  private:
     std::vector<int32_t> devs_;
     int64_t dim_ = 0;
     int64_t counts_ = 0;
+    // IP and COSINE search the vectors extended by a dimension, see above
+    bool is_ip_ = false;
+    bool is_cosine_ = false;
+    float max_norm_sq_ = 0.0f;
+    bool adapt_for_cpu_ = false;
     std::optional<cagra_index> gpu_index_;
+    mutable DeviceBitsetCache bitset_cache_;
+
+    // k results a query into ids and distances, the ids the bitset filters out or the search could not find are -1
+    Status
+    SearchOnDevice(const float* queries, int64_t rows, int64_t k, const CagraConfig& cfg, const BitsetView& bitset,
+                   int64_t* ids, float* distances) const {
+        auto search_dim = is_ip_ ? dim_ + 1 : dim_;
+        std::vector<float> normalized;
+        if (is_cosine_) {
+            normalized.assign(queries, queries + rows * dim_);
+            NormalizeVecs(normalized.data(), rows, dim_);
+            queries = normalized.data();
+        }
+        try {
+            auto scoped_device = raft_utils::device_setter{devs_[0]};
+            auto& res = raft_utils::get_raft_resources();
+            auto stream = res.get_stream().value();
+            GpuStageTimer timer(GetGpuMetrics(Type()));
+
+            auto queries_gpu = raft::make_device_matrix<float, idx_type>(res, rows, search_dim);
+            if (is_ip_) {
+                RAFT_CUDA_TRY(
+                    cudaMemsetAsync(queries_gpu.data_handle(), 0, queries_gpu.size() * sizeof(float), stream));
+            }
+            timer.Time(GpuStageTimer::kH2D, stream, [&] {
+                RAFT_CUDA_TRY(cudaMemcpy2DAsync(queries_gpu.data_handle(), search_dim * sizeof(float), queries,
+                                                dim_ * sizeof(float), dim_ * sizeof(float), rows, cudaMemcpyDefault,
+                                                stream));
+            });
+            timer.H2D(rows * dim_ * sizeof(float));
+
+            // the device reads the bits of the filter
+            std::vector<uint8_t> dense_bits;
+            auto gpu_bitset = bitset_cache_.Get(res, devs_[0], bitset.to_dense(dense_bits), cfg.filter_version.value());
+            auto max_k = std::min(counts_, int64_t{cagra_detail::MAX_CAGRA_K});
+            auto search_k = std::min(k + (bitset.count() * k / counts_), max_k);
+            auto gpu_results = timer.Time(GpuStageTimer::kKernel, stream, [&] {
+                return RawSearch(res, raft::make_const_mdspan(queries_gpu.view()), cfg, std::max(search_k, k), k,
+                                 gpu_bitset->view());
+            });
+            if (gpu_results.k() != k) {
+                auto new_gpu_results = raft_detail::raft_results{res, gpu_results.rows(), k};
+                timer.Time(GpuStageTimer::kSlice, stream, [&] {
+                    raft_detail::slice<<<1024, 256, 0, stream>>>(new_gpu_results.ids_data(), gpu_results.ids_data(),
+                                                                 new_gpu_results.rows(), new_gpu_results.k(),
+                                                                 gpu_results.rows(), gpu_results.k());
+                    raft_detail::slice<<<1024, 256, 0, stream>>>(new_gpu_results.dists_data(),
+                                                                 gpu_results.dists_data(), new_gpu_results.rows(),
+                                                                 new_gpu_results.k(), gpu_results.rows(),
+                                                                 gpu_results.k());
+                });
+                timer.Sync([&] { res.sync_stream(); });
+                gpu_results = new_gpu_results;
+            }
+            timer.Time(GpuStageTimer::kD2H, stream, [&] {
+                raft::copy(ids, gpu_results.ids_data(), rows * k, res.get_stream());
+                raft::copy(distances, gpu_results.dists_data(), rows * k, res.get_stream());
+            });
+            timer.D2H(rows * k * (sizeof(int64_t) + sizeof(float)));
+            timer.Sync([&] { res.sync_stream(); });
+            raft_utils::report_memory_pool();
+        } catch (std::exception& e) {
+            LOG_KNOWHERE_WARNING_ << "RAFT inner error, " << e.what();
+            return Status::raft_inner_error;
+        }
+
+        if (is_ip_) {
+            // |q|^2 + M - 2 q.x back to q.x
+            for (int64_t i = 0; i < rows; ++i) {
+                float query_norm_sq = faiss::fvec_norm_L2sqr(queries + i * dim_, dim_);
+                for (int64_t j = i * k; j < (i + 1) * k; ++j) {
+                    if (ids[j] != -1) {
+                        distances[j] = (query_norm_sq + max_norm_sq_ - distances[j]) / 2;
+                    }
+                }
+            }
+        }
+        return Status::success;
+    }
+
+    // Searches with k, doubling it while a query has fewer than target_k results the bitset keeps.
+    raft_detail::raft_results
+    RawSearch(raft::device_resources& res, raft::device_matrix_view<const float, idx_type> queries,
+              const CagraConfig& cfg, int64_t k, int64_t target_k, DeviceBitsetView const& bitset) const {
+        auto max_k = std::min(counts_, int64_t{cagra_detail::MAX_CAGRA_K});
+        auto rows = queries.extent(0);
+        auto search_params = raft::neighbors::experimental::cagra::search_params{};
+        search_params.max_queries = cfg.max_queries.value();
+        search_params.itopk_size = std::max<int64_t>(cfg.itopk_size.value(), k);
+        auto ids_dev = raft::make_device_matrix<idx_type, idx_type>(res, rows, k);
+        auto dis_dev = raft::make_device_matrix<float, idx_type>(res, rows, k);
+        raft::neighbors::experimental::cagra::search(res, search_params, *gpu_index_, queries, ids_dev.view(),
+                                                     dis_dev.view());
+
+        auto result = raft_detail::raft_results{res, rows, k};
+        cagra_detail::widen_ids<<<1024, 256, 0, res.get_stream().value()>>>(result.ids_data(), ids_dev.data_handle(),
+                                                                            rows * k, counts_);
+        raft::copy(result.dists_data(), dis_dev.data_handle(), rows * k, res.get_stream());
+
+        auto blocks = std::min(int64_t{rows}, int64_t{1024});
+        auto threads = std::min(int(k), 256);
+        auto warp_remainder = threads % 32;
+        if (warp_remainder != 0) {
+            threads += (32 - warp_remainder);
+        }
+        auto enough_valid = raft::make_device_vector<bool>(res, rows);
+        raft_detail::postprocess_device_results<<<blocks, threads, 0, res.get_stream().value()>>>(
+            enough_valid.data_handle(), result.ids_data(), result.dists_data(), rows, k, target_k, bitset);
+
+        if (k < max_k && !thrust::all_of(res.get_thrust_policy(), enough_valid.data_handle(),
+                                         enough_valid.data_handle() + rows, thrust::identity<bool>())) {
+            result = RawSearch(res, queries, cfg, std::min(k * 2, max_k), target_k, bitset);
+        }
+        return result;
+    }
+
+    // The graph and the vectors as an HNSW index of one level, under the binary name of HNSW.
+    Status
+    SerializeForCpu(raft::device_resources& res, BinarySet& binset) const {
+        auto graph = gpu_index_->graph();
+        auto vectors = gpu_index_->dataset();
+        auto degree = graph.extent(1);
+        std::vector<idx_type> host_graph(counts_ * degree);
+        std::vector<float> host_vectors(counts_ * dim_);
+        try {
+            raft::copy(host_graph.data(), graph.data_handle(), host_graph.size(), res.get_stream());
+            RAFT_CUDA_TRY(cudaMemcpy2DAsync(host_vectors.data(), dim_ * sizeof(float), vectors.data_handle(),
+                                            vectors.stride(0) * sizeof(float), dim_ * sizeof(float), counts_,
+                                            cudaMemcpyDefault, res.get_stream().value()));
+            res.sync_stream();
+        } catch (std::exception& e) {
+            LOG_KNOWHERE_WARNING_ << "RAFT inner error, " << e.what();
+            return Status::raft_inner_error;
+        }
+        auto metric_type = is_cosine_ ? metric::COSINE : is_ip_ ? metric::IP : metric::L2;
+        return SerializeGraphAsHnsw(host_vectors.data(), host_graph.data(), counts_, dim_, degree, metric_type,
+                                    binset);
+    }
 };
 
+// The graph of CAGRA, pruned from its intermediate kNN graph of twice the degree, built on the current device.
+expected<std::vector<uint32_t>>
+BuildCagraKnnGraph(const float* data, int64_t rows, int64_t dim, int64_t k, bool is_cosine) {
+    std::vector<float> normalized;
+    if (is_cosine) {
+        normalized.assign(data, data + rows * dim);
+        NormalizeVecs(normalized.data(), rows, dim);
+        data = normalized.data();
+    }
+    std::vector<idx_type> graph(rows * k);
+    try {
+        raft_utils::init_gpu_resources();
+        auto& res = raft_utils::get_build_resources();
+        auto build_params = raft::neighbors::experimental::cagra::index_params{};
+        build_params.intermediate_graph_degree = 2 * k;
+        build_params.graph_degree = k;
+        build_params.metric = raft::distance::DistanceType::L2Expanded;
+        auto data_gpu = raft::make_device_matrix<float, idx_type>(res, rows, dim);
+        raft::copy(data_gpu.data_handle(), data, rows * dim, res.get_stream());
+        auto index = raft::neighbors::experimental::cagra::build(
+            res, build_params,
+            raft::make_device_matrix_view<const float, idx_type>((const float*)data_gpu.data_handle(), rows, dim));
+        raft::copy(graph.data(), index.graph().data_handle(), graph.size(), res.get_stream());
+        res.sync_stream();
+    } catch (std::exception& e) {
+        LOG_KNOWHERE_WARNING_ << "RAFT inner error, " << e.what();
+        return expected<std::vector<uint32_t>>::Err(Status::raft_inner_error, e.what());
+    }
+    return graph;
+}
+
+KNOWHERE_REGISTER_GLOBAL(GPU_RAFT_CAGRA, [](const Object& object) {
+    return Index<IndexNodeBatchingWrapper>::Create(std::make_unique<IndexNodeThreadPoolWrapper>(
+        std::make_unique<IndexNodeMultiGpuWrapper>([]() { return std::make_unique<CagraIndexNode>(nullptr); }),
+        cuda_concurrent_size));
+});
+
 }  // namespace knowhere
@@ -14,16 +14,30 @@
  * See the License for the specific language governing permissions and
  * limitations under the License.
  */
+#ifndef CAGRA_CONFIG_H
+#define CAGRA_CONFIG_H
+
 #include "knowhere/config.h"
+
 namespace knowhere {
 
 class CagraConfig : public BaseConfig {
  public:
     CFG_INT intermediate_graph_degree;
     CFG_INT graph_degree;
+    CFG_INT build_chunk_rows;
     CFG_LIST gpu_ids;
+    CFG_STRING multi_gpu_mode;
+    CFG_INT gpu_id;
     CFG_INT max_queries;
+    CFG_INT itopk_size;
+    CFG_BOOL adapt_for_cpu;
     KNOHWERE_DECLARE_CONFIG(CagraConfig) {
+        KNOWHERE_CONFIG_DECLARE_FIELD(k)
+            .set_default(10)
+            .description("search for top k similar vector.")
+            .set_range(1, 1024)
+            .for_search();
         KNOWHERE_CONFIG_DECLARE_FIELD(intermediate_graph_degree)
             .set_default(128)
             .description("degree of input graph for pruning.")
@@ -32,16 +46,41 @@ class CagraConfig : public BaseConfig {
         KNOWHERE_CONFIG_DECLARE_FIELD(graph_degree)
             .set_default(64)
             .description("degree of output graph.")
-            .for_search()
+            .for_train()
             .set_range(1, 65536);
+        KNOWHERE_CONFIG_DECLARE_FIELD(build_chunk_rows)
+            .description("rows of the data streamed to the gpu at a time through pinned memory")
+            .set_default(65536)
+            .set_range(1, std::numeric_limits<CFG_INT::value_type>::max())
+            .for_train();
         KNOWHERE_CONFIG_DECLARE_FIELD(gpu_ids)
-            .description("gpu device ids")
+            .description("gpu device ids, the index is replicated or sharded over several of them")
             .set_default({
                 0,
             })
             .for_train();
+        KNOWHERE_CONFIG_DECLARE_FIELD(multi_gpu_mode)
+            .description("how the index spans several gpu_ids: replicated or sharded")
+            .set_default("replicated")
+            .for_train();
+        KNOWHERE_CONFIG_DECLARE_FIELD(gpu_id)
+            .description("gpu device the index is loaded onto, -1 for the one it was built on")
+            .set_default(-1)
+            .for_deserialize();
         KNOWHERE_CONFIG_DECLARE_FIELD(max_queries).description("query batch size.").set_default(1).for_search();
+        KNOWHERE_CONFIG_DECLARE_FIELD(itopk_size)
+            .description("candidates kept by the search, raised to k when smaller.")
+            .set_default(64)
+            .set_range(1, 1024)
+            .for_search()
+            .for_range_search();
+        KNOWHERE_CONFIG_DECLARE_FIELD(adapt_for_cpu)
+            .description("also serialize the graph as an HNSW index a host without GPU can load.")
+            .set_default(false)
+            .for_train();
     }
 };
 
 }  // namespace knowhere
+
+#endif /* CAGRA_CONFIG_H */
@@ -11,19 +11,33 @@
 
 #include <omp.h>
 
+#include <algorithm>
+#include <atomic>
 #include <cstdint>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <shared_mutex>
+#include <thread>
 
+#include "common/knn_util.h"
 #include "common/range_util.h"
 #include "diskann/aux_utils.h"
 #include "diskann/pq_flash_index.h"
 #include "fmt/core.h"
 #include "index/diskann/diskann_config.h"
+#include "knowhere/comp/cancellation.h"
 #include "knowhere/comp/index_param.h"
+#include "knowhere/comp/query_trace.h"
 #include "knowhere/comp/thread_pool.h"
 #include "knowhere/dataset.h"
 #include "knowhere/expected.h"
 #ifndef _WINDOWS
+#include "diskann/coalescing_aligned_file_reader.h"
+#include "diskann/io_uring_aligned_file_reader.h"
 #include "diskann/linux_aligned_file_reader.h"
+#include "diskann/sector_buffer_pool.h"
+#include "diskann/striped_aligned_file_reader.h"
 #else
 #include "diskann/windows_aligned_file_reader.h"
 #endif
@@ -31,6 +45,7 @@
 #include "knowhere/feder/DiskANN.h"
 #include "knowhere/file_manager.h"
 #include "knowhere/log.h"
+#include "knowhere/prometheus_client.h"
 #include "knowhere/utils.h"
 
 namespace knowhere {
@@ -47,6 +62,26 @@ class DiskANNIndexNode : public IndexNode {
         file_manager_ = diskann_index_pack->GetPack();
     }
 
+    ~DiskANNIndexNode() {
+        stop_prepare_.store(true);
+        if (prepare_thread_.joinable()) {
+            prepare_thread_.join();
+        }
+        if (merge_thread_.joinable()) {
+            merge_thread_.join();
+        }
+        {
+            std::scoped_lock lock(hot_mutex_);
+            if (hot_thread_.joinable()) {
+                hot_thread_.join();
+            }
+        }
+        pq_flash_index_.reset();
+        for (auto& stripe_file : stripe_files_) {
+            std::remove(stripe_file.c_str());
+        }
+    }
+
     Status
     Build(const DataSet& dataset, const Config& cfg) override;
 
@@ -55,10 +90,14 @@ class DiskANNIndexNode : public IndexNode {
         return Status::not_implemented;
     }
 
+    // Inserts and deletes on the loaded index, see streaming_merge_ratio: the rows added go to an in-memory HNSW
+    // index with the ids following the ones of the disk index, the searches merge its results with the ones of the
+    // disk index.
     Status
-    Add(const DataSet& dataset, const Config& cfg) override {
-        return Status::not_implemented;
-    }
+    Add(const DataSet& dataset, const Config& cfg) override;
+
+    Status
+    DeleteByIds(const DataSet& dataset) override;
 
     expected<DataSetPtr>
     Search(const DataSet& dataset, const Config& cfg, const BitsetView& bitset) const override;
@@ -69,6 +108,9 @@ class DiskANNIndexNode : public IndexNode {
     expected<DataSetPtr>
     GetVectorByIds(const DataSet& dataset) const override;
 
+    folly::Future<expected<DataSetPtr>>
+    GetVectorByIdsAsync(const DataSet& dataset) const override;
+
     bool
     HasRawData(const std::string& metric_type) const override {
         return IsMetricType(metric_type, metric::L2) || IsMetricType(metric_type, metric::COSINE);
@@ -92,6 +134,17 @@ class DiskANNIndexNode : public IndexNode {
         return Status::not_implemented;
     }
 
+    void
+    SetSearchPool(std::shared_ptr<ThreadPool> pool) override {
+        search_pool_ = std::move(pool);
+    }
+
+    std::shared_ptr<ThreadPool>
+    AsyncSearchPool() const override {
+        // not loaded yet, the search fails on its own
+        return search_pool_ ? search_pool_ : IndexNode::AsyncSearchPool();
+    }
+
     std::unique_ptr<BaseConfig>
     CreateConfig() const override {
         return std::make_unique<DiskANNConfig>();
@@ -118,17 +171,38 @@ class DiskANNIndexNode : public IndexNode {
 
     int64_t
     Size() const override {
-        LOG_KNOWHERE_ERROR_ << "Size() function has not been implemented yet.";
-        return 0;
+        return GetMemoryUsage().Total();
     }
 
+    MemoryUsage
+    GetMemoryUsage() const override {
+        if (!is_prepared_.load()) {
+            return MemoryUsage();
+        }
+        auto usage = pq_flash_index_->get_memory_usage();
+        std::shared_lock lock(fresh_mutex_);
+        if (delta_rows_.load() > 0) {
+            usage += delta_.GetMemoryUsage();
+        }
+        usage.Add(MemoryUsage::kOther, MemoryUsage::kHeap, deleted_.capacity());
+        if (auto hot = std::atomic_load(&hot_tier_); hot != nullptr) {
+            usage += hot->index.GetMemoryUsage();
+        }
+        return usage;
+    }
+
+    // The nodes are read from disk rather than mapped, the sample queries of the index are searched instead to bring
+    // them into the caches; the budget does not apply and progress counts queries.
+    Status
+    Warmup(int64_t budget, const WarmupProgress& progress) const override;
+
     int64_t
     Count() const override {
         if (count_.load() == -1) {
             LOG_KNOWHERE_ERROR_ << "Count() function is not supported when index is not ready yet.";
             return 0;
         }
-        return count_.load();
+        return count_.load() + delta_rows_.load();
     }
 
     std::string
@@ -146,6 +220,15 @@ class DiskANNIndexNode : public IndexNode {
         return true;
     }
 
+    bool
+    LoadFiles(const std::vector<std::string>& filenames) {
+        if (!file_manager_->LoadFiles(filenames)) {
+            LOG_KNOWHERE_ERROR_ << "Failed to load the files of " << index_prefix_ << ".";
+            return false;
+        }
+        return true;
+    }
+
     bool
     AddFile(const std::string& filename) {
         if (!file_manager_->AddFile(filename)) {
@@ -158,6 +241,54 @@ class DiskANNIndexNode : public IndexNode {
     uint64_t
     GetCachedNodeNum(const float cache_dram_budget, const uint64_t data_dim, const uint64_t max_degree);
 
+    Status
+    PrepareCacheAndWarmUp(const DiskANNConfig& prep_conf, float cache_budget_gb, bool lazy);
+
+    // searches the sample queries of the index, which the load fetched along with it when warm_up was set
+    Status
+    SearchSampleQueries(const WarmupProgress& progress) const;
+
+    // the bitset of a search of the disk index, the one of the caller with the deleted points, held by bits
+    BitsetView
+    DiskBitset(const BitsetView& bitset, std::vector<uint8_t>& bits) const;
+
+    // the bitset of a search of the delta index, the bits of the caller past the points of the disk index
+    BitsetView
+    DeltaBitset(const BitsetView& bitset, std::vector<uint8_t>& bits) const;
+
+    // merges the top k of the delta index for the queries into the top k of the disk index in ids and distances
+    Status
+    MergeDeltaResults(const DataSet& dataset, const DiskANNConfig& conf, const BitsetView& bitset, int64_t k,
+                      int64_t* ids, float* distances) const;
+
+    // starts the streaming merge once enough points were deleted since the last one, under fresh_mutex_
+    void
+    MaybeStartStreamingMerge();
+
+    // the hot tier, see hot_tier_memory_mb: the rows of the disk points the searches hit most, in an HNSW index
+    // searched in parallel with the disk index. Rebuilt in the background every kHotTierRebuildQueries queries from
+    // the hits, which halve at every rebuild so that the recent ones weigh more.
+    struct HotTier {
+        Index<IndexNode> index;
+        // the disk ids of its rows
+        std::vector<int64_t> ids;
+    };
+
+    // searches the hot tier for the queries, the results of the rows the bitset of the disk index filters out dropped
+    expected<DataSetPtr>
+    SearchHotTier(const HotTier& hot, const DataSet& dataset, const DiskANNConfig& conf, const BitsetView& disk_bitset,
+                  int64_t k) const;
+
+    // counts the hits of the disk points in the results and starts a rebuild of the hot tier when one is due
+    void
+    RecordHits(const int64_t* ids, int64_t n, int64_t nq) const;
+
+    // the hot tier of the hot_tier_rows_ disk points with the most hits, or null if they are the ones it has
+    std::shared_ptr<const HotTier>
+    BuildHotTier(const std::shared_ptr<const HotTier>& current) const;
+
+    enum class PrepareState { kWarmingUp, kReady, kFailed };
+
     std::string index_prefix_;
     mutable std::mutex preparation_lock_;
     std::atomic_bool is_prepared_;
@@ -166,6 +297,32 @@ class DiskANNIndexNode : public IndexNode {
     std::atomic_int64_t dim_;
     std::atomic_int64_t count_;
     std::shared_ptr<ThreadPool> search_pool_;
+    // the node cache and the warm up of a lazy Deserialize
+    std::thread prepare_thread_;
+    std::atomic_bool stop_prepare_{false};
+    std::atomic<PrepareState> prepare_state_{PrepareState::kReady};
+    // the stripes of the disk index the load wrote, see disk_stripe_paths
+    std::vector<std::string> stripe_files_;
+    // the inserts and deletes after the load, taken exclusively by Add and DeleteByIds and shared by the searches
+    mutable std::shared_mutex fresh_mutex_;
+    std::string metric_type_;
+    Index<IndexNode> delta_;
+    std::atomic_int64_t delta_rows_{0};
+    // the bits of the deleted points of the disk index
+    std::vector<uint8_t> deleted_;
+    int64_t num_deleted_ = 0;
+    int64_t num_merged_deleted_ = 0;
+    float streaming_merge_ratio_ = 0;
+    std::thread merge_thread_;
+    std::atomic_bool merging_{false};
+    // the hot tier, replaced as a whole by its rebuilds, see HotTier
+    mutable std::shared_ptr<const HotTier> hot_tier_;
+    int64_t hot_tier_rows_ = 0;
+    mutable std::unique_ptr<std::atomic<uint32_t>[]> hot_hits_;
+    mutable std::atomic_int64_t hot_queries_{0};
+    mutable std::mutex hot_mutex_;
+    mutable std::thread hot_thread_;
+    mutable std::atomic_bool hot_rebuilding_{false};
 };
 
 }  // namespace knowhere
@@ -174,6 +331,42 @@ namespace knowhere {
 namespace {
 static constexpr float kCacheExpansionRate = 1.2;
 static constexpr int kSearchListSizeMaxValue = 200;
+// the graph of the delta index of the inserts
+static constexpr int kDeltaM = 16;
+static constexpr int kDeltaEfConstruction = 200;
+// the queries between two rebuilds of the hot tier
+static constexpr int64_t kHotTierRebuildQueries = 10000;
+
+// merges the top k of b into the top k of a, the distances of both ordered by larger_first; the ids of b found in a
+// are dropped, as the disk points of the hot tier are found by the disk index too
+void
+MergeTopK(int64_t k, bool larger_first, int64_t* a_ids, float* a_distances, const int64_t* b_ids,
+          const float* b_distances) {
+    std::vector<int64_t> merged_ids(k);
+    std::vector<float> merged_distances(k);
+    int64_t i = 0, j = 0;
+    for (int64_t r = 0; r < k; r++) {
+        while (j < k && b_ids[j] != -1 && std::find(a_ids, a_ids + k, b_ids[j]) != a_ids + k) {
+            j++;
+        }
+        bool a_valid = i < k && a_ids[i] != -1;
+        bool b_valid = j < k && b_ids[j] != -1;
+        bool take_a = a_valid && (!b_valid || (larger_first ? a_distances[i] >= b_distances[j]
+                                                            : a_distances[i] <= b_distances[j]));
+        if (take_a || !b_valid) {
+            // past the results of both, the padding of a
+            merged_ids[r] = a_ids[i];
+            merged_distances[r] = a_distances[i];
+            i++;
+        } else {
+            merged_ids[r] = b_ids[j];
+            merged_distances[r] = b_distances[j];
+            j++;
+        }
+    }
+    std::copy(merged_ids.begin(), merged_ids.end(), a_ids);
+    std::copy(merged_distances.begin(), merged_distances.end(), a_distances);
+}
 
 Status
 TryDiskANNCall(std::function<void()>&& diskann_call) {
@@ -192,6 +385,45 @@ TryDiskANNCall(std::function<void()>&& diskann_call) {
     }
 }
 
+// reports the work of a query, as diskann counted it, in the query metrics of the index type; it also becomes the
+// QueryStats of the thread for the trace of the query
+void
+ObserveQueryStats(const QueryMetrics& metrics, const diskann::QueryStats& stats) {
+    auto& query_stats = QueryStats::Current();
+    query_stats.Reset();
+    query_stats.hops = stats.n_hops;
+    query_stats.distance_computations = stats.n_cmps;
+    query_stats.ios = stats.n_ios;
+    query_stats.cache_hits = stats.n_cache_hits;
+    // every read is of one sector
+    query_stats.bytes_read = static_cast<int64_t>(stats.n_ios) * SECTOR_LEN;
+    query_stats.io_us = static_cast<int64_t>(stats.io_us);
+    metrics.Observe(query_stats);
+}
+
+// adds the growth of a cumulative count of the sector buffer pool since the last report to counter
+void
+ReportPoolCount(std::atomic<uint64_t>& reported, uint64_t count, prometheus::Counter& counter) {
+    auto prev = reported.load();
+    while (count > prev && !reported.compare_exchange_weak(prev, count)) {
+    }
+    if (count > prev) {
+        counter.Increment(count - prev);
+    }
+}
+
+// the sector buffer pool is shared by the searches of all the indexes, its pressure is reported after every search
+void
+ReportSectorBufferPool() {
+    static std::atomic<uint64_t> reported_waits{0};
+    static std::atomic<uint64_t> reported_remote{0};
+    auto stats = diskann::SectorBufferPool::instance().stats();
+    knowhere_diskann_sector_pool_bytes.Set(stats.bytes);
+    knowhere_diskann_sector_pool_borrowed_bytes.Set(stats.borrowed_bytes);
+    ReportPoolCount(reported_waits, stats.n_waits, knowhere_diskann_sector_pool_waits);
+    ReportPoolCount(reported_remote, stats.n_remote, knowhere_diskann_sector_pool_remote_borrows);
+}
+
 std::vector<std::string>
 GetNecessaryFilenames(const std::string& prefix, const bool need_norm, const bool use_sample_cache,
                       const bool use_sample_warmup) {
@@ -221,6 +453,11 @@ GetOptionalFilenames(const std::string& prefix) {
     filenames.push_back(diskann::get_disk_index_centroids_filename(disk_index_filename));
     filenames.push_back(diskann::get_disk_index_medoids_filename(disk_index_filename));
     filenames.push_back(diskann::get_cached_nodes_file(prefix));
+    filenames.push_back(diskann::get_disk_index_layout_file(disk_index_filename));
+    filenames.push_back(diskann::get_disk_index_sq_table_file(disk_index_filename));
+    filenames.push_back(diskann::get_disk_index_nav_graph_file(disk_index_filename));
+    filenames.push_back(diskann::get_disk_index_labels_file(disk_index_filename));
+    filenames.push_back(diskann::get_disk_index_label_medoids_file(disk_index_filename));
     return filenames;
 }
 
@@ -271,6 +508,10 @@ DiskANNIndexNode<T>::Build(const DataSet& dataset, const Config& cfg) {
         LOG_KNOWHERE_ERROR_ << "Failed load the raw data before building." << std::endl;
         return Status::diskann_file_error;
     }
+    if (!build_conf.label_path.value().empty() && !LoadFile(build_conf.label_path.value())) {
+        LOG_KNOWHERE_ERROR_ << "Failed load the labels before building." << std::endl;
+        return Status::diskann_file_error;
+    }
     auto& data_path = build_conf.data_path.value();
     index_prefix_ = build_conf.index_prefix.value();
 
@@ -291,8 +532,20 @@ DiskANNIndexNode<T>::Build(const DataSet& dataset, const Config& cfg) {
             return diskann::Metric::INNER_PRODUCT;
         }
     }();
-    auto num_nodes_to_cache =
-        GetCachedNodeNum(build_conf.search_cache_budget_gb.value(), dim, build_conf.max_degree.value());
+    // the cached nodes leave room for the navigation graph in the budget
+    auto nav_graph_bytes = build_conf.nav_graph_ratio.value() * count * (dim + diskann::kNavGraphMaxDegree + 2) * 4;
+    auto nav_graph_gb = nav_graph_bytes / (1024 * 1024 * 1024);
+    auto num_nodes_to_cache = GetCachedNodeNum(std::max(build_conf.search_cache_budget_gb.value() - nav_graph_gb, 0.0f),
+                                               dim, build_conf.max_degree.value());
+    auto disk_sq_type = [&t = build_conf.disk_sq_type.value()] {
+        if (!strcasecmp(t.c_str(), kDiskSqTypeSQ8)) {
+            return diskann::DiskSQType::SQ8;
+        } else if (!strcasecmp(t.c_str(), kDiskSqTypeFP16)) {
+            return diskann::DiskSQType::FP16;
+        } else {
+            return diskann::DiskSQType::NONE;
+        }
+    }();
     diskann::BuildConfig diskann_internal_build_config{data_path,
                                                        index_prefix_,
                                                        diskann_metric,
@@ -303,7 +556,24 @@ DiskANNIndexNode<T>::Build(const DataSet& dataset, const Config& cfg) {
                                                        static_cast<uint32_t>(build_conf.disk_pq_dims.value()),
                                                        false,
                                                        build_conf.accelerate_build.value(),
-                                                       static_cast<uint32_t>(num_nodes_to_cache)};
+                                                       static_cast<uint32_t>(num_nodes_to_cache),
+                                                       build_conf.graph_layout.value(),
+                                                       static_cast<unsigned>(build_conf.build_concurrent_shards.value()),
+                                                       disk_sq_type};
+    // the graph is built on the L2 distances of the vectors prepared for it, IP and COSINE ones included
+    if (strcasecmp(build_conf.knn_graph.value().c_str(), kKnnGraphNone)) {
+        auto builder = [source = build_conf.knn_graph.value()](const float* data, size_t rows, size_t dim, unsigned k) {
+            auto graph = BuildKnnGraph(data, rows, dim, k, metric::L2, source);
+            if (!graph.has_value()) {
+                throw diskann::ANNException("kNN graph by " + source + " failed: " + graph.what(), -1);
+            }
+            return graph.value();
+        };
+        diskann_internal_build_config.knn_graph_builder = builder;
+    }
+    diskann_internal_build_config.nav_graph_ratio = build_conf.nav_graph_ratio.value();
+    diskann_internal_build_config.label_file_path = build_conf.label_path.value();
+    diskann_internal_build_config.compress_graph = build_conf.compress_graph.value();
     RETURN_IF_ERROR(TryDiskANNCall([&]() {
         int res = diskann::build_disk_index<T>(diskann_internal_build_config);
         if (res != 0)
@@ -341,6 +611,8 @@ DiskANNIndexNode<T>::Deserialize(const BinarySet& binset, const Config& cfg) {
         return Status::success;
     }
     index_prefix_ = prep_conf.index_prefix.value();
+    metric_type_ = prep_conf.metric_type.value();
+    streaming_merge_ratio_ = prep_conf.streaming_merge_ratio.value();
     bool is_ip = IsMetricType(prep_conf.metric_type.value(), knowhere::metric::IP);
     bool need_norm = IsMetricType(prep_conf.metric_type.value(), knowhere::metric::IP) ||
                      IsMetricType(prep_conf.metric_type.value(), knowhere::metric::COSINE);
@@ -354,13 +626,17 @@ DiskANNIndexNode<T>::Deserialize(const BinarySet& binset, const Config& cfg) {
         }
     }();
 
-    // Load file from file manager.
-    for (auto& filename : GetNecessaryFilenames(
-             index_prefix_, need_norm, prep_conf.search_cache_budget_gb.value() > 0 && !prep_conf.use_bfs_cache.value(),
-             prep_conf.warm_up.value())) {
-        if (!LoadFile(filename)) {
-            return Status::diskann_file_error;
-        }
+    // Load the files from the file manager in one batch, the pq files ahead of the disk index, so that it can fetch
+    // them concurrently. The sample queries and the cached node list only serve the node cache and the warm up: a
+    // lazy prepare loads them in the background with those, after the index is serving.
+    bool lazy = prep_conf.lazy_prepare.value();
+    bool sample_cache = prep_conf.search_cache_budget_gb.value() > 0 && !prep_conf.use_bfs_cache.value();
+    auto filenames =
+        GetNecessaryFilenames(index_prefix_, need_norm, sample_cache && !lazy, prep_conf.warm_up.value() && !lazy);
+    std::vector<std::string> deferred_filenames;
+    // a lazy node cache comes from a bfs, only the warm up reads the sample queries
+    if (lazy && prep_conf.warm_up.value()) {
+        deferred_filenames.push_back(diskann::get_sample_data_filename(index_prefix_));
     }
     for (auto& filename : GetOptionalFilenames(index_prefix_)) {
         auto is_exist_op = file_manager_->IsExisted(filename);
@@ -368,10 +644,14 @@ DiskANNIndexNode<T>::Deserialize(const BinarySet& binset, const Config& cfg) {
             LOG_KNOWHERE_ERROR_ << "Failed to check existence of file " << filename << ".";
             return Status::diskann_file_error;
         }
-        if (is_exist_op.value() && !LoadFile(filename)) {
-            return Status::diskann_file_error;
+        if (is_exist_op.value()) {
+            bool deferred = lazy && filename == diskann::get_cached_nodes_file(index_prefix_);
+            (deferred ? deferred_filenames : filenames).push_back(filename);
         }
     }
+    if (!LoadFiles(filenames)) {
+        return Status::diskann_file_error;
+    }
 
     // set thread pool
     search_pool_ = ThreadPool::GetGlobalSearchThreadPool();
@@ -379,11 +659,38 @@ DiskANNIndexNode<T>::Deserialize(const BinarySet& binset, const Config& cfg) {
     // load diskann pq code and meta info
     std::shared_ptr<AlignedFileReader> reader = nullptr;
 
-    reader.reset(new LinuxAlignedFileReader());
+    auto stripe_dirs = prep_conf.disk_stripe_paths.value();
+    if (!stripe_dirs.empty()) {
+        std::vector<std::string> dirs;
+        for (size_t begin = 0, end; begin <= stripe_dirs.size(); begin = end + 1) {
+            end = std::min(stripe_dirs.find(',', begin), stripe_dirs.size());
+            if (end > begin) {
+                dirs.push_back(stripe_dirs.substr(begin, end - begin));
+            }
+        }
+        auto stripe_len = static_cast<uint64_t>(prep_conf.disk_stripe_sectors.value()) * SECTOR_LEN;
+        if (TryDiskANNCall([&]() {
+                stripe_files_ =
+                    diskann::stripe_disk_index(diskann::get_disk_index_filename(index_prefix_), dirs, stripe_len);
+                reader = std::make_shared<StripedAlignedFileReader>(stripe_files_, stripe_len);
+            }) != Status::success) {
+            LOG_KNOWHERE_ERROR_ << "Failed to stripe the disk index of " << index_prefix_ << ".";
+            return Status::diskann_file_error;
+        }
+    } else if (IoUringAlignedFileReader::GlobalEnabled()) {
+        reader.reset(new IoUringAlignedFileReader());
+    } else {
+        reader.reset(new LinuxAlignedFileReader());
+    }
+    if (prep_conf.coalesce_reads.value()) {
+        reader = std::make_shared<CoalescingAlignedFileReader>(std::move(reader));
+    }
 
     pq_flash_index_ = std::make_unique<diskann::PQFlashIndex<T>>(reader, diskann_metric);
+    // mapped rather than read, the PQ codes are the page cache of their file that every process loading it shares
+    bool mmap_pq_data = lazy || prep_conf.enable_mmap.value_or(false);
     auto disk_ann_call = [&]() {
-        int res = pq_flash_index_->load(search_pool_->size(), index_prefix_.c_str());
+        int res = pq_flash_index_->load(search_pool_->size(), index_prefix_.c_str(), mmap_pq_data);
         if (res != 0) {
             throw diskann::ANNException("pq_flash_index_->load returned non-zero value: " + std::to_string(res), -1);
         }
@@ -401,11 +708,74 @@ DiskANNIndexNode<T>::Deserialize(const BinarySet& binset, const Config& cfg) {
         dim_.store(pq_flash_index_->get_data_dim());
     }
 
+    // the rows of the hot tier are got from the disk index, which holds them transformed for IP
+    if (prep_conf.hot_tier_memory_mb.value() > 0) {
+        if (!HasRawData(metric_type_)) {
+            LOG_KNOWHERE_WARNING_ << "DiskANN " << index_prefix_ << " has no hot tier with metric " << metric_type_
+                                  << ".";
+        } else {
+            auto row_bytes = dim_.load() * sizeof(float) + 2 * kDeltaM * sizeof(int32_t);
+            hot_tier_rows_ = std::min<int64_t>(
+                count_.load(), prep_conf.hot_tier_memory_mb.value() * 1024 * 1024 / row_bytes);
+            hot_hits_ = std::make_unique<std::atomic<uint32_t>[]>(count_.load());
+        }
+    }
+
+    // the navigation graph comes out of the node cache budget, it is left out when it does not fit in
+    auto cache_budget_gb = prep_conf.search_cache_budget_gb.value();
+    auto nav_graph_file = diskann::get_disk_index_nav_graph_file(diskann::get_disk_index_filename(index_prefix_));
+    if (file_exists(nav_graph_file)) {
+        auto nav_graph_gb = static_cast<float>(get_file_size(nav_graph_file)) / (1024 * 1024 * 1024);
+        if (nav_graph_gb > cache_budget_gb) {
+            LOG_KNOWHERE_WARNING_ << "The navigation graph of " << index_prefix_
+                                  << " does not fit in search_cache_budget_gb, the searches start from the medoid.";
+        } else if (TryDiskANNCall([&]() { pq_flash_index_->load_nav_graph(nav_graph_file); }) != Status::success) {
+            LOG_KNOWHERE_ERROR_ << "Failed to load the navigation graph of DiskANN.";
+            return Status::diskann_inner_error;
+        } else {
+            cache_budget_gb -= nav_graph_gb;
+        }
+    }
+
+    if (prep_conf.lazy_prepare.value()) {
+        // serve the searches right away, the node cache and the warm up follow in the background
+        prepare_state_.store(PrepareState::kWarmingUp);
+        is_prepared_.store(true);
+        prepare_thread_ = std::thread([this, prep_conf, cache_budget_gb,
+                                       deferred_filenames = std::move(deferred_filenames)]() {
+            auto status = LoadFiles(deferred_filenames) ? PrepareCacheAndWarmUp(prep_conf, cache_budget_gb, true)
+                                                        : Status::diskann_file_error;
+            if (status != Status::success) {
+                LOG_KNOWHERE_WARNING_ << "DiskANN " << index_prefix_
+                                      << " serves searches without its node cache or warm up.";
+            }
+            prepare_state_.store(status == Status::success ? PrepareState::kReady : PrepareState::kFailed);
+        });
+        return Status::success;
+    }
+
+    auto status = PrepareCacheAndWarmUp(prep_conf, cache_budget_gb, false);
+    if (status != Status::success) {
+        return status;
+    }
+    prepare_state_.store(PrepareState::kReady);
+    is_prepared_.store(true);
+    return Status::success;
+}
+
+template <typename T>
+Status
+DiskANNIndexNode<T>::PrepareCacheAndWarmUp(const DiskANNConfig& prep_conf, float cache_budget_gb, bool lazy) {
     std::string warmup_query_file = diskann::get_sample_data_filename(index_prefix_);
     // load cache
     auto cached_nodes_file = diskann::get_cached_nodes_file(index_prefix_);
     std::vector<uint32_t> node_list;
-    if (file_exists(cached_nodes_file)) {
+    if (prep_conf.dynamic_cache.value()) {
+        auto num_nodes_to_cache =
+            GetCachedNodeNum(cache_budget_gb, pq_flash_index_->get_data_dim(), pq_flash_index_->get_max_degree());
+        LOG_KNOWHERE_INFO_ << "Caching up to " << num_nodes_to_cache << " nodes learnt from the searches.";
+        pq_flash_index_->enable_dynamic_cache(num_nodes_to_cache, prep_conf.dynamic_cache_refresh_queries.value());
+    } else if (file_exists(cached_nodes_file)) {
         LOG_KNOWHERE_INFO_ << "Reading cached nodes from file.";
         size_t num_nodes, nodes_id_dim;
         uint32_t* cached_nodes_ids = nullptr;
@@ -415,8 +785,8 @@ DiskANNIndexNode<T>::Deserialize(const BinarySet& binset, const Config& cfg) {
             delete[] cached_nodes_ids;
         }
     } else {
-        auto num_nodes_to_cache = GetCachedNodeNum(prep_conf.search_cache_budget_gb.value(),
-                                                   pq_flash_index_->get_data_dim(), pq_flash_index_->get_max_degree());
+        auto num_nodes_to_cache =
+            GetCachedNodeNum(cache_budget_gb, pq_flash_index_->get_data_dim(), pq_flash_index_->get_max_degree());
         if (num_nodes_to_cache > pq_flash_index_->get_num_points() / 3) {
             LOG_KNOWHERE_ERROR_ << "Failed to generate cache, num_nodes_to_cache(" << num_nodes_to_cache
                                 << ") is larger than 1/3 of the total data number.";
@@ -424,7 +794,8 @@ DiskANNIndexNode<T>::Deserialize(const BinarySet& binset, const Config& cfg) {
         }
         if (num_nodes_to_cache > 0) {
             LOG_KNOWHERE_INFO_ << "Caching " << num_nodes_to_cache << " sample nodes around medoid(s).";
-            if (prep_conf.use_bfs_cache.value()) {
+            // the sample queries would count the nodes of the searches running meanwhile
+            if (prep_conf.use_bfs_cache.value() || lazy) {
                 LOG_KNOWHERE_INFO_ << "Use bfs to generate cache list";
                 if (TryDiskANNCall([&]() { pq_flash_index_->cache_bfs_levels(num_nodes_to_cache, node_list); }) !=
                     Status::success) {
@@ -445,7 +816,7 @@ DiskANNIndexNode<T>::Deserialize(const BinarySet& binset, const Config& cfg) {
         LOG_KNOWHERE_INFO_ << "End of preparing diskann index.";
     }
 
-    if (node_list.size() > 0) {
+    if (node_list.size() > 0 && !stop_prepare_.load()) {
         if (TryDiskANNCall([&]() { pq_flash_index_->load_cache_list(node_list); }) != Status::success) {
             LOG_KNOWHERE_ERROR_ << "Failed to load cache for DiskANN.";
             return Status::diskann_inner_error;
@@ -453,52 +824,369 @@ DiskANNIndexNode<T>::Deserialize(const BinarySet& binset, const Config& cfg) {
     }
 
     // warmup
-    if (prep_conf.warm_up.value()) {
-        LOG_KNOWHERE_INFO_ << "Warming up.";
-        uint64_t warmup_L = 20;
-        uint64_t warmup_num = 0;
-        uint64_t warmup_dim = 0;
-        uint64_t warmup_aligned_dim = 0;
-        T* warmup = nullptr;
-        if (TryDiskANNCall([&]() {
-                diskann::load_aligned_bin<T>(warmup_query_file, warmup, warmup_num, warmup_dim, warmup_aligned_dim);
-            }) != Status::success) {
-            LOG_KNOWHERE_ERROR_ << "Failed to load warmup file for DiskANN.";
-            return Status::diskann_file_error;
-        }
-        std::vector<int64_t> warmup_result_ids_64(warmup_num, 0);
-        std::vector<float> warmup_result_dists(warmup_num, 0);
+    if (prep_conf.warm_up.value() && !stop_prepare_.load()) {
+        RETURN_IF_ERROR(SearchSampleQueries(nullptr));
+    }
+
+    return Status::success;
+}
+
+template <typename T>
+Status
+DiskANNIndexNode<T>::SearchSampleQueries(const WarmupProgress& progress) const {
+    std::string warmup_query_file = diskann::get_sample_data_filename(index_prefix_);
+    LOG_KNOWHERE_INFO_ << "Warming up.";
+    uint64_t warmup_L = 20;
+    uint64_t warmup_num = 0;
+    uint64_t warmup_dim = 0;
+    uint64_t warmup_aligned_dim = 0;
+    T* warmup = nullptr;
+    if (TryDiskANNCall([&]() {
+            diskann::load_aligned_bin<T>(warmup_query_file, warmup, warmup_num, warmup_dim, warmup_aligned_dim);
+        }) != Status::success) {
+        LOG_KNOWHERE_ERROR_ << "Failed to load warmup file for DiskANN.";
+        return Status::diskann_file_error;
+    }
+    std::vector<int64_t> warmup_result_ids_64(warmup_num, 0);
+    std::vector<float> warmup_result_dists(warmup_num, 0);
 
-        bool all_searches_are_good = true;
+    bool all_searches_are_good = true;
+    std::mutex progress_mtx;
+    int64_t done = 0;
 
-        std::vector<folly::Future<folly::Unit>> futures;
-        futures.reserve(warmup_num);
-        for (_s64 i = 0; i < (int64_t)warmup_num; ++i) {
-            futures.emplace_back(search_pool_->push([&, index = i]() {
+    if (TryDiskANNCall([&]() {
+            search_pool_->parallel_for(0, warmup_num, 1, [&](int64_t index) {
+                if (stop_prepare_.load()) {
+                    return;
+                }
                 pq_flash_index_->cached_beam_search(warmup + (index * warmup_aligned_dim), 1, warmup_L,
                                                     warmup_result_ids_64.data() + (index * 1),
                                                     warmup_result_dists.data() + (index * 1), 4);
-            }));
+                if (progress) {
+                    std::lock_guard lock(progress_mtx);
+                    progress(++done, warmup_num);
+                }
+            });
+        }) != Status::success) {
+        all_searches_are_good = false;
+    }
+    if (warmup != nullptr) {
+        diskann::aligned_free(warmup);
+    }
+
+    if (!all_searches_are_good) {
+        LOG_KNOWHERE_ERROR_ << "Failed to do search on warmup file for DiskANN.";
+        return Status::diskann_inner_error;
+    }
+    return Status::success;
+}
+
+template <typename T>
+Status
+DiskANNIndexNode<T>::Warmup(int64_t budget, const WarmupProgress& progress) const {
+    if (!is_prepared_.load() || !pq_flash_index_) {
+        return Status::empty_index;
+    }
+    if (!file_exists(diskann::get_sample_data_filename(index_prefix_))) {
+        LOG_KNOWHERE_INFO_ << "No sample queries of " << index_prefix_ << " to warm up with, load it with warm_up.";
+        return Status::success;
+    }
+    return SearchSampleQueries(progress);
+}
+
+template <typename T>
+Status
+DiskANNIndexNode<T>::Add(const DataSet& dataset, const Config& cfg) {
+    if (!is_prepared_.load() || !pq_flash_index_) {
+        LOG_KNOWHERE_ERROR_ << "Can not add data to a DiskANN index that is not loaded.";
+        return Status::empty_index;
+    }
+    if (dataset.GetDim() != Dim()) {
+        LOG_KNOWHERE_ERROR_ << "The dim of the data added, " << dataset.GetDim() << ", is not the one of the index, "
+                            << Dim() << ".";
+        return Status::invalid_args;
+    }
+    Json json;
+    json[meta::DIM] = Dim();
+    json[meta::METRIC_TYPE] = metric_type_;
+    json[indexparam::HNSW_M] = kDeltaM;
+    json[indexparam::EFCONSTRUCTION] = kDeltaEfConstruction;
+
+    std::unique_lock lock(fresh_mutex_);
+    Status status;
+    if (delta_rows_.load() == 0) {
+        auto delta = IndexFactory::Instance().Create(IndexEnum::INDEX_HNSW);
+        status = delta.Build(dataset, json);
+        if (status == Status::success) {
+            delta_ = std::move(delta);
         }
-        for (auto& future : futures) {
-            if (TryDiskANNCall([&]() { future.wait(); }) != Status::success) {
-                all_searches_are_good = false;
-            }
+    } else {
+        status = delta_.Add(dataset, json);
+    }
+    if (status != Status::success) {
+        LOG_KNOWHERE_ERROR_ << "Failed to add " << dataset.GetRows() << " rows to the delta index of DiskANN.";
+        return status;
+    }
+    delta_rows_.fetch_add(dataset.GetRows());
+    return Status::success;
+}
+
+template <typename T>
+Status
+DiskANNIndexNode<T>::DeleteByIds(const DataSet& dataset) {
+    if (!is_prepared_.load() || !pq_flash_index_) {
+        LOG_KNOWHERE_ERROR_ << "Can not delete from a DiskANN index that is not loaded.";
+        return Status::empty_index;
+    }
+    auto n = dataset.GetRows();
+    auto ids = dataset.GetIds();
+    auto disk_count = count_.load();
+
+    std::unique_lock lock(fresh_mutex_);
+    auto total = disk_count + delta_rows_.load();
+    for (int64_t i = 0; i < n; i++) {
+        if (ids[i] < 0 || ids[i] >= total) {
+            LOG_KNOWHERE_ERROR_ << "Can not delete id " << ids[i] << " of a DiskANN index of " << total << " rows.";
+            return Status::invalid_args;
+        }
+    }
+    if (deleted_.empty()) {
+        deleted_.resize((disk_count + 7) / 8);
+    }
+    std::vector<int64_t> delta_ids;
+    for (int64_t i = 0; i < n; i++) {
+        auto id = ids[i];
+        if (id >= disk_count) {
+            delta_ids.push_back(id - disk_count);
+        } else if (!(deleted_[id >> 3] & (0x1 << (id & 0x7)))) {
+            deleted_[id >> 3] |= 0x1 << (id & 0x7);
+            num_deleted_++;
         }
-        if (warmup != nullptr) {
-            diskann::aligned_free(warmup);
+    }
+    if (!delta_ids.empty()) {
+        auto status = delta_.DeleteByIds(*GenIdsDataSet(delta_ids.size(), delta_ids.data()));
+        if (status != Status::success) {
+            LOG_KNOWHERE_ERROR_ << "Failed to delete from the delta index of DiskANN.";
+            return status;
         }
+    }
+    MaybeStartStreamingMerge();
+    return Status::success;
+}
 
-        if (!all_searches_are_good) {
-            LOG_KNOWHERE_ERROR_ << "Failed to do search on warmup file for DiskANN.";
-            return Status::diskann_inner_error;
+template <typename T>
+void
+DiskANNIndexNode<T>::MaybeStartStreamingMerge() {
+    auto disk_count = count_.load();
+    if (streaming_merge_ratio_ <= 0 || merging_.load() ||
+        num_deleted_ - num_merged_deleted_ < streaming_merge_ratio_ * disk_count) {
+        return;
+    }
+    if (merge_thread_.joinable()) {
+        merge_thread_.join();
+    }
+    std::vector<bool> deleted(disk_count);
+    for (int64_t i = 0; i < disk_count; i++) {
+        deleted[i] = deleted_[i >> 3] & (0x1 << (i & 0x7));
+    }
+    num_merged_deleted_ = num_deleted_;
+    merging_.store(true);
+    merge_thread_ = std::thread([this, deleted = std::move(deleted)]() {
+        if (TryDiskANNCall([&]() { pq_flash_index_->patch_deleted_nodes(deleted); }) != Status::success) {
+            LOG_KNOWHERE_WARNING_ << "The streaming merge of DiskANN " << index_prefix_
+                                  << " failed, its graph still links to the deleted points.";
+        }
+        merging_.store(false);
+    });
+}
+
+template <typename T>
+BitsetView
+DiskANNIndexNode<T>::DiskBitset(const BitsetView& bitset, std::vector<uint8_t>& bits) const {
+    auto disk_count = count_.load();
+    if (num_deleted_ == 0 && static_cast<int64_t>(bitset.size()) <= disk_count) {
+        return bitset;
+    }
+    bits = deleted_;
+    bits.resize((disk_count + 7) / 8);
+    if (bitset.is_dense()) {
+        auto n = std::min(bits.size(), bitset.byte_size());
+        for (size_t i = 0; i < n; i++) {
+            bits[i] |= bitset.data()[i];
+        }
+        // the bits past the disk index are the ones of the delta index
+        if (disk_count % 8 != 0 && !bits.empty()) {
+            bits.back() &= (0x1 << (disk_count % 8)) - 1;
+        }
+    } else {
+        auto n = std::min<int64_t>(bitset.size(), disk_count);
+        for (int64_t i = 0; i < n; i++) {
+            if (bitset.test(i)) {
+                bits[i >> 3] |= 0x1 << (i & 0x7);
+            }
         }
     }
+    return BitsetView(bits.data(), disk_count);
+}
 
-    is_prepared_.store(true);
+template <typename T>
+BitsetView
+DiskANNIndexNode<T>::DeltaBitset(const BitsetView& bitset, std::vector<uint8_t>& bits) const {
+    auto disk_count = count_.load();
+    auto rows = delta_rows_.load();
+    if (static_cast<int64_t>(bitset.size()) <= disk_count) {
+        return nullptr;
+    }
+    bits.assign((rows + 7) / 8, 0);
+    auto n = std::min<int64_t>(bitset.size() - disk_count, rows);
+    for (int64_t i = 0; i < n; i++) {
+        if (bitset.test(disk_count + i)) {
+            bits[i >> 3] |= 0x1 << (i & 0x7);
+        }
+    }
+    return BitsetView(bits.data(), rows);
+}
+
+template <typename T>
+Status
+DiskANNIndexNode<T>::MergeDeltaResults(const DataSet& dataset, const DiskANNConfig& conf, const BitsetView& bitset,
+                                       int64_t k, int64_t* ids, float* distances) const {
+    Json json;
+    json[meta::METRIC_TYPE] = metric_type_;
+    json[meta::TOPK] = k;
+    json[indexparam::EF] = std::max<int64_t>(conf.search_list_size.value(), k);
+    std::vector<uint8_t> bits;
+    auto res = delta_.Search(dataset, json, DeltaBitset(bitset, bits));
+    if (!res.has_value()) {
+        LOG_KNOWHERE_ERROR_ << "Failed to search the delta index of DiskANN: " << res.what();
+        return res.error();
+    }
+    auto delta_ids = res.value()->GetIds();
+    auto delta_distances = res.value()->GetDistance();
+    auto disk_count = count_.load();
+    // the distances of L2 are the smaller the closer, the ones of IP and COSINE are similarities
+    bool larger_first = !IsMetricType(metric_type_, metric::L2);
+    std::vector<int64_t> b_ids(k);
+    for (int64_t q = 0; q < dataset.GetRows(); q++) {
+        for (int64_t j = 0; j < k; j++) {
+            auto id = delta_ids[q * k + j];
+            b_ids[j] = id == -1 ? -1 : id + disk_count;
+        }
+        MergeTopK(k, larger_first, ids + q * k, distances + q * k, b_ids.data(), delta_distances + q * k);
+    }
     return Status::success;
 }
 
+template <typename T>
+expected<DataSetPtr>
+DiskANNIndexNode<T>::SearchHotTier(const HotTier& hot, const DataSet& dataset, const DiskANNConfig& conf,
+                                   const BitsetView& disk_bitset, int64_t k) const {
+    std::vector<uint8_t> bits;
+    BitsetView bitset;
+    if (!disk_bitset.empty()) {
+        bits.assign((hot.ids.size() + 7) / 8, 0);
+        for (size_t i = 0; i < hot.ids.size(); i++) {
+            if (disk_bitset.test(hot.ids[i])) {
+                bits[i >> 3] |= 0x1 << (i & 0x7);
+            }
+        }
+        bitset = BitsetView(bits.data(), hot.ids.size());
+    }
+    Json json;
+    json[meta::METRIC_TYPE] = metric_type_;
+    json[meta::TOPK] = k;
+    json[indexparam::EF] = std::max<int64_t>(conf.search_list_size.value(), k);
+    auto res = hot.index.Search(dataset, json, bitset);
+    if (!res.has_value()) {
+        return res;
+    }
+    // to the ids of the disk index
+    auto ids = const_cast<int64_t*>(res.value()->GetIds());
+    for (int64_t i = 0; i < dataset.GetRows() * k; i++) {
+        if (ids[i] != -1) {
+            ids[i] = hot.ids[ids[i]];
+        }
+    }
+    return res;
+}
+
+template <typename T>
+void
+DiskANNIndexNode<T>::RecordHits(const int64_t* ids, int64_t n, int64_t nq) const {
+    if (hot_hits_ == nullptr) {
+        return;
+    }
+    auto disk_count = count_.load();
+    for (int64_t i = 0; i < n; i++) {
+        if (ids[i] >= 0 && ids[i] < disk_count) {
+            hot_hits_[ids[i]].fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    auto queries = hot_queries_.fetch_add(nq) + nq;
+    if (queries < kHotTierRebuildQueries || hot_rebuilding_.exchange(true)) {
+        return;
+    }
+    hot_queries_.store(0);
+    std::scoped_lock lock(hot_mutex_);
+    if (hot_thread_.joinable()) {
+        hot_thread_.join();
+    }
+    hot_thread_ = std::thread([this]() {
+        auto current = std::atomic_load(&hot_tier_);
+        std::shared_ptr<const HotTier> hot;
+        if (TryDiskANNCall([&]() { hot = BuildHotTier(current); }) != Status::success) {
+            LOG_KNOWHERE_WARNING_ << "Failed to rebuild the hot tier of DiskANN " << index_prefix_ << ".";
+        } else if (hot != nullptr) {
+            std::atomic_store(&hot_tier_, hot);
+        }
+        hot_rebuilding_.store(false);
+    });
+}
+
+template <typename T>
+std::shared_ptr<const typename DiskANNIndexNode<T>::HotTier>
+DiskANNIndexNode<T>::BuildHotTier(const std::shared_ptr<const HotTier>& current) const {
+    auto disk_count = count_.load();
+    std::vector<std::pair<uint32_t, int64_t>> hits;
+    for (int64_t i = 0; i < disk_count; i++) {
+        auto n = hot_hits_[i].load(std::memory_order_relaxed);
+        if (n > 0) {
+            hits.emplace_back(n, i);
+            hot_hits_[i].store(n / 2, std::memory_order_relaxed);
+        }
+    }
+    auto rows = std::min<int64_t>(hot_tier_rows_, hits.size());
+    if (rows == 0) {
+        return nullptr;
+    }
+    std::partial_sort(hits.begin(), hits.begin() + rows, hits.end(), std::greater<>());
+    std::vector<int64_t> ids(rows);
+    for (int64_t i = 0; i < rows; i++) {
+        ids[i] = hits[i].second;
+    }
+    std::sort(ids.begin(), ids.end());
+    if (current != nullptr && current->ids == ids) {
+        return nullptr;
+    }
+
+    auto dim = dim_.load();
+    std::vector<float> data(rows * dim);
+    pq_flash_index_->get_vector_by_ids(ids.data(), rows, data.data());
+    auto hot = std::make_shared<HotTier>();
+    hot->index = IndexFactory::Instance().Create(IndexEnum::INDEX_HNSW);
+    Json json;
+    json[meta::METRIC_TYPE] = metric_type_;
+    json[meta::DIM] = dim;
+    json[indexparam::HNSW_M] = kDeltaM;
+    json[indexparam::EFCONSTRUCTION] = kDeltaEfConstruction;
+    if (hot->index.Build(*GenDataSet(rows, dim, data.data()), json) != Status::success) {
+        throw std::runtime_error("failed to build the hot tier");
+    }
+    hot->ids = std::move(ids);
+    LOG_KNOWHERE_INFO_ << "The hot tier of DiskANN " << index_prefix_ << " holds " << rows << " points.";
+    return hot;
+}
+
 template <typename T>
 expected<DataSetPtr>
 DiskANNIndexNode<T>::Search(const DataSet& dataset, const Config& cfg, const BitsetView& bitset) const {
@@ -525,6 +1213,14 @@ DiskANNIndexNode<T>::Search(const DataSet& dataset, const Config& cfg, const Bit
     auto beamwidth = static_cast<uint64_t>(search_conf.beamwidth.value());
     auto filter_ratio = static_cast<float>(search_conf.filter_threshold.value());
     auto for_tuning = static_cast<bool>(search_conf.for_tuning.value());
+    auto pipelined = search_conf.pipelined_search.value();
+    auto score_sector_nodes = search_conf.score_sector_nodes.value();
+    auto adaptive_beam = search_conf.adaptive_beamwidth.value();
+    auto filter_label = static_cast<int64_t>(search_conf.filter_label.value());
+    diskann::SearchBudget budget;
+    budget.max_ios = static_cast<uint64_t>(search_conf.search_io_budget.value());
+    budget.deadline_us = static_cast<uint64_t>(search_conf.search_time_budget_ms.value() * 1000);
+    int64_t interleave = search_conf.search_interleave.value();
 
     auto nq = dataset.GetRows();
     auto dim = dataset.GetDim();
@@ -540,30 +1236,110 @@ DiskANNIndexNode<T>::Search(const DataSet& dataset, const Config& cfg, const Bit
                                                  search_conf.search_list_size.value());
     }
 
-    auto p_id = new int64_t[k * nq];
-    auto p_dist = new float[k * nq];
+    KnnResultBuffers buffers(search_conf, k * nq);
+    auto p_id = buffers.ids;
+    auto p_dist = buffers.distances;
+
+    std::shared_lock fresh_lock(fresh_mutex_);
+    std::vector<uint8_t> disk_bits;
+    auto disk_bitset = DiskBitset(bitset, disk_bits);
 
     bool all_searches_are_good = true;
-    std::vector<folly::Future<folly::Unit>> futures;
-    futures.reserve(nq);
-    for (int64_t row = 0; row < nq; ++row) {
-        futures.emplace_back(search_pool_->push([&, index = row]() {
-            pq_flash_index_->cached_beam_search(xq + (index * dim), k, lsearch, p_id + (index * k),
-                                                p_dist + (index * k), beamwidth, false, nullptr, feder_result, bitset,
-                                                filter_ratio, for_tuning);
-        }));
+    std::atomic<int64_t> partial_queries = 0;
+    // the queries of a cancelled search stop expanding or are skipped, the search then fails
+    auto cancellation = search_conf.cancellation.get();
+    CancellationToken::Scope scope(cancellation);
+    const auto index_type = Type();
+    const auto& query_metrics = GetQueryMetrics(index_type);
+    auto sample_rate = search_conf.trace_sample_rate.value();
+    // the hot tier is searched on the search pool while the disk index is, it knows nothing of the labels
+    auto hot = filter_label < 0 ? std::atomic_load(&hot_tier_) : nullptr;
+    std::optional<folly::Future<expected<DataSetPtr>>> hot_res;
+    if (hot != nullptr) {
+        hot_res = search_pool_->push([&]() {
+            CancellationToken::Scope scope(cancellation);
+            return SearchHotTier(*hot, dataset, search_conf, disk_bitset, k);
+        });
+    }
+    // the queries of a group are searched at once by one thread, see search_interleave
+    bool interleaved = interleave > 1 && nq > 1 && feder_result == nullptr && sample_rate == 0 && !pipelined &&
+                       !adaptive_beam && !score_sector_nodes && filter_label < 0 && budget.max_ios == 0 &&
+                       budget.deadline_us == 0;
+    if (interleaved && TryDiskANNCall([&]() {
+            search_pool_->parallel_for(0, (nq + interleave - 1) / interleave, 1, [&](int64_t group) {
+                if (CancellationToken::CurrentCancelled()) {
+                    return;
+                }
+                int64_t begin = group * interleave;
+                int64_t n = std::min(interleave, nq - begin);
+                std::vector<diskann::QueryStats> stats(n);
+                auto cut = pq_flash_index_->interleaved_beam_search(xq + begin * dim, n, dim, k, lsearch,
+                                                                    p_id + begin * k, p_dist + begin * k, beamwidth,
+                                                                    stats.data(), disk_bitset, filter_ratio,
+                                                                    for_tuning);
+                partial_queries.fetch_add(cut, std::memory_order_relaxed);
+                for (auto& s : stats) {
+                    ObserveQueryStats(query_metrics, s);
+                }
+            });
+        }) != Status::success) {
+        all_searches_are_good = false;
+    }
+    if (!interleaved && TryDiskANNCall([&]() {
+            search_pool_->parallel_for(0, nq, 1, [&](int64_t index) {
+                if (CancellationToken::CurrentCancelled()) {
+                    return;
+                }
+                QueryTraceScope trace(index_type, sample_rate, index);
+                diskann::QueryStats stats;
+                if (!pq_flash_index_->cached_beam_search(xq + (index * dim), k, lsearch, p_id + (index * k),
+                                                         p_dist + (index * k), beamwidth, false, &stats,
+                                                         feder_result, disk_bitset, filter_ratio, for_tuning, pipelined,
+                                                         score_sector_nodes, nullptr, &budget, filter_label,
+                                                         adaptive_beam)) {
+                    partial_queries.fetch_add(1, std::memory_order_relaxed);
+                }
+                ObserveQueryStats(query_metrics, stats);
+            });
+        }) != Status::success) {
+        all_searches_are_good = false;
     }
-    for (auto& future : futures) {
-        if (TryDiskANNCall([&]() { future.wait(); }) != Status::success) {
-            all_searches_are_good = false;
+    // the hot tier only adds to the results of the disk index, they stand without it
+    if (hot_res.has_value()) {
+        auto hot_result = std::move(hot_res.value()).get();
+        if (!hot_result.has_value()) {
+            LOG_KNOWHERE_WARNING_ << "Failed to search the hot tier of DiskANN: " << hot_result.what();
+        } else if (all_searches_are_good) {
+            bool larger_first = !IsMetricType(metric_type_, metric::L2);
+            for (int64_t q = 0; q < nq; q++) {
+                MergeTopK(k, larger_first, p_id + q * k, p_dist + q * k, hot_result.value()->GetIds() + q * k,
+                          hot_result.value()->GetDistance() + q * k);
+            }
         }
     }
 
+    ReportSectorBufferPool();
     if (!all_searches_are_good) {
+        buffers.Free();
         return expected<DataSetPtr>::Err(Status::diskann_inner_error, "some search failed");
     }
+    if (cancellation != nullptr && cancellation->IsCancelled()) {
+        buffers.Free();
+        return expected<DataSetPtr>::Err(Status::search_cancelled, "search cancelled");
+    }
+    if (delta_rows_.load() > 0) {
+        auto status = MergeDeltaResults(dataset, search_conf, bitset, k, p_id, p_dist);
+        if (status != Status::success) {
+            buffers.Free();
+            return expected<DataSetPtr>::Err(status, "failed to search the delta index");
+        }
+    }
+    RecordHits(p_id, nq * k, nq);
 
-    auto res = GenResultDataSet(nq, k, p_id, p_dist);
+    auto res = buffers.ToDataSet(nq, k);
+    if (partial_queries.load() > 0) {
+        res->SetPartialQueries(partial_queries.load());
+    }
 
     // set visit_info json string into result dataset
     if (feder_result != nullptr) {
@@ -611,37 +1387,84 @@ DiskANNIndexNode<T>::RangeSearch(const DataSet& dataset, const Config& cfg, cons
     float* p_dist = nullptr;
     size_t* p_lims = nullptr;
 
-    std::vector<std::vector<int64_t>> result_id_array(nq);
-    std::vector<std::vector<float>> result_dist_array(nq);
+    auto max_results = search_conf.max_results.value();
+    bool do_filter = range_filter != defaultRangeFilter;
+    // the hits the range filter drops do not count towards the ones that stop the search
+    float filter_bound = do_filter ? range_filter : (is_ip ? std::numeric_limits<float>::infinity()
+                                                           : -std::numeric_limits<float>::infinity());
+    RangeSearchResultBuilder results(nq, max_results, is_ip);
+
+    std::shared_lock fresh_lock(fresh_mutex_);
+    std::vector<uint8_t> disk_bits;
+    auto disk_bitset = DiskBitset(bitset, disk_bits);
+    // the hits of the delta index, their ids past the ones of the disk index
+    DataSetPtr delta_res;
+    auto disk_count = count_.load();
+    if (delta_rows_.load() > 0) {
+        Json json;
+        json[meta::METRIC_TYPE] = metric_type_;
+        json[meta::RADIUS] = radius;
+        if (do_filter) {
+            json[meta::RANGE_FILTER] = range_filter;
+        }
+        std::vector<uint8_t> delta_bits;
+        auto delta = delta_.RangeSearch(dataset, json, DeltaBitset(bitset, delta_bits));
+        if (!delta.has_value()) {
+            LOG_KNOWHERE_ERROR_ << "Failed to range search the delta index of DiskANN: " << delta.what();
+            return expected<DataSetPtr>::Err(delta.error(), "failed to range search the delta index");
+        }
+        delta_res = delta.value();
+    }
 
-    std::vector<folly::Future<folly::Unit>> futures;
-    futures.reserve(nq);
     bool all_searches_are_good = true;
-    for (int64_t row = 0; row < nq; ++row) {
-        futures.emplace_back(search_pool_->push([&, index = row]() {
-            std::vector<int64_t> indices;
-            std::vector<float> distances;
-            pq_flash_index_->range_search(xq + (index * dim), radius, min_k, max_k, result_id_array[index],
-                                          result_dist_array[index], beamwidth, search_list_and_k_ratio, bitset);
-            // filter range search result
-            if (search_conf.range_filter.value() != defaultRangeFilter) {
-                FilterRangeSearchResultForOneNq(result_dist_array[index], result_id_array[index], is_ip, radius,
-                                                range_filter);
-            }
-        }));
-    }
-    for (auto& future : futures) {
-        if (TryDiskANNCall([&]() { future.wait(); }) != Status::success) {
-            all_searches_are_good = false;
-        }
+    auto cancellation = search_conf.cancellation.get();
+    CancellationToken::Scope scope(cancellation);
+    const auto index_type = Type();
+    const auto& query_metrics = GetQueryMetrics(index_type);
+    auto sample_rate = search_conf.trace_sample_rate.value();
+    if (TryDiskANNCall([&]() {
+            search_pool_->parallel_for(0, nq, 1, [&](int64_t index) {
+                if (CancellationToken::CurrentCancelled()) {
+                    return;
+                }
+                QueryTraceScope trace(index_type, sample_rate, index);
+                std::vector<int64_t> result_ids;
+                std::vector<float> result_dists;
+                diskann::QueryStats stats;
+                pq_flash_index_->range_search(xq + (index * dim), radius, min_k, max_k, result_ids, result_dists,
+                                              beamwidth, search_list_and_k_ratio, disk_bitset, &stats, max_results,
+                                              filter_bound);
+                ObserveQueryStats(query_metrics, stats);
+                // filter range search result
+                auto writer = results.Query(index);
+                writer.Append(result_dists.data(), result_ids.data(), result_dists.size(), do_filter, is_ip, radius,
+                              range_filter);
+                if (delta_res != nullptr) {
+                    auto lims = delta_res->GetLims();
+                    auto delta_ids = delta_res->GetIds();
+                    std::vector<int64_t> ids(delta_ids + lims[index], delta_ids + lims[index + 1]);
+                    for (auto& id : ids) {
+                        id += disk_count;
+                    }
+                    writer.Append(delta_res->GetDistance() + lims[index], ids.data(), ids.size(), do_filter, is_ip,
+                                  radius, range_filter);
+                }
+            });
+        }) != Status::success) {
+        all_searches_are_good = false;
     }
+    ReportSectorBufferPool();
     if (!all_searches_are_good) {
         return expected<DataSetPtr>::Err(Status::diskann_inner_error, "some search failed");
     }
+    if (cancellation != nullptr && cancellation->IsCancelled()) {
+        return expected<DataSetPtr>::Err(Status::search_cancelled, "range search cancelled");
+    }
 
-    GetRangeSearchResult(result_dist_array, result_id_array, is_ip, nq, radius, search_conf.range_filter.value(),
-                         p_dist, p_id, p_lims);
-    return GenResultDataSet(nq, p_id, p_dist, p_lims);
+    bool owned = results.Build(search_conf, p_dist, p_id, p_lims);
+    auto res = GenResultDataSet(nq, p_id, p_dist, p_lims);
+    res->SetIsOwner(owned);
+    return res;
 }
 
 /*
@@ -666,14 +1489,64 @@ DiskANNIndexNode<T>::GetVectorByIds(const DataSet& dataset) const {
         return expected<DataSetPtr>::Err(Status::malloc_error, "failed to allocate memory for data");
     }
 
-    if (TryDiskANNCall([&]() { pq_flash_index_->get_vector_by_ids(ids, rows, data); }) != Status::success) {
+    // the rows of the delta index are got from it, the others from the disk index
+    std::shared_lock fresh_lock(fresh_mutex_);
+    auto disk_count = count_.load();
+    std::vector<int64_t> disk_ids, disk_rows, delta_ids, delta_rows;
+    for (int64_t i = 0; i < rows; i++) {
+        if (ids[i] < disk_count) {
+            disk_ids.push_back(ids[i]);
+            disk_rows.push_back(i);
+        } else {
+            delta_ids.push_back(ids[i] - disk_count);
+            delta_rows.push_back(i);
+        }
+    }
+    if (delta_ids.empty()) {
+        if (TryDiskANNCall([&]() { pq_flash_index_->get_vector_by_ids(ids, rows, data); }) != Status::success) {
+            delete[] data;
+            return expected<DataSetPtr>::Err(Status::diskann_inner_error, "failed to get vector");
+        }
+        return GenResultDataSet(rows, dim, data);
+    }
+
+    std::vector<float> disk_data(disk_ids.size() * dim);
+    if (TryDiskANNCall([&]() {
+            pq_flash_index_->get_vector_by_ids(disk_ids.data(), disk_ids.size(), disk_data.data());
+        }) != Status::success) {
         delete[] data;
         return expected<DataSetPtr>::Err(Status::diskann_inner_error, "failed to get vector");
-    };
-
+    }
+    auto delta_data = delta_.GetVectorByIds(*GenIdsDataSet(delta_ids.size(), delta_ids.data()));
+    if (!delta_data.has_value()) {
+        delete[] data;
+        return expected<DataSetPtr>::Err(delta_data.error(), "failed to get vector from the delta index");
+    }
+    auto delta_tensor = static_cast<const float*>(delta_data.value()->GetTensor());
+    for (size_t i = 0; i < disk_rows.size(); i++) {
+        std::copy_n(disk_data.data() + i * dim, dim, data + disk_rows[i] * dim);
+    }
+    for (size_t i = 0; i < delta_rows.size(); i++) {
+        std::copy_n(delta_tensor + i * dim, dim, data + delta_rows[i] * dim);
+    }
     return GenResultDataSet(rows, dim, data);
 }
 
+template <typename T>
+folly::Future<expected<DataSetPtr>>
+DiskANNIndexNode<T>::GetVectorByIdsAsync(const DataSet& dataset) const {
+    if (!is_prepared_.load() || !pq_flash_index_) {
+        LOG_KNOWHERE_ERROR_ << "Failed to load diskann.";
+        return folly::makeFuture(expected<DataSetPtr>::Err(Status::empty_index, "index not loaded"));
+    }
+    // the reads run on the search pool, with ids of their own as the caller may drop the dataset
+    std::vector<int64_t> ids(dataset.GetIds(), dataset.GetIds() + dataset.GetRows());
+    return search_pool_->push([this, ids = std::move(ids)]() {
+        auto ids_ds = GenIdsDataSet(ids.size(), ids.data());
+        return GetVectorByIds(*ids_ds);
+    });
+}
+
 template <typename T>
 expected<DataSetPtr>
 DiskANNIndexNode<T>::GetIndexMeta(const Config& cfg) const {
@@ -690,6 +1563,17 @@ DiskANNIndexNode<T>::GetIndexMeta(const Config& cfg) const {
 
     Json json_meta, json_id_set;
     nlohmann::to_json(json_meta, meta);
+    switch (prepare_state_.load()) {
+        case PrepareState::kWarmingUp:
+            json_meta["prepare_state"] = "warming_up";
+            break;
+        case PrepareState::kReady:
+            json_meta["prepare_state"] = "ready";
+            break;
+        case PrepareState::kFailed:
+            json_meta["prepare_state"] = "failed";
+            break;
+    }
     nlohmann::to_json(json_id_set, id_set);
     return GenResultDataSet(json_meta.dump(), json_id_set.dump());
 }
@@ -12,6 +12,9 @@
 #ifndef DISKANN_CONFIG_H
 #define DISKANN_CONFIG_H
 
+#include <strings.h>
+
+#include "common/knn_util.h"
 #include "knowhere/config.h"
 
 namespace knowhere {
@@ -20,6 +23,9 @@ namespace {
 
 constexpr const CFG_INT::value_type kSearchListSizeMinValue = 16;
 constexpr const CFG_INT::value_type kDefaultSearchListSizeForBuild = 128;
+constexpr const char* kDiskSqTypeNone = "NONE";
+constexpr const char* kDiskSqTypeSQ8 = "SQ8";
+constexpr const char* kDiskSqTypeFP16 = "FP16";
 
 }  // namespace
 
@@ -29,6 +35,11 @@ class DiskANNConfig : public BaseConfig {
     CFG_STRING index_prefix;
     // The path to the raw data file. Raw data's format should be [row_num(4 bytes) | dim_num(4 bytes) | vectors].
     CFG_STRING data_path;
+    // The path to a file of one uint32 label per row, e.g. its tenant, in the format of the raw data with a dim of 1.
+    // The rows of every label get a graph of their own, stitched into the graph of the index: a search with a
+    // filter_label then starts from the medoid of the label and only follows the edges to its rows, instead of reading
+    // the nodes the bitset filters out. Float vectors only, empty for none.
+    CFG_STRING label_path;
     // This is the degree of the graph index, typically between 60 and 150. Larger R will result in larger indices and
     // longer indexing times, but better search quality.
     CFG_INT max_degree;
@@ -53,6 +64,31 @@ class DiskANNConfig : public BaseConfig {
     // This is the flag to enable fast build, in which we will not build vamana graph by full 2 round. This can
     // accelerate index build ~30% with an ~1% recall regression.
     CFG_BOOL accelerate_build;
+    // Reorder the nodes on SSD so that each sector holds a node and its graph neighbors instead of the nodes of
+    // consecutive ids. A search that reads a sector then also gets nodes it is likely to need next, see
+    // score_sector_nodes.
+    CFG_BOOL graph_layout;
+    // Store the adjacency list of each node on SSD delta-encoded: its ids sorted and the gaps between them bit-packed
+    // at the width of the largest one, about half of the 32 bits of an id for the max_degree neighbors among millions
+    // of points. The slots shrink to the longest encoded list, so more nodes fit a sector and a hop reads fewer.
+    CFG_BOOL compress_graph;
+    // When the index does not fit in build_dram_budget_gb, the data is split into shards that are built separately and
+    // merged. This many shards are built at once, each sized for its share of the budget: more shards of fewer points
+    // each, which keeps the cores busy through the single-threaded phases of every shard build.
+    CFG_INT build_concurrent_shards;
+    // Store SQ8 (1 byte per dimension) or FP16 codes of the vectors in the nodes on SSD instead of the vectors, so that
+    // more nodes fit in a sector and the node cache. The float vectors are kept at the end of the index file to rerank
+    // the final candidates. Only for float vectors of at most 1024 dimensions, and not along with disk_pq_dims.
+    CFG_STRING disk_sq_type;
+    // Build the graph from an approximate kNN graph of the vectors, by NN_DESCENT on the CPU or CAGRA on the GPU:
+    // the neighbors of every node are pruned from its kNN and the nodes having it in theirs, without the searches of
+    // the Vamana passes. Float vectors only, NONE builds by the searches.
+    CFG_STRING knn_graph;
+    // Sample this fraction of the vectors into a small in-memory navigation graph, searched before every disk search
+    // for the entry points of it: the sampled points closest to the query rather than the medoid, which saves the first
+    // hops of the search on SSD. The load keeps it within search_cache_budget_gb, the node cache gets the rest. Float
+    // vectors only, 0 for none.
+    CFG_FLOAT nav_graph_ratio;
     // While serving the index, the entire graph is stored on SSD. For faster search performance, you can cache a few
     // frequently accessed nodes in memory.
     CFG_FLOAT search_cache_budget_gb;
@@ -62,6 +98,35 @@ class DiskANNConfig : public BaseConfig {
     // cached the nodes on the search paths; 2. do bfs from the entry point and cache them. The first method is suitable
     // for TopK query heavy circumstances and the second one performed better in range search.
     CFG_BOOL use_bfs_cache;
+    // Instead of a cache fixed at load time, cache the nodes the searches read the most, learnt from the live traffic
+    // and reconsidered every dynamic_cache_refresh_queries searches. The refresh builds the new cache next to the one
+    // the searches keep using, so each holds at most half of search_cache_budget_gb.
+    CFG_BOOL dynamic_cache;
+    CFG_INT dynamic_cache_refresh_queries;
+    // Let the concurrent searches share the sectors they read at the same time: a search that needs a sector another
+    // one is reading waits for that read instead of issuing its own. Saves SSD bandwidth when many similar queries
+    // are searched together, e.g. in batch scoring, at the cost of a little synchronization per read.
+    CFG_BOOL coalesce_reads;
+    // Stripe the disk index across the directories of this comma separated list, one per SSD, and read it from the
+    // stripes: the reads of a search go to all the devices at once, so that one index is served by the IOPS of all
+    // of them rather than of the device it was loaded to. The stripes are disk_stripe_sectors sectors each, written
+    // by the load and removed with the index; they are read with aio, whether io_uring is enabled or not.
+    CFG_STRING disk_stripe_paths;
+    CFG_INT disk_stripe_sectors;
+    // Return from the load as soon as the index can serve searches: the PQ compressed vectors are mapped instead of
+    // read, and the node cache and the warm up are done in the background while the first searches run without them.
+    // A node cache that would be learnt from sample queries is taken around the entry points instead. GetIndexMeta
+    // reports the progress as prepare_state.
+    CFG_BOOL lazy_prepare;
+    // The loaded index takes inserts into an in-memory HNSW index searched along with it, and deletes as a list of
+    // ids filtered out of its searches. Once the deletes since the last merge reach this fraction of the points of
+    // the disk index, a streaming merge in the background rewrites the neighbor lists on disk that link to them,
+    // sector by sector. 0 never merges.
+    CFG_FLOAT streaming_merge_ratio;
+    // The memory of the hot tier, in MB, 0 for none. The hot tier holds the vectors of the points the searches hit
+    // most, lately, in an in-memory HNSW index that the searches run in parallel with the disk index; it is rebuilt
+    // in the background from the hits as they shift. L2 and COSINE only, as the vectors come from the disk index.
+    CFG_FLOAT hot_tier_memory_mb;
     // The beamwidth to be used for search. This is the maximum number of IO requests each query will issue per
     // iteration of search code. Larger beamwidth will result in fewer IO round-trips per query but might result in
     // slightly higher total number of IO requests to SSD per query. For the highest query throughput with a fixed SSD
@@ -78,6 +143,31 @@ class DiskANNConfig : public BaseConfig {
     // value should be in range of [0.0, 1.0] which means when greater or equal to x% of the bits are set,
     // use PQ + Refine. Default to -1.0f, negative vlaues will use dynamic threshold calculator given topk.
     CFG_FLOAT filter_threshold;
+    // Keep beamwidth reads in flight and expand each node as soon as its sector arrives, instead of waiting for the
+    // whole beam of every round. A slow read then only delays its own node, which cuts the tail latency, but the
+    // search may read a few more nodes than the round based one.
+    CFG_BOOL pipelined_search;
+    // Compute the full precision distance of every node in the sectors a search reads, not only of the expanded ones,
+    // so that they can enter the result without being expanded. Meant for indexes built with graph_layout.
+    CFG_BOOL score_sector_nodes;
+    // Adapt the beam of every query: the search starts with a beam twice beamwidth, to cut the round-trips while
+    // the candidates are far from the query, halves it down to beamwidth / 2 with every round that does not improve
+    // the top k, and stops before search_list_size is exhausted once the top k is expanded and stable for a few
+    // rounds. Ignored by pipelined_search.
+    CFG_BOOL adaptive_beamwidth;
+    // Search this many queries at once on each thread of the pool: every query keeps its beamwidth reads in flight
+    // and the thread expands the nodes of whichever query a read completes for, so that it works rather than waits
+    // for the disk, and the queries are no longer bound by the threads. The searches that trace, pipeline their
+    // reads, adapt their beam, score sector nodes, filter by label or have a budget go query by query.
+    CFG_INT search_interleave;
+    // Bound the work of every query: a search that issued search_io_budget sector reads, or that has run for
+    // search_time_budget_ms, stops expanding and returns the best results it found. The result then reports the
+    // number of queries cut short, see DataSet::GetPartialQueries. 0 disables either bound.
+    CFG_INT search_io_budget;
+    CFG_FLOAT search_time_budget_ms;
+    // Search only the rows of this label of an index built with label_path, -1 for all of them. The bitset still
+    // applies to the rows of the label.
+    CFG_INT filter_label;
     KNOHWERE_DECLARE_CONFIG(DiskANNConfig) {
         KNOWHERE_CONFIG_DECLARE_FIELD(metric_type)
             .set_default("L2")
@@ -89,6 +179,10 @@ class DiskANNConfig : public BaseConfig {
             .for_train()
             .for_deserialize();
         KNOWHERE_CONFIG_DECLARE_FIELD(data_path).description("raw data path.").for_train();
+        KNOWHERE_CONFIG_DECLARE_FIELD(label_path)
+            .description("path of the labels of the rows.")
+            .set_default("")
+            .for_train();
         KNOWHERE_CONFIG_DECLARE_FIELD(max_degree)
             .description("the degree of the graph index.")
             .set_default(48)
@@ -116,6 +210,32 @@ class DiskANNConfig : public BaseConfig {
             .description("a flag to enbale fast build.")
             .set_default(false)
             .for_train();
+        KNOWHERE_CONFIG_DECLARE_FIELD(graph_layout)
+            .description("pack the graph neighbors of a node into its sector on disk.")
+            .set_default(false)
+            .for_train();
+        KNOWHERE_CONFIG_DECLARE_FIELD(compress_graph)
+            .description("delta-encode the adjacency lists of the nodes on disk.")
+            .set_default(false)
+            .for_train();
+        KNOWHERE_CONFIG_DECLARE_FIELD(build_concurrent_shards)
+            .description("the number of shards built at once when the data exceeds the build DRAM budget.")
+            .set_default(1)
+            .set_range(1, 64)
+            .for_train();
+        KNOWHERE_CONFIG_DECLARE_FIELD(disk_sq_type)
+            .description("the type of the codes of the vectors stored on the ssd, NONE, SQ8 or FP16.")
+            .set_default(kDiskSqTypeNone)
+            .for_train();
+        KNOWHERE_CONFIG_DECLARE_FIELD(knn_graph)
+            .description("the kNN graph the graph is pruned from, NONE, NN_DESCENT or CAGRA.")
+            .set_default(kKnnGraphNone)
+            .for_train();
+        KNOWHERE_CONFIG_DECLARE_FIELD(nav_graph_ratio)
+            .description("the fraction of the vectors sampled into the in-memory navigation graph.")
+            .set_default(0)
+            .set_range(0, 1)
+            .for_train();
         KNOWHERE_CONFIG_DECLARE_FIELD(search_cache_budget_gb)
             .description("the size of cached nodes in GB.")
             .set_default(0)
@@ -130,6 +250,42 @@ class DiskANNConfig : public BaseConfig {
             .description("should bfs strategy to cache nodes.")
             .set_default(false)
             .for_deserialize();
+        KNOWHERE_CONFIG_DECLARE_FIELD(dynamic_cache)
+            .description("cache the nodes most read by the searches instead of a fixed set.")
+            .set_default(false)
+            .for_deserialize();
+        KNOWHERE_CONFIG_DECLARE_FIELD(dynamic_cache_refresh_queries)
+            .description("number of searches between two refreshes of the dynamic cache.")
+            .set_default(1000)
+            .set_range(1, std::numeric_limits<CFG_INT::value_type>::max())
+            .for_deserialize();
+        KNOWHERE_CONFIG_DECLARE_FIELD(coalesce_reads)
+            .description("share the sector reads concurrent searches have in flight.")
+            .set_default(false)
+            .for_deserialize();
+        KNOWHERE_CONFIG_DECLARE_FIELD(disk_stripe_paths)
+            .description("the directories of the devices to stripe the disk index across.")
+            .set_default("")
+            .for_deserialize();
+        KNOWHERE_CONFIG_DECLARE_FIELD(disk_stripe_sectors)
+            .description("the sectors of a stripe of the disk index.")
+            .set_default(16)
+            .set_range(1, 65536)
+            .for_deserialize();
+        KNOWHERE_CONFIG_DECLARE_FIELD(lazy_prepare)
+            .description("serve searches before the node cache and the warm up are done.")
+            .set_default(false)
+            .for_deserialize();
+        KNOWHERE_CONFIG_DECLARE_FIELD(streaming_merge_ratio)
+            .description("the fraction of deleted points that starts a streaming merge of the disk graph.")
+            .set_default(0.01)
+            .set_range(0, 1)
+            .for_deserialize();
+        KNOWHERE_CONFIG_DECLARE_FIELD(hot_tier_memory_mb)
+            .description("the memory of the in-memory tier of the most hit points, in MB.")
+            .set_default(0)
+            .set_range(0, std::numeric_limits<CFG_FLOAT::value_type>::max())
+            .for_deserialize();
         KNOWHERE_CONFIG_DECLARE_FIELD(beamwidth)
             .description("the maximum number of IO requests each query will issue per iteration of search code.")
             .set_default(8)
@@ -156,6 +312,38 @@ class DiskANNConfig : public BaseConfig {
             .set_default(-1.0f)
             .set_range(-1.0f, 1.0f)
             .for_search();
+        KNOWHERE_CONFIG_DECLARE_FIELD(pipelined_search)
+            .description("overlap the reads of the next candidates with the expansion of the arrived ones.")
+            .set_default(false)
+            .for_search();
+        KNOWHERE_CONFIG_DECLARE_FIELD(score_sector_nodes)
+            .description("score all the nodes of the sectors read, not only the expanded ones.")
+            .set_default(false)
+            .for_search();
+        KNOWHERE_CONFIG_DECLARE_FIELD(adaptive_beamwidth)
+            .description("narrow the beam as the candidates converge and stop once the top k is stable.")
+            .set_default(false)
+            .for_search();
+        KNOWHERE_CONFIG_DECLARE_FIELD(search_interleave)
+            .description("the number of queries a thread searches at once, overlapping their reads.")
+            .set_default(1)
+            .set_range(1, 256)
+            .for_search();
+        KNOWHERE_CONFIG_DECLARE_FIELD(search_io_budget)
+            .description("the max number of sector reads of a query, 0 for no limit.")
+            .set_default(0)
+            .set_range(0, std::numeric_limits<CFG_INT::value_type>::max())
+            .for_search();
+        KNOWHERE_CONFIG_DECLARE_FIELD(search_time_budget_ms)
+            .description("the time after which a query stops expanding, 0 for no limit.")
+            .set_default(0)
+            .set_range(0, std::numeric_limits<CFG_FLOAT::value_type>::max())
+            .for_search();
+        KNOWHERE_CONFIG_DECLARE_FIELD(filter_label)
+            .description("the label of the rows to search, -1 for all.")
+            .set_default(-1)
+            .set_range(-1, std::numeric_limits<uint32_t>::max())
+            .for_search();
     }
 
     inline Status
@@ -177,6 +365,20 @@ class DiskANNConfig : public BaseConfig {
         if (!search_list_size.has_value()) {
             search_list_size = kDefaultSearchListSizeForBuild;
         }
+        auto& type = disk_sq_type.value();
+        if (strcasecmp(type.c_str(), kDiskSqTypeNone) && strcasecmp(type.c_str(), kDiskSqTypeSQ8) &&
+            strcasecmp(type.c_str(), kDiskSqTypeFP16)) {
+            LOG_KNOWHERE_ERROR_ << "invalid disk_sq_type " << type << " for diskann";
+            return Status::invalid_args;
+        }
+        if (strcasecmp(type.c_str(), kDiskSqTypeNone) && disk_pq_dims.value() != 0) {
+            LOG_KNOWHERE_ERROR_ << "disk_sq_type " << type << " does not go with disk_pq_dims";
+            return Status::invalid_args;
+        }
+        if (!IsValidKnnGraph(knn_graph.value())) {
+            LOG_KNOWHERE_ERROR_ << "invalid knn_graph " << knn_graph.value() << " for diskann";
+            return Status::invalid_args;
+        }
         return Status::success;
     }
 };
@@ -9,10 +9,13 @@
 // is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
 // or implied. See the License for the specific language governing permissions and limitations under the License.
 
+#include "common/knn_util.h"
 #include "common/metric.h"
 #include "common/range_util.h"
 #include "faiss/IndexBinaryFlat.h"
 #include "faiss/IndexFlat.h"
+#include "faiss/IndexFlatHalf.h"
+#include "faiss/IndexFlatInt8.h"
 #include "faiss/index_io.h"
 #include "index/flat/flat_config.h"
 #include "io/FaissIO.h"
@@ -23,8 +26,54 @@
 
 namespace knowhere {
 
+// the rows of another type than the storage of the index that Add converts to floats at a time
+constexpr int64_t kFlatConvertChunkRows = 4096;
+
+// Every distance is exact, so the first Refill computes them all and the iteration only pops the heap.
+class FlatIterator : public IndexIterator {
+ public:
+    FlatIterator(const faiss::Index* index, const float* query, const BitsetView& bitset, bool is_cosine)
+        : IndexIterator(index->metric_type == faiss::METRIC_INNER_PRODUCT),
+          index_(index),
+          query_(query, query + index->d),
+          bitset_(bitset) {
+        if (is_cosine) {
+            NormalizeVec(query_.data(), index->d);
+        }
+    }
+
+ protected:
+    Status
+    Refill(int64_t wanted, bool& exhausted) override {
+        ThreadPool::ScopedOmpSetter setter(1);
+        bool is_ip = index_->metric_type == faiss::METRIC_INNER_PRODUCT;
+        float radius = is_ip ? -std::numeric_limits<float>::infinity() : std::numeric_limits<float>::infinity();
+        faiss::RangeSearchResult res(1);
+        try {
+            index_->range_search(1, query_.data(), radius, &res, bitset_);
+        } catch (const std::exception& e) {
+            LOG_KNOWHERE_WARNING_ << "error inner faiss: " << e.what();
+            return Status::faiss_inner_error;
+        }
+        for (size_t i = 0; i < res.lims[1]; ++i) {
+            Push(res.distances[i], res.labels[i]);
+        }
+        exhausted = true;
+        return Status::success;
+    }
+
+ private:
+    const faiss::Index* index_;
+    std::vector<float> query_;
+    BitsetView bitset_;
+};
+
 template <typename T>
 class FlatIndexNode : public IndexNode {
+    // float vectors are held by an IndexFlat or, stored as halves, an IndexFlatHalf; rows of FP16 and BF16 are held
+    // by an IndexFlatHalf and rows of INT8 by an IndexFlatInt8 as they are
+    using IndexType = std::conditional_t<std::is_same<T, faiss::IndexFlat>::value, faiss::IndexFlatCodes, T>;
+
  public:
     FlatIndexNode(const Object&) : index_(nullptr) {
         static_assert(std::is_same<T, faiss::IndexFlat>::value || std::is_same<T, faiss::IndexBinaryFlat>::value,
@@ -32,12 +81,22 @@ class FlatIndexNode : public IndexNode {
         search_pool_ = ThreadPool::GetGlobalSearchThreadPool();
     }
 
+    bool
+    SupportsDataType(DataType type) const override {
+        if constexpr (std::is_same<T, faiss::IndexFlat>::value) {
+            return type == DataType::FLOAT32 || type == DataType::FP16 || type == DataType::BF16 ||
+                   type == DataType::INT8;
+        }
+        return type == DataType::FLOAT32;
+    }
+
     Status
     Train(const DataSet& dataset, const Config& cfg) override {
         const FlatConfig& f_cfg = static_cast<const FlatConfig&>(cfg);
+        bool is_cosine = IsMetricType(f_cfg.metric_type.value(), knowhere::metric::COSINE);
 
-        // do normalize for COSINE metric type
-        if (IsMetricType(f_cfg.metric_type.value(), knowhere::metric::COSINE)) {
+        // do normalize for COSINE metric type, Add normalizes the rows of other types once converted
+        if (is_cosine && dataset.GetDataType() == DataType::FLOAT32) {
             Normalize(dataset);
         }
 
@@ -46,6 +105,32 @@ class FlatIndexNode : public IndexNode {
             LOG_KNOWHERE_WARNING_ << "please check metric type: " << f_cfg.metric_type.value();
             return metric.error();
         }
+        if constexpr (std::is_same<T, faiss::IndexFlat>::value) {
+            // rows of another type than FLOAT32 are stored as they are, but for normalized rows of INT8, which keep
+            // their fractions as FP16
+            switch (dataset.GetDataType()) {
+                case DataType::FP16:
+                case DataType::BF16:
+                    index_ = std::make_unique<faiss::IndexFlatHalf>(dataset.GetDim(), metric.value(),
+                                                                    dataset.GetDataType() == DataType::BF16);
+                    return Status::success;
+                case DataType::INT8:
+                    if (is_cosine) {
+                        index_ = std::make_unique<faiss::IndexFlatHalf>(dataset.GetDim(), metric.value(), false);
+                    } else {
+                        index_ = std::make_unique<faiss::IndexFlatInt8>(dataset.GetDim(), metric.value());
+                    }
+                    return Status::success;
+                default:
+                    break;
+            }
+            auto& storage_type = f_cfg.storage_type.value();
+            if (strcasecmp(storage_type.c_str(), kStorageTypeFP32)) {
+                bool bf16 = !strcasecmp(storage_type.c_str(), kStorageTypeBF16);
+                index_ = std::make_unique<faiss::IndexFlatHalf>(dataset.GetDim(), metric.value(), bf16);
+                return Status::success;
+            }
+        }
         index_ = std::make_unique<T>(dataset.GetDim(), metric.value());
         return Status::success;
     }
@@ -55,7 +140,31 @@ class FlatIndexNode : public IndexNode {
         auto x = dataset.GetTensor();
         auto n = dataset.GetRows();
         if constexpr (std::is_same<T, faiss::IndexFlat>::value) {
-            index_->add(n, (const float*)x);
+            auto type = dataset.GetDataType();
+            if (type == DataType::FLOAT32) {
+                index_->add(n, (const float*)x);
+                return Status::success;
+            }
+            const FlatConfig& f_cfg = static_cast<const FlatConfig&>(cfg);
+            bool is_cosine = IsMetricType(f_cfg.metric_type.value(), knowhere::metric::COSINE);
+            if (!is_cosine && StoresDataType(type)) {
+                // the rows are the codes
+                auto bytes = static_cast<const uint8_t*>(x);
+                index_->codes.insert(index_->codes.end(), bytes, bytes + n * index_->code_size);
+                index_->ntotal += n;
+                return Status::success;
+            }
+            auto dim = dataset.GetDim();
+            auto row_size = dim * DataTypeSize(type);
+            std::vector<float> rows(std::min(n, kFlatConvertChunkRows) * dim);
+            for (int64_t i = 0; i < n; i += kFlatConvertChunkRows) {
+                auto chunk = std::min(n - i, kFlatConvertChunkRows);
+                ConvertToFloat(static_cast<const uint8_t*>(x) + i * row_size, type, chunk * dim, rows.data());
+                if (is_cosine) {
+                    NormalizeVecs(rows.data(), chunk, dim);
+                }
+                index_->add(chunk, rows.data());
+            }
         }
         if constexpr (std::is_same<T, faiss::IndexBinaryFlat>::value) {
             index_->add(n, (const uint8_t*)x);
@@ -79,50 +188,67 @@ class FlatIndexNode : public IndexNode {
         auto x = dataset.GetTensor();
         auto dim = dataset.GetDim();
 
-        auto len = k * nq;
-        int64_t* ids = nullptr;
-        float* distances = nullptr;
+        KnnResultBuffers buffers(f_cfg, k * nq);
+        int64_t* ids = buffers.ids;
+        float* distances = buffers.distances;
+        // INT8 queries of rows stored as INT8 are searched as they are, the queries of the other types as floats
+        auto int8_index = Int8Index(dataset);
+        DataSetPtr converted;
+        auto float_x = int8_index == nullptr ? FloatQueries(dataset, converted) : nullptr;
         try {
-            ids = new (std::nothrow) int64_t[len];
-            distances = new (std::nothrow) float[len];
-            std::vector<folly::Future<folly::Unit>> futs;
-            futs.reserve(nq);
-            for (int i = 0; i < nq; ++i) {
-                futs.emplace_back(search_pool_->push([&, index = i] {
-                    ThreadPool::ScopedOmpSetter setter(1);
-                    auto cur_ids = ids + k * index;
-                    auto cur_dis = distances + k * index;
-                    if constexpr (std::is_same<T, faiss::IndexFlat>::value) {
-                        auto cur_query = (const float*)x + dim * index;
-                        std::unique_ptr<float[]> copied_query = nullptr;
-                        if (is_cosine) {
-                            copied_query = CopyAndNormalizeFloatVec(cur_query, dim);
-                            cur_query = copied_query.get();
-                        }
-                        index_->search(1, cur_query, k, cur_dis, cur_ids, bitset);
+            if constexpr (std::is_same<T, faiss::IndexFlat>::value) {
+                // the base rows are normalized already for COSINE, so only the queries are
+                auto metric = index_->metric_type;
+                auto flat = dynamic_cast<const faiss::IndexFlat*>(index_.get());
+                if (flat != nullptr && (metric == faiss::METRIC_L2 || metric == faiss::METRIC_INNER_PRODUCT) &&
+                    nq >= kKnnBatchMinQueries) {
+                    std::unique_ptr<float[]> copied_queries = nullptr;
+                    auto xq = float_x;
+                    if (is_cosine) {
+                        copied_queries = std::make_unique<float[]>(nq * dim);
+                        std::copy_n(xq, nq * dim, copied_queries.get());
+                        NormalizeVecs(copied_queries.get(), nq, dim);
+                        xq = copied_queries.get();
+                    }
+                    KnnBatchSearch(flat->get_xb(), flat->ntotal, xq, nq, dim, k, metric, false, distances, ids,
+                                   bitset);
+                    return buffers.ToDataSet(nq, k);
+                }
+            }
+            search_pool_->parallel_for(0, nq, 1, [&](int64_t index) {
+                ThreadPool::ScopedOmpSetter setter(1);
+                auto cur_ids = ids + k * index;
+                auto cur_dis = distances + k * index;
+                if constexpr (std::is_same<T, faiss::IndexFlat>::value) {
+                    if (int8_index != nullptr) {
+                        int8_index->search_int8(1, (const int8_t*)x + dim * index, k, cur_dis, cur_ids, bitset);
+                        return;
                     }
-                    if constexpr (std::is_same<T, faiss::IndexBinaryFlat>::value) {
-                        auto cur_i_dis = reinterpret_cast<int32_t*>(cur_dis);
-                        index_->search(1, (const uint8_t*)x + index * dim / 8, k, cur_i_dis, cur_ids, bitset);
-                        if (index_->metric_type == faiss::METRIC_Hamming) {
-                            for (int64_t j = 0; j < k; j++) {
-                                cur_dis[j] = static_cast<float>(cur_i_dis[j]);
-                            }
+                    auto cur_query = float_x + dim * index;
+                    std::unique_ptr<float[]> copied_query = nullptr;
+                    if (is_cosine) {
+                        copied_query = CopyAndNormalizeFloatVec(cur_query, dim);
+                        cur_query = copied_query.get();
+                    }
+                    index_->search(1, cur_query, k, cur_dis, cur_ids, bitset);
+                }
+                if constexpr (std::is_same<T, faiss::IndexBinaryFlat>::value) {
+                    auto cur_i_dis = reinterpret_cast<int32_t*>(cur_dis);
+                    index_->search(1, (const uint8_t*)x + index * dim / 8, k, cur_i_dis, cur_ids, bitset);
+                    if (index_->metric_type == faiss::METRIC_Hamming) {
+                        for (int64_t j = 0; j < k; j++) {
+                            cur_dis[j] = static_cast<float>(cur_i_dis[j]);
                         }
                     }
-                }));
-            }
-            for (auto& fut : futs) {
-                fut.wait();
-            }
+                }
+            });
         } catch (const std::exception& e) {
-            std::unique_ptr<int64_t[]> auto_delete_ids(ids);
-            std::unique_ptr<float[]> auto_delete_dis(distances);
+            buffers.Free();
             LOG_KNOWHERE_WARNING_ << "error inner faiss: " << e.what();
             return expected<DataSetPtr>::Err(Status::faiss_inner_error, e.what());
         }
 
-        return GenResultDataSet(nq, k, ids, distances);
+        return buffers.ToDataSet(nq, k);
     }
 
     expected<DataSetPtr>
@@ -146,21 +272,22 @@ class FlatIndexNode : public IndexNode {
         int64_t* ids = nullptr;
         float* distances = nullptr;
         size_t* lims = nullptr;
+        bool owned = true;
 
-        std::vector<std::vector<int64_t>> result_id_array(nq);
-        std::vector<std::vector<float>> result_dist_array(nq);
-        std::vector<size_t> result_size(nq);
-        std::vector<size_t> result_lims(nq + 1);
+        RangeSearchResultBuilder results(nq, f_cfg.max_results.value(), is_ip);
+        auto int8_index = Int8Index(dataset);
+        DataSetPtr converted;
+        auto float_xq = int8_index == nullptr ? FloatQueries(dataset, converted) : nullptr;
 
         try {
-            std::vector<folly::Future<folly::Unit>> futs;
-            futs.reserve(nq);
-            for (int i = 0; i < nq; ++i) {
-                futs.emplace_back(search_pool_->push([&, index = i] {
-                    ThreadPool::ScopedOmpSetter setter(1);
-                    faiss::RangeSearchResult res(1);
-                    if constexpr (std::is_same<T, faiss::IndexFlat>::value) {
-                        auto cur_query = (const float*)xq + dim * index;
+            search_pool_->parallel_for(0, nq, 1, [&](int64_t index) {
+                ThreadPool::ScopedOmpSetter setter(1);
+                faiss::RangeSearchResult res(1);
+                if constexpr (std::is_same<T, faiss::IndexFlat>::value) {
+                    if (int8_index != nullptr) {
+                        int8_index->range_search_int8(1, (const int8_t*)xq + dim * index, radius, &res, bitset);
+                    } else {
+                        auto cur_query = float_xq + dim * index;
                         std::unique_ptr<float[]> copied_query = nullptr;
                         if (is_cosine) {
                             copied_query = CopyAndNormalizeFloatVec(cur_query, dim);
@@ -168,34 +295,45 @@ class FlatIndexNode : public IndexNode {
                         }
                         index_->range_search(1, cur_query, radius, &res, bitset);
                     }
-                    if constexpr (std::is_same<T, faiss::IndexBinaryFlat>::value) {
-                        index_->range_search(1, (const uint8_t*)xq + index * dim / 8, radius, &res, bitset);
-                    }
-                    auto elem_cnt = res.lims[1];
-                    result_dist_array[index].resize(elem_cnt);
-                    result_id_array[index].resize(elem_cnt);
-                    result_size[index] = elem_cnt;
-                    for (size_t j = 0; j < elem_cnt; j++) {
-                        result_dist_array[index][j] = res.distances[j];
-                        result_id_array[index][j] = res.labels[j];
-                    }
-                    if (f_cfg.range_filter.value() != defaultRangeFilter) {
-                        FilterRangeSearchResultForOneNq(result_dist_array[index], result_id_array[index], is_ip, radius,
-                                                        range_filter);
-                    }
-                }));
-            }
-            for (auto& fut : futs) {
-                fut.wait();
-            }
-            GetRangeSearchResult(result_dist_array, result_id_array, is_ip, nq, radius, range_filter, distances, ids,
-                                 lims);
+                }
+                if constexpr (std::is_same<T, faiss::IndexBinaryFlat>::value) {
+                    index_->range_search(1, (const uint8_t*)xq + index * dim / 8, radius, &res, bitset);
+                }
+                results.Query(index).Append(res.distances, res.labels, res.lims[1],
+                                            f_cfg.range_filter.value() != defaultRangeFilter, is_ip, radius,
+                                            range_filter);
+            });
+            owned = results.Build(f_cfg, distances, ids, lims);
         } catch (const std::exception& e) {
             LOG_KNOWHERE_WARNING_ << "error inner faiss: " << e.what();
             return expected<DataSetPtr>::Err(Status::faiss_inner_error, e.what());
         }
 
-        return GenResultDataSet(nq, ids, distances, lims);
+        auto res = GenResultDataSet(nq, ids, distances, lims);
+        res->SetIsOwner(owned);
+        return res;
+    }
+
+    expected<std::vector<IndexIteratorPtr>>
+    AnnIterator(const DataSet& dataset, const Config& cfg, const BitsetView& bitset) const override {
+        if constexpr (std::is_same<T, faiss::IndexFlat>::value) {
+            if (!index_) {
+                LOG_KNOWHERE_WARNING_ << "iterator on empty index";
+                return expected<std::vector<IndexIteratorPtr>>::Err(Status::empty_index, "index not loaded");
+            }
+            const FlatConfig& f_cfg = static_cast<const FlatConfig&>(cfg);
+            bool is_cosine = IsMetricType(f_cfg.metric_type.value(), knowhere::metric::COSINE);
+            // the iterators copy their queries, the converted ones need not outlive them
+            DataSetPtr converted;
+            auto xq = FloatQueries(dataset, converted);
+            auto dim = dataset.GetDim();
+            std::vector<IndexIteratorPtr> iterators(dataset.GetRows());
+            for (size_t i = 0; i < iterators.size(); ++i) {
+                iterators[i] = std::make_shared<FlatIterator>(index_.get(), xq + i * dim, bitset, is_cosine);
+            }
+            return iterators;
+        }
+        return expected<std::vector<IndexIteratorPtr>>::Err(Status::not_implemented, "no iterator for " + Type());
     }
 
     expected<DataSetPtr>
@@ -236,7 +374,9 @@ class FlatIndexNode : public IndexNode {
     bool
     HasRawData(const std::string& metric_type) const override {
         if constexpr (std::is_same<T, faiss::IndexFlat>::value) {
-            return !IsMetricType(metric_type, metric::COSINE);
+            // halves and int8 are not the vectors added
+            return !IsMetricType(metric_type, metric::COSINE) &&
+                   (!index_ || dynamic_cast<const faiss::IndexFlat*>(index_.get()) != nullptr);
         }
         if constexpr (std::is_same<T, faiss::IndexBinaryFlat>::value) {
             return true;
@@ -255,15 +395,8 @@ class FlatIndexNode : public IndexNode {
             expected<DataSetPtr>::Err(Status::empty_index, "index not loaded");
         }
         try {
-            MemoryIOWriter writer;
-            if constexpr (std::is_same<T, faiss::IndexFlat>::value) {
-                faiss::write_index(index_.get(), &writer);
-            }
-            if constexpr (std::is_same<T, faiss::IndexBinaryFlat>::value) {
-                faiss::write_index_binary(index_.get(), &writer);
-            }
-            std::shared_ptr<uint8_t[]> data(writer.data_);
-            binset.Append(Type(), data, writer.rp);
+            auto [data, size] = SerializeToMemory([&](MemoryIOWriter& writer) { WriteIndex(&writer); });
+            binset.Append(Type(), data, size);
             return Status::success;
         } catch (const std::exception& e) {
             LOG_KNOWHERE_WARNING_ << "error inner faiss: " << e.what();
@@ -271,6 +404,23 @@ class FlatIndexNode : public IndexNode {
         }
     }
 
+    Status
+    SerializeToFile(SectionWriter& writer) const override {
+        if (!index_) {
+            LOG_KNOWHERE_ERROR_ << "Can not serialize empty index.";
+            return Status::empty_index;
+        }
+        RETURN_IF_ERROR(writer.Begin(Type()));
+        try {
+            SectionIOWriter section(writer);
+            WriteIndex(&section);
+        } catch (const std::exception& e) {
+            LOG_KNOWHERE_WARNING_ << "error inner faiss: " << e.what();
+            return Status::faiss_inner_error;
+        }
+        return writer.End();
+    }
+
     Status
     Deserialize(const BinarySet& binset, const Config& config) override {
         std::vector<std::string> names = {"IVF",        // compatible with knowhere-1.x
@@ -287,11 +437,11 @@ class FlatIndexNode : public IndexNode {
         reader.data_ = binary->data.get();
         if constexpr (std::is_same<T, faiss::IndexFlat>::value) {
             faiss::Index* index = faiss::read_index(&reader);
-            index_.reset(static_cast<T*>(index));
+            index_.reset(static_cast<IndexType*>(index));
         }
         if constexpr (std::is_same<T, faiss::IndexBinaryFlat>::value) {
             faiss::IndexBinary* index = faiss::read_index_binary(&reader);
-            index_.reset(static_cast<T*>(index));
+            index_.reset(static_cast<IndexType*>(index));
         }
         return Status::success;
     }
@@ -305,17 +455,33 @@ class FlatIndexNode : public IndexNode {
             io_flags |= faiss::IO_FLAG_MMAP;
         }
 
-        if constexpr (std::is_same<T, faiss::IndexFlat>::value) {
-            faiss::Index* index = faiss::read_index(filename.data(), io_flags);
-            index_.reset(static_cast<T*>(index));
-        }
-        if constexpr (std::is_same<T, faiss::IndexBinaryFlat>::value) {
-            faiss::IndexBinary* index = faiss::read_index_binary(filename.data(), io_flags);
-            index_.reset(static_cast<T*>(index));
+        try {
+            auto reader = OpenFaissFile(filename, cfg.file_offset);
+            if constexpr (std::is_same<T, faiss::IndexFlat>::value) {
+                faiss::Index* index = faiss::read_index(reader.get(), io_flags);
+                index_.reset(static_cast<IndexType*>(index));
+            }
+            if constexpr (std::is_same<T, faiss::IndexBinaryFlat>::value) {
+                faiss::IndexBinary* index = faiss::read_index_binary(reader.get(), io_flags);
+                index_.reset(static_cast<IndexType*>(index));
+            }
+        } catch (const std::exception& e) {
+            LOG_KNOWHERE_WARNING_ << "faiss inner error: " << e.what();
+            return Status::faiss_inner_error;
         }
         return Status::success;
     }
 
+    void
+    SetSearchPool(std::shared_ptr<ThreadPool> pool) override {
+        search_pool_ = std::move(pool);
+    }
+
+    std::shared_ptr<ThreadPool>
+    AsyncSearchPool() const override {
+        return search_pool_;
+    }
+
     std::unique_ptr<BaseConfig>
     CreateConfig() const override {
         return std::make_unique<FlatConfig>();
@@ -328,7 +494,23 @@ class FlatIndexNode : public IndexNode {
 
     int64_t
     Size() const override {
-        return index_->ntotal * index_->d * sizeof(float);
+        return GetMemoryUsage().Total();
+    }
+
+    MemoryUsage
+    GetMemoryUsage() const override {
+        MemoryUsage usage;
+        if (!index_) {
+            return usage;
+        }
+        // faiss reads the vectors into memory even when asked to map them
+        if constexpr (std::is_same<T, faiss::IndexFlat>::value) {
+            usage.Add(MemoryUsage::kVectors, MemoryUsage::kHeap, index_->codes.capacity());
+        } else {
+            usage.Add(MemoryUsage::kVectors, MemoryUsage::kHeap, index_->xb.capacity());
+        }
+        usage.Add(MemoryUsage::kOther, MemoryUsage::kHeap, sizeof(*index_));
+        return usage;
     }
 
     int64_t
@@ -347,7 +529,48 @@ class FlatIndexNode : public IndexNode {
     }
 
  private:
-    std::unique_ptr<T> index_;
+    // whether the index stores rows of the type as they are, for Add to take them as its codes
+    bool
+    StoresDataType(DataType type) const {
+        if (type == DataType::INT8) {
+            return dynamic_cast<const faiss::IndexFlatInt8*>(index_.get()) != nullptr;
+        }
+        auto half = dynamic_cast<const faiss::IndexFlatHalf*>(index_.get());
+        return half != nullptr && (type == DataType::FP16 || type == DataType::BF16) &&
+               half->bf16 == (type == DataType::BF16);
+    }
+
+    // the index of rows stored as INT8 if the queries are INT8 too, null otherwise
+    const faiss::IndexFlatInt8*
+    Int8Index(const DataSet& dataset) const {
+        if (dataset.GetDataType() != DataType::INT8) {
+            return nullptr;
+        }
+        return dynamic_cast<const faiss::IndexFlatInt8*>(index_.get());
+    }
+
+    // the queries as floats, converted into converted if they are of another type
+    static const float*
+    FloatQueries(const DataSet& dataset, DataSetPtr& converted) {
+        if (dataset.GetDataType() == DataType::FLOAT32) {
+            return static_cast<const float*>(dataset.GetTensor());
+        }
+        converted = ConvertToFloat(dataset);
+        return static_cast<const float*>(converted->GetTensor());
+    }
+
+    // writes the index in the faiss format, for Serialize and SerializeToFile
+    void
+    WriteIndex(faiss::IOWriter* writer) const {
+        if constexpr (std::is_same<T, faiss::IndexFlat>::value) {
+            faiss::write_index(index_.get(), writer);
+        }
+        if constexpr (std::is_same<T, faiss::IndexBinaryFlat>::value) {
+            faiss::write_index_binary(index_.get(), writer);
+        }
+    }
+
+    std::unique_ptr<IndexType> index_;
     std::shared_ptr<ThreadPool> search_pool_;
 };
 
@@ -13,10 +13,40 @@
 #define FLAT_CONFIG_H
 
 #include "knowhere/config.h"
+#include "knowhere/utils.h"
 
 namespace knowhere {
 
-class FlatConfig : public BaseConfig {};
+namespace {
+
+constexpr const char* kStorageTypeFP32 = "FP32";
+constexpr const char* kStorageTypeFP16 = "FP16";
+constexpr const char* kStorageTypeBF16 = "BF16";
+
+}  // namespace
+
+class FlatConfig : public BaseConfig {
+ public:
+    CFG_STRING storage_type;
+    KNOHWERE_DECLARE_CONFIG(FlatConfig) {
+        KNOWHERE_CONFIG_DECLARE_FIELD(storage_type)
+            .set_default(kStorageTypeFP32)
+            .description("type the float vectors are stored as, FP32/FP16/BF16, the halves search within their "
+                         "precision of the exact distances.")
+            .for_train();
+    }
+
+    inline Status
+    CheckAndAdjustForBuild() override {
+        auto& type = storage_type.value();
+        if (strcasecmp(type.c_str(), kStorageTypeFP32) && strcasecmp(type.c_str(), kStorageTypeFP16) &&
+            strcasecmp(type.c_str(), kStorageTypeBF16)) {
+            LOG_KNOWHERE_ERROR_ << "invalid storage_type " << type;
+            return Status::invalid_args;
+        }
+        return Status::success;
+    }
+};
 
 }  // namespace knowhere
 
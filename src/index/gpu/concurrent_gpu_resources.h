@@ -0,0 +1,231 @@
+// Copyright (C) 2019-2023 Zilliz. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file except in compliance
+// with the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
+// or implied. See the License for the specific language governing permissions and limitations under the License
+
+#pragma once
+
+#include <faiss/gpu/StandardGpuResources.h>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace knowhere {
+
+// faiss GPU resources that several searches use at once. Each lane is a StandardGpuResourcesImpl of its own, with a
+// stream, a cuBLAS handle, temporary and pinned memory; a search takes a free lane for its thread with a LaneScope and
+// every faiss call of that thread goes to the lane. The calls of a thread holding no lane, like freeing an index, go
+// to the first lane; memory always goes back to the lane it came from.
+class ConcurrentGpuResources : public faiss::gpu::GpuResourcesProvider {
+    class Impl;
+
+ public:
+    static constexpr size_t kMaxLanes = 64;
+
+    ConcurrentGpuResources(size_t lanes, size_t tmp_mem_sz, size_t pin_mem_sz)
+        : impl_(std::make_shared<Impl>(std::clamp<size_t>(lanes, 1, kMaxLanes), tmp_mem_sz, pin_mem_sz)) {
+    }
+
+    std::shared_ptr<faiss::gpu::GpuResources>
+    getResources() override {
+        return impl_;
+    }
+
+    size_t
+    Lanes() const {
+        return impl_->lanes_.size();
+    }
+
+    // Binds a free lane to the calling thread until destroyed, waiting while all of them are taken. A scope inside
+    // another one of the same thread takes a lane of its own and gives the outer one back to the thread when done.
+    class LaneScope {
+     public:
+        explicit LaneScope(ConcurrentGpuResources& res)
+            : impl_(res.impl_.get()), lane_(impl_->Acquire()), prev_(Impl::Current()) {
+            Impl::Current() = {impl_, lane_};
+        }
+
+        ~LaneScope() {
+            Impl::Current() = prev_;
+            impl_->Release(lane_);
+        }
+
+        LaneScope(const LaneScope&) = delete;
+        LaneScope&
+        operator=(const LaneScope&) = delete;
+
+     private:
+        Impl* impl_;
+        size_t lane_;
+        std::pair<const void*, size_t> prev_;
+    };
+
+ private:
+    class Impl : public faiss::gpu::GpuResources {
+     public:
+        Impl(size_t lanes, size_t tmp_mem_sz, size_t pin_mem_sz)
+            : free_(lanes == kMaxLanes ? ~uint64_t{0} : (uint64_t{1} << lanes) - 1) {
+            for (size_t i = 0; i < lanes; ++i) {
+                auto lane = std::make_unique<Lane>();
+                lane->res.setTempMemory(tmp_mem_sz);
+                lane->res.setPinnedMemory(pin_mem_sz);
+                lanes_.push_back(std::move(lane));
+            }
+        }
+
+        // the lane bound to the calling thread and the resources it is of
+        static std::pair<const void*, size_t>&
+        Current() {
+            static thread_local std::pair<const void*, size_t> current{nullptr, 0};
+            return current;
+        }
+
+        // lock-free as long as a lane is free
+        size_t
+        Acquire() {
+            while (true) {
+                auto free = free_.load();
+                while (free != 0) {
+                    auto lane = static_cast<size_t>(__builtin_ctzll(free));
+                    if (free_.compare_exchange_weak(free, free & ~(uint64_t{1} << lane))) {
+                        return lane;
+                    }
+                }
+                std::unique_lock lock(wait_mutex_);
+                ++waiters_;
+                lane_freed_.wait(lock, [this]() { return free_.load() != 0; });
+                --waiters_;
+            }
+        }
+
+        void
+        Release(size_t lane) {
+            free_.fetch_or(uint64_t{1} << lane);
+            if (waiters_.load() > 0) {
+                std::lock_guard lock(wait_mutex_);
+                lane_freed_.notify_one();
+            }
+        }
+
+        void
+        initializeForDevice(int device) override {
+            std::lock_guard lock(CurrentLane().mutex);
+            CurrentLane().res.initializeForDevice(device);
+        }
+
+        cublasHandle_t
+        getBlasHandle(int device) override {
+            return CurrentLane().res.getBlasHandle(device);
+        }
+
+        cudaStream_t
+        getDefaultStream(int device) override {
+            return CurrentLane().res.getDefaultStream(device);
+        }
+
+        void
+        setDefaultStream(int device, cudaStream_t stream) override {
+            CurrentLane().res.setDefaultStream(device, stream);
+        }
+
+        std::vector<cudaStream_t>
+        getAlternateStreams(int device) override {
+            return CurrentLane().res.getAlternateStreams(device);
+        }
+
+        void*
+        allocMemory(const faiss::gpu::AllocRequest& req) override {
+            auto lane = CurrentIndex();
+            void* p = nullptr;
+            {
+                std::lock_guard lock(lanes_[lane]->mutex);
+                p = lanes_[lane]->res.allocMemory(req);
+            }
+            if (p != nullptr) {
+                std::lock_guard lock(owners_mutex_);
+                owners_[p] = lane;
+            }
+            return p;
+        }
+
+        void
+        deallocMemory(int device, void* p) override {
+            if (p == nullptr) {
+                return;
+            }
+            size_t lane = 0;
+            {
+                std::lock_guard lock(owners_mutex_);
+                auto it = owners_.find(p);
+                if (it != owners_.end()) {
+                    lane = it->second;
+                    owners_.erase(it);
+                }
+            }
+            std::lock_guard lock(lanes_[lane]->mutex);
+            lanes_[lane]->res.deallocMemory(device, p);
+        }
+
+        size_t
+        getTempMemoryAvailable(int device) const override {
+            return lanes_[CurrentIndex()]->res.getTempMemoryAvailable(device);
+        }
+
+        std::pair<void*, size_t>
+        getPinnedMemory() override {
+            return CurrentLane().res.getPinnedMemory();
+        }
+
+        cudaStream_t
+        getAsyncCopyStream(int device) override {
+            return CurrentLane().res.getAsyncCopyStream(device);
+        }
+
+     private:
+        friend class ConcurrentGpuResources;
+
+        struct Lane {
+            faiss::gpu::StandardGpuResourcesImpl res;
+            // only the thread holding the lane allocates from it, but a free comes from any thread
+            std::mutex mutex;
+        };
+
+        size_t
+        CurrentIndex() const {
+            const auto& [owner, lane] = Current();
+            return owner == this ? lane : 0;
+        }
+
+        Lane&
+        CurrentLane() {
+            return *lanes_[CurrentIndex()];
+        }
+
+        std::vector<std::unique_ptr<Lane>> lanes_;
+        // a bit set for every free lane
+        std::atomic<uint64_t> free_;
+        std::atomic<int64_t> waiters_{0};
+        std::mutex wait_mutex_;
+        std::condition_variable lane_freed_;
+        // the lane of every allocation
+        std::mutex owners_mutex_;
+        std::unordered_map<void*, size_t> owners_;
+    };
+
+    std::shared_ptr<Impl> impl_;
+};
+
+}  // namespace knowhere
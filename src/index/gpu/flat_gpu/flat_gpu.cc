@@ -9,6 +9,8 @@
 // is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
 // or implied. See the License for the specific language governing permissions and limitations under the License.
 
+#include "common/gpu_metrics.h"
+#include "common/knn_util.h"
 #include "common/metric.h"
 #include "faiss/IndexFlat.h"
 #include "faiss/gpu/GpuCloner.h"
@@ -17,6 +19,8 @@
 #include "index/gpu/gpu_res_mgr.h"
 #include "io/FaissIO.h"
 #include "knowhere/factory.h"
+#include "knowhere/index_node_batching_wrapper.h"
+#include "knowhere/index_node_multi_gpu_wrapper.h"
 #include "knowhere/log.h"
 
 namespace knowhere {
@@ -62,23 +66,26 @@ class GpuFlatIndexNode : public IndexNode {
         const FlatConfig& f_cfg = static_cast<const FlatConfig&>(cfg);
         auto nq = dataset.GetRows();
         auto x = dataset.GetTensor();
-        auto len = f_cfg.k * nq;
-        int64_t* ids = nullptr;
-        float* dis = nullptr;
+        KnnResultBuffers buffers(f_cfg, f_cfg.k * nq);
+        // the device reads the bits of the filter
+        std::vector<uint8_t> dense_bits;
         try {
-            ids = new (std::nothrow) int64_t[len];
-            dis = new (std::nothrow) float[len];
-
             ResScope rs(res_, false);
-            index_->search(nq, (const float*)x, f_cfg.k, dis, ids, bitset);
+            // faiss copies the queries, the filter and the results itself, the kernel stage is the whole search
+            GpuStageTimer timer(GetGpuMetrics(Type()));
+            auto dense = bitset.to_dense(dense_bits);
+            timer.Time(GpuStageTimer::kKernel, rs.Stream(), [&] {
+                index_->search(nq, (const float*)x, f_cfg.k, buffers.distances, buffers.ids, dense);
+            });
+            timer.H2D(nq * index_->d * sizeof(float) + dense.byte_size());
+            timer.D2H(nq * f_cfg.k.value() * (sizeof(int64_t) + sizeof(float)));
         } catch (const std::exception& e) {
-            std::unique_ptr<int64_t[]> auto_delete_ids(ids);
-            std::unique_ptr<float[]> auto_delete_dis(dis);
+            buffers.Free();
             LOG_KNOWHERE_WARNING_ << "faiss inner error, " << e.what();
             return expected<DataSetPtr>::Err(Status::faiss_inner_error, e.what());
         }
 
-        return GenResultDataSet(nq, f_cfg.k, ids, dis);
+        return buffers.ToDataSet(nq, f_cfg.k);
     }
 
     expected<DataSetPtr>
@@ -117,11 +124,10 @@ class GpuFlatIndexNode : public IndexNode {
             expected<DataSetPtr>::Err(Status::empty_index, "index not loaded");
         }
         try {
-            MemoryIOWriter writer;
             // Serialize() is called after Add(), at this time index_ is CPU index actually
-            faiss::write_index(index_.get(), &writer);
-            std::shared_ptr<uint8_t[]> data(writer.data_);
-            binset.Append(Type(), data, writer.rp);
+            auto [data, size] =
+                SerializeToMemory([&](MemoryIOWriter& writer) { faiss::write_index(index_.get(), &writer); });
+            binset.Append(Type(), data, size);
         } catch (const std::exception& e) {
             LOG_KNOWHERE_WARNING_ << "faiss inner error, " << e.what();
             return expected<DataSetPtr>::Err(Status::faiss_inner_error, e.what());
@@ -142,7 +148,8 @@ class GpuFlatIndexNode : public IndexNode {
             reader.data_ = binary->data.get();
             std::unique_ptr<faiss::Index> index(faiss::read_index(&reader));
 
-            auto gpu_res = GPUResMgr::GetInstance().GetRes();
+            const auto& gpu_cfg = static_cast<const GpuFlatConfig&>(config);
+            auto gpu_res = GPUResMgr::GetInstance().GetRes(gpu_cfg.gpu_id.value());
             ResScope rs(gpu_res, true);
             auto gpu_index = faiss::gpu::index_cpu_to_gpu(gpu_res->faiss_res_.get(), gpu_res->gpu_id_, index.get());
             index_.reset(gpu_index);
@@ -176,6 +183,13 @@ class GpuFlatIndexNode : public IndexNode {
         return index_->ntotal * index_->d * sizeof(float);
     }
 
+    MemoryUsage
+    GetMemoryUsage() const override {
+        MemoryUsage usage;
+        usage.Add(MemoryUsage::kVectors, MemoryUsage::kDevice, Size());
+        return usage;
+    }
+
     int64_t
     Count() const override {
         return index_->ntotal;
@@ -191,6 +205,9 @@ class GpuFlatIndexNode : public IndexNode {
     std::unique_ptr<faiss::Index> index_;
 };
 
-KNOWHERE_REGISTER_GLOBAL(GPU_FAISS_FLAT, [](const Object& object) { return Index<GpuFlatIndexNode>::Create(object); });
+KNOWHERE_REGISTER_GLOBAL(GPU_FAISS_FLAT, [](const Object& object) {
+    return Index<IndexNodeBatchingWrapper>::Create(std::make_unique<IndexNodeMultiGpuWrapper>(
+        []() { return std::make_unique<GpuFlatIndexNode>(nullptr); }));
+});
 
 }  // namespace knowhere
@@ -19,8 +19,22 @@ namespace knowhere {
 class GpuFlatConfig : public FlatConfig {
  public:
     CFG_INT gpu_id;
+    CFG_LIST gpu_ids;
+    CFG_STRING multi_gpu_mode;
     KNOHWERE_DECLARE_CONFIG(GpuFlatConfig) {
-        KNOWHERE_CONFIG_DECLARE_FIELD(gpu_id).description("gpu device id").set_default(0).for_train();
+        KNOWHERE_CONFIG_DECLARE_FIELD(gpu_id)
+            .description("gpu device id, -1 for the first one given to KnowhereConfig::InitGPUResource")
+            .set_default(-1)
+            .for_train()
+            .for_deserialize();
+        KNOWHERE_CONFIG_DECLARE_FIELD(gpu_ids)
+            .description("gpu device ids the index is replicated or sharded over, instead of gpu_id")
+            .allow_empty_without_default()
+            .for_train();
+        KNOWHERE_CONFIG_DECLARE_FIELD(multi_gpu_mode)
+            .description("how the index spans several gpu_ids: replicated or sharded")
+            .set_default("replicated")
+            .for_train();
     }
 };
 
@@ -12,6 +12,8 @@
 #pragma once
 
 #include <faiss/gpu/StandardGpuResources.h>
+
+#include "index/gpu/concurrent_gpu_resources.h"
 #ifdef KNOWHERE_WITH_RAFT
 #include <rmm/cuda_device.hpp>
 #include <rmm/mr/device/device_memory_resource.hpp>
@@ -20,43 +22,51 @@
 #include <vector>
 #endif
 
+#include <map>
 #include <memory>
 #include <mutex>
 #include <utility>
 
 #include "knowhere/comp/blocking_queue.h"
 #include "knowhere/log.h"
+#include "knowhere/prometheus_client.h"
 
 namespace knowhere {
 
 constexpr int64_t MB = 1LL << 20;
 
+// The indexes built on a resource share it, up to streams_per_res_ of their searches run on it at once.
 struct Resource {
-    Resource(int64_t gpu_id, faiss::gpu::StandardGpuResources* r) : faiss_res_(r), gpu_id_(gpu_id) {
+    Resource(int64_t gpu_id, ConcurrentGpuResources* r) : faiss_res_(r), gpu_id_(gpu_id) {
         static int64_t global_id = 0;
         id_ = global_id++;
     }
 
-    std::unique_ptr<faiss::gpu::StandardGpuResources> faiss_res_;
+    std::unique_ptr<ConcurrentGpuResources> faiss_res_;
     int64_t id_;
     int64_t gpu_id_;
-    std::mutex mutex_;
 };
 using ResPtr = std::shared_ptr<Resource>;
 using ResWPtr = std::weak_ptr<Resource>;
 
+// The memory sizes are those of every stream, a device reserves them res_num_ * streams_per_res_ times.
 struct GPUParams {
-    int64_t tmp_mem_sz_ = 256 * MB;
-    int64_t pin_mem_sz_ = 256 * MB;
+    int64_t tmp_mem_sz_ = 64 * MB;
+    int64_t pin_mem_sz_ = 16 * MB;
     int64_t res_num_ = 2;
+    int64_t streams_per_res_ = 4;
 
     GPUParams() {
     }
 
     GPUParams(int64_t res_num) : res_num_(res_num) {
     }
+
+    GPUParams(int64_t res_num, int64_t streams_per_res) : res_num_(res_num), streams_per_res_(streams_per_res) {
+    }
 };
 
+// The faiss resources of every device, each device has a pool of its own that the indexes on it take from.
 class GPUResMgr {
  public:
     friend class ResScope;
@@ -69,43 +79,39 @@ class GPUResMgr {
         return instance;
     }
 
+    // Registers a device with the params of its pool, the first one registered is the default device.
     void
     InitDevice(const int64_t gpu_id, const GPUParams& gpu_params) {
         // check gpu device validation
         faiss::gpu::setCurrentDevice(gpu_id);
 
-        gpu_id_ = gpu_id;
-        gpu_params_.res_num_ = gpu_params.res_num_;
-        gpu_params_.tmp_mem_sz_ = gpu_params.tmp_mem_sz_;
-        gpu_params_.pin_mem_sz_ = gpu_params.pin_mem_sz_;
-
-        LOG_KNOWHERE_DEBUG_ << "InitDevice gpu_id " << gpu_id_ << ", resource count " << gpu_params_.res_num_
-                            << ", tmp_mem_sz " << gpu_params_.tmp_mem_sz_ / MB << "MB, pin_mem_sz "
-                            << gpu_params_.pin_mem_sz_ / MB << "MB";
+        std::lock_guard<std::mutex> lock(init_mutex_);
+        if (devices_.empty()) {
+            gpu_id_ = gpu_id;
+        }
+        auto& device = devices_[gpu_id];
+        if (device == nullptr) {
+            device = std::make_unique<Device>();
+        }
+        device->params_.res_num_ = gpu_params.res_num_;
+        device->params_.streams_per_res_ = gpu_params.streams_per_res_;
+        device->params_.tmp_mem_sz_ = gpu_params.tmp_mem_sz_;
+        device->params_.pin_mem_sz_ = gpu_params.pin_mem_sz_;
+
+        LOG_KNOWHERE_DEBUG_ << "InitDevice gpu_id " << gpu_id << ", resource count " << gpu_params.res_num_
+                            << ", tmp_mem_sz " << gpu_params.tmp_mem_sz_ / MB << "MB, pin_mem_sz "
+                            << gpu_params.pin_mem_sz_ / MB << "MB";
     }
 
+    // Creates the pools of the registered devices, of the default device with the default params if none is.
     void
     Init() {
-        if (!init_) {
-            // double-check for thread safe
-            std::lock_guard<std::mutex> lock(init_mutex_);
-            if (!init_) {
-                for (int64_t i = 0; i < gpu_params_.res_num_; ++i) {
-                    auto gpu_res = new faiss::gpu::StandardGpuResources();
-                    auto res = std::make_shared<Resource>(gpu_id_, gpu_res);
-
-                    cudaStream_t s;
-                    CUDA_VERIFY(cudaStreamCreate(&s));
-                    gpu_res->setDefaultStream(gpu_id_, s);
-                    gpu_res->setTempMemory(gpu_params_.tmp_mem_sz_);
-                    // need not set pinned memory by now
-
-                    res_bq_.Put(res);
-                }
-                LOG_KNOWHERE_DEBUG_ << "Init gpu_id " << gpu_id_ << ", resource count " << res_bq_.Size()
-                                    << ", tmp_mem_sz " << gpu_params_.tmp_mem_sz_ / MB << "MB";
-                init_ = true;
-            }
+        std::lock_guard<std::mutex> lock(init_mutex_);
+        if (devices_.empty()) {
+            devices_[gpu_id_] = std::make_unique<Device>();
+        }
+        for (auto& [gpu_id, device] : devices_) {
+            InitPool(gpu_id, *device);
         }
     }
 
@@ -113,55 +119,120 @@ class GPUResMgr {
     // This func should be invoked before main return
     void
     Free() {
-        while (!res_bq_.Empty()) {
-            res_bq_.Take();
+        std::lock_guard<std::mutex> lock(init_mutex_);
+        for (auto& [gpu_id, device] : devices_) {
+            while (!device->res_bq_.Empty()) {
+                device->res_bq_.Take();
+            }
+            device->init_ = false;
+            GetGpuPoolBytesGauge(gpu_id, "faiss_tmp", "reserved").Set(0);
+            GetGpuPoolBytesGauge(gpu_id, "faiss_pinned", "reserved").Set(0);
         }
-        init_ = false;
     }
 
+    // A resource of the device, of the default one for -1. It waits for one while all of the pool are taken; the pool
+    // of a device never registered is created with the default params.
     ResPtr
-    GetRes() {
-        // Generally Init() should be called separately,
-        // here is for supporting python test
-        Init();
-        auto res = res_bq_.Take();
+    GetRes(int64_t gpu_id = -1) {
+        Device* device = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(init_mutex_);
+            if (gpu_id < 0) {
+                gpu_id = gpu_id_;
+            }
+            auto& entry = devices_[gpu_id];
+            if (entry == nullptr) {
+                entry = std::make_unique<Device>();
+            }
+            device = entry.get();
+            // Generally Init() should be called separately,
+            // here is for supporting python test
+            InitPool(gpu_id, *device);
+        }
+        auto res = device->res_bq_.Take();
+        GetGpuResourcesInUseGauge(gpu_id).Increment();
         return res;
     }
 
     void
     PutRes(const ResPtr& res) {
-        res_bq_.Put(res);
+        Device* device = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(init_mutex_);
+            auto it = devices_.find(res->gpu_id_);
+            if (it == devices_.end()) {
+                return;
+            }
+            device = it->second.get();
+        }
+        GetGpuResourcesInUseGauge(res->gpu_id_).Decrement();
+        device->res_bq_.Put(res);
     }
 
  protected:
-    bool init_ = false;
+    struct Device {
+        GPUParams params_;
+        ResBQ res_bq_;
+        bool init_ = false;
+    };
+
+    // with init_mutex_ held
+    void
+    InitPool(int64_t gpu_id, Device& device) {
+        if (device.init_) {
+            return;
+        }
+        // the pinned memory is allocated on the current device
+        faiss::gpu::setCurrentDevice(gpu_id);
+        const auto& params = device.params_;
+        for (int64_t i = 0; i < params.res_num_; ++i) {
+            // every stream creates its own on the first use of the device
+            auto gpu_res = new ConcurrentGpuResources(params.streams_per_res_, params.tmp_mem_sz_, params.pin_mem_sz_);
+            device.res_bq_.Put(std::make_shared<Resource>(gpu_id, gpu_res));
+        }
+        LOG_KNOWHERE_DEBUG_ << "Init gpu_id " << gpu_id << ", resource count " << device.res_bq_.Size()
+                            << ", streams per resource " << params.streams_per_res_ << ", tmp_mem_sz "
+                            << params.tmp_mem_sz_ / MB << "MB, pin_mem_sz " << params.pin_mem_sz_ / MB << "MB";
+        // every stream of every resource reserves its memory
+        auto streams = params.res_num_ * params.streams_per_res_;
+        GetGpuPoolBytesGauge(gpu_id, "faiss_tmp", "reserved").Set(streams * params.tmp_mem_sz_);
+        GetGpuPoolBytesGauge(gpu_id, "faiss_pinned", "reserved").Set(streams * params.pin_mem_sz_);
+        device.init_ = true;
+    }
+
     std::mutex init_mutex_;
 
+    // the default device
     int64_t gpu_id_ = 0;
-    GPUParams gpu_params_;
-    ResBQ res_bq_;
+    std::map<int64_t, std::unique_ptr<Device>> devices_;
 };
 
+// Runs the faiss calls of the thread on a stream of the resource of its own, other threads use the other streams of
+// the resource at the same time.
 class ResScope {
  public:
-    ResScope(ResPtr& res, const bool renew) : res_(res), renew_(renew) {
-        res_->mutex_.lock();
+    ResScope(ResPtr& res, const bool renew) : res_(res), renew_(renew), lane_(*res_->faiss_res_) {
     }
 
-    ResScope(ResWPtr& res, const bool renew) : res_(res.lock()), renew_(renew) {
-        res_->mutex_.lock();
+    ResScope(ResWPtr& res, const bool renew) : res_(res.lock()), renew_(renew), lane_(*res_->faiss_res_) {
     }
 
     ~ResScope() {
         if (renew_) {
             GPUResMgr::GetInstance().PutRes(res_);
         }
-        res_->mutex_.unlock();
+    }
+
+    // the stream the faiss calls of the thread run on
+    cudaStream_t
+    Stream() const {
+        return res_->faiss_res_->getResources()->getDefaultStream(res_->gpu_id_);
     }
 
  private:
     ResPtr res_;  // hold resource until deconstruct
     bool renew_;
+    ConcurrentGpuResources::LaneScope lane_;
 };
 
 }  // namespace knowhere
@@ -9,6 +9,13 @@
 // is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
 // or implied. See the License for the specific language governing permissions and limitations under the License.
 
+#include <algorithm>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include "common/gpu_metrics.h"
+#include "common/knn_util.h"
 #include "common/metric.h"
 #include "faiss/IndexFlat.h"
 #include "faiss/IndexIVFFlat.h"
@@ -16,6 +23,8 @@
 #include "faiss/IndexReplicas.h"
 #include "faiss/IndexScalarQuantizer.h"
 #include "faiss/gpu/GpuCloner.h"
+#include "faiss/gpu/GpuDistance.h"
+#include "faiss/gpu/GpuIndexFlat.h"
 #include "faiss/gpu/GpuIndexIVF.h"
 #include "faiss/gpu/GpuIndexIVFFlat.h"
 #include "faiss/gpu/GpuIndexIVFPQ.h"
@@ -26,6 +35,8 @@
 #include "io/FaissIO.h"
 #include "knowhere/comp/index_param.h"
 #include "knowhere/factory.h"
+#include "knowhere/index_node_batching_wrapper.h"
+#include "knowhere/index_node_multi_gpu_wrapper.h"
 #include "knowhere/log.h"
 
 namespace knowhere {
@@ -65,6 +76,7 @@ class GpuIvfIndexNode : public IndexNode {
         auto tensor = dataset.GetTensor();
         auto dim = dataset.GetDim();
         auto ivf_gpu_cfg = static_cast<const typename KnowhereConfigType<T>::Type&>(cfg);
+        adapt_for_cpu_ = ivf_gpu_cfg.adapt_for_cpu.value();
 
         auto metric = Str2FaissMetricType(ivf_gpu_cfg.metric_type);
         if (!metric.has_value()) {
@@ -74,14 +86,31 @@ class GpuIvfIndexNode : public IndexNode {
 
         std::unique_ptr<faiss::Index> index;
         try {
-            auto gpu_res = GPUResMgr::GetInstance().GetRes();
+            auto gpu_res = GPUResMgr::GetInstance().GetRes(ivf_gpu_cfg.gpu_id.value());
             ResScope rs(gpu_res, true);
 
             if constexpr (std::is_same<T, faiss::IndexIVFFlat>::value) {
-                faiss::gpu::GpuIndexIVFFlatConfig f_cfg;
-                f_cfg.device = static_cast<int32_t>(gpu_res->gpu_id_);
-                index = std::make_unique<faiss::gpu::GpuIndexIVFFlat>(gpu_res->faiss_res_.get(), dim, ivf_gpu_cfg.nlist,
-                                                                      metric.value(), f_cfg);
+                if (ivf_gpu_cfg.out_of_core.value()) {
+                    // the lists are built on the host, the device only runs the clustering and keeps the centroids
+                    faiss::gpu::GpuIndexFlatConfig c_cfg;
+                    c_cfg.device = static_cast<int32_t>(gpu_res->gpu_id_);
+                    auto coarse = std::make_unique<faiss::gpu::GpuIndexFlat>(gpu_res->faiss_res_.get(), dim,
+                                                                             metric.value(), c_cfg);
+                    auto host = std::make_unique<faiss::IndexIVFFlat>(new faiss::IndexFlat(dim, metric.value()), dim,
+                                                                      ivf_gpu_cfg.nlist.value(), metric.value());
+                    host->own_fields = true;
+                    host->clustering_index = coarse.get();
+                    host->train(rows, reinterpret_cast<const float*>(tensor));
+                    host->clustering_index = nullptr;
+                    coarse->copyFrom(static_cast<const faiss::IndexFlat*>(host->quantizer));
+                    coarse_ = std::move(coarse);
+                    index = std::move(host);
+                } else {
+                    faiss::gpu::GpuIndexIVFFlatConfig f_cfg;
+                    f_cfg.device = static_cast<int32_t>(gpu_res->gpu_id_);
+                    index = std::make_unique<faiss::gpu::GpuIndexIVFFlat>(
+                        gpu_res->faiss_res_.get(), dim, ivf_gpu_cfg.nlist, metric.value(), f_cfg);
+                }
             }
             if constexpr (std::is_same<T, faiss::IndexIVFPQ>::value) {
                 faiss::gpu::GpuIndexIVFPQConfig f_cfg;
@@ -97,7 +126,9 @@ class GpuIvfIndexNode : public IndexNode {
                     gpu_res->faiss_res_.get(), dim, ivf_gpu_cfg.nlist, faiss::QuantizerType::QT_8bit, metric.value(),
                     true, f_cfg);
             }
-            index->train(rows, reinterpret_cast<const float*>(tensor));
+            if (!index->is_trained) {
+                index->train(rows, reinterpret_cast<const float*>(tensor));
+            }
             res_ = gpu_res;
         } catch (std::exception& e) {
             LOG_KNOWHERE_WARNING_ << "faiss inner error, " << e.what();
@@ -121,7 +152,15 @@ class GpuIvfIndexNode : public IndexNode {
         auto tensor = dataset.GetTensor();
         try {
             ResScope rs(res_, false);
-            index_->add(rows, (const float*)tensor);
+            if (coarse_ != nullptr) {
+                // the device assigns the vectors to their lists, the host stores them
+                std::vector<faiss::idx_t> lists(rows);
+                coarse_->assign(rows, (const float*)tensor, lists.data());
+                static_cast<faiss::IndexIVF*>(index_.get())
+                    ->add_core(rows, (const float*)tensor, nullptr, nullptr, lists.data());
+            } else {
+                index_->add(rows, (const float*)tensor);
+            }
         } catch (std::exception& e) {
             LOG_KNOWHERE_WARNING_ << "faiss inner error, " << e.what();
             return expected<DataSetPtr>::Err(Status::faiss_inner_error, e.what());
@@ -138,24 +177,42 @@ class GpuIvfIndexNode : public IndexNode {
         auto k = ivf_gpu_cfg.k;
         auto tensor = dataset.GetTensor();
         auto dim = dataset.GetDim();
-        float* dis = new (std::nothrow) float[rows * k];
-        int64_t* ids = new (std::nothrow) int64_t[rows * k];
+        KnnResultBuffers buffers(ivf_gpu_cfg, rows * k);
+        float* dis = buffers.distances;
+        int64_t* ids = buffers.ids;
+        // the device reads the bits of the filter
+        std::vector<uint8_t> dense_bits;
+        auto dense = bitset.to_dense(dense_bits);
+        if (coarse_ != nullptr) {
+            auto status = SearchOutOfCore((const float*)tensor, rows, ivf_gpu_cfg.k.value(), ivf_gpu_cfg.nprobe.value(),
+                                          dense, dis, ids);
+            if (status != Status::success) {
+                buffers.Free();
+                return expected<DataSetPtr>::Err(status, "out of core search failed");
+            }
+            return buffers.ToDataSet(rows, ivf_gpu_cfg.k);
+        }
         try {
             ResScope rs(res_, false);
             auto gpu_index = dynamic_cast<faiss::gpu::GpuIndexIVF*>(index_.get());
+            // faiss copies the queries, the filter and the results itself, the kernel stage is the whole search
+            GpuStageTimer timer(GetGpuMetrics(Type()));
             for (int i = 0; i < rows; i += block_size) {
                 int64_t search_size = (rows - i > block_size) ? block_size : (rows - i);
-                gpu_index->search_thread_safe(search_size, reinterpret_cast<const float*>(tensor) + i * dim, k,
-                                              ivf_gpu_cfg.nprobe, dis + i * k, ids + i * k, bitset);
+                timer.Time(GpuStageTimer::kKernel, rs.Stream(), [&] {
+                    gpu_index->search_thread_safe(search_size, reinterpret_cast<const float*>(tensor) + i * dim, k,
+                                                  ivf_gpu_cfg.nprobe, dis + i * k, ids + i * k, dense);
+                });
+                timer.H2D(search_size * dim * sizeof(float) + dense.byte_size());
             }
+            timer.D2H(rows * k.value() * (sizeof(int64_t) + sizeof(float)));
         } catch (std::exception& e) {
-            std::unique_ptr<float> auto_delete_dis(dis);
-            std::unique_ptr<int64_t> auto_delete_ids(ids);
+            buffers.Free();
             LOG_KNOWHERE_WARNING_ << "faiss inner error, " << e.what();
             return expected<DataSetPtr>::Err(Status::faiss_inner_error, e.what());
         }
 
-        return GenResultDataSet(rows, ivf_gpu_cfg.k, ids, dis);
+        return buffers.ToDataSet(rows, ivf_gpu_cfg.k);
     }
 
     expected<DataSetPtr>
@@ -185,14 +242,19 @@ class GpuIvfIndexNode : public IndexNode {
         }
 
         try {
-            MemoryIOWriter writer;
-            {
-                faiss::Index* host_index = faiss::gpu::index_gpu_to_cpu(index_.get());
-                faiss::write_index(host_index, &writer);
-                delete host_index;
+            // the copy runs on a stream of its own, next to the searches
+            ResScope rs(res_, false);
+            // out of core, the index is on the host already
+            std::unique_ptr<faiss::Index> host_index(
+                coarse_ != nullptr ? nullptr : faiss::gpu::index_gpu_to_cpu(index_.get()));
+            auto [data, size] = SerializeToMemory([&](MemoryIOWriter& writer) {
+                faiss::write_index(host_index != nullptr ? host_index.get() : index_.get(), &writer);
+            });
+            binset.Append(Type(), data, size);
+            if (adapt_for_cpu_) {
+                // the same faiss binary, the CPU index reads it as it is
+                binset.Append(CpuType(), data, size);
             }
-            std::shared_ptr<uint8_t[]> data(writer.data_);
-            binset.Append(Type(), data, writer.rp);
         } catch (std::exception& e) {
             LOG_KNOWHERE_WARNING_ << "faiss inner error, " << e.what();
             return expected<DataSetPtr>::Err(Status::faiss_inner_error, e.what());
@@ -203,7 +265,8 @@ class GpuIvfIndexNode : public IndexNode {
 
     Status
     Deserialize(const BinarySet& binset, const Config& config) override {
-        auto binary = binset.GetByName(Type());
+        // a CPU IVF index of the same kind loads as well
+        auto binary = binset.GetByNames({Type(), CpuType()});
         if (binary == nullptr) {
             LOG_KNOWHERE_ERROR_ << "invalid binary set.";
             return Status::invalid_binary_set;
@@ -214,8 +277,28 @@ class GpuIvfIndexNode : public IndexNode {
             reader.data_ = binary->data.get();
 
             std::unique_ptr<faiss::Index> index(faiss::read_index(&reader));
-            auto gpu_res = GPUResMgr::GetInstance().GetRes();
+            const auto& gpu_cfg = static_cast<const typename KnowhereConfigType<T>::Type&>(config);
+            adapt_for_cpu_ = gpu_cfg.adapt_for_cpu.value();
+            auto gpu_res = GPUResMgr::GetInstance().GetRes(gpu_cfg.gpu_id.value());
             ResScope rs(gpu_res, true);
+            coarse_ = nullptr;
+            if constexpr (std::is_same<T, faiss::IndexIVFFlat>::value) {
+                if (gpu_cfg.out_of_core.value()) {
+                    // only the centroids go to the device
+                    auto ivf = dynamic_cast<faiss::IndexIVFFlat*>(index.get());
+                    if (ivf == nullptr || ivf->column_blocked) {
+                        LOG_KNOWHERE_ERROR_ << "the binary set is no ivf flat index with plain lists";
+                        return Status::invalid_binary_set;
+                    }
+                    faiss::gpu::GpuIndexFlatConfig c_cfg;
+                    c_cfg.device = static_cast<int32_t>(gpu_res->gpu_id_);
+                    coarse_ = std::make_unique<faiss::gpu::GpuIndexFlat>(
+                        gpu_res->faiss_res_.get(), static_cast<const faiss::IndexFlat*>(ivf->quantizer), c_cfg);
+                    index_ = std::move(index);
+                    res_ = gpu_res;
+                    return Status::success;
+                }
+            }
             auto gpu_index = faiss::gpu::index_cpu_to_gpu(gpu_res->faiss_res_.get(), gpu_res->gpu_id_, index.get());
             index_.reset(gpu_index);
             res_ = gpu_res;
@@ -272,18 +355,144 @@ class GpuIvfIndexNode : public IndexNode {
     }
 
  private:
+    // the CPU IVF index the binary of the GPU one is readable by
+    std::string
+    CpuType() const {
+        if constexpr (std::is_same<faiss::IndexIVFFlat, T>::value) {
+            return knowhere::IndexEnum::INDEX_FAISS_IVFFLAT;
+        }
+        if constexpr (std::is_same<faiss::IndexIVFPQ, T>::value) {
+            return knowhere::IndexEnum::INDEX_FAISS_IVFPQ;
+        }
+        if constexpr (std::is_same<faiss::IndexIVFScalarQuantizer, T>::value) {
+            return knowhere::IndexEnum::INDEX_FAISS_IVFSQ8;
+        }
+    }
+
+    // Out of core, the device finds the lists of the queries, then every list one of them probes goes to the device
+    // once, with all the queries probing it; the candidates of the lists of a query merge on the host.
+    Status
+    SearchOutOfCore(const float* x, int64_t rows, int64_t k, int64_t nprobe, const BitsetView& bitset, float* distances,
+                    int64_t* ids) const {
+        auto ivf = static_cast<const faiss::IndexIVF*>(index_.get());
+        auto dim = ivf->d;
+        auto is_ip = ivf->metric_type == faiss::METRIC_INNER_PRODUCT;
+        nprobe = std::min<int64_t>(nprobe, ivf->nlist);
+        try {
+            auto res = res_.lock();
+            ResScope rs(res, false);
+            faiss::gpu::DeviceScope device(static_cast<int>(res->gpu_id_));
+
+            std::vector<faiss::idx_t> probes(rows * nprobe);
+            std::vector<float> coarse_dis(rows * nprobe);
+            coarse_->search(rows, x, nprobe, coarse_dis.data(), probes.data());
+            std::vector<std::vector<int64_t>> queries_of(ivf->nlist);
+            for (int64_t i = 0; i < rows * nprobe; ++i) {
+                if (probes[i] >= 0) {
+                    queries_of[probes[i]].push_back(i / nprobe);
+                }
+            }
+
+            std::vector<std::vector<std::pair<float, int64_t>>> candidates(rows);
+            std::vector<float> queries, vectors, list_dis;
+            std::vector<int64_t> list_ids, kept_ids;
+            auto invlists = ivf->invlists;
+            for (size_t list = 0; list < ivf->nlist; ++list) {
+                const auto& qs = queries_of[list];
+                if (qs.empty() || invlists->list_size(list) == 0) {
+                    continue;
+                }
+                queries.resize(qs.size() * dim);
+                for (size_t i = 0; i < qs.size(); ++i) {
+                    std::copy_n(x + qs[i] * dim, dim, queries.data() + i * dim);
+                }
+                for (size_t seg = 0; seg < invlists->get_segment_num(list); ++seg) {
+                    auto offset = invlists->get_segment_offset(list, seg);
+                    auto n = static_cast<int64_t>(invlists->get_segment_size(list, seg));
+                    auto codes = reinterpret_cast<const float*>(invlists->get_codes(list, offset));
+                    auto seg_ids = invlists->get_ids(list, offset);
+                    // the filtered vectors never reach the device
+                    if (!bitset.empty()) {
+                        vectors.clear();
+                        kept_ids.clear();
+                        for (int64_t j = 0; j < n; ++j) {
+                            if (static_cast<size_t>(seg_ids[j]) >= bitset.size() || !bitset.test(seg_ids[j])) {
+                                vectors.insert(vectors.end(), codes + j * dim, codes + (j + 1) * dim);
+                                kept_ids.push_back(seg_ids[j]);
+                            }
+                        }
+                        codes = vectors.data();
+                        seg_ids = kept_ids.data();
+                        n = kept_ids.size();
+                    }
+                    if (n == 0) {
+                        continue;
+                    }
+
+                    auto seg_k = std::min(k, n);
+                    list_dis.resize(qs.size() * seg_k);
+                    list_ids.resize(qs.size() * seg_k);
+                    faiss::gpu::GpuDistanceParams params;
+                    params.metric = ivf->metric_type;
+                    params.k = static_cast<int>(seg_k);
+                    params.dims = static_cast<int>(dim);
+                    params.vectors = codes;
+                    params.numVectors = static_cast<int>(n);
+                    params.queries = queries.data();
+                    params.numQueries = static_cast<int>(qs.size());
+                    params.outDistances = list_dis.data();
+                    params.outIndices = list_ids.data();
+                    faiss::gpu::bfKnn(res->faiss_res_.get(), params);
+
+                    for (size_t i = 0; i < qs.size(); ++i) {
+                        for (int64_t j = 0; j < seg_k; ++j) {
+                            auto id = list_ids[i * seg_k + j];
+                            if (id >= 0) {
+                                candidates[qs[i]].emplace_back(list_dis[i * seg_k + j], seg_ids[id]);
+                            }
+                        }
+                    }
+                }
+            }
+
+            auto closer = [is_ip](const std::pair<float, int64_t>& a, const std::pair<float, int64_t>& b) {
+                return is_ip ? a.first > b.first : a.first < b.first;
+            };
+            auto missing = is_ip ? -std::numeric_limits<float>::max() : std::numeric_limits<float>::max();
+            for (int64_t q = 0; q < rows; ++q) {
+                auto& c = candidates[q];
+                auto found = std::min<int64_t>(k, c.size());
+                std::partial_sort(c.begin(), c.begin() + found, c.end(), closer);
+                for (int64_t j = 0; j < k; ++j) {
+                    distances[q * k + j] = j < found ? c[j].first : missing;
+                    ids[q * k + j] = j < found ? c[j].second : -1;
+                }
+            }
+        } catch (std::exception& e) {
+            LOG_KNOWHERE_WARNING_ << "faiss inner error, " << e.what();
+            return Status::faiss_inner_error;
+        }
+        return Status::success;
+    }
+
     mutable ResWPtr res_;
     std::unique_ptr<faiss::Index> index_;
+    // out of core, the centroids on the device, index_ is then the index on the host
+    std::unique_ptr<faiss::Index> coarse_;
+    bool adapt_for_cpu_ = false;
 };
 
 KNOWHERE_REGISTER_GLOBAL(GPU_FAISS_IVF_FLAT, [](const Object& object) {
-    return Index<GpuIvfIndexNode<faiss::IndexIVFFlat>>::Create(object);
+    return Index<IndexNodeBatchingWrapper>::Create(std::make_unique<IndexNodeMultiGpuWrapper>(
+        []() { return std::make_unique<GpuIvfIndexNode<faiss::IndexIVFFlat>>(nullptr); }));
 });
 KNOWHERE_REGISTER_GLOBAL(GPU_FAISS_IVF_PQ, [](const Object& object) {
-    return Index<GpuIvfIndexNode<faiss::IndexIVFPQ>>::Create(object);
+    return Index<IndexNodeBatchingWrapper>::Create(std::make_unique<IndexNodeMultiGpuWrapper>(
+        []() { return std::make_unique<GpuIvfIndexNode<faiss::IndexIVFPQ>>(nullptr); }));
 });
 KNOWHERE_REGISTER_GLOBAL(GPU_FAISS_IVF_SQ8, [](const Object& object) {
-    return Index<GpuIvfIndexNode<faiss::IndexIVFScalarQuantizer>>::Create(object);
+    return Index<IndexNodeBatchingWrapper>::Create(std::make_unique<IndexNodeMultiGpuWrapper>(
+        []() { return std::make_unique<GpuIvfIndexNode<faiss::IndexIVFScalarQuantizer>>(nullptr); }));
 });
 
 }  // namespace knowhere
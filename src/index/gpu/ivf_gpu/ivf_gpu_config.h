@@ -16,24 +16,91 @@ namespace knowhere {
 class GpuIvfFlatConfig : public IvfFlatConfig {
  public:
     CFG_INT gpu_id;
+    CFG_LIST gpu_ids;
+    CFG_STRING multi_gpu_mode;
+    CFG_BOOL adapt_for_cpu;
+    CFG_BOOL out_of_core;
     KNOHWERE_DECLARE_CONFIG(GpuIvfFlatConfig) {
-        KNOWHERE_CONFIG_DECLARE_FIELD(gpu_id).description("gpu device id").set_default(0).for_train();
+        KNOWHERE_CONFIG_DECLARE_FIELD(gpu_id)
+            .description("gpu device id, -1 for the first one given to KnowhereConfig::InitGPUResource")
+            .set_default(-1)
+            .for_train()
+            .for_deserialize();
+        KNOWHERE_CONFIG_DECLARE_FIELD(gpu_ids)
+            .description("gpu device ids the index is replicated or sharded over, instead of gpu_id")
+            .allow_empty_without_default()
+            .for_train();
+        KNOWHERE_CONFIG_DECLARE_FIELD(multi_gpu_mode)
+            .description("how the index spans several gpu_ids: replicated or sharded")
+            .set_default("replicated")
+            .for_train();
+        KNOWHERE_CONFIG_DECLARE_FIELD(adapt_for_cpu)
+            .description("also serialize the index under the name of its CPU IVF index, a host without GPU loads it")
+            .set_default(false)
+            .for_train()
+            .for_deserialize();
+        KNOWHERE_CONFIG_DECLARE_FIELD(out_of_core)
+            .description("keep only the centroids on the gpu and the lists in host memory, a search streams the "
+                         "lists it probes to the gpu")
+            .set_default(false)
+            .for_train()
+            .for_deserialize();
     }
 };
 
 class GpuIvfPqConfig : public IvfPqConfig {
  public:
     CFG_INT gpu_id;
+    CFG_LIST gpu_ids;
+    CFG_STRING multi_gpu_mode;
+    CFG_BOOL adapt_for_cpu;
     KNOHWERE_DECLARE_CONFIG(GpuIvfPqConfig) {
-        KNOWHERE_CONFIG_DECLARE_FIELD(gpu_id).description("gpu device id").set_default(0).for_train();
+        KNOWHERE_CONFIG_DECLARE_FIELD(gpu_id)
+            .description("gpu device id, -1 for the first one given to KnowhereConfig::InitGPUResource")
+            .set_default(-1)
+            .for_train()
+            .for_deserialize();
+        KNOWHERE_CONFIG_DECLARE_FIELD(gpu_ids)
+            .description("gpu device ids the index is replicated or sharded over, instead of gpu_id")
+            .allow_empty_without_default()
+            .for_train();
+        KNOWHERE_CONFIG_DECLARE_FIELD(multi_gpu_mode)
+            .description("how the index spans several gpu_ids: replicated or sharded")
+            .set_default("replicated")
+            .for_train();
+        KNOWHERE_CONFIG_DECLARE_FIELD(adapt_for_cpu)
+            .description("also serialize the index under the name of its CPU IVF index, a host without GPU loads it")
+            .set_default(false)
+            .for_train()
+            .for_deserialize();
     }
 };
 
 class GpuIvfSqConfig : public IvfSqConfig {
  public:
     CFG_INT gpu_id;
+    CFG_LIST gpu_ids;
+    CFG_STRING multi_gpu_mode;
+    CFG_BOOL adapt_for_cpu;
     KNOHWERE_DECLARE_CONFIG(GpuIvfSqConfig) {
-        KNOWHERE_CONFIG_DECLARE_FIELD(gpu_id).description("gpu device id").set_default(0).for_train();
+        KNOWHERE_CONFIG_DECLARE_FIELD(gpu_id)
+            .description("gpu device id, -1 for the first one given to KnowhereConfig::InitGPUResource")
+            .set_default(-1)
+            .for_train()
+            .for_deserialize();
+        KNOWHERE_CONFIG_DECLARE_FIELD(gpu_ids)
+            .description("gpu device ids the index is replicated or sharded over, instead of gpu_id")
+            .allow_empty_without_default()
+            .for_train();
+        KNOWHERE_CONFIG_DECLARE_FIELD(multi_gpu_mode)
+            .description("how the index spans several gpu_ids: replicated or sharded")
+            .set_default("replicated")
+            .for_train();
+        KNOWHERE_CONFIG_DECLARE_FIELD(adapt_for_cpu)
+            .description("also serialize the index under the name of its CPU IVF index, a host without GPU loads it")
+            .set_default(false)
+            .for_train()
+            .for_deserialize();
     }
 };
 
@@ -0,0 +1,323 @@
+// Copyright (C) 2019-2023 Zilliz. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file except in compliance
+// with the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
+// or implied. See the License for the specific language governing permissions and limitations under the License.
+
+#include <cmath>
+
+#include "common/knn_util.h"
+#include "common/metric.h"
+#include "common/range_util.h"
+#include "faiss/IndexBinaryHash.h"
+#include "faiss/index_io.h"
+#include "index/hash/hash_config.h"
+#include "io/FaissIO.h"
+#include "knowhere/comp/thread_pool.h"
+#include "knowhere/factory.h"
+#include "knowhere/log.h"
+#include "knowhere/utils.h"
+
+namespace knowhere {
+
+// Multi-index hashing of binary vectors under the Hamming distance: the bits are cut into nhash runs of hash_bits
+// bits, each the key of a hash table of the vectors, and a search only computes the distances to the vectors that
+// share a key with the query up to hash_flips flipped bits. A vector within r bits of the query is within r / nhash
+// bits of it on one of the runs, so the small radii of near-duplicate lookups are found exactly by a few table
+// lookups instead of a scan.
+class BinaryHashIndexNode : public IndexNode {
+ public:
+    BinaryHashIndexNode(const Object&) : index_(nullptr) {
+        search_pool_ = ThreadPool::GetGlobalSearchThreadPool();
+    }
+
+    Status
+    Train(const DataSet& dataset, const Config& cfg) override {
+        const BinMihConfig& h_cfg = static_cast<const BinMihConfig&>(cfg);
+        auto metric = Str2FaissMetricType(h_cfg.metric_type.value());
+        if (!metric.has_value()) {
+            LOG_KNOWHERE_WARNING_ << "please check metric type: " << h_cfg.metric_type.value();
+            return metric.error();
+        }
+        if (metric.value() != faiss::METRIC_Hamming) {
+            LOG_KNOWHERE_ERROR_ << "BIN_MIH only supports HAMMING, not " << h_cfg.metric_type.value();
+            return Status::invalid_metric_type;
+        }
+        auto dim = dataset.GetDim();
+        auto b = h_cfg.hash_bits.value();
+        auto nhash = h_cfg.nhash.value() > 0 ? h_cfg.nhash.value() : dim / b;
+        if (nhash == 0 || nhash * b > dim) {
+            LOG_KNOWHERE_ERROR_ << "nhash(" << nhash << ") runs of hash_bits(" << b << ") do not fit in dim(" << dim
+                                << ")";
+            return Status::invalid_args;
+        }
+        index_ = std::make_unique<faiss::IndexBinaryMultiHash>(dim, nhash, b);
+        return Status::success;
+    }
+
+    Status
+    Add(const DataSet& dataset, const Config& cfg) override {
+        if (!index_) {
+            LOG_KNOWHERE_ERROR_ << "Can not add data to empty BIN_MIH.";
+            return Status::empty_index;
+        }
+        index_->add(dataset.GetRows(), (const uint8_t*)dataset.GetTensor());
+        return Status::success;
+    }
+
+    expected<DataSetPtr>
+    Search(const DataSet& dataset, const Config& cfg, const BitsetView& bitset) const override {
+        if (!index_) {
+            LOG_KNOWHERE_WARNING_ << "search on empty index";
+            return expected<DataSetPtr>::Err(Status::empty_index, "index not loaded");
+        }
+
+        const BinMihConfig& h_cfg = static_cast<const BinMihConfig&>(cfg);
+        auto k = h_cfg.k.value();
+        auto nflip = std::min<int>(h_cfg.hash_flips.value(), index_->b);
+        auto nq = dataset.GetRows();
+        auto x = (const uint8_t*)dataset.GetTensor();
+        auto code_size = index_->code_size;
+
+        KnnResultBuffers buffers(h_cfg, k * nq);
+        int64_t* ids = buffers.ids;
+        float* distances = buffers.distances;
+        try {
+            search_pool_->parallel_for(0, nq, 1, [&](int64_t index) {
+                ThreadPool::ScopedOmpSetter setter(1);
+                auto cur_ids = ids + k * index;
+                auto cur_dis = distances + k * index;
+                auto cur_i_dis = reinterpret_cast<int32_t*>(cur_dis);
+                index_->search_thread_safe(1, x + index * code_size, k, cur_i_dis, cur_ids, nflip, bitset);
+                for (int64_t j = 0; j < k; j++) {
+                    cur_dis[j] = static_cast<float>(cur_i_dis[j]);
+                }
+            });
+        } catch (const std::exception& e) {
+            buffers.Free();
+            LOG_KNOWHERE_WARNING_ << "error inner faiss: " << e.what();
+            return expected<DataSetPtr>::Err(Status::faiss_inner_error, e.what());
+        }
+
+        return buffers.ToDataSet(nq, k);
+    }
+
+    expected<DataSetPtr>
+    RangeSearch(const DataSet& dataset, const Config& cfg, const BitsetView& bitset) const override {
+        if (!index_) {
+            LOG_KNOWHERE_WARNING_ << "range search on empty index";
+            return expected<DataSetPtr>::Err(Status::empty_index, "index not loaded");
+        }
+
+        const BinMihConfig& h_cfg = static_cast<const BinMihConfig&>(cfg);
+        auto nq = dataset.GetRows();
+        auto xq = (const uint8_t*)dataset.GetTensor();
+        auto code_size = index_->code_size;
+
+        float radius = h_cfg.radius.value();
+        float range_filter = h_cfg.range_filter.value();
+        // the hits are below the radius, at most max_dis bits away, and so within max_dis / nhash bits of the query
+        // on one of the runs
+        int max_dis = static_cast<int>(std::ceil(radius)) - 1;
+        int nflip = std::min<int>(index_->b, std::max<int>(h_cfg.hash_flips.value(), max_dis / index_->nhash));
+
+        int64_t* ids = nullptr;
+        float* distances = nullptr;
+        size_t* lims = nullptr;
+        bool owned = true;
+
+        RangeSearchResultBuilder results(nq, h_cfg.max_results.value(), false);
+
+        try {
+            search_pool_->parallel_for(0, nq, 1, [&](int64_t index) {
+                ThreadPool::ScopedOmpSetter setter(1);
+                faiss::RangeSearchResult res(1);
+                index_->range_search_thread_safe(1, xq + index * code_size, radius, &res, nflip, bitset);
+                results.Query(index).Append(res.distances, res.labels, res.lims[1],
+                                            range_filter != defaultRangeFilter, false, radius, range_filter);
+            });
+            owned = results.Build(h_cfg, distances, ids, lims);
+        } catch (const std::exception& e) {
+            LOG_KNOWHERE_WARNING_ << "error inner faiss: " << e.what();
+            return expected<DataSetPtr>::Err(Status::faiss_inner_error, e.what());
+        }
+
+        auto res = GenResultDataSet(nq, ids, distances, lims);
+        res->SetIsOwner(owned);
+        return res;
+    }
+
+    expected<DataSetPtr>
+    GetVectorByIds(const DataSet& dataset) const override {
+        auto rows = dataset.GetRows();
+        auto ids = dataset.GetIds();
+        auto code_size = index_->code_size;
+        uint8_t* data = nullptr;
+        try {
+            data = new uint8_t[rows * code_size];
+            for (int64_t i = 0; i < rows; i++) {
+                index_->storage->reconstruct(ids[i], data + i * code_size);
+            }
+            return GenResultDataSet(rows, Dim(), data);
+        } catch (const std::exception& e) {
+            std::unique_ptr<uint8_t[]> auto_del(data);
+            LOG_KNOWHERE_WARNING_ << "error inner faiss: " << e.what();
+            return expected<DataSetPtr>::Err(Status::faiss_inner_error, e.what());
+        }
+    }
+
+    bool
+    HasRawData(const std::string& metric_type) const override {
+        return true;
+    }
+
+    expected<DataSetPtr>
+    GetIndexMeta(const Config& cfg) const override {
+        return expected<DataSetPtr>::Err(Status::not_implemented, "GetIndexMeta not implemented");
+    }
+
+    Status
+    Serialize(BinarySet& binset) const override {
+        if (!index_) {
+            LOG_KNOWHERE_ERROR_ << "Can not serialize empty index.";
+            return Status::empty_index;
+        }
+        try {
+            auto [data, size] =
+                SerializeToMemory([&](MemoryIOWriter& writer) { faiss::write_index_binary(index_.get(), &writer); });
+            binset.Append(Type(), data, size);
+            return Status::success;
+        } catch (const std::exception& e) {
+            LOG_KNOWHERE_WARNING_ << "error inner faiss: " << e.what();
+            return Status::faiss_inner_error;
+        }
+    }
+
+    Status
+    SerializeToFile(SectionWriter& writer) const override {
+        if (!index_) {
+            LOG_KNOWHERE_ERROR_ << "Can not serialize empty index.";
+            return Status::empty_index;
+        }
+        RETURN_IF_ERROR(writer.Begin(Type()));
+        try {
+            SectionIOWriter section(writer);
+            faiss::write_index_binary(index_.get(), &section);
+        } catch (const std::exception& e) {
+            LOG_KNOWHERE_WARNING_ << "error inner faiss: " << e.what();
+            return Status::faiss_inner_error;
+        }
+        return writer.End();
+    }
+
+    Status
+    Deserialize(const BinarySet& binset, const Config& config) override {
+        auto binary = binset.GetByName(Type());
+        if (binary == nullptr) {
+            LOG_KNOWHERE_ERROR_ << "Invalid binary set.";
+            return Status::invalid_binary_set;
+        }
+
+        MemoryIOReader reader;
+        reader.total = binary->size;
+        reader.data_ = binary->data.get();
+        try {
+            return Load(faiss::read_index_binary(&reader));
+        } catch (const std::exception& e) {
+            LOG_KNOWHERE_WARNING_ << "faiss inner error: " << e.what();
+            return Status::faiss_inner_error;
+        }
+    }
+
+    Status
+    DeserializeFromFile(const std::string& filename, const Config& config) override {
+        auto cfg = static_cast<const knowhere::BaseConfig&>(config);
+        try {
+            auto reader = OpenFaissFile(filename, cfg.file_offset);
+            return Load(faiss::read_index_binary(reader.get()));
+        } catch (const std::exception& e) {
+            LOG_KNOWHERE_WARNING_ << "faiss inner error: " << e.what();
+            return Status::faiss_inner_error;
+        }
+    }
+
+    void
+    SetSearchPool(std::shared_ptr<ThreadPool> pool) override {
+        search_pool_ = std::move(pool);
+    }
+
+    std::shared_ptr<ThreadPool>
+    AsyncSearchPool() const override {
+        return search_pool_;
+    }
+
+    std::unique_ptr<BaseConfig>
+    CreateConfig() const override {
+        return std::make_unique<BinMihConfig>();
+    }
+
+    int64_t
+    Dim() const override {
+        return index_->d;
+    }
+
+    int64_t
+    Size() const override {
+        return GetMemoryUsage().Total();
+    }
+
+    // the tables are node based, every key costs a node, a bucket and the buffer of its ids
+    MemoryUsage
+    GetMemoryUsage() const override {
+        MemoryUsage usage;
+        if (!index_) {
+            return usage;
+        }
+        usage.Add(MemoryUsage::kVectors, MemoryUsage::kHeap, index_->storage->xb.capacity());
+        for (auto& map : index_->maps) {
+            int64_t bytes = map.bucket_count() * sizeof(void*);
+            for (auto& [key, ids] : map) {
+                bytes += sizeof(void*) + sizeof(key) + sizeof(ids) + ids.capacity() * sizeof(ids[0]);
+            }
+            usage.Add(MemoryUsage::kLists, MemoryUsage::kHeap, bytes);
+        }
+        usage.Add(MemoryUsage::kOther, MemoryUsage::kHeap, sizeof(*index_) + sizeof(*index_->storage));
+        return usage;
+    }
+
+    int64_t
+    Count() const override {
+        return index_->ntotal;
+    }
+
+    std::string
+    Type() const override {
+        return knowhere::IndexEnum::INDEX_FAISS_BIN_MIH;
+    }
+
+ private:
+    // takes the index read by Deserialize or DeserializeFromFile
+    Status
+    Load(faiss::IndexBinary* index) {
+        auto mih = dynamic_cast<faiss::IndexBinaryMultiHash*>(index);
+        if (mih == nullptr) {
+            delete index;
+            LOG_KNOWHERE_ERROR_ << "the binary set does not hold a BIN_MIH index.";
+            return Status::invalid_binary_set;
+        }
+        index_.reset(mih);
+        return Status::success;
+    }
+
+    std::unique_ptr<faiss::IndexBinaryMultiHash> index_;
+    std::shared_ptr<ThreadPool> search_pool_;
+};
+
+KNOWHERE_REGISTER_GLOBAL(BIN_MIH, [](const Object& object) { return Index<BinaryHashIndexNode>::Create(object); });
+
+}  // namespace knowhere
@@ -0,0 +1,47 @@
+// Copyright (C) 2019-2023 Zilliz. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file except in compliance
+// with the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
+// or implied. See the License for the specific language governing permissions and limitations under the License.
+
+#ifndef HASH_CONFIG_H
+#define HASH_CONFIG_H
+
+#include "knowhere/config.h"
+
+namespace knowhere {
+
+class BinMihConfig : public BaseConfig {
+ public:
+    CFG_INT hash_bits;
+    CFG_INT nhash;
+    CFG_INT hash_flips;
+    KNOHWERE_DECLARE_CONFIG(BinMihConfig) {
+        KNOWHERE_CONFIG_DECLARE_FIELD(hash_bits)
+            .description("bits of every hash table key, a run of hash_bits bits of the vector")
+            .set_default(16)
+            .for_train()
+            .set_range(1, 32);
+        KNOWHERE_CONFIG_DECLARE_FIELD(nhash)
+            .description("number of hash tables, on disjoint runs of bits, 0 for dim / hash_bits of them")
+            .set_default(0)
+            .for_train()
+            .set_range(0, 65536);
+        KNOWHERE_CONFIG_DECLARE_FIELD(hash_flips)
+            .description("a knn search looks up the keys within hash_flips bits of the ones of the query, a range "
+                         "search at least the ones that find every vector within the radius")
+            .set_default(1)
+            .for_search()
+            .for_range_search()
+            .set_range(0, 32);
+    }
+};
+
+}  // namespace knowhere
+
+#endif /* HASH_CONFIG_H */
@@ -13,26 +13,112 @@
 
 #include <omp.h>
 
+#include <cstring>
 #include <exception>
 #include <new>
+#include <shared_mutex>
 
+#include "common/knn_util.h"
 #include "common/range_util.h"
 #include "hnswlib/hnswalg.h"
 #include "hnswlib/hnswlib.h"
 #include "index/hnsw/hnsw_config.h"
+#include "knowhere/comp/cancellation.h"
 #include "knowhere/comp/index_param.h"
+#include "knowhere/comp/query_stats.h"
+#include "knowhere/comp/query_trace.h"
 #include "knowhere/comp/thread_pool.h"
 #include "knowhere/comp/time_recorder.h"
 #include "knowhere/config.h"
 #include "knowhere/expected.h"
 #include "knowhere/factory.h"
+#include "knowhere/index_node_pre_transform_wrapper.h"
 #include "knowhere/log.h"
+#include "knowhere/prometheus_client.h"
 #include "knowhere/utils.h"
 
 namespace knowhere {
+namespace {
+hnswlib::ReorderType
+GetReorderType(const CFG_STRING& reorder) {
+    if (!reorder.has_value()) {
+        return hnswlib::ReorderType::NONE;
+    }
+    auto& type = reorder.value();
+    if (!strcasecmp(type.c_str(), kReorderBFS)) {
+        return hnswlib::ReorderType::BFS;
+    } else if (!strcasecmp(type.c_str(), kReorderRCM)) {
+        return hnswlib::ReorderType::RCM;
+    } else if (!strcasecmp(type.c_str(), kReorderGorder)) {
+        return hnswlib::ReorderType::GORDER;
+    }
+    return hnswlib::ReorderType::NONE;
+}
+
+hnswlib::RefineType
+GetRefineType(const std::string& type) {
+    if (!strcasecmp(type.c_str(), kHnswRefineFP16)) {
+        return hnswlib::RefineType::FP16;
+    } else if (!strcasecmp(type.c_str(), kHnswRefineFP32)) {
+        return hnswlib::RefineType::FP32;
+    }
+    return hnswlib::RefineType::NONE;
+}
+
+// the bits or the alive ids of a filter merged with the deleted labels, shared by the iterators of one call
+struct MergedFilter {
+    std::vector<uint8_t> bits;
+    std::vector<uint32_t> ids;
+};
+
+// Pages through the best-first walk of HierarchicalNSW::IteratorWorkspace, a Refill expands one node. The walk
+// measures the negated distances for ip, as the searches do. It is created with `graph_mutex` held shared, and a
+// Refill holds it shared too, as a search does.
+class HnswIterator : public IndexIterator {
+ public:
+    HnswIterator(const hnswlib::HierarchicalNSW<float>* index, std::shared_mutex& graph_mutex, const void* query,
+                 const BitsetView& bitset, bool is_ip, std::shared_ptr<MergedFilter> filter)
+        : IndexIterator(is_ip),
+          index_(index),
+          graph_mutex_(graph_mutex),
+          filter_(std::move(filter)),
+          workspace_(index->getIteratorWorkspace(query, bitset)),
+          negate_(is_ip) {
+    }
+
+ protected:
+    Status
+    Refill(int64_t wanted, bool& exhausted) override {
+        std::shared_lock<std::shared_mutex> lock(graph_mutex_);
+        exhausted = !index_->iteratorExpand(*workspace_, [this](float dist, int64_t label) {
+            Push(negate_ ? -dist : dist, label);
+        });
+        return Status::success;
+    }
+
+    // nothing closer than the closest candidate is left to find, as far as the walk goes
+    bool
+    MayFindCloser(float distance) const override {
+        if (workspace_->candidates.empty()) {
+            return false;
+        }
+        float frontier = workspace_->candidates.top().first;
+        return Closer(negate_ ? -frontier : frontier, distance);
+    }
+
+ private:
+    const hnswlib::HierarchicalNSW<float>* index_;
+    std::shared_mutex& graph_mutex_;
+    std::shared_ptr<MergedFilter> filter_;
+    std::unique_ptr<hnswlib::HierarchicalNSW<float>::IteratorWorkspace> workspace_;
+    bool negate_;
+};
+}  // namespace
+
 class HnswIndexNode : public IndexNode {
  public:
-    HnswIndexNode(const Object& object) : index_(nullptr) {
+    HnswIndexNode(const Object& object, std::string type = IndexEnum::INDEX_HNSW)
+        : index_(nullptr), type_(std::move(type)) {
         search_pool_ = ThreadPool::GetGlobalSearchThreadPool();
     }
 
@@ -62,6 +148,9 @@ class HnswIndexNode : public IndexNode {
             LOG_KNOWHERE_WARNING_ << "memory malloc error.";
             return Status::malloc_error;
         }
+        if (hnsw_cfg.align_level0.value_or(false)) {
+            index->setLevel0Aligned(true);
+        }
         if (this->index_) {
             delete this->index_;
             LOG_KNOWHERE_WARNING_ << "index not empty, deleted old index";
@@ -74,32 +163,225 @@ class HnswIndexNode : public IndexNode {
     Add(const DataSet& dataset, const Config& cfg) override {
         if (!index_) {
             LOG_KNOWHERE_ERROR_ << "Can not add data to empty HNSW index.";
-            expected<DataSetPtr>::Err(Status::empty_index, "index not loaded");
+            return Status::empty_index;
+        }
+
+        if (index_->mmap_enabled_ || index_->links_compressed_) {
+            LOG_KNOWHERE_ERROR_ << "Can not add data to a mmapped or compressed HNSW index.";
+            return Status::not_implemented;
         }
 
+        std::shared_lock<std::shared_mutex> lock(graph_mutex_);
         knowhere::TimeRecorder build_time("Building HNSW cost");
         auto rows = dataset.GetRows();
         auto tensor = dataset.GetTensor();
         auto hnsw_cfg = static_cast<const HnswConfig&>(cfg);
-        index_->addPoint(tensor, 0);
 
-#pragma omp parallel for
-        for (int i = 1; i < rows; ++i) {
-            index_->addPoint(((const char*)tensor + index_->data_size_ * i), i);
+        // adding to a non empty index appends, labels go on from the current count and the capacity grows
+        // geometrically
+        size_t base = index_->cur_element_count;
+        if (base + rows > index_->max_elements_) {
+            try {
+                index_->resizeIndex(std::max(base + rows, index_->max_elements_ * 2));
+            } catch (std::exception& e) {
+                LOG_KNOWHERE_WARNING_ << "hnsw inner error: " << e.what();
+                return Status::hnsw_inner_error;
+            }
+        }
+        // a first build may start from a kNN graph of the rows, the neighbors of every row to prune its list from
+        std::vector<uint32_t> knn_graph;
+        auto degree = (int64_t)index_->maxM0_;
+        if (base == 0 && strcasecmp(hnsw_cfg.knn_graph.value().c_str(), kKnnGraphNone)) {
+            auto graph = BuildKnnGraph((const float*)tensor, rows, Dim(), degree, hnsw_cfg.metric_type.value(),
+                                       hnsw_cfg.knn_graph.value());
+            if (!graph.has_value()) {
+                LOG_KNOWHERE_ERROR_ << "kNN graph of HNSW failed: " << graph.what();
+                return graph.error();
+            }
+            knn_graph = std::move(graph.value());
+            build_time.RecordSection("kNN graph by " + hnsw_cfg.knn_graph.value());
+        }
+
+        try {
+            if (!knn_graph.empty()) {
+                index_->buildFromKnnGraph(tensor, knn_graph.data(), rows, degree);
+            } else {
+                int64_t first = 0;
+                if (base == 0) {
+                    index_->addPoint(tensor, 0);
+                    first = 1;
+                }
+                ThreadPool::GetGlobalBuildThreadPool()->parallel_for(first, rows, 1, [&](int64_t i) {
+                    index_->addPoint(((const char*)tensor + index_->data_size_ * i), base + i);
+                });
+            }
+        } catch (std::exception& e) {
+            LOG_KNOWHERE_WARNING_ << "hnsw inner error: " << e.what();
+            return Status::hnsw_inner_error;
         }
         build_time.RecordSection("");
+
+        // appended points are quantized by addPoint, and keep the original order after the reordered ones
+        if (base > 0) {
+            LOG_KNOWHERE_INFO_ << "HNSW appended #points num:" << rows << " #total:" << index_->cur_element_count
+                               << " #capacity:" << index_->max_elements_;
+            return Status::success;
+        }
+
+        auto reorder = GetReorderType(hnsw_cfg.reorder);
+        if (reorder != hnswlib::ReorderType::NONE) {
+            try {
+                index_->reorderGraph(reorder);
+            } catch (std::exception& e) {
+                LOG_KNOWHERE_WARNING_ << "hnsw inner error: " << e.what();
+                return Status::hnsw_inner_error;
+            }
+            build_time.RecordSection("reorder graph by " + hnsw_cfg.reorder.value());
+        }
+        if (hnsw_cfg.entry_hubs.has_value()) {
+            index_->setEntryHubs(hnsw_cfg.entry_hubs.value());
+        }
+
+        auto& sq_type = hnsw_cfg.sq_type.value();
+        if (IsQuantized()) {
+            RETURN_IF_ERROR(QuantizeLevel0(cfg));
+            build_time.RecordSection("quantize level 0 of " + type_);
+        } else if (strcasecmp(sq_type.c_str(), kSqTypeNone)) {
+            try {
+                auto qtype = strcasecmp(sq_type.c_str(), kSqTypeSQ8) ? faiss::QT_fp16
+                                                                     : faiss::QT_8bit;
+                index_->quantizeLevel0(qtype, hnsw_cfg.refine.value());
+            } catch (std::exception& e) {
+                LOG_KNOWHERE_WARNING_ << "hnsw inner error: " << e.what();
+                return Status::hnsw_inner_error;
+            }
+            build_time.RecordSection("quantize level 0 to " + sq_type);
+        }
+        if (hnsw_cfg.compress_links.value()) {
+            try {
+                index_->compressLinks();
+            } catch (std::exception& e) {
+                LOG_KNOWHERE_WARNING_ << "hnsw inner error: " << e.what();
+                return Status::hnsw_inner_error;
+            }
+            build_time.RecordSection("compress links");
+        }
         LOG_KNOWHERE_INFO_ << "HNSW built with #points num:" << index_->max_elements_ << " #M:" << index_->M_
                            << " #max level:" << index_->maxlevel_ << " #ef_construction:" << index_->ef_construction_
                            << " #dim:" << *(size_t*)(index_->space_->get_dist_func_param());
         return Status::success;
     }
 
+    Status
+    DeleteByIds(const DataSet& dataset) override {
+        if (!index_) {
+            return Status::empty_index;
+        }
+        auto rows = dataset.GetRows();
+        auto ids = dataset.GetIds();
+        for (int64_t i = 0; i < rows; i++) {
+            if (ids[i] < 0 || ids[i] >= (int64_t)index_->cur_element_count) {
+                LOG_KNOWHERE_WARNING_ << "delete id " << ids[i] << " out of range [0, " << index_->cur_element_count
+                                      << ")";
+                return Status::invalid_args;
+            }
+        }
+        // the tombstones and the repaired links change under no search
+        std::unique_lock<std::shared_mutex> lock(graph_mutex_);
+        for (int64_t i = 0; i < rows; i++) {
+            index_->markDeleted(ids[i]);
+        }
+
+        // the deleted elements stay in the graph until enough of them pile up, then the links to them are replaced
+        // in one pass; a mmapped or compressed graph is read only and keeps them
+        if (index_->needRepairDeleted() && !index_->mmap_enabled_ && !index_->links_compressed_) {
+            knowhere::TimeRecorder repair_time("Repairing HNSW cost");
+            auto count = (int64_t)index_->cur_element_count;
+            ThreadPool::GetGlobalBuildThreadPool()->parallel_for(
+                0, count, 1024, [&](int64_t i) { index_->repairDeletedLinks(i); });
+            index_->finishRepairDeleted();
+            repair_time.RecordSection("");
+        }
+        return Status::success;
+    }
+
+    // The vectors of the others are inserted into this graph, which keeps its links: the merge costs the inserts of
+    // the others alone rather than a build over all of them. The deleted rows of the others are inserted deleted.
+    Status
+    Merge(const std::vector<const IndexNode*>& others, const Config& cfg) override {
+        if (!index_) {
+            return Status::empty_index;
+        }
+        if (index_->mmap_enabled_ || index_->links_compressed_) {
+            LOG_KNOWHERE_ERROR_ << "Can not merge into a mmapped or compressed HNSW index.";
+            return Status::not_implemented;
+        }
+        size_t rows = 0;
+        for (auto other : others) {
+            auto hnsw = dynamic_cast<const HnswIndexNode*>(other);
+            if (hnsw == nullptr || hnsw->index_ == nullptr || hnsw->Dim() != Dim() ||
+                hnsw->index_->metric_type_ != index_->metric_type_) {
+                LOG_KNOWHERE_ERROR_ << "can only merge HNSW indexes of the same dim and metric";
+                return Status::invalid_args;
+            }
+            if (!hnsw->index_->hasRawData()) {
+                LOG_KNOWHERE_INFO_ << "merging the vectors decoded from a quantized HNSW index";
+            }
+            rows += hnsw->index_->cur_element_count;
+        }
+
+        std::shared_lock<std::shared_mutex> lock(graph_mutex_);
+        knowhere::TimeRecorder merge_time("Merging HNSW cost");
+        size_t base = index_->cur_element_count;
+        try {
+            if (base + rows > index_->max_elements_) {
+                index_->resizeIndex(base + rows);
+            }
+            for (auto other : others) {
+                auto src = static_cast<const HnswIndexNode*>(other)->index_;
+                auto count = (int64_t)src->cur_element_count;
+                auto insert = [&](int64_t label) {
+                    std::unique_ptr<char[]> data(new char[src->data_size_]);
+                    src->copyRawDataByInternalId(src->getInternalId(label), data.get());
+                    index_->addPoint(data.get(), base + label);
+                };
+                // the first point of an empty graph is its entry point, the others link to it
+                int64_t first = 0;
+                if (index_->cur_element_count == 0 && count > 0) {
+                    insert(0);
+                    first = 1;
+                }
+                ThreadPool::GetGlobalBuildThreadPool()->parallel_for(first, count, 1, insert);
+                for (int64_t label = 0; label < count; ++label) {
+                    if (src->isMarkedDeleted(label)) {
+                        index_->markDeleted(base + label);
+                    }
+                }
+                base += count;
+            }
+        } catch (std::exception& e) {
+            LOG_KNOWHERE_WARNING_ << "hnsw inner error: " << e.what();
+            return Status::hnsw_inner_error;
+        }
+        // the hubs are the elements of the highest levels, which the inserted ones may have taken over
+        if (!index_->entry_hubs_.empty()) {
+            index_->setEntryHubs(index_->entry_hubs_.size());
+        }
+        merge_time.RecordSection("");
+        LOG_KNOWHERE_INFO_ << "HNSW merged #points num:" << rows << " #total:" << index_->cur_element_count;
+        return Status::success;
+    }
+
     expected<DataSetPtr>
-    Search(const DataSet& dataset, const Config& cfg, const BitsetView& bitset) const override {
+    Search(const DataSet& dataset, const Config& cfg, const BitsetView& bitset_in) const override {
         if (!index_) {
             LOG_KNOWHERE_WARNING_ << "search on empty index";
-            expected<DataSetPtr>::Err(Status::empty_index, "index not loaded");
+            return expected<DataSetPtr>::Err(Status::empty_index, "index not loaded");
         }
+        std::shared_lock<std::shared_mutex> lock(graph_mutex_);
+        std::vector<uint8_t> merged_bits;
+        std::vector<uint32_t> alive_ids;
+        auto bitset = FilterDeleted(bitset_in, merged_bits, alive_ids);
         auto nq = dataset.GetRows();
         auto xq = dataset.GetTensor();
 
@@ -114,38 +396,95 @@ class HnswIndexNode : public IndexNode {
             feder_result = std::make_unique<feder::hnsw::FederResult>();
         }
 
-        auto p_id = new int64_t[k * nq];
-        auto p_dist = new float[k * nq];
+        KnnResultBuffers buffers(hnsw_cfg, k * nq);
+        auto p_id = buffers.ids;
+        auto p_dist = buffers.distances;
 
-        hnswlib::SearchParam param{(size_t)hnsw_cfg.ef.value(), hnsw_cfg.for_tuning.value()};
+        hnswlib::SearchParam param{(size_t)hnsw_cfg.ef.value(), hnsw_cfg.for_tuning.value(),
+                                   (size_t)hnsw_cfg.prefetch_depth.value_or(0),
+                                   (size_t)hnsw_cfg.early_stop_patience.value_or(0), hnsw_cfg.filter_threshold.value()};
+        if (IsQuantized()) {
+            param.refine_k_ = static_cast<const HnswQuantConfig&>(cfg).refine_k.value_or(0.0f);
+        }
         bool transform =
             (index_->metric_type_ == hnswlib::Metric::INNER_PRODUCT || index_->metric_type_ == hnswlib::Metric::COSINE);
 
+        // the queries of a cancelled search are cut short or skipped, the search then fails
+        auto cancellation = hnsw_cfg.cancellation.get();
+        const auto index_type = Type();
+        const auto& query_metrics = GetQueryMetrics(index_type);
+        auto sample_rate = hnsw_cfg.trace_sample_rate.value();
+        auto write_query = [&](int64_t query, const std::vector<std::pair<float, hnswlib::labeltype>>& rst) {
+            auto p_query_dist = p_dist + query * k;
+            auto p_query_id = p_id + query * k;
+            size_t rst_size = rst.size();
+            for (size_t idx = 0; idx < rst_size; ++idx) {
+                const auto& [dist, id] = rst[idx];
+                p_query_dist[idx] = transform ? (-dist) : dist;
+                p_query_id[idx] = id;
+            }
+            for (size_t idx = rst_size; idx < (size_t)k; idx++) {
+                p_query_dist[idx] = float(1.0 / 0.0);
+                p_query_id[idx] = -1;
+            }
+        };
         std::vector<folly::Future<folly::Unit>> futs;
-        futs.reserve(nq);
-        for (int i = 0; i < nq; ++i) {
-            futs.emplace_back(search_pool_->push([&, idx = i]() {
-                auto single_query = (const char*)xq + idx * index_->data_size_;
-                auto rst = index_->searchKnn(single_query, k, bitset, &param, feder_result);
-                size_t rst_size = rst.size();
-                auto p_single_dis = p_dist + idx * k;
-                auto p_single_id = p_id + idx * k;
-                for (size_t idx = 0; idx < rst_size; ++idx) {
-                    const auto& [dist, id] = rst[idx];
-                    p_single_dis[idx] = transform ? (-dist) : dist;
-                    p_single_id[idx] = id;
+        if (feder_result != nullptr) {
+            futs.emplace_back(search_pool_->push([&]() {
+                CancellationToken::Scope scope(cancellation);
+                QueryStats::Current().Reset();
+                QueryTraceScope trace(index_type, sample_rate, 0);
+                auto rst = index_->searchKnn(xq, k, bitset, &param, feder_result);
+                query_metrics.Observe(QueryStats::Current());
+                write_query(0, rst);
+            }));
+        } else if (sample_rate > 0) {
+            // the queries of a tile are walked together, so a traced search walks them one by one instead
+            search_pool_->parallel_for(0, nq, 1, [&](int64_t idx) {
+                CancellationToken::Scope scope(cancellation);
+                if (CancellationToken::CurrentCancelled()) {
+                    return;
                 }
-                for (size_t idx = rst_size; idx < (size_t)k; idx++) {
-                    p_single_dis[idx] = float(1.0 / 0.0);
-                    p_single_id[idx] = -1;
+                QueryStats::Current().Reset();
+                QueryTraceScope trace(index_type, sample_rate, idx);
+                auto rst = index_->searchKnn((const char*)xq + idx * index_->data_size_, k, bitset, &param);
+                query_metrics.Observe(QueryStats::Current());
+                write_query(idx, rst);
+            });
+        } else {
+            // search queries tile by tile, keep enough tiles to occupy the threads the search may use
+            int64_t tile = std::clamp<int64_t>(nq / search_pool_->concurrency(), 1, kSearchTileSize);
+            search_pool_->parallel_for(0, (nq + tile - 1) / tile, 1, [&](int64_t t) {
+                CancellationToken::Scope scope(cancellation);
+                if (CancellationToken::CurrentCancelled()) {
+                    return;
                 }
-            }));
+                auto begin = t * tile;
+                auto tile_nq = std::min(tile, nq - begin);
+                auto p_tile_dist = p_dist + begin * k;
+                auto p_tile_id = p_id + begin * k;
+                // the queries of a tile are walked together, so their work is not reported per query
+                QueryStats::Current().Reset();
+                index_->searchKnnBatch((const char*)xq + begin * index_->data_size_, tile_nq, k, bitset, &param,
+                                       p_tile_dist, p_tile_id);
+                for (int64_t idx = 0; idx < tile_nq * k; ++idx) {
+                    if (p_tile_id[idx] == -1) {
+                        p_tile_dist[idx] = float(1.0 / 0.0);
+                    } else if (transform) {
+                        p_tile_dist[idx] = -p_tile_dist[idx];
+                    }
+                }
+            });
         }
         for (auto& fut : futs) {
             fut.wait();
         }
+        if (cancellation != nullptr && cancellation->IsCancelled()) {
+            buffers.Free();
+            return expected<DataSetPtr>::Err(Status::search_cancelled, "search cancelled");
+        }
 
-        auto res = GenResultDataSet(nq, k, p_id, p_dist);
+        auto res = buffers.ToDataSet(nq, k);
 
         // set visit_info json string into result dataset
         if (feder_result != nullptr) {
@@ -159,11 +498,15 @@ class HnswIndexNode : public IndexNode {
     }
 
     expected<DataSetPtr>
-    RangeSearch(const DataSet& dataset, const Config& cfg, const BitsetView& bitset) const override {
+    RangeSearch(const DataSet& dataset, const Config& cfg, const BitsetView& bitset_in) const override {
         if (!index_) {
             LOG_KNOWHERE_WARNING_ << "range search on empty index";
             return expected<DataSetPtr>::Err(Status::empty_index, "index not loaded");
         }
+        std::shared_lock<std::shared_mutex> lock(graph_mutex_);
+        std::vector<uint8_t> merged_bits;
+        std::vector<uint32_t> alive_ids;
+        auto bitset = FilterDeleted(bitset_in, merged_bits, alive_ids);
 
         auto nq = dataset.GetRows();
         auto xq = dataset.GetTensor();
@@ -184,47 +527,55 @@ class HnswIndexNode : public IndexNode {
             feder_result = std::make_unique<feder::hnsw::FederResult>();
         }
 
-        hnswlib::SearchParam param{(size_t)hnsw_cfg.ef.value()};
+        hnswlib::SearchParam param{(size_t)hnsw_cfg.ef.value(), false, (size_t)hnsw_cfg.prefetch_depth.value_or(0)};
+        param.range_init_ef_ = hnsw_cfg.range_init_ef.value_or(0);
+        // the walk keeps the closest max_results hits on its own and stops expanding past them, in its distances
+        // that are the negated ones for ip; the hits the range filter drops do not count towards them
+        bool do_filter = hnsw_cfg.range_filter.value() != defaultRangeFilter;
+        auto max_results = hnsw_cfg.max_results.value();
+        param.range_max_results_ = max_results;
+        if (do_filter) {
+            param.range_lower_ = is_ip ? -range_filter : range_filter;
+        }
 
         int64_t* ids = nullptr;
         float* dis = nullptr;
         size_t* lims = nullptr;
 
-        std::vector<std::vector<int64_t>> result_id_array(nq);
-        std::vector<std::vector<float>> result_dist_array(nq);
-        std::vector<size_t> result_size(nq);
-        std::vector<size_t> result_lims(nq + 1);
-
-        std::vector<folly::Future<folly::Unit>> futs;
-        futs.reserve(nq);
-        for (int64_t i = 0; i < nq; ++i) {
-            futs.emplace_back(search_pool_->push([&, idx = i]() {
-                auto single_query = (const char*)xq + idx * index_->data_size_;
-                auto rst = index_->searchRange(single_query, radius_for_calc, bitset, &param, feder_result);
-                auto elem_cnt = rst.size();
-                result_dist_array[idx].resize(elem_cnt);
-                result_id_array[idx].resize(elem_cnt);
-                for (size_t j = 0; j < elem_cnt; j++) {
-                    auto& p = rst[j];
-                    result_dist_array[idx][j] = (is_ip ? (-p.first) : p.first);
-                    result_id_array[idx][j] = p.second;
-                }
-                result_size[idx] = rst.size();
-                if (hnsw_cfg.range_filter.value() != defaultRangeFilter) {
-                    FilterRangeSearchResultForOneNq(result_dist_array[idx], result_id_array[idx], is_ip,
-                                                    radius_for_filter, range_filter);
+        RangeSearchResultBuilder results(nq, max_results, is_ip);
+
+        // the queries of a cancelled search are cut short or skipped, the search then fails
+        auto cancellation = hnsw_cfg.cancellation.get();
+        CancellationToken::Scope scope(cancellation);
+        const auto index_type = Type();
+        const auto& query_metrics = GetQueryMetrics(index_type);
+        auto sample_rate = hnsw_cfg.trace_sample_rate.value();
+        search_pool_->parallel_for(0, nq, 1, [&](int64_t idx) {
+            if (CancellationToken::CurrentCancelled()) {
+                return;
+            }
+            auto single_query = (const char*)xq + idx * index_->data_size_;
+            QueryStats::Current().Reset();
+            QueryTraceScope trace(index_type, sample_rate, idx);
+            auto rst = index_->searchRange(single_query, radius_for_calc, bitset, &param, feder_result);
+            query_metrics.Observe(QueryStats::Current());
+            // the range filter is applied while converting, so that the results are copied only once here
+            auto writer = results.Query(idx);
+            for (auto& [dist, id] : rst) {
+                float d = is_ip ? (-dist) : dist;
+                if (!do_filter || distance_in_range(d, radius_for_filter, range_filter, is_ip)) {
+                    writer.Add(d, id);
                 }
-            }));
-        }
-        for (auto& fut : futs) {
-            fut.wait();
+            }
+        });
+        if (cancellation != nullptr && cancellation->IsCancelled()) {
+            return expected<DataSetPtr>::Err(Status::search_cancelled, "range search cancelled");
         }
 
-        // filter range search result
-        GetRangeSearchResult(result_dist_array, result_id_array, is_ip, nq, radius_for_filter, range_filter, dis, ids,
-                             lims);
+        bool owned = results.Build(hnsw_cfg, dis, ids, lims);
 
         auto res = GenResultDataSet(nq, ids, dis, lims);
+        res->SetIsOwner(owned);
 
         // set visit_info json string into result dataset
         if (feder_result != nullptr) {
@@ -237,6 +588,26 @@ class HnswIndexNode : public IndexNode {
         return res;
     }
 
+    expected<std::vector<IndexIteratorPtr>>
+    AnnIterator(const DataSet& dataset, const Config& cfg, const BitsetView& bitset_in) const override {
+        if (!index_) {
+            LOG_KNOWHERE_WARNING_ << "iterator on empty index";
+            return expected<std::vector<IndexIteratorPtr>>::Err(Status::empty_index, "index not loaded");
+        }
+        std::shared_lock<std::shared_mutex> lock(graph_mutex_);
+        auto filter = std::make_shared<MergedFilter>();
+        auto bitset = FilterDeleted(bitset_in, filter->bits, filter->ids);
+        bool is_ip =
+            (index_->metric_type_ == hnswlib::Metric::INNER_PRODUCT || index_->metric_type_ == hnswlib::Metric::COSINE);
+        auto xq = static_cast<const char*>(dataset.GetTensor());
+        std::vector<IndexIteratorPtr> iterators(dataset.GetRows());
+        for (size_t i = 0; i < iterators.size(); ++i) {
+            iterators[i] = std::make_shared<HnswIterator>(index_, graph_mutex_, xq + i * index_->data_size_, bitset,
+                                                          is_ip, filter);
+        }
+        return iterators;
+    }
+
     expected<DataSetPtr>
     GetVectorByIds(const DataSet& dataset) const override {
         if (!index_) {
@@ -246,14 +617,19 @@ class HnswIndexNode : public IndexNode {
         auto dim = Dim();
         auto rows = dataset.GetRows();
         auto ids = dataset.GetIds();
+        for (int64_t i = 0; i < rows; i++) {
+            if (ids[i] < 0 || ids[i] >= (int64_t)index_->cur_element_count) {
+                LOG_KNOWHERE_WARNING_ << "get vector of id " << ids[i] << " out of range [0, "
+                                      << index_->cur_element_count << ")";
+                return expected<DataSetPtr>::Err(Status::invalid_args, "id out of range");
+            }
+        }
 
         char* data = nullptr;
         try {
             data = new char[index_->data_size_ * rows];
             for (int64_t i = 0; i < rows; i++) {
-                int64_t id = ids[i];
-                assert(id >= 0 && id < (int64_t)index_->cur_element_count);
-                std::copy_n(index_->getDataByInternalId(id), index_->data_size_, data + i * index_->data_size_);
+                index_->copyRawDataByInternalId(index_->getInternalId(ids[i]), data + i * index_->data_size_);
             }
             return GenResultDataSet(rows, dim, data);
         } catch (std::exception& e) {
@@ -265,7 +641,7 @@ class HnswIndexNode : public IndexNode {
 
     bool
     HasRawData(const std::string& metric_type) const override {
-        return true;
+        return index_ == nullptr || index_->hasRawData();
     }
 
     expected<DataSetPtr>
@@ -275,10 +651,11 @@ class HnswIndexNode : public IndexNode {
             return expected<DataSetPtr>::Err(Status::empty_index, "index not loaded");
         }
 
+        std::shared_lock<std::shared_mutex> lock(graph_mutex_);
         auto hnsw_cfg = static_cast<const HnswConfig&>(cfg);
         auto overview_levels = hnsw_cfg.overview_levels.value();
         feder::hnsw::HNSWMeta meta(index_->ef_construction_, index_->M_, index_->cur_element_count, index_->maxlevel_,
-                                   index_->enterpoint_node_, overview_levels);
+                                   index_->getExternalLabel(index_->enterpoint_node_), overview_levels);
         std::unordered_set<int64_t> id_set;
 
         for (int i = 0; i < overview_levels; i++) {
@@ -303,11 +680,10 @@ class HnswIndexNode : public IndexNode {
             LOG_KNOWHERE_ERROR_ << "Can not serialize empty HNSW index.";
             return Status::empty_index;
         }
+        std::shared_lock<std::shared_mutex> lock(graph_mutex_);
         try {
-            MemoryIOWriter writer;
-            index_->saveIndex(writer);
-            std::shared_ptr<uint8_t[]> data(writer.data_);
-            binset.Append(Type(), data, writer.rp);
+            auto [data, size] = SerializeToMemory([&](MemoryIOWriter& writer) { index_->saveIndex(writer); });
+            binset.Append(Type(), data, size);
         } catch (std::exception& e) {
             LOG_KNOWHERE_WARNING_ << "hnsw inner error: " << e.what();
             return Status::hnsw_inner_error;
@@ -315,8 +691,30 @@ class HnswIndexNode : public IndexNode {
         return Status::success;
     }
 
+    Status
+    SerializeToFile(SectionWriter& writer) const override {
+        if (!index_) {
+            LOG_KNOWHERE_ERROR_ << "Can not serialize empty HNSW index.";
+            return Status::empty_index;
+        }
+        std::shared_lock<std::shared_mutex> lock(graph_mutex_);
+        RETURN_IF_ERROR(writer.Begin(Type()));
+        try {
+            SectionIOWriter section(writer);
+            index_->saveIndex(section);
+        } catch (std::exception& e) {
+            LOG_KNOWHERE_WARNING_ << "hnsw inner error: " << e.what();
+            return Status::hnsw_inner_error;
+        }
+        return writer.End();
+    }
+
     Status
     Deserialize(const BinarySet& binset, const Config& config) override {
+        if (!HnswConfig::IsValidReorder(static_cast<const HnswConfig&>(config).reorder)) {
+            LOG_KNOWHERE_ERROR_ << "invalid reorder for hnsw";
+            return Status::invalid_args;
+        }
         if (index_) {
             delete index_;
         }
@@ -334,6 +732,17 @@ class HnswIndexNode : public IndexNode {
             hnswlib::SpaceInterface<float>* space = nullptr;
             index_ = new (std::nothrow) hnswlib::HierarchicalNSW<float>(space);
             index_->loadIndex(reader);
+            auto hnsw_cfg = static_cast<const HnswConfig&>(config);
+            if (hnsw_cfg.align_level0.has_value()) {
+                index_->setLevel0Aligned(hnsw_cfg.align_level0.value());
+            }
+            index_->reorderGraph(GetReorderType(hnsw_cfg.reorder));
+            if (hnsw_cfg.entry_hubs.has_value()) {
+                index_->setEntryHubs(hnsw_cfg.entry_hubs.value());
+            }
+            if (hnsw_cfg.compress_links.value()) {
+                index_->compressLinks();
+            }
             LOG_KNOWHERE_INFO_ << "Loaded HNSW index. #points num:" << index_->max_elements_ << " #M:" << index_->M_
                                << " #max level:" << index_->maxlevel_
                                << " #ef_construction:" << index_->ef_construction_
@@ -354,6 +763,16 @@ class HnswIndexNode : public IndexNode {
             hnswlib::SpaceInterface<float>* space = nullptr;
             index_ = new (std::nothrow) hnswlib::HierarchicalNSW<float>(space);
             index_->loadIndex(filename, config);
+            auto hnsw_cfg = static_cast<const HnswConfig&>(config);
+            if (hnsw_cfg.align_level0.has_value() && !index_->mmap_enabled_) {
+                index_->setLevel0Aligned(hnsw_cfg.align_level0.value());
+            }
+            if (hnsw_cfg.entry_hubs.has_value()) {
+                index_->setEntryHubs(hnsw_cfg.entry_hubs.value());
+            }
+            if (hnsw_cfg.compress_links.value() && !index_->mmap_enabled_) {
+                index_->compressLinks();
+            }
         } catch (std::exception& e) {
             LOG_KNOWHERE_WARNING_ << "hnsw inner error: " << e.what();
             return Status::hnsw_inner_error;
@@ -361,8 +780,25 @@ class HnswIndexNode : public IndexNode {
         return Status::success;
     }
 
+    void
+    SetSearchPool(std::shared_ptr<ThreadPool> pool) override {
+        search_pool_ = std::move(pool);
+    }
+
+    std::shared_ptr<ThreadPool>
+    AsyncSearchPool() const override {
+        return search_pool_;
+    }
+
     std::unique_ptr<BaseConfig>
     CreateConfig() const override {
+        if (type_ == IndexEnum::INDEX_HNSW_SQ8) {
+            return std::make_unique<HnswSqConfig>();
+        } else if (type_ == IndexEnum::INDEX_HNSW_PQ) {
+            return std::make_unique<HnswPqConfig>();
+        } else if (type_ == IndexEnum::INDEX_HNSW_PRQ) {
+            return std::make_unique<HnswPrqConfig>();
+        }
         return std::make_unique<HnswConfig>();
     }
 
@@ -376,10 +812,22 @@ class HnswIndexNode : public IndexNode {
 
     int64_t
     Size() const override {
+        return GetMemoryUsage().Total();
+    }
+
+    MemoryUsage
+    GetMemoryUsage() const override {
         if (!index_) {
-            return 0;
+            return MemoryUsage();
+        }
+        return index_->memoryUsage();
+    }
+
+    void
+    MappedRegions(std::vector<MappedRegion>& regions) const override {
+        if (index_) {
+            index_->mappedRegions(regions);
         }
-        return index_->cal_size();
     }
 
     int64_t
@@ -392,7 +840,7 @@ class HnswIndexNode : public IndexNode {
 
     std::string
     Type() const override {
-        return knowhere::IndexEnum::INDEX_HNSW;
+        return type_;
     }
 
     ~HnswIndexNode() override {
@@ -402,6 +850,48 @@ class HnswIndexNode : public IndexNode {
     }
 
  private:
+    // Deleted labels are filtered out along with the ones set in `bitset`; `buf` holds the bits when both are set, or
+    // `ids` the alive ids left when the filter is given by those.
+    BitsetView
+    FilterDeleted(const BitsetView& bitset, std::vector<uint8_t>& buf, std::vector<uint32_t>& ids) const {
+        auto deleted = index_->deletedBitset();
+        if (deleted.empty()) {
+            return bitset;
+        }
+        if (bitset.empty()) {
+            return deleted;
+        }
+        size_t num_bits = std::max(bitset.size(), deleted.size());
+        if (auto alive = bitset.alive_ids(); alive != nullptr) {
+            ids.clear();
+            for (size_t i = 0; i < bitset.num_alive_ids(); i++) {
+                if (!deleted.test(alive[i])) {
+                    ids.push_back(alive[i]);
+                }
+            }
+            for (size_t id = bitset.size(); id < deleted.size(); id++) {
+                if (!deleted.test(id)) {
+                    ids.push_back(id);
+                }
+            }
+            return BitsetView::FromAliveIds(ids.data(), ids.size(), num_bits);
+        }
+        buf.assign((num_bits + 7) / 8, 0);
+        if (bitset.is_dense()) {
+            std::copy_n(bitset.data(), bitset.byte_size(), buf.data());
+            for (size_t i = 0; i < deleted.byte_size(); i++) {
+                buf[i] |= deleted.data()[i];
+            }
+        } else {
+            for (size_t i = 0; i < num_bits; i += 64) {
+                size_t n = std::min<size_t>(64, num_bits - i);
+                uint64_t bits = bitset.block(i, n) | deleted.block(i, n);
+                std::memcpy(buf.data() + i / 8, &bits, (n + 7) / 8);
+            }
+        }
+        return BitsetView(buf.data(), num_bits);
+    }
+
     void
     UpdateLevelLinkList(int32_t level, feder::hnsw::HNSWMeta& meta, std::unordered_set<int64_t>& id_set) const {
         if (!(level > 0 && level <= index_->maxlevel_)) {
@@ -430,19 +920,78 @@ class HnswIndexNode : public IndexNode {
             std::vector<int64_t> neighbors(size);
             for (int i = 0; i < size; i++) {
                 hnswlib::tableint cand = datal[i];
-                neighbors[i] = cand;
+                neighbors[i] = index_->getExternalLabel(cand);
             }
-            id_set.insert(curr_id);
+            int64_t curr_label = index_->getExternalLabel(curr_id);
+            id_set.insert(curr_label);
             id_set.insert(neighbors.begin(), neighbors.end());
-            meta.AddNodeInfo(level, curr_id, std::move(neighbors));
+            meta.AddNodeInfo(level, curr_label, std::move(neighbors));
         }
     }
 
- private:
+    // HNSW_SQ8, HNSW_PQ and HNSW_PRQ rather than HNSW, whose level 0 is only quantized by sq_type
+    bool
+    IsQuantized() const {
+        return type_ != IndexEnum::INDEX_HNSW;
+    }
+
+    // Replaces the level 0 vectors of the built graph with the codes of the quantizer of the index type.
+    Status
+    QuantizeLevel0(const Config& cfg) {
+        auto& quant_cfg = static_cast<const HnswQuantConfig&>(cfg);
+        auto dim = Dim();
+        auto metric = index_->metric_type_ == hnswlib::Metric::L2 ? faiss::METRIC_L2 : faiss::METRIC_INNER_PRODUCT;
+        std::unique_ptr<faiss::Index> codec;
+        try {
+            if (type_ == IndexEnum::INDEX_HNSW_SQ8) {
+                auto qtype = strcasecmp(quant_cfg.sq_type.value().c_str(), kSqTypeSQ8) ? faiss::QT_fp16
+                                                                                       : faiss::QT_8bit;
+                codec = std::make_unique<faiss::IndexScalarQuantizer>(dim, qtype, metric);
+            } else if (type_ == IndexEnum::INDEX_HNSW_PQ) {
+                auto& pq_cfg = static_cast<const HnswPqConfig&>(cfg);
+                if (dim % pq_cfg.m.value() != 0) {
+                    LOG_KNOWHERE_ERROR_ << "dim " << dim << " of hnsw pq is not a multiple of m " << pq_cfg.m.value();
+                    return Status::invalid_args;
+                }
+                codec = std::make_unique<faiss::IndexPQ>(dim, pq_cfg.m.value(), pq_cfg.nbits.value(), metric);
+            } else {
+                auto& prq_cfg = static_cast<const HnswPrqConfig&>(cfg);
+                codec = std::make_unique<faiss::IndexResidualQuantizer>(dim, prq_cfg.m.value(), prq_cfg.nbits.value(),
+                                                                        metric);
+            }
+            index_->quantizeLevel0(std::move(codec), GetRefineType(quant_cfg.refine_type.value()));
+        } catch (std::exception& e) {
+            LOG_KNOWHERE_WARNING_ << "hnsw inner error: " << e.what();
+            return Status::hnsw_inner_error;
+        }
+        return Status::success;
+    }
+
+    // max number of queries handled by one search task
+    static constexpr int64_t kSearchTileSize = 16;
+
     hnswlib::HierarchicalNSW<float>* index_;
+    // The searches, the iterators, the inserts and the walks of the links hold it shared; a delete holds it
+    // exclusively, since the repair of the links to the deleted elements rewrites the link lists in place.
+    mutable std::shared_mutex graph_mutex_;
     std::shared_ptr<ThreadPool> search_pool_;
+    std::string type_;
 };
 
-KNOWHERE_REGISTER_GLOBAL(HNSW, [](const Object& object) { return Index<HnswIndexNode>::Create(object); });
+KNOWHERE_REGISTER_GLOBAL(HNSW, [](const Object& object) {
+    return Index<IndexNodePreTransformWrapper>::Create(std::make_unique<HnswIndexNode>(object));
+});
+KNOWHERE_REGISTER_GLOBAL(HNSW_SQ8, [](const Object& object) {
+    return Index<IndexNodePreTransformWrapper>::Create(
+        std::make_unique<HnswIndexNode>(object, IndexEnum::INDEX_HNSW_SQ8));
+});
+KNOWHERE_REGISTER_GLOBAL(HNSW_PQ, [](const Object& object) {
+    return Index<IndexNodePreTransformWrapper>::Create(
+        std::make_unique<HnswIndexNode>(object, IndexEnum::INDEX_HNSW_PQ));
+});
+KNOWHERE_REGISTER_GLOBAL(HNSW_PRQ, [](const Object& object) {
+    return Index<IndexNodePreTransformWrapper>::Create(
+        std::make_unique<HnswIndexNode>(object, IndexEnum::INDEX_HNSW_PRQ));
+});
 
 }  // namespace knowhere
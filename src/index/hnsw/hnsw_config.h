@@ -12,8 +12,10 @@
 #ifndef HNSW_CONFIG_H
 #define HNSW_CONFIG_H
 
+#include "common/knn_util.h"
 #include "knowhere/comp/index_param.h"
 #include "knowhere/config.h"
+#include "knowhere/utils.h"
 
 namespace knowhere {
 
@@ -21,6 +23,16 @@ namespace {
 
 constexpr const CFG_INT::value_type kEfMinValue = 16;
 constexpr const CFG_INT::value_type kDefaultRangeSearchEf = 16;
+constexpr const char* kSqTypeNone = "NONE";
+constexpr const char* kSqTypeSQ8 = "SQ8";
+constexpr const char* kSqTypeFP16 = "FP16";
+constexpr const char* kReorderNone = "NONE";
+constexpr const char* kReorderBFS = "BFS";
+constexpr const char* kReorderRCM = "RCM";
+constexpr const char* kReorderGorder = "GORDER";
+constexpr const char* kHnswRefineNone = "NONE";
+constexpr const char* kHnswRefineFP16 = "FP16";
+constexpr const char* kHnswRefineFP32 = "FP32";
 
 }  // namespace
 
@@ -30,6 +42,17 @@ class HnswConfig : public BaseConfig {
     CFG_INT efConstruction;
     CFG_INT ef;
     CFG_INT overview_levels;
+    CFG_STRING sq_type;
+    CFG_BOOL refine;
+    CFG_BOOL align_level0;
+    CFG_INT prefetch_depth;
+    CFG_INT early_stop_patience;
+    CFG_FLOAT filter_threshold;
+    CFG_INT range_init_ef;
+    CFG_INT entry_hubs;
+    CFG_STRING reorder;
+    CFG_STRING knn_graph;
+    CFG_BOOL compress_links;
     KNOHWERE_DECLARE_CONFIG(HnswConfig) {
         KNOWHERE_CONFIG_DECLARE_FIELD(M).description("hnsw M").set_default(30).set_range(1, 2048).for_train();
         KNOWHERE_CONFIG_DECLARE_FIELD(efConstruction)
@@ -48,6 +71,99 @@ class HnswConfig : public BaseConfig {
             .set_default(3)
             .set_range(1, 5)
             .for_feder();
+        KNOWHERE_CONFIG_DECLARE_FIELD(sq_type)
+            .description("hnsw level 0 scalar quantizer type, NONE/SQ8/FP16")
+            .set_default(kSqTypeNone)
+            .for_train();
+        KNOWHERE_CONFIG_DECLARE_FIELD(refine)
+            .description("keep raw vectors to re-rank the quantized level 0 results")
+            .set_default(false)
+            .for_train();
+        KNOWHERE_CONFIG_DECLARE_FIELD(align_level0)
+            .description("pad level 0 records to cache lines, keeps the stored layout on load if not set")
+            .allow_empty_without_default()
+            .for_train()
+            .for_deserialize()
+            .for_deserialize_from_file();
+        KNOWHERE_CONFIG_DECLARE_FIELD(prefetch_depth)
+            .description("hnsw neighbors prefetched ahead, defaults by SIMD level")
+            .allow_empty_without_default()
+            .set_range(1, 16)
+            .for_search()
+            .for_range_search();
+        KNOWHERE_CONFIG_DECLARE_FIELD(early_stop_patience)
+            .description("stop a hnsw knn search after this many expansions without improving the top k")
+            .allow_empty_without_default()
+            .set_range(1, std::numeric_limits<CFG_INT::value_type>::max())
+            .for_search();
+        KNOWHERE_CONFIG_DECLARE_FIELD(filter_threshold)
+            .description("the filtered out ratio from which hnsw knn search goes brute force, -1 for the default")
+            .set_default(-1.0f)
+            .set_range(-1.0f, 1.0f)
+            .for_search();
+        KNOWHERE_CONFIG_DECLARE_FIELD(range_init_ef)
+            .description("hnsw range search starts with this ef, grown up to ef until a candidate is in range")
+            .allow_empty_without_default()
+            .set_range(1, std::numeric_limits<CFG_INT::value_type>::max())
+            .for_range_search();
+        KNOWHERE_CONFIG_DECLARE_FIELD(entry_hubs)
+            .description("number of top level hnsw nodes a search may start from, keeps the stored ones if not set")
+            .allow_empty_without_default()
+            .set_range(0, 65536)
+            .for_train()
+            .for_deserialize()
+            .for_deserialize_from_file();
+        KNOWHERE_CONFIG_DECLARE_FIELD(reorder)
+            .description("hnsw graph reordering after build or on load, NONE/BFS/RCM/GORDER")
+            .allow_empty_without_default()
+            .for_train()
+            .for_deserialize();
+        KNOWHERE_CONFIG_DECLARE_FIELD(knn_graph)
+            .description("build level 0 by pruning a kNN graph instead of by inserts, NONE/NN_DESCENT/CAGRA")
+            .set_default(kKnnGraphNone)
+            .for_train();
+        KNOWHERE_CONFIG_DECLARE_FIELD(compress_links)
+            .description("keep the hnsw level 0 links compressed, sized to their counts, the index is read only then")
+            .set_default(false)
+            .for_train()
+            .for_deserialize()
+            .for_deserialize_from_file();
+    }
+
+    // an unset reorder means NONE
+    static bool
+    IsValidReorder(const CFG_STRING& reorder) {
+        if (!reorder.has_value()) {
+            return true;
+        }
+        auto& type = reorder.value();
+        return !strcasecmp(type.c_str(), kReorderNone) || !strcasecmp(type.c_str(), kReorderBFS) ||
+               !strcasecmp(type.c_str(), kReorderRCM) || !strcasecmp(type.c_str(), kReorderGorder);
+    }
+
+    inline Status
+    CheckAndAdjustForBuild() override {
+        if (!IsValidReorder(reorder)) {
+            LOG_KNOWHERE_ERROR_ << "invalid reorder " << reorder.value() << " for hnsw";
+            return Status::invalid_args;
+        }
+        if (!IsValidKnnGraph(knn_graph.value())) {
+            LOG_KNOWHERE_ERROR_ << "invalid knn_graph " << knn_graph.value() << " for hnsw";
+            return Status::invalid_args;
+        }
+        auto& type = sq_type.value();
+        if (strcasecmp(type.c_str(), kSqTypeNone) && strcasecmp(type.c_str(), kSqTypeSQ8) &&
+            strcasecmp(type.c_str(), kSqTypeFP16)) {
+            LOG_KNOWHERE_ERROR_ << "invalid sq_type " << type << " for hnsw";
+            return Status::invalid_args;
+        }
+        auto& metric = metric_type.value();
+        if (strcasecmp(type.c_str(), kSqTypeNone) &&
+            (IsMetricType(metric, metric::HAMMING) || IsMetricType(metric, metric::JACCARD))) {
+            LOG_KNOWHERE_ERROR_ << "sq_type " << type << " does not support metric " << metric;
+            return Status::invalid_args;
+        }
+        return Status::success;
     }
 
     inline Status
@@ -74,6 +190,98 @@ class HnswConfig : public BaseConfig {
     }
 };
 
+// The graph of HNSW_SQ8, HNSW_PQ and HNSW_PRQ is built on the vectors, then its level 0 keeps their codes.
+class HnswQuantConfig : public HnswConfig {
+ public:
+    CFG_STRING refine_type;
+    CFG_FLOAT refine_k;
+    KNOHWERE_DECLARE_CONFIG(HnswQuantConfig) {
+        KNOWHERE_CONFIG_DECLARE_FIELD(refine_type)
+            .description("the copy of the vectors kept to re-rank the quantized results, NONE/FP16/FP32")
+            .set_default(kHnswRefineNone)
+            .for_train();
+        KNOWHERE_CONFIG_DECLARE_FIELD(refine_k)
+            .description("re-rank the closest refine_k * k candidates of a search, all of the ef ones if not set")
+            .allow_empty_without_default()
+            .set_range(1.0f, std::numeric_limits<CFG_FLOAT::value_type>::max())
+            .for_search();
+    }
+
+    inline Status
+    CheckAndAdjustForBuild() override {
+        RETURN_IF_ERROR(HnswConfig::CheckAndAdjustForBuild());
+        auto& type = refine_type.value();
+        if (strcasecmp(type.c_str(), kHnswRefineNone) && strcasecmp(type.c_str(), kHnswRefineFP16) &&
+            strcasecmp(type.c_str(), kHnswRefineFP32)) {
+            LOG_KNOWHERE_ERROR_ << "invalid refine_type " << type << " for hnsw";
+            return Status::invalid_args;
+        }
+        auto& metric = metric_type.value();
+        if (IsMetricType(metric, metric::HAMMING) || IsMetricType(metric, metric::JACCARD)) {
+            LOG_KNOWHERE_ERROR_ << "quantized hnsw does not support metric " << metric;
+            return Status::invalid_metric_type;
+        }
+        return Status::success;
+    }
+};
+
+class HnswSqConfig : public HnswQuantConfig {
+ public:
+    KNOHWERE_DECLARE_CONFIG(HnswSqConfig) {
+        KNOWHERE_CONFIG_DECLARE_FIELD(sq_type)
+            .description("hnsw level 0 scalar quantizer type, SQ8/FP16")
+            .set_default(kSqTypeSQ8)
+            .for_train();
+    }
+
+    inline Status
+    CheckAndAdjustForBuild() override {
+        if (!strcasecmp(sq_type.value().c_str(), kSqTypeNone)) {
+            LOG_KNOWHERE_ERROR_ << "sq_type of hnsw sq8 should be SQ8 or FP16";
+            return Status::invalid_args;
+        }
+        return HnswQuantConfig::CheckAndAdjustForBuild();
+    }
+};
+
+class HnswPqConfig : public HnswQuantConfig {
+ public:
+    CFG_INT m;
+    CFG_INT nbits;
+    KNOHWERE_DECLARE_CONFIG(HnswPqConfig) {
+        KNOWHERE_CONFIG_DECLARE_FIELD(m)
+            .description("number of sub-vectors of the product quantizer, a divisor of dim")
+            .set_default(4)
+            .set_range(1, 65536)
+            .for_train();
+        KNOWHERE_CONFIG_DECLARE_FIELD(nbits)
+            .description("bits of the code of each sub-vector")
+            .set_default(8)
+            .set_range(1, 16)
+            .for_train();
+    }
+};
+
+// faiss has no product residual quantizer here, the level 0 codes of HNSW_PRQ are the ones of a residual quantizer
+// over the whole vector, m codebooks of nbits each.
+class HnswPrqConfig : public HnswQuantConfig {
+ public:
+    CFG_INT m;
+    CFG_INT nbits;
+    KNOHWERE_DECLARE_CONFIG(HnswPrqConfig) {
+        KNOWHERE_CONFIG_DECLARE_FIELD(m)
+            .description("number of residual codebooks")
+            .set_default(2)
+            .set_range(1, 64)
+            .for_train();
+        KNOWHERE_CONFIG_DECLARE_FIELD(nbits)
+            .description("bits of the code of each codebook")
+            .set_default(8)
+            .set_range(1, 16)
+            .for_train();
+    }
+};
+
 }  // namespace knowhere
 
 #endif /* HNSW_CONFIG_H */
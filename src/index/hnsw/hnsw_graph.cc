@@ -0,0 +1,53 @@
+// Copyright (C) 2019-2023 Zilliz. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file except in compliance
+// with the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
+// or implied. See the License for the specific language governing permissions and limitations under the License.
+
+#include "index/hnsw/hnsw_graph.h"
+
+#include <memory>
+
+#include "hnswlib/hnswalg.h"
+#include "hnswlib/hnswlib.h"
+#include "io/FaissIO.h"
+#include "knowhere/comp/index_param.h"
+#include "knowhere/log.h"
+#include "knowhere/utils.h"
+
+namespace knowhere {
+
+Status
+SerializeGraphAsHnsw(const float* data, const uint32_t* graph, int64_t rows, int64_t dim, int64_t degree,
+                     const std::string& metric_type, BinarySet& binset) {
+    // the index owns its space and frees it
+    hnswlib::SpaceInterface<float>* space = nullptr;
+    if (IsMetricType(metric_type, metric::L2)) {
+        space = new (std::nothrow) hnswlib::L2Space(dim);
+    } else if (IsMetricType(metric_type, metric::IP)) {
+        space = new (std::nothrow) hnswlib::InnerProductSpace(dim);
+    } else if (IsMetricType(metric_type, metric::COSINE)) {
+        space = new (std::nothrow) hnswlib::CosineSpace(dim);
+    } else {
+        LOG_KNOWHERE_WARNING_ << "metric type not support in hnsw: " << metric_type;
+        return Status::invalid_metric_type;
+    }
+    try {
+        auto m = std::max<int64_t>(1, (degree + 1) / 2);
+        auto index = std::make_unique<hnswlib::HierarchicalNSW<float>>(space, rows, m, 2 * m);
+        index->loadLevel0Graph(data, graph, rows, degree);
+        auto [binary, size] = SerializeToMemory([&](MemoryIOWriter& writer) { index->saveIndex(writer); });
+        binset.Append(IndexEnum::INDEX_HNSW, binary, size);
+    } catch (std::exception& e) {
+        LOG_KNOWHERE_WARNING_ << "hnsw inner error: " << e.what();
+        return Status::hnsw_inner_error;
+    }
+    return Status::success;
+}
+
+}  // namespace knowhere
@@ -0,0 +1,36 @@
+// Copyright (C) 2019-2023 Zilliz. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file except in compliance
+// with the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
+// or implied. See the License for the specific language governing permissions and limitations under the License.
+
+#ifndef HNSW_GRAPH_H
+#define HNSW_GRAPH_H
+
+#include <cstdint>
+#include <string>
+
+#include "knowhere/binaryset.h"
+#include "knowhere/expected.h"
+
+namespace knowhere {
+
+/**
+ * @brief Serializes float vectors and a kNN graph over them, built elsewhere (CAGRA on a GPU), as an HNSW index of a
+ * single level, under the binary name HnswIndexNode loads. A host without a GPU then serves the graph as HNSW.
+ *
+ * @param graph degree neighbor ids a row, rows rows; at most 2 * M of each are kept, M being degree / 2 rounded up
+ * @param metric_type L2, IP or COSINE
+ */
+Status
+SerializeGraphAsHnsw(const float* data, const uint32_t* graph, int64_t rows, int64_t dim, int64_t degree,
+                     const std::string& metric_type, BinarySet& binset);
+
+}  // namespace knowhere
+
+#endif /* HNSW_GRAPH_H */
@@ -9,25 +9,44 @@
 // is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
 // or implied. See the License for the specific language governing permissions and limitations under the License.
 
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <numeric>
+
+#include "common/knn_util.h"
 #include "common/metric.h"
 #include "common/range_util.h"
 #include "faiss/IndexBinaryFlat.h"
 #include "faiss/IndexBinaryIVF.h"
 #include "faiss/IndexFlat.h"
+#include "faiss/IndexHNSW.h"
 #include "faiss/IndexIVFFlat.h"
 #include "faiss/IndexIVFPQ.h"
 #include "faiss/IndexIVFPQFastScan.h"
+#include "faiss/IndexIVFRaBitQ.h"
 #include "faiss/IndexScaNN.h"
 #include "faiss/IndexScalarQuantizer.h"
+#include "faiss/VectorTransform.h"
+#include "faiss/impl/pq4_fast_scan.h"
 #include "faiss/index_io.h"
+#include "faiss/invlists/BlockInvertedLists.h"
+#include "faiss/invlists/OnDiskInvertedLists.h"
+#include "faiss/utils/Heap.h"
 #include "index/ivf/ivf_config.h"
 #include "io/FaissIO.h"
+#include "knowhere/comp/cancellation.h"
+#include "knowhere/comp/query_stats.h"
+#include "knowhere/comp/query_trace.h"
 #include "knowhere/comp/thread_pool.h"
 #include "knowhere/dataset.h"
 #include "knowhere/expected.h"
 #include "knowhere/factory.h"
+#include "knowhere/index_node_pre_transform_wrapper.h"
+#include "knowhere/index_node_refine_wrapper.h"
 #include "knowhere/feder/IVFFlat.h"
 #include "knowhere/log.h"
+#include "knowhere/prometheus_client.h"
 #include "knowhere/utils.h"
 
 namespace knowhere {
@@ -42,14 +61,256 @@ struct QuantizerT<faiss::IndexBinaryIVF> {
     using type = faiss::IndexBinaryFlat;
 };
 
+// The fast scan indexes search whole blocks of codes with their own kernels instead of an InvertedListScanner, and
+// IVF_RABITQ re-ranks the candidates of a whole search, so they are left out of the list by list search paths.
+template <typename T>
+constexpr bool kScansListByList = std::is_base_of<faiss::IndexIVF, T>::value &&
+                                  !std::is_same<T, faiss::IndexIVFPQFastScan>::value &&
+                                  !std::is_same<T, faiss::IndexIVFRaBitQ>::value;
+
+// a filtered knn search probes at most this many times nprobe lists, see SearchFiltered
+constexpr int64_t kFilterProbeExpansion = 8;
+
+// The search params of a knn search that the searches of preassigned lists take and the per query one does not.
+struct ScanOptions {
+    // the Hamming threshold of the polysemous filter of IVF_PQ, 0 for none
+    int polysemous_ht = 0;
+    // see CutProbes, 0 probes nprobe lists
+    float probe_ratio = 0.0f;
+};
+
+// The parameters of a scan of the probed lists; the IVF_PQ ones also carry the Hamming threshold of its polysemous
+// filter.
+template <typename T>
+using ScanParamsT = std::conditional_t<std::is_same<T, faiss::IndexIVFPQ>::value, faiss::IVFPQSearchParameters,
+                                       faiss::IVFSearchParameters>;
+
+template <typename T>
+ScanParamsT<T>
+MakeScanParams(size_t nprobe, int parallel_mode, const ScanOptions& opts) {
+    ScanParamsT<T> params;
+    params.nprobe = nprobe;
+    params.max_codes = 0;
+    params.parallel_mode = parallel_mode;
+    if constexpr (std::is_same<T, faiss::IndexIVFPQ>::value) {
+        params.polysemous_ht = opts.polysemous_ht;
+    }
+    return params;
+}
+
+// Cuts the nprobe probes of every query, sorted by centroid distance as the quantizer reports it, at the first one
+// further than ratio times the distance of the nearest centroid from it, i.e. a gap of (ratio - 1) * |d0|; the cut
+// probes are -1 and not scanned. A query whose nearest centroid stands out from the others probes fewer lists, one
+// that falls between several keeps up to nprobe of them.
+void
+CutProbes(faiss::Index::idx_t* keys, const float* coarse_dis, int64_t nq, int64_t nprobe, float ratio) {
+    if (ratio <= 0.0f) {
+        return;
+    }
+    for (int64_t i = 0; i < nq; ++i) {
+        auto row_keys = keys + i * nprobe;
+        auto row_dis = coarse_dis + i * nprobe;
+        float max_gap = (ratio - 1.0f) * std::abs(row_dis[0]);
+        for (int64_t j = 1; j < nprobe; ++j) {
+            if (std::abs(row_dis[j] - row_dis[0]) > max_gap) {
+                std::fill(row_keys + j, row_keys + nprobe, -1);
+                break;
+            }
+        }
+    }
+}
+
+// Adds the codes of the inverted lists to kVectors and their ids to kLists, at the size of the buffers that hold them.
+void
+AddInvertedListsUsage(const faiss::InvertedLists* invlists, MemoryUsage& usage) {
+    using idx_t = faiss::InvertedLists::idx_t;
+    if (invlists == nullptr) {
+        return;
+    }
+    if (auto ails = dynamic_cast<const faiss::ArrayInvertedLists*>(invlists)) {
+        for (size_t i = 0; i < ails->nlist; ++i) {
+            usage.Add(MemoryUsage::kVectors, MemoryUsage::kHeap, ails->codes[i].capacity());
+            usage.Add(MemoryUsage::kLists, MemoryUsage::kHeap, ails->ids[i].capacity() * sizeof(idx_t));
+        }
+    } else if (auto cils = dynamic_cast<const faiss::ConcurrentArrayInvertedLists*>(invlists)) {
+        // whole segments are allocated, the codes along with their norms
+        auto code_size = cils->code_size + (cils->save_norm ? sizeof(float) : 0);
+        for (size_t i = 0; i < cils->nlist; ++i) {
+            size_t segments = 0;
+            {
+                std::lock_guard lock(cils->lists[i].writer);
+                segments = cils->lists[i].segments.size();
+            }
+            usage.Add(MemoryUsage::kVectors, MemoryUsage::kHeap, segments * cils->segment_size * code_size);
+            usage.Add(MemoryUsage::kLists, MemoryUsage::kHeap, segments * cils->segment_size * sizeof(idx_t));
+        }
+    } else if (auto rils = dynamic_cast<const faiss::ReadOnlyArrayInvertedLists*>(invlists)) {
+        usage.Add(MemoryUsage::kVectors, MemoryUsage::kHeap, rils->readonly_codes.capacity());
+        usage.Add(MemoryUsage::kLists, MemoryUsage::kHeap, rils->readonly_ids.capacity() * sizeof(idx_t));
+    } else if (auto arena = dynamic_cast<const faiss::ArenaInvertedLists*>(invlists)) {
+        // the padding of the blocks goes to the codes
+        int64_t ids = 0;
+        for (auto size : arena->sizes) {
+            ids += size * sizeof(idx_t);
+        }
+        usage.Add(MemoryUsage::kVectors, MemoryUsage::kHeap, arena->arena_size - ids);
+        usage.Add(MemoryUsage::kLists, MemoryUsage::kHeap, ids);
+    } else if (auto blils = dynamic_cast<const faiss::BlockInvertedLists*>(invlists)) {
+        for (size_t i = 0; i < blils->nlist; ++i) {
+            usage.Add(MemoryUsage::kVectors, MemoryUsage::kHeap, blils->codes[i].size());
+            usage.Add(MemoryUsage::kLists, MemoryUsage::kHeap, blils->ids[i].capacity() * sizeof(idx_t));
+        }
+    } else if (auto odils = dynamic_cast<const faiss::OnDiskInvertedLists*>(invlists)) {
+        // the file is mapped as a whole, its free space goes to the codes
+        int64_t ids = odils->compute_ntotal() * sizeof(idx_t);
+        usage.Add(MemoryUsage::kVectors, MemoryUsage::kMmap, odils->totsize - ids);
+        usage.Add(MemoryUsage::kLists, MemoryUsage::kMmap, ids);
+    } else {
+        auto ntotal = invlists->compute_ntotal();
+        usage.Add(MemoryUsage::kVectors, MemoryUsage::kHeap, ntotal * invlists->code_size);
+        usage.Add(MemoryUsage::kLists, MemoryUsage::kHeap, ntotal * sizeof(idx_t));
+    }
+}
+
+// Adds the inverted lists, the coarse centroids and the codebooks of an IVF index.
+template <typename IVF>
+void
+AddIvfUsage(const IVF* ivf, MemoryUsage& usage) {
+    AddInvertedListsUsage(ivf->invlists, usage);
+    if constexpr (std::is_same<IVF, faiss::IndexBinaryIVF>::value) {
+        if (auto quantizer = dynamic_cast<const faiss::IndexBinaryFlat*>(ivf->quantizer)) {
+            usage.Add(MemoryUsage::kCodebooks, MemoryUsage::kHeap, quantizer->xb.capacity());
+        }
+    } else {
+        if (auto quantizer = dynamic_cast<const faiss::IndexFlatCodes*>(ivf->quantizer)) {
+            usage.Add(MemoryUsage::kCodebooks, MemoryUsage::kHeap, quantizer->codes.capacity());
+        } else if (ivf->quantizer != nullptr) {
+            usage.Add(MemoryUsage::kCodebooks, MemoryUsage::kHeap, ivf->nlist * ivf->d * sizeof(float));
+        }
+    }
+    if constexpr (std::is_same<IVF, faiss::IndexIVFPQ>::value || std::is_same<IVF, faiss::IndexIVFPQFastScan>::value) {
+        usage.Add(MemoryUsage::kCodebooks, MemoryUsage::kHeap,
+                  (ivf->pq.centroids.capacity() + ivf->precomputed_table.size()) * sizeof(float));
+    }
+    if constexpr (std::is_same<IVF, faiss::IndexIVFPQFastScan>::value) {
+        usage.Add(MemoryUsage::kVectors, MemoryUsage::kHeap, ivf->norms.capacity() * sizeof(float));
+    }
+    if constexpr (std::is_same<IVF, faiss::IndexIVFScalarQuantizer>::value) {
+        usage.Add(MemoryUsage::kCodebooks, MemoryUsage::kHeap, ivf->sq.trained.capacity() * sizeof(float));
+    }
+    if constexpr (std::is_same<IVF, faiss::IndexIVFRaBitQ>::value) {
+        // the rotation matrix and the rotated centroids, then the refine tier
+        usage.Add(MemoryUsage::kCodebooks, MemoryUsage::kHeap,
+                  (ivf->d * ivf->d + ivf->rotated_centroids.capacity()) * sizeof(float));
+        if (auto refine = dynamic_cast<const faiss::IndexFlatCodes*>(ivf->refine_index)) {
+            usage.Add(MemoryUsage::kVectors, MemoryUsage::kHeap, refine->codes.capacity());
+        }
+    }
+}
+
+// Pages through the lists of the index in the order of their centroids, nprobe lists a Refill. The top of the heap
+// waits while the lists scanned last still hold results closer than it, the further lists are then unlikely to.
+template <typename T>
+class IvfIterator : public IndexIterator {
+ public:
+    IvfIterator(const T* index, const float* query, int64_t nprobe, const BitsetView& bitset, bool is_cosine)
+        : IndexIterator(index->metric_type == faiss::METRIC_INNER_PRODUCT),
+          index_(index),
+          query_(query, query + index->d),
+          nprobe_(std::max<int64_t>(1, std::min<int64_t>(nprobe, index->nlist))),
+          bitset_(bitset),
+          keys_(index->nlist),
+          coarse_dis_(index->nlist) {
+        if (is_cosine) {
+            NormalizeVec(query_.data(), index->d);
+        }
+        index_->quantizer->search(1, query_.data(), index_->nlist, coarse_dis_.data(), keys_.data());
+    }
+
+ protected:
+    Status
+    Refill(int64_t wanted, bool& exhausted) override {
+        ThreadPool::ScopedOmpSetter setter(1);
+        int64_t end = std::min<int64_t>(cursor_ + nprobe_, index_->nlist);
+        faiss::IVFSearchParameters params;
+        params.nprobe = end - cursor_;
+        params.max_codes = 0;
+        params.parallel_mode = 0;
+        // every vector of the lists is in range
+        bool is_ip = index_->metric_type == faiss::METRIC_INNER_PRODUCT;
+        float radius = is_ip ? -std::numeric_limits<float>::infinity() : std::numeric_limits<float>::infinity();
+        faiss::RangeSearchResult res(1);
+        try {
+            if constexpr (std::is_same<T, faiss::IndexIVFFlat>::value) {
+                index_->range_search_preassigned_without_codes(1, query_.data(), radius, keys_.data() + cursor_,
+                                                               coarse_dis_.data() + cursor_, &res, false, &params,
+                                                               nullptr, bitset_);
+            } else {
+                index_->range_search_preassigned(1, query_.data(), radius, keys_.data() + cursor_,
+                                                 coarse_dis_.data() + cursor_, &res, false, &params, nullptr, bitset_);
+            }
+        } catch (const std::exception& e) {
+            LOG_KNOWHERE_WARNING_ << "faiss inner error: " << e.what();
+            return Status::faiss_inner_error;
+        }
+        has_batch_best_ = res.lims[1] > 0;
+        for (size_t i = 0; i < res.lims[1]; ++i) {
+            if (i == 0 || Closer(res.distances[i], batch_best_)) {
+                batch_best_ = res.distances[i];
+            }
+            Push(res.distances[i], res.labels[i]);
+        }
+        cursor_ = end;
+        exhausted = cursor_ >= index_->nlist;
+        return Status::success;
+    }
+
+    bool
+    MayFindCloser(float distance) const override {
+        return cursor_ < index_->nlist && has_batch_best_ && Closer(batch_best_, distance);
+    }
+
+ private:
+    const T* index_;
+    std::vector<float> query_;
+    int64_t nprobe_;
+    BitsetView bitset_;
+    // the lists by the distance of their centroids, the ones before the cursor are scanned
+    std::vector<faiss::Index::idx_t> keys_;
+    std::vector<float> coarse_dis_;
+    int64_t cursor_ = 0;
+    bool has_batch_best_ = false;
+    float batch_best_ = 0;
+};
+
+// The index types of the quantizers of IVF_SQ, by code size: 4 and 6 bits and fp16 per dimension next to the 8 bits of
+// IVF_SQ8.
+const char*
+SqIndexType(faiss::QuantizerType qtype) {
+    switch (qtype) {
+        case faiss::QuantizerType::QT_4bit:
+            return IndexEnum::INDEX_FAISS_IVFSQ4;
+        case faiss::QuantizerType::QT_6bit:
+            return IndexEnum::INDEX_FAISS_IVFSQ6;
+        case faiss::QuantizerType::QT_fp16:
+            return IndexEnum::INDEX_FAISS_IVFSQ_FP16;
+        default:
+            return IndexEnum::INDEX_FAISS_IVFSQ8;
+    }
+}
+
 template <typename T>
 class IvfIndexNode : public IndexNode {
  public:
-    IvfIndexNode(const Object& object) : index_(nullptr) {
+    // sq_qtype is the quantizer of an IVF_SQ index, the other indexes leave it out
+    IvfIndexNode(const Object& object, faiss::QuantizerType sq_qtype = faiss::QuantizerType::QT_8bit)
+        : index_(nullptr), sq_qtype_(sq_qtype) {
         static_assert(std::is_same<T, faiss::IndexIVFFlat>::value || std::is_same<T, faiss::IndexIVFFlatCC>::value ||
                           std::is_same<T, faiss::IndexIVFPQ>::value ||
+                          std::is_same<T, faiss::IndexIVFPQFastScan>::value ||
                           std::is_same<T, faiss::IndexIVFScalarQuantizer>::value ||
-                          std::is_same<T, faiss::IndexBinaryIVF>::value || std::is_same<T, faiss::IndexScaNN>::value,
+                          std::is_same<T, faiss::IndexBinaryIVF>::value || std::is_same<T, faiss::IndexScaNN>::value ||
+                          std::is_same<T, faiss::IndexIVFRaBitQ>::value,
                       "not support");
         search_pool_ = ThreadPool::GetGlobalSearchThreadPool();
     }
@@ -57,10 +318,14 @@ class IvfIndexNode : public IndexNode {
     Train(const DataSet& dataset, const Config& cfg) override;
     Status
     Add(const DataSet& dataset, const Config& cfg) override;
+    Status
+    Merge(const std::vector<const IndexNode*>& others, const Config& cfg) override;
     expected<DataSetPtr>
     Search(const DataSet& dataset, const Config& cfg, const BitsetView& bitset) const override;
     expected<DataSetPtr>
     RangeSearch(const DataSet& dataset, const Config& cfg, const BitsetView& bitset) const override;
+    expected<std::vector<IndexIteratorPtr>>
+    AnnIterator(const DataSet& dataset, const Config& cfg, const BitsetView& bitset) const override;
     expected<DataSetPtr>
     GetVectorByIds(const DataSet& dataset) const override;
     bool
@@ -74,26 +339,49 @@ class IvfIndexNode : public IndexNode {
         if constexpr (std::is_same<faiss::IndexIVFPQ, T>::value) {
             return false;
         }
+        if constexpr (std::is_same<faiss::IndexIVFPQFastScan, T>::value) {
+            return false;
+        }
         if constexpr (std::is_same<faiss::IndexScaNN, T>::value) {
-            return true;
+            // an SQ8 or FP16 refine tier replaces the raw vectors
+            return !index_ || index_->with_raw_data();
         }
         if constexpr (std::is_same<faiss::IndexIVFScalarQuantizer, T>::value) {
             return false;
         }
+        if constexpr (std::is_same<faiss::IndexIVFRaBitQ, T>::value) {
+            // only a FLAT refine tier keeps the raw vectors
+            return index_ && index_->with_raw_data();
+        }
         if constexpr (std::is_same<faiss::IndexBinaryIVF, T>::value) {
             return true;
         }
     }
     expected<DataSetPtr>
     GetIndexMeta(const Config& cfg) const override {
+        if (static_cast<const IvfConfig&>(cfg).list_stats.value()) {
+            return GetListStats();
+        }
         return expected<DataSetPtr>::Err(Status::not_implemented, "GetIndexMeta not implemented");
     }
     Status
     Serialize(BinarySet& binset) const override;
     Status
+    SerializeToFile(SectionWriter& writer) const override;
+    Status
     Deserialize(const BinarySet& binset, const Config& config) override;
     Status
     DeserializeFromFile(const std::string& filename, const Config& config) override;
+    void
+    SetSearchPool(std::shared_ptr<ThreadPool> pool) override {
+        search_pool_ = std::move(pool);
+    }
+
+    std::shared_ptr<ThreadPool>
+    AsyncSearchPool() const override {
+        return search_pool_;
+    }
+
     std::unique_ptr<BaseConfig>
     CreateConfig() const override {
         if constexpr (std::is_same<faiss::IndexIVFFlat, T>::value) {
@@ -105,12 +393,18 @@ class IvfIndexNode : public IndexNode {
         if constexpr (std::is_same<faiss::IndexIVFPQ, T>::value) {
             return std::make_unique<IvfPqConfig>();
         }
+        if constexpr (std::is_same<faiss::IndexIVFPQFastScan, T>::value) {
+            return std::make_unique<IvfPqFastScanConfig>();
+        }
         if constexpr (std::is_same<faiss::IndexScaNN, T>::value) {
             return std::make_unique<ScannConfig>();
         }
         if constexpr (std::is_same<faiss::IndexIVFScalarQuantizer, T>::value) {
             return std::make_unique<IvfSqConfig>();
         }
+        if constexpr (std::is_same<faiss::IndexIVFRaBitQ, T>::value) {
+            return std::make_unique<IvfRaBitQConfig>();
+        }
         if constexpr (std::is_same<faiss::IndexBinaryIVF, T>::value) {
             return std::make_unique<IvfBinConfig>();
         }
@@ -124,47 +418,51 @@ class IvfIndexNode : public IndexNode {
     };
     int64_t
     Size() const override {
+        return GetMemoryUsage().Total();
+    };
+    MemoryUsage
+    GetMemoryUsage() const override {
+        MemoryUsage usage;
         if (!index_) {
-            return 0;
+            return usage;
         }
-        if constexpr (std::is_same<T, faiss::IndexIVFFlat>::value) {
-            auto nb = index_->invlists->compute_ntotal();
-            auto nlist = index_->nlist;
-            auto code_size = index_->code_size;
-            return (nb * code_size + nb * sizeof(int64_t) + nlist * code_size);
-        }
-        if constexpr (std::is_same<T, faiss::IndexIVFFlatCC>::value) {
-            auto nb = index_->invlists->compute_ntotal();
-            auto nlist = index_->nlist;
-            auto code_size = index_->code_size;
-            return (nb * code_size + nb * sizeof(int64_t) + nlist * code_size);
+        usage.Add(MemoryUsage::kOther, MemoryUsage::kHeap, sizeof(*index_));
+        if constexpr (std::is_same<T, faiss::IndexScaNN>::value) {
+            if (auto base = dynamic_cast<const faiss::IndexIVFPQFastScan*>(index_->base_index)) {
+                AddIvfUsage(base, usage);
+            }
+            // the refine tier: the raw vectors mapped from the index file, or the vectors or codes in memory
+            if (index_->mmap_xb != nullptr) {
+                usage.Add(MemoryUsage::kVectors, MemoryUsage::kMmap, index_->mmap_size);
+            } else if (auto refine = dynamic_cast<const faiss::IndexFlatCodes*>(index_->refine_index)) {
+                usage.Add(MemoryUsage::kVectors, MemoryUsage::kHeap, refine->codes.capacity());
+            }
+        } else {
+            AddIvfUsage(index_.get(), usage);
         }
-        if constexpr (std::is_same<T, faiss::IndexIVFPQ>::value) {
-            auto nb = index_->invlists->compute_ntotal();
-            auto code_size = index_->code_size;
-            auto pq = index_->pq;
-            auto nlist = index_->nlist;
-            auto d = index_->d;
-
-            auto capacity = nb * code_size + nb * sizeof(int64_t) + nlist * d * sizeof(float);
-            auto centroid_table = pq.M * pq.ksub * pq.dsub * sizeof(float);
-            auto precomputed_table = nlist * pq.M * pq.ksub * sizeof(float);
-            return (capacity + centroid_table + precomputed_table);
+        return usage;
+    };
+    // the lists mapped from their file, then the raw vectors a ScaNN index maps for its refine tier, read last
+    void
+    MappedRegions(std::vector<MappedRegion>& regions) const override {
+        if (!index_) {
+            return;
         }
+        const faiss::InvertedLists* invlists = nullptr;
         if constexpr (std::is_same<T, faiss::IndexScaNN>::value) {
-            return index_->size();
+            if (auto base = dynamic_cast<const faiss::IndexIVFPQFastScan*>(index_->base_index)) {
+                invlists = base->invlists;
+            }
+        } else {
+            invlists = index_->invlists;
         }
-        if constexpr (std::is_same<T, faiss::IndexIVFScalarQuantizer>::value) {
-            auto nb = index_->invlists->compute_ntotal();
-            auto code_size = index_->code_size;
-            auto nlist = index_->nlist;
-            return (nb * code_size + nb * sizeof(int64_t) + 2 * code_size + nlist * code_size);
+        if (auto odils = dynamic_cast<const faiss::OnDiskInvertedLists*>(invlists)) {
+            regions.push_back({odils->ptr, odils->totsize});
         }
-        if constexpr (std::is_same<T, faiss::IndexBinaryIVF>::value) {
-            auto nb = index_->invlists->compute_ntotal();
-            auto nlist = index_->nlist;
-            auto code_size = index_->code_size;
-            return (nb * code_size + nb * sizeof(int64_t) + nlist * code_size);
+        if constexpr (std::is_same<T, faiss::IndexScaNN>::value) {
+            if (index_->mmap_ptr != nullptr) {
+                regions.push_back({index_->mmap_ptr, index_->mmap_size});
+            }
         }
     };
     int64_t
@@ -185,11 +483,17 @@ class IvfIndexNode : public IndexNode {
         if constexpr (std::is_same<T, faiss::IndexIVFPQ>::value) {
             return knowhere::IndexEnum::INDEX_FAISS_IVFPQ;
         }
+        if constexpr (std::is_same<T, faiss::IndexIVFPQFastScan>::value) {
+            return knowhere::IndexEnum::INDEX_FAISS_IVFPQ_FASTSCAN;
+        }
         if constexpr (std::is_same<T, faiss::IndexScaNN>::value) {
             return knowhere::IndexEnum::INDEX_FAISS_SCANN;
         }
         if constexpr (std::is_same<T, faiss::IndexIVFScalarQuantizer>::value) {
-            return knowhere::IndexEnum::INDEX_FAISS_IVFSQ8;
+            return SqIndexType(sq_qtype_);
+        }
+        if constexpr (std::is_same<T, faiss::IndexIVFRaBitQ>::value) {
+            return knowhere::IndexEnum::INDEX_FAISS_IVFRABITQ;
         }
         if constexpr (std::is_same<T, faiss::IndexBinaryIVF>::value) {
             return knowhere::IndexEnum::INDEX_FAISS_BIN_IVFFLAT;
@@ -197,12 +501,53 @@ class IvfIndexNode : public IndexNode {
     };
 
  private:
+    // writes the index in the faiss format, for Serialize and SerializeToFile
+    void
+    WriteIndex(faiss::IOWriter* writer) const;
+    void
+    NormalizeCodesOnce() const;
+    void
+    MakeDirectMapOnce() const;
+    template <typename Reconstruct>
+    void
+    GatherVectors(const int64_t* ids, int64_t rows, size_t row_size, uint8_t* data,
+                  const Reconstruct& reconstruct) const;
+    void
+    PackInvertedLists(const Config& cfg);
+    void
+    ComputeListRadius(const Config& cfg);
+    Status
+    CheckLoadedQuantizer() const;
+    void
+    SplitLists(int64_t rows, const float* data, const Config& cfg);
+    expected<DataSetPtr>
+    GetListStats() const;
+    void
+    SearchListMajor(const float* xq, int64_t nq, int64_t k, int64_t nprobe, bool is_cosine, float* distances,
+                    int64_t* ids, const BitsetView& bitset, const ScanOptions& opts) const;
+    std::vector<int64_t>
+    AliveListSizes(const BitsetView& bitset) const;
+    void
+    SearchFiltered(const float* xq, int64_t nq, int64_t k, int64_t nprobe, bool is_cosine, float* distances,
+                   int64_t* ids, const BitsetView& bitset, const ScanOptions& opts) const;
+    int64_t
+    ListSplits(int64_t nq, int64_t nprobe) const;
+    void
+    SearchAcrossLists(const float* xq, int64_t nq, int64_t k, int64_t nprobe, int64_t splits, bool is_cosine,
+                      float* distances, int64_t* ids, const BitsetView& bitset, const ScanOptions& opts) const;
+    void
+    RangeSearchAcrossLists(const float* xq, int64_t nq, float radius, int64_t nprobe, int64_t splits, bool is_cosine,
+                           std::vector<std::vector<float>>& result_dist_array,
+                           std::vector<std::vector<int64_t>>& result_id_array, const BitsetView& bitset) const;
+
     std::unique_ptr<T> index_;
     std::shared_ptr<ThreadPool> search_pool_;
+    faiss::QuantizerType sq_qtype_;
 
     // temporary solution to fix IVF_FLAT cosine
     mutable bool normalized_ = false;
     mutable std::mutex normalize_mtx_;
+    mutable std::mutex direct_map_mtx_;
 };
 
 }  // namespace knowhere
@@ -241,17 +586,90 @@ MatchNbits(int64_t size, int64_t nbits) {
     return nbits;
 }
 
+// Assigns the k-means training points on the build pool instead of OMP, one slice of the points per thread.
+class ClusteringAssigner : public faiss::IndexFlat {
+ public:
+    ClusteringAssigner(int64_t dim, faiss::MetricType metric)
+        : faiss::IndexFlat(dim, metric), pool_(ThreadPool::GetGlobalBuildThreadPool()) {
+    }
+
+    void
+    search(idx_t n, const float* x, idx_t k, float* distances, idx_t* labels,
+           const BitsetView bitset = nullptr) const override {
+        int64_t threads = std::max<int64_t>(1, pool_->size());
+        int64_t slice = std::max<int64_t>(kMinSlice, (n + threads - 1) / threads);
+        if (n <= slice) {
+            faiss::IndexFlat::search(n, x, k, distances, labels, bitset);
+            return;
+        }
+        std::vector<folly::Future<folly::Unit>> futs;
+        futs.reserve((n + slice - 1) / slice);
+        for (int64_t begin = 0; begin < n; begin += slice) {
+            futs.emplace_back(pool_->push([&, begin, end = std::min<int64_t>(n, begin + slice)] {
+                ThreadPool::ScopedOmpSetter setter(1);
+                faiss::IndexFlat::search(end - begin, x + begin * d, k, distances + begin * k, labels + begin * k,
+                                         bitset);
+            }));
+        }
+        for (auto& fut : futs) {
+            fut.wait();
+        }
+    }
+
+ private:
+    // flat search batches queries by 4096 rows for its matrix multiplication
+    static constexpr int64_t kMinSlice = 4096;
+    std::shared_ptr<ThreadPool> pool_;
+};
+
+// Trains `index` whose level-1 quantizer is that of `ivf`. The k-means samples at most max_points_per_centroid rows
+// per list, assigns them on the build pool, and starts from the centroids of centroids_file, if any. With an HNSW
+// quantizer_type the flat quantizer is then replaced by an HNSW graph over the trained centroids, which assigns the
+// added rows and the queries in about log(nlist) distance computations instead of nlist.
+template <typename IndexT>
+void
+TrainWithClustering(IndexT& index, faiss::IndexIVF& ivf, int64_t rows, const float* data, const IvfConfig& cfg) {
+    ivf.cp.max_points_per_centroid = cfg.max_points_per_centroid.value();
+    auto& path = cfg.centroids_file.value();
+    if (!path.empty()) {
+        std::ifstream reader(path, std::ios::binary | std::ios::ate);
+        size_t expected_size = ivf.nlist * ivf.d * sizeof(float);
+        if (reader && static_cast<size_t>(reader.tellg()) == expected_size) {
+            ivf.init_centroids.resize(ivf.nlist * ivf.d);
+            reader.seekg(0);
+            reader.read(reinterpret_cast<char*>(ivf.init_centroids.data()), expected_size);
+        } else {
+            LOG_KNOWHERE_WARNING_ << "centroids file " << path << " does not hold " << ivf.nlist << " centroids of dim "
+                                  << ivf.d << ", train from random points";
+        }
+    }
+    ClusteringAssigner assigner(ivf.d, ivf.quantizer->metric_type);
+    ivf.clustering_index = &assigner;
+    index.train(rows, data);
+    ivf.clustering_index = nullptr;
+    std::vector<float>().swap(ivf.init_centroids);
+
+    if (!strcasecmp(cfg.quantizer_type.value().c_str(), kQuantizerTypeHnsw)) {
+        auto flat = static_cast<faiss::IndexFlat*>(ivf.quantizer);
+        auto hnsw = std::make_unique<faiss::IndexHNSWFlat>(ivf.d, cfg.quantizer_m.value(), flat->metric_type);
+        hnsw->hnsw.efConstruction = cfg.quantizer_ef_construction.value();
+        hnsw->hnsw.efSearch = cfg.quantizer_ef.value();
+        hnsw->add(ivf.nlist, flat->get_xb());
+        ivf.quantizer = hnsw.release();
+        delete flat;
+    }
+}
+
 template <typename T>
 Status
 IvfIndexNode<T>::Train(const DataSet& dataset, const Config& cfg) {
     const BaseConfig& base_cfg = static_cast<const IvfConfig&>(cfg);
-    std::unique_ptr<ThreadPool::ScopedOmpSetter> setter;
-    if (base_cfg.num_build_thread.has_value()) {
-        setter = std::make_unique<ThreadPool::ScopedOmpSetter>(base_cfg.num_build_thread.value());
-    }
+    ThreadPool::ScopedBuildOmpSetter setter(base_cfg.num_build_thread);
     // do normalize for COSINE metric type
     if (IsMetricType(base_cfg.metric_type.value(), knowhere::metric::COSINE)) {
-        if constexpr (!(std::is_same_v<faiss::IndexIVFFlatCC, T>)&&!(std::is_same_v<faiss::IndexScaNN, T>)) {
+        // these normalize the data they are trained and added with themselves
+        if constexpr (!std::is_same_v<faiss::IndexIVFFlatCC, T> && !std::is_same_v<faiss::IndexScaNN, T> &&
+                      !std::is_same_v<faiss::IndexIVFPQFastScan, T>) {
             Normalize(dataset);
             normalized_ = true;
         }
@@ -276,7 +694,8 @@ IvfIndexNode<T>::Train(const DataSet& dataset, const Config& cfg) {
             auto nlist = MatchNlist(rows, ivf_flat_cfg.nlist.value());
             qzr = new (std::nothrow) typename QuantizerT<T>::type(dim, metric.value());
             index = std::make_unique<faiss::IndexIVFFlat>(qzr, dim, nlist, metric.value());
-            index->train(rows, (const float*)data);
+            index->column_blocked = ivf_flat_cfg.column_blocked.value();
+            TrainWithClustering(*index, *index, rows, (const float*)data, ivf_flat_cfg);
         }
         if constexpr (std::is_same<faiss::IndexIVFFlatCC, T>::value) {
             const IvfFlatCcConfig& ivf_flat_cc_cfg = static_cast<const IvfFlatCcConfig&>(cfg);
@@ -285,7 +704,7 @@ IvfIndexNode<T>::Train(const DataSet& dataset, const Config& cfg) {
             bool is_cosine = base_cfg.metric_type.value() == metric::COSINE;
             index = std::make_unique<faiss::IndexIVFFlatCC>(qzr, dim, nlist, ivf_flat_cc_cfg.ssize.value(), is_cosine,
                                                             metric.value());
-            index->train(rows, (const float*)data);
+            TrainWithClustering(*index, *index, rows, (const float*)data, ivf_flat_cc_cfg);
         }
         if constexpr (std::is_same<faiss::IndexIVFPQ, T>::value) {
             const IvfPqConfig& ivf_pq_cfg = static_cast<const IvfPqConfig&>(cfg);
@@ -293,7 +712,23 @@ IvfIndexNode<T>::Train(const DataSet& dataset, const Config& cfg) {
             auto nbits = MatchNbits(rows, ivf_pq_cfg.nbits.value());
             qzr = new (std::nothrow) typename QuantizerT<T>::type(dim, metric.value());
             index = std::make_unique<faiss::IndexIVFPQ>(qzr, dim, nlist, ivf_pq_cfg.m.value(), nbits, metric.value());
-            index->train(rows, (const float*)data);
+            if (!ivf_pq_cfg.precompute_table.value()) {
+                index->use_precomputed_table = -1;
+            }
+            // train_residual permutes the centroids of the trained PQ, an annealing over the 2^nbits codes of every
+            // sub-quantizer
+            index->do_polysemous_training = ivf_pq_cfg.polysemous.value();
+            TrainWithClustering(*index, *index, rows, (const float*)data, ivf_pq_cfg);
+        }
+        if constexpr (std::is_same<faiss::IndexIVFPQFastScan, T>::value) {
+            const IvfPqFastScanConfig& fast_scan_cfg = static_cast<const IvfPqFastScanConfig&>(cfg);
+            auto nlist = MatchNlist(rows, fast_scan_cfg.nlist.value());
+            auto m = fast_scan_cfg.m.value() > 0 ? fast_scan_cfg.m.value() : dim / 2;
+            bool is_cosine = base_cfg.metric_type.value() == metric::COSINE;
+            qzr = new (std::nothrow) typename QuantizerT<T>::type(dim, metric.value());
+            index = std::make_unique<faiss::IndexIVFPQFastScan>(qzr, dim, nlist, m, 4, is_cosine, metric.value(),
+                                                                fast_scan_cfg.bbs.value());
+            TrainWithClustering(*index, *index, rows, (const float*)data, fast_scan_cfg);
         }
         if constexpr (std::is_same<faiss::IndexScaNN, T>::value) {
             const ScannConfig& scann_cfg = static_cast<const ScannConfig&>(cfg);
@@ -303,16 +738,41 @@ IvfIndexNode<T>::Train(const DataSet& dataset, const Config& cfg) {
             base_index =
                 new (std::nothrow) faiss::IndexIVFPQFastScan(qzr, dim, nlist, dim / 2, 4, is_cosine, metric.value());
             base_index->own_fields = true;
-            index = std::make_unique<faiss::IndexScaNN>(base_index, (const float*)data);
-            index->train(rows, (const float*)data);
+            // the codes are assigned score-aware when the data is added, over the k-means codebooks
+            base_index->anisotropic_threshold = scann_cfg.anisotropic_threshold.value();
+            auto& refine_type = scann_cfg.refine_type.value();
+            if (!strcasecmp(refine_type.c_str(), kRefineTypeFlat)) {
+                index = std::make_unique<faiss::IndexScaNN>(base_index, (const float*)data);
+            } else {
+                auto qtype = !strcasecmp(refine_type.c_str(), kRefineTypeSQ8) ? faiss::QuantizerType::QT_8bit
+                                                                              : faiss::QuantizerType::QT_fp16;
+                index = std::make_unique<faiss::IndexScaNN>(
+                    base_index, new faiss::IndexScalarQuantizer(dim, qtype, metric.value()));
+                index->own_refine_index = true;
+            }
+            TrainWithClustering(*index, *base_index, rows, (const float*)data, scann_cfg);
         }
         if constexpr (std::is_same<faiss::IndexIVFScalarQuantizer, T>::value) {
             const IvfSqConfig& ivf_sq_cfg = static_cast<const IvfSqConfig&>(cfg);
             auto nlist = MatchNlist(rows, ivf_sq_cfg.nlist.value());
             qzr = new (std::nothrow) typename QuantizerT<T>::type(dim, metric.value());
-            index = std::make_unique<faiss::IndexIVFScalarQuantizer>(qzr, dim, nlist, faiss::QuantizerType::QT_8bit,
-                                                                     metric.value());
-            index->train(rows, (const float*)data);
+            index = std::make_unique<faiss::IndexIVFScalarQuantizer>(qzr, dim, nlist, sq_qtype_, metric.value());
+            TrainWithClustering(*index, *index, rows, (const float*)data, ivf_sq_cfg);
+        }
+        if constexpr (std::is_same<faiss::IndexIVFRaBitQ, T>::value) {
+            const IvfRaBitQConfig& rabitq_cfg = static_cast<const IvfRaBitQConfig&>(cfg);
+            auto nlist = MatchNlist(rows, rabitq_cfg.nlist.value());
+            qzr = new (std::nothrow) typename QuantizerT<T>::type(dim, metric.value());
+            index = std::make_unique<faiss::IndexIVFRaBitQ>(qzr, dim, nlist, metric.value());
+            auto& refine_type = rabitq_cfg.refine_type.value();
+            if (!strcasecmp(refine_type.c_str(), kRefineTypeFlat)) {
+                index->refine_index = new faiss::IndexFlat(dim, metric.value());
+            } else if (strcasecmp(refine_type.c_str(), kRefineTypeNone)) {
+                auto qtype = !strcasecmp(refine_type.c_str(), kRefineTypeSQ8) ? faiss::QuantizerType::QT_8bit
+                                                                              : faiss::QuantizerType::QT_fp16;
+                index->refine_index = new faiss::IndexScalarQuantizer(dim, qtype, metric.value());
+            }
+            TrainWithClustering(*index, *index, rows, (const float*)data, rabitq_cfg);
         }
         if constexpr (std::is_same<faiss::IndexBinaryIVF, T>::value) {
             const IvfBinConfig& ivf_bin_cfg = static_cast<const IvfBinConfig&>(cfg);
@@ -347,11 +807,11 @@ IvfIndexNode<T>::Add(const DataSet& dataset, const Config& cfg) {
     auto data = dataset.GetTensor();
     auto rows = dataset.GetRows();
     const BaseConfig& base_cfg = static_cast<const IvfConfig&>(cfg);
-    std::unique_ptr<ThreadPool::ScopedOmpSetter> setter;
-    if (base_cfg.num_build_thread.has_value()) {
-        setter = std::make_unique<ThreadPool::ScopedOmpSetter>(base_cfg.num_build_thread.value());
-    }
+    ThreadPool::ScopedBuildOmpSetter setter(base_cfg.num_build_thread);
     try {
+        if constexpr (!std::is_same<faiss::IndexBinaryIVF, T>::value) {
+            SplitLists(rows, (const float*)data, cfg);
+        }
         if constexpr (std::is_same<T, faiss::IndexIVFFlat>::value) {
             index_->add_without_codes(rows, (const float*)data);
         } else if constexpr (std::is_same<faiss::IndexBinaryIVF, T>::value) {
@@ -359,7 +819,10 @@ IvfIndexNode<T>::Add(const DataSet& dataset, const Config& cfg) {
         } else {
             index_->add(rows, (const float*)data);
         }
-
+        // the vectors of an IVF_FLAT only come with its raw data when loaded
+        if constexpr (!std::is_same<T, faiss::IndexIVFFlat>::value) {
+            ComputeListRadius(cfg);
+        }
     } catch (std::exception& e) {
         LOG_KNOWHERE_WARNING_ << "faiss inner error: " << e.what();
         return Status::faiss_inner_error;
@@ -367,6 +830,742 @@ IvfIndexNode<T>::Add(const DataSet& dataset, const Config& cfg) {
     return Status::success;
 }
 
+// Whether the refine tiers a and b, either of them null, hold the vectors the same way.
+bool
+SameRefine(const faiss::Index* a, const faiss::Index* b) {
+    auto refine_a = dynamic_cast<const faiss::IndexFlatCodes*>(a);
+    auto refine_b = dynamic_cast<const faiss::IndexFlatCodes*>(b);
+    if ((refine_a == nullptr) != (refine_b == nullptr)) {
+        return false;
+    }
+    if (refine_a != nullptr &&
+        (typeid(*refine_a) != typeid(*refine_b) || refine_a->code_size != refine_b->code_size)) {
+        return false;
+    }
+    auto sq_a = dynamic_cast<const faiss::IndexScalarQuantizer*>(refine_a);
+    auto sq_b = dynamic_cast<const faiss::IndexScalarQuantizer*>(refine_b);
+    return sq_a == nullptr || (sq_a->sq.qtype == sq_b->sq.qtype && sq_a->sq.trained == sq_b->sq.trained);
+}
+
+// Whether a and b assign and encode the vectors the same way, i.e. hold the same centroids and codebooks.
+template <typename IndexT>
+bool
+SameTraining(const IndexT& a, const IndexT& b) {
+    if constexpr (std::is_same<IndexT, faiss::IndexScaNN>::value) {
+        if (!SameRefine(a.refine_index, b.refine_index)) {
+            return false;
+        }
+        return SameTraining(*static_cast<const faiss::IndexIVFPQFastScan*>(a.base_index),
+                            *static_cast<const faiss::IndexIVFPQFastScan*>(b.base_index));
+    } else {
+        if (a.d != b.d || a.nlist != b.nlist || a.metric_type != b.metric_type || a.code_size != b.code_size) {
+            return false;
+        }
+        std::vector<float> centroids_a(a.nlist * a.d), centroids_b(b.nlist * b.d);
+        a.quantizer->reconstruct_n(0, a.nlist, centroids_a.data());
+        b.quantizer->reconstruct_n(0, b.nlist, centroids_b.data());
+        if (centroids_a != centroids_b) {
+            return false;
+        }
+        if constexpr (std::is_same<IndexT, faiss::IndexIVFPQ>::value) {
+            return a.by_residual == b.by_residual && a.pq.M == b.pq.M && a.pq.nbits == b.pq.nbits &&
+                   a.pq.centroids == b.pq.centroids;
+        }
+        if constexpr (std::is_same<IndexT, faiss::IndexIVFPQFastScan>::value) {
+            return a.by_residual == b.by_residual && a.pq.M == b.pq.M && a.pq.nbits == b.pq.nbits && a.bbs == b.bbs &&
+                   a.is_cosine_ == b.is_cosine_ && a.pq.centroids == b.pq.centroids;
+        }
+        if constexpr (std::is_same<IndexT, faiss::IndexIVFScalarQuantizer>::value) {
+            return a.by_residual == b.by_residual && a.sq.qtype == b.sq.qtype && a.sq.trained == b.sq.trained;
+        }
+        if constexpr (std::is_same<IndexT, faiss::IndexIVFRaBitQ>::value) {
+            auto rotation_a = static_cast<const faiss::LinearTransform*>(a.rotation);
+            auto rotation_b = static_cast<const faiss::LinearTransform*>(b.rotation);
+            return a.qb == b.qb && rotation_a->A == rotation_b->A && SameRefine(a.refine_index, b.refine_index);
+        }
+        return true;
+    }
+}
+
+// Appends the entries of the lists of src to the same lists of dst, their ids shifted by id_offset, segment by segment
+// for the lists stored in segments. Without codes only the ids are copied, for the lists of an IVF_FLAT.
+void
+AppendInvertedLists(faiss::InvertedLists& dst, const faiss::InvertedLists& src, int64_t id_offset, bool with_codes) {
+    using idx_t = faiss::InvertedLists::idx_t;
+    std::vector<idx_t> ids;
+    for (size_t list_no = 0; list_no < src.nlist; ++list_no) {
+        for (size_t segment = 0; segment < src.get_segment_num(list_no); ++segment) {
+            auto size = src.get_segment_size(list_no, segment);
+            if (size == 0) {
+                continue;
+            }
+            auto offset = src.get_segment_offset(list_no, segment);
+            auto src_ids = src.get_ids(list_no, offset);
+            ids.resize(size);
+            for (size_t i = 0; i < size; ++i) {
+                ids[i] = src_ids[i] + id_offset;
+            }
+            src.release_ids(list_no, src_ids);
+            if (!with_codes) {
+                dst.add_entries_without_codes(list_no, size, ids.data());
+                continue;
+            }
+            auto codes = src.get_codes(list_no, offset);
+            auto norms = src.get_code_norms(list_no, offset);
+            dst.add_entries(list_no, size, ids.data(), codes, norms);
+            src.release_codes(list_no, codes);
+            src.release_code_norms(list_no, norms);
+        }
+    }
+}
+
+// Appends the lists of a fast scan index to the ones of dst: the codes are unpacked from the blocks of src, then
+// packed after the last code of the same list of dst.
+void
+AppendBlockInvertedLists(faiss::IndexIVFPQFastScan& dst, const faiss::IndexIVFPQFastScan& src, int64_t id_offset) {
+    auto dst_lists = dynamic_cast<faiss::BlockInvertedLists*>(dst.invlists);
+    auto src_lists = dynamic_cast<const faiss::BlockInvertedLists*>(src.invlists);
+    if (dst_lists == nullptr || src_lists == nullptr) {
+        throw std::runtime_error("only block inverted lists can be merged");
+    }
+    // two 4 bit codes a byte, the layout pq4_pack_codes_range packs
+    size_t row_size = (dst.pq.M + 1) / 2;
+    std::vector<uint8_t> codes;
+    for (size_t list_no = 0; list_no < src_lists->nlist; ++list_no) {
+        size_t n = src_lists->list_size(list_no);
+        if (n == 0) {
+            continue;
+        }
+        codes.assign(n * row_size, 0);
+        for (size_t i = 0; i < n; ++i) {
+            for (size_t sq = 0; sq < src.pq.M; ++sq) {
+                uint8_t code = faiss::pq4_get_packed_element(src_lists->codes[list_no].get(), src.bbs, src.M2, i, sq);
+                codes[i * row_size + sq / 2] |= sq % 2 == 0 ? code : code << 4;
+            }
+        }
+        size_t size = dst_lists->list_size(list_no);
+        dst_lists->resize(list_no, size + n);
+        for (size_t i = 0; i < n; ++i) {
+            dst_lists->ids[list_no][size + i] = src_lists->ids[list_no][i] + id_offset;
+        }
+        faiss::pq4_pack_codes_range(codes.data(), dst.pq.M, size, size + n, dst.bbs, dst.M2,
+                                    dst_lists->codes[list_no].get());
+    }
+}
+
+// Appends the lists of srcs to the ones of dst, the ids of srcs[i] shifted by the rows of dst and of srcs[0..i). The
+// lists that can not be appended to, e.g. packed into an arena, are copied into an ArrayInvertedLists first.
+template <typename IVF>
+void
+MergeInvertedLists(IVF& dst, const std::vector<const IVF*>& srcs) {
+    int64_t id_offset = dst.ntotal;
+    if constexpr (std::is_same<IVF, faiss::IndexIVFPQFastScan>::value) {
+        for (auto src : srcs) {
+            AppendBlockInvertedLists(dst, *src, id_offset);
+            id_offset += src->ntotal;
+        }
+    } else {
+        constexpr bool with_codes = !std::is_same<IVF, faiss::IndexIVFFlat>::value;
+        if (dynamic_cast<faiss::ArrayInvertedLists*>(dst.invlists) == nullptr &&
+            dynamic_cast<faiss::ConcurrentArrayInvertedLists*>(dst.invlists) == nullptr) {
+            auto lists = new faiss::ArrayInvertedLists(dst.nlist, dst.code_size);
+            AppendInvertedLists(*lists, *dst.invlists, 0, with_codes);
+            dst.replace_invlists(lists, true);
+        }
+        for (auto src : srcs) {
+            AppendInvertedLists(*dst.invlists, *src->invlists, id_offset, with_codes);
+            id_offset += src->ntotal;
+        }
+    }
+    dst.ntotal = id_offset;
+}
+
+// The vectors of an IVF_FLAT are arranged apart from its lists, by the list they are in: the ones of all the indexes
+// are reconstructed in the order of their merged ids, then arranged again by the merged lists.
+std::vector<float>
+GatherArrangedVectors(const faiss::IndexIVFFlat& dst, const std::vector<const faiss::IndexIVFFlat*>& srcs) {
+    auto rows = dst.ntotal;
+    for (auto src : srcs) {
+        rows += src->ntotal;
+    }
+    std::vector<float> vectors(rows * dst.d);
+    int64_t id_offset = 0;
+    auto gather = [&](const faiss::IndexIVFFlat& ivf) {
+        if (ivf.ntotal > 0 && ivf.prefix_sum.size() != ivf.nlist + 1) {
+            throw std::runtime_error("IVF_FLAT without its raw data can not be merged");
+        }
+        for (size_t list_no = 0; list_no < ivf.nlist; ++list_no) {
+            for (size_t offset = 0; offset < ivf.invlists->list_size(list_no); ++offset) {
+                auto id = ivf.invlists->get_single_id(list_no, offset);
+                ivf.reconstruct_from_offset_without_codes(list_no, offset, vectors.data() + (id_offset + id) * ivf.d);
+            }
+        }
+        id_offset += ivf.ntotal;
+    };
+    gather(dst);
+    for (auto src : srcs) {
+        gather(*src);
+    }
+    return vectors;
+}
+
+// The lists of others are appended to the ones of this index as they are, their codes are not computed again.
+template <typename T>
+Status
+IvfIndexNode<T>::Merge(const std::vector<const IndexNode*>& others, const Config& cfg) {
+    if constexpr (std::is_same<T, faiss::IndexBinaryIVF>::value) {
+        return Status::not_implemented;
+    } else {
+        if (!index_) {
+            return Status::empty_index;
+        }
+        std::vector<const T*> srcs;
+        for (auto other : others) {
+            auto ivf = dynamic_cast<const IvfIndexNode<T>*>(other);
+            if (ivf == nullptr || ivf->index_ == nullptr || !SameTraining(*index_, *ivf->index_)) {
+                LOG_KNOWHERE_ERROR_ << "can only merge " << Type() << " indexes trained with the same quantizer";
+                return Status::invalid_args;
+            }
+            srcs.push_back(ivf->index_.get());
+        }
+        const BaseConfig& base_cfg = static_cast<const IvfConfig&>(cfg);
+        ThreadPool::ScopedBuildOmpSetter setter(base_cfg.num_build_thread);
+        try {
+            if constexpr (std::is_same<T, faiss::IndexScaNN>::value) {
+                auto base = static_cast<faiss::IndexIVFPQFastScan*>(index_->base_index);
+                if (index_->mmap_xb != nullptr) {
+                    LOG_KNOWHERE_ERROR_ << "Can not merge into a mmapped SCANN index.";
+                    return Status::not_implemented;
+                }
+                std::vector<const faiss::IndexIVFPQFastScan*> src_bases;
+                for (auto src : srcs) {
+                    auto src_base = static_cast<const faiss::IndexIVFPQFastScan*>(src->base_index);
+                    if (base->is_cosine_) {
+                        base->norms.insert(base->norms.end(), src_base->norms.begin(), src_base->norms.end());
+                    }
+                    src_bases.push_back(src_base);
+                }
+                MergeInvertedLists(*base, src_bases);
+                base->clear_list_radius();
+                // the refine tier holds the vectors or their codes by id
+                if (auto refine = dynamic_cast<faiss::IndexFlatCodes*>(index_->refine_index)) {
+                    for (auto src : srcs) {
+                        auto codes = src->mmap_xb != nullptr
+                                         ? reinterpret_cast<const uint8_t*>(src->mmap_xb)
+                                         : static_cast<const faiss::IndexFlatCodes*>(src->refine_index)->codes.data();
+                        refine->codes.insert(refine->codes.end(), codes, codes + src->ntotal * refine->code_size);
+                        refine->ntotal += src->ntotal;
+                    }
+                }
+                index_->ntotal = base->ntotal;
+            } else {
+                if (dynamic_cast<const faiss::OnDiskInvertedLists*>(index_->invlists) != nullptr) {
+                    LOG_KNOWHERE_ERROR_ << "Can not merge into a mmapped " << Type() << " index.";
+                    return Status::not_implemented;
+                }
+                std::vector<float> vectors;
+                if constexpr (std::is_same<T, faiss::IndexIVFFlat>::value) {
+                    vectors = GatherArrangedVectors(*index_, srcs);
+                }
+                MergeInvertedLists(*index_, srcs);
+                if constexpr (std::is_same<T, faiss::IndexIVFRaBitQ>::value) {
+                    // the refine tier holds the vectors or their codes by id
+                    if (auto refine = dynamic_cast<faiss::IndexFlatCodes*>(index_->refine_index)) {
+                        for (auto src : srcs) {
+                            auto& codes = static_cast<const faiss::IndexFlatCodes*>(src->refine_index)->codes;
+                            refine->codes.insert(refine->codes.end(), codes.begin(), codes.end());
+                            refine->ntotal += src->ntotal;
+                        }
+                    }
+                }
+                if constexpr (std::is_same<T, faiss::IndexIVFFlat>::value) {
+                    index_->arrange_codes(index_->ntotal, vectors.data());
+                    // the arranged vectors of the others may not be normalized yet
+                    normalized_ = false;
+                }
+                index_->clear_list_radius();
+                PackInvertedLists(cfg);
+                ComputeListRadius(cfg);
+                std::lock_guard<std::mutex> lock(direct_map_mtx_);
+                if (!index_->direct_map.no()) {
+                    index_->make_direct_map(true);
+                }
+            }
+        } catch (std::exception& e) {
+            LOG_KNOWHERE_WARNING_ << "faiss inner error: " << e.what();
+            return Status::faiss_inner_error;
+        }
+        return Status::success;
+    }
+}
+
+// temporary solution to fix IVF_FLAT cosine
+template <typename T>
+void
+IvfIndexNode<T>::NormalizeCodesOnce() const {
+    if constexpr (std::is_same<T, faiss::IndexIVFFlat>::value) {
+        if (!normalized_) {
+            std::lock_guard<std::mutex> lock(normalize_mtx_);
+            if (!normalized_) {
+                index_->normalize_arranged_codes();
+                if (index_->get_list_radius() != nullptr) {
+                    index_->compute_list_radius();
+                }
+                normalized_ = true;
+            }
+        }
+    }
+}
+
+// The direct map is built by the first GetVectorByIds of an index and kept up to date by its adds afterwards.
+template <typename T>
+void
+IvfIndexNode<T>::MakeDirectMapOnce() const {
+    std::lock_guard<std::mutex> lock(direct_map_mtx_);
+    if (index_->direct_map.no()) {
+        index_->make_direct_map(true);
+    }
+}
+
+// Copies the vectors of ids into data, row_size bytes each, with reconstruct(list_no, offset, row). The ids are
+// sorted by list and offset first, so that the lists are read in order, and the sorted ids are gathered in chunks by
+// the search pool.
+template <typename T>
+template <typename Reconstruct>
+void
+IvfIndexNode<T>::GatherVectors(const int64_t* ids, int64_t rows, size_t row_size, uint8_t* data,
+                               const Reconstruct& reconstruct) const {
+    constexpr int64_t kGatherGrain = 64;
+    MakeDirectMapOnce();
+    std::vector<std::pair<uint64_t, int64_t>> order(rows);
+    for (int64_t i = 0; i < rows; ++i) {
+        order[i] = {index_->direct_map.get(ids[i]), i};
+    }
+    std::sort(order.begin(), order.end());
+    auto gather = [&](int64_t i) {
+        auto [lo, row] = order[i];
+        reconstruct(faiss::lo_listno(lo), faiss::lo_offset(lo), data + row * row_size);
+    };
+    if (rows <= kGatherGrain) {
+        for (int64_t i = 0; i < rows; ++i) {
+            gather(i);
+        }
+        return;
+    }
+    search_pool_->parallel_for(0, rows, kGatherGrain, gather);
+}
+
+// Moves the inverted lists of a loaded index into one arena, so that scans do not jump between a vector per list.
+// The lists can not be appended to afterwards.
+template <typename T>
+void
+IvfIndexNode<T>::PackInvertedLists(const Config& cfg) {
+    if constexpr (std::is_same<T, faiss::IndexIVFScalarQuantizer>::value || std::is_same<T, faiss::IndexIVFPQ>::value) {
+        const IvfConfig& ivf_cfg = static_cast<const IvfConfig&>(cfg);
+        if (!ivf_cfg.invlists_arena.value() || dynamic_cast<faiss::ArrayInvertedLists*>(index_->invlists) == nullptr) {
+            return;
+        }
+        auto arena = new faiss::ArenaInvertedLists(*index_->invlists, ivf_cfg.huge_pages.value());
+        if (ivf_cfg.huge_pages.value() && !arena->huge_pages) {
+            LOG_KNOWHERE_INFO_ << "no huge pages reserved, inverted lists arena uses transparent huge pages";
+        }
+        index_->replace_invlists(arena, true);
+    }
+}
+
+// Bounds every list by the largest distance of its vectors to the centroid, the searches then skip the probed lists
+// none of the vectors of which can enter the top k or the range.
+template <typename T>
+void
+IvfIndexNode<T>::ComputeListRadius(const Config& cfg) {
+    if constexpr (std::is_same<T, faiss::IndexIVFFlat>::value ||
+                  std::is_same<T, faiss::IndexIVFScalarQuantizer>::value || std::is_same<T, faiss::IndexIVFPQ>::value) {
+        if (!static_cast<const IvfConfig&>(cfg).list_pruning.value()) {
+            return;
+        }
+        index_->compute_list_radius();
+    }
+}
+
+// An IVF_SQ index of one quantizer does not load the codes of another, their sizes and distances differ.
+template <typename T>
+Status
+IvfIndexNode<T>::CheckLoadedQuantizer() const {
+    if constexpr (std::is_same<T, faiss::IndexIVFScalarQuantizer>::value) {
+        if (index_->sq.qtype != sq_qtype_) {
+            LOG_KNOWHERE_ERROR_ << "Can not load an index of " << SqIndexType(index_->sq.qtype) << " codes as "
+                                << Type();
+            return Status::invalid_binary_set;
+        }
+    }
+    return Status::success;
+}
+
+// Splits the lists the first add makes larger than list_split_ratio times the mean list size into sub-centroids, so
+// that a few huge lists do not dominate the scan time of the queries probing them.
+template <typename T>
+void
+IvfIndexNode<T>::SplitLists(int64_t rows, const float* data, const Config& cfg) {
+    if constexpr (std::is_same<T, faiss::IndexIVFFlat>::value ||
+                  std::is_same<T, faiss::IndexIVFScalarQuantizer>::value || std::is_same<T, faiss::IndexIVFPQ>::value) {
+        auto ratio = static_cast<const IvfConfig&>(cfg).list_split_ratio.value();
+        if (ratio == 0.0f || rows == 0) {
+            return;
+        }
+        if (index_->ntotal > 0) {
+            LOG_KNOWHERE_INFO_ << "lists are only split on the first add";
+            return;
+        }
+        auto max_list_size = std::max<size_t>(1, static_cast<size_t>(ratio * rows / index_->nlist));
+        auto nadded = index_->split_lists(rows, data, max_list_size);
+        if (nadded > 0) {
+            LOG_KNOWHERE_INFO_ << "split the lists of more than " << max_list_size << " rows into " << nadded
+                               << " more lists";
+            // the precomputed tables depend on the centroids
+            if constexpr (std::is_same<T, faiss::IndexIVFPQ>::value) {
+                if (index_->by_residual) {
+                    index_->precompute_table();
+                }
+            }
+        }
+    }
+}
+
+// The list sizes as a histogram by powers of two, the imbalance factor, i.e. the number of codes scanned per probe
+// relative to lists of the same size, the bytes of every list, and the number of codes a probe scans on average
+// when the queries follow the data.
+template <typename IndexT>
+DataSetPtr
+GenListStats(const IndexT& ivf) {
+    size_t nlist = ivf.nlist;
+    size_t entry_size = ivf.code_size + sizeof(faiss::Index::idx_t);
+
+    std::vector<int64_t> list_bytes(nlist);
+    std::vector<int64_t> histogram;
+    size_t ntotal = 0, max_size = 0, min_size = std::numeric_limits<size_t>::max();
+    double square_sum = 0;
+    for (size_t i = 0; i < nlist; i++) {
+        size_t size = ivf.invlists->list_size(i);
+        ntotal += size;
+        max_size = std::max(max_size, size);
+        min_size = std::min(min_size, size);
+        square_sum += double(size) * size;
+        list_bytes[i] = size * entry_size;
+        // bucket 0 holds the empty lists, bucket b > 0 the sizes in [2^(b - 1), 2^b)
+        size_t bucket = 0;
+        while ((size >> bucket) != 0) {
+            bucket++;
+        }
+        if (histogram.size() <= bucket) {
+            histogram.resize(bucket + 1, 0);
+        }
+        histogram[bucket]++;
+    }
+
+    Json stats;
+    stats["nlist"] = nlist;
+    stats["ntotal"] = ntotal;
+    stats["min_list_size"] = nlist > 0 ? min_size : 0;
+    stats["max_list_size"] = max_size;
+    stats["mean_list_size"] = nlist > 0 ? double(ntotal) / nlist : 0.0;
+    stats["imbalance_factor"] = ntotal > 0 ? square_sum * nlist / (double(ntotal) * ntotal) : 1.0;
+    stats["avg_scanned_codes_per_probe"] = ntotal > 0 ? square_sum / ntotal : 0.0;
+    stats["list_size_histogram"] = histogram;
+    stats["list_bytes"] = list_bytes;
+    return GenResultDataSet(stats.dump(), "");
+}
+
+template <typename T>
+expected<DataSetPtr>
+IvfIndexNode<T>::GetListStats() const {
+    if (!index_) {
+        LOG_KNOWHERE_WARNING_ << "get list stats on empty index";
+        return expected<DataSetPtr>::Err(Status::empty_index, "index not loaded");
+    }
+    if constexpr (std::is_same<T, faiss::IndexScaNN>::value) {
+        return GenListStats(*static_cast<const faiss::IndexIVF*>(index_->base_index));
+    } else {
+        return GenListStats(*index_);
+    }
+}
+
+// Searches nq queries in the calling thread: they are assigned to lists with a single quantizer search, a matrix
+// multiplication for a large enough batch, and every probed list is then scanned once for all the queries probing it.
+template <typename T>
+void
+IvfIndexNode<T>::SearchListMajor(const float* xq, int64_t nq, int64_t k, int64_t nprobe, bool is_cosine,
+                                 float* distances, int64_t* ids, const BitsetView& bitset,
+                                 const ScanOptions& opts) const {
+    if constexpr (kScansListByList<T>) {
+        auto dim = index_->d;
+        std::unique_ptr<float[]> copied_queries = nullptr;
+        if (is_cosine) {
+            copied_queries = std::make_unique<float[]>(nq * dim);
+            std::copy_n(xq, nq * dim, copied_queries.get());
+            NormalizeVecs(copied_queries.get(), nq, dim);
+            xq = copied_queries.get();
+            NormalizeCodesOnce();
+        }
+        auto params = MakeScanParams<T>(std::min<size_t>(nprobe, index_->nlist),
+                                        faiss::IndexIVF::PARALLEL_MODE_LIST_MAJOR, opts);
+        auto assign = std::make_unique<faiss::Index::idx_t[]>(nq * params.nprobe);
+        auto coarse_dis = std::make_unique<float[]>(nq * params.nprobe);
+        index_->quantizer->search(nq, xq, params.nprobe, coarse_dis.get(), assign.get());
+        CutProbes(assign.get(), coarse_dis.get(), nq, params.nprobe, opts.probe_ratio);
+        // mapped lists are read ahead for the whole batch, see OnDiskInvertedLists::prefetch_lists
+        index_->invlists->prefetch_lists(assign.get(), nq * params.nprobe);
+        if constexpr (std::is_same<T, faiss::IndexIVFFlat>::value) {
+            index_->search_preassigned_without_codes(nq, xq, k, assign.get(), coarse_dis.get(), distances, ids, false,
+                                                     &params, nullptr, bitset);
+        } else {
+            index_->search_preassigned(nq, xq, k, assign.get(), coarse_dis.get(), distances, ids, false, &params,
+                                       nullptr, bitset);
+        }
+    }
+}
+
+// The vectors of every list that the filter keeps. A list whose ids are a run of consecutive ids, as the ones of a
+// list that is added in one go in id order tend to be, is counted by a popcount of its range of the bitset, the
+// others id by id.
+template <typename T>
+std::vector<int64_t>
+IvfIndexNode<T>::AliveListSizes(const BitsetView& bitset) const {
+    std::vector<int64_t> alive(index_->nlist, 0);
+    if constexpr (kScansListByList<T>) {
+        auto invlists = index_->invlists;
+        search_pool_->parallel_for(0, index_->nlist, 16, [&](int64_t list_no) {
+            size_t size = invlists->list_size(list_no);
+            if (size == 0) {
+                return;
+            }
+            faiss::InvertedLists::ScopedIds ids(invlists, list_no);
+            auto [lo, hi] = std::minmax_element(ids.get(), ids.get() + size);
+            if (*lo >= 0 && static_cast<size_t>(*hi - *lo) + 1 == size) {
+                alive[list_no] = size - bitset.count(*lo, *hi + 1);
+                return;
+            }
+            for (size_t j = 0; j < size; ++j) {
+                alive[list_no] += !bitset.test(ids[j]);
+            }
+        });
+    }
+    return alive;
+}
+
+// A knn search under a filter that leaves few vectors probes by the vectors the filter keeps in every list rather
+// than by nprobe lists alone: the lists it empties are skipped, and the probes go on in centroid order past nprobe
+// lists, up to kFilterProbeExpansion times as many, until nprobe lists with vectors left and at least k vectors, or
+// as many as nprobe lists keep on average, have been scanned.
+template <typename T>
+void
+IvfIndexNode<T>::SearchFiltered(const float* xq, int64_t nq, int64_t k, int64_t nprobe, bool is_cosine,
+                                float* distances, int64_t* ids, const BitsetView& bitset,
+                                const ScanOptions& opts) const {
+    if constexpr (kScansListByList<T>) {
+        auto dim = index_->d;
+        std::unique_ptr<float[]> copied_queries = nullptr;
+        if (is_cosine) {
+            copied_queries = std::make_unique<float[]>(nq * dim);
+            std::copy_n(xq, nq * dim, copied_queries.get());
+            NormalizeVecs(copied_queries.get(), nq, dim);
+            xq = copied_queries.get();
+            NormalizeCodesOnce();
+        }
+        int64_t nlist = index_->nlist;
+        auto alive = AliveListSizes(bitset);
+        auto alive_total = std::accumulate(alive.begin(), alive.end(), int64_t(0));
+        nprobe = std::min<int64_t>(nprobe, nlist);
+        int64_t max_probe = std::min<int64_t>(nlist, nprobe * kFilterProbeExpansion);
+        int64_t target = std::max<int64_t>(k, nprobe * alive_total / nlist);
+
+        auto keys = std::make_unique<faiss::Index::idx_t[]>(nq * max_probe);
+        auto coarse_dis = std::make_unique<float[]>(nq * max_probe);
+        index_->quantizer->search(nq, xq, max_probe, coarse_dis.get(), keys.get());
+        // the probes of a query are packed to the front of its row, the rest are -1 and not scanned
+        for (int64_t i = 0; i < nq; ++i) {
+            auto row_keys = keys.get() + i * max_probe;
+            auto row_dis = coarse_dis.get() + i * max_probe;
+            int64_t probed = 0, scanned = 0;
+            for (int64_t j = 0; j < max_probe && row_keys[j] >= 0; ++j) {
+                auto list_no = row_keys[j];
+                if (alive[list_no] == 0) {
+                    continue;
+                }
+                if (probed >= nprobe && scanned >= target) {
+                    break;
+                }
+                row_keys[probed] = list_no;
+                row_dis[probed++] = row_dis[j];
+                scanned += alive[list_no];
+            }
+            std::fill(row_keys + probed, row_keys + max_probe, -1);
+        }
+        index_->invlists->prefetch_lists(keys.get(), nq * max_probe);
+
+        search_pool_->parallel_for(0, nq, 1, [&](int64_t i) {
+            if (CancellationToken::CurrentCancelled()) {
+                return;
+            }
+            ThreadPool::ScopedOmpSetter setter(1);
+            auto params = MakeScanParams<T>(max_probe, 0, opts);
+            if constexpr (std::is_same<T, faiss::IndexIVFFlat>::value) {
+                index_->search_preassigned_without_codes(1, xq + i * dim, k, keys.get() + i * max_probe,
+                                                         coarse_dis.get() + i * max_probe, distances + i * k,
+                                                         ids + i * k, false, &params, nullptr, bitset);
+            } else {
+                index_->search_preassigned(1, xq + i * dim, k, keys.get() + i * max_probe,
+                                           coarse_dis.get() + i * max_probe, distances + i * k, ids + i * k, false,
+                                           &params, nullptr, bitset);
+            }
+        });
+    }
+}
+
+// Number of parts the probed lists of every query are split into, so that a handful of queries with many probes
+// still keep the threads the search may use busy. 1 when there are enough queries, or the index does not scan list by
+// list.
+template <typename T>
+int64_t
+IvfIndexNode<T>::ListSplits(int64_t nq, int64_t nprobe) const {
+    if constexpr (kScansListByList<T>) {
+        int64_t threads = search_pool_->concurrency();
+        if (nq < threads) {
+            return std::max<int64_t>(1, std::min<int64_t>(std::min<int64_t>(nprobe, index_->nlist), threads / nq));
+        }
+    }
+    return 1;
+}
+
+// Each query is assigned to its lists in the calling thread, then the probed lists are split in `splits` tasks
+// searched by the pool, and the per task result heaps of a query are merged.
+template <typename T>
+void
+IvfIndexNode<T>::SearchAcrossLists(const float* xq, int64_t nq, int64_t k, int64_t nprobe, int64_t splits,
+                                   bool is_cosine, float* distances, int64_t* ids, const BitsetView& bitset,
+                                   const ScanOptions& opts) const {
+    if constexpr (kScansListByList<T>) {
+        auto dim = index_->d;
+        std::unique_ptr<float[]> copied_queries = nullptr;
+        if (is_cosine) {
+            copied_queries = std::make_unique<float[]>(nq * dim);
+            std::copy_n(xq, nq * dim, copied_queries.get());
+            NormalizeVecs(copied_queries.get(), nq, dim);
+            xq = copied_queries.get();
+            NormalizeCodesOnce();
+        }
+        nprobe = std::min<int64_t>(nprobe, index_->nlist);
+        auto keys = std::make_unique<faiss::Index::idx_t[]>(nq * nprobe);
+        auto coarse_dis = std::make_unique<float[]>(nq * nprobe);
+        index_->quantizer->search(nq, xq, nprobe, coarse_dis.get(), keys.get());
+        CutProbes(keys.get(), coarse_dis.get(), nq, nprobe, opts.probe_ratio);
+        index_->invlists->prefetch_lists(keys.get(), nq * nprobe);
+
+        auto part_dis = std::make_unique<float[]>(nq * splits * k);
+        auto part_ids = std::make_unique<int64_t[]>(nq * splits * k);
+        search_pool_->parallel_for(0, nq * splits, 1, [&](int64_t t) {
+            if (CancellationToken::CurrentCancelled()) {
+                return;
+            }
+            auto i = t / splits;
+            auto p = t % splits;
+            ThreadPool::ScopedOmpSetter setter(1);
+            auto begin = i * nprobe + nprobe * p / splits;
+            auto end = i * nprobe + nprobe * (p + 1) / splits;
+            auto params = MakeScanParams<T>(end - begin, 0, opts);
+            auto offset = (i * splits + p) * k;
+            if constexpr (std::is_same<T, faiss::IndexIVFFlat>::value) {
+                index_->search_preassigned_without_codes(1, xq + i * dim, k, keys.get() + begin,
+                                                         coarse_dis.get() + begin, part_dis.get() + offset,
+                                                         part_ids.get() + offset, false, &params, nullptr, bitset);
+            } else {
+                index_->search_preassigned(1, xq + i * dim, k, keys.get() + begin, coarse_dis.get() + begin,
+                                           part_dis.get() + offset, part_ids.get() + offset, false, &params, nullptr,
+                                           bitset);
+            }
+        });
+
+        auto merge = [&](auto heap_tag) {
+            using Heap = decltype(heap_tag);
+            for (int64_t i = 0; i < nq; ++i) {
+                faiss::heap_heapify<Heap>(k, distances + i * k, ids + i * k);
+                for (int64_t p = 0; p < splits; ++p) {
+                    auto offset = (i * splits + p) * k;
+                    faiss::heap_addn<Heap>(k, distances + i * k, ids + i * k, part_dis.get() + offset,
+                                           part_ids.get() + offset, k);
+                }
+                faiss::heap_reorder<Heap>(k, distances + i * k, ids + i * k);
+            }
+        };
+        if (index_->metric_type == faiss::METRIC_INNER_PRODUCT) {
+            merge(faiss::CMin<float, int64_t>());
+        } else {
+            merge(faiss::CMax<float, int64_t>());
+        }
+    }
+}
+
+// Same as SearchAcrossLists for a range search. The parts of a query are concatenated.
+template <typename T>
+void
+IvfIndexNode<T>::RangeSearchAcrossLists(const float* xq, int64_t nq, float radius, int64_t nprobe, int64_t splits,
+                                        bool is_cosine, std::vector<std::vector<float>>& result_dist_array,
+                                        std::vector<std::vector<int64_t>>& result_id_array,
+                                        const BitsetView& bitset) const {
+    if constexpr (kScansListByList<T>) {
+        auto dim = index_->d;
+        std::unique_ptr<float[]> copied_queries = nullptr;
+        if (is_cosine) {
+            copied_queries = std::make_unique<float[]>(nq * dim);
+            std::copy_n(xq, nq * dim, copied_queries.get());
+            NormalizeVecs(copied_queries.get(), nq, dim);
+            xq = copied_queries.get();
+            NormalizeCodesOnce();
+        }
+        nprobe = std::min<int64_t>(nprobe, index_->nlist);
+        auto keys = std::make_unique<faiss::Index::idx_t[]>(nq * nprobe);
+        auto coarse_dis = std::make_unique<float[]>(nq * nprobe);
+        index_->quantizer->search(nq, xq, nprobe, coarse_dis.get(), keys.get());
+        index_->invlists->prefetch_lists(keys.get(), nq * nprobe);
+
+        std::vector<std::unique_ptr<faiss::RangeSearchResult>> parts(nq * splits);
+        for (auto& res : parts) {
+            res = std::make_unique<faiss::RangeSearchResult>(1);
+        }
+        search_pool_->parallel_for(0, nq * splits, 1, [&](int64_t t) {
+            if (CancellationToken::CurrentCancelled()) {
+                return;
+            }
+            auto i = t / splits;
+            auto p = t % splits;
+            ThreadPool::ScopedOmpSetter setter(1);
+            auto begin = i * nprobe + nprobe * p / splits;
+            auto end = i * nprobe + nprobe * (p + 1) / splits;
+            faiss::IVFSearchParameters params;
+            params.nprobe = end - begin;
+            params.max_codes = 0;
+            params.parallel_mode = 0;
+            auto& res = parts[i * splits + p];
+            if constexpr (std::is_same<T, faiss::IndexIVFFlat>::value) {
+                index_->range_search_preassigned_without_codes(1, xq + i * dim, radius, keys.get() + begin,
+                                                               coarse_dis.get() + begin, res.get(), false, &params,
+                                                               nullptr, bitset);
+            } else {
+                index_->range_search_preassigned(1, xq + i * dim, radius, keys.get() + begin, coarse_dis.get() + begin,
+                                                 res.get(), false, &params, nullptr, bitset);
+            }
+        });
+
+        for (int64_t i = 0; i < nq; ++i) {
+            for (int64_t p = 0; p < splits; ++p) {
+                auto& res = parts[i * splits + p];
+                auto elem_cnt = res->lims[1];
+                result_dist_array[i].insert(result_dist_array[i].end(), res->distances, res->distances + elem_cnt);
+                result_id_array[i].insert(result_id_array[i].end(), res->labels, res->labels + elem_cnt);
+            }
+        }
+    }
+}
+
 template <typename T>
 expected<DataSetPtr>
 IvfIndexNode<T>::Search(const DataSet& dataset, const Config& cfg, const BitsetView& bitset) const {
@@ -389,15 +1588,53 @@ IvfIndexNode<T>::Search(const DataSet& dataset, const Config& cfg, const BitsetV
     auto k = ivf_cfg.k.value();
     auto nprobe = ivf_cfg.nprobe.value();
 
-    int64_t* ids(new (std::nothrow) int64_t[rows * k]);
-    float* distances(new (std::nothrow) float[rows * k]);
+    KnnResultBuffers buffers(ivf_cfg, rows * k);
+    int64_t* ids = buffers.ids;
+    float* distances = buffers.distances;
     int32_t* i_distances = reinterpret_cast<int32_t*>(distances);
+    // ScaNN, fast scan and binary indexes do not scan list by list
+    auto splits = ListSplits(rows, nprobe);
+    bool list_major = ivf_cfg.batch_search_nq.value() > 0 && rows > 1 && kScansListByList<T>;
+    auto filter_probe_threshold = ivf_cfg.filter_probe_threshold.value();
+    bool filtered = kScansListByList<T> && !bitset.empty() && filter_probe_threshold < 1.0f &&
+                    bitset.count() >= filter_probe_threshold * bitset.size();
+    // the per query search below takes neither of the scan options, a search with one goes across the lists
+    ScanOptions opts;
+    opts.probe_ratio = ivf_cfg.probe_ratio.value();
+    if constexpr (std::is_same<T, faiss::IndexIVFPQ>::value) {
+        opts.polysemous_ht = static_cast<const IvfPqConfig&>(cfg).polysemous_ht.value();
+    }
+    bool preassigned = kScansListByList<T> && (opts.polysemous_ht > 0 || opts.probe_ratio > 0.0f);
+    // the lists of a cancelled search are cut short and its queries skipped, the search then fails
+    auto cancellation = ivf_cfg.cancellation.get();
+    CancellationToken::Scope scope(cancellation);
     try {
-        std::vector<folly::Future<folly::Unit>> futs;
-        futs.reserve(rows);
-        for (int i = 0; i < rows; ++i) {
-            futs.emplace_back(search_pool_->push([&, index = i] {
+        if (filtered) {
+            SearchFiltered((const float*)data, rows, k, nprobe, is_cosine, distances, ids, bitset, opts);
+        } else if (splits > 1 || (preassigned && !list_major)) {
+            SearchAcrossLists((const float*)data, rows, k, nprobe, splits, is_cosine, distances, ids, bitset, opts);
+        } else if (list_major) {
+            // at most one batch per search thread, so that small batches still use the threads the search may use
+            int64_t threads = std::max<int64_t>(1, search_pool_->concurrency());
+            int64_t batch = std::min<int64_t>(ivf_cfg.batch_search_nq.value(), (rows + threads - 1) / threads);
+            search_pool_->parallel_for(0, (rows + batch - 1) / batch, 1, [&](int64_t b) {
+                ThreadPool::ScopedOmpSetter setter(1);
+                auto begin = b * batch;
+                auto end = std::min<int64_t>(rows, begin + batch);
+                SearchListMajor((const float*)data + begin * dim, end - begin, k, nprobe, is_cosine,
+                                distances + begin * k, ids + begin * k, bitset, opts);
+            });
+        } else {
+            const auto index_type = Type();
+            const auto& query_metrics = GetQueryMetrics(index_type);
+            auto sample_rate = ivf_cfg.trace_sample_rate.value();
+            search_pool_->parallel_for(0, rows, 1, [&](int64_t index) {
+                if (CancellationToken::CurrentCancelled()) {
+                    return;
+                }
                 ThreadPool::ScopedOmpSetter setter(1);
+                QueryStats::Current().Reset();
+                QueryTraceScope trace(index_type, sample_rate, index);
                 auto offset = k * index;
                 std::unique_ptr<float[]> copied_query = nullptr;
                 if constexpr (std::is_same<T, faiss::IndexBinaryIVF>::value) {
@@ -413,17 +1650,7 @@ IvfIndexNode<T>::Search(const DataSet& dataset, const Config& cfg, const BitsetV
                     if (is_cosine) {
                         copied_query = CopyAndNormalizeFloatVec(cur_query, dim);
                         cur_query = copied_query.get();
-
-                        // temporary solution to fix IVF_FLAT cosine
-                        if (!normalized_) {
-                            std::lock_guard<std::mutex> lock(normalize_mtx_);
-                            if (!normalized_) {
-                                faiss::IndexIVFFlat* ivf_index = static_cast<faiss::IndexIVFFlat*>(index_.get());
-                                size_t nb = ivf_index->arranged_codes.size() / ivf_index->code_size;
-                                NormalizeVecs((float*)(ivf_index->arranged_codes.data()), nb, dim);
-                                normalized_ = true;
-                            }
-                        }
+                        NormalizeCodesOnce();
                     }
                     index_->search_without_codes_thread_safe(1, cur_query, k, distances + offset, ids + offset, nprobe,
                                                              0, bitset);
@@ -435,7 +1662,23 @@ IvfIndexNode<T>::Search(const DataSet& dataset, const Config& cfg, const BitsetV
                         cur_query = copied_query.get();
                     }
                     index_->search_thread_safe(1, cur_query, k, distances + offset, ids + offset, nprobe,
-                                               scann_cfg.reorder_k.value(), bitset);
+                                               scann_cfg.reorder_k.value(), scann_cfg.reorder_spread.value(), bitset);
+                } else if constexpr (std::is_same<T, faiss::IndexIVFPQFastScan>::value) {
+                    auto cur_query = (const float*)data + index * dim;
+                    if (is_cosine) {
+                        copied_query = CopyAndNormalizeFloatVec(cur_query, dim);
+                        cur_query = copied_query.get();
+                    }
+                    index_->search_thread_safe(1, cur_query, k, distances + offset, ids + offset, nprobe, bitset);
+                } else if constexpr (std::is_same<T, faiss::IndexIVFRaBitQ>::value) {
+                    auto cur_query = (const float*)data + index * dim;
+                    const IvfRaBitQConfig& rabitq_cfg = static_cast<const IvfRaBitQConfig&>(cfg);
+                    if (is_cosine) {
+                        copied_query = CopyAndNormalizeFloatVec(cur_query, dim);
+                        cur_query = copied_query.get();
+                    }
+                    index_->search_refined_thread_safe(1, cur_query, k, distances + offset, ids + offset, nprobe,
+                                                       rabitq_cfg.refine_k.value(), bitset);
                 } else {
                     auto cur_query = (const float*)data + index * dim;
                     if (is_cosine) {
@@ -444,19 +1687,20 @@ IvfIndexNode<T>::Search(const DataSet& dataset, const Config& cfg, const BitsetV
                     }
                     index_->search_thread_safe(1, cur_query, k, distances + offset, ids + offset, nprobe, 0, bitset);
                 }
-            }));
-        }
-        for (auto& fut : futs) {
-            fut.wait();
+                query_metrics.Observe(QueryStats::Current());
+            });
         }
     } catch (const std::exception& e) {
-        delete[] ids;
-        delete[] distances;
+        buffers.Free();
         LOG_KNOWHERE_WARNING_ << "faiss inner error: " << e.what();
         return expected<DataSetPtr>::Err(Status::faiss_inner_error, e.what());
     }
+    if (cancellation != nullptr && cancellation->IsCancelled()) {
+        buffers.Free();
+        return expected<DataSetPtr>::Err(Status::search_cancelled, "search cancelled");
+    }
 
-    auto res = GenResultDataSet(rows, k, ids, distances);
+    auto res = buffers.ToDataSet(rows, k);
     return res;
 }
 
@@ -472,6 +1716,13 @@ IvfIndexNode<T>::RangeSearch(const DataSet& dataset, const Config& cfg, const Bi
         expected<DataSetPtr>::Err(Status::index_not_trained, "index not trained");
     }
 
+    if constexpr (std::is_same<T, faiss::IndexIVFPQFastScan>::value) {
+        if (index_->bbs != 32) {
+            LOG_KNOWHERE_ERROR_ << "range search of IVF_PQ_FASTSCAN requires bbs 32, got " << index_->bbs;
+            return expected<DataSetPtr>::Err(Status::not_implemented, "range search requires bbs 32");
+        }
+    }
+
     auto nq = dataset.GetRows();
     auto xq = dataset.GetTensor();
     auto dim = dataset.GetDim();
@@ -486,81 +1737,118 @@ IvfIndexNode<T>::RangeSearch(const DataSet& dataset, const Config& cfg, const Bi
     int64_t* ids = nullptr;
     float* distances = nullptr;
     size_t* lims = nullptr;
+    bool owned = true;
 
-    std::vector<std::vector<int64_t>> result_id_array(nq);
-    std::vector<std::vector<float>> result_dist_array(nq);
-    std::vector<size_t> result_size(nq);
-    std::vector<size_t> result_lims(nq + 1);
+    RangeSearchResultBuilder results(nq, ivf_cfg.max_results.value(), is_ip);
+    bool do_filter = range_filter != defaultRangeFilter;
 
+    // the lists are probed by centroid distance until the first one out of reach, see IndexIVF::list_radius, or
+    // without results, range_nprobe bounds them
+    auto range_nprobe = ivf_cfg.range_nprobe.value();
+    int64_t nprobe = range_nprobe > 0 ? range_nprobe : std::numeric_limits<int64_t>::max();
+    auto splits = ListSplits(nq, nprobe);
+    // the lists of a cancelled search are cut short and its queries skipped, the search then fails
+    auto cancellation = ivf_cfg.cancellation.get();
+    CancellationToken::Scope scope(cancellation);
     try {
-        std::vector<folly::Future<folly::Unit>> futs;
-        futs.reserve(nq);
-        for (int i = 0; i < nq; ++i) {
-            futs.emplace_back(search_pool_->push([&, index = i] {
+        if (splits > 1) {
+            std::vector<std::vector<int64_t>> result_id_array(nq);
+            std::vector<std::vector<float>> result_dist_array(nq);
+            RangeSearchAcrossLists((const float*)xq, nq, radius, nprobe, splits, is_cosine, result_dist_array,
+                                   result_id_array, bitset);
+            for (int i = 0; i < nq; ++i) {
+                results.Query(i).Append(result_dist_array[i].data(), result_id_array[i].data(),
+                                        result_dist_array[i].size(), do_filter, is_ip, radius, range_filter);
+            }
+        } else {
+            search_pool_->parallel_for(0, nq, 1, [&](int64_t index) {
+                if (CancellationToken::CurrentCancelled()) {
+                    return;
+                }
                 ThreadPool::ScopedOmpSetter setter(1);
                 faiss::RangeSearchResult res(1);
                 std::unique_ptr<float[]> copied_query = nullptr;
                 if constexpr (std::is_same<T, faiss::IndexBinaryIVF>::value) {
                     auto cur_data = (const uint8_t*)xq + index * dim / 8;
-                    index_->range_search_thread_safe(1, cur_data, radius, &res, index_->nlist, bitset);
+                    index_->range_search_thread_safe(1, cur_data, radius, &res, nprobe, bitset);
                 } else if constexpr (std::is_same<T, faiss::IndexIVFFlat>::value) {
                     auto cur_query = (const float*)xq + index * dim;
                     if (is_cosine) {
                         copied_query = CopyAndNormalizeFloatVec(cur_query, dim);
                         cur_query = copied_query.get();
-
-                        // temporary solution to fix IVF_FLAT cosine
-                        if (!normalized_) {
-                            std::lock_guard<std::mutex> lock(normalize_mtx_);
-                            if (!normalized_) {
-                                faiss::IndexIVFFlat* ivf_index = static_cast<faiss::IndexIVFFlat*>(index_.get());
-                                size_t nb = ivf_index->arranged_codes.size() / ivf_index->code_size;
-                                NormalizeVecs((float*)(ivf_index->arranged_codes.data()), nb, dim);
-                                normalized_ = true;
-                            }
-                        }
+                        NormalizeCodesOnce();
                     }
-                    index_->range_search_without_codes_thread_safe(1, cur_query, radius, &res, index_->nlist, 0,
-                                                                   bitset);
+                    index_->range_search_without_codes_thread_safe(1, cur_query, radius, &res, nprobe, 0, bitset);
                 } else if constexpr (std::is_same<T, faiss::IndexScaNN>::value) {
                     auto cur_query = (const float*)xq + index * dim;
                     if (is_cosine) {
                         copied_query = CopyAndNormalizeFloatVec(cur_query, dim);
                         cur_query = copied_query.get();
                     }
-                    index_->range_search_thread_safe(1, cur_query, radius, &res, bitset);
+                    index_->range_search_thread_safe(1, cur_query, radius, &res, nprobe, bitset);
+                } else if constexpr (std::is_same<T, faiss::IndexIVFPQFastScan>::value) {
+                    auto cur_query = (const float*)xq + index * dim;
+                    if (is_cosine) {
+                        copied_query = CopyAndNormalizeFloatVec(cur_query, dim);
+                        cur_query = copied_query.get();
+                    }
+                    index_->range_search_thread_safe(1, cur_query, radius, &res, nprobe, bitset);
+                } else if constexpr (std::is_same<T, faiss::IndexIVFRaBitQ>::value) {
+                    auto cur_query = (const float*)xq + index * dim;
+                    if (is_cosine) {
+                        copied_query = CopyAndNormalizeFloatVec(cur_query, dim);
+                        cur_query = copied_query.get();
+                    }
+                    index_->range_search_refined_thread_safe(1, cur_query, radius, &res, nprobe, bitset);
                 } else {
                     auto cur_query = (const float*)xq + index * dim;
                     if (is_cosine) {
                         copied_query = CopyAndNormalizeFloatVec(cur_query, dim);
                         cur_query = copied_query.get();
                     }
-                    index_->range_search_thread_safe(1, cur_query, radius, &res, index_->nlist, 0, bitset);
+                    index_->range_search_thread_safe(1, cur_query, radius, &res, nprobe, 0, bitset);
                 }
-                auto elem_cnt = res.lims[1];
-                result_dist_array[index].resize(elem_cnt);
-                result_id_array[index].resize(elem_cnt);
-                result_size[index] = elem_cnt;
-                for (size_t j = 0; j < elem_cnt; j++) {
-                    result_dist_array[index][j] = res.distances[j];
-                    result_id_array[index][j] = res.labels[j];
-                }
-                if (range_filter != defaultRangeFilter) {
-                    FilterRangeSearchResultForOneNq(result_dist_array[index], result_id_array[index], is_ip, radius,
-                                                    range_filter);
-                }
-            }));
+                results.Query(index).Append(res.distances, res.labels, res.lims[1], do_filter, is_ip, radius,
+                                            range_filter);
+            });
         }
-        for (auto& fut : futs) {
-            fut.wait();
+        if (cancellation != nullptr && cancellation->IsCancelled()) {
+            return expected<DataSetPtr>::Err(Status::search_cancelled, "range search cancelled");
         }
-        GetRangeSearchResult(result_dist_array, result_id_array, is_ip, nq, radius, range_filter, distances, ids, lims);
+        owned = results.Build(ivf_cfg, distances, ids, lims);
     } catch (const std::exception& e) {
         LOG_KNOWHERE_WARNING_ << "faiss inner error: " << e.what();
         return expected<DataSetPtr>::Err(Status::faiss_inner_error, e.what());
     }
 
-    return GenResultDataSet(nq, ids, distances, lims);
+    auto res = GenResultDataSet(nq, ids, distances, lims);
+    res->SetIsOwner(owned);
+    return res;
+}
+
+template <typename T>
+expected<std::vector<IndexIteratorPtr>>
+IvfIndexNode<T>::AnnIterator(const DataSet& dataset, const Config& cfg, const BitsetView& bitset) const {
+    if constexpr (kScansListByList<T>) {
+        if (!this->index_) {
+            LOG_KNOWHERE_WARNING_ << "iterator on empty index";
+            return expected<std::vector<IndexIteratorPtr>>::Err(Status::empty_index, "index not loaded");
+        }
+        const IvfConfig& ivf_cfg = static_cast<const IvfConfig&>(cfg);
+        bool is_cosine = IsMetricType(ivf_cfg.metric_type.value(), knowhere::metric::COSINE);
+        if (is_cosine) {
+            NormalizeCodesOnce();
+        }
+        auto xq = static_cast<const float*>(dataset.GetTensor());
+        auto dim = dataset.GetDim();
+        std::vector<IndexIteratorPtr> iterators(dataset.GetRows());
+        for (size_t i = 0; i < iterators.size(); ++i) {
+            iterators[i] = std::make_shared<IvfIterator<T>>(index_.get(), xq + i * dim, ivf_cfg.nprobe.value(),
+                                                            bitset, is_cosine);
+        }
+        return iterators;
+    }
+    return expected<std::vector<IndexIteratorPtr>>::Err(Status::not_implemented, "no iterator for " + Type());
 }
 
 template <typename T>
@@ -580,12 +1868,9 @@ IvfIndexNode<T>::GetVectorByIds(const DataSet& dataset) const {
         uint8_t* data = nullptr;
         try {
             data = new uint8_t[dim * rows / 8];
-            index_->make_direct_map(true);
-            for (int64_t i = 0; i < rows; i++) {
-                int64_t id = ids[i];
-                assert(id >= 0 && id < index_->ntotal);
-                index_->reconstruct(id, data + i * dim / 8);
-            }
+            GatherVectors(ids, rows, dim / 8, data, [this](int64_t list_no, int64_t offset, uint8_t* row) {
+                index_->reconstruct_from_offset(list_no, offset, row);
+            });
             return GenResultDataSet(rows, dim, data);
         } catch (const std::exception& e) {
             std::unique_ptr<uint8_t[]> auto_del(data);
@@ -597,6 +1882,25 @@ IvfIndexNode<T>::GetVectorByIds(const DataSet& dataset) const {
         auto rows = dataset.GetRows();
         auto ids = dataset.GetIds();
 
+        float* data = nullptr;
+        try {
+            data = new float[dim * rows];
+            GatherVectors(ids, rows, dim * sizeof(float), reinterpret_cast<uint8_t*>(data),
+                          [this](int64_t list_no, int64_t offset, uint8_t* row) {
+                              index_->reconstruct_from_offset_without_codes(list_no, offset,
+                                                                            reinterpret_cast<float*>(row));
+                          });
+            return GenResultDataSet(rows, dim, data);
+        } catch (const std::exception& e) {
+            std::unique_ptr<float[]> auto_del(data);
+            LOG_KNOWHERE_WARNING_ << "faiss inner error: " << e.what();
+            return expected<DataSetPtr>::Err(Status::faiss_inner_error, e.what());
+        }
+    } else if constexpr (std::is_same<T, faiss::IndexIVFFlatCC>::value) {
+        auto dim = Dim();
+        auto rows = dataset.GetRows();
+        auto ids = dataset.GetIds();
+
         float* data = nullptr;
         try {
             data = new float[dim * rows];
@@ -604,7 +1908,7 @@ IvfIndexNode<T>::GetVectorByIds(const DataSet& dataset) const {
             for (int64_t i = 0; i < rows; i++) {
                 int64_t id = ids[i];
                 assert(id >= 0 && id < index_->ntotal);
-                index_->reconstruct_without_codes(id, data + i * dim);
+                index_->reconstruct(id, data + i * dim);
             }
             return GenResultDataSet(rows, dim, data);
         } catch (const std::exception& e) {
@@ -612,7 +1916,7 @@ IvfIndexNode<T>::GetVectorByIds(const DataSet& dataset) const {
             LOG_KNOWHERE_WARNING_ << "faiss inner error: " << e.what();
             return expected<DataSetPtr>::Err(Status::faiss_inner_error, e.what());
         }
-    } else if constexpr (std::is_same<T, faiss::IndexIVFFlatCC>::value) {
+    } else if constexpr (std::is_same<T, faiss::IndexScaNN>::value) {
         auto dim = Dim();
         auto rows = dataset.GetRows();
         auto ids = dataset.GetIds();
@@ -620,7 +1924,6 @@ IvfIndexNode<T>::GetVectorByIds(const DataSet& dataset) const {
         float* data = nullptr;
         try {
             data = new float[dim * rows];
-            index_->make_direct_map(true);
             for (int64_t i = 0; i < rows; i++) {
                 int64_t id = ids[i];
                 assert(id >= 0 && id < index_->ntotal);
@@ -632,7 +1935,10 @@ IvfIndexNode<T>::GetVectorByIds(const DataSet& dataset) const {
             LOG_KNOWHERE_WARNING_ << "faiss inner error: " << e.what();
             return expected<DataSetPtr>::Err(Status::faiss_inner_error, e.what());
         }
-    } else if constexpr (std::is_same<T, faiss::IndexScaNN>::value) {
+    } else if constexpr (std::is_same<T, faiss::IndexIVFRaBitQ>::value) {
+        if (!index_->with_raw_data()) {
+            return expected<DataSetPtr>::Err(Status::not_implemented, "IVF_RABITQ without a FLAT refine_type");
+        }
         auto dim = Dim();
         auto rows = dataset.GetRows();
         auto ids = dataset.GetIds();
@@ -643,7 +1949,7 @@ IvfIndexNode<T>::GetVectorByIds(const DataSet& dataset) const {
             for (int64_t i = 0; i < rows; i++) {
                 int64_t id = ids[i];
                 assert(id >= 0 && id < index_->ntotal);
-                index_->reconstruct(id, data + i * dim);
+                index_->refine_index->reconstruct(id, data + i * dim);
             }
             return GenResultDataSet(rows, dim, data);
         } catch (const std::exception& e) {
@@ -659,18 +1965,24 @@ IvfIndexNode<T>::GetVectorByIds(const DataSet& dataset) const {
 template <>
 expected<DataSetPtr>
 IvfIndexNode<faiss::IndexIVFFlat>::GetIndexMeta(const Config& config) const {
+    if (static_cast<const IvfConfig&>(config).list_stats.value()) {
+        return GetListStats();
+    }
     if (!index_) {
         LOG_KNOWHERE_WARNING_ << "get index meta on empty index";
         expected<DataSetPtr>::Err(Status::empty_index, "index not loaded");
     }
 
     auto ivf_index = dynamic_cast<faiss::IndexIVF*>(index_.get());
-    auto ivf_quantizer = dynamic_cast<faiss::IndexFlat*>(ivf_index->quantizer);
 
     int64_t dim = ivf_index->d;
     int64_t nlist = ivf_index->nlist;
     int64_t ntotal = ivf_index->ntotal;
 
+    // the quantizer is a flat index or an HNSW graph over its own flat storage
+    std::vector<float> centroids(nlist * dim);
+    ivf_index->quantizer->reconstruct_n(0, nlist, centroids.data());
+
     feder::ivfflat::IVFFlatMeta meta(nlist, dim, ntotal);
     std::unordered_set<int64_t> id_set;
 
@@ -684,7 +1996,7 @@ IvfIndexNode<faiss::IndexIVFFlat>::GetIndexMeta(const Config& config) const {
         auto node_id_codes = sids->get();
 
         // centroid vector
-        auto centroid_vec = ivf_quantizer->get_xb() + i * dim;
+        auto centroid_vec = centroids.data() + i * dim;
 
         meta.AddCluster(i, node_id_codes, node_num, centroid_vec, dim);
     }
@@ -695,20 +2007,24 @@ IvfIndexNode<faiss::IndexIVFFlat>::GetIndexMeta(const Config& config) const {
     return GenResultDataSet(json_meta.dump(), json_id_set.dump());
 }
 
+template <typename T>
+void
+IvfIndexNode<T>::WriteIndex(faiss::IOWriter* writer) const {
+    if constexpr (std::is_same<T, faiss::IndexBinaryIVF>::value) {
+        faiss::write_index_binary(index_.get(), writer);
+    } else if constexpr (std::is_same<T, faiss::IndexIVFFlat>::value) {
+        faiss::write_index_nm(index_.get(), writer);
+    } else {
+        faiss::write_index(index_.get(), writer);
+    }
+}
+
 template <typename T>
 Status
 IvfIndexNode<T>::Serialize(BinarySet& binset) const {
     try {
-        MemoryIOWriter writer;
-        if constexpr (std::is_same<T, faiss::IndexBinaryIVF>::value) {
-            faiss::write_index_binary(index_.get(), &writer);
-        } else if constexpr (std::is_same<T, faiss::IndexIVFFlat>::value) {
-            faiss::write_index_nm(index_.get(), &writer);
-        } else {
-            faiss::write_index(index_.get(), &writer);
-        }
-        std::shared_ptr<uint8_t[]> data(writer.data_);
-        binset.Append(Type(), data, writer.rp);
+        auto [data, size] = SerializeToMemory([&](MemoryIOWriter& writer) { WriteIndex(&writer); });
+        binset.Append(Type(), data, size);
         return Status::success;
     } catch (const std::exception& e) {
         LOG_KNOWHERE_WARNING_ << "faiss inner error: " << e.what();
@@ -716,6 +2032,51 @@ IvfIndexNode<T>::Serialize(BinarySet& binset) const {
     }
 }
 
+template <typename T>
+Status
+IvfIndexNode<T>::SerializeToFile(SectionWriter& writer) const {
+    RETURN_IF_ERROR(writer.Begin(Type()));
+    try {
+        SectionIOWriter section(writer);
+        WriteIndex(&section);
+    } catch (const std::exception& e) {
+        LOG_KNOWHERE_WARNING_ << "faiss inner error: " << e.what();
+        return Status::faiss_inner_error;
+    }
+    return writer.End();
+}
+
+// ScaNN indexes serialized before IndexScaNN had a format of its own are read back as an IndexRefineFlat.
+template <typename T>
+T*
+UpgradeReadIndex(faiss::Index* index) {
+    if constexpr (std::is_same<T, faiss::IndexScaNN>::value) {
+        auto refine = dynamic_cast<faiss::IndexRefineFlat*>(index);
+        if (refine != nullptr && dynamic_cast<faiss::IndexScaNN*>(index) == nullptr) {
+            auto scann = new faiss::IndexScaNN(refine->base_index, refine->refine_index);
+            scann->own_fields = true;
+            scann->own_refine_index = true;
+            refine->own_fields = false;
+            refine->own_refine_index = false;
+            delete refine;
+            return scann;
+        }
+    }
+    return static_cast<T*>(index);
+}
+
+// The IVF_PQ residual tables are not serialized, the reader recomputes them unless the config leaves them out.
+template <typename T>
+int
+ReadFlags(const Config& config) {
+    if constexpr (std::is_same<T, faiss::IndexIVFPQ>::value) {
+        if (!static_cast<const IvfPqConfig&>(config).precompute_table.value()) {
+            return faiss::IO_FLAG_SKIP_PRECOMPUTED_TABLE;
+        }
+    }
+    return 0;
+}
+
 template <typename T>
 Status
 IvfIndexNode<T>::Deserialize(const BinarySet& binset, const Config& config) {
@@ -735,8 +2096,11 @@ IvfIndexNode<T>::Deserialize(const BinarySet& binset, const Config& config) {
         if constexpr (std::is_same<T, faiss::IndexBinaryIVF>::value) {
             index_.reset(static_cast<T*>(faiss::read_index_binary(&reader)));
         } else {
-            index_.reset(static_cast<T*>(faiss::read_index(&reader)));
+            index_.reset(UpgradeReadIndex<T>(faiss::read_index(&reader, ReadFlags<T>(config))));
         }
+        RETURN_IF_ERROR(CheckLoadedQuantizer());
+        PackInvertedLists(config);
+        ComputeListRadius(config);
     } catch (const std::exception& e) {
         LOG_KNOWHERE_WARNING_ << "faiss inner error: " << e.what();
         return Status::faiss_inner_error;
@@ -749,16 +2113,23 @@ Status
 IvfIndexNode<T>::DeserializeFromFile(const std::string& filename, const Config& config) {
     auto cfg = static_cast<const knowhere::BaseConfig&>(config);
 
-    int io_flags = 0;
+    int io_flags = ReadFlags<T>(config);
     if (cfg.enable_mmap.value()) {
         io_flags |= faiss::IO_FLAG_MMAP;
     }
     try {
+        auto reader = OpenFaissFile(filename, cfg.file_offset);
         if constexpr (std::is_same<T, faiss::IndexBinaryIVF>::value) {
-            index_.reset(static_cast<T*>(faiss::read_index_binary(filename.data(), io_flags)));
+            index_.reset(static_cast<T*>(faiss::read_index_binary(reader.get(), io_flags)));
         } else {
-            index_.reset(static_cast<T*>(faiss::read_index(filename.data(), io_flags)));
+            index_.reset(UpgradeReadIndex<T>(faiss::read_index(reader.get(), io_flags)));
         }
+        RETURN_IF_ERROR(CheckLoadedQuantizer());
+        // mmapped lists are already contiguous in the file
+        if (!cfg.enable_mmap.value()) {
+            PackInvertedLists(config);
+        }
+        ComputeListRadius(config);
     } catch (const std::exception& e) {
         LOG_KNOWHERE_WARNING_ << "faiss inner error: " << e.what();
         return Status::faiss_inner_error;
@@ -790,7 +2161,9 @@ IvfIndexNode<faiss::IndexIVFFlat>::Deserialize(const BinarySet& binset, const Co
             return Status::invalid_binary_set;
         }
         size_t nb = binary->size / index_->invlists->code_size;
+        index_->column_blocked = static_cast<const IvfFlatConfig&>(config).column_blocked.value();
         index_->arrange_codes(nb, (const float*)(binary->data.get()));
+        ComputeListRadius(config);
     } catch (const std::exception& e) {
         LOG_KNOWHERE_WARNING_ << "faiss inner error: " << e.what();
         return Status::faiss_inner_error;
@@ -806,10 +2179,12 @@ KNOWHERE_REGISTER_GLOBAL(BIN_IVF_FLAT, [](const Object& object) {
     return Index<IvfIndexNode<faiss::IndexBinaryIVF>>::Create(object);
 });
 
-KNOWHERE_REGISTER_GLOBAL(IVFFLAT,
-                         [](const Object& object) { return Index<IvfIndexNode<faiss::IndexIVFFlat>>::Create(object); });
-KNOWHERE_REGISTER_GLOBAL(IVF_FLAT,
-                         [](const Object& object) { return Index<IvfIndexNode<faiss::IndexIVFFlat>>::Create(object); });
+KNOWHERE_REGISTER_GLOBAL(IVFFLAT, [](const Object& object) {
+    return Index<IndexNodePreTransformWrapper>::Create(std::make_unique<IvfIndexNode<faiss::IndexIVFFlat>>(object));
+});
+KNOWHERE_REGISTER_GLOBAL(IVF_FLAT, [](const Object& object) {
+    return Index<IndexNodePreTransformWrapper>::Create(std::make_unique<IvfIndexNode<faiss::IndexIVFFlat>>(object));
+});
 KNOWHERE_REGISTER_GLOBAL(IVFFLATCC, [](const Object& object) {
     return Index<IvfIndexNode<faiss::IndexIVFFlatCC>>::Create(object);
 });
@@ -818,16 +2193,40 @@ KNOWHERE_REGISTER_GLOBAL(IVF_FLAT_CC, [](const Object& object) {
 });
 KNOWHERE_REGISTER_GLOBAL(SCANN,
                          [](const Object& object) { return Index<IvfIndexNode<faiss::IndexScaNN>>::Create(object); });
-KNOWHERE_REGISTER_GLOBAL(IVFPQ,
-                         [](const Object& object) { return Index<IvfIndexNode<faiss::IndexIVFPQ>>::Create(object); });
-KNOWHERE_REGISTER_GLOBAL(IVF_PQ,
-                         [](const Object& object) { return Index<IvfIndexNode<faiss::IndexIVFPQ>>::Create(object); });
+KNOWHERE_REGISTER_GLOBAL(IVFPQ, [](const Object& object) {
+    return Index<IndexNodeRefineWrapper>::Create(
+        std::make_unique<IndexNodePreTransformWrapper>(std::make_unique<IvfIndexNode<faiss::IndexIVFPQ>>(object)));
+});
+KNOWHERE_REGISTER_GLOBAL(IVF_PQ, [](const Object& object) {
+    return Index<IndexNodeRefineWrapper>::Create(
+        std::make_unique<IndexNodePreTransformWrapper>(std::make_unique<IvfIndexNode<faiss::IndexIVFPQ>>(object)));
+});
+KNOWHERE_REGISTER_GLOBAL(IVF_PQ_FASTSCAN, [](const Object& object) {
+    return Index<IvfIndexNode<faiss::IndexIVFPQFastScan>>::Create(object);
+});
 
 KNOWHERE_REGISTER_GLOBAL(IVFSQ, [](const Object& object) {
-    return Index<IvfIndexNode<faiss::IndexIVFScalarQuantizer>>::Create(object);
+    return Index<IndexNodeRefineWrapper>::Create(std::make_unique<IndexNodePreTransformWrapper>(
+        std::make_unique<IvfIndexNode<faiss::IndexIVFScalarQuantizer>>(object)));
 });
 KNOWHERE_REGISTER_GLOBAL(IVF_SQ8, [](const Object& object) {
-    return Index<IvfIndexNode<faiss::IndexIVFScalarQuantizer>>::Create(object);
+    return Index<IndexNodeRefineWrapper>::Create(std::make_unique<IndexNodePreTransformWrapper>(
+        std::make_unique<IvfIndexNode<faiss::IndexIVFScalarQuantizer>>(object)));
+});
+KNOWHERE_REGISTER_GLOBAL(IVF_SQ4, [](const Object& object) {
+    return Index<IndexNodeRefineWrapper>::Create(std::make_unique<IndexNodePreTransformWrapper>(
+        std::make_unique<IvfIndexNode<faiss::IndexIVFScalarQuantizer>>(object, faiss::QuantizerType::QT_4bit)));
+});
+KNOWHERE_REGISTER_GLOBAL(IVF_SQ6, [](const Object& object) {
+    return Index<IndexNodeRefineWrapper>::Create(std::make_unique<IndexNodePreTransformWrapper>(
+        std::make_unique<IvfIndexNode<faiss::IndexIVFScalarQuantizer>>(object, faiss::QuantizerType::QT_6bit)));
+});
+KNOWHERE_REGISTER_GLOBAL(IVF_SQ_FP16, [](const Object& object) {
+    return Index<IndexNodeRefineWrapper>::Create(std::make_unique<IndexNodePreTransformWrapper>(
+        std::make_unique<IvfIndexNode<faiss::IndexIVFScalarQuantizer>>(object, faiss::QuantizerType::QT_fp16)));
+});
+KNOWHERE_REGISTER_GLOBAL(IVF_RABITQ, [](const Object& object) {
+    return Index<IvfIndexNode<faiss::IndexIVFRaBitQ>>::Create(object);
 });
 
 }  // namespace knowhere
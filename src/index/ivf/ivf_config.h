@@ -12,28 +12,165 @@
 #ifndef IVF_CONFIG_H
 #define IVF_CONFIG_H
 
+#include "knowhere/comp/knowhere_config.h"
 #include "knowhere/config.h"
+#include "knowhere/utils.h"
 
 namespace knowhere {
+
+inline constexpr const char* kRefineTypeNone = "NONE";
+inline constexpr const char* kRefineTypeFlat = "FLAT";
+inline constexpr const char* kRefineTypeSQ8 = "SQ8";
+inline constexpr const char* kRefineTypeFP16 = "FP16";
+
+inline constexpr const char* kQuantizerTypeFlat = "FLAT";
+inline constexpr const char* kQuantizerTypeHnsw = "HNSW";
+
 class IvfConfig : public BaseConfig {
  public:
     CFG_INT nlist;
     CFG_INT nprobe;
+    CFG_INT range_nprobe;
+    CFG_INT batch_search_nq;
+    CFG_BOOL invlists_arena;
+    CFG_BOOL huge_pages;
+    CFG_INT max_points_per_centroid;
+    CFG_STRING centroids_file;
+    CFG_STRING quantizer_type;
+    CFG_INT quantizer_m;
+    CFG_INT quantizer_ef_construction;
+    CFG_INT quantizer_ef;
+    CFG_BOOL list_pruning;
+    CFG_FLOAT list_split_ratio;
+    CFG_BOOL list_stats;
+    CFG_FLOAT filter_probe_threshold;
+    CFG_FLOAT probe_ratio;
     KNOHWERE_DECLARE_CONFIG(IvfConfig) {
         KNOWHERE_CONFIG_DECLARE_FIELD(nlist)
             .set_default(128)
             .description("number of inverted lists.")
             .for_train()
-            .set_range(1, 65536);
+            .set_range(1, 1 << 20);
         KNOWHERE_CONFIG_DECLARE_FIELD(nprobe)
             .set_default(8)
             .description("number of probes at query time.")
             .for_search()
             .set_range(1, 65536);
+        KNOWHERE_CONFIG_DECLARE_FIELD(range_nprobe)
+            .set_default(0)
+            .description("max lists a range search probes by centroid distance, 0 probes them until the first one out "
+                         "of reach of the radius by the list radii of list_pruning, or else without results.")
+            .for_range_search()
+            .set_range(0, 1 << 20);
+        KNOWHERE_CONFIG_DECLARE_FIELD(batch_search_nq)
+            .set_default(0)
+            .description("max queries assigned together and scanned list by list, 0 searches query by query.")
+            .for_search()
+            .set_range(0, 65536);
+        KNOWHERE_CONFIG_DECLARE_FIELD(invlists_arena)
+            .set_default(false)
+            .description("pack the inverted lists of a loaded IVF_SQ8 or IVF_PQ into one aligned arena.")
+            .for_deserialize()
+            .for_deserialize_from_file();
+        KNOWHERE_CONFIG_DECLARE_FIELD(huge_pages)
+            .set_default(false)
+            .description("back the inverted lists arena with 2MB huge pages.")
+            .for_deserialize()
+            .for_deserialize_from_file();
+        KNOWHERE_CONFIG_DECLARE_FIELD(max_points_per_centroid)
+            .set_default(256)
+            .description("the k-means of the inverted lists trains on at most nlist times this many sampled rows.")
+            .for_train()
+            .set_range(1, 65536);
+        KNOWHERE_CONFIG_DECLARE_FIELD(centroids_file)
+            .set_default("")
+            .description("nlist * dim float32 centroids, e.g. of a previous segment, the k-means starts from.")
+            .for_train();
+        KNOWHERE_CONFIG_DECLARE_FIELD(quantizer_type)
+            .set_default(kQuantizerTypeFlat)
+            .description("index the queries and rows are assigned to lists with, FLAT/HNSW, HNSW pays off for large "
+                         "nlist.")
+            .for_train();
+        KNOWHERE_CONFIG_DECLARE_FIELD(quantizer_m)
+            .set_default(32)
+            .description("hnsw M of the HNSW quantizer.")
+            .for_train()
+            .set_range(2, 2048);
+        KNOWHERE_CONFIG_DECLARE_FIELD(quantizer_ef_construction)
+            .set_default(40)
+            .description("hnsw efConstruction of the HNSW quantizer.")
+            .for_train()
+            .set_range(1, std::numeric_limits<CFG_INT::value_type>::max());
+        KNOWHERE_CONFIG_DECLARE_FIELD(quantizer_ef)
+            .set_default(64)
+            .description("hnsw ef of the HNSW quantizer, raised to nprobe when lower, saved with the index.")
+            .for_train()
+            .set_range(1, std::numeric_limits<CFG_INT::value_type>::max());
+        KNOWHERE_CONFIG_DECLARE_FIELD(list_pruning)
+            .set_default(false)
+            .description("bound the IVF_FLAT, IVF_SQ8 and IVF_PQ lists by their largest residual norm, searches then "
+                         "skip the probed lists that can not improve the top k or hold a vector within the radius.")
+            .for_train()
+            .for_deserialize()
+            .for_deserialize_from_file();
+        KNOWHERE_CONFIG_DECLARE_FIELD(list_split_ratio)
+            .set_default(0.0f)
+            .description("split the IVF_FLAT, IVF_SQ8 and IVF_PQ lists the first add makes larger than this many "
+                         "times the mean list size into sub-centroids, 0 keeps nlist lists.")
+            .for_train()
+            .set_range(0.0f, std::numeric_limits<CFG_FLOAT::value_type>::max());
+        KNOWHERE_CONFIG_DECLARE_FIELD(list_stats)
+            .set_default(false)
+            .description("return the list size statistics instead of the feder meta.")
+            .for_feder();
+        KNOWHERE_CONFIG_DECLARE_FIELD(filter_probe_threshold)
+            .set_default(0.5f)
+            .description("the filtered out ratio from which a knn search probes by the vectors the filter keeps in "
+                         "the lists: the ones it empties are skipped, and the probes go on past nprobe until enough "
+                         "are scanned, 1 turns it off.")
+            .for_search()
+            .set_range(0.0f, 1.0f);
+        KNOWHERE_CONFIG_DECLARE_FIELD(probe_ratio)
+            .set_default(0.0f)
+            .description("a knn search of IVF_FLAT, IVF_SQ8 or IVF_PQ probes, of its nprobe nearest lists, only the "
+                         "ones whose centroid distance is within probe_ratio times the one of the nearest centroid, "
+                         "e.g. 1.5; 0 probes nprobe lists.")
+            .for_search()
+            .set_range(0.0f, std::numeric_limits<CFG_FLOAT::value_type>::max());
+    }
+
+    inline Status
+    CheckAndAdjustForBuild() override {
+        auto& type = quantizer_type.value();
+        if (strcasecmp(type.c_str(), kQuantizerTypeFlat) && strcasecmp(type.c_str(), kQuantizerTypeHnsw)) {
+            LOG_KNOWHERE_ERROR_ << "invalid quantizer_type " << type;
+            return Status::invalid_args;
+        }
+        if (list_split_ratio.value() != 0.0f && list_split_ratio.value() < 1.0f) {
+            LOG_KNOWHERE_ERROR_ << "list_split_ratio(" << list_split_ratio.value() << ") should be 0 or at least 1";
+            return Status::invalid_args;
+        }
+        // the centroids of the file replace the seeding of k-means++ and k-means||, which do not start from given ones
+        if (!centroids_file.value().empty() &&
+            KnowhereConfig::GetClusteringType() != KnowhereConfig::ClusteringType::K_MEANS) {
+            LOG_KNOWHERE_ERROR_ << "centroids_file can only be used with the K_MEANS clustering type";
+            return Status::invalid_args;
+        }
+        return Status::success;
     }
 };
 
-class IvfFlatConfig : public IvfConfig {};
+class IvfFlatConfig : public IvfConfig {
+ public:
+    CFG_BOOL column_blocked;
+    KNOHWERE_DECLARE_CONFIG(IvfFlatConfig) {
+        KNOWHERE_CONFIG_DECLARE_FIELD(column_blocked)
+            .set_default(false)
+            .description("lay the vectors of IVF_FLAT lists out in blocks of 16 interleaved per dimension.")
+            .for_train()
+            .for_deserialize();
+    }
+};
 
 class IvfFlatCcConfig : public IvfFlatConfig {
  public:
@@ -51,21 +188,120 @@ class IvfPqConfig : public IvfConfig {
  public:
     CFG_INT m;
     CFG_INT nbits;
+    CFG_BOOL precompute_table;
+    CFG_BOOL polysemous;
+    CFG_INT polysemous_ht;
     KNOHWERE_DECLARE_CONFIG(IvfPqConfig) {
         KNOWHERE_CONFIG_DECLARE_FIELD(m).description("m").set_default(4).for_train().set_range(1, 65536);
         KNOWHERE_CONFIG_DECLARE_FIELD(nbits).description("nbits").set_default(8).for_train().set_range(1, 64);
+        KNOWHERE_CONFIG_DECLARE_FIELD(precompute_table)
+            .set_default(true)
+            .description("keep the nlist * m * 2^nbits float L2 residual tables in memory, false computes the tables "
+                         "of the probed lists on the fly.")
+            .for_train()
+            .for_deserialize()
+            .for_deserialize_from_file();
+        KNOWHERE_CONFIG_DECLARE_FIELD(polysemous)
+            .set_default(false)
+            .description("order the centroids of every sub-quantizer so that the Hamming distance of two codes follows "
+                         "the distance of their vectors, which lets a search skip codes by polysemous_ht")
+            .for_train();
+        KNOWHERE_CONFIG_DECLARE_FIELD(polysemous_ht)
+            .set_default(0)
+            .description("the codes at a Hamming distance of polysemous_ht or more from the code of the query are "
+                         "skipped without computing their distance, 0 scans them all; for an index built with "
+                         "polysemous")
+            .for_search()
+            .set_range(0, 65536);
+    }
+
+    inline Status
+    CheckAndAdjustForBuild() override {
+        RETURN_IF_ERROR(IvfConfig::CheckAndAdjustForBuild());
+        // the training keeps a table of 2^nbits squared distances per thread
+        if (polysemous.value() && nbits.value() > 8) {
+            LOG_KNOWHERE_ERROR_ << "polysemous takes nbits(" << nbits.value() << ") of at most 8";
+            return Status::invalid_args;
+        }
+        return Status::success;
+    }
+};
+
+class IvfPqFastScanConfig : public IvfConfig {
+ public:
+    CFG_INT m;
+    CFG_INT bbs;
+    KNOHWERE_DECLARE_CONFIG(IvfPqFastScanConfig) {
+        KNOWHERE_CONFIG_DECLARE_FIELD(m)
+            .description("number of 4 bit sub-quantizers, 0 uses dim / 2")
+            .set_default(0)
+            .for_train()
+            .set_range(0, 65536);
+        KNOWHERE_CONFIG_DECLARE_FIELD(bbs)
+            .description("number of codes scanned together, a multiple of 32, range search requires 32")
+            .set_default(32)
+            .for_train()
+            .set_range(32, 1024);
+    }
+
+    inline Status
+    CheckAndAdjustForBuild() override {
+        RETURN_IF_ERROR(IvfConfig::CheckAndAdjustForBuild());
+        if (bbs.value() % 32 != 0) {
+            LOG_KNOWHERE_ERROR_ << "bbs(" << bbs.value() << ") should be a multiple of 32";
+            return Status::invalid_args;
+        }
+        return Status::success;
     }
 };
 
 class ScannConfig : public IvfFlatConfig {
  public:
     CFG_INT reorder_k;
+    CFG_STRING refine_type;
+    CFG_FLOAT reorder_spread;
+    // > 0 quantizes the vectors of an IP/COSINE index score-aware: the error of a code parallel to its vector,
+    // which shifts its top scores, weighs (dim - 1) * t^2 / (1 - t^2) times the orthogonal one, t being this
+    // threshold on the inner product relative to the norms, 0.2 in ScaNN.
+    CFG_FLOAT anisotropic_threshold;
     KNOHWERE_DECLARE_CONFIG(ScannConfig) {
         KNOWHERE_CONFIG_DECLARE_FIELD(reorder_k)
             .description("reorder k used for refining")
             .allow_empty_without_default()
             .set_range(1, std::numeric_limits<CFG_INT::value_type>::max())
             .for_search();
+        KNOWHERE_CONFIG_DECLARE_FIELD(refine_type)
+            .description("vectors the fast scan candidates are refined with, FLAT/SQ8/FP16")
+            .set_default(kRefineTypeFlat)
+            .for_train();
+        KNOWHERE_CONFIG_DECLARE_FIELD(reorder_spread)
+            .description("refine, per query, only the candidates within this many times the fast scan distance "
+                         "spread of the top k past the k-th one, at most reorder_k, 0 refines all reorder_k")
+            .set_default(0.0f)
+            .set_range(0.0f, std::numeric_limits<CFG_FLOAT::value_type>::max())
+            .for_search();
+        KNOWHERE_CONFIG_DECLARE_FIELD(anisotropic_threshold)
+            .description("relative inner product threshold of the anisotropic quantization loss, 0 quantizes by "
+                         "the reconstruction error")
+            .set_default(0.0f)
+            .set_range(0.0f, 1.0f)
+            .for_train();
+    }
+
+    inline Status
+    CheckAndAdjustForBuild() override {
+        RETURN_IF_ERROR(IvfConfig::CheckAndAdjustForBuild());
+        auto& type = refine_type.value();
+        if (strcasecmp(type.c_str(), kRefineTypeFlat) && strcasecmp(type.c_str(), kRefineTypeSQ8) &&
+            strcasecmp(type.c_str(), kRefineTypeFP16)) {
+            LOG_KNOWHERE_ERROR_ << "invalid refine_type " << type << " for scann";
+            return Status::invalid_args;
+        }
+        if (anisotropic_threshold.value() >= 1.0f) {
+            LOG_KNOWHERE_ERROR_ << "anisotropic_threshold(" << anisotropic_threshold.value() << ") should be below 1";
+            return Status::invalid_args;
+        }
+        return Status::success;
     }
 
     inline Status
@@ -85,6 +321,42 @@ class ScannConfig : public IvfFlatConfig {
 
 class IvfSqConfig : public IvfConfig {};
 
+// The codes hold one bit per dimension, the candidates of a search are re-ranked with the vectors, or their SQ8 or
+// fp16 codes, of refine_type if any.
+class IvfRaBitQConfig : public IvfConfig {
+ public:
+    CFG_STRING refine_type;
+    CFG_FLOAT refine_k;
+    KNOHWERE_DECLARE_CONFIG(IvfRaBitQConfig) {
+        KNOWHERE_CONFIG_DECLARE_FIELD(refine_type)
+            .description("vectors the 1 bit candidates are re-ranked with, NONE/FLAT/SQ8/FP16")
+            .set_default(kRefineTypeNone)
+            .for_train();
+        KNOWHERE_CONFIG_DECLARE_FIELD(refine_k)
+            .description("re-rank the closest refine_k * k candidates of a search by their 1 bit distances")
+            .set_default(4.0f)
+            .set_range(1.0f, std::numeric_limits<CFG_FLOAT::value_type>::max())
+            .for_search();
+    }
+
+    inline Status
+    CheckAndAdjustForBuild() override {
+        RETURN_IF_ERROR(IvfConfig::CheckAndAdjustForBuild());
+        auto& type = refine_type.value();
+        if (strcasecmp(type.c_str(), kRefineTypeNone) && strcasecmp(type.c_str(), kRefineTypeFlat) &&
+            strcasecmp(type.c_str(), kRefineTypeSQ8) && strcasecmp(type.c_str(), kRefineTypeFP16)) {
+            LOG_KNOWHERE_ERROR_ << "invalid refine_type " << type << " for ivf_rabitq";
+            return Status::invalid_args;
+        }
+        if (!IsMetricType(metric_type.value(), metric::L2) && !IsMetricType(metric_type.value(), metric::IP) &&
+            !IsMetricType(metric_type.value(), metric::COSINE)) {
+            LOG_KNOWHERE_ERROR_ << "ivf_rabitq only supports metric L2, IP and COSINE, not " << metric_type.value();
+            return Status::invalid_metric_type;
+        }
+        return Status::success;
+    }
+};
+
 class IvfBinConfig : public IvfConfig {};
 
 }  // namespace knowhere
@@ -17,6 +17,8 @@
 
 #include "ivf_raft.cuh"
 #include "knowhere/factory.h"
+#include "knowhere/index_node_batching_wrapper.h"
+#include "knowhere/index_node_multi_gpu_wrapper.h"
 #include "knowhere/index_node_thread_pool_wrapper.h"
 
 constexpr uint32_t cuda_concurrent_size = 16;
@@ -24,22 +26,30 @@ constexpr uint32_t cuda_concurrent_size = 16;
 namespace knowhere {
 
 KNOWHERE_REGISTER_GLOBAL(GPU_RAFT_IVF_FLAT, [](const Object& object) {
-    return Index<IndexNodeThreadPoolWrapper>::Create(
-        std::make_unique<RaftIvfIndexNode<detail::raft_ivf_flat_index>>(object), cuda_concurrent_size);
+    return Index<IndexNodeBatchingWrapper>::Create(std::make_unique<IndexNodeThreadPoolWrapper>(
+        std::make_unique<IndexNodeMultiGpuWrapper>(
+            []() { return std::make_unique<RaftIvfIndexNode<detail::raft_ivf_flat_index>>(nullptr); }),
+        cuda_concurrent_size));
 });
 
 KNOWHERE_REGISTER_GLOBAL(GPU_RAFT_IVF_PQ, [](const Object& object) {
-    return Index<IndexNodeThreadPoolWrapper>::Create(
-        std::make_unique<RaftIvfIndexNode<detail::raft_ivf_pq_index>>(object), cuda_concurrent_size);
+    return Index<IndexNodeBatchingWrapper>::Create(std::make_unique<IndexNodeThreadPoolWrapper>(
+        std::make_unique<IndexNodeMultiGpuWrapper>(
+            []() { return std::make_unique<RaftIvfIndexNode<detail::raft_ivf_pq_index>>(nullptr); }),
+        cuda_concurrent_size));
 });
 
 KNOWHERE_REGISTER_GLOBAL(GPU_IVF_FLAT, [](const Object& object) {
-    return Index<IndexNodeThreadPoolWrapper>::Create(
-        std::make_unique<RaftIvfIndexNode<detail::raft_ivf_flat_index>>(object), cuda_concurrent_size);
+    return Index<IndexNodeBatchingWrapper>::Create(std::make_unique<IndexNodeThreadPoolWrapper>(
+        std::make_unique<IndexNodeMultiGpuWrapper>(
+            []() { return std::make_unique<RaftIvfIndexNode<detail::raft_ivf_flat_index>>(nullptr); }),
+        cuda_concurrent_size));
 });
 
 KNOWHERE_REGISTER_GLOBAL(GPU_IVF_PQ, [](const Object& object) {
-    return Index<IndexNodeThreadPoolWrapper>::Create(
-        std::make_unique<RaftIvfIndexNode<detail::raft_ivf_pq_index>>(object), cuda_concurrent_size);
+    return Index<IndexNodeBatchingWrapper>::Create(std::make_unique<IndexNodeThreadPoolWrapper>(
+        std::make_unique<IndexNodeMultiGpuWrapper>(
+            []() { return std::make_unique<RaftIvfIndexNode<detail::raft_ivf_pq_index>>(nullptr); }),
+        cuda_concurrent_size));
 });
 }  // namespace knowhere
@@ -18,18 +18,33 @@
 #ifndef IVF_RAFT_CUH
 #define IVF_RAFT_CUH
 
+#include <algorithm>
+#include <cmath>
 #include <cstddef>
 #include <cstdint>
+#include <cstring>
+#include <functional>
 #include <limits>
 #include <memory>
 #include <optional>
 #include <raft/neighbors/specializations.cuh>
+#include <vector>
 
+#include "common/gpu_metrics.h"
+#include "common/knn_util.h"
+#include "common/raft/raft_results.cuh"
 #include "common/raft/raft_utils.h"
 #include "common/raft_metric.h"
+#include "common/range_util.h"
+#include "faiss/IndexFlat.h"
+#include "faiss/IndexIVFFlat.h"
+#include "faiss/index_io.h"
+#include "faiss/utils/distances.h"
 #include "fmt/core.h"
 #include "index/ivf_raft/ivf_raft_config.h"
+#include "io/FaissIO.h"
 #include "knowhere/comp/index_param.h"
+#include "knowhere/comp/thread_pool.h"
 #include "knowhere/device_bitset.h"
 #include "knowhere/factory.h"
 #include "knowhere/log.h"
@@ -42,115 +57,11 @@
 namespace knowhere {
 
 namespace raft_detail {
-struct raft_results {
-    raft_results(raft::device_resources& res)
-        : ids_{raft::make_device_matrix<std::int64_t, std::int64_t>(res, 0, 0)},
-          dists_{raft::make_device_matrix<float, std::int64_t>(res, 0, 0)} {
-    }
-    raft_results(raft::device_resources& res, std::int64_t rows, std::int64_t k)
-        : ids_{raft::make_device_matrix<std::int64_t, std::int64_t>(res, rows, k)},
-          dists_{raft::make_device_matrix<float, std::int64_t>(res, rows, k)} {
-    }
-    auto
-    ids() {
-        return ids_.view();
-    }
-    auto
-    dists() {
-        return dists_.view();
-    }
-    auto
-    ids_data() {
-        return ids_.data_handle();
-    }
-    auto
-    dists_data() {
-        return dists_.data_handle();
-    }
-
-    auto
-    rows() const {
-        return ids_.extent(0);
-    }
-    auto
-    k() const {
-        return ids_.extent(1);
-    }
-
- private:
-    raft::device_matrix<std::int64_t, std::int64_t> ids_;
-    raft::device_matrix<float, std::int64_t> dists_;
-};
-
 auto constexpr static const MAX_IVF_FLAT_K = 256;
-
-__global__ void
-postprocess_device_results(bool* enough_valid, int64_t* ids, float* dists, int64_t rows, int k, int target_k,
-                           DeviceBitsetView bitset) {
-    __shared__ int invalid_count[1];
-    for (auto row_index = blockIdx.x; row_index < rows; row_index += gridDim.x) {
-        if (threadIdx.x == 0) {
-            invalid_count[0] = 0;
-        }
-        __syncthreads();
-        // First, replace all invalid IDs with -1
-        for (auto col_index = threadIdx.x; col_index < k; col_index += blockDim.x) {
-            auto elem_index = row_index * k + col_index;
-            auto cur_id = ids[elem_index];
-            auto invalid_id = bitset.test(cur_id);
-            if (invalid_id) {  // TODO(wphicks): assuming the branch is worth it here;
-                               // should analyze perf.
-                atomicAdd_block(invalid_count, 1);
-            }
-            invalid_id |= cur_id == std::numeric_limits<int64_t>::max();
-            ids[elem_index] = int(invalid_id) * -1 + int(!invalid_id) * ids[elem_index];
-        }
-        __syncthreads();
-
-        // Now move all valid results to the front of the row
-        auto cur_valid_index = row_index * k;
-        for (auto col_index = 0; col_index < k; ++col_index) {
-            auto elem_index = row_index * k + col_index;
-            // Just do one row per block for now; can improve this later
-            if (ids[elem_index] != -1 && threadIdx.x == 0) {
-                // Swap valid id to an earlier place in the row
-                ids[cur_valid_index] = ids[elem_index];
-                if (elem_index != cur_valid_index) {
-                    ids[elem_index] = -1;
-                    // Only count elements invalidated by the bitset. These are the
-                    // elements that will require a swap as opposed to just appearing at
-                    // the end of the row
-                }
-                dists[cur_valid_index++] = dists[elem_index];
-            }
-        }
-        // Check if we have enough valid results
-        if (threadIdx.x == 0) {
-            enough_valid[row_index] = (k - invalid_count[0] >= target_k);
-        }
-    }
-}
-
-/* The following kernel is used to copy data from one row-major 2D array to
- * another. If the input array has more columns than the output array, the
- * rows will be truncated to the length of the output array. Similarly, the
- * number of rows will be truncated if the output has fewer rows. If the output
- * array has more rows/columns than the input, the output will be padded with
- * entries of -1. */
-template <typename T, typename IndexT>
-__global__ void
-slice(T* out, T* in, IndexT out_rows, IndexT out_cols, IndexT in_rows, IndexT in_cols) {
-    for (auto i = blockIdx.x * blockDim.x + threadIdx.x; i < out_rows * out_cols; i += blockDim.x * gridDim.x) {
-        auto row_index = i / out_cols;
-        auto col_index = i % out_cols;
-        if (row_index < in_rows && col_index < in_cols) {
-            out[i] = in[row_index * in_cols + col_index];
-        } else {
-            out[i] = -1;
-        }
-    }
-}
-
+// the most results of a query a range search looks at
+auto constexpr static const MAX_IVF_RANGE_K = 1024;
+// the smallest sub-batch a search is split into, smaller ones cost more in launches than the overlap saves
+auto constexpr static const PIPELINE_MIN_ROWS = 64;
 }  // namespace raft_detail
 
 namespace detail {
@@ -259,22 +170,33 @@ class RaftIvfIndexNode : public IndexNode {
                     return Status::invalid_metric_type;
                 }
                 devs_.insert(devs_.begin(), ivf_raft_cfg.gpu_ids.value().begin(), ivf_raft_cfg.gpu_ids.value().end());
-                auto& res = raft_utils::get_raft_resources();
+                auto& res = raft_utils::get_build_resources();
 
+                // k-means runs on a strided sample of the data, the device holds only the sample; Add streams the
+                // data itself
                 auto rows = dataset.GetRows();
                 auto dim = dataset.GetDim();
                 auto* data = reinterpret_cast<float const*>(dataset.GetTensor());
-
-                auto data_gpu = raft::make_device_matrix<float, std::int64_t>(res, rows, dim);
-                RAFT_CUDA_TRY(cudaMemcpyAsync(data_gpu.data_handle(), data, data_gpu.size() * sizeof(float),
-                                              cudaMemcpyDefault, res.get_stream().value()));
+                auto sample_rows = std::clamp<std::int64_t>(
+                    std::ceil(rows * ivf_raft_cfg.kmeans_trainset_fraction.value()), ivf_raft_cfg.nlist.value(), rows);
+                raft_utils::pinned_buffer sample_buffer;
+                auto* sample = static_cast<float*>(sample_buffer.get(sample_rows * dim * sizeof(float)));
+                for (std::int64_t i = 0; i < sample_rows; ++i) {
+                    auto row = static_cast<std::int64_t>(static_cast<double>(i) * rows / sample_rows);
+                    std::memcpy(sample + i * dim, data + row * dim, dim * sizeof(float));
+                }
+                auto data_gpu = raft::make_device_matrix<float, std::int64_t>(res, sample_rows, dim);
+                RAFT_CUDA_TRY(cudaMemcpyAsync(data_gpu.data_handle(), sample, data_gpu.size() * sizeof(float),
+                                              cudaMemcpyHostToDevice, res.get_stream().value()));
                 if constexpr (std::is_same_v<detail::raft_ivf_flat_index, T>) {
                     auto build_params = raft::neighbors::ivf_flat::index_params{};
                     build_params.metric = metric.value();
                     build_params.n_lists = ivf_raft_cfg.nlist.value();
                     build_params.kmeans_n_iters = ivf_raft_cfg.kmeans_n_iters.value();
-                    build_params.kmeans_trainset_fraction = ivf_raft_cfg.kmeans_trainset_fraction.value();
+                    build_params.kmeans_trainset_fraction = 1.0;
+                    build_params.add_data_on_build = false;
                     build_params.adaptive_centers = ivf_raft_cfg.adaptive_centers.value();
+                    adapt_for_cpu_ = ivf_raft_cfg.adapt_for_cpu.value();
                     gpu_index_ =
                         raft::neighbors::ivf_flat::build<float, std::int64_t>(res, build_params, data_gpu.view());
                 } else if constexpr (std::is_same_v<detail::raft_ivf_pq_index, T>) {
@@ -283,7 +205,8 @@ class RaftIvfIndexNode : public IndexNode {
                     build_params.n_lists = ivf_raft_cfg.nlist.value();
                     build_params.pq_bits = ivf_raft_cfg.nbits.value();
                     build_params.kmeans_n_iters = ivf_raft_cfg.kmeans_n_iters.value();
-                    build_params.kmeans_trainset_fraction = ivf_raft_cfg.kmeans_trainset_fraction.value();
+                    build_params.kmeans_trainset_fraction = 1.0;
+                    build_params.add_data_on_build = false;
                     build_params.pq_dim = ivf_raft_cfg.m.value();
                     auto codebook_kind = detail::str_to_codebook_gen(ivf_raft_cfg.codebook_kind.value());
                     if (!codebook_kind.has_value()) {
@@ -294,11 +217,12 @@ class RaftIvfIndexNode : public IndexNode {
                     build_params.force_random_rotation = ivf_raft_cfg.force_random_rotation.value();
                     gpu_index_ =
                         raft::neighbors::ivf_pq::build<float, std::int64_t>(res, build_params, data_gpu.view());
+                    host_refine_ = ivf_raft_cfg.host_refine.value();
                 } else {
                     static_assert(std::is_same_v<detail::raft_ivf_flat_index, T>);
                 }
                 dim_ = dim;
-                counts_ = rows;
+                counts_ = 0;
                 res.sync_stream();
 
             } catch (std::exception& e) {
@@ -319,40 +243,47 @@ class RaftIvfIndexNode : public IndexNode {
             result = Status::index_not_trained;
         } else {
             try {
+                auto ivf_raft_cfg = static_cast<const typename KnowhereConfigType<T>::Type&>(cfg);
                 auto scoped_device = raft_utils::device_setter{devs_[0]};
                 auto rows = dataset.GetRows();
                 auto dim = dataset.GetDim();
                 auto* data = reinterpret_cast<float const*>(dataset.GetTensor());
 
                 raft_utils::init_gpu_resources();
-                auto& res = raft_utils::get_raft_resources();
-
-                // TODO(wphicks): Clean up transfer with raft
-                // buffer objects when available
-                auto data_gpu = raft::make_device_matrix<float, std::int64_t>(res, rows, dim);
-                RAFT_CUDA_TRY(cudaMemcpyAsync(data_gpu.data_handle(), data, data_gpu.size() * sizeof(float),
-                                              cudaMemcpyDefault, res.get_stream().value()));
-
-                auto indices = rmm::device_uvector<std::int64_t>(rows, res.get_stream());
-                thrust::sequence(res.get_thrust_policy(), indices.begin(), indices.end(), gpu_index_->size());
-
-                if constexpr (std::is_same_v<detail::raft_ivf_flat_index, T>) {
-                    raft::neighbors::ivf_flat::extend<float, std::int64_t>(
-                        res, raft::make_const_mdspan(data_gpu.view()),
-                        std::make_optional(
-                            raft::make_device_vector_view<const std::int64_t, std::int64_t>(indices.data(), rows)),
-                        gpu_index_.value());
-                } else if constexpr (std::is_same_v<detail::raft_ivf_pq_index, T>) {
-                    raft::neighbors::ivf_pq::extend<float, std::int64_t>(
-                        res, raft::make_const_mdspan(data_gpu.view()),
-                        std::make_optional(
-                            raft::make_device_matrix_view<const std::int64_t, std::int64_t>(indices.data(), rows, 1)),
-                        gpu_index_.value());
-                } else {
-                    static_assert(std::is_same_v<detail::raft_ivf_flat_index, T>);
+                auto& res = raft_utils::get_build_resources();
+
+                // the lists grow a chunk at a time while the next chunk uploads, the data need not fit on the device
+                raft_utils::stream_to_device(
+                    res, data, rows, dim, ivf_raft_cfg.build_chunk_rows.value(),
+                    [&](std::int64_t, const float* chunk, std::int64_t n) {
+                        auto indices = rmm::device_uvector<std::int64_t>(n, res.get_stream());
+                        thrust::sequence(res.get_thrust_policy(), indices.begin(), indices.end(), gpu_index_->size());
+                        auto chunk_view = raft::make_device_matrix_view<const float, std::int64_t>(chunk, n, dim);
+                        if constexpr (std::is_same_v<detail::raft_ivf_flat_index, T>) {
+                            raft::neighbors::ivf_flat::extend<float, std::int64_t>(
+                                res, chunk_view,
+                                std::make_optional(
+                                    raft::make_device_vector_view<const std::int64_t, std::int64_t>(indices.data(), n)),
+                                gpu_index_.value());
+                        } else if constexpr (std::is_same_v<detail::raft_ivf_pq_index, T>) {
+                            raft::neighbors::ivf_pq::extend<float, std::int64_t>(
+                                res, chunk_view,
+                                std::make_optional(raft::make_device_matrix_view<const std::int64_t, std::int64_t>(
+                                    indices.data(), n, 1)),
+                                gpu_index_.value());
+                        } else {
+                            static_assert(std::is_same_v<detail::raft_ivf_flat_index, T>);
+                        }
+                    });
+                GetGpuMetrics(this->Type()).h2d_bytes.Increment(rows * dim * sizeof(float));
+                raft_utils::report_memory_pool();
+                if constexpr (std::is_same_v<detail::raft_ivf_pq_index, T>) {
+                    if (host_refine_) {
+                        host_data_.insert(host_data_.end(), data, data + rows * dim);
+                    }
                 }
                 dim_ = dim;
-                counts_ = rows;
+                counts_ = gpu_index_->size();
             } catch (std::exception& e) {
                 LOG_KNOWHERE_WARNING_ << "RAFT inner error, " << e.what();
                 result = Status::raft_inner_error;
@@ -366,92 +297,58 @@ class RaftIvfIndexNode : public IndexNode {
     Search(const DataSet& dataset, const Config& cfg, const BitsetView& bitset) const override {
         auto ivf_raft_cfg = static_cast<const typename KnowhereConfigType<T>::Type&>(cfg);
         auto rows = dataset.GetRows();
-        auto dim = dataset.GetDim();
-        auto* data = reinterpret_cast<float const*>(dataset.GetTensor());
-        auto output_size = rows * ivf_raft_cfg.k.value();
-        auto ids = std::unique_ptr<std::int64_t[]>(new std::int64_t[output_size]);
-        auto dis = std::unique_ptr<float[]>(new float[output_size]);
-        try {
-            auto scoped_device = raft_utils::device_setter{devs_[0]};
-            auto& res_ = raft_utils::get_raft_resources();
-
-            // TODO(wphicks): Clean up transfer with raft
-            // buffer objects when available
-            auto data_gpu = raft::make_device_matrix<float, std::int64_t>(res_, rows, dim);
-            raft::copy(data_gpu.data_handle(), data, data_gpu.size(), res_.get_stream());
-
-            auto gpu_results = raft_detail::raft_results{res_};
-            auto gpu_bitset = DeviceBitset{res_, bitset};
-
-            if constexpr (std::is_same_v<detail::raft_ivf_flat_index, T>) {
-                auto search_params = raft::neighbors::ivf_flat::search_params{};
-                search_params.n_probes = std::min<uint32_t>(ivf_raft_cfg.nprobe.value(), gpu_index_->n_lists());
-                auto search_k = std::min(
-                    ivf_raft_cfg.k.value() + (bitset.count() * ivf_raft_cfg.k.value() / counts_),
-                    std::min(static_cast<uint64_t>(counts_), static_cast<uint64_t>(raft_detail::MAX_IVF_FLAT_K)));
-                gpu_results = RawSearch(res_, raft::make_const_mdspan(data_gpu.view()), search_params, search_k,
-                                        ivf_raft_cfg.k.value(), gpu_bitset.view());
-            } else if constexpr (std::is_same_v<detail::raft_ivf_pq_index, T>) {
-                auto search_params = raft::neighbors::ivf_pq::search_params{};
-                search_params.n_probes = std::min<uint32_t>(ivf_raft_cfg.nprobe.value(), gpu_index_->n_lists());
-                auto lut_dtype = detail::str_to_cuda_dtype(ivf_raft_cfg.lut_dtype.value());
-                if (!lut_dtype.has_value()) {
-                    LOG_KNOWHERE_WARNING_ << "please check lookup dtype: " << ivf_raft_cfg.lut_dtype.value();
-                    return expected<DataSetPtr>::Err(
-                        lut_dtype.error(), fmt::format("invalid lookup dtype: {}", ivf_raft_cfg.lut_dtype.value()));
-                }
-                if (lut_dtype.value() != CUDA_R_32F && lut_dtype.value() != CUDA_R_16F &&
-                    lut_dtype.value() != CUDA_R_8U) {
-                    LOG_KNOWHERE_WARNING_ << "selected lookup dtype not supported: " << ivf_raft_cfg.lut_dtype.value();
-                    return expected<DataSetPtr>::Err(Status::invalid_args,
-                                                     fmt::format("invalid lookup dtype: {}", lut_dtype.value()));
-                }
-                search_params.lut_dtype = lut_dtype.value();
-                auto internal_distance_dtype = detail::str_to_cuda_dtype(ivf_raft_cfg.internal_distance_dtype.value());
-                if (!internal_distance_dtype.has_value()) {
-                    LOG_KNOWHERE_WARNING_ << "please check internal distance dtype: "
-                                          << ivf_raft_cfg.internal_distance_dtype.value();
-                    return expected<DataSetPtr>::Err(internal_distance_dtype.error(),
-                                                     fmt::format("invalid internal distance dtype: {}",
-                                                                 ivf_raft_cfg.internal_distance_dtype.value()));
-                }
-                if (internal_distance_dtype.value() != CUDA_R_32F && internal_distance_dtype.value() != CUDA_R_16F) {
-                    LOG_KNOWHERE_WARNING_ << "selected internal distance dtype not supported: "
-                                          << ivf_raft_cfg.internal_distance_dtype.value();
-                    return expected<DataSetPtr>::Err(
-                        Status::invalid_args, fmt::format("invalid lookup dtype: {}", internal_distance_dtype.value()));
-                }
-                search_params.internal_distance_dtype = internal_distance_dtype.value();
-                search_params.preferred_shmem_carveout = search_params.preferred_shmem_carveout;
-                gpu_results = RawSearch(res_, raft::make_const_mdspan(data_gpu.view()), search_params,
-                                        ivf_raft_cfg.k.value(), ivf_raft_cfg.k.value(), gpu_bitset.view());
-            } else {
-                static_assert(std::is_same_v<detail::raft_ivf_flat_index, T>);
-            }
-
-            if (gpu_results.k() != ivf_raft_cfg.k.value()) {
-                auto new_gpu_results = raft_detail::raft_results{res_, gpu_results.rows(), ivf_raft_cfg.k.value()};
-                raft_detail::slice<<<1024, 256, 0, res_.get_stream().value()>>>(
-                    new_gpu_results.ids_data(), gpu_results.ids_data(), new_gpu_results.rows(), new_gpu_results.k(),
-                    gpu_results.rows(), gpu_results.k());
-                res_.sync_stream();
-                gpu_results = new_gpu_results;
-            }
-            raft::copy(ids.get(), gpu_results.ids_data(), output_size, res_.get_stream());
-            raft::copy(dis.get(), gpu_results.dists_data(), output_size, res_.get_stream());
-            res_.sync_stream();
-
-        } catch (std::exception& e) {
-            LOG_KNOWHERE_WARNING_ << "RAFT inner error, " << e.what();
-            return expected<DataSetPtr>::Err(Status::raft_inner_error, e.what());
+        auto k = ivf_raft_cfg.k.value();
+        KnnResultBuffers buffers(ivf_raft_cfg, rows * k);
+        auto status = KnnSearch(reinterpret_cast<float const*>(dataset.GetTensor()), rows, k, ivf_raft_cfg, bitset,
+                                buffers.ids, buffers.distances);
+        if (status != Status::success) {
+            buffers.Free();
+            return expected<DataSetPtr>::Err(status, "RAFT IVF search failed");
         }
-
-        return GenResultDataSet(rows, ivf_raft_cfg.k.value(), ids.release(), dis.release());
+        return buffers.ToDataSet(rows, k);
     }
 
+    // The search of the closest results of every query the device can return, of which those within the range stay.
     expected<DataSetPtr>
     RangeSearch(const DataSet& dataset, const Config& cfg, const BitsetView& bitset) const override {
-        return expected<DataSetPtr>::Err(Status::not_implemented, "RangeSearch not implemented");
+        if (!gpu_index_) {
+            LOG_KNOWHERE_WARNING_ << "range search on empty index";
+            return expected<DataSetPtr>::Err(Status::empty_index, "index not loaded");
+        }
+        auto ivf_raft_cfg = static_cast<const typename KnowhereConfigType<T>::Type&>(cfg);
+        auto rows = dataset.GetRows();
+        int64_t max_results = ivf_raft_cfg.max_results.value();
+        int64_t k = std::min<int64_t>(MaxK(), raft_detail::MAX_IVF_RANGE_K);
+        if (max_results > 0) {
+            k = std::min(k, max_results);
+        }
+        std::vector<int64_t> knn_ids(rows * k);
+        std::vector<float> knn_dis(rows * k);
+        auto status = KnnSearch(reinterpret_cast<float const*>(dataset.GetTensor()), rows, k, ivf_raft_cfg, bitset,
+                                knn_ids.data(), knn_dis.data());
+        if (status != Status::success) {
+            return expected<DataSetPtr>::Err(status, "RAFT IVF search failed");
+        }
+
+        auto is_ip = IsIp();
+        float radius = ivf_raft_cfg.radius.value();
+        float range_filter = ivf_raft_cfg.range_filter.value();
+        if (range_filter == defaultRangeFilter) {
+            range_filter = is_ip ? std::numeric_limits<float>::infinity() : -std::numeric_limits<float>::infinity();
+        }
+        RangeSearchResultBuilder results(rows, max_results, is_ip);
+        for (int64_t i = 0; i < rows; ++i) {
+            auto ids = knn_ids.data() + i * k;
+            auto n = std::find(ids, ids + k, -1) - ids;
+            results.Query(i).Append(knn_dis.data() + i * k, ids, n, true, is_ip, radius, range_filter);
+        }
+        int64_t* ids = nullptr;
+        float* distances = nullptr;
+        size_t* lims = nullptr;
+        auto owned = results.Build(ivf_raft_cfg, distances, ids, lims);
+        auto res = GenResultDataSet(rows, ids, distances, lims);
+        res->SetIsOwner(owned);
+        return res;
     }
 
     expected<DataSetPtr>
@@ -496,6 +393,10 @@ class RaftIvfIndexNode : public IndexNode {
         }
         if constexpr (std::is_same_v<T, detail::raft_ivf_pq_index>) {
             raft::neighbors::ivf_pq::serialize<std::int64_t>(res, os, *gpu_index_);
+            // the raw vectors of host_refine follow the index
+            int64_t host_rows = dim_ > 0 ? host_data_.size() / dim_ : 0;
+            os.write((char*)(&host_rows), sizeof(host_rows));
+            os.write((char*)host_data_.data(), host_data_.size() * sizeof(float));
         }
         res.sync_stream();
 
@@ -504,6 +405,11 @@ class RaftIvfIndexNode : public IndexNode {
 
         memcpy(index_binary.get(), buf.str().c_str(), buf.str().size());
         binset.Append(this->Type(), index_binary, buf.str().size());
+        if constexpr (std::is_same_v<T, detail::raft_ivf_flat_index>) {
+            if (adapt_for_cpu_) {
+                return SerializeForCpu(res, binset);
+            }
+        }
         return Status::success;
     }
 
@@ -522,6 +428,10 @@ class RaftIvfIndexNode : public IndexNode {
         is.read((char*)(&this->counts_), sizeof(this->counts_));
         this->devs_.resize(1);
         is.read((char*)(&this->devs_[0]), sizeof(this->devs_[0]));
+        auto& raft_cfg = static_cast<const typename KnowhereConfigType<T>::Type&>(config);
+        if (raft_cfg.gpu_id.value() >= 0) {
+            this->devs_[0] = raft_cfg.gpu_id.value();
+        }
         auto scoped_device = raft_utils::device_setter{devs_[0]};
 
         raft_utils::init_gpu_resources();
@@ -532,12 +442,21 @@ class RaftIvfIndexNode : public IndexNode {
             res.sync_stream();
             is.sync();
             gpu_index_ = T(std::move(index_));
+            adapt_for_cpu_ = raft_cfg.adapt_for_cpu.value();
         }
         if constexpr (std::is_same_v<T, detail::raft_ivf_pq_index>) {
             T index_ = raft::neighbors::ivf_pq::deserialize<std::int64_t>(res, is);
             res.sync_stream();
             is.sync();
             gpu_index_ = T(std::move(index_));
+            // none in the binaries of before host_refine
+            int64_t host_rows = 0;
+            if (!is.read((char*)(&host_rows), sizeof(host_rows))) {
+                host_rows = 0;
+            }
+            host_data_.resize(host_rows * dim_);
+            is.read((char*)host_data_.data(), host_data_.size() * sizeof(float));
+            host_refine_ = host_rows > 0;
         }
 
         return Status::success;
@@ -584,16 +503,230 @@ class RaftIvfIndexNode : public IndexNode {
     int64_t dim_ = 0;
     int64_t counts_ = 0;
     std::optional<T> gpu_index_;
+    mutable DeviceBitsetCache bitset_cache_;
+    // IVF-PQ with host_refine, the raw vectors the searches with a refine_ratio rerank their candidates by
+    bool host_refine_ = false;
+    std::vector<float> host_data_;
+    // IVF_FLAT, also serialized as the CPU IVF_FLAT index
+    bool adapt_for_cpu_ = false;
+
+    bool
+    IsIp() const {
+        return gpu_index_->metric() == raft::distance::DistanceType::InnerProduct;
+    }
+
+    // The centers and the lists as a faiss IndexIVFFlat, under the binary name of the CPU IVF_FLAT. A list on the
+    // device holds its vectors in interleaved groups of kIndexGroupSize: the veclen components from the l-th on of
+    // the i-th vector of a group are at l * kIndexGroupSize + i * veclen of the group.
+    Status
+    SerializeForCpu(raft::device_resources& res, BinarySet& binset) const {
+        auto& index = *gpu_index_;
+        auto n_lists = static_cast<int64_t>(index.n_lists());
+        auto dim = static_cast<int64_t>(index.dim());
+        auto veclen = static_cast<int64_t>(index.veclen());
+        auto group_size = static_cast<int64_t>(raft::neighbors::ivf_flat::kIndexGroupSize);
+        std::vector<float> centers(n_lists * dim);
+        std::vector<uint32_t> sizes(n_lists);
+        std::vector<int64_t> offsets(n_lists + 1);
+        std::vector<float> data(index.data().size());
+        std::vector<int64_t> ids(index.indices().size());
+        try {
+            raft::copy(centers.data(), index.centers().data_handle(), centers.size(), res.get_stream());
+            raft::copy(sizes.data(), index.list_sizes().data_handle(), sizes.size(), res.get_stream());
+            raft::copy(offsets.data(), index.list_offsets().data_handle(), offsets.size(), res.get_stream());
+            raft::copy(data.data(), index.data().data_handle(), data.size(), res.get_stream());
+            raft::copy(ids.data(), index.indices().data_handle(), ids.size(), res.get_stream());
+            res.sync_stream();
+        } catch (std::exception& e) {
+            LOG_KNOWHERE_WARNING_ << "RAFT inner error, " << e.what();
+            return Status::raft_inner_error;
+        }
+
+        auto metric = IsIp() ? faiss::METRIC_INNER_PRODUCT : faiss::METRIC_L2;
+        try {
+            auto quantizer = new faiss::IndexFlat(dim, metric);
+            faiss::IndexIVFFlat ivf(quantizer, dim, n_lists, metric);
+            ivf.own_fields = true;
+            quantizer->add(n_lists, centers.data());
+            std::vector<float> vectors;
+            for (int64_t list = 0; list < n_lists; ++list) {
+                auto size = static_cast<int64_t>(sizes[list]);
+                auto list_data = data.data() + offsets[list] * dim;
+                vectors.resize(size * dim);
+                for (int64_t i = 0; i < size; ++i) {
+                    auto group = list_data + (i / group_size) * group_size * dim;
+                    auto in_group = (i % group_size) * veclen;
+                    for (int64_t l = 0; l < dim; l += veclen) {
+                        std::memcpy(vectors.data() + i * dim + l, group + l * group_size + in_group,
+                                    veclen * sizeof(float));
+                    }
+                }
+                ivf.invlists->add_entries(list, size, ids.data() + offsets[list],
+                                          reinterpret_cast<const uint8_t*>(vectors.data()));
+                ivf.ntotal += size;
+            }
+            auto [binary, size] = SerializeToMemory([&](MemoryIOWriter& writer) { faiss::write_index(&ivf, &writer); });
+            binset.Append(IndexEnum::INDEX_FAISS_IVFFLAT, binary, size);
+        } catch (std::exception& e) {
+            LOG_KNOWHERE_WARNING_ << "faiss inner error, " << e.what();
+            return Status::faiss_inner_error;
+        }
+        return Status::success;
+    }
+
+    // k results of each query into ids and distances, the ids the bitset filters out or the search could not find
+    // are -1
+    Status
+    KnnSearch(const float* data, int64_t rows, int64_t k, const typename KnowhereConfigType<T>::Type& ivf_raft_cfg,
+              const BitsetView& bitset, int64_t* ids, float* distances) const {
+        try {
+            auto scoped_device = raft_utils::device_setter{devs_[0]};
+            auto& res_ = raft_utils::get_raft_resources();
+
+            // the device reads the bits of the filter, from the streams of all the sub-batches
+            std::vector<uint8_t> dense_bits;
+            auto gpu_bitset =
+                bitset_cache_.Get(res_, devs_[0], bitset.to_dense(dense_bits), ivf_raft_cfg.filter_version.value());
 
+            if constexpr (std::is_same_v<detail::raft_ivf_flat_index, T>) {
+                auto search_params = raft::neighbors::ivf_flat::search_params{};
+                search_params.n_probes = std::min<uint32_t>(ivf_raft_cfg.nprobe.value(), gpu_index_->n_lists());
+                PipelinedSearch(data, rows, dim_, search_params, SearchK(k, bitset), k, gpu_bitset->view(), ids,
+                                distances);
+            } else if constexpr (std::is_same_v<detail::raft_ivf_pq_index, T>) {
+                auto search_params = raft::neighbors::ivf_pq::search_params{};
+                search_params.n_probes = std::min<uint32_t>(ivf_raft_cfg.nprobe.value(), gpu_index_->n_lists());
+                auto lut_dtype = detail::str_to_cuda_dtype(ivf_raft_cfg.lut_dtype.value());
+                if (!lut_dtype.has_value()) {
+                    LOG_KNOWHERE_WARNING_ << "please check lookup dtype: " << ivf_raft_cfg.lut_dtype.value();
+                    return lut_dtype.error();
+                }
+                if (lut_dtype.value() != CUDA_R_32F && lut_dtype.value() != CUDA_R_16F &&
+                    lut_dtype.value() != CUDA_R_8U) {
+                    LOG_KNOWHERE_WARNING_ << "selected lookup dtype not supported: " << ivf_raft_cfg.lut_dtype.value();
+                    return Status::invalid_args;
+                }
+                search_params.lut_dtype = lut_dtype.value();
+                auto internal_distance_dtype = detail::str_to_cuda_dtype(ivf_raft_cfg.internal_distance_dtype.value());
+                if (!internal_distance_dtype.has_value()) {
+                    LOG_KNOWHERE_WARNING_ << "please check internal distance dtype: "
+                                          << ivf_raft_cfg.internal_distance_dtype.value();
+                    return internal_distance_dtype.error();
+                }
+                if (internal_distance_dtype.value() != CUDA_R_32F && internal_distance_dtype.value() != CUDA_R_16F) {
+                    LOG_KNOWHERE_WARNING_ << "selected internal distance dtype not supported: "
+                                          << ivf_raft_cfg.internal_distance_dtype.value();
+                    return Status::invalid_args;
+                }
+                search_params.internal_distance_dtype = internal_distance_dtype.value();
+                search_params.preferred_shmem_carveout = search_params.preferred_shmem_carveout;
+                auto refine_ratio = ivf_raft_cfg.refine_ratio.value();
+                if (refine_ratio > 1.0f && !host_data_.empty()) {
+                    RefinedSearch(data, rows, search_params, k, refine_ratio, bitset, gpu_bitset->view(), ids,
+                                  distances);
+                } else {
+                    PipelinedSearch(data, rows, dim_, search_params, SearchK(k, bitset), k, gpu_bitset->view(), ids,
+                                    distances);
+                }
+            } else {
+                static_assert(std::is_same_v<detail::raft_ivf_flat_index, T>);
+            }
+        } catch (std::exception& e) {
+            LOG_KNOWHERE_WARNING_ << "RAFT inner error, " << e.what();
+            return Status::raft_inner_error;
+        }
+        return Status::success;
+    }
+
+    // the k to search with for k results the bitset keeps, from the share of the ids it filters out
+    int64_t
+    SearchK(int64_t k, const BitsetView& bitset) const {
+        if (counts_ == 0) {
+            return k;
+        }
+        return std::min<int64_t>(k + bitset.count() * k / counts_, MaxK());
+    }
+
+    // IVF-PQ with a refine ratio: the device finds k * refine_ratio candidates of every query by their PQ distances,
+    // the search pool reranks the candidates of a sub-batch by their exact distances as soon as the sub-batch is back
+    // from the device, while the device still searches the next ones.
     template <typename raft_search_params_t>
-    raft_detail::raft_results
-    RawSearch(raft::device_resources& res, raft::device_matrix_view<const float, std::int64_t> queries,
-              raft_search_params_t const& search_params, int k, int target_k, DeviceBitsetView const& bitset) const {
-        auto max_k = counts_;
+    void
+    RefinedSearch(const float* queries, int64_t rows, raft_search_params_t const& search_params, int64_t k,
+                  float refine_ratio, const BitsetView& bitset, DeviceBitsetView const& gpu_bitset, int64_t* ids,
+                  float* distances) const {
+        auto candidate_k = std::min<int64_t>(static_cast<int64_t>(std::ceil(k * refine_ratio)), MaxK());
+        std::vector<int64_t> candidate_ids(rows * candidate_k);
+        std::vector<float> candidate_distances(rows * candidate_k);
+        auto pool = ThreadPool::GetGlobalSearchThreadPool();
+        std::vector<folly::Future<folly::Unit>> reranks;
+        auto rerank = [&](int64_t begin, int64_t n) {
+            reranks.push_back(pool->push([&, begin, n]() {
+                Refine(queries, begin, n, candidate_ids.data(), candidate_k, k, ids, distances);
+            }));
+        };
+        try {
+            PipelinedSearch(queries, rows, dim_, search_params, SearchK(candidate_k, bitset), candidate_k, gpu_bitset,
+                            candidate_ids.data(), candidate_distances.data(), rerank);
+        } catch (...) {
+            // the reranks read the candidates
+            for (auto& f : reranks) {
+                f.wait();
+            }
+            throw;
+        }
+        for (auto& f : reranks) {
+            std::move(f).get();
+        }
+    }
+
+    // the k closest of the candidate_k candidates of each query of [begin, begin + rows), by exact distance
+    void
+    Refine(const float* queries, int64_t begin, int64_t rows, const int64_t* candidates, int64_t candidate_k, int64_t k,
+           int64_t* ids, float* distances) const {
+        auto is_ip = IsIp();
+        std::vector<std::pair<float, int64_t>> scored;
+        for (auto q = begin; q < begin + rows; ++q) {
+            scored.clear();
+            auto query = queries + q * dim_;
+            for (int64_t j = 0; j < candidate_k; ++j) {
+                auto id = candidates[q * candidate_k + j];
+                if (id < 0) {
+                    continue;
+                }
+                auto vector = host_data_.data() + id * dim_;
+                auto dis =
+                    is_ip ? faiss::fvec_inner_product(query, vector, dim_) : faiss::fvec_L2sqr(query, vector, dim_);
+                scored.emplace_back(dis, id);
+            }
+            auto found = std::min<int64_t>(k, scored.size());
+            std::partial_sort(scored.begin(), scored.begin() + found, scored.end(), [is_ip](auto& a, auto& b) {
+                return is_ip ? a.first > b.first : a.first < b.first;
+            });
+            for (int64_t j = 0; j < k; ++j) {
+                ids[q * k + j] = j < found ? scored[j].second : -1;
+                distances[q * k + j] = j < found ? scored[j].first : -1;
+            }
+        }
+    }
+
+    // the largest k a search may ask for
+    int64_t
+    MaxK() const {
         if constexpr (std::is_same_v<detail::raft_ivf_flat_index, T>) {
-            k = std::min(k, raft_detail::MAX_IVF_FLAT_K);
-            max_k = std::min(max_k, int64_t{raft_detail::MAX_IVF_FLAT_K});
+            return std::min(counts_, int64_t{raft_detail::MAX_IVF_FLAT_K});
         }
+        return counts_;
+    }
+
+    // One search with k, of which the ids the bitset filters out become -1 at the end of their row. enough_valid tells
+    // of each query whether target_k results are left.
+    template <typename raft_search_params_t>
+    raft_detail::raft_results
+    RawSearchOnce(raft::device_resources& res, raft::device_matrix_view<const float, std::int64_t> queries,
+                  raft_search_params_t const& search_params, int k, int target_k, DeviceBitsetView const& bitset,
+                  bool* enough_valid) const {
+        k = std::min<int64_t>(k, MaxK());
         auto result = raft_detail::raft_results{res, queries.extent(0), k};
         if constexpr (std::is_same_v<detail::raft_ivf_flat_index, T>) {
             raft::neighbors::ivf_flat::search<float, std::int64_t>(res, search_params, *gpu_index_, queries,
@@ -611,17 +744,130 @@ class RaftIvfIndexNode : public IndexNode {
         if (warp_remainder != 0) {
             threads += (32 - warp_remainder);
         }
-        auto enough_valid = raft::make_device_vector<bool>(res, queries.extent(0));
-
         raft_detail::postprocess_device_results<<<blocks, threads, 0, res.get_stream().value()>>>(
-            enough_valid.data_handle(), result.ids_data(), result.dists_data(), queries.extent(0), k, target_k, bitset);
+            enough_valid, result.ids_data(), result.dists_data(), queries.extent(0), k, target_k, bitset);
+        return result;
+    }
 
-        if (k < max_k && !thrust::all_of(res.get_thrust_policy(), enough_valid.data_handle(),
-                                         enough_valid.data_handle() + queries.extent(0), thrust::identity<bool>())) {
-            result = RawSearch(res, queries, search_params, std::min(int64_t{k * 2}, max_k), target_k, bitset);
+    // Searches with k, doubling it while a query has fewer than target_k results the bitset keeps.
+    template <typename raft_search_params_t>
+    raft_detail::raft_results
+    RawSearch(raft::device_resources& res, raft::device_matrix_view<const float, std::int64_t> queries,
+              raft_search_params_t const& search_params, int k, int target_k, DeviceBitsetView const& bitset) const {
+        auto enough_valid = raft::make_device_vector<bool>(res, queries.extent(0));
+        auto result =
+            RawSearchOnce(res, queries, search_params, k, target_k, bitset, enough_valid.data_handle());
+        if (result.k() < MaxK() &&
+            !thrust::all_of(res.get_thrust_policy(), enough_valid.data_handle(),
+                            enough_valid.data_handle() + queries.extent(0), thrust::identity<bool>())) {
+            result = RawSearch(res, queries, search_params, std::min(int64_t{result.k() * 2}, MaxK()), target_k,
+                               bitset);
         }
         return result;
     }
+
+    // the first k columns of results, padded with -1
+    static raft_detail::raft_results
+    Slice(raft::device_resources& res, raft_detail::raft_results results, int64_t k) {
+        if (results.k() == k) {
+            return results;
+        }
+        auto sliced = raft_detail::raft_results{res, results.rows(), k};
+        raft_detail::slice<<<1024, 256, 0, res.get_stream().value()>>>(sliced.ids_data(), results.ids_data(),
+                                                                       sliced.rows(), sliced.k(), results.rows(),
+                                                                       results.k());
+        raft_detail::slice<<<1024, 256, 0, res.get_stream().value()>>>(sliced.dists_data(), results.dists_data(),
+                                                                       sliced.rows(), sliced.k(), results.rows(),
+                                                                       results.k());
+        return sliced;
+    }
+
+    // Splits the queries into up to pipeline_streams sub-batches of at least PIPELINE_MIN_ROWS queries, each on a
+    // stream of its own and staged through a pinned buffer of its own. The upload, the search and the download of a
+    // sub-batch overlap those of the others, and the host waits once for them all. The device buffers come from the
+    // RMM pool of the device. A sub-batch of which a query is left short of k results by the bitset is searched again,
+    // with a larger k. on_rows is called with the rows of every sub-batch once its results are in place. The copies,
+    // the search, the slice and the waits of every sub-batch go into the GpuMetrics of the index type.
+    template <typename raft_search_params_t>
+    void
+    PipelinedSearch(const float* queries, int64_t rows, int64_t dim, raft_search_params_t const& search_params,
+                    int search_k, int k, DeviceBitsetView const& bitset, int64_t* ids, float* distances,
+                    const std::function<void(int64_t, int64_t)>& on_rows = nullptr) const {
+        struct SubBatch {
+            raft::device_resources* res;
+            int64_t begin;
+            int64_t rows;
+            std::optional<raft::device_matrix<float, std::int64_t>> queries;
+            int64_t* pinned_ids;
+            float* pinned_queries;
+            float* pinned_distances;
+            bool* pinned_enough;
+        };
+        GpuStageTimer timer(GetGpuMetrics(this->Type()));
+        auto streams = std::clamp<int64_t>((rows + raft_detail::PIPELINE_MIN_ROWS - 1) / raft_detail::PIPELINE_MIN_ROWS,
+                                           1, raft_utils::pipeline_streams);
+        auto batch = std::max<int64_t>(1, (rows + streams - 1) / streams);
+        std::vector<SubBatch> sub_batches;
+        for (int64_t s = 0; s * batch < rows; ++s) {
+            auto& sub = sub_batches.emplace_back();
+            sub.res = &raft_utils::get_pipeline_resources(s);
+            sub.begin = s * batch;
+            sub.rows = std::min(batch, rows - sub.begin);
+            auto pinned = raft_utils::get_pinned_buffer(
+                s, sub.rows * (k * sizeof(int64_t) + (dim + k) * sizeof(float) + sizeof(bool)));
+            sub.pinned_ids = static_cast<int64_t*>(pinned);
+            sub.pinned_queries = reinterpret_cast<float*>(sub.pinned_ids + sub.rows * k);
+            sub.pinned_distances = sub.pinned_queries + sub.rows * dim;
+            sub.pinned_enough = reinterpret_cast<bool*>(sub.pinned_distances + sub.rows * k);
+
+            auto stream = sub.res->get_stream();
+            std::copy_n(queries + sub.begin * dim, sub.rows * dim, sub.pinned_queries);
+            sub.queries = raft::make_device_matrix<float, std::int64_t>(*sub.res, sub.rows, dim);
+            timer.Time(GpuStageTimer::kH2D, stream.value(),
+                       [&] { raft::copy(sub.queries->data_handle(), sub.pinned_queries, sub.rows * dim, stream); });
+            timer.H2D(sub.rows * dim * sizeof(float));
+            auto enough_valid = raft::make_device_vector<bool>(*sub.res, sub.rows);
+            auto raw = timer.Time(GpuStageTimer::kKernel, stream.value(), [&] {
+                return RawSearchOnce(*sub.res, raft::make_const_mdspan(sub.queries->view()), search_params, search_k, k,
+                                     bitset, enough_valid.data_handle());
+            });
+            auto results = timer.Time(GpuStageTimer::kSlice, stream.value(),
+                                      [&] { return Slice(*sub.res, std::move(raw), k); });
+            timer.Time(GpuStageTimer::kD2H, stream.value(), [&] {
+                raft::copy(sub.pinned_ids, results.ids_data(), sub.rows * k, stream);
+                raft::copy(sub.pinned_distances, results.dists_data(), sub.rows * k, stream);
+                raft::copy(sub.pinned_enough, enough_valid.data_handle(), sub.rows, stream);
+            });
+            timer.D2H(sub.rows * (k * (sizeof(int64_t) + sizeof(float)) + sizeof(bool)));
+        }
+
+        for (auto& sub : sub_batches) {
+            timer.Sync([&] { sub.res->sync_stream(); });
+            bool enough = std::all_of(sub.pinned_enough, sub.pinned_enough + sub.rows, [](bool x) { return x; });
+            if (!enough && std::min<int64_t>(search_k, MaxK()) < MaxK()) {
+                auto stream = sub.res->get_stream();
+                auto raw = timer.Time(GpuStageTimer::kKernel, stream.value(), [&] {
+                    return RawSearch(*sub.res, raft::make_const_mdspan(sub.queries->view()), search_params,
+                                     std::min(int64_t{search_k} * 2, MaxK()), k, bitset);
+                });
+                auto results = timer.Time(GpuStageTimer::kSlice, stream.value(),
+                                          [&] { return Slice(*sub.res, std::move(raw), k); });
+                timer.Time(GpuStageTimer::kD2H, stream.value(), [&] {
+                    raft::copy(ids + sub.begin * k, results.ids_data(), sub.rows * k, stream);
+                    raft::copy(distances + sub.begin * k, results.dists_data(), sub.rows * k, stream);
+                });
+                timer.D2H(sub.rows * k * (sizeof(int64_t) + sizeof(float)));
+                timer.Sync([&] { sub.res->sync_stream(); });
+            } else {
+                std::copy_n(sub.pinned_ids, sub.rows * k, ids + sub.begin * k);
+                std::copy_n(sub.pinned_distances, sub.rows * k, distances + sub.begin * k);
+            }
+            if (on_rows) {
+                on_rows(sub.begin, sub.rows);
+            }
+        }
+        raft_utils::report_memory_pool();
+    }
 };
 
 }  // namespace knowhere
@@ -26,9 +26,13 @@ namespace knowhere {
 class RaftIvfFlatConfig : public IvfFlatConfig {
  public:
     CFG_LIST gpu_ids;
+    CFG_STRING multi_gpu_mode;
+    CFG_INT gpu_id;
     CFG_INT kmeans_n_iters;
     CFG_FLOAT kmeans_trainset_fraction;
+    CFG_INT build_chunk_rows;
     CFG_BOOL adaptive_centers;
+    CFG_BOOL adapt_for_cpu;
     KNOHWERE_DECLARE_CONFIG(RaftIvfFlatConfig) {
         KNOWHERE_CONFIG_DECLARE_FIELD(k)
             .set_default(10)
@@ -37,11 +41,19 @@ class RaftIvfFlatConfig : public IvfFlatConfig {
             .for_search();
 
         KNOWHERE_CONFIG_DECLARE_FIELD(gpu_ids)
-            .description("gpu device ids")
+            .description("gpu device ids, the index is replicated or sharded over several of them")
             .set_default({
                 0,
             })
             .for_train();
+        KNOWHERE_CONFIG_DECLARE_FIELD(multi_gpu_mode)
+            .description("how the index spans several gpu_ids: replicated or sharded")
+            .set_default("replicated")
+            .for_train();
+        KNOWHERE_CONFIG_DECLARE_FIELD(gpu_id)
+            .description("gpu device the index is loaded onto, -1 for the one it was built on")
+            .set_default(-1)
+            .for_deserialize();
         KNOWHERE_CONFIG_DECLARE_FIELD(kmeans_n_iters)
             .description("iterations to search for kmeans centers")
             .set_default(20)
@@ -50,19 +62,32 @@ class RaftIvfFlatConfig : public IvfFlatConfig {
             .description("fraction of data to use in kmeans building")
             .set_default(0.5)
             .for_train();
+        KNOWHERE_CONFIG_DECLARE_FIELD(build_chunk_rows)
+            .description("rows of the data streamed to the gpu at a time while adding them")
+            .set_default(65536)
+            .set_range(1, std::numeric_limits<CFG_INT::value_type>::max())
+            .for_train();
         KNOWHERE_CONFIG_DECLARE_FIELD(adaptive_centers)
             .description("update centroids with new data")
             .set_default(false)
             .for_train();
+        KNOWHERE_CONFIG_DECLARE_FIELD(adapt_for_cpu)
+            .description("also serialize the index as the CPU IVF_FLAT index, a host without GPU loads it")
+            .set_default(false)
+            .for_train()
+            .for_deserialize();
     }
 };
 
 class RaftIvfPqConfig : public IvfPqConfig {
  public:
     CFG_LIST gpu_ids;
+    CFG_STRING multi_gpu_mode;
+    CFG_INT gpu_id;
     CFG_INT streams_per_device;
     CFG_INT kmeans_n_iters;
     CFG_FLOAT kmeans_trainset_fraction;
+    CFG_INT build_chunk_rows;
     CFG_INT m;
     CFG_STRING codebook_kind;
     CFG_BOOL force_random_rotation;
@@ -70,6 +95,8 @@ class RaftIvfPqConfig : public IvfPqConfig {
     CFG_STRING lut_dtype;
     CFG_STRING internal_distance_dtype;
     CFG_FLOAT preferred_shmem_carveout;
+    CFG_BOOL host_refine;
+    CFG_FLOAT refine_ratio;
     KNOHWERE_DECLARE_CONFIG(RaftIvfPqConfig) {
         KNOWHERE_CONFIG_DECLARE_FIELD(k)
             .set_default(10)
@@ -78,11 +105,19 @@ class RaftIvfPqConfig : public IvfPqConfig {
             .for_search();
 
         KNOWHERE_CONFIG_DECLARE_FIELD(gpu_ids)
-            .description("gpu device ids")
+            .description("gpu device ids, the index is replicated or sharded over several of them")
             .set_default({
                 0,
             })
             .for_train();
+        KNOWHERE_CONFIG_DECLARE_FIELD(multi_gpu_mode)
+            .description("how the index spans several gpu_ids: replicated or sharded")
+            .set_default("replicated")
+            .for_train();
+        KNOWHERE_CONFIG_DECLARE_FIELD(gpu_id)
+            .description("gpu device the index is loaded onto, -1 for the one it was built on")
+            .set_default(-1)
+            .for_deserialize();
         KNOWHERE_CONFIG_DECLARE_FIELD(streams_per_device)
             .description("CUDA streams per GPU")
             .set_default(1)
@@ -95,6 +130,11 @@ class RaftIvfPqConfig : public IvfPqConfig {
             .description("fraction of data to use in kmeans building")
             .set_default(0.5)
             .for_train();
+        KNOWHERE_CONFIG_DECLARE_FIELD(build_chunk_rows)
+            .description("rows of the data streamed to the gpu at a time while adding them")
+            .set_default(65536)
+            .set_range(1, std::numeric_limits<CFG_INT::value_type>::max())
+            .for_train();
         KNOWHERE_CONFIG_DECLARE_FIELD(m).description("dimension after compression by PQ").set_default(0).for_train();
         KNOWHERE_CONFIG_DECLARE_FIELD(codebook_kind)
             .description("how PQ codebooks are created")
@@ -120,6 +160,17 @@ class RaftIvfPqConfig : public IvfPqConfig {
             .description("preferred fraction of memory for shmem vs L1")
             .set_default(1.0)
             .for_search();
+        KNOWHERE_CONFIG_DECLARE_FIELD(host_refine)
+            .description("keep the raw vectors in host memory, for the searches with a refine_ratio")
+            .set_default(false)
+            .for_train();
+        KNOWHERE_CONFIG_DECLARE_FIELD(refine_ratio)
+            .description("candidates the gpu finds per result, reranked by their exact distances on the host; "
+                         "above 1 needs an index built with host_refine")
+            .set_default(1.0)
+            .set_range(1.0, 64.0)
+            .for_search()
+            .for_range_search();
     }
 };
 
@@ -0,0 +1,640 @@
+// Copyright (C) 2019-2023 Zilliz. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file except in compliance
+// with the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
+// or implied. See the License for the specific language governing permissions and limitations under the License.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include "common/gpu_metrics.h"
+#include "common/knn_util.h"
+#include "common/raft/raft_results.cuh"
+#include "common/raft/raft_utils.h"
+#include "common/range_util.h"
+#include "index/raft_brute_force/raft_brute_force_config.h"
+#include "knowhere/comp/index_param.h"
+#include "knowhere/device_bitset.h"
+#include "knowhere/factory.h"
+#include "knowhere/index_node.h"
+#include "knowhere/index_node_batching_wrapper.h"
+#include "knowhere/index_node_multi_gpu_wrapper.h"
+#include "knowhere/index_node_thread_pool_wrapper.h"
+#include "knowhere/log.h"
+#include "knowhere/utils.h"
+#include "raft/neighbors/brute_force.cuh"
+#include "thrust/logical.h"
+
+constexpr uint32_t cuda_concurrent_size = 16;
+
+namespace knowhere {
+
+namespace raft_bf_detail {
+// the largest k of a search, range searches look at as many results of a query
+auto constexpr static const MAX_BRUTE_FORCE_K = 1024;
+// the largest share of the rows a filter may drop for a search over all of them with a larger k, past it a search goes
+// over the rows the filter keeps only
+auto constexpr static const MAX_OVERSAMPLED_FILTER = 0.5;
+
+// copies the rows ids of in, dim columns each
+__global__ void
+gather_rows(float* out, const float* in, const int64_t* ids, int64_t rows, int64_t dim) {
+    for (auto i = int64_t{blockIdx.x} * blockDim.x + threadIdx.x; i < rows * dim;
+         i += int64_t{blockDim.x} * gridDim.x) {
+        out[i] = in[ids[i / dim] * dim + i % dim];
+    }
+}
+
+// The first in_k of the in_stride results of each query of a tile into the k columns of out: the ids of the tile, its
+// positions, to the ids of the index through alive or past first, the distances times sign, and the columns past in_k
+// or past the -1 ids empty, -1 and the largest distance.
+__global__ void
+place_tile(int64_t* out_ids, float* out_dists, int64_t rows, int64_t k, const int64_t* in_ids, const float* in_dists,
+           int64_t in_stride, int64_t in_k, const int64_t* alive, int64_t first, float sign) {
+    for (auto i = int64_t{blockIdx.x} * blockDim.x + threadIdx.x; i < rows * k; i += int64_t{blockDim.x} * gridDim.x) {
+        auto row = i / k;
+        auto col = i % k;
+        auto id = col < in_k ? in_ids[row * in_stride + col] : int64_t{-1};
+        if (id < 0) {
+            out_ids[i] = -1;
+            out_dists[i] = std::numeric_limits<float>::infinity();
+        } else {
+            out_ids[i] = alive != nullptr ? alive[id] : first + id;
+            out_dists[i] = sign * in_dists[row * in_stride + col];
+        }
+    }
+}
+
+// the merged results back to the distances of the metric, the empty ones -1
+__global__ void
+finish_results(int64_t* ids, float* dists, int64_t n, float sign) {
+    for (auto i = int64_t{blockIdx.x} * blockDim.x + threadIdx.x; i < n; i += int64_t{blockDim.x} * gridDim.x) {
+        if (ids[i] < 0 || dists[i] == std::numeric_limits<float>::infinity()) {
+            ids[i] = -1;
+        }
+        dists[i] *= sign;
+    }
+}
+
+// The k best results of every query over the tiles searched so far, the smallest distance the best one: the distances
+// of IP are negated on the way in and back on the way out. The results so far are the first rows x k of the two parts
+// of a merge, those of a tile the second.
+class TopK {
+ public:
+    TopK(raft::device_resources& res, int64_t rows, int64_t k, bool is_ip)
+        : rows_(rows),
+          k_(k),
+          sign_(is_ip ? -1.0f : 1.0f),
+          parts_(res, 2 * rows, k),
+          merged_(res, rows, k),
+          translations_(raft::make_device_vector<int64_t, int64_t>(res, 2)) {
+        RAFT_CUDA_TRY(cudaMemsetAsync(translations_.data_handle(), 0, 2 * sizeof(int64_t), res.get_stream().value()));
+    }
+
+    int64_t
+    k() const {
+        return k_;
+    }
+
+    // the in_k of the in_stride results of each query of a tile, see place_tile
+    void
+    Add(raft::device_resources& res, const int64_t* in_ids, const float* in_dists, int64_t in_stride, int64_t in_k,
+        const int64_t* alive, int64_t first) {
+        auto stream = res.get_stream();
+        auto offset = empty_ ? 0 : rows_ * k_;
+        place_tile<<<1024, 256, 0, stream.value()>>>(parts_.ids_data() + offset, parts_.dists_data() + offset, rows_,
+                                                     k_, in_ids, in_dists, in_stride, in_k, alive, first, sign_);
+        if (!empty_) {
+            raft::neighbors::brute_force::knn_merge_parts<float, int64_t>(
+                res, raft::make_device_matrix_view<const float, int64_t>(parts_.dists_data(), 2 * rows_, k_),
+                raft::make_device_matrix_view<const int64_t, int64_t>(parts_.ids_data(), 2 * rows_, k_),
+                merged_.dists(), merged_.ids(), rows_, std::make_optional(translations_.view()));
+            raft::copy(parts_.ids_data(), merged_.ids_data(), rows_ * k_, stream);
+            raft::copy(parts_.dists_data(), merged_.dists_data(), rows_ * k_, stream);
+        }
+        empty_ = false;
+    }
+
+    // the results into the host buffers ids and distances, rows x k each
+    void
+    Finish(raft::device_resources& res, int64_t* ids, float* distances, GpuStageTimer& timer) {
+        auto stream = res.get_stream();
+        timer.Time(GpuStageTimer::kSlice, stream.value(), [&] {
+            if (empty_) {
+                Add(res, nullptr, nullptr, 0, 0, nullptr, 0);
+            }
+            finish_results<<<1024, 256, 0, stream.value()>>>(parts_.ids_data(), parts_.dists_data(), rows_ * k_,
+                                                             sign_);
+        });
+        timer.Time(GpuStageTimer::kD2H, stream.value(), [&] {
+            raft::copy(ids, parts_.ids_data(), rows_ * k_, stream);
+            raft::copy(distances, parts_.dists_data(), rows_ * k_, stream);
+        });
+        timer.D2H(rows_ * k_ * (sizeof(int64_t) + sizeof(float)));
+        timer.Sync([&] { res.sync_stream(); });
+    }
+
+ private:
+    int64_t rows_;
+    int64_t k_;
+    float sign_;
+    bool empty_ = true;
+    raft_detail::raft_results parts_;
+    raft_detail::raft_results merged_;
+    raft::device_vector<int64_t, int64_t> translations_;
+};
+}  // namespace raft_bf_detail
+
+/**
+ * Exact search on the GPU by the brute force kNN of RAFT: the distances of a tile of the rows to the queries and the
+ * selection of the best k of them, fused into one kernel for L2 with a small k. The vectors stay in host memory, and on
+ * the device as well when they fit in half of its free memory; else a search streams them to the device a tile at a
+ * time through pinned buffers and merges the results of the tiles. COSINE is IP on the normalized vectors.
+ *
+ * A filter is tested on the device: a search with k grown by the share of the rows it drops, of which the dropped ids
+ * are removed afterwards, as long as it drops at most MAX_OVERSAMPLED_FILTER of them and every query keeps k results;
+ * else the search goes over the rows the filter keeps, gathered into tiles of their own, and stays exact.
+ */
+class RaftBruteForceIndexNode : public IndexNode {
+ public:
+    RaftBruteForceIndexNode(const Object& object) : devs_{} {
+    }
+
+    Status
+    Train(const DataSet& dataset, const Config& cfg) override {
+        auto bf_cfg = static_cast<const RaftBruteForceConfig&>(cfg);
+        if (!devs_.empty()) {
+            LOG_KNOWHERE_WARNING_ << "index is already trained";
+            return Status::index_already_trained;
+        }
+        if (bf_cfg.gpu_ids.value().size() != 1) {
+            LOG_KNOWHERE_WARNING_ << "RAFT brute force implementation is single-GPU only";
+            return Status::raft_inner_error;
+        }
+        auto& metric_type = bf_cfg.metric_type.value();
+        bool is_cosine = IsMetricType(metric_type, metric::COSINE);
+        bool is_ip = is_cosine || IsMetricType(metric_type, metric::IP);
+        if (!is_ip && !IsMetricType(metric_type, metric::L2)) {
+            LOG_KNOWHERE_WARNING_ << "selected metric not supported in RAFT brute force: " << metric_type;
+            return Status::invalid_metric_type;
+        }
+        try {
+            auto scoped_device = raft_utils::device_setter{*bf_cfg.gpu_ids.value().begin()};
+            raft_utils::init_gpu_resources();
+        } catch (std::exception& e) {
+            LOG_KNOWHERE_WARNING_ << "RAFT inner error, " << e.what();
+            return Status::raft_inner_error;
+        }
+        devs_.assign(bf_cfg.gpu_ids.value().begin(), bf_cfg.gpu_ids.value().end());
+        dim_ = dataset.GetDim();
+        is_ip_ = is_ip;
+        is_cosine_ = is_cosine;
+        return Status::success;
+    }
+
+    // The rows are appended to the ones on the host, and the device copy, if any, is made again from all of them.
+    Status
+    Add(const DataSet& dataset, const Config& cfg) override {
+        if (devs_.empty()) {
+            return Status::index_not_trained;
+        }
+        auto bf_cfg = static_cast<const RaftBruteForceConfig&>(cfg);
+        auto rows = dataset.GetRows();
+        auto* data = reinterpret_cast<const float*>(dataset.GetTensor());
+        auto first = host_data_.size();
+        host_data_.insert(host_data_.end(), data, data + rows * dim_);
+        if (is_cosine_) {
+            NormalizeVecs(host_data_.data() + first, rows, dim_);
+        }
+        counts_ += rows;
+        return Upload(bf_cfg.device_resident.value(), bf_cfg.build_chunk_rows.value());
+    }
+
+    expected<DataSetPtr>
+    Search(const DataSet& dataset, const Config& cfg, const BitsetView& bitset) const override {
+        if (devs_.empty()) {
+            LOG_KNOWHERE_WARNING_ << "search on empty index";
+            return expected<DataSetPtr>::Err(Status::empty_index, "index not loaded");
+        }
+        auto bf_cfg = static_cast<const RaftBruteForceConfig&>(cfg);
+        auto rows = dataset.GetRows();
+        auto k = bf_cfg.k.value();
+        KnnResultBuffers buffers(bf_cfg, rows * k);
+        auto status = SearchOnDevice(reinterpret_cast<const float*>(dataset.GetTensor()), rows, k, bf_cfg, bitset,
+                                     buffers.ids, buffers.distances);
+        if (status != Status::success) {
+            buffers.Free();
+            return expected<DataSetPtr>::Err(status, "RAFT brute force search failed");
+        }
+        return buffers.ToDataSet(rows, k);
+    }
+
+    // A knn search of MAX_BRUTE_FORCE_K, or max_results, of which the hits in range are kept: a query finds at most
+    // that many.
+    expected<DataSetPtr>
+    RangeSearch(const DataSet& dataset, const Config& cfg, const BitsetView& bitset) const override {
+        if (devs_.empty()) {
+            LOG_KNOWHERE_WARNING_ << "range search on empty index";
+            return expected<DataSetPtr>::Err(Status::empty_index, "index not loaded");
+        }
+        auto bf_cfg = static_cast<const RaftBruteForceConfig&>(cfg);
+        auto rows = dataset.GetRows();
+        int64_t max_results = bf_cfg.max_results.value();
+        int64_t k = max_results > 0 ? std::min<int64_t>(max_results, raft_bf_detail::MAX_BRUTE_FORCE_K)
+                                    : raft_bf_detail::MAX_BRUTE_FORCE_K;
+        k = std::max<int64_t>(1, std::min(k, counts_));
+        std::vector<int64_t> knn_ids(rows * k);
+        std::vector<float> knn_dis(rows * k);
+        auto status = SearchOnDevice(reinterpret_cast<const float*>(dataset.GetTensor()), rows, k, bf_cfg, bitset,
+                                     knn_ids.data(), knn_dis.data());
+        if (status != Status::success) {
+            return expected<DataSetPtr>::Err(status, "RAFT brute force search failed");
+        }
+
+        float radius = bf_cfg.radius.value();
+        float range_filter = bf_cfg.range_filter.value();
+        if (range_filter == defaultRangeFilter) {
+            range_filter = is_ip_ ? std::numeric_limits<float>::infinity() : -std::numeric_limits<float>::infinity();
+        }
+        RangeSearchResultBuilder results(rows, max_results, is_ip_);
+        for (int64_t i = 0; i < rows; ++i) {
+            auto ids = knn_ids.data() + i * k;
+            auto n = std::find(ids, ids + k, -1) - ids;
+            results.Query(i).Append(knn_dis.data() + i * k, ids, n, true, is_ip_, radius, range_filter);
+        }
+        int64_t* ids = nullptr;
+        float* distances = nullptr;
+        size_t* lims = nullptr;
+        auto owned = results.Build(bf_cfg, distances, ids, lims);
+        auto res = GenResultDataSet(rows, ids, distances, lims);
+        res->SetIsOwner(owned);
+        return res;
+    }
+
+    expected<DataSetPtr>
+    GetVectorByIds(const DataSet& dataset) const override {
+        if (is_cosine_) {
+            return expected<DataSetPtr>::Err(Status::not_implemented,
+                                             "RAFT brute force holds COSINE vectors normalized");
+        }
+        auto rows = dataset.GetRows();
+        auto ids = dataset.GetIds();
+        auto data = std::make_unique<float[]>(rows * dim_);
+        for (int64_t i = 0; i < rows; ++i) {
+            if (ids[i] < 0 || ids[i] >= counts_) {
+                return expected<DataSetPtr>::Err(Status::invalid_args, "id out of range");
+            }
+            std::memcpy(data.get() + i * dim_, host_data_.data() + ids[i] * dim_, dim_ * sizeof(float));
+        }
+        return GenResultDataSet(rows, dim_, data.release());
+    }
+
+    bool
+    HasRawData(const std::string& metric_type) const override {
+        return !IsMetricType(metric_type, metric::COSINE);
+    }
+
+    expected<DataSetPtr>
+    GetIndexMeta(const Config& cfg) const override {
+        return expected<DataSetPtr>::Err(Status::not_implemented, "GetIndexMeta not implemented");
+    }
+
+    Status
+    Serialize(BinarySet& binset) const override {
+        if (devs_.empty()) {
+            LOG_KNOWHERE_ERROR_ << "Can not serialize empty RaftBruteForceIndex.";
+            return Status::empty_index;
+        }
+        std::stringbuf buf;
+        std::ostream os(&buf);
+        os.write((char*)(&this->dim_), sizeof(this->dim_));
+        os.write((char*)(&this->counts_), sizeof(this->counts_));
+        os.write((char*)(&this->devs_[0]), sizeof(this->devs_[0]));
+        os.write((char*)(&this->is_ip_), sizeof(this->is_ip_));
+        os.write((char*)(&this->is_cosine_), sizeof(this->is_cosine_));
+        os.write((char*)host_data_.data(), host_data_.size() * sizeof(float));
+        os.flush();
+
+        std::shared_ptr<uint8_t[]> index_binary(new (std::nothrow) uint8_t[buf.str().size()]);
+        memcpy(index_binary.get(), buf.str().c_str(), buf.str().size());
+        binset.Append(this->Type(), index_binary, buf.str().size());
+        return Status::success;
+    }
+
+    Status
+    Deserialize(const BinarySet& binset, const Config& config) override {
+        auto binary = binset.GetByName(this->Type());
+        if (binary == nullptr) {
+            LOG_KNOWHERE_ERROR_ << "Invalid binary set.";
+            return Status::invalid_binary_set;
+        }
+        std::stringbuf buf;
+        buf.sputn((char*)binary->data.get(), binary->size);
+        std::istream is(&buf);
+
+        is.read((char*)(&this->dim_), sizeof(this->dim_));
+        is.read((char*)(&this->counts_), sizeof(this->counts_));
+        this->devs_.resize(1);
+        is.read((char*)(&this->devs_[0]), sizeof(this->devs_[0]));
+        is.read((char*)(&this->is_ip_), sizeof(this->is_ip_));
+        is.read((char*)(&this->is_cosine_), sizeof(this->is_cosine_));
+        host_data_.resize(counts_ * dim_);
+        is.read((char*)host_data_.data(), host_data_.size() * sizeof(float));
+        auto& bf_cfg = static_cast<const RaftBruteForceConfig&>(config);
+        if (bf_cfg.gpu_id.value() >= 0) {
+            this->devs_[0] = bf_cfg.gpu_id.value();
+        }
+        try {
+            auto scoped_device = raft_utils::device_setter{devs_[0]};
+            raft_utils::init_gpu_resources();
+        } catch (std::exception& e) {
+            LOG_KNOWHERE_WARNING_ << "RAFT inner error, " << e.what();
+            return Status::raft_inner_error;
+        }
+        return Upload(bf_cfg.device_resident.value(), bf_cfg.build_chunk_rows.value());
+    }
+
+    Status
+    DeserializeFromFile(const std::string& filename, const Config& config) override {
+        LOG_KNOWHERE_ERROR_ << "RaftBruteForceIndex doesn't support Deserialization from file.";
+        return Status::not_implemented;
+    }
+
+    std::unique_ptr<BaseConfig>
+    CreateConfig() const override {
+        return std::make_unique<RaftBruteForceConfig>();
+    }
+
+    int64_t
+    Dim() const override {
+        return dim_;
+    }
+
+    int64_t
+    Size() const override {
+        return counts_ * dim_ * sizeof(float);
+    }
+
+    MemoryUsage
+    GetMemoryUsage() const override {
+        MemoryUsage usage;
+        usage.Add(MemoryUsage::kVectors, MemoryUsage::kHeap, host_data_.capacity() * sizeof(float));
+        if (device_data_.has_value()) {
+            usage.Add(MemoryUsage::kVectors, MemoryUsage::kDevice, device_data_->size() * sizeof(float));
+        }
+        return usage;
+    }
+
+    int64_t
+    Count() const override {
+        return counts_;
+    }
+
+    std::string
+    Type() const override {
+        return knowhere::IndexEnum::INDEX_RAFT_BRUTE_FORCE;
+    }
+
+ private:
+    std::vector<int32_t> devs_;
+    int64_t dim_ = 0;
+    int64_t counts_ = 0;
+    bool is_ip_ = false;
+    bool is_cosine_ = false;
+    // the vectors, normalized for COSINE
+    std::vector<float> host_data_;
+    // the copy of host_data_ on the device, none when the searches stream the vectors
+    std::optional<raft::device_matrix<float, int64_t>> device_data_;
+    mutable DeviceBitsetCache bitset_cache_;
+
+    raft::distance::DistanceType
+    Metric() const {
+        return is_ip_ ? raft::distance::DistanceType::InnerProduct : raft::distance::DistanceType::L2Expanded;
+    }
+
+    // the copy of the vectors on the device when resident asks for one and they fit in half of its free memory
+    Status
+    Upload(bool resident, int64_t chunk_rows) {
+        try {
+            auto scoped_device = raft_utils::device_setter{devs_[0]};
+            device_data_.reset();
+            auto bytes = host_data_.size() * sizeof(float);
+            if (resident && bytes > 0) {
+                size_t free = 0;
+                size_t total = 0;
+                RAFT_CUDA_TRY(cudaMemGetInfo(&free, &total));
+                if (bytes > free / 2) {
+                    LOG_KNOWHERE_INFO_ << "RAFT brute force vectors of " << bytes << " bytes do not fit on the device, "
+                                       << free << " bytes free, the searches stream them";
+                    resident = false;
+                }
+            }
+            if (!resident || bytes == 0) {
+                return Status::success;
+            }
+            auto& res = raft_utils::get_build_resources();
+            auto data_gpu = raft::make_device_matrix<float, int64_t>(res, counts_, dim_);
+            raft_utils::stream_to_device(res, host_data_.data(), counts_, dim_, chunk_rows,
+                                         [&](int64_t first, const float* chunk, int64_t n) {
+                                             RAFT_CUDA_TRY(cudaMemcpyAsync(
+                                                 data_gpu.data_handle() + first * dim_, chunk, n * dim_ * sizeof(float),
+                                                 cudaMemcpyDeviceToDevice, res.get_stream().value()));
+                                         });
+            device_data_.emplace(std::move(data_gpu));
+            GetGpuMetrics(Type()).h2d_bytes.Increment(bytes);
+            raft_utils::report_memory_pool();
+        } catch (std::exception& e) {
+            LOG_KNOWHERE_WARNING_ << "RAFT inner error, " << e.what();
+            device_data_.reset();
+            return Status::raft_inner_error;
+        }
+        return Status::success;
+    }
+
+    // k results a query into ids and distances, the ids the bitset filters out or past the rows are -1
+    Status
+    SearchOnDevice(const float* queries, int64_t rows, int64_t k, const RaftBruteForceConfig& cfg,
+                   const BitsetView& bitset, int64_t* ids, float* distances) const {
+        std::vector<float> normalized;
+        if (is_cosine_) {
+            normalized.assign(queries, queries + rows * dim_);
+            NormalizeVecs(normalized.data(), rows, dim_);
+            queries = normalized.data();
+        }
+        try {
+            auto scoped_device = raft_utils::device_setter{devs_[0]};
+            auto& res = raft_utils::get_raft_resources();
+            auto stream = res.get_stream().value();
+            GpuStageTimer timer(GetGpuMetrics(Type()));
+            auto queries_gpu = raft::make_device_matrix<float, int64_t>(res, rows, dim_);
+            timer.Time(GpuStageTimer::kH2D, stream,
+                       [&] { raft::copy(queries_gpu.data_handle(), queries, rows * dim_, res.get_stream()); });
+            timer.H2D(rows * dim_ * sizeof(float));
+            auto queries_view = raft::make_const_mdspan(queries_gpu.view());
+            auto tile_rows = cfg.search_tile_rows.value();
+            raft_bf_detail::TopK top(res, rows, k, is_ip_);
+
+            auto filtered = std::min<int64_t>(bitset.empty() ? 0 : bitset.count(), counts_);
+            // the tiles a search streams upload while the ones before are searched, their copies are of the kernel
+            // stage
+            timer.Time(GpuStageTimer::kKernel, stream, [&] {
+                bool done = false;
+                if (device_data_.has_value() && filtered == 0) {
+                    SearchTile(res, queries_view, device_data_->data_handle(), counts_, nullptr, 0, top);
+                    done = true;
+                } else if (device_data_.has_value() && filtered <= counts_ * raft_bf_detail::MAX_OVERSAMPLED_FILTER) {
+                    std::vector<uint8_t> dense_bits;
+                    auto gpu_bitset =
+                        bitset_cache_.Get(res, devs_[0], bitset.to_dense(dense_bits), cfg.filter_version.value());
+                    done = OversampledSearch(res, queries_view, filtered, gpu_bitset->view(), top);
+                }
+                if (!done) {
+                    std::vector<int64_t> alive;
+                    if (filtered > 0) {
+                        alive.reserve(counts_ - filtered);
+                        for (size_t id = bitset.next_unset(0); id < size_t(counts_); id = bitset.next_unset(id + 1)) {
+                            alive.push_back(id);
+                        }
+                    }
+                    if (device_data_.has_value()) {
+                        GatheredSearch(res, queries_view, alive, tile_rows, top);
+                    } else {
+                        StreamedSearch(res, queries_view, filtered > 0 ? &alive : nullptr, tile_rows, top);
+                        timer.H2D((filtered > 0 ? static_cast<int64_t>(alive.size()) : counts_) * dim_ * sizeof(float));
+                    }
+                }
+            });
+            top.Finish(res, ids, distances, timer);
+            raft_utils::report_memory_pool();
+        } catch (std::exception& e) {
+            LOG_KNOWHERE_WARNING_ << "RAFT inner error, " << e.what();
+            return Status::raft_inner_error;
+        }
+        return Status::success;
+    }
+
+    // the k best of the n rows at tile on the device into top, their positions in the tile mapped through alive or
+    // past first
+    void
+    SearchTile(raft::device_resources& res, raft::device_matrix_view<const float, int64_t> queries, const float* tile,
+               int64_t n, const int64_t* alive, int64_t first, raft_bf_detail::TopK& top) const {
+        auto tile_k = std::min(top.k(), n);
+        auto results = raft_detail::raft_results{res, queries.extent(0), tile_k};
+        std::vector<raft::device_matrix_view<const float, int64_t>> index{
+            raft::make_device_matrix_view<const float, int64_t>(tile, n, dim_)};
+        raft::neighbors::brute_force::knn<int64_t, float, int64_t>(res, index, queries, results.ids(),
+                                                                   results.dists(), Metric());
+        top.Add(res, results.ids_data(), results.dists_data(), tile_k, tile_k, alive, first);
+    }
+
+    // A search of all the rows on the device with k grown by the share of them the filter drops, with a margin of a
+    // quarter of k for how unevenly the filter spreads over the queries, of which the ids the filter drops are removed.
+    // False when a query is left with fewer than k results.
+    bool
+    OversampledSearch(raft::device_resources& res, raft::device_matrix_view<const float, int64_t> queries,
+                      int64_t filtered, DeviceBitsetView const& bitset, raft_bf_detail::TopK& top) const {
+        auto k = top.k();
+        auto alive = counts_ - filtered;
+        auto search_k = std::min(counts_, k * counts_ / alive + k / 4 + 1);
+        if (search_k > raft_bf_detail::MAX_BRUTE_FORCE_K) {
+            return false;
+        }
+        auto rows = queries.extent(0);
+        auto results = raft_detail::raft_results{res, rows, search_k};
+        std::vector<raft::device_matrix_view<const float, int64_t>> index{
+            raft::make_device_matrix_view<const float, int64_t>(device_data_->data_handle(), counts_, dim_)};
+        raft::neighbors::brute_force::knn<int64_t, float, int64_t>(res, index, queries, results.ids(),
+                                                                   results.dists(), Metric());
+
+        auto blocks = std::min(rows, int64_t{1024});
+        auto threads = std::min(int(search_k), 256);
+        auto warp_remainder = threads % 32;
+        if (warp_remainder != 0) {
+            threads += (32 - warp_remainder);
+        }
+        auto enough_valid = raft::make_device_vector<bool>(res, rows);
+        raft_detail::postprocess_device_results<<<blocks, threads, 0, res.get_stream().value()>>>(
+            enough_valid.data_handle(), results.ids_data(), results.dists_data(), rows, search_k, std::min(k, alive),
+            bitset);
+        if (!thrust::all_of(res.get_thrust_policy(), enough_valid.data_handle(), enough_valid.data_handle() + rows,
+                            thrust::identity<bool>())) {
+            return false;
+        }
+        top.Add(res, results.ids_data(), results.dists_data(), search_k, std::min(k, search_k), nullptr, 0);
+        return true;
+    }
+
+    // the search of the rows alive of the ones on the device, gathered tile_rows at a time into a tile of their own
+    void
+    GatheredSearch(raft::device_resources& res, raft::device_matrix_view<const float, int64_t> queries,
+                   const std::vector<int64_t>& alive, int64_t tile_rows, raft_bf_detail::TopK& top) const {
+        int64_t n = alive.size();
+        if (n == 0) {
+            return;
+        }
+        auto stream = res.get_stream();
+        auto alive_gpu = raft::make_device_vector<int64_t, int64_t>(res, n);
+        raft::copy(alive_gpu.data_handle(), alive.data(), n, stream);
+        auto tile = raft::make_device_matrix<float, int64_t>(res, std::min(tile_rows, n), dim_);
+        for (int64_t begin = 0; begin < n; begin += tile_rows) {
+            auto m = std::min(tile_rows, n - begin);
+            raft_bf_detail::gather_rows<<<1024, 256, 0, stream.value()>>>(
+                tile.data_handle(), device_data_->data_handle(), alive_gpu.data_handle() + begin, m, dim_);
+            SearchTile(res, queries, tile.data_handle(), m, alive_gpu.data_handle() + begin, 0, top);
+        }
+    }
+
+    // The search of the rows on the host, all of them or the ones of alive, streamed to the device tile_rows at a time.
+    // The upload of a tile overlaps the search of the one before; the rows of alive are gathered on the host first, a
+    // tile at a time.
+    void
+    StreamedSearch(raft::device_resources& res, raft::device_matrix_view<const float, int64_t> queries,
+                   const std::vector<int64_t>* alive, int64_t tile_rows, raft_bf_detail::TopK& top) const {
+        if (alive == nullptr) {
+            raft_utils::stream_to_device(res, host_data_.data(), counts_, dim_, tile_rows,
+                                         [&](int64_t first, const float* chunk, int64_t n) {
+                                             SearchTile(res, queries, chunk, n, nullptr, first, top);
+                                         });
+            return;
+        }
+        int64_t n = alive->size();
+        if (n == 0) {
+            return;
+        }
+        auto alive_gpu = raft::make_device_vector<int64_t, int64_t>(res, n);
+        raft::copy(alive_gpu.data_handle(), alive->data(), n, res.get_stream());
+        std::vector<float> gathered;
+        for (int64_t begin = 0; begin < n; begin += tile_rows) {
+            auto m = std::min(tile_rows, n - begin);
+            gathered.resize(m * dim_);
+            for (int64_t i = 0; i < m; ++i) {
+                std::memcpy(gathered.data() + i * dim_, host_data_.data() + (*alive)[begin + i] * dim_,
+                            dim_ * sizeof(float));
+            }
+            // returns once the device is done with gathered
+            raft_utils::stream_to_device(res, gathered.data(), m, dim_, m,
+                                         [&](int64_t, const float* chunk, int64_t rows) {
+                                             SearchTile(res, queries, chunk, rows, alive_gpu.data_handle() + begin, 0,
+                                                        top);
+                                         });
+        }
+    }
+};
+
+KNOWHERE_REGISTER_GLOBAL(GPU_RAFT_BRUTE_FORCE, [](const Object& object) {
+    return Index<IndexNodeBatchingWrapper>::Create(std::make_unique<IndexNodeThreadPoolWrapper>(
+        std::make_unique<IndexNodeMultiGpuWrapper>([]() { return std::make_unique<RaftBruteForceIndexNode>(nullptr); }),
+        cuda_concurrent_size));
+});
+
+}  // namespace knowhere
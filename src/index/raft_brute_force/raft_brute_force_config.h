@@ -0,0 +1,70 @@
+// Copyright (C) 2019-2023 Zilliz. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file except in compliance
+// with the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
+// or implied. See the License for the specific language governing permissions and limitations under the License.
+
+#ifndef RAFT_BRUTE_FORCE_CONFIG_H
+#define RAFT_BRUTE_FORCE_CONFIG_H
+
+#include "knowhere/config.h"
+
+namespace knowhere {
+
+class RaftBruteForceConfig : public BaseConfig {
+ public:
+    CFG_LIST gpu_ids;
+    CFG_STRING multi_gpu_mode;
+    CFG_INT gpu_id;
+    CFG_INT build_chunk_rows;
+    CFG_BOOL device_resident;
+    CFG_INT search_tile_rows;
+    KNOHWERE_DECLARE_CONFIG(RaftBruteForceConfig) {
+        KNOWHERE_CONFIG_DECLARE_FIELD(k)
+            .set_default(10)
+            .description("search for top k similar vector.")
+            .set_range(1, 1024)
+            .for_search();
+        KNOWHERE_CONFIG_DECLARE_FIELD(gpu_ids)
+            .description("gpu device ids, the index is replicated or sharded over several of them")
+            .set_default({
+                0,
+            })
+            .for_train();
+        KNOWHERE_CONFIG_DECLARE_FIELD(multi_gpu_mode)
+            .description("how the index spans several gpu_ids: replicated or sharded")
+            .set_default("replicated")
+            .for_train();
+        KNOWHERE_CONFIG_DECLARE_FIELD(gpu_id)
+            .description("gpu device the index is loaded onto, -1 for the one it was built on")
+            .set_default(-1)
+            .for_deserialize();
+        KNOWHERE_CONFIG_DECLARE_FIELD(build_chunk_rows)
+            .description("rows of the data streamed to the gpu at a time through pinned memory")
+            .set_default(65536)
+            .set_range(1, std::numeric_limits<CFG_INT::value_type>::max())
+            .for_train()
+            .for_deserialize();
+        KNOWHERE_CONFIG_DECLARE_FIELD(device_resident)
+            .description("keep the vectors on the gpu when they fit in half of its free memory, else the searches "
+                         "stream them from host memory")
+            .set_default(true)
+            .for_train()
+            .for_deserialize();
+        KNOWHERE_CONFIG_DECLARE_FIELD(search_tile_rows)
+            .description("rows a search streams to the gpu, or gathers out of a filter, at a time")
+            .set_default(1 << 20)
+            .set_range(1, std::numeric_limits<CFG_INT::value_type>::max())
+            .for_search()
+            .for_range_search();
+    }
+};
+
+}  // namespace knowhere
+
+#endif /* RAFT_BRUTE_FORCE_CONFIG_H */
@@ -0,0 +1,51 @@
+// Copyright (C) 2019-2023 Zilliz. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file except in compliance
+// with the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
+// or implied. See the License for the specific language governing permissions and limitations under the License.
+
+#ifndef SPARSE_CONFIG_H
+#define SPARSE_CONFIG_H
+
+#include "knowhere/comp/index_param.h"
+#include "knowhere/config.h"
+#include "knowhere/utils.h"
+
+namespace knowhere {
+
+class SparseInvertedIndexConfig : public BaseConfig {
+ public:
+    CFG_FLOAT drop_ratio_build;
+    CFG_FLOAT drop_ratio_search;
+    KNOHWERE_DECLARE_CONFIG(SparseInvertedIndexConfig) {
+        KNOWHERE_CONFIG_DECLARE_FIELD(drop_ratio_build)
+            .set_default(0.0f)
+            .description("the fraction of the entries of each row dropped when added, the smallest ones.")
+            .set_range(0.0f, 0.99f)
+            .for_train();
+        KNOWHERE_CONFIG_DECLARE_FIELD(drop_ratio_search)
+            .set_default(0.0f)
+            .description("the fraction of the entries of each query left out of its search, the smallest ones.")
+            .set_range(0.0f, 0.99f)
+            .for_search()
+            .for_range_search();
+    }
+
+    inline Status
+    CheckAndAdjustForBuild() override {
+        if (!IsMetricType(metric_type.value(), metric::IP)) {
+            LOG_KNOWHERE_ERROR_ << "sparse inverted index only supports metric IP, not " << metric_type.value();
+            return Status::invalid_metric_type;
+        }
+        return Status::success;
+    }
+};
+
+}  // namespace knowhere
+
+#endif /* SPARSE_CONFIG_H */
@@ -0,0 +1,779 @@
+// Copyright (C) 2019-2023 Zilliz. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file except in compliance
+// with the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
+// or implied. See the License for the specific language governing permissions and limitations under the License.
+
+#include <sys/mman.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#include "common/knn_util.h"
+#include "common/range_util.h"
+#include "index/sparse/sparse_config.h"
+#include "io/fileIO.h"
+#include "io/index_file.h"
+#include "knowhere/comp/cancellation.h"
+#include "knowhere/comp/thread_pool.h"
+#include "knowhere/factory.h"
+#include "knowhere/log.h"
+
+namespace knowhere {
+
+namespace {
+
+// the CSR rows of a sparse dataset, see GenSparseDataSet
+struct SparseRows {
+    explicit SparseRows(const DataSet& dataset)
+        : rows(dataset.GetRows()),
+          offsets(static_cast<const int64_t*>(dataset.GetTensor())),
+          indices(reinterpret_cast<const int32_t*>(offsets + rows + 1)),
+          values(reinterpret_cast<const float*>(indices + offsets[rows])) {
+    }
+
+    int64_t rows;
+    const int64_t* offsets;
+    const int32_t* indices;
+    const float* values;
+};
+
+// the entries of row i, less the smallest drop_ratio of them
+std::vector<std::pair<int32_t, float>>
+RowEntries(const SparseRows& rows, int64_t i, float drop_ratio) {
+    std::vector<std::pair<int32_t, float>> entries;
+    entries.reserve(rows.offsets[i + 1] - rows.offsets[i]);
+    for (auto j = rows.offsets[i]; j < rows.offsets[i + 1]; ++j) {
+        entries.emplace_back(rows.indices[j], rows.values[j]);
+    }
+    auto keep = entries.size() - static_cast<size_t>(entries.size() * drop_ratio);
+    if (keep < entries.size()) {
+        std::nth_element(entries.begin(), entries.begin() + keep, entries.end(),
+                         [](const auto& a, const auto& b) { return a.second > b.second; });
+        entries.resize(keep);
+    }
+    return entries;
+}
+
+constexpr uint32_t kSparseMagic = 0x56495053;  // "SPIV"
+constexpr uint32_t kSparseVersion = 1;
+// the code of the largest weight of a dimension, a weight is quantized to code * scale of its dimension
+constexpr float kMaxCode = 255.0f;
+
+struct SparseHeader {
+    uint32_t magic;
+    uint32_t version;
+    int64_t rows;
+    int64_t dim;
+    int64_t nnz;
+};
+
+// the posting list of one dimension of a query, weight is the one of the query times the scale of the dimension
+struct Term {
+    const uint32_t* docs;
+    const uint8_t* codes;
+    size_t size;
+    float weight;
+};
+
+// Keeps the k largest scores pushed, as a min heap on the score.
+class TopK {
+ public:
+    explicit TopK(size_t k) : k_(k) {
+        heap_.reserve(k);
+    }
+
+    bool
+    Full() const {
+        return heap_.size() == k_;
+    }
+
+    // the score a result must pass to be kept once full
+    float
+    Threshold() const {
+        return heap_.front().first;
+    }
+
+    void
+    Push(float score, uint32_t doc) {
+        if (!Full()) {
+            heap_.emplace_back(score, doc);
+            std::push_heap(heap_.begin(), heap_.end(), Greater);
+        } else if (score > heap_.front().first) {
+            std::pop_heap(heap_.begin(), heap_.end(), Greater);
+            heap_.back() = {score, doc};
+            std::push_heap(heap_.begin(), heap_.end(), Greater);
+        }
+    }
+
+    // the results, largest first, the ones missing as -1
+    void
+    Write(int64_t* ids, float* distances) {
+        std::sort_heap(heap_.begin(), heap_.end(), Greater);
+        for (size_t i = 0; i < k_; ++i) {
+            ids[i] = i < heap_.size() ? heap_[i].second : -1;
+            distances[i] = i < heap_.size() ? heap_[i].first : std::numeric_limits<float>::lowest();
+        }
+    }
+
+ private:
+    static bool
+    Greater(const std::pair<float, uint32_t>& a, const std::pair<float, uint32_t>& b) {
+        return a.first > b.first || (a.first == b.first && a.second < b.second);
+    }
+
+    size_t k_;
+    std::vector<std::pair<float, uint32_t>> heap_;
+};
+
+// The scores of a query term at a time; the docs touched are the ones of a score, all of them positive.
+struct Accumulator {
+    std::vector<float> scores;
+    std::vector<uint32_t> touched;
+
+    void
+    Accumulate(const std::vector<Term>& terms, size_t rows) {
+        if (scores.size() < rows) {
+            scores.resize(rows, 0.0f);
+        }
+        for (auto& term : terms) {
+            for (size_t i = 0; i < term.size; ++i) {
+                auto doc = term.docs[i];
+                if (scores[doc] == 0.0f) {
+                    touched.push_back(doc);
+                }
+                scores[doc] += term.weight * term.codes[i];
+            }
+        }
+    }
+
+    // leaves the scores zeroed for the next query
+    void
+    Clear() {
+        for (auto doc : touched) {
+            scores[doc] = 0.0f;
+        }
+        touched.clear();
+    }
+
+    static Accumulator&
+    Local() {
+        thread_local Accumulator accumulator;
+        return accumulator;
+    }
+};
+
+// WAND: the lists are walked doc by doc in the order of their next docs, and a doc is scored only when the bounds of
+// the lists up to it pass the k-th score so far; the lists before such a pivot jump straight to its doc.
+void
+WandSearch(const std::vector<Term>& terms, const BitsetView& bitset, TopK& topk) {
+    struct Cursor {
+        Term term;
+        size_t pos;
+        float bound;
+
+        uint32_t
+        Doc() const {
+            return term.docs[pos];
+        }
+    };
+    std::vector<Cursor> cursors;
+    cursors.reserve(terms.size());
+    for (auto& term : terms) {
+        cursors.push_back({term, 0, term.weight * kMaxCode});
+    }
+    std::vector<Cursor*> order;
+    for (auto& cursor : cursors) {
+        order.push_back(&cursor);
+    }
+    auto by_doc = [](const Cursor* a, const Cursor* b) { return a->Doc() < b->Doc(); };
+    std::sort(order.begin(), order.end(), by_doc);
+    while (!order.empty()) {
+        float threshold = topk.Full() ? topk.Threshold() : 0.0f;
+        float bound = 0.0f;
+        size_t pivot = 0;
+        for (; pivot < order.size(); ++pivot) {
+            bound += order[pivot]->bound;
+            if (bound > threshold) {
+                break;
+            }
+        }
+        if (pivot == order.size()) {
+            break;
+        }
+        auto pivot_doc = order[pivot]->Doc();
+        if (order[0]->Doc() == pivot_doc) {
+            float score = 0.0f;
+            for (size_t i = 0; i < order.size() && order[i]->Doc() == pivot_doc; ++i) {
+                score += order[i]->term.weight * order[i]->term.codes[order[i]->pos];
+                ++order[i]->pos;
+            }
+            if (bitset.empty() || !bitset.test(pivot_doc)) {
+                topk.Push(score, pivot_doc);
+            }
+        } else {
+            // no doc before the pivot one passes the threshold
+            for (size_t i = 0; i < pivot; ++i) {
+                auto& term = order[i]->term;
+                auto next = std::lower_bound(term.docs + order[i]->pos, term.docs + term.size, pivot_doc);
+                order[i]->pos = next - term.docs;
+            }
+        }
+        order.erase(std::remove_if(order.begin(), order.end(),
+                                   [](const Cursor* cursor) { return cursor->pos == cursor->term.size; }),
+                    order.end());
+        std::sort(order.begin(), order.end(), by_doc);
+    }
+}
+
+// Every score is exact, so the first Refill computes them all and the iteration only pops the heap.
+class SparseIterator : public IndexIterator {
+ public:
+    SparseIterator(std::vector<Term> terms, size_t rows, const BitsetView& bitset)
+        : IndexIterator(true), terms_(std::move(terms)), rows_(rows), bitset_(bitset) {
+    }
+
+ protected:
+    Status
+    Refill(int64_t wanted, bool& exhausted) override {
+        auto& accumulator = Accumulator::Local();
+        accumulator.Accumulate(terms_, rows_);
+        for (auto doc : accumulator.touched) {
+            if (bitset_.empty() || !bitset_.test(doc)) {
+                Push(accumulator.scores[doc], doc);
+            }
+        }
+        accumulator.Clear();
+        exhausted = true;
+        return Status::success;
+    }
+
+ private:
+    std::vector<Term> terms_;
+    size_t rows_;
+    BitsetView bitset_;
+};
+
+}  // namespace
+
+/**
+ * @brief An inverted index of sparse rows for the inner product, see GenSparseDataSet for their layout. The posting
+ * list of a dimension holds the rows of an entry in it, in the order they were added, and their weights quantized to
+ * a byte: the largest weight of the dimension is 255 times its scale, a weight quantized to 0 is dropped. The weights
+ * are the values of the entries, which must not be negative. A search scores the rows in the lists of the dimensions
+ * of the query: SPARSE_INVERTED_INDEX all of them, SPARSE_WAND only the ones whose bound may pass the top k, see
+ * WandSearch. The scores are the inner products with the quantized weights.
+ *
+ * The lists are kept flat, the offsets of each dimension into the rows and codes of all of them, so an index loaded
+ * with enable_mmap searches them in its file as they are.
+ */
+template <bool use_wand>
+class SparseInvertedIndexNode : public IndexNode {
+ public:
+    SparseInvertedIndexNode(const Object&) {
+        search_pool_ = ThreadPool::GetGlobalSearchThreadPool();
+    }
+
+    ~SparseInvertedIndexNode() override {
+        Unmap();
+    }
+
+    Status
+    Train(const DataSet& dataset, const Config& cfg) override {
+        if (!dataset.IsSparse()) {
+            LOG_KNOWHERE_WARNING_ << Type() << " only takes sparse rows";
+            return Status::invalid_args;
+        }
+        Unmap();
+        rows_ = 0;
+        dim_ = 0;
+        offsets_buf_.assign(1, 0);
+        scales_buf_.clear();
+        docs_buf_.clear();
+        codes_buf_.clear();
+        SetViews();
+        trained_ = true;
+        return Status::success;
+    }
+
+    Status
+    Add(const DataSet& dataset, const Config& cfg) override {
+        if (!trained_) {
+            return Status::index_not_trained;
+        }
+        if (!dataset.IsSparse()) {
+            LOG_KNOWHERE_WARNING_ << Type() << " only takes sparse rows";
+            return Status::invalid_args;
+        }
+        const auto& s_cfg = static_cast<const SparseInvertedIndexConfig&>(cfg);
+        SparseRows rows(dataset);
+        if (rows_ + rows.rows > std::numeric_limits<uint32_t>::max()) {
+            LOG_KNOWHERE_WARNING_ << Type() << " holds up to " << std::numeric_limits<uint32_t>::max() << " rows";
+            return Status::invalid_args;
+        }
+        // the entries added of each dimension
+        std::vector<std::vector<std::pair<uint32_t, float>>> added(std::max(dim_, dataset.GetDim()));
+        for (int64_t i = 0; i < rows.rows; ++i) {
+            for (auto& [index, value] : RowEntries(rows, i, s_cfg.drop_ratio_build.value())) {
+                if (index < 0 || value < 0.0f || !std::isfinite(value)) {
+                    LOG_KNOWHERE_WARNING_ << "invalid sparse entry " << index << ": " << value;
+                    return Status::invalid_args;
+                }
+                if (static_cast<size_t>(index) >= added.size()) {
+                    added.resize(index + 1);
+                }
+                added[index].emplace_back(rows_ + i, value);
+            }
+        }
+
+        Materialize();
+        int64_t dim = added.size();
+        std::vector<uint64_t> offsets(dim + 1, 0);
+        std::vector<float> scales(dim, 0.0f);
+        std::vector<uint32_t> docs;
+        std::vector<uint8_t> codes;
+        docs.reserve(docs_buf_.size());
+        codes.reserve(codes_buf_.size());
+        for (int64_t d = 0; d < dim; ++d) {
+            float old_scale = d < dim_ ? scales_buf_[d] : 0.0f;
+            float max = old_scale * kMaxCode;
+            for (auto& entry : added[d]) {
+                max = std::max(max, entry.second);
+            }
+            scales[d] = max / kMaxCode;
+            // the codes of the dimension are quantized again when a larger weight is added to it
+            float ratio = scales[d] > 0.0f ? old_scale / scales[d] : 0.0f;
+            uint64_t begin = d < dim_ ? offsets_buf_[d] : 0;
+            uint64_t end = d < dim_ ? offsets_buf_[d + 1] : 0;
+            for (auto i = begin; i < end; ++i) {
+                auto code = ratio == 1.0f ? codes_buf_[i] : static_cast<uint8_t>(std::lround(codes_buf_[i] * ratio));
+                if (code > 0) {
+                    docs.push_back(docs_buf_[i]);
+                    codes.push_back(code);
+                }
+            }
+            for (auto& [doc, value] : added[d]) {
+                auto code = static_cast<uint8_t>(std::lround(value / scales[d]));
+                if (code > 0) {
+                    docs.push_back(doc);
+                    codes.push_back(code);
+                }
+            }
+            offsets[d + 1] = docs.size();
+        }
+        rows_ += rows.rows;
+        dim_ = dim;
+        offsets_buf_ = std::move(offsets);
+        scales_buf_ = std::move(scales);
+        docs_buf_ = std::move(docs);
+        codes_buf_ = std::move(codes);
+        SetViews();
+        return Status::success;
+    }
+
+    expected<DataSetPtr>
+    Search(const DataSet& dataset, const Config& cfg, const BitsetView& bitset) const override {
+        if (!trained_) {
+            LOG_KNOWHERE_WARNING_ << "search on empty index";
+            return expected<DataSetPtr>::Err(Status::empty_index, "index not loaded");
+        }
+        if (!dataset.IsSparse()) {
+            return expected<DataSetPtr>::Err(Status::invalid_args, Type() + " only takes sparse queries");
+        }
+        const auto& s_cfg = static_cast<const SparseInvertedIndexConfig&>(cfg);
+        auto k = s_cfg.k.value();
+        auto nq = dataset.GetRows();
+        SparseRows queries(dataset);
+        auto drop_ratio = s_cfg.drop_ratio_search.value();
+
+        auto cancellation = s_cfg.cancellation.get();
+        KnnResultBuffers buffers(s_cfg, k * nq);
+        search_pool_->parallel_for(0, nq, 1, [&](int64_t i) {
+            CancellationToken::Scope scope(cancellation);
+            TopK topk(k);
+            if (!CancellationToken::CurrentCancelled()) {
+                auto terms = Terms(queries, i, drop_ratio);
+                if constexpr (use_wand) {
+                    WandSearch(terms, bitset, topk);
+                } else {
+                    auto& accumulator = Accumulator::Local();
+                    accumulator.Accumulate(terms, rows_);
+                    for (auto doc : accumulator.touched) {
+                        if (bitset.empty() || !bitset.test(doc)) {
+                            topk.Push(accumulator.scores[doc], doc);
+                        }
+                    }
+                    accumulator.Clear();
+                }
+            }
+            topk.Write(buffers.ids + i * k, buffers.distances + i * k);
+        });
+        if (cancellation != nullptr && cancellation->IsCancelled()) {
+            buffers.Free();
+            return expected<DataSetPtr>::Err(Status::search_cancelled, "search cancelled");
+        }
+        return buffers.ToDataSet(nq, k);
+    }
+
+    expected<DataSetPtr>
+    RangeSearch(const DataSet& dataset, const Config& cfg, const BitsetView& bitset) const override {
+        if (!trained_) {
+            LOG_KNOWHERE_WARNING_ << "range search on empty index";
+            return expected<DataSetPtr>::Err(Status::empty_index, "index not loaded");
+        }
+        if (!dataset.IsSparse()) {
+            return expected<DataSetPtr>::Err(Status::invalid_args, Type() + " only takes sparse queries");
+        }
+        const auto& s_cfg = static_cast<const SparseInvertedIndexConfig&>(cfg);
+        auto nq = dataset.GetRows();
+        SparseRows queries(dataset);
+        auto drop_ratio = s_cfg.drop_ratio_search.value();
+        float radius = s_cfg.radius.value();
+        float range_filter = s_cfg.range_filter.value();
+        bool filter = range_filter != defaultRangeFilter;
+
+        RangeSearchResultBuilder results(nq, s_cfg.max_results.value(), true);
+        search_pool_->parallel_for(0, nq, 1, [&](int64_t i) {
+            auto writer = results.Query(i);
+            auto& accumulator = Accumulator::Local();
+            accumulator.Accumulate(Terms(queries, i, drop_ratio), rows_);
+            for (auto doc : accumulator.touched) {
+                auto score = accumulator.scores[doc];
+                if (score > radius && (!filter || distance_in_range(score, radius, range_filter, true)) &&
+                    (bitset.empty() || !bitset.test(doc))) {
+                    writer.Add(score, doc);
+                }
+            }
+            accumulator.Clear();
+        });
+        int64_t* ids = nullptr;
+        float* distances = nullptr;
+        size_t* lims = nullptr;
+        bool owned = results.Build(s_cfg, distances, ids, lims);
+        auto res = GenResultDataSet(nq, ids, distances, lims);
+        res->SetIsOwner(owned);
+        return res;
+    }
+
+    expected<std::vector<IndexIteratorPtr>>
+    AnnIterator(const DataSet& dataset, const Config& cfg, const BitsetView& bitset) const override {
+        if (!trained_) {
+            LOG_KNOWHERE_WARNING_ << "iterator on empty index";
+            return expected<std::vector<IndexIteratorPtr>>::Err(Status::empty_index, "index not loaded");
+        }
+        if (!dataset.IsSparse()) {
+            return expected<std::vector<IndexIteratorPtr>>::Err(Status::invalid_args,
+                                                                Type() + " only takes sparse queries");
+        }
+        const auto& s_cfg = static_cast<const SparseInvertedIndexConfig&>(cfg);
+        SparseRows queries(dataset);
+        std::vector<IndexIteratorPtr> iterators(queries.rows);
+        for (int64_t i = 0; i < queries.rows; ++i) {
+            iterators[i] =
+                std::make_shared<SparseIterator>(Terms(queries, i, s_cfg.drop_ratio_search.value()), rows_, bitset);
+        }
+        return iterators;
+    }
+
+    expected<DataSetPtr>
+    GetVectorByIds(const DataSet& dataset) const override {
+        return expected<DataSetPtr>::Err(Status::not_implemented, "the rows of " + Type() + " are not kept");
+    }
+
+    bool
+    HasRawData(const std::string& metric_type) const override {
+        // the weights are quantized
+        return false;
+    }
+
+    expected<DataSetPtr>
+    GetIndexMeta(const Config& cfg) const override {
+        return expected<DataSetPtr>::Err(Status::not_implemented, "GetIndexMeta not implemented");
+    }
+
+    // the header, then the offsets, the scales, the docs and the codes of the lists
+    Status
+    Serialize(BinarySet& binset) const override {
+        if (!trained_) {
+            LOG_KNOWHERE_ERROR_ << "Can not serialize empty index.";
+            return Status::empty_index;
+        }
+        SparseHeader header{kSparseMagic, kSparseVersion, rows_, dim_, static_cast<int64_t>(offsets_[dim_])};
+        auto size = SerializedSize(header);
+        std::shared_ptr<uint8_t[]> data(new uint8_t[size]);
+        auto p = data.get();
+        p = std::copy_n(reinterpret_cast<const uint8_t*>(&header), sizeof(header), p);
+        p = std::copy_n(reinterpret_cast<const uint8_t*>(offsets_), (dim_ + 1) * sizeof(uint64_t), p);
+        p = std::copy_n(reinterpret_cast<const uint8_t*>(scales_), dim_ * sizeof(float), p);
+        p = std::copy_n(reinterpret_cast<const uint8_t*>(docs_), header.nnz * sizeof(uint32_t), p);
+        std::copy_n(codes_, header.nnz, p);
+        binset.Append(Type(), data, size);
+        return Status::success;
+    }
+
+    Status
+    Deserialize(const BinarySet& binset, const Config& config) override {
+        auto binary = binset.GetByName(Type());
+        if (binary == nullptr) {
+            LOG_KNOWHERE_ERROR_ << "Invalid binary set.";
+            return Status::invalid_binary_set;
+        }
+        Unmap();
+        return Load(binary->data.get(), binary->size, true);
+    }
+
+    Status
+    DeserializeFromFile(const std::string& filename, const Config& config) override {
+        const auto& cfg = static_cast<const BaseConfig&>(config);
+        Unmap();
+        try {
+            auto reader = FileReader(filename);
+            // the index is a section of a knowhere index file when file_size is set
+            size_t offset = cfg.file_offset;
+            size_t size = cfg.file_size != 0 ? cfg.file_size : reader.size() - offset;
+            if (offset + size > reader.size()) {
+                reader.close();
+                LOG_KNOWHERE_ERROR_ << "index out of the bounds of file " << filename;
+                return Status::invalid_index_file;
+            }
+            if (!cfg.enable_mmap.value_or(false)) {
+                auto data = std::make_unique<uint8_t[]>(size);
+                reader.seek(offset);
+                size_t read = 0;
+                while (read < size) {
+                    auto n = reader.read(reinterpret_cast<char*>(data.get()) + read, size - read);
+                    if (n <= 0) {
+                        break;
+                    }
+                    read += n;
+                }
+                reader.close();
+                if (read < size) {
+                    LOG_KNOWHERE_ERROR_ << "failed to read " << filename;
+                    return Status::invalid_index_file;
+                }
+                return Load(data.get(), size, true);
+            }
+            int flags = MAP_SHARED;
+            if (cfg.mmap_populate.value_or(false)) {
+                flags |= MAP_POPULATE;
+            }
+            map_size_ = reader.size();
+            auto addr = mmap(nullptr, map_size_, PROT_READ, flags, reader.descriptor(), 0);
+            reader.close();
+            if (addr == MAP_FAILED) {
+                LOG_KNOWHERE_ERROR_ << "failed to map " << filename << ": " << std::strerror(errno);
+                return Status::invalid_index_file;
+            }
+            map_ = static_cast<uint8_t*>(addr);
+            auto status = IndexFile::Advise(addr, map_size_, cfg);
+            if (status == Status::success) {
+                status = Load(map_ + offset, size, false);
+            }
+            if (status != Status::success) {
+                Unmap();
+            }
+            return status;
+        } catch (const std::exception& e) {
+            LOG_KNOWHERE_WARNING_ << "failed to load " << filename << ": " << e.what();
+            return Status::invalid_index_file;
+        }
+    }
+
+    void
+    SetSearchPool(std::shared_ptr<ThreadPool> pool) override {
+        search_pool_ = std::move(pool);
+    }
+
+    std::shared_ptr<ThreadPool>
+    AsyncSearchPool() const override {
+        return search_pool_;
+    }
+
+    std::unique_ptr<BaseConfig>
+    CreateConfig() const override {
+        return std::make_unique<SparseInvertedIndexConfig>();
+    }
+
+    int64_t
+    Dim() const override {
+        return dim_;
+    }
+
+    int64_t
+    Size() const override {
+        return GetMemoryUsage().Total();
+    }
+
+    MemoryUsage
+    GetMemoryUsage() const override {
+        MemoryUsage usage;
+        if (!trained_) {
+            return usage;
+        }
+        auto residency = map_ != nullptr ? MemoryUsage::kMmap : MemoryUsage::kHeap;
+        auto nnz = offsets_[dim_];
+        usage.Add(MemoryUsage::kLists, residency,
+                  (dim_ + 1) * sizeof(uint64_t) + nnz * (sizeof(uint32_t) + sizeof(uint8_t)));
+        usage.Add(MemoryUsage::kCodebooks, residency, dim_ * sizeof(float));
+        usage.Add(MemoryUsage::kOther, MemoryUsage::kHeap, sizeof(*this));
+        return usage;
+    }
+
+    void
+    MappedRegions(std::vector<MappedRegion>& regions) const override {
+        if (map_ != nullptr) {
+            regions.push_back({data_, data_size_});
+        }
+    }
+
+    int64_t
+    Count() const override {
+        return rows_;
+    }
+
+    std::string
+    Type() const override {
+        if constexpr (use_wand) {
+            return knowhere::IndexEnum::INDEX_SPARSE_WAND;
+        } else {
+            return knowhere::IndexEnum::INDEX_SPARSE_INVERTED_INDEX;
+        }
+    }
+
+ private:
+    static size_t
+    SerializedSize(const SparseHeader& header) {
+        return sizeof(header) + (header.dim + 1) * sizeof(uint64_t) + header.dim * sizeof(float) +
+               header.nnz * (sizeof(uint32_t) + sizeof(uint8_t));
+    }
+
+    // the lists of the dimensions of query i in the index, a dimension the index has none of is left out
+    std::vector<Term>
+    Terms(const SparseRows& queries, int64_t i, float drop_ratio) const {
+        std::vector<Term> terms;
+        for (auto& [index, value] : RowEntries(queries, i, drop_ratio)) {
+            if (index < 0 || index >= dim_ || value <= 0.0f || offsets_[index] == offsets_[index + 1]) {
+                continue;
+            }
+            auto begin = offsets_[index];
+            terms.push_back({docs_ + begin, codes_ + begin, offsets_[index + 1] - begin, value * scales_[index]});
+        }
+        return terms;
+    }
+
+    // points the lists at the serialized index in data, copied unless it stays mapped
+    Status
+    Load(const uint8_t* data, size_t size, bool copy) {
+        SparseHeader header;
+        if (size < sizeof(header)) {
+            LOG_KNOWHERE_ERROR_ << "truncated " << Type();
+            return Status::invalid_binary_set;
+        }
+        std::memcpy(&header, data, sizeof(header));
+        if (header.magic != kSparseMagic || header.version != kSparseVersion || header.rows < 0 || header.dim < 0 ||
+            header.nnz < 0 || SerializedSize(header) != size) {
+            LOG_KNOWHERE_ERROR_ << "not a " << Type() << " of version " << kSparseVersion << " or truncated";
+            return Status::invalid_binary_set;
+        }
+        auto offsets = reinterpret_cast<const uint64_t*>(data + sizeof(header));
+        auto scales = reinterpret_cast<const float*>(offsets + header.dim + 1);
+        auto docs = reinterpret_cast<const uint32_t*>(scales + header.dim);
+        auto codes = reinterpret_cast<const uint8_t*>(docs + header.nnz);
+        if (offsets[header.dim] != static_cast<uint64_t>(header.nnz)) {
+            LOG_KNOWHERE_ERROR_ << "corrupted " << Type();
+            return Status::invalid_binary_set;
+        }
+        rows_ = header.rows;
+        dim_ = header.dim;
+        if (copy) {
+            offsets_buf_.assign(offsets, offsets + dim_ + 1);
+            scales_buf_.assign(scales, scales + dim_);
+            docs_buf_.assign(docs, docs + header.nnz);
+            codes_buf_.assign(codes, codes + header.nnz);
+            SetViews();
+        } else {
+            offsets_buf_ = {};
+            scales_buf_ = {};
+            docs_buf_ = {};
+            codes_buf_ = {};
+            offsets_ = offsets;
+            scales_ = scales;
+            docs_ = docs;
+            codes_ = codes;
+            data_ = data;
+            data_size_ = size;
+        }
+        trained_ = true;
+        return Status::success;
+    }
+
+    void
+    SetViews() {
+        offsets_ = offsets_buf_.data();
+        scales_ = scales_buf_.data();
+        docs_ = docs_buf_.data();
+        codes_ = codes_buf_.data();
+    }
+
+    // copies the lists of a mapped index into memory, so that they may change
+    void
+    Materialize() {
+        if (map_ == nullptr) {
+            return;
+        }
+        auto nnz = offsets_[dim_];
+        offsets_buf_.assign(offsets_, offsets_ + dim_ + 1);
+        scales_buf_.assign(scales_, scales_ + dim_);
+        docs_buf_.assign(docs_, docs_ + nnz);
+        codes_buf_.assign(codes_, codes_ + nnz);
+        SetViews();
+        Unmap();
+    }
+
+    void
+    Unmap() {
+        if (map_ != nullptr) {
+            munmap(map_, map_size_);
+            map_ = nullptr;
+            map_size_ = 0;
+            data_ = nullptr;
+            data_size_ = 0;
+        }
+    }
+
+    bool trained_ = false;
+    int64_t rows_ = 0;
+    int64_t dim_ = 0;
+    // offsets_[d] to offsets_[d + 1] are the entries of dimension d in docs_ and codes_, the docs in ascending order
+    const uint64_t* offsets_ = nullptr;
+    const float* scales_ = nullptr;
+    const uint32_t* docs_ = nullptr;
+    const uint8_t* codes_ = nullptr;
+    // the lists held in memory, the views point into them unless the index is mapped
+    std::vector<uint64_t> offsets_buf_;
+    std::vector<float> scales_buf_;
+    std::vector<uint32_t> docs_buf_;
+    std::vector<uint8_t> codes_buf_;
+    // the mapping of the whole file and the index in it
+    uint8_t* map_ = nullptr;
+    size_t map_size_ = 0;
+    const uint8_t* data_ = nullptr;
+    size_t data_size_ = 0;
+    std::shared_ptr<ThreadPool> search_pool_;
+};
+
+KNOWHERE_REGISTER_GLOBAL(SPARSE_INVERTED_INDEX, [](const Object& object) {
+    return Index<SparseInvertedIndexNode<false>>::Create(object);
+});
+KNOWHERE_REGISTER_GLOBAL(SPARSE_WAND,
+                         [](const Object& object) { return Index<SparseInvertedIndexNode<true>>::Create(object); });
+
+}  // namespace knowhere
@@ -12,6 +12,7 @@
 #include "io/FaissIO.h"
 
 #include <cstring>
+#include <stdexcept>
 
 namespace knowhere {
 
@@ -22,6 +23,11 @@ size_t
 MemoryIOWriter::operator()(const void* ptr, size_t size, size_t nitems) {
     auto total_need = size * nitems + rp;
 
+    if (count_only) {
+        rp = total_need;
+        return nitems;
+    }
+
     if (!data_) {  // data == nullptr
         total = total_need * magic_num;
         rp = size * nitems;
@@ -47,6 +53,28 @@ MemoryIOWriter::operator()(const void* ptr, size_t size, size_t nitems) {
     return nitems;
 }
 
+void
+MemoryIOWriter::reserve(size_t size) {
+    if (size <= total) {
+        return;
+    }
+    auto new_data = new uint8_t[size];
+    if (data_) {
+        memcpy(new_data, data_, rp);
+        delete[] data_;
+    }
+    data_ = new_data;
+    total = size;
+}
+
+size_t
+SectionIOWriter::operator()(const void* ptr, size_t size, size_t nitems) {
+    if (sink_.Write(ptr, size * nitems) != Status::success) {
+        throw std::runtime_error("failed to write a section of the index");
+    }
+    return nitems;
+}
+
 size_t
 MemoryIOReader::operator()(void* ptr, size_t size, size_t nitems) {
     if (rp >= total) {
@@ -61,4 +89,14 @@ MemoryIOReader::operator()(void* ptr, size_t size, size_t nitems) {
     return nitems;
 }
 
+const uint8_t*
+MemoryIOReader::borrow(size_t size) {
+    if (rp > total || total - rp < size) {
+        return nullptr;
+    }
+    auto ptr = data_ + rp;
+    rp += size;
+    return ptr;
+}
+
 }  // namespace knowhere
@@ -13,6 +13,15 @@
 
 #include <faiss/impl/io.h>
 
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include "knowhere/binaryset.h"
+
 namespace knowhere {
 
 #if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
@@ -75,10 +84,16 @@ struct MemoryIOWriter : public faiss::IOWriter {
     uint8_t* data_ = nullptr;
     size_t total = 0;
     size_t rp = 0;
+    // only counts the bytes written in rp, see SerializeToMemory
+    bool count_only = false;
 
     size_t
     operator()(const void* ptr, size_t size, size_t nitems) override;
 
+    // allocates the buffer once for size bytes, the writes up to it then neither grow nor copy it
+    void
+    reserve(size_t size);
+
     template <typename T>
     size_t
     write(T* ptr, size_t size, size_t nitems = 1) {
@@ -92,6 +107,30 @@ struct MemoryIOWriter : public faiss::IOWriter {
     }
 };
 
+// A faiss writer of the section begun last in a SectionWriter, for the writers of faiss and hnswlib to stream an
+// index through; throws when the section writer fails, as the faiss writers do.
+struct SectionIOWriter : public faiss::IOWriter {
+    explicit SectionIOWriter(SectionWriter& sink) : sink_(sink) {
+    }
+
+    size_t
+    operator()(const void* ptr, size_t size, size_t nitems) override;
+
+    template <typename T>
+    size_t
+    write(T* ptr, size_t size, size_t nitems = 1) {
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        for (size_t i = 0; i < nitems; ++i) {
+            *(ptr + i) = getSwappedBytes(*(ptr + i));
+        }
+#endif
+        return operator()((const void*)ptr, size, nitems);
+    }
+
+ private:
+    SectionWriter& sink_;
+};
+
 struct MemoryIOReader : public faiss::IOReader {
     uint8_t* data_;
     size_t rp = 0;
@@ -100,6 +139,11 @@ struct MemoryIOReader : public faiss::IOReader {
     size_t
     operator()(void* ptr, size_t size, size_t nitems) override;
 
+    // the next size bytes in place in the source buffer rather than copied out, nullptr when fewer remain; valid as
+    // long as the source buffer is
+    const uint8_t*
+    borrow(size_t size) override;
+
     template <typename T>
     size_t
     read(T* ptr, size_t size, size_t nitems = 1) {
@@ -114,4 +158,45 @@ struct MemoryIOReader : public faiss::IOReader {
     }
 };
 
+/**
+ * @brief Serializes with write(MemoryIOWriter&) into one buffer allocated at its final size: a first run only
+ * counts the bytes, the second writes them. The buffer then never grows, so there are no copies on growth and no
+ * moment with the old and the new buffer both alive, which doubled the memory of serializing a large index.
+ *
+ * @return the buffer and its size, as BinarySet::Append takes them
+ */
+template <typename Func>
+std::pair<std::shared_ptr<uint8_t[]>, size_t>
+SerializeToMemory(Func&& write) {
+    MemoryIOWriter writer;
+#if __BYTE_ORDER__ != __ORDER_BIG_ENDIAN__
+    // on big endian hosts MemoryIOWriter::write swaps the bytes of its source in place, it must run once only
+    MemoryIOWriter counter;
+    counter.count_only = true;
+    write(counter);
+    writer.reserve(counter.rp);
+#endif
+    try {
+        write(writer);
+    } catch (...) {
+        delete[] writer.data_;
+        throw;
+    }
+    return {std::shared_ptr<uint8_t[]>(writer.data_), writer.rp};
+}
+
+/**
+ * @brief A faiss reader of the file positioned at offset, where the index starts in a section of a knowhere index
+ * file (0 for a file of its own). The IO_FLAG_MMAP loaders of faiss map the whole file and take the ftell of the
+ * reader as the offset into it, so they load from a section in place too.
+ */
+inline std::unique_ptr<faiss::FileIOReader>
+OpenFaissFile(const std::string& filename, size_t offset) {
+    auto reader = std::make_unique<faiss::FileIOReader>(filename.data());
+    if (offset != 0 && fseek(reader->f, offset, SEEK_SET) != 0) {
+        throw std::runtime_error("failed to seek to the index in " + filename);
+    }
+    return reader;
+}
+
 }  // namespace knowhere
@@ -0,0 +1,530 @@
+// Copyright (C) 2019-2023 Zilliz. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file except in compliance
+// with the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
+// or implied. See the License for the specific language governing permissions and limitations under the License
+
+#include "io/index_file.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <memory>
+
+#include "knowhere/log.h"
+
+namespace knowhere {
+
+namespace {
+
+constexpr char kMagic[8] = {'K', 'N', 'O', 'W', 'H', 'I', 'D', 'X'};
+constexpr uint32_t kVersion = 1;
+
+struct FileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t section_count;
+    uint64_t table_checksum;
+    uint64_t file_size;
+    uint8_t reserved[32];
+};
+static_assert(sizeof(FileHeader) == 64);
+
+struct TableEntry {
+    char name[96];
+    uint64_t offset;
+    uint64_t size;
+    uint64_t checksum;
+    uint64_t reserved;
+};
+static_assert(sizeof(TableEntry) == 128);
+
+uint64_t
+AlignUp(uint64_t n) {
+    return (n + IndexFile::kAlignment - 1) / IndexFile::kAlignment * IndexFile::kAlignment;
+}
+
+class Fd {
+ public:
+    explicit Fd(int fd) : fd_(fd) {
+    }
+
+    ~Fd() {
+        if (fd_ >= 0) {
+            close(fd_);
+        }
+    }
+
+    Fd(const Fd&) = delete;
+
+    Fd&
+    operator=(const Fd&) = delete;
+
+    int
+    get() const {
+        return fd_;
+    }
+
+ private:
+    int fd_;
+};
+
+bool
+WriteAll(int fd, const void* data, size_t size, uint64_t offset) {
+    auto ptr = static_cast<const uint8_t*>(data);
+    while (size > 0) {
+        auto n = pwrite(fd, ptr, size, offset);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        ptr += n;
+        size -= n;
+        offset += n;
+    }
+    return true;
+}
+
+bool
+ReadAll(int fd, void* data, size_t size, uint64_t offset) {
+    auto ptr = static_cast<uint8_t*>(data);
+    while (size > 0) {
+        auto n = pread(fd, ptr, size, offset);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        ptr += n;
+        size -= n;
+        offset += n;
+    }
+    return true;
+}
+
+inline uint64_t
+Rotl(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+// the round of xxh64, four independent lanes keep the multiplier busy
+constexpr uint64_t kPrime1 = 0x9E3779B185EBCA87ULL;
+constexpr uint64_t kPrime2 = 0xC2B2AE3D27D4EB4FULL;
+constexpr uint64_t kPrime3 = 0x165667B19E3779F9ULL;
+
+inline uint64_t
+Round(uint64_t acc, uint64_t word) {
+    return Rotl(acc + word * kPrime2, 31) * kPrime1;
+}
+
+struct Mapping {
+    void* addr;
+    size_t size;
+    ~Mapping() {
+        munmap(addr, size);
+    }
+};
+
+}  // namespace
+
+IndexFile::Hasher::Hasher() : acc_{kPrime1 + kPrime2, kPrime2, 0, 0 - kPrime1} {
+}
+
+void
+IndexFile::Hasher::Update(const uint8_t* data, size_t size) {
+    if (size == 0) {
+        return;
+    }
+    total_ += size;
+    auto round = [this](const uint8_t* block) {
+        for (int lane = 0; lane < 4; ++lane) {
+            uint64_t word;
+            std::memcpy(&word, block + lane * 8, 8);
+            acc_[lane] = Round(acc_[lane], word);
+        }
+    };
+    if (tail_size_ > 0) {
+        size_t n = std::min(size, sizeof(tail_) - tail_size_);
+        std::memcpy(tail_ + tail_size_, data, n);
+        tail_size_ += n;
+        data += n;
+        size -= n;
+        if (tail_size_ < sizeof(tail_)) {
+            return;
+        }
+        round(tail_);
+        tail_size_ = 0;
+    }
+    for (; size >= 32; data += 32, size -= 32) {
+        round(data);
+    }
+    std::memcpy(tail_, data, size);
+    tail_size_ = size;
+}
+
+uint64_t
+IndexFile::Hasher::Digest() const {
+    uint64_t h = Rotl(acc_[0], 1) + Rotl(acc_[1], 7) + Rotl(acc_[2], 12) + Rotl(acc_[3], 18) + total_;
+    for (size_t i = 0; i < tail_size_; ++i) {
+        h = Rotl(h ^ (tail_[i] * kPrime3), 11) * kPrime1;
+    }
+    h ^= h >> 33;
+    h *= kPrime2;
+    h ^= h >> 29;
+    return h;
+}
+
+uint64_t
+IndexFile::Checksum(const uint8_t* data, size_t size) {
+    Hasher hasher;
+    hasher.Update(data, size);
+    return hasher.Digest();
+}
+
+bool
+IndexFile::Is(const std::string& filename) {
+    Fd fd(open(filename.c_str(), O_RDONLY));
+    char magic[sizeof(kMagic)];
+    return fd.get() >= 0 && ReadAll(fd.get(), magic, sizeof(magic), 0) &&
+           std::memcmp(magic, kMagic, sizeof(kMagic)) == 0;
+}
+
+Status
+IndexFile::Write(const std::string& filename, const BinarySet& binset) {
+    std::vector<TableEntry> entries(binset.binary_map_.size());
+    uint64_t offset = AlignUp(sizeof(FileHeader) + entries.size() * sizeof(TableEntry));
+    size_t i = 0;
+    for (auto& [name, binary] : binset.binary_map_) {
+        auto& entry = entries[i++];
+        std::memset(&entry, 0, sizeof(entry));
+        if (name.size() >= sizeof(entry.name)) {
+            LOG_KNOWHERE_ERROR_ << "section name too long for an index file: " << name;
+            return Status::invalid_args;
+        }
+        std::memcpy(entry.name, name.data(), name.size());
+        entry.offset = offset;
+        entry.size = binary->size;
+        entry.checksum = Checksum(binary->data.get(), binary->size);
+        offset = AlignUp(offset + binary->size);
+    }
+
+    FileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.section_count = entries.size();
+    header.table_checksum =
+        Checksum(reinterpret_cast<const uint8_t*>(entries.data()), entries.size() * sizeof(TableEntry));
+    header.file_size = offset;
+
+    Fd fd(open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644));
+    if (fd.get() < 0) {
+        LOG_KNOWHERE_ERROR_ << "failed to open index file " << filename << ": " << std::strerror(errno);
+        return Status::invalid_index_file;
+    }
+    bool ok = WriteAll(fd.get(), &header, sizeof(header), 0) &&
+              WriteAll(fd.get(), entries.data(), entries.size() * sizeof(TableEntry), sizeof(header));
+    i = 0;
+    for (auto& [name, binary] : binset.binary_map_) {
+        ok = ok && WriteAll(fd.get(), binary->data.get(), binary->size, entries[i++].offset);
+    }
+    // the padding of the last section, so that every section maps whole pages
+    ok = ok && ftruncate(fd.get(), offset) == 0;
+    if (!ok) {
+        LOG_KNOWHERE_ERROR_ << "failed to write index file " << filename << ": " << std::strerror(errno);
+        return Status::invalid_index_file;
+    }
+    return Status::success;
+}
+
+IndexFile::Writer::~Writer() {
+    if (fd_ < 0) {
+        return;
+    }
+    Wait();
+    close(fd_);
+    unlink(filename_.c_str());
+}
+
+Status
+IndexFile::Writer::Open(const std::string& filename, bool direct_io) {
+    filename_ = filename;
+    int flags = O_WRONLY | O_CREAT | O_TRUNC;
+    fd_ = direct_io ? open(filename.c_str(), flags | O_DIRECT, 0644) : -1;
+    if (direct_io && fd_ < 0) {
+        LOG_KNOWHERE_INFO_ << "no direct io on " << filename << ", writing through the page cache: "
+                           << std::strerror(errno);
+    }
+    if (fd_ < 0) {
+        fd_ = open(filename.c_str(), flags, 0644);
+    }
+    if (fd_ < 0) {
+        LOG_KNOWHERE_ERROR_ << "failed to open index file " << filename << ": " << std::strerror(errno);
+        return Status::invalid_index_file;
+    }
+    for (auto& block : blocks_) {
+        block.reset(static_cast<uint8_t*>(aligned_alloc(kAlignment, kBlockSize)));
+        if (block == nullptr) {
+            return Status::malloc_error;
+        }
+    }
+    return Status::success;
+}
+
+Status
+IndexFile::Writer::Begin(const std::string& name) {
+    if ((sizeof(FileHeader) + (sections_.size() + 1) * sizeof(TableEntry)) > kAlignment ||
+        name.size() >= sizeof(TableEntry::name) || in_section_) {
+        LOG_KNOWHERE_ERROR_ << "can not begin section " << name << " of index file " << filename_;
+        return Status::invalid_args;
+    }
+    sections_.push_back({name, offset_, 0, 0});
+    hasher_ = Hasher();
+    in_section_ = true;
+    return Status::success;
+}
+
+Status
+IndexFile::Writer::Write(const void* data, size_t size) {
+    auto ptr = static_cast<const uint8_t*>(data);
+    hasher_.Update(ptr, size);
+    sections_.back().size += size;
+    while (size > 0) {
+        size_t n = std::min(size, kBlockSize - filled_);
+        std::memcpy(blocks_[block_].get() + filled_, ptr, n);
+        filled_ += n;
+        ptr += n;
+        size -= n;
+        if (filled_ == kBlockSize) {
+            RETURN_IF_ERROR(Flush(kBlockSize));
+        }
+    }
+    return Status::success;
+}
+
+Status
+IndexFile::Writer::End() {
+    // the section is padded to the alignment the next one starts at
+    size_t padded = AlignUp(filled_);
+    std::memset(blocks_[block_].get() + filled_, 0, padded - filled_);
+    if (padded > 0) {
+        RETURN_IF_ERROR(Flush(padded));
+    }
+    sections_.back().checksum = hasher_.Digest();
+    in_section_ = false;
+    return Status::success;
+}
+
+Status
+IndexFile::Writer::Flush(size_t size) {
+    RETURN_IF_ERROR(Wait());
+    pending_ = std::async(std::launch::async, [fd = fd_, data = blocks_[block_].get(), size, offset = offset_]() {
+        return WriteAll(fd, data, size, offset);
+    });
+    block_ ^= 1;
+    filled_ = 0;
+    offset_ += size;
+    return Status::success;
+}
+
+Status
+IndexFile::Writer::Wait() {
+    if (pending_.valid() && !pending_.get()) {
+        LOG_KNOWHERE_ERROR_ << "failed to write index file " << filename_;
+        return Status::invalid_index_file;
+    }
+    return Status::success;
+}
+
+Status
+IndexFile::Writer::Close() {
+    if (in_section_) {
+        return Status::invalid_args;
+    }
+    RETURN_IF_ERROR(Wait());
+    // the header and the table fill the first block of the file, written last so that a file cut short has no magic
+    auto head = blocks_[block_].get();
+    std::memset(head, 0, kAlignment);
+    auto entries = reinterpret_cast<TableEntry*>(head + sizeof(FileHeader));
+    for (size_t i = 0; i < sections_.size(); ++i) {
+        std::memcpy(entries[i].name, sections_[i].name.data(), sections_[i].name.size());
+        entries[i].offset = sections_[i].offset;
+        entries[i].size = sections_[i].size;
+        entries[i].checksum = sections_[i].checksum;
+    }
+    auto header = reinterpret_cast<FileHeader*>(head);
+    std::memcpy(header->magic, kMagic, sizeof(kMagic));
+    header->version = kVersion;
+    header->section_count = sections_.size();
+    header->table_checksum = Checksum(reinterpret_cast<const uint8_t*>(entries), sections_.size() * sizeof(TableEntry));
+    header->file_size = offset_;
+    if (!WriteAll(fd_, head, kAlignment, 0) || ftruncate(fd_, offset_) != 0) {
+        LOG_KNOWHERE_ERROR_ << "failed to write index file " << filename_ << ": " << std::strerror(errno);
+        return Status::invalid_index_file;
+    }
+    close(fd_);
+    fd_ = -1;
+    return Status::success;
+}
+
+Status
+IndexFile::ReadTable(const std::string& filename, std::vector<Section>& sections) {
+    Fd fd(open(filename.c_str(), O_RDONLY));
+    struct stat st;
+    FileHeader header;
+    if (fd.get() < 0 || fstat(fd.get(), &st) != 0 || !ReadAll(fd.get(), &header, sizeof(header), 0)) {
+        LOG_KNOWHERE_ERROR_ << "failed to read index file " << filename << ": " << std::strerror(errno);
+        return Status::invalid_index_file;
+    }
+    if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 || header.version != kVersion ||
+        header.file_size != static_cast<uint64_t>(st.st_size)) {
+        LOG_KNOWHERE_ERROR_ << "not a knowhere index file of version " << kVersion << " or truncated: " << filename;
+        return Status::invalid_index_file;
+    }
+    std::vector<TableEntry> entries(header.section_count);
+    if (!ReadAll(fd.get(), entries.data(), entries.size() * sizeof(TableEntry), sizeof(header)) ||
+        Checksum(reinterpret_cast<const uint8_t*>(entries.data()), entries.size() * sizeof(TableEntry)) !=
+            header.table_checksum) {
+        LOG_KNOWHERE_ERROR_ << "corrupted section table in index file " << filename;
+        return Status::invalid_index_file;
+    }
+    sections.clear();
+    for (auto& entry : entries) {
+        if (entry.offset % kAlignment != 0 || entry.offset + entry.size > header.file_size) {
+            LOG_KNOWHERE_ERROR_ << "section out of the bounds of index file " << filename;
+            return Status::invalid_index_file;
+        }
+        sections.push_back({std::string(entry.name, strnlen(entry.name, sizeof(entry.name))), entry.offset,
+                            entry.size, entry.checksum});
+    }
+    return Status::success;
+}
+
+Status
+IndexFile::Verify(const std::string& filename, const Section& section) {
+    Fd fd(open(filename.c_str(), O_RDONLY));
+    if (fd.get() < 0) {
+        return Status::invalid_index_file;
+    }
+    if (section.size == 0) {
+        return section.checksum == Checksum(nullptr, 0) ? Status::success : Status::invalid_index_file;
+    }
+    auto addr = mmap(nullptr, section.size, PROT_READ, MAP_PRIVATE, fd.get(), section.offset);
+    if (addr == MAP_FAILED) {
+        LOG_KNOWHERE_ERROR_ << "failed to map index file " << filename << ": " << std::strerror(errno);
+        return Status::invalid_index_file;
+    }
+    Mapping mapping{addr, section.size};
+    madvise(addr, section.size, MADV_SEQUENTIAL);
+    if (Checksum(static_cast<const uint8_t*>(addr), section.size) != section.checksum) {
+        LOG_KNOWHERE_ERROR_ << "checksum mismatch of section " << section.name << " in index file " << filename;
+        return Status::invalid_index_file;
+    }
+    return Status::success;
+}
+
+std::string
+IndexFile::SharedMemoryPath(const std::string& name) {
+    return "/dev/shm/" + name;
+}
+
+Status
+IndexFile::Publish(const std::string& name, const BinarySet& binset) {
+    if (name.empty() || name.find('/') != std::string::npos) {
+        LOG_KNOWHERE_ERROR_ << "invalid shared memory name " << name;
+        return Status::invalid_args;
+    }
+    // written aside and renamed, the processes attaching meanwhile see the previous object or none
+    auto path = SharedMemoryPath(name);
+    auto tmp = path + ".publishing." + std::to_string(getpid());
+    auto status = Write(tmp, binset);
+    if (status == Status::success && rename(tmp.c_str(), path.c_str()) != 0) {
+        LOG_KNOWHERE_ERROR_ << "failed to publish index " << name << ": " << std::strerror(errno);
+        status = Status::invalid_index_file;
+    }
+    if (status != Status::success) {
+        unlink(tmp.c_str());
+    }
+    return status;
+}
+
+Status
+IndexFile::Unpublish(const std::string& name) {
+    if (name.empty() || name.find('/') != std::string::npos) {
+        return Status::invalid_args;
+    }
+    if (shm_unlink(("/" + name).c_str()) != 0) {
+        LOG_KNOWHERE_ERROR_ << "failed to unpublish index " << name << ": " << std::strerror(errno);
+        return Status::invalid_index_file;
+    }
+    return Status::success;
+}
+
+Status
+IndexFile::Advise(void* addr, size_t size, const BaseConfig& cfg) {
+    auto advice = cfg.mmap_advice.value_or("NORMAL");
+    int flag;
+    if (advice == "NORMAL") {
+        flag = MADV_NORMAL;
+    } else if (advice == "RANDOM") {
+        flag = MADV_RANDOM;
+    } else if (advice == "SEQUENTIAL") {
+        flag = MADV_SEQUENTIAL;
+    } else if (advice == "WILLNEED") {
+        flag = MADV_WILLNEED;
+    } else {
+        LOG_KNOWHERE_ERROR_ << "unknown mmap advice " << advice;
+        return Status::invalid_args;
+    }
+    if (flag != MADV_NORMAL && madvise(addr, size, flag) != 0) {
+        LOG_KNOWHERE_WARNING_ << "madvise " << advice << " failed: " << std::strerror(errno);
+    }
+    return Status::success;
+}
+
+Status
+IndexFile::Map(const std::string& filename, const BaseConfig& cfg, BinarySet& binset) {
+    std::vector<Section> sections;
+    RETURN_IF_ERROR(ReadTable(filename, sections));
+    Fd fd(open(filename.c_str(), O_RDONLY));
+    struct stat st;
+    if (fd.get() < 0 || fstat(fd.get(), &st) != 0) {
+        return Status::invalid_index_file;
+    }
+    size_t size = st.st_size;
+    int flags = MAP_PRIVATE;
+    if (cfg.mmap_populate.value_or(false)) {
+        flags |= MAP_POPULATE;
+    }
+    auto addr = mmap(nullptr, size, PROT_READ | PROT_WRITE, flags, fd.get(), 0);
+    if (addr == MAP_FAILED) {
+        LOG_KNOWHERE_ERROR_ << "failed to map index file " << filename << ": " << std::strerror(errno);
+        return Status::invalid_index_file;
+    }
+    auto mapping = std::shared_ptr<Mapping>(new Mapping{addr, size});
+    RETURN_IF_ERROR(Advise(addr, size, cfg));
+    auto base = static_cast<uint8_t*>(addr);
+    for (auto& section : sections) {
+        if (cfg.verify_checksum.value_or(true) && Checksum(base + section.offset, section.size) != section.checksum) {
+            LOG_KNOWHERE_ERROR_ << "checksum mismatch of section " << section.name << " in index file " << filename;
+            return Status::invalid_index_file;
+        }
+        binset.Append(section.name, std::shared_ptr<uint8_t[]>(mapping, base + section.offset), section.size);
+    }
+    return Status::success;
+}
+
+}  // namespace knowhere
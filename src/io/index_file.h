@@ -0,0 +1,169 @@
+// Copyright (C) 2019-2023 Zilliz. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file except in compliance
+// with the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
+// or implied. See the License for the specific language governing permissions and limitations under the License
+
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "knowhere/binaryset.h"
+#include "knowhere/config.h"
+#include "knowhere/expected.h"
+
+namespace knowhere {
+
+/**
+ * @brief The knowhere index file, one container for the BinarySet of any index type:
+ *
+ *   header   magic, version, section count, checksum of the table
+ *   table    per section its name, offset, size and checksum, one kEntrySize record each
+ *   sections each starting on a kAlignment boundary, so a section maps in place with the alignment of its own file
+ *
+ * The integers are little endian. A section holds the bytes of one entry of the BinarySet as is, the one named after
+ * the index type is the same stream the index reads from a file of its own.
+ */
+class IndexFile {
+ public:
+    struct Section {
+        std::string name;
+        uint64_t offset;
+        uint64_t size;
+        uint64_t checksum;
+    };
+
+    constexpr static uint64_t kAlignment = 4096;
+
+    // Checksum of bytes given in pieces, the same as of all of them at once
+    class Hasher {
+     public:
+        Hasher();
+
+        void
+        Update(const uint8_t* data, size_t size);
+
+        uint64_t
+        Digest() const;
+
+     private:
+        uint64_t acc_[4];
+        uint8_t tail_[32];
+        size_t tail_size_ = 0;
+        size_t total_ = 0;
+    };
+
+    /**
+     * @brief Writes an index file section by section as it is serialized, rather than from a BinarySet of all of it,
+     * see IndexNode::SerializeToFile. The bytes are gathered into large aligned blocks, each written in the
+     * background while the next one fills, and with direct_io bypass the page cache (O_DIRECT) where the file system
+     * supports it. The table has room for the sections of the first kAlignment bytes, the file is complete once
+     * Closed and removed if the writer is destroyed before.
+     */
+    class Writer : public SectionWriter {
+     public:
+        constexpr static size_t kBlockSize = size_t(8) << 20;
+
+        Writer() = default;
+
+        ~Writer() override;
+
+        Writer(const Writer&) = delete;
+
+        Writer&
+        operator=(const Writer&) = delete;
+
+        Status
+        Open(const std::string& filename, bool direct_io = false);
+
+        Status
+        Begin(const std::string& name) override;
+
+        Status
+        Write(const void* data, size_t size) override;
+
+        Status
+        End() override;
+
+        // writes the header and the table
+        Status
+        Close();
+
+     private:
+        // writes the block filled so far, size bytes of it, at offset_ in the background
+        Status
+        Flush(size_t size);
+
+        Status
+        Wait();
+
+        std::string filename_;
+        int fd_ = -1;
+        std::vector<Section> sections_;
+        bool in_section_ = false;
+        Hasher hasher_;
+        std::unique_ptr<uint8_t, decltype(&free)> blocks_[2] = {{nullptr, &free}, {nullptr, &free}};
+        int block_ = 0;
+        size_t filled_ = 0;
+        uint64_t offset_ = kAlignment;
+        std::future<bool> pending_;
+    };
+
+    // whether the file starts with the magic of an index file
+    static bool
+    Is(const std::string& filename);
+
+    static Status
+    Write(const std::string& filename, const BinarySet& binset);
+
+    // the section table, checked against its checksum and the size of the file
+    static Status
+    ReadTable(const std::string& filename, std::vector<Section>& sections);
+
+    // checks the bytes of the section in the file against its checksum
+    static Status
+    Verify(const std::string& filename, const Section& section);
+
+    /**
+     * @brief Maps the file and appends its sections to binset, their data point into the mapping and keep it alive.
+     * The mapping is private, a loader writing to a section gets a copy of the page, the file never changes. The
+     * mmap_populate, mmap_advice and verify_checksum of the config apply.
+     */
+    static Status
+    Map(const std::string& filename, const BaseConfig& cfg, BinarySet& binset);
+
+    // the path of the POSIX shared memory object name, which the loaders then open as any file; a memfd received
+    // from another process opens the same way as /proc/self/fd/<fd>
+    static std::string
+    SharedMemoryPath(const std::string& name);
+
+    /**
+     * @brief Writes binset as an index file into the POSIX shared memory object name, for the processes of the host
+     * to Map it rather than read a copy each. The object appears once complete, replacing one of the same name, and
+     * stays until Unpublish; the mappings of it outlive that.
+     */
+    static Status
+    Publish(const std::string& name, const BinarySet& binset);
+
+    static Status
+    Unpublish(const std::string& name);
+
+    // applies the mmap_advice of the config to a mapping, MADV_WILLNEED prefetches it
+    static Status
+    Advise(void* addr, size_t size, const BaseConfig& cfg);
+
+    static uint64_t
+    Checksum(const uint8_t* data, size_t size);
+};
+
+}  // namespace knowhere
@@ -0,0 +1,141 @@
+// Copyright (C) 2019-2023 Zilliz. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file except in compliance
+// with the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
+// or implied. See the License for the specific language governing permissions and limitations under the License.
+
+#if defined(__x86_64__)
+#include "distances_amx.h"
+
+#include <immintrin.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace faiss {
+
+namespace {
+
+// a tile holds 16 rows of 64 bytes: 32 bf16 of a row of x, 16 pairs of bf16 of 16 rows of y, or 16 fp32 sums
+constexpr size_t kTileRows = 16;
+constexpr size_t kTileDim = 32;
+// each step multiplies 2 tiles of x by 2 tiles of y into 4 tiles of sums
+constexpr size_t kBlock = 2 * kTileRows;
+
+struct alignas(64) TileConfig {
+    uint8_t palette_id;
+    uint8_t start_row;
+    uint8_t reserved[14];
+    uint16_t colsb[16];
+    uint8_t rows[16];
+};
+
+inline size_t
+round_up(size_t n, size_t align) {
+    return (n + align - 1) / align * align;
+}
+
+// 16 floats to bf16, rounded to nearest even
+inline __m256i
+to_bf16(__m512 v) {
+    __m512i bits = _mm512_castps_si512(v);
+    __m512i lsb = _mm512_and_si512(_mm512_srli_epi32(bits, 16), _mm512_set1_epi32(1));
+    bits = _mm512_add_epi32(bits, _mm512_add_epi32(lsb, _mm512_set1_epi32(0x7fff)));
+    return _mm512_cvtepi32_epi16(_mm512_srli_epi32(bits, 16));
+}
+
+// a row of d floats to dp bf16, zero past d
+inline void
+row_to_bf16(uint16_t* out, const float* row, size_t d, size_t dp) {
+    for (size_t k = 0; k < dp; k += 16) {
+        __mmask16 mask = k >= d ? 0 : (d - k >= 16 ? 0xffff : (__mmask16)((1u << (d - k)) - 1));
+        _mm256_storeu_si256((__m256i*)(out + k), to_bf16(_mm512_maskz_loadu_ps(mask, row + k)));
+    }
+}
+
+}  // namespace
+
+void
+fvec_inner_products_gemm_amx(float* ip, const float* x, const float* y, size_t d, size_t nx, size_t ny) {
+    if (nx == 0 || ny == 0) {
+        return;
+    }
+    const size_t dp = round_up(d, kTileDim);
+    const size_t nchunks = dp / kTileDim;
+    const size_t nxp = round_up(nx, kBlock);
+    const size_t nyp = round_up(ny, kBlock);
+
+    // x row by row; the rows past nx are zero
+    std::vector<uint16_t> xp(nxp * dp, 0);
+    for (size_t i = 0; i < nx; i++) {
+        row_to_bf16(xp.data() + i * dp, x + i * d, d, dp);
+    }
+    // y by groups of 16 rows, each chunk of 32 dims of a group a tile of 16 rows of 16 pairs, the pairs of a row
+    // being the same 2 dims of the 16 rows of the group
+    std::vector<uint32_t> yp(nyp * dp / 2, 0);
+    std::vector<uint16_t> row(dp);
+    for (size_t j = 0; j < ny; j++) {
+        row_to_bf16(row.data(), y + j * d, d, dp);
+        const uint32_t* pairs = (const uint32_t*)row.data();
+        uint32_t* group = yp.data() + (j / kTileRows) * nchunks * kTileRows * kTileRows;
+        for (size_t p = 0; p < dp / 2; p++) {
+            group[p * kTileRows + j % kTileRows] = pairs[p];
+        }
+    }
+
+    TileConfig cfg = {};
+    cfg.palette_id = 1;
+    for (int t = 0; t < 8; t++) {
+        cfg.colsb[t] = 64;
+        cfg.rows[t] = kTileRows;
+    }
+    _tile_loadconfig(&cfg);
+
+    const size_t x_stride = dp * sizeof(uint16_t);
+    const size_t y_group = nchunks * kTileRows * kTileRows;
+    alignas(64) float sums[kBlock * kBlock];
+    for (size_t i0 = 0; i0 < nxp; i0 += kBlock) {
+        const uint16_t* x0 = xp.data() + i0 * dp;
+        const uint16_t* x1 = x0 + kTileRows * dp;
+        for (size_t j0 = 0; j0 < nyp; j0 += kBlock) {
+            const uint32_t* y0 = yp.data() + (j0 / kTileRows) * y_group;
+            const uint32_t* y1 = y0 + y_group;
+            _tile_zero(0);
+            _tile_zero(1);
+            _tile_zero(2);
+            _tile_zero(3);
+            for (size_t c = 0; c < nchunks; c++) {
+                _tile_loadd(4, x0 + c * kTileDim, x_stride);
+                _tile_loadd(5, x1 + c * kTileDim, x_stride);
+                _tile_loadd(6, y0 + c * kTileRows * kTileRows, 64);
+                _tile_loadd(7, y1 + c * kTileRows * kTileRows, 64);
+                _tile_dpbf16ps(0, 4, 6);
+                _tile_dpbf16ps(1, 4, 7);
+                _tile_dpbf16ps(2, 5, 6);
+                _tile_dpbf16ps(3, 5, 7);
+            }
+            _tile_stored(0, sums, kBlock * sizeof(float));
+            _tile_stored(1, sums + kTileRows, kBlock * sizeof(float));
+            _tile_stored(2, sums + kTileRows * kBlock, kBlock * sizeof(float));
+            _tile_stored(3, sums + kTileRows * kBlock + kTileRows, kBlock * sizeof(float));
+
+            const size_t ni = std::min(kBlock, nx - i0);
+            const size_t nj = std::min(kBlock, ny - j0);
+            for (size_t i = 0; i < ni; i++) {
+                for (size_t j = 0; j < nj; j++) {
+                    ip[(i0 + i) * ny + j0 + j] = sums[i * kBlock + j];
+                }
+            }
+        }
+    }
+    _tile_release();
+}
+
+}  // namespace faiss
+#endif
@@ -0,0 +1,27 @@
+// Copyright (C) 2019-2023 Zilliz. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file except in compliance
+// with the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
+// or implied. See the License for the specific language governing permissions and limitations under the License.
+
+#ifndef DISTANCES_AMX_H
+#define DISTANCES_AMX_H
+
+#include <cstddef>
+
+namespace faiss {
+
+/// the inner products of the nx vectors x and the ny vectors y of d floats, ip[i * ny + j], multiplied in bf16 AMX
+/// tiles and summed in fp32. Built with -mamx-tile -mamx-bf16 and hooked only when the cpu supports AMX and the
+/// kernel granted the process its tile data
+void
+fvec_inner_products_gemm_amx(float* ip, const float* x, const float* y, size_t d, size_t nx, size_t ny);
+
+}  // namespace faiss
+
+#endif /* DISTANCES_AMX_H */
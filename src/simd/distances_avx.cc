@@ -16,6 +16,10 @@
 #include <immintrin.h>
 
 #include <cassert>
+#include <cmath>
+#include <cstring>
+
+#include "distances_sse.h"
 
 namespace faiss {
 
@@ -195,5 +199,786 @@ fvec_Linf_avx(const float* x, const float* y, size_t d) {
     return _mm_cvtss_f32(msum2);
 }
 
+// per 64-bit lane popcount, 4-bit lookups summed with sad (Mula et al.)
+static inline __m256i
+popcount_epi64_avx(__m256i v) {
+    const __m256i lookup =
+        _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4, 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i low_mask = _mm256_set1_epi8(0x0f);
+    __m256i lo = _mm256_and_si256(v, low_mask);
+    __m256i hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), low_mask);
+    __m256i cnt = _mm256_add_epi8(_mm256_shuffle_epi8(lookup, lo), _mm256_shuffle_epi8(lookup, hi));
+    return _mm256_sad_epu8(cnt, _mm256_setzero_si256());
+}
+
+static inline int
+reduce_add_epi64_avx(__m256i v) {
+    __m128i s = _mm_add_epi64(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+    return _mm_cvtsi128_si64(s) + _mm_extract_epi64(s, 1);
+}
+
+static inline __m256i
+load_code_avx(const uint8_t* p) {
+    return _mm256_loadu_si256((const __m256i*)p);
+}
+
+// the last code_size % 32 bytes
+static inline int
+hamming_tail(const uint8_t* x, const uint8_t* y, size_t n) {
+    int accu = 0;
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        uint64_t a, b;
+        std::memcpy(&a, x + i, sizeof(a));
+        std::memcpy(&b, y + i, sizeof(b));
+        accu += __builtin_popcountll(a ^ b);
+    }
+    for (; i < n; i++) {
+        accu += __builtin_popcount(x[i] ^ y[i]);
+    }
+    return accu;
+}
+
+static inline void
+jaccard_tail(const uint8_t* x, const uint8_t* y, size_t n, int& num, int& den) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        uint64_t a, b;
+        std::memcpy(&a, x + i, sizeof(a));
+        std::memcpy(&b, y + i, sizeof(b));
+        num += __builtin_popcountll(a & b);
+        den += __builtin_popcountll(a | b);
+    }
+    for (; i < n; i++) {
+        num += __builtin_popcount(x[i] & y[i]);
+        den += __builtin_popcount(x[i] | y[i]);
+    }
+}
+
+static inline float
+jaccard_from_counts(int num, int den) {
+    return (den == 0) ? 1.0f : (float)(den - num) / (float)den;
+}
+
+int
+bvec_hamming_avx(const uint8_t* x, const uint8_t* y, size_t code_size) {
+    __m256i msum = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 32 <= code_size; i += 32) {
+        __m256i mxor = _mm256_xor_si256(load_code_avx(x + i), load_code_avx(y + i));
+        msum = _mm256_add_epi64(msum, popcount_epi64_avx(mxor));
+    }
+    return reduce_add_epi64_avx(msum) + hamming_tail(x + i, y + i, code_size - i);
+}
+
+float
+bvec_jaccard_avx(const uint8_t* x, const uint8_t* y, size_t code_size) {
+    __m256i mnum = _mm256_setzero_si256();
+    __m256i mden = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 32 <= code_size; i += 32) {
+        __m256i mx = load_code_avx(x + i);
+        __m256i my = load_code_avx(y + i);
+        mnum = _mm256_add_epi64(mnum, popcount_epi64_avx(_mm256_and_si256(mx, my)));
+        mden = _mm256_add_epi64(mden, popcount_epi64_avx(_mm256_or_si256(mx, my)));
+    }
+    int num = reduce_add_epi64_avx(mnum);
+    int den = reduce_add_epi64_avx(mden);
+    jaccard_tail(x + i, y + i, code_size - i, num, den);
+    return jaccard_from_counts(num, den);
+}
+
+void
+bvec_hamming_batch_4_avx(const uint8_t* x, const uint8_t* y0, const uint8_t* y1, const uint8_t* y2,
+                         const uint8_t* y3, size_t code_size, float& dis0, float& dis1, float& dis2, float& dis3) {
+    __m256i msum0 = _mm256_setzero_si256();
+    __m256i msum1 = _mm256_setzero_si256();
+    __m256i msum2 = _mm256_setzero_si256();
+    __m256i msum3 = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 32 <= code_size; i += 32) {
+        __m256i mx = load_code_avx(x + i);
+        msum0 = _mm256_add_epi64(msum0, popcount_epi64_avx(_mm256_xor_si256(mx, load_code_avx(y0 + i))));
+        msum1 = _mm256_add_epi64(msum1, popcount_epi64_avx(_mm256_xor_si256(mx, load_code_avx(y1 + i))));
+        msum2 = _mm256_add_epi64(msum2, popcount_epi64_avx(_mm256_xor_si256(mx, load_code_avx(y2 + i))));
+        msum3 = _mm256_add_epi64(msum3, popcount_epi64_avx(_mm256_xor_si256(mx, load_code_avx(y3 + i))));
+    }
+    size_t rest = code_size - i;
+    dis0 = reduce_add_epi64_avx(msum0) + hamming_tail(x + i, y0 + i, rest);
+    dis1 = reduce_add_epi64_avx(msum1) + hamming_tail(x + i, y1 + i, rest);
+    dis2 = reduce_add_epi64_avx(msum2) + hamming_tail(x + i, y2 + i, rest);
+    dis3 = reduce_add_epi64_avx(msum3) + hamming_tail(x + i, y3 + i, rest);
+}
+
+void
+bvec_jaccard_batch_4_avx(const uint8_t* x, const uint8_t* y0, const uint8_t* y1, const uint8_t* y2,
+                         const uint8_t* y3, size_t code_size, float& dis0, float& dis1, float& dis2, float& dis3) {
+    const uint8_t* ys[4] = {y0, y1, y2, y3};
+    __m256i mnum[4], mden[4];
+    for (int j = 0; j < 4; j++) {
+        mnum[j] = _mm256_setzero_si256();
+        mden[j] = _mm256_setzero_si256();
+    }
+    size_t i = 0;
+    for (; i + 32 <= code_size; i += 32) {
+        __m256i mx = load_code_avx(x + i);
+        for (int j = 0; j < 4; j++) {
+            __m256i my = load_code_avx(ys[j] + i);
+            mnum[j] = _mm256_add_epi64(mnum[j], popcount_epi64_avx(_mm256_and_si256(mx, my)));
+            mden[j] = _mm256_add_epi64(mden[j], popcount_epi64_avx(_mm256_or_si256(mx, my)));
+        }
+    }
+    float* dis[4] = {&dis0, &dis1, &dis2, &dis3};
+    for (int j = 0; j < 4; j++) {
+        int num = reduce_add_epi64_avx(mnum[j]);
+        int den = reduce_add_epi64_avx(mden[j]);
+        jaccard_tail(x + i, ys[j] + i, code_size - i, num, den);
+        *dis[j] = jaccard_from_counts(num, den);
+    }
+}
+
+// four codes a pass share the loads of x
+void
+bvec_hamming_ny_avx(float* dis, const uint8_t* x, const uint8_t* y, size_t code_size, size_t ny) {
+    size_t i = 0;
+    for (; i + 4 <= ny; i += 4, y += 4 * code_size) {
+        bvec_hamming_batch_4_avx(x, y, y + code_size, y + 2 * code_size, y + 3 * code_size, code_size, dis[i],
+                                 dis[i + 1], dis[i + 2], dis[i + 3]);
+    }
+    for (; i < ny; i++, y += code_size) {
+        dis[i] = bvec_hamming_avx(x, y, code_size);
+    }
+}
+
+void
+bvec_jaccard_ny_avx(float* dis, const uint8_t* x, const uint8_t* y, size_t code_size, size_t ny) {
+    size_t i = 0;
+    for (; i + 4 <= ny; i += 4, y += 4 * code_size) {
+        bvec_jaccard_batch_4_avx(x, y, y + code_size, y + 2 * code_size, y + 3 * code_size, code_size, dis[i],
+                                 dis[i + 1], dis[i + 2], dis[i + 3]);
+    }
+    for (; i < ny; i++, y += code_size) {
+        dis[i] = bvec_jaccard_avx(x, y, code_size);
+    }
+}
+
+bool
+bvec_is_subset_avx(const uint8_t* x, const uint8_t* y, size_t code_size) {
+    size_t i = 0;
+    for (; i + 32 <= code_size; i += 32) {
+        // testc is set when x & ~y is zero
+        if (!_mm256_testc_si256(load_code_avx(y + i), load_code_avx(x + i))) {
+            return false;
+        }
+    }
+    for (; i < code_size; i++) {
+        if ((x[i] & y[i]) != x[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void
+fvec_L2sqr_block_16_avx(float* dis, const float* x, const float* y, size_t d) {
+    __m256 msum0 = _mm256_setzero_ps();
+    __m256 msum1 = _mm256_setzero_ps();
+    for (size_t i = 0; i < d; i++) {
+        const __m256 mx = _mm256_set1_ps(x[i]);
+        const __m256 a0 = _mm256_sub_ps(mx, _mm256_loadu_ps(y + i * 16));
+        const __m256 a1 = _mm256_sub_ps(mx, _mm256_loadu_ps(y + i * 16 + 8));
+        msum0 = _mm256_add_ps(msum0, _mm256_mul_ps(a0, a0));
+        msum1 = _mm256_add_ps(msum1, _mm256_mul_ps(a1, a1));
+    }
+    _mm256_storeu_ps(dis, msum0);
+    _mm256_storeu_ps(dis + 8, msum1);
+}
+
+void
+fvec_inner_product_block_16_avx(float* ip, const float* x, const float* y, size_t d) {
+    __m256 msum0 = _mm256_setzero_ps();
+    __m256 msum1 = _mm256_setzero_ps();
+    for (size_t i = 0; i < d; i++) {
+        const __m256 mx = _mm256_set1_ps(x[i]);
+        msum0 = _mm256_add_ps(msum0, _mm256_mul_ps(mx, _mm256_loadu_ps(y + i * 16)));
+        msum1 = _mm256_add_ps(msum1, _mm256_mul_ps(mx, _mm256_loadu_ps(y + i * 16 + 8)));
+    }
+    _mm256_storeu_ps(ip, msum0);
+    _mm256_storeu_ps(ip + 8, msum1);
+}
+
+namespace {
+
+// 8 bf16 halves as floats
+inline __m256
+bf16_load_8(const uint16_t* y) {
+    __m256i yi = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)y));
+    return _mm256_castsi256_ps(_mm256_slli_epi32(yi, 16));
+}
+
+inline float
+reduce_add_8(__m256 msum) {
+    __m128 msum2 = _mm_add_ps(_mm256_extractf128_ps(msum, 1), _mm256_extractf128_ps(msum, 0));
+    msum2 = _mm_hadd_ps(msum2, msum2);
+    msum2 = _mm_hadd_ps(msum2, msum2);
+    return _mm_cvtss_f32(msum2);
+}
+
+inline float
+bf16_tail(uint16_t h) {
+    uint32_t u = (uint32_t)h << 16;
+    float f;
+    std::memcpy(&f, &u, sizeof(f));
+    return f;
+}
+
+inline float
+fp16_tail(uint16_t h) {
+    return _mm_cvtss_f32(_mm_cvtph_ps(_mm_cvtsi32_si128(h)));
+}
+
+}  // namespace
+
+float
+fp16vec_L2sqr_avx(const float* x, const uint16_t* y, size_t d) {
+    __m256 msum = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i + 8 <= d; i += 8) {
+        const __m256 a =
+            _mm256_sub_ps(_mm256_loadu_ps(x + i), _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)(y + i))));
+        msum = _mm256_add_ps(msum, _mm256_mul_ps(a, a));
+    }
+    float res = reduce_add_8(msum);
+    for (; i < d; i++) {
+        const float tmp = x[i] - fp16_tail(y[i]);
+        res += tmp * tmp;
+    }
+    return res;
+}
+
+float
+fp16vec_inner_product_avx(const float* x, const uint16_t* y, size_t d) {
+    __m256 msum = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i + 8 <= d; i += 8) {
+        const __m256 my = _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)(y + i)));
+        msum = _mm256_add_ps(msum, _mm256_mul_ps(_mm256_loadu_ps(x + i), my));
+    }
+    float res = reduce_add_8(msum);
+    for (; i < d; i++) {
+        res += x[i] * fp16_tail(y[i]);
+    }
+    return res;
+}
+
+float
+bf16vec_L2sqr_avx(const float* x, const uint16_t* y, size_t d) {
+    __m256 msum = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i + 8 <= d; i += 8) {
+        const __m256 a = _mm256_sub_ps(_mm256_loadu_ps(x + i), bf16_load_8(y + i));
+        msum = _mm256_add_ps(msum, _mm256_mul_ps(a, a));
+    }
+    float res = reduce_add_8(msum);
+    for (; i < d; i++) {
+        const float tmp = x[i] - bf16_tail(y[i]);
+        res += tmp * tmp;
+    }
+    return res;
+}
+
+float
+bf16vec_inner_product_avx(const float* x, const uint16_t* y, size_t d) {
+    __m256 msum = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i + 8 <= d; i += 8) {
+        msum = _mm256_add_ps(msum, _mm256_mul_ps(_mm256_loadu_ps(x + i), bf16_load_8(y + i)));
+    }
+    float res = reduce_add_8(msum);
+    for (; i < d; i++) {
+        res += x[i] * bf16_tail(y[i]);
+    }
+    return res;
+}
+
+void
+fp16vec_L2sqr_ny_avx(float* dis, const float* x, const uint16_t* y, size_t d, size_t ny) {
+    for (size_t i = 0; i < ny; i++) {
+        dis[i] = fp16vec_L2sqr_avx(x, y + i * d, d);
+    }
+}
+
+void
+fp16vec_inner_products_ny_avx(float* ip, const float* x, const uint16_t* y, size_t d, size_t ny) {
+    for (size_t i = 0; i < ny; i++) {
+        ip[i] = fp16vec_inner_product_avx(x, y + i * d, d);
+    }
+}
+
+void
+bf16vec_L2sqr_ny_avx(float* dis, const float* x, const uint16_t* y, size_t d, size_t ny) {
+    for (size_t i = 0; i < ny; i++) {
+        dis[i] = bf16vec_L2sqr_avx(x, y + i * d, d);
+    }
+}
+
+void
+bf16vec_inner_products_ny_avx(float* ip, const float* x, const uint16_t* y, size_t d, size_t ny) {
+    for (size_t i = 0; i < ny; i++) {
+        ip[i] = bf16vec_inner_product_avx(x, y + i * d, d);
+    }
+}
+
+namespace {
+
+// 16 int8 widened to int16, the products of pairs of them are summed to int32 by madd
+inline __m256i
+i8_load_16(const int8_t* x) {
+    return _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i*)x));
+}
+
+inline int32_t
+reduce_add_epi32_avx(__m256i v) {
+    __m128i s = _mm_add_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(1, 0, 3, 2)));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(s);
+}
+
+}  // namespace
+
+float
+i8vec_L2sqr_avx(const int8_t* x, const int8_t* y, size_t d) {
+    __m256i msum = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 16 <= d; i += 16) {
+        const __m256i a = _mm256_sub_epi16(i8_load_16(x + i), i8_load_16(y + i));
+        msum = _mm256_add_epi32(msum, _mm256_madd_epi16(a, a));
+    }
+    int32_t res = reduce_add_epi32_avx(msum);
+    for (; i < d; i++) {
+        const int32_t tmp = (int32_t)x[i] - (int32_t)y[i];
+        res += tmp * tmp;
+    }
+    return (float)res;
+}
+
+float
+i8vec_inner_product_avx(const int8_t* x, const int8_t* y, size_t d) {
+    __m256i msum = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 16 <= d; i += 16) {
+        msum = _mm256_add_epi32(msum, _mm256_madd_epi16(i8_load_16(x + i), i8_load_16(y + i)));
+    }
+    int32_t res = reduce_add_epi32_avx(msum);
+    for (; i < d; i++) {
+        res += (int32_t)x[i] * (int32_t)y[i];
+    }
+    return (float)res;
+}
+
+void
+i8vec_L2sqr_ny_avx(float* dis, const int8_t* x, const int8_t* y, size_t d, size_t ny) {
+    for (size_t i = 0; i < ny; i++) {
+        dis[i] = i8vec_L2sqr_avx(x, y + i * d, d);
+    }
+}
+
+void
+i8vec_inner_products_ny_avx(float* ip, const int8_t* x, const int8_t* y, size_t d, size_t ny) {
+    for (size_t i = 0; i < ny; i++) {
+        ip[i] = i8vec_inner_product_avx(x, y + i * d, d);
+    }
+}
+
+void
+fvec_to_fp16_avx(uint16_t* y, const float* x, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128i h = _mm256_cvtps_ph(_mm256_loadu_ps(x + i), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+        _mm_storeu_si128((__m128i*)(y + i), h);
+    }
+    for (; i < n; i++) {
+        __m128i h = _mm_cvtps_ph(_mm_set_ss(x[i]), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+        y[i] = _mm_cvtsi128_si32(h) & 0xffff;
+    }
+}
+
+void
+fp16_to_fvec_avx(float* x, const uint16_t* y, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        _mm256_storeu_ps(x + i, _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)(y + i))));
+    }
+    for (; i < n; i++) {
+        x[i] = fp16_tail(y[i]);
+    }
+}
+
+void
+fvec_to_bf16_avx(uint16_t* y, const float* x, size_t n) {
+    // round to nearest even, NaN kept quiet
+    for (size_t i = 0; i < n; i++) {
+        uint32_t u;
+        std::memcpy(&u, x + i, sizeof(u));
+        if ((u & 0x7fffffffu) > 0x7f800000u) {
+            y[i] = (u >> 16) | 0x40;
+        } else {
+            y[i] = (u + 0x7fffu + ((u >> 16) & 1)) >> 16;
+        }
+    }
+}
+
+void
+bf16_to_fvec_avx(float* x, const uint16_t* y, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        _mm256_storeu_ps(x + i, bf16_load_8(y + i));
+    }
+    for (; i < n; i++) {
+        x[i] = bf16_tail(y[i]);
+    }
+}
+
+namespace {
+
+// loads the first d < 8 floats, 0 past them
+inline __m256
+masked_read_8(size_t d, const float* x) {
+    static const int32_t lanes[16] = {-1, -1, -1, -1, -1, -1, -1, -1, 0, 0, 0, 0, 0, 0, 0, 0};
+    return _mm256_maskload_ps(x, _mm256_loadu_si256((const __m256i*)(lanes + 8 - d)));
+}
+
+// the sums of the lanes of 4 vectors
+inline __m128
+reduce_add_4x8(__m256 s0, __m256 s1, __m256 s2, __m256 s3) {
+    const __m256 s = _mm256_hadd_ps(_mm256_hadd_ps(s0, s1), _mm256_hadd_ps(s2, s3));
+    return _mm_add_ps(_mm256_castps256_ps128(s), _mm256_extractf128_ps(s, 1));
+}
+
+struct ElementOpL2 {
+    static __m256
+    op(__m256 msum, __m256 x, __m256 y) {
+        const __m256 a_m_b = _mm256_sub_ps(x, y);
+        return _mm256_add_ps(msum, _mm256_mul_ps(a_m_b, a_m_b));
+    }
+};
+
+struct ElementOpIP {
+    static __m256
+    op(__m256 msum, __m256 x, __m256 y) {
+        return _mm256_add_ps(msum, _mm256_mul_ps(x, y));
+    }
+};
+
+// distances between x and 4 rows of y, each block of x is loaded once for the 4 of them
+template <class ElementOp>
+void
+fvec_op_4_avx(float* dis, const float* x, const float* y0, const float* y1, const float* y2, const float* y3,
+              size_t d) {
+    const size_t d8 = d & ~size_t(7);
+    __m256 msum0 = _mm256_setzero_ps();
+    __m256 msum1 = _mm256_setzero_ps();
+    __m256 msum2 = _mm256_setzero_ps();
+    __m256 msum3 = _mm256_setzero_ps();
+    for (size_t j = 0; j < d8; j += 8) {
+        const __m256 mx = _mm256_loadu_ps(x + j);
+        msum0 = ElementOp::op(msum0, mx, _mm256_loadu_ps(y0 + j));
+        msum1 = ElementOp::op(msum1, mx, _mm256_loadu_ps(y1 + j));
+        msum2 = ElementOp::op(msum2, mx, _mm256_loadu_ps(y2 + j));
+        msum3 = ElementOp::op(msum3, mx, _mm256_loadu_ps(y3 + j));
+    }
+    if (d8 < d) {
+        const __m256 mx = masked_read_8(d - d8, x + d8);
+        msum0 = ElementOp::op(msum0, mx, masked_read_8(d - d8, y0 + d8));
+        msum1 = ElementOp::op(msum1, mx, masked_read_8(d - d8, y1 + d8));
+        msum2 = ElementOp::op(msum2, mx, masked_read_8(d - d8, y2 + d8));
+        msum3 = ElementOp::op(msum3, mx, masked_read_8(d - d8, y3 + d8));
+    }
+    _mm_storeu_ps(dis, reduce_add_4x8(msum0, msum1, msum2, msum3));
+}
+
+template <class ElementOp>
+float
+fvec_op_1_avx(const float* x, const float* y, size_t d) {
+    const size_t d8 = d & ~size_t(7);
+    __m256 msum = _mm256_setzero_ps();
+    for (size_t j = 0; j < d8; j += 8) {
+        msum = ElementOp::op(msum, _mm256_loadu_ps(x + j), _mm256_loadu_ps(y + j));
+    }
+    if (d8 < d) {
+        msum = ElementOp::op(msum, masked_read_8(d - d8, x + d8), masked_read_8(d - d8, y + d8));
+    }
+    return reduce_add_8(msum);
+}
+
+// 4 rows of y per pass
+template <class ElementOp>
+void
+fvec_op_ny_avx(float* dis, const float* x, const float* y, size_t d, size_t ny) {
+    size_t i = 0;
+    for (; i + 4 <= ny; i += 4) {
+        const float* y0 = y + i * d;
+        fvec_op_4_avx<ElementOp>(dis + i, x, y0, y0 + d, y0 + 2 * d, y0 + 3 * d, d);
+    }
+    for (; i < ny; i++) {
+        dis[i] = fvec_op_1_avx<ElementOp>(x, y + i * d, d);
+    }
+}
+
+inline void
+prefetch_row(const char* row, size_t d) {
+    for (size_t off = 0; off < d * sizeof(float); off += 64) {
+        _mm_prefetch(row + off, _MM_HINT_T0);
+    }
+}
+
+// 4 gathered rows per pass, the rows of the next pass are prefetched meanwhile
+template <class ElementOp>
+void
+fvec_op_batch_indexed_avx(float* dis, const float* x, const char* base, const uint32_t* ids, size_t n, size_t d,
+                          size_t stride) {
+    auto row = [&](size_t i) { return base + ids[i] * stride; };
+    for (size_t i = 0; i < n && i < 4; i++) {
+        prefetch_row(row(i), d);
+    }
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        for (size_t j = i + 4; j < n && j < i + 8; j++) {
+            prefetch_row(row(j), d);
+        }
+        fvec_op_4_avx<ElementOp>(dis + i, x, (const float*)row(i), (const float*)row(i + 1),
+                                 (const float*)row(i + 2), (const float*)row(i + 3), d);
+    }
+    for (; i < n; i++) {
+        dis[i] = fvec_op_1_avx<ElementOp>(x, (const float*)row(i), d);
+    }
+}
+
+// D floats in blocks of 32, a constant trip count without tail that the compiler unrolls
+template <class ElementOp, size_t D>
+float
+fvec_op_d_avx(const float* x, const float* y, size_t) {
+    static_assert(D % 32 == 0, "the specialized dims are multiples of 32");
+    __m256 msum0 = _mm256_setzero_ps();
+    __m256 msum1 = _mm256_setzero_ps();
+    __m256 msum2 = _mm256_setzero_ps();
+    __m256 msum3 = _mm256_setzero_ps();
+    for (size_t j = 0; j < D; j += 32) {
+        msum0 = ElementOp::op(msum0, _mm256_loadu_ps(x + j), _mm256_loadu_ps(y + j));
+        msum1 = ElementOp::op(msum1, _mm256_loadu_ps(x + j + 8), _mm256_loadu_ps(y + j + 8));
+        msum2 = ElementOp::op(msum2, _mm256_loadu_ps(x + j + 16), _mm256_loadu_ps(y + j + 16));
+        msum3 = ElementOp::op(msum3, _mm256_loadu_ps(x + j + 24), _mm256_loadu_ps(y + j + 24));
+    }
+    return reduce_add_8(_mm256_add_ps(_mm256_add_ps(msum0, msum1), _mm256_add_ps(msum2, msum3)));
+}
+
+template <class ElementOp>
+auto
+fvec_op_dim_avx(size_t d) -> float (*)(const float*, const float*, size_t) {
+#define DISPATCH(dval) \
+    case dval:         \
+        return fvec_op_d_avx<ElementOp, dval>;
+
+    switch (d) {
+        DISPATCH(128)
+        DISPATCH(256)
+        DISPATCH(384)
+        DISPATCH(512)
+        DISPATCH(768)
+        DISPATCH(1024)
+        DISPATCH(1536)
+        default:
+            return nullptr;
+    }
+#undef DISPATCH
+}
+
+}  // namespace
+
+void
+fvec_L2sqr_ny_avx(float* dis, const float* x, const float* y, size_t d, size_t ny) {
+    // the SSE kernels of the tiny dimensions fill their registers better
+    if (d < 8) {
+        fvec_L2sqr_ny_sse(dis, x, y, d, ny);
+        return;
+    }
+    fvec_op_ny_avx<ElementOpL2>(dis, x, y, d, ny);
+}
+
+void
+fvec_inner_products_ny_avx(float* ip, const float* x, const float* y, size_t d, size_t ny) {
+    if (d < 8) {
+        fvec_inner_products_ny_sse(ip, x, y, d, ny);
+        return;
+    }
+    fvec_op_ny_avx<ElementOpIP>(ip, x, y, d, ny);
+}
+
+void
+fvec_L2sqr_batch_indexed_avx(float* dis, const float* x, const char* base, const uint32_t* ids, size_t n, size_t d,
+                             size_t stride) {
+    fvec_op_batch_indexed_avx<ElementOpL2>(dis, x, base, ids, n, d, stride);
+}
+
+void
+fvec_inner_product_batch_indexed_avx(float* ip, const float* x, const char* base, const uint32_t* ids, size_t n,
+                                     size_t d, size_t stride) {
+    fvec_op_batch_indexed_avx<ElementOpIP>(ip, x, base, ids, n, d, stride);
+}
+
+auto
+fvec_L2sqr_dim_avx(size_t d) -> float (*)(const float*, const float*, size_t) {
+    return fvec_op_dim_avx<ElementOpL2>(d);
+}
+
+auto
+fvec_inner_product_dim_avx(size_t d) -> float (*)(const float*, const float*, size_t) {
+    return fvec_op_dim_avx<ElementOpIP>(d);
+}
+
+float
+fvec_norm_L2sqr_avx(const float* x, size_t d) {
+    __m256 msum0 = _mm256_setzero_ps();
+    __m256 msum1 = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i + 16 <= d; i += 16) {
+        const __m256 mx0 = _mm256_loadu_ps(x + i);
+        const __m256 mx1 = _mm256_loadu_ps(x + i + 8);
+        msum0 = _mm256_add_ps(msum0, _mm256_mul_ps(mx0, mx0));
+        msum1 = _mm256_add_ps(msum1, _mm256_mul_ps(mx1, mx1));
+    }
+    if (i + 8 <= d) {
+        const __m256 mx = _mm256_loadu_ps(x + i);
+        msum0 = _mm256_add_ps(msum0, _mm256_mul_ps(mx, mx));
+        i += 8;
+    }
+    if (i < d) {
+        const __m256 mx = masked_read_8(d - i, x + i);
+        msum1 = _mm256_add_ps(msum1, _mm256_mul_ps(mx, mx));
+    }
+    return reduce_add_8(_mm256_add_ps(msum0, msum1));
+}
+
+static inline float
+cosine_from_sums(float ip, float norm_x, float norm_y) {
+    return (norm_x > 0 && norm_y > 0) ? ip / (std::sqrt(norm_x) * std::sqrt(norm_y)) : 0.0f;
+}
+
+float
+fvec_cosine_avx(const float* x, const float* y, size_t d) {
+    __m256 mip = _mm256_setzero_ps();
+    __m256 mnx = _mm256_setzero_ps();
+    __m256 mny = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i + 8 <= d; i += 8) {
+        const __m256 mx = _mm256_loadu_ps(x + i);
+        const __m256 my = _mm256_loadu_ps(y + i);
+        mip = _mm256_add_ps(mip, _mm256_mul_ps(mx, my));
+        mnx = _mm256_add_ps(mnx, _mm256_mul_ps(mx, mx));
+        mny = _mm256_add_ps(mny, _mm256_mul_ps(my, my));
+    }
+    if (i < d) {
+        const __m256 mx = masked_read_8(d - i, x + i);
+        const __m256 my = masked_read_8(d - i, y + i);
+        mip = _mm256_add_ps(mip, _mm256_mul_ps(mx, my));
+        mnx = _mm256_add_ps(mnx, _mm256_mul_ps(mx, mx));
+        mny = _mm256_add_ps(mny, _mm256_mul_ps(my, my));
+    }
+    return cosine_from_sums(reduce_add_8(mip), reduce_add_8(mnx), reduce_add_8(mny));
+}
+
+void
+fvec_madd_avx(size_t n, const float* a, float bf, const float* b, float* c) {
+    const __m256 bf8 = _mm256_set1_ps(bf);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        _mm256_storeu_ps(c + i, _mm256_add_ps(_mm256_loadu_ps(a + i), _mm256_mul_ps(bf8, _mm256_loadu_ps(b + i))));
+    }
+    for (; i < n; i++) {
+        c[i] = a[i] + bf * b[i];
+    }
+}
+
+int
+fvec_madd_and_argmin_avx(size_t n, const float* a, float bf, const float* b, float* c) {
+    const __m256 bf8 = _mm256_set1_ps(bf);
+    __m256 vmin8 = _mm256_set1_ps(1e20);
+    __m256 imin8 = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+    __m256i idx8 = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    const __m256i inc8 = _mm256_set1_epi32(8);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        const __m256 vc8 = _mm256_add_ps(_mm256_loadu_ps(a + i), _mm256_mul_ps(bf8, _mm256_loadu_ps(b + i)));
+        _mm256_storeu_ps(c + i, vc8);
+        // each lane keeps its first minimum
+        const __m256 mask = _mm256_cmp_ps(vc8, vmin8, _CMP_LT_OQ);
+        vmin8 = _mm256_blendv_ps(vmin8, vc8, mask);
+        imin8 = _mm256_blendv_ps(imin8, _mm256_castsi256_ps(idx8), mask);
+        idx8 = _mm256_add_epi32(idx8, inc8);
+    }
+
+    // the first minimum of all the lanes
+    ALIGNED(32) float vmins[8];
+    ALIGNED(32) int32_t imins[8];
+    _mm256_store_ps(vmins, vmin8);
+    _mm256_store_si256((__m256i*)imins, _mm256_castps_si256(imin8));
+    float vmin = 1e20;
+    int imin = -1;
+    for (int j = 0; j < 8; j++) {
+        if (imins[j] >= 0 && (vmins[j] < vmin || (vmins[j] == vmin && imins[j] < imin))) {
+            vmin = vmins[j];
+            imin = imins[j];
+        }
+    }
+
+    for (; i < n; i++) {
+        c[i] = a[i] + bf * b[i];
+        if (c[i] < vmin) {
+            vmin = c[i];
+            imin = i;
+        }
+    }
+    return imin;
+}
+
+void
+pq_adc_ny_avx(float* dis, const uint8_t* codes, const float* tables, size_t ny, size_t nchunks) {
+    // one gather loads 4 consecutive chunks of the 8 codes of a block, each lane then holds the centroid ids of its
+    // vector for these chunks, one per byte
+    const __m256i offsets = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(nchunks));
+    const __m256i mask = _mm256_set1_epi32(0xff);
+    size_t i = 0;
+    for (; i + 8 <= ny; i += 8) {
+        const uint8_t* block = codes + i * nchunks;
+        __m256 msum = _mm256_setzero_ps();
+        size_t c = 0;
+        for (; c + 4 <= nchunks; c += 4) {
+            __m256i ids = _mm256_i32gather_epi32((const int*)(block + c), offsets, 1);
+            const float* t = tables + c * 256;
+            msum = _mm256_add_ps(msum, _mm256_i32gather_ps(t, _mm256_and_si256(ids, mask), 4));
+            msum = _mm256_add_ps(msum, _mm256_i32gather_ps(t + 256, _mm256_and_si256(_mm256_srli_epi32(ids, 8), mask), 4));
+            msum = _mm256_add_ps(msum,
+                                 _mm256_i32gather_ps(t + 512, _mm256_and_si256(_mm256_srli_epi32(ids, 16), mask), 4));
+            msum = _mm256_add_ps(msum, _mm256_i32gather_ps(t + 768, _mm256_srli_epi32(ids, 24), 4));
+        }
+        for (; c < nchunks; c++) {
+            __m256i ids = _mm256_setr_epi32(block[c], block[nchunks + c], block[2 * nchunks + c],
+                                            block[3 * nchunks + c], block[4 * nchunks + c], block[5 * nchunks + c],
+                                            block[6 * nchunks + c], block[7 * nchunks + c]);
+            msum = _mm256_add_ps(msum, _mm256_i32gather_ps(tables + c * 256, ids, 4));
+        }
+        _mm256_storeu_ps(dis + i, msum);
+    }
+    for (; i < ny; i++) {
+        const uint8_t* code = codes + i * nchunks;
+        float d = 0.0f;
+        for (size_t c = 0; c < nchunks; c++) {
+            d += tables[c * 256 + code[c]];
+        }
+        dis[i] = d;
+    }
+}
+
 }  // namespace faiss
 #endif
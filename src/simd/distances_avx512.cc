@@ -15,9 +15,13 @@
 #include <immintrin.h>
 
 #include <cassert>
+#include <cmath>
 #include <cstdio>
+#include <cstring>
 #include <string>
 
+#include "distances_sse.h"
+
 namespace faiss {
 
 // reads 0 <= d < 4 floats as __m128
@@ -249,6 +253,783 @@ fvec_Linf_avx512(const float* x, const float* y, size_t d) {
     return _mm_cvtss_f32(msum2);
 }
 
+// per 64-bit lane popcount, 4-bit lookups summed with sad (Mula et al.)
+static inline __m512i
+popcount_epi64_avx512(__m512i v) {
+    const __m512i lookup = _mm512_broadcast_i32x4(_mm_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4));
+    const __m512i low_mask = _mm512_set1_epi8(0x0f);
+    __m512i lo = _mm512_and_si512(v, low_mask);
+    __m512i hi = _mm512_and_si512(_mm512_srli_epi16(v, 4), low_mask);
+    __m512i cnt = _mm512_add_epi8(_mm512_shuffle_epi8(lookup, lo), _mm512_shuffle_epi8(lookup, hi));
+    return _mm512_sad_epu8(cnt, _mm512_setzero_si512());
+}
+
+// the last partial block is read with a mask, bytes past code_size are zero
+static inline __mmask64
+code_mask(size_t rest) {
+    return rest >= 64 ? ~__mmask64(0) : (__mmask64(1) << rest) - 1;
+}
+
+static inline float
+jaccard_from_counts(int num, int den) {
+    return (den == 0) ? 1.0f : (float)(den - num) / (float)den;
+}
+
+int
+bvec_hamming_avx512(const uint8_t* x, const uint8_t* y, size_t code_size) {
+    __m512i msum = _mm512_setzero_si512();
+    for (size_t i = 0; i < code_size; i += 64) {
+        __mmask64 mask = code_mask(code_size - i);
+        __m512i mxor = _mm512_xor_si512(_mm512_maskz_loadu_epi8(mask, x + i), _mm512_maskz_loadu_epi8(mask, y + i));
+        msum = _mm512_add_epi64(msum, popcount_epi64_avx512(mxor));
+    }
+    return _mm512_reduce_add_epi64(msum);
+}
+
+float
+bvec_jaccard_avx512(const uint8_t* x, const uint8_t* y, size_t code_size) {
+    __m512i mnum = _mm512_setzero_si512();
+    __m512i mden = _mm512_setzero_si512();
+    for (size_t i = 0; i < code_size; i += 64) {
+        __mmask64 mask = code_mask(code_size - i);
+        __m512i mx = _mm512_maskz_loadu_epi8(mask, x + i);
+        __m512i my = _mm512_maskz_loadu_epi8(mask, y + i);
+        mnum = _mm512_add_epi64(mnum, popcount_epi64_avx512(_mm512_and_si512(mx, my)));
+        mden = _mm512_add_epi64(mden, popcount_epi64_avx512(_mm512_or_si512(mx, my)));
+    }
+    return jaccard_from_counts(_mm512_reduce_add_epi64(mnum), _mm512_reduce_add_epi64(mden));
+}
+
+void
+bvec_hamming_batch_4_avx512(const uint8_t* x, const uint8_t* y0, const uint8_t* y1, const uint8_t* y2,
+                            const uint8_t* y3, size_t code_size, float& dis0, float& dis1, float& dis2, float& dis3) {
+    __m512i msum0 = _mm512_setzero_si512();
+    __m512i msum1 = _mm512_setzero_si512();
+    __m512i msum2 = _mm512_setzero_si512();
+    __m512i msum3 = _mm512_setzero_si512();
+    for (size_t i = 0; i < code_size; i += 64) {
+        __mmask64 mask = code_mask(code_size - i);
+        __m512i mx = _mm512_maskz_loadu_epi8(mask, x + i);
+        msum0 = _mm512_add_epi64(
+            msum0, popcount_epi64_avx512(_mm512_xor_si512(mx, _mm512_maskz_loadu_epi8(mask, y0 + i))));
+        msum1 = _mm512_add_epi64(
+            msum1, popcount_epi64_avx512(_mm512_xor_si512(mx, _mm512_maskz_loadu_epi8(mask, y1 + i))));
+        msum2 = _mm512_add_epi64(
+            msum2, popcount_epi64_avx512(_mm512_xor_si512(mx, _mm512_maskz_loadu_epi8(mask, y2 + i))));
+        msum3 = _mm512_add_epi64(
+            msum3, popcount_epi64_avx512(_mm512_xor_si512(mx, _mm512_maskz_loadu_epi8(mask, y3 + i))));
+    }
+    dis0 = _mm512_reduce_add_epi64(msum0);
+    dis1 = _mm512_reduce_add_epi64(msum1);
+    dis2 = _mm512_reduce_add_epi64(msum2);
+    dis3 = _mm512_reduce_add_epi64(msum3);
+}
+
+void
+bvec_jaccard_batch_4_avx512(const uint8_t* x, const uint8_t* y0, const uint8_t* y1, const uint8_t* y2,
+                            const uint8_t* y3, size_t code_size, float& dis0, float& dis1, float& dis2, float& dis3) {
+    const uint8_t* ys[4] = {y0, y1, y2, y3};
+    __m512i mnum[4], mden[4];
+    for (int j = 0; j < 4; j++) {
+        mnum[j] = _mm512_setzero_si512();
+        mden[j] = _mm512_setzero_si512();
+    }
+    for (size_t i = 0; i < code_size; i += 64) {
+        __mmask64 mask = code_mask(code_size - i);
+        __m512i mx = _mm512_maskz_loadu_epi8(mask, x + i);
+        for (int j = 0; j < 4; j++) {
+            __m512i my = _mm512_maskz_loadu_epi8(mask, ys[j] + i);
+            mnum[j] = _mm512_add_epi64(mnum[j], popcount_epi64_avx512(_mm512_and_si512(mx, my)));
+            mden[j] = _mm512_add_epi64(mden[j], popcount_epi64_avx512(_mm512_or_si512(mx, my)));
+        }
+    }
+    float* dis[4] = {&dis0, &dis1, &dis2, &dis3};
+    for (int j = 0; j < 4; j++) {
+        *dis[j] = jaccard_from_counts(_mm512_reduce_add_epi64(mnum[j]), _mm512_reduce_add_epi64(mden[j]));
+    }
+}
+
+// four codes a pass share the loads of x
+void
+bvec_hamming_ny_avx512(float* dis, const uint8_t* x, const uint8_t* y, size_t code_size, size_t ny) {
+    size_t i = 0;
+    for (; i + 4 <= ny; i += 4, y += 4 * code_size) {
+        bvec_hamming_batch_4_avx512(x, y, y + code_size, y + 2 * code_size, y + 3 * code_size, code_size, dis[i],
+                                    dis[i + 1], dis[i + 2], dis[i + 3]);
+    }
+    for (; i < ny; i++, y += code_size) {
+        dis[i] = bvec_hamming_avx512(x, y, code_size);
+    }
+}
+
+void
+bvec_jaccard_ny_avx512(float* dis, const uint8_t* x, const uint8_t* y, size_t code_size, size_t ny) {
+    size_t i = 0;
+    for (; i + 4 <= ny; i += 4, y += 4 * code_size) {
+        bvec_jaccard_batch_4_avx512(x, y, y + code_size, y + 2 * code_size, y + 3 * code_size, code_size, dis[i],
+                                    dis[i + 1], dis[i + 2], dis[i + 3]);
+    }
+    for (; i < ny; i++, y += code_size) {
+        dis[i] = bvec_jaccard_avx512(x, y, code_size);
+    }
+}
+
+bool
+bvec_is_subset_avx512(const uint8_t* x, const uint8_t* y, size_t code_size) {
+    for (size_t i = 0; i < code_size; i += 64) {
+        __mmask64 mask = code_mask(code_size - i);
+        __m512i mx = _mm512_maskz_loadu_epi8(mask, x + i);
+        __m512i my = _mm512_maskz_loadu_epi8(mask, y + i);
+        if (_mm512_test_epi64_mask(_mm512_andnot_si512(my, mx), mx) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void
+fvec_L2sqr_block_16_avx512(float* dis, const float* x, const float* y, size_t d) {
+    __m512 msum = _mm512_setzero_ps();
+    for (size_t i = 0; i < d; i++) {
+        const __m512 a = _mm512_sub_ps(_mm512_set1_ps(x[i]), _mm512_loadu_ps(y + i * 16));
+        msum = _mm512_add_ps(msum, _mm512_mul_ps(a, a));
+    }
+    _mm512_storeu_ps(dis, msum);
+}
+
+void
+fvec_inner_product_block_16_avx512(float* ip, const float* x, const float* y, size_t d) {
+    __m512 msum = _mm512_setzero_ps();
+    for (size_t i = 0; i < d; i++) {
+        msum = _mm512_add_ps(msum, _mm512_mul_ps(_mm512_set1_ps(x[i]), _mm512_loadu_ps(y + i * 16)));
+    }
+    _mm512_storeu_ps(ip, msum);
+}
+
+namespace {
+
+// 16 bf16 halves as floats
+inline __m512
+bf16_load_16(const uint16_t* y) {
+    __m512i yi = _mm512_cvtepu16_epi32(_mm256_loadu_si256((const __m256i*)y));
+    return _mm512_castsi512_ps(_mm512_slli_epi32(yi, 16));
+}
+
+// the last d < 16 halves, 0 past them
+inline __m256i
+half_load_tail(const uint16_t* y, size_t d) {
+    uint16_t buf[16] = {0};
+    std::memcpy(buf, y, d * sizeof(uint16_t));
+    return _mm256_loadu_si256((const __m256i*)buf);
+}
+
+inline __m512
+bf16_load_tail(const uint16_t* y, size_t d) {
+    __m512i yi = _mm512_cvtepu16_epi32(half_load_tail(y, d));
+    return _mm512_castsi512_ps(_mm512_slli_epi32(yi, 16));
+}
+
+inline __m512
+fp16_load_tail(const uint16_t* y, size_t d) {
+    return _mm512_cvtph_ps(half_load_tail(y, d));
+}
+
+}  // namespace
+
+float
+fp16vec_L2sqr_avx512(const float* x, const uint16_t* y, size_t d) {
+    __m512 msum = _mm512_setzero_ps();
+    size_t i = 0;
+    for (; i + 16 <= d; i += 16) {
+        const __m512 a =
+            _mm512_sub_ps(_mm512_loadu_ps(x + i), _mm512_cvtph_ps(_mm256_loadu_si256((const __m256i*)(y + i))));
+        msum = _mm512_fmadd_ps(a, a, msum);
+    }
+    if (i < d) {
+        const __mmask16 mask = (1U << (d - i)) - 1U;
+        const __m512 a = _mm512_sub_ps(_mm512_maskz_loadu_ps(mask, x + i), fp16_load_tail(y + i, d - i));
+        msum = _mm512_fmadd_ps(a, a, msum);
+    }
+    return _mm512_reduce_add_ps(msum);
+}
+
+float
+fp16vec_inner_product_avx512(const float* x, const uint16_t* y, size_t d) {
+    __m512 msum = _mm512_setzero_ps();
+    size_t i = 0;
+    for (; i + 16 <= d; i += 16) {
+        msum = _mm512_fmadd_ps(_mm512_loadu_ps(x + i), _mm512_cvtph_ps(_mm256_loadu_si256((const __m256i*)(y + i))),
+                               msum);
+    }
+    if (i < d) {
+        const __mmask16 mask = (1U << (d - i)) - 1U;
+        msum = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, x + i), fp16_load_tail(y + i, d - i), msum);
+    }
+    return _mm512_reduce_add_ps(msum);
+}
+
+float
+bf16vec_L2sqr_avx512(const float* x, const uint16_t* y, size_t d) {
+    __m512 msum = _mm512_setzero_ps();
+    size_t i = 0;
+    for (; i + 16 <= d; i += 16) {
+        const __m512 a = _mm512_sub_ps(_mm512_loadu_ps(x + i), bf16_load_16(y + i));
+        msum = _mm512_fmadd_ps(a, a, msum);
+    }
+    if (i < d) {
+        const __mmask16 mask = (1U << (d - i)) - 1U;
+        const __m512 a = _mm512_sub_ps(_mm512_maskz_loadu_ps(mask, x + i), bf16_load_tail(y + i, d - i));
+        msum = _mm512_fmadd_ps(a, a, msum);
+    }
+    return _mm512_reduce_add_ps(msum);
+}
+
+float
+bf16vec_inner_product_avx512(const float* x, const uint16_t* y, size_t d) {
+    __m512 msum = _mm512_setzero_ps();
+    size_t i = 0;
+    for (; i + 16 <= d; i += 16) {
+        msum = _mm512_fmadd_ps(_mm512_loadu_ps(x + i), bf16_load_16(y + i), msum);
+    }
+    if (i < d) {
+        const __mmask16 mask = (1U << (d - i)) - 1U;
+        msum = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, x + i), bf16_load_tail(y + i, d - i), msum);
+    }
+    return _mm512_reduce_add_ps(msum);
+}
+
+namespace {
+
+// the sums of the lanes of 4 vectors
+inline __m128
+reduce_add_4x16(__m512 s0, __m512 s1, __m512 s2, __m512 s3) {
+    auto fold = [](__m512 v) { return _mm256_add_ps(_mm512_castps512_ps256(v), _mm512_extractf32x8_ps(v, 1)); };
+    const __m256 s = _mm256_hadd_ps(_mm256_hadd_ps(fold(s0), fold(s1)), _mm256_hadd_ps(fold(s2), fold(s3)));
+    return _mm_add_ps(_mm256_castps256_ps128(s), _mm256_extractf128_ps(s, 1));
+}
+
+struct ElementOpL2 {
+    static __m512
+    op(__m512 msum, __m512 x, __m512 y) {
+        const __m512 a_m_b = _mm512_sub_ps(x, y);
+        return _mm512_fmadd_ps(a_m_b, a_m_b, msum);
+    }
+};
+
+struct ElementOpIP {
+    static __m512
+    op(__m512 msum, __m512 x, __m512 y) {
+        return _mm512_fmadd_ps(x, y, msum);
+    }
+};
+
+// 8 rows of y per pass, each block of x is loaded once for the 8 of them and the 8 sums hide the latency of the fma
+template <class ElementOp>
+void
+fvec_op_ny_avx512(float* dis, const float* x, const float* y, size_t d, size_t ny) {
+    const size_t d16 = d & ~size_t(15);
+    const __mmask16 tail = (1U << (d - d16)) - 1;
+    size_t i = 0;
+    for (; i + 8 <= ny; i += 8) {
+        const float* y0 = y + i * d;
+        __m512 msum0 = _mm512_setzero_ps(), msum1 = _mm512_setzero_ps();
+        __m512 msum2 = _mm512_setzero_ps(), msum3 = _mm512_setzero_ps();
+        __m512 msum4 = _mm512_setzero_ps(), msum5 = _mm512_setzero_ps();
+        __m512 msum6 = _mm512_setzero_ps(), msum7 = _mm512_setzero_ps();
+        auto step = [&](__m512 mx, auto load) {
+            msum0 = ElementOp::op(msum0, mx, load(y0));
+            msum1 = ElementOp::op(msum1, mx, load(y0 + d));
+            msum2 = ElementOp::op(msum2, mx, load(y0 + 2 * d));
+            msum3 = ElementOp::op(msum3, mx, load(y0 + 3 * d));
+            msum4 = ElementOp::op(msum4, mx, load(y0 + 4 * d));
+            msum5 = ElementOp::op(msum5, mx, load(y0 + 5 * d));
+            msum6 = ElementOp::op(msum6, mx, load(y0 + 6 * d));
+            msum7 = ElementOp::op(msum7, mx, load(y0 + 7 * d));
+        };
+        for (size_t j = 0; j < d16; j += 16) {
+            step(_mm512_loadu_ps(x + j), [j](const float* yr) { return _mm512_loadu_ps(yr + j); });
+        }
+        if (tail) {
+            step(_mm512_maskz_loadu_ps(tail, x + d16),
+                 [d16, tail](const float* yr) { return _mm512_maskz_loadu_ps(tail, yr + d16); });
+        }
+        _mm_storeu_ps(dis + i, reduce_add_4x16(msum0, msum1, msum2, msum3));
+        _mm_storeu_ps(dis + i + 4, reduce_add_4x16(msum4, msum5, msum6, msum7));
+    }
+    for (; i < ny; i++) {
+        const float* yi = y + i * d;
+        __m512 msum = _mm512_setzero_ps();
+        for (size_t j = 0; j < d16; j += 16) {
+            msum = ElementOp::op(msum, _mm512_loadu_ps(x + j), _mm512_loadu_ps(yi + j));
+        }
+        if (tail) {
+            msum = ElementOp::op(msum, _mm512_maskz_loadu_ps(tail, x + d16), _mm512_maskz_loadu_ps(tail, yi + d16));
+        }
+        dis[i] = _mm512_reduce_add_ps(msum);
+    }
+}
+
+// distances between x and 4 rows of y, each block of x is loaded once for the 4 of them
+template <class ElementOp>
+void
+fvec_op_4_avx512(float* dis, const float* x, const float* y0, const float* y1, const float* y2, const float* y3,
+                 size_t d) {
+    const size_t d16 = d & ~size_t(15);
+    const __mmask16 tail = (1U << (d - d16)) - 1;
+    __m512 msum0 = _mm512_setzero_ps();
+    __m512 msum1 = _mm512_setzero_ps();
+    __m512 msum2 = _mm512_setzero_ps();
+    __m512 msum3 = _mm512_setzero_ps();
+    for (size_t j = 0; j < d16; j += 16) {
+        const __m512 mx = _mm512_loadu_ps(x + j);
+        msum0 = ElementOp::op(msum0, mx, _mm512_loadu_ps(y0 + j));
+        msum1 = ElementOp::op(msum1, mx, _mm512_loadu_ps(y1 + j));
+        msum2 = ElementOp::op(msum2, mx, _mm512_loadu_ps(y2 + j));
+        msum3 = ElementOp::op(msum3, mx, _mm512_loadu_ps(y3 + j));
+    }
+    if (tail) {
+        const __m512 mx = _mm512_maskz_loadu_ps(tail, x + d16);
+        msum0 = ElementOp::op(msum0, mx, _mm512_maskz_loadu_ps(tail, y0 + d16));
+        msum1 = ElementOp::op(msum1, mx, _mm512_maskz_loadu_ps(tail, y1 + d16));
+        msum2 = ElementOp::op(msum2, mx, _mm512_maskz_loadu_ps(tail, y2 + d16));
+        msum3 = ElementOp::op(msum3, mx, _mm512_maskz_loadu_ps(tail, y3 + d16));
+    }
+    _mm_storeu_ps(dis, reduce_add_4x16(msum0, msum1, msum2, msum3));
+}
+
+template <class ElementOp>
+float
+fvec_op_1_avx512(const float* x, const float* y, size_t d) {
+    const size_t d16 = d & ~size_t(15);
+    const __mmask16 tail = (1U << (d - d16)) - 1;
+    __m512 msum = _mm512_setzero_ps();
+    for (size_t j = 0; j < d16; j += 16) {
+        msum = ElementOp::op(msum, _mm512_loadu_ps(x + j), _mm512_loadu_ps(y + j));
+    }
+    if (tail) {
+        msum = ElementOp::op(msum, _mm512_maskz_loadu_ps(tail, x + d16), _mm512_maskz_loadu_ps(tail, y + d16));
+    }
+    return _mm512_reduce_add_ps(msum);
+}
+
+inline void
+prefetch_row(const char* row, size_t d) {
+    for (size_t off = 0; off < d * sizeof(float); off += 64) {
+        _mm_prefetch(row + off, _MM_HINT_T0);
+    }
+}
+
+// 4 gathered rows per pass, the rows of the next pass are prefetched meanwhile
+template <class ElementOp>
+void
+fvec_op_batch_indexed_avx512(float* dis, const float* x, const char* base, const uint32_t* ids, size_t n, size_t d,
+                             size_t stride) {
+    auto row = [&](size_t i) { return base + ids[i] * stride; };
+    for (size_t i = 0; i < n && i < 4; i++) {
+        prefetch_row(row(i), d);
+    }
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        for (size_t j = i + 4; j < n && j < i + 8; j++) {
+            prefetch_row(row(j), d);
+        }
+        fvec_op_4_avx512<ElementOp>(dis + i, x, (const float*)row(i), (const float*)row(i + 1),
+                                    (const float*)row(i + 2), (const float*)row(i + 3), d);
+    }
+    for (; i < n; i++) {
+        dis[i] = fvec_op_1_avx512<ElementOp>(x, (const float*)row(i), d);
+    }
+}
+
+// D floats in blocks of 64, a constant trip count without tail that the compiler unrolls
+template <class ElementOp, size_t D>
+float
+fvec_op_d_avx512(const float* x, const float* y, size_t) {
+    static_assert(D % 64 == 0, "the specialized dims are multiples of 64");
+    __m512 msum0 = _mm512_setzero_ps();
+    __m512 msum1 = _mm512_setzero_ps();
+    __m512 msum2 = _mm512_setzero_ps();
+    __m512 msum3 = _mm512_setzero_ps();
+    for (size_t j = 0; j < D; j += 64) {
+        msum0 = ElementOp::op(msum0, _mm512_loadu_ps(x + j), _mm512_loadu_ps(y + j));
+        msum1 = ElementOp::op(msum1, _mm512_loadu_ps(x + j + 16), _mm512_loadu_ps(y + j + 16));
+        msum2 = ElementOp::op(msum2, _mm512_loadu_ps(x + j + 32), _mm512_loadu_ps(y + j + 32));
+        msum3 = ElementOp::op(msum3, _mm512_loadu_ps(x + j + 48), _mm512_loadu_ps(y + j + 48));
+    }
+    return _mm512_reduce_add_ps(_mm512_add_ps(_mm512_add_ps(msum0, msum1), _mm512_add_ps(msum2, msum3)));
+}
+
+template <class ElementOp>
+auto
+fvec_op_dim_avx512(size_t d) -> float (*)(const float*, const float*, size_t) {
+#define DISPATCH(dval) \
+    case dval:         \
+        return fvec_op_d_avx512<ElementOp, dval>;
+
+    switch (d) {
+        DISPATCH(128)
+        DISPATCH(256)
+        DISPATCH(384)
+        DISPATCH(512)
+        DISPATCH(768)
+        DISPATCH(1024)
+        DISPATCH(1536)
+        default:
+            return nullptr;
+    }
+#undef DISPATCH
+}
+
+}  // namespace
+
+void
+fvec_L2sqr_ny_avx512(float* dis, const float* x, const float* y, size_t d, size_t ny) {
+    // the SSE kernels of the tiny dimensions fill their registers better
+    if (d < 8) {
+        fvec_L2sqr_ny_sse(dis, x, y, d, ny);
+        return;
+    }
+    fvec_op_ny_avx512<ElementOpL2>(dis, x, y, d, ny);
+}
+
+void
+fvec_inner_products_ny_avx512(float* ip, const float* x, const float* y, size_t d, size_t ny) {
+    if (d < 8) {
+        fvec_inner_products_ny_sse(ip, x, y, d, ny);
+        return;
+    }
+    fvec_op_ny_avx512<ElementOpIP>(ip, x, y, d, ny);
+}
+
+void
+fvec_L2sqr_batch_indexed_avx512(float* dis, const float* x, const char* base, const uint32_t* ids, size_t n, size_t d,
+                                size_t stride) {
+    fvec_op_batch_indexed_avx512<ElementOpL2>(dis, x, base, ids, n, d, stride);
+}
+
+void
+fvec_inner_product_batch_indexed_avx512(float* ip, const float* x, const char* base, const uint32_t* ids, size_t n,
+                                        size_t d, size_t stride) {
+    fvec_op_batch_indexed_avx512<ElementOpIP>(ip, x, base, ids, n, d, stride);
+}
+
+auto
+fvec_L2sqr_dim_avx512(size_t d) -> float (*)(const float*, const float*, size_t) {
+    return fvec_op_dim_avx512<ElementOpL2>(d);
+}
+
+auto
+fvec_inner_product_dim_avx512(size_t d) -> float (*)(const float*, const float*, size_t) {
+    return fvec_op_dim_avx512<ElementOpIP>(d);
+}
+
+namespace {
+
+struct LoadFp16 {
+    static __m512
+    load(const uint16_t* y) {
+        return _mm512_cvtph_ps(_mm256_loadu_si256((const __m256i*)y));
+    }
+
+    static __m512
+    load_tail(const uint16_t* y, size_t d) {
+        return fp16_load_tail(y, d);
+    }
+};
+
+struct LoadBf16 {
+    static __m512
+    load(const uint16_t* y) {
+        return bf16_load_16(y);
+    }
+
+    static __m512
+    load_tail(const uint16_t* y, size_t d) {
+        return bf16_load_tail(y, d);
+    }
+};
+
+// 4 rows of halves per pass, each block of x is loaded once for the 4 of them
+template <class Load, class ElementOp, class Single>
+void
+halfvec_op_ny_avx512(float* dis, const float* x, const uint16_t* y, size_t d, size_t ny, Single single) {
+    const size_t d16 = d & ~size_t(15);
+    const __mmask16 tail = (1U << (d - d16)) - 1;
+    size_t i = 0;
+    for (; i + 4 <= ny; i += 4) {
+        const uint16_t* y0 = y + i * d;
+        __m512 msum0 = _mm512_setzero_ps();
+        __m512 msum1 = _mm512_setzero_ps();
+        __m512 msum2 = _mm512_setzero_ps();
+        __m512 msum3 = _mm512_setzero_ps();
+        for (size_t j = 0; j < d16; j += 16) {
+            const __m512 mx = _mm512_loadu_ps(x + j);
+            msum0 = ElementOp::op(msum0, mx, Load::load(y0 + j));
+            msum1 = ElementOp::op(msum1, mx, Load::load(y0 + d + j));
+            msum2 = ElementOp::op(msum2, mx, Load::load(y0 + 2 * d + j));
+            msum3 = ElementOp::op(msum3, mx, Load::load(y0 + 3 * d + j));
+        }
+        if (tail) {
+            const __m512 mx = _mm512_maskz_loadu_ps(tail, x + d16);
+            msum0 = ElementOp::op(msum0, mx, Load::load_tail(y0 + d16, d - d16));
+            msum1 = ElementOp::op(msum1, mx, Load::load_tail(y0 + d + d16, d - d16));
+            msum2 = ElementOp::op(msum2, mx, Load::load_tail(y0 + 2 * d + d16, d - d16));
+            msum3 = ElementOp::op(msum3, mx, Load::load_tail(y0 + 3 * d + d16, d - d16));
+        }
+        _mm_storeu_ps(dis + i, reduce_add_4x16(msum0, msum1, msum2, msum3));
+    }
+    for (; i < ny; i++) {
+        dis[i] = single(x, y + i * d, d);
+    }
+}
+
+// 32 int8 widened to int16, the products of pairs of them are summed to int32 by madd
+inline __m512i
+i8_load_32(const int8_t* x) {
+    return _mm512_cvtepi8_epi16(_mm256_loadu_si256((const __m256i*)x));
+}
+
+// the last d < 32 int8, 0 past them
+inline __m512i
+i8_load_tail(const int8_t* x, size_t d) {
+    const __mmask64 mask = (1ULL << d) - 1;
+    return _mm512_cvtepi8_epi16(_mm512_castsi512_si256(_mm512_maskz_loadu_epi8(mask, x)));
+}
+
+struct I8OpL2 {
+    static __m512i
+    op(__m512i msum, __m512i x, __m512i y) {
+        const __m512i a_m_b = _mm512_sub_epi16(x, y);
+        return _mm512_add_epi32(msum, _mm512_madd_epi16(a_m_b, a_m_b));
+    }
+};
+
+struct I8OpIP {
+    static __m512i
+    op(__m512i msum, __m512i x, __m512i y) {
+        return _mm512_add_epi32(msum, _mm512_madd_epi16(x, y));
+    }
+};
+
+template <class I8Op>
+float
+i8vec_op_avx512(const int8_t* x, const int8_t* y, size_t d) {
+    const size_t d32 = d & ~size_t(31);
+    __m512i msum = _mm512_setzero_si512();
+    for (size_t j = 0; j < d32; j += 32) {
+        msum = I8Op::op(msum, i8_load_32(x + j), i8_load_32(y + j));
+    }
+    if (d32 < d) {
+        msum = I8Op::op(msum, i8_load_tail(x + d32, d - d32), i8_load_tail(y + d32, d - d32));
+    }
+    return (float)_mm512_reduce_add_epi32(msum);
+}
+
+// 4 rows per pass, each block of x is widened once for the 4 of them
+template <class I8Op>
+void
+i8vec_op_ny_avx512(float* dis, const int8_t* x, const int8_t* y, size_t d, size_t ny) {
+    const size_t d32 = d & ~size_t(31);
+    size_t i = 0;
+    for (; i + 4 <= ny; i += 4) {
+        const int8_t* y0 = y + i * d;
+        __m512i msum0 = _mm512_setzero_si512();
+        __m512i msum1 = _mm512_setzero_si512();
+        __m512i msum2 = _mm512_setzero_si512();
+        __m512i msum3 = _mm512_setzero_si512();
+        auto step = [&](__m512i mx, auto load) {
+            msum0 = I8Op::op(msum0, mx, load(y0));
+            msum1 = I8Op::op(msum1, mx, load(y0 + d));
+            msum2 = I8Op::op(msum2, mx, load(y0 + 2 * d));
+            msum3 = I8Op::op(msum3, mx, load(y0 + 3 * d));
+        };
+        for (size_t j = 0; j < d32; j += 32) {
+            step(i8_load_32(x + j), [j](const int8_t* yr) { return i8_load_32(yr + j); });
+        }
+        if (d32 < d) {
+            step(i8_load_tail(x + d32, d - d32),
+                 [d, d32](const int8_t* yr) { return i8_load_tail(yr + d32, d - d32); });
+        }
+        dis[i] = (float)_mm512_reduce_add_epi32(msum0);
+        dis[i + 1] = (float)_mm512_reduce_add_epi32(msum1);
+        dis[i + 2] = (float)_mm512_reduce_add_epi32(msum2);
+        dis[i + 3] = (float)_mm512_reduce_add_epi32(msum3);
+    }
+    for (; i < ny; i++) {
+        dis[i] = i8vec_op_avx512<I8Op>(x, y + i * d, d);
+    }
+}
+
+}  // namespace
+
+void
+fp16vec_L2sqr_ny_avx512(float* dis, const float* x, const uint16_t* y, size_t d, size_t ny) {
+    halfvec_op_ny_avx512<LoadFp16, ElementOpL2>(dis, x, y, d, ny, fp16vec_L2sqr_avx512);
+}
+
+void
+fp16vec_inner_products_ny_avx512(float* ip, const float* x, const uint16_t* y, size_t d, size_t ny) {
+    halfvec_op_ny_avx512<LoadFp16, ElementOpIP>(ip, x, y, d, ny, fp16vec_inner_product_avx512);
+}
+
+void
+bf16vec_L2sqr_ny_avx512(float* dis, const float* x, const uint16_t* y, size_t d, size_t ny) {
+    halfvec_op_ny_avx512<LoadBf16, ElementOpL2>(dis, x, y, d, ny, bf16vec_L2sqr_avx512);
+}
+
+void
+bf16vec_inner_products_ny_avx512(float* ip, const float* x, const uint16_t* y, size_t d, size_t ny) {
+    halfvec_op_ny_avx512<LoadBf16, ElementOpIP>(ip, x, y, d, ny, bf16vec_inner_product_avx512);
+}
+
+float
+i8vec_L2sqr_avx512(const int8_t* x, const int8_t* y, size_t d) {
+    return i8vec_op_avx512<I8OpL2>(x, y, d);
+}
+
+float
+i8vec_inner_product_avx512(const int8_t* x, const int8_t* y, size_t d) {
+    return i8vec_op_avx512<I8OpIP>(x, y, d);
+}
+
+void
+i8vec_L2sqr_ny_avx512(float* dis, const int8_t* x, const int8_t* y, size_t d, size_t ny) {
+    i8vec_op_ny_avx512<I8OpL2>(dis, x, y, d, ny);
+}
+
+void
+i8vec_inner_products_ny_avx512(float* ip, const int8_t* x, const int8_t* y, size_t d, size_t ny) {
+    i8vec_op_ny_avx512<I8OpIP>(ip, x, y, d, ny);
+}
+
+float
+fvec_norm_L2sqr_avx512(const float* x, size_t d) {
+    __m512 msum0 = _mm512_setzero_ps();
+    __m512 msum1 = _mm512_setzero_ps();
+    size_t i = 0;
+    for (; i + 32 <= d; i += 32) {
+        const __m512 mx0 = _mm512_loadu_ps(x + i);
+        const __m512 mx1 = _mm512_loadu_ps(x + i + 16);
+        msum0 = _mm512_fmadd_ps(mx0, mx0, msum0);
+        msum1 = _mm512_fmadd_ps(mx1, mx1, msum1);
+    }
+    if (i + 16 <= d) {
+        const __m512 mx = _mm512_loadu_ps(x + i);
+        msum0 = _mm512_fmadd_ps(mx, mx, msum0);
+        i += 16;
+    }
+    if (i < d) {
+        const __m512 mx = _mm512_maskz_loadu_ps((1U << (d - i)) - 1, x + i);
+        msum1 = _mm512_fmadd_ps(mx, mx, msum1);
+    }
+    return _mm512_reduce_add_ps(_mm512_add_ps(msum0, msum1));
+}
+
+static inline float
+cosine_from_sums(float ip, float norm_x, float norm_y) {
+    return (norm_x > 0 && norm_y > 0) ? ip / (std::sqrt(norm_x) * std::sqrt(norm_y)) : 0.0f;
+}
+
+float
+fvec_cosine_avx512(const float* x, const float* y, size_t d) {
+    __m512 mip = _mm512_setzero_ps();
+    __m512 mnx = _mm512_setzero_ps();
+    __m512 mny = _mm512_setzero_ps();
+    for (size_t i = 0; i < d; i += 16) {
+        // the last block is read with a mask, zeros past d
+        const __mmask16 mask = d - i >= 16 ? __mmask16(0xffff) : __mmask16((1U << (d - i)) - 1);
+        const __m512 mx = _mm512_maskz_loadu_ps(mask, x + i);
+        const __m512 my = _mm512_maskz_loadu_ps(mask, y + i);
+        mip = _mm512_fmadd_ps(mx, my, mip);
+        mnx = _mm512_fmadd_ps(mx, mx, mnx);
+        mny = _mm512_fmadd_ps(my, my, mny);
+    }
+    return cosine_from_sums(_mm512_reduce_add_ps(mip), _mm512_reduce_add_ps(mnx), _mm512_reduce_add_ps(mny));
+}
+
+void
+fvec_madd_avx512(size_t n, const float* a, float bf, const float* b, float* c) {
+    const __m512 mbf = _mm512_set1_ps(bf);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        _mm512_storeu_ps(c + i, _mm512_add_ps(_mm512_loadu_ps(a + i), _mm512_mul_ps(mbf, _mm512_loadu_ps(b + i))));
+    }
+    if (i < n) {
+        const __mmask16 mask = (1U << (n - i)) - 1;
+        const __m512 vc = _mm512_add_ps(_mm512_maskz_loadu_ps(mask, a + i),
+                                        _mm512_mul_ps(mbf, _mm512_maskz_loadu_ps(mask, b + i)));
+        _mm512_mask_storeu_ps(c + i, mask, vc);
+    }
+}
+
+int
+fvec_madd_and_argmin_avx512(size_t n, const float* a, float bf, const float* b, float* c) {
+    const __m512 mbf = _mm512_set1_ps(bf);
+    __m512 vmin16 = _mm512_set1_ps(1e20);
+    __m512i imin16 = _mm512_set1_epi32(-1);
+    __m512i idx16 = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    const __m512i inc16 = _mm512_set1_epi32(16);
+    size_t i = 0;
+    for (; i < n; i += 16) {
+        // the lanes past n stay at their minimum
+        const __mmask16 valid = n - i >= 16 ? 0xffff : (1U << (n - i)) - 1;
+        const __m512 vc16 = _mm512_add_ps(_mm512_maskz_loadu_ps(valid, a + i),
+                                          _mm512_mul_ps(mbf, _mm512_maskz_loadu_ps(valid, b + i)));
+        _mm512_mask_storeu_ps(c + i, valid, vc16);
+        // each lane keeps its first minimum
+        const __mmask16 mask = _mm512_mask_cmp_ps_mask(valid, vc16, vmin16, _CMP_LT_OQ);
+        vmin16 = _mm512_mask_blend_ps(mask, vmin16, vc16);
+        imin16 = _mm512_mask_blend_epi32(mask, imin16, idx16);
+        idx16 = _mm512_add_epi32(idx16, inc16);
+    }
+
+    // the first minimum of all the lanes
+    const float vmin = _mm512_reduce_min_ps(vmin16);
+    const __mmask16 at_min = _mm512_cmp_ps_mask(vmin16, _mm512_set1_ps(vmin), _CMP_EQ_OQ);
+    return (int)_mm512_mask_reduce_min_epu32(at_min, imin16);
+}
+
+void
+pq_adc_ny_avx512(float* dis, const uint8_t* codes, const float* tables, size_t ny, size_t nchunks) {
+    // one gather loads 4 consecutive chunks of the 16 codes of a block, each lane then holds the centroid ids of its
+    // vector for these chunks, one per byte
+    const __m512i offsets = _mm512_mullo_epi32(
+        _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15), _mm512_set1_epi32(nchunks));
+    const __m512i mask = _mm512_set1_epi32(0xff);
+    size_t i = 0;
+    for (; i + 16 <= ny; i += 16) {
+        const uint8_t* block = codes + i * nchunks;
+        __m512 msum = _mm512_setzero_ps();
+        size_t c = 0;
+        for (; c + 4 <= nchunks; c += 4) {
+            __m512i ids = _mm512_i32gather_epi32(offsets, block + c, 1);
+            const float* t = tables + c * 256;
+            msum = _mm512_add_ps(msum, _mm512_i32gather_ps(_mm512_and_si512(ids, mask), t, 4));
+            msum = _mm512_add_ps(msum, _mm512_i32gather_ps(_mm512_and_si512(_mm512_srli_epi32(ids, 8), mask), t + 256, 4));
+            msum = _mm512_add_ps(msum,
+                                 _mm512_i32gather_ps(_mm512_and_si512(_mm512_srli_epi32(ids, 16), mask), t + 512, 4));
+            msum = _mm512_add_ps(msum, _mm512_i32gather_ps(_mm512_srli_epi32(ids, 24), t + 768, 4));
+        }
+        for (; c < nchunks; c++) {
+            __m512i ids = _mm512_cvtepu8_epi32(_mm_setr_epi8(
+                block[c], block[nchunks + c], block[2 * nchunks + c], block[3 * nchunks + c], block[4 * nchunks + c],
+                block[5 * nchunks + c], block[6 * nchunks + c], block[7 * nchunks + c], block[8 * nchunks + c],
+                block[9 * nchunks + c], block[10 * nchunks + c], block[11 * nchunks + c], block[12 * nchunks + c],
+                block[13 * nchunks + c], block[14 * nchunks + c], block[15 * nchunks + c]));
+            msum = _mm512_add_ps(msum, _mm512_i32gather_ps(ids, tables + c * 256, 4));
+        }
+        _mm512_storeu_ps(dis + i, msum);
+    }
+    for (; i < ny; i++) {
+        const uint8_t* code = codes + i * nchunks;
+        float d = 0.0f;
+        for (size_t c = 0; c < nchunks; c++) {
+            d += tables[c * 256 + code[c]];
+        }
+        dis[i] = d;
+    }
+}
+
 }  // namespace faiss
 
 #endif
@@ -32,6 +32,132 @@ fvec_L1_avx512(const float* x, const float* y, size_t d);
 float
 fvec_Linf_avx512(const float* x, const float* y, size_t d);
 
+/// squared L2 distances between x and the ny vectors of y, stored one after the other
+void
+fvec_L2sqr_ny_avx512(float* dis, const float* x, const float* y, size_t d, size_t ny);
+
+/// inner products between x and the ny vectors of y
+void
+fvec_inner_products_ny_avx512(float* ip, const float* x, const float* y, size_t d, size_t ny);
+
+/// distances between x and the n vectors of d floats at base + ids[i] * stride bytes
+void
+fvec_L2sqr_batch_indexed_avx512(float* dis, const float* x, const char* base, const uint32_t* ids, size_t n, size_t d,
+                                size_t stride);
+
+void
+fvec_inner_product_batch_indexed_avx512(float* ip, const float* x, const char* base, const uint32_t* ids, size_t n,
+                                        size_t d, size_t stride);
+
+/// squared L2 distance and inner product kernels unrolled for d in 128, 256, 384, 512, 768, 1024 and 1536, nullptr
+/// for any other d; the kernels ignore their size argument
+auto
+fvec_L2sqr_dim_avx512(size_t d) -> float (*)(const float*, const float*, size_t);
+
+auto
+fvec_inner_product_dim_avx512(size_t d) -> float (*)(const float*, const float*, size_t);
+
+/// squared norm of x
+float
+fvec_norm_L2sqr_avx512(const float* x, size_t d);
+
+/// cosine similarity of x and y, the inner product and both norms summed in one pass; 0 if either is zero
+float
+fvec_cosine_avx512(const float* x, const float* y, size_t d);
+
+/// c = a + bf * b
+void
+fvec_madd_avx512(size_t n, const float* a, float bf, const float* b, float* c);
+
+/// c = a + bf * b, and the index of the first minimum of c, -1 when none is below 1e20
+int
+fvec_madd_and_argmin_avx512(size_t n, const float* a, float bf, const float* b, float* c);
+
+/// squared L2 distances between x and the 16 vectors of a column block, y holds d rows of 16 floats
+void
+fvec_L2sqr_block_16_avx512(float* dis, const float* x, const float* y, size_t d);
+
+/// inner products between x and the 16 vectors of a column block
+void
+fvec_inner_product_block_16_avx512(float* ip, const float* x, const float* y, size_t d);
+
+/// number of differing bits between two codes of code_size bytes
+int
+bvec_hamming_avx512(const uint8_t* x, const uint8_t* y, size_t code_size);
+
+/// 1 - |x & y| / |x | y|, 1 when both codes are empty
+float
+bvec_jaccard_avx512(const uint8_t* x, const uint8_t* y, size_t code_size);
+
+/// hamming distances between x and 4 codes at once
+void
+bvec_hamming_batch_4_avx512(const uint8_t* x, const uint8_t* y0, const uint8_t* y1, const uint8_t* y2,
+                            const uint8_t* y3, size_t code_size, float& dis0, float& dis1, float& dis2, float& dis3);
+
+/// jaccard distances between x and 4 codes at once
+void
+bvec_jaccard_batch_4_avx512(const uint8_t* x, const uint8_t* y0, const uint8_t* y1, const uint8_t* y2,
+                            const uint8_t* y3, size_t code_size, float& dis0, float& dis1, float& dis2, float& dis3);
+
+/// hamming / jaccard distances between x and the ny codes of y, stored one after the other
+void
+bvec_hamming_ny_avx512(float* dis, const uint8_t* x, const uint8_t* y, size_t code_size, size_t ny);
+
+void
+bvec_jaccard_ny_avx512(float* dis, const uint8_t* x, const uint8_t* y, size_t code_size, size_t ny);
+
+/// whether the bits set in x are all set in y
+bool
+bvec_is_subset_avx512(const uint8_t* x, const uint8_t* y, size_t code_size);
+
+/// squared L2 distance between x and a vector stored as d fp16 halves
+float
+fp16vec_L2sqr_avx512(const float* x, const uint16_t* y, size_t d);
+
+/// inner product between x and a vector stored as d fp16 halves
+float
+fp16vec_inner_product_avx512(const float* x, const uint16_t* y, size_t d);
+
+/// squared L2 distance between x and a vector stored as d bf16 halves, the upper 16 bits of floats
+float
+bf16vec_L2sqr_avx512(const float* x, const uint16_t* y, size_t d);
+
+/// inner product between x and a vector stored as d bf16 halves
+float
+bf16vec_inner_product_avx512(const float* x, const uint16_t* y, size_t d);
+
+/// the distances between x and the ny vectors of d halves of y, stored one after the other
+void
+fp16vec_L2sqr_ny_avx512(float* dis, const float* x, const uint16_t* y, size_t d, size_t ny);
+
+void
+fp16vec_inner_products_ny_avx512(float* ip, const float* x, const uint16_t* y, size_t d, size_t ny);
+
+void
+bf16vec_L2sqr_ny_avx512(float* dis, const float* x, const uint16_t* y, size_t d, size_t ny);
+
+void
+bf16vec_inner_products_ny_avx512(float* ip, const float* x, const uint16_t* y, size_t d, size_t ny);
+
+/// squared L2 distance and inner product between int8 vectors, summed exactly in int32
+float
+i8vec_L2sqr_avx512(const int8_t* x, const int8_t* y, size_t d);
+
+float
+i8vec_inner_product_avx512(const int8_t* x, const int8_t* y, size_t d);
+
+/// the distances between x and the ny int8 vectors of y
+void
+i8vec_L2sqr_ny_avx512(float* dis, const int8_t* x, const int8_t* y, size_t d, size_t ny);
+
+void
+i8vec_inner_products_ny_avx512(float* ip, const int8_t* x, const int8_t* y, size_t d, size_t ny);
+
+/// sums of the nchunks tables of 256 floats looked up at the 8 bit PQ codes of ny vectors, codes holds nchunks bytes
+/// per vector
+void
+pq_adc_ny_avx512(float* dis, const uint8_t* codes, const float* tables, size_t ny, size_t nchunks);
+
 }  // namespace faiss
 
 #endif /* DISTANCES_AVX512_H */
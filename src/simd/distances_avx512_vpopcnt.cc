@@ -0,0 +1,136 @@
+// Copyright (C) 2019-2023 Zilliz. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file except in compliance
+// with the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
+// or implied. See the License for the specific language governing permissions and limitations under the License.
+
+#if defined(__x86_64__)
+#include "distances_avx512_vpopcnt.h"
+
+#include <immintrin.h>
+
+namespace faiss {
+
+namespace {
+
+// the last partial block is read with a mask, bytes past code_size are zero
+inline __mmask64
+code_mask(size_t rest) {
+    return rest >= 64 ? ~__mmask64(0) : (__mmask64(1) << rest) - 1;
+}
+
+inline float
+jaccard_from_counts(int num, int den) {
+    return (den == 0) ? 1.0f : (float)(den - num) / (float)den;
+}
+
+}  // namespace
+
+int
+bvec_hamming_avx512_vpopcnt(const uint8_t* x, const uint8_t* y, size_t code_size) {
+    __m512i msum = _mm512_setzero_si512();
+    for (size_t i = 0; i < code_size; i += 64) {
+        __mmask64 mask = code_mask(code_size - i);
+        __m512i mxor = _mm512_xor_si512(_mm512_maskz_loadu_epi8(mask, x + i), _mm512_maskz_loadu_epi8(mask, y + i));
+        msum = _mm512_add_epi64(msum, _mm512_popcnt_epi64(mxor));
+    }
+    return _mm512_reduce_add_epi64(msum);
+}
+
+float
+bvec_jaccard_avx512_vpopcnt(const uint8_t* x, const uint8_t* y, size_t code_size) {
+    __m512i mnum = _mm512_setzero_si512();
+    __m512i mden = _mm512_setzero_si512();
+    for (size_t i = 0; i < code_size; i += 64) {
+        __mmask64 mask = code_mask(code_size - i);
+        __m512i mx = _mm512_maskz_loadu_epi8(mask, x + i);
+        __m512i my = _mm512_maskz_loadu_epi8(mask, y + i);
+        mnum = _mm512_add_epi64(mnum, _mm512_popcnt_epi64(_mm512_and_si512(mx, my)));
+        mden = _mm512_add_epi64(mden, _mm512_popcnt_epi64(_mm512_or_si512(mx, my)));
+    }
+    return jaccard_from_counts(_mm512_reduce_add_epi64(mnum), _mm512_reduce_add_epi64(mden));
+}
+
+void
+bvec_hamming_batch_4_avx512_vpopcnt(const uint8_t* x, const uint8_t* y0, const uint8_t* y1, const uint8_t* y2,
+                                    const uint8_t* y3, size_t code_size, float& dis0, float& dis1, float& dis2,
+                                    float& dis3) {
+    __m512i msum0 = _mm512_setzero_si512();
+    __m512i msum1 = _mm512_setzero_si512();
+    __m512i msum2 = _mm512_setzero_si512();
+    __m512i msum3 = _mm512_setzero_si512();
+    for (size_t i = 0; i < code_size; i += 64) {
+        __mmask64 mask = code_mask(code_size - i);
+        __m512i mx = _mm512_maskz_loadu_epi8(mask, x + i);
+        msum0 = _mm512_add_epi64(
+            msum0, _mm512_popcnt_epi64(_mm512_xor_si512(mx, _mm512_maskz_loadu_epi8(mask, y0 + i))));
+        msum1 = _mm512_add_epi64(
+            msum1, _mm512_popcnt_epi64(_mm512_xor_si512(mx, _mm512_maskz_loadu_epi8(mask, y1 + i))));
+        msum2 = _mm512_add_epi64(
+            msum2, _mm512_popcnt_epi64(_mm512_xor_si512(mx, _mm512_maskz_loadu_epi8(mask, y2 + i))));
+        msum3 = _mm512_add_epi64(
+            msum3, _mm512_popcnt_epi64(_mm512_xor_si512(mx, _mm512_maskz_loadu_epi8(mask, y3 + i))));
+    }
+    dis0 = _mm512_reduce_add_epi64(msum0);
+    dis1 = _mm512_reduce_add_epi64(msum1);
+    dis2 = _mm512_reduce_add_epi64(msum2);
+    dis3 = _mm512_reduce_add_epi64(msum3);
+}
+
+void
+bvec_jaccard_batch_4_avx512_vpopcnt(const uint8_t* x, const uint8_t* y0, const uint8_t* y1, const uint8_t* y2,
+                                    const uint8_t* y3, size_t code_size, float& dis0, float& dis1, float& dis2,
+                                    float& dis3) {
+    const uint8_t* ys[4] = {y0, y1, y2, y3};
+    __m512i mnum[4], mden[4];
+    for (int j = 0; j < 4; j++) {
+        mnum[j] = _mm512_setzero_si512();
+        mden[j] = _mm512_setzero_si512();
+    }
+    for (size_t i = 0; i < code_size; i += 64) {
+        __mmask64 mask = code_mask(code_size - i);
+        __m512i mx = _mm512_maskz_loadu_epi8(mask, x + i);
+        for (int j = 0; j < 4; j++) {
+            __m512i my = _mm512_maskz_loadu_epi8(mask, ys[j] + i);
+            mnum[j] = _mm512_add_epi64(mnum[j], _mm512_popcnt_epi64(_mm512_and_si512(mx, my)));
+            mden[j] = _mm512_add_epi64(mden[j], _mm512_popcnt_epi64(_mm512_or_si512(mx, my)));
+        }
+    }
+    float* dis[4] = {&dis0, &dis1, &dis2, &dis3};
+    for (int j = 0; j < 4; j++) {
+        *dis[j] = jaccard_from_counts(_mm512_reduce_add_epi64(mnum[j]), _mm512_reduce_add_epi64(mden[j]));
+    }
+}
+
+void
+bvec_hamming_ny_avx512_vpopcnt(float* dis, const uint8_t* x, const uint8_t* y, size_t code_size, size_t ny) {
+    size_t i = 0;
+    for (; i + 4 <= ny; i += 4, y += 4 * code_size) {
+        bvec_hamming_batch_4_avx512_vpopcnt(x, y, y + code_size, y + 2 * code_size, y + 3 * code_size, code_size,
+                                            dis[i], dis[i + 1], dis[i + 2], dis[i + 3]);
+    }
+    for (; i < ny; i++, y += code_size) {
+        dis[i] = bvec_hamming_avx512_vpopcnt(x, y, code_size);
+    }
+}
+
+void
+bvec_jaccard_ny_avx512_vpopcnt(float* dis, const uint8_t* x, const uint8_t* y, size_t code_size, size_t ny) {
+    size_t i = 0;
+    for (; i + 4 <= ny; i += 4, y += 4 * code_size) {
+        bvec_jaccard_batch_4_avx512_vpopcnt(x, y, y + code_size, y + 2 * code_size, y + 3 * code_size, code_size,
+                                            dis[i], dis[i + 1], dis[i + 2], dis[i + 3]);
+    }
+    for (; i < ny; i++, y += code_size) {
+        dis[i] = bvec_jaccard_avx512_vpopcnt(x, y, code_size);
+    }
+}
+
+}  // namespace faiss
+
+#endif
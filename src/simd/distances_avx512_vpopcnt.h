@@ -0,0 +1,46 @@
+// Copyright (C) 2019-2023 Zilliz. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file except in compliance
+// with the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
+// or implied. See the License for the specific language governing permissions and limitations under the License.
+
+#ifndef DISTANCES_AVX512_VPOPCNT_H
+#define DISTANCES_AVX512_VPOPCNT_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace faiss {
+
+/// the binary code kernels of distances_avx512.h counting the bits with VPOPCNTQ, built with -mavx512vpopcntdq and
+/// hooked only when the cpu supports it
+int
+bvec_hamming_avx512_vpopcnt(const uint8_t* x, const uint8_t* y, size_t code_size);
+
+float
+bvec_jaccard_avx512_vpopcnt(const uint8_t* x, const uint8_t* y, size_t code_size);
+
+void
+bvec_hamming_batch_4_avx512_vpopcnt(const uint8_t* x, const uint8_t* y0, const uint8_t* y1, const uint8_t* y2,
+                                    const uint8_t* y3, size_t code_size, float& dis0, float& dis1, float& dis2,
+                                    float& dis3);
+
+void
+bvec_jaccard_batch_4_avx512_vpopcnt(const uint8_t* x, const uint8_t* y0, const uint8_t* y1, const uint8_t* y2,
+                                    const uint8_t* y3, size_t code_size, float& dis0, float& dis1, float& dis2,
+                                    float& dis3);
+
+void
+bvec_hamming_ny_avx512_vpopcnt(float* dis, const uint8_t* x, const uint8_t* y, size_t code_size, size_t ny);
+
+void
+bvec_jaccard_ny_avx512_vpopcnt(float* dis, const uint8_t* x, const uint8_t* y, size_t code_size, size_t ny);
+
+}  // namespace faiss
+
+#endif /* DISTANCES_AVX512_VPOPCNT_H */
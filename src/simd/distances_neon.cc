@@ -0,0 +1,341 @@
+// Copyright (C) 2019-2023 Zilliz. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file except in compliance
+// with the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
+// or implied. See the License for the specific language governing permissions and limitations under the License.
+
+#if defined(__aarch64__)
+
+#include "distances_neon.h"
+
+#include <arm_neon.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace faiss {
+
+namespace {
+
+struct ElementOpL2 {
+    static float32x4_t
+    op(float32x4_t msum, float32x4_t x, float32x4_t y) {
+        const float32x4_t a_m_b = vsubq_f32(x, y);
+        return vfmaq_f32(msum, a_m_b, a_m_b);
+    }
+
+    static float
+    op(float x, float y) {
+        return (x - y) * (x - y);
+    }
+};
+
+struct ElementOpIP {
+    static float32x4_t
+    op(float32x4_t msum, float32x4_t x, float32x4_t y) {
+        return vfmaq_f32(msum, x, y);
+    }
+
+    static float
+    op(float x, float y) {
+        return x * y;
+    }
+};
+
+struct ElementOpL1 {
+    static float32x4_t
+    op(float32x4_t msum, float32x4_t x, float32x4_t y) {
+        return vaddq_f32(msum, vabdq_f32(x, y));
+    }
+
+    static float
+    op(float x, float y) {
+        return std::fabs(x - y);
+    }
+};
+
+// sum of op over the d dimensions, two accumulators to hide the latency of the fma
+template <class ElementOp>
+float
+fvec_op_neon(const float* x, const float* y, size_t d) {
+    float32x4_t msum0 = vdupq_n_f32(0.0f);
+    float32x4_t msum1 = vdupq_n_f32(0.0f);
+    size_t i = 0;
+    for (; i + 8 <= d; i += 8) {
+        msum0 = ElementOp::op(msum0, vld1q_f32(x + i), vld1q_f32(y + i));
+        msum1 = ElementOp::op(msum1, vld1q_f32(x + i + 4), vld1q_f32(y + i + 4));
+    }
+    if (i + 4 <= d) {
+        msum0 = ElementOp::op(msum0, vld1q_f32(x + i), vld1q_f32(y + i));
+        i += 4;
+    }
+    float res = vaddvq_f32(vaddq_f32(msum0, msum1));
+    for (; i < d; i++) {
+        res += ElementOp::op(x[i], y[i]);
+    }
+    return res;
+}
+
+// distances between x and 4 rows of y, each block of x is loaded once for the 4 of them
+template <class ElementOp>
+void
+fvec_op_4_neon(float* dis, const float* x, const float* y0, const float* y1, const float* y2, const float* y3,
+               size_t d) {
+    const size_t d4 = d & ~size_t(3);
+    float32x4_t msum0 = vdupq_n_f32(0.0f);
+    float32x4_t msum1 = vdupq_n_f32(0.0f);
+    float32x4_t msum2 = vdupq_n_f32(0.0f);
+    float32x4_t msum3 = vdupq_n_f32(0.0f);
+    for (size_t j = 0; j < d4; j += 4) {
+        const float32x4_t mx = vld1q_f32(x + j);
+        msum0 = ElementOp::op(msum0, mx, vld1q_f32(y0 + j));
+        msum1 = ElementOp::op(msum1, mx, vld1q_f32(y1 + j));
+        msum2 = ElementOp::op(msum2, mx, vld1q_f32(y2 + j));
+        msum3 = ElementOp::op(msum3, mx, vld1q_f32(y3 + j));
+    }
+    // pairwise adds leave the 4 sums in the 4 lanes
+    float32x4_t msum = vpaddq_f32(vpaddq_f32(msum0, msum1), vpaddq_f32(msum2, msum3));
+    if (d4 < d) {
+        float tails[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+        for (size_t j = d4; j < d; j++) {
+            tails[0] += ElementOp::op(x[j], y0[j]);
+            tails[1] += ElementOp::op(x[j], y1[j]);
+            tails[2] += ElementOp::op(x[j], y2[j]);
+            tails[3] += ElementOp::op(x[j], y3[j]);
+        }
+        msum = vaddq_f32(msum, vld1q_f32(tails));
+    }
+    vst1q_f32(dis, msum);
+}
+
+// 4 rows of y per pass
+template <class ElementOp>
+void
+fvec_op_ny_neon(float* dis, const float* x, const float* y, size_t d, size_t ny) {
+    size_t i = 0;
+    for (; i + 4 <= ny; i += 4) {
+        const float* y0 = y + i * d;
+        fvec_op_4_neon<ElementOp>(dis + i, x, y0, y0 + d, y0 + 2 * d, y0 + 3 * d, d);
+    }
+    for (; i < ny; i++) {
+        dis[i] = fvec_op_neon<ElementOp>(x, y + i * d, d);
+    }
+}
+
+inline void
+prefetch_row(const char* row, size_t d) {
+    for (size_t off = 0; off < d * sizeof(float); off += 64) {
+        __builtin_prefetch(row + off);
+    }
+}
+
+// 4 gathered rows per pass, the rows of the next pass are prefetched meanwhile
+template <class ElementOp>
+void
+fvec_op_batch_indexed_neon(float* dis, const float* x, const char* base, const uint32_t* ids, size_t n, size_t d,
+                           size_t stride) {
+    auto row = [&](size_t i) { return base + ids[i] * stride; };
+    for (size_t i = 0; i < n && i < 4; i++) {
+        prefetch_row(row(i), d);
+    }
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        for (size_t j = i + 4; j < n && j < i + 8; j++) {
+            prefetch_row(row(j), d);
+        }
+        fvec_op_4_neon<ElementOp>(dis + i, x, (const float*)row(i), (const float*)row(i + 1),
+                                  (const float*)row(i + 2), (const float*)row(i + 3), d);
+    }
+    for (; i < n; i++) {
+        dis[i] = fvec_op_neon<ElementOp>(x, (const float*)row(i), d);
+    }
+}
+
+// D floats in blocks of 16, a constant trip count without tail that the compiler unrolls
+template <class ElementOp, size_t D>
+float
+fvec_op_d_neon(const float* x, const float* y, size_t) {
+    static_assert(D % 16 == 0, "the specialized dims are multiples of 16");
+    float32x4_t msum0 = vdupq_n_f32(0.0f);
+    float32x4_t msum1 = vdupq_n_f32(0.0f);
+    float32x4_t msum2 = vdupq_n_f32(0.0f);
+    float32x4_t msum3 = vdupq_n_f32(0.0f);
+    for (size_t j = 0; j < D; j += 16) {
+        msum0 = ElementOp::op(msum0, vld1q_f32(x + j), vld1q_f32(y + j));
+        msum1 = ElementOp::op(msum1, vld1q_f32(x + j + 4), vld1q_f32(y + j + 4));
+        msum2 = ElementOp::op(msum2, vld1q_f32(x + j + 8), vld1q_f32(y + j + 8));
+        msum3 = ElementOp::op(msum3, vld1q_f32(x + j + 12), vld1q_f32(y + j + 12));
+    }
+    return vaddvq_f32(vaddq_f32(vaddq_f32(msum0, msum1), vaddq_f32(msum2, msum3)));
+}
+
+template <class ElementOp>
+auto
+fvec_op_dim_neon(size_t d) -> float (*)(const float*, const float*, size_t) {
+#define DISPATCH(dval) \
+    case dval:         \
+        return fvec_op_d_neon<ElementOp, dval>;
+
+    switch (d) {
+        DISPATCH(128)
+        DISPATCH(256)
+        DISPATCH(384)
+        DISPATCH(512)
+        DISPATCH(768)
+        DISPATCH(1024)
+        DISPATCH(1536)
+        default:
+            return nullptr;
+    }
+#undef DISPATCH
+}
+
+}  // namespace
+
+float
+fvec_L2sqr_neon(const float* x, const float* y, size_t d) {
+    return fvec_op_neon<ElementOpL2>(x, y, d);
+}
+
+float
+fvec_inner_product_neon(const float* x, const float* y, size_t d) {
+    return fvec_op_neon<ElementOpIP>(x, y, d);
+}
+
+float
+fvec_L1_neon(const float* x, const float* y, size_t d) {
+    return fvec_op_neon<ElementOpL1>(x, y, d);
+}
+
+float
+fvec_Linf_neon(const float* x, const float* y, size_t d) {
+    float32x4_t mmax = vdupq_n_f32(0.0f);
+    size_t i = 0;
+    for (; i + 4 <= d; i += 4) {
+        mmax = vmaxq_f32(mmax, vabdq_f32(vld1q_f32(x + i), vld1q_f32(y + i)));
+    }
+    float res = vmaxvq_f32(mmax);
+    for (; i < d; i++) {
+        res = std::max(res, std::fabs(x[i] - y[i]));
+    }
+    return res;
+}
+
+float
+fvec_norm_L2sqr_neon(const float* x, size_t d) {
+    return fvec_op_neon<ElementOpIP>(x, x, d);
+}
+
+static inline float
+cosine_from_sums(float ip, float norm_x, float norm_y) {
+    return (norm_x > 0 && norm_y > 0) ? ip / (std::sqrt(norm_x) * std::sqrt(norm_y)) : 0.0f;
+}
+
+float
+fvec_cosine_neon(const float* x, const float* y, size_t d) {
+    float32x4_t mip = vdupq_n_f32(0.0f);
+    float32x4_t mnx = vdupq_n_f32(0.0f);
+    float32x4_t mny = vdupq_n_f32(0.0f);
+    size_t i = 0;
+    for (; i + 4 <= d; i += 4) {
+        const float32x4_t mx = vld1q_f32(x + i);
+        const float32x4_t my = vld1q_f32(y + i);
+        mip = vfmaq_f32(mip, mx, my);
+        mnx = vfmaq_f32(mnx, mx, mx);
+        mny = vfmaq_f32(mny, my, my);
+    }
+    float ip = vaddvq_f32(mip), norm_x = vaddvq_f32(mnx), norm_y = vaddvq_f32(mny);
+    for (; i < d; i++) {
+        ip += x[i] * y[i];
+        norm_x += x[i] * x[i];
+        norm_y += y[i] * y[i];
+    }
+    return cosine_from_sums(ip, norm_x, norm_y);
+}
+
+void
+fvec_L2sqr_ny_neon(float* dis, const float* x, const float* y, size_t d, size_t ny) {
+    fvec_op_ny_neon<ElementOpL2>(dis, x, y, d, ny);
+}
+
+void
+fvec_inner_products_ny_neon(float* ip, const float* x, const float* y, size_t d, size_t ny) {
+    fvec_op_ny_neon<ElementOpIP>(ip, x, y, d, ny);
+}
+
+void
+fvec_L2sqr_batch_indexed_neon(float* dis, const float* x, const char* base, const uint32_t* ids, size_t n, size_t d,
+                              size_t stride) {
+    fvec_op_batch_indexed_neon<ElementOpL2>(dis, x, base, ids, n, d, stride);
+}
+
+void
+fvec_inner_product_batch_indexed_neon(float* ip, const float* x, const char* base, const uint32_t* ids, size_t n,
+                                      size_t d, size_t stride) {
+    fvec_op_batch_indexed_neon<ElementOpIP>(ip, x, base, ids, n, d, stride);
+}
+
+auto
+fvec_L2sqr_dim_neon(size_t d) -> float (*)(const float*, const float*, size_t) {
+    return fvec_op_dim_neon<ElementOpL2>(d);
+}
+
+auto
+fvec_inner_product_dim_neon(size_t d) -> float (*)(const float*, const float*, size_t) {
+    return fvec_op_dim_neon<ElementOpIP>(d);
+}
+
+float
+i8vec_L2sqr_neon(const int8_t* x, const int8_t* y, size_t d) {
+    int32x4_t msum = vdupq_n_s32(0);
+    size_t i = 0;
+    for (; i + 8 <= d; i += 8) {
+        // the differences span 9 bits, their squares are summed in int32
+        const int16x8_t a = vsubl_s8(vld1_s8(x + i), vld1_s8(y + i));
+        msum = vmlal_s16(msum, vget_low_s16(a), vget_low_s16(a));
+        msum = vmlal_high_s16(msum, a, a);
+    }
+    int32_t res = vaddvq_s32(msum);
+    for (; i < d; i++) {
+        const int32_t tmp = (int32_t)x[i] - (int32_t)y[i];
+        res += tmp * tmp;
+    }
+    return (float)res;
+}
+
+float
+i8vec_inner_product_neon(const int8_t* x, const int8_t* y, size_t d) {
+    int32x4_t msum = vdupq_n_s32(0);
+    size_t i = 0;
+    for (; i + 8 <= d; i += 8) {
+        // the products of int8 fit int16, pairs of them are summed into int32
+        msum = vpadalq_s16(msum, vmull_s8(vld1_s8(x + i), vld1_s8(y + i)));
+    }
+    int32_t res = vaddvq_s32(msum);
+    for (; i < d; i++) {
+        res += (int32_t)x[i] * (int32_t)y[i];
+    }
+    return (float)res;
+}
+
+void
+i8vec_L2sqr_ny_neon(float* dis, const int8_t* x, const int8_t* y, size_t d, size_t ny) {
+    for (size_t i = 0; i < ny; i++) {
+        dis[i] = i8vec_L2sqr_neon(x, y + i * d, d);
+    }
+}
+
+void
+i8vec_inner_products_ny_neon(float* ip, const int8_t* x, const int8_t* y, size_t d, size_t ny) {
+    for (size_t i = 0; i < ny; i++) {
+        ip[i] = i8vec_inner_product_neon(x, y + i * d, d);
+    }
+}
+
+}  // namespace faiss
+#endif
@@ -0,0 +1,85 @@
+// Copyright (C) 2019-2023 Zilliz. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file except in compliance
+// with the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
+// or implied. See the License for the specific language governing permissions and limitations under the License.
+
+#ifndef DISTANCES_NEON_H
+#define DISTANCES_NEON_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace faiss {
+
+/// Squared L2 distance between two vectors
+float
+fvec_L2sqr_neon(const float* x, const float* y, size_t d);
+
+/// inner product
+float
+fvec_inner_product_neon(const float* x, const float* y, size_t d);
+
+/// L1 distance
+float
+fvec_L1_neon(const float* x, const float* y, size_t d);
+
+/// infinity distance
+float
+fvec_Linf_neon(const float* x, const float* y, size_t d);
+
+/// squared norm of x
+float
+fvec_norm_L2sqr_neon(const float* x, size_t d);
+
+/// cosine similarity of x and y, the inner product and both norms summed in one pass; 0 if either is zero
+float
+fvec_cosine_neon(const float* x, const float* y, size_t d);
+
+/// squared L2 distances between x and the ny vectors of y, stored one after the other
+void
+fvec_L2sqr_ny_neon(float* dis, const float* x, const float* y, size_t d, size_t ny);
+
+/// inner products between x and the ny vectors of y
+void
+fvec_inner_products_ny_neon(float* ip, const float* x, const float* y, size_t d, size_t ny);
+
+/// distances between x and the n vectors of d floats at base + ids[i] * stride bytes
+void
+fvec_L2sqr_batch_indexed_neon(float* dis, const float* x, const char* base, const uint32_t* ids, size_t n, size_t d,
+                              size_t stride);
+
+void
+fvec_inner_product_batch_indexed_neon(float* ip, const float* x, const char* base, const uint32_t* ids, size_t n,
+                                      size_t d, size_t stride);
+
+/// squared L2 distance and inner product kernels unrolled for d in 128, 256, 384, 512, 768, 1024 and 1536, nullptr
+/// for any other d; the kernels ignore their size argument
+auto
+fvec_L2sqr_dim_neon(size_t d) -> float (*)(const float*, const float*, size_t);
+
+auto
+fvec_inner_product_dim_neon(size_t d) -> float (*)(const float*, const float*, size_t);
+
+/// squared L2 distance and inner product between int8 vectors, summed exactly in int32
+float
+i8vec_L2sqr_neon(const int8_t* x, const int8_t* y, size_t d);
+
+float
+i8vec_inner_product_neon(const int8_t* x, const int8_t* y, size_t d);
+
+/// the distances between x and the ny int8 vectors of y
+void
+i8vec_L2sqr_ny_neon(float* dis, const int8_t* x, const int8_t* y, size_t d, size_t ny);
+
+void
+i8vec_inner_products_ny_neon(float* ip, const int8_t* x, const int8_t* y, size_t d, size_t ny);
+
+}  // namespace faiss
+
+#endif /* DISTANCES_NEON_H */
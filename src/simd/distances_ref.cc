@@ -9,7 +9,9 @@
 
 #include "distances_ref.h"
 
+#include <algorithm>
 #include <cmath>
+#include <cstring>
 namespace faiss {
 
 float
@@ -60,6 +62,22 @@ fvec_norm_L2sqr_ref(const float* x, size_t d) {
     return res;
 }
 
+static inline float
+cosine_from_sums(float ip, float norm_x, float norm_y) {
+    return (norm_x > 0 && norm_y > 0) ? ip / (std::sqrt(norm_x) * std::sqrt(norm_y)) : 0.0f;
+}
+
+float
+fvec_cosine_ref(const float* x, const float* y, size_t d) {
+    float ip = 0, norm_x = 0, norm_y = 0;
+    for (size_t i = 0; i < d; i++) {
+        ip += x[i] * y[i];
+        norm_x += x[i] * x[i];
+        norm_y += y[i] * y[i];
+    }
+    return cosine_from_sums(ip, norm_x, norm_y);
+}
+
 void
 fvec_L2sqr_ny_ref(float* dis, const float* x, const float* y, size_t d, size_t ny) {
     for (size_t i = 0; i < ny; i++) {
@@ -76,6 +94,89 @@ fvec_inner_products_ny_ref(float* ip, const float* x, const float* y, size_t d,
     }
 }
 
+void
+fvec_L2sqr_batch_indexed_ref(float* dis, const float* x, const char* base, const uint32_t* ids, size_t n, size_t d,
+                             size_t stride) {
+    for (size_t i = 0; i < n; i++) {
+        dis[i] = fvec_L2sqr_ref(x, (const float*)(base + ids[i] * stride), d);
+    }
+}
+
+void
+fvec_inner_product_batch_indexed_ref(float* ip, const float* x, const char* base, const uint32_t* ids, size_t n,
+                                     size_t d, size_t stride) {
+    for (size_t i = 0; i < n; i++) {
+        ip[i] = fvec_inner_product_ref(x, (const float*)(base + ids[i] * stride), d);
+    }
+}
+
+namespace {
+
+struct ElementOpL2 {
+    static float
+    op(float x, float y) {
+        return (x - y) * (x - y);
+    }
+};
+
+struct ElementOpIP {
+    static float
+    op(float x, float y) {
+        return x * y;
+    }
+};
+
+// D floats as 16 partial sums, lanes the compiler vectorizes without reordering the additions
+template <class ElementOp, size_t D>
+float
+fvec_op_d_ref(const float* x, const float* y, size_t) {
+    static_assert(D % 16 == 0, "the specialized dims are multiples of 16");
+    float sums[16] = {0};
+    for (size_t j = 0; j < D; j += 16) {
+        for (size_t k = 0; k < 16; k++) {
+            sums[k] += ElementOp::op(x[j + k], y[j + k]);
+        }
+    }
+    float res = 0;
+    for (size_t k = 0; k < 16; k++) {
+        res += sums[k];
+    }
+    return res;
+}
+
+template <class ElementOp>
+auto
+fvec_op_dim_ref(size_t d) -> float (*)(const float*, const float*, size_t) {
+#define DISPATCH(dval) \
+    case dval:         \
+        return fvec_op_d_ref<ElementOp, dval>;
+
+    switch (d) {
+        DISPATCH(128)
+        DISPATCH(256)
+        DISPATCH(384)
+        DISPATCH(512)
+        DISPATCH(768)
+        DISPATCH(1024)
+        DISPATCH(1536)
+        default:
+            return nullptr;
+    }
+#undef DISPATCH
+}
+
+}  // namespace
+
+auto
+fvec_L2sqr_dim_ref(size_t d) -> float (*)(const float*, const float*, size_t) {
+    return fvec_op_dim_ref<ElementOpL2>(d);
+}
+
+auto
+fvec_inner_product_dim_ref(size_t d) -> float (*)(const float*, const float*, size_t) {
+    return fvec_op_dim_ref<ElementOpIP>(d);
+}
+
 void
 fvec_madd_ref(size_t n, const float* a, float bf, const float* b, float* c) {
     for (size_t i = 0; i < n; i++) c[i] = a[i] + bf * b[i];
@@ -96,4 +197,325 @@ fvec_madd_and_argmin_ref(size_t n, const float* a, float bf, const float* b, flo
     return imin;
 }
 
+void
+fvec_L2sqr_block_16_ref(float* dis, const float* x, const float* y, size_t d) {
+    float res[16] = {0};
+    for (size_t i = 0; i < d; i++) {
+        for (size_t j = 0; j < 16; j++) {
+            const float tmp = x[i] - y[i * 16 + j];
+            res[j] += tmp * tmp;
+        }
+    }
+    std::memcpy(dis, res, sizeof(res));
+}
+
+void
+fvec_inner_product_block_16_ref(float* ip, const float* x, const float* y, size_t d) {
+    float res[16] = {0};
+    for (size_t i = 0; i < d; i++) {
+        for (size_t j = 0; j < 16; j++) {
+            res[j] += x[i] * y[i * 16 + j];
+        }
+    }
+    std::memcpy(ip, res, sizeof(res));
+}
+
+static inline uint64_t
+load_u64(const uint8_t* p) {
+    uint64_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+int
+bvec_hamming_ref(const uint8_t* x, const uint8_t* y, size_t code_size) {
+    int accu = 0;
+    size_t i = 0;
+    for (; i + 8 <= code_size; i += 8) {
+        accu += __builtin_popcountll(load_u64(x + i) ^ load_u64(y + i));
+    }
+    for (; i < code_size; i++) {
+        accu += __builtin_popcount(x[i] ^ y[i]);
+    }
+    return accu;
+}
+
+float
+bvec_jaccard_ref(const uint8_t* x, const uint8_t* y, size_t code_size) {
+    int accu_num = 0;
+    int accu_den = 0;
+    size_t i = 0;
+    for (; i + 8 <= code_size; i += 8) {
+        uint64_t a = load_u64(x + i);
+        uint64_t b = load_u64(y + i);
+        accu_num += __builtin_popcountll(a & b);
+        accu_den += __builtin_popcountll(a | b);
+    }
+    for (; i < code_size; i++) {
+        accu_num += __builtin_popcount(x[i] & y[i]);
+        accu_den += __builtin_popcount(x[i] | y[i]);
+    }
+    return (accu_den == 0) ? 1.0f : (float)(accu_den - accu_num) / (float)accu_den;
+}
+
+void
+bvec_hamming_batch_4_ref(const uint8_t* x, const uint8_t* y0, const uint8_t* y1, const uint8_t* y2,
+                         const uint8_t* y3, size_t code_size, float& dis0, float& dis1, float& dis2, float& dis3) {
+    dis0 = bvec_hamming_ref(x, y0, code_size);
+    dis1 = bvec_hamming_ref(x, y1, code_size);
+    dis2 = bvec_hamming_ref(x, y2, code_size);
+    dis3 = bvec_hamming_ref(x, y3, code_size);
+}
+
+void
+bvec_jaccard_batch_4_ref(const uint8_t* x, const uint8_t* y0, const uint8_t* y1, const uint8_t* y2,
+                         const uint8_t* y3, size_t code_size, float& dis0, float& dis1, float& dis2, float& dis3) {
+    dis0 = bvec_jaccard_ref(x, y0, code_size);
+    dis1 = bvec_jaccard_ref(x, y1, code_size);
+    dis2 = bvec_jaccard_ref(x, y2, code_size);
+    dis3 = bvec_jaccard_ref(x, y3, code_size);
+}
+
+void
+bvec_hamming_ny_ref(float* dis, const uint8_t* x, const uint8_t* y, size_t code_size, size_t ny) {
+    for (size_t i = 0; i < ny; i++) {
+        dis[i] = bvec_hamming_ref(x, y + i * code_size, code_size);
+    }
+}
+
+void
+bvec_jaccard_ny_ref(float* dis, const uint8_t* x, const uint8_t* y, size_t code_size, size_t ny) {
+    for (size_t i = 0; i < ny; i++) {
+        dis[i] = bvec_jaccard_ref(x, y + i * code_size, code_size);
+    }
+}
+
+bool
+bvec_is_subset_ref(const uint8_t* x, const uint8_t* y, size_t code_size) {
+    size_t i = 0;
+    for (; i + 8 <= code_size; i += 8) {
+        uint64_t a = load_u64(x + i);
+        if ((a & load_u64(y + i)) != a) {
+            return false;
+        }
+    }
+    for (; i < code_size; i++) {
+        if ((x[i] & y[i]) != x[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+namespace {
+
+inline float
+float_from_bits(uint32_t u) {
+    float f;
+    std::memcpy(&f, &u, sizeof(f));
+    return f;
+}
+
+inline uint32_t
+float_to_bits(float f) {
+    uint32_t u;
+    std::memcpy(&u, &f, sizeof(u));
+    return u;
+}
+
+// fp16 <-> fp32 without F16C, via Fabian "ryg" Giesen, https://gist.github.com/2156668
+inline uint16_t
+fp16_from_float(float f) {
+    uint32_t fint = float_to_bits(f);
+    uint32_t sign = fint & 0x80000000u;
+    fint ^= sign;
+
+    // NaN->qNaN and Inf->Inf
+    const uint32_t f32infty = 255u << 23;
+    int32_t o = (fint > f32infty) ? 0x7e00u : 0x7c00u;
+
+    // shift the exponent down, denormalize if necessary
+    const uint32_t round_mask = ~0xfffu;
+    const uint32_t magic = 15u << 23;
+    float fscale = float_from_bits(fint & round_mask) * float_from_bits(magic);
+    fscale = std::min(fscale, float_from_bits((31u << 23) - 0x1000u));
+    int32_t fint2 = float_to_bits(fscale) - round_mask;
+    if (fint < f32infty) {
+        o = fint2 >> 13;
+    }
+    return (o | (sign >> 16));
+}
+
+inline float
+fp16_to_float(uint16_t h) {
+    const uint32_t shifted_exp = 0x7c00u << 13;
+    int32_t o = ((int32_t)(h & 0x7fffu)) << 13;
+    int32_t exp = shifted_exp & o;
+    o += (int32_t)(127 - 15) << 23;
+
+    int32_t infnan_val = o + ((int32_t)(128 - 16) << 23);
+    int32_t zerodenorm_val = float_to_bits(float_from_bits(o + (1u << 23)) - float_from_bits(113u << 23));
+    int32_t reg_val = (exp == 0) ? zerodenorm_val : o;
+
+    int32_t sign_bit = ((int32_t)(h & 0x8000u)) << 16;
+    return float_from_bits(((exp == shifted_exp) ? infnan_val : reg_val) | sign_bit);
+}
+
+inline uint16_t
+bf16_from_float(float f) {
+    uint32_t u = float_to_bits(f);
+    if ((u & 0x7fffffffu) > 0x7f800000u) {
+        // keeps NaN a quiet NaN
+        return (u >> 16) | 0x40;
+    }
+    u += 0x7fffu + ((u >> 16) & 1);
+    return u >> 16;
+}
+
+inline float
+bf16_to_float(uint16_t h) {
+    return float_from_bits((uint32_t)h << 16);
+}
+
+}  // namespace
+
+float
+fp16vec_L2sqr_ref(const float* x, const uint16_t* y, size_t d) {
+    float res = 0;
+    for (size_t i = 0; i < d; i++) {
+        const float tmp = x[i] - fp16_to_float(y[i]);
+        res += tmp * tmp;
+    }
+    return res;
+}
+
+float
+fp16vec_inner_product_ref(const float* x, const uint16_t* y, size_t d) {
+    float res = 0;
+    for (size_t i = 0; i < d; i++) {
+        res += x[i] * fp16_to_float(y[i]);
+    }
+    return res;
+}
+
+float
+bf16vec_L2sqr_ref(const float* x, const uint16_t* y, size_t d) {
+    float res = 0;
+    for (size_t i = 0; i < d; i++) {
+        const float tmp = x[i] - bf16_to_float(y[i]);
+        res += tmp * tmp;
+    }
+    return res;
+}
+
+float
+bf16vec_inner_product_ref(const float* x, const uint16_t* y, size_t d) {
+    float res = 0;
+    for (size_t i = 0; i < d; i++) {
+        res += x[i] * bf16_to_float(y[i]);
+    }
+    return res;
+}
+
+void
+fp16vec_L2sqr_ny_ref(float* dis, const float* x, const uint16_t* y, size_t d, size_t ny) {
+    for (size_t i = 0; i < ny; i++) {
+        dis[i] = fp16vec_L2sqr_ref(x, y + i * d, d);
+    }
+}
+
+void
+fp16vec_inner_products_ny_ref(float* ip, const float* x, const uint16_t* y, size_t d, size_t ny) {
+    for (size_t i = 0; i < ny; i++) {
+        ip[i] = fp16vec_inner_product_ref(x, y + i * d, d);
+    }
+}
+
+void
+bf16vec_L2sqr_ny_ref(float* dis, const float* x, const uint16_t* y, size_t d, size_t ny) {
+    for (size_t i = 0; i < ny; i++) {
+        dis[i] = bf16vec_L2sqr_ref(x, y + i * d, d);
+    }
+}
+
+void
+bf16vec_inner_products_ny_ref(float* ip, const float* x, const uint16_t* y, size_t d, size_t ny) {
+    for (size_t i = 0; i < ny; i++) {
+        ip[i] = bf16vec_inner_product_ref(x, y + i * d, d);
+    }
+}
+
+float
+i8vec_L2sqr_ref(const int8_t* x, const int8_t* y, size_t d) {
+    int32_t res = 0;
+    for (size_t i = 0; i < d; i++) {
+        const int32_t tmp = (int32_t)x[i] - (int32_t)y[i];
+        res += tmp * tmp;
+    }
+    return (float)res;
+}
+
+float
+i8vec_inner_product_ref(const int8_t* x, const int8_t* y, size_t d) {
+    int32_t res = 0;
+    for (size_t i = 0; i < d; i++) {
+        res += (int32_t)x[i] * (int32_t)y[i];
+    }
+    return (float)res;
+}
+
+void
+i8vec_L2sqr_ny_ref(float* dis, const int8_t* x, const int8_t* y, size_t d, size_t ny) {
+    for (size_t i = 0; i < ny; i++) {
+        dis[i] = i8vec_L2sqr_ref(x, y + i * d, d);
+    }
+}
+
+void
+i8vec_inner_products_ny_ref(float* ip, const int8_t* x, const int8_t* y, size_t d, size_t ny) {
+    for (size_t i = 0; i < ny; i++) {
+        ip[i] = i8vec_inner_product_ref(x, y + i * d, d);
+    }
+}
+
+void
+fvec_to_fp16_ref(uint16_t* y, const float* x, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        y[i] = fp16_from_float(x[i]);
+    }
+}
+
+void
+fp16_to_fvec_ref(float* x, const uint16_t* y, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        x[i] = fp16_to_float(y[i]);
+    }
+}
+
+void
+fvec_to_bf16_ref(uint16_t* y, const float* x, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        y[i] = bf16_from_float(x[i]);
+    }
+}
+
+void
+bf16_to_fvec_ref(float* x, const uint16_t* y, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        x[i] = bf16_to_float(y[i]);
+    }
+}
+
+void
+pq_adc_ny_ref(float* dis, const uint8_t* codes, const float* tables, size_t ny, size_t nchunks) {
+    for (size_t i = 0; i < ny; i++) {
+        const uint8_t* code = codes + i * nchunks;
+        float d = 0.0f;
+        for (size_t c = 0; c < nchunks; c++) {
+            d += tables[c * 256 + code[c]];
+        }
+        dis[i] = d;
+    }
+}
+
 }  // namespace faiss
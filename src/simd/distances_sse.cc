@@ -15,6 +15,7 @@
 #include <immintrin.h>
 
 #include <cassert>
+#include <cmath>
 #include <cstdint>
 
 #include "distances_ref.h"
@@ -64,6 +65,38 @@ fvec_norm_L2sqr_sse(const float* x, size_t d) {
     return _mm_cvtss_f32(msum1);
 }
 
+static inline float
+cosine_from_sums(float ip, float norm_x, float norm_y) {
+    return (norm_x > 0 && norm_y > 0) ? ip / (std::sqrt(norm_x) * std::sqrt(norm_y)) : 0.0f;
+}
+
+static inline float
+reduce_add_4(__m128 msum) {
+    msum = _mm_hadd_ps(msum, msum);
+    msum = _mm_hadd_ps(msum, msum);
+    return _mm_cvtss_f32(msum);
+}
+
+float
+fvec_cosine_sse(const float* x, const float* y, size_t d) {
+    __m128 mip = _mm_setzero_ps();
+    __m128 mnx = _mm_setzero_ps();
+    __m128 mny = _mm_setzero_ps();
+    while (d > 0) {
+        // the last block is read with zeros past d
+        __m128 mx = d >= 4 ? _mm_loadu_ps(x) : masked_read(d, x);
+        __m128 my = d >= 4 ? _mm_loadu_ps(y) : masked_read(d, y);
+        mip = _mm_add_ps(mip, _mm_mul_ps(mx, my));
+        mnx = _mm_add_ps(mnx, _mm_mul_ps(mx, mx));
+        mny = _mm_add_ps(mny, _mm_mul_ps(my, my));
+        size_t n = d >= 4 ? 4 : d;
+        x += n;
+        y += n;
+        d -= n;
+    }
+    return cosine_from_sums(reduce_add_4(mip), reduce_add_4(mnx), reduce_add_4(mny));
+}
+
 namespace {
 
 /// Function that does a component-wise operation between x and y
@@ -240,6 +273,99 @@ fvec_inner_products_ny_sse(float* dis, const float* x, const float* y, size_t d,
 #undef DISPATCH
 }
 
+namespace {
+
+// one gathered row at a time, the rows are prefetched 4 ahead
+template <class Distance>
+void
+fvec_batch_indexed_sse(float* dis, const float* x, const char* base, const uint32_t* ids, size_t n, size_t d,
+                       size_t stride, Distance distance) {
+    auto prefetch = [&](size_t i) {
+        const char* row = base + ids[i] * stride;
+        for (size_t off = 0; off < d * sizeof(float); off += 64) {
+            _mm_prefetch(row + off, _MM_HINT_T0);
+        }
+    };
+    for (size_t i = 0; i < n && i < 4; i++) {
+        prefetch(i);
+    }
+    for (size_t i = 0; i < n; i++) {
+        if (i + 4 < n) {
+            prefetch(i + 4);
+        }
+        dis[i] = distance(x, (const float*)(base + ids[i] * stride), d);
+    }
+}
+
+// D floats in blocks of 16, a constant trip count without tail that the compiler unrolls
+template <class ElementOp, size_t D>
+float
+fvec_op_d_sse(const float* x, const float* y, size_t) {
+    static_assert(D % 16 == 0, "the specialized dims are multiples of 16");
+    __m128 msum0 = _mm_setzero_ps();
+    __m128 msum1 = _mm_setzero_ps();
+    __m128 msum2 = _mm_setzero_ps();
+    __m128 msum3 = _mm_setzero_ps();
+    for (size_t j = 0; j < D; j += 16) {
+        msum0 = _mm_add_ps(msum0, ElementOp::op(_mm_loadu_ps(x + j), _mm_loadu_ps(y + j)));
+        msum1 = _mm_add_ps(msum1, ElementOp::op(_mm_loadu_ps(x + j + 4), _mm_loadu_ps(y + j + 4)));
+        msum2 = _mm_add_ps(msum2, ElementOp::op(_mm_loadu_ps(x + j + 8), _mm_loadu_ps(y + j + 8)));
+        msum3 = _mm_add_ps(msum3, ElementOp::op(_mm_loadu_ps(x + j + 12), _mm_loadu_ps(y + j + 12)));
+    }
+    __m128 msum = _mm_add_ps(_mm_add_ps(msum0, msum1), _mm_add_ps(msum2, msum3));
+    msum = _mm_hadd_ps(msum, msum);
+    msum = _mm_hadd_ps(msum, msum);
+    return _mm_cvtss_f32(msum);
+}
+
+template <class ElementOp>
+auto
+fvec_op_dim_sse(size_t d) -> float (*)(const float*, const float*, size_t) {
+#define DISPATCH(dval) \
+    case dval:         \
+        return fvec_op_d_sse<ElementOp, dval>;
+
+    switch (d) {
+        DISPATCH(128)
+        DISPATCH(256)
+        DISPATCH(384)
+        DISPATCH(512)
+        DISPATCH(768)
+        DISPATCH(1024)
+        DISPATCH(1536)
+        default:
+            return nullptr;
+    }
+#undef DISPATCH
+}
+
+}  // anonymous namespace
+
+void
+fvec_L2sqr_batch_indexed_sse(float* dis, const float* x, const char* base, const uint32_t* ids, size_t n, size_t d,
+                             size_t stride) {
+    fvec_batch_indexed_sse(dis, x, base, ids, n, d, stride,
+                           [](const float* a, const float* b, size_t len) { return fvec_L2sqr_sse(a, b, len); });
+}
+
+void
+fvec_inner_product_batch_indexed_sse(float* ip, const float* x, const char* base, const uint32_t* ids, size_t n,
+                                     size_t d, size_t stride) {
+    fvec_batch_indexed_sse(ip, x, base, ids, n, d, stride, [](const float* a, const float* b, size_t len) {
+        return fvec_inner_product_sse(a, b, len);
+    });
+}
+
+auto
+fvec_L2sqr_dim_sse(size_t d) -> float (*)(const float*, const float*, size_t) {
+    return fvec_op_dim_sse<ElementOpL2>(d);
+}
+
+auto
+fvec_inner_product_dim_sse(size_t d) -> float (*)(const float*, const float*, size_t) {
+    return fvec_op_dim_sse<ElementOpIP>(d);
+}
+
 float
 fvec_L1_sse(const float* x, const float* y, size_t d) {
     return fvec_L1_ref(x, y, d);
@@ -377,5 +503,66 @@ fvec_madd_and_argmin_sse(size_t n, const float* a, float bf, const float* b, flo
     return _mm_cvtsi128_si32(imin4);
 }
 
+namespace {
+
+// the sums of 8 products of int16 pairs in 4 int32 lanes
+inline int32_t
+reduce_add_epi32_sse(__m128i v) {
+    v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+    v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(v);
+}
+
+inline __m128i
+i8_load_8(const int8_t* x) {
+    return _mm_cvtepi8_epi16(_mm_loadl_epi64((const __m128i*)x));
+}
+
+}  // anonymous namespace
+
+float
+i8vec_L2sqr_sse(const int8_t* x, const int8_t* y, size_t d) {
+    __m128i msum = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 8 <= d; i += 8) {
+        const __m128i a = _mm_sub_epi16(i8_load_8(x + i), i8_load_8(y + i));
+        msum = _mm_add_epi32(msum, _mm_madd_epi16(a, a));
+    }
+    int32_t res = reduce_add_epi32_sse(msum);
+    for (; i < d; i++) {
+        const int32_t tmp = (int32_t)x[i] - (int32_t)y[i];
+        res += tmp * tmp;
+    }
+    return (float)res;
+}
+
+float
+i8vec_inner_product_sse(const int8_t* x, const int8_t* y, size_t d) {
+    __m128i msum = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 8 <= d; i += 8) {
+        msum = _mm_add_epi32(msum, _mm_madd_epi16(i8_load_8(x + i), i8_load_8(y + i)));
+    }
+    int32_t res = reduce_add_epi32_sse(msum);
+    for (; i < d; i++) {
+        res += (int32_t)x[i] * (int32_t)y[i];
+    }
+    return (float)res;
+}
+
+void
+i8vec_L2sqr_ny_sse(float* dis, const int8_t* x, const int8_t* y, size_t d, size_t ny) {
+    for (size_t i = 0; i < ny; i++) {
+        dis[i] = i8vec_L2sqr_sse(x, y + i * d, d);
+    }
+}
+
+void
+i8vec_inner_products_ny_sse(float* ip, const int8_t* x, const int8_t* y, size_t d, size_t ny) {
+    for (size_t i = 0; i < ny; i++) {
+        ip[i] = i8vec_inner_product_sse(x, y + i * d, d);
+    }
+}
+
 }  // namespace faiss
 #endif
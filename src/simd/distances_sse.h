@@ -12,6 +12,7 @@
 #ifndef DISTANCES_SSE_H
 #define DISTANCES_SSE_H
 
+#include <cstdint>
 #include <cstdio>
 namespace faiss {
 
@@ -34,12 +35,47 @@ fvec_Linf_sse(const float* x, const float* y, size_t d);
 float
 fvec_norm_L2sqr_sse(const float* x, size_t d);
 
+/// cosine similarity of x and y, the inner product and both norms summed in one pass; 0 if either is zero
+float
+fvec_cosine_sse(const float* x, const float* y, size_t d);
+
 void
 fvec_L2sqr_ny_sse(float* dis, const float* x, const float* y, size_t d, size_t ny);
 
 void
 fvec_inner_products_ny_sse(float* ip, const float* x, const float* y, size_t d, size_t ny);
 
+/// distances between x and the n vectors of d floats at base + ids[i] * stride bytes
+void
+fvec_L2sqr_batch_indexed_sse(float* dis, const float* x, const char* base, const uint32_t* ids, size_t n, size_t d,
+                             size_t stride);
+
+void
+fvec_inner_product_batch_indexed_sse(float* ip, const float* x, const char* base, const uint32_t* ids, size_t n,
+                                     size_t d, size_t stride);
+
+/// squared L2 distance and inner product kernels unrolled for d in 128, 256, 384, 512, 768, 1024 and 1536, nullptr
+/// for any other d; the kernels ignore their size argument
+auto
+fvec_L2sqr_dim_sse(size_t d) -> float (*)(const float*, const float*, size_t);
+
+auto
+fvec_inner_product_dim_sse(size_t d) -> float (*)(const float*, const float*, size_t);
+
+/// squared L2 distance and inner product between int8 vectors, summed exactly in int32
+float
+i8vec_L2sqr_sse(const int8_t* x, const int8_t* y, size_t d);
+
+float
+i8vec_inner_product_sse(const int8_t* x, const int8_t* y, size_t d);
+
+/// the distances between x and the ny int8 vectors of y
+void
+i8vec_L2sqr_ny_sse(float* dis, const int8_t* x, const int8_t* y, size_t d, size_t ny);
+
+void
+i8vec_inner_products_ny_sse(float* ip, const int8_t* x, const int8_t* y, size_t d, size_t ny);
+
 void
 fvec_madd_sse(size_t n, const float* a, float bf, const float* b, float* c);
 
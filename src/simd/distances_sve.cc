@@ -0,0 +1,145 @@
+// Copyright (C) 2019-2023 Zilliz. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file except in compliance
+// with the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
+// or implied. See the License for the specific language governing permissions and limitations under the License.
+
+#if defined(__aarch64__)
+
+#include "distances_sve.h"
+
+#include <arm_sve.h>
+
+namespace faiss {
+
+// The kernels are vector length agnostic: svcntw() floats per register, 8 on Graviton3, and the tail of the
+// dimension goes through the same loop under a svwhilelt predicate.
+
+namespace {
+
+struct ElementOpL2 {
+    static svfloat32_t
+    op(svbool_t pg, svfloat32_t msum, svfloat32_t x, svfloat32_t y) {
+        const svfloat32_t a_m_b = svsub_f32_x(pg, x, y);
+        return svmla_f32_m(pg, msum, a_m_b, a_m_b);
+    }
+};
+
+struct ElementOpIP {
+    static svfloat32_t
+    op(svbool_t pg, svfloat32_t msum, svfloat32_t x, svfloat32_t y) {
+        return svmla_f32_m(pg, msum, x, y);
+    }
+};
+
+struct ElementOpL1 {
+    static svfloat32_t
+    op(svbool_t pg, svfloat32_t msum, svfloat32_t x, svfloat32_t y) {
+        return svadd_f32_m(pg, msum, svabd_f32_x(pg, x, y));
+    }
+};
+
+// sum of op over the d dimensions, two accumulators to hide the latency of the fma
+template <class ElementOp>
+float
+fvec_op_sve(const float* x, const float* y, size_t d) {
+    const size_t step = svcntw();
+    const svbool_t all = svptrue_b32();
+    svfloat32_t msum0 = svdup_n_f32(0.0f);
+    svfloat32_t msum1 = svdup_n_f32(0.0f);
+    size_t i = 0;
+    for (; i + 2 * step <= d; i += 2 * step) {
+        msum0 = ElementOp::op(all, msum0, svld1_f32(all, x + i), svld1_f32(all, y + i));
+        msum1 = ElementOp::op(all, msum1, svld1_f32(all, x + i + step), svld1_f32(all, y + i + step));
+    }
+    for (; i < d; i += step) {
+        const svbool_t pg = svwhilelt_b32_u64(i, d);
+        msum0 = ElementOp::op(pg, msum0, svld1_f32(pg, x + i), svld1_f32(pg, y + i));
+    }
+    return svaddv_f32(all, svadd_f32_x(all, msum0, msum1));
+}
+
+// 4 rows of y per pass, each block of x is loaded once for the 4 of them
+template <class ElementOp>
+void
+fvec_op_ny_sve(float* dis, const float* x, const float* y, size_t d, size_t ny) {
+    const size_t step = svcntw();
+    const svbool_t all = svptrue_b32();
+    size_t i = 0;
+    for (; i + 4 <= ny; i += 4) {
+        const float* y0 = y + i * d;
+        const float* y1 = y0 + d;
+        const float* y2 = y1 + d;
+        const float* y3 = y2 + d;
+        svfloat32_t msum0 = svdup_n_f32(0.0f);
+        svfloat32_t msum1 = svdup_n_f32(0.0f);
+        svfloat32_t msum2 = svdup_n_f32(0.0f);
+        svfloat32_t msum3 = svdup_n_f32(0.0f);
+        for (size_t j = 0; j < d; j += step) {
+            const svbool_t pg = svwhilelt_b32_u64(j, d);
+            const svfloat32_t mx = svld1_f32(pg, x + j);
+            msum0 = ElementOp::op(pg, msum0, mx, svld1_f32(pg, y0 + j));
+            msum1 = ElementOp::op(pg, msum1, mx, svld1_f32(pg, y1 + j));
+            msum2 = ElementOp::op(pg, msum2, mx, svld1_f32(pg, y2 + j));
+            msum3 = ElementOp::op(pg, msum3, mx, svld1_f32(pg, y3 + j));
+        }
+        dis[i] = svaddv_f32(all, msum0);
+        dis[i + 1] = svaddv_f32(all, msum1);
+        dis[i + 2] = svaddv_f32(all, msum2);
+        dis[i + 3] = svaddv_f32(all, msum3);
+    }
+    for (; i < ny; i++) {
+        dis[i] = fvec_op_sve<ElementOp>(x, y + i * d, d);
+    }
+}
+
+}  // namespace
+
+float
+fvec_L2sqr_sve(const float* x, const float* y, size_t d) {
+    return fvec_op_sve<ElementOpL2>(x, y, d);
+}
+
+float
+fvec_inner_product_sve(const float* x, const float* y, size_t d) {
+    return fvec_op_sve<ElementOpIP>(x, y, d);
+}
+
+float
+fvec_L1_sve(const float* x, const float* y, size_t d) {
+    return fvec_op_sve<ElementOpL1>(x, y, d);
+}
+
+float
+fvec_Linf_sve(const float* x, const float* y, size_t d) {
+    const size_t step = svcntw();
+    svfloat32_t mmax = svdup_n_f32(0.0f);
+    for (size_t i = 0; i < d; i += step) {
+        const svbool_t pg = svwhilelt_b32_u64(i, d);
+        mmax = svmax_f32_m(pg, mmax, svabd_f32_x(pg, svld1_f32(pg, x + i), svld1_f32(pg, y + i)));
+    }
+    return svmaxv_f32(svptrue_b32(), mmax);
+}
+
+float
+fvec_norm_L2sqr_sve(const float* x, size_t d) {
+    return fvec_op_sve<ElementOpIP>(x, x, d);
+}
+
+void
+fvec_L2sqr_ny_sve(float* dis, const float* x, const float* y, size_t d, size_t ny) {
+    fvec_op_ny_sve<ElementOpL2>(dis, x, y, d, ny);
+}
+
+void
+fvec_inner_products_ny_sve(float* ip, const float* x, const float* y, size_t d, size_t ny) {
+    fvec_op_ny_sve<ElementOpIP>(ip, x, y, d, ny);
+}
+
+}  // namespace faiss
+#endif
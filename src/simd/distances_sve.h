@@ -0,0 +1,49 @@
+// Copyright (C) 2019-2023 Zilliz. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file except in compliance
+// with the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
+// or implied. See the License for the specific language governing permissions and limitations under the License.
+
+#ifndef DISTANCES_SVE_H
+#define DISTANCES_SVE_H
+
+#include <cstddef>
+
+namespace faiss {
+
+/// Squared L2 distance between two vectors
+float
+fvec_L2sqr_sve(const float* x, const float* y, size_t d);
+
+/// inner product
+float
+fvec_inner_product_sve(const float* x, const float* y, size_t d);
+
+/// L1 distance
+float
+fvec_L1_sve(const float* x, const float* y, size_t d);
+
+/// infinity distance
+float
+fvec_Linf_sve(const float* x, const float* y, size_t d);
+
+/// squared norm of x
+float
+fvec_norm_L2sqr_sve(const float* x, size_t d);
+
+/// squared L2 distances between x and the ny vectors of y, stored one after the other
+void
+fvec_L2sqr_ny_sve(float* dis, const float* x, const float* y, size_t d, size_t ny);
+
+/// inner products between x and the ny vectors of y
+void
+fvec_inner_products_ny_sve(float* ip, const float* x, const float* y, size_t d, size_t ny);
+
+}  // namespace faiss
+
+#endif /* DISTANCES_SVE_H */
@@ -13,18 +13,41 @@
 
 #include "hook.h"
 
+#include <algorithm>
+#include <chrono>
 #include <iostream>
+#include <limits>
+#include <map>
 #include <mutex>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+#if defined(__x86_64__)
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#if defined(__aarch64__)
+#include <sys/auxv.h>
+#endif
 
 #include "faiss/FaissHook.h"
 
 #if defined(__x86_64__)
+#include "distances_amx.h"
 #include "distances_avx.h"
 #include "distances_avx512.h"
+#include "distances_avx512_vpopcnt.h"
 #include "distances_sse.h"
 #include "instruction_set.h"
 #endif
 
+#if defined(__aarch64__)
+#include "distances_neon.h"
+#include "distances_sve.h"
+#endif
+
 #include "distances_ref.h"
 #include "knowhere/log.h"
 namespace faiss {
@@ -33,6 +56,13 @@ namespace faiss {
 bool use_avx512 = true;
 bool use_avx2 = true;
 bool use_sse4_2 = true;
+bool use_amx = false;
+bool use_sq_int8_query = true;
+#endif
+
+#if defined(__aarch64__)
+bool use_sve = true;
+bool use_neon = true;
 #endif
 
 decltype(fvec_inner_product) fvec_inner_product = fvec_inner_product_ref;
@@ -40,10 +70,56 @@ decltype(fvec_L2sqr) fvec_L2sqr = fvec_L2sqr_ref;
 decltype(fvec_L1) fvec_L1 = fvec_L1_ref;
 decltype(fvec_Linf) fvec_Linf = fvec_Linf_ref;
 decltype(fvec_norm_L2sqr) fvec_norm_L2sqr = fvec_norm_L2sqr_ref;
+decltype(fvec_cosine) fvec_cosine = fvec_cosine_ref;
 decltype(fvec_L2sqr_ny) fvec_L2sqr_ny = fvec_L2sqr_ny_ref;
 decltype(fvec_inner_products_ny) fvec_inner_products_ny = fvec_inner_products_ny_ref;
 decltype(fvec_madd) fvec_madd = fvec_madd_ref;
 decltype(fvec_madd_and_argmin) fvec_madd_and_argmin = fvec_madd_and_argmin_ref;
+decltype(fvec_L2sqr_batch_indexed) fvec_L2sqr_batch_indexed = fvec_L2sqr_batch_indexed_ref;
+decltype(fvec_inner_product_batch_indexed) fvec_inner_product_batch_indexed = fvec_inner_product_batch_indexed_ref;
+decltype(fvec_L2sqr_block_16) fvec_L2sqr_block_16 = fvec_L2sqr_block_16_ref;
+decltype(fvec_inner_product_block_16) fvec_inner_product_block_16 = fvec_inner_product_block_16_ref;
+decltype(fp16vec_L2sqr) fp16vec_L2sqr = fp16vec_L2sqr_ref;
+decltype(fp16vec_inner_product) fp16vec_inner_product = fp16vec_inner_product_ref;
+decltype(bf16vec_L2sqr) bf16vec_L2sqr = bf16vec_L2sqr_ref;
+decltype(bf16vec_inner_product) bf16vec_inner_product = bf16vec_inner_product_ref;
+decltype(fp16vec_L2sqr_ny) fp16vec_L2sqr_ny = fp16vec_L2sqr_ny_ref;
+decltype(fp16vec_inner_products_ny) fp16vec_inner_products_ny = fp16vec_inner_products_ny_ref;
+decltype(bf16vec_L2sqr_ny) bf16vec_L2sqr_ny = bf16vec_L2sqr_ny_ref;
+decltype(bf16vec_inner_products_ny) bf16vec_inner_products_ny = bf16vec_inner_products_ny_ref;
+decltype(i8vec_L2sqr) i8vec_L2sqr = i8vec_L2sqr_ref;
+decltype(i8vec_inner_product) i8vec_inner_product = i8vec_inner_product_ref;
+decltype(i8vec_L2sqr_ny) i8vec_L2sqr_ny = i8vec_L2sqr_ny_ref;
+decltype(i8vec_inner_products_ny) i8vec_inner_products_ny = i8vec_inner_products_ny_ref;
+decltype(fvec_to_fp16) fvec_to_fp16 = fvec_to_fp16_ref;
+decltype(fp16_to_fvec) fp16_to_fvec = fp16_to_fvec_ref;
+decltype(fvec_to_bf16) fvec_to_bf16 = fvec_to_bf16_ref;
+decltype(bf16_to_fvec) bf16_to_fvec = bf16_to_fvec_ref;
+decltype(bvec_hamming) bvec_hamming = bvec_hamming_ref;
+decltype(bvec_jaccard_dis) bvec_jaccard_dis = bvec_jaccard_ref;
+decltype(bvec_hamming_batch_4) bvec_hamming_batch_4 = bvec_hamming_batch_4_ref;
+decltype(bvec_jaccard_batch_4) bvec_jaccard_batch_4 = bvec_jaccard_batch_4_ref;
+decltype(bvec_hamming_ny) bvec_hamming_ny = bvec_hamming_ny_ref;
+decltype(bvec_jaccard_ny) bvec_jaccard_ny = bvec_jaccard_ny_ref;
+decltype(bvec_is_subset) bvec_is_subset = bvec_is_subset_ref;
+decltype(pq_adc_ny) pq_adc_ny = pq_adc_ny_ref;
+decltype(fvec_inner_products_gemm) fvec_inner_products_gemm = nullptr;
+size_t fvec_prefetch_depth = 1;
+
+// the lookups of the dim specialized kernels of the hooked simd type
+static fvec_func_ptr (*fvec_L2sqr_dim)(size_t) = fvec_L2sqr_dim_ref;
+static fvec_func_ptr (*fvec_inner_product_dim)(size_t) = fvec_inner_product_dim_ref;
+
+static std::mutex hook_mutex;
+// the simd type of the last hook and the variants fvec_hook_tuned bound over it, "kernel=variant"
+static std::string hooked_simd_type;
+static std::vector<std::string> tuned_variants;
+// the slots of the dim kernels handed out so far, by dim; the nodes of a map do not move, so a slot stays valid while
+// every hook rebinds it
+static std::map<size_t, fvec_func_ptr> L2sqr_dim_slots;
+static std::map<size_t, fvec_func_ptr> inner_product_dim_slots;
+static void
+rebind_dim_slots();
 
 #if defined(__x86_64__)
 bool
@@ -52,6 +128,33 @@ cpu_support_avx512() {
     return (instruction_set_inst.AVX512F() && instruction_set_inst.AVX512DQ() && instruction_set_inst.AVX512BW());
 }
 
+bool
+cpu_support_avx512_vnni() {
+    InstructionSet& instruction_set_inst = InstructionSet::GetInstance();
+    return cpu_support_avx512() && instruction_set_inst.AVX512VNNI();
+}
+
+bool
+cpu_support_avx512_vpopcntdq() {
+    InstructionSet& instruction_set_inst = InstructionSet::GetInstance();
+    return cpu_support_avx512() && instruction_set_inst.AVX512VPOPCNTDQ();
+}
+
+// ARCH_REQ_XCOMP_PERM and the xsave feature number of the AMX tile data, which older kernel headers lack
+constexpr int kArchReqXcompPerm = 0x1023;
+constexpr int kXfeatureXtiledata = 18;
+
+bool
+cpu_support_amx() {
+    InstructionSet& instruction_set_inst = InstructionSet::GetInstance();
+    if (!cpu_support_avx512() || !instruction_set_inst.AMXTILE() || !instruction_set_inst.AMXBF16()) {
+        return false;
+    }
+    // linux hands out the tile data state only to the processes that ask for it
+    static const bool granted = syscall(SYS_arch_prctl, kArchReqXcompPerm, kXfeatureXtiledata) == 0;
+    return granted;
+}
+
 bool
 cpu_support_avx2() {
     InstructionSet& instruction_set_inst = InstructionSet::GetInstance();
@@ -65,10 +168,21 @@ cpu_support_sse4_2() {
 }
 #endif
 
+#if defined(__aarch64__)
+#ifndef HWCAP_SVE
+#define HWCAP_SVE (1 << 22)
+#endif
+
+bool
+cpu_support_sve() {
+    return (getauxval(AT_HWCAP) & HWCAP_SVE) != 0;
+}
+#endif
+
 void
 fvec_hook(std::string& simd_type) {
-    static std::mutex hook_mutex;
     std::lock_guard<std::mutex> lock(hook_mutex);
+    tuned_variants.clear();
 #if defined(__x86_64__)
     if (use_avx512 && cpu_support_avx512()) {
         fvec_inner_product = fvec_inner_product_avx512;
@@ -76,11 +190,51 @@ fvec_hook(std::string& simd_type) {
         fvec_L1 = fvec_L1_avx512;
         fvec_Linf = fvec_Linf_avx512;
 
-        fvec_norm_L2sqr = fvec_norm_L2sqr_sse;
-        fvec_L2sqr_ny = fvec_L2sqr_ny_sse;
-        fvec_inner_products_ny = fvec_inner_products_ny_sse;
-        fvec_madd = fvec_madd_sse;
-        fvec_madd_and_argmin = fvec_madd_and_argmin_sse;
+        fvec_norm_L2sqr = fvec_norm_L2sqr_avx512;
+        fvec_cosine = fvec_cosine_avx512;
+        fvec_L2sqr_ny = fvec_L2sqr_ny_avx512;
+        fvec_inner_products_ny = fvec_inner_products_ny_avx512;
+        fvec_L2sqr_batch_indexed = fvec_L2sqr_batch_indexed_avx512;
+        fvec_inner_product_batch_indexed = fvec_inner_product_batch_indexed_avx512;
+        fvec_L2sqr_dim = fvec_L2sqr_dim_avx512;
+        fvec_inner_product_dim = fvec_inner_product_dim_avx512;
+        fvec_madd = fvec_madd_avx512;
+        fvec_madd_and_argmin = fvec_madd_and_argmin_avx512;
+        fvec_L2sqr_block_16 = fvec_L2sqr_block_16_avx512;
+        fvec_inner_product_block_16 = fvec_inner_product_block_16_avx512;
+        fp16vec_L2sqr = fp16vec_L2sqr_avx512;
+        fp16vec_inner_product = fp16vec_inner_product_avx512;
+        bf16vec_L2sqr = bf16vec_L2sqr_avx512;
+        bf16vec_inner_product = bf16vec_inner_product_avx512;
+        fp16vec_L2sqr_ny = fp16vec_L2sqr_ny_avx512;
+        fp16vec_inner_products_ny = fp16vec_inner_products_ny_avx512;
+        bf16vec_L2sqr_ny = bf16vec_L2sqr_ny_avx512;
+        bf16vec_inner_products_ny = bf16vec_inner_products_ny_avx512;
+        fvec_to_fp16 = fvec_to_fp16_avx;
+        fp16_to_fvec = fp16_to_fvec_avx;
+        fvec_to_bf16 = fvec_to_bf16_avx;
+        bf16_to_fvec = bf16_to_fvec_avx;
+        bvec_hamming = bvec_hamming_avx512;
+        bvec_jaccard_dis = bvec_jaccard_avx512;
+        bvec_hamming_batch_4 = bvec_hamming_batch_4_avx512;
+        bvec_jaccard_batch_4 = bvec_jaccard_batch_4_avx512;
+        bvec_hamming_ny = bvec_hamming_ny_avx512;
+        bvec_jaccard_ny = bvec_jaccard_ny_avx512;
+        bvec_is_subset = bvec_is_subset_avx512;
+        if (cpu_support_avx512_vpopcntdq()) {
+            bvec_hamming = bvec_hamming_avx512_vpopcnt;
+            bvec_jaccard_dis = bvec_jaccard_avx512_vpopcnt;
+            bvec_hamming_batch_4 = bvec_hamming_batch_4_avx512_vpopcnt;
+            bvec_jaccard_batch_4 = bvec_jaccard_batch_4_avx512_vpopcnt;
+            bvec_hamming_ny = bvec_hamming_ny_avx512_vpopcnt;
+            bvec_jaccard_ny = bvec_jaccard_ny_avx512_vpopcnt;
+        }
+        pq_adc_ny = pq_adc_ny_avx512;
+        i8vec_L2sqr = i8vec_L2sqr_avx512;
+        i8vec_inner_product = i8vec_inner_product_avx512;
+        i8vec_L2sqr_ny = i8vec_L2sqr_ny_avx512;
+        i8vec_inner_products_ny = i8vec_inner_products_ny_avx512;
+        fvec_prefetch_depth = 4;
 
         simd_type = "AVX512";
     } else if (use_avx2 && cpu_support_avx2()) {
@@ -89,11 +243,43 @@ fvec_hook(std::string& simd_type) {
         fvec_L1 = fvec_L1_avx;
         fvec_Linf = fvec_Linf_avx;
 
-        fvec_norm_L2sqr = fvec_norm_L2sqr_sse;
-        fvec_L2sqr_ny = fvec_L2sqr_ny_sse;
-        fvec_inner_products_ny = fvec_inner_products_ny_sse;
-        fvec_madd = fvec_madd_sse;
-        fvec_madd_and_argmin = fvec_madd_and_argmin_sse;
+        fvec_norm_L2sqr = fvec_norm_L2sqr_avx;
+        fvec_cosine = fvec_cosine_avx;
+        fvec_L2sqr_ny = fvec_L2sqr_ny_avx;
+        fvec_inner_products_ny = fvec_inner_products_ny_avx;
+        fvec_L2sqr_batch_indexed = fvec_L2sqr_batch_indexed_avx;
+        fvec_inner_product_batch_indexed = fvec_inner_product_batch_indexed_avx;
+        fvec_L2sqr_dim = fvec_L2sqr_dim_avx;
+        fvec_inner_product_dim = fvec_inner_product_dim_avx;
+        fvec_madd = fvec_madd_avx;
+        fvec_madd_and_argmin = fvec_madd_and_argmin_avx;
+        fvec_L2sqr_block_16 = fvec_L2sqr_block_16_avx;
+        fvec_inner_product_block_16 = fvec_inner_product_block_16_avx;
+        fp16vec_L2sqr = fp16vec_L2sqr_avx;
+        fp16vec_inner_product = fp16vec_inner_product_avx;
+        bf16vec_L2sqr = bf16vec_L2sqr_avx;
+        bf16vec_inner_product = bf16vec_inner_product_avx;
+        fp16vec_L2sqr_ny = fp16vec_L2sqr_ny_avx;
+        fp16vec_inner_products_ny = fp16vec_inner_products_ny_avx;
+        bf16vec_L2sqr_ny = bf16vec_L2sqr_ny_avx;
+        bf16vec_inner_products_ny = bf16vec_inner_products_ny_avx;
+        fvec_to_fp16 = fvec_to_fp16_avx;
+        fp16_to_fvec = fp16_to_fvec_avx;
+        fvec_to_bf16 = fvec_to_bf16_avx;
+        bf16_to_fvec = bf16_to_fvec_avx;
+        bvec_hamming = bvec_hamming_avx;
+        bvec_jaccard_dis = bvec_jaccard_avx;
+        bvec_hamming_batch_4 = bvec_hamming_batch_4_avx;
+        bvec_jaccard_batch_4 = bvec_jaccard_batch_4_avx;
+        bvec_hamming_ny = bvec_hamming_ny_avx;
+        bvec_jaccard_ny = bvec_jaccard_ny_avx;
+        bvec_is_subset = bvec_is_subset_avx;
+        pq_adc_ny = pq_adc_ny_avx;
+        i8vec_L2sqr = i8vec_L2sqr_avx;
+        i8vec_inner_product = i8vec_inner_product_avx;
+        i8vec_L2sqr_ny = i8vec_L2sqr_ny_avx;
+        i8vec_inner_products_ny = i8vec_inner_products_ny_avx;
+        fvec_prefetch_depth = 3;
 
         simd_type = "AVX2";
     } else if (use_sse4_2 && cpu_support_sse4_2()) {
@@ -103,10 +289,42 @@ fvec_hook(std::string& simd_type) {
         fvec_Linf = fvec_Linf_sse;
 
         fvec_norm_L2sqr = fvec_norm_L2sqr_sse;
+        fvec_cosine = fvec_cosine_sse;
         fvec_L2sqr_ny = fvec_L2sqr_ny_sse;
         fvec_inner_products_ny = fvec_inner_products_ny_sse;
+        fvec_L2sqr_batch_indexed = fvec_L2sqr_batch_indexed_sse;
+        fvec_inner_product_batch_indexed = fvec_inner_product_batch_indexed_sse;
+        fvec_L2sqr_dim = fvec_L2sqr_dim_sse;
+        fvec_inner_product_dim = fvec_inner_product_dim_sse;
         fvec_madd = fvec_madd_sse;
         fvec_madd_and_argmin = fvec_madd_and_argmin_sse;
+        fvec_L2sqr_block_16 = fvec_L2sqr_block_16_ref;
+        fvec_inner_product_block_16 = fvec_inner_product_block_16_ref;
+        fp16vec_L2sqr = fp16vec_L2sqr_ref;
+        fp16vec_inner_product = fp16vec_inner_product_ref;
+        bf16vec_L2sqr = bf16vec_L2sqr_ref;
+        bf16vec_inner_product = bf16vec_inner_product_ref;
+        fp16vec_L2sqr_ny = fp16vec_L2sqr_ny_ref;
+        fp16vec_inner_products_ny = fp16vec_inner_products_ny_ref;
+        bf16vec_L2sqr_ny = bf16vec_L2sqr_ny_ref;
+        bf16vec_inner_products_ny = bf16vec_inner_products_ny_ref;
+        fvec_to_fp16 = fvec_to_fp16_ref;
+        fp16_to_fvec = fp16_to_fvec_ref;
+        fvec_to_bf16 = fvec_to_bf16_ref;
+        bf16_to_fvec = bf16_to_fvec_ref;
+        bvec_hamming = bvec_hamming_ref;
+        bvec_jaccard_dis = bvec_jaccard_ref;
+        bvec_hamming_batch_4 = bvec_hamming_batch_4_ref;
+        bvec_jaccard_batch_4 = bvec_jaccard_batch_4_ref;
+        bvec_hamming_ny = bvec_hamming_ny_ref;
+        bvec_jaccard_ny = bvec_jaccard_ny_ref;
+        bvec_is_subset = bvec_is_subset_ref;
+        pq_adc_ny = pq_adc_ny_ref;
+        i8vec_L2sqr = i8vec_L2sqr_sse;
+        i8vec_inner_product = i8vec_inner_product_sse;
+        i8vec_L2sqr_ny = i8vec_L2sqr_ny_sse;
+        i8vec_inner_products_ny = i8vec_inner_products_ny_sse;
+        fvec_prefetch_depth = 2;
 
         simd_type = "SSE4_2";
     } else {
@@ -116,14 +334,347 @@ fvec_hook(std::string& simd_type) {
         fvec_Linf = fvec_Linf_ref;
 
         fvec_norm_L2sqr = fvec_norm_L2sqr_ref;
+        fvec_cosine = fvec_cosine_ref;
         fvec_L2sqr_ny = fvec_L2sqr_ny_ref;
         fvec_inner_products_ny = fvec_inner_products_ny_ref;
+        fvec_L2sqr_batch_indexed = fvec_L2sqr_batch_indexed_ref;
+        fvec_inner_product_batch_indexed = fvec_inner_product_batch_indexed_ref;
+        fvec_L2sqr_dim = fvec_L2sqr_dim_ref;
+        fvec_inner_product_dim = fvec_inner_product_dim_ref;
         fvec_madd = fvec_madd_ref;
         fvec_madd_and_argmin = fvec_madd_and_argmin_ref;
+        fvec_L2sqr_block_16 = fvec_L2sqr_block_16_ref;
+        fvec_inner_product_block_16 = fvec_inner_product_block_16_ref;
+        fp16vec_L2sqr = fp16vec_L2sqr_ref;
+        fp16vec_inner_product = fp16vec_inner_product_ref;
+        bf16vec_L2sqr = bf16vec_L2sqr_ref;
+        bf16vec_inner_product = bf16vec_inner_product_ref;
+        fp16vec_L2sqr_ny = fp16vec_L2sqr_ny_ref;
+        fp16vec_inner_products_ny = fp16vec_inner_products_ny_ref;
+        bf16vec_L2sqr_ny = bf16vec_L2sqr_ny_ref;
+        bf16vec_inner_products_ny = bf16vec_inner_products_ny_ref;
+        fvec_to_fp16 = fvec_to_fp16_ref;
+        fp16_to_fvec = fp16_to_fvec_ref;
+        fvec_to_bf16 = fvec_to_bf16_ref;
+        bf16_to_fvec = bf16_to_fvec_ref;
+        bvec_hamming = bvec_hamming_ref;
+        bvec_jaccard_dis = bvec_jaccard_ref;
+        bvec_hamming_batch_4 = bvec_hamming_batch_4_ref;
+        bvec_jaccard_batch_4 = bvec_jaccard_batch_4_ref;
+        bvec_hamming_ny = bvec_hamming_ny_ref;
+        bvec_jaccard_ny = bvec_jaccard_ny_ref;
+        bvec_is_subset = bvec_is_subset_ref;
+        pq_adc_ny = pq_adc_ny_ref;
+        i8vec_L2sqr = i8vec_L2sqr_ref;
+        i8vec_inner_product = i8vec_inner_product_ref;
+        i8vec_L2sqr_ny = i8vec_L2sqr_ny_ref;
+        i8vec_inner_products_ny = i8vec_inner_products_ny_ref;
+        fvec_prefetch_depth = 1;
 
         simd_type = "GENERIC";
     }
+    // the bf16 products of AMX trade precision for throughput, so the gemm kernel is bound only when asked for
+    fvec_inner_products_gemm = nullptr;
+    if (use_amx && simd_type == "AVX512" && cpu_support_amx()) {
+        fvec_inner_products_gemm = fvec_inner_products_gemm_amx;
+        simd_type = "AMX";
+    }
+#elif defined(__aarch64__)
+    // NEON is part of the base armv8-a, the SVE kernels need the kernel to report the extension
+    if (use_sve && cpu_support_sve()) {
+        fvec_inner_product = fvec_inner_product_sve;
+        fvec_L2sqr = fvec_L2sqr_sve;
+        fvec_L1 = fvec_L1_sve;
+        fvec_Linf = fvec_Linf_sve;
+
+        fvec_norm_L2sqr = fvec_norm_L2sqr_sve;
+        fvec_cosine = fvec_cosine_neon;
+        fvec_L2sqr_ny = fvec_L2sqr_ny_sve;
+        fvec_inner_products_ny = fvec_inner_products_ny_sve;
+        fvec_L2sqr_batch_indexed = fvec_L2sqr_batch_indexed_neon;
+        fvec_inner_product_batch_indexed = fvec_inner_product_batch_indexed_neon;
+        fvec_L2sqr_dim = fvec_L2sqr_dim_neon;
+        fvec_inner_product_dim = fvec_inner_product_dim_neon;
+        i8vec_L2sqr = i8vec_L2sqr_neon;
+        i8vec_inner_product = i8vec_inner_product_neon;
+        i8vec_L2sqr_ny = i8vec_L2sqr_ny_neon;
+        i8vec_inner_products_ny = i8vec_inner_products_ny_neon;
+        fvec_prefetch_depth = 3;
+
+        simd_type = "SVE";
+    } else if (use_neon) {
+        fvec_inner_product = fvec_inner_product_neon;
+        fvec_L2sqr = fvec_L2sqr_neon;
+        fvec_L1 = fvec_L1_neon;
+        fvec_Linf = fvec_Linf_neon;
+
+        fvec_norm_L2sqr = fvec_norm_L2sqr_neon;
+        fvec_cosine = fvec_cosine_neon;
+        fvec_L2sqr_ny = fvec_L2sqr_ny_neon;
+        fvec_inner_products_ny = fvec_inner_products_ny_neon;
+        fvec_L2sqr_batch_indexed = fvec_L2sqr_batch_indexed_neon;
+        fvec_inner_product_batch_indexed = fvec_inner_product_batch_indexed_neon;
+        fvec_L2sqr_dim = fvec_L2sqr_dim_neon;
+        fvec_inner_product_dim = fvec_inner_product_dim_neon;
+        i8vec_L2sqr = i8vec_L2sqr_neon;
+        i8vec_inner_product = i8vec_inner_product_neon;
+        i8vec_L2sqr_ny = i8vec_L2sqr_ny_neon;
+        i8vec_inner_products_ny = i8vec_inner_products_ny_neon;
+        fvec_prefetch_depth = 2;
+
+        simd_type = "NEON";
+    } else {
+        fvec_inner_product = fvec_inner_product_ref;
+        fvec_L2sqr = fvec_L2sqr_ref;
+        fvec_L1 = fvec_L1_ref;
+        fvec_Linf = fvec_Linf_ref;
+
+        fvec_norm_L2sqr = fvec_norm_L2sqr_ref;
+        fvec_cosine = fvec_cosine_ref;
+        fvec_L2sqr_ny = fvec_L2sqr_ny_ref;
+        fvec_inner_products_ny = fvec_inner_products_ny_ref;
+        fvec_L2sqr_batch_indexed = fvec_L2sqr_batch_indexed_ref;
+        fvec_inner_product_batch_indexed = fvec_inner_product_batch_indexed_ref;
+        fvec_L2sqr_dim = fvec_L2sqr_dim_ref;
+        fvec_inner_product_dim = fvec_inner_product_dim_ref;
+        i8vec_L2sqr = i8vec_L2sqr_ref;
+        i8vec_inner_product = i8vec_inner_product_ref;
+        i8vec_L2sqr_ny = i8vec_L2sqr_ny_ref;
+        i8vec_inner_products_ny = i8vec_inner_products_ny_ref;
+        fvec_prefetch_depth = 1;
+
+        simd_type = "GENERIC";
+    }
+#endif
+    hooked_simd_type = simd_type;
+    rebind_dim_slots();
+}
+
+#if defined(__x86_64__)
+namespace {
+
+template <typename Func>
+using Variants = std::vector<std::pair<const char*, Func>>;
+
+// the variants of a kernel the cpu supports and the simd flags allow
+template <typename Func>
+Variants<Func>
+x86_variants(Func avx512, Func avx2, Func sse4_2, Func generic) {
+    Variants<Func> variants;
+    if (use_avx512 && cpu_support_avx512()) {
+        variants.emplace_back("AVX512", avx512);
+    }
+    if (use_avx2 && cpu_support_avx2()) {
+        variants.emplace_back("AVX2", avx2);
+    }
+    if (use_sse4_2 && cpu_support_sse4_2()) {
+        variants.emplace_back("SSE4_2", sse4_2);
+    }
+    variants.emplace_back("GENERIC", generic);
+    return variants;
+}
+
+#define X86_VARIANTS(func) x86_variants(func##_avx512, func##_avx, func##_sse, func##_ref)
+
+// rows of the calibration data, they stay in cache so that the kernels are timed and not the memory
+constexpr size_t tune_rows = 16;
+
+// nanoseconds per call, the best of a few rounds
+template <typename Call>
+double
+time_per_call(Call call, size_t calls) {
+    double best = std::numeric_limits<double>::max();
+    for (int round = 0; round < 3; round++) {
+        const auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < calls; i++) {
+            call(i);
+        }
+        const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+        best = std::min(best, elapsed.count() / calls);
+    }
+    return best;
+}
+
+// the index of the fastest variant, each dim counts by the time relative to the fastest variant at that dim so
+// that the large dims do not outweigh the small ones
+template <typename Func, typename Run>
+size_t
+fastest_variant(const Variants<Func>& variants, const std::vector<size_t>& dims, Run run) {
+    std::vector<double> score(variants.size(), 0.0);
+    for (size_t d : dims) {
+        std::vector<double> times;
+        for (auto& variant : variants) {
+            times.push_back(run(variant.second, d));
+        }
+        const double best = *std::min_element(times.begin(), times.end());
+        for (size_t k = 0; k < variants.size(); k++) {
+            score[k] += times[k] / best;
+        }
+    }
+    return std::min_element(score.begin(), score.end()) - score.begin();
+}
+
+template <typename Func, typename Run>
+void
+tune_kernel(const char* kernel, Func& target, const Variants<Func>& variants, const std::vector<size_t>& dims,
+            Run run) {
+    const size_t k = fastest_variant(variants, dims, run);
+    target = variants[k].second;
+    tuned_variants.push_back(std::string(kernel) + "=" + variants[k].first);
+}
+
+// the dim specialized kernels picked per dim by fvec_hook_tuned
+std::unordered_map<size_t, fvec_func_ptr> tuned_L2sqr_dim;
+std::unordered_map<size_t, fvec_func_ptr> tuned_inner_product_dim;
+
+void
+tune_dim_kernels(const char* kernel, std::unordered_map<size_t, fvec_func_ptr>& tuned,
+                 const Variants<fvec_func_ptr (*)(size_t)>& lookups, const std::vector<size_t>& dims,
+                 const float* x, const float* y) {
+    tuned.clear();
+    for (size_t d : dims) {
+        Variants<fvec_func_ptr> variants;
+        for (auto& lookup : lookups) {
+            if (const fvec_func_ptr func = lookup.second(d)) {
+                variants.emplace_back(lookup.first, func);
+            }
+        }
+        if (variants.empty()) {
+            continue;
+        }
+        const size_t k = fastest_variant(variants, {d}, [&](fvec_func_ptr func, size_t dim) {
+            volatile float sink = 0;
+            return time_per_call([&](size_t i) { sink = func(x, y + (i % tune_rows) * dim, dim); },
+                                 (1 << 19) / dim);
+        });
+        tuned[d] = variants[k].second;
+        tuned_variants.push_back(std::string(kernel) + "(" + std::to_string(d) + ")=" + variants[k].first);
+    }
+}
+
+}  // namespace
 #endif
+
+void
+fvec_hook_tuned(std::string& simd_type, const std::vector<size_t>& dims) {
+    fvec_hook(simd_type);
+#if defined(__x86_64__)
+    std::lock_guard<std::mutex> lock(hook_mutex);
+    if (dims.empty()) {
+        return;
+    }
+    const size_t max_dim = *std::max_element(dims.begin(), dims.end());
+    std::mt19937 rng(0);
+    std::uniform_real_distribution<float> distrib(-1.0f, 1.0f);
+    std::vector<float> x(max_dim);
+    std::vector<float> y(tune_rows * max_dim);
+    std::vector<float> dis(tune_rows);
+    std::vector<uint32_t> ids(tune_rows);
+    for (auto& v : x) {
+        v = distrib(rng);
+    }
+    for (auto& v : y) {
+        v = distrib(rng);
+    }
+    for (size_t i = 0; i < tune_rows; i++) {
+        ids[i] = (i * 7) % tune_rows;
+    }
+
+    // the calls of each timing round cover about 2^19 floats
+    auto one = [&](auto func, size_t d) {
+        volatile float sink = 0;
+        return time_per_call([&](size_t i) { sink = func(x.data(), y.data() + (i % tune_rows) * d, d); },
+                             (1 << 19) / d);
+    };
+    auto ny = [&](auto func, size_t d) {
+        return time_per_call([&](size_t) { func(dis.data(), x.data(), y.data(), d, tune_rows); },
+                             (1 << 19) / (d * tune_rows) + 1);
+    };
+    auto indexed = [&](auto func, size_t d) {
+        return time_per_call(
+            [&](size_t) {
+                func(dis.data(), x.data(), (const char*)y.data(), ids.data(), tune_rows, d, d * sizeof(float));
+            },
+            (1 << 19) / (d * tune_rows) + 1);
+    };
+    auto norm = [&](auto func, size_t d) {
+        volatile float sink = 0;
+        return time_per_call([&](size_t i) { sink = func(y.data() + (i % tune_rows) * d, d); }, (1 << 19) / d);
+    };
+
+    tune_kernel("fvec_L2sqr", fvec_L2sqr, X86_VARIANTS(fvec_L2sqr), dims, one);
+    tune_kernel("fvec_inner_product", fvec_inner_product, X86_VARIANTS(fvec_inner_product), dims, one);
+    tune_kernel("fvec_cosine", fvec_cosine, X86_VARIANTS(fvec_cosine), dims, one);
+    tune_kernel("fvec_norm_L2sqr", fvec_norm_L2sqr, X86_VARIANTS(fvec_norm_L2sqr), dims, norm);
+    tune_kernel("fvec_L2sqr_ny", fvec_L2sqr_ny, X86_VARIANTS(fvec_L2sqr_ny), dims, ny);
+    tune_kernel("fvec_inner_products_ny", fvec_inner_products_ny, X86_VARIANTS(fvec_inner_products_ny), dims, ny);
+    tune_kernel("fvec_L2sqr_batch_indexed", fvec_L2sqr_batch_indexed, X86_VARIANTS(fvec_L2sqr_batch_indexed), dims,
+                indexed);
+    tune_kernel("fvec_inner_product_batch_indexed", fvec_inner_product_batch_indexed,
+                X86_VARIANTS(fvec_inner_product_batch_indexed), dims, indexed);
+
+    tune_dim_kernels("fvec_L2sqr_for_dim", tuned_L2sqr_dim, X86_VARIANTS(fvec_L2sqr_dim), dims, x.data(), y.data());
+    tune_dim_kernels("fvec_inner_product_for_dim", tuned_inner_product_dim, X86_VARIANTS(fvec_inner_product_dim),
+                     dims, x.data(), y.data());
+    fvec_L2sqr_dim = [](size_t d) -> fvec_func_ptr {
+        auto it = tuned_L2sqr_dim.find(d);
+        return it != tuned_L2sqr_dim.end() ? it->second : nullptr;
+    };
+    fvec_inner_product_dim = [](size_t d) -> fvec_func_ptr {
+        auto it = tuned_inner_product_dim.find(d);
+        return it != tuned_inner_product_dim.end() ? it->second : nullptr;
+    };
+    rebind_dim_slots();
+#undef X86_VARIANTS
+#endif
+}
+
+std::string
+fvec_hook_variants() {
+    std::lock_guard<std::mutex> lock(hook_mutex);
+    if (tuned_variants.empty()) {
+        return hooked_simd_type;
+    }
+    std::string variants;
+    for (auto& variant : tuned_variants) {
+        variants += (variants.empty() ? "" : ",") + variant;
+    }
+    return variants;
+}
+
+fvec_func_ptr
+fvec_L2sqr_for_dim(size_t d) {
+    const fvec_func_ptr func = fvec_L2sqr_dim(d);
+    return func != nullptr ? func : fvec_L2sqr;
+}
+
+fvec_func_ptr
+fvec_inner_product_for_dim(size_t d) {
+    const fvec_func_ptr func = fvec_inner_product_dim(d);
+    return func != nullptr ? func : fvec_inner_product;
+}
+
+// called with hook_mutex held
+static void
+rebind_dim_slots() {
+    for (auto& [d, slot] : L2sqr_dim_slots) {
+        slot = fvec_L2sqr_for_dim(d);
+    }
+    for (auto& [d, slot] : inner_product_dim_slots) {
+        slot = fvec_inner_product_for_dim(d);
+    }
+}
+
+const fvec_func_ptr*
+fvec_L2sqr_slot_for_dim(size_t d) {
+    std::lock_guard<std::mutex> lock(hook_mutex);
+    return &L2sqr_dim_slots.try_emplace(d, fvec_L2sqr_for_dim(d)).first->second;
+}
+
+const fvec_func_ptr*
+fvec_inner_product_slot_for_dim(size_t d) {
+    std::lock_guard<std::mutex> lock(hook_mutex);
+    return &inner_product_dim_slots.try_emplace(d, fvec_inner_product_for_dim(d)).first->second;
 }
 
 static int init_hook_ = []() {
@@ -12,7 +12,9 @@
 #ifndef HOOK_H
 #define HOOK_H
 
+#include <cstdint>
 #include <string>
+#include <vector>
 namespace faiss {
 
 extern float (*fvec_inner_product)(const float*, const float*, size_t);
@@ -20,29 +22,134 @@ extern float (*fvec_L2sqr)(const float*, const float*, size_t);
 extern float (*fvec_L1)(const float*, const float*, size_t);
 extern float (*fvec_Linf)(const float*, const float*, size_t);
 extern float (*fvec_norm_L2sqr)(const float*, size_t);
+/// cosine similarity, the inner product and the two norms summed in one pass so neither vector is normalized first
+extern float (*fvec_cosine)(const float*, const float*, size_t);
 extern void (*fvec_L2sqr_ny)(float*, const float*, const float*, size_t, size_t);
 extern void (*fvec_inner_products_ny)(float*, const float*, const float*, size_t, size_t);
 extern void (*fvec_madd)(size_t, const float*, float, const float*, float*);
 extern int (*fvec_madd_and_argmin)(size_t, const float*, float, const float*, float*);
 
+/// distances between a vector and the n vectors of d floats at base + ids[i] * stride bytes, the rows a graph index
+/// gathers by id for one hop; the rows are prefetched ahead of the ones being computed
+extern void (*fvec_L2sqr_batch_indexed)(float*, const float*, const char*, const uint32_t*, size_t, size_t, size_t);
+extern void (*fvec_inner_product_batch_indexed)(float*, const float*, const char*, const uint32_t*, size_t, size_t,
+                                                size_t);
+
+using fvec_func_ptr = float (*)(const float*, const float*, size_t);
+
+/// the squared L2 distance / inner product kernel of the hooked simd type for vectors of d floats, unrolled without
+/// tail for the common dims 128, 256, 384, 512, 768, 1024 and 1536, fvec_L2sqr / fvec_inner_product for any other d.
+/// An index looks its kernel up once when it is trained or loaded and keeps the pointer
+fvec_func_ptr
+fvec_L2sqr_for_dim(size_t d);
+fvec_func_ptr
+fvec_inner_product_for_dim(size_t d);
+
+/// the same kernels kept in a slot that every fvec_hook / fvec_hook_tuned rebinds, for the indexes that outlive a
+/// KnowhereConfig::SetSimdType; the slot of a dim lives as long as the process
+const fvec_func_ptr*
+fvec_L2sqr_slot_for_dim(size_t d);
+const fvec_func_ptr*
+fvec_inner_product_slot_for_dim(size_t d);
+
+/// distances between a vector and the 16 vectors of a column block, which holds d rows of 16 floats
+extern void (*fvec_L2sqr_block_16)(float*, const float*, const float*, size_t);
+extern void (*fvec_inner_product_block_16)(float*, const float*, const float*, size_t);
+
+/// distances between a float vector and ones stored as fp16 or bf16 halves, the ny forms take ny vectors stored one
+/// after the other
+extern float (*fp16vec_L2sqr)(const float*, const uint16_t*, size_t);
+extern float (*fp16vec_inner_product)(const float*, const uint16_t*, size_t);
+extern float (*bf16vec_L2sqr)(const float*, const uint16_t*, size_t);
+extern float (*bf16vec_inner_product)(const float*, const uint16_t*, size_t);
+extern void (*fp16vec_L2sqr_ny)(float*, const float*, const uint16_t*, size_t, size_t);
+extern void (*fp16vec_inner_products_ny)(float*, const float*, const uint16_t*, size_t, size_t);
+extern void (*bf16vec_L2sqr_ny)(float*, const float*, const uint16_t*, size_t, size_t);
+extern void (*bf16vec_inner_products_ny)(float*, const float*, const uint16_t*, size_t, size_t);
+
+/// distances between int8 vectors, summed exactly in int32
+extern float (*i8vec_L2sqr)(const int8_t*, const int8_t*, size_t);
+extern float (*i8vec_inner_product)(const int8_t*, const int8_t*, size_t);
+extern void (*i8vec_L2sqr_ny)(float*, const int8_t*, const int8_t*, size_t, size_t);
+extern void (*i8vec_inner_products_ny)(float*, const int8_t*, const int8_t*, size_t, size_t);
+
+/// conversions of n floats to halves, rounding to nearest even, and back
+extern void (*fvec_to_fp16)(uint16_t*, const float*, size_t);
+extern void (*fp16_to_fvec)(float*, const uint16_t*, size_t);
+extern void (*fvec_to_bf16)(uint16_t*, const float*, size_t);
+extern void (*bf16_to_fvec)(float*, const uint16_t*, size_t);
+
+/// binary codes, the size is in bytes
+extern int (*bvec_hamming)(const uint8_t*, const uint8_t*, size_t);
+extern float (*bvec_jaccard_dis)(const uint8_t*, const uint8_t*, size_t);
+extern void (*bvec_hamming_batch_4)(const uint8_t*, const uint8_t*, const uint8_t*, const uint8_t*, const uint8_t*,
+                                    size_t, float&, float&, float&, float&);
+extern void (*bvec_jaccard_batch_4)(const uint8_t*, const uint8_t*, const uint8_t*, const uint8_t*, const uint8_t*,
+                                    size_t, float&, float&, float&, float&);
+/// the distances between a code and the ny codes stored one after the other
+extern void (*bvec_hamming_ny)(float*, const uint8_t*, const uint8_t*, size_t, size_t);
+extern void (*bvec_jaccard_ny)(float*, const uint8_t*, const uint8_t*, size_t, size_t);
+/// whether the bits set in the first code are all set in the second, for the sub/superstructure metrics
+extern bool (*bvec_is_subset)(const uint8_t*, const uint8_t*, size_t);
+
+/// sums of the nchunks tables of 256 floats looked up at the 8 bit PQ codes of ny vectors (asymmetric PQ distances)
+extern void (*pq_adc_ny)(float*, const uint8_t*, const float*, size_t, size_t);
+
+/// the inner products of nx vectors and ny vectors of d floats, ip[i * ny + j], for the blocks of the brute force
+/// searches and of k-means; nullptr to multiply with sgemm, which is the default
+extern void (*fvec_inner_products_gemm)(float*, const float*, const float*, size_t, size_t, size_t);
+
+/// how many graph neighbors to prefetch ahead of the distance being computed, set along with the kernels
+extern size_t fvec_prefetch_depth;
+
 #if defined(__x86_64__)
 extern bool use_avx512;
 extern bool use_avx2;
 extern bool use_sse4_2;
+// on top of AVX512, off by default
+extern bool use_amx;
+// IVF_SQ8 inner product scanners that quantize the query to int8, on by default
+extern bool use_sq_int8_query;
+#endif
+
+#if defined(__aarch64__)
+extern bool use_sve;
+extern bool use_neon;
 #endif
 
 #if defined(__x86_64__)
 bool
 cpu_support_avx512();
 bool
+cpu_support_avx512_vnni();
+bool
+cpu_support_avx512_vpopcntdq();
+bool
+cpu_support_amx();
+bool
 cpu_support_avx2();
 bool
 cpu_support_sse4_2();
 #endif
 
+#if defined(__aarch64__)
+bool
+cpu_support_sve();
+#endif
+
 void
 fvec_hook(std::string&);
 
+/// fvec_hook, then times the variants of the float kernels the cpu supports at the dims and binds the fastest of
+/// each; the dim specialized kernels are picked per dim. The widest simd type is not always the fastest, wide
+/// registers can lower the clock. x86 only, elsewhere it is fvec_hook
+void
+fvec_hook_tuned(std::string&, const std::vector<size_t>& dims);
+
+/// the simd type of the hook, or "kernel=variant" of each kernel fvec_hook_tuned bound, comma separated
+std::string
+fvec_hook_variants();
+
 }  // namespace faiss
 
 #endif /* HOOK_H */
@@ -1,5 +1,6 @@
 import knowhere
 import json
+import numpy as np
 import pytest
 
 test_data = [
@@ -97,3 +98,32 @@ def test_index(gen_data, faiss_ans, recall, error, name, config):
     else:
         assert recall(f_ids, k_ids) >= 0.5
     assert error(f_dis, f_dis) <= 0.01
+
+
+def test_index_array_views_and_async_search(gen_data):
+    config = test_data[0][1]
+    idx = knowhere.CreateIndex(test_data[0][0])
+    xb, xq = gen_data(10000, 100, 256)
+    idx.Build(knowhere.ArrayToDataSet(xb), json.dumps(config))
+
+    ans, _ = idx.Search(knowhere.ArrayToDataSet(xq), json.dumps(config), knowhere.GetNullBitSetView())
+    k_dis, k_ids = knowhere.DataSetToArray(ans)
+    v_dis, v_ids = knowhere.DataSetToArrayView(ans)
+    assert v_ids.dtype == np.int64 and v_ids.shape == k_ids.shape
+    assert not v_ids.flags.writeable
+    assert (v_ids == k_ids).all()
+    assert (v_dis == k_dis).all()
+    # the views hold the result
+    del ans
+    assert (v_ids == k_ids).all()
+
+    futures = [
+        knowhere.SearchAsync(idx, knowhere.ArrayToDataSet(xq[i : i + 10]), json.dumps(config))
+        for i in range(0, 100, 10)
+    ]
+    for i, fut in enumerate(futures):
+        ans, status = fut.result()
+        assert knowhere.Status(status) == knowhere.Status.success
+        assert fut.done()
+        _, ids = knowhere.DataSetToArrayView(ans)
+        assert (ids == k_ids[i * 10 : i * 10 + 10]).all()
@@ -9,6 +9,8 @@
 // is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
 // or implied. See the License for the specific language governing permissions and limitations under the License.
 
+#include <cmath>
+
 #include "catch2/catch_approx.hpp"
 #include "catch2/catch_test_macros.hpp"
 #include "catch2/generators/catch_generators.hpp"
@@ -69,6 +71,79 @@ TEST_CASE("Test Brute Force", "[float vector]") {
         delete[] dist;
     }
 
+    SECTION("Test Batch Search") {
+        // enough queries go through the blocked BLAS path
+        const int64_t batch_nq = 100;
+        auto batch_query_ds = CopyDataSet(train_ds, batch_nq);
+        auto res = knowhere::BruteForce::Search(train_ds, batch_query_ds, conf, nullptr);
+        REQUIRE(res.has_value());
+        auto ids = res.value()->GetIds();
+        auto dist = res.value()->GetDistance();
+        for (int64_t i = 0; i < batch_nq; i++) {
+            REQUIRE(ids[i * k] == i);
+            if (metric == knowhere::metric::L2) {
+                REQUIRE(dist[i * k] == Approx(0).margin(0.001));
+            } else {
+                REQUIRE(std::abs(dist[i * k] - 1.0) < 0.00001);
+            }
+        }
+    }
+
+    SECTION("Test Search With Norms") {
+        auto norms_nq = GENERATE(as<int64_t>{}, 10, 100);
+        auto norms_query_ds = CopyDataSet(train_ds, norms_nq);
+        auto xb = (const float*)train_ds->GetTensor();
+        std::vector<float> norms(nb);
+        for (int64_t i = 0; i < nb; i++) {
+            float norm_sqr = 0;
+            for (int64_t j = 0; j < dim; j++) {
+                norm_sqr += xb[i * dim + j] * xb[i * dim + j];
+            }
+            norms[i] = std::sqrt(norm_sqr);
+        }
+        auto base_ds = knowhere::GenDataSet(nb, dim, xb);
+        base_ds->SetNorms(norms.data());
+        auto gt = knowhere::BruteForce::Search(train_ds, norms_query_ds, conf, nullptr);
+        auto res = knowhere::BruteForce::Search(base_ds, norms_query_ds, conf, nullptr);
+        REQUIRE(gt.has_value());
+        REQUIRE(res.has_value());
+        auto gt_dist = gt.value()->GetDistance();
+        auto dist = res.value()->GetDistance();
+        for (int64_t i = 0; i < norms_nq * k; i++) {
+            REQUIRE(dist[i] == Approx(gt_dist[i]).margin(0.0001));
+        }
+    }
+
+    SECTION("Test Chunked Search") {
+        // chunks of 300 rows, the later ones do not start on a byte of the bitset
+        const int64_t chunk_rows = 300;
+        std::vector<knowhere::BaseChunk> chunks;
+        for (int64_t offset = 0; offset < nb; offset += chunk_rows) {
+            auto data = (const float*)train_ds->GetTensor() + offset * dim;
+            chunks.push_back({data, std::min(chunk_rows, nb - offset), offset});
+        }
+        auto chunk_nq = GENERATE(as<int64_t>{}, 10, 100);
+        auto chunk_query_ds = CopyDataSet(train_ds, chunk_nq);
+        std::vector<uint8_t> bitset_data(nb / 8);
+        // filters out the even rows after the first chunk
+        for (int64_t i = chunk_rows; i < nb; i += 2) {
+            bitset_data[i >> 3] |= (1 << (i & 7));
+        }
+        knowhere::BitsetView bitset(bitset_data.data(), nb);
+        auto gt = knowhere::BruteForce::Search(train_ds, chunk_query_ds, conf, bitset);
+        auto res = knowhere::BruteForce::Search(chunks, chunk_query_ds, conf, bitset);
+        REQUIRE(gt.has_value());
+        REQUIRE(res.has_value());
+        auto gt_dist = gt.value()->GetDistance();
+        auto ids = res.value()->GetIds();
+        auto dist = res.value()->GetDistance();
+        for (int64_t i = 0; i < chunk_nq * k; i++) {
+            REQUIRE(ids[i] >= 0);
+            REQUIRE(!bitset.test(ids[i]));
+            REQUIRE(dist[i] == Approx(gt_dist[i]).margin(0.001));
+        }
+    }
+
     SECTION("Test Range Search") {
         auto res = knowhere::BruteForce::RangeSearch(train_ds, query_ds, conf, nullptr);
         REQUIRE(res.has_value());
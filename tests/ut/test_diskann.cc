@@ -9,7 +9,11 @@
 // is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
 // or implied. See the License for the specific language governing permissions and limitations under the License.
 
+#include <algorithm>
+#include <chrono>
+#include <set>
 #include <string>
+#include <thread>
 
 #include "catch2/catch_approx.hpp"
 #include "catch2/catch_test_macros.hpp"
@@ -17,6 +21,7 @@
 #include "index/diskann/diskann.cc"
 #include "index/diskann/diskann_config.h"
 #include "knowhere/comp/brute_force.h"
+#include "knowhere/comp/knowhere_config.h"
 #include "knowhere/comp/local_file_manager.h"
 #include "knowhere/expected.h"
 #include "knowhere/factory.h"
@@ -109,6 +114,11 @@ TEST_CASE("Invalid diskann params test", "[diskann]") {
         test_json["data_path"] = kL2IndexPrefix + ".temp";
         test_stat = diskann.Build(*ds_ptr, test_json);
         REQUIRE(test_stat == knowhere::Status::diskann_file_error);
+        // invalid disk sq type
+        test_json = test_gen();
+        test_json["disk_sq_type"] = "SQ4";
+        test_stat = diskann.Build(*ds_ptr, test_json);
+        REQUIRE(test_stat == knowhere::Status::invalid_args);
     }
 
     SECTION("Invalid search params test") {
@@ -260,6 +270,20 @@ TEST_CASE("Test DiskANNIndexNode.", "[diskann]") {
             auto knn_recall = GetKNNRecall(*knn_gt_ptr, *res.value());
             REQUIRE(knn_recall > kKnnRecall);
 
+            // the searches hand their sector buffers back to the pool, and still run one at a time when the pool
+            // can hold a single buffer
+            {
+                auto& pool = diskann::SectorBufferPool::instance();
+                REQUIRE(pool.stats().bytes > 0);
+                REQUIRE(pool.stats().borrowed_bytes == 0);
+                knowhere::KnowhereConfig::SetDiskANNSectorBufferPool(1);
+                auto res = diskann.Search(*query_ds, knn_json, nullptr);
+                knowhere::KnowhereConfig::SetDiskANNSectorBufferPool(0);
+                REQUIRE(res.has_value());
+                REQUIRE(GetKNNRecall(*knn_gt_ptr, *res.value()) == knn_recall);
+                REQUIRE(pool.stats().borrowed_bytes == 0);
+            }
+
             // knn search without cache file
             {
                 std::string cached_nodes_file_path =
@@ -275,6 +299,92 @@ TEST_CASE("Test DiskANNIndexNode.", "[diskann]") {
                 REQUIRE(GetKNNRecall(*knn_gt_ptr, *res.value()) == knn_recall);
             }
 
+            // knn search with the cache learnt from the searches
+            {
+                knowhere::Json dynamic_json = deserialize_json;
+                dynamic_json["dynamic_cache"] = true;
+                dynamic_json["dynamic_cache_refresh_queries"] = 16;
+                auto diskann_tmp = knowhere::IndexFactory::Instance().Create("DISKANN", diskann_index_pack);
+                diskann_tmp.Deserialize(binset, dynamic_json);
+                for (int round = 0; round < 3; round++) {
+                    auto res = diskann_tmp.Search(*query_ds, knn_json, nullptr);
+                    REQUIRE(res.has_value());
+                    REQUIRE(GetKNNRecall(*knn_gt_ptr, *res.value()) == knn_recall);
+                }
+            }
+
+            // knn search sharing the reads of the concurrent queries
+            {
+                knowhere::Json coalesce_json = deserialize_json;
+                coalesce_json["coalesce_reads"] = true;
+                auto diskann_tmp = knowhere::IndexFactory::Instance().Create("DISKANN", diskann_index_pack);
+                diskann_tmp.Deserialize(binset, coalesce_json);
+                auto res = diskann_tmp.Search(*query_ds, knn_json, nullptr);
+                REQUIRE(res.has_value());
+                REQUIRE(GetKNNRecall(*knn_gt_ptr, *res.value()) == knn_recall);
+            }
+
+            // knn search while the node cache and the warm up are still in progress
+            {
+                knowhere::Json lazy_json = deserialize_json;
+                lazy_json["lazy_prepare"] = true;
+                auto diskann_tmp = knowhere::IndexFactory::Instance().Create("DISKANN", diskann_index_pack);
+                REQUIRE(diskann_tmp.Deserialize(binset, lazy_json) == knowhere::Status::success);
+                auto res = diskann_tmp.Search(*query_ds, knn_json, nullptr);
+                REQUIRE(res.has_value());
+                REQUIRE(GetKNNRecall(*knn_gt_ptr, *res.value()) > kKnnRecall);
+                std::string prepare_state;
+                for (int retry = 0; retry < 600 && prepare_state != "ready"; retry++) {
+                    auto meta = diskann_tmp.GetIndexMeta(lazy_json);
+                    REQUIRE(meta.has_value());
+                    prepare_state = knowhere::Json::parse(meta.value()->GetJsonInfo())["prepare_state"];
+                    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+                }
+                REQUIRE(prepare_state == "ready");
+                res = diskann_tmp.Search(*query_ds, knn_json, nullptr);
+                REQUIRE(res.has_value());
+                REQUIRE(GetKNNRecall(*knn_gt_ptr, *res.value()) > kKnnRecall);
+            }
+
+            // pipelined knn search
+            {
+                knowhere::Json pipelined_json = knn_json;
+                pipelined_json["pipelined_search"] = true;
+                auto res = diskann.Search(*query_ds, pipelined_json, nullptr);
+                REQUIRE(res.has_value());
+                REQUIRE(GetKNNRecall(*knn_gt_ptr, *res.value()) > kKnnRecall);
+            }
+
+            // knn search with an adaptive beam
+            {
+                knowhere::Json adaptive_json = knn_json;
+                adaptive_json["adaptive_beamwidth"] = true;
+                auto res = diskann.Search(*query_ds, adaptive_json, nullptr);
+                REQUIRE(res.has_value());
+                REQUIRE(GetKNNRecall(*knn_gt_ptr, *res.value()) > kKnnRecall);
+            }
+
+            // interleaved knn search, the queries of a thread overlapping their reads
+            {
+                knowhere::Json interleaved_json = knn_json;
+                interleaved_json["search_interleave"] = 8;
+                auto res = diskann.Search(*query_ds, interleaved_json, nullptr);
+                REQUIRE(res.has_value());
+                REQUIRE(GetKNNRecall(*knn_gt_ptr, *res.value()) > kKnnRecall);
+                REQUIRE(res.value()->GetPartialQueries() == 0);
+            }
+
+            // knn search stopped by its io budget
+            {
+                REQUIRE(res.value()->GetPartialQueries() == 0);
+                knowhere::Json budget_json = knn_json;
+                budget_json["search_io_budget"] = 1;
+                auto res = diskann.Search(*query_ds, budget_json, nullptr);
+                REQUIRE(res.has_value());
+                REQUIRE(res.value()->GetPartialQueries() > 0);
+                REQUIRE(GetKNNRecall(*knn_gt_ptr, *res.value()) <= knn_recall);
+            }
+
             // knn search with bitset
             std::vector<std::function<std::vector<uint8_t>(size_t, size_t)>> gen_bitset_funcs = {
                 GenerateBitsetWithFirstTbitsSet, GenerateBitsetWithRandomTbitsSet};
@@ -306,7 +416,401 @@ TEST_CASE("Test DiskANNIndexNode.", "[diskann]") {
             auto ap = GetRangeSearchRecall(*range_search_gt_ptr, *range_search_res.value());
             float standard_ap = metric_range_ap_map[metric_str];
             REQUIRE(ap > standard_ap);
+
+            // the range search grows its list from min_k, doubling it every round while at least half of the list
+            // is in range; a round resumes the search of the one before rather than reading its sectors again
+            {
+                int64_t min_k = range_json["min_k"];
+                auto gt_lims = range_search_gt_ptr->GetLims();
+                // the queries hold enough results for at least 3 rounds on average
+                REQUIRE(static_cast<int64_t>(gt_lims[kNumQueries]) > 4 * min_k * kNumQueries);
+                // a single round of a list of every row, the results the rounds restarting from scratch converge to
+                knowhere::Json single_round_json = range_json;
+                single_round_json["min_k"] = kNumRows;
+                auto single_round_res = diskann.RangeSearch(*query_ds, single_round_json, nullptr);
+                REQUIRE(single_round_res.has_value());
+                REQUIRE(GetRangeSearchRecall(*range_search_gt_ptr, *single_round_res.value()) > standard_ap);
+                REQUIRE(GetRangeSearchRecall(*single_round_res.value(), *range_search_res.value()) > standard_ap);
+            }
+        }
+    }
+
+    SECTION("Test graph layout") {
+        std::shared_ptr<knowhere::FileManager> file_manager = std::make_shared<knowhere::LocalFileManager>();
+        auto diskann_index_pack = knowhere::Pack(file_manager);
+        knowhere::Json deserialize_json = knowhere::Json::parse(deserialize_gen().dump());
+        knowhere::BinarySet binset;
+        {
+            knowhere::DataSet* ds_ptr = nullptr;
+            auto diskann = knowhere::IndexFactory::Instance().Create("DISKANN", diskann_index_pack);
+            knowhere::Json json = knowhere::Json::parse(build_gen().dump());
+            json["graph_layout"] = true;
+            REQUIRE(diskann.Build(*ds_ptr, json) == knowhere::Status::success);
+        }
+        auto diskann = knowhere::IndexFactory::Instance().Create("DISKANN", diskann_index_pack);
+        REQUIRE(diskann.Deserialize(binset, deserialize_json) == knowhere::Status::success);
+
+        knowhere::Json knn_json = knowhere::Json::parse(knn_search_gen().dump());
+        auto res = diskann.Search(*query_ds, knn_json, nullptr);
+        REQUIRE(res.has_value());
+        auto knn_recall = GetKNNRecall(*knn_gt_ptr, *res.value());
+        REQUIRE(knn_recall > kKnnRecall);
+
+        // the nodes sharing the read sectors can only add closer candidates
+        knn_json["score_sector_nodes"] = true;
+        res = diskann.Search(*query_ds, knn_json, nullptr);
+        REQUIRE(res.has_value());
+        REQUIRE(GetKNNRecall(*knn_gt_ptr, *res.value()) >= knn_recall);
+
+        if (metric_str == knowhere::metric::L2) {
+            auto ids_ds = GenIdsDataSet(kNumRows, kNumQueries);
+            auto vectors = diskann.GetVectorByIds(*ids_ds);
+            REQUIRE(vectors.has_value());
+            auto xb = static_cast<const float*>(base_ds->GetTensor());
+            auto data = static_cast<const float*>(vectors.value()->GetTensor());
+            for (int64_t i = 0; i < kNumQueries; ++i) {
+                auto id = ids_ds->GetIds()[i];
+                for (uint32_t j = 0; j < kDim; ++j) {
+                    REQUIRE(data[i * kDim + j] == xb[id * kDim + j]);
+                }
+            }
+        }
+    }
+    SECTION("Test kNN graph build") {
+        std::shared_ptr<knowhere::FileManager> file_manager = std::make_shared<knowhere::LocalFileManager>();
+        auto diskann_index_pack = knowhere::Pack(file_manager);
+        knowhere::Json deserialize_json = knowhere::Json::parse(deserialize_gen().dump());
+        knowhere::BinarySet binset;
+        {
+            knowhere::DataSet* ds_ptr = nullptr;
+            auto diskann = knowhere::IndexFactory::Instance().Create("DISKANN", diskann_index_pack);
+            knowhere::Json json = knowhere::Json::parse(build_gen().dump());
+            json[knowhere::indexparam::KNN_GRAPH] = "UNKNOWN";
+            REQUIRE(diskann.Build(*ds_ptr, json) == knowhere::Status::invalid_args);
+            json[knowhere::indexparam::KNN_GRAPH] = "NN_DESCENT";
+            REQUIRE(diskann.Build(*ds_ptr, json) == knowhere::Status::success);
+        }
+        auto diskann = knowhere::IndexFactory::Instance().Create("DISKANN", diskann_index_pack);
+        REQUIRE(diskann.Deserialize(binset, deserialize_json) == knowhere::Status::success);
+
+        knowhere::Json knn_json = knowhere::Json::parse(knn_search_gen().dump());
+        auto res = diskann.Search(*query_ds, knn_json, nullptr);
+        REQUIRE(res.has_value());
+        REQUIRE(GetKNNRecall(*knn_gt_ptr, *res.value()) > kKnnRecall);
+    }
+    SECTION("Test navigation graph") {
+        std::shared_ptr<knowhere::FileManager> file_manager = std::make_shared<knowhere::LocalFileManager>();
+        auto diskann_index_pack = knowhere::Pack(file_manager);
+        knowhere::Json deserialize_json = knowhere::Json::parse(deserialize_gen().dump());
+        knowhere::BinarySet binset;
+        {
+            knowhere::DataSet* ds_ptr = nullptr;
+            auto diskann = knowhere::IndexFactory::Instance().Create("DISKANN", diskann_index_pack);
+            knowhere::Json json = knowhere::Json::parse(build_gen().dump());
+            json["nav_graph_ratio"] = 0.05;
+            REQUIRE(diskann.Build(*ds_ptr, json) == knowhere::Status::success);
+        }
+        REQUIRE(fs::exists(metric_dir_map[metric_str] + "_disk.index_nav_graph.bin"));
+        auto diskann = knowhere::IndexFactory::Instance().Create("DISKANN", diskann_index_pack);
+        REQUIRE(diskann.Deserialize(binset, deserialize_json) == knowhere::Status::success);
+
+        // the searches start from the sampled points closest to the queries
+        knowhere::Json knn_json = knowhere::Json::parse(knn_search_gen().dump());
+        auto res = diskann.Search(*query_ds, knn_json, nullptr);
+        REQUIRE(res.has_value());
+        REQUIRE(GetKNNRecall(*knn_gt_ptr, *res.value()) > kKnnRecall);
+    }
+    SECTION("Test sharded build") {
+        std::shared_ptr<knowhere::FileManager> file_manager = std::make_shared<knowhere::LocalFileManager>();
+        auto diskann_index_pack = knowhere::Pack(file_manager);
+        knowhere::Json deserialize_json = knowhere::Json::parse(deserialize_gen().dump());
+        knowhere::Json knn_json = knowhere::Json::parse(knn_search_gen().dump());
+        knowhere::BinarySet binset;
+        // the recall of the index built with the build_dram_budget_gb and build_concurrent_shards of the json
+        auto build_and_search = [&](const knowhere::Json& json) {
+            {
+                knowhere::DataSet* ds_ptr = nullptr;
+                auto diskann = knowhere::IndexFactory::Instance().Create("DISKANN", diskann_index_pack);
+                REQUIRE(diskann.Build(*ds_ptr, json) == knowhere::Status::success);
+            }
+            auto diskann = knowhere::IndexFactory::Instance().Create("DISKANN", diskann_index_pack);
+            REQUIRE(diskann.Deserialize(binset, deserialize_json) == knowhere::Status::success);
+            REQUIRE(diskann.Count() == kNumRows);
+            auto res = diskann.Search(*query_ds, knn_json, nullptr);
+            REQUIRE(res.has_value());
+            return GetKNNRecall(*knn_gt_ptr, *res.value());
+        };
+
+        // the whole index in one shot
+        knowhere::Json json = knowhere::Json::parse(build_gen().dump());
+        auto one_shot_recall = build_and_search(json);
+        REQUIRE(one_shot_recall > kKnnRecall);
+
+        // a budget below the estimate of the whole index, about 0.9MB: the data is partitioned into shards that are
+        // built one at a time and merged, or with 4 concurrent shards, into smaller shards built 4 at a time
+        json["build_dram_budget_gb"] = 0.7 * 1024 * 1024 / (1024 * 1024 * 1024);
+        for (auto concurrent_shards : {1, 4}) {
+            CAPTURE(concurrent_shards);
+            json["build_concurrent_shards"] = concurrent_shards;
+            auto recall = build_and_search(json);
+            REQUIRE(recall > kKnnRecall);
+            REQUIRE(recall >= one_shot_recall - 0.05f);
+        }
+    }
+    SECTION("Test label filtered search") {
+        constexpr uint32_t kNumLabels = 4;
+        std::string label_path = kDir + "/labels";
+        {
+            std::vector<uint32_t> labels(kNumRows);
+            for (uint32_t i = 0; i < kNumRows; ++i) {
+                labels[i] = i % kNumLabels;
+            }
+            std::ofstream writer(label_path, std::ios::binary);
+            uint32_t label_dim = 1;
+            writer.write((char*)&kNumRows, sizeof(uint32_t));
+            writer.write((char*)&label_dim, sizeof(uint32_t));
+            writer.write((char*)labels.data(), sizeof(uint32_t) * kNumRows);
+        }
+        std::shared_ptr<knowhere::FileManager> file_manager = std::make_shared<knowhere::LocalFileManager>();
+        auto diskann_index_pack = knowhere::Pack(file_manager);
+        knowhere::Json deserialize_json = knowhere::Json::parse(deserialize_gen().dump());
+        knowhere::BinarySet binset;
+        {
+            knowhere::DataSet* ds_ptr = nullptr;
+            auto diskann = knowhere::IndexFactory::Instance().Create("DISKANN", diskann_index_pack);
+            knowhere::Json json = knowhere::Json::parse(build_gen().dump());
+            json["label_path"] = label_path;
+            REQUIRE(diskann.Build(*ds_ptr, json) == knowhere::Status::success);
+        }
+        auto diskann = knowhere::IndexFactory::Instance().Create("DISKANN", diskann_index_pack);
+        REQUIRE(diskann.Deserialize(binset, deserialize_json) == knowhere::Status::success);
+
+        // the rows of the label only, as close as the ones of a search filtering the others out
+        knowhere::Json knn_json = knowhere::Json::parse(knn_search_gen().dump());
+        knn_json["filter_label"] = 1;
+        std::vector<uint8_t> bitset_data((kNumRows + 7) / 8, 0);
+        for (uint32_t i = 0; i < kNumRows; ++i) {
+            if (i % kNumLabels != 1) {
+                bitset_data[i >> 3] |= 1 << (i & 0x7);
+            }
+        }
+        knowhere::BitsetView bitset(bitset_data.data(), kNumRows);
+        auto res = diskann.Search(*query_ds, knn_json, nullptr);
+        REQUIRE(res.has_value());
+        auto ids = res.value()->GetIds();
+        for (uint32_t i = 0; i < kNumQueries * kK; ++i) {
+            REQUIRE(ids[i] % kNumLabels == 1);
+        }
+        auto gt = knowhere::BruteForce::Search(base_ds, query_ds, knn_json, bitset);
+        REQUIRE(GetKNNRecall(*gt.value(), *res.value()) >= kKnnRecall);
+
+        // no row has the label
+        knn_json["filter_label"] = kNumLabels;
+        res = diskann.Search(*query_ds, knn_json, nullptr);
+        REQUIRE(res.has_value());
+        REQUIRE(res.value()->GetIds()[0] == -1);
+    }
+    SECTION("Test striped disk index") {
+        std::shared_ptr<knowhere::FileManager> file_manager = std::make_shared<knowhere::LocalFileManager>();
+        auto diskann_index_pack = knowhere::Pack(file_manager);
+        std::vector<std::string> stripe_dirs = {kDir + "/stripe0", kDir + "/stripe1", kDir + "/stripe2"};
+        for (auto& dir : stripe_dirs) {
+            fs::create_directories(dir);
+        }
+        knowhere::Json deserialize_json = knowhere::Json::parse(deserialize_gen().dump());
+        deserialize_json["disk_stripe_paths"] = stripe_dirs[0] + "," + stripe_dirs[1] + "," + stripe_dirs[2];
+        deserialize_json["disk_stripe_sectors"] = 2;
+        knowhere::BinarySet binset;
+        {
+            knowhere::DataSet* ds_ptr = nullptr;
+            auto diskann = knowhere::IndexFactory::Instance().Create("DISKANN", diskann_index_pack);
+            knowhere::Json json = knowhere::Json::parse(build_gen().dump());
+            REQUIRE(diskann.Build(*ds_ptr, json) == knowhere::Status::success);
+        }
+        {
+            auto diskann = knowhere::IndexFactory::Instance().Create("DISKANN", diskann_index_pack);
+            REQUIRE(diskann.Deserialize(binset, deserialize_json) == knowhere::Status::success);
+            for (auto& dir : stripe_dirs) {
+                REQUIRE(!fs::is_empty(dir));
+            }
+
+            // the same results as read from the one file
+            knowhere::Json knn_json = knowhere::Json::parse(knn_search_gen().dump());
+            auto res = diskann.Search(*query_ds, knn_json, nullptr);
+            REQUIRE(res.has_value());
+            REQUIRE(GetKNNRecall(*knn_gt_ptr, *res.value()) >= kKnnRecall);
+            knn_json["pipelined_search"] = true;
+            res = diskann.Search(*query_ds, knn_json, nullptr);
+            REQUIRE(res.has_value());
+            REQUIRE(GetKNNRecall(*knn_gt_ptr, *res.value()) >= kKnnRecall);
+        }
+        // the stripes go with the index
+        for (auto& dir : stripe_dirs) {
+            REQUIRE(fs::is_empty(dir));
+        }
+    }
+    SECTION("Test hot tier") {
+        std::shared_ptr<knowhere::FileManager> file_manager = std::make_shared<knowhere::LocalFileManager>();
+        auto diskann_index_pack = knowhere::Pack(file_manager);
+        knowhere::Json deserialize_json = knowhere::Json::parse(deserialize_gen().dump());
+        deserialize_json["hot_tier_memory_mb"] = 1;
+        knowhere::BinarySet binset;
+        {
+            knowhere::DataSet* ds_ptr = nullptr;
+            auto diskann = knowhere::IndexFactory::Instance().Create("DISKANN", diskann_index_pack);
+            knowhere::Json json = knowhere::Json::parse(build_gen().dump());
+            REQUIRE(diskann.Build(*ds_ptr, json) == knowhere::Status::success);
+        }
+        auto diskann = knowhere::IndexFactory::Instance().Create("DISKANN", diskann_index_pack);
+        REQUIRE(diskann.Deserialize(binset, deserialize_json) == knowhere::Status::success);
+        knowhere::Json knn_json = knowhere::Json::parse(knn_search_gen().dump());
+        auto cold_size = diskann.Size();
+
+        // enough queries for a rebuild of the hot tier from their hits
+        for (uint32_t i = 0; i < 10000 / kNumQueries; i++) {
+            auto res = diskann.Search(*query_ds, knn_json, nullptr);
+            REQUIRE(res.has_value());
+        }
+        if (metric_str != knowhere::metric::IP) {
+            for (int retry = 0; retry < 600 && diskann.Size() == cold_size; retry++) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            }
+            REQUIRE(diskann.Size() > cold_size);
+        }
+        // the results of the points in both tiers come once
+        auto res = diskann.Search(*query_ds, knn_json, nullptr);
+        REQUIRE(res.has_value());
+        REQUIRE(GetKNNRecall(*knn_gt_ptr, *res.value()) >= kKnnRecall);
+        auto ids = res.value()->GetIds();
+        for (uint32_t q = 0; q < kNumQueries; q++) {
+            std::set<int64_t> unique(ids + q * kK, ids + (q + 1) * kK);
+            REQUIRE(unique.size() == kK);
+        }
+    }
+    SECTION("Test streaming inserts and deletes") {
+        std::shared_ptr<knowhere::FileManager> file_manager = std::make_shared<knowhere::LocalFileManager>();
+        auto diskann_index_pack = knowhere::Pack(file_manager);
+        knowhere::Json deserialize_json = knowhere::Json::parse(deserialize_gen().dump());
+        deserialize_json["streaming_merge_ratio"] = 0.01;
+        knowhere::BinarySet binset;
+        {
+            knowhere::DataSet* ds_ptr = nullptr;
+            auto diskann = knowhere::IndexFactory::Instance().Create("DISKANN", diskann_index_pack);
+            knowhere::Json json = knowhere::Json::parse(build_gen().dump());
+            REQUIRE(diskann.Build(*ds_ptr, json) == knowhere::Status::success);
         }
+        auto diskann = knowhere::IndexFactory::Instance().Create("DISKANN", diskann_index_pack);
+        REQUIRE(diskann.Deserialize(binset, deserialize_json) == knowhere::Status::success);
+
+        // the queries inserted are their own nearest neighbors, with the ids following the rows of the disk index
+        knowhere::Json add_json = knowhere::Json::parse(build_gen().dump());
+        REQUIRE(diskann.Add(*query_ds, add_json) == knowhere::Status::success);
+        REQUIRE(diskann.Count() == kNumRows + kNumQueries);
+        knowhere::Json knn_json = knowhere::Json::parse(knn_search_gen().dump());
+        auto res = diskann.Search(*query_ds, knn_json, nullptr);
+        REQUIRE(res.has_value());
+        if (metric_str != knowhere::metric::IP) {
+            for (uint32_t i = 0; i < kNumQueries; ++i) {
+                REQUIRE(res.value()->GetIds()[i * kK] == kNumRows + i);
+            }
+        }
+
+        // a tenth of the disk index and the first insert deleted, which starts a streaming merge in the background
+        std::vector<int64_t> deleted_ids;
+        for (uint32_t i = 0; i < kNumRows / 10; ++i) {
+            deleted_ids.push_back(i);
+        }
+        deleted_ids.push_back(kNumRows);
+        auto deleted_ds = knowhere::GenIdsDataSet(deleted_ids.size(), deleted_ids.data());
+        REQUIRE(diskann.DeleteByIds(*deleted_ds) == knowhere::Status::success);
+        auto is_deleted = [](int64_t id) { return (id >= 0 && id < kNumRows / 10) || id == kNumRows; };
+        res = diskann.Search(*query_ds, knn_json, nullptr);
+        REQUIRE(res.has_value());
+        for (uint32_t i = 0; i < kNumQueries * kK; ++i) {
+            REQUIRE(!is_deleted(res.value()->GetIds()[i]));
+        }
+        knowhere::Json range_json = knowhere::Json::parse(range_search_gen().dump());
+        auto range_res = diskann.RangeSearch(*query_ds, range_json, nullptr);
+        REQUIRE(range_res.has_value());
+        auto lims = range_res.value()->GetLims();
+        for (size_t i = 0; i < lims[kNumQueries]; ++i) {
+            REQUIRE(!is_deleted(range_res.value()->GetIds()[i]));
+        }
+
+        // the inserted rows are got back from the delta index
+        std::vector<int64_t> inserted_ids = {kNumRows + 1, 0};
+        auto vectors = diskann.GetVectorByIds(*knowhere::GenIdsDataSet(inserted_ids.size(), inserted_ids.data()));
+        if (metric_str == knowhere::metric::L2) {
+            REQUIRE(vectors.has_value());
+            auto xq = static_cast<const float*>(query_ds->GetTensor());
+            auto data = static_cast<const float*>(vectors.value()->GetTensor());
+            REQUIRE(std::equal(data, data + kDim, xq + kDim));
+        }
+    }
+    SECTION("Test disk sq") {
+        auto sq_type = GENERATE(as<std::string>{}, "SQ8", "FP16");
+        std::shared_ptr<knowhere::FileManager> file_manager = std::make_shared<knowhere::LocalFileManager>();
+        auto diskann_index_pack = knowhere::Pack(file_manager);
+        knowhere::Json deserialize_json = knowhere::Json::parse(deserialize_gen().dump());
+        knowhere::BinarySet binset;
+        {
+            knowhere::DataSet* ds_ptr = nullptr;
+            auto diskann = knowhere::IndexFactory::Instance().Create("DISKANN", diskann_index_pack);
+            knowhere::Json json = knowhere::Json::parse(build_gen().dump());
+            json["disk_sq_type"] = sq_type;
+            REQUIRE(diskann.Build(*ds_ptr, json) == knowhere::Status::success);
+        }
+        auto diskann = knowhere::IndexFactory::Instance().Create("DISKANN", diskann_index_pack);
+        REQUIRE(diskann.Deserialize(binset, deserialize_json) == knowhere::Status::success);
+
+        // the candidates rerank on the exact vectors
+        knowhere::Json knn_json = knowhere::Json::parse(knn_search_gen().dump());
+        auto res = diskann.Search(*query_ds, knn_json, nullptr);
+        REQUIRE(res.has_value());
+        REQUIRE(GetKNNRecall(*knn_gt_ptr, *res.value()) > kKnnRecall);
+
+        if (metric_str == knowhere::metric::L2) {
+            auto ids_ds = GenIdsDataSet(kNumRows, kNumQueries);
+            auto vectors = diskann.GetVectorByIds(*ids_ds);
+            REQUIRE(vectors.has_value());
+            auto xb = static_cast<const float*>(base_ds->GetTensor());
+            auto data = static_cast<const float*>(vectors.value()->GetTensor());
+            for (int64_t i = 0; i < kNumQueries; ++i) {
+                auto id = ids_ds->GetIds()[i];
+                for (uint32_t j = 0; j < kDim; ++j) {
+                    REQUIRE(data[i * kDim + j] == xb[id * kDim + j]);
+                }
+            }
+        }
+    }
+    SECTION("Test compressed graph") {
+        auto graph_layout = GENERATE(as<bool>{}, false, true);
+        std::shared_ptr<knowhere::FileManager> file_manager = std::make_shared<knowhere::LocalFileManager>();
+        auto diskann_index_pack = knowhere::Pack(file_manager);
+        knowhere::Json deserialize_json = knowhere::Json::parse(deserialize_gen().dump());
+        knowhere::BinarySet binset;
+        {
+            knowhere::DataSet* ds_ptr = nullptr;
+            auto diskann = knowhere::IndexFactory::Instance().Create("DISKANN", diskann_index_pack);
+            knowhere::Json json = knowhere::Json::parse(build_gen().dump());
+            json["compress_graph"] = true;
+            json["graph_layout"] = graph_layout;
+            REQUIRE(diskann.Build(*ds_ptr, json) == knowhere::Status::success);
+        }
+        auto diskann = knowhere::IndexFactory::Instance().Create("DISKANN", diskann_index_pack);
+        REQUIRE(diskann.Deserialize(binset, deserialize_json) == knowhere::Status::success);
+
+        // the cached and the read nodes decode to the same graph
+        knowhere::Json knn_json = knowhere::Json::parse(knn_search_gen().dump());
+        auto res = diskann.Search(*query_ds, knn_json, nullptr);
+        REQUIRE(res.has_value());
+        REQUIRE(GetKNNRecall(*knn_gt_ptr, *res.value()) > kKnnRecall);
+
+        knowhere::Json range_json = knowhere::Json::parse(range_search_gen().dump());
+        auto range_search_res = diskann.RangeSearch(*query_ds, range_json, nullptr);
+        REQUIRE(range_search_res.has_value());
+        REQUIRE(GetRangeSearchRecall(*range_search_gt_ptr, *range_search_res.value()) >
+                metric_range_ap_map[metric_str]);
     }
     fs::remove_all(kDir);
     fs::remove(kDir);
@@ -380,6 +884,12 @@ TEST_CASE("Test DiskANN GetVectorByIds", "[diskann]") {
                             REQUIRE(data[i * dim + j] == xb[id * dim + j]);
                         }
                     }
+                    // the same vectors read in the background
+                    auto future = index.GetVectorByIdsAsync(*ids_ds);
+                    auto async_results = std::move(future).get();
+                    REQUIRE(async_results.has_value());
+                    auto async_data = (float*)async_results.value()->GetTensor();
+                    REQUIRE(std::equal(data, data + (size_t)ids_size * dim, async_data));
                 }
             }
         }
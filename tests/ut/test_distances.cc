@@ -1,8 +1,24 @@
 #include <catch2/catch_test_macros.hpp>
 #include <catch2/generators/catch_generators.hpp>
 #include <catch2/matchers/catch_matchers_floating_point.hpp>
+#include <cmath>
 #include <random>
 
+#include "faiss/impl/ScalarQuantizer.h"
+#include "faiss/impl/ScalarQuantizerDC.h"
+#include "faiss/utils/binary_distances.h"
+#if defined(__x86_64__)
+#include "faiss/impl/ScalarQuantizerDC_avx.h"
+#include "faiss/impl/ScalarQuantizerDC_avx512.h"
+#include "simd/distances_amx.h"
+#include "simd/distances_avx.h"
+#include "simd/distances_avx512.h"
+#include "simd/distances_sse.h"
+#endif
+#if defined(__aarch64__)
+#include "simd/distances_neon.h"
+#include "simd/distances_sve.h"
+#endif
 #include "simd/distances_ref.h"
 #include "simd/hook.h"
 TEST_CASE("Test Distance Compute", "[distance]") {
@@ -53,6 +69,46 @@ TEST_CASE("Test Distance Compute", "[distance]") {
         }
     }
 
+    SECTION("Test Cosine Compute") {
+        typedef float (*FUNC)(const float*, const float*, size_t);
+        std::vector<FUNC> funcs = {faiss::fvec_cosine, faiss::fvec_cosine_ref};
+#if defined(__x86_64__)
+        funcs.push_back(faiss::fvec_cosine_sse);
+        if (faiss::cpu_support_avx2()) {
+            funcs.push_back(faiss::fvec_cosine_avx);
+        }
+        if (faiss::cpu_support_avx512()) {
+            funcs.push_back(faiss::fvec_cosine_avx512);
+        }
+#endif
+#if defined(__aarch64__)
+        funcs.push_back(faiss::fvec_cosine_neon);
+#endif
+        std::uniform_real_distribution<float> signed_distrib(-1.0f, 1.0f);
+        for (int i = 0; i < 200; ++i) {
+            CAPTURE(i);
+            auto len = distrib(rng) % 2000 + 1;
+            std::vector<float> a(len);
+            std::vector<float> b(len);
+            for (int j = 0; j < len; ++j) {
+                a[j] = signed_distrib(rng);
+                b[j] = signed_distrib(rng);
+            }
+            // neither side is normalized
+            auto gold = faiss::fvec_inner_product_ref(a.data(), b.data(), len) /
+                        std::sqrt(faiss::fvec_norm_L2sqr_ref(a.data(), len) * faiss::fvec_norm_L2sqr_ref(b.data(), len));
+            for (auto func : funcs) {
+                REQUIRE_THAT(func(a.data(), b.data(), len), Catch::Matchers::WithinAbs(gold, 0.0001f));
+            }
+            // a zero vector is at 0 from everything
+            std::vector<float> zero(len, 0.0f);
+            for (auto func : funcs) {
+                REQUIRE(func(zero.data(), b.data(), len) == 0.0f);
+                REQUIRE(func(a.data(), zero.data(), len) == 0.0f);
+            }
+        }
+    }
+
     SECTION("Test Madd and Argmin") {
         typedef int (*FUNC)(size_t, const float*, float, const float*, float*);
         auto [real_func, gold_func] = GENERATE(table<FUNC, FUNC>({
@@ -108,4 +164,503 @@ TEST_CASE("Test Distance Compute", "[distance]") {
             }
         }
     }
+
+    SECTION("Test Batched Distance Compute") {
+        typedef void (*FUNC)(float*, const float*, const float*, size_t, size_t);
+        typedef float (*GOLD_FUNC)(const float*, const float*, size_t);
+        std::vector<std::tuple<FUNC, GOLD_FUNC>> funcs = {
+            make_tuple(faiss::fvec_L2sqr_ny, faiss::fvec_L2sqr_ref),
+            make_tuple(faiss::fvec_inner_products_ny, faiss::fvec_inner_product_ref),
+        };
+#if defined(__x86_64__)
+        if (faiss::cpu_support_avx2()) {
+            funcs.emplace_back(faiss::fvec_L2sqr_ny_avx, faiss::fvec_L2sqr_ref);
+            funcs.emplace_back(faiss::fvec_inner_products_ny_avx, faiss::fvec_inner_product_ref);
+        }
+        if (faiss::cpu_support_avx512()) {
+            funcs.emplace_back(faiss::fvec_L2sqr_ny_avx512, faiss::fvec_L2sqr_ref);
+            funcs.emplace_back(faiss::fvec_inner_products_ny_avx512, faiss::fvec_inner_product_ref);
+        }
+#endif
+#if defined(__aarch64__)
+        funcs.emplace_back(faiss::fvec_L2sqr_ny_neon, faiss::fvec_L2sqr_ref);
+        funcs.emplace_back(faiss::fvec_inner_products_ny_neon, faiss::fvec_inner_product_ref);
+        if (faiss::cpu_support_sve()) {
+            funcs.emplace_back(faiss::fvec_L2sqr_ny_sve, faiss::fvec_L2sqr_ref);
+            funcs.emplace_back(faiss::fvec_inner_products_ny_sve, faiss::fvec_inner_product_ref);
+        }
+#endif
+        std::uniform_int_distribution<> dim_distrib(1, 300);
+        std::uniform_int_distribution<> ny_distrib(1, 40);
+        for (int i = 0; i < 100; ++i) {
+            CAPTURE(i);
+            size_t dim = dim_distrib(rng);
+            size_t ny = ny_distrib(rng);
+            std::vector<float> x(dim);
+            std::vector<float> ys(ny * dim);
+            for (auto& v : x) {
+                v = fill_distrib(rng);
+            }
+            for (auto& v : ys) {
+                v = fill_distrib(rng);
+            }
+            for (auto [real_func, gold_func] : funcs) {
+                std::vector<float> dis(ny);
+                real_func(dis.data(), x.data(), ys.data(), dim, ny);
+                for (size_t j = 0; j < ny; ++j) {
+                    auto gold = gold_func(x.data(), ys.data() + j * dim, dim);
+                    REQUIRE_THAT(dis[j], Catch::Matchers::WithinRel(gold, 0.001f));
+                }
+            }
+        }
+    }
+
+    SECTION("Test Gathered Distance Compute") {
+        typedef void (*FUNC)(float*, const float*, const char*, const uint32_t*, size_t, size_t, size_t);
+        typedef float (*GOLD_FUNC)(const float*, const float*, size_t);
+        std::vector<std::tuple<FUNC, GOLD_FUNC>> funcs = {
+            make_tuple(faiss::fvec_L2sqr_batch_indexed, faiss::fvec_L2sqr_ref),
+            make_tuple(faiss::fvec_inner_product_batch_indexed, faiss::fvec_inner_product_ref),
+        };
+#if defined(__x86_64__)
+        if (faiss::cpu_support_avx2()) {
+            funcs.emplace_back(faiss::fvec_L2sqr_batch_indexed_avx, faiss::fvec_L2sqr_ref);
+            funcs.emplace_back(faiss::fvec_inner_product_batch_indexed_avx, faiss::fvec_inner_product_ref);
+        }
+        if (faiss::cpu_support_avx512()) {
+            funcs.emplace_back(faiss::fvec_L2sqr_batch_indexed_avx512, faiss::fvec_L2sqr_ref);
+            funcs.emplace_back(faiss::fvec_inner_product_batch_indexed_avx512, faiss::fvec_inner_product_ref);
+        }
+#endif
+#if defined(__aarch64__)
+        funcs.emplace_back(faiss::fvec_L2sqr_batch_indexed_neon, faiss::fvec_L2sqr_ref);
+        funcs.emplace_back(faiss::fvec_inner_product_batch_indexed_neon, faiss::fvec_inner_product_ref);
+#endif
+        std::uniform_int_distribution<> dim_distrib(1, 300);
+        std::uniform_int_distribution<> n_distrib(1, 40);
+        for (int i = 0; i < 100; ++i) {
+            CAPTURE(i);
+            size_t dim = dim_distrib(rng);
+            size_t n = n_distrib(rng);
+            // rows padded like the records of a graph index
+            size_t stride = (dim + 3) * sizeof(float);
+            size_t nb = 64;
+            std::vector<float> x(dim);
+            std::vector<float> base(nb * (dim + 3));
+            std::vector<uint32_t> ids(n);
+            for (auto& v : x) {
+                v = fill_distrib(rng);
+            }
+            for (auto& v : base) {
+                v = fill_distrib(rng);
+            }
+            for (auto& id : ids) {
+                id = distrib(rng) % nb;
+            }
+            for (auto [real_func, gold_func] : funcs) {
+                std::vector<float> dis(n);
+                real_func(dis.data(), x.data(), (const char*)base.data(), ids.data(), n, dim, stride);
+                for (size_t j = 0; j < n; ++j) {
+                    auto gold = gold_func(x.data(), base.data() + ids[j] * (dim + 3), dim);
+                    REQUIRE_THAT(dis[j], Catch::Matchers::WithinRel(gold, 0.001f));
+                }
+            }
+        }
+    }
+
+    SECTION("Test Dim Specialized Distance Compute") {
+        typedef faiss::fvec_func_ptr (*LOOKUP)(size_t);
+        typedef float (*GOLD_FUNC)(const float*, const float*, size_t);
+        std::vector<std::tuple<LOOKUP, GOLD_FUNC>> lookups = {
+            make_tuple(faiss::fvec_L2sqr_for_dim, faiss::fvec_L2sqr_ref),
+            make_tuple(faiss::fvec_inner_product_for_dim, faiss::fvec_inner_product_ref),
+            make_tuple(faiss::fvec_L2sqr_dim_ref, faiss::fvec_L2sqr_ref),
+            make_tuple(faiss::fvec_inner_product_dim_ref, faiss::fvec_inner_product_ref),
+        };
+#if defined(__x86_64__)
+        if (faiss::cpu_support_avx2()) {
+            lookups.emplace_back(faiss::fvec_L2sqr_dim_avx, faiss::fvec_L2sqr_ref);
+            lookups.emplace_back(faiss::fvec_inner_product_dim_avx, faiss::fvec_inner_product_ref);
+        }
+        if (faiss::cpu_support_avx512()) {
+            lookups.emplace_back(faiss::fvec_L2sqr_dim_avx512, faiss::fvec_L2sqr_ref);
+            lookups.emplace_back(faiss::fvec_inner_product_dim_avx512, faiss::fvec_inner_product_ref);
+        }
+#endif
+#if defined(__aarch64__)
+        lookups.emplace_back(faiss::fvec_L2sqr_dim_neon, faiss::fvec_L2sqr_ref);
+        lookups.emplace_back(faiss::fvec_inner_product_dim_neon, faiss::fvec_inner_product_ref);
+#endif
+        auto dim = GENERATE(as<size_t>{}, 128, 256, 384, 512, 768, 1024, 1536);
+        std::vector<float> x(dim);
+        std::vector<float> y(dim);
+        for (auto& v : x) {
+            v = fill_distrib(rng);
+        }
+        for (auto& v : y) {
+            v = fill_distrib(rng);
+        }
+        for (auto [lookup, gold_func] : lookups) {
+            auto real_func = lookup(dim);
+            REQUIRE(real_func != nullptr);
+            REQUIRE_THAT(real_func(x.data(), y.data(), dim),
+                         Catch::Matchers::WithinRel(gold_func(x.data(), y.data(), dim), 0.001f));
+        }
+        // any other dim keeps the generic kernels
+        CHECK(faiss::fvec_L2sqr_for_dim(dim + 1) == faiss::fvec_L2sqr);
+        CHECK(faiss::fvec_inner_product_for_dim(dim + 1) == faiss::fvec_inner_product);
+        CHECK(faiss::fvec_L2sqr_dim_ref(dim + 1) == nullptr);
+
+        // a slot stays the same and follows every hook after it was handed out
+        auto slot = faiss::fvec_L2sqr_slot_for_dim(dim);
+        CHECK(faiss::fvec_L2sqr_slot_for_dim(dim) == slot);
+        CHECK(*slot == faiss::fvec_L2sqr_for_dim(dim));
+#if defined(__x86_64__)
+        faiss::use_avx512 = faiss::use_avx2 = faiss::use_sse4_2 = false;
+        faiss::fvec_hook(ins);
+        CHECK(*slot == faiss::fvec_L2sqr_dim_ref(dim));
+        faiss::use_avx512 = faiss::use_avx2 = faiss::use_sse4_2 = true;
+        faiss::fvec_hook(ins);
+#endif
+        CHECK(*slot == faiss::fvec_L2sqr_for_dim(dim));
+        CHECK(*faiss::fvec_inner_product_slot_for_dim(dim + 1) == faiss::fvec_inner_product);
+    }
+
+    SECTION("Test Reduced Precision Distance Compute") {
+        typedef void (*HALF_FUNC)(float*, const float*, const uint16_t*, size_t, size_t);
+        typedef float (*HALF_GOLD_FUNC)(const float*, const uint16_t*, size_t);
+        typedef void (*I8_FUNC)(float*, const int8_t*, const int8_t*, size_t, size_t);
+        typedef float (*I8_GOLD_FUNC)(const int8_t*, const int8_t*, size_t);
+        std::vector<std::tuple<HALF_FUNC, HALF_GOLD_FUNC>> fp16_funcs = {
+            make_tuple(faiss::fp16vec_L2sqr_ny, faiss::fp16vec_L2sqr_ref),
+            make_tuple(faiss::fp16vec_inner_products_ny, faiss::fp16vec_inner_product_ref),
+        };
+        std::vector<std::tuple<HALF_FUNC, HALF_GOLD_FUNC>> bf16_funcs = {
+            make_tuple(faiss::bf16vec_L2sqr_ny, faiss::bf16vec_L2sqr_ref),
+            make_tuple(faiss::bf16vec_inner_products_ny, faiss::bf16vec_inner_product_ref),
+        };
+        std::vector<std::tuple<I8_FUNC, I8_GOLD_FUNC>> i8_funcs = {
+            make_tuple(faiss::i8vec_L2sqr_ny, faiss::i8vec_L2sqr_ref),
+            make_tuple(faiss::i8vec_inner_products_ny, faiss::i8vec_inner_product_ref),
+        };
+#if defined(__x86_64__)
+        if (faiss::cpu_support_avx2()) {
+            fp16_funcs.emplace_back(faiss::fp16vec_L2sqr_ny_avx, faiss::fp16vec_L2sqr_ref);
+            bf16_funcs.emplace_back(faiss::bf16vec_inner_products_ny_avx, faiss::bf16vec_inner_product_ref);
+            i8_funcs.emplace_back(faiss::i8vec_L2sqr_ny_avx, faiss::i8vec_L2sqr_ref);
+            i8_funcs.emplace_back(faiss::i8vec_inner_products_ny_avx, faiss::i8vec_inner_product_ref);
+        }
+        if (faiss::cpu_support_avx512()) {
+            fp16_funcs.emplace_back(faiss::fp16vec_L2sqr_ny_avx512, faiss::fp16vec_L2sqr_ref);
+            fp16_funcs.emplace_back(faiss::fp16vec_inner_products_ny_avx512, faiss::fp16vec_inner_product_ref);
+            bf16_funcs.emplace_back(faiss::bf16vec_L2sqr_ny_avx512, faiss::bf16vec_L2sqr_ref);
+            bf16_funcs.emplace_back(faiss::bf16vec_inner_products_ny_avx512, faiss::bf16vec_inner_product_ref);
+            i8_funcs.emplace_back(faiss::i8vec_L2sqr_ny_avx512, faiss::i8vec_L2sqr_ref);
+            i8_funcs.emplace_back(faiss::i8vec_inner_products_ny_avx512, faiss::i8vec_inner_product_ref);
+        }
+#endif
+#if defined(__aarch64__)
+        i8_funcs.emplace_back(faiss::i8vec_L2sqr_ny_neon, faiss::i8vec_L2sqr_ref);
+        i8_funcs.emplace_back(faiss::i8vec_inner_products_ny_neon, faiss::i8vec_inner_product_ref);
+#endif
+        std::uniform_int_distribution<> dim_distrib(1, 300);
+        std::uniform_int_distribution<> ny_distrib(1, 40);
+        std::uniform_real_distribution<float> data_distrib(-1, 1);
+        std::uniform_int_distribution<> i8_distrib(-128, 127);
+        for (int i = 0; i < 100; ++i) {
+            CAPTURE(i);
+            size_t dim = dim_distrib(rng);
+            size_t ny = ny_distrib(rng);
+            std::vector<float> x(dim);
+            std::vector<float> ys(ny * dim);
+            for (auto& v : x) {
+                v = data_distrib(rng);
+            }
+            for (auto& v : ys) {
+                v = data_distrib(rng);
+            }
+            std::vector<uint16_t> fp16_ys(ny * dim);
+            std::vector<uint16_t> bf16_ys(ny * dim);
+            faiss::fvec_to_fp16_ref(fp16_ys.data(), ys.data(), ny * dim);
+            faiss::fvec_to_bf16_ref(bf16_ys.data(), ys.data(), ny * dim);
+            std::vector<int8_t> i8_x(dim);
+            std::vector<int8_t> i8_ys(ny * dim);
+            for (auto& v : i8_x) {
+                v = i8_distrib(rng);
+            }
+            for (auto& v : i8_ys) {
+                v = i8_distrib(rng);
+            }
+            std::vector<float> dis(ny);
+            for (auto& [funcs, codes] : {make_tuple(fp16_funcs, fp16_ys.data()), make_tuple(bf16_funcs, bf16_ys.data())}) {
+                for (auto [real_func, gold_func] : funcs) {
+                    real_func(dis.data(), x.data(), codes, dim, ny);
+                    for (size_t j = 0; j < ny; ++j) {
+                        auto gold = gold_func(x.data(), codes + j * dim, dim);
+                        REQUIRE_THAT(dis[j], Catch::Matchers::WithinRel(gold, 0.001f) ||
+                                                 Catch::Matchers::WithinAbs(gold, 0.001f));
+                    }
+                }
+            }
+            // the int8 sums are exact
+            for (auto [real_func, gold_func] : i8_funcs) {
+                real_func(dis.data(), i8_x.data(), i8_ys.data(), dim, ny);
+                for (size_t j = 0; j < ny; ++j) {
+                    REQUIRE(dis[j] == gold_func(i8_x.data(), i8_ys.data() + j * dim, dim));
+                }
+            }
+        }
+    }
+
+#if defined(__x86_64__)
+    SECTION("Test AMX Inner Products Gemm") {
+        // the cpu or the kernel may not provide AMX
+        if (faiss::cpu_support_amx()) {
+            std::uniform_real_distribution<float> signed_distrib(-1.0f, 1.0f);
+            std::uniform_int_distribution<> size_distrib(1, 100);
+            for (int i = 0; i < 20; ++i) {
+                CAPTURE(i);
+                size_t nx = size_distrib(rng), ny = size_distrib(rng), dim = size_distrib(rng) * 3;
+                std::vector<float> x(nx * dim);
+                std::vector<float> y(ny * dim);
+                for (auto& v : x) {
+                    v = signed_distrib(rng);
+                }
+                for (auto& v : y) {
+                    v = signed_distrib(rng);
+                }
+                std::vector<float> ip(nx * ny);
+                faiss::fvec_inner_products_gemm_amx(ip.data(), x.data(), y.data(), dim, nx, ny);
+                // the products are rounded to bf16, 8 bits of mantissa
+                for (size_t a = 0; a < nx; ++a) {
+                    for (size_t b = 0; b < ny; ++b) {
+                        float gold = faiss::fvec_inner_product_ref(x.data() + a * dim, y.data() + b * dim, dim);
+                        REQUIRE_THAT(ip[a * ny + b], Catch::Matchers::WithinAbs(gold, 0.01f * dim));
+                    }
+                }
+            }
+        }
+    }
+#endif
+
+    SECTION("Test Column Block Distance Compute") {
+        typedef void (*FUNC)(float*, const float*, const float*, size_t);
+        typedef float (*GOLD_FUNC)(const float*, const float*, size_t);
+        auto [real_func, ref_func, gold_func] = GENERATE(table<FUNC, FUNC, GOLD_FUNC>({
+            make_tuple(faiss::fvec_L2sqr_block_16, faiss::fvec_L2sqr_block_16_ref, faiss::fvec_L2sqr_ref),
+            make_tuple(faiss::fvec_inner_product_block_16, faiss::fvec_inner_product_block_16_ref,
+                       faiss::fvec_inner_product_ref),
+        }));
+        std::uniform_int_distribution<> dim_distrib(1, 300);
+        for (int i = 0; i < 100; ++i) {
+            CAPTURE(i);
+            auto dim = dim_distrib(rng);
+            std::vector<float> x(dim);
+            std::vector<float> ys(16 * dim);
+            std::vector<float> block(16 * dim);
+            for (auto& v : x) {
+                v = fill_distrib(rng);
+            }
+            for (int j = 0; j < 16; ++j) {
+                for (int t = 0; t < dim; ++t) {
+                    ys[j * dim + t] = fill_distrib(rng);
+                    block[t * 16 + j] = ys[j * dim + t];
+                }
+            }
+            float dis[16], dis_ref[16];
+            real_func(dis, x.data(), block.data(), dim);
+            ref_func(dis_ref, x.data(), block.data(), dim);
+            for (int j = 0; j < 16; ++j) {
+                auto gold = gold_func(x.data(), ys.data() + j * dim, dim);
+                REQUIRE_THAT(dis[j], Catch::Matchers::WithinRel(gold, 0.001f));
+                REQUIRE_THAT(dis_ref[j], Catch::Matchers::WithinRel(gold, 0.001f));
+            }
+        }
+    }
+
+    SECTION("Test Bit Vector Distance Compute") {
+        std::uniform_int_distribution<> code_size_distrib(1, 300);
+        std::uniform_int_distribution<> byte_distrib(0, 255);
+        for (int i = 0; i < 1000; ++i) {
+            CAPTURE(i);
+            auto code_size = code_size_distrib(rng);
+            std::vector<std::vector<uint8_t>> codes(5, std::vector<uint8_t>(code_size));
+            for (auto& code : codes) {
+                for (auto& byte : code) {
+                    byte = byte_distrib(rng);
+                }
+            }
+            auto x = codes[0].data();
+            auto y = codes[1].data();
+            REQUIRE(faiss::bvec_hamming(x, y, code_size) == faiss::xor_popcnt(x, y, code_size));
+            REQUIRE(faiss::bvec_hamming_ref(x, y, code_size) == faiss::xor_popcnt(x, y, code_size));
+            REQUIRE_THAT(faiss::bvec_jaccard_dis(x, y, code_size),
+                         Catch::Matchers::WithinRel(faiss::bvec_jaccard(x, y, code_size), 0.0001f));
+            REQUIRE_THAT(faiss::bvec_jaccard_ref(x, y, code_size),
+                         Catch::Matchers::WithinRel(faiss::bvec_jaccard(x, y, code_size), 0.0001f));
+
+            float dis[4];
+            faiss::bvec_hamming_batch_4(x, codes[1].data(), codes[2].data(), codes[3].data(), codes[4].data(),
+                                        code_size, dis[0], dis[1], dis[2], dis[3]);
+            for (int j = 0; j < 4; ++j) {
+                REQUIRE(dis[j] == faiss::xor_popcnt(x, codes[j + 1].data(), code_size));
+            }
+            faiss::bvec_jaccard_batch_4(x, codes[1].data(), codes[2].data(), codes[3].data(), codes[4].data(),
+                                        code_size, dis[0], dis[1], dis[2], dis[3]);
+            for (int j = 0; j < 4; ++j) {
+                auto gold = faiss::bvec_jaccard(x, codes[j + 1].data(), code_size);
+                REQUIRE_THAT(dis[j], Catch::Matchers::WithinRel(gold, 0.0001f));
+            }
+
+            // codes 1 to 4 one after the other, the last one a superset of x
+            std::vector<uint8_t> ys;
+            for (int j = 1; j < 5; ++j) {
+                ys.insert(ys.end(), codes[j].begin(), codes[j].end());
+            }
+            for (int b = 0; b < code_size; ++b) {
+                ys[3 * code_size + b] |= x[b];
+            }
+            for (const size_t ny : {1, 3, 4}) {
+                std::vector<float> dis_ny(ny);
+                faiss::bvec_hamming_ny(dis_ny.data(), x, ys.data(), code_size, ny);
+                for (size_t j = 0; j < ny; ++j) {
+                    REQUIRE(dis_ny[j] == faiss::xor_popcnt(x, ys.data() + j * code_size, code_size));
+                }
+                faiss::bvec_jaccard_ny(dis_ny.data(), x, ys.data(), code_size, ny);
+                for (size_t j = 0; j < ny; ++j) {
+                    auto gold = faiss::bvec_jaccard(x, ys.data() + j * code_size, code_size);
+                    REQUIRE_THAT(dis_ny[j], Catch::Matchers::WithinRel(gold, 0.0001f));
+                }
+            }
+            for (int j = 0; j < 4; ++j) {
+                auto y_j = ys.data() + j * code_size;
+                REQUIRE(faiss::bvec_is_subset(x, y_j, code_size) == faiss::is_subset(x, y_j, code_size));
+                REQUIRE(faiss::bvec_is_subset(y_j, x, code_size) == faiss::is_subset(y_j, x, code_size));
+            }
+            REQUIRE(faiss::bvec_is_subset(x, ys.data() + 3 * code_size, code_size));
+        }
+    }
+
+    SECTION("Test PQ ADC Lookup") {
+        typedef void (*FUNC)(float*, const uint8_t*, const float*, size_t, size_t);
+        std::vector<FUNC> funcs = {faiss::pq_adc_ny};
+#if defined(__x86_64__)
+        if (faiss::cpu_support_avx2()) {
+            funcs.push_back(faiss::pq_adc_ny_avx);
+        }
+        if (faiss::cpu_support_avx512()) {
+            funcs.push_back(faiss::pq_adc_ny_avx512);
+        }
+#endif
+        std::uniform_int_distribution<> chunk_distrib(1, 70);
+        std::uniform_int_distribution<> ny_distrib(1, 100);
+        std::uniform_int_distribution<> code_distrib(0, 255);
+        for (int i = 0; i < 100; ++i) {
+            CAPTURE(i);
+            size_t nchunks = chunk_distrib(rng);
+            size_t ny = ny_distrib(rng);
+            std::vector<float> tables(nchunks * 256);
+            for (auto& v : tables) {
+                v = fill_distrib(rng);
+            }
+            std::vector<uint8_t> codes(ny * nchunks);
+            for (auto& v : codes) {
+                v = code_distrib(rng);
+            }
+            std::vector<float> gold(ny);
+            faiss::pq_adc_ny_ref(gold.data(), codes.data(), tables.data(), ny, nchunks);
+            for (auto func : funcs) {
+                std::vector<float> dis(ny);
+                func(dis.data(), codes.data(), tables.data(), ny, nchunks);
+                // the chunks are summed in the same order
+                REQUIRE(dis == gold);
+            }
+        }
+    }
+
+    SECTION("Test SQ8 Int8 Inner Product") {
+        using SELECTOR = faiss::InvertedListScanner* (*)(faiss::MetricType, const faiss::ScalarQuantizer*,
+                                                        const faiss::Index*, size_t, bool, bool);
+        // the selectors and the largest int8 weight of their quantized query
+        std::vector<std::pair<SELECTOR, int>> selectors;
+#if defined(__x86_64__)
+        if (faiss::cpu_support_avx2()) {
+            selectors.emplace_back(faiss::sq_select_inverted_list_scanner_avx, 63);
+        }
+        if (faiss::cpu_support_avx512()) {
+            selectors.emplace_back(faiss::sq_select_inverted_list_scanner_avx512, 63);
+        }
+        if (faiss::cpu_support_avx512_vnni()) {
+            selectors.emplace_back(faiss::sq_select_inverted_list_scanner_avx512_vnni, 127);
+        }
+#endif
+        auto qtype = GENERATE(faiss::QuantizerType::QT_8bit, faiss::QuantizerType::QT_8bit_uniform);
+        auto dim = GENERATE(16, 100, 128, 200);
+        const int nb = 200;
+        std::uniform_real_distribution<float> data_distrib(0, 1);
+        std::uniform_real_distribution<float> query_distrib(-1, 1);
+        std::vector<float> xb(nb * dim);
+        std::vector<float> xq(dim);
+        for (auto& v : xb) {
+            v = data_distrib(rng);
+        }
+        for (auto& v : xq) {
+            v = query_distrib(rng);
+        }
+        faiss::ScalarQuantizer sq(dim, qtype);
+        sq.train(nb, xb.data());
+        std::vector<uint8_t> codes(nb * sq.code_size);
+        sq.compute_codes(xb.data(), codes.data(), nb);
+
+        std::unique_ptr<faiss::InvertedListScanner> gold(
+            faiss::sq_select_inverted_list_scanner_ref(faiss::METRIC_INNER_PRODUCT, &sq, nullptr, dim, false, false));
+        gold->set_query(xq.data());
+        gold->set_list(0, 0);
+        // the query weights x[i] * vdiff[i] / 255 are rounded to multiples of scale = max |weight| / qmax, which is
+        // all the error of a code on top of the float rounding: sum(c[i] * |weight[i] - scale * qw[i]|)
+        bool uniform = qtype == faiss::QuantizerType::QT_8bit_uniform;
+        std::vector<float> w(dim);
+        float wmax = 0;
+        for (int i = 0; i < dim; ++i) {
+            w[i] = xq[i] * (uniform ? sq.trained[1] : sq.trained[dim + i]) / 255.0f;
+            wmax = std::max(wmax, std::abs(w[i]));
+        }
+        for (auto [selector, qmax] : selectors) {
+            float scale = wmax > 0 ? wmax / qmax : 1.0f;
+            std::vector<float> rounding(dim);
+            for (int i = 0; i < dim; ++i) {
+                rounding[i] = std::abs(w[i] - scale * std::lrint(w[i] / scale));
+            }
+            std::unique_ptr<faiss::InvertedListScanner> scanner(
+                selector(faiss::METRIC_INNER_PRODUCT, &sq, nullptr, dim, false, false));
+            scanner->set_query(xq.data());
+            scanner->set_list(0, 0);
+            for (int i = 0; i < nb; ++i) {
+                auto code = codes.data() + i * sq.code_size;
+                float tolerance = 1e-5f * dim;
+                for (int j = 0; j < dim; ++j) {
+                    tolerance += code[j] * rounding[j];
+                }
+                REQUIRE_THAT(scanner->distance_to_code(code),
+                             Catch::Matchers::WithinAbs(gold->distance_to_code(code), tolerance));
+            }
+        }
+
+#if defined(__x86_64__)
+        // turned off, the codes are decoded to floats again
+        faiss::use_sq_int8_query = false;
+        for (auto [selector, qmax] : selectors) {
+            std::unique_ptr<faiss::InvertedListScanner> scanner(
+                selector(faiss::METRIC_INNER_PRODUCT, &sq, nullptr, dim, false, false));
+            scanner->set_query(xq.data());
+            scanner->set_list(0, 0);
+            for (int i = 0; i < nb; ++i) {
+                auto code = codes.data() + i * sq.code_size;
+                REQUIRE_THAT(scanner->distance_to_code(code),
+                             Catch::Matchers::WithinAbs(gold->distance_to_code(code), 1e-5f * dim));
+            }
+        }
+        faiss::use_sq_int8_query = true;
+#endif
+    }
 }
@@ -228,4 +228,32 @@ TEST_CASE("Test Feder", "[feder]") {
         REQUIRE(res1.has_value());
         CheckIvfFlatMeta(res1.value(), nb, json);
     }
+
+    SECTION("Test IVF List Stats") {
+        auto name = knowhere::IndexEnum::INDEX_FAISS_IVFSQ8;
+        auto idx = knowhere::IndexFactory::Instance().Create(name);
+        REQUIRE(idx.Type() == name);
+
+        auto json = ivfflat_gen();
+        json[knowhere::indexparam::LIST_SPLIT_RATIO] = 1.5;
+        json[knowhere::indexparam::LIST_STATS] = true;
+        REQUIRE(idx.Build(*train_ds, json) == knowhere::Status::success);
+
+        auto res = idx.GetIndexMeta(json);
+        REQUIRE(res.has_value());
+        auto stats = knowhere::Json::parse(res.value()->GetJsonInfo());
+        int64_t nlist = stats["nlist"];
+        REQUIRE(nlist >= json[knowhere::indexparam::NLIST].get<int64_t>());
+        REQUIRE(stats["ntotal"] == nb);
+        REQUIRE(stats["imbalance_factor"].get<double>() >= 1.0);
+        REQUIRE(stats["list_bytes"].size() == (size_t)nlist);
+        int64_t lists = 0;
+        for (auto& cnt : stats["list_size_histogram"]) {
+            lists += cnt.get<int64_t>();
+        }
+        REQUIRE(lists == nlist);
+
+        auto results = idx.Search(*query_ds, json, nullptr);
+        REQUIRE(results.has_value());
+    }
 }
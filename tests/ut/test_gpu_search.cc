@@ -9,6 +9,10 @@
 // is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
 // or implied. See the License for the specific language governing permissions and limitations under the License.
 
+#include <algorithm>
+#include <thread>
+#include <vector>
+
 #include "catch2/catch_approx.hpp"
 #include "catch2/catch_test_macros.hpp"
 #include "catch2/generators/catch_generators.hpp"
@@ -16,6 +20,7 @@
 #include "knowhere/comp/index_param.h"
 #include "knowhere/comp/knowhere_config.h"
 #include "knowhere/factory.h"
+#include "knowhere/prometheus_client.h"
 #include "utils.h"
 
 #ifdef KNOWHERE_WITH_RAFT
@@ -57,6 +62,20 @@ TEST_CASE("Test All GPU Index", "[search]") {
         return json;
     };
 
+    auto cagra_gen = [&base_gen]() {
+        knowhere::Json json = base_gen();
+        json[knowhere::indexparam::INTERMEDIATE_GRAPH_DEGREE] = 64;
+        json[knowhere::indexparam::GRAPH_DEGREE] = 32;
+        json[knowhere::indexparam::ITOPK_SIZE] = 128;
+        return json;
+    };
+
+    auto cagra_ip_gen = [&cagra_gen]() {
+        knowhere::Json json = cagra_gen();
+        json[knowhere::meta::METRIC_TYPE] = knowhere::metric::IP;
+        return json;
+    };
+
     SECTION("Test Gpu Index Search") {
         using std::make_tuple;
         auto [name, gen] = GENERATE_REF(table<std::string, std::function<knowhere::Json()>>({
@@ -68,6 +87,8 @@ TEST_CASE("Test All GPU Index", "[search]") {
             // make_tuple(knowhere::IndexEnum::INDEX_FAISS_GPU_IVFSQ8, ivfsq_gen),
             make_tuple(knowhere::IndexEnum::INDEX_RAFT_IVFFLAT, ivfflat_gen),
             make_tuple(knowhere::IndexEnum::INDEX_RAFT_IVFPQ, ivfpq_gen),
+            make_tuple(knowhere::IndexEnum::INDEX_RAFT_CAGRA, cagra_gen),
+            make_tuple(knowhere::IndexEnum::INDEX_RAFT_BRUTE_FORCE, gpu_flat_gen),
         }));
         auto idx = knowhere::IndexFactory::Instance().Create(name);
         auto cfg_json = gen().dump();
@@ -86,6 +107,53 @@ TEST_CASE("Test All GPU Index", "[search]") {
         }
     }
 
+    SECTION("Test Gpu Index Metrics") {
+        auto name = GENERATE(as<std::string>{}, knowhere::IndexEnum::INDEX_RAFT_IVFFLAT,
+                             knowhere::IndexEnum::INDEX_RAFT_CAGRA, knowhere::IndexEnum::INDEX_RAFT_BRUTE_FORCE);
+        auto json = name == knowhere::IndexEnum::INDEX_RAFT_IVFFLAT ? ivfflat_gen()
+                    : name == knowhere::IndexEnum::INDEX_RAFT_CAGRA ? cagra_gen()
+                                                                    : gpu_flat_gen();
+        CAPTURE(name);
+        auto idx = knowhere::IndexFactory::Instance().Create(name);
+        auto train_ds = GenDataSet(nb, dim, seed);
+        auto query_ds = GenDataSet(nq, dim, seed);
+        REQUIRE(idx.Build(*train_ds, json) == knowhere::Status::success);
+        const auto& metrics = knowhere::GetGpuMetrics(name);
+        auto h2d = metrics.h2d_bytes.Value();
+        auto d2h = metrics.d2h_bytes.Value();
+        auto results = idx.Search(*query_ds, json, nullptr);
+        REQUIRE(results.has_value());
+        CHECK(metrics.h2d_bytes.Value() >= h2d + nq * dim * sizeof(float));
+        CHECK(metrics.d2h_bytes.Value() >= d2h + nq * (sizeof(int64_t) + sizeof(float)));
+        auto str = knowhere::prometheusClient->GetMetrics();
+        CHECK(str.find("stage=\"kernel\"") != std::string::npos);
+        CHECK(str.find("pool=\"rmm\"") != std::string::npos);
+    }
+
+    SECTION("Test Gpu Index Chunked Build") {
+        using std::make_tuple;
+        auto [name, gen] = GENERATE_REF(table<std::string, std::function<knowhere::Json()>>({
+            make_tuple(knowhere::IndexEnum::INDEX_RAFT_IVFFLAT, ivfflat_gen),
+            make_tuple(knowhere::IndexEnum::INDEX_RAFT_IVFPQ, ivfpq_gen),
+            make_tuple(knowhere::IndexEnum::INDEX_RAFT_CAGRA, cagra_gen),
+        }));
+        CAPTURE(name);
+        auto idx = knowhere::IndexFactory::Instance().Create(name);
+        knowhere::Json json = gen();
+        // 10000 rows in chunks of 768, the last one shorter
+        json[knowhere::indexparam::BUILD_CHUNK_ROWS] = 768;
+        auto train_ds = GenDataSet(nb, dim, seed);
+        auto query_ds = GenDataSet(nq, dim, seed);
+        REQUIRE(idx.Build(*train_ds, json) == knowhere::Status::success);
+        REQUIRE(idx.Count() == nb);
+        auto results = idx.Search(*query_ds, json, nullptr);
+        REQUIRE(results.has_value());
+        auto ids = results.value()->GetIds();
+        for (int i = 0; i < nq; ++i) {
+            CHECK(ids[i] == i);
+        }
+    }
+
     SECTION("Test Gpu Index Search With Bitset") {
         using std::make_tuple;
         auto [name, gen] = GENERATE_REF(table<std::string, std::function<knowhere::Json()>>({
@@ -97,6 +165,8 @@ TEST_CASE("Test All GPU Index", "[search]") {
             // make_tuple(knowhere::IndexEnum::INDEX_FAISS_GPU_IVFSQ8, ivfsq_gen),
             make_tuple(knowhere::IndexEnum::INDEX_RAFT_IVFFLAT, ivfflat_gen),
             make_tuple(knowhere::IndexEnum::INDEX_RAFT_IVFPQ, ivfpq_gen),
+            make_tuple(knowhere::IndexEnum::INDEX_RAFT_CAGRA, cagra_gen),
+            make_tuple(knowhere::IndexEnum::INDEX_RAFT_BRUTE_FORCE, gpu_flat_gen),
         }));
         auto idx = knowhere::IndexFactory::Instance().Create(name);
         auto cfg_json = gen().dump();
@@ -139,6 +209,8 @@ TEST_CASE("Test All GPU Index", "[search]") {
             // make_tuple(knowhere::IndexEnum::INDEX_FAISS_GPU_IVFSQ8, ivfsq_gen),
             make_tuple(knowhere::IndexEnum::INDEX_RAFT_IVFFLAT, ivfflat_gen),
             make_tuple(knowhere::IndexEnum::INDEX_RAFT_IVFPQ, ivfpq_gen),
+            make_tuple(knowhere::IndexEnum::INDEX_RAFT_CAGRA, cagra_gen),
+            make_tuple(knowhere::IndexEnum::INDEX_RAFT_BRUTE_FORCE, gpu_flat_gen),
         }));
         auto idx = knowhere::IndexFactory::Instance().Create(name);
         auto cfg_json = gen().dump();
@@ -171,6 +243,8 @@ TEST_CASE("Test All GPU Index", "[search]") {
             // make_tuple(knowhere::IndexEnum::INDEX_FAISS_GPU_IVFSQ8, ivfsq_gen),
             make_tuple(knowhere::IndexEnum::INDEX_RAFT_IVFFLAT, ivfflat_gen),
             make_tuple(knowhere::IndexEnum::INDEX_RAFT_IVFPQ, ivfpq_gen),
+            make_tuple(knowhere::IndexEnum::INDEX_RAFT_CAGRA, cagra_gen),
+            make_tuple(knowhere::IndexEnum::INDEX_RAFT_BRUTE_FORCE, gpu_flat_gen),
         }));
 
         auto idx = knowhere::IndexFactory::Instance().Create(name);
@@ -221,5 +295,280 @@ TEST_CASE("Test All GPU Index", "[search]") {
         float recall = GetKNNRecall(*gt.value(), *results.value());
         REQUIRE(recall == 1.0f);
     }
+
+    SECTION("Test Gpu Index Search Batching") {
+        using std::make_tuple;
+        auto [name, gen] = GENERATE_REF(table<std::string, std::function<knowhere::Json()>>({
+            make_tuple(knowhere::IndexEnum::INDEX_RAFT_IVFFLAT, ivfflat_gen),
+            make_tuple(knowhere::IndexEnum::INDEX_RAFT_IVFPQ, ivfpq_gen),
+        }));
+        auto idx = knowhere::IndexFactory::Instance().Create(name);
+        knowhere::Json json = gen();
+        json[knowhere::meta::TOPK] = 10;
+        auto train_ds = GenDataSet(nb, dim, seed);
+        auto query_ds = GenDataSet(nq, dim, seed + 1);
+        REQUIRE(idx.Build(*train_ds, json) == knowhere::Status::success);
+        auto expected = idx.Search(*query_ds, json, nullptr);
+        REQUIRE(expected.has_value());
+
+        // searches of a single query from many threads, each must get the rows of its own query back
+        knowhere::KnowhereConfig::SetGpuSearchBatching(2000, 64);
+        const int64_t num_threads = 32, per_thread = 8;
+        auto queries = (const float*)query_ds->GetTensor();
+        std::vector<std::thread> threads;
+        std::vector<int> failed(num_threads, 0);
+        for (int64_t t = 0; t < num_threads; ++t) {
+            threads.emplace_back([&, t]() {
+                for (int64_t i = t * per_thread; i < (t + 1) * per_thread; ++i) {
+                    auto one = knowhere::GenDataSet(1, dim, queries + i * dim);
+                    auto res = idx.Search(*one, json, nullptr);
+                    auto want = expected.value()->GetIds() + i * 10;
+                    if (!res.has_value() || !std::equal(want, want + 10, res.value()->GetIds())) {
+                        failed[t] = 1;
+                    }
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        knowhere::KnowhereConfig::SetGpuSearchBatching(0);
+        for (int64_t t = 0; t < num_threads; ++t) {
+            CHECK(failed[t] == 0);
+        }
+    }
+
+    SECTION("Test Gpu Index Multi GPU") {
+        // both modes over the same device twice, as a host with a single GPU can run them
+        auto [mode] = GENERATE(table<std::string>({"replicated", "sharded"}));
+        auto idx = knowhere::IndexFactory::Instance().Create(knowhere::IndexEnum::INDEX_RAFT_IVFFLAT);
+        knowhere::Json json = ivfflat_gen();
+        json[knowhere::indexparam::GPU_IDS] = {0, 0};
+        json[knowhere::indexparam::MULTI_GPU_MODE] = mode;
+        CAPTURE(mode);
+        auto train_ds = GenDataSet(nb, dim, seed);
+        // the last vectors, which are in the second shard
+        auto first = nb - nq;
+        auto query_ds = knowhere::GenDataSet(nq, dim, (const float*)train_ds->GetTensor() + first * dim);
+        REQUIRE(idx.Build(*train_ds, json) == knowhere::Status::success);
+        REQUIRE(idx.Count() == nb);
+
+        auto check = [&](const knowhere::Index<knowhere::IndexNode>& index) {
+            auto results = index.Search(*query_ds, json, nullptr);
+            REQUIRE(results.has_value());
+            auto ids = results.value()->GetIds();
+            for (int64_t i = 0; i < nq; ++i) {
+                CHECK(ids[i] == first + i);
+            }
+            std::vector<uint8_t> bits(nb / 8, 0);
+            for (int64_t i = first; i < nb; i += 2) {
+                bits[i >> 3] |= 1 << (i & 7);
+            }
+            auto filtered = index.Search(*query_ds, json, knowhere::BitsetView(bits.data(), nb));
+            REQUIRE(filtered.has_value());
+            for (int64_t i = 0; i < nq; ++i) {
+                CHECK((i % 2 == 0) == (filtered.value()->GetIds()[i] != first + i));
+            }
+        };
+        check(idx);
+
+        knowhere::BinarySet bs;
+        REQUIRE(idx.Serialize(bs) == knowhere::Status::success);
+        auto loaded = knowhere::IndexFactory::Instance().Create(knowhere::IndexEnum::INDEX_RAFT_IVFFLAT);
+        REQUIRE(loaded.Deserialize(bs) == knowhere::Status::success);
+        REQUIRE(loaded.Count() == nb);
+        check(loaded);
+    }
+
+    SECTION("Test Gpu Index Search Filter Version") {
+        using std::make_tuple;
+        auto [name, gen] = GENERATE_REF(table<std::string, std::function<knowhere::Json()>>({
+            make_tuple(knowhere::IndexEnum::INDEX_RAFT_IVFFLAT, ivfflat_gen),
+            make_tuple(knowhere::IndexEnum::INDEX_RAFT_CAGRA, cagra_gen),
+        }));
+        CAPTURE(name);
+        auto idx = knowhere::IndexFactory::Instance().Create(name);
+        knowhere::Json json = gen();
+        auto train_ds = GenDataSet(nb, dim, seed);
+        REQUIRE(idx.Build(*train_ds, json) == knowhere::Status::success);
+        auto query_ds = knowhere::GenDataSet(nq, dim, train_ds->GetTensor());
+
+        // each version filters out other queries, a kept filter must not hide the changes of the next version
+        std::vector<uint8_t> bits(nb / 8, 0);
+        for (int64_t version = 0; version < 3; ++version) {
+            std::fill(bits.begin(), bits.end(), 0);
+            for (int64_t i = version; i < nq; i += 3) {
+                bits[i >> 3] |= 1 << (i & 7);
+            }
+            json[knowhere::indexparam::FILTER_VERSION] = version;
+            for (int repeat = 0; repeat < 2; ++repeat) {
+                auto results = idx.Search(*query_ds, json, knowhere::BitsetView(bits.data(), nb));
+                REQUIRE(results.has_value());
+                for (int64_t i = 0; i < nq; ++i) {
+                    CHECK((i % 3 == version) == (results.value()->GetIds()[i] != i));
+                }
+            }
+        }
+    }
+
+    SECTION("Test RAFT IVF Range Search") {
+        auto idx = knowhere::IndexFactory::Instance().Create(knowhere::IndexEnum::INDEX_RAFT_IVFFLAT);
+        knowhere::Json json = ivfflat_gen();
+        auto train_ds = GenDataSet(nb, dim, seed);
+        auto query_ds = GenDataSet(nq, dim, seed);
+        REQUIRE(idx.Build(*train_ds, json) == knowhere::Status::success);
+        auto results = idx.RangeSearch(*query_ds, json, nullptr);
+        REQUIRE(results.has_value());
+        auto gt = knowhere::BruteForce::RangeSearch(train_ds, query_ds, json, nullptr);
+        REQUIRE(gt.has_value());
+        REQUIRE(GetRangeSearchRecall(*gt.value(), *results.value()) > 0.8f);
+    }
+
+    SECTION("Test RAFT IVF-PQ Host Refine") {
+        auto idx = knowhere::IndexFactory::Instance().Create(knowhere::IndexEnum::INDEX_RAFT_IVFPQ);
+        knowhere::Json json = ivfpq_gen();
+        json[knowhere::meta::TOPK] = 10;
+        json[knowhere::indexparam::HOST_REFINE] = true;
+        auto train_ds = GenDataSet(nb, dim, seed);
+        auto query_ds = GenDataSet(nq, dim, seed);
+        REQUIRE(idx.Build(*train_ds, json) == knowhere::Status::success);
+        auto gt = knowhere::BruteForce::Search(train_ds, query_ds, json, nullptr);
+        REQUIRE(gt.has_value());
+        auto results = idx.Search(*query_ds, json, nullptr);
+        REQUIRE(results.has_value());
+        auto recall = GetKNNRecall(*gt.value(), *results.value());
+
+        // the reranked candidates find at least as many of the exact results
+        json[knowhere::indexparam::REFINE_RATIO] = 4.0;
+        auto refined = idx.Search(*query_ds, json, nullptr);
+        REQUIRE(refined.has_value());
+        REQUIRE(GetKNNRecall(*gt.value(), *refined.value()) >= recall);
+
+        knowhere::BinarySet bs;
+        REQUIRE(idx.Serialize(bs) == knowhere::Status::success);
+        auto idx_new = knowhere::IndexFactory::Instance().Create(knowhere::IndexEnum::INDEX_RAFT_IVFPQ);
+        REQUIRE(idx_new.Deserialize(bs, json) == knowhere::Status::success);
+        auto reloaded = idx_new.Search(*query_ds, json, nullptr);
+        REQUIRE(reloaded.has_value());
+        REQUIRE(GetKNNRecall(*gt.value(), *reloaded.value()) >= recall);
+    }
+
+    SECTION("Test CAGRA Inner Product") {
+        auto idx = knowhere::IndexFactory::Instance().Create(knowhere::IndexEnum::INDEX_RAFT_CAGRA);
+        knowhere::Json json = cagra_ip_gen();
+        json[knowhere::meta::TOPK] = 10;
+        auto train_ds = GenDataSet(nb, dim, seed);
+        auto query_ds = GenDataSet(nq, dim, seed + 1);
+        REQUIRE(idx.Build(*train_ds, json) == knowhere::Status::success);
+        auto results = idx.Search(*query_ds, json, nullptr);
+        REQUIRE(results.has_value());
+        auto gt = knowhere::BruteForce::Search(train_ds, query_ds, json, nullptr);
+        REQUIRE(GetKNNRecall(*gt.value(), *results.value()) > 0.8f);
+        // distances are inner products again, not the L2 distances of the extended vectors
+        if (results.value()->GetIds()[0] == gt.value()->GetIds()[0]) {
+            REQUIRE(results.value()->GetDistance()[0] == Approx(gt.value()->GetDistance()[0]).epsilon(1e-3));
+        }
+
+        auto ids_ds = GenIdsDataSet(nb, nq);
+        auto vectors = idx.GetVectorByIds(*ids_ds);
+        REQUIRE(vectors.has_value());
+        auto data = (const float*)train_ds->GetTensor();
+        auto got = (const float*)vectors.value()->GetTensor();
+        for (int64_t i = 0; i < nq * dim; ++i) {
+            REQUIRE(got[i] == data[ids_ds->GetIds()[i / dim] * dim + i % dim]);
+        }
+    }
+
+    SECTION("Test CAGRA Serialized For CPU") {
+        auto [gen] = GENERATE_REF(table<std::function<knowhere::Json()>>({
+            std::make_tuple(cagra_gen),
+            std::make_tuple(cagra_ip_gen),
+        }));
+        auto idx = knowhere::IndexFactory::Instance().Create(knowhere::IndexEnum::INDEX_RAFT_CAGRA);
+        knowhere::Json json = gen();
+        json[knowhere::indexparam::ADAPT_FOR_CPU] = true;
+        json[knowhere::meta::TOPK] = 10;
+        auto train_ds = GenDataSet(nb, dim, seed);
+        auto query_ds = GenDataSet(nq, dim, seed + 1);
+        REQUIRE(idx.Build(*train_ds, json) == knowhere::Status::success);
+        knowhere::BinarySet bs;
+        REQUIRE(idx.Serialize(bs) == knowhere::Status::success);
+
+        // a host without GPU serves the same binary set as HNSW
+        auto hnsw = knowhere::IndexFactory::Instance().Create(knowhere::IndexEnum::INDEX_HNSW);
+        REQUIRE(hnsw.Deserialize(bs) == knowhere::Status::success);
+        REQUIRE(hnsw.Count() == nb);
+        json[knowhere::indexparam::EF] = 64;
+        auto results = hnsw.Search(*query_ds, json, nullptr);
+        REQUIRE(results.has_value());
+        auto gt = knowhere::BruteForce::Search(train_ds, query_ds, json, nullptr);
+        REQUIRE(GetKNNRecall(*gt.value(), *results.value()) > 0.8f);
+    }
+
+    SECTION("Test RAFT IVF_FLAT Serialized For CPU") {
+        auto idx = knowhere::IndexFactory::Instance().Create(knowhere::IndexEnum::INDEX_RAFT_IVFFLAT);
+        knowhere::Json json = ivfflat_gen();
+        json[knowhere::indexparam::ADAPT_FOR_CPU] = true;
+        json[knowhere::meta::TOPK] = 10;
+        auto train_ds = GenDataSet(nb, dim, seed);
+        auto query_ds = GenDataSet(nq, dim, seed + 1);
+        REQUIRE(idx.Build(*train_ds, json) == knowhere::Status::success);
+        knowhere::BinarySet bs;
+        REQUIRE(idx.Serialize(bs) == knowhere::Status::success);
+
+        // the lists probed in full, the CPU index finds what the GPU one does
+        auto ivf = knowhere::IndexFactory::Instance().Create(knowhere::IndexEnum::INDEX_FAISS_IVFFLAT);
+        REQUIRE(ivf.Deserialize(bs) == knowhere::Status::success);
+        REQUIRE(ivf.Count() == nb);
+        auto results = ivf.Search(*query_ds, json, nullptr);
+        REQUIRE(results.has_value());
+        auto gpu_results = idx.Search(*query_ds, json, nullptr);
+        REQUIRE(gpu_results.has_value());
+        REQUIRE(GetKNNRecall(*gpu_results.value(), *results.value()) > 0.99f);
+    }
+
+    SECTION("Test RAFT Brute Force Exact") {
+        auto [metric, resident] = GENERATE(table<std::string, bool>({
+            std::make_tuple(knowhere::metric::L2, true),
+            std::make_tuple(knowhere::metric::IP, true),
+            std::make_tuple(knowhere::metric::COSINE, true),
+            std::make_tuple(knowhere::metric::L2, false),
+            std::make_tuple(knowhere::metric::COSINE, false),
+        }));
+        CAPTURE(metric, resident);
+        auto idx = knowhere::IndexFactory::Instance().Create(knowhere::IndexEnum::INDEX_RAFT_BRUTE_FORCE);
+        knowhere::Json json = gpu_flat_gen();
+        json[knowhere::meta::METRIC_TYPE] = metric;
+        json[knowhere::meta::TOPK] = 100;
+        json[knowhere::indexparam::DEVICE_RESIDENT] = resident;
+        // 10000 rows in tiles of 3000, the last one shorter
+        json[knowhere::indexparam::SEARCH_TILE_ROWS] = 3000;
+        auto train_ds = GenDataSet(nb, dim, seed);
+        auto query_ds = GenDataSet(100, dim, seed + 1);
+        REQUIRE(idx.Build(*train_ds, json) == knowhere::Status::success);
+
+        // no filter, a filter the search oversamples for and one it searches the rows kept by
+        for (auto filtered : {int64_t{0}, nb / 4, nb * 98 / 100}) {
+            auto bitset_data = GenerateBitsetWithRandomTbitsSet(nb, filtered);
+            knowhere::BitsetView bitset(bitset_data.data(), nb);
+            auto results = idx.Search(*query_ds, json, bitset);
+            REQUIRE(results.has_value());
+            auto gt = knowhere::BruteForce::Search(train_ds, query_ds, json, bitset);
+            REQUIRE(GetKNNRecall(*gt.value(), *results.value()) > 0.99f);
+            for (int64_t i = 0; i < 100 * 100; i += 100) {
+                REQUIRE(results.value()->GetDistance()[i] == Approx(gt.value()->GetDistance()[i]).epsilon(1e-3));
+            }
+        }
+
+        knowhere::BinarySet bs;
+        REQUIRE(idx.Serialize(bs) == knowhere::Status::success);
+        auto loaded = knowhere::IndexFactory::Instance().Create(knowhere::IndexEnum::INDEX_RAFT_BRUTE_FORCE);
+        REQUIRE(loaded.Deserialize(bs, json) == knowhere::Status::success);
+        REQUIRE(loaded.Count() == nb);
+        auto results = loaded.Search(*query_ds, json, nullptr);
+        REQUIRE(results.has_value());
+        auto gt = knowhere::BruteForce::Search(train_ds, query_ds, json, nullptr);
+        REQUIRE(GetKNNRecall(*gt.value(), *results.value()) > 0.99f);
+    }
 }
 #endif
@@ -10,6 +10,7 @@
 // or implied. See the License for the specific language governing permissions and limitations under the License.
 
 #include <future>
+#include <set>
 
 #include "catch2/catch_approx.hpp"
 #include "catch2/catch_test_macros.hpp"
@@ -135,6 +136,59 @@ TEST_CASE("Test Build Search Concurrency", "[Concurrency]") {
         }
     }
 
+    SECTION("Test Concurrent Invlists Appends With Readers") {
+        size_t nlist = 4;
+        size_t code_size = sizeof(int64_t);
+        size_t segment_size = 48;
+        int64_t writers = 4, batches = 200, batch = 37;
+
+        faiss::ConcurrentArrayInvertedLists invList(nlist, code_size, segment_size, false);
+        // every entry holds its id as code, so that a reader can tell a published entry that was not written
+        std::vector<std::future<void>> writer_tasks;
+        for (int64_t w = 0; w < writers; w++) {
+            writer_tasks.push_back(std::async(std::launch::async, [&, w] {
+                std::vector<faiss::Index::idx_t> ids(batch);
+                for (int64_t b = 0; b < batches; b++) {
+                    for (int64_t j = 0; j < batch; j++) {
+                        ids[j] = (w * batches + b) * batch + j;
+                    }
+                    invList.add_entries(b % nlist, batch, ids.data(), reinterpret_cast<const uint8_t*>(ids.data()));
+                }
+            }));
+        }
+        std::atomic<bool> done = false;
+        auto reader_task = std::async(std::launch::async, [&] {
+            size_t mismatches = 0;
+            while (!done.load()) {
+                for (size_t i = 0; i < nlist; i++) {
+                    size_t segment_num = invList.get_segment_num(i);
+                    for (size_t s = 0; s < segment_num; s++) {
+                        size_t offset = invList.get_segment_offset(i, s);
+                        size_t size = invList.get_segment_size(i, s);
+                        for (size_t j = offset; j < offset + size; j++) {
+                            mismatches += *invList.get_ids(i, j) != *(const int64_t*)invList.get_codes(i, j);
+                        }
+                    }
+                }
+            }
+            return mismatches;
+        });
+        for (auto& task : writer_tasks) {
+            task.get();
+        }
+        done = true;
+        CHECK(reader_task.get() == 0);
+
+        std::set<faiss::Index::idx_t> all_ids;
+        for (size_t i = 0; i < nlist; i++) {
+            REQUIRE(invList.list_size(i) == writers * batches * batch / nlist);
+            for (size_t j = 0; j < invList.list_size(i); j++) {
+                all_ids.insert(*invList.get_ids(i, j));
+            }
+        }
+        REQUIRE(all_ids.size() == size_t(writers * batches * batch));
+    }
+
     SECTION("Test Add & Search & RangeSearch Serialized ") {
         using std::make_tuple;
         auto [name, gen] = GENERATE_REF(table<std::string, std::function<knowhere::Json()>>({
@@ -28,11 +28,14 @@ TEST_CASE("Knowhere global config", "[init]") {
     REQUIRE(knowhere::KnowhereConfig::GetEarlyStopThreshold() == early_stop_threshold);
 
     knowhere::KnowhereConfig::SetClusteringType(knowhere::KnowhereConfig::ClusteringType::K_MEANS_PLUS_PLUS);
+    knowhere::KnowhereConfig::SetClusteringType(knowhere::KnowhereConfig::ClusteringType::K_MEANS_PARALLEL);
     knowhere::KnowhereConfig::SetClusteringType(knowhere::KnowhereConfig::ClusteringType::K_MEANS);
 
 #ifdef KNOWHERE_WITH_DISKANN
     REQUIRE_FALSE(knowhere::KnowhereConfig::SetAioContextPool(0));
     REQUIRE(knowhere::KnowhereConfig::SetAioContextPool(16));
+    REQUIRE_FALSE(knowhere::KnowhereConfig::SetIoUringReader(0, false));
+    REQUIRE_FALSE(knowhere::KnowhereConfig::SetIoUringReader(1024, false));
 #endif
 
 #ifdef KNOWHERE_WITH_RAFT
@@ -41,7 +44,7 @@ TEST_CASE("Knowhere global config", "[init]") {
 }
 
 TEST_CASE("Knowhere SIMD config", "[simd]") {
-    std::vector<std::string> v = {"AVX512", "AVX2", "SSE4_2", "GENERIC"};
+    std::vector<std::string> v = {"AMX", "AVX512", "AVX2", "SSE4_2", "GENERIC"};
     std::unordered_set<std::string> s(v.begin(), v.end());
 
     auto res = knowhere::KnowhereConfig::SetSimdType(knowhere::KnowhereConfig::SimdType::AVX512);
@@ -52,6 +55,50 @@ TEST_CASE("Knowhere SIMD config", "[simd]") {
     REQUIRE(s.find(res) != s.end());
     res = knowhere::KnowhereConfig::SetSimdType(knowhere::KnowhereConfig::SimdType::GENERIC);
     REQUIRE(s.find(res) != s.end());
+    res = knowhere::KnowhereConfig::SetSimdType(knowhere::KnowhereConfig::SimdType::AUTO_TUNED);
+    REQUIRE(s.find(res) != s.end());
+#if defined(__x86_64__)
+    REQUIRE(knowhere::KnowhereConfig::GetSimdKernelVariants().find("fvec_L2sqr=") != std::string::npos);
+#endif
+    res = knowhere::KnowhereConfig::SetSimdType(knowhere::KnowhereConfig::SimdType::AMX);
+    REQUIRE(s.find(res) != s.end());
     res = knowhere::KnowhereConfig::SetSimdType(knowhere::KnowhereConfig::SimdType::AUTO);
     REQUIRE(s.find(res) != s.end());
+    REQUIRE(res != "AMX");
+    REQUIRE(knowhere::KnowhereConfig::GetSimdKernelVariants() == res);
+}
+
+TEST_CASE("Knowhere payload allocator", "[init]") {
+    using knowhere::PayloadAllocator;
+    knowhere::KnowhereConfig::SetPayloadAllocator(PayloadAllocator::HugePages::k2M, 0);
+
+    // the reserved pools are empty on most hosts, the buffer then falls back to plain or transparent huge pages
+    size_t size = 3 * PayloadAllocator::kMinMappedSize + 1;
+    auto mapped = static_cast<char*>(PayloadAllocator::Allocate(size));
+    REQUIRE(mapped != nullptr);
+    REQUIRE(reinterpret_cast<uintptr_t>(mapped) % 64 == 0);
+    REQUIRE(PayloadAllocator::AllocatedSize(mapped, size) >= size);
+    for (size_t i = 0; i < size; i += 4096) {
+        REQUIRE(mapped[i] == 0);
+    }
+    mapped[size - 1] = 1;
+
+    auto heap = static_cast<char*>(PayloadAllocator::Allocate(100));
+    REQUIRE(heap != nullptr);
+    REQUIRE(PayloadAllocator::AllocatedSize(heap, 100) == 100);
+    PayloadAllocator::Free(heap);
+
+    size_t live = 0;
+    for (int i = PayloadAllocator::kPages; i < PayloadAllocator::kBackingNum; ++i) {
+        live += PayloadAllocator::AllocatedBytes(static_cast<PayloadAllocator::Backing>(i));
+    }
+    REQUIRE(live >= size);
+
+    auto grown = static_cast<char*>(PayloadAllocator::Reallocate(mapped, size, 2 * size));
+    REQUIRE(grown != nullptr);
+    REQUIRE(grown[size - 1] == 1);
+    PayloadAllocator::Free(grown);
+    PayloadAllocator::Free(nullptr);
+
+    knowhere::KnowhereConfig::SetPayloadAllocator(PayloadAllocator::HugePages::kTransparent);
 }
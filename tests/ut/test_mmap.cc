@@ -9,6 +9,7 @@
 // is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
 // or implied. See the License for the specific language governing permissions and limitations under the License.
 
+#include <cstring>
 #include <filesystem>
 
 #include "catch2/catch_approx.hpp"
@@ -18,9 +19,12 @@
 #include "hnswlib/hnswalg.h"
 #include "knowhere/bitsetview.h"
 #include "knowhere/comp/brute_force.h"
+#include "knowhere/comp/index_manager.h"
 #include "knowhere/comp/index_param.h"
 #include "knowhere/comp/knowhere_config.h"
 #include "knowhere/factory.h"
+#include "knowhere/index_node_pre_transform_wrapper.h"
+#include "knowhere/index_node_refine_wrapper.h"
 #include "knowhere/log.h"
 #include "utils.h"
 
@@ -77,6 +81,13 @@ TEST_CASE("Search mmap", "[float metrics]") {
 
     auto ivfsq_gen = ivfflat_gen;
 
+    auto ivf_hnsw_quantizer_gen = [&ivfflat_gen]() {
+        knowhere::Json json = ivfflat_gen();
+        json[knowhere::indexparam::QUANTIZER_TYPE] = "HNSW";
+        json[knowhere::indexparam::QUANTIZER_M] = 8;
+        return json;
+    };
+
     auto flat_gen = base_gen;
 
     auto ivfpq_gen = [&ivfflat_gen]() {
@@ -86,6 +97,26 @@ TEST_CASE("Search mmap", "[float metrics]") {
         return json;
     };
 
+    auto scann_gen = [&ivfflat_gen]() {
+        knowhere::Json json = ivfflat_gen();
+        json[knowhere::indexparam::NPROBE] = 14;
+        json[knowhere::indexparam::REORDER_K] = 500;
+        return json;
+    };
+
+    auto ivfpq_fastscan_gen = [&ivfflat_gen]() {
+        knowhere::Json json = ivfflat_gen();
+        json[knowhere::indexparam::M] = 64;
+        return json;
+    };
+
+    auto ivf_rabitq_gen = [&ivfflat_gen]() {
+        knowhere::Json json = ivfflat_gen();
+        json[knowhere::indexparam::REFINE_TYPE] = "SQ8";
+        json[knowhere::indexparam::REFINE_K] = 8.0f;
+        return json;
+    };
+
     auto hnsw_gen = [&base_gen]() {
         knowhere::Json json = base_gen();
         json[knowhere::indexparam::HNSW_M] = 128;
@@ -94,6 +125,20 @@ TEST_CASE("Search mmap", "[float metrics]") {
         return json;
     };
 
+    auto hnsw_sq8_gen = [&hnsw_gen]() {
+        knowhere::Json json = hnsw_gen();
+        json[knowhere::indexparam::SQ_TYPE] = "SQ8";
+        json[knowhere::indexparam::REFINE] = true;
+        return json;
+    };
+
+    auto hnsw_pq_gen = [&hnsw_gen]() {
+        knowhere::Json json = hnsw_gen();
+        json[knowhere::indexparam::M] = 32;
+        json[knowhere::indexparam::REFINE_TYPE] = "FP16";
+        return json;
+    };
+
     auto reload_from_file = [](knowhere::Index<knowhere::IndexNode>& index, const knowhere::DataSet& dataset,
                                const knowhere::Json& conf) {
         auto path = kDir / index.Type();
@@ -128,8 +173,12 @@ TEST_CASE("Search mmap", "[float metrics]") {
             make_tuple(knowhere::IndexEnum::INDEX_FAISS_IDMAP, flat_gen),
             make_tuple(knowhere::IndexEnum::INDEX_FAISS_IVFFLAT_CC, ivfflatcc_gen),
             make_tuple(knowhere::IndexEnum::INDEX_FAISS_IVFSQ8, ivfsq_gen),
+            make_tuple(knowhere::IndexEnum::INDEX_FAISS_IVFSQ8, ivf_hnsw_quantizer_gen),
             make_tuple(knowhere::IndexEnum::INDEX_FAISS_IVFPQ, ivfpq_gen),
+            make_tuple(knowhere::IndexEnum::INDEX_FAISS_IVFPQ_FASTSCAN, ivfpq_fastscan_gen),
+            make_tuple(knowhere::IndexEnum::INDEX_FAISS_SCANN, scann_gen),
             make_tuple(knowhere::IndexEnum::INDEX_HNSW, hnsw_gen),
+            make_tuple(knowhere::IndexEnum::INDEX_HNSW, hnsw_sq8_gen),
         }));
         auto idx = knowhere::IndexFactory::Instance().Create(name);
         auto cfg_json = gen().dump();
@@ -141,14 +190,185 @@ TEST_CASE("Search mmap", "[float metrics]") {
         REQUIRE(idx.Count() == nb);
 
         reload_from_file(idx, *train_ds, json);
+        if (name == knowhere::IndexEnum::INDEX_HNSW) {
+            // level 0 is mapped along with the vectors in it
+            auto usage = idx.GetMemoryUsage();
+            REQUIRE(usage.bytes[knowhere::MemoryUsage::kVectors][knowhere::MemoryUsage::kMmap] > 0);
+            REQUIRE(usage.bytes[knowhere::MemoryUsage::kGraph][knowhere::MemoryUsage::kMmap] > 0);
+        }
         auto results = idx.Search(*query_ds, json, nullptr);
         REQUIRE(results.has_value());
         float recall = GetKNNRecall(*gt.value(), *results.value());
-        if (name != "IVF_PQ") {
+        if (name != "IVF_PQ" && name != "IVF_PQ_FASTSCAN") {
             REQUIRE(recall > kKnnRecallThreshold);
         }
     }
 
+    SECTION("Test Search from Index File") {
+        using std::make_tuple;
+        auto [name, gen] = GENERATE_REF(table<std::string, std::function<knowhere::Json()>>({
+            make_tuple(knowhere::IndexEnum::INDEX_FAISS_IDMAP, flat_gen),
+            make_tuple(knowhere::IndexEnum::INDEX_FAISS_IVFFLAT_CC, ivfflatcc_gen),
+            make_tuple(knowhere::IndexEnum::INDEX_FAISS_IVFSQ8, ivfsq_gen),
+            make_tuple(knowhere::IndexEnum::INDEX_FAISS_IVFSQ4, ivfsq_gen),
+            make_tuple(knowhere::IndexEnum::INDEX_FAISS_IVFSQ6, ivfsq_gen),
+            make_tuple(knowhere::IndexEnum::INDEX_FAISS_IVFSQ_FP16, ivfsq_gen),
+            make_tuple(knowhere::IndexEnum::INDEX_FAISS_IVFRABITQ, ivf_rabitq_gen),
+            make_tuple(knowhere::IndexEnum::INDEX_HNSW, hnsw_gen),
+            make_tuple(knowhere::IndexEnum::INDEX_HNSW, hnsw_sq8_gen),
+            make_tuple(knowhere::IndexEnum::INDEX_HNSW_PQ, hnsw_pq_gen),
+        }));
+        auto mmap = GENERATE(true, false);
+        auto idx = knowhere::IndexFactory::Instance().Create(name);
+        knowhere::Json json = gen();
+        json["enable_mmap"] = mmap;
+        CAPTURE(name, json.dump());
+        REQUIRE(idx.Build(*train_ds, json) == knowhere::Status::success);
+        auto expected = idx.Search(*query_ds, json, nullptr);
+        REQUIRE(expected.has_value());
+
+        fs::create_directory(kDir);
+        auto path = (kDir / (idx.Type() + ".knowhere")).string();
+        REQUIRE(idx.SerializeToFile(path) == knowhere::Status::success);
+        auto loaded = knowhere::IndexFactory::Instance().Create(name);
+        REQUIRE(loaded.DeserializeFromFile(path, json) == knowhere::Status::success);
+        REQUIRE(loaded.Count() == nb);
+        auto results = loaded.Search(*query_ds, json, nullptr);
+        REQUIRE(results.has_value());
+        auto ids = results.value()->GetIds();
+        auto expected_ids = expected.value()->GetIds();
+        for (int64_t i = 0; i < nq * topk; ++i) {
+            REQUIRE(ids[i] == expected_ids[i]);
+        }
+        if (name == knowhere::IndexEnum::INDEX_FAISS_IVFSQ4) {
+            // the codes of one quantizer do not load as those of another
+            auto other = knowhere::IndexFactory::Instance().Create(knowhere::IndexEnum::INDEX_FAISS_IVFSQ8);
+            REQUIRE(other.DeserializeFromFile(path, json) == knowhere::Status::invalid_binary_set);
+        }
+
+        // written with direct io, the same file
+        auto direct_path = path + ".direct";
+        REQUIRE(idx.SerializeToFile(direct_path, true) == knowhere::Status::success);
+        REQUIRE(fs::file_size(direct_path) == fs::file_size(path));
+        auto direct = knowhere::IndexFactory::Instance().Create(name);
+        REQUIRE(direct.DeserializeFromFile(direct_path, json) == knowhere::Status::success);
+        results = direct.Search(*query_ds, json, nullptr);
+        REQUIRE(results.has_value());
+        for (int64_t i = 0; i < nq * topk; ++i) {
+            REQUIRE(results.value()->GetIds()[i] == expected_ids[i]);
+        }
+
+        // a flipped byte in the last section fails its checksum
+        {
+            std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+            file.seekg(-1, std::ios::end);
+            while (file.peek() == 0) {
+                file.seekg(-1, std::ios::cur);
+            }
+            auto pos = file.tellg();
+            char c = static_cast<char>(file.get()) ^ 0x1;
+            file.seekp(pos);
+            file.put(c);
+        }
+        auto corrupted = knowhere::IndexFactory::Instance().Create(name);
+        REQUIRE(corrupted.DeserializeFromFile(path, json) == knowhere::Status::invalid_index_file);
+    }
+
+    SECTION("Test Search from Shared Memory") {
+        using std::make_tuple;
+        auto [name, gen] = GENERATE_REF(table<std::string, std::function<knowhere::Json()>>({
+            make_tuple(knowhere::IndexEnum::INDEX_FAISS_IDMAP, flat_gen),
+            make_tuple(knowhere::IndexEnum::INDEX_FAISS_IVFFLAT_CC, ivfflatcc_gen),
+            make_tuple(knowhere::IndexEnum::INDEX_HNSW, hnsw_gen),
+        }));
+        auto idx = knowhere::IndexFactory::Instance().Create(name);
+        knowhere::Json json = gen();
+        CAPTURE(name, json.dump());
+        REQUIRE(idx.Build(*train_ds, json) == knowhere::Status::success);
+        auto expected = idx.Search(*query_ds, json, nullptr);
+        REQUIRE(expected.has_value());
+
+        auto shm_name = "knowhere_test_" + idx.Type();
+        REQUIRE(idx.Publish(shm_name) == knowhere::Status::success);
+        auto attached = knowhere::IndexFactory::Instance().Create(name);
+        REQUIRE(attached.Attach(shm_name, json) == knowhere::Status::success);
+        // the attached index outlives the object
+        REQUIRE(knowhere::Index<knowhere::IndexNode>::Unpublish(shm_name) == knowhere::Status::success);
+        REQUIRE(attached.Count() == nb);
+        if (name == knowhere::IndexEnum::INDEX_HNSW) {
+            auto usage = attached.GetMemoryUsage();
+            REQUIRE(usage.bytes[knowhere::MemoryUsage::kGraph][knowhere::MemoryUsage::kMmap] > 0);
+        }
+        auto results = attached.Search(*query_ds, json, nullptr);
+        REQUIRE(results.has_value());
+        for (int64_t i = 0; i < nq * topk; ++i) {
+            REQUIRE(results.value()->GetIds()[i] == expected.value()->GetIds()[i]);
+        }
+
+        auto missing = knowhere::IndexFactory::Instance().Create(name);
+        REQUIRE(missing.Attach(shm_name, json) != knowhere::Status::success);
+        REQUIRE(knowhere::Index<knowhere::IndexNode>::Unpublish("a/b") == knowhere::Status::invalid_args);
+    }
+
+    SECTION("Test Warmup") {
+        using std::make_tuple;
+        auto [name, gen] = GENERATE_REF(table<std::string, std::function<knowhere::Json()>>({
+            make_tuple(knowhere::IndexEnum::INDEX_FAISS_IDMAP, flat_gen),
+            make_tuple(knowhere::IndexEnum::INDEX_FAISS_IVFFLAT_CC, ivfflatcc_gen),
+            make_tuple(knowhere::IndexEnum::INDEX_HNSW, hnsw_gen),
+            make_tuple(knowhere::IndexEnum::INDEX_HNSW, hnsw_sq8_gen),
+        }));
+        auto idx = knowhere::IndexFactory::Instance().Create(name);
+        knowhere::Json json = gen();
+        CAPTURE(name, json.dump());
+        REQUIRE(idx.Build(*train_ds, json) == knowhere::Status::success);
+        auto expected = idx.Search(*query_ds, json, nullptr);
+        REQUIRE(expected.has_value());
+
+        fs::create_directory(kDir);
+        auto path = (kDir / (idx.Type() + "_warmup.knowhere")).string();
+        REQUIRE(idx.SerializeToFile(path) == knowhere::Status::success);
+        auto loaded = knowhere::IndexFactory::Instance().Create(name);
+        REQUIRE(loaded.DeserializeFromFile(path, json) == knowhere::Status::success);
+
+        auto usage = loaded.GetMemoryUsage();
+        // told from the threads of the search pool, one at a time
+        int64_t done = 0, total = -1, calls = 0;
+        bool growing = true;
+        auto progress = [&](int64_t d, int64_t t) {
+            growing = growing && d > done;
+            done = d;
+            total = t;
+            ++calls;
+        };
+        // a budget of a page warms up a page at most
+        REQUIRE(loaded.Warmup(4096, nullptr, json, progress) == knowhere::Status::success);
+        // an index held in memory has nothing to fault in
+        bool mmap = usage.In(knowhere::MemoryUsage::kMmap) > 0;
+        REQUIRE((calls > 0) == mmap);
+        if (mmap) {
+            REQUIRE(growing);
+            REQUIRE(done == total);
+            REQUIRE(done <= 4096);
+        }
+
+        done = 0;
+        total = -1;
+        calls = 0;
+        REQUIRE(loaded.Warmup(0, query_ds.get(), json, progress) == knowhere::Status::success);
+        if (mmap) {
+            REQUIRE(growing);
+            REQUIRE(done == total);
+            // the regions cover the mapped bytes of the index
+            REQUIRE(done >= usage.In(knowhere::MemoryUsage::kMmap) / 2);
+        }
+        auto results = loaded.Search(*query_ds, json, nullptr);
+        REQUIRE(results.has_value());
+        for (int64_t i = 0; i < nq * topk; ++i) {
+            REQUIRE(results.value()->GetIds()[i] == expected.value()->GetIds()[i]);
+        }
+    }
+
     SECTION("Test Range Search") {
         using std::make_tuple;
         auto [name, gen] = GENERATE_REF(table<std::string, std::function<knowhere::Json()>>({
@@ -156,7 +376,9 @@ TEST_CASE("Search mmap", "[float metrics]") {
             make_tuple(knowhere::IndexEnum::INDEX_FAISS_IVFFLAT_CC, ivfflatcc_gen),
             make_tuple(knowhere::IndexEnum::INDEX_FAISS_IVFSQ8, ivfsq_gen),
             make_tuple(knowhere::IndexEnum::INDEX_FAISS_IVFPQ, ivfpq_gen),
+            make_tuple(knowhere::IndexEnum::INDEX_FAISS_IVFPQ_FASTSCAN, ivfpq_fastscan_gen),
             make_tuple(knowhere::IndexEnum::INDEX_HNSW, hnsw_gen),
+            make_tuple(knowhere::IndexEnum::INDEX_HNSW, hnsw_sq8_gen),
         }));
         auto idx = knowhere::IndexFactory::Instance().Create(name);
         auto cfg_json = gen().dump();
@@ -170,7 +392,7 @@ TEST_CASE("Search mmap", "[float metrics]") {
         REQUIRE(results.has_value());
         auto ids = results.value()->GetIds();
         auto lims = results.value()->GetLims();
-        if (name != "IVF_PQ") {
+        if (name != "IVF_PQ" && name != "IVF_PQ_FASTSCAN") {
             for (int i = 0; i < nq; ++i) {
                 CHECK(ids[lims[i]] == i);
             }
@@ -316,6 +538,36 @@ TEST_CASE("Search binary mmap", "[float metrics]") {
             CHECK(ids[lims[i]] == i);
         }
     }
+
+    SECTION("Test HNSW with an element size not a multiple of 4") {
+        // 3 bytes vectors after the level 0 links and an odd count leave the upper link lists misaligned in the
+        // file, they are copied rather than mapped
+        const int64_t odd_nb = 999, odd_dim = 24;
+        const auto odd_train_ds = GenBinDataSet(odd_nb, odd_dim);
+        const auto odd_query_ds = GenBinDataSet(nq, odd_dim);
+        knowhere::Json json = hnsw_gen();
+        json[knowhere::meta::DIM] = odd_dim;
+        json[knowhere::indexparam::HNSW_M] = 8;
+        json["enable_mmap"] = true;
+        auto idx = knowhere::IndexFactory::Instance().Create(knowhere::IndexEnum::INDEX_HNSW);
+        REQUIRE(idx.Build(*odd_train_ds, json) == knowhere::Status::success);
+        auto expected = idx.Search(*odd_query_ds, json, nullptr);
+        REQUIRE(expected.has_value());
+
+        fs::create_directory(kDir);
+        auto path = (kDir / "hnsw_odd_element_size.knowhere").string();
+        REQUIRE(idx.SerializeToFile(path) == knowhere::Status::success);
+        auto loaded = knowhere::IndexFactory::Instance().Create(knowhere::IndexEnum::INDEX_HNSW);
+        REQUIRE(loaded.DeserializeFromFile(path, json) == knowhere::Status::success);
+        auto usage = loaded.GetMemoryUsage();
+        REQUIRE(usage.bytes[knowhere::MemoryUsage::kGraph][knowhere::MemoryUsage::kHeap] >
+                static_cast<int64_t>(odd_nb * sizeof(void*)));
+        auto results = loaded.Search(*odd_query_ds, json, nullptr);
+        REQUIRE(results.has_value());
+        for (int64_t i = 0; i < nq * topk; ++i) {
+            REQUIRE(results.value()->GetIds()[i] == expected.value()->GetIds()[i]);
+        }
+    }
 }
 
 TEST_CASE("Search binary mmap", "[bool metrics]") {
@@ -447,3 +699,191 @@ TEST_CASE("Search binary mmap", "[bool metrics]") {
     }
 #endif
 }
+
+TEST_CASE("Index Manager", "[float metrics]") {
+    const int64_t nb = 1000, nq = 10;
+    const int64_t dim = 128;
+    const int64_t topk = 5;
+    const int segments = 3;
+
+    knowhere::Json json;
+    json[knowhere::meta::DIM] = dim;
+    json[knowhere::meta::METRIC_TYPE] = knowhere::metric::L2;
+    json[knowhere::meta::TOPK] = topk;
+    const auto query_ds = GenDataSet(nq, dim);
+
+    fs::create_directory(kDir);
+    std::vector<std::string> names;
+    std::vector<knowhere::DataSetPtr> expected;
+    int64_t segment_bytes = 0;
+    for (int s = 0; s < segments; ++s) {
+        auto idx = knowhere::IndexFactory::Instance().Create(knowhere::IndexEnum::INDEX_FAISS_IDMAP);
+        REQUIRE(idx.Build(*GenDataSet(nb, dim, s), json) == knowhere::Status::success);
+        auto res = idx.Search(*query_ds, json, nullptr);
+        REQUIRE(res.has_value());
+        expected.push_back(res.value());
+        names.push_back("segment_" + std::to_string(s));
+        REQUIRE(idx.SerializeToFile((kDir / (names.back() + ".knowhere")).string()) == knowhere::Status::success);
+        segment_bytes = idx.GetMemoryUsage().In(knowhere::MemoryUsage::kHeap);
+    }
+    auto check = [&](knowhere::IndexManager& manager, int s) {
+        auto idx = manager.Acquire(names[s]);
+        REQUIRE(idx.has_value());
+        auto res = idx.value().Search(*query_ds, json, nullptr);
+        REQUIRE(res.has_value());
+        for (int64_t i = 0; i < nq * topk; ++i) {
+            REQUIRE(res.value()->GetIds()[i] == expected[s]->GetIds()[i]);
+        }
+    };
+
+    SECTION("Demote and Evict") {
+        // room for two segments loaded whole
+        knowhere::IndexManager manager(2 * segment_bytes + segment_bytes / 2);
+        for (int s = 0; s < segments; ++s) {
+            REQUIRE(manager.Register(names[s], knowhere::IndexEnum::INDEX_FAISS_IDMAP,
+                                     (kDir / (names[s] + ".knowhere")).string(), json) == knowhere::Status::success);
+            REQUIRE(manager.GetResidency(names[s]) == knowhere::IndexManager::kEvicted);
+        }
+        REQUIRE(manager.Register(names[0], knowhere::IndexEnum::INDEX_FAISS_IDMAP, "", json) ==
+                knowhere::Status::invalid_args);
+        REQUIRE(!manager.Acquire("unknown").has_value());
+
+        check(manager, 0);
+        check(manager, 1);
+        check(manager, 0);
+        REQUIRE(manager.GetStats().heap_bytes <= manager.GetStats().budget);
+        // the least recently acquired one makes room for the third, mapped rather than dropped
+        check(manager, 2);
+        auto stats = manager.GetStats();
+        REQUIRE(stats.heap_bytes <= stats.budget);
+        REQUIRE(manager.GetResidency(names[0]) == knowhere::IndexManager::kLoaded);
+        REQUIRE(manager.GetResidency(names[1]) != knowhere::IndexManager::kLoaded);
+        REQUIRE(manager.GetResidency(names[2]) == knowhere::IndexManager::kLoaded);
+        REQUIRE(stats.loads == 3);
+        REQUIRE(stats.demotions + stats.evictions >= 1);
+        // a mapped or evicted segment still answers as it did loaded
+        check(manager, 1);
+        REQUIRE(manager.GetStats().heap_bytes <= manager.GetStats().budget);
+
+        manager.SetBudget(0);
+        stats = manager.GetStats();
+        REQUIRE(stats.heap_bytes == 0);
+        REQUIRE(stats.loaded == 0);
+        REQUIRE(manager.Unregister(names[0]) == knowhere::Status::success);
+        REQUIRE(manager.Unregister(names[0]) == knowhere::Status::invalid_args);
+        REQUIRE(manager.GetStats().mapped + manager.GetStats().evicted == segments - 1);
+    }
+
+    SECTION("Prefetch") {
+        knowhere::IndexManager manager(segment_bytes + segment_bytes / 2);
+        for (int s = 0; s < segments; ++s) {
+            REQUIRE(manager.Register(names[s], knowhere::IndexEnum::INDEX_FAISS_IDMAP,
+                                     (kDir / (names[s] + ".knowhere")).string(), json) == knowhere::Status::success);
+        }
+        check(manager, 0);
+        // there is no room for a second segment, a prefetch does not push out the first
+        auto futs = manager.Prefetch({names[1], names[2], "unknown"});
+        REQUIRE(futs.size() == 2);
+        for (auto& fut : futs) {
+            fut.wait();
+        }
+        REQUIRE(manager.GetResidency(names[0]) == knowhere::IndexManager::kLoaded);
+        REQUIRE(manager.GetResidency(names[1]) == knowhere::IndexManager::kEvicted);
+        REQUIRE(manager.GetStats().loads == 1);
+
+        manager.SetBudget(segments * segment_bytes * 2);
+        futs = manager.Prefetch({names[0], names[1], names[2]});
+        REQUIRE(futs.size() == 2);
+        for (auto& fut : futs) {
+            fut.wait();
+        }
+        auto stats = manager.GetStats();
+        REQUIRE(stats.loaded == segments);
+        REQUIRE(stats.loads == segments);
+        for (int s = 0; s < segments; ++s) {
+            check(manager, s);
+        }
+        REQUIRE(manager.GetStats().loads == segments);
+    }
+
+    SECTION("Register Built") {
+        auto idx = knowhere::IndexFactory::Instance().Create(knowhere::IndexEnum::INDEX_FAISS_IDMAP);
+        REQUIRE(idx.Build(*GenDataSet(nb, dim, 0), json) == knowhere::Status::success);
+        auto path = (kDir / "built.knowhere").string();
+        fs::remove(path);
+        knowhere::IndexManager manager(2 * segment_bytes);
+        REQUIRE(manager.Register(names[0], idx, path, json) == knowhere::Status::success);
+        REQUIRE(manager.GetResidency(names[0]) == knowhere::IndexManager::kLoaded);
+        // written to its file once demoted, and loaded back from it
+        manager.SetBudget(0);
+        REQUIRE(fs::exists(path));
+        REQUIRE(manager.GetResidency(names[0]) != knowhere::IndexManager::kLoaded);
+        manager.SetBudget(2 * segment_bytes);
+        check(manager, 0);
+    }
+}
+
+namespace {
+// a node of one section that counts how it was serialized, behind the wrappers the registered indexes use
+class StreamingNode : public StubIndexNode {
+ public:
+    StreamingNode(int* serialized, int* streamed) : serialized_(serialized), streamed_(streamed) {
+    }
+
+    knowhere::Status
+    Serialize(knowhere::BinarySet& binset) const override {
+        ++*serialized_;
+        std::shared_ptr<uint8_t[]> data(new uint8_t[sizeof(kPayload)]);
+        std::memcpy(data.get(), kPayload, sizeof(kPayload));
+        binset.Append(Type(), data, sizeof(kPayload));
+        return knowhere::Status::success;
+    }
+
+    knowhere::Status
+    SerializeToFile(knowhere::SectionWriter& writer) const override {
+        ++*streamed_;
+        auto status = writer.Begin(Type());
+        if (status == knowhere::Status::success) {
+            status = writer.Write(kPayload, sizeof(kPayload));
+        }
+        return status == knowhere::Status::success ? writer.End() : status;
+    }
+
+    int64_t
+    Size() const override {
+        return sizeof(kPayload);
+    }
+
+    std::string
+    Type() const override {
+        return "STREAMING";
+    }
+
+ private:
+    static constexpr uint8_t kPayload[] = {1, 2, 3, 4};
+    int* serialized_;
+    int* streamed_;
+};
+}  // namespace
+
+TEST_CASE("Test SerializeToFile through the index node wrappers", "[mmap]") {
+    int serialized = 0, streamed = 0;
+    // the wrappers of IVF_PQ, the outermost ones of every registered index
+    knowhere::Index<knowhere::IndexNode> idx = knowhere::Index<knowhere::IndexNodeRefineWrapper>::Create(
+        std::make_unique<knowhere::IndexNodePreTransformWrapper>(
+            std::make_unique<StreamingNode>(&serialized, &streamed)));
+
+    fs::create_directory(kDir);
+    auto path = (kDir / "streaming.knowhere").string();
+    REQUIRE(idx.SerializeToFile(path) == knowhere::Status::success);
+    // streamed through the wrappers rather than written from the BinarySet of the fallback
+    REQUIRE(streamed == 1);
+    REQUIRE(serialized == 0);
+    REQUIRE(fs::file_size(path) > 0);
+
+    // the fallback writes the same sections
+    knowhere::BinarySet binset;
+    REQUIRE(idx.Serialize(binset) == knowhere::Status::success);
+    REQUIRE(serialized == 1);
+    REQUIRE(binset.Contains("STREAMING"));
+}
@@ -21,4 +21,29 @@ TEST_CASE("Test prometheus client", "[prometheus client]") {
         std::cout << str << std::endl;
         CHECK(str.length() >= 0);
     }
+
+    SECTION("check labelled metrics") {
+        knowhere::GetOpLatencyHistogram("TEST_INDEX", "search").Observe(1.0);
+        knowhere::QueryStats stats;
+        stats.hops = 3;
+        stats.distance_computations = 42;
+        knowhere::GetQueryMetrics("TEST_INDEX").Observe(stats);
+        auto str = knowhere::prometheusClient->GetMetrics();
+        CHECK(str.find("knowhere_op_latency") != std::string::npos);
+        CHECK(str.find("knowhere_query_hops") != std::string::npos);
+        CHECK(str.find("TEST_INDEX") != std::string::npos);
+    }
+
+    SECTION("check gpu metrics") {
+        const auto& metrics = knowhere::GetGpuMetrics("TEST_GPU_INDEX");
+        metrics.kernel_latency.Observe(10.0);
+        metrics.h2d_bytes.Increment(4096);
+        knowhere::GetGpuPoolBytesGauge(0, "rmm", "used").Set(1024);
+        CHECK(&knowhere::GetGpuMetrics("TEST_GPU_INDEX") == &metrics);
+        auto str = knowhere::prometheusClient->GetMetrics();
+        CHECK(str.find("knowhere_gpu_stage_latency") != std::string::npos);
+        CHECK(str.find("knowhere_gpu_transfer_bytes") != std::string::npos);
+        CHECK(str.find("knowhere_gpu_pool_bytes") != std::string::npos);
+        CHECK(str.find("TEST_GPU_INDEX") != std::string::npos);
+    }
 }
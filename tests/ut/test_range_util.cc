@@ -10,7 +10,10 @@
 // or implied. See the License for the specific language governing permissions and limitations under the License.
 
 #include "catch2/catch_test_macros.hpp"
+#include "catch2/generators/catch_generators.hpp"
 #include "common/range_util.h"
+#include "knowhere/comp/profile_zone.h"
+#include "knowhere/comp/thread_pool.h"
 #include "knowhere/factory.h"
 #include "utils.h"
 
@@ -186,3 +189,127 @@ TEST_CASE("Test GetRangeSearchResult for Faiss", "[range search]") {
         }
     }
 }
+
+TEST_CASE("Test RangeSearchResultBuilder", "[range search]") {
+    const int64_t nq = 100;
+    std::vector<std::vector<int64_t>> labels;
+    std::vector<std::vector<float>> distances;
+    GenRangeSearchResult(labels, distances, nq, 0, 10000, 0.0, 100.0);
+    const float radius = 50.0, range_filter = 10.0;
+
+    knowhere::RangeSearchResultBuilder builder(nq);
+    // the odd queries from the pool, the even ones from this thread, in reverse
+    knowhere::ThreadPool::GetGlobalSearchThreadPool()->parallel_for(0, nq / 2, 1, [&](int64_t i) {
+        auto q = 2 * i + 1;
+        builder.Query(q).Append(distances[q].data(), labels[q].data(), labels[q].size(), true, false, radius,
+                                range_filter);
+    });
+    for (int64_t q = nq - 2; q >= 0; q -= 2) {
+        builder.Query(q).Append(distances[q].data(), labels[q].data(), labels[q].size(), true, false, radius,
+                                range_filter);
+    }
+
+    float* result_distances;
+    int64_t* result_labels;
+    size_t* lims;
+    knowhere::BaseConfig cfg;
+    REQUIRE(builder.Build(cfg, result_distances, result_labels, lims));
+    auto result = knowhere::GenResultDataSet(nq, result_labels, result_distances, lims);
+    REQUIRE(lims[nq] == CountValidRangeSearchResult(distances, radius, range_filter, false));
+    for (int64_t q = 0; q < nq; q++) {
+        size_t j = lims[q];
+        for (size_t k = 0; k < labels[q].size(); k++) {
+            if (knowhere::distance_in_range(distances[q][k], radius, range_filter, false)) {
+                REQUIRE(result_labels[j] == labels[q][k]);
+                REQUIRE(result_distances[j] == distances[q][k]);
+                j++;
+            }
+        }
+        REQUIRE(j == lims[q + 1]);
+    }
+}
+
+TEST_CASE("Test RangeSearchResultBuilder with max_results", "[range search]") {
+    const int64_t nq = 100;
+    std::vector<std::vector<int64_t>> labels;
+    std::vector<std::vector<float>> distances;
+    GenRangeSearchResult(labels, distances, nq, 0, 10000, 0.0, 100.0);
+    const float radius = 50.0, range_filter = 10.0;
+    const bool is_ip = GENERATE(false, true);
+    const int64_t max_results = GENERATE(1, 7, 1000);
+
+    knowhere::RangeSearchResultBuilder builder(nq, max_results, is_ip);
+    knowhere::ThreadPool::GetGlobalSearchThreadPool()->parallel_for(0, nq, 1, [&](int64_t q) {
+        auto writer = builder.Query(q);
+        writer.Append(distances[q].data(), labels[q].data(), labels[q].size(), true, is_ip,
+                      is_ip ? range_filter : radius, is_ip ? radius : range_filter);
+        if (writer.Full()) {
+            // nothing at the bound gets in
+            writer.Add(writer.Bound(), -1);
+        }
+    });
+
+    float* result_distances;
+    int64_t* result_labels;
+    size_t* lims;
+    knowhere::BaseConfig cfg;
+    REQUIRE(builder.Build(cfg, result_distances, result_labels, lims));
+    auto result = knowhere::GenResultDataSet(nq, result_labels, result_distances, lims);
+    for (int64_t q = 0; q < nq; q++) {
+        // the closest of the hits of the query, sorted closest first
+        std::vector<float> expected;
+        for (auto d : distances[q]) {
+            if (knowhere::distance_in_range(d, is_ip ? range_filter : radius, is_ip ? radius : range_filter, is_ip)) {
+                expected.push_back(d);
+            }
+        }
+        std::sort(expected.begin(), expected.end());
+        if (is_ip) {
+            std::reverse(expected.begin(), expected.end());
+        }
+        expected.resize(std::min<size_t>(expected.size(), max_results));
+        REQUIRE(lims[q + 1] - lims[q] == expected.size());
+        for (size_t j = 0; j < expected.size(); j++) {
+            REQUIRE(result_distances[lims[q] + j] == expected[j]);
+            REQUIRE(result_labels[lims[q] + j] != -1);
+        }
+    }
+}
+
+#ifdef KNOWHERE_WITH_PROFILE_ZONES
+TEST_CASE("Test profile zones of GetRangeSearchResult", "[range search]") {
+    const int64_t nq = 10;
+    faiss::RangeSearchResult res(nq);
+    GenRangeSearchResult(res, nq, 0, 10000, 0.0, 100.0);
+
+    auto calls = [] {
+        for (const auto& zone : knowhere::ProfileZones::Snapshot()) {
+            if (zone.name == "result.range_build") {
+                return zone.calls;
+            }
+        }
+        return uint64_t(0);
+    };
+    auto get_range_search_result = [&] {
+        float* distances;
+        int64_t* labels;
+        size_t* lims;
+        knowhere::GetRangeSearchResult(res, false, nq, 50.0, 0.0, distances, labels, lims, nullptr);
+        knowhere::GenResultDataSet(nq, labels, distances, lims);
+    };
+
+    knowhere::ProfileZones::SetMode(knowhere::ProfileMode::kOff);
+    knowhere::ProfileZones::Reset();
+    get_range_search_result();
+    REQUIRE(calls() == 0);
+
+    knowhere::ProfileZones::SetMode(knowhere::ProfileMode::kTiming);
+    get_range_search_result();
+    get_range_search_result();
+    REQUIRE(calls() == 2);
+
+    knowhere::ProfileZones::SetMode(knowhere::ProfileMode::kOff);
+    knowhere::ProfileZones::Reset();
+    REQUIRE(calls() == 0);
+}
+#endif
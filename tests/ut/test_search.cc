@@ -9,21 +9,41 @@
 // is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
 // or implied. See the License for the specific language governing permissions and limitations under the License.
 
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <numeric>
+#include <set>
+#include <thread>
+
 #include "catch2/catch_approx.hpp"
 #include "catch2/catch_test_macros.hpp"
 #include "catch2/generators/catch_generators.hpp"
 #include "faiss/utils/binary_distances.h"
 #include "hnswlib/hnswalg.h"
 #include "knowhere/bitsetview.h"
+#include "knowhere/comp/auto_tune.h"
+#include "knowhere/comp/binary_codec.h"
 #include "knowhere/comp/brute_force.h"
 #include "knowhere/comp/index_param.h"
 #include "knowhere/comp/knowhere_config.h"
+#include "knowhere/comp/multi_index_search.h"
+#include "knowhere/comp/query_planner.h"
+#include "knowhere/comp/query_trace.h"
+#include "knowhere/comp/raw_vector_store.h"
+#include "knowhere/comp/recall_monitor.h"
+#include "knowhere/comp/result_cache.h"
+#include "knowhere/comp/thread_pool.h"
 #include "knowhere/factory.h"
 #include "knowhere/log.h"
+#include "simd/hook.h"
 #include "utils.h"
 
 namespace {
 constexpr float kKnnRecallThreshold = 0.6f;
+// 16 levels per dimension lose about a tenth of the recall of IVF_FLAT on the test data
+constexpr float kSq4KnnRecallThreshold = 0.5f;
 constexpr float kBruteForceRecallThreshold = 0.99f;
 }  // namespace
 
@@ -59,10 +79,48 @@ TEST_CASE("Test Mem Index With Float Vector", "[float metrics]") {
         return json;
     };
 
+    auto ivfflat_blocked_gen = [&ivfflat_gen]() {
+        knowhere::Json json = ivfflat_gen();
+        json[knowhere::indexparam::COLUMN_BLOCKED] = true;
+        return json;
+    };
+
     auto ivfsq_gen = ivfflat_gen;
 
+    auto ivf_hnsw_quantizer_gen = [&ivfflat_gen]() {
+        knowhere::Json json = ivfflat_gen();
+        json[knowhere::indexparam::QUANTIZER_TYPE] = "HNSW";
+        json[knowhere::indexparam::QUANTIZER_M] = 8;
+        return json;
+    };
+
+    auto ivf_pruning_gen = [&ivfflat_gen]() {
+        knowhere::Json json = ivfflat_gen();
+        json[knowhere::indexparam::NPROBE] = 16;
+        json[knowhere::indexparam::LIST_PRUNING] = true;
+        return json;
+    };
+
+    auto ivf_batch_gen = [&ivfflat_gen]() {
+        knowhere::Json json = ivfflat_gen();
+        json[knowhere::indexparam::BATCH_SEARCH_NQ] = 4;
+        return json;
+    };
+
     auto flat_gen = base_gen;
 
+    auto flat_fp16_gen = [&base_gen]() {
+        knowhere::Json json = base_gen();
+        json[knowhere::indexparam::STORAGE_TYPE] = "FP16";
+        return json;
+    };
+
+    auto flat_bf16_gen = [&base_gen]() {
+        knowhere::Json json = base_gen();
+        json[knowhere::indexparam::STORAGE_TYPE] = "BF16";
+        return json;
+    };
+
     auto ivfpq_gen = [&ivfflat_gen]() {
         knowhere::Json json = ivfflat_gen();
         json[knowhere::indexparam::M] = 4;
@@ -77,6 +135,44 @@ TEST_CASE("Test Mem Index With Float Vector", "[float metrics]") {
         return json;
     };
 
+    auto scann_sq8_gen = [&scann_gen]() {
+        knowhere::Json json = scann_gen();
+        json[knowhere::indexparam::REFINE_TYPE] = "SQ8";
+        return json;
+    };
+
+    auto scann_fp16_spread_gen = [&scann_gen]() {
+        knowhere::Json json = scann_gen();
+        json[knowhere::indexparam::REFINE_TYPE] = "FP16";
+        json[knowhere::indexparam::REORDER_SPREAD] = 4.0f;
+        return json;
+    };
+
+    auto scann_anisotropic_gen = [&scann_gen]() {
+        knowhere::Json json = scann_gen();
+        json[knowhere::indexparam::ANISOTROPIC_THRESHOLD] = 0.2f;
+        return json;
+    };
+
+    auto ivfpq_fastscan_gen = [&ivfflat_gen]() {
+        knowhere::Json json = ivfflat_gen();
+        json[knowhere::indexparam::M] = 64;
+        return json;
+    };
+
+    auto ivf_rabitq_gen = [&ivfflat_gen]() {
+        knowhere::Json json = ivfflat_gen();
+        json[knowhere::indexparam::REFINE_TYPE] = "FLAT";
+        json[knowhere::indexparam::REFINE_K] = 8.0f;
+        return json;
+    };
+
+    auto ivf_rabitq_sq8_gen = [&ivf_rabitq_gen]() {
+        knowhere::Json json = ivf_rabitq_gen();
+        json[knowhere::indexparam::REFINE_TYPE] = "SQ8";
+        return json;
+    };
+
     auto hnsw_gen = [&base_gen]() {
         knowhere::Json json = base_gen();
         json[knowhere::indexparam::HNSW_M] = 128;
@@ -85,6 +181,74 @@ TEST_CASE("Test Mem Index With Float Vector", "[float metrics]") {
         return json;
     };
 
+    auto hnsw_sq8_gen = [&hnsw_gen]() {
+        knowhere::Json json = hnsw_gen();
+        json[knowhere::indexparam::SQ_TYPE] = "SQ8";
+        json[knowhere::indexparam::REFINE] = true;
+        return json;
+    };
+
+    auto hnsw_fp16_gen = [&hnsw_gen]() {
+        knowhere::Json json = hnsw_gen();
+        json[knowhere::indexparam::SQ_TYPE] = "FP16";
+        return json;
+    };
+
+    auto hnsw_sq_gen = [&hnsw_gen]() {
+        knowhere::Json json = hnsw_gen();
+        json[knowhere::indexparam::REFINE_TYPE] = "FP16";
+        json[knowhere::indexparam::REFINE_K] = 2.0f;
+        return json;
+    };
+
+    auto hnsw_pq_gen = [&hnsw_gen]() {
+        knowhere::Json json = hnsw_gen();
+        json[knowhere::indexparam::M] = 32;
+        json[knowhere::indexparam::NBITS] = 8;
+        json[knowhere::indexparam::REFINE_TYPE] = "FP32";
+        return json;
+    };
+
+    auto hnsw_prq_gen = [&hnsw_gen]() {
+        knowhere::Json json = hnsw_gen();
+        json[knowhere::indexparam::M] = 4;
+        json[knowhere::indexparam::NBITS] = 8;
+        json[knowhere::indexparam::REFINE_TYPE] = "FP32";
+        json[knowhere::indexparam::REFINE_K] = 4.0f;
+        return json;
+    };
+
+    auto hnsw_aligned_gen = [&hnsw_gen]() {
+        knowhere::Json json = hnsw_gen();
+        json[knowhere::indexparam::ALIGN_LEVEL0] = true;
+        json[knowhere::indexparam::PREFETCH_DEPTH] = 8;
+        return json;
+    };
+
+    auto hnsw_early_stop_gen = [&hnsw_gen]() {
+        knowhere::Json json = hnsw_gen();
+        json[knowhere::indexparam::EARLY_STOP_PATIENCE] = 16;
+        return json;
+    };
+
+    auto hnsw_range_init_gen = [&hnsw_gen]() {
+        knowhere::Json json = hnsw_gen();
+        json[knowhere::indexparam::RANGE_INIT_EF] = 8;
+        return json;
+    };
+
+    auto hnsw_hubs_gen = [&hnsw_gen]() {
+        knowhere::Json json = hnsw_gen();
+        json[knowhere::indexparam::ENTRY_HUBS] = 32;
+        return json;
+    };
+
+    auto hnsw_filter_gen = [&hnsw_gen]() {
+        knowhere::Json json = hnsw_gen();
+        json[knowhere::indexparam::FILTER_THRESHOLD] = 0.3f;
+        return json;
+    };
+
     auto load_raw_data = [](knowhere::Index<knowhere::IndexNode>& index, const knowhere::DataSet& dataset,
                             const knowhere::Json& conf) {
         auto rows = dataset.GetRows();
@@ -112,12 +276,39 @@ TEST_CASE("Test Mem Index With Float Vector", "[float metrics]") {
         using std::make_tuple;
         auto [name, gen] = GENERATE_REF(table<std::string, std::function<knowhere::Json()>>({
             make_tuple(knowhere::IndexEnum::INDEX_FAISS_IDMAP, flat_gen),
+            make_tuple(knowhere::IndexEnum::INDEX_FAISS_IDMAP, flat_fp16_gen),
+            make_tuple(knowhere::IndexEnum::INDEX_FAISS_IDMAP, flat_bf16_gen),
             make_tuple(knowhere::IndexEnum::INDEX_FAISS_IVFFLAT, ivfflat_gen),
+            make_tuple(knowhere::IndexEnum::INDEX_FAISS_IVFFLAT, ivfflat_blocked_gen),
             make_tuple(knowhere::IndexEnum::INDEX_FAISS_IVFFLAT_CC, ivfflatcc_gen),
             make_tuple(knowhere::IndexEnum::INDEX_FAISS_IVFSQ8, ivfsq_gen),
+            make_tuple(knowhere::IndexEnum::INDEX_FAISS_IVFSQ4, ivfsq_gen),
+            make_tuple(knowhere::IndexEnum::INDEX_FAISS_IVFSQ6, ivfsq_gen),
+            make_tuple(knowhere::IndexEnum::INDEX_FAISS_IVFSQ_FP16, ivfsq_gen),
+            make_tuple(knowhere::IndexEnum::INDEX_FAISS_IVFFLAT, ivf_hnsw_quantizer_gen),
+            make_tuple(knowhere::IndexEnum::INDEX_FAISS_IVFSQ8, ivf_hnsw_quantizer_gen),
+            make_tuple(knowhere::IndexEnum::INDEX_FAISS_IVFFLAT, ivf_pruning_gen),
+            make_tuple(knowhere::IndexEnum::INDEX_FAISS_IVFSQ8, ivf_pruning_gen),
             make_tuple(knowhere::IndexEnum::INDEX_FAISS_IVFPQ, ivfpq_gen),
+            make_tuple(knowhere::IndexEnum::INDEX_FAISS_IVFPQ_FASTSCAN, ivfpq_fastscan_gen),
+            make_tuple(knowhere::IndexEnum::INDEX_FAISS_IVFFLAT, ivf_batch_gen),
+            make_tuple(knowhere::IndexEnum::INDEX_FAISS_IVFFLAT_CC, ivf_batch_gen),
+            make_tuple(knowhere::IndexEnum::INDEX_FAISS_IVFSQ8, ivf_batch_gen),
             make_tuple(knowhere::IndexEnum::INDEX_FAISS_SCANN, scann_gen),
+            make_tuple(knowhere::IndexEnum::INDEX_FAISS_SCANN, scann_sq8_gen),
+            make_tuple(knowhere::IndexEnum::INDEX_FAISS_SCANN, scann_fp16_spread_gen),
+            make_tuple(knowhere::IndexEnum::INDEX_FAISS_SCANN, scann_anisotropic_gen),
+            make_tuple(knowhere::IndexEnum::INDEX_FAISS_IVFRABITQ, ivf_rabitq_gen),
+            make_tuple(knowhere::IndexEnum::INDEX_FAISS_IVFRABITQ, ivf_rabitq_sq8_gen),
             make_tuple(knowhere::IndexEnum::INDEX_HNSW, hnsw_gen),
+            make_tuple(knowhere::IndexEnum::INDEX_HNSW, hnsw_sq8_gen),
+            make_tuple(knowhere::IndexEnum::INDEX_HNSW, hnsw_fp16_gen),
+            make_tuple(knowhere::IndexEnum::INDEX_HNSW_SQ8, hnsw_sq_gen),
+            make_tuple(knowhere::IndexEnum::INDEX_HNSW_PQ, hnsw_pq_gen),
+            make_tuple(knowhere::IndexEnum::INDEX_HNSW_PRQ, hnsw_prq_gen),
+            make_tuple(knowhere::IndexEnum::INDEX_HNSW, hnsw_aligned_gen),
+            make_tuple(knowhere::IndexEnum::INDEX_HNSW, hnsw_early_stop_gen),
+            make_tuple(knowhere::IndexEnum::INDEX_HNSW, hnsw_hubs_gen),
         }));
         auto idx = knowhere::IndexFactory::Instance().Create(name);
         auto cfg_json = gen().dump();
@@ -127,13 +318,19 @@ TEST_CASE("Test Mem Index With Float Vector", "[float metrics]") {
         REQUIRE(idx.Build(*train_ds, json) == knowhere::Status::success);
         REQUIRE(idx.Size() > 0);
         REQUIRE(idx.Count() == nb);
+        auto usage = idx.GetMemoryUsage();
+        REQUIRE(usage.Total() == idx.Size());
+        REQUIRE(usage.Of(knowhere::MemoryUsage::kVectors) > 0);
+        REQUIRE(usage.In(knowhere::MemoryUsage::kMmap) == 0);
         if (name == knowhere::IndexEnum::INDEX_FAISS_IVFFLAT) {
             load_raw_data(idx, *train_ds, json);
         }
         auto results = idx.Search(*query_ds, json, nullptr);
         REQUIRE(results.has_value());
         float recall = GetKNNRecall(*gt.value(), *results.value());
-        if (name != "IVF_PQ") {
+        if (name == knowhere::IndexEnum::INDEX_FAISS_IVFSQ4) {
+            REQUIRE(recall > kSq4KnnRecallThreshold);
+        } else if (name != "IVF_PQ" && name != "IVF_PQ_FASTSCAN") {
             REQUIRE(recall > kKnnRecallThreshold);
         }
     }
@@ -143,11 +340,21 @@ TEST_CASE("Test Mem Index With Float Vector", "[float metrics]") {
         auto [name, gen] = GENERATE_REF(table<std::string, std::function<knowhere::Json()>>({
             make_tuple(knowhere::IndexEnum::INDEX_FAISS_IDMAP, flat_gen),
             make_tuple(knowhere::IndexEnum::INDEX_FAISS_IVFFLAT, ivfflat_gen),
+            make_tuple(knowhere::IndexEnum::INDEX_FAISS_IVFFLAT, ivfflat_blocked_gen),
             make_tuple(knowhere::IndexEnum::INDEX_FAISS_IVFFLAT_CC, ivfflatcc_gen),
             make_tuple(knowhere::IndexEnum::INDEX_FAISS_IVFSQ8, ivfsq_gen),
             make_tuple(knowhere::IndexEnum::INDEX_FAISS_IVFPQ, ivfpq_gen),
+            make_tuple(knowhere::IndexEnum::INDEX_FAISS_IVFPQ_FASTSCAN, ivfpq_fastscan_gen),
             make_tuple(knowhere::IndexEnum::INDEX_FAISS_SCANN, scann_gen),
+            make_tuple(knowhere::IndexEnum::INDEX_FAISS_IVFRABITQ, ivf_rabitq_gen),
             make_tuple(knowhere::IndexEnum::INDEX_HNSW, hnsw_gen),
+            make_tuple(knowhere::IndexEnum::INDEX_HNSW, hnsw_sq8_gen),
+            make_tuple(knowhere::IndexEnum::INDEX_HNSW, hnsw_fp16_gen),
+            make_tuple(knowhere::IndexEnum::INDEX_HNSW_SQ8, hnsw_sq_gen),
+            make_tuple(knowhere::IndexEnum::INDEX_HNSW_PQ, hnsw_pq_gen),
+            make_tuple(knowhere::IndexEnum::INDEX_HNSW_PRQ, hnsw_prq_gen),
+            make_tuple(knowhere::IndexEnum::INDEX_HNSW, hnsw_aligned_gen),
+            make_tuple(knowhere::IndexEnum::INDEX_HNSW, hnsw_range_init_gen),
         }));
         auto idx = knowhere::IndexFactory::Instance().Create(name);
         auto cfg_json = gen().dump();
@@ -162,17 +369,151 @@ TEST_CASE("Test Mem Index With Float Vector", "[float metrics]") {
         REQUIRE(results.has_value());
         auto ids = results.value()->GetIds();
         auto lims = results.value()->GetLims();
-        if (name != "IVF_PQ" && name != "SCANN") {
+        if (name != "IVF_PQ" && name != "IVF_PQ_FASTSCAN" && name != "SCANN") {
             for (int i = 0; i < nq; ++i) {
                 CHECK(ids[lims[i]] == i);
             }
         }
     }
 
+    SECTION("Test IVF Range Search Probes") {
+        // the list radii bound the lists of a range search by the radius, range_nprobe caps them
+        knowhere::Json json = ivf_pruning_gen();
+        json[knowhere::meta::RADIUS] = knowhere::IsMetricType(metric, knowhere::metric::L2) ? 16.0 : 0.8;
+        const knowhere::Json range_conf = {
+            {knowhere::meta::METRIC_TYPE, metric},
+            {knowhere::meta::RADIUS, json[knowhere::meta::RADIUS]},
+            {knowhere::meta::RANGE_FILTER, json[knowhere::meta::RANGE_FILTER]},
+        };
+        auto range_gt = knowhere::BruteForce::RangeSearch(train_ds, query_ds, range_conf, nullptr);
+        REQUIRE(range_gt.has_value());
+        auto idx = knowhere::IndexFactory::Instance().Create(knowhere::IndexEnum::INDEX_FAISS_IVFSQ8);
+        REQUIRE(idx.Build(*train_ds, json) == knowhere::Status::success);
+        auto results = idx.RangeSearch(*query_ds, json, nullptr);
+        REQUIRE(results.has_value());
+        REQUIRE(GetRangeSearchRecall(*range_gt.value(), *results.value()) > 0.9f);
+
+        json[knowhere::indexparam::RANGE_NPROBE] = 1;
+        auto bounded = idx.RangeSearch(*query_ds, json, nullptr);
+        REQUIRE(bounded.has_value());
+        auto ids = bounded.value()->GetIds();
+        auto lims = bounded.value()->GetLims();
+        REQUIRE(lims[nq] <= results.value()->GetLims()[nq]);
+        for (int i = 0; i < nq; ++i) {
+            CHECK(std::find(ids + lims[i], ids + lims[i + 1], i) != ids + lims[i + 1]);
+        }
+    }
+
+    SECTION("Test IVF Filtered Probes") {
+        // a single probe mostly lands on lists the filter leaves next to nothing of, the probes go on past it
+        auto name = GENERATE(as<std::string>{}, knowhere::IndexEnum::INDEX_FAISS_IVFFLAT,
+                             knowhere::IndexEnum::INDEX_FAISS_IVFSQ8);
+        knowhere::Json json = ivfflat_gen();
+        json[knowhere::indexparam::NPROBE] = 1;
+        CAPTURE(name);
+        auto idx = knowhere::IndexFactory::Instance().Create(name);
+        REQUIRE(idx.Build(*train_ds, json) == knowhere::Status::success);
+        auto bitset_data = GenerateBitsetWithRandomTbitsSet(nb, nb * 0.95);
+        knowhere::BitsetView bitset(bitset_data.data(), nb);
+        auto results = idx.Search(*query_ds, json, bitset);
+        REQUIRE(results.has_value());
+        auto ids = results.value()->GetIds();
+        for (int i = 0; i < nq * topk; ++i) {
+            REQUIRE(ids[i] != -1);
+            CHECK(!bitset.test(ids[i]));
+        }
+
+        json[knowhere::indexparam::FILTER_PROBE_THRESHOLD] = 1.0f;
+        auto unfiltered = idx.Search(*query_ds, json, bitset);
+        REQUIRE(unfiltered.has_value());
+        auto gt = knowhere::BruteForce::Search(train_ds, query_ds, json, bitset);
+        REQUIRE(gt.has_value());
+        CHECK(GetKNNRecall(*gt.value(), *results.value()) >= GetKNNRecall(*gt.value(), *unfiltered.value()));
+    }
+
+    SECTION("Test IVF adaptive probes") {
+        auto name = knowhere::IndexEnum::INDEX_FAISS_IVFFLAT;
+        knowhere::Json json = ivfflat_gen();
+        auto idx = knowhere::IndexFactory::Instance().Create(name);
+        REQUIRE(idx.Build(*train_ds, json) == knowhere::Status::success);
+        auto all = idx.Search(*query_ds, json, nullptr);
+        REQUIRE(all.has_value());
+
+        // a ratio no centroid is beyond probes the nprobe lists, a ratio of 1 the nearest alone
+        json[knowhere::indexparam::PROBE_RATIO] = 1e30f;
+        auto unbounded = idx.Search(*query_ds, json, nullptr);
+        REQUIRE(unbounded.has_value());
+        json[knowhere::indexparam::PROBE_RATIO] = 1.0f;
+        auto nearest = idx.Search(*query_ds, json, nullptr);
+        REQUIRE(nearest.has_value());
+        json[knowhere::indexparam::PROBE_RATIO] = 1.5f;
+        auto adaptive = idx.Search(*query_ds, json, nullptr);
+        REQUIRE(adaptive.has_value());
+
+        // the probes of a ratio are a prefix of the nprobe ones that holds the nearest list, its results are in
+        // between
+        bool is_ip = !knowhere::IsMetricType(metric, knowhere::metric::L2);
+        for (int i = 0; i < nq * topk; ++i) {
+            CHECK(unbounded.value()->GetIds()[i] == all.value()->GetIds()[i]);
+            auto lo = all.value()->GetDistance()[i], mid = adaptive.value()->GetDistance()[i],
+                 hi = nearest.value()->GetDistance()[i];
+            if (is_ip) {
+                std::swap(lo, hi);
+            }
+            CHECK(lo <= mid + 1e-5);
+            CHECK(mid <= hi + 1e-5);
+        }
+    }
+
+    SECTION("Test Iterator") {
+        using std::make_tuple;
+        auto [name, gen] = GENERATE_REF(table<std::string, std::function<knowhere::Json()>>({
+            make_tuple(knowhere::IndexEnum::INDEX_FAISS_IDMAP, flat_gen),
+            make_tuple(knowhere::IndexEnum::INDEX_FAISS_IVFFLAT, ivfflat_gen),
+            make_tuple(knowhere::IndexEnum::INDEX_FAISS_IVFSQ8, ivfsq_gen),
+            make_tuple(knowhere::IndexEnum::INDEX_FAISS_IVFPQ_FASTSCAN, ivfpq_fastscan_gen),
+            make_tuple(knowhere::IndexEnum::INDEX_HNSW, hnsw_gen),
+            make_tuple(knowhere::IndexEnum::INDEX_HNSW, hnsw_sq8_gen),
+        }));
+        auto idx = knowhere::IndexFactory::Instance().Create(name);
+        auto cfg_json = gen().dump();
+        CAPTURE(name, cfg_json);
+        knowhere::Json json = knowhere::Json::parse(cfg_json);
+        REQUIRE(idx.Build(*train_ds, json) == knowhere::Status::success);
+        auto iterators = idx.AnnIterator(*query_ds, json, nullptr);
+        REQUIRE(iterators.has_value());
+        REQUIRE(iterators.value().size() == (size_t)nq);
+
+        const int64_t pages = 4, page = 7;
+        json[knowhere::meta::TOPK] = pages * page;
+        auto results = idx.Search(*query_ds, json, nullptr);
+        REQUIRE(results.has_value());
+        for (int64_t i = 0; i < nq; ++i) {
+            std::vector<int64_t> ids;
+            std::vector<float> distances;
+            for (int64_t p = 0; p < pages; ++p) {
+                auto batch = iterators.value()[i]->Next(page);
+                REQUIRE(batch.has_value());
+                REQUIRE(batch.value()->GetRows() == 1);
+                REQUIRE(batch.value()->GetDim() == page);
+                ids.insert(ids.end(), batch.value()->GetIds(), batch.value()->GetIds() + page);
+                distances.insert(distances.end(), batch.value()->GetDistance(),
+                                 batch.value()->GetDistance() + page);
+            }
+            REQUIRE(std::set<int64_t>(ids.begin(), ids.end()).size() == ids.size());
+            if (name == knowhere::IndexEnum::INDEX_FAISS_IDMAP) {
+                for (int64_t j = 0; j < pages * page; ++j) {
+                    REQUIRE(distances[j] == Approx(results.value()->GetDistance()[i * pages * page + j]));
+                }
+            }
+        }
+    }
+
     SECTION("Test Search with Bitset") {
         using std::make_tuple;
         auto [name, gen, threshold] = GENERATE_REF(table<std::string, std::function<knowhere::Json()>, float>({
             make_tuple(knowhere::IndexEnum::INDEX_HNSW, hnsw_gen, hnswlib::kHnswSearchKnnBFThreshold),
+            make_tuple(knowhere::IndexEnum::INDEX_HNSW, hnsw_filter_gen, 0.3f),
         }));
         auto idx = knowhere::IndexFactory::Instance().Create(name);
         auto cfg_json = gen().dump();
@@ -200,6 +541,282 @@ TEST_CASE("Test Mem Index With Float Vector", "[float metrics]") {
         }
     }
 
+    SECTION("Test Search with Cancellation") {
+        using std::make_tuple;
+        auto [name, gen] = GENERATE_REF(table<std::string, std::function<knowhere::Json()>>({
+            make_tuple(knowhere::IndexEnum::INDEX_FAISS_IVFFLAT, ivfflat_gen),
+            make_tuple(knowhere::IndexEnum::INDEX_HNSW, hnsw_gen),
+        }));
+        auto idx = knowhere::IndexFactory::Instance().Create(name);
+        knowhere::Json json = gen();
+        CAPTURE(name, json.dump());
+        REQUIRE(idx.Build(*train_ds, json) == knowhere::Status::success);
+
+        auto token = std::make_shared<knowhere::CancellationToken>();
+        auto results = idx.Search(*query_ds, json, nullptr, token);
+        REQUIRE(results.has_value());
+        auto range_results = idx.RangeSearch(*query_ds, json, nullptr, token);
+        REQUIRE(range_results.has_value());
+
+        token->Cancel();
+        results = idx.Search(*query_ds, json, nullptr, token);
+        REQUIRE(results.error() == knowhere::Status::search_cancelled);
+        range_results = idx.RangeSearch(*query_ds, json, nullptr, token);
+        REQUIRE(range_results.error() == knowhere::Status::search_cancelled);
+
+        // a timeout the search stays within does not cancel it
+        json[knowhere::meta::SEARCH_TIMEOUT_MS] = 60000;
+        results = idx.Search(*query_ds, json, nullptr);
+        REQUIRE(results.has_value());
+    }
+
+    SECTION("Test Search with max threads") {
+        using std::make_tuple;
+        auto [name, gen] = GENERATE_REF(table<std::string, std::function<knowhere::Json()>>({
+            make_tuple(knowhere::IndexEnum::INDEX_FAISS_IVFFLAT, ivfflat_gen),
+            make_tuple(knowhere::IndexEnum::INDEX_HNSW, hnsw_gen),
+        }));
+        auto idx = knowhere::IndexFactory::Instance().Create(name);
+        knowhere::Json json = gen();
+        CAPTURE(name, json.dump());
+        REQUIRE(idx.Build(*train_ds, json) == knowhere::Status::success);
+
+        auto results = idx.Search(*query_ds, json, nullptr);
+        REQUIRE(results.has_value());
+        // a budget changes which threads search the queries, not what they find
+        json[knowhere::meta::MAX_THREADS] = 1;
+        auto bounded = idx.Search(*query_ds, json, nullptr);
+        REQUIRE(bounded.has_value());
+        for (int64_t i = 0; i < nq * topk; ++i) {
+            REQUIRE(bounded.value()->GetIds()[i] == results.value()->GetIds()[i]);
+        }
+        json[knowhere::meta::MAX_THREADS] = -1;
+        REQUIRE(idx.Search(*query_ds, json, nullptr).error() == knowhere::Status::out_of_range_in_json);
+
+        // the tasks of a parallel_for, and the ones nested in them, share the budget of the caller
+        auto pool = knowhere::ThreadPool::GetGlobalSearchThreadPool();
+        std::atomic<int32_t> running = 0;
+        std::atomic<int32_t> most = 0;
+        auto work = [&](int64_t) {
+            auto now = ++running;
+            int32_t seen = most.load();
+            while (now > seen && !most.compare_exchange_weak(seen, now)) {
+            }
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+            --running;
+        };
+        {
+            knowhere::ThreadPool::ScopedParallelism parallelism(2);
+            REQUIRE(pool->concurrency() == std::min(2, pool->size()));
+            pool->parallel_for(0, 8, 1, [&](int64_t) { pool->parallel_for(0, 8, 1, work); });
+        }
+        REQUIRE(most.load() <= 2);
+        REQUIRE(pool->concurrency() == pool->size());
+    }
+
+    SECTION("Test Search with Buffers") {
+        using std::make_tuple;
+        auto [name, gen] = GENERATE_REF(table<std::string, std::function<knowhere::Json()>>({
+            make_tuple(knowhere::IndexEnum::INDEX_FAISS_IDMAP, flat_gen),
+            make_tuple(knowhere::IndexEnum::INDEX_FAISS_IVFFLAT, ivfflat_gen),
+            make_tuple(knowhere::IndexEnum::INDEX_HNSW, hnsw_gen),
+        }));
+        auto idx = knowhere::IndexFactory::Instance().Create(name);
+        knowhere::Json json = gen();
+        CAPTURE(name, json.dump());
+        REQUIRE(idx.Build(*train_ds, json) == knowhere::Status::success);
+
+        auto results = idx.Search(*query_ds, json, nullptr);
+        REQUIRE(results.has_value());
+        std::vector<int64_t> ids(nq * topk);
+        std::vector<float> dis(nq * topk);
+        REQUIRE(idx.SearchWithBuf(*query_ds, json, nullptr, ids.data(), dis.data()) == knowhere::Status::success);
+        for (int64_t i = 0; i < nq * topk; ++i) {
+            REQUIRE(ids[i] == results.value()->GetIds()[i]);
+            REQUIRE(dis[i] == results.value()->GetDistance()[i]);
+        }
+
+        auto range_results = idx.RangeSearch(*query_ds, json, nullptr);
+        REQUIRE(range_results.has_value());
+        auto total = range_results.value()->GetLims()[nq];
+        std::vector<size_t> lims(nq + 1);
+        std::vector<int64_t> range_ids(total);
+        std::vector<float> range_dis(total);
+        auto buf_results =
+            idx.RangeSearchWithBuf(*query_ds, json, nullptr, range_ids.data(), range_dis.data(), total, lims.data());
+        REQUIRE(buf_results.has_value());
+        REQUIRE(buf_results.value()->GetIds() == range_ids.data());
+        for (int64_t i = 0; i <= nq; ++i) {
+            REQUIRE(lims[i] == range_results.value()->GetLims()[i]);
+        }
+        for (size_t i = 0; i < total; ++i) {
+            REQUIRE(range_ids[i] == range_results.value()->GetIds()[i]);
+        }
+        if (total > 0) {
+            // results past the capacity come back in arrays of the dataset
+            buf_results = idx.RangeSearchWithBuf(*query_ds, json, nullptr, range_ids.data(), range_dis.data(),
+                                                 total - 1, lims.data());
+            REQUIRE(buf_results.has_value());
+            REQUIRE(buf_results.value()->GetIds() != range_ids.data());
+            REQUIRE(buf_results.value()->GetLims()[nq] == total);
+        }
+    }
+
+    SECTION("Test Search with Prepared Params") {
+        using std::make_tuple;
+        auto [name, gen] = GENERATE_REF(table<std::string, std::function<knowhere::Json()>>({
+            make_tuple(knowhere::IndexEnum::INDEX_FAISS_IVFFLAT, ivfflat_gen),
+            make_tuple(knowhere::IndexEnum::INDEX_HNSW, hnsw_gen),
+        }));
+        auto idx = knowhere::IndexFactory::Instance().Create(name);
+        knowhere::Json json = gen();
+        CAPTURE(name, json.dump());
+        REQUIRE(idx.Build(*train_ds, json) == knowhere::Status::success);
+
+        auto results = idx.Search(*query_ds, json, nullptr);
+        REQUIRE(results.has_value());
+        auto range_results = idx.RangeSearch(*query_ds, json, nullptr);
+        REQUIRE(range_results.has_value());
+        auto check = [&](const knowhere::expected<knowhere::DataSetPtr>& res,
+                         const knowhere::expected<knowhere::DataSetPtr>& want, int64_t len) {
+            REQUIRE(res.has_value());
+            for (int64_t i = 0; i < len; ++i) {
+                REQUIRE(res.value()->GetIds()[i] == want.value()->GetIds()[i]);
+            }
+        };
+
+        auto params = idx.PrepareSearch(json);
+        REQUIRE(params.has_value());
+        auto range_params = idx.PrepareSearch(json, true);
+        REQUIRE(range_params.has_value());
+        // the configs kept by the params are reused, with the fields of the search before cleared
+        for (int round = 0; round < 3; ++round) {
+            check(idx.Search(*query_ds, *params.value(), nullptr), results, nq * topk);
+            check(idx.RangeSearch(*query_ds, *range_params.value(), nullptr), range_results,
+                  range_results.value()->GetLims()[nq]);
+        }
+        std::vector<int64_t> ids(nq * topk);
+        std::vector<float> dis(nq * topk);
+        REQUIRE(idx.SearchWithBuf(*query_ds, *params.value(), nullptr, ids.data(), dis.data()) ==
+                knowhere::Status::success);
+        check(idx.Search(*query_ds, *params.value(), nullptr), results, nq * topk);
+
+        auto token = std::make_shared<knowhere::CancellationToken>();
+        token->Cancel();
+        REQUIRE(idx.Search(*query_ds, *params.value(), nullptr, token).error() == knowhere::Status::search_cancelled);
+        check(idx.Search(*query_ds, *params.value(), nullptr), results, nq * topk);
+
+        // params of another kind of search or index type are refused
+        REQUIRE(idx.Search(*query_ds, *range_params.value(), nullptr).error() == knowhere::Status::invalid_args);
+        auto flat = knowhere::IndexFactory::Instance().Create(knowhere::IndexEnum::INDEX_FAISS_IDMAP);
+        REQUIRE(flat.Build(*train_ds, json) == knowhere::Status::success);
+        REQUIRE(flat.Search(*query_ds, *params.value(), nullptr).error() == knowhere::Status::invalid_args);
+
+        // a bad json fails on prepare
+        knowhere::Json bad_json = json;
+        bad_json[knowhere::meta::TOPK] = -1;
+        REQUIRE(idx.PrepareSearch(bad_json).error() == knowhere::Status::out_of_range_in_json);
+
+        knowhere::KnowhereConfig::SetSearchParamsCache(16);
+        for (int round = 0; round < 3; ++round) {
+            check(idx.Search(*query_ds, json, nullptr), results, nq * topk);
+            check(idx.RangeSearch(*query_ds, json, nullptr), range_results, range_results.value()->GetLims()[nq]);
+        }
+        REQUIRE(idx.Search(*query_ds, bad_json, nullptr).error() == knowhere::Status::out_of_range_in_json);
+        knowhere::KnowhereConfig::SetSearchParamsCache(0);
+    }
+
+    SECTION("Test Search with Result Cache") {
+        auto idx = knowhere::IndexFactory::Instance().Create(knowhere::IndexEnum::INDEX_HNSW);
+        knowhere::Json json = hnsw_gen();
+        REQUIRE(idx.Build(*train_ds, json) == knowhere::Status::success);
+        auto want = idx.Search(*query_ds, json, nullptr);
+        REQUIRE(want.has_value());
+        auto check = [&](const knowhere::expected<knowhere::DataSetPtr>& res) {
+            REQUIRE(res.has_value());
+            for (int64_t i = 0; i < nq * topk; ++i) {
+                REQUIRE(res.value()->GetIds()[i] == want.value()->GetIds()[i]);
+                REQUIRE(res.value()->GetDistance()[i] == want.value()->GetDistance()[i]);
+            }
+        };
+
+        knowhere::KnowhereConfig::SetResultCache(1 << 20);
+        auto stats = knowhere::ResultCache::GetStats();
+        check(idx.Search(*query_ds, json, nullptr));
+        REQUIRE(knowhere::ResultCache::GetStats().misses == stats.misses + nq);
+        REQUIRE(knowhere::ResultCache::GetStats().bytes > 0);
+        stats = knowhere::ResultCache::GetStats();
+        check(idx.Search(*query_ds, json, nullptr));
+        std::vector<int64_t> ids(nq * topk);
+        std::vector<float> dis(nq * topk);
+        REQUIRE(idx.SearchWithBuf(*query_ds, json, nullptr, ids.data(), dis.data()) == knowhere::Status::success);
+        REQUIRE(std::equal(ids.begin(), ids.end(), want.value()->GetIds()));
+        REQUIRE(knowhere::ResultCache::GetStats().hits == stats.hits + 2 * nq);
+        REQUIRE(knowhere::ResultCache::GetStats().misses == stats.misses);
+
+        // another config, a filter of no version or new data miss
+        stats = knowhere::ResultCache::GetStats();
+        knowhere::Json other = json;
+        other[knowhere::indexparam::EF] = 2 * topk;
+        REQUIRE(idx.Search(*query_ds, other, nullptr).has_value());
+        auto bitset_data = GenerateBitsetWithRandomTbitsSet(nb, nb / 10);
+        knowhere::BitsetView bitset(bitset_data.data(), nb);
+        REQUIRE(idx.Search(*query_ds, json, bitset).has_value());
+        REQUIRE(knowhere::ResultCache::GetStats().hits == stats.hits);
+        REQUIRE(knowhere::ResultCache::GetStats().misses == stats.misses + nq);
+        knowhere::Json filtered = json;
+        filtered[knowhere::indexparam::FILTER_VERSION] = 1;
+        auto filtered_want = idx.Search(*query_ds, filtered, bitset);
+        REQUIRE(filtered_want.has_value());
+        auto filtered_res = idx.Search(*query_ds, filtered, bitset);
+        REQUIRE(filtered_res.has_value());
+        REQUIRE(std::equal(filtered_res.value()->GetIds(), filtered_res.value()->GetIds() + nq * topk,
+                           filtered_want.value()->GetIds()));
+        REQUIRE(knowhere::ResultCache::GetStats().hits == stats.hits + nq);
+
+        stats = knowhere::ResultCache::GetStats();
+        REQUIRE(idx.Build(*train_ds, json) == knowhere::Status::success);
+        REQUIRE(idx.Search(*query_ds, json, nullptr).has_value());
+        REQUIRE(knowhere::ResultCache::GetStats().hits == stats.hits);
+
+        knowhere::KnowhereConfig::SetResultCache(0);
+        REQUIRE(knowhere::ResultCache::GetStats().bytes == 0);
+    }
+
+    SECTION("Test Multi Index Search") {
+        using std::make_tuple;
+        auto [name, gen] = GENERATE_REF(table<std::string, std::function<knowhere::Json()>>({
+            make_tuple(knowhere::IndexEnum::INDEX_FAISS_IVFFLAT, ivfflat_gen),
+            make_tuple(knowhere::IndexEnum::INDEX_HNSW, hnsw_gen),
+        }));
+        knowhere::Json json = gen();
+        CAPTURE(name, json.dump());
+        // the base rows split over segments of uneven sizes, one of them empty
+        const std::vector<int64_t> bounds = {0, 100, 100, 450, nb};
+        auto tensor = (const float*)train_ds->GetTensor();
+        std::vector<knowhere::SegmentIndex> segments;
+        for (size_t s = 0; s + 1 < bounds.size(); ++s) {
+            auto idx = knowhere::IndexFactory::Instance().Create(name);
+            auto rows = bounds[s + 1] - bounds[s];
+            if (rows > 0) {
+                REQUIRE(idx.Build(*knowhere::GenDataSet(rows, dim, tensor + bounds[s] * dim), json) ==
+                        knowhere::Status::success);
+            }
+            segments.push_back({idx, nullptr, bounds[s]});
+        }
+        auto results = knowhere::MultiIndexSearch::Search(segments, *query_ds, json);
+        REQUIRE(results.has_value());
+        REQUIRE(GetKNNRecall(*gt.value(), *results.value()) > kKnnRecallThreshold);
+        for (int64_t i = 0; i < nq * topk; i++) {
+            REQUIRE(results.value()->GetIds()[i] < nb);
+        }
+
+        auto token = std::make_shared<knowhere::CancellationToken>();
+        token->Cancel();
+        results = knowhere::MultiIndexSearch::Search(segments, *query_ds, json, token);
+        REQUIRE(results.error() == knowhere::Status::search_cancelled);
+    }
+
     SECTION("Test Serialize/Deserialize") {
         using std::make_tuple;
         auto [name, gen] = GENERATE_REF(table<std::string, std::function<knowhere::Json()>>({
@@ -208,7 +825,16 @@ TEST_CASE("Test Mem Index With Float Vector", "[float metrics]") {
             make_tuple(knowhere::IndexEnum::INDEX_FAISS_IVFFLAT_CC, ivfflatcc_gen),
             make_tuple(knowhere::IndexEnum::INDEX_FAISS_IVFSQ8, ivfsq_gen),
             make_tuple(knowhere::IndexEnum::INDEX_FAISS_IVFPQ, ivfpq_gen),
+            make_tuple(knowhere::IndexEnum::INDEX_FAISS_IVFPQ_FASTSCAN, ivfpq_fastscan_gen),
+            make_tuple(knowhere::IndexEnum::INDEX_FAISS_IVFRABITQ, ivf_rabitq_sq8_gen),
             make_tuple(knowhere::IndexEnum::INDEX_HNSW, hnsw_gen),
+            make_tuple(knowhere::IndexEnum::INDEX_HNSW, hnsw_sq8_gen),
+            make_tuple(knowhere::IndexEnum::INDEX_HNSW, hnsw_fp16_gen),
+            make_tuple(knowhere::IndexEnum::INDEX_HNSW_SQ8, hnsw_sq_gen),
+            make_tuple(knowhere::IndexEnum::INDEX_HNSW_PQ, hnsw_pq_gen),
+            make_tuple(knowhere::IndexEnum::INDEX_HNSW_PRQ, hnsw_prq_gen),
+            make_tuple(knowhere::IndexEnum::INDEX_HNSW, hnsw_aligned_gen),
+            make_tuple(knowhere::IndexEnum::INDEX_HNSW, hnsw_hubs_gen),
         }));
 
         auto idx = knowhere::IndexFactory::Instance().Create(name);
@@ -229,6 +855,49 @@ TEST_CASE("Test Mem Index With Float Vector", "[float metrics]") {
         REQUIRE(results.has_value());
     }
 
+    SECTION("Test Deserialize compressed BinarySet") {
+        using std::make_tuple;
+        auto [name, gen] = GENERATE_REF(table<std::string, std::function<knowhere::Json()>>({
+            make_tuple(knowhere::IndexEnum::INDEX_FAISS_IVFSQ8, ivfsq_gen),
+            make_tuple(knowhere::IndexEnum::INDEX_HNSW, hnsw_gen),
+        }));
+        auto codec = GENERATE(knowhere::BinaryCodec::LZ4, knowhere::BinaryCodec::ZSTD);
+        auto idx = knowhere::IndexFactory::Instance().Create(name);
+        knowhere::Json json = gen();
+        CAPTURE(name, json.dump(), codec);
+        REQUIRE(idx.Build(*train_ds, json) == knowhere::Status::success);
+        auto expected = idx.Search(*query_ds, json, nullptr);
+        REQUIRE(expected.has_value());
+        knowhere::BinarySet bs;
+        REQUIRE(idx.Serialize(bs) == knowhere::Status::success);
+        auto raw_size = bs.GetByName(name)->size;
+
+        REQUIRE(knowhere::BinarySetCodec::Compress(bs, codec) == knowhere::Status::success);
+        if (knowhere::BinarySetCodec::IsCompressed(*bs.GetByName(name))) {
+            REQUIRE(bs.GetByName(name)->size < raw_size);
+        }
+        auto idx_ = knowhere::IndexFactory::Instance().Create(name);
+        REQUIRE(idx_.Deserialize(bs) == knowhere::Status::success);
+        auto results = idx_.Search(*query_ds, json, nullptr);
+        REQUIRE(results.has_value());
+        for (int64_t i = 0; i < nq * json[knowhere::meta::TOPK].get<int64_t>(); ++i) {
+            REQUIRE(results.value()->GetIds()[i] == expected.value()->GetIds()[i]);
+        }
+
+        // the random vectors of the test hardly compress, a section of ids does
+        const int64_t n = 1 << 20;
+        std::shared_ptr<uint8_t[]> ids(new uint8_t[n * sizeof(int64_t)]);
+        std::iota(reinterpret_cast<int64_t*>(ids.get()), reinterpret_cast<int64_t*>(ids.get()) + n, 0);
+        knowhere::BinarySet ids_bs;
+        ids_bs.Append("ids", ids, n * sizeof(int64_t));
+        REQUIRE(knowhere::BinarySetCodec::Compress(ids_bs, codec) == knowhere::Status::success);
+        REQUIRE(knowhere::BinarySetCodec::IsCompressed(*ids_bs.GetByName("ids")));
+        REQUIRE(knowhere::BinarySetCodec::Decompress(ids_bs) == knowhere::Status::success);
+        auto ids_binary = ids_bs.GetByName("ids");
+        REQUIRE(ids_binary->size == n * static_cast<int64_t>(sizeof(int64_t)));
+        REQUIRE(std::memcmp(ids_binary->data.get(), ids.get(), ids_binary->size) == 0);
+    }
+
     SECTION("Test IVFPQ with invalid params") {
         auto idx = knowhere::IndexFactory::Instance().Create(knowhere::IndexEnum::INDEX_FAISS_IVFPQ);
         uint32_t nb = 1000;
@@ -246,20 +915,1137 @@ TEST_CASE("Test Mem Index With Float Vector", "[float metrics]") {
         auto res = idx.Build(*train_ds, ivf_pq_gen());
         REQUIRE(res == knowhere::Status::faiss_inner_error);
     }
-}
 
-TEST_CASE("Test Mem Index With Binary Vector", "[float metrics]") {
-    using Catch::Approx;
+    SECTION("Test IVF_PQ_FASTSCAN with invalid params") {
+        auto idx = knowhere::IndexFactory::Instance().Create(knowhere::IndexEnum::INDEX_FAISS_IVFPQ_FASTSCAN);
+        knowhere::Json json = ivfpq_fastscan_gen();
+        json[knowhere::indexparam::BBS] = 48;
+        REQUIRE(idx.Build(*train_ds, json) == knowhere::Status::invalid_args);
+    }
 
-    const int64_t nb = 1000, nq = 10;
-    const int64_t dim = 1024;
-    const int64_t topk = 5;
+    SECTION("Test IVF with inverted lists arena") {
+        using std::make_tuple;
+        auto [name, gen] = GENERATE_REF(table<std::string, std::function<knowhere::Json()>>({
+            make_tuple(knowhere::IndexEnum::INDEX_FAISS_IVFSQ8, ivfsq_gen),
+            make_tuple(knowhere::IndexEnum::INDEX_FAISS_IVFPQ, ivfpq_gen),
+        }));
+        auto huge_pages = GENERATE(true, false);
+        auto idx = knowhere::IndexFactory::Instance().Create(name);
+        knowhere::Json json = gen();
+        CAPTURE(name, huge_pages);
+        REQUIRE(idx.Build(*train_ds, json) == knowhere::Status::success);
+        auto results = idx.Search(*query_ds, json, nullptr);
+        REQUIRE(results.has_value());
 
-    auto metric = GENERATE(as<std::string>{}, knowhere::metric::HAMMING, knowhere::metric::JACCARD);
-    auto base_gen = [&]() {
-        knowhere::Json json;
-        json[knowhere::meta::DIM] = dim;
-        json[knowhere::meta::METRIC_TYPE] = metric;
+        knowhere::Json load_json = json;
+        load_json[knowhere::indexparam::INVLISTS_ARENA] = true;
+        load_json[knowhere::indexparam::HUGE_PAGES] = huge_pages;
+        knowhere::BinarySet bs;
+        REQUIRE(idx.Serialize(bs) == knowhere::Status::success);
+        auto idx_arena = knowhere::IndexFactory::Instance().Create(name);
+        REQUIRE(idx_arena.Deserialize(bs, load_json) == knowhere::Status::success);
+        REQUIRE(idx_arena.Count() == nb);
+
+        // an arena is serialized as plain inverted lists
+        knowhere::BinarySet bs_arena;
+        REQUIRE(idx_arena.Serialize(bs_arena) == knowhere::Status::success);
+        auto idx_ = knowhere::IndexFactory::Instance().Create(name);
+        REQUIRE(idx_.Deserialize(bs_arena) == knowhere::Status::success);
+
+        auto ids = results.value()->GetIds();
+        for (auto* index : {&idx_arena, &idx_}) {
+            auto results_ = index->Search(*query_ds, json, nullptr);
+            REQUIRE(results_.has_value());
+            auto ids_ = results_.value()->GetIds();
+            for (int i = 0; i < nq * topk; ++i) {
+                CHECK(ids[i] == ids_[i]);
+            }
+        }
+    }
+
+    SECTION("Test IVF_PQ without precomputed tables") {
+        auto name = knowhere::IndexEnum::INDEX_FAISS_IVFPQ;
+        knowhere::Json json = ivfpq_gen();
+        auto idx = knowhere::IndexFactory::Instance().Create(name);
+        REQUIRE(idx.Build(*train_ds, json) == knowhere::Status::success);
+        auto results = idx.Search(*query_ds, json, nullptr);
+        REQUIRE(results.has_value());
+
+        knowhere::Json lazy_json = json;
+        lazy_json[knowhere::indexparam::PRECOMPUTE_TABLE] = false;
+        auto idx_lazy = knowhere::IndexFactory::Instance().Create(name);
+        REQUIRE(idx_lazy.Build(*train_ds, lazy_json) == knowhere::Status::success);
+        knowhere::BinarySet bs;
+        REQUIRE(idx.Serialize(bs) == knowhere::Status::success);
+        auto idx_loaded = knowhere::IndexFactory::Instance().Create(name);
+        REQUIRE(idx_loaded.Deserialize(bs, lazy_json) == knowhere::Status::success);
+
+        // only the L2 distances to the residuals use the tables
+        auto codebooks = idx.GetMemoryUsage().Of(knowhere::MemoryUsage::kCodebooks);
+        auto distances = results.value()->GetDistance();
+        for (auto* index : {&idx_lazy, &idx_loaded}) {
+            if (knowhere::IsMetricType(metric, knowhere::metric::L2)) {
+                REQUIRE(index->GetMemoryUsage().Of(knowhere::MemoryUsage::kCodebooks) < codebooks);
+            }
+            auto results_ = index->Search(*query_ds, json, nullptr);
+            REQUIRE(results_.has_value());
+            auto distances_ = results_.value()->GetDistance();
+            for (int i = 0; i < nq * topk; ++i) {
+                CHECK(distances[i] == Approx(distances_[i]).epsilon(1e-4));
+            }
+        }
+    }
+
+    SECTION("Test IVF_PQ list-major batch search") {
+        // the batches go list by list over the lists their queries probe, with and without the precomputed tables
+        auto precompute_table = GENERATE(true, false);
+        knowhere::Json json = ivfpq_gen();
+        json[knowhere::indexparam::PRECOMPUTE_TABLE] = precompute_table;
+        CAPTURE(precompute_table);
+        auto idx = knowhere::IndexFactory::Instance().Create(knowhere::IndexEnum::INDEX_FAISS_IVFPQ);
+        REQUIRE(idx.Build(*train_ds, json) == knowhere::Status::success);
+        auto results = idx.Search(*query_ds, json, nullptr);
+        REQUIRE(results.has_value());
+
+        json[knowhere::indexparam::BATCH_SEARCH_NQ] = 4;
+        auto batched = idx.Search(*query_ds, json, nullptr);
+        REQUIRE(batched.has_value());
+        auto distances = results.value()->GetDistance();
+        auto distances_ = batched.value()->GetDistance();
+        for (int i = 0; i < nq * topk; ++i) {
+            CHECK(distances[i] == Approx(distances_[i]).epsilon(1e-4));
+        }
+        CHECK(GetKNNRecall(*results.value(), *batched.value()) >= 0.99f);
+    }
+
+    SECTION("Test IVF_PQ polysemous filter") {
+        auto name = knowhere::IndexEnum::INDEX_FAISS_IVFPQ;
+        knowhere::Json json = ivfpq_gen();
+        json[knowhere::indexparam::POLYSEMOUS] = true;
+        auto idx = knowhere::IndexFactory::Instance().Create(name);
+        REQUIRE(idx.Build(*train_ds, json) == knowhere::Status::success);
+        auto results = idx.Search(*query_ds, json, nullptr);
+        REQUIRE(results.has_value());
+
+        // 4 codes of 8 bits are at a Hamming distance of at most 32, a threshold above it skips none
+        json[knowhere::indexparam::POLYSEMOUS_HT] = 33;
+        auto all = idx.Search(*query_ds, json, nullptr);
+        REQUIRE(all.has_value());
+        json[knowhere::indexparam::POLYSEMOUS_HT] = 12;
+        auto skipped = idx.Search(*query_ds, json, nullptr);
+        REQUIRE(skipped.has_value());
+
+        // the skipping search ranks a subset of the same codes, none of its results is closer
+        bool is_ip = !knowhere::IsMetricType(metric, knowhere::metric::L2);
+        auto distances = results.value()->GetDistance();
+        auto distances_all = all.value()->GetDistance();
+        auto distances_skipped = skipped.value()->GetDistance();
+        for (int i = 0; i < nq * topk; ++i) {
+            CHECK(distances_all[i] == Approx(distances[i]).epsilon(1e-4));
+            if (is_ip) {
+                CHECK(distances_skipped[i] <= distances[i] + 1e-4);
+            } else {
+                CHECK(distances_skipped[i] >= distances[i] - 1e-4);
+            }
+        }
+    }
+
+    SECTION("Test pre-transform") {
+        using std::make_tuple;
+        auto [name, gen] = GENERATE_REF(table<std::string, std::function<knowhere::Json()>>({
+            make_tuple(knowhere::IndexEnum::INDEX_HNSW, hnsw_gen),
+            make_tuple(knowhere::IndexEnum::INDEX_FAISS_IVFFLAT, ivfflat_gen),
+            make_tuple(knowhere::IndexEnum::INDEX_FAISS_IVFSQ8, ivfsq_gen),
+        }));
+        CAPTURE(name);
+        knowhere::Json json = gen();
+        json[knowhere::indexparam::PRE_TRANSFORM] = "RR";
+        auto idx = knowhere::IndexFactory::Instance().Create(name);
+        REQUIRE(idx.Build(*train_ds, json) == knowhere::Status::success);
+        REQUIRE(idx.Count() == nb);
+        REQUIRE(idx.Dim() == dim);
+        REQUIRE(idx.GetMemoryUsage().Total() == idx.Size());
+        REQUIRE_FALSE(idx.HasRawData(metric));
+        // a rotation keeps the distances
+        auto results = idx.Search(*query_ds, json, nullptr);
+        REQUIRE(results.has_value());
+        REQUIRE(GetKNNRecall(*gt.value(), *results.value()) > kKnnRecallThreshold);
+
+        knowhere::BinarySet bs;
+        REQUIRE(idx.Serialize(bs) == knowhere::Status::success);
+        REQUIRE(bs.Contains("pre_transform"));
+        auto idx_ = knowhere::IndexFactory::Instance().Create(name);
+        REQUIRE(idx_.Deserialize(bs, json) == knowhere::Status::success);
+        auto results_ = idx_.Search(*query_ds, json, nullptr);
+        REQUIRE(results_.has_value());
+        auto ids = results.value()->GetIds();
+        auto ids_ = results_.value()->GetIds();
+        for (int i = 0; i < nq * topk; ++i) {
+            CHECK(ids[i] == ids_[i]);
+        }
+
+        if (name == knowhere::IndexEnum::INDEX_HNSW) {
+            std::vector<int64_t> ids_v(nq);
+            for (int i = 0; i < nq; ++i) {
+                ids_v[i] = i;
+            }
+            auto vectors = idx_.GetVectorByIds(*GenIdsDataSet(nq, ids_v));
+            REQUIRE(vectors.has_value());
+            auto xb = (const float*)train_ds->GetTensor();
+            auto xv = (const float*)vectors.value()->GetTensor();
+            for (int i = 0; i < nq * dim; ++i) {
+                REQUIRE(xv[i] == Approx(xb[i]).margin(1e-4));
+            }
+        }
+
+        // to fewer dims, the queries go through the same transform
+        json[knowhere::indexparam::PRE_TRANSFORM] = "PCA";
+        json[knowhere::indexparam::PRE_TRANSFORM_DIM] = dim / 2;
+        auto idx_pca = knowhere::IndexFactory::Instance().Create(name);
+        if (!knowhere::IsMetricType(metric, knowhere::metric::L2)) {
+            REQUIRE(idx_pca.Build(*train_ds, json) == knowhere::Status::invalid_metric_type);
+        } else {
+            REQUIRE(idx_pca.Build(*train_ds, json) == knowhere::Status::success);
+            REQUIRE(idx_pca.Dim() == dim);
+            REQUIRE(idx_pca.Size() < idx.Size());
+            results = idx_pca.Search(*query_ds, json, nullptr);
+            REQUIRE(results.has_value());
+            std::vector<int64_t> first = {0};
+            REQUIRE_FALSE(idx_pca.GetVectorByIds(*GenIdsDataSet(1, first)).has_value());
+        }
+
+        json[knowhere::indexparam::PRE_TRANSFORM] = "ZCA";
+        REQUIRE(idx_pca.Build(*train_ds, json) == knowhere::Status::invalid_args);
+    }
+
+    SECTION("Test rerank store") {
+        using std::make_tuple;
+        auto [name, gen] = GENERATE_REF(table<std::string, std::function<knowhere::Json()>>({
+            make_tuple(knowhere::IndexEnum::INDEX_FAISS_IVFPQ, ivfpq_gen),
+            make_tuple(knowhere::IndexEnum::INDEX_FAISS_IVFSQ8, ivfsq_gen),
+        }));
+        auto store = GENERATE(as<std::string>{}, "FP32", "FP16");
+        CAPTURE(name, store);
+        knowhere::Json json = gen();
+        auto idx = knowhere::IndexFactory::Instance().Create(name);
+        REQUIRE(idx.Build(*train_ds, json) == knowhere::Status::success);
+        auto approx = idx.Search(*query_ds, json, nullptr);
+        REQUIRE(approx.has_value());
+
+        json[knowhere::indexparam::RERANK_STORE] = store;
+        json[knowhere::indexparam::RERANK_RATIO] = 4;
+        auto idx_ = knowhere::IndexFactory::Instance().Create(name);
+        REQUIRE(idx_.Build(*train_ds, json) == knowhere::Status::success);
+        REQUIRE(idx_.Count() == nb);
+        REQUIRE(idx_.Size() > idx.Size());
+        REQUIRE(idx_.GetMemoryUsage().Total() == idx_.Size());
+        REQUIRE(idx_.HasRawData(metric) == (store == "FP32" || idx.HasRawData(metric)));
+        auto results = idx_.Search(*query_ds, json, nullptr);
+        REQUIRE(results.has_value());
+        REQUIRE(GetKNNRecall(*gt.value(), *results.value()) >= GetKNNRecall(*gt.value(), *approx.value()));
+        // the distances of the results are the exact ones
+        auto gt_ids = gt.value()->GetIds();
+        auto gt_dis = gt.value()->GetDistance();
+        auto ids = results.value()->GetIds();
+        auto dis = results.value()->GetDistance();
+        for (int i = 0; i < nq; ++i) {
+            if (ids[i * topk] == gt_ids[i * topk]) {
+                CHECK(dis[i * topk] == Approx(gt_dis[i * topk]).epsilon(store == "FP16" ? 1e-2 : 1e-4));
+            }
+        }
+
+        knowhere::BinarySet bs;
+        REQUIRE(idx_.Serialize(bs) == knowhere::Status::success);
+        REQUIRE(bs.Contains("rerank_store"));
+        auto idx_load = knowhere::IndexFactory::Instance().Create(name);
+        REQUIRE(idx_load.Deserialize(bs, json) == knowhere::Status::success);
+        auto results_ = idx_load.Search(*query_ds, json, nullptr);
+        REQUIRE(results_.has_value());
+        auto ids_ = results_.value()->GetIds();
+        for (int i = 0; i < nq * topk; ++i) {
+            CHECK(ids[i] == ids_[i]);
+        }
+
+        // an FP32 store built from the store of the caller shares its rows
+        if (store == "FP32") {
+            auto rows = knowhere::RawVectorStore::View(train_ds->GetTensor(), nb, dim, dim * sizeof(float), train_ds);
+            auto idx_shared = knowhere::IndexFactory::Instance().Create(name);
+            REQUIRE(idx_shared.Build(*knowhere::GenDataSet(rows), json) == knowhere::Status::success);
+            REQUIRE(idx_shared.Size() == idx.Size());
+            auto shared_results = idx_shared.Search(*query_ds, json, nullptr);
+            REQUIRE(shared_results.has_value());
+            for (int i = 0; i < nq * topk; ++i) {
+                CHECK(ids[i] == shared_results.value()->GetIds()[i]);
+            }
+            std::vector<int64_t> consecutive = {3, 4, 5};
+            auto vectors = idx_shared.GetVectorByIds(*GenIdsDataSet(3, consecutive));
+            REQUIRE(vectors.has_value());
+            REQUIRE(vectors.value()->GetTensor() == rows->Row(3));
+            // an add copies the rows first, those of the caller stay as they are
+            REQUIRE(idx_shared.Add(*train_ds, json) == knowhere::Status::success);
+            REQUIRE(idx_shared.Size() > idx.Size());
+            REQUIRE(rows->Rows() == nb);
+        }
+
+        json[knowhere::indexparam::RERANK_STORE] = "BF16";
+        REQUIRE(idx_load.Build(*train_ds, json) == knowhere::Status::invalid_args);
+    }
+
+    SECTION("Test multi-vector search") {
+        // documents of 4 rows, the query i holds 2 rows of the document i
+        const int64_t rows_per_doc = 4;
+        std::vector<int64_t> doc_ids(nb);
+        for (int64_t i = 0; i < nb; ++i) {
+            doc_ids[i] = i / rows_per_doc;
+        }
+        auto xb = (const float*)train_ds->GetTensor();
+        std::vector<float> xq(nq * 2 * dim);
+        std::vector<size_t> lims(nq + 1);
+        for (int64_t i = 0; i < nq; ++i) {
+            std::copy_n(xb + i * rows_per_doc * dim, 2 * dim, xq.data() + i * 2 * dim);
+            lims[i + 1] = (i + 1) * 2;
+        }
+        auto query = knowhere::GenDataSet(nq * 2, dim, xq.data());
+        query->SetLims(lims.data());
+
+        knowhere::Json json = flat_gen();
+        json[knowhere::indexparam::MULTI_VECTOR_K] = 16;
+        auto idx = knowhere::IndexFactory::Instance().Create(knowhere::IndexEnum::INDEX_FAISS_IDMAP);
+        REQUIRE(idx.Build(*train_ds, json) == knowhere::Status::success);
+        auto results = idx.MultiVectorSearch(*query, json, nullptr, doc_ids.data());
+        if (!knowhere::IsMetricType(metric, knowhere::metric::COSINE)) {
+            REQUIRE(results.error() == knowhere::Status::invalid_metric_type);
+        } else {
+            REQUIRE(results.has_value());
+            REQUIRE(results.value()->GetRows() == nq);
+            auto ids = results.value()->GetIds();
+            auto scores = results.value()->GetDistance();
+            for (int64_t i = 0; i < nq; ++i) {
+                CHECK(ids[i * topk] == i);
+                CHECK(scores[i * topk] == Approx(2.0).margin(1e-4));
+            }
+            // every hit of the document adds up, the documents come highest score first
+            json[knowhere::indexparam::MULTI_VECTOR_AGG] = "SUM";
+            auto sums = idx.MultiVectorSearch(*query, json, nullptr, doc_ids.data());
+            REQUIRE(sums.has_value());
+            auto sum_ids = sums.value()->GetIds();
+            auto sum_scores = sums.value()->GetDistance();
+            for (int64_t i = 0; i < nq; ++i) {
+                for (int64_t j = 1; j < topk; ++j) {
+                    CHECK(sum_ids[i * topk + j] < nb / rows_per_doc);
+                    CHECK(sum_scores[i * topk + j - 1] >= sum_scores[i * topk + j]);
+                }
+            }
+            json[knowhere::indexparam::MULTI_VECTOR_AGG] = "MEAN";
+            REQUIRE(idx.MultiVectorSearch(*query, json, nullptr, doc_ids.data()).error() ==
+                    knowhere::Status::invalid_args);
+        }
+    }
+
+    SECTION("Test grouped search") {
+        using std::make_tuple;
+        auto [name, gen] = GENERATE_REF(table<std::string, std::function<knowhere::Json()>>({
+            make_tuple(knowhere::IndexEnum::INDEX_FAISS_IDMAP, flat_gen),
+            make_tuple(knowhere::IndexEnum::INDEX_FAISS_IVFFLAT, ivfflat_gen),
+            make_tuple(knowhere::IndexEnum::INDEX_HNSW, hnsw_gen),
+        }));
+        CAPTURE(name);
+        // groups of 20 rows
+        const int64_t groups = 50;
+        const int64_t group_size = 2;
+        std::vector<int64_t> group_ids(nb);
+        for (int64_t i = 0; i < nb; ++i) {
+            group_ids[i] = i % groups;
+        }
+        knowhere::Json json = gen();
+        json[knowhere::indexparam::GROUP_SIZE] = group_size;
+        auto idx = knowhere::IndexFactory::Instance().Create(name);
+        REQUIRE(idx.Build(*train_ds, json) == knowhere::Status::success);
+        auto results = idx.GroupedSearch(*query_ds, json, nullptr, group_ids.data());
+        REQUIRE(results.has_value());
+        REQUIRE(results.value()->GetDim() == topk * group_size);
+        auto ids = results.value()->GetIds();
+        auto gt_ids = gt.value()->GetIds();
+        for (int64_t i = 0; i < nq; ++i) {
+            auto row = ids + i * topk * group_size;
+            std::set<int64_t> seen;
+            for (int64_t g = 0; g < topk; ++g) {
+                // every group is full, of rows of the group
+                for (int64_t j = 0; j < group_size; ++j) {
+                    REQUIRE(row[g * group_size + j] >= 0);
+                }
+                auto group = group_ids[row[g * group_size]];
+                for (int64_t j = 0; j < group_size; ++j) {
+                    CHECK(group_ids[row[g * group_size + j]] == group);
+                }
+                CHECK(seen.insert(group).second);
+            }
+            if (name == knowhere::IndexEnum::INDEX_FAISS_IDMAP) {
+                CHECK(row[0] == gt_ids[i * topk]);
+            }
+        }
+        REQUIRE(idx.GroupedSearch(*query_ds, json, nullptr, nullptr).error() == knowhere::Status::invalid_args);
+    }
+
+    SECTION("Test mixed search") {
+        using std::make_tuple;
+        auto [name, gen] = GENERATE_REF(table<std::string, std::function<knowhere::Json()>>({
+            make_tuple(knowhere::IndexEnum::INDEX_FAISS_IDMAP, flat_gen),
+            make_tuple(knowhere::IndexEnum::INDEX_FAISS_IVFFLAT, ivfflat_gen),
+            make_tuple(knowhere::IndexEnum::INDEX_HNSW, hnsw_gen),
+        }));
+        CAPTURE(name);
+        knowhere::Json json = gen();
+        auto idx = knowhere::IndexFactory::Instance().Create(name);
+        REQUIRE(idx.Build(*train_ds, json) == knowhere::Status::success);
+
+        auto bitset_data = GenerateBitsetWithRandomTbitsSet(nb, nb / 2);
+        std::vector<knowhere::BitsetView> filters{knowhere::BitsetView(bitset_data.data(), nb)};
+        knowhere::Json wide;
+        wide[knowhere::indexparam::NPROBE] = 16;
+        wide[knowhere::indexparam::EF] = 64;
+        std::vector<knowhere::Json> params{wide};
+        // the first queries are one run of the batch, the others alternate between groups
+        std::vector<knowhere::MixedQuery> queries(nq);
+        for (int64_t i = 0; i < nq; ++i) {
+            queries[i].k = i < 4 ? topk : 1 + i % 3;
+            queries[i].filter = i < 4 || i % 2 ? -1 : 0;
+            queries[i].params = i >= 4 && i % 3 == 0 ? 0 : -1;
+        }
+        auto results = idx.MixedSearch(*query_ds, json, queries, filters, params);
+        REQUIRE(results.has_value());
+        auto lims = results.value()->GetLims();
+        auto ids = results.value()->GetIds();
+        auto distances = results.value()->GetDistance();
+        REQUIRE(lims[0] == 0);
+        for (int64_t i = 0; i < nq; ++i) {
+            auto& q = queries[i];
+            REQUIRE(lims[i + 1] - lims[i] == static_cast<size_t>(q.k));
+            // the same as a search of the query alone
+            knowhere::Json query_json = json;
+            if (q.params >= 0) {
+                query_json.update(params[q.params]);
+            }
+            query_json[knowhere::meta::TOPK] = q.k;
+            auto one = knowhere::GenDataSet(1, dim, (const float*)query_ds->GetTensor() + i * dim);
+            auto alone = idx.Search(*one, query_json, q.filter >= 0 ? filters[q.filter] : nullptr);
+            REQUIRE(alone.has_value());
+            for (int64_t j = 0; j < q.k; ++j) {
+                CHECK(ids[lims[i] + j] == alone.value()->GetIds()[j]);
+                CHECK(distances[lims[i] + j] == Approx(alone.value()->GetDistance()[j]));
+            }
+        }
+
+        queries[nq - 1].filter = 1;
+        REQUIRE(idx.MixedSearch(*query_ds, json, queries, filters, params).error() ==
+                knowhere::Status::invalid_args);
+    }
+
+    SECTION("Test HNSW build from a kNN graph") {
+        auto name = GENERATE(as<std::string>{}, knowhere::IndexEnum::INDEX_HNSW, knowhere::IndexEnum::INDEX_HNSW_SQ8);
+        CAPTURE(name);
+        knowhere::Json json = hnsw_gen();
+        json[knowhere::indexparam::HNSW_M] = 16;
+        auto idx = knowhere::IndexFactory::Instance().Create(name);
+        json[knowhere::indexparam::KNN_GRAPH] = "UNKNOWN";
+        REQUIRE(idx.Build(*train_ds, json) == knowhere::Status::invalid_args);
+        json[knowhere::indexparam::KNN_GRAPH] = "NN_DESCENT";
+        REQUIRE(idx.Build(*train_ds, json) == knowhere::Status::success);
+        REQUIRE(idx.Count() == nb);
+        auto results = idx.Search(*query_ds, json, nullptr);
+        REQUIRE(results.has_value());
+        REQUIRE(GetKNNRecall(*gt.value(), *results.value()) >= kKnnRecallThreshold);
+
+        // inserts after the build go on through the graph
+        REQUIRE(idx.Add(*train_ds, json) == knowhere::Status::success);
+        REQUIRE(idx.Count() == 2 * nb);
+    }
+
+    SECTION("Test auto tune") {
+        using std::make_tuple;
+        auto [name, gen, param] = GENERATE_REF(table<std::string, std::function<knowhere::Json()>, std::string>({
+            make_tuple(knowhere::IndexEnum::INDEX_HNSW, hnsw_gen, knowhere::indexparam::EF),
+            make_tuple(knowhere::IndexEnum::INDEX_FAISS_IVFFLAT, ivfflat_gen, knowhere::indexparam::NPROBE),
+        }));
+        CAPTURE(name);
+        knowhere::Json json = gen();
+        json.erase(param);
+        auto idx = knowhere::IndexFactory::Instance().Create(name);
+        REQUIRE(idx.Build(*train_ds, json) == knowhere::Status::success);
+        auto tuned = knowhere::AutoTune::Tune(idx, train_ds, query_ds, json, {0.95f, 0.5f});
+        REQUIRE(tuned.has_value());
+        auto& table = tuned.value();
+        REQUIRE(table.size() >= 1);
+        REQUIRE(table.size() <= 2);
+        REQUIRE(table.back()["recall"].get<float>() >= 0.95f);
+        REQUIRE(idx.SetTunedParams(table) == knowhere::Status::success);
+
+        // the params of the table stand in for the ones the search does not set
+        json[knowhere::meta::TARGET_RECALL] = 0.95;
+        auto results = idx.Search(*query_ds, json, nullptr);
+        REQUIRE(results.has_value());
+        REQUIRE(GetKNNRecall(*gt.value(), *results.value()) >= 0.95f);
+
+        knowhere::BinarySet bs;
+        REQUIRE(idx.Serialize(bs) == knowhere::Status::success);
+        REQUIRE(bs.Contains("tuned_params"));
+        auto idx_ = knowhere::IndexFactory::Instance().Create(name);
+        REQUIRE(idx_.Deserialize(bs, json) == knowhere::Status::success);
+        REQUIRE(idx_.TunedParams() == idx.TunedParams());
+
+        json[knowhere::meta::TARGET_RECALL] = 2;
+        REQUIRE(idx_.Search(*query_ds, json, nullptr).error() == knowhere::Status::out_of_range_in_json);
+        auto flat = knowhere::IndexFactory::Instance().Create(knowhere::IndexEnum::INDEX_FAISS_IDMAP);
+        REQUIRE(knowhere::AutoTune::Tune(flat, train_ds, query_ds, base_gen(), {0.9f}).error() ==
+                knowhere::Status::not_implemented);
+    }
+
+    SECTION("Test query planner") {
+        using Plan = knowhere::QueryPlanner::Plan;
+        knowhere::Json json = hnsw_gen();
+        auto idx = knowhere::IndexFactory::Instance().Create(knowhere::IndexEnum::INDEX_HNSW);
+        REQUIRE(idx.Build(*train_ds, json) == knowhere::Status::success);
+
+        // a filter keeping a handful of rows goes to the scan of the alive rows, as exact as the brute force one
+        auto bitset_data = GenerateBitsetWithRandomTbitsSet(nb, nb - 3);
+        knowhere::BitsetView bitset(bitset_data.data(), nb);
+        REQUIRE(knowhere::QueryPlanner::Choose(idx, true, nq, json, bitset) == Plan::kBruteForceAliveIds);
+        auto filtered_gt = knowhere::BruteForce::Search(train_ds, query_ds, json, bitset);
+        REQUIRE(filtered_gt.has_value());
+        auto results = knowhere::QueryPlanner::Search(idx, train_ds, query_ds, json, bitset);
+        REQUIRE(results.has_value());
+        REQUIRE(std::equal(results.value()->GetIds(), results.value()->GetIds() + nq * topk,
+                           filtered_gt.value()->GetIds()));
+        if (idx.HasRawData(metric)) {
+            REQUIRE(knowhere::QueryPlanner::Choose(idx, false, nq, json, bitset) == Plan::kBruteForceAliveIds);
+            results = knowhere::QueryPlanner::Search(idx, nullptr, query_ds, json, bitset);
+            REQUIRE(results.has_value());
+            REQUIRE(std::equal(results.value()->GetIds(), results.value()->GetIds() + nq * topk,
+                               filtered_gt.value()->GetIds()));
+        }
+
+        // without a filter the model picks between the graph and the scan of all the rows
+        auto model = knowhere::QueryPlanner::GetCostModel();
+        auto cheap_graph = model;
+        cheap_graph.index_per_query = 0;
+        cheap_graph.random_access = 0;
+        cheap_graph.graph_distances_per_candidate = 1;
+        knowhere::QueryPlanner::SetCostModel(cheap_graph);
+        REQUIRE(knowhere::QueryPlanner::Choose(idx, true, nq, json, nullptr) == Plan::kIndex);
+        results = knowhere::QueryPlanner::Search(idx, train_ds, query_ds, json, nullptr);
+        REQUIRE(results.has_value());
+        REQUIRE(GetKNNRecall(*gt.value(), *results.value()) >= kKnnRecallThreshold);
+        auto costly_graph = model;
+        costly_graph.index_per_query = 1e9;
+        knowhere::QueryPlanner::SetCostModel(costly_graph);
+        REQUIRE(knowhere::QueryPlanner::Choose(idx, true, nq, json, nullptr) == Plan::kBruteForce);
+        REQUIRE(knowhere::QueryPlanner::Choose(idx, false, nq, json, nullptr) == Plan::kIndex);
+        results = knowhere::QueryPlanner::Search(idx, train_ds, query_ds, json, nullptr);
+        REQUIRE(results.has_value());
+        REQUIRE(GetKNNRecall(*gt.value(), *results.value()) == 1.0f);
+
+        auto calibrated = knowhere::QueryPlanner::Calibrate();
+        REQUIRE(calibrated.distance_per_dim > 0);
+        REQUIRE(calibrated.bitset_per_id > 0);
+        REQUIRE(calibrated.index_per_query == costly_graph.index_per_query);
+        knowhere::QueryPlanner::SetCostModel(model);
+
+        // the index types the model knows nothing of always go to the index
+        auto sparse = knowhere::IndexFactory::Instance().Create(knowhere::IndexEnum::INDEX_SPARSE_INVERTED_INDEX);
+        REQUIRE(knowhere::QueryPlanner::Choose(sparse, true, nq, json, bitset) == Plan::kIndex);
+    }
+
+    SECTION("Test recall monitor") {
+        using std::make_tuple;
+        auto [name, gen] = GENERATE_REF(table<std::string, std::function<knowhere::Json()>>({
+            make_tuple(knowhere::IndexEnum::INDEX_FAISS_IDMAP, flat_gen),
+            make_tuple(knowhere::IndexEnum::INDEX_HNSW, hnsw_gen),
+        }));
+        CAPTURE(name);
+        knowhere::Json json = gen();
+        auto idx = knowhere::IndexFactory::Instance().Create(name);
+        REQUIRE(idx.Build(*train_ds, json) == knowhere::Status::success);
+        auto monitor = std::make_shared<knowhere::RecallMonitor>(train_ds, 1.0f, "test_" + name);
+        REQUIRE(monitor->Recall() == -1.0f);
+        idx.SetRecallMonitor(monitor);
+        REQUIRE(idx.GetRecallMonitor() == monitor);
+
+        auto results = idx.Search(*query_ds, json, nullptr);
+        REQUIRE(results.has_value());
+        monitor->Wait();
+        REQUIRE(monitor->Samples() == nq);
+        auto recall = GetKNNRecall(*gt.value(), *results.value());
+        REQUIRE(monitor->Recall() == Catch::Approx(recall));
+        if (name == knowhere::IndexEnum::INDEX_FAISS_IDMAP) {
+            REQUIRE(monitor->Recall() == 1.0f);
+        }
+
+        // the filtered searches are measured against the filtered brute force ones
+        auto bitset_data = GenerateBitsetWithRandomTbitsSet(nb, nb / 2);
+        knowhere::BitsetView bitset(bitset_data.data(), nb);
+        REQUIRE(idx.Search(*query_ds, json, bitset).has_value());
+        monitor->Wait();
+        REQUIRE(monitor->Samples() == 2 * nq);
+        REQUIRE(monitor->Recall() >= kKnnRecallThreshold);
+
+        idx.SetRecallMonitor(nullptr);
+        REQUIRE(idx.Search(*query_ds, json, nullptr).has_value());
+        monitor->Wait();
+        REQUIRE(monitor->Samples() == 2 * nq);
+    }
+
+    SECTION("Test k-means|| clustering") {
+        knowhere::KnowhereConfig::SetClusteringType(knowhere::KnowhereConfig::ClusteringType::K_MEANS_PARALLEL);
+        knowhere::Json json = ivfflat_gen();
+        auto idx = knowhere::IndexFactory::Instance().Create(knowhere::IndexEnum::INDEX_FAISS_IVFFLAT);
+        auto status = idx.Build(*train_ds, json);
+        knowhere::KnowhereConfig::SetClusteringType(knowhere::KnowhereConfig::ClusteringType::K_MEANS);
+        REQUIRE(status == knowhere::Status::success);
+        auto results = idx.Search(*query_ds, json, nullptr);
+        REQUIRE(results.has_value());
+        REQUIRE(GetKNNRecall(*gt.value(), *results.value()) >= kKnnRecallThreshold);
+    }
+
+    SECTION("Test IVF k-means training options") {
+        using std::make_tuple;
+        auto [name, gen] = GENERATE_REF(table<std::string, std::function<knowhere::Json()>>({
+            make_tuple(knowhere::IndexEnum::INDEX_FAISS_IVFFLAT_CC, ivfflatcc_gen),
+            make_tuple(knowhere::IndexEnum::INDEX_FAISS_IVFSQ8, ivfsq_gen),
+            make_tuple(knowhere::IndexEnum::INDEX_FAISS_SCANN, scann_gen),
+        }));
+        // warm start from the first nlist rows, a file of the wrong size falls back to random points
+        auto centroids_rows = GENERATE(as<int64_t>{}, 16, 15);
+        auto path = std::filesystem::current_path().string() + "/ivf_centroids";
+        {
+            std::ofstream writer(path, std::ios::binary);
+            writer.write((const char*)train_ds->GetTensor(), centroids_rows * dim * sizeof(float));
+        }
+        knowhere::Json json = gen();
+        json[knowhere::indexparam::MAX_POINTS_PER_CENTROID] = 40;
+        json[knowhere::indexparam::CENTROIDS_FILE] = path;
+        CAPTURE(name, centroids_rows);
+        auto idx = knowhere::IndexFactory::Instance().Create(name);
+        // the seeding of k-means++ does not start from given centroids
+        knowhere::KnowhereConfig::SetClusteringType(knowhere::KnowhereConfig::ClusteringType::K_MEANS_PLUS_PLUS);
+        REQUIRE(idx.Build(*train_ds, json) == knowhere::Status::invalid_args);
+        knowhere::KnowhereConfig::SetClusteringType(knowhere::KnowhereConfig::ClusteringType::K_MEANS);
+        REQUIRE(idx.Build(*train_ds, json) == knowhere::Status::success);
+        std::filesystem::remove(path);
+        REQUIRE(idx.Count() == nb);
+        auto results = idx.Search(*query_ds, json, nullptr);
+        REQUIRE(results.has_value());
+        REQUIRE(GetKNNRecall(*gt.value(), *results.value()) > kKnnRecallThreshold);
+    }
+
+    SECTION("Test HNSW with quantized level 0") {
+        auto sq_type = GENERATE(as<std::string>{}, "SQ8", "FP16");
+        auto refine = GENERATE(true, false);
+        knowhere::Json json = hnsw_gen();
+        json[knowhere::indexparam::SQ_TYPE] = sq_type;
+        json[knowhere::indexparam::REFINE] = refine;
+        CAPTURE(sq_type, refine);
+
+        auto idx = knowhere::IndexFactory::Instance().Create(knowhere::IndexEnum::INDEX_HNSW);
+        REQUIRE(idx.Build(*train_ds, json) == knowhere::Status::success);
+        REQUIRE(idx.HasRawData(metric) == refine);
+        auto results = idx.Search(*query_ds, json, nullptr);
+        REQUIRE(results.has_value());
+        REQUIRE(GetKNNRecall(*gt.value(), *results.value()) > kKnnRecallThreshold);
+
+        knowhere::BinarySet bs;
+        REQUIRE(idx.Serialize(bs) == knowhere::Status::success);
+        auto idx_ = knowhere::IndexFactory::Instance().Create(knowhere::IndexEnum::INDEX_HNSW);
+        REQUIRE(idx_.Deserialize(bs) == knowhere::Status::success);
+        REQUIRE(idx_.HasRawData(metric) == refine);
+        auto results_ = idx_.Search(*query_ds, json, nullptr);
+        REQUIRE(results_.has_value());
+        auto ids = results.value()->GetIds();
+        auto ids_ = results_.value()->GetIds();
+        for (int i = 0; i < nq * topk; ++i) {
+            CHECK(ids[i] == ids_[i]);
+        }
+
+        if (refine) {
+            std::vector<int64_t> ids_v(nq);
+            for (int i = 0; i < nq; ++i) {
+                ids_v[i] = i;
+            }
+            auto vectors = idx_.GetVectorByIds(*GenIdsDataSet(nq, ids_v));
+            REQUIRE(vectors.has_value());
+            auto xb = (const float*)train_ds->GetTensor();
+            auto xv = (const float*)vectors.value()->GetTensor();
+            for (int i = 0; i < nq * dim; ++i) {
+                REQUIRE(xv[i] == xb[i]);
+            }
+        }
+    }
+
+    SECTION("Test HNSW level 0 layout") {
+        auto sq_type = GENERATE(as<std::string>{}, "NONE", "SQ8");
+        knowhere::Json json = hnsw_gen();
+        json[knowhere::indexparam::SQ_TYPE] = sq_type;
+        json[knowhere::indexparam::ALIGN_LEVEL0] = true;
+        CAPTURE(sq_type);
+
+        auto idx = knowhere::IndexFactory::Instance().Create(knowhere::IndexEnum::INDEX_HNSW);
+        REQUIRE(idx.Build(*train_ds, json) == knowhere::Status::success);
+        auto results = idx.Search(*query_ds, json, nullptr);
+        REQUIRE(results.has_value());
+        knowhere::BinarySet bs;
+        REQUIRE(idx.Serialize(bs) == knowhere::Status::success);
+
+        // load densely re-packed, and as stored
+        for (bool aligned : {false, true}) {
+            knowhere::Json load_json;
+            load_json[knowhere::indexparam::ALIGN_LEVEL0] = aligned;
+            REQUIRE(idx.Deserialize(bs, load_json) == knowhere::Status::success);
+            auto results_ = idx.Search(*query_ds, json, nullptr);
+            REQUIRE(results_.has_value());
+            auto ids = results.value()->GetIds();
+            auto ids_ = results_.value()->GetIds();
+            for (int i = 0; i < nq * topk; ++i) {
+                CHECK(ids[i] == ids_[i]);
+            }
+        }
+    }
+
+    SECTION("Test HNSW compressed links") {
+        auto reorder = GENERATE(as<std::string>{}, "NONE", "RCM");
+        knowhere::Json json = hnsw_gen();
+        json[knowhere::indexparam::REORDER] = reorder;
+        CAPTURE(reorder);
+
+        auto idx = knowhere::IndexFactory::Instance().Create(knowhere::IndexEnum::INDEX_HNSW);
+        REQUIRE(idx.Build(*train_ds, json) == knowhere::Status::success);
+        auto results = idx.Search(*query_ds, json, nullptr);
+        REQUIRE(results.has_value());
+        auto range_results = idx.RangeSearch(*query_ds, json, nullptr);
+        REQUIRE(range_results.has_value());
+        auto graph = idx.GetMemoryUsage().bytes[knowhere::MemoryUsage::kGraph][knowhere::MemoryUsage::kHeap];
+        knowhere::BinarySet bs;
+        REQUIRE(idx.Serialize(bs) == knowhere::Status::success);
+
+        // the same walks over smaller lists, stored back as they were
+        knowhere::Json load_json;
+        load_json[knowhere::indexparam::COMPRESS_LINKS] = true;
+        auto compressed = knowhere::IndexFactory::Instance().Create(knowhere::IndexEnum::INDEX_HNSW);
+        REQUIRE(compressed.Deserialize(bs, load_json) == knowhere::Status::success);
+        CHECK(compressed.GetMemoryUsage().bytes[knowhere::MemoryUsage::kGraph][knowhere::MemoryUsage::kHeap] < graph);
+        auto results_ = compressed.Search(*query_ds, json, nullptr);
+        REQUIRE(results_.has_value());
+        auto ids = results.value()->GetIds();
+        auto ids_ = results_.value()->GetIds();
+        for (int i = 0; i < nq * topk; ++i) {
+            CHECK(ids[i] == ids_[i]);
+        }
+        auto range_results_ = compressed.RangeSearch(*query_ds, json, nullptr);
+        REQUIRE(range_results_.has_value());
+        auto lims = range_results.value()->GetLims();
+        auto lims_ = range_results_.value()->GetLims();
+        for (int i = 0; i <= nq; ++i) {
+            CHECK(lims[i] == lims_[i]);
+        }
+        CHECK(compressed.Add(*train_ds, json) == knowhere::Status::not_implemented);
+
+        knowhere::BinarySet bs_;
+        REQUIRE(compressed.Serialize(bs_) == knowhere::Status::success);
+        REQUIRE(idx.Deserialize(bs_) == knowhere::Status::success);
+        auto reloaded = idx.Search(*query_ds, json, nullptr);
+        REQUIRE(reloaded.has_value());
+        auto reloaded_ids = reloaded.value()->GetIds();
+        for (int i = 0; i < nq * topk; ++i) {
+            CHECK(ids[i] == reloaded_ids[i]);
+        }
+    }
+
+    SECTION("Test HNSW sampled query trace") {
+        knowhere::Json json = hnsw_gen();
+        auto idx = knowhere::IndexFactory::Instance().Create(knowhere::IndexEnum::INDEX_HNSW);
+        REQUIRE(idx.Build(*train_ds, json) == knowhere::Status::success);
+
+        uint64_t cursor = 0;
+        knowhere::QueryTraceBuffer::Instance().Read(cursor);
+        json[knowhere::meta::TRACE_SAMPLE_RATE] = 1.0;
+        auto traced = idx.Search(*query_ds, json, nullptr);
+        REQUIRE(traced.has_value());
+        REQUIRE(GetKNNRecall(*gt.value(), *traced.value()) > kKnnRecallThreshold);
+        auto traces = knowhere::QueryTraceBuffer::Instance().Read(cursor);
+        REQUIRE(traces.size() == (size_t)nq);
+        std::set<int64_t> queries;
+        for (const auto& trace : traces) {
+            CHECK(std::string(trace.index_type) == knowhere::IndexEnum::INDEX_HNSW);
+            CHECK(trace.stats.hops > 0);
+            CHECK(trace.stats.distance_computations > 0);
+            queries.insert(trace.query);
+        }
+        CHECK(queries.size() == (size_t)nq);
+    }
+
+    SECTION("Test HNSW graph reordering") {
+        auto reorder = GENERATE(as<std::string>{}, "BFS", "RCM", "GORDER");
+        auto sq_type = GENERATE(as<std::string>{}, "NONE", "SQ8");
+        knowhere::Json json = hnsw_gen();
+        json[knowhere::indexparam::REORDER] = reorder;
+        json[knowhere::indexparam::SQ_TYPE] = sq_type;
+        json[knowhere::indexparam::REFINE] = true;
+        CAPTURE(reorder, sq_type);
+
+        auto idx = knowhere::IndexFactory::Instance().Create(knowhere::IndexEnum::INDEX_HNSW);
+        REQUIRE(idx.Build(*train_ds, json) == knowhere::Status::success);
+        auto results = idx.Search(*query_ds, json, nullptr);
+        REQUIRE(results.has_value());
+        REQUIRE(GetKNNRecall(*gt.value(), *results.value()) > kKnnRecallThreshold);
+
+        // labels, not internal ids, are filtered and returned
+        auto bitset_data = GenerateBitsetWithRandomTbitsSet(nb, nb * 0.4);
+        knowhere::BitsetView bitset(bitset_data.data(), nb);
+        auto filtered = idx.Search(*query_ds, json, bitset);
+        REQUIRE(filtered.has_value());
+        auto filtered_gt = knowhere::BruteForce::Search(train_ds, query_ds, json, bitset);
+        REQUIRE(GetKNNRecall(*filtered_gt.value(), *filtered.value()) > kKnnRecallThreshold);
+        auto filtered_ids = filtered.value()->GetIds();
+        for (int i = 0; i < nq * topk; ++i) {
+            REQUIRE((filtered_ids[i] == -1 || !bitset.test(filtered_ids[i])));
+        }
+
+        auto range_results = idx.RangeSearch(*query_ds, json, nullptr);
+        REQUIRE(range_results.has_value());
+        auto range_ids = range_results.value()->GetIds();
+        auto lims = range_results.value()->GetLims();
+        for (int i = 0; i < nq; ++i) {
+            CHECK(range_ids[lims[i]] == i);
+        }
+
+        std::vector<int64_t> ids_v(nq);
+        for (int i = 0; i < nq; ++i) {
+            ids_v[i] = i;
+        }
+        auto vectors = idx.GetVectorByIds(*GenIdsDataSet(nq, ids_v));
+        REQUIRE(vectors.has_value());
+        auto xb = (const float*)train_ds->GetTensor();
+        auto xv = (const float*)vectors.value()->GetTensor();
+        for (int i = 0; i < nq * dim; ++i) {
+            REQUIRE(xv[i] == xb[i]);
+        }
+        std::vector<int64_t> bad_ids = {nb};
+        REQUIRE_FALSE(idx.GetVectorByIds(*GenIdsDataSet(bad_ids.size(), bad_ids)).has_value());
+
+        knowhere::BinarySet bs;
+        REQUIRE(idx.Serialize(bs) == knowhere::Status::success);
+        auto idx_ = knowhere::IndexFactory::Instance().Create(knowhere::IndexEnum::INDEX_HNSW);
+        REQUIRE(idx_.Deserialize(bs) == knowhere::Status::success);
+        auto results_ = idx_.Search(*query_ds, json, nullptr);
+        REQUIRE(results_.has_value());
+        auto ids = results.value()->GetIds();
+        auto ids_ = results_.value()->GetIds();
+        for (int i = 0; i < nq * topk; ++i) {
+            CHECK(ids[i] == ids_[i]);
+        }
+    }
+
+    SECTION("Test HNSW graph reordering on load") {
+        knowhere::Json json = hnsw_gen();
+        auto idx = knowhere::IndexFactory::Instance().Create(knowhere::IndexEnum::INDEX_HNSW);
+        REQUIRE(idx.Build(*train_ds, json) == knowhere::Status::success);
+        knowhere::BinarySet bs;
+        REQUIRE(idx.Serialize(bs) == knowhere::Status::success);
+
+        knowhere::Json load_json;
+        load_json[knowhere::indexparam::REORDER] = "RCM";
+        REQUIRE(idx.Deserialize(bs, load_json) == knowhere::Status::success);
+        auto results = idx.Search(*query_ds, json, nullptr);
+        REQUIRE(results.has_value());
+        REQUIRE(GetKNNRecall(*gt.value(), *results.value()) > kKnnRecallThreshold);
+
+        load_json[knowhere::indexparam::REORDER] = "DFS";
+        REQUIRE(idx.Deserialize(bs, load_json) == knowhere::Status::invalid_args);
+    }
+
+    SECTION("Test HNSW incremental add and delete") {
+        knowhere::Json json = hnsw_gen();
+        auto idx = knowhere::IndexFactory::Instance().Create(knowhere::IndexEnum::INDEX_HNSW);
+        const int64_t half = nb / 2;
+        auto tensor = (const float*)train_ds->GetTensor();
+        REQUIRE(idx.Build(*knowhere::GenDataSet(half, dim, tensor), json) == knowhere::Status::success);
+        REQUIRE(idx.Add(*knowhere::GenDataSet(nb - half, dim, tensor + half * dim), json) ==
+                knowhere::Status::success);
+        REQUIRE(idx.Count() == nb);
+        auto results = idx.Search(*query_ds, json, nullptr);
+        REQUIRE(results.has_value());
+        REQUIRE(GetKNNRecall(*gt.value(), *results.value()) > kKnnRecallThreshold);
+
+        // deleting ids is the same as filtering them out, before and after the links to them are repaired
+        std::vector<uint8_t> bitset_data((nb + 7) / 8, 0);
+        knowhere::BitsetView bitset(bitset_data.data(), nb);
+        for (int64_t step : {64, 4}) {
+            std::vector<int64_t> ids;
+            for (int64_t i = 0; i < nb; i += step) {
+                ids.push_back(i);
+                bitset_data[i >> 3] |= 0x1 << (i & 0x7);
+            }
+            REQUIRE(idx.DeleteByIds(*GenIdsDataSet(ids.size(), ids)) == knowhere::Status::success);
+            auto gt_deleted = knowhere::BruteForce::Search(train_ds, query_ds, json, bitset);
+            results = idx.Search(*query_ds, json, nullptr);
+            REQUIRE(results.has_value());
+            REQUIRE(GetKNNRecall(*gt_deleted.value(), *results.value()) > kKnnRecallThreshold);
+            for (int64_t i = 0; i < nq * topk; i++) {
+                auto id = results.value()->GetIds()[i];
+                REQUIRE((id < 0 || !bitset.test(id)));
+            }
+        }
+
+        knowhere::BinarySet bs;
+        REQUIRE(idx.Serialize(bs) == knowhere::Status::success);
+        REQUIRE(idx.Deserialize(bs, json) == knowhere::Status::success);
+        auto gt_deleted = knowhere::BruteForce::Search(train_ds, query_ds, json, bitset);
+        results = idx.Search(*query_ds, json, nullptr);
+        REQUIRE(results.has_value());
+        REQUIRE(GetKNNRecall(*gt_deleted.value(), *results.value()) > kKnnRecallThreshold);
+
+        std::vector<int64_t> bad_ids = {nb};
+        REQUIRE(idx.DeleteByIds(*GenIdsDataSet(bad_ids.size(), bad_ids)) == knowhere::Status::invalid_args);
+    }
+
+    SECTION("Test HNSW delete of a whole neighborhood") {
+        // an element away from the others among a tight cluster: its neighbors and theirs are all in the cluster
+        const int64_t cluster = 20;
+        knowhere::Json json = hnsw_gen();
+        json[knowhere::indexparam::HNSW_M] = 4;
+        auto tensor = (const float*)train_ds->GetTensor();
+        std::vector<float> data(tensor, tensor + nb * dim);
+        std::vector<float> center(dim, 0.0f);
+        center[0] = 1000.0f;
+        for (int64_t i = 0; i < cluster; i++) {
+            data.insert(data.end(), center.begin(), center.end());
+            data[(nb + i) * dim + 1 + i] = 1.0f;
+        }
+        data.insert(data.end(), center.begin(), center.end());
+        const int64_t target = nb + cluster;
+        auto idx = knowhere::IndexFactory::Instance().Create(knowhere::IndexEnum::INDEX_HNSW);
+        REQUIRE(idx.Build(*knowhere::GenDataSet(target + 1, dim, data.data()), json) == knowhere::Status::success);
+
+        // enough other deletes for the links to the deleted elements to be repaired
+        std::vector<int64_t> ids;
+        for (int64_t i = 0; i < cluster; i++) {
+            ids.push_back(nb + i);
+        }
+        for (int64_t i = 0; i < nb; i += 8) {
+            ids.push_back(i);
+        }
+        REQUIRE(idx.DeleteByIds(*GenIdsDataSet(ids.size(), ids)) == knowhere::Status::success);
+        auto results = idx.Search(*knowhere::GenDataSet(1, dim, center.data()), json, nullptr);
+        REQUIRE(results.has_value());
+        REQUIRE(results.value()->GetIds()[0] == target);
+    }
+
+    SECTION("Test Index Merge") {
+        using std::make_tuple;
+        auto [name, gen] = GENERATE_REF(table<std::string, std::function<knowhere::Json()>>({
+            make_tuple(knowhere::IndexEnum::INDEX_FAISS_IVFFLAT, ivfflat_gen),
+            make_tuple(knowhere::IndexEnum::INDEX_FAISS_IVFFLAT_CC, ivfflatcc_gen),
+            make_tuple(knowhere::IndexEnum::INDEX_FAISS_IVFSQ8, ivfsq_gen),
+            make_tuple(knowhere::IndexEnum::INDEX_FAISS_IVFPQ, ivfpq_gen),
+            make_tuple(knowhere::IndexEnum::INDEX_FAISS_SCANN, scann_gen),
+            make_tuple(knowhere::IndexEnum::INDEX_FAISS_SCANN, scann_sq8_gen),
+            make_tuple(knowhere::IndexEnum::INDEX_FAISS_IVFRABITQ, ivf_rabitq_gen),
+            make_tuple(knowhere::IndexEnum::INDEX_HNSW, hnsw_gen),
+            make_tuple(knowhere::IndexEnum::INDEX_HNSW, hnsw_sq8_gen),
+        }));
+        auto cfg_json = gen().dump();
+        CAPTURE(name, cfg_json);
+        knowhere::Json json = knowhere::Json::parse(cfg_json);
+        bool is_ivf = name != knowhere::IndexEnum::INDEX_HNSW;
+        auto tensor = (const float*)train_ds->GetTensor();
+        const std::vector<int64_t> begins = {0, 400, 700, nb};
+
+        // the segments of an IVF share the quantizer trained once, a copy of which each of them is added to
+        auto trained = knowhere::IndexFactory::Instance().Create(name);
+        if (is_ivf) {
+            REQUIRE(trained.Train(*train_ds, json) == knowhere::Status::success);
+        }
+        auto trained_copy = [&]() {
+            knowhere::BinarySet bs;
+            REQUIRE(trained.Serialize(bs) == knowhere::Status::success);
+            if (name == knowhere::IndexEnum::INDEX_FAISS_IVFFLAT) {
+                bs.Append("RAW_DATA", std::make_shared<knowhere::Binary>());
+            }
+            auto copy = knowhere::IndexFactory::Instance().Create(name);
+            REQUIRE(copy.Deserialize(bs, json) == knowhere::Status::success);
+            return copy;
+        };
+        std::vector<knowhere::Index<knowhere::IndexNode>> segments;
+        for (size_t i = 0; i + 1 < begins.size(); ++i) {
+            auto rows = begins[i + 1] - begins[i];
+            auto part = knowhere::GenDataSet(rows, dim, tensor + begins[i] * dim);
+            if (is_ivf) {
+                segments.push_back(trained_copy());
+                REQUIRE(segments.back().Add(*part, json) == knowhere::Status::success);
+            } else {
+                segments.push_back(knowhere::IndexFactory::Instance().Create(name));
+                REQUIRE(segments.back().Build(*part, json) == knowhere::Status::success);
+            }
+        }
+        auto merged = knowhere::Index<knowhere::IndexNode>(segments[0]);
+        std::vector<knowhere::Index<knowhere::IndexNode>> others(segments.begin() + 1, segments.end());
+        REQUIRE(merged.Merge(others, json) == knowhere::Status::success);
+        REQUIRE(merged.Count() == nb);
+        // the others are left as they are
+        REQUIRE(others[0].Count() == begins[2] - begins[1]);
+        if (name == knowhere::IndexEnum::INDEX_FAISS_IVFFLAT) {
+            load_raw_data(merged, *train_ds, json);
+        }
+        auto results = merged.Search(*query_ds, json, nullptr);
+        REQUIRE(results.has_value());
+
+        if (is_ivf) {
+            // the merged lists hold what adding all the rows to one segment would
+            auto whole = trained_copy();
+            REQUIRE(whole.Add(*train_ds, json) == knowhere::Status::success);
+            if (name == knowhere::IndexEnum::INDEX_FAISS_IVFFLAT) {
+                load_raw_data(whole, *train_ds, json);
+            }
+            auto expected = whole.Search(*query_ds, json, nullptr);
+            REQUIRE(expected.has_value());
+            for (int64_t i = 0; i < nq * topk; ++i) {
+                REQUIRE(results.value()->GetIds()[i] == expected.value()->GetIds()[i]);
+            }
+
+            // a segment trained apart assigns the rows to other lists
+            auto apart = knowhere::IndexFactory::Instance().Create(name);
+            REQUIRE(apart.Build(*knowhere::GenDataSet(begins[1], dim, tensor), json) == knowhere::Status::success);
+            REQUIRE(merged.Merge({apart}, json) == knowhere::Status::invalid_args);
+        } else {
+            REQUIRE(GetKNNRecall(*gt.value(), *results.value()) > kKnnRecallThreshold);
+        }
+        auto flat = knowhere::IndexFactory::Instance().Create(knowhere::IndexEnum::INDEX_FAISS_IDMAP);
+        REQUIRE(flat.Build(*train_ds, base_gen()) == knowhere::Status::success);
+        REQUIRE(merged.Merge({flat}, json) == knowhere::Status::invalid_args);
+        REQUIRE(merged.Count() == nb);
+    }
+
+    SECTION("Test chunked build") {
+        using std::make_tuple;
+        auto [name, gen] = GENERATE_REF(table<std::string, std::function<knowhere::Json()>>({
+            make_tuple(knowhere::IndexEnum::INDEX_FAISS_IDMAP, flat_gen),
+            make_tuple(knowhere::IndexEnum::INDEX_FAISS_IVFFLAT_CC, ivfflatcc_gen),
+            make_tuple(knowhere::IndexEnum::INDEX_FAISS_IVFSQ8, ivfsq_gen),
+            make_tuple(knowhere::IndexEnum::INDEX_HNSW, hnsw_gen),
+        }));
+        auto with_sample = GENERATE(true, false);
+        knowhere::Json json = gen();
+        CAPTURE(name, with_sample, json.dump());
+        auto tensor = (const float*)train_ds->GetTensor();
+        const int64_t chunk_rows = 300;
+        int64_t produced = 0;
+        auto producer = [&]() -> knowhere::DataSetPtr {
+            if (produced >= nb) {
+                return nullptr;
+            }
+            auto rows = std::min(chunk_rows, nb - produced);
+            auto chunk = knowhere::GenDataSet(rows, dim, tensor + produced * dim);
+            produced += rows;
+            return chunk;
+        };
+        auto idx = knowhere::IndexFactory::Instance().Create(name);
+        REQUIRE(idx.BuildChunked(producer, json, with_sample ? train_ds.get() : nullptr) == knowhere::Status::success);
+        REQUIRE(idx.Count() == nb);
+        auto results = idx.Search(*query_ds, json, nullptr);
+        REQUIRE(results.has_value());
+        REQUIRE(GetKNNRecall(*gt.value(), *results.value()) > kKnnRecallThreshold);
+
+        auto empty = knowhere::IndexFactory::Instance().Create(name);
+        REQUIRE(empty.BuildChunked([] { return nullptr; }, json) == knowhere::Status::empty_index);
+        auto failing = knowhere::IndexFactory::Instance().Create(name);
+        REQUIRE(failing.BuildChunked([]() -> knowhere::DataSetPtr { throw std::runtime_error("unreachable"); }, json) ==
+                knowhere::Status::invalid_args);
+    }
+
+    SECTION("Test typed vectors") {
+        // the rows are integers in [0, 100], which FP16, BF16 and INT8 all hold exactly
+        auto type = GENERATE(knowhere::DataType::FP16, knowhere::DataType::BF16, knowhere::DataType::INT8,
+                             knowhere::DataType::UINT8);
+        auto to_type = [&](const knowhere::DataSet& ds) {
+            auto n = ds.GetRows() * dim;
+            auto xs = (const float*)ds.GetTensor();
+            auto data = std::make_shared<std::vector<uint8_t>>(n * knowhere::DataTypeSize(type));
+            switch (type) {
+                case knowhere::DataType::FP16:
+                    faiss::fvec_to_fp16((uint16_t*)data->data(), xs, n);
+                    break;
+                case knowhere::DataType::BF16:
+                    faiss::fvec_to_bf16((uint16_t*)data->data(), xs, n);
+                    break;
+                default:
+                    std::copy_n(xs, n, data->data());
+                    break;
+            }
+            return data;
+        };
+        auto train_data = to_type(*train_ds);
+        auto query_data = to_type(*query_ds);
+        auto typed_train = knowhere::GenDataSet(nb, dim, train_data->data(), type);
+        auto typed_query = knowhere::GenDataSet(nq, dim, query_data->data(), type);
+        bool is_cosine = knowhere::IsMetricType(metric, knowhere::metric::COSINE);
+        CAPTURE(static_cast<int>(type), metric);
+
+        knowhere::Json json = base_gen();
+        auto flat = knowhere::IndexFactory::Instance().Create(knowhere::IndexEnum::INDEX_FAISS_IDMAP);
+        REQUIRE(flat.Build(*typed_train, json) == knowhere::Status::success);
+        REQUIRE(flat.Count() == nb);
+        auto results = flat.Search(*typed_query, json, nullptr);
+        REQUIRE(results.has_value());
+        // the normalized rows of COSINE are stored as halves
+        if (is_cosine) {
+            REQUIRE(GetKNNRecall(*gt.value(), *results.value()) > kKnnRecallThreshold);
+        } else {
+            for (int64_t i = 0; i < nq * topk; ++i) {
+                REQUIRE(results.value()->GetDistance()[i] == Approx(gt.value()->GetDistance()[i]));
+            }
+        }
+        auto float_results = flat.Search(*query_ds, json, nullptr);
+        REQUIRE(float_results.has_value());
+        REQUIRE(GetKNNRecall(*results.value(), *float_results.value()) >= kBruteForceRecallThreshold);
+        auto range_results = flat.RangeSearch(*typed_query, json, nullptr);
+        REQUIRE(range_results.has_value());
+
+        knowhere::BinarySet bs;
+        REQUIRE(flat.Serialize(bs) == knowhere::Status::success);
+        auto loaded = knowhere::IndexFactory::Instance().Create(knowhere::IndexEnum::INDEX_FAISS_IDMAP);
+        REQUIRE(loaded.Deserialize(bs, json) == knowhere::Status::success);
+        auto loaded_results = loaded.Search(*typed_query, json, nullptr);
+        REQUIRE(loaded_results.has_value());
+        REQUIRE(std::equal(results.value()->GetIds(), results.value()->GetIds() + nq * topk,
+                           loaded_results.value()->GetIds()));
+
+        // HNSW reads floats only, Index converts the rows for it
+        knowhere::Json hnsw_json = hnsw_gen();
+        auto hnsw = knowhere::IndexFactory::Instance().Create(knowhere::IndexEnum::INDEX_HNSW);
+        REQUIRE(hnsw.Build(*typed_train, hnsw_json) == knowhere::Status::success);
+        auto hnsw_results = hnsw.Search(*typed_query, hnsw_json, nullptr);
+        REQUIRE(hnsw_results.has_value());
+        REQUIRE(GetKNNRecall(*gt.value(), *hnsw_results.value()) > kKnnRecallThreshold);
+    }
+
+    SECTION("Test HNSW with invalid sq_type") {
+        knowhere::Json json = hnsw_gen();
+        json[knowhere::indexparam::SQ_TYPE] = "PQ";
+        auto idx = knowhere::IndexFactory::Instance().Create(knowhere::IndexEnum::INDEX_HNSW);
+        REQUIRE(idx.Build(*train_ds, json) == knowhere::Status::invalid_args);
+    }
+}
+
+TEST_CASE("Test Mem Index With Binary Vector", "[float metrics]") {
+    using Catch::Approx;
+
+    const int64_t nb = 1000, nq = 10;
+    const int64_t dim = 1024;
+    const int64_t topk = 5;
+
+    auto metric = GENERATE(as<std::string>{}, knowhere::metric::HAMMING, knowhere::metric::JACCARD);
+    auto base_gen = [&]() {
+        knowhere::Json json;
+        json[knowhere::meta::DIM] = dim;
+        json[knowhere::meta::METRIC_TYPE] = metric;
         json[knowhere::meta::TOPK] = topk;
         json[knowhere::meta::RADIUS] = knowhere::IsMetricType(metric, knowhere::metric::HAMMING) ? 10.0 : 0.1;
         json[knowhere::meta::RANGE_FILTER] = 0.0;
@@ -353,6 +2139,68 @@ TEST_CASE("Test Mem Index With Binary Vector", "[float metrics]") {
         auto results = idx_.Search(*query_ds, json, nullptr);
         REQUIRE(results.has_value());
     }
+
+    SECTION("Test BIN_MIH near duplicates") {
+        auto name = knowhere::IndexEnum::INDEX_FAISS_BIN_MIH;
+        knowhere::Json json = base_gen();
+        auto idx = knowhere::IndexFactory::Instance().Create(name);
+        if (!knowhere::IsMetricType(metric, knowhere::metric::HAMMING)) {
+            REQUIRE(idx.Build(*train_ds, json) == knowhere::Status::invalid_metric_type);
+            return;
+        }
+        REQUIRE(idx.Build(*train_ds, json) == knowhere::Status::success);
+        REQUIRE(idx.Count() == nb);
+
+        // the first rows with a few bits flipped
+        const int64_t code_size = dim / 8;
+        auto dup = std::make_unique<uint8_t[]>(nq * code_size);
+        std::copy_n((const uint8_t*)train_ds->GetTensor(), nq * code_size, dup.get());
+        for (int64_t i = 0; i < nq; ++i) {
+            for (int64_t bit : {3 * i, 200 + 7 * i, 1000 - i}) {
+                dup[i * code_size + bit / 8] ^= 1 << (bit % 8);
+            }
+        }
+        auto dup_ds = knowhere::GenDataSet(nq, dim, dup.get());
+
+        auto results = idx.Search(*dup_ds, json, nullptr);
+        REQUIRE(results.has_value());
+        for (int64_t i = 0; i < nq; ++i) {
+            CHECK(results.value()->GetIds()[i * topk] == i);
+            CHECK(results.value()->GetDistance()[i * topk] == 3.0f);
+        }
+
+        // the range search finds every vector within the radius, as the scan of BIN_FLAT does
+        auto flat = knowhere::IndexFactory::Instance().Create(knowhere::IndexEnum::INDEX_FAISS_BIN_IDMAP);
+        REQUIRE(flat.Build(*train_ds, json) == knowhere::Status::success);
+        auto bitset_data = GenerateBitsetWithRandomTbitsSet(nb, nb / 2);
+        knowhere::BitsetView bitset(bitset_data.data(), nb);
+        for (const knowhere::BitsetView& view : {bitset, knowhere::BitsetView()}) {
+            auto hashed = idx.RangeSearch(*dup_ds, json, view);
+            auto scanned = flat.RangeSearch(*dup_ds, json, view);
+            REQUIRE(hashed.has_value());
+            REQUIRE(scanned.has_value());
+            auto lims = hashed.value()->GetLims();
+            auto lims_ = scanned.value()->GetLims();
+            for (int64_t i = 0; i < nq; ++i) {
+                REQUIRE(lims[i + 1] - lims[i] == lims_[i + 1] - lims_[i]);
+                std::set<int64_t> ids(hashed.value()->GetIds() + lims[i], hashed.value()->GetIds() + lims[i + 1]);
+                std::set<int64_t> ids_(scanned.value()->GetIds() + lims_[i],
+                                       scanned.value()->GetIds() + lims_[i + 1]);
+                CHECK(ids == ids_);
+                CHECK(ids.count(i) == (view.empty() || !view.test(i)));
+            }
+        }
+
+        knowhere::BinarySet bs;
+        REQUIRE(idx.Serialize(bs) == knowhere::Status::success);
+        auto idx_ = knowhere::IndexFactory::Instance().Create(name);
+        REQUIRE(idx_.Deserialize(bs, json) == knowhere::Status::success);
+        auto results_ = idx_.Search(*dup_ds, json, nullptr);
+        REQUIRE(results_.has_value());
+        for (int64_t i = 0; i < nq * topk; ++i) {
+            CHECK(results_.value()->GetIds()[i] == results.value()->GetIds()[i]);
+        }
+    }
 }
 
 TEST_CASE("Test Mem Index With Binary Vector", "[bool metrics]") {
@@ -0,0 +1,298 @@
+// Copyright (C) 2019-2023 Zilliz. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file except in compliance
+// with the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
+// or implied. See the License for the specific language governing permissions and limitations under the License.
+
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <map>
+
+#include "catch2/catch_approx.hpp"
+#include "catch2/catch_test_macros.hpp"
+#include "catch2/generators/catch_generators.hpp"
+#include "knowhere/bitsetview.h"
+#include "knowhere/comp/hybrid_search.h"
+#include "knowhere/comp/index_param.h"
+#include "knowhere/factory.h"
+#include "utils.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+constexpr float kKnnRecallThreshold = 0.9f;
+
+// the exact inner products of the queries with every row
+std::vector<std::vector<float>>
+SparseIP(const knowhere::DataSet& base, const knowhere::DataSet& queries) {
+    auto row = [](const knowhere::DataSet& ds, int64_t i) {
+        auto offsets = static_cast<const int64_t*>(ds.GetTensor());
+        auto indices = reinterpret_cast<const int32_t*>(offsets + ds.GetRows() + 1);
+        auto values = reinterpret_cast<const float*>(indices + offsets[ds.GetRows()]);
+        std::map<int32_t, float> entries;
+        for (auto j = offsets[i]; j < offsets[i + 1]; ++j) {
+            entries[indices[j]] = values[j];
+        }
+        return entries;
+    };
+    std::vector<std::vector<float>> scores(queries.GetRows(), std::vector<float>(base.GetRows(), 0.0f));
+    for (int64_t q = 0; q < queries.GetRows(); ++q) {
+        auto query = row(queries, q);
+        for (int64_t i = 0; i < base.GetRows(); ++i) {
+            for (auto& [index, value] : row(base, i)) {
+                auto it = query.find(index);
+                if (it != query.end()) {
+                    scores[q][i] += it->second * value;
+                }
+            }
+        }
+    }
+    return scores;
+}
+}  // namespace
+
+TEST_CASE("Test Sparse Inverted Index", "[sparse]") {
+    using Catch::Approx;
+
+    const int64_t nb = 1000, nq = 10;
+    const int64_t dim = 1000;
+    const int64_t topk = 10;
+
+    auto name = GENERATE(as<std::string>{}, knowhere::IndexEnum::INDEX_SPARSE_INVERTED_INDEX,
+                         knowhere::IndexEnum::INDEX_SPARSE_WAND);
+
+    auto base_gen = [&]() {
+        knowhere::Json json;
+        json[knowhere::meta::DIM] = dim;
+        json[knowhere::meta::METRIC_TYPE] = knowhere::metric::IP;
+        json[knowhere::meta::TOPK] = topk;
+        return json;
+    };
+
+    const auto train_ds = GenSparseDataSet(nb, dim, 32, 42);
+    const auto query_ds = GenSparseDataSet(nq, dim, 16, 7);
+    const auto scores = SparseIP(*train_ds, *query_ds);
+
+    // the ids of the topk largest exact scores of each query
+    auto gt = [&](const std::vector<uint8_t>& bits) {
+        auto ids = new int64_t[nq * topk];
+        auto distances = new float[nq * topk];
+        for (int64_t q = 0; q < nq; ++q) {
+            std::vector<int64_t> order;
+            for (int64_t i = 0; i < nb; ++i) {
+                if (bits.empty() || !(bits[i >> 3] & (1 << (i & 7)))) {
+                    order.push_back(i);
+                }
+            }
+            std::partial_sort(order.begin(), order.begin() + topk, order.end(),
+                              [&](int64_t a, int64_t b) { return scores[q][a] > scores[q][b]; });
+            for (int64_t j = 0; j < topk; ++j) {
+                ids[q * topk + j] = order[j];
+                distances[q * topk + j] = scores[q][order[j]];
+            }
+        }
+        return knowhere::GenResultDataSet(nq, topk, ids, distances);
+    };
+
+    SECTION("Test Search") {
+        auto idx = knowhere::IndexFactory::Instance().Create(name);
+        auto json = base_gen();
+        REQUIRE(idx.Build(*train_ds, json) == knowhere::Status::success);
+        REQUIRE(idx.Count() == nb);
+        REQUIRE(idx.Dim() == dim);
+        auto results = idx.Search(*query_ds, json, nullptr);
+        REQUIRE(results.has_value());
+        REQUIRE(GetKNNRecall(*gt({}), *results.value()) >= kKnnRecallThreshold);
+        // the scores are the ones of the quantized weights, within a step of the largest weight of each term
+        auto ids = results.value()->GetIds();
+        auto distances = results.value()->GetDistance();
+        for (int64_t i = 0; i < nq * topk; ++i) {
+            REQUIRE(distances[i] == Approx(scores[i / topk][ids[i]]).margin(0.05));
+            if (i % topk > 0) {
+                REQUIRE(distances[i] <= distances[i - 1]);
+            }
+        }
+
+        // WAND skips the rows that can not reach the top k, so it finds the same scores as scoring them all
+        auto exhaustive = knowhere::IndexFactory::Instance().Create(knowhere::IndexEnum::INDEX_SPARSE_INVERTED_INDEX);
+        REQUIRE(exhaustive.Build(*train_ds, json) == knowhere::Status::success);
+        auto expected = exhaustive.Search(*query_ds, json, nullptr);
+        REQUIRE(expected.has_value());
+        for (int64_t i = 0; i < nq * topk; ++i) {
+            REQUIRE(distances[i] == Approx(expected.value()->GetDistance()[i]).epsilon(1e-5));
+        }
+    }
+
+    SECTION("Test Hybrid Search") {
+        const int64_t dense_dim = 32;
+        auto sparse_idx = knowhere::IndexFactory::Instance().Create(name);
+        auto sparse_json = base_gen();
+        REQUIRE(sparse_idx.Build(*train_ds, sparse_json) == knowhere::Status::success);
+        auto dense_idx = knowhere::IndexFactory::Instance().Create(knowhere::IndexEnum::INDEX_FAISS_IDMAP);
+        knowhere::Json dense_json;
+        dense_json[knowhere::meta::DIM] = dense_dim;
+        dense_json[knowhere::meta::METRIC_TYPE] = knowhere::metric::L2;
+        dense_json[knowhere::meta::TOPK] = topk;
+        REQUIRE(dense_idx.Build(*GenDataSet(nb, dense_dim, 42), dense_json) == knowhere::Status::success);
+        // the dense queries are the first rows of the base
+        auto dense_query_ds = GenDataSet(nq, dense_dim, 42);
+        knowhere::HybridSide dense{dense_idx, dense_query_ds.get(), dense_json};
+        knowhere::HybridSide sparse{sparse_idx, query_ds.get(), sparse_json};
+        auto sparse_results = sparse_idx.Search(*query_ds, sparse_json, nullptr);
+        REQUIRE(sparse_results.has_value());
+
+        knowhere::Json json;
+        json[knowhere::meta::TOPK] = topk;
+        json[knowhere::indexparam::HYBRID_FUSION] = "RRF";
+        json[knowhere::indexparam::SPARSE_WEIGHT] = 0.0f;
+        auto results = knowhere::HybridSearch::Search(dense, sparse, json);
+        REQUIRE(results.has_value());
+        for (int64_t q = 0; q < nq; ++q) {
+            REQUIRE(results.value()->GetIds()[q * topk] == q);
+        }
+
+        json[knowhere::indexparam::HYBRID_FUSION] = "WEIGHTED";
+        json[knowhere::indexparam::SPARSE_WEIGHT] = 1.0f;
+        json[knowhere::indexparam::DENSE_WEIGHT] = 0.0f;
+        results = knowhere::HybridSearch::Search(dense, sparse, json);
+        REQUIRE(results.has_value());
+        for (int64_t q = 0; q < nq; ++q) {
+            REQUIRE(results.value()->GetDistance()[q * topk] ==
+                    Approx(0.5f + std::atan(sparse_results.value()->GetDistance()[q * topk]) / M_PI));
+        }
+
+        // every fused result is one of either side, the scores best first
+        json[knowhere::indexparam::DENSE_WEIGHT] = 0.5f;
+        results = knowhere::HybridSearch::Search(dense, sparse, json);
+        REQUIRE(results.has_value());
+        auto dense_results = dense_idx.Search(*dense_query_ds, dense_json, nullptr);
+        REQUIRE(dense_results.has_value());
+        for (int64_t i = 0; i < nq * topk; ++i) {
+            auto id = results.value()->GetIds()[i];
+            auto first = (i / topk) * topk;
+            auto in = [&](const int64_t* ids) {
+                return std::find(ids + first, ids + first + topk, id) != ids + first + topk;
+            };
+            REQUIRE((in(dense_results.value()->GetIds()) || in(sparse_results.value()->GetIds())));
+            if (i % topk > 0) {
+                REQUIRE(results.value()->GetDistance()[i] <= results.value()->GetDistance()[i - 1]);
+            }
+        }
+
+        json[knowhere::indexparam::HYBRID_FUSION] = "MAX";
+        REQUIRE(knowhere::HybridSearch::Search(dense, sparse, json).error() == knowhere::Status::invalid_args);
+    }
+
+    SECTION("Test Search with Bitset") {
+        auto idx = knowhere::IndexFactory::Instance().Create(name);
+        auto json = base_gen();
+        REQUIRE(idx.Build(*train_ds, json) == knowhere::Status::success);
+        auto bits = GenerateBitsetWithRandomTbitsSet(nb, nb / 2);
+        knowhere::BitsetView bitset(bits.data(), nb);
+        auto results = idx.Search(*query_ds, json, bitset);
+        REQUIRE(results.has_value());
+        auto ids = results.value()->GetIds();
+        for (int64_t i = 0; i < nq * topk; ++i) {
+            REQUIRE((ids[i] == -1 || !bitset.test(ids[i])));
+        }
+        REQUIRE(GetKNNRecall(*gt(bits), *results.value()) >= kKnnRecallThreshold);
+    }
+
+    SECTION("Test Range Search") {
+        auto idx = knowhere::IndexFactory::Instance().Create(name);
+        auto json = base_gen();
+        json[knowhere::meta::RADIUS] = 1.0;
+        json[knowhere::meta::RANGE_FILTER] = 3.0;
+        REQUIRE(idx.Build(*train_ds, json) == knowhere::Status::success);
+        auto results = idx.RangeSearch(*query_ds, json, nullptr);
+        REQUIRE(results.has_value());
+        auto lims = results.value()->GetLims();
+        auto ids = results.value()->GetIds();
+        auto distances = results.value()->GetDistance();
+        for (int64_t q = 0; q < nq; ++q) {
+            for (auto i = lims[q]; i < lims[q + 1]; ++i) {
+                REQUIRE(distances[i] > 1.0f);
+                REQUIRE(distances[i] <= 3.0f);
+                REQUIRE(distances[i] == Approx(scores[q][ids[i]]).margin(0.05));
+            }
+        }
+    }
+
+    SECTION("Test Add") {
+        // the codes of a dimension are quantized again as larger weights are added to it
+        auto idx = knowhere::IndexFactory::Instance().Create(name);
+        auto json = base_gen();
+        auto half = nb / 2;
+        auto offsets = static_cast<const int64_t*>(train_ds->GetTensor());
+        auto indices = reinterpret_cast<const int32_t*>(offsets + nb + 1);
+        auto values = reinterpret_cast<const float*>(indices + offsets[nb]);
+        std::vector<int64_t> second_offsets;
+        for (int64_t i = half; i <= nb; ++i) {
+            second_offsets.push_back(offsets[i] - offsets[half]);
+        }
+        auto first = knowhere::GenSparseDataSet(half, dim, offsets, indices, values);
+        auto second = knowhere::GenSparseDataSet(nb - half, dim, second_offsets.data(), indices + offsets[half],
+                                                 values + offsets[half]);
+        REQUIRE(idx.Train(*first, json) == knowhere::Status::success);
+        REQUIRE(idx.Add(*first, json) == knowhere::Status::success);
+        REQUIRE(idx.Add(*second, json) == knowhere::Status::success);
+        REQUIRE(idx.Count() == nb);
+        auto results = idx.Search(*query_ds, json, nullptr);
+        REQUIRE(results.has_value());
+        REQUIRE(GetKNNRecall(*gt({}), *results.value()) >= kKnnRecallThreshold);
+    }
+
+    SECTION("Test Serialize and mmap") {
+        auto idx = knowhere::IndexFactory::Instance().Create(name);
+        auto json = base_gen();
+        REQUIRE(idx.Build(*train_ds, json) == knowhere::Status::success);
+        auto expected = idx.Search(*query_ds, json, nullptr);
+        REQUIRE(expected.has_value());
+        auto expected_ids = expected.value()->GetIds();
+
+        knowhere::BinarySet binset;
+        REQUIRE(idx.Serialize(binset) == knowhere::Status::success);
+        auto copy = knowhere::IndexFactory::Instance().Create(name);
+        REQUIRE(copy.Deserialize(binset, json) == knowhere::Status::success);
+        auto results = copy.Search(*query_ds, json, nullptr);
+        REQUIRE(results.has_value());
+        for (int64_t i = 0; i < nq * topk; ++i) {
+            REQUIRE(results.value()->GetIds()[i] == expected_ids[i]);
+        }
+
+        auto mmap = GENERATE(true, false);
+        json["enable_mmap"] = mmap;
+        auto dir = fs::current_path() / "sparse_test";
+        fs::create_directory(dir);
+        auto path = (dir / (name + ".knowhere")).string();
+        REQUIRE(idx.SerializeToFile(path) == knowhere::Status::success);
+        auto loaded = knowhere::IndexFactory::Instance().Create(name);
+        REQUIRE(loaded.DeserializeFromFile(path, json) == knowhere::Status::success);
+        REQUIRE(loaded.Count() == nb);
+        REQUIRE((loaded.GetMemoryUsage().In(knowhere::MemoryUsage::kMmap) > 0) == mmap);
+        results = loaded.Search(*query_ds, json, nullptr);
+        REQUIRE(results.has_value());
+        for (int64_t i = 0; i < nq * topk; ++i) {
+            REQUIRE(results.value()->GetIds()[i] == expected_ids[i]);
+        }
+        // a mapped index is read into memory once added to
+        REQUIRE(loaded.Add(*query_ds, json) == knowhere::Status::success);
+        REQUIRE(loaded.Count() == nb + nq);
+        REQUIRE(loaded.GetMemoryUsage().In(knowhere::MemoryUsage::kMmap) == 0);
+        fs::remove_all(dir);
+    }
+
+    SECTION("Test Invalid Args") {
+        auto idx = knowhere::IndexFactory::Instance().Create(name);
+        auto json = base_gen();
+        REQUIRE(idx.Build(*GenDataSet(nb, 128), json) == knowhere::Status::invalid_args);
+        json[knowhere::meta::METRIC_TYPE] = knowhere::metric::L2;
+        REQUIRE(idx.Build(*train_ds, json) == knowhere::Status::invalid_metric_type);
+    }
+}
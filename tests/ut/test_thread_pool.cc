@@ -0,0 +1,473 @@
+// Copyright (C) 2019-2023 Zilliz. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file except in compliance
+// with the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
+// or implied. See the License for the specific language governing permissions and limitations under the License.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "catch2/catch_test_macros.hpp"
+#include "folly/executors/thread_factory/NamedThreadFactory.h"
+#include "knowhere/comp/numa.h"
+#include "knowhere/comp/task_scheduler.h"
+#include "knowhere/comp/work_stealing_executor.h"
+#include "knowhere/index.h"
+#include "knowhere/index_node_pre_transform_wrapper.h"
+#include "knowhere/index_node_thread_pool_wrapper.h"
+#include "utils.h"
+
+namespace {
+constexpr int kThieves = 4;
+
+// the owner pushes the items 0..n and pops some of them back while the thieves steal, every item must be taken once
+void
+RaceOwnerAgainstThieves(int64_t capacity, int n, int pops_per_push) {
+    std::vector<int> items(n);
+    std::vector<std::atomic<int>> taken(n);
+    for (int i = 0; i < n; ++i) {
+        items[i] = i;
+        taken[i] = 0;
+    }
+    knowhere::ChaseLevDeque<int> deque(capacity);
+    std::atomic<bool> done{false};
+    std::vector<std::thread> thieves;
+    for (int k = 0; k < kThieves; ++k) {
+        thieves.emplace_back([&] {
+            while (!done.load(std::memory_order_acquire)) {
+                if (auto item = deque.Steal()) {
+                    taken[*item].fetch_add(1);
+                }
+            }
+        });
+    }
+    for (int i = 0; i < n; ++i) {
+        deque.Push(&items[i]);
+        if (i % 2 == 0) {
+            continue;
+        }
+        for (int p = 0; p < pops_per_push; ++p) {
+            if (auto item = deque.Pop()) {
+                taken[*item].fetch_add(1);
+            }
+        }
+    }
+    // a null Pop means the deque is empty, or that a thief won the last item
+    while (auto item = deque.Pop()) {
+        taken[*item].fetch_add(1);
+    }
+    done.store(true, std::memory_order_release);
+    for (auto& thief : thieves) {
+        thief.join();
+    }
+    REQUIRE(deque.Empty());
+    for (int i = 0; i < n; ++i) {
+        REQUIRE(taken[i].load() == 1);
+    }
+}
+
+// a count the test waits to reach, bumped from the workers
+class Countdown {
+ public:
+    explicit Countdown(int64_t count) : count_(count) {
+    }
+
+    void
+    Done() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (--count_ == 0) {
+            reached_.notify_all();
+        }
+    }
+
+    bool
+    Wait(std::chrono::seconds timeout) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        return reached_.wait_for(lock, timeout, [this] { return count_ == 0; });
+    }
+
+ private:
+    std::mutex mutex_;
+    std::condition_variable reached_;
+    int64_t count_;
+};
+
+// the tasks of a test block on it until the test opens it
+class Gate {
+ public:
+    void
+    Open() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        open_ = true;
+        opened_.notify_all();
+    }
+
+    void
+    Wait() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        opened_.wait(lock, [this] { return open_; });
+    }
+
+ private:
+    std::mutex mutex_;
+    std::condition_variable opened_;
+    bool open_ = false;
+};
+
+// polls cond until it holds, false if it does not within a minute
+template <typename Cond>
+bool
+Eventually(Cond cond) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::minutes(1);
+    while (!cond()) {
+        if (std::chrono::steady_clock::now() > deadline) {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
+// a node searching on the pool it is given, as the indexes with a search pool of their own do
+class PooledNode : public StubIndexNode {
+ public:
+    PooledNode() : search_pool_(knowhere::ThreadPool::GetGlobalSearchThreadPool()) {
+    }
+
+    knowhere::Status
+    Deserialize(const knowhere::BinarySet&, const knowhere::Config&) override {
+        return knowhere::Status::success;
+    }
+
+    void
+    SetSearchPool(std::shared_ptr<knowhere::ThreadPool> pool) override {
+        search_pool_ = std::move(pool);
+    }
+
+    std::shared_ptr<knowhere::ThreadPool>
+    SearchPool() const {
+        return AsyncSearchPool();
+    }
+
+ protected:
+    std::shared_ptr<knowhere::ThreadPool>
+    AsyncSearchPool() const override {
+        return search_pool_;
+    }
+
+ private:
+    std::shared_ptr<knowhere::ThreadPool> search_pool_;
+};
+
+// the pool the searches of an index loaded with the numa_node of the config run on
+std::shared_ptr<knowhere::ThreadPool>
+LoadedSearchPool(int numa_node) {
+    auto node = std::make_unique<PooledNode>();
+    auto pooled = node.get();
+    knowhere::Index<knowhere::IndexNode> idx =
+        knowhere::Index<knowhere::IndexNodePreTransformWrapper>::Create(std::move(node));
+    knowhere::Json json;
+    json["numa_node"] = numa_node;
+    REQUIRE(idx.Deserialize(knowhere::BinarySet(), json) == knowhere::Status::success);
+    return pooled->SearchPool();
+}
+}  // namespace
+
+TEST_CASE("Test ChaseLevDeque", "[thread_pool]") {
+    SECTION("owner push and pop against thieves") {
+        RaceOwnerAgainstThieves(1024, 200000, 1);
+    }
+
+    SECTION("growth while the thieves steal") {
+        // the ring of 2 grows many times over, the thieves keep reading the rings it outgrew
+        RaceOwnerAgainstThieves(2, 200000, 0);
+    }
+
+    SECTION("single threaded order") {
+        knowhere::ChaseLevDeque<int> deque(2);
+        std::vector<int> items{0, 1, 2, 3, 4};
+        for (auto& item : items) {
+            deque.Push(&item);
+        }
+        REQUIRE(*deque.Steal() == 0);
+        REQUIRE(*deque.Pop() == 4);
+        REQUIRE(*deque.Steal() == 1);
+        REQUIRE(*deque.Pop() == 3);
+        REQUIRE(*deque.Pop() == 2);
+        REQUIRE(deque.Pop() == nullptr);
+        REQUIRE(deque.Steal() == nullptr);
+        REQUIRE(deque.Empty());
+    }
+}
+
+TEST_CASE("Test WorkStealingExecutor", "[thread_pool]") {
+    auto factory = std::make_shared<folly::NamedThreadFactory>("WorkStealingTest");
+
+    SECTION("every task runs once") {
+        constexpr int kTasks = 10000;
+        std::vector<std::atomic<int>> runs(kTasks);
+        for (auto& r : runs) {
+            r = 0;
+        }
+        Countdown countdown(kTasks);
+        knowhere::WorkStealingExecutor executor(4, factory);
+        for (int i = 0; i < kTasks; ++i) {
+            executor.add([&, i] {
+                runs[i].fetch_add(1);
+                countdown.Done();
+            });
+        }
+        REQUIRE(countdown.Wait(std::chrono::seconds(60)));
+        for (int i = 0; i < kTasks; ++i) {
+            REQUIRE(runs[i].load() == 1);
+        }
+    }
+
+    SECTION("tasks added from the workers") {
+        // a binary tree of tasks, each added by its parent from the deque of a worker and stolen by the idle ones
+        constexpr int kDepth = 14;
+        constexpr int64_t kTasks = (int64_t(1) << (kDepth + 1)) - 1;
+        Countdown countdown(kTasks);
+        std::atomic<int64_t> ran{0};
+        // declared before the executor, so that it outlives the workers still returning from it
+        std::function<void(int)> spawn;
+        knowhere::WorkStealingExecutor executor(4, factory);
+        spawn = [&](int depth) {
+            ran.fetch_add(1);
+            if (depth < kDepth) {
+                executor.add([&, depth] { spawn(depth + 1); });
+                executor.add([&, depth] { spawn(depth + 1); });
+            }
+            countdown.Done();
+        };
+        executor.add([&] { spawn(0); });
+        REQUIRE(countdown.Wait(std::chrono::seconds(60)));
+        REQUIRE(ran.load() == kTasks);
+    }
+
+    SECTION("destruction drains the queued tasks") {
+        constexpr int kTasks = 1000;
+        std::atomic<int> ran{0};
+        {
+            knowhere::WorkStealingExecutor executor(2, factory);
+            for (int i = 0; i < kTasks; ++i) {
+                executor.add([&] {
+                    std::this_thread::sleep_for(std::chrono::microseconds(10));
+                    ran.fetch_add(1);
+                });
+            }
+            // and tasks that add more of them while the executor is stopping
+            executor.add([&] {
+                for (int i = 0; i < kTasks; ++i) {
+                    executor.add([&] { ran.fetch_add(1); });
+                }
+                ran.fetch_add(1);
+            });
+        }
+        REQUIRE(ran.load() == 2 * kTasks + 1);
+    }
+}
+
+TEST_CASE("Test TaskScheduler", "[thread_pool]") {
+    using knowhere::TaskClass;
+    Gate gate;
+    std::vector<std::thread> threads;
+    auto join = [&] {
+        gate.Open();
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    };
+
+    SECTION("max running overall") {
+        knowhere::TaskScheduler scheduler(2);
+        std::atomic<int> running{0}, most{0};
+        for (int i = 0; i < 4; ++i) {
+            threads.emplace_back([&] {
+                scheduler.Run(TaskClass::INTERACTIVE, [&] {
+                    auto now = ++running;
+                    auto seen = most.load();
+                    while (now > seen && !most.compare_exchange_weak(seen, now)) {
+                    }
+                    gate.Wait();
+                    --running;
+                });
+            });
+        }
+        REQUIRE(Eventually([&] {
+            return scheduler.Running(TaskClass::INTERACTIVE) == 2 && scheduler.Queued(TaskClass::INTERACTIVE) == 2;
+        }));
+        // no other class gets past the overall cap either
+        threads.emplace_back([&] { scheduler.Run(TaskClass::BATCH, [] {}); });
+        REQUIRE(Eventually([&] { return scheduler.Queued(TaskClass::BATCH) == 1; }));
+        REQUIRE(scheduler.Running(TaskClass::BATCH) == 0);
+        join();
+        REQUIRE(most.load() == 2);
+        REQUIRE(scheduler.Running(TaskClass::INTERACTIVE) == 0);
+        REQUIRE(scheduler.Running(TaskClass::BATCH) == 0);
+    }
+
+    SECTION("max running per class") {
+        knowhere::TaskScheduler scheduler(8);
+        scheduler.Configure(TaskClass::BUILD, {1, 1, 0});
+        for (int i = 0; i < 3; ++i) {
+            threads.emplace_back([&] { scheduler.Run(TaskClass::BUILD, [&] { gate.Wait(); }); });
+        }
+        REQUIRE(Eventually([&] {
+            return scheduler.Running(TaskClass::BUILD) == 1 && scheduler.Queued(TaskClass::BUILD) == 2;
+        }));
+        // the free slots overall still go to the other classes
+        REQUIRE(scheduler.Run(TaskClass::INTERACTIVE, [] { return 7; }) == 7);
+        REQUIRE(scheduler.Running(TaskClass::BUILD) == 1);
+        join();
+        REQUIRE(scheduler.Running(TaskClass::BUILD) == 0);
+        REQUIRE(scheduler.Queued(TaskClass::BUILD) == 0);
+    }
+
+    SECTION("max queued rejects") {
+        knowhere::TaskScheduler scheduler(1);
+        scheduler.Configure(TaskClass::INTERACTIVE, {16, 0, 1});
+        threads.emplace_back([&] { scheduler.Run(TaskClass::INTERACTIVE, [&] { gate.Wait(); }); });
+        REQUIRE(Eventually([&] { return scheduler.Running(TaskClass::INTERACTIVE) == 1; }));
+        threads.emplace_back([&] { scheduler.Run(TaskClass::INTERACTIVE, [] {}); });
+        REQUIRE(Eventually([&] { return scheduler.Queued(TaskClass::INTERACTIVE) == 1; }));
+        REQUIRE_THROWS_AS(scheduler.Run(TaskClass::INTERACTIVE, [] {}), knowhere::TaskRejected);
+        // the queue of another class is not full
+        threads.emplace_back([&] { scheduler.Run(TaskClass::BATCH, [] {}); });
+        REQUIRE(Eventually([&] { return scheduler.Queued(TaskClass::BATCH) == 1; }));
+        join();
+        REQUIRE(scheduler.Queued(TaskClass::INTERACTIVE) == 0);
+        REQUIRE(scheduler.Queued(TaskClass::BATCH) == 0);
+    }
+
+    SECTION("weighted sharing") {
+        // one slot, so that the classes start one task at a time in the order the scheduler picks them
+        knowhere::TaskScheduler scheduler(1);
+        scheduler.Configure(TaskClass::INTERACTIVE, {4, 0, 0});
+        scheduler.Configure(TaskClass::BUILD, {1, 0, 0});
+        threads.emplace_back([&] { scheduler.Run(TaskClass::BATCH, [&] { gate.Wait(); }); });
+        REQUIRE(Eventually([&] { return scheduler.Running(TaskClass::BATCH) == 1; }));
+        constexpr int kTasks = 10;
+        std::mutex order_mutex;
+        std::vector<TaskClass> order;
+        for (auto task_class : {TaskClass::INTERACTIVE, TaskClass::BUILD}) {
+            for (int i = 0; i < kTasks; ++i) {
+                threads.emplace_back([&, task_class] {
+                    scheduler.Run(task_class, [&] {
+                        std::lock_guard<std::mutex> lock(order_mutex);
+                        order.push_back(task_class);
+                    });
+                });
+            }
+        }
+        REQUIRE(Eventually([&] {
+            return scheduler.Queued(TaskClass::INTERACTIVE) == kTasks && scheduler.Queued(TaskClass::BUILD) == kTasks;
+        }));
+        join();
+        REQUIRE(order.size() == 2 * kTasks);
+        auto interactive = std::count(order.begin(), order.begin() + kTasks, TaskClass::INTERACTIVE);
+        // about 4 of every 5 of the first tasks are interactive, and the builds still move
+        REQUIRE(interactive >= 7);
+        REQUIRE(interactive < kTasks);
+    }
+
+    SECTION("Run gives its slot back when func throws") {
+        knowhere::TaskScheduler scheduler(1);
+        REQUIRE_THROWS_AS(scheduler.Run(TaskClass::INTERACTIVE, []() -> int { throw std::runtime_error("failed"); }),
+                          std::runtime_error);
+        REQUIRE(scheduler.Running(TaskClass::INTERACTIVE) == 0);
+        REQUIRE(scheduler.Run(TaskClass::INTERACTIVE, [] { return 7; }) == 7);
+    }
+}
+
+TEST_CASE("Test TaskScheduler rejections fail with too_many_requests", "[thread_pool]") {
+    using knowhere::TaskClass;
+    auto scheduler = knowhere::ThreadPool::GetGlobalTaskScheduler();
+    auto build_config = scheduler->GetConfig(TaskClass::BUILD);
+    auto interactive_config = scheduler->GetConfig(TaskClass::INTERACTIVE);
+    knowhere::IndexNodeThreadPoolWrapper wrapper(std::make_unique<StubIndexNode>(), 1);
+    auto ds = GenDataSet(1, 4);
+    knowhere::BaseConfig cfg;
+    Gate gate;
+    std::vector<std::thread> threads;
+
+    // one task of the class runs and one waits, the queue of the class is full
+    auto fill = [&](TaskClass task_class, knowhere::TaskScheduler::ClassConfig config) {
+        config.max_running = 1;
+        config.max_queued = 1;
+        scheduler->Configure(task_class, config);
+        threads.emplace_back([&, task_class] { scheduler->Run(task_class, [&] { gate.Wait(); }); });
+        REQUIRE(Eventually([&] { return scheduler->Running(task_class) == 1; }));
+        threads.emplace_back([&, task_class] { scheduler->Run(task_class, [] {}); });
+        REQUIRE(Eventually([&] { return scheduler->Queued(task_class) == 1; }));
+    };
+    fill(TaskClass::BUILD, build_config);
+    REQUIRE(wrapper.Train(*ds, cfg) == knowhere::Status::too_many_requests);
+    fill(TaskClass::INTERACTIVE, interactive_config);
+    auto result = wrapper.SearchAsync(*ds, cfg, nullptr).get();
+    REQUIRE_FALSE(result.has_value());
+    REQUIRE(result.error() == knowhere::Status::too_many_requests);
+
+    gate.Open();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    scheduler->Configure(TaskClass::BUILD, build_config);
+    scheduler->Configure(TaskClass::INTERACTIVE, interactive_config);
+    REQUIRE(wrapper.Train(*ds, cfg) == knowhere::Status::success);
+}
+
+TEST_CASE("Test NUMA search pools", "[thread_pool]") {
+    using knowhere::ThreadPool;
+    auto global = ThreadPool::GetGlobalSearchThreadPool();
+    auto nodes = knowhere::Numa::NodeCount();
+    REQUIRE(nodes >= 1);
+    // no node, or one the host does not have, is the global pool
+    REQUIRE(ThreadPool::GetGlobalSearchThreadPool(-1) == global);
+    REQUIRE(ThreadPool::GetGlobalSearchThreadPool(nodes) == global);
+    REQUIRE(ThreadPool::SearchNumaNode(-1) == -1);
+    REQUIRE(LoadedSearchPool(0) == global);
+
+    ThreadPool::EnableNumaSearchPools(true);
+    if (nodes == 1) {
+        // a single node host falls back to the global pool
+        REQUIRE(ThreadPool::SearchNumaNode(-1) == -1);
+        REQUIRE(ThreadPool::SearchNumaNode(0) == -1);
+        REQUIRE(LoadedSearchPool(-1) == global);
+        REQUIRE(LoadedSearchPool(0) == global);
+    } else {
+        std::vector<int> homes(nodes, 0);
+        for (int i = 0; i < nodes; ++i) {
+            auto home = ThreadPool::SearchNumaNode(-1);
+            REQUIRE(home >= 0);
+            REQUIRE(home < nodes);
+            ++homes[home];
+        }
+        // round robin over the nodes
+        REQUIRE(std::count(homes.begin(), homes.end(), 1) == nodes);
+        for (int node = 0; node < nodes; ++node) {
+            REQUIRE(ThreadPool::SearchNumaNode(node) == node);
+            auto pool = ThreadPool::GetGlobalSearchThreadPool(node);
+            REQUIRE(pool != global);
+            REQUIRE(ThreadPool::GetGlobalSearchThreadPool(node) == pool);
+            REQUIRE(LoadedSearchPool(node) == pool);
+        }
+        REQUIRE(ThreadPool::SearchNumaNode(nodes) == -1);
+        REQUIRE(LoadedSearchPool(nodes) == global);
+    }
+    ThreadPool::EnableNumaSearchPools(false);
+    REQUIRE(LoadedSearchPool(0) == global);
+}
@@ -9,12 +9,19 @@
 // is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
 // or implied. See the License for the specific language governing permissions and limitations under the License.
 
+#include <atomic>
+#include <thread>
 #include <vector>
 
 #include "catch2/catch_approx.hpp"
 #include "catch2/catch_test_macros.hpp"
+#include "catch2/generators/catch_generators.hpp"
+#include "common/lru_cache.h"
+#include "hnswlib/neighbor.h"
+#include "hnswlib/visited_list_pool.h"
 #include "knowhere/comp/time_recorder.h"
 #include "knowhere/heap.h"
+#include "knowhere/log.h"
 #include "knowhere/utils.h"
 #include "utils.h"
 
@@ -45,6 +52,19 @@ TEST_CASE("Test Vector Normalization", "[normalize]") {
             CHECK(std::abs(1.0f - sum) <= floatDiff);
         }
     }
+
+    SECTION("Test parallel normalize matches the serial one") {
+        uint64_t rows = 10000;
+        auto ds = GenDataSet(rows, dim, seed);
+        auto data = (float*)ds->GetTensor();
+        std::vector<float> serial(data, data + rows * dim);
+
+        auto serial_norms = knowhere::NormalizeVecs(serial.data(), rows, dim);
+        auto norms = knowhere::ParallelNormalizeVecs(data, rows, dim);
+
+        REQUIRE(norms == serial_norms);
+        REQUIRE(std::equal(serial.begin(), serial.end(), data));
+    }
 }
 
 TEST_CASE("Test Bitset Generation", "[utils]") {
@@ -78,6 +98,72 @@ TEST_CASE("Test Bitset Generation", "[utils]") {
     }
 }
 
+TEST_CASE("Test Bitset Block Operations", "[utils]") {
+    for (const auto size : kBitsetSizes) {
+        for (size_t i = 0; i <= size; i += std::max<size_t>(1, size / 10)) {
+            auto bitset_data = GenerateBitsetWithRandomTbitsSet(size, i);
+            knowhere::BitsetView bitset(bitset_data.data(), size);
+            REQUIRE(bitset.count() == i);
+            for (size_t from = 0; from < size; ++from) {
+                for (const size_t n : {1, 7, 32, 64}) {
+                    uint64_t mask = 0;
+                    bool any_unset = false;
+                    for (size_t b = 0; b < n; ++b) {
+                        bool set = from + b < size && bitset.test(from + b);
+                        mask |= uint64_t(set) << b;
+                        any_unset |= !set;
+                    }
+                    REQUIRE(bitset.block(from, n) == mask);
+                    REQUIRE(bitset.any_unset_in(from, from + n) == any_unset);
+                }
+                size_t unset = from, set = from;
+                while (unset < size && bitset.test(unset)) {
+                    ++unset;
+                }
+                while (set < size && !bitset.test(set)) {
+                    ++set;
+                }
+                REQUIRE(bitset.next_unset(from) == unset);
+                REQUIRE(bitset.next_set(from) == set);
+            }
+        }
+    }
+}
+
+TEST_CASE("Test Bitset Id Forms", "[utils]") {
+    for (const auto size : kBitsetSizes) {
+        for (size_t i = 0; i <= size; i += std::max<size_t>(1, size / 10)) {
+            auto bitset_data = GenerateBitsetWithRandomTbitsSet(size, i);
+            knowhere::BitsetView dense(bitset_data.data(), size);
+            std::vector<uint32_t> alive, filtered;
+            for (size_t id = 0; id < size; ++id) {
+                (dense.test(id) ? filtered : alive).push_back(id);
+            }
+            for (auto bitset : {knowhere::BitsetView::FromAliveIds(alive.data(), alive.size(), size),
+                                knowhere::BitsetView::FromFilteredIds(filtered.data(), filtered.size(), size)}) {
+                REQUIRE(!bitset.is_dense());
+                REQUIRE(bitset.size() == size);
+                REQUIRE(bitset.count() == i);
+                for (size_t from = 0; from < size; ++from) {
+                    REQUIRE(bitset.test(from) == dense.test(from));
+                    for (const size_t n : {1, 7, 32, 64}) {
+                        REQUIRE(bitset.block(from, n) == dense.block(from, n));
+                        REQUIRE(bitset.any_unset_in(from, from + n) == dense.any_unset_in(from, from + n));
+                    }
+                    REQUIRE(bitset.next_unset(from) == dense.next_unset(from));
+                    REQUIRE(bitset.next_set(from) == dense.next_set(from));
+                }
+                std::vector<uint8_t> buf;
+                auto bits = bitset.to_dense(buf);
+                REQUIRE(bits.is_dense());
+                REQUIRE(std::vector<uint8_t>(bits.data(), bits.data() + bits.byte_size()) == bitset_data);
+            }
+            REQUIRE(knowhere::BitsetView::FromAliveIds(alive.data(), alive.size(), size).num_alive_ids() ==
+                    alive.size());
+        }
+    }
+}
+
 namespace {
 constexpr size_t kHeapSize = 10;
 constexpr size_t kElementCount = 10000;
@@ -99,6 +185,32 @@ TEST_CASE("ResultMaxHeap") {
     REQUIRE(heap.Size() == 0);
 }
 
+TEST_CASE("ResultMaxHeap strategies") {
+    // the sorted array, the heap and the buffer, with fewer and more results than k
+    auto k = GENERATE(as<size_t>{}, 0, 1, 16, 17, 100, 1024, 4000);
+    auto n = GENERATE(as<size_t>{}, 5, kElementCount);
+    knowhere::ResultMaxHeap<float, size_t> heap(k);
+    auto pairs = GenerateRandomDistanceIdPair(n);
+    for (const auto& [dist, id] : pairs) {
+        heap.Push(dist, id);
+    }
+    std::sort(pairs.begin(), pairs.end());
+    const size_t len = std::min(k, n);
+    REQUIRE(heap.Size() == len);
+    for (int64_t i = len - 1; i >= 0; --i) {
+        auto op = heap.Pop();
+        REQUIRE(op.has_value());
+        REQUIRE(op.value().second == pairs[i].second);
+    }
+    REQUIRE(!heap.Pop().has_value());
+
+    // a heap popped from keeps what is pushed again
+    if (k > 0) {
+        heap.Push(pairs.back().first, pairs.back().second);
+        REQUIRE(heap.Size() == 1);
+    }
+}
+
 TEST_CASE("Test Time Recorder") {
     knowhere::TimeRecorder tr("test", 2);
     int64_t sum = 0;
@@ -108,3 +220,192 @@ TEST_CASE("Test Time Recorder") {
     auto span = tr.ElapseFromBegin("done");
     REQUIRE(span > 0);
 }
+
+TEST_CASE("Test Visited List Pool", "[utils]") {
+    const size_t n = 100;
+    hnswlib::VisitedListPool pool(n);
+
+    SECTION("Reset clears visited marks") {
+        auto& visited = pool.getFreeVisitedList();
+        for (size_t i = 0; i < n; i += 2) {
+            visited.set(i);
+        }
+        for (size_t i = 0; i < n; ++i) {
+            REQUIRE(visited.get(i) == (i % 2 == 0));
+        }
+        auto& again = pool.getFreeVisitedList();
+        REQUIRE(&again == &visited);
+        for (size_t i = 0; i < n; ++i) {
+            REQUIRE(!again.get(i));
+        }
+    }
+
+    SECTION("Epoch wrap around") {
+        auto& visited = pool.getFreeVisitedList();
+        visited.set(0);
+        for (size_t round = 0; round < (1 << 16) + 1; ++round) {
+            visited.reset();
+            REQUIRE(!visited.get(0));
+            visited.set(1);
+        }
+        REQUIRE(visited.get(1));
+        REQUIRE(!visited.get(0));
+    }
+}
+
+TEST_CASE("Test Neighbor Block Set", "[utils]") {
+    auto capacity = GENERATE(as<size_t>{}, 1, 16, 17, 100, 1000);
+    std::mt19937 rng(42);
+    hnswlib::NeighborSet flat(capacity);
+    hnswlib::NeighborBlockSet blocks(capacity);
+    auto contents = [](const auto& set) {
+        std::vector<std::pair<unsigned, int>> nbrs;
+        set.for_each([&nbrs](const hnswlib::Neighbor& nbr) { nbrs.emplace_back(nbr.id, nbr.status); });
+        return nbrs;
+    };
+    // the same inserts and pops, with ties and invalid neighbors, leave the same neighbors in the same order
+    for (unsigned i = 0; i < 20000; ++i) {
+        REQUIRE(blocks.has_next() == flat.has_next());
+        if (flat.has_next() && rng() % 3 == 0) {
+            auto nbr = flat.pop();
+            auto block_nbr = blocks.pop();
+            REQUIRE(block_nbr.id == nbr.id);
+            REQUIRE(block_nbr.status == nbr.status);
+        } else {
+            hnswlib::Neighbor nbr(i, static_cast<float>(rng() % 500),
+                                  rng() % 4 == 0 ? hnswlib::Neighbor::kInvalid : hnswlib::Neighbor::kValid);
+            REQUIRE(blocks.insert(nbr) == flat.insert(nbr));
+        }
+        REQUIRE(blocks.size() == flat.size());
+        if (i % 97 == 0) {
+            REQUIRE(contents(blocks) == contents(flat));
+            if (flat.size() > 0) {
+                REQUIRE(blocks[flat.size() - 1].id == flat[flat.size() - 1].id);
+            }
+        }
+    }
+}
+
+TEST_CASE("Test LRU Cache", "[utils]") {
+    SECTION("Evicts by charge") {
+        knowhere::lru_cache<int, int> cache(10);
+        cache.put(1, 1, 4);
+        cache.put(2, 2, 4);
+        int val = 0;
+        REQUIRE(cache.try_get(1, val));
+        REQUIRE(val == 1);
+        // 2 is the least recently used one now
+        cache.put(3, 3, 4);
+        REQUIRE(!cache.try_get(2, val));
+        REQUIRE(cache.try_get(1, val));
+        REQUIRE(cache.try_get(3, val));
+        REQUIRE(cache.charge() == 8);
+        cache.put(1, 10, 2);
+        REQUIRE(cache.charge() == 6);
+        REQUIRE(cache.try_get(1, val));
+        REQUIRE(val == 10);
+        // an entry charged past the capacity is not kept
+        cache.put(4, 4, 11);
+        REQUIRE(!cache.try_get(4, val));
+    }
+
+    SECTION("Clock") {
+        knowhere::clock_cache<int, int> cache(3);
+        cache.put(1, 1);
+        cache.put(2, 2);
+        cache.put(3, 3);
+        int val = 0;
+        REQUIRE(cache.try_get(1, val));
+        REQUIRE(cache.try_get(3, val));
+        // 2 is the only one not hit, the others get a second chance
+        cache.put(4, 4);
+        REQUIRE(!cache.try_get(2, val));
+        REQUIRE(cache.try_get(1, val));
+        REQUIRE(cache.try_get(3, val));
+        REQUIRE(cache.try_get(4, val));
+        REQUIRE(cache.charge() == 3);
+        cache.put(3, 30, 2);
+        REQUIRE(cache.charge() <= 3);
+        REQUIRE(cache.try_get(3, val));
+        REQUIRE(val == 30);
+        cache.put(5, 5, 4);
+        REQUIRE(!cache.try_get(5, val));
+        REQUIRE(cache.charge() <= 3);
+    }
+
+    SECTION("Concurrent") {
+        const int n = 1000;
+        knowhere::concurrent_cache<int, int> cache(n, 8);
+        for (int i = 0; i < n; ++i) {
+            cache.put(i, 2 * i);
+        }
+        int val = 0;
+        for (int i = 0; i < n; i += 7) {
+            if (cache.try_get(i, val)) {
+                REQUIRE(val == 2 * i);
+            }
+        }
+        REQUIRE(cache.charge() <= n);
+        for (int i = n; i < 2 * n; ++i) {
+            cache.put(i, 2 * i, 1);
+        }
+        REQUIRE(cache.charge() <= n);
+
+        // hits and puts of many threads at once only ever see the values put
+        std::vector<std::thread> threads;
+        std::atomic<int> wrong{0};
+        for (int t = 0; t < 8; ++t) {
+            threads.emplace_back([&cache, &wrong, t]() {
+                int v = 0;
+                for (int i = 0; i < 20000; ++i) {
+                    int key = (i * 31 + t) % (3 * n);
+                    if (i % 4 == 0) {
+                        cache.put(key, 2 * key);
+                    } else if (cache.try_get(key, v) && v != 2 * key) {
+                        wrong.fetch_add(1);
+                    }
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        REQUIRE(wrong.load() == 0);
+        REQUIRE(cache.charge() <= n);
+        cache.clear();
+        REQUIRE(cache.charge() == 0);
+        REQUIRE(!cache.try_get(2 * n - 1, val));
+    }
+}
+
+TEST_CASE("Test Log Rate Limit", "[utils]") {
+    knowhere::SetLogRateLimit(2);
+    auto suppressed = knowhere::LogSuppressedCount();
+    int formatted = 0;
+    auto format = [&formatted]() { return ++formatted; };
+    for (int i = 0; i < 10; ++i) {
+        LOG_KNOWHERE_WARNING_ << "rate limited message " << format();
+    }
+    // the site logs 2 messages per second, the window may turn once over the loop
+    REQUIRE(formatted >= 2);
+    REQUIRE(formatted <= 4);
+    REQUIRE(knowhere::LogSuppressedCount() - suppressed == 10 - formatted);
+    knowhere::FlushLogs();
+
+    // the messages of many threads are queued without waiting for each other
+    knowhere::SetLogRateLimit(0);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 8; ++t) {
+        threads.emplace_back([] {
+            for (int i = 0; i < 100; ++i) {
+                LOG_KNOWHERE_INFO_ << "unlimited message " << i;
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    knowhere::FlushLogs();
+    REQUIRE(knowhere::LogSuppressedCount() - suppressed == 10 - formatted);
+    knowhere::SetLogRateLimit(10);
+}
@@ -13,6 +13,7 @@
 #include <cstdint>
 #include <limits>
 #include <memory>
+#include <numeric>
 #include <queue>
 #include <random>
 #include <set>
@@ -21,6 +22,7 @@
 #include "common/range_util.h"
 #include "knowhere/binaryset.h"
 #include "knowhere/dataset.h"
+#include "knowhere/index_node.h"
 
 constexpr int64_t kSeed = 42;
 using IdDisPair = std::pair<int64_t, float>;
@@ -42,6 +44,27 @@ GenDataSet(int rows, int dim, int seed = 42) {
     return ds;
 }
 
+// rows of nnz entries of dimensions in [0, dim), of values in (0, 1]
+inline knowhere::DataSetPtr
+GenSparseDataSet(int rows, int dim, int nnz, int seed = 42) {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> value_distrib(0.0f, 1.0f);
+    std::vector<int64_t> offsets(rows + 1, 0);
+    std::vector<int32_t> indices;
+    std::vector<float> values;
+    std::vector<int32_t> dims(dim);
+    std::iota(dims.begin(), dims.end(), 0);
+    for (int i = 0; i < rows; ++i) {
+        std::shuffle(dims.begin(), dims.end(), rng);
+        for (int j = 0; j < nnz; ++j) {
+            indices.push_back(dims[j]);
+            values.push_back(1.0f - value_distrib(rng));
+        }
+        offsets[i + 1] = indices.size();
+    }
+    return knowhere::GenSparseDataSet(rows, dim, offsets.data(), indices.data(), values.data());
+}
+
 inline knowhere::DataSetPtr
 CopyDataSet(knowhere::DataSetPtr dataset, const int64_t copy_rows) {
     auto rows = copy_rows;
@@ -187,3 +210,83 @@ GenerateRandomDistanceIdPair(size_t n) {
     }
     return res;
 }
+
+// An index node that holds nothing, for the tests of the wrappers and of the schedulers around the indexes: it trains
+// and adds anything, fails the rest with not_implemented. Override what a test needs.
+class StubIndexNode : public knowhere::IndexNode {
+ public:
+    knowhere::Status
+    Train(const knowhere::DataSet&, const knowhere::Config&) override {
+        return knowhere::Status::success;
+    }
+
+    knowhere::Status
+    Add(const knowhere::DataSet&, const knowhere::Config&) override {
+        return knowhere::Status::success;
+    }
+
+    knowhere::expected<knowhere::DataSetPtr>
+    Search(const knowhere::DataSet&, const knowhere::Config&, const knowhere::BitsetView&) const override {
+        return knowhere::expected<knowhere::DataSetPtr>::Err(knowhere::Status::not_implemented, "stub");
+    }
+
+    knowhere::expected<knowhere::DataSetPtr>
+    RangeSearch(const knowhere::DataSet&, const knowhere::Config&, const knowhere::BitsetView&) const override {
+        return knowhere::expected<knowhere::DataSetPtr>::Err(knowhere::Status::not_implemented, "stub");
+    }
+
+    knowhere::expected<knowhere::DataSetPtr>
+    GetVectorByIds(const knowhere::DataSet&) const override {
+        return knowhere::expected<knowhere::DataSetPtr>::Err(knowhere::Status::not_implemented, "stub");
+    }
+
+    bool
+    HasRawData(const std::string&) const override {
+        return false;
+    }
+
+    knowhere::expected<knowhere::DataSetPtr>
+    GetIndexMeta(const knowhere::Config&) const override {
+        return knowhere::expected<knowhere::DataSetPtr>::Err(knowhere::Status::not_implemented, "stub");
+    }
+
+    knowhere::Status
+    Serialize(knowhere::BinarySet&) const override {
+        return knowhere::Status::not_implemented;
+    }
+
+    knowhere::Status
+    Deserialize(const knowhere::BinarySet&, const knowhere::Config&) override {
+        return knowhere::Status::not_implemented;
+    }
+
+    knowhere::Status
+    DeserializeFromFile(const std::string&, const knowhere::Config&) override {
+        return knowhere::Status::not_implemented;
+    }
+
+    std::unique_ptr<knowhere::BaseConfig>
+    CreateConfig() const override {
+        return std::make_unique<knowhere::BaseConfig>();
+    }
+
+    int64_t
+    Dim() const override {
+        return 0;
+    }
+
+    int64_t
+    Size() const override {
+        return 0;
+    }
+
+    int64_t
+    Count() const override {
+        return 0;
+    }
+
+    std::string
+    Type() const override {
+        return "STUB";
+    }
+};
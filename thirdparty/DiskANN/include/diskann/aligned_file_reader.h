@@ -99,4 +99,28 @@ class AlignedFileReader {
   // async reads
   virtual void get_submitted_req(io_context_t &ctx, size_t n_ops) = 0;
   virtual void submit_req( io_context_t &ctx, std::vector<AlignedRead> &read_reqs) = 0;
+
+  // waits until at least min_n of the submitted reads completed and appends
+  // the buffers of the completed ones, at most max_n, to done
+  virtual void get_completed_req(io_context_t &ctx, size_t min_n,
+                                 size_t max_n, std::vector<void *> &done) {
+    throw diskann::ANNException("reaping single reads is not supported", -1,
+                                __FUNCSIG__, __FILE__, __LINE__);
+  }
+
+  // max number of requests a context has in flight at once
+  virtual size_t max_events_per_ctx() {
+    return MAX_IO_DEPTH;
+  }
+
+  // buffers most reads land in, readers that can pin them read into them
+  // without mapping the pages per request; an empty list drops them
+  virtual void register_buffers(
+      const std::vector<std::pair<void*, size_t>>& bufs) {
+  }
+
+  // the bytes written to the file at offset, for the readers that read
+  // copies of it to write to them too
+  virtual void write_through(uint64_t offset, const void* buf, uint64_t len) {
+  }
 };
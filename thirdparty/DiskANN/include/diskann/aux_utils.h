@@ -27,6 +27,7 @@ typedef int FileHandle;
 #endif
 
 #include "cached_io.h"
+#include "disk_sq_table.h"
 #include "common_includes.h"
 #include "tsl/robin_set.h"
 
@@ -100,10 +101,11 @@ namespace diskann {
    * parameter cannot be generated successfully, it is set to -1.*/
   template<typename T>
   DISKANN_DLLEXPORT std::unique_ptr<diskann::Index<T>> build_merged_vamana_index(
-      std::string base_file, diskann::Metric _compareMetric, unsigned L,
-      unsigned R, bool accelerate_build, double sampling_rate,
+      std::string base_file, bool ip_prepared, diskann::Metric _compareMetric,
+      unsigned L, unsigned R, bool accelerate_build, double sampling_rate,
       double ram_budget, std::string mem_index_path, std::string medoids_file,
-      std::string centroids_file);
+      std::string centroids_file, unsigned concurrent_shards = 1,
+      const KnnGraphBuilder &knn_graph_builder = KnnGraphBuilder());
 
   template<typename T>
   DISKANN_DLLEXPORT void generate_cache_list_from_graph_with_pq(
@@ -119,6 +121,9 @@ namespace diskann {
       _u64 tuning_sample_num, _u64 tuning_sample_aligned_dim, uint32_t L,
       uint32_t nthreads, uint32_t start_bw = 2);
 
+  // the max degree of the navigation graph, see BuildConfig::nav_graph_ratio
+  static constexpr unsigned kNavGraphMaxDegree = 32;
+
   struct BuildConfig {
     std::string     data_file_path = "";
     std::string     index_file_path = "";
@@ -141,6 +146,30 @@ namespace diskann {
     bool accelerate_build = false;
     // the cached nodes number
     uint32_t num_nodes_to_cache = 0;
+    // pack graph neighbors into the same sectors of the disk index
+    bool graph_layout = false;
+    // number of shards built at once when the data does not fit in M, each
+    // shard then gets 1/concurrent_shards of it
+    unsigned concurrent_shards = 1;
+    // store SQ8 or fp16 codes of the vectors in the nodes instead of the
+    // vectors, which are then kept in the reorder data: float data only and
+    // not along with disk PQ
+    DiskSQType disk_sq_type = DiskSQType::NONE;
+    // builds the graph of float vectors from the kNN graph it returns rather
+    // than by searches, see KnnGraphBuilder
+    KnnGraphBuilder knn_graph_builder;
+    // fraction of the float vectors sampled into the navigation graph, a
+    // small in-memory graph searched for the entry points of the disk
+    // searches; none for 0
+    float nav_graph_ratio = 0;
+    // bin file of one uint32 label per point, e.g. its tenant: the points of
+    // every label get a graph of their own stitched into the graph, so that
+    // the searches filtered by a label only follow the edges to its points.
+    // Float data only, none if empty
+    std::string label_file_path = "";
+    // delta-encodes the adjacency lists of the disk nodes, so that more
+    // nodes fit a sector
+    bool compress_graph = false;
   };
 
   template<typename T>
@@ -150,6 +179,21 @@ namespace diskann {
   DISKANN_DLLEXPORT void create_disk_layout(
       const std::string base_file, const std::string mem_index_file,
       const std::string output_file,
-      const std::string reorder_data_file = std::string(""));
+      const std::string reorder_data_file = std::string(""),
+      bool              compress_graph = false);
+
+  // Reorders the nodes of the disk index so that each sector holds a node and
+  // its graph neighbors, and saves the location of every node in layout_file.
+  // The index is left as is for nodes spanning sectors.
+  DISKANN_DLLEXPORT void relayout_disk_index(const std::string &mem_index_file,
+                                             const std::string &disk_index_file,
+                                             const std::string &layout_file);
+
+  // Cuts disk_index_file in stripes of stripe_len bytes, stripe i going to
+  // the file of dirs[i % n] at (i / n) * stripe_len, for a reader to spread
+  // the reads of the index across the devices of dirs. Returns the files.
+  DISKANN_DLLEXPORT std::vector<std::string> stripe_disk_index(
+      const std::string &disk_index_file, const std::vector<std::string> &dirs,
+      _u64 stripe_len);
 
 }  // namespace diskann
@@ -0,0 +1,102 @@
+#pragma once
+#ifndef _WINDOWS
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "aligned_file_reader.h"
+
+// a read one search issued and the others wait for instead of reading the
+// same sector again
+struct CoalescedRead;
+
+// wraps a reader so that the blocking reads of concurrent searches share the
+// sectors they need at the same time: a read of a sector already in flight
+// waits for it and copies its buffer instead of going to the disk. Queries
+// of one batch start from the same entry points and walk close regions of
+// the graph, so they often read the same sectors within a few hops of each
+// other. The async reads of the pipelined search go to the wrapped reader
+// as they are.
+class CoalescingAlignedFileReader : public AlignedFileReader {
+ private:
+  std::shared_ptr<AlignedFileReader> reader_;
+
+  // reads in flight by offset, the condition is signaled whenever one of
+  // them completes or one of its copies is done
+  tsl::robin_map<uint64_t, std::shared_ptr<CoalescedRead>> in_flight_;
+  std::mutex                                               mtx_;
+  std::condition_variable                                  cv_;
+
+  std::atomic<uint64_t> n_reads_{0};
+  std::atomic<uint64_t> n_coalesced_{0};
+
+ public:
+  explicit CoalescingAlignedFileReader(
+      std::shared_ptr<AlignedFileReader> reader)
+      : reader_(std::move(reader)) {
+  }
+  ~CoalescingAlignedFileReader() = default;
+
+  io_context_t get_ctx() {
+    return reader_->get_ctx();
+  }
+  void put_ctx(io_context_t ctx) {
+    reader_->put_ctx(ctx);
+  }
+
+  // Open & close ops
+  // Blocking calls
+  void open(const std::string &fname) {
+    reader_->open(fname);
+  }
+  void close() {
+    reader_->close();
+  }
+
+  // process batch of aligned requests in parallel, sharing the ones other
+  // searches have in flight
+  // NOTE :: blocking call
+  void read(std::vector<AlignedRead> &read_reqs, IOContext &ctx,
+            bool async = false);
+
+  // async reads
+  void get_submitted_req(io_context_t &ctx, size_t n_ops) override {
+    reader_->get_submitted_req(ctx, n_ops);
+  }
+  void submit_req(io_context_t &ctx, std::vector<AlignedRead> &read_reqs) {
+    reader_->submit_req(ctx, read_reqs);
+  }
+  void get_completed_req(io_context_t &ctx, size_t min_n, size_t max_n,
+                         std::vector<void *> &done) override {
+    reader_->get_completed_req(ctx, min_n, max_n, done);
+  }
+
+  size_t max_events_per_ctx() override {
+    return reader_->max_events_per_ctx();
+  }
+
+  void register_buffers(
+      const std::vector<std::pair<void *, size_t>> &bufs) override {
+    reader_->register_buffers(bufs);
+  }
+
+  void write_through(uint64_t offset, const void *buf,
+                     uint64_t len) override {
+    reader_->write_through(offset, buf, len);
+  }
+
+  // number of blocking reads requested and of the ones served by a read
+  // already in flight
+  uint64_t n_reads() const {
+    return n_reads_.load(std::memory_order_relaxed);
+  }
+  uint64_t n_coalesced() const {
+    return n_coalesced_.load(std::memory_order_relaxed);
+  }
+};
+
+#endif
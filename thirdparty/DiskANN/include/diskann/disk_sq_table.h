@@ -0,0 +1,147 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "ann_exception.h"
+#include "simd/hook.h"
+
+namespace diskann {
+
+  enum class DiskSQType : uint32_t { NONE = 0, SQ8 = 1, FP16 = 2 };
+
+  // Scalar quantizer of the float vectors stored next to the nodes of the
+  // disk index instead of the vectors themselves: 8 bits per dimension
+  // between the min and max of the dimension, or fp16. The exact vectors then
+  // live in the reorder data of the index and only rerank the final
+  // candidates.
+  class DiskSQTable {
+   public:
+    DiskSQType type() const {
+      return type_;
+    }
+
+    size_t dim() const {
+      return dim_;
+    }
+
+    size_t code_size() const {
+      return type_ == DiskSQType::SQ8 ? dim_ : dim_ * sizeof(uint16_t);
+    }
+
+    // starts training a quantizer of type on vectors of dim dimensions, the
+    // vectors are then fed to update in batches
+    void init(DiskSQType type, size_t dim) {
+      type_ = type;
+      dim_ = dim;
+      vmin_.assign(type == DiskSQType::SQ8 ? dim : 0,
+                   std::numeric_limits<float>::max());
+      vdiff_.assign(type == DiskSQType::SQ8 ? dim : 0,
+                    std::numeric_limits<float>::lowest());
+    }
+
+    void update(const float *data, size_t n) {
+      if (type_ != DiskSQType::SQ8) {
+        return;
+      }
+      // vdiff_ holds the max until finish
+      for (size_t i = 0; i < n; i++) {
+        for (size_t d = 0; d < dim_; d++) {
+          vmin_[d] = std::min(vmin_[d], data[i * dim_ + d]);
+          vdiff_[d] = std::max(vdiff_[d], data[i * dim_ + d]);
+        }
+      }
+    }
+
+    void finish() {
+      for (size_t d = 0; d < vdiff_.size(); d++) {
+        vdiff_[d] = std::max(vdiff_[d] - vmin_[d], 0.0f) / 255.0f;
+      }
+    }
+
+    void encode(const float *vec, uint8_t *code) const {
+      if (type_ == DiskSQType::FP16) {
+        faiss::fvec_to_fp16((uint16_t *) code, vec, dim_);
+        return;
+      }
+      for (size_t d = 0; d < dim_; d++) {
+        float v = vdiff_[d] > 0 ? (vec[d] - vmin_[d]) / vdiff_[d] : 0;
+        code[d] = (uint8_t) std::clamp(std::nearbyint(v), 0.0f, 255.0f);
+      }
+    }
+
+    void decode(const uint8_t *code, float *vec) const {
+      if (type_ == DiskSQType::FP16) {
+        faiss::fp16_to_fvec(vec, (const uint16_t *) code, dim_);
+        return;
+      }
+      for (size_t d = 0; d < dim_; d++) {
+        vec[d] = vmin_[d] + code[d] * vdiff_[d];
+      }
+    }
+
+    // squared L2 distance, or negated inner product, between query and the
+    // vector of code, as the float distance functions of the index compute
+    // them on the exact vectors
+    float distance(const float *query, const uint8_t *code, bool ip) const {
+      if (type_ == DiskSQType::FP16) {
+        return ip ? -faiss::fp16vec_inner_product(query, (const uint16_t *) code,
+                                                  dim_)
+                  : faiss::fp16vec_L2sqr(query, (const uint16_t *) code, dim_);
+      }
+      float res = 0;
+      if (ip) {
+        for (size_t d = 0; d < dim_; d++) {
+          res += query[d] * (vmin_[d] + code[d] * vdiff_[d]);
+        }
+        return -res;
+      }
+      for (size_t d = 0; d < dim_; d++) {
+        float diff = query[d] - (vmin_[d] + code[d] * vdiff_[d]);
+        res += diff * diff;
+      }
+      return res;
+    }
+
+    // [type(u32)][dim(u32)], then for SQ8 [min(float) x dim][step(float) x dim]
+    void save(const std::string &file) const {
+      std::ofstream writer(file, std::ios::binary);
+      writer.exceptions(std::ios::failbit | std::ios::badbit);
+      uint32_t type = (uint32_t) type_, dim = (uint32_t) dim_;
+      writer.write((char *) &type, sizeof(uint32_t));
+      writer.write((char *) &dim, sizeof(uint32_t));
+      writer.write((char *) vmin_.data(), vmin_.size() * sizeof(float));
+      writer.write((char *) vdiff_.data(), vdiff_.size() * sizeof(float));
+    }
+
+    void load(const std::string &file) {
+      std::ifstream reader(file, std::ios::binary);
+      uint32_t      type = 0, dim = 0;
+      reader.read((char *) &type, sizeof(uint32_t));
+      reader.read((char *) &dim, sizeof(uint32_t));
+      if (!reader || (type != (uint32_t) DiskSQType::SQ8 &&
+                      type != (uint32_t) DiskSQType::FP16)) {
+        throw ANNException("Invalid disk sq table " + file, -1, __FUNCSIG__,
+                           __FILE__, __LINE__);
+      }
+      init((DiskSQType) type, dim);
+      reader.read((char *) vmin_.data(), vmin_.size() * sizeof(float));
+      reader.read((char *) vdiff_.data(), vdiff_.size() * sizeof(float));
+      if (!reader) {
+        throw ANNException("Truncated disk sq table " + file, -1, __FUNCSIG__,
+                           __FILE__, __LINE__);
+      }
+    }
+
+   private:
+    DiskSQType         type_ = DiskSQType::NONE;
+    size_t             dim_ = 0;
+    std::vector<float> vmin_;
+    std::vector<float> vdiff_;
+  };
+
+}  // namespace diskann
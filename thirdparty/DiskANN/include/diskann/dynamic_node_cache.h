@@ -0,0 +1,188 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "tsl/robin_map.h"
+#include "tsl/robin_set.h"
+
+namespace diskann {
+
+  // Node cache filled from the live query traffic. Searches count the nodes
+  // they expand in a count-min sketch and sample the ones they had to read
+  // from disk. A refresh ranks the sampled and the cached nodes by their
+  // estimated frequency, so that a sampled node only displaces cached nodes
+  // seen less often (TinyLFU admission), builds a new table holding the best
+  // capacity ones and swaps it in. Searches take the table once per query and
+  // never wait for a refresh, the table they hold stays alive until they drop
+  // it.
+  class DynamicNodeCache {
+   public:
+    // cached node records, laid out as on disk: coords, nnbrs, nbrs
+    struct Table {
+      tsl::robin_map<uint32_t, uint32_t> slots;  // id -> slot
+      std::vector<uint32_t>              ids;
+      std::vector<char>                  records;
+      size_t                             record_len = 0;
+
+      const char *find(uint32_t id) const {
+        auto iter = slots.find(id);
+        return iter == slots.end()
+                   ? nullptr
+                   : records.data() + (size_t) iter->second * record_len;
+      }
+    };
+
+    DynamicNodeCache(size_t capacity, size_t record_len,
+                     size_t refresh_interval)
+        : capacity_(capacity), record_len_(record_len),
+          refresh_interval_(refresh_interval) {
+      size_t width = 1024;
+      while (width < capacity * 4) {
+        width <<= 1;
+      }
+      width_mask_ = width - 1;
+      sketch_.reset(new std::atomic<uint16_t>[kSketchDepth * width]());
+      sketch_size_ = kSketchDepth * width;
+      samples_.resize(std::clamp<size_t>(capacity * 2, 1024, 1 << 20));
+      auto table = std::make_shared<Table>();
+      table->record_len = record_len;
+      std::atomic_store(&table_, std::shared_ptr<const Table>(table));
+    }
+
+    size_t capacity() const {
+      return capacity_;
+    }
+
+    size_t record_len() const {
+      return record_len_;
+    }
+
+    std::shared_ptr<const Table> table() const {
+      return std::atomic_load(&table_);
+    }
+
+    // a search expanded id
+    void record_access(uint32_t id) {
+      for (size_t r = 0; r < kSketchDepth; r++) {
+        auto &counter = sketch_[r * (width_mask_ + 1) + slot_of(id, r)];
+        if (counter.load(std::memory_order_relaxed) < UINT16_MAX) {
+          counter.fetch_add(1, std::memory_order_relaxed);
+        }
+      }
+    }
+
+    // a search read id from disk, it becomes a candidate of the next refresh
+    void record_miss(uint32_t id) {
+      record_access(id);
+      auto pos = sample_pos_.fetch_add(1, std::memory_order_relaxed);
+      reinterpret_cast<std::atomic<uint32_t> &>(
+          samples_[pos % samples_.size()])
+          .store(id, std::memory_order_relaxed);
+    }
+
+    // true for the one search of every refresh_interval ones that should
+    // start a refresh, unless the previous one is still running
+    bool count_query() {
+      if (queries_.fetch_add(1, std::memory_order_relaxed) + 1 <
+          refresh_interval_) {
+        return false;
+      }
+      queries_.store(0, std::memory_order_relaxed);
+      bool expected = false;
+      return refreshing_.compare_exchange_strong(expected, true);
+    }
+
+    // the nodes the next table holds, the ones already cached first
+    std::vector<uint32_t> select() {
+      auto cur = table();
+      const size_t n_samples =
+          std::min(sample_pos_.exchange(0), samples_.size());
+      tsl::robin_set<uint32_t> candidates(cur->ids.begin(), cur->ids.end());
+      for (size_t i = 0; i < n_samples; i++) {
+        candidates.insert(reinterpret_cast<std::atomic<uint32_t> &>(samples_[i])
+                              .load(std::memory_order_relaxed));
+      }
+      std::vector<std::pair<uint32_t, uint32_t>> ranked;  // <freq, id>
+      ranked.reserve(candidates.size());
+      for (auto id : candidates) {
+        ranked.emplace_back(estimate(id), id);
+      }
+      const size_t n = std::min(capacity_, ranked.size());
+      // ties keep the cached nodes
+      std::partial_sort(ranked.begin(), ranked.begin() + n, ranked.end(),
+                        [&cur](const auto &a, const auto &b) {
+                          if (a.first != b.first) {
+                            return a.first > b.first;
+                          }
+                          return cur->slots.count(a.second) >
+                                 cur->slots.count(b.second);
+                        });
+      std::vector<uint32_t> ids(n);
+      for (size_t i = 0; i < n; i++) {
+        ids[i] = ranked[i].second;
+      }
+      std::stable_partition(ids.begin(), ids.end(), [&cur](uint32_t id) {
+        return cur->slots.count(id) > 0;
+      });
+      return ids;
+    }
+
+    // swaps next in and halves the counts, so the frequencies follow the
+    // traffic as it changes
+    void install(std::shared_ptr<const Table> next) {
+      std::atomic_store(&table_, std::move(next));
+      for (size_t i = 0; i < sketch_size_; i++) {
+        sketch_[i].store(sketch_[i].load(std::memory_order_relaxed) >> 1,
+                         std::memory_order_relaxed);
+      }
+      refreshing_.store(false);
+    }
+
+    // gives up a refresh that failed
+    void abort_refresh() {
+      refreshing_.store(false);
+    }
+
+   private:
+    static constexpr size_t kSketchDepth = 4;
+
+    size_t slot_of(uint32_t id, size_t row) const {
+      static constexpr uint64_t seeds[kSketchDepth] = {
+          0x9E3779B97F4A7C15ULL, 0xC2B2AE3D27D4EB4FULL, 0x165667B19E3779F9ULL,
+          0xD6E8FEB86659FD93ULL};
+      return ((id + 1) * seeds[row] >> 32) & width_mask_;
+    }
+
+    uint32_t estimate(uint32_t id) const {
+      uint32_t freq = UINT16_MAX;
+      for (size_t r = 0; r < kSketchDepth; r++) {
+        freq = std::min<uint32_t>(
+            freq, sketch_[r * (width_mask_ + 1) + slot_of(id, r)].load(
+                      std::memory_order_relaxed));
+      }
+      return freq;
+    }
+
+    const size_t capacity_;
+    const size_t record_len_;
+    const size_t refresh_interval_;
+
+    std::unique_ptr<std::atomic<uint16_t>[]> sketch_;
+    size_t                                   sketch_size_ = 0;
+    size_t                                   width_mask_ = 0;
+
+    std::vector<uint32_t> samples_;
+    std::atomic<size_t>   sample_pos_{0};
+
+    std::atomic<size_t> queries_{0};
+    std::atomic<bool>   refreshing_{false};
+
+    std::shared_ptr<const Table> table_;
+  };
+
+}  // namespace diskann
@@ -0,0 +1,151 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace diskann {
+
+  // how the nodes of a disk index store their adjacency lists, after their
+  // coordinates: nnbrs followed by the ids as they are, or delta-encoded
+  enum class GraphCodec : uint64_t { NONE = 0, DELTA = 1 };
+
+  // Delta encoding of an adjacency list: its ids sorted ascending, the first
+  // one as it is and the gaps to the next ones bit-packed, LSB first, at the
+  // width of the largest gap.
+  //
+  //   [u32 nnbrs][u32 first id][u8 width][(nnbrs - 1) gaps of width bits]
+  //
+  // nnbrs stays where the plain list has it. The gaps between the sorted
+  // neighbors of a node are about npts / nnbrs, a list then takes about half
+  // of the 4 * nnbrs bytes of the plain one and more nodes fit a sector.
+  namespace delta_graph {
+    constexpr size_t kHeaderLen = 2 * sizeof(uint32_t) + sizeof(uint8_t);
+
+    inline uint32_t gap_width(const uint32_t *sorted, size_t n) {
+      uint32_t max_gap = 0;
+      for (size_t i = 1; i < n; i++) {
+        max_gap = std::max(max_gap, sorted[i] - sorted[i - 1]);
+      }
+      uint32_t width = 0;
+      while (width < 32 && (max_gap >> width) != 0) {
+        width++;
+      }
+      return width;
+    }
+
+    inline size_t encoded_len(size_t n, uint32_t width) {
+      return n == 0 ? sizeof(uint32_t)
+                    : kHeaderLen + ((n - 1) * width + 7) / 8;
+    }
+
+    // bytes the n ids take encoded, sorts them
+    inline size_t encoded_len(uint32_t *ids, size_t n) {
+      std::sort(ids, ids + n);
+      return encoded_len(n, gap_width(ids, n));
+    }
+
+    // encodes the n ids to out, sorting them, returns the bytes written
+    inline size_t encode(uint32_t *ids, size_t n, uint8_t *out) {
+      std::sort(ids, ids + n);
+      uint32_t nnbrs = (uint32_t) n;
+      memcpy(out, &nnbrs, sizeof(uint32_t));
+      if (n == 0) {
+        return sizeof(uint32_t);
+      }
+      uint32_t width = gap_width(ids, n);
+      memcpy(out + sizeof(uint32_t), ids, sizeof(uint32_t));
+      out[2 * sizeof(uint32_t)] = (uint8_t) width;
+
+      uint8_t *p = out + kHeaderLen;
+      uint64_t acc = 0;
+      uint32_t nbits = 0;
+      for (size_t i = 1; i < n; i++) {
+        acc |= (uint64_t) (ids[i] - ids[i - 1]) << nbits;
+        nbits += width;
+        for (; nbits >= 8; nbits -= 8) {
+          *p++ = (uint8_t) acc;
+          acc >>= 8;
+        }
+      }
+      if (nbits > 0) {
+        *p++ = (uint8_t) acc;
+      }
+      return p - out;
+    }
+
+    // the gap of width bits at bit of the packed gaps
+    inline uint32_t read_gap(const uint8_t *gaps, size_t bit, uint32_t width) {
+      const uint8_t *p = gaps + bit / 8;
+      uint32_t       shift = bit % 8;
+      uint32_t       nbytes = (shift + width + 7) / 8;
+      uint64_t       v = 0;
+      for (uint32_t j = 0; j < nbytes; j++) {
+        v |= (uint64_t) p[j] << (8 * j);
+      }
+      return (uint32_t) ((v >> shift) & ((1ULL << width) - 1));
+    }
+
+    // decodes the list at in to out, of room for all its ids, returns nnbrs
+    inline size_t decode(const uint8_t *in, uint32_t *out) {
+      uint32_t n;
+      memcpy(&n, in, sizeof(uint32_t));
+      if (n == 0) {
+        return 0;
+      }
+      uint32_t cur;
+      memcpy(&cur, in + sizeof(uint32_t), sizeof(uint32_t));
+      uint32_t       width = in[2 * sizeof(uint32_t)];
+      const uint8_t *gaps = in + kHeaderLen;
+      size_t         ngaps = n - 1;
+      out[0] = cur;
+
+      size_t g = 0;
+#if defined(__AVX2__)
+      // 8 gaps at a time: each is gathered as the 32 bits at its first byte,
+      // shifted down and masked, then prefix-summed onto the last id. The
+      // gathers must not read past the list, the gaps after the last whole
+      // group in it are decoded one by one.
+      if (width > 0 && width <= 25) {
+        size_t         gaps_len = (ngaps * width + 7) / 8;
+        const __m256i  vwidth = _mm256_set1_epi32(width);
+        const __m256i  vmask = _mm256_set1_epi32((1U << width) - 1);
+        const __m256i  seven = _mm256_set1_epi32(7);
+        const __m256i  lane_bits = _mm256_mullo_epi32(
+            _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), vwidth);
+        __m256i        run = _mm256_set1_epi32(cur);
+        for (; g + 8 <= ngaps && ((g + 7) * width) / 8 + 4 <= gaps_len;
+             g += 8) {
+          __m256i bits = _mm256_add_epi32(
+              _mm256_set1_epi32((int) (g * width)), lane_bits);
+          __m256i v = _mm256_i32gather_epi32(
+              (const int *) gaps, _mm256_srli_epi32(bits, 3), 1);
+          v = _mm256_srlv_epi32(v, _mm256_and_si256(bits, seven));
+          v = _mm256_and_si256(v, vmask);
+          // prefix sum in each 128 bits, then the low half's sum carried to
+          // the high half
+          v = _mm256_add_epi32(v, _mm256_slli_si256(v, 4));
+          v = _mm256_add_epi32(v, _mm256_slli_si256(v, 8));
+          __m256i low_sum = _mm256_shuffle_epi32(v, 0xFF);
+          v = _mm256_add_epi32(
+              v, _mm256_permute2x128_si256(low_sum, low_sum, 0x08));
+          v = _mm256_add_epi32(v, run);
+          _mm256_storeu_si256((__m256i *) (out + 1 + g), v);
+          run = _mm256_permutevar8x32_epi32(v, _mm256_set1_epi32(7));
+        }
+        cur = out[g];
+      }
+#endif
+      for (; g < ngaps; g++) {
+        cur += read_gap(gaps, g * width, width);
+        out[g + 1] = cur;
+      }
+      return n;
+    }
+  }  // namespace delta_graph
+
+}  // namespace diskann
@@ -47,6 +47,13 @@ namespace diskann {
                               size_of_outer_vector);
   }
 
+  // Builds an approximate kNN graph of the rows float vectors by their L2
+  // distances, k neighbor ids a row, for the build to prune into the graph
+  // instead of searching it for the neighbors of every point. An empty graph
+  // leaves the build to the searches.
+  using KnnGraphBuilder = std::function<std::vector<unsigned>(
+      const float *data, size_t rows, size_t dim, unsigned k)>;
+
   template<typename T>
   struct InMemQueryScratch {
     std::vector<Neighbor>    *_pool = nullptr;
@@ -329,6 +336,11 @@ namespace diskann {
 
     void link(Parameters &parameters);
 
+    // the graph of link() from the k neighbors a row of knn_graph, pruned
+    // along with the rows having them in theirs, without any search
+    void link_knn_graph(Parameters                  &parameters,
+                        const std::vector<unsigned> &knn_graph, unsigned k);
+
     // WARNING: Do not call reserve_location() without acquiring change_lock_
     int  reserve_location();
     void release_location();
@@ -0,0 +1,102 @@
+#pragma once
+#ifndef _WINDOWS
+
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "aligned_file_reader.h"
+#include "aio_context_pool.h"
+
+// one io_uring instance, used by one search at a time like an aio context
+struct IoUringRing;
+
+// reads the index file through io_uring rings, each context handed out is a
+// ring of max_events_per_ctx() entries. The file and the registered buffers
+// are registered with every ring, so that reads into them skip the per request
+// file lookup and page pinning, and with sqpoll one kernel thread shared by
+// the rings of the reader polls their submission queues.
+class IoUringAlignedFileReader : public AlignedFileReader {
+ private:
+  FileHandle file_desc;
+  size_t     queue_depth_;
+  bool       sqpoll_;
+
+  // all rings created, the idle ones and the buffers they should register,
+  // rings whose buf_gen lags behind buf_gen_ re-register when handed out
+  std::vector<std::unique_ptr<IoUringRing>> rings_;
+  std::vector<IoUringRing *>                idle_rings_;
+  std::vector<std::pair<void *, size_t>>    bufs_;
+  uint64_t                                  buf_gen_ = 0;
+  std::mutex                                ring_mtx_;
+
+  IoUringRing *create_ring();
+  void         sync_ring(IoUringRing *ring);
+
+ public:
+  IoUringAlignedFileReader();
+  ~IoUringAlignedFileReader();
+
+  io_context_t get_ctx();
+  void         put_ctx(io_context_t ctx);
+
+  // Open & close ops
+  // Blocking calls
+  void open(const std::string &fname);
+  void close();
+
+  // process batch of aligned requests in parallel
+  // NOTE :: blocking call
+  void read(std::vector<AlignedRead> &read_reqs, IOContext &ctx,
+            bool async = false);
+
+  // async reads
+  void get_submitted_req(io_context_t &ctx, size_t n_ops) override;
+  void submit_req(io_context_t &ctx, std::vector<AlignedRead> &read_reqs);
+  void get_completed_req(io_context_t &ctx, size_t min_n, size_t max_n,
+                         std::vector<void *> &done) override;
+
+  size_t max_events_per_ctx() override {
+    return queue_depth_;
+  }
+
+  void register_buffers(
+      const std::vector<std::pair<void *, size_t>> &bufs) override;
+
+  // readers created from now on use io_uring with rings of queue_depth
+  // entries, returns false if the kernel does not provide io_uring
+  static bool InitGlobalConfig(size_t queue_depth, bool sqpoll) {
+    if (queue_depth == 0 || queue_depth > default_max_events) {
+      LOG(ERROR) << "io_uring queue depth " << queue_depth
+                 << " should be in [1, " << default_max_events << "]";
+      return false;
+    }
+    if (!Supported()) {
+      LOG(ERROR) << "io_uring is not available, keep reading with libaio";
+      return false;
+    }
+    std::scoped_lock lk(global_mut);
+    global_enabled = true;
+    global_queue_depth = queue_depth;
+    global_sqpoll = sqpoll;
+    return true;
+  }
+
+  static bool GlobalEnabled() {
+    std::scoped_lock lk(global_mut);
+    return global_enabled;
+  }
+
+  // whether io_uring rings can be set up, it may be compiled out of the
+  // kernel or disabled through kernel.io_uring_disabled
+  static bool Supported();
+
+ private:
+  inline static bool       global_enabled = false;
+  inline static size_t     global_queue_depth = default_max_events;
+  inline static bool       global_sqpoll = false;
+  inline static std::mutex global_mut;
+};
+
+#endif
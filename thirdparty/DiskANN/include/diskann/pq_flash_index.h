@@ -13,14 +13,20 @@
 #include "tsl/robin_set.h"
 
 #include "knowhere/bitsetview.h"
+#include "knowhere/comp/memory_usage.h"
 #include "knowhere/feder/DiskANN.h"
 
 #include "aligned_file_reader.h"
 #include "concurrent_queue.h"
+#include "disk_sq_table.h"
+#include "dynamic_node_cache.h"
+#include "graph_codec.h"
+#include "memory_mapper.h"
 #include "neighbor.h"
 #include "parameters.h"
 #include "percentile_stats.h"
 #include "pq_table.h"
+#include "sector_buffer_pool.h"
 #include "utils.h"
 #include "windows_customizations.h"
 #include "diskann/distance.h"
@@ -36,8 +42,8 @@ namespace diskann {
   struct QueryScratch {
     T *coord_scratch = nullptr;  // MUST BE AT LEAST [sizeof(T) * data_dim]
 
-    char *sector_scratch =
-        nullptr;          // MUST BE AT LEAST [MAX_N_SECTOR_READS * SECTOR_LEN]
+    // the sector scratch, MAX_N_SECTOR_READS * read_len_for_node bytes, is
+    // borrowed from the SectorBufferPool for each search
     _u64 sector_idx = 0;  // index of next [SECTOR_LEN] scratch to use
 
     float *aligned_pqtable_dist_scratch =
@@ -46,6 +52,8 @@ namespace diskann {
         nullptr;  // MUST BE AT LEAST diskann MAX_DEGREE
     _u8 *aligned_pq_coord_scratch =
         nullptr;  // MUST BE AT LEAST  [N_CHUNKS * MAX_DEGREE]
+    unsigned *nbrs_scratch =
+        nullptr;  // MUST BE AT LEAST diskann MAX_DEGREE, decoded neighbors
     T     *aligned_query_T = nullptr;
     float *aligned_query_float = nullptr;
 
@@ -62,6 +70,27 @@ namespace diskann {
     QueryScratch<T> scratch;
   };
 
+  // limits of the search of one query, a search running out of them stops
+  // expanding and returns the best results it found so far
+  struct SearchBudget {
+    _u64 max_ios = 0;      // sector reads of the beam search, 0 for no limit
+    _u64 deadline_us = 0;  // time from the start of the search, 0 for none
+  };
+
+  // the search of a query, kept so that a later cached_beam_search of the
+  // same query with a larger l_search resumes it instead of starting over
+  struct BeamSearchState {
+    bool started = false;
+    // the candidate list, sorted, and the visited candidates that did not
+    // fit in it
+    std::vector<Neighbor> retset;
+    std::vector<Neighbor> spilled;
+    // the nodes whose full precision distance is known
+    std::vector<Neighbor>    full_retset;
+    tsl::robin_set<unsigned> scored;
+    tsl::robin_set<_u64>     visited;
+  };
+
   template<typename T>
   class PQFlashIndex {
    public:
@@ -74,12 +103,26 @@ namespace diskann {
     DISKANN_DLLEXPORT int load(diskann::MemoryMappedFiles &files,
                                uint32_t num_threads, const char *index_prefix);
 #else
-    // load compressed data, and obtains the handle to the disk-resident index
-    DISKANN_DLLEXPORT int  load(uint32_t num_threads, const char *index_prefix);
+    // load compressed data, and obtains the handle to the disk-resident index;
+    // with mmap_pq_data the compressed vectors are mapped, so that the load
+    // does not wait for them and the searches page them in as they go
+    DISKANN_DLLEXPORT int  load(uint32_t num_threads, const char *index_prefix,
+                                bool mmap_pq_data = false);
 #endif
 
     DISKANN_DLLEXPORT void load_cache_list(std::vector<uint32_t> &node_list);
 
+    // loads the navigation graph of nav_file, see build_nav_graph, the
+    // searches then start from the points of it closest to their queries
+    // rather than from the medoid; to be called before any search
+    DISKANN_DLLEXPORT void load_nav_graph(const std::string &nav_file);
+
+    // caches up to num_nodes_to_cache nodes picked from the nodes the
+    // searches read, reconsidered every refresh_interval searches; a refresh
+    // holds the old and the new table, so each holds at most half of them
+    DISKANN_DLLEXPORT void enable_dynamic_cache(_u64 num_nodes_to_cache,
+                                                _u64 refresh_interval);
+
 #ifdef EXEC_ENV_OLS
     DISKANN_DLLEXPORT void generate_cache_list_from_sample_queries(
         MemoryMappedFiles &files, std::string sample_bin, _u64 l_search,
@@ -94,25 +137,61 @@ namespace diskann {
     DISKANN_DLLEXPORT void cache_bfs_levels(_u64 num_nodes_to_cache,
                                             std::vector<uint32_t> &node_list);
 
-    DISKANN_DLLEXPORT void cached_beam_search(
+    // returns false if the budget stopped the search before it converged.
+    // With a filter_label of an index built with labels the search starts
+    // from the medoid of the label and only follows the edges to its nodes,
+    // the bitset still applies to them
+    DISKANN_DLLEXPORT bool cached_beam_search(
         const T *query, const _u64 k_search, const _u64 l_search, _s64 *res_ids,
         float *res_dists, const _u64 beam_width,
         const bool use_reorder_data = false, QueryStats *stats = nullptr,
         const knowhere::feder::diskann::FederResultUniq &feder = nullptr,
         knowhere::BitsetView                             bitset_view = nullptr,
         const float                                      filter_ratio = -1.0f,
-        const bool                                       for_tuning = false);
+        const bool                                       for_tuning = false,
+        const bool                                       pipelined = false,
+        const bool                                       score_sector_nodes = false,
+        BeamSearchState                                 *state = nullptr,
+        const SearchBudget                              *budget = nullptr,
+        const _s64                                       filter_label = -1,
+        const bool                                       adaptive_beam = false);
+
+    // searches the nq queries, query_stride elements apart, all at once on
+    // the calling thread: every query keeps up to beam_width reads in flight
+    // on the IO context of the thread, which expands the nodes of whichever
+    // query a read completes for, so that the thread overlaps the IO waits of
+    // the queries rather than blocking on each. The reads of all the queries
+    // go out in one submit per round, at most max_events_per_ctx in flight.
+    // The searches of a heavily filtered bitset and of the indexes whose
+    // nodes hold quantized vectors go query by query through
+    // cached_beam_search. stats holds nq entries, if any. Returns the number
+    // of queries cut short by the cancellation token.
+    DISKANN_DLLEXPORT _u64 interleaved_beam_search(
+        const T *queries, const _u64 nq, const _u64 query_stride,
+        const _u64 k_search, const _u64 l_search, _s64 *res_ids,
+        float *res_dists, const _u64 beam_width, QueryStats *stats = nullptr,
+        knowhere::BitsetView bitset_view = nullptr,
+        const float filter_ratio = -1.0f, const bool for_tuning = false);
 
     DISKANN_DLLEXPORT _u32 range_search(
         const T *query1, const double range, const _u64 min_l_search,
         const _u64 max_l_search, std::vector<_s64> &indices,
         std::vector<float> &distances, const _u64 beam_width,
         const float l_k_ratio, knowhere::BitsetView bitset_view = nullptr,
-        QueryStats *stats = nullptr);
+        QueryStats *stats = nullptr, const _u64 max_results = 0,
+        const float range_filter = 0);
 
     DISKANN_DLLEXPORT void get_vector_by_ids(
         const int64_t *ids, const int64_t n, T *const output_data);
 
+    // rewrites on disk, sector by sector, the neighbor lists that link to the
+    // deleted points, the links going to the neighbors of those points closest
+    // to the node by PQ distance. The deleted nodes keep their lists, so the
+    // searches running meanwhile still pass through them. Returns the number
+    // of nodes patched.
+    DISKANN_DLLEXPORT _u64
+    patch_deleted_nodes(const std::vector<bool> &deleted);
+
     std::shared_ptr<AlignedFileReader> reader;
 
     DISKANN_DLLEXPORT _u64 get_num_points() const noexcept;
@@ -127,27 +206,90 @@ namespace diskann {
 
     DISKANN_DLLEXPORT diskann::Metric get_metric() const noexcept;
 
+    // the memory the index holds besides the disk index file, which it reads
+    // with direct IO
+    DISKANN_DLLEXPORT knowhere::MemoryUsage get_memory_usage() const noexcept;
+
    protected:
     DISKANN_DLLEXPORT void use_medoids_data_as_centroids();
     DISKANN_DLLEXPORT void setup_thread_data(_u64 nthreads);
     DISKANN_DLLEXPORT void destroy_thread_data();
 
    private:
+    // location of node_id in the graph part, its id unless the index was
+    // relaid out by graph neighborhood
+    _u64 get_node_loc(_u64 node_id) {
+      return node_locs.empty() ? node_id : node_locs[node_id];
+    }
+
+    // the n points closest to the query found by a greedy search of list size
+    // l over the navigation graph, by their ids in the index, closest first
+    void nav_graph_search(const float *query, unsigned n, unsigned l,
+                          std::vector<unsigned> &ids) const;
+
     // sector # on disk where node_id is present with in the graph part
     _u64 get_node_sector_offset(_u64 node_id) {
-      return long_node ? (node_id * nsectors_per_node + 1) * SECTOR_LEN
-                       : (node_id / nnodes_per_sector + 1) * SECTOR_LEN;
+      return long_node
+                 ? (node_id * nsectors_per_node + 1) * SECTOR_LEN
+                 : (get_node_loc(node_id) / nnodes_per_sector + 1) * SECTOR_LEN;
     }
 
     // obtains region of sector containing node
     char *get_offset_to_node(char *sector_buf, _u64 node_id) {
-      return long_node
-                 ? sector_buf
-                 : sector_buf + (node_id % nnodes_per_sector) * max_node_len;
+      return long_node ? sector_buf
+                       : sector_buf + (get_node_loc(node_id) % nnodes_per_sector) *
+                                          max_node_len;
     }
 
+    // the neighbors of the node at node_buf and their number, decoded into
+    // nbrs_scratch of MAX_GRAPH_DEGREE ids if the adjacency lists are encoded
+    unsigned *get_node_nbrs(char *node_buf, _u64 &nnbrs,
+                            unsigned *nbrs_scratch) const {
+      unsigned *nhood = (unsigned *) (node_buf + disk_bytes_per_point);
+      if (graph_codec == GraphCodec::NONE) {
+        nnbrs = *nhood;
+        return nhood + 1;
+      }
+      nnbrs = delta_graph::decode((const uint8_t *) nhood, nbrs_scratch);
+      return nbrs_scratch;
+    }
+
+    // the exact vector of node_id, in its node unless the nodes hold
+    // quantized vectors, which keep the exact ones in the reorder data
+    _u64  get_vector_sector_offset(_u64 node_id);
+    _u64  get_vector_read_len();
+    char *get_offset_to_vector(char *sector_buf, _u64 node_id);
+
+    // distance between the query and the vector a node stores, exact or as
+    // compressed by disk PQ or the disk scalar quantizer
+    float disk_node_dist(const T *query, const float *query_float,
+                         const T *node_coords, unsigned id);
+
+    // borrows the sector scratch of a search, to do before getting the io
+    // context so that the context reads into the buffers the pool has now
+    SectorBufferPool::Buffer borrow_sector_scratch();
+
     inline void copy_vec_base_data(T *des, const int64_t des_idx, void *src);
 
+    // the scratch of a search, and its release
+    ThreadData<T> alloc_thread_data();
+    void          free_thread_data(ThreadData<T> &data);
+
+    // the entry points of a search of the query: the points of the
+    // navigation graph closest to it, else the closest medoid
+    void pick_entry_points(const float *query_float, _u64 l_search,
+                           std::vector<unsigned> &entry_points);
+
+    // the k_search best of the sorted full_retset into indices and distances,
+    // as distances of the metric of the index; -1 past the results
+    void copy_results(const std::vector<Neighbor> &full_retset,
+                      const _u64 k_search, _s64 *indices, float *distances,
+                      const float query_norm);
+
+    // counts a search for the dynamic cache, refreshing it in the background
+    // every refresh interval
+    void count_dynamic_cache_query();
+
     // Init thread data and returns query norm if avaialble.
     // If there is no value, there is nothing to do with the given query
     std::optional<float> init_thread_data(ThreadData<T> &data, const T *query1);
@@ -159,10 +301,13 @@ namespace diskann {
     void brute_force_beam_search(
         ThreadData<T> &data, const float query_norm, const _u64 k_search,
         _s64 *indices, float *distances, const _u64 beam_width_param,
-        IOContext &ctx, QueryStats *stats,
+        IOContext &ctx, char *sector_scratch, QueryStats *stats,
         const knowhere::feder::diskann::FederResultUniq &feder,
         knowhere::BitsetView                             bitset_view);
 
+    // rebuilds the dynamic cache table, reading the newly admitted nodes
+    void refresh_dynamic_cache();
+
     // Assign the index of ids to its corresponding sector and if it is in
     // cache, write to the output_data
     DISKANN_DLLEXPORT std::unordered_map<_u64, std::vector<_u64>>
@@ -175,6 +320,9 @@ namespace diskann {
     // nnbrs of node `i`: *(unsigned*) (buf)
     // nbrs of node `i`: ((unsigned*)buf) + 1
     _u64 max_node_len = 0, nnodes_per_sector = 0, max_degree = 0;
+    // how the nodes store their adjacency lists, nnbrs and the nbrs above
+    // unless encoded
+    GraphCodec graph_codec = GraphCodec::NONE;
 
     // Data used for searching with re-order vectors
     _u64 ndims_reorder_vecs = 0, reorder_data_start_sector = 0,
@@ -202,6 +350,11 @@ namespace diskann {
     _u64 aligned_dim = 0;
     _u64 disk_bytes_per_point = 0;
 
+    // node locations and the nodes at each location, empty when the nodes
+    // are laid out by id
+    std::vector<_u32> node_locs;
+    std::vector<_u32> loc_nodes;
+
     std::string                        disk_index_file;
     std::vector<std::pair<_u32, _u32>> node_visit_counter;
 
@@ -211,6 +364,7 @@ namespace diskann {
     // chunk_size = chunk size of each dimension chunk
     // pq_tables = float* [[2^8 * [chunk_size]] * n_chunks]
     _u8              *data = nullptr;
+    std::unique_ptr<MemoryMapper> data_mapper;  // holds data when mapped
     _u64              n_chunks;
     FixedChunkPQTable pq_table;
 
@@ -240,6 +394,10 @@ namespace diskann {
     _u64              disk_pq_n_chunks = 0;
     FixedChunkPQTable disk_pq_table;
 
+    // or scalar quantized vectors, the exact ones in the reorder data
+    bool        use_disk_index_sq = false;
+    DiskSQTable disk_sq_table;
+
     // medoid/start info
 
     // graph has one entry point by default,
@@ -252,8 +410,26 @@ namespace diskann {
     // closest centroid as the starting point of search
     float *centroid_data = nullptr;
 
+    // navigation graph, when loaded: the ids in the index of its points,
+    // their vectors of data_dim floats and their neighbor lists of the
+    // number of neighbors followed by nav_degree neighbors
+    _u32               nav_npts = 0;
+    _u32               nav_degree = 0;
+    _u32               nav_entry = 0;
+    std::vector<_u32>  nav_ids;
+    std::vector<float> nav_data;
+    std::vector<_u32>  nav_graph;
+
+    // the label of every node and the medoid of every label, of an index
+    // built with labels
+    std::vector<_u32>          node_labels;
+    tsl::robin_map<_u32, _u32> label_medoids;
+
     // nhood_cache
-    unsigned *nhood_cache_buf = nullptr;
+    // the searches only look the node cache up once load_cache_list filled
+    // it, which may run while they go
+    std::atomic<bool> node_cache_loaded{false};
+    unsigned         *nhood_cache_buf = nullptr;
     tsl::robin_map<_u32, std::pair<_u32, _u32 *>>
         nhood_cache;  // <id, <neihbors_num, neihbors>>
 
@@ -261,15 +437,27 @@ namespace diskann {
     T                        *coord_cache_buf = nullptr;
     tsl::robin_map<_u32, T *> coord_cache;
 
+    // dynamic_cache, refreshed in the background on the search pool
+    std::unique_ptr<DynamicNodeCache>          dynamic_cache;
+    std::optional<folly::Future<folly::Unit>> dynamic_cache_refresh;
+    std::mutex                                 dynamic_cache_mtx;
+
     // thread-specific scratch
     ConcurrentQueue<ThreadData<T>> thread_data;
+    // the scratch of the queries of interleaved searches, allocated as they
+    // need it and kept for the next ones
+    ConcurrentQueue<ThreadData<T>> interleave_data;
     _u64                           max_nthreads;
     bool                           load_flag = false;
     bool                           count_visited_nodes = false;
     bool                           reorder_data_exists = false;
     _u64                           reoreder_data_offset = 0;
 
-    mutable knowhere::lru_cache<uint64_t, uint32_t> lru_cache;
+    // generation of the sector buffer pool registered with the reader
+    uint64_t   sector_bufs_gen = 0;
+    std::mutex sector_bufs_mtx;
+
+    mutable knowhere::concurrent_cache<uint64_t, uint32_t> lru_cache;
 
 #ifdef EXEC_ENV_OLS
     // Set to a larger value than the actual header to accommodate
@@ -5,6 +5,7 @@
 
 #include "utils.h"
 #include "concurrent_queue.h"
+#include "simd/hook.h"
 #define NUM_PQ_CENTROIDS 256
 
 namespace diskann {
@@ -16,35 +17,12 @@ namespace diskann {
     }
   }
 
+  // pq_dists holds the 256 distances of every chunk, summed with the gather
+  // kernel the cpu supports
   inline void pq_dist_lookup(const _u8* pq_ids, const _u64 n_pts,
                              const _u64 pq_nchunks, const float* pq_dists,
                              float* dists_out) {
-#if defined(__ARM_NEON) && defined(__aarch64__)
-    __builtin_prefetch((char*) dists_out, 1, 3);
-    __builtin_prefetch((char*) pq_ids, 0, 3);
-    __builtin_prefetch((char*) (pq_ids + 64), 0, 3);
-    __builtin_prefetch((char*) (pq_ids + 128), 0, 3);
-#else
-    _mm_prefetch((char*) dists_out, _MM_HINT_T0);
-    _mm_prefetch((char*) pq_ids, _MM_HINT_T0);
-    _mm_prefetch((char*) (pq_ids + 64), _MM_HINT_T0);
-    _mm_prefetch((char*) (pq_ids + 128), _MM_HINT_T0);
-#endif
-    memset(dists_out, 0, n_pts * sizeof(float));
-    for (_u64 chunk = 0; chunk < pq_nchunks; chunk++) {
-      const float* chunk_dists = pq_dists + 256 * chunk;
-      if (chunk < pq_nchunks - 1) {
-#if defined(__ARM_NEON) && defined(__aarch64__)
-        __builtin_prefetch((char*) (chunk_dists + 256), 0, 3);
-#else
-        _mm_prefetch((char*) (chunk_dists + 256), _MM_HINT_T0);
-#endif
-      }
-      for (_u64 idx = 0; idx < n_pts; idx++) {
-        _u8 pq_centerid = pq_ids[pq_nchunks * idx + chunk];
-        dists_out[idx] += chunk_dists[pq_centerid];
-      }
-    }
+    faiss::pq_adc_ny(dists_out, pq_ids, pq_dists, n_pts, pq_nchunks);
   }
 
   class FixedChunkPQTable {
@@ -170,6 +148,13 @@ namespace diskann {
   get_num_chunks() {
     return static_cast<_u32>(n_chunks);
   }
+
+  // the bytes of the tables, in both layouts, and of what indexes them
+  _u64 get_size() const {
+    return 2 * 256 * ndims * sizeof(float) + ndims * (sizeof(float) + sizeof(_u32)) +
+           (n_chunks + 1) * sizeof(_u32);
+  }
+
   void populate_chunk_distances(const float* query_vec, float* dist_vec) {
     memset(dist_vec, 0, 256 * n_chunks * sizeof(float));
     // chunk wise distance computation
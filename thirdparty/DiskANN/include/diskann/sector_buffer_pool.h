@@ -0,0 +1,102 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace diskann {
+
+  // Sector buffers the searches of all the indexes of the process borrow for
+  // the reads of one search and hand back when it is done, instead of every
+  // index keeping one per search thread for good. The pool grows to the
+  // buffers the concurrent searches need, up to its capacity past which
+  // searches wait for a buffer, and gives back the idle buffers above the
+  // peak of the last period. Buffers are kept per NUMA node, a search takes
+  // one of the node it runs on when there is one, and the pages of a new
+  // buffer are touched by the thread that borrows it first so that they are
+  // placed on its node.
+  class SectorBufferPool {
+   public:
+    struct Stats {
+      uint64_t bytes = 0;           // allocated
+      uint64_t borrowed_bytes = 0;  // in use by searches
+      uint64_t peak_borrowed_bytes = 0;
+      uint64_t n_borrows = 0;
+      uint64_t n_waits = 0;   // borrows that waited for the capacity
+      uint64_t n_remote = 0;  // borrows served by a buffer of another node
+    };
+
+    // a buffer borrowed for the lifetime of the object
+    class Buffer {
+     public:
+      Buffer() = default;
+      explicit Buffer(size_t len);
+      ~Buffer();
+      Buffer(Buffer &&other) noexcept;
+      Buffer &operator=(Buffer &&other) noexcept;
+      Buffer(const Buffer &) = delete;
+      Buffer &operator=(const Buffer &) = delete;
+
+      char *get() const {
+        return buf_;
+      }
+
+     private:
+      char  *buf_ = nullptr;
+      size_t len_ = 0;
+    };
+
+    static SectorBufferPool &instance();
+
+    // limit of the bytes allocated, 0 for none. A search always gets a
+    // buffer when no other one is borrowed.
+    void set_capacity(uint64_t bytes);
+
+    // a buffer of len bytes aligned to the sector size
+    char *borrow(size_t len);
+    void  release(char *buf, size_t len);
+
+    // frees the idle buffers above the peak borrowed since the last trim
+    void trim();
+
+    // all the buffers allocated, the readers register them, and the number
+    // of changes to them so far
+    std::vector<std::pair<void *, size_t>> buffers(uint64_t &generation);
+    uint64_t                               generation();
+
+    Stats stats();
+
+   private:
+    SectorBufferPool();
+
+    struct Entry {
+      size_t len;
+      int    node;
+    };
+
+    int   current_node() const;
+    char *allocate(size_t len);
+    void  free_buffer(char *buf, size_t len);
+    bool  evict_idle(size_t keep_len);
+    void  trim_locked();
+
+    int n_nodes_ = 1;
+
+    // idle buffers by length and node
+    std::map<size_t, std::vector<std::vector<char *>>> idle_;
+    std::unordered_map<char *, Entry>                  all_;
+    uint64_t                                           capacity_ = 0;
+    uint64_t                                           generation_ = 0;
+    uint64_t                                           n_releases_ = 0;
+    uint64_t peak_since_trim_ = 0;
+    Stats    stats_;
+
+    std::mutex              mtx_;
+    std::condition_variable cv_;
+  };
+
+}  // namespace diskann
@@ -0,0 +1,88 @@
+#pragma once
+#ifndef _WINDOWS
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "aligned_file_reader.h"
+#include "linux_aligned_file_reader.h"
+
+// a read spanning several stripes, done once all of its pieces are
+struct StripedRead;
+
+// reads a disk index striped across several files, one per device, so that
+// the searches of one index use the IOPS of all of them: the file is cut in
+// stripes of stripe_len bytes and stripe i is the (i / n)-th of the file of
+// device i % n, see diskann::stripe_disk_index. The reads of a beam go to
+// the devices of their sectors at once; an aio context is not bound to a
+// file, so the reads of all the devices share the context of the search and
+// complete together.
+class StripedAlignedFileReader : public AlignedFileReader {
+ private:
+  std::vector<std::string>                             stripe_files_;
+  uint64_t                                             stripe_len_;
+  std::vector<std::shared_ptr<LinuxAlignedFileReader>> readers_;
+
+  // the async reads of a context that span stripes: the pieces in flight by
+  // their buffers, and the events they take besides one per read
+  struct ContextSplits {
+    tsl::robin_map<void *, std::shared_ptr<StripedRead>> pieces;
+    size_t                                               extra_events = 0;
+  };
+  tsl::robin_map<io_context_t, ContextSplits> splits_;
+  std::mutex                                  split_mtx_;
+
+  // the descriptors the writes to the file go to the stripes by, opened by
+  // the first one
+  std::vector<int> write_fds_;
+  std::mutex       write_mtx_;
+
+  // the reads of the devices the requests cut into, by device; the splits
+  // are tracked in the ones of ctx unless null
+  void split(const std::vector<AlignedRead>        &read_reqs,
+             std::vector<std::vector<AlignedRead>> &pieces,
+             const io_context_t                    *ctx);
+
+ public:
+  StripedAlignedFileReader(std::vector<std::string> stripe_files,
+                           uint64_t                 stripe_len);
+  ~StripedAlignedFileReader() = default;
+
+  io_context_t get_ctx() {
+    return readers_[0]->get_ctx();
+  }
+  void put_ctx(io_context_t ctx) {
+    readers_[0]->put_ctx(ctx);
+  }
+
+  // Open & close ops, of the stripes of the file
+  // Blocking calls
+  void open(const std::string &fname);
+  void close();
+
+  // process batch of aligned requests in parallel across the devices
+  // NOTE :: blocking call
+  void read(std::vector<AlignedRead> &read_reqs, IOContext &ctx,
+            bool async = false);
+
+  // async reads
+  void get_submitted_req(io_context_t &ctx, size_t n_ops) override;
+  void submit_req(io_context_t &ctx, std::vector<AlignedRead> &read_reqs);
+  void get_completed_req(io_context_t &ctx, size_t min_n, size_t max_n,
+                         std::vector<void *> &done) override;
+
+  // a read spanning stripes takes an event of the context per piece
+  size_t max_events_per_ctx() override {
+    return readers_[0]->max_events_per_ctx() / 2;
+  }
+
+  void write_through(uint64_t offset, const void *buf, uint64_t len) override;
+
+  size_t n_devices() const {
+    return stripe_files_.size();
+  }
+};
+
+#endif
@@ -999,6 +999,31 @@ namespace diskann {
       const std::string& disk_index_filename) {
     return disk_index_filename + "_cached_nodes.bin";
   }
+
+  inline std::string get_disk_index_layout_file(
+      const std::string &disk_index_filename) {
+    return disk_index_filename + "_layout.bin";
+  }
+
+  inline std::string get_disk_index_sq_table_file(
+      const std::string &disk_index_filename) {
+    return disk_index_filename + "_sq_table.bin";
+  }
+
+  inline std::string get_disk_index_nav_graph_file(
+      const std::string &disk_index_filename) {
+    return disk_index_filename + "_nav_graph.bin";
+  }
+
+  inline std::string get_disk_index_labels_file(
+      const std::string &disk_index_filename) {
+    return disk_index_filename + "_labels.bin";
+  }
+
+  inline std::string get_disk_index_label_medoids_file(
+      const std::string &disk_index_filename) {
+    return disk_index_filename + "_label_medoids.bin";
+  }
 };  // namespace diskann
 
 struct PivotContainer {
@@ -4,10 +4,16 @@
 #include <algorithm>
 #include <atomic>
 #include <cassert>
+#include <condition_variable>
+#include <exception>
 #include <fstream>
 #include <iostream>
+#include <map>
+#include <mutex>
+#include <queue>
 #include <set>
 #include <string>
+#include <thread>
 #include <vector>
 
 #if defined(RELEASE_UNUSED_TCMALLOC_MEMORY_AT_CHECKPOINTS) && \
@@ -19,6 +25,7 @@
 #include "boost/dynamic_bitset.hpp"
 #include "diskann/aux_utils.h"
 #include "diskann/cached_io.h"
+#include "diskann/graph_codec.h"
 #include "diskann/index.h"
 #include "omp.h"
 #include "diskann/partition_and_pq.h"
@@ -343,34 +350,15 @@ namespace diskann {
 
     // find max node id
     _u64 nnodes = 0;
-    _u64 nelems = 0;
     for (auto &idmap : idmaps) {
       for (auto &id : idmap) {
         nnodes = std::max(nnodes, (_u64) id);
       }
-      nelems += idmap.size();
     }
     nnodes++;
     LOG_KNOWHERE_DEBUG_ << "# nodes: " << nnodes
                         << ", max. degree: " << max_degree;
 
-    // compute inverse map: node -> shards
-    std::vector<std::pair<unsigned, unsigned>> node_shard;
-    node_shard.reserve(nelems);
-    for (_u64 shard = 0; shard < nshards; shard++) {
-      LOG_KNOWHERE_INFO_ << "Creating inverse map -- shard #" << shard;
-      for (_u64 idx = 0; idx < idmaps[shard].size(); idx++) {
-        _u64 node_id = idmaps[shard][idx];
-        node_shard.push_back(std::make_pair((_u32) node_id, (_u32) shard));
-      }
-    }
-    std::sort(node_shard.begin(), node_shard.end(),
-              [](const auto &left, const auto &right) {
-                return left.first < right.first || (left.first == right.first &&
-                                                    left.second < right.second);
-              });
-    LOG_KNOWHERE_INFO_ << "Finished computing node -> shards map";
-
     // create cached vamana readers
     std::vector<cached_ifstream> vamana_readers(nshards);
     for (_u64 i = 0; i < nshards; i++) {
@@ -439,64 +427,102 @@ namespace diskann {
 
     LOG_KNOWHERE_INFO_ << "Starting merge";
 
+    // The nodes are merged in blocks of consecutive ids. The shards store
+    // their nodes in the ascending order of their id maps, so every shard
+    // reader moves forward through the block on its own and they are read in
+    // parallel; the neighborhoods of the block are then merged in parallel
+    // and written in order.
+    constexpr _u64 kMergeBlockSize = 1 << 18;
+    std::vector<size_t>                shard_pos(nshards, 0);
+    std::vector<std::vector<unsigned>> shard_block_nodes(nshards);
+    std::vector<std::vector<size_t>>   shard_block_offsets(nshards);
+    std::vector<std::vector<unsigned>> shard_block_nbrs(nshards);
+    std::vector<std::vector<unsigned>> block_nhoods(
+        (std::min)(nnodes, kMergeBlockSize));
+
     // Gopal. random_shuffle() is deprecated.
-    std::random_device rng;
-    std::mt19937       urng(rng());
-
-    std::vector<bool>     nhood_set(nnodes, 0);
-    std::vector<unsigned> final_nhood;
-
-    unsigned nnbrs = 0, shard_nnbrs = 0;
-    unsigned cur_id = 0;
-    for (const auto &id_shard : node_shard) {
-      unsigned node_id = id_shard.first;
-      unsigned shard_id = id_shard.second;
-      if (cur_id < node_id) {
-        // Gopal. random_shuffle() is deprecated.
-        std::shuffle(final_nhood.begin(), final_nhood.end(), urng);
-        nnbrs =
-            (unsigned) (std::min)(final_nhood.size(), (uint64_t) max_degree);
+    std::random_device       rng;
+    std::vector<std::mt19937> urngs;
+    for (int i = 0; i < omp_get_max_threads(); i++) {
+      urngs.emplace_back(rng());
+    }
+
+    std::exception_ptr read_error;
+    for (_u64 block_start = 0; block_start < nnodes;
+         block_start += kMergeBlockSize) {
+      const _u64 block_end = (std::min)(nnodes, block_start + kMergeBlockSize);
+
+#pragma omp parallel for schedule(dynamic, 1)
+      for (int64_t shard = 0; shard < (int64_t) nshards; shard++) {
+        auto &nodes = shard_block_nodes[shard];
+        auto &offsets = shard_block_offsets[shard];
+        auto &nbrs = shard_block_nbrs[shard];
+        nodes.clear();
+        offsets.assign(1, 0);
+        nbrs.clear();
+        const auto &idmap = idmaps[shard];
+        try {
+          while (shard_pos[shard] < idmap.size() &&
+                 idmap[shard_pos[shard]] < block_end) {
+            unsigned shard_nnbrs;
+            vamana_readers[shard].read((char *) &shard_nnbrs,
+                                       sizeof(unsigned));
+            const size_t begin = nbrs.size();
+            nbrs.resize(begin + shard_nnbrs);
+            vamana_readers[shard].read((char *) (nbrs.data() + begin),
+                                       shard_nnbrs * sizeof(unsigned));
+            // rename nodes
+            for (size_t j = begin; j < nbrs.size(); j++) {
+              nbrs[j] = idmap[nbrs[j]];
+            }
+            nodes.push_back(idmap[shard_pos[shard]++]);
+            offsets.push_back(nbrs.size());
+          }
+        } catch (...) {
+#pragma omp critical
+          if (read_error == nullptr) {
+            read_error = std::current_exception();
+          }
+        }
+      }
+      if (read_error != nullptr) {
+        std::rethrow_exception(read_error);
+      }
+
+      for (_u64 shard = 0; shard < nshards; shard++) {
+        const auto &nodes = shard_block_nodes[shard];
+        const auto &offsets = shard_block_offsets[shard];
+        const auto &nbrs = shard_block_nbrs[shard];
+        for (size_t i = 0; i < nodes.size(); i++) {
+          auto &nhood = block_nhoods[nodes[i] - block_start];
+          nhood.insert(nhood.end(), nbrs.begin() + offsets[i],
+                       nbrs.begin() + offsets[i + 1]);
+        }
+      }
+
+#pragma omp parallel for schedule(dynamic, 1024)
+      for (int64_t i = 0; i < (int64_t) (block_end - block_start); i++) {
+        auto &nhood = block_nhoods[i];
+        std::sort(nhood.begin(), nhood.end());
+        nhood.erase(std::unique(nhood.begin(), nhood.end()), nhood.end());
+        std::shuffle(nhood.begin(), nhood.end(), urngs[omp_get_thread_num()]);
+        nhood.resize((std::min)(nhood.size(), (size_t) max_degree));
+      }
+
+      for (_u64 i = 0; i < block_end - block_start; i++) {
+        auto    &nhood = block_nhoods[i];
+        unsigned nnbrs = (unsigned) nhood.size();
         // write into merged ofstream
         merged_vamana_writer.write((char *) &nnbrs, sizeof(unsigned));
-        merged_vamana_writer.write((char *) final_nhood.data(),
+        merged_vamana_writer.write((char *) nhood.data(),
                                    nnbrs * sizeof(unsigned));
         merged_index_size += (sizeof(unsigned) + nnbrs * sizeof(unsigned));
-        if (cur_id % 499999 == 1) {
-          LOG_KNOWHERE_DEBUG_ << ".";
-        }
-        cur_id = node_id;
-        nnbrs = 0;
-        for (auto &p : final_nhood)
-          nhood_set[p] = 0;
-        final_nhood.clear();
-      }
-      // read from shard_id ifstream
-      vamana_readers[shard_id].read((char *) &shard_nnbrs, sizeof(unsigned));
-      std::vector<unsigned> shard_nhood(shard_nnbrs);
-      vamana_readers[shard_id].read((char *) shard_nhood.data(),
-                                    shard_nnbrs * sizeof(unsigned));
-
-      // rename nodes
-      for (_u64 j = 0; j < shard_nnbrs; j++) {
-        if (nhood_set[idmaps[shard_id][shard_nhood[j]]] == 0) {
-          nhood_set[idmaps[shard_id][shard_nhood[j]]] = 1;
-          final_nhood.emplace_back(idmaps[shard_id][shard_nhood[j]]);
-        }
+        nhood.clear();
       }
+      LOG_KNOWHERE_DEBUG_ << "Merged " << block_end << " of " << nnodes
+                          << " nodes";
     }
 
-    // Gopal. random_shuffle() is deprecated.
-    std::shuffle(final_nhood.begin(), final_nhood.end(), urng);
-    nnbrs = (unsigned) (std::min)(final_nhood.size(), (uint64_t) max_degree);
-    // write into merged ofstream
-    merged_vamana_writer.write((char *) &nnbrs, sizeof(unsigned));
-    merged_vamana_writer.write((char *) final_nhood.data(),
-                               nnbrs * sizeof(unsigned));
-    merged_index_size += (sizeof(unsigned) + nnbrs * sizeof(unsigned));
-    for (auto &p : final_nhood)
-      nhood_set[p] = 0;
-    final_nhood.clear();
-
     LOG_KNOWHERE_DEBUG_ << "Expected size: " << merged_index_size;
 
     merged_vamana_writer.reset();
@@ -511,7 +537,8 @@ namespace diskann {
       std::string base_file, bool ip_prepared, diskann::Metric compareMetric,
       unsigned L, unsigned R, bool accelerate_build, double sampling_rate,
       double ram_budget, std::string mem_index_path, std::string medoids_file,
-      std::string centroids_file) {
+      std::string centroids_file, unsigned concurrent_shards,
+      const KnnGraphBuilder &knn_graph_builder) {
     size_t base_num, base_dim;
     diskann::get_bin_metadata(base_file, base_num, base_dim);
 
@@ -531,6 +558,7 @@ namespace diskann {
       paras.Set<bool>("saturate_graph", 1);
       paras.Set<std::string>("save_path", mem_index_path);
       paras.Set<bool>("accelerate_build", accelerate_build);
+      paras.Set<KnnGraphBuilder>("knn_graph_builder", knn_graph_builder);
 
       std::unique_ptr<diskann::Index<T>> _pvamanaIndex =
           std::unique_ptr<diskann::Index<T>>(new diskann::Index<T>(
@@ -543,14 +571,16 @@ namespace diskann {
       return _pvamanaIndex;
     }
     std::string merged_index_prefix = mem_index_path + "_tempFiles";
-    int         num_parts =
-        partition_with_ram_budget<T>(base_file, sampling_rate, ram_budget,
-                                     2 * R / 3, merged_index_prefix, 2);
+    // shards sized for concurrent_shards of them to be built at once
+    concurrent_shards = std::max(concurrent_shards, 1u);
+    int num_parts = partition_with_ram_budget<T>(
+        base_file, sampling_rate, ram_budget / concurrent_shards, 2 * R / 3,
+        merged_index_prefix, 2);
 
     std::string cur_centroid_filepath = merged_index_prefix + "_centroids.bin";
     std::rename(cur_centroid_filepath.c_str(), centroids_file.c_str());
 
-    for (int p = 0; p < num_parts; p++) {
+    auto build_shard = [&](int p) {
       std::string shard_base_file =
           merged_index_prefix + "_subshard-" + std::to_string(p) + ".bin";
 
@@ -572,6 +602,7 @@ namespace diskann {
       paras.Set<bool>("saturate_graph", 0);
       paras.Set<std::string>("save_path", shard_index_file);
       paras.Set<bool>("accelerate_build", accelerate_build);
+      paras.Set<KnnGraphBuilder>("knn_graph_builder", knn_graph_builder);
 
       _u64 shard_base_dim, shard_base_pts;
       get_bin_metadata(shard_base_file, shard_base_pts, shard_base_dim);
@@ -582,6 +613,66 @@ namespace diskann {
       _pvamanaIndex->build(shard_base_file.c_str(), shard_base_pts, paras);
       _pvamanaIndex->save(shard_index_file.c_str());
       std::remove(shard_base_file.c_str());
+    };
+
+    // Start the shards in order, as many at a time as their estimated memory
+    // fits in the budget. Each shard is driven by its own thread, since the
+    // Index build waits on the tasks it pushes to the global build pool; the
+    // shards share that pool, so that one shard's single-threaded phases
+    // (reading its data, finding the medoid, saving) leave the pool to the
+    // others.
+    std::vector<double> shard_ram(num_parts);
+    for (int p = 0; p < num_parts; p++) {
+      size_t shard_pts, shard_dim;
+      get_bin_metadata(merged_index_prefix + "_subshard-" + std::to_string(p) +
+                           "_ids_uint32.bin",
+                       shard_pts, shard_dim);
+      shard_ram[p] =
+          estimate_ram_usage(shard_pts, base_dim, sizeof(T), 2 * R / 3);
+    }
+    const double            ram_budget_bytes = ram_budget * 1024 * 1024 * 1024;
+    std::mutex              shard_mtx;
+    std::condition_variable shard_cv;
+    double                  ram_in_use = 0;
+    int                     n_running = 0;
+    std::exception_ptr      shard_error;
+    std::vector<std::thread> shard_threads;
+    for (int p = 0; p < num_parts; p++) {
+      int n_others;
+      {
+        std::unique_lock<std::mutex> lk(shard_mtx);
+        shard_cv.wait(lk, [&] {
+          return shard_error != nullptr || n_running == 0 ||
+                 ram_in_use + shard_ram[p] <= ram_budget_bytes;
+        });
+        if (shard_error != nullptr) {
+          break;
+        }
+        n_others = n_running++;
+        ram_in_use += shard_ram[p];
+      }
+      LOG_KNOWHERE_INFO_ << "Building shard #" << p << " of " << num_parts
+                         << " next to " << n_others << " others";
+      shard_threads.emplace_back([&, p] {
+        try {
+          build_shard(p);
+        } catch (...) {
+          std::lock_guard<std::mutex> lk(shard_mtx);
+          if (shard_error == nullptr) {
+            shard_error = std::current_exception();
+          }
+        }
+        std::lock_guard<std::mutex> lk(shard_mtx);
+        n_running--;
+        ram_in_use -= shard_ram[p];
+        shard_cv.notify_all();
+      });
+    }
+    for (auto &thread : shard_threads) {
+      thread.join();
+    }
+    if (shard_error != nullptr) {
+      std::rethrow_exception(shard_error);
     }
 
     diskann::merge_shards(merged_index_prefix + "_subshard-", "_mem.index",
@@ -869,7 +960,8 @@ namespace diskann {
   void create_disk_layout(const std::string base_file,
                           const std::string mem_index_file,
                           const std::string output_file,
-                          const std::string reorder_data_file) {
+                          const std::string reorder_data_file,
+                          bool              compress_graph) {
     unsigned npts, ndims;
 
     // amount to read or write in one shot
@@ -948,8 +1040,55 @@ namespace diskann {
     medoid = (_u64) medoid_u32;
     if (vamana_frozen_num == 1)
       vamana_frozen_loc = medoid;
-    max_node_len =
-        (((_u64) width_u32 + 1) * sizeof(unsigned)) + (ndims_64 * sizeof(T));
+    _u64 nhood_len = ((_u64) width_u32 + 1) * sizeof(unsigned);
+
+    // a compressed graph sizes the slots for its longest encoded list, the
+    // lists are sorted, so a first pass over the graph finds it
+    std::vector<unsigned> nbrs(width_u32);
+    if (compress_graph) {
+      auto graph_start = vamana_reader.tellg();
+      _u64 max_encoded_len = 0;
+      for (_u64 node_id = 0; node_id < npts_64; ++node_id) {
+        unsigned nnbrs;
+        vamana_reader.read((char *) &nnbrs, sizeof(unsigned));
+        vamana_reader.read((char *) nbrs.data(), nnbrs * sizeof(unsigned));
+        max_encoded_len = std::max<_u64>(
+            max_encoded_len, delta_graph::encoded_len(nbrs.data(), nnbrs));
+      }
+      vamana_reader.seekg(graph_start);
+      max_encoded_len = ROUND_UP(max_encoded_len, sizeof(unsigned));
+      if (max_encoded_len < nhood_len) {
+        LOG_KNOWHERE_INFO_ << "Adjacency lists delta-encoded into "
+                           << max_encoded_len << "B instead of " << nhood_len
+                           << "B";
+        nhood_len = max_encoded_len;
+      } else {
+        LOG_KNOWHERE_INFO_ << "Adjacency lists do not shrink encoded, keep "
+                              "them as they are.";
+        compress_graph = false;
+      }
+    }
+    max_node_len = nhood_len + (ndims_64 * sizeof(T));
+
+    // reads the adjacency list of the next node of the graph into the nnbrs
+    // and nbrs of its slot at nhood_buf, encoded for a compressed graph
+    auto read_nhood = [&](char *nhood_buf) {
+      unsigned nnbrs;
+      vamana_reader.read((char *) &nnbrs, sizeof(unsigned));
+
+      // sanity checks on nnbrs
+      assert(nnbrs > 0);
+      assert(nnbrs <= width_u32);
+
+      if (compress_graph) {
+        vamana_reader.read((char *) nbrs.data(), nnbrs * sizeof(unsigned));
+        delta_graph::encode(nbrs.data(), nnbrs, (uint8_t *) nhood_buf);
+      } else {
+        *(unsigned *) nhood_buf = nnbrs;
+        vamana_reader.read(nhood_buf + sizeof(unsigned),
+                           nnbrs * sizeof(unsigned));
+      }
+    };
 
     bool long_node = max_node_len > SECTOR_LEN;
     if (long_node) {
@@ -1008,25 +1147,19 @@ namespace diskann {
       *(_u64 *) (sector_buf.get() + 10 * sizeof(_u64)) =
           n_data_nodes_per_sector;
     }
+    // the degree is not implied by max_node_len when the lists are encoded
+    *(_u64 *) (sector_buf.get() + 11 * sizeof(_u64)) =
+        (_u64) (compress_graph ? GraphCodec::DELTA : GraphCodec::NONE);
+    *(_u64 *) (sector_buf.get() + 12 * sizeof(_u64)) = width_u32;
 
     diskann_writer.write(sector_buf.get(), SECTOR_LEN);
 
     if (long_node) {
       for (_u64 node_id = 0; node_id < npts_64; ++node_id) {
         memset(sector_buf.get(), 0, sector_buf_size);
-        char *nnbrs = sector_buf.get() + ndims_64 * sizeof(T);
-        char *nhood_buf =
-            sector_buf.get() + (ndims_64 * sizeof(T)) + sizeof(unsigned);
-
-        // read cur node's nnbrs
-        vamana_reader.read(nnbrs, sizeof(unsigned));
-
-        // sanity checks on nnbrs
-        assert(static_cast<uint32_t>(*nnbrs) > 0);
-        assert(static_cast<uint32_t>(*nnbrs) <= width_u32);
 
         // read node's nhood
-        vamana_reader.read(nhood_buf, *((unsigned *) nnbrs) * sizeof(unsigned));
+        read_nhood(sector_buf.get() + ndims_64 * sizeof(T));
 
         // write coords of node first
         base_reader.read((char *) sector_buf.get(), sizeof(T) * ndims_64);
@@ -1049,19 +1182,9 @@ namespace diskann {
            sector_node_id++) {
         char *sector_node_buf =
             sector_buf.get() + (sector_node_id * max_node_len);
-        char *nnbrs = sector_node_buf + ndims_64 * sizeof(T);
-        char *nhood_buf =
-            sector_node_buf + (ndims_64 * sizeof(T)) + sizeof(unsigned);
-
-        // read cur node's nnbrs
-        vamana_reader.read(nnbrs, sizeof(unsigned));
-
-        // sanity checks on nnbrs
-        assert(static_cast<uint32_t>(*nnbrs) > 0);
-        assert(static_cast<uint32_t>(*nnbrs) <= width_u32);
 
         // read node's nhood
-        vamana_reader.read(nhood_buf, *((unsigned *) nnbrs) * sizeof(unsigned));
+        read_nhood(sector_node_buf + ndims_64 * sizeof(T));
 
         // write coords of node first
         base_reader.read(sector_node_buf, sizeof(T) * ndims_64);
@@ -1103,6 +1226,436 @@ namespace diskann {
     LOG_KNOWHERE_DEBUG_ << "Output file written.";
   }
 
+  void relayout_disk_index(const std::string &mem_index_file,
+                           const std::string &disk_index_file,
+                           const std::string &layout_file) {
+    _u64 file_size, npts, max_node_len, nnodes_per_sector;
+    {
+      std::ifstream meta_reader(disk_index_file, std::ios::binary);
+      meta_reader.read((char *) &file_size, sizeof(_u64));
+      meta_reader.read((char *) &npts, sizeof(_u64));
+      meta_reader.seekg(3 * sizeof(_u64), std::ios::beg);
+      meta_reader.read((char *) &max_node_len, sizeof(_u64));
+      meta_reader.read((char *) &nnodes_per_sector, sizeof(_u64));
+    }
+    if (max_node_len > SECTOR_LEN || nnodes_per_sector <= 1) {
+      LOG_KNOWHERE_INFO_ << "Nodes of " << max_node_len
+                         << "B do not share sectors, keep the id order.";
+      return;
+    }
+
+    // the graph, nnbrs followed by nbrs for every node
+    size_t                             graph_file_size;
+    unsigned                           width_u32, medoid_u32;
+    _u64                               frozen_num;
+    std::vector<std::vector<unsigned>> graph(npts);
+    {
+      cached_ifstream vamana_reader(mem_index_file, 64 * 1024 * 1024);
+      vamana_reader.read((char *) &graph_file_size, sizeof(uint64_t));
+      vamana_reader.read((char *) &width_u32, sizeof(unsigned));
+      vamana_reader.read((char *) &medoid_u32, sizeof(unsigned));
+      vamana_reader.read((char *) &frozen_num, sizeof(_u64));
+      for (_u64 i = 0; i < npts; i++) {
+        unsigned nnbrs;
+        vamana_reader.read((char *) &nnbrs, sizeof(unsigned));
+        graph[i].resize(nnbrs);
+        vamana_reader.read((char *) graph[i].data(),
+                           nnbrs * sizeof(unsigned));
+      }
+    }
+
+    // fill the sectors in bfs order from the medoid, each with the first
+    // node left and then the neighbors of the nodes already in it
+    std::vector<uint32_t> loc2id;
+    loc2id.reserve(npts);
+    boost::dynamic_bitset<> placed(npts);
+    std::queue<unsigned>    seeds;
+    seeds.push(medoid_u32);
+    _u64 next_unplaced = 0;
+    auto next_seed = [&]() -> unsigned {
+      while (!seeds.empty()) {
+        auto id = seeds.front();
+        seeds.pop();
+        if (!placed[id]) {
+          return id;
+        }
+      }
+      while (placed[next_unplaced]) {
+        next_unplaced++;
+      }
+      return (unsigned) next_unplaced;
+    };
+    auto place = [&](unsigned id) {
+      placed[id] = true;
+      loc2id.push_back(id);
+    };
+    while (loc2id.size() < npts) {
+      const _u64 begin = loc2id.size();
+      const _u64 end = std::min<_u64>(npts, begin + nnodes_per_sector);
+      place(next_seed());
+      for (_u64 i = begin; loc2id.size() < end; i++) {
+        if (i == loc2id.size()) {
+          // the neighborhoods of the sector are all placed
+          place(next_seed());
+          continue;
+        }
+        for (auto nbr : graph[loc2id[i]]) {
+          if (!placed[nbr]) {
+            place(nbr);
+            if (loc2id.size() == end) {
+              break;
+            }
+          }
+        }
+      }
+      for (_u64 i = begin; i < end; i++) {
+        for (auto nbr : graph[loc2id[i]]) {
+          if (!placed[nbr]) {
+            seeds.push(nbr);
+          }
+        }
+      }
+    }
+    std::vector<std::vector<unsigned>>().swap(graph);
+
+    // rewrite the node sectors in the new order, the metadata and the reorder
+    // data that follow them are kept as is
+    const _u64 n_sectors =
+        ROUND_UP(npts, nnodes_per_sector) / nnodes_per_sector;
+    const std::string tmp_file = disk_index_file + "_relayout";
+    {
+      std::ifstream           disk_reader(disk_index_file, std::ios::binary);
+      cached_ofstream         disk_writer(tmp_file, 64 * 1024 * 1024);
+      std::unique_ptr<char[]> sector_buf = std::make_unique<char[]>(SECTOR_LEN);
+      disk_reader.read(sector_buf.get(), SECTOR_LEN);
+      disk_writer.write(sector_buf.get(), SECTOR_LEN);
+      for (_u64 sector = 0; sector < n_sectors; sector++) {
+        memset(sector_buf.get(), 0, SECTOR_LEN);
+        for (_u64 j = 0; j < nnodes_per_sector &&
+                         sector * nnodes_per_sector + j < npts;
+             j++) {
+          _u64 id = loc2id[sector * nnodes_per_sector + j];
+          disk_reader.seekg((id / nnodes_per_sector + 1) * SECTOR_LEN +
+                                (id % nnodes_per_sector) * max_node_len,
+                            std::ios::beg);
+          disk_reader.read(sector_buf.get() + j * max_node_len, max_node_len);
+        }
+        disk_writer.write(sector_buf.get(), SECTOR_LEN);
+      }
+      disk_reader.seekg((n_sectors + 1) * SECTOR_LEN, std::ios::beg);
+      for (_u64 off = (n_sectors + 1) * SECTOR_LEN; off < file_size;
+           off += SECTOR_LEN) {
+        disk_reader.read(sector_buf.get(), SECTOR_LEN);
+        disk_writer.write(sector_buf.get(), SECTOR_LEN);
+      }
+    }
+    if (std::rename(tmp_file.c_str(), disk_index_file.c_str()) != 0) {
+      std::remove(tmp_file.c_str());
+      throw ANNException("Failed to replace " + disk_index_file +
+                             " with its relayout",
+                         -1, __FUNCSIG__, __FILE__, __LINE__);
+    }
+
+    std::vector<uint32_t> id2loc(npts);
+    for (_u64 loc = 0; loc < npts; loc++) {
+      id2loc[loc2id[loc]] = (uint32_t) loc;
+    }
+    save_bin<uint32_t>(layout_file, id2loc.data(), npts, 1);
+    LOG_KNOWHERE_INFO_ << "Disk index relaid out in " << n_sectors
+                       << " sectors by graph neighborhood.";
+  }
+
+  // Trains a disk sq table of type on the float vectors of data_file, saves it
+  // to sq_table_file and the codes of the vectors to codes_file, a bin file of
+  // npts x code_size bytes.
+  void generate_disk_sq_data(const std::string &data_file, DiskSQType type,
+                             const std::string &sq_table_file,
+                             const std::string &codes_file) {
+    size_t npts, dim;
+    get_bin_metadata(data_file, npts, dim);
+    const size_t block_size = 65536;
+
+    DiskSQTable table;
+    table.init(type, dim);
+    std::ifstream reader(data_file, std::ios::binary);
+    reader.exceptions(std::ios::failbit | std::ios::badbit);
+    std::vector<float> block(block_size * dim);
+    if (type == DiskSQType::SQ8) {
+      reader.seekg(2 * sizeof(_u32), std::ios::beg);
+      for (size_t start = 0; start < npts; start += block_size) {
+        size_t n = std::min(block_size, npts - start);
+        reader.read((char *) block.data(), n * dim * sizeof(float));
+        table.update(block.data(), n);
+      }
+    }
+    table.finish();
+    table.save(sq_table_file);
+
+    std::ofstream writer(codes_file, std::ios::binary);
+    writer.exceptions(std::ios::failbit | std::ios::badbit);
+    _u32 npts_u32 = (_u32) npts, code_size_u32 = (_u32) table.code_size();
+    writer.write((char *) &npts_u32, sizeof(_u32));
+    writer.write((char *) &code_size_u32, sizeof(_u32));
+    std::vector<_u8> codes(block_size * table.code_size());
+    reader.seekg(2 * sizeof(_u32), std::ios::beg);
+    for (size_t start = 0; start < npts; start += block_size) {
+      size_t n = std::min(block_size, npts - start);
+      reader.read((char *) block.data(), n * dim * sizeof(float));
+#pragma omp parallel for schedule(static, 1024)
+      for (int64_t i = 0; i < (int64_t) n; i++) {
+        table.encode(block.data() + i * dim,
+                     codes.data() + i * table.code_size());
+      }
+      writer.write((char *) codes.data(), n * table.code_size());
+    }
+    LOG_KNOWHERE_INFO_ << "Compressed base for disk-SQ into "
+                       << table.code_size() << " bytes per vector.";
+  }
+
+  std::vector<std::string> stripe_disk_index(
+      const std::string &disk_index_file, const std::vector<std::string> &dirs,
+      _u64 stripe_len) {
+    auto name = disk_index_file.substr(disk_index_file.find_last_of('/') + 1);
+    std::vector<std::string>   stripe_files;
+    std::vector<std::ofstream> writers;
+    for (size_t i = 0; i < dirs.size(); i++) {
+      stripe_files.push_back(dirs[i] + "/" + name + "_stripe" +
+                             std::to_string(i));
+      writers.emplace_back(stripe_files.back(),
+                           std::ios::binary | std::ios::trunc);
+      if (!writers.back()) {
+        throw ANNException("Failed to create " + stripe_files.back(), -1,
+                           __FUNCSIG__, __FILE__, __LINE__);
+      }
+    }
+
+    // the last stripe is padded, the direct reads are of whole blocks
+    std::ifstream     reader(disk_index_file, std::ios::binary);
+    std::vector<char> stripe(stripe_len);
+    _u64              file_size = get_file_size(disk_index_file);
+    _u64              n_stripes = ROUND_UP(file_size, stripe_len) / stripe_len;
+    for (_u64 i = 0; i < n_stripes; i++) {
+      std::fill(stripe.begin(), stripe.end(), 0);
+      reader.read(stripe.data(),
+                  std::min(stripe_len, file_size - i * stripe_len));
+      writers[i % writers.size()].write(stripe.data(), stripe_len);
+    }
+    for (size_t i = 0; i < writers.size(); i++) {
+      writers[i].close();
+      if (writers[i].fail()) {
+        throw ANNException("Failed to write " + stripe_files[i], -1,
+                           __FUNCSIG__, __FILE__, __LINE__);
+      }
+    }
+    LOG_KNOWHERE_INFO_ << "Striped " << disk_index_file << " across "
+                       << dirs.size() << " files, " << n_stripes
+                       << " stripes of " << stripe_len << " bytes.";
+    return stripe_files;
+  }
+
+  // Samples ratio of the float vectors of data_file, builds an in-memory
+  // vamana graph of degree at most R over them and saves it to nav_file:
+  // npts, dim, degree and entry point, the ids of the points sampled, their
+  // vectors, and for each of them its number of neighbors followed by degree
+  // neighbors, padded. No file is saved if less than two points are sampled.
+  void build_nav_graph(const std::string &data_file, float ratio, unsigned R,
+                       unsigned L, const std::string &nav_file) {
+    size_t npts, dim;
+    get_bin_metadata(data_file, npts, dim);
+    const size_t block_size = 65536;
+
+    std::mt19937                          generator(std::random_device{}());
+    std::uniform_real_distribution<float> distribution(0, 1);
+    std::vector<_u32>                     ids;
+    std::vector<float>                    sample;
+    std::ifstream                         reader(data_file, std::ios::binary);
+    reader.exceptions(std::ios::failbit | std::ios::badbit);
+    reader.seekg(2 * sizeof(_u32), std::ios::beg);
+    std::vector<float> block(block_size * dim);
+    for (size_t start = 0; start < npts; start += block_size) {
+      size_t n = std::min(block_size, npts - start);
+      reader.read((char *) block.data(), n * dim * sizeof(float));
+      for (size_t i = 0; i < n; i++) {
+        if (distribution(generator) < ratio) {
+          ids.push_back((_u32) (start + i));
+          sample.insert(sample.end(), block.data() + i * dim,
+                        block.data() + (i + 1) * dim);
+        }
+      }
+    }
+    if (ids.size() < 2) {
+      LOG_KNOWHERE_WARNING_ << "No navigation graph for " << ids.size()
+                            << " point(s) sampled.";
+      return;
+    }
+
+    std::string sample_file = nav_file + "_data.bin";
+    save_bin<float>(sample_file, sample.data(), ids.size(), dim);
+    diskann::Parameters paras;
+    paras.Set<unsigned>("L", L);
+    paras.Set<unsigned>("R", R);
+    paras.Set<unsigned>("C", 750);
+    paras.Set<float>("alpha", 1.2f);
+    paras.Set<unsigned>("num_rnds", 2);
+    paras.Set<bool>("saturate_graph", 0);
+    paras.Set<bool>("accelerate_build", false);
+    diskann::Index<float> nav_index(diskann::Metric::L2, false, dim,
+                                    ids.size(), false, false);
+    nav_index.build(sample_file.c_str(), ids.size(), paras);
+    std::remove(sample_file.c_str());
+
+    auto &graph = *nav_index.get_graph();
+    _u32  header[4] = {(_u32) ids.size(), (_u32) dim, R,
+                       nav_index.get_entry_point()};
+    std::ofstream writer(nav_file, std::ios::binary);
+    writer.exceptions(std::ios::failbit | std::ios::badbit);
+    writer.write((char *) header, sizeof(header));
+    writer.write((char *) ids.data(), ids.size() * sizeof(_u32));
+    writer.write((char *) sample.data(), sample.size() * sizeof(float));
+    std::vector<_u32> nbrs(R + 1);
+    for (size_t i = 0; i < ids.size(); i++) {
+      std::fill(nbrs.begin(), nbrs.end(), 0);
+      nbrs[0] = (_u32) std::min<size_t>(graph[i].size(), R);
+      std::copy(graph[i].begin(), graph[i].begin() + nbrs[0],
+                nbrs.begin() + 1);
+      writer.write((char *) nbrs.data(), nbrs.size() * sizeof(_u32));
+    }
+    LOG_KNOWHERE_INFO_ << "Navigation graph built over " << ids.size()
+                       << " sampled points.";
+  }
+
+  // Builds a vamana graph of degree R / 2 over the points of every label of
+  // label_file, a bin file of one label per point, and stitches them into the
+  // graph of mem_index_file: every node keeps its neighbors of the same label
+  // first, then its neighbors in the graph up to R. A search filtered by a
+  // label then follows only the edges to its points, from the medoid of the
+  // label: the labels and the label, medoid pairs are saved next to the disk
+  // index. A label of at most R / 2 + 1 points is a clique.
+  void stitch_label_graphs(const std::string &data_file,
+                           const std::string &label_file, unsigned R,
+                           unsigned L, const std::string &mem_index_file,
+                           const std::string &disk_index_file) {
+    size_t npts, dim, nlabels, label_dim;
+    get_bin_metadata(data_file, npts, dim);
+    std::unique_ptr<_u32[]> labels;
+    load_bin<_u32>(label_file, labels, nlabels, label_dim);
+    if (nlabels != npts || label_dim != 1) {
+      std::stringstream stream;
+      stream << "Label file of " << nlabels << " x " << label_dim
+             << " labels for " << npts << " points.";
+      throw diskann::ANNException(stream.str(), -1);
+    }
+    std::map<_u32, std::vector<_u32>> label_points;
+    for (size_t i = 0; i < npts; i++) {
+      label_points[labels[i]].push_back((_u32) i);
+    }
+
+    const unsigned                 label_R = std::max(R / 2, 1u);
+    std::vector<std::vector<_u32>> label_nbrs(npts);
+    std::vector<_u32>              label_medoids;
+    std::ifstream                  reader(data_file, std::ios::binary);
+    reader.exceptions(std::ios::failbit | std::ios::badbit);
+    std::string label_data_file = mem_index_file + "_label_data.bin";
+    for (auto &[label, ids] : label_points) {
+      _u32 medoid = ids[0];
+      if (ids.size() <= label_R + 1) {
+        for (auto id : ids) {
+          for (auto nbr : ids) {
+            if (nbr != id) {
+              label_nbrs[id].push_back(nbr);
+            }
+          }
+        }
+      } else {
+        std::vector<float> vectors(ids.size() * dim);
+        for (size_t i = 0; i < ids.size(); i++) {
+          reader.seekg(2 * sizeof(_u32) + (_u64) ids[i] * dim * sizeof(float),
+                       std::ios::beg);
+          reader.read((char *) (vectors.data() + i * dim),
+                      dim * sizeof(float));
+        }
+        save_bin<float>(label_data_file, vectors.data(), ids.size(), dim);
+        diskann::Parameters paras;
+        paras.Set<unsigned>("L", L);
+        paras.Set<unsigned>("R", label_R);
+        paras.Set<unsigned>("C", 750);
+        paras.Set<float>("alpha", 1.2f);
+        paras.Set<unsigned>("num_rnds", 2);
+        paras.Set<bool>("saturate_graph", 0);
+        paras.Set<bool>("accelerate_build", false);
+        diskann::Index<float> label_index(diskann::Metric::L2, false, dim,
+                                          ids.size(), false, false);
+        label_index.build(label_data_file.c_str(), ids.size(), paras);
+        auto &graph = *label_index.get_graph();
+        for (size_t i = 0; i < ids.size(); i++) {
+          for (size_t j = 0; j < graph[i].size() && j < label_R; j++) {
+            label_nbrs[ids[i]].push_back(ids[graph[i][j]]);
+          }
+        }
+        medoid = ids[label_index.get_entry_point()];
+      }
+      label_medoids.push_back(label);
+      label_medoids.push_back(medoid);
+    }
+    std::remove(label_data_file.c_str());
+
+    // the nodes past npts are frozen points, without a label
+    std::string stitched_file = mem_index_file + "_stitched";
+    {
+      std::ifstream in(mem_index_file, std::ios::binary);
+      in.exceptions(std::ios::failbit | std::ios::badbit);
+      std::ofstream out(stitched_file, std::ios::binary);
+      out.exceptions(std::ios::failbit | std::ios::badbit);
+      _u64 index_size, num_frozen_pts;
+      _u32 width, ep;
+      in.read((char *) &index_size, sizeof(_u64));
+      in.read((char *) &width, sizeof(_u32));
+      in.read((char *) &ep, sizeof(_u32));
+      in.read((char *) &num_frozen_pts, sizeof(_u64));
+      out.write((char *) &index_size, sizeof(_u64));
+      out.write((char *) &width, sizeof(_u32));
+      out.write((char *) &ep, sizeof(_u32));
+      out.write((char *) &num_frozen_pts, sizeof(_u64));
+      index_size = 24;
+      width = 0;
+      std::vector<_u32> nbrs;
+      for (size_t i = 0; i < npts + num_frozen_pts; i++) {
+        _u32 k;
+        in.read((char *) &k, sizeof(_u32));
+        nbrs.resize(k);
+        in.read((char *) nbrs.data(), k * sizeof(_u32));
+        if (i < npts) {
+          auto &stitched = label_nbrs[i];
+          for (auto nbr : nbrs) {
+            if (stitched.size() < R &&
+                std::find(stitched.begin(), stitched.end(), nbr) ==
+                    stitched.end()) {
+              stitched.push_back(nbr);
+            }
+          }
+          nbrs.swap(stitched);
+          std::vector<_u32>().swap(stitched);
+          k = (_u32) nbrs.size();
+        }
+        out.write((char *) &k, sizeof(_u32));
+        out.write((char *) nbrs.data(), k * sizeof(_u32));
+        index_size += (_u64) (k + 1) * sizeof(_u32);
+        width = std::max(width, k);
+      }
+      out.seekp(0, std::ios::beg);
+      out.write((char *) &index_size, sizeof(_u64));
+      out.write((char *) &width, sizeof(_u32));
+    }
+    std::rename(stitched_file.c_str(), mem_index_file.c_str());
+
+    save_bin<_u32>(get_disk_index_labels_file(disk_index_file), labels.get(),
+                   npts, 1);
+    save_bin<_u32>(get_disk_index_label_medoids_file(disk_index_file),
+                   label_medoids.data(), label_points.size(), 2);
+    LOG_KNOWHERE_INFO_ << "Graphs of " << label_points.size()
+                       << " labels stitched into the graph.";
+  }
+
   template<typename T>
   int build_disk_index(const BuildConfig &config) {
     if (!std::is_same<T, float>::value &&
@@ -1117,6 +1670,15 @@ namespace diskann {
 
     _u32 disk_pq_dims = config.disk_pq_dims;
     bool use_disk_pq = disk_pq_dims != 0;
+    bool use_disk_sq = config.disk_sq_type != DiskSQType::NONE;
+    if (use_disk_sq && (!std::is_same<T, float>::value || use_disk_pq)) {
+      LOG(ERROR) << "Disk SQ needs float data and does not go with disk PQ.";
+      return -1;
+    }
+    if (!config.label_file_path.empty() && !std::is_same<T, float>::value) {
+      LOG(ERROR) << "Labels need float data.";
+      return -1;
+    }
 
     bool reorder_data = config.reorder;
     bool ip_prepared = false;
@@ -1140,6 +1702,10 @@ namespace diskann {
     // optional, used if disk index must store pq data
     std::string disk_pq_compressed_vectors_path =
         index_prefix_path + "_disk.index_pq_compressed.bin";
+    // optional, used if disk index must store sq data
+    std::string disk_sq_table_path =
+        get_disk_index_sq_table_file(disk_index_path);
+    std::string disk_sq_codes_path = disk_index_path + "_sq_codes.bin";
     // optional, used if build mem usage is enough to generate cached nodes
     std::string cached_nodes_file = get_cached_nodes_file(index_prefix_path);
 
@@ -1204,6 +1770,12 @@ namespace diskann {
     size_t points_num, dim;
 
     diskann::get_bin_metadata(data_file_to_use.c_str(), points_num, dim);
+    // the exact vectors to rerank with are read a sector at a time
+    if (use_disk_sq && dim * sizeof(float) > SECTOR_LEN) {
+      LOG(ERROR) << "Disk SQ needs vectors of at most "
+                 << SECTOR_LEN / sizeof(float) << " dimensions, got " << dim;
+      return -1;
+    }
 
     size_t num_pq_chunks =
         (size_t) (std::floor)(_u64(pq_code_size_limit / points_num));
@@ -1275,21 +1847,47 @@ namespace diskann {
     auto vamana_index = diskann::build_merged_vamana_index<T>(
         data_file_to_use.c_str(), ip_prepared, diskann::Metric::L2, L, R,
         config.accelerate_build, p_val, indexing_ram_budget, mem_index_path,
-        medoids_path, centroids_path);
+        medoids_path, centroids_path, config.concurrent_shards,
+        config.knn_graph_builder);
     auto graph_e = std::chrono::high_resolution_clock::now();
     std::chrono::duration<double> graph_diff = graph_e - graph_s;
     LOG_KNOWHERE_INFO_ << "Training graph cost: " << graph_diff.count() << "s";
-    if (!use_disk_pq) {
+    if (!config.label_file_path.empty()) {
+      stitch_label_graphs(data_file_to_use, config.label_file_path, R, L,
+                          mem_index_path, disk_index_path);
+    }
+    if (use_disk_sq) {
+      generate_disk_sq_data(data_file_to_save, config.disk_sq_type,
+                            disk_sq_table_path, disk_sq_codes_path);
+      diskann::create_disk_layout<_u8>(
+          disk_sq_codes_path, mem_index_path, disk_index_path,
+          data_file_to_save.c_str(), config.compress_graph);
+    } else if (!use_disk_pq) {
       diskann::create_disk_layout<T>(data_file_to_save.c_str(), mem_index_path,
-                                     disk_index_path);
+                                     disk_index_path, "",
+                                     config.compress_graph);
     } else {
       if (!reorder_data)
         diskann::create_disk_layout<_u8>(disk_pq_compressed_vectors_path,
-                                         mem_index_path, disk_index_path);
+                                         mem_index_path, disk_index_path, "",
+                                         config.compress_graph);
       else
-        diskann::create_disk_layout<_u8>(disk_pq_compressed_vectors_path,
-                                         mem_index_path, disk_index_path,
-                                         data_file_to_save.c_str());
+        diskann::create_disk_layout<_u8>(
+            disk_pq_compressed_vectors_path, mem_index_path, disk_index_path,
+            data_file_to_save.c_str(), config.compress_graph);
+    }
+    if (config.graph_layout) {
+      relayout_disk_index(mem_index_path, disk_index_path,
+                          get_disk_index_layout_file(disk_index_path));
+    }
+    if (config.nav_graph_ratio > 0) {
+      if (std::is_same<T, float>::value) {
+        build_nav_graph(data_file_to_use, config.nav_graph_ratio,
+                        std::min(R, kNavGraphMaxDegree), L,
+                        get_disk_index_nav_graph_file(disk_index_path));
+      } else {
+        LOG_KNOWHERE_WARNING_ << "No navigation graph for non-float data.";
+      }
     }
 
     double ten_percent_points = std::ceil(points_num * 0.1);
@@ -1329,18 +1927,23 @@ namespace diskann {
     std::remove(mem_index_path.c_str());
     if (use_disk_pq)
       std::remove(disk_pq_compressed_vectors_path.c_str());
+    if (use_disk_sq)
+      std::remove(disk_sq_codes_path.c_str());
     return 0;
   }
 
   template DISKANN_DLLEXPORT void create_disk_layout<int8_t>(
       const std::string base_file, const std::string mem_index_file,
-      const std::string output_file, const std::string reorder_data_file);
+      const std::string output_file, const std::string reorder_data_file,
+      bool compress_graph);
   template DISKANN_DLLEXPORT void create_disk_layout<uint8_t>(
       const std::string base_file, const std::string mem_index_file,
-      const std::string output_file, const std::string reorder_data_file);
+      const std::string output_file, const std::string reorder_data_file,
+      bool compress_graph);
   template DISKANN_DLLEXPORT void create_disk_layout<float>(
       const std::string base_file, const std::string mem_index_file,
-      const std::string output_file, const std::string reorder_data_file);
+      const std::string output_file, const std::string reorder_data_file,
+      bool compress_graph);
 
   template DISKANN_DLLEXPORT int8_t *load_warmup<int8_t>(
       const std::string &cache_warmup_file, uint64_t &warmup_num,
@@ -1394,7 +1997,9 @@ namespace diskann {
                                     double sampling_rate, double ram_budget,
                                     std::string mem_index_path,
                                     std::string medoids_path,
-                                    std::string centroids_file);
+                                    std::string centroids_file,
+                                    unsigned    concurrent_shards,
+                                    const KnnGraphBuilder &knn_graph_builder);
   template DISKANN_DLLEXPORT std::unique_ptr<diskann::Index<float>>
   build_merged_vamana_index<float>(std::string base_file, bool ip_prepared,
                                    diskann::Metric compareMetric, unsigned L,
@@ -1402,7 +2007,9 @@ namespace diskann {
                                    double sampling_rate, double ram_budget,
                                    std::string mem_index_path,
                                    std::string medoids_path,
-                                   std::string centroids_file);
+                                   std::string centroids_file,
+                                   unsigned    concurrent_shards,
+                                   const KnnGraphBuilder &knn_graph_builder);
   template DISKANN_DLLEXPORT std::unique_ptr<diskann::Index<uint8_t>>
   build_merged_vamana_index<uint8_t>(std::string base_file, bool ip_prepared,
                                      diskann::Metric compareMetric, unsigned L,
@@ -1410,7 +2017,9 @@ namespace diskann {
                                      double sampling_rate, double ram_budget,
                                      std::string mem_index_path,
                                      std::string medoids_path,
-                                     std::string centroids_file);
+                                     std::string centroids_file,
+                                     unsigned    concurrent_shards,
+                                     const KnnGraphBuilder &knn_graph_builder);
 
   template DISKANN_DLLEXPORT void
   generate_cache_list_from_graph_with_pq<int8_t>(
@@ -0,0 +1,118 @@
+#include "diskann/coalescing_aligned_file_reader.h"
+
+#include <cstring>
+
+struct CoalescedRead {
+  void    *buf = nullptr;
+  uint64_t len = 0;
+  bool     done = false;
+  bool     failed = false;
+  // searches copying buf once done, the issuer keeps buf until they finish
+  size_t waiters = 0;
+};
+
+void CoalescingAlignedFileReader::read(std::vector<AlignedRead> &read_reqs,
+                                       IOContext &ctx, bool async) {
+  // the reads this call issues, with the entries the others may join (null
+  // for the reads of a sector in flight with another length), and the ones
+  // it joins with the requests to copy them into
+  std::vector<AlignedRead>                                         issued;
+  std::vector<std::shared_ptr<CoalescedRead>>                      issued_entries;
+  std::vector<std::pair<std::shared_ptr<CoalescedRead>, AlignedRead>> joined;
+  issued.reserve(read_reqs.size());
+  issued_entries.reserve(read_reqs.size());
+  {
+    std::unique_lock<std::mutex> lk(mtx_);
+    for (auto &req : read_reqs) {
+      auto iter = in_flight_.find(req.offset);
+      if (iter != in_flight_.end() && iter->second->len == req.len) {
+        iter->second->waiters++;
+        joined.emplace_back(iter->second, req);
+        continue;
+      }
+      issued.push_back(req);
+      if (iter == in_flight_.end()) {
+        auto entry = std::make_shared<CoalescedRead>();
+        entry->buf = req.buf;
+        entry->len = req.len;
+        in_flight_.emplace(req.offset, entry);
+        issued_entries.push_back(std::move(entry));
+      } else {
+        issued_entries.push_back(nullptr);
+      }
+    }
+  }
+  n_reads_.fetch_add(read_reqs.size(), std::memory_order_relaxed);
+  n_coalesced_.fetch_add(joined.size(), std::memory_order_relaxed);
+
+  // the entries of this call leave in_flight_ once read, successfully or not
+  auto finish_issued = [&](bool failed) {
+    std::unique_lock<std::mutex> lk(mtx_);
+    for (size_t i = 0; i < issued.size(); i++) {
+      auto &entry = issued_entries[i];
+      if (entry == nullptr) {
+        continue;
+      }
+      entry->done = true;
+      entry->failed = failed;
+      auto iter = in_flight_.find(issued[i].offset);
+      if (iter != in_flight_.end() && iter->second == entry) {
+        in_flight_.erase(iter);
+      }
+    }
+    cv_.notify_all();
+  };
+
+  try {
+    if (!issued.empty()) {
+      reader_->read(issued, ctx, async);
+    }
+  } catch (...) {
+    finish_issued(true);
+    // the issuers of the joined reads wait for this call to be done with
+    // their buffers
+    std::unique_lock<std::mutex> lk(mtx_);
+    for (auto &join : joined) {
+      join.first->waiters--;
+    }
+    cv_.notify_all();
+    throw;
+  }
+  finish_issued(false);
+
+  // copy the joined reads as they complete, the failed ones are read again
+  std::vector<AlignedRead> retry;
+  for (auto &join : joined) {
+    auto &entry = join.first;
+    {
+      std::unique_lock<std::mutex> lk(mtx_);
+      cv_.wait(lk, [&entry] { return entry->done; });
+      if (entry->failed) {
+        entry->waiters--;
+        cv_.notify_all();
+        retry.push_back(join.second);
+        continue;
+      }
+    }
+    std::memcpy(join.second.buf, entry->buf, entry->len);
+    std::unique_lock<std::mutex> lk(mtx_);
+    entry->waiters--;
+    cv_.notify_all();
+  }
+
+  // keep the buffers of this call until the joined reads copied them
+  {
+    std::unique_lock<std::mutex> lk(mtx_);
+    cv_.wait(lk, [&issued_entries] {
+      for (auto &entry : issued_entries) {
+        if (entry != nullptr && entry->waiters > 0) {
+          return false;
+        }
+      }
+      return true;
+    });
+  }
+  if (!retry.empty()) {
+    reader_->read(retry, ctx, async);
+  }
+}
@@ -1416,6 +1416,23 @@ namespace diskann {
    */
   template<typename T, typename TagT>
   void Index<T, TagT>::link(Parameters &parameters) {
+    // a graph of float vectors may start from a kNN graph of them
+    auto knn_graph_builder = parameters.Get<KnnGraphBuilder>(
+        "knn_graph_builder", KnnGraphBuilder());
+    if (knn_graph_builder && std::is_same<T, float>::value &&
+        _num_frozen_pts == 0 && _nd > 0) {
+      auto           k = parameters.Get<unsigned>("R");
+      diskann::Timer knn_timer;
+      auto           knn_graph =
+          knn_graph_builder((const float *) _data, _nd, _aligned_dim, k);
+      if (!knn_graph.empty()) {
+        LOG_KNOWHERE_INFO_ << "kNN graph of " << _nd << " points built in "
+                           << (double) knn_timer.elapsed() / 1000000 << "s";
+        link_knn_graph(parameters, knn_graph, k);
+        return;
+      }
+    }
+
     uint32_t num_syncs = (unsigned) DIV_ROUND_UP(_nd + _num_frozen_pts, 8192);
     if (num_syncs < 40)
       num_syncs = 40;
@@ -1724,6 +1741,97 @@ namespace diskann {
     }
   }
 
+  template<typename T, typename TagT>
+  void Index<T, TagT>::link_knn_graph(Parameters                  &parameters,
+                                      const std::vector<unsigned> &knn_graph,
+                                      unsigned                     k) {
+    _saturate_graph = parameters.Get<bool>("saturate_graph");
+    _indexingQueueSize = parameters.Get<unsigned>("L");
+    _indexingRange = parameters.Get<unsigned>("R");
+    _indexingMaxC = parameters.Get<unsigned>("C");
+    _indexingAlpha = parameters.Get<float>("alpha");
+    _ep = calculate_entry_point();
+
+    diskann::Timer link_timer;
+    std::vector<std::vector<unsigned>> reverse(_nd);
+    for (size_t i = 0; i < _nd; i++) {
+      for (size_t j = 0; j < k; j++) {
+        auto id = knn_graph[i * k + j];
+        if (id < _nd && id != i)
+          reverse[id].push_back((unsigned) i);
+      }
+    }
+
+    // runs fn on every node, in batches of the build pool
+    auto num_threads = std::max<size_t>(1, _build_thread_pool->size());
+    size_t batch_size = DIV_ROUND_UP(_nd, num_threads * 8);
+    auto   for_all_nodes = [&](auto &&fn) {
+      std::vector<folly::Future<folly::Unit>> futures;
+      for (size_t begin = 0; begin < _nd; begin += batch_size) {
+        futures.emplace_back(_build_thread_pool->push(
+            [&, begin, end = std::min(_nd, begin + batch_size)]() {
+              for (size_t node = begin; node < end; node++)
+                fn((unsigned) node);
+            }));
+      }
+      for (auto &future : futures) {
+        future.wait();
+      }
+    };
+
+    // the neighbors of a node are pruned from its kNN and the nodes having it
+    // in theirs, the way link() prunes the nodes its searches visit
+    std::vector<std::vector<unsigned>> pruned_lists(_nd);
+    for_all_nodes([&](unsigned node) {
+      tsl::robin_set<unsigned> visited;
+      std::vector<Neighbor>    pool;
+      auto                     add = [&](unsigned id) {
+        if (id < _nd && id != node && visited.insert(id).second) {
+          float dist = _distance(_data + _aligned_dim * (size_t) node,
+                                 _data + _aligned_dim * (size_t) id,
+                                 (size_t) _aligned_dim);
+          pool.emplace_back(Neighbor(id, dist, true));
+        }
+      };
+      for (size_t j = 0; j < k; j++)
+        add(knn_graph[node * k + j]);
+      for (auto id : reverse[node])
+        add(id);
+      if (!pool.empty())
+        prune_neighbors(node, pool, pruned_lists[node]);
+    });
+    std::vector<std::vector<unsigned>>().swap(reverse);
+    for_all_nodes(
+        [&](unsigned node) { _final_graph[node] = pruned_lists[node]; });
+
+    // then the reverse links, and the nodes they took over the range pruned
+    std::vector<unsigned> need_to_sync(_max_points + _num_frozen_pts, 0);
+    for_all_nodes([&](unsigned node) {
+      batch_inter_insert(node, pruned_lists[node], need_to_sync);
+    });
+    std::vector<std::vector<unsigned>>().swap(pruned_lists);
+    for_all_nodes([&](unsigned node) {
+      if (_final_graph[node].size() <= _indexingRange)
+        return;
+      tsl::robin_set<unsigned> visited;
+      std::vector<Neighbor>    pool;
+      for (auto id : _final_graph[node]) {
+        if (id != node && visited.insert(id).second) {
+          float dist = _distance(_data + _aligned_dim * (size_t) node,
+                                 _data + _aligned_dim * (size_t) id,
+                                 (size_t) _aligned_dim);
+          pool.emplace_back(Neighbor(id, dist, true));
+        }
+      }
+      std::vector<unsigned> new_out_neighbors;
+      prune_neighbors(node, pool, new_out_neighbors);
+      _final_graph[node] = std::move(new_out_neighbors);
+    });
+    LOG_KNOWHERE_INFO_ << "Graph of " << _nd << " points pruned from the kNN "
+                       << "graph in "
+                       << (double) link_timer.elapsed() / 1000000 << "s";
+  }
+
   template<typename T, typename TagT>
   void Index<T, TagT>::prune_all_nbrs(const Parameters &parameters) {
     const unsigned range = parameters.Get<unsigned>("R");
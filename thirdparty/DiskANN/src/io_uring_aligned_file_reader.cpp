@@ -0,0 +1,453 @@
+#include "diskann/io_uring_aligned_file_reader.h"
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include "diskann/utils.h"
+
+// the rings are driven through the raw system calls, the few operations
+// needed here do not justify a dependency on liburing
+struct IoUringRing {
+  int fd = -1;
+
+  unsigned     *sq_tail = nullptr;
+  unsigned     *sq_mask = nullptr;
+  unsigned     *sq_flags = nullptr;
+  unsigned     *sq_array = nullptr;
+  io_uring_sqe *sqes = nullptr;
+  unsigned     *cq_head = nullptr;
+  unsigned     *cq_tail = nullptr;
+  unsigned     *cq_mask = nullptr;
+  io_uring_cqe *cqes = nullptr;
+
+  void  *sq_map = nullptr;
+  size_t sq_map_size = 0;
+  void  *cq_map = nullptr;
+  size_t cq_map_size = 0;
+  size_t sqes_size = 0;
+
+  unsigned entries = 0;
+  bool     sqpoll = false;
+  // submitted by submit_req and not reaped yet
+  size_t pending = 0;
+
+  bool               file_registered = false;
+  uint64_t           buf_gen = 0;
+  std::vector<iovec> bufs;  // registered, sorted by address
+
+  ~IoUringRing() {
+    if (sqes != nullptr) {
+      munmap(sqes, sqes_size);
+    }
+    if (cq_map != nullptr && cq_map != sq_map) {
+      munmap(cq_map, cq_map_size);
+    }
+    if (sq_map != nullptr) {
+      munmap(sq_map, sq_map_size);
+    }
+    if (fd >= 0) {
+      ::close(fd);
+    }
+  }
+};
+
+namespace {
+  static constexpr uint64_t n_retries = 10;
+  // how long the shared submission queue poller spins before it sleeps
+  static constexpr unsigned sq_thread_idle_ms = 50;
+
+  int io_uring_setup(unsigned entries, io_uring_params *p) {
+    return (int) syscall(__NR_io_uring_setup, entries, p);
+  }
+
+  int io_uring_enter(int fd, unsigned to_submit, unsigned min_complete,
+                     unsigned flags) {
+    return (int) syscall(__NR_io_uring_enter, fd, to_submit, min_complete,
+                         flags, nullptr, 0);
+  }
+
+  int io_uring_register(int fd, unsigned opcode, const void *arg,
+                        unsigned nr_args) {
+    return (int) syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+  }
+
+  [[noreturn]] void throw_errno(const char *what, int err) {
+    std::stringstream ss;
+    ss << "Unknown error occur in " << what << ", errno: " << err << ", "
+       << strerror(err);
+    throw diskann::ANNException(ss.str(), -1, __FUNCSIG__, __FILE__,
+                                __LINE__);
+  }
+
+  IoUringRing *ring_of(io_context_t ctx) {
+    return reinterpret_cast<IoUringRing *>(ctx);
+  }
+
+  // queues the reads, the caller makes sure the ring has room for them
+  void queue_reads(IoUringRing *ring, int fd, const AlignedRead *reqs,
+                   size_t n) {
+    unsigned tail = *ring->sq_tail;
+    for (size_t i = 0; i < n; i++, tail++) {
+      const auto    &req = reqs[i];
+      const unsigned idx = tail & *ring->sq_mask;
+      io_uring_sqe  *sqe = ring->sqes + idx;
+      memset(sqe, 0, sizeof(*sqe));
+      sqe->opcode = IORING_OP_READ;
+      sqe->addr = (uint64_t) req.buf;
+      sqe->len = (uint32_t) req.len;
+      sqe->off = req.offset;
+      sqe->user_data = (uint64_t) req.buf;
+      if (ring->file_registered) {
+        sqe->fd = 0;
+        sqe->flags = IOSQE_FIXED_FILE;
+      } else {
+        sqe->fd = fd;
+      }
+      // the registered buffer holding the request, if any
+      auto it = std::upper_bound(
+          ring->bufs.begin(), ring->bufs.end(), req.buf,
+          [](void *p, const iovec &v) { return p < v.iov_base; });
+      if (it != ring->bufs.begin()) {
+        --it;
+        const char *base = (const char *) it->iov_base;
+        if ((const char *) req.buf + req.len <= base + it->iov_len) {
+          sqe->opcode = IORING_OP_READ_FIXED;
+          sqe->buf_index = (uint16_t) (it - ring->bufs.begin());
+        }
+      }
+      ring->sq_array[idx] = idx;
+    }
+    __atomic_store_n(ring->sq_tail, tail, __ATOMIC_RELEASE);
+  }
+
+  // hands n queued reads to the kernel and, unless polled, waits for
+  // min_complete completions in the same call
+  void submit(IoUringRing *ring, unsigned n, unsigned min_complete) {
+    if (ring->sqpoll) {
+      // the poller may have gone to sleep before it saw the new tail
+      __atomic_thread_fence(__ATOMIC_SEQ_CST);
+      if (__atomic_load_n(ring->sq_flags, __ATOMIC_RELAXED) &
+          IORING_SQ_NEED_WAKEUP) {
+        while (io_uring_enter(ring->fd, n, 0, IORING_ENTER_SQ_WAKEUP) < 0) {
+          if (errno != EINTR) {
+            throw_errno("io_uring_enter", errno);
+          }
+        }
+      }
+      return;
+    }
+    // the kernel only waits once it took all the reads
+    unsigned submitted = 0;
+    uint64_t submit_retry = 0;
+    while (submitted < n) {
+      int ret = io_uring_enter(ring->fd, n - submitted, min_complete,
+                               min_complete > 0 ? IORING_ENTER_GETEVENTS : 0);
+      if (ret < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        if ((errno != EAGAIN && errno != EBUSY) ||
+            ++submit_retry > n_retries) {
+          throw_errno("io_uring_enter", errno);
+        }
+        LOG(WARNING) << "io_uring_enter() failed; submit: " << submitted
+                     << ", expected: " << n << ", retry: " << submit_retry;
+        continue;
+      }
+      submitted += ret;
+    }
+  }
+
+  // reaps between min_n and max_n completions, taking all the ones available
+  // at once before waiting for more, and appends their buffers to bufs
+  size_t reap(IoUringRing *ring, size_t min_n, size_t max_n,
+              std::vector<void *> *bufs = nullptr) {
+    size_t done = 0;
+    int    err = 0;
+    while (true) {
+      unsigned head = *ring->cq_head;
+      unsigned tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+      for (; head != tail && done < max_n; head++, done++) {
+        const io_uring_cqe *cqe = ring->cqes + (head & *ring->cq_mask);
+        if (cqe->res < 0 && err == 0) {
+          err = -cqe->res;
+        }
+        if (bufs != nullptr) {
+          bufs->push_back((void *) cqe->user_data);
+        }
+      }
+      __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+      if (done >= min_n) {
+        break;
+      }
+      if (io_uring_enter(ring->fd, 0, (unsigned) (min_n - done),
+                         IORING_ENTER_GETEVENTS) < 0 &&
+          errno != EINTR) {
+        throw_errno("io_uring_enter", errno);
+      }
+    }
+    if (err != 0) {
+      throw_errno("io_uring read", err);
+    }
+    return done;
+  }
+}  // namespace
+
+bool IoUringAlignedFileReader::Supported() {
+  io_uring_params p;
+  memset(&p, 0, sizeof(p));
+  int fd = io_uring_setup(1, &p);
+  if (fd < 0) {
+    return false;
+  }
+  ::close(fd);
+  return true;
+}
+
+IoUringAlignedFileReader::IoUringAlignedFileReader() {
+  this->file_desc = -1;
+  std::scoped_lock lk(global_mut);
+  this->queue_depth_ = global_queue_depth;
+  this->sqpoll_ = global_sqpoll;
+}
+
+IoUringAlignedFileReader::~IoUringAlignedFileReader() {
+  // rings attached to the poller of the first one go first
+  while (!rings_.empty()) {
+    rings_.pop_back();
+  }
+  if (this->file_desc != -1 && ::fcntl(this->file_desc, F_GETFD) != -1) {
+    std::cerr << "close() not called" << std::endl;
+    ::close(this->file_desc);
+  }
+}
+
+IoUringRing *IoUringAlignedFileReader::create_ring() {
+  auto            ring = std::make_unique<IoUringRing>();
+  io_uring_params p;
+  memset(&p, 0, sizeof(p));
+  if (sqpoll_) {
+    p.flags = IORING_SETUP_SQPOLL;
+    p.sq_thread_idle = sq_thread_idle_ms;
+    if (!rings_.empty()) {
+      p.flags |= IORING_SETUP_ATTACH_WQ;
+      p.wq_fd = rings_.front()->fd;
+    }
+  }
+  ring->fd = io_uring_setup(queue_depth_, &p);
+  if (ring->fd < 0 && sqpoll_ && errno == EPERM) {
+    // polling needs privileges before linux 5.11
+    LOG(WARNING) << "io_uring sqpoll is not permitted, submit by syscalls";
+    sqpoll_ = false;
+    memset(&p, 0, sizeof(p));
+    ring->fd = io_uring_setup(queue_depth_, &p);
+  }
+  if (ring->fd < 0) {
+    throw_errno("io_uring_setup", errno);
+  }
+  ring->sqpoll = sqpoll_;
+  ring->entries = p.sq_entries;
+
+  ring->sq_map_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+  ring->cq_map_size = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+  if (p.features & IORING_FEAT_SINGLE_MMAP) {
+    ring->sq_map_size = ring->cq_map_size =
+        std::max(ring->sq_map_size, ring->cq_map_size);
+  }
+  ring->sq_map = mmap(nullptr, ring->sq_map_size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+  if (ring->sq_map == MAP_FAILED) {
+    ring->sq_map = nullptr;
+    throw_errno("mmap of io_uring", errno);
+  }
+  if (p.features & IORING_FEAT_SINGLE_MMAP) {
+    ring->cq_map = ring->sq_map;
+  } else {
+    ring->cq_map = mmap(nullptr, ring->cq_map_size, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, ring->fd,
+                        IORING_OFF_CQ_RING);
+    if (ring->cq_map == MAP_FAILED) {
+      ring->cq_map = nullptr;
+      throw_errno("mmap of io_uring", errno);
+    }
+  }
+  ring->sqes_size = p.sq_entries * sizeof(io_uring_sqe);
+  void *sqes = mmap(nullptr, ring->sqes_size, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+  if (sqes == MAP_FAILED) {
+    throw_errno("mmap of io_uring", errno);
+  }
+  ring->sqes = (io_uring_sqe *) sqes;
+
+  char *sq = (char *) ring->sq_map;
+  char *cq = (char *) ring->cq_map;
+  ring->sq_tail = (unsigned *) (sq + p.sq_off.tail);
+  ring->sq_mask = (unsigned *) (sq + p.sq_off.ring_mask);
+  ring->sq_flags = (unsigned *) (sq + p.sq_off.flags);
+  ring->sq_array = (unsigned *) (sq + p.sq_off.array);
+  ring->cq_head = (unsigned *) (cq + p.cq_off.head);
+  ring->cq_tail = (unsigned *) (cq + p.cq_off.tail);
+  ring->cq_mask = (unsigned *) (cq + p.cq_off.ring_mask);
+  ring->cqes = (io_uring_cqe *) (cq + p.cq_off.cqes);
+
+  rings_.push_back(std::move(ring));
+  return rings_.back().get();
+}
+
+// brings the registrations of a ring nobody else uses up to date
+void IoUringAlignedFileReader::sync_ring(IoUringRing *ring) {
+  if (!ring->file_registered && this->file_desc != -1) {
+    ring->file_registered =
+        io_uring_register(ring->fd, IORING_REGISTER_FILES, &this->file_desc,
+                          1) == 0;
+  }
+  std::vector<std::pair<void *, size_t>> bufs;
+  {
+    std::scoped_lock lk(ring_mtx_);
+    if (ring->buf_gen == buf_gen_) {
+      return;
+    }
+    ring->buf_gen = buf_gen_;
+    bufs = bufs_;
+  }
+  if (!ring->bufs.empty()) {
+    io_uring_register(ring->fd, IORING_UNREGISTER_BUFFERS, nullptr, 0);
+    ring->bufs.clear();
+  }
+  if (bufs.empty()) {
+    return;
+  }
+  std::vector<iovec> iovs;
+  iovs.reserve(bufs.size());
+  for (auto &[buf, len] : bufs) {
+    iovs.push_back({buf, len});
+  }
+  std::sort(iovs.begin(), iovs.end(), [](const iovec &a, const iovec &b) {
+    return a.iov_base < b.iov_base;
+  });
+  if (io_uring_register(ring->fd, IORING_REGISTER_BUFFERS, iovs.data(),
+                        (unsigned) iovs.size()) != 0) {
+    // pinning counts against RLIMIT_MEMLOCK, read into unpinned buffers
+    LOG(WARNING) << "io_uring buffer registration failed, errno: " << errno
+                 << ", " << strerror(errno);
+    return;
+  }
+  ring->bufs = std::move(iovs);
+}
+
+io_context_t IoUringAlignedFileReader::get_ctx() {
+  IoUringRing *ring = nullptr;
+  {
+    std::scoped_lock lk(ring_mtx_);
+    if (idle_rings_.empty()) {
+      ring = create_ring();
+    } else {
+      ring = idle_rings_.back();
+      idle_rings_.pop_back();
+    }
+  }
+  sync_ring(ring);
+  return reinterpret_cast<io_context_t>(ring);
+}
+
+void IoUringAlignedFileReader::put_ctx(io_context_t ctx) {
+  std::scoped_lock lk(ring_mtx_);
+  idle_rings_.push_back(ring_of(ctx));
+}
+
+void IoUringAlignedFileReader::register_buffers(
+    const std::vector<std::pair<void *, size_t>> &bufs) {
+  std::vector<IoUringRing *> idle;
+  {
+    std::scoped_lock lk(ring_mtx_);
+    bufs_ = bufs;
+    buf_gen_++;
+    idle.swap(idle_rings_);
+  }
+  // rings in use pick the buffers up when handed out next
+  for (auto ring : idle) {
+    sync_ring(ring);
+  }
+  std::scoped_lock lk(ring_mtx_);
+  idle_rings_.insert(idle_rings_.end(), idle.begin(), idle.end());
+}
+
+void IoUringAlignedFileReader::open(const std::string &fname) {
+  int flags = O_DIRECT | O_RDONLY | O_LARGEFILE;
+  this->file_desc = ::open(fname.c_str(), flags);
+  // error checks
+  assert(this->file_desc != -1);
+  LOG_KNOWHERE_DEBUG_ << "Opened file : " << fname;
+}
+
+void IoUringAlignedFileReader::close() {
+  {
+    std::scoped_lock lk(ring_mtx_);
+    for (auto &ring : rings_) {
+      if (ring->file_registered) {
+        io_uring_register(ring->fd, IORING_UNREGISTER_FILES, nullptr, 0);
+        ring->file_registered = false;
+      }
+    }
+  }
+  ::close(this->file_desc);
+  this->file_desc = -1;
+}
+
+void IoUringAlignedFileReader::read(std::vector<AlignedRead> &read_reqs,
+                                    io_context_t &ctx, bool async) {
+  if (async == true) {
+    diskann::cout << "Async currently not supported in linux." << std::endl;
+  }
+  assert(this->file_desc != -1);
+  auto ring = ring_of(ctx);
+  for (size_t i = 0; i < read_reqs.size(); i += ring->entries) {
+    const size_t n_ops = std::min<size_t>(read_reqs.size() - i, ring->entries);
+    queue_reads(ring, this->file_desc, read_reqs.data() + i, n_ops);
+    submit(ring, (unsigned) n_ops, (unsigned) n_ops);
+    reap(ring, n_ops, n_ops);
+  }
+}
+
+void IoUringAlignedFileReader::submit_req(io_context_t             &ctx,
+                                          std::vector<AlignedRead> &read_reqs) {
+  auto ring = ring_of(ctx);
+  if (ring->pending + read_reqs.size() > ring->entries) {
+    std::stringstream err;
+    err << "Async does not support number of read requests ("
+        << ring->pending + read_reqs.size()
+        << ") exceeds max number of events per context (" << ring->entries
+        << ")";
+    throw diskann::ANNException(err.str(), -1, __FUNCSIG__, __FILE__, __LINE__);
+  }
+  queue_reads(ring, this->file_desc, read_reqs.data(), read_reqs.size());
+  submit(ring, (unsigned) read_reqs.size(), 0);
+  ring->pending += read_reqs.size();
+}
+
+void IoUringAlignedFileReader::get_submitted_req(io_context_t &ctx,
+                                                 size_t        n_ops) {
+  auto ring = ring_of(ctx);
+  if (n_ops > ring->pending) {
+    std::stringstream err;
+    err << "Async does not support getting number of read requests (" << n_ops
+        << ") exceeds number of submitted requests (" << ring->pending << ")";
+    throw diskann::ANNException(err.str(), -1, __FUNCSIG__, __FILE__, __LINE__);
+  }
+  reap(ring, n_ops, n_ops);
+  ring->pending -= n_ops;
+}
+
+void IoUringAlignedFileReader::get_completed_req(io_context_t &ctx,
+                                                 size_t min_n, size_t max_n,
+                                                 std::vector<void *> &done) {
+  auto ring = ring_of(ctx);
+  ring->pending -= reap(ring, min_n, std::min(max_n, ring->pending), &done);
+}
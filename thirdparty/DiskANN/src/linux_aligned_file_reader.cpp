@@ -191,6 +191,7 @@ void LinuxAlignedFileReader::submit_req(io_context_t             &ctx,
   for (size_t j = 0; j < n_ops; j++) {
     io_prep_pread(cb.data() + j, fd, read_reqs[j].buf, read_reqs[j].len,
                   read_reqs[j].offset);
+    cb[j].data = read_reqs[j].buf;
   }
   for (uint64_t i = 0; i < n_ops; i++) {
     cbs[i] = cb.data() + i;
@@ -262,4 +263,36 @@ void LinuxAlignedFileReader::get_submitted_req(io_context_t &ctx, size_t n_ops)
       }
     }
   }
-}
\ No newline at end of file
+}
+
+void LinuxAlignedFileReader::get_completed_req(io_context_t &ctx,
+                                               size_t min_n, size_t max_n,
+                                               std::vector<void *> &done) {
+  std::vector<io_event_t> evts(max_n);
+  uint64_t                num_read = 0;
+  while (num_read < min_n) {
+    int64_t ret = io_getevents(ctx, min_n - num_read, max_n - num_read,
+                               evts.data() + num_read, nullptr);
+    if (ret < 0) {
+      if (-ret == EINTR) {
+        continue;
+      }
+      std::stringstream err;
+      err << "Unknown error occur in io_getevents, errno: " << -ret << ", "
+          << strerror(-ret);
+      throw diskann::ANNException(err.str(), -1, __FUNCSIG__, __FILE__,
+                                  __LINE__);
+    }
+    num_read += ret;
+  }
+  for (uint64_t i = 0; i < num_read; i++) {
+    if ((int64_t) evts[i].res < 0) {
+      std::stringstream err;
+      err << "Read failed, errno: " << -(int64_t) evts[i].res << ", "
+          << strerror(-(int64_t) evts[i].res);
+      throw diskann::ANNException(err.str(), -1, __FUNCSIG__, __FILE__,
+                                  __LINE__);
+    }
+    done.push_back(evts[i].data);
+  }
+}
@@ -7,6 +7,7 @@
 #include <diskann/math_utils.h>
 #include "diskann/logger.h"
 #include "diskann/utils.h"
+#include "faiss/Clustering.h"
 
 #ifndef FINTEGER
 #define FINTEGER long
@@ -458,6 +459,20 @@ namespace kmeans {
 
   void kmeanspp_selecting_pivots(float* data, size_t num_points, size_t dim,
                                  float* pivot_data, size_t num_centers) {
+    // k-means|| takes a few batched passes over the points rather than one
+    // per center, so it has no limit on their number
+    if (faiss::clustering_type == faiss::ClusteringType::K_MEANS_PARALLEL &&
+        num_points >= num_centers) {
+      std::vector<int> centers(num_centers);
+      faiss::kmeans_parallel_seeding(data, num_points, dim, num_centers,
+                                     std::random_device{}(), centers.data());
+      for (size_t j = 0; j < num_centers; j++) {
+        std::memcpy(pivot_data + j * dim, data + (size_t) centers[j] * dim,
+                    dim * sizeof(float));
+      }
+      return;
+    }
+
     if (num_points > 1 << 23) {
       diskann::cout << "ERROR: n_pts " << num_points
                     << " currently not supported for k-means++, maximum is "
@@ -40,6 +40,7 @@
 #include <cassert>
 #include "diskann/memory_mapper.h"
 #include "diskann/partition_and_pq.h"
+#include "simd/hook.h"
 #ifdef _WINDOWS
 #include <xmmintrin.h>
 #endif
@@ -202,13 +203,6 @@ int generate_pq_pivots(const float *passed_train_data, size_t num_train,
   std::memcpy(train_data.get(), passed_train_data,
               num_train * dim * sizeof(float));
 
-  for (uint64_t i = 0; i < num_train; i++) {
-    for (uint64_t j = 0; j < dim; j++) {
-      if (passed_train_data[i * dim + j] != train_data[i * dim + j])
-        LOG(ERROR) << "error in copy";
-    }
-  }
-
   std::unique_ptr<float[]> full_pivot_data;
 
   if (file_exists(pq_pivots_path)) {
@@ -231,17 +225,17 @@ int generate_pq_pivots(const float *passed_train_data, size_t num_train,
                          // compute PQ. This needs to be set to false when using
                          // PQ for MIPS as such translations dont preserve inner
                          // products.
+    // row by row, the training data is row major
+    for (uint64_t p = 0; p < num_train; p++) {
+      faiss::fvec_madd(dim, centroid.get(), 1.0f, train_data.get() + p * dim,
+                       centroid.get());
+    }
     for (uint64_t d = 0; d < dim; d++) {
-      for (uint64_t p = 0; p < num_train; p++) {
-        centroid[d] += train_data[p * dim + d];
-      }
       centroid[d] /= num_train;
     }
-
-    for (uint64_t d = 0; d < dim; d++) {
-      for (uint64_t p = 0; p < num_train; p++) {
-        train_data[p * dim + d] -= centroid[d];
-      }
+    for (uint64_t p = 0; p < num_train; p++) {
+      faiss::fvec_madd(dim, train_data.get() + p * dim, -1.0f, centroid.get(),
+                       train_data.get() + p * dim);
     }
   }
 
@@ -476,120 +470,125 @@ int generate_pq_data_from_pivots(const std::string data_file,
   std::memset(block_inflated_base.get(), 0, block_size * dim * sizeof(float));
 #endif
 
-  std::unique_ptr<_u32[]> block_compressed_base =
-      std::make_unique<_u32[]>(block_size * (_u64) num_pq_chunks);
-  std::memset(block_compressed_base.get(), 0,
-              block_size * (_u64) num_pq_chunks * sizeof(uint32_t));
-
-  std::unique_ptr<T[]> block_data_T = std::make_unique<T[]>(block_size * dim);
-  std::unique_ptr<float[]> block_data_float =
-      std::make_unique<float[]>(block_size * dim);
+  // the pivots of each chunk side by side, with their squared norms: the
+  // closest pivot of a chunk is the argmin of |c|^2 - 2 <x, c>, with the
+  // inner products to all the pivots taken at once by the simd kernels
+  std::vector<std::vector<float>> chunk_pivots(num_pq_chunks);
+  std::vector<std::vector<float>> chunk_norms(num_pq_chunks);
+  for (size_t i = 0; i < num_pq_chunks; i++) {
+    size_t chunk_size = chunk_offsets[i + 1] - chunk_offsets[i];
+    chunk_pivots[i].resize(num_centers * chunk_size);
+    chunk_norms[i].resize(num_centers);
+    for (size_t c = 0; c < num_centers; c++) {
+      float *pivot = chunk_pivots[i].data() + c * chunk_size;
+      std::memcpy(pivot, full_pivot_data.get() + c * dim + chunk_offsets[i],
+                  chunk_size * sizeof(float));
+      chunk_norms[i][c] = faiss::fvec_norm_L2sqr(pivot, chunk_size);
+    }
+  }
 
-  size_t num_blocks = DIV_ROUND_UP(num_points, block_size);
-  auto   thread_pool = knowhere::ThreadPool::GetGlobalBuildThreadPool();
-  std::vector<folly::Future<folly::Unit>> futures;
-  futures.reserve(num_pq_chunks);
+  // two blocks in flight: the next one is read and the previous one written
+  // while the current one is encoded
+  size_t               num_blocks = DIV_ROUND_UP(num_points, block_size);
+  std::unique_ptr<T[]> block_data[2] = {
+      std::make_unique<T[]>(block_size * dim),
+      std::make_unique<T[]>(block_size * dim)};
+  std::vector<_u32> block_codes[2] = {
+      std::vector<_u32>(block_size * num_pq_chunks),
+      std::vector<_u32>(block_size * num_pq_chunks)};
+  auto block_rows = [&](size_t block) {
+    return std::min(block_size, num_points - block * block_size);
+  };
+  auto read_block = [&](size_t block) {
+    base_reader.read((char *) block_data[block % 2].get(),
+                     sizeof(T) * block_rows(block) * dim);
+  };
+  auto write_block = [&](size_t block) {
+    size_t n = block_rows(block);
+    auto  &codes = block_codes[block % 2];
+    if (num_centers > 256) {
+      compressed_file_writer.write((char *) codes.data(),
+                                   n * num_pq_chunks * sizeof(uint32_t));
+    } else {
+      std::unique_ptr<uint8_t[]> pVec =
+          std::make_unique<uint8_t[]>(n * num_pq_chunks);
+      diskann::convert_types<uint32_t, uint8_t>(codes.data(), pVec.get(), n,
+                                                num_pq_chunks);
+      compressed_file_writer.write((char *) (pVec.get()),
+                                   n * num_pq_chunks * sizeof(uint8_t));
+    }
+#ifdef SAVE_INFLATED_PQ
+    for (size_t j = 0; j < n; j++) {
+      for (size_t i = 0; i < num_pq_chunks; i++) {
+        size_t chunk_size = chunk_offsets[i + 1] - chunk_offsets[i];
+        for (uint64_t k = 0; k < chunk_size; k++)
+          block_inflated_base[j * dim + chunk_offsets[i] + k] =
+              chunk_pivots[i][codes[j * num_pq_chunks + i] * chunk_size + k] +
+              centroid[chunk_offsets[i] + k];
+      }
+    }
+    inflated_file_writer.write((char *) (block_inflated_base.get()),
+                               n * dim * sizeof(float));
+#endif
+  };
 
+  auto thread_pool = knowhere::ThreadPool::GetGlobalBuildThreadPool();
+  std::future<void> reading = std::async(std::launch::async, read_block, 0);
+  std::future<void> writing;
   for (size_t block = 0; block < num_blocks; block++) {
-    size_t start_id = block * block_size;
-    size_t end_id = (std::min)((block + 1) * block_size, num_points);
-    size_t cur_blk_size = end_id - start_id;
-
-    base_reader.read((char *) (block_data_T.get()),
-                     sizeof(T) * (cur_blk_size * dim));
-    diskann::convert_types<T, float>(block_data_T.get(), block_data_float.get(),
-                                     cur_blk_size, dim);
+    reading.get();
+    // the buffers of the next block are the ones of the previous block
+    if (writing.valid()) {
+      writing.get();
+    }
+    if (block + 1 < num_blocks) {
+      reading = std::async(std::launch::async, read_block, block + 1);
+    }
 
-    LOG_KNOWHERE_DEBUG_ << "Processing points  [" << start_id << ", " << end_id
-                        << ")..";
-    auto num_threads = thread_pool->size();
-    futures.reserve(num_threads);
-    auto batch_size = DIV_ROUND_UP(cur_blk_size, num_threads);
+    size_t start_id = block * block_size;
+    size_t cur_blk_size = block_rows(block);
+    LOG_KNOWHERE_DEBUG_ << "Processing points  [" << start_id << ", "
+                        << start_id + cur_blk_size << ")..";
+    const T *data = block_data[block % 2].get();
+    _u32    *codes = block_codes[block % 2].data();
+    auto     batch_size = DIV_ROUND_UP(cur_blk_size, thread_pool->size());
+    std::vector<folly::Future<folly::Unit>> futures;
     for (uint64_t p = 0; p < cur_blk_size; p += batch_size) {
       futures.emplace_back(thread_pool->push(
           [&, batch_beg_id = p,
            batch_end_id = std::min(p + batch_size, cur_blk_size)]() {
-            std::vector<float> block_data_tmp(dim);
-            for (auto index = batch_beg_id; index < batch_end_id; index++) {
+            std::vector<float> vec(dim);
+            std::vector<float> ips(num_centers);
+            std::vector<float> tmp(num_centers);
+            for (auto j = batch_beg_id; j < batch_end_id; j++) {
+              // centered, with the dimensions in the order of the chunks
               for (uint64_t d = 0; d < dim; d++) {
-                block_data_float[index * dim + d] -= centroid[d];
+                vec[d] = (float) data[j * dim + rearrangement[d]] -
+                         centroid[rearrangement[d]];
               }
-              for (uint64_t d = 0; d < dim; d++) {
-                block_data_tmp[d] =
-                    block_data_float[index * dim + rearrangement[d]];
-              }
-              for (uint64_t d = 0; d < dim; d++) {
-                block_data_float[index * dim + d] = block_data_tmp[d];
+              for (size_t i = 0; i < num_pq_chunks; i++) {
+                size_t chunk_size = chunk_offsets[i + 1] - chunk_offsets[i];
+                if (chunk_size == 0) {
+                  codes[j * num_pq_chunks + i] = 0;
+                  continue;
+                }
+                faiss::fvec_inner_products_ny(
+                    ips.data(), vec.data() + chunk_offsets[i],
+                    chunk_pivots[i].data(), chunk_size, num_centers);
+                codes[j * num_pq_chunks + i] = faiss::fvec_madd_and_argmin(
+                    num_centers, chunk_norms[i].data(), -2.0f, ips.data(),
+                    tmp.data());
               }
             }
           }));
     }
-
-    futures.clear();
-    futures.reserve(num_pq_chunks);
-    for (size_t i = 0; i < num_pq_chunks; i++) {
-      size_t cur_chunk_size = chunk_offsets[i + 1] - chunk_offsets[i];
-      if (cur_chunk_size == 0)
-        continue;
-      futures.emplace_back(thread_pool->push([&, chunk_size = cur_chunk_size,
-                                           chunk_index = i]() {
-        std::unique_ptr<float[]> cur_pivot_data =
-            std::make_unique<float[]>(num_centers * chunk_size);
-        std::unique_ptr<float[]> cur_data =
-            std::make_unique<float[]>(cur_blk_size * chunk_size);
-        std::unique_ptr<uint32_t[]> closest_center =
-            std::make_unique<uint32_t[]>(cur_blk_size);
-
-        for (int64_t j = 0; j < (_s64) cur_blk_size; j++) {
-          for (uint64_t k = 0; k < chunk_size; k++)
-            cur_data[j * chunk_size + k] =
-                block_data_float[j * dim + chunk_offsets[chunk_index] + k];
-        }
-
-        for (int64_t j = 0; j < (_s64) num_centers; j++) {
-          std::memcpy(
-              cur_pivot_data.get() + j * chunk_size,
-              full_pivot_data.get() + j * dim + chunk_offsets[chunk_index],
-              chunk_size * sizeof(float));
-        }
-
-        math_utils::elkan_L2(cur_data.get(), cur_pivot_data.get(), chunk_size,
-                             cur_blk_size, num_centers, closest_center.get());
-
-        for (int64_t j = 0; j < (_s64) cur_blk_size; j++) {
-          block_compressed_base[j * num_pq_chunks + chunk_index] =
-              closest_center[j];
-#ifdef SAVE_INFLATED_PQ
-          for (uint64_t k = 0; k < chunk_size; k++)
-            block_inflated_base[j * dim + chunk_offsets[chunk_index] + k] =
-                cur_pivot_data[closest_center[j] * chunk_size + k] +
-                centroid[chunk_offsets[chunk_index] + k];
-#endif
-        }
-      }));
-    }
     for (auto &future : futures) {
       future.wait();
     }
-
-    if (num_centers > 256) {
-      compressed_file_writer.write(
-          (char *) (block_compressed_base.get()),
-          cur_blk_size * num_pq_chunks * sizeof(uint32_t));
-    } else {
-      std::unique_ptr<uint8_t[]> pVec =
-          std::make_unique<uint8_t[]>(cur_blk_size * num_pq_chunks);
-      diskann::convert_types<uint32_t, uint8_t>(
-          block_compressed_base.get(), pVec.get(), cur_blk_size, num_pq_chunks);
-      compressed_file_writer.write(
-          (char *) (pVec.get()),
-          cur_blk_size * num_pq_chunks * sizeof(uint8_t));
-    }
-#ifdef SAVE_INFLATED_PQ
-    inflated_file_writer.write((char *) (block_inflated_base.get()),
-                               cur_blk_size * dim * sizeof(float));
-#endif
-    // diskann::cout << ".done." << std::endl;
+    writing = std::async(std::launch::async, write_block, block);
+  }
+  if (writing.valid()) {
+    writing.get();
   }
 // Gopal. Splitting diskann_dll into separate DLLs for search and build.
 // This code should only be available in the "build" DLL.
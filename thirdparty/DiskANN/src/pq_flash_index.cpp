@@ -8,6 +8,7 @@
 #include "diskann/percentile_stats.h"
 
 #include <omp.h>
+#include <algorithm>
 #include <atomic>
 #include <chrono>
 #include <cmath>
@@ -23,6 +24,9 @@
 #include "diskann/aux_utils.h"
 #include "diskann/timer.h"
 #include "diskann/utils.h"
+#include "knowhere/comp/cancellation.h"
+#include "knowhere/comp/payload_allocator.h"
+#include "knowhere/comp/profile_zone.h"
 #include "knowhere/heap.h"
 
 #include "knowhere/utils.h"
@@ -56,7 +60,16 @@
 namespace {
   constexpr size_t kReadBatchSize = 32;
   constexpr _u64 kRefineBeamWidthFactor = 2;
+  // an adaptive beam starts this many times wider than beam_width, and the
+  // search stops once the top k of its candidates did not change for
+  // kAdaptiveStableRounds rounds
+  constexpr _u64 kAdaptiveBeamWidthFactor = 2;
+  constexpr _u64 kAdaptiveStableRounds = 3;
   constexpr _u64 kBruteForceTopkRefineExpansionFactor = 2;
+  // the points of the navigation graph a search starts from, and the list
+  // size of the search of the graph for them
+  constexpr _u64     kNavEntryPoints = 4;
+  constexpr unsigned kNavSearchListSize = 32;
   auto           calcFilterThreshold = [](const auto topk) -> const float {
     return std::max(-0.04570166137874405f * log2(topk + 58.96422392240403) +
                                   1.1982775974217197,
@@ -88,9 +101,15 @@ namespace diskann {
 
   template<typename T>
   PQFlashIndex<T>::~PQFlashIndex() {
+    {
+      std::scoped_lock lk(dynamic_cache_mtx);
+      if (dynamic_cache_refresh.has_value()) {
+        dynamic_cache_refresh->wait();
+      }
+    }
 #ifndef EXEC_ENV_OLS
-    if (data != nullptr) {
-      delete[] data;
+    if (data != nullptr && data_mapper == nullptr) {
+      knowhere::PayloadAllocator::Free(data);
     }
 #endif
 
@@ -102,7 +121,7 @@ namespace diskann {
     // delete backing bufs for nhood and coord cache
     if (nhood_cache_buf != nullptr) {
       delete[] nhood_cache_buf;
-      diskann::aligned_free(coord_cache_buf);
+      knowhere::PayloadAllocator::Free(coord_cache_buf);
     }
     if (base_norms != nullptr) {
       delete[] base_norms;
@@ -114,40 +133,57 @@ namespace diskann {
     }
   }
 
+  template<typename T>
+  ThreadData<T> PQFlashIndex<T>::alloc_thread_data() {
+    QueryScratch<T> scratch;
+    _u64 coord_alloc_size = ROUND_UP(sizeof(T) * this->aligned_dim, 256);
+    diskann::alloc_aligned((void **) &scratch.coord_scratch, coord_alloc_size,
+                           256);
+    diskann::alloc_aligned(
+        (void **) &scratch.aligned_pq_coord_scratch,
+        (_u64) MAX_GRAPH_DEGREE * (_u64) this->aligned_dim * sizeof(_u8), 256);
+    diskann::alloc_aligned((void **) &scratch.aligned_pqtable_dist_scratch,
+                           256 * (_u64) this->aligned_dim * sizeof(float), 256);
+    diskann::alloc_aligned((void **) &scratch.aligned_dist_scratch,
+                           (_u64) MAX_GRAPH_DEGREE * sizeof(float), 256);
+    diskann::alloc_aligned((void **) &scratch.nbrs_scratch,
+                           (_u64) MAX_GRAPH_DEGREE * sizeof(unsigned), 256);
+    diskann::alloc_aligned((void **) &scratch.aligned_query_T,
+                           this->aligned_dim * sizeof(T), 8 * sizeof(T));
+    diskann::alloc_aligned((void **) &scratch.aligned_query_float,
+                           this->aligned_dim * sizeof(float),
+                           8 * sizeof(float));
+    scratch.visited = new tsl::robin_set<_u64>(4096);
+
+    memset(scratch.coord_scratch, 0, sizeof(T) * this->aligned_dim);
+    memset(scratch.aligned_query_T, 0, this->aligned_dim * sizeof(T));
+    memset(scratch.aligned_query_float, 0, this->aligned_dim * sizeof(float));
+
+    ThreadData<T> data;
+    data.scratch = scratch;
+    return data;
+  }
+
+  template<typename T>
+  void PQFlashIndex<T>::free_thread_data(ThreadData<T> &data) {
+    auto &scratch = data.scratch;
+    diskann::aligned_free((void *) scratch.coord_scratch);
+    diskann::aligned_free((void *) scratch.aligned_pq_coord_scratch);
+    diskann::aligned_free((void *) scratch.aligned_pqtable_dist_scratch);
+    diskann::aligned_free((void *) scratch.aligned_dist_scratch);
+    diskann::aligned_free((void *) scratch.nbrs_scratch);
+    diskann::aligned_free((void *) scratch.aligned_query_float);
+    diskann::aligned_free((void *) scratch.aligned_query_T);
+
+    delete scratch.visited;
+  }
+
   template<typename T>
   void PQFlashIndex<T>::setup_thread_data(_u64 nthreads) {
     LOG(INFO) << "Setting up thread-specific contexts for nthreads: "
               << nthreads;
     for (_s64 thread = 0; thread < (_s64) nthreads; thread++) {
-      QueryScratch<T> scratch;
-      _u64 coord_alloc_size = ROUND_UP(sizeof(T) * this->aligned_dim, 256);
-      diskann::alloc_aligned((void **) &scratch.coord_scratch, coord_alloc_size,
-                             256);
-      diskann::alloc_aligned((void **) &scratch.sector_scratch,
-                             (_u64) MAX_N_SECTOR_READS * read_len_for_node,
-                             SECTOR_LEN);
-      diskann::alloc_aligned(
-          (void **) &scratch.aligned_pq_coord_scratch,
-          (_u64) MAX_GRAPH_DEGREE * (_u64) this->aligned_dim * sizeof(_u8),
-          256);
-      diskann::alloc_aligned((void **) &scratch.aligned_pqtable_dist_scratch,
-                             256 * (_u64) this->aligned_dim * sizeof(float),
-                             256);
-      diskann::alloc_aligned((void **) &scratch.aligned_dist_scratch,
-                             (_u64) MAX_GRAPH_DEGREE * sizeof(float), 256);
-      diskann::alloc_aligned((void **) &scratch.aligned_query_T,
-                             this->aligned_dim * sizeof(T), 8 * sizeof(T));
-      diskann::alloc_aligned((void **) &scratch.aligned_query_float,
-                             this->aligned_dim * sizeof(float),
-                             8 * sizeof(float));
-      scratch.visited = new tsl::robin_set<_u64>(4096);
-
-      memset(scratch.coord_scratch, 0, sizeof(T) * this->aligned_dim);
-      memset(scratch.aligned_query_T, 0, this->aligned_dim * sizeof(T));
-      memset(scratch.aligned_query_float, 0, this->aligned_dim * sizeof(float));
-
-      ThreadData<T> data;
-      data.scratch = scratch;
+      ThreadData<T> data = alloc_thread_data();
       this->thread_data.push(data);
     }
     load_flag = true;
@@ -157,22 +193,20 @@ namespace diskann {
   void PQFlashIndex<T>::destroy_thread_data() {
     LOG_KNOWHERE_DEBUG_ << "Clearing scratch";
     assert(this->thread_data.size() == this->max_nthreads);
+    this->reader->register_buffers({});
     while (this->thread_data.size() > 0) {
       ThreadData<T> data = this->thread_data.pop();
-      while (data.scratch.sector_scratch == nullptr) {
+      while (data.scratch.coord_scratch == nullptr) {
         this->thread_data.wait_for_push_notify();
         data = this->thread_data.pop();
       }
-      auto &scratch = data.scratch;
-      diskann::aligned_free((void *) scratch.coord_scratch);
-      diskann::aligned_free((void *) scratch.sector_scratch);
-      diskann::aligned_free((void *) scratch.aligned_pq_coord_scratch);
-      diskann::aligned_free((void *) scratch.aligned_pqtable_dist_scratch);
-      diskann::aligned_free((void *) scratch.aligned_dist_scratch);
-      diskann::aligned_free((void *) scratch.aligned_query_float);
-      diskann::aligned_free((void *) scratch.aligned_query_T);
-
-      delete scratch.visited;
+      free_thread_data(data);
+    }
+    // no interleaved search runs any more, all of their scratch is back
+    for (ThreadData<T> data = this->interleave_data.pop();
+         data.scratch.coord_scratch != nullptr;
+         data = this->interleave_data.pop()) {
+      free_thread_data(data);
     }
   }
 
@@ -188,8 +222,8 @@ namespace diskann {
     memset(nhood_cache_buf, 0, num_cached_nodes * (max_degree + 1));
 
     _u64 coord_cache_buf_len = num_cached_nodes * aligned_dim;
-    diskann::alloc_aligned((void **) &coord_cache_buf,
-                           coord_cache_buf_len * sizeof(T), 8 * sizeof(T));
+    coord_cache_buf = (T *) knowhere::PayloadAllocator::Allocate(
+        coord_cache_buf_len * sizeof(T), 8 * sizeof(T));
     memset(coord_cache_buf, 0, coord_cache_buf_len * sizeof(T));
 
     size_t BLOCK_SIZE = 32;
@@ -229,25 +263,176 @@ namespace diskann {
         memcpy(cached_coords, node_coords, disk_bytes_per_point);
         coord_cache.insert(std::make_pair(nhood.first, cached_coords));
 
-        // insert node nhood into nhood_cache
-        unsigned *node_nhood = OFFSET_TO_NODE_NHOOD(node_buf);
-
-        auto                        nnbrs = *node_nhood;
-        unsigned                   *nbrs = node_nhood + 1;
+        // insert node nhood into nhood_cache, encoded lists are decoded
+        // right into it
         std::pair<_u32, unsigned *> cnhood;
-        cnhood.first = nnbrs;
         cnhood.second = nhood_cache_buf + node_idx * (max_degree + 1);
-        memcpy(cnhood.second, nbrs, nnbrs * sizeof(unsigned));
+        _u64      nnbrs;
+        unsigned *nbrs = get_node_nbrs(node_buf, nnbrs, cnhood.second);
+        cnhood.first = nnbrs;
+        if (nbrs != cnhood.second) {
+          memcpy(cnhood.second, nbrs, nnbrs * sizeof(unsigned));
+        }
         nhood_cache.insert(std::make_pair(nhood.first, cnhood));
         aligned_free(nhood.second);
         node_idx++;
       }
     }
     this->reader->put_ctx(ctx);
+    node_cache_loaded.store(true, std::memory_order_release);
     LOG_KNOWHERE_DEBUG_ << "done.";
   }
 
+  template<typename T>
+  void PQFlashIndex<T>::load_nav_graph(const std::string &nav_file) {
+    std::ifstream reader(nav_file, std::ios::binary);
+    reader.exceptions(std::ios::failbit | std::ios::badbit);
+    _u32 header[4];
+    reader.read((char *) header, sizeof(header));
+    if (header[1] != data_dim) {
+      std::stringstream stream;
+      stream << "Navigation graph of dim " << header[1] << " for an index of "
+             << "dim " << data_dim;
+      throw diskann::ANNException(stream.str(), -1);
+    }
+    nav_ids.resize(header[0]);
+    nav_data.resize((_u64) header[0] * header[1]);
+    nav_graph.resize((_u64) header[0] * (header[2] + 1));
+    reader.read((char *) nav_ids.data(), nav_ids.size() * sizeof(_u32));
+    reader.read((char *) nav_data.data(), nav_data.size() * sizeof(float));
+    reader.read((char *) nav_graph.data(), nav_graph.size() * sizeof(_u32));
+    nav_npts = header[0];
+    nav_degree = header[2];
+    nav_entry = header[3];
+    LOG_KNOWHERE_INFO_ << "Loaded the navigation graph of " << nav_npts
+                       << " points.";
+  }
+
+  template<typename T>
+  void PQFlashIndex<T>::nav_graph_search(const float *query, unsigned n,
+                                         unsigned l,
+                                         std::vector<unsigned> &ids) const {
+    // the graph is over the vectors of the index as searched, that is L2 on
+    // the transformed ones for inner product and on the normalized ones for
+    // cosine
+    auto dist = [&](_u32 i) {
+      return faiss::fvec_L2sqr(query, nav_data.data() + (_u64) i * data_dim,
+                               data_dim);
+    };
+    l = std::max(l, n);
+    std::vector<Neighbor>    list;
+    tsl::robin_set<unsigned> visited;
+    list.reserve(l + 1);
+    list.emplace_back(nav_entry, dist(nav_entry), true);
+    visited.insert(nav_entry);
+    size_t k = 0;
+    while (k < list.size()) {
+      auto cur = list[k].id;
+      list[k].flag = false;
+      size_t      nk = list.size();
+      const _u32 *nhood = nav_graph.data() + (_u64) cur * (nav_degree + 1);
+      for (_u32 j = 0; j < nhood[0]; j++) {
+        auto nbr = nhood[1 + j];
+        if (!visited.insert(nbr).second) {
+          continue;
+        }
+        Neighbor nn(nbr, dist(nbr), true);
+        if (list.size() == l && !(nn < list.back())) {
+          continue;
+        }
+        auto pos = std::upper_bound(list.begin(), list.end(), nn);
+        nk = std::min<size_t>(nk, pos - list.begin());
+        list.insert(pos, nn);
+        if (list.size() > l) {
+          list.pop_back();
+        }
+      }
+      k = nk <= k ? nk : k + 1;
+      while (k < list.size() && !list[k].flag) {
+        k++;
+      }
+    }
+    ids.clear();
+    for (size_t i = 0; i < std::min<size_t>(n, list.size()); i++) {
+      ids.push_back(nav_ids[list[i].id]);
+    }
+  }
+
+  template<typename T>
+  void PQFlashIndex<T>::enable_dynamic_cache(_u64 num_nodes_to_cache,
+                                             _u64 refresh_interval) {
+    const _u64 capacity = num_nodes_to_cache / 2;
+    if (capacity == 0) {
+      LOG(WARNING) << "Cache budget too small for the dynamic cache.";
+      return;
+    }
+    LOG_KNOWHERE_DEBUG_ << "Caching up to " << capacity
+                        << " nodes from the search traffic, refreshed every "
+                        << refresh_interval << " searches";
+    dynamic_cache = std::make_unique<DynamicNodeCache>(
+        capacity, max_node_len, refresh_interval);
+  }
+
+  template<typename T>
+  void PQFlashIndex<T>::refresh_dynamic_cache() {
+    auto ids = dynamic_cache->select();
+    auto cur = dynamic_cache->table();
+    auto next = std::make_shared<DynamicNodeCache::Table>();
+    next->record_len = max_node_len;
+    next->records.resize(ids.size() * max_node_len);
+    next->slots.reserve(ids.size());
+    std::vector<_u32> to_read;
+    for (_u32 slot = 0; slot < ids.size(); slot++) {
+      next->slots.emplace(ids[slot], slot);
+      if (auto record = cur->find(ids[slot]); record != nullptr) {
+        memcpy(next->records.data() + (_u64) slot * max_node_len, record,
+               max_node_len);
+      } else {
+        to_read.push_back(slot);
+      }
+    }
+    next->ids = std::move(ids);
+
+    char *buf = nullptr;
+    alloc_aligned((void **) &buf, kReadBatchSize * read_len_for_node,
+                  SECTOR_LEN);
+    auto ctx = this->reader->get_ctx();
+    bool ok = true;
+    try {
+      std::vector<AlignedRead> read_reqs;
+      for (_u64 start = 0; start < to_read.size(); start += kReadBatchSize) {
+        const _u64 end = std::min(to_read.size(), start + kReadBatchSize);
+        read_reqs.clear();
+        for (_u64 i = start; i < end; i++) {
+          read_reqs.emplace_back(
+              get_node_sector_offset(next->ids[to_read[i]]), read_len_for_node,
+              buf + (i - start) * read_len_for_node);
+        }
+        reader->read(read_reqs, ctx);
+        for (_u64 i = start; i < end; i++) {
+          auto slot = to_read[i];
+          memcpy(next->records.data() + (_u64) slot * max_node_len,
+                 get_offset_to_node(buf + (i - start) * read_len_for_node,
+                                    next->ids[slot]),
+                 max_node_len);
+        }
+      }
+    } catch (const std::exception &e) {
+      LOG(ERROR) << "Failed to refresh the dynamic cache: " << e.what();
+      ok = false;
+    }
+    this->reader->put_ctx(ctx);
+    aligned_free(buf);
+
+    if (ok) {
+      dynamic_cache->install(std::move(next));
+    } else {
+      dynamic_cache->abort_refresh();
+    }
+  }
+
 #ifdef EXEC_ENV_OLS
+
   template<typename T>
   void PQFlashIndex<T>::generate_cache_list_from_sample_queries(
       MemoryMappedFiles &files, std::string sample_bin, _u64 l_search,
@@ -331,7 +516,7 @@ namespace diskann {
 
     // borrow thread data
     ThreadData<T> this_thread_data = this->thread_data.pop();
-    while (this_thread_data.scratch.sector_scratch == nullptr) {
+    while (this_thread_data.scratch.coord_scratch == nullptr) {
       this->thread_data.wait_for_push_notify();
       this_thread_data = this->thread_data.pop();
     }
@@ -406,9 +591,9 @@ namespace diskann {
 
           // insert node coord into coord_cache
           char     *node_buf = get_offset_to_node(nhood.second, nhood.first);
-          unsigned *node_nhood = OFFSET_TO_NODE_NHOOD(node_buf);
-          _u64      nnbrs = (_u64) *node_nhood;
-          unsigned *nbrs = node_nhood + 1;
+          _u64      nnbrs;
+          unsigned *nbrs = get_node_nbrs(
+              node_buf, nnbrs, this_thread_data.scratch.nbrs_scratch);
           // explore next level
           for (_u64 j = 0; j < nnbrs && !finish_flag; j++) {
             if (std::find(node_list.begin(), node_list.end(), nbrs[j]) ==
@@ -462,15 +647,16 @@ namespace diskann {
     std::memset(centroid_data, 0, num_medoids * aligned_dim * sizeof(float));
 
     ThreadData<T> data = this->thread_data.pop();
-    while (data.scratch.sector_scratch == nullptr) {
+    while (data.scratch.coord_scratch == nullptr) {
       this->thread_data.wait_for_push_notify();
       data = this->thread_data.pop();
     }
+    auto sector_buf = borrow_sector_scratch();
     auto ctx = this->reader->get_ctx();
     // borrow buf
     auto scratch = &(data.scratch);
     scratch->reset();
-    char *sector_scratch = scratch->sector_scratch;
+    char *sector_scratch = sector_buf.get();
     T    *medoid_coords = scratch->coord_scratch;
 
     LOG(INFO) << "Loading centroid data from medoids vector data of "
@@ -491,7 +677,10 @@ namespace diskann {
       T *medoid_disk_coords = OFFSET_TO_NODE_COORDS(medoid_node_buf);
       memcpy(medoid_coords, medoid_disk_coords, disk_bytes_per_point);
 
-      if (!use_disk_index_pq) {
+      if (use_disk_index_sq) {
+        disk_sq_table.decode((_u8 *) medoid_coords,
+                             centroid_data + cur_m * aligned_dim);
+      } else if (!use_disk_index_pq) {
         for (uint32_t i = 0; i < data_dim; i++) {
           centroid_data[cur_m * aligned_dim + i] = medoid_coords[i];
         }
@@ -513,7 +702,8 @@ namespace diskann {
                             const char *index_prefix) {
 #else
   template<typename T>
-  int PQFlashIndex<T>::load(uint32_t num_threads, const char *index_prefix) {
+  int PQFlashIndex<T>::load(uint32_t num_threads, const char *index_prefix,
+                            bool mmap_pq_data) {
 #endif
     std::string pq_table_bin =
         get_pq_pivots_filename(std::string(index_prefix));
@@ -547,14 +737,53 @@ namespace diskann {
     // inner product without PQ
     this->disk_bytes_per_point = this->data_dim * sizeof(T);
     this->aligned_dim = ROUND_UP(pq_file_dim, 8);
+    // the full precision distances are over aligned_dim or data_dim floats,
+    // when they agree the L2 kernel unrolled for that dim serves them all
+    // (inner product is searched as L2 over the transformed data)
+    if constexpr (std::is_same_v<T, float>) {
+      if (metric != diskann::Metric::COSINE &&
+          this->aligned_dim == this->data_dim) {
+        this->dist_cmp = faiss::fvec_L2sqr_for_dim(this->aligned_dim);
+        this->dist_cmp_float = this->dist_cmp;
+      }
+    }
 
     size_t npts_u64, nchunks_u64;
 #ifdef EXEC_ENV_OLS
     diskann::load_bin<_u8>(files, pq_compressed_vectors, this->data, npts_u64,
                            nchunks_u64);
 #else
-    diskann::load_bin<_u8>(pq_compressed_vectors, this->data, npts_u64,
-                           nchunks_u64);
+    if (mmap_pq_data && file_exists(pq_compressed_vectors)) {
+      get_bin_metadata(pq_compressed_vectors, npts_u64, nchunks_u64);
+      data_mapper = std::make_unique<MemoryMapper>(pq_compressed_vectors);
+      const size_t expected_size = 2 * sizeof(_u32) + npts_u64 * nchunks_u64;
+      if (data_mapper->getBuf() == MAP_FAILED ||
+          data_mapper->getFileSize() != expected_size) {
+        LOG(ERROR) << "Failed to map " << pq_compressed_vectors
+                   << " of size " << expected_size;
+        return -1;
+      }
+      // page the codes in ahead of the searches, in the background
+      madvise(data_mapper->getBuf(), expected_size, MADV_WILLNEED);
+      this->data = (_u8 *) data_mapper->getBuf() + 2 * sizeof(_u32);
+    } else {
+      // the codes are read at random by every search, on huge pages if any
+      get_bin_metadata(pq_compressed_vectors, npts_u64, nchunks_u64);
+      this->data = (_u8 *) knowhere::PayloadAllocator::Allocate(
+          npts_u64 * nchunks_u64);
+      if (this->data == nullptr) {
+        LOG(ERROR) << "Failed to allocate the codes of "
+                   << pq_compressed_vectors;
+        return -1;
+      }
+      std::ifstream reader(pq_compressed_vectors, std::ios::binary);
+      reader.seekg(2 * sizeof(_u32));
+      reader.read((char *) this->data, npts_u64 * nchunks_u64);
+      if (!reader) {
+        LOG(ERROR) << "Failed to read " << pq_compressed_vectors;
+        return -1;
+      }
+    }
 #endif
 
     this->num_points = npts_u64;
@@ -591,6 +820,23 @@ namespace diskann {
                 << disk_pq_n_chunks << " bytes per point." << std::endl;
     }
 
+#ifndef EXEC_ENV_OLS
+    std::string disk_sq_table_path =
+        get_disk_index_sq_table_file(this->disk_index_file);
+    if (file_exists(disk_sq_table_path)) {
+      disk_sq_table.load(disk_sq_table_path);
+      if (disk_sq_table.dim() != data_dim) {
+        LOG(ERROR) << "Mismatch in #dims for disk sq table and disk index: "
+                   << disk_sq_table.dim() << " vs " << data_dim;
+        return -1;
+      }
+      use_disk_index_sq = true;
+      disk_bytes_per_point = disk_sq_table.code_size();
+      LOG(INFO) << "Disk index uses SQ data compressed down to "
+                << disk_bytes_per_point << " bytes per point.";
+    }
+#endif
+
 // read index metadata
 #ifdef EXEC_ENV_OLS
     // This is a bit tricky. We have to read the header from the
@@ -639,17 +885,6 @@ namespace diskann {
       read_len_for_node = SECTOR_LEN * nsectors_per_node;
     }
 
-    max_degree = ((max_node_len - disk_bytes_per_point) / sizeof(unsigned)) - 1;
-
-    if (max_degree > MAX_GRAPH_DEGREE) {
-      std::stringstream stream;
-      stream << "Error loading index. Ensure that max graph degree (R) does "
-                "not exceed "
-             << MAX_GRAPH_DEGREE << std::endl;
-      throw diskann::ANNException(stream.str(), -1, __FUNCSIG__, __FILE__,
-                                  __LINE__);
-    }
-
     // setting up concept of frozen points in disk index for streaming-DiskANN
     READ_U64(index_metadata, this->num_frozen_points);
     _u64 file_frozen_id;
@@ -664,19 +899,55 @@ namespace diskann {
 
     READ_U64(index_metadata, this->reorder_data_exists);
     if (this->reorder_data_exists) {
-      if (this->use_disk_index_pq == false) {
+      if (this->use_disk_index_pq == false &&
+          this->use_disk_index_sq == false) {
         throw ANNException(
-            "Reordering is designed for used with disk PQ compression option",
+            "Reordering is designed for used with disk PQ or SQ compression "
+            "option",
             -1, __FUNCSIG__, __FILE__, __LINE__);
       }
       READ_U64(index_metadata, this->reorder_data_start_sector);
       READ_U64(index_metadata, this->ndims_reorder_vecs);
       READ_U64(index_metadata, this->nvecs_per_sector);
+    } else if (this->use_disk_index_sq) {
+      LOG(ERROR) << "Disk index with SQ data has no full precision vectors "
+                    "to rerank with";
+      return -1;
+    } else {
+      _u64 unused;
+      for (int i = 0; i < 3; i++) {
+        READ_U64(index_metadata, unused);
+      }
+    }
+
+    // the codec of the adjacency lists, none for the indexes written before
+    // there were codecs, whose metadata is zero past the reorder data
+    _u64 codec, file_max_degree;
+    READ_U64(index_metadata, codec);
+    READ_U64(index_metadata, file_max_degree);
+    if (codec > (_u64) GraphCodec::DELTA) {
+      LOG(ERROR) << "Unknown adjacency list codec " << codec;
+      return -1;
+    }
+    graph_codec = (GraphCodec) codec;
+    max_degree =
+        graph_codec == GraphCodec::NONE
+            ? ((max_node_len - disk_bytes_per_point) / sizeof(unsigned)) - 1
+            : file_max_degree;
+
+    if (max_degree > MAX_GRAPH_DEGREE) {
+      std::stringstream stream;
+      stream << "Error loading index. Ensure that max graph degree (R) does "
+                "not exceed "
+             << MAX_GRAPH_DEGREE << std::endl;
+      throw diskann::ANNException(stream.str(), -1, __FUNCSIG__, __FILE__,
+                                  __LINE__);
     }
     LOG(INFO) << "Disk-Index File Meta-data: "
               << "# nodes per sector: " << nnodes_per_sector
               << ", max node len (bytes): " << max_node_len
-              << ", max node degree: " << max_degree;
+              << ", max node degree: " << max_degree
+              << (graph_codec == GraphCodec::DELTA ? ", delta-encoded" : "");
 
 #ifdef EXEC_ENV_OLS
     delete[] bytes;
@@ -685,6 +956,52 @@ namespace diskann {
 #endif
 
 #ifndef EXEC_ENV_OLS
+    std::string layout_file = get_disk_index_layout_file(disk_index_file);
+    if (!long_node && file_exists(layout_file)) {
+      size_t layout_num, layout_dim;
+      std::unique_ptr<_u32[]> locs;
+      diskann::load_bin<_u32>(layout_file, locs, layout_num, layout_dim);
+      if (layout_num != num_points || layout_dim != 1) {
+        LOG(ERROR) << "Mismatch in #points for disk index layout file and disk "
+                      "index file: "
+                   << layout_num << " vs " << num_points;
+        return -1;
+      }
+      node_locs.assign(locs.get(), locs.get() + num_points);
+      loc_nodes.resize(num_points);
+      for (_u64 id = 0; id < num_points; id++) {
+        if (node_locs[id] >= num_points) {
+          LOG(ERROR) << "Node " << id << " laid out at " << node_locs[id]
+                     << " past the " << num_points << " nodes";
+          return -1;
+        }
+        loc_nodes[node_locs[id]] = id;
+      }
+      LOG(INFO) << "Nodes laid out by graph neighborhood.";
+    }
+
+    std::string labels_file = get_disk_index_labels_file(disk_index_file);
+    std::string label_medoids_file =
+        get_disk_index_label_medoids_file(disk_index_file);
+    if (file_exists(labels_file) && file_exists(label_medoids_file)) {
+      size_t                  labels_num, labels_dim, medoids_num, medoids_dim;
+      std::unique_ptr<_u32[]> labels, pairs;
+      diskann::load_bin<_u32>(labels_file, labels, labels_num, labels_dim);
+      diskann::load_bin<_u32>(label_medoids_file, pairs, medoids_num,
+                              medoids_dim);
+      if (labels_num != num_points || labels_dim != 1 || medoids_dim != 2) {
+        LOG(ERROR) << "Mismatch in #points for labels file and disk index "
+                      "file: "
+                   << labels_num << " vs " << num_points;
+        return -1;
+      }
+      node_labels.assign(labels.get(), labels.get() + num_points);
+      for (_u64 i = 0; i < medoids_num; i++) {
+        label_medoids[pairs[2 * i]] = pairs[2 * i + 1];
+      }
+      LOG(INFO) << "Loaded the labels of " << medoids_num << " label graphs.";
+    }
+
     // open AlignedFileReader handle to index_file
     std::string index_fname(disk_index_file);
     reader->open(index_fname);
@@ -833,7 +1150,7 @@ namespace diskann {
   void PQFlashIndex<T>::brute_force_beam_search(
       ThreadData<T> &data, const float query_norm, const _u64 k_search,
       _s64 *indices, float *distances, const _u64 beam_width_param,
-      IOContext &ctx, QueryStats *stats,
+      IOContext &ctx, char *sector_scratch, QueryStats *stats,
       const knowhere::feder::diskann::FederResultUniq &feder,
       knowhere::BitsetView                             bitset_view) {
     auto         query_scratch = &(data.scratch);
@@ -853,8 +1170,9 @@ namespace diskann {
     std::unordered_map<_u64, std::vector<_u64>> nodes_in_sectors_to_visit;
     std::vector<AlignedRead>                    frontier_read_reqs;
     frontier_read_reqs.reserve(beam_width);
-    char *sector_scratch = query_scratch->sector_scratch;
     _u64 &sector_scratch_idx = query_scratch->sector_idx;
+    const bool use_node_cache =
+        node_cache_loaded.load(std::memory_order_acquire);
     knowhere::ResultMaxHeap<float, _u64> max_heap(k_search);
     Timer                                io_timer, query_timer;
 
@@ -881,8 +1199,9 @@ namespace diskann {
     while (const auto opt = pq_max_heap.Pop()) {
       const auto [dist, id] = opt.value();
 
-      // check if in cache
-      if (coord_cache.find(id) != coord_cache.end()) {
+      // check if in cache, which holds the quantized vectors with disk sq
+      if (use_node_cache && !use_disk_index_sq &&
+          coord_cache.find(id) != coord_cache.end()) {
         float dist =
             dist_cmp_wrap(query, coord_cache.at(id), (size_t) aligned_dim, id);
         max_heap.Push(dist, id);
@@ -890,7 +1209,7 @@ namespace diskann {
       }
 
       // deduplicate and prepare for I/O
-      const _u64 sector_offset = get_node_sector_offset(id);
+      const _u64 sector_offset = get_vector_sector_offset(id);
       nodes_in_sectors_to_visit[sector_offset].push_back(id);
     }
 
@@ -898,7 +1217,7 @@ namespace diskann {
          it != nodes_in_sectors_to_visit.cend();) {
       const auto sector_offset = it->first;
       frontier_read_reqs.emplace_back(
-          sector_offset, read_len_for_node,
+          sector_offset, get_vector_read_len(),
           sector_scratch + sector_scratch_idx * read_len_for_node);
       ++sector_scratch_idx, ++it;
       if (stats != nullptr) {
@@ -910,11 +1229,14 @@ namespace diskann {
       if (frontier_read_reqs.size() == beam_width ||
           it == nodes_in_sectors_to_visit.cend()) {
         io_timer.reset();
+        {
+          KNOWHERE_PROFILE_ZONE("diskann.io_wait");
 #ifdef USE_BING_INFRA
-        reader->read(frontier_read_reqs, ctx, true);  // async reader windows.
+          reader->read(frontier_read_reqs, ctx, true);  // async reader windows.
 #else
-        reader->read(frontier_read_reqs, ctx);  // synchronous IO linux
+          reader->read(frontier_read_reqs, ctx);  // synchronous IO linux
 #endif
+        }
         if (stats != nullptr) {
           stats->io_us += (double) io_timer.elapsed();
         }
@@ -924,9 +1246,11 @@ namespace diskann {
           const auto offset = req.offset;
           char      *sector_buf = reinterpret_cast<char *>(req.buf);
           for (const auto cur_id : nodes_in_sectors_to_visit[offset]) {
-            char *node_buf = get_offset_to_node(sector_buf, cur_id);
+            char *node_buf = get_offset_to_vector(sector_buf, cur_id);
+            // Do we really need memcpy here?
             memcpy(node_fp_coords_copy, node_buf,
-                   disk_bytes_per_point);  // Do we really need memcpy here?
+                   use_disk_index_sq ? data_dim * sizeof(T)
+                                     : disk_bytes_per_point);
             float dist = dist_cmp_wrap(query, node_fp_coords_copy,
                                   (size_t) aligned_dim, cur_id);
             max_heap.Push(dist, cur_id);
@@ -974,17 +1298,20 @@ namespace diskann {
   }
 
   template<typename T>
-  void PQFlashIndex<T>::cached_beam_search(
+  bool PQFlashIndex<T>::cached_beam_search(
       const T *query1, const _u64 k_search, const _u64 l_search, _s64 *indices,
       float *distances, const _u64 beam_width, const bool use_reorder_data,
       QueryStats *stats, const knowhere::feder::diskann::FederResultUniq &feder,
-      knowhere::BitsetView bitset_view, const float filter_ratio_in, const bool for_tuning) {
+      knowhere::BitsetView bitset_view, const float filter_ratio_in, const bool for_tuning,
+      const bool pipelined, const bool score_sector_nodes,
+      BeamSearchState *state, const SearchBudget *budget,
+      const _s64 filter_label, const bool adaptive_beam) {
     if (beam_width > MAX_N_SECTOR_READS)
       throw ANNException("Beamwidth can not be higher than MAX_N_SECTOR_READS",
                          -1, __FUNCSIG__, __FILE__, __LINE__);
 
     ThreadData<T> data = this->thread_data.pop();
-    while (data.scratch.sector_scratch == nullptr) {
+    while (data.scratch.coord_scratch == nullptr) {
       this->thread_data.wait_for_push_notify();
       data = this->thread_data.pop();
     }
@@ -993,11 +1320,34 @@ namespace diskann {
       // return an empty answer when calcu a zero point
       this->thread_data.push(data);
       this->thread_data.push_notify_all();
-      return;
+      return true;
     }
     float query_norm = query_norm_opt.value();
+    auto  sector_buf = borrow_sector_scratch();
     auto  ctx = this->reader->get_ctx();
 
+    // a search of a label follows its edges however many nodes the bitset
+    // filters out, and finds nothing of a label no node has
+    const bool by_label = filter_label >= 0 && !node_labels.empty();
+    auto       label_medoid = by_label ? label_medoids.find((_u32) filter_label)
+                                       : label_medoids.end();
+    auto       off_label = [&](unsigned id) {
+      return by_label && node_labels[id] != (_u32) filter_label;
+    };
+
+    if (by_label && label_medoid == label_medoids.end()) {
+      for (_u64 i = 0; i < k_search; i++) {
+        indices[i] = -1;
+        if (distances != nullptr) {
+          distances[i] = -1;
+        }
+      }
+      this->thread_data.push(data);
+      this->thread_data.push_notify_all();
+      this->reader->put_ctx(ctx);
+      return true;
+    }
+
     if (!bitset_view.empty()) {
       const auto filter_threshold =
           filter_ratio_in < 0 ? calcFilterThreshold(k_search) : filter_ratio_in;
@@ -1009,16 +1359,17 @@ namespace diskann {
             distances[i] = -1;
           }
         }
-        return;
+        return true;
       }
 
-      if (bv_cnt >= bitset_view.size() * filter_threshold) {
+      if (!by_label && bv_cnt >= bitset_view.size() * filter_threshold) {
         brute_force_beam_search(data, query_norm, k_search, indices, distances,
-                                beam_width, ctx, stats, feder, bitset_view);
+                                beam_width, ctx, sector_buf.get(), stats, feder,
+                                bitset_view);
         this->thread_data.push(data);
         this->thread_data.push_notify_all();
         this->reader->put_ctx(ctx);
-        return;
+        return true;
       }
     }
 
@@ -1030,8 +1381,10 @@ namespace diskann {
     T *data_buf = query_scratch->coord_scratch;
 
     // sector scratch
-    char *sector_scratch = query_scratch->sector_scratch;
+    char *sector_scratch = sector_buf.get();
     _u64 &sector_scratch_idx = query_scratch->sector_idx;
+    const bool use_node_cache =
+        node_cache_loaded.load(std::memory_order_acquire);
 
     Timer io_timer, query_timer;
     // cleared every iteration
@@ -1044,6 +1397,13 @@ namespace diskann {
     std::vector<std::pair<unsigned, std::pair<unsigned, unsigned *>>>
         cached_nhoods;
     cached_nhoods.reserve(2 * beam_width);
+    std::vector<std::pair<unsigned, const char *>> dyn_nhoods;
+    dyn_nhoods.reserve(2 * beam_width);
+    // the full precision distances of the cached nodes, see below
+    const bool batch_cached_dists = std::is_same_v<T, float> &&
+                                    !use_disk_index_pq && !use_disk_index_sq;
+    std::vector<uint32_t> cached_rows;
+    std::vector<float>    cached_dists;
 
     // query <-> PQ chunk centers distances
     float *pq_dists = query_scratch->aligned_pqtable_dist_scratch;
@@ -1068,62 +1428,348 @@ namespace diskann {
 
     std::vector<Neighbor> full_retset;
     full_retset.reserve(4096);
-    auto vec_hash = knowhere::hash_vec(query_float, data_dim);
-    _u32 best_medoid = 0;
-    // for tuning, do not use cache
-    if (for_tuning || !lru_cache.try_get(vec_hash, best_medoid)) {
-      float best_dist = (std::numeric_limits<float>::max)();
-      std::vector<SimpleNeighbor> medoid_dists;
-      for (_u64 cur_m = 0; cur_m < num_medoids; cur_m++) {
-        float cur_expanded_dist =
-            dist_cmp_float_wrap(query_float, centroid_data + aligned_dim * cur_m,
-                           (size_t) aligned_dim, medoids[cur_m]);
-        if (cur_expanded_dist < best_dist) {
-          best_medoid = medoids[cur_m];
-          best_dist = cur_expanded_dist;
-        }
+    tsl::robin_set<unsigned> scored;
+    auto     vec_hash = knowhere::hash_vec(query_float, data_dim);
+    unsigned cur_list_size = 0;
+    unsigned k = 0;
+    if (state != nullptr && state->started) {
+      // resume the search: the best l_search of the candidates kept enter
+      // the list, the nodes already expanded stay marked and the others are
+      // expanded from the first one on
+      visited.swap(state->visited);
+      full_retset.swap(state->full_retset);
+      scored.swap(state->scored);
+      auto &candidates = state->retset;
+      candidates.insert(candidates.end(), state->spilled.begin(),
+                        state->spilled.end());
+      std::sort(candidates.begin(), candidates.end());
+      cur_list_size = (unsigned) std::min<_u64>(candidates.size(), l_search);
+      std::copy(candidates.begin(), candidates.begin() + cur_list_size,
+                retset.begin());
+      state->spilled.assign(candidates.begin() + cur_list_size,
+                            candidates.end());
+      while (k < cur_list_size && !retset[k].flag) {
+        k++;
+      }
+    } else {
+      _u32                  best_medoid = 0;
+      std::vector<unsigned> entry_points;
+      // for tuning, do not use cache
+      if (by_label) {
+        entry_points.push_back(label_medoid->second);
+      } else if (!for_tuning && lru_cache.try_get(vec_hash, best_medoid)) {
+        entry_points.push_back(best_medoid);
+      } else {
+        pick_entry_points(query_float, l_search, entry_points);
       }
-    }
-
-    compute_dists(&best_medoid, 1, dist_scratch);
-    retset[0].id = best_medoid;
-    retset[0].flag = true;
-    retset[0].distance = dist_scratch[0];
-    visited.insert(best_medoid);
-
-    unsigned cur_list_size = 1;
 
-    std::sort(retset.begin(), retset.begin() + cur_list_size);
+      compute_dists(entry_points.data(), entry_points.size(), dist_scratch);
+      for (size_t i = 0; i < entry_points.size(); i++) {
+        retset[i] = Neighbor(entry_points[i], dist_scratch[i], true);
+        visited.insert(entry_points[i]);
+      }
+      cur_list_size = (unsigned) entry_points.size();
+      std::sort(retset.begin(), retset.begin() + cur_list_size);
+    }
 
     unsigned cmps = 0;
     unsigned hops = 0;
     unsigned num_ios = 0;
-    unsigned k = 0;
 
-    while (k < cur_list_size) {
+    // a search out of budget, or whose cancellation token is cancelled, stops
+    // expanding, its results are partial if a candidate was left to expand
+    bool partial = false;
+    auto stop_for_budget = [&]() {
+      bool out_of_budget =
+          budget != nullptr &&
+          ((budget->max_ios > 0 && num_ios >= budget->max_ios) ||
+           (budget->deadline_us > 0 &&
+            (_u64) query_timer.elapsed() >= budget->deadline_us));
+      if (!out_of_budget &&
+          !knowhere::CancellationToken::CurrentCancelled()) {
+        return false;
+      }
+      for (unsigned i = k; i < cur_list_size && !partial; i++) {
+        partial = retset[i].flag;
+      }
+      return true;
+    };
+
+    // full precision (or disk pq) distance of a node read from disk
+    auto node_dist = [&](unsigned id, T *node_fp_coords) -> float {
+      return disk_node_dist(query, query_float, node_fp_coords, id);
+    };
+
+    // with score_sector_nodes the nodes sharing a sector with an expanded one
+    // enter full_retset too, as they come for free with the read, and the
+    // graph layout puts the neighbors of a node there. Each node enters once.
+    const bool score_sector =
+        score_sector_nodes && !long_node && nnodes_per_sector > 1;
+    auto first_score = [&](unsigned id) {
+      return !score_sector || scored.insert(id).second;
+    };
+    auto score_sector_of = [&](unsigned id, char *sector_buf) {
+      if (!score_sector) {
+        return;
+      }
+      const _u64 first_loc =
+          get_node_loc(id) / nnodes_per_sector * nnodes_per_sector;
+      const _u64 last_loc =
+          std::min<_u64>(first_loc + nnodes_per_sector, num_points);
+      for (_u64 loc = first_loc; loc < last_loc; loc++) {
+        unsigned co_id = loc_nodes.empty() ? (unsigned) loc : loc_nodes[loc];
+        if ((!bitset_view.empty() && bitset_view.test(co_id)) ||
+            !first_score(co_id)) {
+          continue;
+        }
+        memcpy(data_buf, sector_buf + (loc - first_loc) * max_node_len,
+               disk_bytes_per_point);
+        full_retset.push_back(Neighbor(co_id, node_dist(co_id, data_buf), true));
+        if (stats != nullptr) {
+          stats->n_cmps++;
+        }
+      }
+    };
+
+    // inserts a visited candidate into retset, returns its position or a
+    // position past the list if it does not enter it. With a state the
+    // candidates falling off the full list are kept for a resumed search.
+    auto insert_candidate = [&](unsigned id, float dist) -> unsigned {
+      if (cur_list_size > 0 && dist >= retset[cur_list_size - 1].distance &&
+          (cur_list_size == l_search)) {
+        if (state != nullptr) {
+          state->spilled.emplace_back(id, dist, true);
+        }
+        return cur_list_size + 1;
+      }
+      Neighbor nn(id, dist, true);
+      // Return position in sorted list where nn inserted.
+      auto r = InsertIntoPool(retset.data(), cur_list_size, nn);
+      if (cur_list_size < l_search) {
+        ++cur_list_size;
+      } else if (state != nullptr && r < cur_list_size) {
+        state->spilled.push_back(retset[cur_list_size]);
+      }
+      return r;
+    };
+
+    // expands a node of a cache or read from disk, returns the best position
+    // of retset its neighbors were inserted at
+    auto expand = [&](unsigned id, T *node_fp_coords, _u64 nnbrs,
+                      unsigned *node_nbrs) {
+      unsigned best = cur_list_size;
+      if ((bitset_view.empty() || !bitset_view.test(id)) && first_score(id)) {
+        float cur_expanded_dist = node_dist(id, node_fp_coords);
+        full_retset.push_back(Neighbor(id, cur_expanded_dist, true));
+        if (feder != nullptr) {
+          feder->visit_info_.AddTopCandidateInfo(id, cur_expanded_dist);
+          feder->id_set_.insert(id);
+        }
+      }
+      cpu_timer.reset();
+      compute_dists(node_nbrs, nnbrs, dist_scratch);
+      if (stats != nullptr) {
+        stats->n_cmps += (double) nnbrs;
+      }
+      for (_u64 m = 0; m < nnbrs; ++m) {
+        unsigned nbr = node_nbrs[m];
+        if (feder != nullptr) {
+          feder->visit_info_.AddTopCandidateNeighbor(id, nbr,
+                                                     dist_scratch[m]);
+          feder->id_set_.insert(nbr);
+        }
+        if (visited.find(nbr) != visited.end() || off_label(nbr)) {
+          continue;
+        }
+        visited.insert(nbr);
+        cmps++;
+        auto r = insert_candidate(nbr, dist_scratch[m]);
+        if (r < best)
+          best = r;
+      }
+      if (stats != nullptr) {
+        stats->cpu_us += (double) cpu_timer.elapsed();
+      }
+      return best;
+    };
+
+    // dynamic cache records are laid out as on disk
+    auto dyn_table =
+        dynamic_cache != nullptr ? dynamic_cache->table() : nullptr;
+    auto expand_record = [&](unsigned id, const char *record) {
+      memcpy(data_buf, record, disk_bytes_per_point);
+      _u64      nnbrs;
+      unsigned *nbrs = get_node_nbrs((char *) record, nnbrs,
+                                     query_scratch->nbrs_scratch);
+      return expand(id, data_buf, nnbrs, nbrs);
+    };
+
+    if (pipelined) {
+      // keeps up to beam_width reads in flight, the nodes are expanded as
+      // their sectors arrive and each freed slot reads the best candidate not
+      // expanded yet, so that a slow read does not hold back the others
+      const _u64 depth = std::min<_u64>(beam_width, reader->max_events_per_ctx());
+      std::vector<char *> free_slots;
+      std::vector<unsigned> slot_ids(depth);
+      for (_u64 i = 0; i < depth; i++) {
+        free_slots.push_back(sector_scratch + i * read_len_for_node);
+      }
+      std::vector<void *> completed;
+      completed.reserve(depth);
+      _u64 n_in_flight = 0;
+
+      // the best candidate not expanded yet, none is left before k
+      auto next_candidate = [&](unsigned &id) {
+        while (k < cur_list_size) {
+          if (!retset[k].flag) {
+            k++;
+            continue;
+          }
+          id = retset[k].id;
+          retset[k].flag = false;
+          if (this->count_visited_nodes) {
+            reinterpret_cast<std::atomic<_u32> &>(
+                this->node_visit_counter[id].second)
+                .fetch_add(1);
+          }
+          if (!bitset_view.empty() && bitset_view.test(id)) {
+            std::memmove(&retset[k], &retset[k + 1],
+                         (cur_list_size - k - 1) * sizeof(Neighbor));
+            cur_list_size--;
+          } else {
+            k++;
+          }
+          return true;
+        }
+        return false;
+      };
+
+      while (true) {
+        // refill the free slots, cached nodes are expanded on the spot
+        frontier_read_reqs.clear();
+        unsigned id;
+        while (!free_slots.empty() && !partial && !stop_for_budget() &&
+               next_candidate(id)) {
+          auto iter = use_node_cache ? nhood_cache.find(id) : nhood_cache.end();
+          if (iter != nhood_cache.end()) {
+            if (stats != nullptr) {
+              stats->n_cache_hits++;
+            }
+            k = std::min(k, expand(id, coord_cache.find(id)->second,
+                                   iter->second.first, iter->second.second));
+            continue;
+          }
+          if (dyn_table != nullptr) {
+            if (auto record = dyn_table->find(id); record != nullptr) {
+              if (stats != nullptr) {
+                stats->n_cache_hits++;
+              }
+              dynamic_cache->record_access(id);
+              k = std::min(k, expand_record(id, record));
+              continue;
+            }
+            dynamic_cache->record_miss(id);
+          }
+          char *slot = free_slots.back();
+          free_slots.pop_back();
+          slot_ids[(slot - sector_scratch) / read_len_for_node] = id;
+          frontier_read_reqs.emplace_back(
+              get_node_sector_offset((size_t) id), read_len_for_node, slot);
+          if (stats != nullptr) {
+            stats->n_4k++;
+            stats->n_ios++;
+          }
+          num_ios++;
+        }
+        if (!frontier_read_reqs.empty()) {
+          reader->submit_req(ctx, frontier_read_reqs);
+          n_in_flight += frontier_read_reqs.size();
+        }
+        if (n_in_flight == 0) {
+          break;
+        }
+
+        io_timer.reset();
+        completed.clear();
+        {
+          KNOWHERE_PROFILE_ZONE("diskann.io_wait");
+          reader->get_completed_req(ctx, 1, n_in_flight, completed);
+        }
+        n_in_flight -= completed.size();
+        if (stats != nullptr) {
+          stats->io_us += (double) io_timer.elapsed();
+          stats->n_hops++;
+        }
+        for (auto buf : completed) {
+          char *slot = (char *) buf;
+          auto  node_id = slot_ids[(slot - sector_scratch) / read_len_for_node];
+          k = std::min(k, expand_record(node_id,
+                                        get_offset_to_node(slot, node_id)));
+          score_sector_of(node_id, slot);
+          free_slots.push_back(slot);
+        }
+        hops++;
+      }
+    }
+
+    // with an adaptive beam the rounds read a wide beam while the candidates
+    // far from the query improve the top k, and the beam halves down to
+    // beam_width / 2 with every round that does not
+    _u64 cur_beam_width =
+        adaptive_beam ? std::min<_u64>(beam_width * kAdaptiveBeamWidthFactor,
+                                       MAX_N_SECTOR_READS)
+                      : beam_width;
+    const _u64 min_beam_width = std::max<_u64>(1, beam_width / 2);
+    _u64       stable_rounds = 0;
+    while (!pipelined && k < cur_list_size) {
+      if (stop_for_budget()) {
+        break;
+      }
+      // the top k stable, and all expanded, the rest of the list is unlikely
+      // to change the results
+      if (adaptive_beam && stable_rounds >= kAdaptiveStableRounds &&
+          std::none_of(retset.begin(),
+                       retset.begin() + std::min<_u64>(k_search, cur_list_size),
+                       [](const Neighbor &n) { return n.flag; })) {
+        break;
+      }
       auto nk = cur_list_size;
       // clear iteration state
       frontier.clear();
       frontier_nhoods.clear();
       frontier_read_reqs.clear();
       cached_nhoods.clear();
+      dyn_nhoods.clear();
       sector_scratch_idx = 0;
       // find new beam
       _u32 marker = k;
       _u32 num_seen = 0;
-      while (marker < cur_list_size && frontier.size() < beam_width &&
-             num_seen < beam_width) {
+      while (marker < cur_list_size && frontier.size() < cur_beam_width &&
+             num_seen < cur_beam_width) {
         if (retset[marker].flag) {
           num_seen++;
-          auto iter = nhood_cache.find(retset[marker].id);
+          auto iter = use_node_cache ? nhood_cache.find(retset[marker].id)
+                                     : nhood_cache.end();
           if (iter != nhood_cache.end()) {
             cached_nhoods.push_back(
                 std::make_pair(retset[marker].id, iter->second));
             if (stats != nullptr) {
               stats->n_cache_hits++;
             }
+          } else if (auto record = dyn_table != nullptr
+                                       ? dyn_table->find(retset[marker].id)
+                                       : nullptr;
+                     record != nullptr) {
+            dyn_nhoods.emplace_back(retset[marker].id, record);
+            dynamic_cache->record_access(retset[marker].id);
+            if (stats != nullptr) {
+              stats->n_cache_hits++;
+            }
           } else {
             frontier.push_back(retset[marker].id);
+            if (dynamic_cache != nullptr) {
+              dynamic_cache->record_miss(retset[marker].id);
+            }
           }
           retset[marker].flag = false;
           if (this->count_visited_nodes) {
@@ -1164,35 +1810,60 @@ namespace diskann {
           num_ios++;
         }
         io_timer.reset();
+        {
+          KNOWHERE_PROFILE_ZONE("diskann.io_wait");
 #ifdef USE_BING_INFRA
-        reader->read(frontier_read_reqs, ctx, true);  // async reader windows.
+          reader->read(frontier_read_reqs, ctx, true);  // async reader windows.
 #else
-        reader->read(frontier_read_reqs, ctx);  // synchronous IO linux
+          reader->read(frontier_read_reqs, ctx);  // synchronous IO linux
 #endif
+        }
         if (stats != nullptr) {
           stats->io_us += (double) io_timer.elapsed();
         }
       }
 
-      // process cached nhoods
-      for (auto &cached_nhood : cached_nhoods) {
-        auto global_cache_iter = coord_cache.find(cached_nhood.first);
-        T   *node_fp_coords_copy = global_cache_iter->second;
-        if (bitset_view.empty() || !bitset_view.test(cached_nhood.first)) {
-          float cur_expanded_dist;
-          if (!use_disk_index_pq) {
-            cur_expanded_dist =
-                dist_cmp_wrap(query, node_fp_coords_copy, (size_t) aligned_dim,
-                         cached_nhood.first);
-          } else {
-            if (metric == diskann::Metric::INNER_PRODUCT ||
-                metric == diskann::Metric::COSINE)
-              cur_expanded_dist = disk_pq_table.inner_product(
-                  query_float, (_u8 *) node_fp_coords_copy);
-            else
-              cur_expanded_dist = disk_pq_table.l2_distance(
-                  query_float, (_u8 *) node_fp_coords_copy);
+      // the coords of the cached nodes are rows of coord_cache_buf, their
+      // full precision distances are computed in one batch
+      if (batch_cached_dists && cached_nhoods.size() > 1) {
+        cached_rows.clear();
+        for (auto &cached_nhood : cached_nhoods) {
+          cached_rows.push_back((uint32_t) (
+              (coord_cache.find(cached_nhood.first)->second - coord_cache_buf) /
+              aligned_dim));
+        }
+        cached_dists.resize(cached_nhoods.size());
+        if (metric == diskann::Metric::COSINE) {
+          faiss::fvec_inner_product_batch_indexed(
+              cached_dists.data(), (const float *) query,
+              (const char *) coord_cache_buf, cached_rows.data(),
+              cached_rows.size(), aligned_dim, aligned_dim * sizeof(T));
+          for (size_t i = 0; i < cached_nhoods.size(); ++i) {
+            cached_dists[i] =
+                -cached_dists[i] / base_norms[cached_nhoods[i].first];
           }
+        } else {
+          // INNER_PRODUCT is served as L2 over the transformed data
+          faiss::fvec_L2sqr_batch_indexed(
+              cached_dists.data(), (const float *) query,
+              (const char *) coord_cache_buf, cached_rows.data(),
+              cached_rows.size(), aligned_dim, aligned_dim * sizeof(T));
+        }
+      } else {
+        cached_dists.clear();
+      }
+
+      // process cached nhoods
+      for (size_t c = 0; c < cached_nhoods.size(); ++c) {
+        auto &cached_nhood = cached_nhoods[c];
+        auto  global_cache_iter = coord_cache.find(cached_nhood.first);
+        T    *node_fp_coords_copy = global_cache_iter->second;
+        if ((bitset_view.empty() || !bitset_view.test(cached_nhood.first)) &&
+            first_score(cached_nhood.first)) {
+          float cur_expanded_dist =
+              cached_dists.empty()
+                  ? node_dist(cached_nhood.first, node_fp_coords_copy)
+                  : cached_dists[c];
           full_retset.push_back(
               Neighbor((unsigned) cached_nhood.first, cur_expanded_dist, true));
 
@@ -1225,21 +1896,12 @@ namespace diskann {
             feder->id_set_.insert(id);
           }
 
-          if (visited.find(id) != visited.end()) {
+          if (visited.find(id) != visited.end() || off_label(id)) {
             continue;
           } else {
             visited.insert(id);
             cmps++;
-            float dist = dist_scratch[m];
-            if (cur_list_size > 0 &&
-                dist >= retset[cur_list_size - 1].distance &&
-                (cur_list_size == l_search))
-              continue;
-            Neighbor nn(id, dist, true);
-            // Return position in sorted list where nn inserted.
-            auto r = InsertIntoPool(retset.data(), cur_list_size, nn);
-            if (cur_list_size < l_search)
-              ++cur_list_size;
+            auto r = insert_candidate(id, dist_scratch[m]);
             if (r < nk)
               // nk logs the best position in the retset that was
               // updated due to neighbors of n.
@@ -1247,6 +1909,10 @@ namespace diskann {
           }
         }
       }
+      // process dynamically cached nhoods
+      for (auto &dyn_nhood : dyn_nhoods) {
+        nk = std::min(nk, expand_record(dyn_nhood.first, dyn_nhood.second));
+      }
 #ifdef USE_BING_INFRA
       // process each frontier nhood - compute distances to unvisited nodes
       int completedIndex = -1;
@@ -1265,27 +1931,17 @@ namespace diskann {
 #endif
         char *node_disk_buf =
             get_offset_to_node(frontier_nhood.second, frontier_nhood.first);
-        unsigned *node_buf = OFFSET_TO_NODE_NHOOD(node_disk_buf);
-        _u64      nnbrs = (_u64) (*node_buf);
+        _u64      nnbrs;
+        unsigned *node_nbrs = get_node_nbrs(node_disk_buf, nnbrs,
+                                            query_scratch->nbrs_scratch);
         T        *node_fp_coords = OFFSET_TO_NODE_COORDS(node_disk_buf);
 
         T *node_fp_coords_copy = data_buf;
         memcpy(node_fp_coords_copy, node_fp_coords, disk_bytes_per_point);
-        if (bitset_view.empty() || !bitset_view.test(frontier_nhood.first)) {
-          float cur_expanded_dist;
-          if (!use_disk_index_pq) {
-            cur_expanded_dist =
-                dist_cmp_wrap(query, node_fp_coords_copy, (size_t) aligned_dim,
-                         frontier_nhood.first);
-          } else {
-            if (metric == diskann::Metric::INNER_PRODUCT ||
-                metric == diskann::Metric::COSINE)
-              cur_expanded_dist = disk_pq_table.inner_product(
-                  query_float, (_u8 *) node_fp_coords_copy);
-            else
-              cur_expanded_dist = disk_pq_table.l2_distance(
-                  query_float, (_u8 *) node_fp_coords_copy);
-          }
+        if ((bitset_view.empty() || !bitset_view.test(frontier_nhood.first)) &&
+            first_score(frontier_nhood.first)) {
+          float cur_expanded_dist =
+              node_dist(frontier_nhood.first, node_fp_coords_copy);
           full_retset.push_back(
               Neighbor(frontier_nhood.first, cur_expanded_dist, true));
 
@@ -1296,7 +1952,7 @@ namespace diskann {
             feder->id_set_.insert(frontier_nhood.first);
           }
         }
-        unsigned *node_nbrs = (node_buf + 1);
+        score_sector_of(frontier_nhood.first, frontier_nhood.second);
         // compute node_nbrs <-> query dist in PQ space
         cpu_timer.reset();
         compute_dists(node_nbrs, nnbrs, dist_scratch);
@@ -1317,25 +1973,15 @@ namespace diskann {
             feder->id_set_.insert(frontier_nhood.first);
           }
 
-          if (visited.find(id) != visited.end()) {
+          if (visited.find(id) != visited.end() || off_label(id)) {
             continue;
           } else {
             visited.insert(id);
             cmps++;
-            float dist = dist_scratch[m];
             if (stats != nullptr) {
               stats->n_cmps++;
             }
-            if (cur_list_size > 0 &&
-                dist >= retset[cur_list_size - 1].distance &&
-                (cur_list_size == l_search))
-              continue;
-            Neighbor nn(id, dist, true);
-            auto     r = InsertIntoPool(
-                    retset.data(), cur_list_size,
-                    nn);  // Return position in sorted list where nn inserted.
-            if (cur_list_size < l_search)
-              ++cur_list_size;
+            auto r = insert_candidate(id, dist_scratch[m]);
             if (r < nk)
               nk = r;  // nk logs the best position in the retset that was
                        // updated due to neighbors of n.
@@ -1347,6 +1993,15 @@ namespace diskann {
         }
       }
 
+      if (adaptive_beam) {
+        if (nk < k_search) {
+          stable_rounds = 0;
+        } else {
+          stable_rounds++;
+          cur_beam_width = std::max(min_beam_width, cur_beam_width / 2);
+        }
+      }
+
       // update best inserted position
       if (nk <= k)
         k = nk;  // k is the best position in retset updated in this round.
@@ -1362,7 +2017,10 @@ namespace diskann {
                 return left.distance < right.distance;
               });
 
-    if (use_reorder_data) {
+    // the nodes of a disk sq index hold quantized vectors, the best
+    // candidates always rerank on the exact ones
+    const bool rerank = use_reorder_data || use_disk_index_sq;
+    if (rerank) {
       if (!(this->reorder_data_exists)) {
         throw ANNException(
             "Requested use of reordering data which does not exist in index "
@@ -1370,6 +2028,11 @@ namespace diskann {
             -1, __FUNCSIG__, __FILE__, __LINE__);
       }
 
+      // a resumed search goes on from the candidates before the rerank
+      if (state != nullptr) {
+        state->full_retset = full_retset;
+      }
+
       std::vector<AlignedRead> vec_read_reqs;
 
       if (full_retset.size() > k_search * FULL_PRECISION_REORDER_MULTIPLIER)
@@ -1377,33 +2040,43 @@ namespace diskann {
             full_retset.begin() + k_search * FULL_PRECISION_REORDER_MULTIPLIER,
             full_retset.end());
 
-      for (size_t i = 0; i < full_retset.size(); ++i) {
-        vec_read_reqs.emplace_back(
-            VECTOR_SECTOR_NO(((size_t) full_retset[i].id)) * SECTOR_LEN,
-            SECTOR_LEN, sector_scratch + i * SECTOR_LEN);
+      // read in batches that fit the sector scratch
+      for (size_t start = 0; start < full_retset.size();
+           start += MAX_N_SECTOR_READS) {
+        const size_t end =
+            std::min<size_t>(full_retset.size(), start + MAX_N_SECTOR_READS);
+        vec_read_reqs.clear();
+        for (size_t i = start; i < end; ++i) {
+          vec_read_reqs.emplace_back(
+              VECTOR_SECTOR_NO(((size_t) full_retset[i].id)) * SECTOR_LEN,
+              SECTOR_LEN, sector_scratch + (i - start) * SECTOR_LEN);
 
-        if (stats != nullptr) {
-          stats->n_4k++;
-          stats->n_ios++;
+          if (stats != nullptr) {
+            stats->n_4k++;
+            stats->n_ios++;
+          }
         }
-      }
 
-      io_timer.reset();
+        io_timer.reset();
+        {
+          KNOWHERE_PROFILE_ZONE("diskann.io_wait");
 #ifdef USE_BING_INFRA
-      reader->read(vec_read_reqs, ctx, false);  // sync reader windows.
+          reader->read(vec_read_reqs, ctx, false);  // sync reader windows.
 #else
-      reader->read(vec_read_reqs, ctx);     // synchronous IO linux
+          reader->read(vec_read_reqs, ctx);     // synchronous IO linux
 #endif
-      if (stats != nullptr) {
-        stats->io_us += io_timer.elapsed();
-      }
+        }
+        if (stats != nullptr) {
+          stats->io_us += io_timer.elapsed();
+        }
 
-      for (size_t i = 0; i < full_retset.size(); ++i) {
-        auto id = full_retset[i].id;
-        auto location =
-            (sector_scratch + i * SECTOR_LEN) + VECTOR_SECTOR_OFFSET(id);
-        full_retset[i].distance =
-            dist_cmp_wrap(query, (T *) location, this->data_dim, id);
+        for (size_t i = start; i < end; ++i) {
+          auto id = full_retset[i].id;
+          auto location = (sector_scratch + (i - start) * SECTOR_LEN) +
+                          VECTOR_SECTOR_OFFSET(id);
+          full_retset[i].distance =
+              dist_cmp_wrap(query, (T *) location, this->data_dim, id);
+        }
       }
 
       std::sort(full_retset.begin(), full_retset.end(),
@@ -1412,7 +2085,38 @@ namespace diskann {
                 });
     }
 
-    // copy k_search values
+    copy_results(full_retset, k_search, indices, distances, query_norm);
+    // the entry of a query holds for its unfiltered searches only
+    if (k_search > 0 && !by_label) {
+      lru_cache.put(vec_hash, indices[0]);
+    }
+
+    if (state != nullptr) {
+      state->started = true;
+      state->retset.assign(retset.begin(), retset.begin() + cur_list_size);
+      if (!rerank) {
+        state->full_retset.swap(full_retset);
+      }
+      state->scored.swap(scored);
+      state->visited.swap(visited);
+    }
+
+    this->thread_data.push(data);
+    this->thread_data.push_notify_all();
+    this->reader->put_ctx(ctx);
+
+    count_dynamic_cache_query();
+
+    if (stats != nullptr) {
+      stats->total_us = (double) query_timer.elapsed();
+    }
+    return !partial;
+  }
+
+  template<typename T>
+  void PQFlashIndex<T>::copy_results(const std::vector<Neighbor> &full_retset,
+                                     const _u64 k_search, _s64 *indices,
+                                     float *distances, const float query_norm) {
     for (_u64 i = 0; i < k_search; i++) {
       if (i >= full_retset.size()) {
         indices[i] = -1;
@@ -1436,62 +2140,456 @@ namespace diskann {
         }
       }
     }
-    if (k_search > 0) {
-      lru_cache.put(vec_hash, indices[0]);
+  }
+
+  template<typename T>
+  void PQFlashIndex<T>::pick_entry_points(const float *query_float,
+                                          _u64                   l_search,
+                                          std::vector<unsigned> &entry_points) {
+    if (nav_npts > 0) {
+      nav_graph_search(query_float,
+                       (unsigned) std::min<_u64>(kNavEntryPoints, l_search),
+                       kNavSearchListSize, entry_points);
+    }
+    if (!entry_points.empty()) {
+      return;
+    }
+    _u32  best_medoid = 0;
+    float best_dist = (std::numeric_limits<float>::max)();
+    for (_u64 cur_m = 0; cur_m < num_medoids; cur_m++) {
+      float cur_expanded_dist = dist_cmp_float_wrap(
+          query_float, centroid_data + aligned_dim * cur_m,
+          (size_t) aligned_dim, medoids[cur_m]);
+      if (cur_expanded_dist < best_dist) {
+        best_medoid = medoids[cur_m];
+        best_dist = cur_expanded_dist;
+      }
     }
+    entry_points.push_back(best_medoid);
+  }
 
-    this->thread_data.push(data);
-    this->thread_data.push_notify_all();
-    this->reader->put_ctx(ctx);
-    // std::cout << num_ios << " " <<stats << std::endl;
+  template<typename T>
+  void PQFlashIndex<T>::count_dynamic_cache_query() {
+    if (dynamic_cache != nullptr && dynamic_cache->count_query()) {
+      std::scoped_lock lk(dynamic_cache_mtx);
+      dynamic_cache_refresh =
+          knowhere::ThreadPool::GetGlobalSearchThreadPool()->push(
+              [this]() { refresh_dynamic_cache(); });
+    }
+  }
 
-    if (stats != nullptr) {
-      stats->total_us = (double) query_timer.elapsed();
+  template<typename T>
+  _u64 PQFlashIndex<T>::interleaved_beam_search(
+      const T *queries, const _u64 nq, const _u64 query_stride,
+      const _u64 k_search, const _u64 l_search, _s64 *res_ids,
+      float *res_dists, const _u64 beam_width, QueryStats *stats,
+      knowhere::BitsetView bitset_view, const float filter_ratio,
+      const bool for_tuning) {
+    if (beam_width > MAX_N_SECTOR_READS)
+      throw ANNException("Beamwidth can not be higher than MAX_N_SECTOR_READS",
+                         -1, __FUNCSIG__, __FILE__, __LINE__);
+
+    _u64 n_partial = 0;
+    // a heavy filter turns the searches into scans of the nodes left, and the
+    // quantized nodes rerank on reads of their exact vectors
+    bool one_by_one = nq <= 1 || use_disk_index_sq;
+    if (!one_by_one && !bitset_view.empty()) {
+      const auto filter_threshold =
+          filter_ratio < 0 ? calcFilterThreshold(k_search) : filter_ratio;
+      one_by_one =
+          bitset_view.count() >= bitset_view.size() * filter_threshold;
+    }
+    if (one_by_one) {
+      for (_u64 q = 0; q < nq; q++) {
+        if (!cached_beam_search(
+                queries + q * query_stride, k_search, l_search,
+                res_ids + q * k_search,
+                res_dists != nullptr ? res_dists + q * k_search : nullptr,
+                beam_width, false, stats != nullptr ? stats + q : nullptr,
+                nullptr, bitset_view, filter_ratio, for_tuning)) {
+          n_partial++;
+        }
+      }
+      return n_partial;
     }
+
+    // the queries run in lanes, a lane owns depth slots of the sector scratch
+    // and searches one query after the other
+    const _u64 max_in_flight =
+        std::min<_u64>(MAX_N_SECTOR_READS, reader->max_events_per_ctx());
+    const _u64 depth = std::clamp<_u64>(beam_width, 1, max_in_flight);
+    const _u64 n_lanes =
+        std::max<_u64>(1, std::min<_u64>(nq, max_in_flight / depth));
+
+    struct Lane {
+      _u64                  query = 0;
+      bool                  running = false;
+      ThreadData<T>         data;
+      float                 query_norm = 0;
+      uint64_t              vec_hash = 0;
+      std::vector<Neighbor> retset;
+      unsigned              cur_list_size = 0;
+      unsigned              k = 0;
+      std::vector<Neighbor> full_retset;
+      std::vector<char *>   free_slots;
+      _u64                  n_in_flight = 0;
+      bool                  partial = false;
+      Timer                 timer;
+    };
+    std::vector<Lane> lanes(n_lanes);
+    std::vector<unsigned> slot_ids(n_lanes * depth);
+
+    auto  sector_buf = borrow_sector_scratch();
+    char *sector_scratch = sector_buf.get();
+    auto  ctx = this->reader->get_ctx();
+    const bool use_node_cache =
+        node_cache_loaded.load(std::memory_order_acquire);
+    auto dyn_table =
+        dynamic_cache != nullptr ? dynamic_cache->table() : nullptr;
+
+    _u64                     next_query = 0;
+    _u64                     n_in_flight = 0;
+    std::vector<AlignedRead> read_reqs;
+    read_reqs.reserve(max_in_flight);
+    std::vector<void *> completed;
+    completed.reserve(max_in_flight);
+
+    auto query_stats = [&](const Lane &lane) {
+      return stats != nullptr ? stats + lane.query : nullptr;
+    };
+
+    // query <-> node distances in PQ space
+    auto compute_dists = [this](Lane &lane, const unsigned *ids,
+                                const _u64 n_ids, float *dists_out) {
+      auto &scratch = lane.data.scratch;
+      aggregate_coords(ids, n_ids, this->data, this->n_chunks,
+                       scratch.aligned_pq_coord_scratch);
+      pq_dist_lookup(scratch.aligned_pq_coord_scratch, n_ids, this->n_chunks,
+                     scratch.aligned_pqtable_dist_scratch, dists_out);
+    };
+
+    // starts the next query in the lane, false once there is none left
+    auto start = [&](Lane &lane) {
+      lane.running = false;
+      while (next_query < nq) {
+        lane.query = next_query++;
+        if (lane.data.scratch.coord_scratch == nullptr) {
+          lane.data = this->interleave_data.pop();
+          if (lane.data.scratch.coord_scratch == nullptr) {
+            lane.data = alloc_thread_data();
+          }
+        }
+        auto query_norm = init_thread_data(
+            lane.data, queries + lane.query * query_stride);
+        if (!query_norm.has_value()) {
+          // an empty answer for a zero query
+          copy_results({}, k_search, res_ids + lane.query * k_search,
+                       res_dists != nullptr
+                           ? res_dists + lane.query * k_search
+                           : nullptr,
+                       0);
+          continue;
+        }
+        auto &scratch = lane.data.scratch;
+        lane.running = true;
+        lane.timer.reset();
+        lane.query_norm = query_norm.value();
+        lane.vec_hash =
+            knowhere::hash_vec(scratch.aligned_query_float, data_dim);
+        lane.retset.resize(l_search + 1);
+        lane.full_retset.clear();
+        lane.cur_list_size = 0;
+        lane.k = 0;
+        lane.partial = false;
+        pq_table.populate_chunk_distances(scratch.aligned_query_float,
+                                          scratch.aligned_pqtable_dist_scratch);
+
+        std::vector<unsigned> entry_points;
+        _u32                  best_medoid = 0;
+        if (!for_tuning && lru_cache.try_get(lane.vec_hash, best_medoid)) {
+          entry_points.push_back(best_medoid);
+        } else {
+          pick_entry_points(scratch.aligned_query_float, l_search,
+                            entry_points);
+        }
+        float *dist_scratch = scratch.aligned_dist_scratch;
+        compute_dists(lane, entry_points.data(), entry_points.size(),
+                      dist_scratch);
+        for (size_t i = 0; i < entry_points.size(); i++) {
+          lane.retset[i] = Neighbor(entry_points[i], dist_scratch[i], true);
+          scratch.visited->insert(entry_points[i]);
+        }
+        lane.cur_list_size = (unsigned) entry_points.size();
+        std::sort(lane.retset.begin(),
+                  lane.retset.begin() + lane.cur_list_size);
+        return true;
+      }
+      return false;
+    };
+
+    // expands a node of the query of the lane, returns the best position of
+    // retset its neighbors were inserted at
+    auto expand = [&](Lane &lane, unsigned id, T *node_fp_coords,
+                      _u64 nnbrs, unsigned *node_nbrs) {
+      auto    &scratch = lane.data.scratch;
+      auto     st = query_stats(lane);
+      unsigned best = lane.cur_list_size;
+      if (bitset_view.empty() || !bitset_view.test(id)) {
+        lane.full_retset.push_back(Neighbor(
+            id,
+            disk_node_dist(scratch.aligned_query_T,
+                           scratch.aligned_query_float, node_fp_coords, id),
+            true));
+      }
+      float *dist_scratch = scratch.aligned_dist_scratch;
+      compute_dists(lane, node_nbrs, nnbrs, dist_scratch);
+      if (st != nullptr) {
+        st->n_cmps += (double) nnbrs;
+      }
+      for (_u64 m = 0; m < nnbrs; ++m) {
+        unsigned nbr = node_nbrs[m];
+        if (!scratch.visited->insert(nbr).second) {
+          continue;
+        }
+        if (lane.cur_list_size == l_search &&
+            dist_scratch[m] >= lane.retset[lane.cur_list_size - 1].distance) {
+          continue;
+        }
+        auto r = InsertIntoPool(lane.retset.data(), lane.cur_list_size,
+                                Neighbor(nbr, dist_scratch[m], true));
+        if (lane.cur_list_size < l_search) {
+          ++lane.cur_list_size;
+        }
+        best = std::min(best, r);
+      }
+      return best;
+    };
+
+    // dynamic cache records are laid out as on disk
+    auto expand_record = [&](Lane &lane, unsigned id, const char *record) {
+      T *data_buf = lane.data.scratch.coord_scratch;
+      memcpy(data_buf, record, disk_bytes_per_point);
+      _u64      nnbrs;
+      unsigned *nbrs = get_node_nbrs((char *) record, nnbrs,
+                                     lane.data.scratch.nbrs_scratch);
+      return expand(lane, id, data_buf, nnbrs, nbrs);
+    };
+
+    // the best candidate of the lane not expanded yet, none is left before k
+    auto next_candidate = [&](Lane &lane, unsigned &id) {
+      auto &retset = lane.retset;
+      while (lane.k < lane.cur_list_size) {
+        auto k = lane.k;
+        if (!retset[k].flag) {
+          lane.k++;
+          continue;
+        }
+        id = retset[k].id;
+        retset[k].flag = false;
+        if (this->count_visited_nodes) {
+          reinterpret_cast<std::atomic<_u32> &>(
+              this->node_visit_counter[id].second)
+              .fetch_add(1);
+        }
+        if (!bitset_view.empty() && bitset_view.test(id)) {
+          std::memmove(&retset[k], &retset[k + 1],
+                       (lane.cur_list_size - k - 1) * sizeof(Neighbor));
+          lane.cur_list_size--;
+        } else {
+          lane.k++;
+        }
+        return true;
+      }
+      return false;
+    };
+
+    // queues reads of the best candidates of the lane into its free slots,
+    // the cached nodes are expanded on the spot; false once the query has no
+    // candidate left to read
+    auto refill = [&](Lane &lane) {
+      auto     st = query_stats(lane);
+      unsigned id;
+      while (!lane.free_slots.empty() &&
+             n_in_flight + read_reqs.size() < max_in_flight) {
+        if (knowhere::CancellationToken::CurrentCancelled()) {
+          for (unsigned i = lane.k; i < lane.cur_list_size && !lane.partial;
+               i++) {
+            lane.partial = lane.retset[i].flag;
+          }
+          return false;
+        }
+        if (!next_candidate(lane, id)) {
+          return false;
+        }
+        auto iter = use_node_cache ? nhood_cache.find(id) : nhood_cache.end();
+        if (iter != nhood_cache.end()) {
+          if (st != nullptr) {
+            st->n_cache_hits++;
+          }
+          lane.k = std::min(
+              lane.k, expand(lane, id, coord_cache.find(id)->second,
+                             iter->second.first, iter->second.second));
+          continue;
+        }
+        if (dyn_table != nullptr) {
+          if (auto record = dyn_table->find(id); record != nullptr) {
+            if (st != nullptr) {
+              st->n_cache_hits++;
+            }
+            dynamic_cache->record_access(id);
+            lane.k = std::min(lane.k, expand_record(lane, id, record));
+            continue;
+          }
+          dynamic_cache->record_miss(id);
+        }
+        char *slot = lane.free_slots.back();
+        lane.free_slots.pop_back();
+        slot_ids[(slot - sector_scratch) / read_len_for_node] = id;
+        read_reqs.emplace_back(get_node_sector_offset((size_t) id),
+                               read_len_for_node, slot);
+        lane.n_in_flight++;
+        if (st != nullptr) {
+          st->n_4k++;
+          st->n_ios++;
+        }
+      }
+      return true;
+    };
+
+    auto finish = [&](Lane &lane) {
+      auto &full_retset = lane.full_retset;
+      std::sort(full_retset.begin(), full_retset.end(),
+                [](const Neighbor &left, const Neighbor &right) {
+                  return left.distance < right.distance;
+                });
+      auto indices = res_ids + lane.query * k_search;
+      copy_results(full_retset, k_search, indices,
+                   res_dists != nullptr ? res_dists + lane.query * k_search
+                                        : nullptr,
+                   lane.query_norm);
+      if (k_search > 0) {
+        lru_cache.put(lane.vec_hash, indices[0]);
+      }
+      count_dynamic_cache_query();
+      n_partial += lane.partial;
+      if (auto st = query_stats(lane); st != nullptr) {
+        st->total_us = (double) lane.timer.elapsed();
+      }
+    };
+
+    for (_u64 l = 0; l < n_lanes; l++) {
+      for (_u64 i = 0; i < depth; i++) {
+        lanes[l].free_slots.push_back(sector_scratch +
+                                      (l * depth + i) * read_len_for_node);
+      }
+      start(lanes[l]);
+    }
+    while (true) {
+      // the reads of all the lanes go out together, a lane whose query has
+      // nothing left to read or in flight goes on with the next query
+      read_reqs.clear();
+      for (auto &lane : lanes) {
+        while (lane.running && !refill(lane) && lane.n_in_flight == 0) {
+          finish(lane);
+          start(lane);
+        }
+      }
+      if (!read_reqs.empty()) {
+        reader->submit_req(ctx, read_reqs);
+        n_in_flight += read_reqs.size();
+      }
+      // a running lane always has reads in flight, or waits for the reads of
+      // the others to leave room for its own
+      if (n_in_flight == 0) {
+        break;
+      }
+
+      completed.clear();
+      {
+        KNOWHERE_PROFILE_ZONE("diskann.io_wait");
+        reader->get_completed_req(ctx, 1, n_in_flight, completed);
+      }
+      n_in_flight -= completed.size();
+      for (auto buf : completed) {
+        char *slot = (char *) buf;
+        auto  slot_no = (_u64) (slot - sector_scratch) / read_len_for_node;
+        auto &lane = lanes[slot_no / depth];
+        auto  node_id = slot_ids[slot_no];
+        lane.k = std::min(
+            lane.k,
+            expand_record(lane, node_id, get_offset_to_node(slot, node_id)));
+        lane.free_slots.push_back(slot);
+        lane.n_in_flight--;
+        if (auto st = query_stats(lane); st != nullptr) {
+          st->n_hops++;
+        }
+      }
+    }
+
+    this->reader->put_ctx(ctx);
+    for (auto &lane : lanes) {
+      if (lane.data.scratch.coord_scratch != nullptr) {
+        this->interleave_data.push(lane.data);
+      }
+    }
+    return n_partial;
   }
 
   // range search returns results of all neighbors within distance of range.
   // indices and distances need to be pre-allocated of size l_search and the
   // return value is the number of matching hits.
+  // with max_results the list stops growing once it holds that many hits
+  // that are not closer than range_filter, the closest of them are then found
   template<typename T>
   _u32 PQFlashIndex<T>::range_search(
       const T *query1, const double range, const _u64 min_l_search,
       const _u64 max_l_search, std::vector<_s64> &indices,
       std::vector<float> &distances, const _u64 beam_width,
       const float l_k_ratio, knowhere::BitsetView bitset_view,
-      QueryStats *stats) {
+      QueryStats *stats, const _u64 max_results, const float range_filter) {
     _u32 res_count = 0;
+    bool is_ip = (metric == diskann::Metric::INNER_PRODUCT ||
+                  metric == diskann::Metric::COSINE);
 
     bool stop_flag = false;
 
     _u32 l_search = min_l_search;  // starting size of the candidate list
-    while (!stop_flag) {
+    // every round resumes the search of the previous one with the larger
+    // list, so the nodes it read are not read again
+    BeamSearchState state;
+    while (!stop_flag && !knowhere::CancellationToken::CurrentCancelled()) {
       indices.resize(l_search);
       distances.resize(l_search);
       for (auto &x : distances)
         x = std::numeric_limits<float>::max();
       this->cached_beam_search(query1, l_search, l_k_ratio * l_search,
                                indices.data(), distances.data(), beam_width,
-                               false, stats, nullptr, bitset_view);
+                               false, stats, nullptr, bitset_view, -1.0f,
+                               false, false, false, &state);
+      _u64 hits = 0;
       for (_u32 i = 0; i < l_search; i++) {
         if (indices[i] == -1) {
           res_count = i;
           break;
         }
-        bool in_range = (metric == diskann::Metric::INNER_PRODUCT ||
-                         metric == diskann::Metric::COSINE)
-                                ? distances[i] > (float) range
-                                : distances[i] < (float) range;
+        bool in_range = is_ip ? distances[i] > (float) range
+                              : distances[i] < (float) range;
         if (!in_range) {
           res_count = i;
           break;
         }
+        if (is_ip ? distances[i] <= range_filter
+                  : distances[i] >= range_filter) {
+          hits++;
+        }
         if (i == l_search - 1) {
           res_count = l_search;
         }
       }
       if (res_count < (_u32) (l_search / 2.0))
         stop_flag = true;
+      if (max_results > 0 && hits >= max_results)
+        stop_flag = true;
       l_search = l_search * 2;
       if (l_search > max_l_search)
         stop_flag = true;
@@ -1501,6 +2599,57 @@ namespace diskann {
     return res_count;
   }
 
+  template<typename T>
+  _u64 PQFlashIndex<T>::get_vector_sector_offset(_u64 node_id) {
+    return use_disk_index_sq ? VECTOR_SECTOR_NO(node_id) * SECTOR_LEN
+                             : get_node_sector_offset(node_id);
+  }
+
+  template<typename T>
+  _u64 PQFlashIndex<T>::get_vector_read_len() {
+    return use_disk_index_sq ? SECTOR_LEN : read_len_for_node;
+  }
+
+  template<typename T>
+  char *PQFlashIndex<T>::get_offset_to_vector(char *sector_buf, _u64 node_id) {
+    return use_disk_index_sq ? sector_buf + VECTOR_SECTOR_OFFSET(node_id)
+                             : get_offset_to_node(sector_buf, node_id);
+  }
+
+  template<typename T>
+  SectorBufferPool::Buffer PQFlashIndex<T>::borrow_sector_scratch() {
+    SectorBufferPool::Buffer buf((_u64) MAX_N_SECTOR_READS * read_len_for_node);
+    auto                    &pool = SectorBufferPool::instance();
+    std::scoped_lock         lk(sector_bufs_mtx);
+    if (pool.generation() != sector_bufs_gen) {
+      this->reader->register_buffers(pool.buffers(sector_bufs_gen));
+    }
+    return buf;
+  }
+
+  template<typename T>
+  float PQFlashIndex<T>::disk_node_dist(const T     *query,
+                                        const float *query_float,
+                                        const T *node_coords, unsigned id) {
+    if (use_disk_index_sq) {
+      // the float distance of the index, see dist_cmp_float_wrap
+      if (metric == diskann::Metric::COSINE) {
+        return disk_sq_table.distance(query_float, (const _u8 *) node_coords,
+                                      true) /
+               base_norms[id];
+      }
+      return disk_sq_table.distance(query_float, (const _u8 *) node_coords,
+                                    false);
+    }
+    if (!use_disk_index_pq) {
+      return dist_cmp_wrap(query, node_coords, (size_t) aligned_dim, id);
+    }
+    if (metric == diskann::Metric::INNER_PRODUCT ||
+        metric == diskann::Metric::COSINE)
+      return disk_pq_table.inner_product(query_float, (_u8 *) node_coords);
+    return disk_pq_table.l2_distance(query_float, (_u8 *) node_coords);
+  }
+
   template<typename T>
   inline void PQFlashIndex<T>::copy_vec_base_data(T *des, const int64_t des_idx,
                                                   void *src) {
@@ -1521,12 +2670,15 @@ namespace diskann {
   PQFlashIndex<T>::get_sectors_layout_and_write_data_from_cache(
       const int64_t *ids, int64_t n, T *output_data) {
     std::unordered_map<_u64, std::vector<_u64>> sectors_to_visit;
+    const bool use_node_cache =
+        node_cache_loaded.load(std::memory_order_acquire);
     for (int64_t i = 0; i < n; ++i) {
       _u64 id = ids[i];
-      if (coord_cache.find(id) != coord_cache.end()) {
+      if (use_node_cache && !use_disk_index_sq &&
+          coord_cache.find(id) != coord_cache.end()) {
         copy_vec_base_data(output_data, i, coord_cache.at(id));
       } else {
-        const _u64 sector_offset = get_node_sector_offset(id);
+        const _u64 sector_offset = get_vector_sector_offset(id);
         sectors_to_visit[sector_offset].push_back(i);
       }
     }
@@ -1543,70 +2695,220 @@ namespace diskann {
     }
 
     ThreadData<T> data = this->thread_data.pop();
-    while (data.scratch.sector_scratch == nullptr) {
+    while (data.scratch.coord_scratch == nullptr) {
       this->thread_data.wait_for_push_notify();
       data = this->thread_data.pop();
     }
 
-    const size_t batch_size =
-        std::min(AioContextPool::GetGlobalAioPool()->max_events_per_ctx(),
-                 std::min(MAX_N_SECTOR_READS / 2UL, sectors_to_visit.size()));
-    const size_t half_buf_idx = MAX_N_SECTOR_READS / 2 * read_len_for_node;
-    char *sector_scratch = data.scratch.sector_scratch;
-    std::vector<AlignedRead> frontier_read_reqs;
-    frontier_read_reqs.reserve(batch_size);
-
+    // The sectors are read in offset order, runs of adjacent ones in one
+    // read, in batches that fill half of the sector scratch each. A batch is
+    // submitted before the vectors of the previous one are copied out of the
+    // other half, so that the copies overlap the reads.
     std::vector<_u64> sector_offsets;
     sector_offsets.reserve(sectors_to_visit.size());
     for (const auto &it : sectors_to_visit) {
       sector_offsets.emplace_back(it.first);
     }
+    std::sort(sector_offsets.begin(), sector_offsets.end());
+
+    const _u64 read_len = get_vector_read_len();
+
+    const _u64 batch_sectors = MAX_N_SECTOR_READS / 2;
+    const _u64 batch_reqs =
+        std::min<_u64>(this->reader->max_events_per_ctx(), batch_sectors);
+    std::vector<std::vector<AlignedRead>> batches;
+    for (_u64 i = 0, n_batch_sectors = 0; i < sector_offsets.size(); i++) {
+      const bool adjacent =
+          i > 0 && n_batch_sectors > 0 &&
+          sector_offsets[i] == sector_offsets[i - 1] + read_len;
+      if (n_batch_sectors == batch_sectors ||
+          (!adjacent && n_batch_sectors > 0 &&
+           batches.back().size() == batch_reqs)) {
+        n_batch_sectors = 0;
+      }
+      if (n_batch_sectors == 0) {
+        batches.emplace_back();
+        batches.back().emplace_back(sector_offsets[i], read_len, nullptr);
+      } else if (adjacent) {
+        batches.back().back().len += read_len;
+      } else {
+        batches.back().emplace_back(sector_offsets[i], read_len, nullptr);
+      }
+      n_batch_sectors++;
+    }
 
-    auto ctx = this->reader->get_ctx();
-    const auto sector_num = sector_offsets.size();
-    const _u64 num_blocks = DIV_ROUND_UP(sector_num, batch_size);
-    std::vector<AlignedRead> last_reqs;
-    bool rotate = false;
-
-    for (_u64 i = 0; i < num_blocks; ++i) {
-      _u64 start_idx = i * batch_size;
-      _u64 idx_len = std::min(batch_size, sector_num - start_idx);
-      last_reqs = frontier_read_reqs;
-      frontier_read_reqs.clear();
-      for (_u64 j = 0; j < idx_len; ++j) {
-        char *sector_buf =
-            sector_scratch + rotate * half_buf_idx + j * read_len_for_node;
-        frontier_read_reqs.emplace_back(sector_offsets[start_idx + j], read_len_for_node,
-                                    sector_buf);
+    const size_t half_buf_len = batch_sectors * read_len_for_node;
+    // lays the reads of a batch out one after the other in a half
+    auto place = [&](std::vector<AlignedRead> &batch, char *half) {
+      for (auto &req : batch) {
+        req.buf = half;
+        half += req.len;
       }
-      rotate ^= 0x1;
-      reader->submit_req(ctx, frontier_read_reqs);
-      for (const auto& req : last_reqs) {
-        auto offset = req.offset;
-        char* sector_buf = static_cast<char*>(req.buf);
-        for (auto idx : sectors_to_visit.at(offset)) {
-          char* node_buf = get_offset_to_node(sector_buf, ids[idx]);
-          copy_vec_base_data(output_data, idx, node_buf);
+    };
+    auto copy_out = [&](const std::vector<AlignedRead> &batch) {
+      for (const auto &req : batch) {
+        for (_u64 off = 0; off < req.len; off += read_len) {
+          char *sector_buf = static_cast<char *>(req.buf) + off;
+          for (auto idx : sectors_to_visit.at(req.offset + off)) {
+            char *node_buf = get_offset_to_vector(sector_buf, ids[idx]);
+            copy_vec_base_data(output_data, idx, node_buf);
+          }
         }
       }
-      reader->get_submitted_req(ctx, frontier_read_reqs.size());
-    }
+    };
 
-    // if any remaining
-    for (const auto& req : frontier_read_reqs) {
-      auto offset = req.offset;
-      char* sector_buf = static_cast<char*>(req.buf);
-      for (auto idx : sectors_to_visit.at(offset)) {
-        char* node_buf = get_offset_to_node(sector_buf, ids[idx]);
-        copy_vec_base_data(output_data, idx, node_buf);
+    auto sector_buf = borrow_sector_scratch();
+    auto ctx = this->reader->get_ctx();
+    for (size_t i = 0; i < batches.size(); i++) {
+      place(batches[i], sector_buf.get() + (i % 2) * half_buf_len);
+      reader->submit_req(ctx, batches[i]);
+      if (i > 0) {
+        copy_out(batches[i - 1]);
       }
+      reader->get_submitted_req(ctx, batches[i].size());
     }
+    copy_out(batches.back());
 
     this->reader->put_ctx(ctx);
     this->thread_data.push(data);
     this->thread_data.push_notify_all();
   }
 
+  template<typename T>
+  _u64 PQFlashIndex<T>::patch_deleted_nodes(const std::vector<bool> &deleted) {
+    if (long_node) {
+      LOG_KNOWHERE_WARNING_ << "The nodes of " << disk_index_file
+                            << " span several sectors, not patched.";
+      return 0;
+    }
+    // a buffered descriptor of its own, a direct read of the searches flushes
+    // the pages it wrote before reading them
+    int fd = ::open(disk_index_file.c_str(), O_RDWR);
+    if (fd < 0) {
+      std::stringstream stream;
+      stream << "Failed to open " << disk_index_file << " for writing.";
+      throw diskann::ANNException(stream.str(), -1, __FUNCSIG__, __FILE__,
+                                  __LINE__);
+    }
+    std::vector<char> sector(SECTOR_LEN);
+    auto read_sector = [&](_u64 offset) {
+      if (::pread(fd, sector.data(), SECTOR_LEN, offset) !=
+          (ssize_t) SECTOR_LEN) {
+        ::close(fd);
+        throw diskann::ANNException("Failed to read " + disk_index_file, -1,
+                                    __FUNCSIG__, __FILE__, __LINE__);
+      }
+    };
+
+    // the lists of the deleted points, whose neighbors replace them
+    std::vector<unsigned> nbrs_scratch(MAX_GRAPH_DEGREE);
+    std::unordered_map<unsigned, std::vector<unsigned>> deleted_nbrs;
+    for (_u64 id = 0; id < num_points && id < deleted.size(); id++) {
+      if (!deleted[id]) {
+        continue;
+      }
+      read_sector(get_node_sector_offset(id));
+      _u64      nnbrs;
+      unsigned *nbrs = get_node_nbrs(get_offset_to_node(sector.data(), id),
+                                     nnbrs, nbrs_scratch.data());
+      deleted_nbrs[id].assign(nbrs, nbrs + nnbrs);
+    }
+    if (deleted_nbrs.empty()) {
+      ::close(fd);
+      return 0;
+    }
+
+    auto is_deleted = [&](unsigned id) {
+      return id < deleted.size() && deleted[id];
+    };
+    std::vector<float> node_vec(data_dim);
+    std::vector<std::pair<float, unsigned>> candidates;
+    std::vector<unsigned> kept;
+    tsl::robin_set<unsigned> seen;
+    const _u64 nhood_len = max_node_len - disk_bytes_per_point;
+    _u64 n_patched = 0;
+    _u64 n_sectors =
+        ROUND_UP(num_points, nnodes_per_sector) / nnodes_per_sector;
+    for (_u64 s = 0; s < n_sectors; s++) {
+      _u64 offset = (s + 1) * SECTOR_LEN;
+      read_sector(offset);
+      bool dirty = false;
+      for (_u64 loc = s * nnodes_per_sector;
+           loc < std::min(num_points, (s + 1) * nnodes_per_sector); loc++) {
+        unsigned id = loc_nodes.empty() ? (unsigned) loc : loc_nodes[loc];
+        if (is_deleted(id)) {
+          continue;
+        }
+        char     *node_buf = get_offset_to_node(sector.data(), id);
+        _u64      nnbrs;
+        unsigned *nbrs = get_node_nbrs(node_buf, nnbrs, nbrs_scratch.data());
+        if (std::none_of(nbrs, nbrs + nnbrs, is_deleted)) {
+          continue;
+        }
+        pq_table.inflate_vector(data + id * n_chunks, node_vec.data());
+        candidates.clear();
+        seen.clear();
+        seen.insert(id);
+        auto add = [&](unsigned c) {
+          if (!is_deleted(c) && seen.insert(c).second) {
+            candidates.emplace_back(
+                pq_table.l2_distance(node_vec.data(), data + c * n_chunks), c);
+          }
+        };
+        for (_u64 i = 0; i < nnbrs; i++) {
+          if (!is_deleted(nbrs[i])) {
+            add(nbrs[i]);
+            continue;
+          }
+          for (auto c : deleted_nbrs[nbrs[i]]) {
+            add(c);
+          }
+        }
+        auto keep = std::min<_u64>(candidates.size(), max_degree);
+        std::partial_sort(candidates.begin(), candidates.begin() + keep,
+                          candidates.end());
+        unsigned *nhood = OFFSET_TO_NODE_NHOOD(node_buf);
+        if (graph_codec == GraphCodec::NONE) {
+          nhood[0] = keep;
+          for (_u64 i = 0; i < keep; i++) {
+            nhood[1 + i] = candidates[i].second;
+          }
+        } else {
+          // the gaps of the new list may be wider, the farthest candidates
+          // go until it fits the slot
+          for (;; keep--) {
+            kept.clear();
+            for (_u64 i = 0; i < keep; i++) {
+              kept.push_back(candidates[i].second);
+            }
+            if (delta_graph::encoded_len(kept.data(), keep) <= nhood_len) {
+              break;
+            }
+          }
+          delta_graph::encode(kept.data(), keep, (uint8_t *) nhood);
+        }
+        dirty = true;
+        n_patched++;
+      }
+      if (!dirty) {
+        continue;
+      }
+      if (::pwrite(fd, sector.data(), SECTOR_LEN, offset) !=
+          (ssize_t) SECTOR_LEN) {
+        ::close(fd);
+        throw diskann::ANNException("Failed to write " + disk_index_file, -1,
+                                    __FUNCSIG__, __FILE__, __LINE__);
+      }
+      reader->write_through(offset, sector.data(), SECTOR_LEN);
+    }
+    ::fdatasync(fd);
+    ::close(fd);
+    LOG_KNOWHERE_INFO_ << "Patched " << n_patched << " nodes of "
+                       << disk_index_file << " linking to "
+                       << deleted_nbrs.size() << " deleted points.";
+    return n_patched;
+  }
+
   template<typename T>
   _u64 PQFlashIndex<T>::get_num_points() const noexcept {
     return num_points;
@@ -1637,6 +2939,48 @@ namespace diskann {
     return metric;
   }
 
+  template<typename T>
+  knowhere::MemoryUsage PQFlashIndex<T>::get_memory_usage() const noexcept {
+    using knowhere::MemoryUsage;
+    MemoryUsage usage;
+    // the PQ codes of all the points, the distances are estimated from them
+    usage.Add(MemoryUsage::kVectors, MemoryUsage::kHeap, num_points * n_chunks);
+    usage.Add(MemoryUsage::kCodebooks, MemoryUsage::kHeap,
+              pq_table.get_size() + num_medoids * aligned_dim * sizeof(float));
+    if (use_disk_index_pq) {
+      usage.Add(MemoryUsage::kCodebooks, MemoryUsage::kHeap,
+                disk_pq_table.get_size());
+    }
+    // the node cache is filled once at load, possibly while searches run
+    if (node_cache_loaded.load(std::memory_order_acquire)) {
+      usage.Add(MemoryUsage::kCache, MemoryUsage::kHeap,
+                nhood_cache.size() * ((max_degree + 1) * sizeof(unsigned) +
+                                      aligned_dim * sizeof(T)));
+    }
+    if (dynamic_cache != nullptr) {
+      usage.Add(MemoryUsage::kCache, MemoryUsage::kHeap,
+                dynamic_cache->capacity() * dynamic_cache->record_len());
+    }
+    usage.Add(MemoryUsage::kCache, MemoryUsage::kHeap,
+              lru_cache.memory_size());
+    usage.Add(MemoryUsage::kGraph, MemoryUsage::kHeap,
+              (nav_ids.size() + nav_graph.size()) * sizeof(_u32) +
+                  nav_data.size() * sizeof(float));
+    usage.Add(MemoryUsage::kOther, MemoryUsage::kHeap,
+              node_labels.capacity() * sizeof(_u32) +
+                  label_medoids.size() * 2 * sizeof(_u32));
+    // the query scratch of every search thread
+    _u64 scratch = ROUND_UP(sizeof(T) * aligned_dim, 256) +
+                   MAX_GRAPH_DEGREE * aligned_dim +
+                   256 * aligned_dim * sizeof(float) +
+                   MAX_GRAPH_DEGREE * sizeof(float) +
+                   aligned_dim * (sizeof(T) + sizeof(float));
+    usage.Add(MemoryUsage::kScratch, MemoryUsage::kHeap,
+              max_nthreads * scratch);
+    usage.Add(MemoryUsage::kOther, MemoryUsage::kHeap, sizeof(*this));
+    return usage;
+  }
+
 #ifdef EXEC_ENV_OLS
   template<typename T>
   char *PQFlashIndex<T>::getHeaderBytes() {
@@ -0,0 +1,228 @@
+#include "diskann/sector_buffer_pool.h"
+
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+#include <string>
+
+namespace diskann {
+
+  namespace {
+    // releases between two trims of the idle buffers
+    constexpr uint64_t kTrimInterval = 4096;
+
+    int count_numa_nodes() {
+      DIR *dir = opendir("/sys/devices/system/node");
+      if (dir == nullptr) {
+        return 1;
+      }
+      int n_nodes = 0;
+      while (auto entry = readdir(dir)) {
+        std::string name = entry->d_name;
+        if (name.size() > 4 && name.compare(0, 4, "node") == 0 &&
+            std::all_of(name.begin() + 4, name.end(), ::isdigit)) {
+          n_nodes = std::max(n_nodes, std::stoi(name.substr(4)) + 1);
+        }
+      }
+      closedir(dir);
+      return std::max(n_nodes, 1);
+    }
+  }  // namespace
+
+  SectorBufferPool::Buffer::Buffer(size_t len)
+      : buf_(SectorBufferPool::instance().borrow(len)), len_(len) {
+  }
+
+  SectorBufferPool::Buffer::~Buffer() {
+    if (buf_ != nullptr) {
+      SectorBufferPool::instance().release(buf_, len_);
+    }
+  }
+
+  SectorBufferPool::Buffer::Buffer(Buffer &&other) noexcept
+      : buf_(other.buf_), len_(other.len_) {
+    other.buf_ = nullptr;
+    other.len_ = 0;
+  }
+
+  SectorBufferPool::Buffer &SectorBufferPool::Buffer::operator=(
+      Buffer &&other) noexcept {
+    if (this != &other) {
+      if (buf_ != nullptr) {
+        SectorBufferPool::instance().release(buf_, len_);
+      }
+      buf_ = other.buf_;
+      len_ = other.len_;
+      other.buf_ = nullptr;
+      other.len_ = 0;
+    }
+    return *this;
+  }
+
+  SectorBufferPool::SectorBufferPool() : n_nodes_(count_numa_nodes()) {
+  }
+
+  SectorBufferPool &SectorBufferPool::instance() {
+    static SectorBufferPool pool;
+    return pool;
+  }
+
+  void SectorBufferPool::set_capacity(uint64_t bytes) {
+    std::unique_lock<std::mutex> lk(mtx_);
+    capacity_ = bytes;
+    cv_.notify_all();
+  }
+
+  int SectorBufferPool::current_node() const {
+    unsigned cpu = 0, node = 0;
+    if (n_nodes_ == 1 || syscall(SYS_getcpu, &cpu, &node, nullptr) != 0) {
+      return 0;
+    }
+    return (int) node % n_nodes_;
+  }
+
+  char *SectorBufferPool::allocate(size_t len) {
+    void *buf = mmap(nullptr, len, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (buf == MAP_FAILED) {
+      return nullptr;
+    }
+    // first touch, the pages go to the node of the borrowing thread
+    std::memset(buf, 0, len);
+    return static_cast<char *>(buf);
+  }
+
+  void SectorBufferPool::free_buffer(char *buf, size_t len) {
+    munmap(buf, len);
+    all_.erase(buf);
+    stats_.bytes -= len;
+    generation_++;
+  }
+
+  bool SectorBufferPool::evict_idle(size_t keep_len) {
+    for (auto &[len, lists] : idle_) {
+      if (len == keep_len) {
+        continue;
+      }
+      for (auto &list : lists) {
+        while (!list.empty() && stats_.bytes + keep_len > capacity_) {
+          free_buffer(list.back(), len);
+          list.pop_back();
+        }
+      }
+    }
+    return stats_.bytes + keep_len <= capacity_;
+  }
+
+  char *SectorBufferPool::borrow(size_t len) {
+    std::unique_lock<std::mutex> lk(mtx_);
+    const int node = current_node();
+    bool      waited = false;
+    while (true) {
+      char *buf = nullptr;
+      auto  iter = idle_.find(len);
+      if (iter != idle_.end()) {
+        auto &lists = iter->second;
+        for (int i = 0; i < n_nodes_ && buf == nullptr; i++) {
+          auto &list = lists[(node + i) % n_nodes_];
+          if (!list.empty()) {
+            buf = list.back();
+            list.pop_back();
+            stats_.n_remote += i > 0;
+          }
+        }
+      }
+      const bool new_buf =
+          buf == nullptr &&
+          (capacity_ == 0 || stats_.bytes + len <= capacity_ ||
+           evict_idle(len) || stats_.borrowed_bytes == 0);
+      if (buf != nullptr || new_buf) {
+        stats_.borrowed_bytes += len;
+        stats_.peak_borrowed_bytes =
+            std::max(stats_.peak_borrowed_bytes, stats_.borrowed_bytes);
+        peak_since_trim_ = std::max(peak_since_trim_, stats_.borrowed_bytes);
+        stats_.n_borrows++;
+      }
+      if (buf != nullptr) {
+        return buf;
+      }
+      if (new_buf) {
+        stats_.bytes += len;
+        lk.unlock();
+        buf = allocate(len);
+        lk.lock();
+        if (buf == nullptr) {
+          stats_.bytes -= len;
+          stats_.borrowed_bytes -= len;
+          cv_.notify_all();
+          throw std::bad_alloc();
+        }
+        all_.emplace(buf, Entry{len, node});
+        generation_++;
+        return buf;
+      }
+      if (!waited) {
+        stats_.n_waits++;
+        waited = true;
+      }
+      cv_.wait(lk);
+    }
+  }
+
+  void SectorBufferPool::release(char *buf, size_t len) {
+    std::unique_lock<std::mutex> lk(mtx_);
+    auto &lists = idle_[len];
+    lists.resize(n_nodes_);
+    lists[all_.at(buf).node].push_back(buf);
+    stats_.borrowed_bytes -= len;
+    if (++n_releases_ % kTrimInterval == 0) {
+      trim_locked();
+    }
+    cv_.notify_all();
+  }
+
+  void SectorBufferPool::trim_locked() {
+    for (auto &[len, lists] : idle_) {
+      for (auto &list : lists) {
+        while (!list.empty() && stats_.bytes > peak_since_trim_) {
+          free_buffer(list.back(), len);
+          list.pop_back();
+        }
+      }
+    }
+    peak_since_trim_ = stats_.borrowed_bytes;
+  }
+
+  void SectorBufferPool::trim() {
+    std::unique_lock<std::mutex> lk(mtx_);
+    trim_locked();
+  }
+
+  std::vector<std::pair<void *, size_t>> SectorBufferPool::buffers(
+      uint64_t &generation) {
+    std::unique_lock<std::mutex> lk(mtx_);
+    std::vector<std::pair<void *, size_t>> bufs;
+    bufs.reserve(all_.size());
+    for (const auto &[buf, entry] : all_) {
+      bufs.emplace_back(buf, entry.len);
+    }
+    generation = generation_;
+    return bufs;
+  }
+
+  uint64_t SectorBufferPool::generation() {
+    std::unique_lock<std::mutex> lk(mtx_);
+    return generation_;
+  }
+
+  SectorBufferPool::Stats SectorBufferPool::stats() {
+    std::unique_lock<std::mutex> lk(mtx_);
+    return stats_;
+  }
+
+}  // namespace diskann
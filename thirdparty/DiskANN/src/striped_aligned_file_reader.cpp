@@ -0,0 +1,206 @@
+#include "diskann/striped_aligned_file_reader.h"
+
+#include <sstream>
+
+#include "diskann/logger.h"
+
+struct StripedRead {
+  void  *buf = nullptr;
+  size_t remaining = 0;
+};
+
+StripedAlignedFileReader::StripedAlignedFileReader(
+    std::vector<std::string> stripe_files, uint64_t stripe_len)
+    : stripe_files_(std::move(stripe_files)), stripe_len_(stripe_len) {
+  if (stripe_files_.empty() || stripe_len_ == 0 ||
+      !IS_512_ALIGNED(stripe_len_)) {
+    throw diskann::ANNException(
+        "A striped disk index needs stripe files and aligned stripes.", -1,
+        __FUNCSIG__, __FILE__, __LINE__);
+  }
+  for (size_t i = 0; i < stripe_files_.size(); i++) {
+    readers_.push_back(std::make_shared<LinuxAlignedFileReader>());
+  }
+}
+
+void StripedAlignedFileReader::open(const std::string &fname) {
+  for (size_t i = 0; i < readers_.size(); i++) {
+    readers_[i]->open(stripe_files_[i]);
+  }
+  LOG_KNOWHERE_DEBUG_ << "Opened " << fname << " striped across "
+                      << stripe_files_.size() << " files";
+}
+
+void StripedAlignedFileReader::close() {
+  for (auto &reader : readers_) {
+    reader->close();
+  }
+  std::scoped_lock lk(write_mtx_);
+  for (auto fd : write_fds_) {
+    ::close(fd);
+  }
+  write_fds_.clear();
+}
+
+void StripedAlignedFileReader::split(
+    const std::vector<AlignedRead>        &read_reqs,
+    std::vector<std::vector<AlignedRead>> &pieces, const io_context_t *ctx) {
+  const uint64_t n = readers_.size();
+  pieces.assign(n, {});
+  for (auto &req : read_reqs) {
+    uint64_t offset = req.offset;
+    uint64_t left = req.len;
+    char    *buf = (char *) req.buf;
+    std::vector<void *> req_pieces;
+    while (left > 0) {
+      uint64_t stripe = offset / stripe_len_;
+      uint64_t in_stripe = offset % stripe_len_;
+      uint64_t len = std::min(left, stripe_len_ - in_stripe);
+      pieces[stripe % n].emplace_back(
+          (stripe / n) * stripe_len_ + in_stripe, len, buf);
+      req_pieces.push_back(buf);
+      offset += len;
+      buf += len;
+      left -= len;
+    }
+    if (ctx != nullptr && req_pieces.size() > 1) {
+      auto read = std::make_shared<StripedRead>();
+      read->buf = req.buf;
+      read->remaining = req_pieces.size();
+      std::scoped_lock lk(split_mtx_);
+      auto &splits = splits_[*ctx];
+      for (auto piece : req_pieces) {
+        splits.pieces[piece] = read;
+      }
+      splits.extra_events += req_pieces.size() - 1;
+    }
+  }
+}
+
+void StripedAlignedFileReader::read(std::vector<AlignedRead> &read_reqs,
+                                    IOContext &ctx, bool async) {
+  std::vector<std::vector<AlignedRead>> pieces;
+  split(read_reqs, pieces, nullptr);
+  size_t left = 0;
+  for (auto &device_pieces : pieces) {
+    left += device_pieces.size();
+  }
+
+  // rounds of at most the events of the context, the pieces of every device
+  // in flight together
+  const size_t        maxnr = readers_[0]->max_events_per_ctx();
+  std::vector<size_t> next(pieces.size(), 0);
+  while (left > 0) {
+    size_t n_round = 0;
+    for (size_t d = 0; d < pieces.size() && n_round < maxnr; d++) {
+      size_t n = std::min(pieces[d].size() - next[d], maxnr - n_round);
+      if (n == 0) {
+        continue;
+      }
+      std::vector<AlignedRead> batch(pieces[d].begin() + next[d],
+                                     pieces[d].begin() + next[d] + n);
+      readers_[d]->submit_req(ctx, batch);
+      next[d] += n;
+      n_round += n;
+    }
+    readers_[0]->get_submitted_req(ctx, n_round);
+    left -= n_round;
+  }
+}
+
+void StripedAlignedFileReader::submit_req(io_context_t             &ctx,
+                                          std::vector<AlignedRead> &read_reqs) {
+  std::vector<std::vector<AlignedRead>> pieces;
+  split(read_reqs, pieces, &ctx);
+  for (size_t d = 0; d < pieces.size(); d++) {
+    if (!pieces[d].empty()) {
+      readers_[d]->submit_req(ctx, pieces[d]);
+    }
+  }
+}
+
+void StripedAlignedFileReader::get_submitted_req(io_context_t &ctx,
+                                                 size_t        n_ops) {
+  // waits for all the pieces, the splits of the context are then done
+  size_t extra = 0;
+  {
+    std::scoped_lock lk(split_mtx_);
+    auto iter = splits_.find(ctx);
+    if (iter != splits_.end()) {
+      extra = iter->second.extra_events;
+      splits_.erase(iter);
+    }
+  }
+  readers_[0]->get_submitted_req(ctx, n_ops + extra);
+}
+
+void StripedAlignedFileReader::get_completed_req(io_context_t &ctx,
+                                                 size_t min_n, size_t max_n,
+                                                 std::vector<void *> &done) {
+  // the pieces of a split read count once, when the last of them completes
+  size_t n_done = 0;
+  std::vector<void *> completed;
+  while (n_done < min_n) {
+    completed.clear();
+    readers_[0]->get_completed_req(ctx, 1, max_n - n_done, completed);
+    std::scoped_lock lk(split_mtx_);
+    auto iter = splits_.find(ctx);
+    for (auto buf : completed) {
+      std::shared_ptr<StripedRead> read;
+      if (iter != splits_.end()) {
+        auto &pieces = iter.value().pieces;
+        auto  piece = pieces.find(buf);
+        if (piece != pieces.end()) {
+          read = piece->second;
+          pieces.erase(piece);
+        }
+      }
+      if (read == nullptr) {
+        done.push_back(buf);
+        n_done++;
+      } else if (--read->remaining == 0) {
+        done.push_back(read->buf);
+        n_done++;
+      } else {
+        iter.value().extra_events--;
+      }
+    }
+  }
+}
+
+void StripedAlignedFileReader::write_through(uint64_t offset, const void *buf,
+                                             uint64_t len) {
+  std::scoped_lock lk(write_mtx_);
+  if (write_fds_.empty()) {
+    for (auto &file : stripe_files_) {
+      int fd = ::open(file.c_str(), O_WRONLY);
+      if (fd < 0) {
+        for (auto opened : write_fds_) {
+          ::close(opened);
+        }
+        write_fds_.clear();
+        throw diskann::ANNException("Failed to open " + file + " for writing",
+                                    -1, __FUNCSIG__, __FILE__, __LINE__);
+      }
+      write_fds_.push_back(fd);
+    }
+  }
+  const uint64_t n = write_fds_.size();
+  auto           src = (const char *) buf;
+  while (len > 0) {
+    uint64_t stripe = offset / stripe_len_;
+    uint64_t in_stripe = offset % stripe_len_;
+    uint64_t piece = std::min(len, stripe_len_ - in_stripe);
+    if (::pwrite(write_fds_[stripe % n], src, piece,
+                 (stripe / n) * stripe_len_ + in_stripe) != (ssize_t) piece) {
+      std::stringstream err;
+      err << "Failed to write the stripe of offset " << offset << " to "
+          << stripe_files_[stripe % n];
+      throw diskann::ANNException(err.str(), -1, __FUNCSIG__, __FILE__,
+                                  __LINE__);
+    }
+    offset += piece;
+    src += piece;
+    len -= piece;
+  }
+}
@@ -11,6 +11,7 @@
 #include <faiss/VectorTransform.h>
 #include <faiss/impl/AuxIndexStructures.h>
 
+#include <algorithm>
 #include <cinttypes>
 #include <cmath>
 #include <cstdio>
@@ -386,6 +387,26 @@ void Clustering::kmeans_plus_plus_algorithm(
     }
 }
 
+void Clustering::kmeans_parallel_algorithm(
+        std::vector<int>& centroids_index,
+        int64_t random_seed,
+        size_t n_input_centroids,
+        size_t d,
+        size_t k,
+        idx_t nx,
+        const uint8_t* x_in) {
+    FAISS_THROW_IF_NOT_MSG(
+            n_input_centroids == 0,
+            "Kmeans parallel only support the provided input centroids number of zero");
+    kmeans_parallel_seeding(
+            reinterpret_cast<const float*>(x_in),
+            nx,
+            d,
+            k,
+            random_seed,
+            centroids_index.data());
+}
+
 void Clustering::train_encoded(
         idx_t nx,
         const uint8_t* x_in,
@@ -535,6 +556,9 @@ void Clustering::train_encoded(
             } else if (ClusteringType::K_MEANS_PLUS_PLUS == clustering_type) {
                 //Use kmeans++ algorithm
                 kmeans_plus_plus_algorithm(centroids_index, random_seed, n_input_centroids, d, k, nx, x_in);
+            } else if (ClusteringType::K_MEANS_PARALLEL == clustering_type) {
+                //Use k-means|| algorithm
+                kmeans_parallel_algorithm(centroids_index, random_seed, n_input_centroids, d, k, nx, x_in);
             } else {
                 FAISS_THROW_FMT ("Clustering Type is knonws: %d", (int)clustering_type);
             }
@@ -734,6 +758,213 @@ float kmeans_clustering(
     return clus.iteration_stats.back().obj;
 }
 
+/******************************************************************************
+ * k-means|| seeding
+ ******************************************************************************/
+
+namespace {
+
+// rounds of oversampling, 5 is enough in the experiments of the paper
+const int kmeans_parallel_rounds = 5;
+
+// uniform in [0, 1) from the seed, the round and the point only, so that the
+// sampling does not depend on the number of threads
+double hash_uniform(uint64_t seed, uint64_t round, uint64_t i) {
+    uint64_t z = seed + (round + 1) * 0x9E3779B97F4A7C15ULL +
+            i * 0xD1B54A32D192ED03ULL;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    z ^= z >> 31;
+    return (z >> 11) * (1.0 / (1ULL << 53));
+}
+
+// dis[i] = min(dis[i], d(x_i, y_j)) over the ny rows of y, nearest[i] the
+// offset + j of the closest, in one batched distance computation
+void update_nearest(
+        const float* x,
+        size_t nx,
+        const float* y,
+        size_t ny,
+        size_t d,
+        int64_t offset,
+        float* dis,
+        int64_t* nearest) {
+    std::vector<float> D(nx);
+    std::vector<int64_t> I(nx);
+    float_maxheap_array_t res = {nx, 1, I.data(), D.data()};
+    knn_L2sqr(x, y, d, nx, ny, &res);
+
+#pragma omp parallel for if (nx > 1000)
+    for (int64_t i = 0; i < (int64_t)nx; i++) {
+        // the BLAS kernel can go slightly below 0
+        float di = std::max(D[i], 0.0f);
+        if (I[i] >= 0 && di < dis[i]) {
+            dis[i] = di;
+            if (nearest) {
+                nearest[i] = offset + I[i];
+            }
+        }
+    }
+}
+
+void gather_rows(
+        const float* x,
+        size_t d,
+        const int64_t* ids,
+        size_t n,
+        std::vector<float>& y) {
+    y.resize(n * d);
+    for (size_t j = 0; j < n; j++) {
+        memcpy(y.data() + j * d, x + ids[j] * d, sizeof(float) * d);
+    }
+}
+
+} // namespace
+
+void kmeans_parallel_seeding(
+        const float* x,
+        size_t nx,
+        size_t d,
+        size_t k,
+        int64_t seed,
+        int* centroids_index) {
+    FAISS_THROW_IF_NOT_FMT(
+            k > 0 && nx >= k,
+            "k-means|| needs 0 < k (%zd) <= nx (%zd)",
+            k,
+            nx);
+
+    RandomGenerator rng(seed);
+    int nt = omp_get_max_threads();
+
+    // 1. oversampling: the candidates, and for each point the squared
+    // distance to its nearest candidate and the index of that candidate
+    std::vector<int64_t> cand;
+    cand.push_back(rng.rand_int64() % nx);
+    std::vector<float> dis(nx, HUGE_VALF);
+    std::vector<int64_t> nearest(nx, 0);
+    std::vector<float> y;
+    update_nearest(
+            x, nx, x + cand[0] * d, 1, d, 0, dis.data(), nearest.data());
+
+    double oversampling = k;
+    for (int round = 0; round < kmeans_parallel_rounds; round++) {
+        double phi = 0;
+#pragma omp parallel for reduction(+ : phi)
+        for (int64_t i = 0; i < (int64_t)nx; i++) {
+            phi += dis[i];
+        }
+        if (phi <= 0) {
+            break; // all the points are candidates already
+        }
+
+        std::vector<std::vector<int64_t>> sampled(nt);
+#pragma omp parallel
+        {
+            auto& mine = sampled[omp_get_thread_num()];
+#pragma omp for schedule(static)
+            for (int64_t i = 0; i < (int64_t)nx; i++) {
+                double p = oversampling * dis[i] / phi;
+                if (p > 0 && hash_uniform(seed, round, i) < p) {
+                    mine.push_back(i);
+                }
+            }
+        }
+
+        size_t begin = cand.size();
+        for (auto& mine : sampled) {
+            cand.insert(cand.end(), mine.begin(), mine.end());
+        }
+        size_t nnew = cand.size() - begin;
+        if (nnew == 0) {
+            continue;
+        }
+        gather_rows(x, d, cand.data() + begin, nnew, y);
+        update_nearest(
+                x, nx, y.data(), nnew, d, begin, dis.data(), nearest.data());
+    }
+
+    size_t m = cand.size();
+    std::vector<uint8_t> taken(nx, 0);
+    size_t nsel = 0;
+
+    if (m <= k) {
+        for (size_t j = 0; j < m; j++) {
+            centroids_index[nsel++] = cand[j];
+            taken[cand[j]] = 1;
+        }
+    } else {
+        // 2. reclustering: weighted k-means++ over the candidates, each
+        // weighted by the number of points nearest to it. The picks go in
+        // batches sampled from the same distribution, and the distances of
+        // the candidates are updated once per batch.
+        std::vector<double> w(m, 0);
+        for (size_t i = 0; i < nx; i++) {
+            w[nearest[i]] += 1;
+        }
+        gather_rows(x, d, cand.data(), m, y);
+
+        std::vector<float> cdis(m, HUGE_VALF);
+        std::vector<double> prefix(m);
+        std::vector<uint8_t> picked(m, 0);
+        std::vector<int64_t> batch;
+        std::vector<float> yb;
+        size_t batch_size = std::max<size_t>(1, k / 256);
+
+        while (nsel < k) {
+            double total = 0;
+            for (size_t j = 0; j < m; j++) {
+                double mass = picked[j] ? 0
+                        : nsel == 0     ? w[j]
+                                        : w[j] * cdis[j];
+                total += mass;
+                prefix[j] = total;
+            }
+            if (total <= 0) {
+                break; // the rest is filled at random below
+            }
+
+            size_t nb = std::min(batch_size, k - nsel);
+            batch.clear();
+            for (size_t b = 0; b < nb; b++) {
+                double r = rng.rand_double() * total;
+                size_t j = std::upper_bound(prefix.begin(), prefix.end(), r) -
+                        prefix.begin();
+                j = std::min(j, m - 1);
+                if (picked[j]) {
+                    continue; // drawn twice in the batch
+                }
+                picked[j] = 1;
+                batch.push_back(j);
+            }
+
+            for (auto j : batch) {
+                centroids_index[nsel++] = cand[j];
+                taken[cand[j]] = 1;
+            }
+            gather_rows(y.data(), d, batch.data(), batch.size(), yb);
+            update_nearest(
+                    y.data(),
+                    m,
+                    yb.data(),
+                    batch.size(),
+                    d,
+                    0,
+                    cdis.data(),
+                    nullptr);
+        }
+    }
+
+    // 3. fewer distinct seeds than k, e.g. duplicate points: fill at random
+    while (nsel < k) {
+        int64_t i = rng.rand_int64() % nx;
+        if (!taken[i]) {
+            taken[i] = 1;
+            centroids_index[nsel++] = i;
+        }
+    }
+}
+
 /******************************************************************************
  * ProgressiveDimClustering implementation
  ******************************************************************************/
@@ -23,6 +23,7 @@ enum ClusteringType
     K_MEANS = 0,
     K_MEANS_PLUS_PLUS,
     K_MEANS_TWO,
+    K_MEANS_PARALLEL, ///< k-means|| seeding, see kmeans_parallel_seeding
 };
 
 // The default algorithm use the K_MEANS
@@ -134,6 +135,15 @@ struct Clustering : ClusteringParameters {
             idx_t nx,
             const uint8_t* x_in);
 
+    void kmeans_parallel_algorithm(
+            std::vector<int>& centroids_index,
+            int64_t random_seed,
+            size_t n_input_centroids,
+            size_t d,
+            size_t k,
+            idx_t nx,
+            const uint8_t* x_in);
+
     /** run with encoded vectors
      *
      * win addition to train()'s parameters takes a codec as parameter
@@ -236,6 +246,26 @@ float kmeans_clustering(
         const float* x,
         float* centroids);
 
+/** k-means|| seeding (Bahmani et al., Scalable K-Means++, VLDB 2012).
+ *
+ * A few rounds oversample the points with probabilities proportional to
+ * their squared distance to the candidates so far, each round a pass of the
+ * batched distance kernels over all the points; the candidates, weighted by
+ * the points nearest to them, are then reclustered to k seeds by a weighted
+ * k-means++ that picks them in batches. The quality of k-means++ seeding at
+ * a few passes over the data rather than k.
+ *
+ * @param x               training set (size nx * d)
+ * @param centroids_index [out] indices of the k seeds among the nx points
+ */
+void kmeans_parallel_seeding(
+        const float* x,
+        size_t nx,
+        size_t d,
+        size_t k,
+        int64_t seed,
+        int* centroids_index);
+
 } // namespace faiss
 
 #endif
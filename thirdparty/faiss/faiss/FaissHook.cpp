@@ -26,7 +26,10 @@ void sq_hook() {
         /* for IVFSQ */
         sq_get_distance_computer = sq_get_distance_computer_avx512;
         sq_sel_quantizer = sq_select_quantizer_avx512;
-        sq_sel_inv_list_scanner = sq_select_inverted_list_scanner_avx512;
+        // integer dot products of 8 bit codes and a quantized query
+        sq_sel_inv_list_scanner = cpu_support_avx512_vnni()
+                ? sq_select_inverted_list_scanner_avx512_vnni
+                : sq_select_inverted_list_scanner_avx512;
     } else if (use_avx2 && cpu_support_avx2()) {
         /* for IVFSQ */
         sq_get_distance_computer = sq_get_distance_computer_avx;
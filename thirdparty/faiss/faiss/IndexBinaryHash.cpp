@@ -9,8 +9,10 @@
 
 #include <faiss/IndexBinaryHash.h>
 
+#include <algorithm>
 #include <cinttypes>
 #include <cstdio>
+#include <cstring>
 #include <memory>
 
 #include <faiss/utils/hamming.h>
@@ -319,11 +321,28 @@ IndexBinaryMultiHash::~IndexBinaryMultiHash() {
 void IndexBinaryMultiHash::reset() {
     storage->reset();
     ntotal = 0;
-    for (auto map : maps) {
+    for (auto& map : maps) {
         map.clear();
     }
 }
 
+namespace {
+
+// the b bits of a code from bit ho on, without reading past the end of the
+// code
+uint64_t multihash_key(
+        const uint8_t* code,
+        size_t code_size,
+        int ho,
+        uint64_t mask) {
+    uint64_t hash = 0;
+    size_t offset = ho >> 3;
+    memcpy(&hash, code + offset, std::min<size_t>(8, code_size - offset));
+    return (hash >> (ho & 7)) & mask;
+}
+
+} // anonymous namespace
+
 void IndexBinaryMultiHash::add(idx_t n, const uint8_t* x) {
     storage->add(n, x);
     // populate maps
@@ -333,8 +352,7 @@ void IndexBinaryMultiHash::add(idx_t n, const uint8_t* x) {
         const uint8_t* xi = x + i * code_size;
         int ho = 0;
         for (int h = 0; h < nhash; h++) {
-            uint64_t hash = *(uint64_t*)(xi + (ho >> 3)) >> (ho & 7);
-            hash &= mask;
+            uint64_t hash = multihash_key(xi, code_size, ho, mask);
             maps[h][hash].push_back(i + ntotal);
             ho += b;
         }
@@ -362,11 +380,14 @@ static void verify_shortlist(
     }
 }
 
+// the ids filtered out by the bitset do not enter the shortlist
 template <class SearchResults>
 void search_1_query_multihash(
         const IndexBinaryMultiHash& index,
         const uint8_t* xi,
         SearchResults& res,
+        int nflip,
+        const BitsetView bitset,
         size_t& n0,
         size_t& nlist,
         size_t& ndis) {
@@ -376,11 +397,10 @@ void search_1_query_multihash(
 
     int ho = 0;
     for (int h = 0; h < index.nhash; h++) {
-        uint64_t qhash = *(uint64_t*)(xi + (ho >> 3)) >> (ho & 7);
-        qhash &= mask;
+        uint64_t qhash = multihash_key(xi, index.code_size, ho, mask);
         const IndexBinaryMultiHash::Map& map = index.maps[h];
 
-        FlipEnumerator fe(index.b, index.nflip);
+        FlipEnumerator fe(index.b, nflip);
         // loop over neighbors that are at most at nflip bits
         do {
             uint64_t hash = qhash ^ fe.x;
@@ -389,7 +409,9 @@ void search_1_query_multihash(
             if (it != map.end()) {
                 const std::vector<idx_t>& v = it->second;
                 for (auto i : v) {
-                    shortlist.insert(i);
+                    if (bitset.empty() || !bitset.test(i)) {
+                        shortlist.insert(i);
+                    }
                 }
                 nlist++;
             } else {
@@ -435,6 +457,16 @@ void IndexBinaryMultiHash::range_search(
         float radius,
         RangeSearchResult* result,
         const BitsetView bitset) const {
+    range_search_thread_safe(n, x, radius, result, nflip, bitset);
+}
+
+void IndexBinaryMultiHash::range_search_thread_safe(
+        idx_t n,
+        const uint8_t* x,
+        float radius,
+        RangeSearchResult* result,
+        int nflip,
+        const BitsetView bitset) const {
     size_t nlist = 0, ndis = 0, n0 = 0;
 
 #pragma omp parallel if (n > 100) reduction(+ : ndis, n0, nlist)
@@ -447,7 +479,8 @@ void IndexBinaryMultiHash::range_search(
             RangeSearchResults res = {radius, qres};
             const uint8_t* q = x + i * code_size;
 
-            search_1_query_multihash(*this, q, res, n0, nlist, ndis);
+            search_1_query_multihash(
+                    *this, q, res, nflip, bitset, n0, nlist, ndis);
         }
         pres.finalize();
     }
@@ -464,6 +497,17 @@ void IndexBinaryMultiHash::search(
         int32_t* distances,
         idx_t* labels,
         const BitsetView bitset) const {
+    search_thread_safe(n, x, k, distances, labels, nflip, bitset);
+}
+
+void IndexBinaryMultiHash::search_thread_safe(
+        idx_t n,
+        const uint8_t* x,
+        idx_t k,
+        int32_t* distances,
+        idx_t* labels,
+        int nflip,
+        const BitsetView bitset) const {
     FAISS_THROW_IF_NOT(k > 0);
 
     using HeapForL2 = CMax<int32_t, idx_t>;
@@ -478,7 +522,8 @@ void IndexBinaryMultiHash::search(
         KnnSearchResults res = {k, simi, idxi};
         const uint8_t* q = x + i * code_size;
 
-        search_1_query_multihash(*this, q, res, n0, nlist, ndis);
+        search_1_query_multihash(
+                *this, q, res, nflip, bitset, n0, nlist, ndis);
 
         heap_reorder<HeapForL2>(k, simi, idxi);
     }
@@ -490,7 +535,7 @@ void IndexBinaryMultiHash::search(
 
 size_t IndexBinaryMultiHash::hashtable_size() const {
     size_t tot = 0;
-    for (auto map : maps) {
+    for (auto& map : maps) {
         tot += map.size();
     }
 
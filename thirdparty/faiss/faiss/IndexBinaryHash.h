@@ -120,6 +120,26 @@ struct IndexBinaryMultiHash : IndexBinary {
             idx_t* labels,
             const BitsetView bitset = nullptr) const override;
 
+    /// same as range_search with nflip bit flips rather than the ones of the
+    /// index, for concurrent searches that differ in it
+    void range_search_thread_safe(
+            idx_t n,
+            const uint8_t* x,
+            float radius,
+            RangeSearchResult* result,
+            int nflip,
+            const BitsetView bitset = nullptr) const;
+
+    /// same as search with nflip bit flips rather than the ones of the index
+    void search_thread_safe(
+            idx_t n,
+            const uint8_t* x,
+            idx_t k,
+            int32_t* distances,
+            idx_t* labels,
+            int nflip,
+            const BitsetView bitset = nullptr) const;
+
     size_t hashtable_size() const;
 };
 
@@ -26,6 +26,7 @@
 #include <faiss/utils/hamming.h>
 #include <faiss/utils/jaccard-inl.h>
 #include <faiss/utils/utils.h>
+#include <knowhere/comp/cancellation.h>
 #include <cinttypes>
 namespace faiss {
 
@@ -343,6 +344,9 @@ void search_knn_hamming_heap_thread_safe(
             size_t nscan = 0;
 
             for (size_t ik = 0; ik < nprobe; ik++) {
+                if (knowhere::CancellationToken::CurrentCancelled()) {
+                    break;
+                }
                 idx_t key = keysi[ik]; /* select the list  */
                 if (key < 0) {
                     // not enough centroids for multiprobe
@@ -435,6 +439,9 @@ void search_knn_binary_dis_heap_thread_safe(
             size_t nscan = 0;
 
             for (size_t ik = 0; ik < nprobe; ik++) {
+                if (knowhere::CancellationToken::CurrentCancelled()) {
+                    break;
+                }
                 idx_t key = keysi[ik]; /* select the list  */
                 if (key < 0) {
                     // not enough centroids for multiprobe
@@ -527,6 +534,9 @@ void search_knn_hamming_count_thread_safe(
         size_t nscan = 0;
 
         for (size_t ik = 0; ik < nprobe; ik++) {
+            if (knowhere::CancellationToken::CurrentCancelled()) {
+                break;
+            }
             idx_t key = keysi[ik]; /* select the list  */
             if (key < 0) {
                 // not enough centroids for multiprobe
@@ -803,6 +813,9 @@ void IndexBinaryIVF::range_search_preassigned_thread_safe(
             size_t prev_nres = qres.nres;
 
             for (size_t ik = 0; ik < nprobe; ik++) {
+                if (knowhere::CancellationToken::CurrentCancelled()) {
+                    break;
+                }
                 scan_list_func(i, ik, qres);
                 if (qres.nres == prev_nres) break;
                 prev_nres = qres.nres;
@@ -0,0 +1,156 @@
+// -*- c++ -*-
+
+#include <faiss/IndexFlatHalf.h>
+
+#include <faiss/FaissHook.h>
+#include <faiss/impl/AuxIndexStructures.h>
+#include <faiss/impl/FaissAssert.h>
+#include <faiss/utils/Heap.h>
+
+namespace faiss {
+
+namespace {
+
+using half_dis_func_t = float (*)(const float*, const uint16_t*, size_t);
+
+half_dis_func_t half_dis_func(bool bf16, MetricType metric) {
+    if (metric == METRIC_INNER_PRODUCT) {
+        return bf16 ? bf16vec_inner_product : fp16vec_inner_product;
+    }
+    return bf16 ? bf16vec_L2sqr : fp16vec_L2sqr;
+}
+
+template <class C>
+void search_halves(
+        const IndexFlatHalf& index,
+        idx_t n,
+        const float* x,
+        idx_t k,
+        float* distances,
+        idx_t* labels,
+        const BitsetView bitset) {
+    size_t d = index.d;
+    const uint16_t* halves = index.get_halves();
+    half_dis_func_t dis_func = half_dis_func(index.bf16, index.metric_type);
+
+#pragma omp parallel for if (n > 1)
+    for (idx_t i = 0; i < n; i++) {
+        const float* xi = x + i * d;
+        float* simi = distances + i * k;
+        idx_t* idxi = labels + i * k;
+        heap_heapify<C>(k, simi, idxi);
+        float block_dis[heap_filter_block];
+        for (size_t j0 = 0; j0 < index.ntotal; j0 += heap_filter_block) {
+            size_t nb = std::min(heap_filter_block, index.ntotal - j0);
+            uint64_t filtered = bitset.empty() ? 0 : bitset.block(j0, nb);
+            if (filtered == (uint64_t(1) << nb) - 1) {
+                continue;
+            }
+            for (size_t b = 0; b < nb; b++) {
+                block_dis[b] = !((filtered >> b) & 1)
+                        ? dis_func(xi, halves + (j0 + b) * d, d)
+                        : C::neutral();
+            }
+            heap_addn_filtered<C>(
+                    k,
+                    simi,
+                    idxi,
+                    block_dis,
+                    nb,
+                    [](size_t) { return true; },
+                    [&](size_t b) { return idx_t(j0 + b); });
+        }
+        heap_reorder<C>(k, simi, idxi);
+    }
+}
+
+template <class C>
+void range_search_halves(
+        const IndexFlatHalf& index,
+        idx_t n,
+        const float* x,
+        float radius,
+        RangeSearchResult* result,
+        const BitsetView bitset) {
+    size_t d = index.d;
+    const uint16_t* halves = index.get_halves();
+    half_dis_func_t dis_func = half_dis_func(index.bf16, index.metric_type);
+
+#pragma omp parallel if (n > 1)
+    {
+        RangeSearchPartialResult pres(result);
+#pragma omp for
+        for (idx_t i = 0; i < n; i++) {
+            const float* xi = x + i * d;
+            RangeQueryResult& qres = pres.new_result(i);
+            for (size_t j = 0; j < index.ntotal; j++) {
+                if (bitset.empty() || !bitset.test(j)) {
+                    float dis = dis_func(xi, halves + j * d, d);
+                    if (C::cmp(radius, dis)) {
+                        qres.add(dis, j);
+                    }
+                }
+            }
+        }
+        pres.finalize();
+    }
+}
+
+} // namespace
+
+IndexFlatHalf::IndexFlatHalf(idx_t d, MetricType metric, bool bf16)
+        : IndexFlatCodes(sizeof(uint16_t) * d, d, metric), bf16(bf16) {
+    FAISS_THROW_IF_NOT_MSG(
+            metric == METRIC_L2 || metric == METRIC_INNER_PRODUCT,
+            "IndexFlatHalf supports L2 and IP only");
+}
+
+void IndexFlatHalf::search(
+        idx_t n,
+        const float* x,
+        idx_t k,
+        float* distances,
+        idx_t* labels,
+        const BitsetView bitset) const {
+    FAISS_THROW_IF_NOT(k > 0);
+    if (metric_type == METRIC_INNER_PRODUCT) {
+        search_halves<CMin<float, idx_t>>(
+                *this, n, x, k, distances, labels, bitset);
+    } else {
+        search_halves<CMax<float, idx_t>>(
+                *this, n, x, k, distances, labels, bitset);
+    }
+}
+
+void IndexFlatHalf::range_search(
+        idx_t n,
+        const float* x,
+        float radius,
+        RangeSearchResult* result,
+        const BitsetView bitset) const {
+    if (metric_type == METRIC_INNER_PRODUCT) {
+        range_search_halves<CMin<float, idx_t>>(
+                *this, n, x, radius, result, bitset);
+    } else {
+        range_search_halves<CMax<float, idx_t>>(
+                *this, n, x, radius, result, bitset);
+    }
+}
+
+void IndexFlatHalf::sa_encode(idx_t n, const float* x, uint8_t* bytes) const {
+    if (bf16) {
+        fvec_to_bf16((uint16_t*)bytes, x, n * d);
+    } else {
+        fvec_to_fp16((uint16_t*)bytes, x, n * d);
+    }
+}
+
+void IndexFlatHalf::sa_decode(idx_t n, const uint8_t* bytes, float* x) const {
+    if (bf16) {
+        bf16_to_fvec(x, (const uint16_t*)bytes, n * d);
+    } else {
+        fp16_to_fvec(x, (const uint16_t*)bytes, n * d);
+    }
+}
+
+} // namespace faiss
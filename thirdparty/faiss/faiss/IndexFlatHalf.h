@@ -0,0 +1,51 @@
+// -*- c++ -*-
+
+#pragma once
+
+#include <cstdint>
+
+#include <faiss/IndexFlatCodes.h>
+
+namespace faiss {
+
+/** Index that stores the vectors as fp16 or bf16 halves and performs
+ * exhaustive search on them, half the memory and bandwidth of IndexFlat.
+ * fp16 keeps 11 bits of mantissa in a narrow range, bf16 keeps the float32
+ * range with 8 bits of mantissa. */
+struct IndexFlatHalf : IndexFlatCodes {
+    /// the halves are bf16 rather than fp16
+    bool bf16 = false;
+
+    explicit IndexFlatHalf(
+            idx_t d,
+            MetricType metric = METRIC_L2,
+            bool bf16 = false);
+
+    IndexFlatHalf() {}
+
+    void search(
+            idx_t n,
+            const float* x,
+            idx_t k,
+            float* distances,
+            idx_t* labels,
+            const BitsetView bitset = nullptr) const override;
+
+    void range_search(
+            idx_t n,
+            const float* x,
+            float radius,
+            RangeSearchResult* result,
+            const BitsetView bitset = nullptr) const override;
+
+    /// the d halves of each vector
+    const uint16_t* get_halves() const {
+        return (const uint16_t*)codes.data();
+    }
+
+    void sa_encode(idx_t n, const float* x, uint8_t* bytes) const override;
+
+    void sa_decode(idx_t n, const uint8_t* bytes, float* x) const override;
+};
+
+} // namespace faiss
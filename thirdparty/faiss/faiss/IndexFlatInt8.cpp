@@ -0,0 +1,196 @@
+// -*- c++ -*-
+
+#include <faiss/IndexFlatInt8.h>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include <faiss/FaissHook.h>
+#include <faiss/impl/AuxIndexStructures.h>
+#include <faiss/impl/FaissAssert.h>
+#include <faiss/utils/Heap.h>
+
+namespace faiss {
+
+namespace {
+
+using int8_dis_func_t = float (*)(const int8_t*, const int8_t*, size_t);
+using int8_dis_ny_func_t =
+        void (*)(float*, const int8_t*, const int8_t*, size_t, size_t);
+
+int8_dis_func_t int8_dis_func(MetricType metric) {
+    return metric == METRIC_INNER_PRODUCT ? i8vec_inner_product : i8vec_L2sqr;
+}
+
+int8_dis_ny_func_t int8_dis_ny_func(MetricType metric) {
+    return metric == METRIC_INNER_PRODUCT ? i8vec_inner_products_ny
+                                          : i8vec_L2sqr_ny;
+}
+
+void round_to_int8(const float* x, size_t n, int8_t* out) {
+    for (size_t i = 0; i < n; i++) {
+        float v = std::nearbyint(x[i]);
+        out[i] = (int8_t)std::min(127.0f, std::max(-128.0f, v));
+    }
+}
+
+template <class C>
+void search_int8_codes(
+        const IndexFlatInt8& index,
+        idx_t n,
+        const int8_t* x,
+        idx_t k,
+        float* distances,
+        idx_t* labels,
+        const BitsetView bitset) {
+    size_t d = index.d;
+    const int8_t* base = index.get_int8();
+    int8_dis_func_t dis_func = int8_dis_func(index.metric_type);
+    int8_dis_ny_func_t dis_ny_func = int8_dis_ny_func(index.metric_type);
+
+#pragma omp parallel for if (n > 1)
+    for (idx_t i = 0; i < n; i++) {
+        const int8_t* xi = x + i * d;
+        float* simi = distances + i * k;
+        idx_t* idxi = labels + i * k;
+        heap_heapify<C>(k, simi, idxi);
+        float block_dis[heap_filter_block];
+        for (size_t j0 = 0; j0 < index.ntotal; j0 += heap_filter_block) {
+            size_t nb = std::min(heap_filter_block, index.ntotal - j0);
+            uint64_t filtered = bitset.empty() ? 0 : bitset.block(j0, nb);
+            if (filtered == (uint64_t(1) << nb) - 1) {
+                continue;
+            }
+            if (filtered == 0) {
+                // a whole block of rows one after the other, scanned by
+                // the kernel with the query loaded once
+                dis_ny_func(block_dis, xi, base + j0 * d, d, nb);
+            } else {
+                for (size_t b = 0; b < nb; b++) {
+                    block_dis[b] = !((filtered >> b) & 1)
+                            ? dis_func(xi, base + (j0 + b) * d, d)
+                            : C::neutral();
+                }
+            }
+            heap_addn_filtered<C>(
+                    k,
+                    simi,
+                    idxi,
+                    block_dis,
+                    nb,
+                    [](size_t) { return true; },
+                    [&](size_t b) { return idx_t(j0 + b); });
+        }
+        heap_reorder<C>(k, simi, idxi);
+    }
+}
+
+template <class C>
+void range_search_int8_codes(
+        const IndexFlatInt8& index,
+        idx_t n,
+        const int8_t* x,
+        float radius,
+        RangeSearchResult* result,
+        const BitsetView bitset) {
+    size_t d = index.d;
+    const int8_t* base = index.get_int8();
+    int8_dis_func_t dis_func = int8_dis_func(index.metric_type);
+
+#pragma omp parallel if (n > 1)
+    {
+        RangeSearchPartialResult pres(result);
+#pragma omp for
+        for (idx_t i = 0; i < n; i++) {
+            const int8_t* xi = x + i * d;
+            RangeQueryResult& qres = pres.new_result(i);
+            for (size_t j = 0; j < index.ntotal; j++) {
+                if (bitset.empty() || !bitset.test(j)) {
+                    float dis = dis_func(xi, base + j * d, d);
+                    if (C::cmp(radius, dis)) {
+                        qres.add(dis, j);
+                    }
+                }
+            }
+        }
+        pres.finalize();
+    }
+}
+
+} // namespace
+
+IndexFlatInt8::IndexFlatInt8(idx_t d, MetricType metric)
+        : IndexFlatCodes(d, d, metric) {
+    FAISS_THROW_IF_NOT_MSG(
+            metric == METRIC_L2 || metric == METRIC_INNER_PRODUCT,
+            "IndexFlatInt8 supports L2 and IP only");
+}
+
+void IndexFlatInt8::search(
+        idx_t n,
+        const float* x,
+        idx_t k,
+        float* distances,
+        idx_t* labels,
+        const BitsetView bitset) const {
+    std::vector<int8_t> xq(n * d);
+    round_to_int8(x, n * d, xq.data());
+    search_int8(n, xq.data(), k, distances, labels, bitset);
+}
+
+void IndexFlatInt8::range_search(
+        idx_t n,
+        const float* x,
+        float radius,
+        RangeSearchResult* result,
+        const BitsetView bitset) const {
+    std::vector<int8_t> xq(n * d);
+    round_to_int8(x, n * d, xq.data());
+    range_search_int8(n, xq.data(), radius, result, bitset);
+}
+
+void IndexFlatInt8::search_int8(
+        idx_t n,
+        const int8_t* x,
+        idx_t k,
+        float* distances,
+        idx_t* labels,
+        const BitsetView bitset) const {
+    FAISS_THROW_IF_NOT(k > 0);
+    if (metric_type == METRIC_INNER_PRODUCT) {
+        search_int8_codes<CMin<float, idx_t>>(
+                *this, n, x, k, distances, labels, bitset);
+    } else {
+        search_int8_codes<CMax<float, idx_t>>(
+                *this, n, x, k, distances, labels, bitset);
+    }
+}
+
+void IndexFlatInt8::range_search_int8(
+        idx_t n,
+        const int8_t* x,
+        float radius,
+        RangeSearchResult* result,
+        const BitsetView bitset) const {
+    if (metric_type == METRIC_INNER_PRODUCT) {
+        range_search_int8_codes<CMin<float, idx_t>>(
+                *this, n, x, radius, result, bitset);
+    } else {
+        range_search_int8_codes<CMax<float, idx_t>>(
+                *this, n, x, radius, result, bitset);
+    }
+}
+
+void IndexFlatInt8::sa_encode(idx_t n, const float* x, uint8_t* bytes) const {
+    round_to_int8(x, n * d, (int8_t*)bytes);
+}
+
+void IndexFlatInt8::sa_decode(idx_t n, const uint8_t* bytes, float* x) const {
+    const int8_t* codes_i8 = (const int8_t*)bytes;
+    for (size_t i = 0; i < n * d; i++) {
+        x[i] = codes_i8[i];
+    }
+}
+
+} // namespace faiss
@@ -0,0 +1,62 @@
+// -*- c++ -*-
+
+#pragma once
+
+#include <cstdint>
+
+#include <faiss/IndexFlatCodes.h>
+
+namespace faiss {
+
+/** Index that stores the vectors as int8 components and performs exhaustive
+ * search on them, a quarter of the memory and bandwidth of IndexFlat. It is
+ * exact for the embeddings a model emits as int8: the distances of int8
+ * queries are summed exactly in int32. Float vectors are rounded to int8,
+ * saturating, when they are added or searched. */
+struct IndexFlatInt8 : IndexFlatCodes {
+    explicit IndexFlatInt8(idx_t d, MetricType metric = METRIC_L2);
+
+    IndexFlatInt8() {}
+
+    void search(
+            idx_t n,
+            const float* x,
+            idx_t k,
+            float* distances,
+            idx_t* labels,
+            const BitsetView bitset = nullptr) const override;
+
+    void range_search(
+            idx_t n,
+            const float* x,
+            float radius,
+            RangeSearchResult* result,
+            const BitsetView bitset = nullptr) const override;
+
+    /// search of n int8 queries of d components, without rounding them
+    void search_int8(
+            idx_t n,
+            const int8_t* x,
+            idx_t k,
+            float* distances,
+            idx_t* labels,
+            const BitsetView bitset = nullptr) const;
+
+    void range_search_int8(
+            idx_t n,
+            const int8_t* x,
+            float radius,
+            RangeSearchResult* result,
+            const BitsetView bitset = nullptr) const;
+
+    /// the d components of each vector
+    const int8_t* get_int8() const {
+        return (const int8_t*)codes.data();
+    }
+
+    void sa_encode(idx_t n, const float* x, uint8_t* bytes) const override;
+
+    void sa_decode(idx_t n, const uint8_t* bytes, float* x) const override;
+};
+
+} // namespace faiss
@@ -14,13 +14,16 @@
 
 #include <algorithm>
 #include <cinttypes>
+#include <cmath>
 #include <cstdio>
 #include <iostream>
 #include <memory>
 
 
+#include <knowhere/comp/cancellation.h>
 #include <knowhere/utils.h>
 
+#include <faiss/FaissHook.h>
 #include <faiss/utils/hamming.h>
 #include <faiss/utils/utils.h>
 
@@ -98,6 +101,9 @@ void Level1Quantizer::train_q1(
             printf("Training level-1 quantizer on %zd vectors in %zdD\n", n, d);
 
         Clustering clus(d, nlist, cp);
+        if (init_centroids.size() == nlist * d) {
+            clus.centroids = init_centroids;
+        }
         quantizer->reset();
         if (clustering_index) {
             clus.train(n, x, *clustering_index);
@@ -120,6 +126,9 @@ void Level1Quantizer::train_q1(
                 (metric_type == METRIC_INNER_PRODUCT && cp.spherical));
 
         Clustering clus(d, nlist, cp);
+        if (init_centroids.size() == nlist * d) {
+            clus.centroids = init_centroids;
+        }
         if (!clustering_index) {
             IndexFlatL2 assigner(d);
             clus.train(n, x, assigner);
@@ -215,11 +224,66 @@ void IndexIVF::add_without_codes(idx_t n, const float* x) {
 }
 
 void IndexIVF::add_with_ids(idx_t n, const float* x, const idx_t* xids) {
+    // the radii do not bound the new vectors
+    clear_list_radius();
     std::unique_ptr<idx_t[]> coarse_idx(new idx_t[n]);
     quantizer->assign(n, x, coarse_idx.get());
     add_core(n, x, nullptr, xids, coarse_idx.get());
 }
 
+size_t IndexIVF::split_lists(idx_t n, const float* x, size_t max_list_size) {
+    FAISS_THROW_IF_NOT_MSG(
+            ntotal == 0, "lists can only be split before the first add");
+    FAISS_THROW_IF_NOT(max_list_size > 0);
+    FAISS_THROW_IF_NOT_MSG(
+            dynamic_cast<ArrayInvertedLists*>(invlists),
+            "only ArrayInvertedLists can be split");
+
+    std::unique_ptr<idx_t[]> assign(new idx_t[n]);
+    quantizer->assign(n, x, assign.get());
+    std::vector<std::vector<idx_t>> members(nlist);
+    for (idx_t i = 0; i < n; i++) {
+        if (assign[i] >= 0) {
+            members[assign[i]].push_back(i);
+        }
+    }
+
+    std::vector<float> centroids(nlist * d);
+    quantizer->reconstruct_n(0, nlist, centroids.data());
+    size_t nadded = 0;
+    for (size_t list_no = 0; list_no < members.size(); list_no++) {
+        const auto& rows = members[list_no];
+        if (rows.size() <= max_list_size) {
+            continue;
+        }
+        size_t nsub = (rows.size() + max_list_size - 1) / max_list_size;
+        std::vector<float> xs(rows.size() * d);
+        for (size_t i = 0; i < rows.size(); i++) {
+            memcpy(xs.data() + i * d, x + rows[i] * d, sizeof(float) * d);
+        }
+        Clustering clus(d, nsub, cp);
+        IndexFlat assigner(d, metric_type);
+        clus.train(rows.size(), xs.data(), assigner);
+        memcpy(centroids.data() + list_no * d,
+               clus.centroids.data(),
+               sizeof(float) * d);
+        centroids.insert(
+                centroids.end(),
+                clus.centroids.begin() + d,
+                clus.centroids.end());
+        nadded += nsub - 1;
+    }
+    if (nadded == 0) {
+        return 0;
+    }
+
+    nlist += nadded;
+    quantizer->reset();
+    quantizer->add(nlist, centroids.data());
+    replace_invlists(new ArrayInvertedLists(nlist, code_size), true);
+    return nadded;
+}
+
 void IndexIVF::add_with_ids_without_codes(
         idx_t n,
         const float* x,
@@ -491,15 +555,19 @@ void IndexIVF::search_preassigned(
     bool do_heap_init =
             !(preassigned_parallel_mode & PARALLEL_MODE_NO_HEAP_INIT);
 
+    auto radii = get_list_radius();
+    bool pruning = radii != nullptr && radii->radius.size() == nlist;
+
     bool do_parallel = omp_get_max_threads() >= 2 &&
-            (pmode == 0           ? false
-                     : pmode == 3 ? n > 1
-                     : pmode == 1 ? nprobe > 1
-                                  : nprobe * n > 1);
+            (pmode == 0 || pmode == 4 ? false
+                     : pmode == 3         ? n > 1
+                     : pmode == 1         ? nprobe > 1
+                                          : nprobe * n > 1);
 
 #pragma omp parallel if (do_parallel) reduction(+ : nlistv, ndis, nheap)
     {
-        InvertedListScanner* scanner = get_InvertedListScanner(store_pairs);
+        InvertedListScanner* scanner =
+                get_InvertedListScanner_with_params(store_pairs, params);
         ScopeDeleter1<InvertedListScanner> del(scanner);
 
         /*****************************************************
@@ -628,10 +696,36 @@ void IndexIVF::search_preassigned(
 
                 idx_t nscan = 0;
 
+                float query_norm = pruning &&
+                                metric_type == METRIC_INNER_PRODUCT
+                        ? std::sqrt(fvec_norm_L2sqr(x + i * d, d))
+                        : 0;
+
                 // loop over probes
                 for (size_t ik = 0; ik < nprobe; ik++) {
+                    if (knowhere::CancellationToken::CurrentCancelled()) {
+                        break;
+                    }
+                    idx_t key = keys[i * nprobe + ik];
+                    if (pruning && key >= 0) {
+                        float dis = coarse_dis[i * nprobe + ik];
+                        if (list_out_of_reach(
+                                    dis,
+                                    radii->max_radius,
+                                    query_norm,
+                                    simi[0])) {
+                            break;
+                        }
+                        if (list_out_of_reach(
+                                    dis,
+                                    radii->radius[key],
+                                    query_norm,
+                                    simi[0])) {
+                            continue;
+                        }
+                    }
                     nscan += scan_one_list(
-                            keys[i * nprobe + ik],
+                            key,
                             coarse_dis[i * nprobe + ik],
                             simi,
                             idxi,
@@ -721,6 +815,41 @@ void IndexIVF::search_preassigned(
             for (int64_t i = 0; i < n; i++) {
                 reorder_result(distances + i * k, labels + i * k);
             }
+        } else if (pmode == 4) {
+            // list major: the (list, query) pairs are sorted by list, so that
+            // a list probed by several queries is scanned back to back while
+            // its codes are in cache
+            std::vector<std::pair<idx_t, idx_t>> pairs;
+            pairs.reserve(n * nprobe);
+            for (idx_t ij = 0; ij < n * nprobe; ij++) {
+                if (keys[ij] >= 0) {
+                    pairs.emplace_back(keys[ij], ij);
+                }
+            }
+            std::sort(pairs.begin(), pairs.end());
+
+            for (idx_t i = 0; i < n; i++) {
+                init_result(distances + i * k, labels + i * k);
+            }
+            for (const auto& [key, ij] : pairs) {
+                if (knowhere::CancellationToken::CurrentCancelled()) {
+                    break;
+                }
+                if (interrupt) {
+                    break;
+                }
+                size_t i = ij / nprobe;
+                scanner->set_query(x + i * d);
+                ndis += scan_one_list(
+                        key,
+                        coarse_dis[ij],
+                        distances + i * k,
+                        labels + i * k,
+                        bitset);
+            }
+            for (idx_t i = 0; i < n; i++) {
+                reorder_result(distances + i * k, labels + i * k);
+            }
         } else {
             FAISS_THROW_FMT("parallel_mode %d not supported\n", pmode);
         }
@@ -805,6 +934,11 @@ void IndexIVF::range_search_preassigned(
         preassigned_parallel_mode = this->parallel_mode;
     }
     int pmode = preassigned_parallel_mode & ~PARALLEL_MODE_NO_HEAP_INIT;
+    // with the list radii the probed lists are bounded by the range rather
+    // than stopping at the first one without results
+    auto radii = get_list_radius();
+    bool pruning = radii != nullptr && radii->radius.size() == nlist;
+
     // don't start parallel section if single query
     bool do_parallel = omp_get_max_threads() >= 2 &&
             (pmode == 3           ? false
@@ -816,7 +950,7 @@ void IndexIVF::range_search_preassigned(
     {
         RangeSearchPartialResult pres(result);
         std::unique_ptr<InvertedListScanner> scanner(
-                get_InvertedListScanner(store_pairs));
+                get_InvertedListScanner_with_params(store_pairs, params));
         FAISS_THROW_IF_NOT(scanner.get());
         all_pres[omp_get_thread_num()] = &pres;
 
@@ -874,9 +1008,31 @@ void IndexIVF::range_search_preassigned(
             RangeQueryResult& qres = pres.new_result(i);
             size_t prev_nres = qres.nres;
 
+            float query_norm = pruning && metric_type == METRIC_INNER_PRODUCT
+                    ? std::sqrt(fvec_norm_L2sqr(x + i * d, d))
+                    : 0;
+
             for (size_t ik = 0; ik < nprobe; ik++) {
+                if (knowhere::CancellationToken::CurrentCancelled()) {
+                    break;
+                }
+                idx_t key = keys[i * nprobe + ik];
+                if (pruning && key >= 0) {
+                    // the lists come by centroid distance, none past the
+                    // first one out of reach of the largest radius can
+                    // hold a vector within the range
+                    float dis = coarse_dis[i * nprobe + ik];
+                    if (list_out_of_reach(
+                                dis, radii->max_radius, query_norm, radius)) {
+                        break;
+                    }
+                    if (list_out_of_reach(
+                                dis, radii->radius[key], query_norm, radius)) {
+                        continue;
+                    }
+                }
                 scan_list_func(i, ik, qres);
-                if (qres.nres == prev_nres) break;
+                if (!pruning && qres.nres == prev_nres) break;
                 prev_nres = qres.nres;
             }
         }
@@ -904,6 +1060,12 @@ InvertedListScanner* IndexIVF::get_InvertedListScanner(
     return nullptr;
 }
 
+InvertedListScanner* IndexIVF::get_InvertedListScanner_with_params(
+        bool store_pairs,
+        const IVFSearchParameters* /*params*/) const {
+    return get_InvertedListScanner(store_pairs);
+}
+
 void IndexIVF::reconstruct(idx_t key, float* recons) const {
     idx_t lo = direct_map.get(key);
     reconstruct_from_offset(lo_listno(lo), lo_offset(lo), recons);
@@ -1017,9 +1179,54 @@ void IndexIVF::reset() {
     invlists->reset();
     arranged_codes.clear();
     prefix_sum.clear();
+    clear_list_radius();
     ntotal = 0;
 }
 
+void IndexIVF::compute_list_radius() {
+    auto radii = std::make_shared<ListRadius>();
+    std::vector<float>& radius = radii->radius;
+    radius.assign(nlist, 0);
+    bool without_codes = !arranged_codes.empty();
+
+#pragma omp parallel for schedule(dynamic)
+    for (idx_t list_no = 0; list_no < nlist; list_no++) {
+        std::vector<float> centroid(d), recons(d);
+        quantizer->reconstruct(list_no, centroid.data());
+        size_t list_size = invlists->list_size(list_no);
+        float max_dis = 0;
+        for (size_t offset = 0; offset < list_size; offset++) {
+            if (without_codes) {
+                reconstruct_from_offset_without_codes(
+                        list_no, offset, recons.data());
+            } else {
+                reconstruct_from_offset(list_no, offset, recons.data());
+            }
+            max_dis = std::max(
+                    max_dis, fvec_L2sqr(recons.data(), centroid.data(), d));
+        }
+        radius[list_no] = std::sqrt(max_dis);
+    }
+
+    radii->max_radius =
+            nlist > 0 ? *std::max_element(radius.begin(), radius.end()) : 0;
+    std::atomic_store(&list_radius, std::shared_ptr<const ListRadius>(radii));
+}
+
+bool IndexIVF::list_out_of_reach(
+        float coarse_dis,
+        float radius,
+        float query_norm,
+        float kth) const {
+    if (metric_type == METRIC_INNER_PRODUCT) {
+        // <q, y> = <q, c> + <q, y - c> <= <q, c> + |q| * radius
+        return coarse_dis + query_norm * radius < kth;
+    }
+    // |q - y| >= |q - c| - radius, coarse_dis and kth are squared
+    float lower_bound = std::sqrt(coarse_dis) - radius;
+    return lower_bound > 0 && lower_bound * lower_bound > kth;
+}
+
 size_t IndexIVF::remove_ids(const IDSelector& sel) {
     size_t nremove = direct_map.remove_ids(sel, invlists);
     ntotal -= nremove;
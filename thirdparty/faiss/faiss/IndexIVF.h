@@ -11,6 +11,7 @@
 #define FAISS_INDEX_IVF_H
 
 #include <stdint.h>
+#include <memory>
 #include <unordered_map>
 #include <vector>
 
@@ -47,6 +48,9 @@ struct Level1Quantizer {
     ClusteringParameters cp; ///< to override default clustering params
     Index* clustering_index; ///< to override index used during clustering
 
+    /// if set (nlist * d), initial centroids of the level-1 k-means
+    std::vector<float> init_centroids;
+
     /// Trains the quantizer and calls train_residual to train sub-quantizers
     void train_q1(
             size_t n,
@@ -122,18 +126,47 @@ struct IndexIVF : Index, Level1Quantizer {
     std::vector<uint8_t> arranged_codes;
     std::vector<size_t> prefix_sum;
 
+    struct ListRadius {
+        std::vector<float> radius;
+        float max_radius = 0;
+    };
+
+    /** Per list largest distance of its vectors to the centroid, filled by
+     * compute_list_radius() and dropped by add_with_ids(). When set, the
+     * searches that scan the lists query by query skip a probed list as soon
+     * as the triangle inequality shows that none of its vectors can enter the
+     * current top k, and stop at the first list out of reach of the largest
+     * radius since the lists come by increasing centroid distance. Range
+     * searches bound their lists the same way by the range.
+     *
+     * It is only replaced as a whole, atomically: a search works on the
+     * radii it took with get_list_radius(), whatever an add does meanwhile.
+     */
+    std::shared_ptr<const ListRadius> list_radius;
+
+    std::shared_ptr<const ListRadius> get_list_radius() const {
+        return std::atomic_load(&list_radius);
+    }
+
+    void clear_list_radius() {
+        std::atomic_store(&list_radius, std::shared_ptr<const ListRadius>());
+    }
+
     /** Parallel mode determines how queries are parallelized with OpenMP
      *
      * 0 (default): split over queries
      * 1: parallelize over inverted lists
      * 2: parallelize over both
      * 3: split over queries with a finer granularity
+     * 4: no parallelism, each inverted list is scanned once for all the
+     *    queries that probe it (list major)
      *
      * PARALLEL_MODE_NO_HEAP_INIT: binary or with the previous to
      * prevent the heap to be initialized and finalized
      */
     int parallel_mode;
     const int PARALLEL_MODE_NO_HEAP_INIT = 1024;
+    static constexpr int PARALLEL_MODE_LIST_MAJOR = 4;
 
     /** optional map that maps back ids to invlist entries. This
      *  enables reconstruct() */
@@ -184,6 +217,16 @@ struct IndexIVF : Index, Level1Quantizer {
             const idx_t* xids,
             const idx_t* precomputed_idx);
 
+    /** Before the first add, splits every list the n vectors x would make
+     * larger than max_list_size: a k-means of its vectors gives
+     * ceil(size / max_list_size) sub-centroids, the first one replaces the
+     * centroid and the others are appended, so nlist grows. The lists must
+     * be ArrayInvertedLists.
+     *
+     * @return the number of lists added
+     */
+    size_t split_lists(idx_t n, const float* x, size_t max_list_size);
+
     /** Encodes a set of vectors as they would appear in the inverted lists
      *
      * @param list_nos   inverted list ids as returned by the
@@ -343,6 +386,12 @@ struct IndexIVF : Index, Level1Quantizer {
     virtual InvertedListScanner* get_InvertedListScanner(
             bool store_pairs = false) const;
 
+    /** Get a scanner for a search with params, which may override fields of
+     * the index for that search; the default ignores them */
+    virtual InvertedListScanner* get_InvertedListScanner_with_params(
+            bool store_pairs,
+            const IVFSearchParameters* params) const;
+
     /** reconstruct a vector. Works only if maintain_direct_map is set to 1 or 2
      */
     void reconstruct(idx_t key, float* recons) const override;
@@ -404,6 +453,19 @@ struct IndexIVF : Index, Level1Quantizer {
             int64_t offset,
             float* recons) const;
 
+    /// fills list_radius from the reconstructed vectors, those of
+    /// arranged_codes when they are set
+    void compute_list_radius();
+
+    /** whether no vector within radius of a centroid at coarse_dis from a
+     * query can be closer than kth, query_norm is only used for inner
+     * product */
+    bool list_out_of_reach(
+            float coarse_dis,
+            float radius,
+            float query_norm,
+            float kth) const;
+
     /// Dataset manipulation functions
 
     size_t remove_ids(const IDSelector& sel) override;
@@ -42,18 +42,50 @@ IndexIVFFlat::IndexIVFFlat(
 
 void IndexIVFFlat::arrange_codes(idx_t n, const float* x) {
     auto ails = dynamic_cast<faiss::ArrayInvertedLists*>(invlists);
+    size_t block = column_blocked ? kColumnBlock : 1;
     prefix_sum.resize(invlists->nlist + 1);
     prefix_sum[0] = 0;
-    arranged_codes.resize(d * n * sizeof(float));
-    auto dst = (float*)(arranged_codes.data());
+    for (size_t i = 0; i < invlists->nlist; i++) {
+        auto rows = (ails->ids[i].size() + block - 1) / block * block;
+        prefix_sum[i + 1] = prefix_sum[i] + rows;
+    }
+    arranged_codes.assign(prefix_sum[invlists->nlist] * code_size, 0);
+    auto codes = (float*)(arranged_codes.data());
     for (size_t i = 0; i < invlists->nlist; i++) {
         auto list_size = ails->ids[i].size();
         for (size_t j = 0; j < list_size; j++) {
             const float* src = x + d * ails->ids[i][j];
-            std::copy_n(src, d, dst);
-            dst += d;
+            if (column_blocked) {
+                float* dst = codes + (prefix_sum[i] + j / block * block) * d;
+                for (size_t t = 0; t < d; t++) {
+                    dst[t * block + j % block] = src[t];
+                }
+            } else {
+                std::copy_n(src, d, codes + (prefix_sum[i] + j) * d);
+            }
+        }
+    }
+}
+
+void IndexIVFFlat::normalize_arranged_codes() {
+    auto codes = (float*)(arranged_codes.data());
+    size_t rows = arranged_codes.size() / code_size;
+    if (!column_blocked) {
+        knowhere::NormalizeVecs(codes, rows, d);
+        return;
+    }
+    std::vector<float> vec(d);
+    for (size_t b = 0; b < rows; b += kColumnBlock) {
+        float* block = codes + b * d;
+        for (size_t j = 0; j < kColumnBlock; j++) {
+            for (size_t t = 0; t < d; t++) {
+                vec[t] = block[t * kColumnBlock + j];
+            }
+            knowhere::NormalizeVec(vec.data(), d);
+            for (size_t t = 0; t < d; t++) {
+                block[t * kColumnBlock + j] = vec[t];
+            }
         }
-        prefix_sum[i + 1] = prefix_sum[i] + list_size;
     }
 }
 
@@ -220,22 +252,45 @@ struct IVFFlatScanner : InvertedListScanner {
             size_t k,
             const BitsetView bitset) const override {
         const float* list_vecs = (const float*)codes;
+        float block_dis[heap_filter_block];
         size_t nup = 0;
-        for (size_t j = 0; j < list_size; j++) {
-            if (bitset.empty() || !bitset.test(ids[j])) {
-                const float* yj = list_vecs + d * j;
-                float dis = metric == METRIC_INNER_PRODUCT
-                        ? fvec_inner_product(xi, yj, d)
-                        : fvec_L2sqr(xi, yj, d);
-                if (code_norms) {
-                    dis /= code_norms[j];
+        for (size_t j0 = 0; j0 < list_size; j0 += heap_filter_block) {
+            size_t nb = std::min(heap_filter_block, list_size - j0);
+            const float* y0 = list_vecs + d * j0;
+            if (bitset.empty()) {
+                if (metric == METRIC_INNER_PRODUCT) {
+                    fvec_inner_products_ny(block_dis, xi, y0, d, nb);
+                } else {
+                    fvec_L2sqr_ny(block_dis, xi, y0, d, nb);
                 }
-                if (C::cmp(simi[0], dis)) {
-                    int64_t id = store_pairs ? lo_build(list_no, j) : ids[j];
-                    heap_replace_top<C>(k, simi, idxi, dis, id);
-                    nup++;
+            } else {
+                // the filtered out vectors are not computed and never pass
+                for (size_t b = 0; b < nb; b++) {
+                    if (bitset.test(ids[j0 + b])) {
+                        block_dis[b] = C::neutral();
+                    } else {
+                        block_dis[b] = metric == METRIC_INNER_PRODUCT
+                                ? fvec_inner_product(xi, y0 + d * b, d)
+                                : fvec_L2sqr(xi, y0 + d * b, d);
+                    }
                 }
             }
+            if (code_norms) {
+                for (size_t b = 0; b < nb; b++) {
+                    block_dis[b] /= code_norms[j0 + b];
+                }
+            }
+            nup += heap_addn_filtered<C>(
+                    k,
+                    simi,
+                    idxi,
+                    block_dis,
+                    nb,
+                    [](size_t) { return true; },
+                    [&](size_t b) {
+                        return store_pairs ? lo_build(list_no, j0 + b)
+                                           : ids[j0 + b];
+                    });
         }
         return nup;
     }
@@ -267,10 +322,118 @@ struct IVFFlatScanner : InvertedListScanner {
     }
 };
 
+/// scans lists arranged in column blocks of IndexIVFFlat::kColumnBlock vectors
+template <MetricType metric, class C>
+struct IVFFlatBlockedScanner : InvertedListScanner {
+    static constexpr size_t kBlock = IndexIVFFlat::kColumnBlock;
+    size_t d;
+
+    IVFFlatBlockedScanner(size_t d, bool store_pairs) : d(d) {
+        this->store_pairs = store_pairs;
+    }
+
+    const float* xi;
+    void set_query(const float* query) override {
+        this->xi = query;
+    }
+
+    void set_list(idx_t list_no, float /* coarse_dis */) override {
+        this->list_no = list_no;
+    }
+
+    float distance_to_code(const uint8_t* /* code */) const override {
+        FAISS_THROW_MSG("column blocked codes are only scanned by blocks");
+    }
+
+    void distances_to_block(const float* block, float* dis) const {
+        if (metric == METRIC_INNER_PRODUCT) {
+            fvec_inner_product_block_16(dis, xi, block, d);
+        } else {
+            fvec_L2sqr_block_16(dis, xi, block, d);
+        }
+    }
+
+    size_t scan_codes(
+            size_t list_size,
+            const uint8_t* codes,
+            const float* code_norms,
+            const idx_t* ids,
+            float* simi,
+            idx_t* idxi,
+            size_t k,
+            const BitsetView bitset) const override {
+        const float* blocks = (const float*)codes;
+        float block_dis[kBlock];
+        size_t nup = 0;
+        for (size_t j0 = 0; j0 < list_size; j0 += kBlock) {
+            distances_to_block(blocks + j0 * d, block_dis);
+            size_t nb = std::min(list_size - j0, kBlock);
+            if (code_norms) {
+                for (size_t b = 0; b < nb; b++) {
+                    block_dis[b] /= code_norms[j0 + b];
+                }
+            }
+            nup += heap_addn_filtered<C>(
+                    k,
+                    simi,
+                    idxi,
+                    block_dis,
+                    nb,
+                    [&](size_t b) {
+                        return bitset.empty() || !bitset.test(ids[j0 + b]);
+                    },
+                    [&](size_t b) {
+                        return store_pairs ? lo_build(list_no, j0 + b)
+                                           : ids[j0 + b];
+                    });
+        }
+        return nup;
+    }
+
+    void scan_codes_range(
+            size_t list_size,
+            const uint8_t* codes,
+            const float* code_norms,
+            const idx_t* ids,
+            float radius,
+            RangeQueryResult& res,
+            const BitsetView bitset) const override {
+        const float* blocks = (const float*)codes;
+        float block_dis[kBlock];
+        for (size_t j0 = 0; j0 < list_size; j0 += kBlock) {
+            distances_to_block(blocks + j0 * d, block_dis);
+            size_t j1 = std::min(list_size, j0 + kBlock);
+            for (size_t j = j0; j < j1; j++) {
+                if (bitset.empty() || !bitset.test(ids[j])) {
+                    float dis = block_dis[j - j0];
+                    if (code_norms) {
+                        dis /= code_norms[j];
+                    }
+                    if (C::cmp(radius, dis)) {
+                        int64_t id = store_pairs ? lo_build(list_no, j) : ids[j];
+                        res.add(dis, id);
+                    }
+                }
+            }
+        }
+    }
+};
+
 } // anonymous namespace
 
 InvertedListScanner* IndexIVFFlat::get_InvertedListScanner(
         bool store_pairs) const {
+    if (column_blocked) {
+        if (metric_type == METRIC_INNER_PRODUCT) {
+            return new IVFFlatBlockedScanner<
+                    METRIC_INNER_PRODUCT,
+                    CMin<float, int64_t>>(d, store_pairs);
+        } else if (metric_type == METRIC_L2) {
+            return new IVFFlatBlockedScanner<METRIC_L2, CMax<float, int64_t>>(
+                    d, store_pairs);
+        }
+        FAISS_THROW_MSG("metric type not supported");
+    }
     if (metric_type == METRIC_INNER_PRODUCT) {
         return new IVFFlatScanner<METRIC_INNER_PRODUCT, CMin<float, int64_t>>(
                 d, store_pairs);
@@ -315,6 +478,14 @@ void IndexIVFFlat::reconstruct_from_offset_without_codes(
             reinterpret_cast<uint8_t*>(rol->pin_readonly_codes->data);
     memcpy(recons, arranged_data + idx * code_size, code_size);
 #else
+    if (column_blocked) {
+        auto block = (const float*)arranged_codes.data() +
+                (prefix_sum[list_no] + offset / kColumnBlock * kColumnBlock) * d;
+        for (size_t t = 0; t < d; t++) {
+            recons[t] = block[t * kColumnBlock + offset % kColumnBlock];
+        }
+        return;
+    }
     memcpy(recons, arranged_codes.data() + idx * code_size, code_size);
 #endif
 }
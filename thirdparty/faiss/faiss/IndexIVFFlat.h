@@ -28,8 +28,20 @@ struct IndexIVFFlat : IndexIVF {
             size_t nlist_,
             MetricType = METRIC_L2);
 
+    /// vectors per column block of the arranged codes
+    static constexpr size_t kColumnBlock = 16;
+
+    /** arrange_codes stores every list in blocks of kColumnBlock vectors laid
+     * out dimension by dimension, the last block of a list zero padded, so
+     * that a scan computes the distances of a whole block at once. prefix_sum
+     * then counts the padded rows */
+    bool column_blocked = false;
+
     void arrange_codes(idx_t n, const float* x);
 
+    /// normalizes the arranged vectors, for the cosine metric
+    void normalize_arranged_codes();
+
     void add_with_ids_without_codes(
             idx_t n,
             const float* x,
@@ -605,7 +605,7 @@ struct QueryTables {
     void init_query_L2() {
         if (!by_residual) {
             pq.compute_distance_table(qi, sim_table);
-        } else if (use_precomputed_table) {
+        } else if (use_precomputed_table > 0) {
             pq.compute_inner_prod_table(qi, sim_table_2);
         }
     }
@@ -963,7 +963,7 @@ struct IVFPQScannerT : QueryTables {
             const uint8_t* codes,
             SearchResultType& res,
             const BitsetView bitset = nullptr) const {
-        int ht = ivfpq.polysemous_ht;
+        int ht = this->polysemous_ht;
         size_t n_hamming_pass = 0, nup = 0;
 
         int code_size = pq.code_size;
@@ -1033,10 +1033,14 @@ struct IVFPQScanner : IVFPQScannerT<Index::idx_t, METRIC_TYPE, PQDecoder>,
                       InvertedListScanner {
     int precompute_mode;
 
-    IVFPQScanner(const IndexIVFPQ& ivfpq, bool store_pairs, int precompute_mode)
+    IVFPQScanner(
+            const IndexIVFPQ& ivfpq,
+            bool store_pairs,
+            int precompute_mode,
+            const IVFSearchParameters* params = nullptr)
             : IVFPQScannerT<Index::idx_t, METRIC_TYPE, PQDecoder>(
                       ivfpq,
-                      nullptr),
+                      params),
               precompute_mode(precompute_mode) {
         this->store_pairs = store_pairs;
     }
@@ -1127,15 +1131,16 @@ struct IVFPQScanner : IVFPQScannerT<Index::idx_t, METRIC_TYPE, PQDecoder>,
 template <class PQDecoder>
 InvertedListScanner* get_InvertedListScanner1(
         const IndexIVFPQ& index,
-        bool store_pairs) {
+        bool store_pairs,
+        const IVFSearchParameters* params) {
     if (index.metric_type == METRIC_INNER_PRODUCT) {
         return new IVFPQScanner<
                 METRIC_INNER_PRODUCT,
                 CMin<float, idx_t>,
-                PQDecoder>(index, store_pairs, 2);
+                PQDecoder>(index, store_pairs, 2, params);
     } else if (index.metric_type == METRIC_L2) {
         return new IVFPQScanner<METRIC_L2, CMax<float, idx_t>, PQDecoder>(
-                index, store_pairs, 2);
+                index, store_pairs, 2, params);
     }
     return nullptr;
 }
@@ -1144,12 +1149,21 @@ InvertedListScanner* get_InvertedListScanner1(
 
 InvertedListScanner* IndexIVFPQ::get_InvertedListScanner(
         bool store_pairs) const {
+    return get_InvertedListScanner_with_params(store_pairs, nullptr);
+}
+
+InvertedListScanner* IndexIVFPQ::get_InvertedListScanner_with_params(
+        bool store_pairs,
+        const IVFSearchParameters* params) const {
     if (pq.nbits == 8) {
-        return get_InvertedListScanner1<PQDecoder8>(*this, store_pairs);
+        return get_InvertedListScanner1<PQDecoder8>(
+                *this, store_pairs, params);
     } else if (pq.nbits == 16) {
-        return get_InvertedListScanner1<PQDecoder16>(*this, store_pairs);
+        return get_InvertedListScanner1<PQDecoder16>(
+                *this, store_pairs, params);
     } else {
-        return get_InvertedListScanner1<PQDecoderGeneric>(*this, store_pairs);
+        return get_InvertedListScanner1<PQDecoderGeneric>(
+                *this, store_pairs, params);
     }
     return nullptr;
 }
@@ -137,6 +137,12 @@ struct IndexIVFPQ : IndexIVF {
     InvertedListScanner* get_InvertedListScanner(
             bool store_pairs) const override;
 
+    /// the polysemous_ht of IVFPQSearchParameters overrides the one of the
+    /// index
+    InvertedListScanner* get_InvertedListScanner_with_params(
+            bool store_pairs,
+            const IVFSearchParameters* params) const override;
+
     /// build precomputed table
     void precompute_table();
 
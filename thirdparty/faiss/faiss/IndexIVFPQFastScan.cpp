@@ -11,12 +11,14 @@
 
 #include <cassert>
 #include <cinttypes>
+#include <cmath>
 #include <cstdio>
 #include <iostream>
 #include <omp.h>
 
 #include <memory>
 
+#include <faiss/FaissHook.h>
 #include <faiss/impl/AuxIndexStructures.h>
 #include <faiss/impl/FaissAssert.h>
 #include <faiss/utils/distances.h>
@@ -201,6 +203,104 @@ void IndexIVFPQFastScan::train(idx_t n, const float* x) {
  * Code management functions
  *********************************************************/
 
+namespace {
+
+// Re-assigns the PQ codes of the residuals of x, by coordinate descent over the
+// sub-quantizers, to minimize the anisotropic loss of ScaNN instead of the
+// reconstruction error e of x:
+//   ||e||^2 + (eta - 1) <e, x / ||x||>^2,   eta = (d - 1) T^2 / (1 - T^2)
+// The error parallel to x, which moves the scores of the queries x ranks high
+// for, weighs eta times the orthogonal one.
+using idx_t = Index::idx_t;
+
+void anisotropic_assign_codes(
+        const ProductQuantizer& pq,
+        float threshold,
+        idx_t n,
+        const float* x,
+        const float* residuals,
+        uint8_t* codes) {
+    constexpr int max_iter = 8;
+    const size_t d = pq.d, M = pq.M, ksub = pq.ksub, dsub = pq.dsub;
+    const float t2 = threshold * threshold;
+    const float eta = (d - 1) * t2 / (1 - t2);
+
+#pragma omp parallel if (n > 1000)
+    {
+        // per sub-quantizer and centroid, the squared norm of the error of
+        // the residual's part and its projection on x / ||x||
+        std::vector<float> err2(M * ksub), proj(M * ksub);
+        std::vector<uint64_t> assign(M);
+#pragma omp for
+        for (idx_t i = 0; i < n; i++) {
+            const float* xi = x + i * d;
+            const float* ri = residuals + i * d;
+            uint8_t* code = codes + i * pq.code_size;
+            float xnorm = std::sqrt(fvec_norm_L2sqr(xi, d));
+            if (xnorm == 0) {
+                continue;
+            }
+            for (size_t m = 0; m < M; m++) {
+                for (size_t c = 0; c < ksub; c++) {
+                    const float* cent = pq.get_centroids(m, c);
+                    float e2 = 0, p = 0;
+                    for (size_t j = 0; j < dsub; j++) {
+                        float e = ri[m * dsub + j] - cent[j];
+                        e2 += e * e;
+                        p += e * xi[m * dsub + j];
+                    }
+                    err2[m * ksub + c] = e2;
+                    proj[m * ksub + c] = p / xnorm;
+                }
+            }
+
+            // start from the nearest centroids, the codes already there
+            PQDecoderGeneric decoder(code, pq.nbits);
+            float par = 0;
+            for (size_t m = 0; m < M; m++) {
+                assign[m] = decoder.decode();
+                par += proj[m * ksub + assign[m]];
+            }
+            for (int iter = 0; iter < max_iter; iter++) {
+                bool changed = false;
+                for (size_t m = 0; m < M; m++) {
+                    const float* e2m = err2.data() + m * ksub;
+                    const float* pm = proj.data() + m * ksub;
+                    float par_others = par - pm[assign[m]];
+                    uint64_t best = assign[m];
+                    float best_loss = e2m[best] +
+                            (eta - 1) * (par_others + pm[best]) *
+                                    (par_others + pm[best]);
+                    for (size_t c = 0; c < ksub; c++) {
+                        float p = par_others + pm[c];
+                        float loss = e2m[c] + (eta - 1) * p * p;
+                        if (loss < best_loss) {
+                            best_loss = loss;
+                            best = c;
+                        }
+                    }
+                    if (best != assign[m]) {
+                        assign[m] = best;
+                        changed = true;
+                    }
+                    par = par_others + pm[best];
+                }
+                if (!changed) {
+                    break;
+                }
+            }
+
+            memset(code, 0, pq.code_size);
+            PQEncoderGeneric encoder(code, pq.nbits);
+            for (size_t m = 0; m < M; m++) {
+                encoder.encode(assign[m]);
+            }
+        }
+    }
+}
+
+} // namespace
+
 void IndexIVFPQFastScan::encode_vectors(
         idx_t n,
         const float* x,
@@ -218,8 +318,21 @@ void IndexIVFPQFastScan::encode_vectors(
             }
         }
         pq.compute_codes(residuals.data(), codes, n);
+        if (anisotropic_threshold > 0 && metric_type == METRIC_INNER_PRODUCT) {
+            anisotropic_assign_codes(
+                    pq,
+                    anisotropic_threshold,
+                    n,
+                    x,
+                    residuals.data(),
+                    codes);
+        }
     } else {
         pq.compute_codes(x, codes, n);
+        if (anisotropic_threshold > 0 && metric_type == METRIC_INNER_PRODUCT) {
+            anisotropic_assign_codes(
+                    pq, anisotropic_threshold, n, x, x, codes);
+        }
     }
 
     if (include_listnos) {
@@ -58,6 +58,12 @@ struct IndexIVFPQFastScan : IndexIVF {
     bool is_cosine_ = false;
     std::vector<float> norms;
 
+    /// > 0: the codes of an inner product index are assigned to minimize the
+    /// score-aware loss of ScaNN with this relative threshold (in [0, 1))
+    /// rather than the reconstruction error. Used when adding only, not
+    /// serialized.
+    float anisotropic_threshold = 0;
+
     IndexIVFPQFastScan(
             Index* quantizer,
             size_t d,
@@ -0,0 +1,424 @@
+#include <faiss/IndexIVFRaBitQ.h>
+
+#include <faiss/IndexFlat.h>
+#include <faiss/VectorTransform.h>
+#include <faiss/impl/AuxIndexStructures.h>
+#include <faiss/impl/FaissAssert.h>
+#include <faiss/utils/Heap.h>
+#include <faiss/utils/distances.h>
+#include <faiss/utils/hamming.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <memory>
+
+namespace faiss {
+
+/***************************************************
+ * IndexIVFRaBitQ
+ ***************************************************/
+
+IndexIVFRaBitQ::IndexIVFRaBitQ(
+        Index* quantizer,
+        size_t d,
+        size_t nlist,
+        MetricType metric)
+        : IndexIVF(
+                  quantizer,
+                  d,
+                  nlist,
+                  (d + 63) / 64 * sizeof(uint64_t) + 2 * sizeof(float),
+                  metric) {
+    FAISS_THROW_IF_NOT(
+            metric == METRIC_L2 || metric == METRIC_INNER_PRODUCT);
+    RandomRotationMatrix* rr = new RandomRotationMatrix(d, d);
+    rr->init(1234);
+    rotation = rr;
+    is_trained = false;
+}
+
+IndexIVFRaBitQ::IndexIVFRaBitQ() : IndexIVF() {}
+
+IndexIVFRaBitQ::~IndexIVFRaBitQ() {
+    delete rotation;
+    delete refine_index;
+}
+
+size_t IndexIVFRaBitQ::sign_size() const {
+    return (d + 63) / 64 * sizeof(uint64_t);
+}
+
+bool IndexIVFRaBitQ::with_raw_data() const {
+    return dynamic_cast<const IndexFlat*>(refine_index) != nullptr;
+}
+
+void IndexIVFRaBitQ::train_residual(idx_t n, const float* x) {
+    std::vector<float> centroids(nlist * d);
+    quantizer->reconstruct_n(0, nlist, centroids.data());
+    rotated_centroids.resize(nlist * d);
+    rotation->apply_noalloc(nlist, centroids.data(), rotated_centroids.data());
+    if (refine_index != nullptr && !refine_index->is_trained) {
+        refine_index->train(n, x);
+    }
+}
+
+void IndexIVFRaBitQ::add_with_ids(idx_t n, const float* x, const idx_t* xids) {
+    if (refine_index == nullptr) {
+        IndexIVF::add_with_ids(n, x, xids);
+        return;
+    }
+    FAISS_THROW_IF_NOT_MSG(
+            xids == nullptr, "ids can not be set with a refine index");
+    FAISS_THROW_IF_NOT(refine_index->ntotal == ntotal);
+    IndexIVF::add_with_ids(n, x, nullptr);
+    refine_index->add(n, x);
+}
+
+void IndexIVFRaBitQ::encode_vectors(
+        idx_t n,
+        const float* x,
+        const idx_t* list_nos,
+        uint8_t* codes,
+        bool include_listnos) const {
+    FAISS_THROW_IF_NOT(is_trained);
+    size_t coarse_size = include_listnos ? coarse_code_size() : 0;
+    size_t signs = sign_size();
+    float sqrt_d = std::sqrt(float(d));
+    std::unique_ptr<float[]> xr(rotation->apply(n, x));
+
+#pragma omp parallel for if (n > 1000)
+    for (idx_t i = 0; i < n; i++) {
+        int64_t list_no = list_nos[i];
+        uint8_t* code = codes + i * (code_size + coarse_size);
+        memset(code, 0, code_size + coarse_size);
+        if (list_no < 0) {
+            continue;
+        }
+        if (coarse_size) {
+            encode_listno(list_no, code);
+        }
+        code += coarse_size;
+        const float* xi = xr.get() + i * d;
+        const float* c = rotated_centroids.data() + list_no * d;
+        float norm = 0, l1 = 0;
+        for (size_t j = 0; j < d; j++) {
+            float r = xi[j] - c[j];
+            if (r > 0) {
+                code[j >> 3] |= 1 << (j & 7);
+            }
+            norm += r * r;
+            l1 += std::fabs(r);
+        }
+        norm = std::sqrt(norm);
+        // <o, x_bar> of the unit residual o and x_bar = sign(o) / sqrt(d)
+        float ip_xo = norm > 0 ? l1 / (sqrt_d * norm) : 1.0f;
+        memcpy(code + signs, &norm, sizeof(float));
+        memcpy(code + signs + sizeof(float), &ip_xo, sizeof(float));
+    }
+}
+
+void IndexIVFRaBitQ::reconstruct_from_offset(
+        int64_t list_no,
+        int64_t offset,
+        float* recons) const {
+    InvertedLists::ScopedCodes code(invlists, list_no, offset);
+    size_t signs = sign_size();
+    float norm, ip_xo;
+    memcpy(&norm, code.get() + signs, sizeof(float));
+    memcpy(&ip_xo, code.get() + signs + sizeof(float), sizeof(float));
+    float scale = norm * ip_xo / std::sqrt(float(d));
+    const float* c = rotated_centroids.data() + list_no * d;
+    std::vector<float> xr(d);
+    for (size_t j = 0; j < d; j++) {
+        bool bit = (code.get()[j >> 3] >> (j & 7)) & 1;
+        xr[j] = c[j] + (bit ? scale : -scale);
+    }
+    rotation->reverse_transform(1, xr.data(), recons);
+}
+
+void IndexIVFRaBitQ::reset() {
+    IndexIVF::reset();
+    if (refine_index != nullptr) {
+        refine_index->reset();
+    }
+}
+
+namespace {
+
+typedef faiss::Index::idx_t idx_t;
+
+struct RaBitQScanner : InvertedListScanner {
+    const IndexIVFRaBitQ* index;
+    size_t d;
+    size_t nwords;
+    int qb;
+    float inv_sqrt_d;
+
+    std::vector<float> q;  // the rotated query
+    std::vector<float> qr; // its residual to the rotated centroid of the list
+    // bit b of the quantized qr, the 64 bit words of every b in turn
+    std::vector<uint64_t> planes;
+    float vmin = 0, delta = 0;
+    float sum_u = 0;
+    float qr_norm2 = 0;
+    float c_ip = 0;
+
+    RaBitQScanner(const IndexIVFRaBitQ* index, bool store_pairs)
+            : index(index),
+              d(index->d),
+              nwords((index->d + 63) / 64),
+              qb(index->qb),
+              inv_sqrt_d(1.0f / std::sqrt(float(index->d))),
+              q(index->d),
+              qr(index->d),
+              planes(index->qb * nwords) {
+        this->store_pairs = store_pairs;
+        this->code_size = index->code_size;
+        this->keep_max = index->metric_type == METRIC_INNER_PRODUCT;
+    }
+
+    void set_query(const float* query) override {
+        index->rotation->apply_noalloc(1, query, q.data());
+    }
+
+    void set_list(idx_t list_no, float /*coarse_dis*/) override {
+        this->list_no = list_no;
+        const float* c = index->rotated_centroids.data() + list_no * d;
+        if (keep_max) {
+            // <x, q> = <c, q> + <r, q>
+            c_ip = fvec_inner_product(c, q.data(), d);
+            memcpy(qr.data(), q.data(), sizeof(float) * d);
+        } else {
+            for (size_t j = 0; j < d; j++) {
+                qr[j] = q[j] - c[j];
+            }
+            qr_norm2 = fvec_norm_L2sqr(qr.data(), d);
+        }
+        auto [lo, hi] = std::minmax_element(qr.begin(), qr.end());
+        vmin = *lo;
+        delta = (*hi - *lo) / ((1 << qb) - 1);
+        std::fill(planes.begin(), planes.end(), 0);
+        uint32_t usum = 0;
+        for (size_t j = 0; j < d; j++) {
+            uint32_t u = delta > 0 ? uint32_t(std::lround((qr[j] - vmin) / delta))
+                                   : 0;
+            u = std::min<uint32_t>(u, (1 << qb) - 1);
+            usum += u;
+            for (int b = 0; b < qb; b++) {
+                planes[b * nwords + j / 64] |= uint64_t((u >> b) & 1)
+                        << (j % 64);
+            }
+        }
+        sum_u = float(usum);
+    }
+
+    float distance_to_code(const uint8_t* code) const final {
+        const uint64_t* signs = reinterpret_cast<const uint64_t*>(code);
+        uint32_t pop = 0, weighted = 0;
+        for (size_t w = 0; w < nwords; w++) {
+            pop += popcount64(signs[w]);
+            for (int b = 0; b < qb; b++) {
+                weighted += popcount64(signs[w] & planes[b * nwords + w]) << b;
+            }
+        }
+        float norm, ip_xo;
+        memcpy(&norm, code + nwords * sizeof(uint64_t), sizeof(float));
+        memcpy(&ip_xo,
+               code + nwords * sizeof(uint64_t) + sizeof(float),
+               sizeof(float));
+        // <x_bar, qr> with x_bar = (2 * bits - 1) / sqrt(d)
+        float ip_bq = (2 * (vmin * pop + delta * weighted) -
+                       (vmin * d + delta * sum_u)) *
+                inv_sqrt_d;
+        float ip_rq = norm * ip_bq / ip_xo;
+        if (keep_max) {
+            return c_ip + ip_rq;
+        }
+        return norm * norm + qr_norm2 - 2 * ip_rq;
+    }
+
+    size_t scan_codes(
+            size_t list_size,
+            const uint8_t* codes,
+            const float* code_norms,
+            const idx_t* ids,
+            float* simi,
+            idx_t* idxi,
+            size_t k,
+            const BitsetView bitset) const override {
+        size_t nup = 0;
+        for (size_t j = 0; j < list_size; j++) {
+            if (bitset.empty() || !bitset.test(ids[j])) {
+                float dis = distance_to_code(codes);
+                if (keep_max ? dis > simi[0] : dis < simi[0]) {
+                    int64_t id = store_pairs ? lo_build(list_no, j) : ids[j];
+                    if (keep_max) {
+                        minheap_replace_top(k, simi, idxi, dis, id);
+                    } else {
+                        maxheap_replace_top(k, simi, idxi, dis, id);
+                    }
+                    nup++;
+                }
+            }
+            codes += code_size;
+        }
+        return nup;
+    }
+
+    void scan_codes_range(
+            size_t list_size,
+            const uint8_t* codes,
+            const float* code_norms,
+            const idx_t* ids,
+            float radius,
+            RangeQueryResult& res,
+            const BitsetView bitset) const override {
+        for (size_t j = 0; j < list_size; j++) {
+            if (bitset.empty() || !bitset.test(ids[j])) {
+                float dis = distance_to_code(codes);
+                if (keep_max ? dis > radius : dis < radius) {
+                    int64_t id = store_pairs ? lo_build(list_no, j) : ids[j];
+                    res.add(dis, id);
+                }
+            }
+            codes += code_size;
+        }
+    }
+};
+
+template <class C>
+static void reorder_2_heaps(
+        idx_t n,
+        idx_t k,
+        idx_t* labels,
+        float* distances,
+        idx_t k_base,
+        const idx_t* base_labels,
+        const float* base_distances) {
+#pragma omp parallel for if (n > 1)
+    for (idx_t i = 0; i < n; i++) {
+        idx_t* idxo = labels + i * k;
+        float* diso = distances + i * k;
+        const idx_t* idxi = base_labels + i * k_base;
+        const float* disi = base_distances + i * k_base;
+
+        heap_heapify<C>(k, diso, idxo, disi, idxi, k);
+        if (k_base != k) { // add remaining elements
+            heap_addn<C>(k, diso, idxo, disi + k, idxi + k, k_base - k);
+        }
+        heap_reorder<C>(k, diso, idxo);
+    }
+}
+
+} // anonymous namespace
+
+InvertedListScanner* IndexIVFRaBitQ::get_InvertedListScanner(
+        bool store_pairs) const {
+    return new RaBitQScanner(this, store_pairs);
+}
+
+void IndexIVFRaBitQ::compute_refine_distances(
+        idx_t n,
+        const float* x,
+        idx_t k_base,
+        float* distances,
+        const idx_t* labels) const {
+    if (auto rf = dynamic_cast<const IndexFlat*>(refine_index)) {
+        rf->compute_distance_subset(n, x, k_base, distances, labels);
+        return;
+    }
+    std::unique_ptr<DistanceComputer> dc(refine_index->get_distance_computer());
+    for (idx_t i = 0; i < n; i++) {
+        dc->set_query(x + i * d);
+        for (idx_t j = 0; j < k_base; j++) {
+            idx_t label = labels[i * k_base + j];
+            if (label >= 0) {
+                distances[i * k_base + j] = (*dc)(label);
+            }
+        }
+    }
+}
+
+void IndexIVFRaBitQ::search_refined_thread_safe(
+        idx_t n,
+        const float* x,
+        idx_t k,
+        float* distances,
+        idx_t* labels,
+        const size_t nprobe,
+        const float refine_k,
+        const BitsetView bitset) const {
+    FAISS_THROW_IF_NOT(k > 0);
+    if (refine_index == nullptr) {
+        search_thread_safe(n, x, k, distances, labels, nprobe, 0, bitset);
+        return;
+    }
+    idx_t k_base = std::max(k, idx_t(refine_k * k));
+    std::unique_ptr<idx_t[]> base_labels(new idx_t[n * k_base]);
+    std::unique_ptr<float[]> base_distances(new float[n * k_base]);
+    search_thread_safe(
+            n,
+            x,
+            k_base,
+            base_distances.get(),
+            base_labels.get(),
+            nprobe,
+            0,
+            bitset);
+
+    compute_refine_distances(
+            n, x, k_base, base_distances.get(), base_labels.get());
+
+    if (metric_type == METRIC_L2) {
+        reorder_2_heaps<CMax<float, idx_t>>(
+                n,
+                k,
+                labels,
+                distances,
+                k_base,
+                base_labels.get(),
+                base_distances.get());
+    } else {
+        reorder_2_heaps<CMin<float, idx_t>>(
+                n,
+                k,
+                labels,
+                distances,
+                k_base,
+                base_labels.get(),
+                base_distances.get());
+    }
+}
+
+void IndexIVFRaBitQ::range_search_refined_thread_safe(
+        idx_t n,
+        const float* x,
+        float radius,
+        RangeSearchResult* result,
+        const size_t nprobe,
+        const BitsetView bitset) const {
+    FAISS_THROW_IF_NOT(n == 1); // currently knowhere will split nq to 1
+
+    range_search_thread_safe(n, x, radius, result, nprobe, 0, bitset);
+    if (refine_index == nullptr) {
+        return;
+    }
+
+    compute_refine_distances(
+            n, x, result->lims[1], result->distances, result->labels);
+
+    idx_t current = 0;
+    for (idx_t i = 0; i < result->lims[1]; ++i) {
+        bool keep = metric_type == METRIC_L2 ? result->distances[i] < radius
+                                             : result->distances[i] > radius;
+        if (keep) {
+            result->distances[current] = result->distances[i];
+            result->labels[current] = result->labels[i];
+            current++;
+        }
+    }
+    result->lims[1] = current;
+}
+
+} // namespace faiss
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <vector>
+
+#include <faiss/IndexIVF.h>
+
+namespace faiss {
+
+struct VectorTransform;
+
+/** Inverted file that stores one bit per dimension of the residuals, as in
+ * RaBitQ: the residual of a vector to its centroid is randomly rotated, and
+ * its code holds the signs of the rotated residual, padded to 64 bit words,
+ * followed by the norm of the residual and the inner product of the unit
+ * residual with its binarization, which unbiases the estimated distances.
+ *
+ * The rotated query residual of a list is quantized to qb bits per dimension
+ * and split in bit planes, so that its inner product with a code is qb + 1
+ * popcounts per 64 dimensions.
+ *
+ * The estimated distances are re-ranked by the optional refine_index, an
+ * IndexFlat or an SQ8 / fp16 IndexScalarQuantizer that holds the vectors in
+ * the order they are added, see search_refined_thread_safe.
+ */
+struct IndexIVFRaBitQ : IndexIVF {
+    /// d x d random rotation of the vectors and the centroids, owned
+    VectorTransform* rotation = nullptr;
+    /// the rotated centroids, size nlist * d
+    std::vector<float> rotated_centroids;
+    /// bits per dimension of the quantized query residuals
+    int qb = 4;
+
+    /// re-ranks the candidates of the scan when set, owned
+    Index* refine_index = nullptr;
+
+    IndexIVFRaBitQ(
+            Index* quantizer,
+            size_t d,
+            size_t nlist,
+            MetricType metric = METRIC_L2);
+
+    IndexIVFRaBitQ();
+
+    ~IndexIVFRaBitQ() override;
+
+    /// bytes of the signs of a code
+    size_t sign_size() const;
+
+    /// whether the refine_index holds the exact vectors
+    bool with_raw_data() const;
+
+    /// rotates the centroids of the quantizer and trains the refine_index
+    void train_residual(idx_t n, const float* x) override;
+
+    /// the refine_index holds the vectors by their position, so the ids must
+    /// be the default ones when it is set
+    void add_with_ids(idx_t n, const float* x, const idx_t* xids) override;
+
+    void encode_vectors(
+            idx_t n,
+            const float* x,
+            const idx_t* list_nos,
+            uint8_t* codes,
+            bool include_listnos = false) const override;
+
+    InvertedListScanner* get_InvertedListScanner(
+            bool store_pairs) const override;
+
+    /// the centroid plus the binarized residual, scaled to its estimated
+    /// projection on the residual
+    void reconstruct_from_offset(int64_t list_no, int64_t offset, float* recons)
+            const override;
+
+    void reset() override;
+
+    /** searches refine_k * k candidates by their estimated distances, then
+     * re-ranks them by the distances of refine_index. Same as
+     * search_thread_safe without a refine_index.
+     */
+    void search_refined_thread_safe(
+            idx_t n,
+            const float* x,
+            idx_t k,
+            float* distances,
+            idx_t* labels,
+            const size_t nprobe,
+            const float refine_k,
+            const BitsetView bitset = nullptr) const;
+
+    /// the candidates within radius by their estimated distances, kept when
+    /// their refined distances are within radius too
+    void range_search_refined_thread_safe(
+            idx_t n,
+            const float* x,
+            float radius,
+            RangeSearchResult* result,
+            const size_t nprobe,
+            const BitsetView bitset = nullptr) const;
+
+   private:
+    /// replaces the distances of the k_base candidates of each query by the
+    /// ones of refine_index, candidates with a negative label are skipped
+    void compute_refine_distances(
+            idx_t n,
+            const float* x,
+            idx_t k_base,
+            float* distances,
+            const idx_t* labels) const;
+};
+
+} // namespace faiss
@@ -14,12 +14,18 @@
 
 #include <faiss/IndexIVF.h>
 
+#include <faiss/FaissHook.h>
+#include <knowhere/comp/cancellation.h>
+#include <knowhere/comp/profile_zone.h>
+#include <knowhere/comp/query_stats.h>
 #include <faiss/utils/utils.h>
 
 #include <faiss/impl/AuxIndexStructures.h>
 #include <faiss/impl/FaissAssert.h>
 #include <omp.h>
+#include <algorithm>
 #include <cinttypes>
+#include <cmath>
 namespace faiss {
 
 namespace {
@@ -60,11 +66,15 @@ void IndexIVF::search_thread_safe(
         std::unique_ptr<float[]> coarse_dis(new float[n * final_nprobe]);
 
         double t0 = getmillisecs();
-        quantizer->search(n, x, final_nprobe, coarse_dis.get(), idx.get());
+        {
+            KNOWHERE_PROFILE_ZONE("ivf.coarse_assign");
+            quantizer->search(n, x, final_nprobe, coarse_dis.get(), idx.get());
+        }
 
         double t1 = getmillisecs();
         invlists->prefetch_lists(idx.get(), n * final_nprobe);
 
+        KNOWHERE_PROFILE_ZONE("ivf.scan_lists");
         search_preassigned(
                 n,
                 x,
@@ -148,11 +158,15 @@ void IndexIVF::search_without_codes_thread_safe(
         std::unique_ptr<float[]> coarse_dis(new float[n * final_nprobe]);
 
         double t0 = getmillisecs();
-        quantizer->search(n, x, final_nprobe, coarse_dis.get(), idx.get());
+        {
+            KNOWHERE_PROFILE_ZONE("ivf.coarse_assign");
+            quantizer->search(n, x, final_nprobe, coarse_dis.get(), idx.get());
+        }
 
         double t1 = getmillisecs();
         invlists->prefetch_lists(idx.get(), n * final_nprobe);
 
+        KNOWHERE_PROFILE_ZONE("ivf.scan_lists");
         search_preassigned_without_codes(
                 n,
                 x,
@@ -250,11 +264,14 @@ void IndexIVF::search_preassigned_without_codes(
     bool do_heap_init =
             !(preassigned_parallel_mode & PARALLEL_MODE_NO_HEAP_INIT);
 
+    auto radii = get_list_radius();
+    bool pruning = radii != nullptr && radii->radius.size() == nlist;
+
     bool do_parallel = omp_get_max_threads() >= 2 &&
-            (pmode == 0           ? false
-                     : pmode == 3 ? n > 1
-                     : pmode == 1 ? nprobe > 1
-                                  : nprobe * n > 1);
+            (pmode == 0 || pmode == 4 ? false
+                     : pmode == 3         ? n > 1
+                     : pmode == 1         ? nprobe > 1
+                                          : nprobe * n > 1);
 
 #pragma omp parallel if (do_parallel) reduction(+ : nlistv, ndis, nheap)
     {
@@ -390,10 +407,36 @@ void IndexIVF::search_preassigned_without_codes(
 
                 idx_t nscan = 0;
 
+                float query_norm = pruning &&
+                                metric_type == METRIC_INNER_PRODUCT
+                        ? std::sqrt(fvec_norm_L2sqr(x + i * d, d))
+                        : 0;
+
                 // loop over probes
                 for (size_t ik = 0; ik < nprobe; ik++) {
+                    if (knowhere::CancellationToken::CurrentCancelled()) {
+                        break;
+                    }
+                    idx_t key = keys[i * nprobe + ik];
+                    if (pruning && key >= 0) {
+                        float dis = coarse_dis[i * nprobe + ik];
+                        if (list_out_of_reach(
+                                    dis,
+                                    radii->max_radius,
+                                    query_norm,
+                                    simi[0])) {
+                            break;
+                        }
+                        if (list_out_of_reach(
+                                    dis,
+                                    radii->radius[key],
+                                    query_norm,
+                                    simi[0])) {
+                            continue;
+                        }
+                    }
                     nscan += scan_one_list(
-                            keys[i * nprobe + ik],
+                            key,
                             coarse_dis[i * nprobe + ik],
                             simi,
                             idxi,
@@ -483,6 +526,41 @@ void IndexIVF::search_preassigned_without_codes(
             for (int64_t i = 0; i < n; i++) {
                 reorder_result(distances + i * k, labels + i * k);
             }
+        } else if (pmode == 4) {
+            // list major: the (list, query) pairs are sorted by list, so that
+            // a list probed by several queries is scanned back to back while
+            // its codes are in cache
+            std::vector<std::pair<idx_t, idx_t>> pairs;
+            pairs.reserve(n * nprobe);
+            for (idx_t ij = 0; ij < n * nprobe; ij++) {
+                if (keys[ij] >= 0) {
+                    pairs.emplace_back(keys[ij], ij);
+                }
+            }
+            std::sort(pairs.begin(), pairs.end());
+
+            for (idx_t i = 0; i < n; i++) {
+                init_result(distances + i * k, labels + i * k);
+            }
+            for (const auto& [key, ij] : pairs) {
+                if (knowhere::CancellationToken::CurrentCancelled()) {
+                    break;
+                }
+                if (interrupt) {
+                    break;
+                }
+                size_t i = ij / nprobe;
+                scanner->set_query(x + i * d);
+                ndis += scan_one_list(
+                        key,
+                        coarse_dis[ij],
+                        distances + i * k,
+                        labels + i * k,
+                        bitset);
+            }
+            for (idx_t i = 0; i < n; i++) {
+                reorder_result(distances + i * k, labels + i * k);
+            }
         } else {
             FAISS_THROW_FMT("parallel_mode %d not supported\n", pmode);
         }
@@ -503,6 +581,10 @@ void IndexIVF::search_preassigned_without_codes(
         ivf_stats->ndis += ndis;
         ivf_stats->nheap_updates += nheap;
     }
+    // the work also goes to the query stats of the calling thread
+    auto& query_stats = knowhere::QueryStats::Current();
+    query_stats.lists_scanned += nlistv;
+    query_stats.codes_scanned += ndis;
 }
 
 void IndexIVF::range_search_thread_safe(
@@ -518,11 +600,15 @@ void IndexIVF::range_search_thread_safe(
     std::unique_ptr<float[]> coarse_dis(new float[nx * final_nprobe]);
 
     double t0 = getmillisecs();
-    quantizer->search(nx, x, final_nprobe, coarse_dis.get(), keys.get());
+    {
+        KNOWHERE_PROFILE_ZONE("ivf.coarse_assign");
+        quantizer->search(nx, x, final_nprobe, coarse_dis.get(), keys.get());
+    }
     indexIVF_stats.quantization_time += getmillisecs() - t0;
 
     t0 = getmillisecs();
     invlists->prefetch_lists(keys.get(), nx * final_nprobe);
+    KNOWHERE_PROFILE_ZONE("ivf.scan_lists");
 
     IVFSearchParameters params = gen_search_param(final_nprobe, 0, max_codes);
 
@@ -554,11 +640,15 @@ void IndexIVF::range_search_without_codes_thread_safe(
     std::unique_ptr<float[]> coarse_dis(new float[nx * final_nprobe]);
 
     double t0 = getmillisecs();
-    quantizer->search(nx, x, final_nprobe, coarse_dis.get(), keys.get());
+    {
+        KNOWHERE_PROFILE_ZONE("ivf.coarse_assign");
+        quantizer->search(nx, x, final_nprobe, coarse_dis.get(), keys.get());
+    }
     indexIVF_stats.quantization_time += getmillisecs() - t0;
 
     t0 = getmillisecs();
     invlists->prefetch_lists(keys.get(), nx * final_nprobe);
+    KNOWHERE_PROFILE_ZONE("ivf.scan_lists");
 
     IVFSearchParameters params = gen_search_param(final_nprobe, 0, max_codes);
 
@@ -607,6 +697,11 @@ void IndexIVF::range_search_preassigned_without_codes(
         preassigned_parallel_mode = this->parallel_mode;
     }
     int pmode = preassigned_parallel_mode & ~PARALLEL_MODE_NO_HEAP_INIT;
+    // with the list radii the probed lists are bounded by the range rather
+    // than stopping at the first one without results
+    auto radii = get_list_radius();
+    bool pruning = radii != nullptr && radii->radius.size() == nlist;
+
     // don't start parallel section if single query
     bool do_parallel = omp_get_max_threads() >= 2 &&
             (pmode == 3           ? false
@@ -682,9 +777,31 @@ void IndexIVF::range_search_preassigned_without_codes(
             RangeQueryResult& qres = pres.new_result(i);
             size_t prev_nres = qres.nres;
 
+            float query_norm = pruning && metric_type == METRIC_INNER_PRODUCT
+                    ? std::sqrt(fvec_norm_L2sqr(x + i * d, d))
+                    : 0;
+
             for (size_t ik = 0; ik < nprobe; ik++) {
+                if (knowhere::CancellationToken::CurrentCancelled()) {
+                    break;
+                }
+                idx_t key = keys[i * nprobe + ik];
+                if (pruning && key >= 0) {
+                    // the lists come by centroid distance, none past the
+                    // first one out of reach of the largest radius can
+                    // hold a vector within the range
+                    float dis = coarse_dis[i * nprobe + ik];
+                    if (list_out_of_reach(
+                                dis, radii->max_radius, query_norm, radius)) {
+                        break;
+                    }
+                    if (list_out_of_reach(
+                                dis, radii->radius[key], query_norm, radius)) {
+                        continue;
+                    }
+                }
                 scan_list_func(i, ik, qres, bitset);
-                if (qres.nres == prev_nres) break;
+                if (!pruning && qres.nres == prev_nres) break;
                 prev_nres = qres.nres;
             }
         }
@@ -705,6 +822,9 @@ void IndexIVF::range_search_preassigned_without_codes(
         stats->nlist += nlistv;
         stats->ndis += ndis;
     }
+    auto& query_stats = knowhere::QueryStats::Current();
+    query_stats.lists_scanned += nlistv;
+    query_stats.codes_scanned += ndis;
 }
 
 } // namespace faiss
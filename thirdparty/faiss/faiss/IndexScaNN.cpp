@@ -8,6 +8,10 @@
 #include <faiss/utils/distances.h>
 #include <faiss/utils/utils.h>
 
+#include <sys/mman.h>
+
+#include <memory>
+
 namespace faiss {
 
 /***************************************************
@@ -19,8 +23,26 @@ IndexScaNN::IndexScaNN(Index* base_index) : IndexRefineFlat(base_index) {}
 IndexScaNN::IndexScaNN(Index* base_index, const float* xb)
         : IndexRefineFlat(base_index, xb) {}
 
+IndexScaNN::IndexScaNN(Index* base_index, Index* refine_index)
+        : IndexRefineFlat() {
+    FAISS_THROW_IF_NOT(base_index->d == refine_index->d);
+    FAISS_THROW_IF_NOT(base_index->metric_type == refine_index->metric_type);
+    this->base_index = base_index;
+    this->refine_index = refine_index;
+    d = base_index->d;
+    metric_type = base_index->metric_type;
+    is_trained = base_index->is_trained && refine_index->is_trained;
+    ntotal = base_index->ntotal;
+}
+
 IndexScaNN::IndexScaNN() : IndexRefineFlat() {}
 
+IndexScaNN::~IndexScaNN() {
+    if (mmap_ptr != nullptr) {
+        munmap(mmap_ptr, mmap_size);
+    }
+}
+
 namespace {
 
 typedef faiss::Index::idx_t idx_t;
@@ -49,8 +71,84 @@ static void reorder_2_heaps(
     }
 }
 
+// The fast scan results of a query are sorted, the candidates beyond the k-th
+// that are farther from it than reorder_spread times the distance between the
+// 1st and the k-th are dropped before the re-rank.
+template <class C>
+static void trim_candidates(
+        idx_t n,
+        idx_t k,
+        idx_t k_base,
+        float reorder_spread,
+        float* distances,
+        idx_t* labels) {
+    for (idx_t i = 0; i < n; i++) {
+        float* dis = distances + i * k_base;
+        idx_t* ids = labels + i * k_base;
+        if (ids[k - 1] < 0) {
+            continue;
+        }
+        float bound = dis[k - 1] + reorder_spread * (dis[k - 1] - dis[0]);
+        for (idx_t j = k; j < k_base; j++) {
+            if (ids[j] >= 0 && C::cmp(dis[j], bound)) {
+                ids[j] = -1;
+                dis[j] = C::neutral();
+            }
+        }
+    }
+}
+
 } // anonymous namespace
 
+bool IndexScaNN::with_raw_data() const {
+    return mmap_xb != nullptr || dynamic_cast<const IndexFlat*>(refine_index);
+}
+
+void IndexScaNN::add(idx_t n, const float* x) {
+    FAISS_THROW_IF_NOT_MSG(
+            mmap_xb == nullptr, "can not add to a ScaNN index mapped from file");
+    IndexRefine::add(n, x);
+}
+
+void IndexScaNN::reconstruct(idx_t key, float* recons) const {
+    if (mmap_xb != nullptr) {
+        memcpy(recons, mmap_xb + key * d, sizeof(float) * d);
+    } else {
+        IndexRefine::reconstruct(key, recons);
+    }
+}
+
+void IndexScaNN::compute_refine_distances(
+        idx_t n,
+        const float* x,
+        idx_t k_base,
+        float* distances,
+        const idx_t* labels) const {
+    if (mmap_xb != nullptr) {
+        if (metric_type == METRIC_INNER_PRODUCT) {
+            fvec_inner_products_by_idx(
+                    distances, x, mmap_xb, labels, d, n, k_base);
+        } else {
+            fvec_L2sqr_by_idx(distances, x, mmap_xb, labels, d, n, k_base);
+        }
+        return;
+    }
+    if (auto rf = dynamic_cast<const IndexFlat*>(refine_index)) {
+        rf->compute_distance_subset(n, x, k_base, distances, labels);
+        return;
+    }
+    std::unique_ptr<DistanceComputer> dc(refine_index->get_distance_computer());
+    for (idx_t i = 0; i < n; i++) {
+        dc->set_query(x + i * d);
+        for (idx_t j = 0; j < k_base; j++) {
+            idx_t label = labels[i * k_base + j];
+            if (label >= 0) {
+                distances[i * k_base + j] = (*dc)(label);
+            }
+        }
+    }
+}
+
 int64_t IndexScaNN::size() {
     auto index_ = dynamic_cast<const IndexIVFPQFastScan*>(base_index);
     FAISS_THROW_IF_NOT(index_);
@@ -66,8 +164,15 @@ int64_t IndexScaNN::size() {
     auto centroid_table = pq.M * pq.ksub * pq.dsub * sizeof(float);
     auto precomputed_table = nlist * pq.M * pq.ksub * sizeof(float);
 
-    auto raw_data = index_->ntotal * d * sizeof(float);
-    return (capacity + centroid_table + precomputed_table + raw_data);
+    // the refine tier: raw vectors, none when they are mapped from file, or
+    // their SQ8 / fp16 codes
+    size_t refine_data = 0;
+    if (mmap_xb == nullptr) {
+        auto rf = dynamic_cast<const IndexFlatCodes*>(refine_index);
+        FAISS_THROW_IF_NOT(rf);
+        refine_data = rf->codes.size();
+    }
+    return (capacity + centroid_table + precomputed_table + refine_data);
 }
 
 void IndexScaNN::search_thread_safe(
@@ -78,6 +183,7 @@ void IndexScaNN::search_thread_safe(
         idx_t* labels,
         const size_t nprobe,
         const size_t reorder_k,
+        const float reorder_spread,
         const BitsetView bitset) const {
     FAISS_THROW_IF_NOT(k > 0);
 
@@ -110,11 +216,18 @@ void IndexScaNN::search_thread_safe(
     for (idx_t i = 0; i < n * k_base; i++)
         assert(base_labels[i] >= -1 && base_labels[i] < ntotal);
 
-    // compute refined distances
-    auto rf = dynamic_cast<const IndexFlat*>(refine_index);
-    FAISS_THROW_IF_NOT(rf);
+    if (reorder_spread > 0 && k_base > k) {
+        if (metric_type == METRIC_L2) {
+            trim_candidates<CMax<float, idx_t>>(
+                    n, k, k_base, reorder_spread, base_distances, base_labels);
+        } else {
+            trim_candidates<CMin<float, idx_t>>(
+                    n, k, k_base, reorder_spread, base_distances, base_labels);
+        }
+    }
 
-    rf->compute_distance_subset(n, x, k_base, base_distances, base_labels);
+    // compute refined distances
+    compute_refine_distances(n, x, k_base, base_distances, base_labels);
 
     if (base->is_cosine_) {
         for (idx_t i = 0; i < n * k_base; i++) {
@@ -143,6 +256,7 @@ void IndexScaNN::range_search_thread_safe(
         const float* x,
         float radius,
         RangeSearchResult* result,
+        const size_t nprobe,
         const BitsetView bitset) const {
     FAISS_THROW_IF_NOT(n == 1);  // currently knowhere will split nq to 1
 
@@ -150,13 +264,11 @@ void IndexScaNN::range_search_thread_safe(
     auto base = dynamic_cast<const IndexIVFPQFastScan*>(base_index);
     FAISS_THROW_IF_NOT(base);
 
-    base->range_search_thread_safe(n, x, radius, result, base->nlist, bitset);
+    base->range_search_thread_safe(n, x, radius, result, nprobe, bitset);
 
     // compute refined distances
-    auto rf = dynamic_cast<const IndexFlat*>(refine_index);
-    FAISS_THROW_IF_NOT(rf);
-
-    rf->compute_distance_subset(n, x, result->lims[1], result->distances, result->labels);
+    compute_refine_distances(
+            n, x, result->lims[1], result->distances, result->labels);
 
     idx_t current = 0;
     for (idx_t i = 0; i < result->lims[1]; ++i) {
@@ -8,11 +8,32 @@ namespace faiss {
 struct IndexScaNN : IndexRefineFlat {
     explicit IndexScaNN(Index* base_index);
     IndexScaNN(Index* base_index, const float* xb);
+    /// re-ranks with refine_index, e.g. an SQ8 or fp16 IndexScalarQuantizer,
+    /// instead of the raw vectors
+    IndexScaNN(Index* base_index, Index* refine_index);
 
     IndexScaNN();
 
+    ~IndexScaNN() override;
+
+    /// raw vectors of a flat refine_index mapped from the index file, only the
+    /// pages of the re-ranked candidates are read
+    const float* mmap_xb = nullptr;
+    void* mmap_ptr = nullptr;
+    size_t mmap_size = 0;
+
     int64_t size();
 
+    /// whether the refine tier holds the exact vectors
+    bool with_raw_data() const;
+
+    void add(idx_t n, const float* x) override;
+
+    void reconstruct(idx_t key, float* recons) const override;
+
+    /// reorder_spread > 0 re-ranks, per query, only the candidates beyond the
+    /// k-th whose fast scan distance is within reorder_spread times the spread
+    /// of the top k fast scan distances of the k-th one, at most reorder_k
     void search_thread_safe(
             idx_t n,
             const float* x,
@@ -21,6 +42,7 @@ struct IndexScaNN : IndexRefineFlat {
             idx_t* labels,
             const size_t nprobe,
             const size_t reorder_k,
+            const float reorder_spread = 0,
             const BitsetView bitset = nullptr) const;
 
     void range_search_thread_safe(
@@ -28,7 +50,18 @@ struct IndexScaNN : IndexRefineFlat {
             const float* x,
             float radius,
             RangeSearchResult* result,
+            const size_t nprobe,
             const BitsetView bitset = nullptr) const;
+
+   private:
+    /// replaces the distances of the k_base candidates of each query by the
+    /// ones of the refine tier, candidates with a negative label are skipped
+    void compute_refine_distances(
+            idx_t n,
+            const float* x,
+            idx_t k_base,
+            float* distances,
+            const idx_t* labels) const;
 };
 
-} // namespace faiss
\ No newline at end of file
+} // namespace faiss
@@ -97,6 +97,17 @@ struct HeapResultHandler {
             }
         }
 
+        /// add the results of ids j0..j0+n-1 of the block dis for which
+        /// keep(b) holds
+        template <class Keep>
+        void add_results(size_t n, const T* dis, TI j0, Keep keep) {
+            heap_addn_filtered<C>(
+                    k, heap_dis, heap_ids, dis, n, keep, [&](size_t b) {
+                        return j0 + b;
+                    });
+            thresh = heap_dis[0];
+        }
+
         /// series of results for query i is done
         void end() {
             heap_reorder<C>(k, heap_dis, heap_ids);
@@ -125,17 +136,17 @@ struct HeapResultHandler {
         for (int64_t i = i0; i < i1; i++) {
             T* heap_dis = heap_dis_tab + i * k;
             TI* heap_ids = heap_ids_tab + i * k;
-            const T* dis_tab_i = dis_tab + (j1 - j0) * (i - i0) - j0;
-            T thresh = heap_dis[0];
-            for (size_t j = j0; j < j1; j++) {
-                if (bitset.empty() || !bitset.test(j)) {
-                    T dis = dis_tab_i[j];
-                    if (C::cmp(thresh, dis)) {
-                        heap_replace_top<C>(k, heap_dis, heap_ids, dis, j);
-                        thresh = heap_dis[0];
-                    }
-                }
-            }
+            const T* dis_tab_i = dis_tab + (j1 - j0) * (i - i0);
+            heap_addn_filtered<C>(
+                    k,
+                    heap_dis,
+                    heap_ids,
+                    dis_tab_i,
+                    j1 - j0,
+                    [&](size_t j) {
+                        return bitset.empty() || !bitset.test(j0 + j);
+                    },
+                    [&](size_t j) { return TI(j0 + j); });
         }
     }
 
@@ -325,6 +336,17 @@ struct ReservoirResultHandler {
             res1.add(dis, idx);
         }
 
+        /// add the results of ids j0..j0+n-1 of the block dis for which
+        /// keep(b) holds
+        template <class Keep>
+        void add_results(size_t n, const T* dis, TI j0, Keep keep) {
+            for (size_t b = 0; b < n; b++) {
+                if (keep(b)) {
+                    res1.add(dis[b], j0 + b);
+                }
+            }
+        }
+
         /// series of results for query i is done
         void end() {
             T* heap_dis = hr.heap_dis_tab + i * hr.k;
@@ -9,6 +9,7 @@
 
 #include <omp.h>
 #include <algorithm>
+#include <cmath>
 #include <cstdio>
 
 #include <faiss/impl/FaissAssert.h>
@@ -447,6 +448,91 @@ struct DistanceComputerByte<Similarity, 1> : SQDistanceComputer {
     }
 };
 
+/*******************************************************************
+ * DCTemplateInt8IP: inner product of 8 bit codes with a query
+ * quantized to int8, so that the codes need not be decoded.
+ *
+ * <x, vmin + (c + 0.5) / 255 * vdiff> = bias + <w, c>, with
+ * w = x * vdiff / 255, and w is quantized as scale * qw once per query.
+ * Dot computes <c, qw> over uint8 codes and int8 weights in
+ * [-Dot::qmax, Dot::qmax].
+ *******************************************************************/
+
+struct DotU8S8 {
+    static constexpr int qmax = 127;
+
+    static int32_t dot(const uint8_t* x, const int8_t* y, size_t d) {
+        int32_t accu = 0;
+        for (size_t i = 0; i < d; i++) {
+            accu += int32_t(x[i]) * y[i];
+        }
+        return accu;
+    }
+};
+
+template <bool uniform, class Dot>
+struct DCTemplateInt8IP : SQDistanceComputer {
+    using Sim = SimilarityIP<1>;
+
+    QuantizerTemplate<Codec8bit, uniform, 1> quant;
+    std::vector<float> w;
+    std::vector<int8_t> qw;
+    float scale = 0;
+    float bias = 0;
+
+    DCTemplateInt8IP(size_t d, const std::vector<float>& trained)
+            : quant(d, trained), w(d), qw(d) {}
+
+    float vmin(size_t i) const {
+        if constexpr (uniform) {
+            return quant.vmin;
+        } else {
+            return quant.vmin[i];
+        }
+    }
+
+    float vdiff(size_t i) const {
+        if constexpr (uniform) {
+            return quant.vdiff;
+        } else {
+            return quant.vdiff[i];
+        }
+    }
+
+    void set_query(const float* x) final {
+        q = x;
+        float wmax = 0;
+        bias = 0;
+        for (size_t i = 0; i < quant.d; i++) {
+            w[i] = x[i] * vdiff(i) / 255.0f;
+            wmax = std::max(wmax, std::abs(w[i]));
+            bias += x[i] * (vmin(i) + 0.5f * vdiff(i) / 255.0f);
+        }
+        scale = wmax > 0 ? wmax / Dot::qmax : 1.0f;
+        for (size_t i = 0; i < quant.d; i++) {
+            qw[i] = (int8_t)std::lrint(w[i] / scale);
+        }
+    }
+
+    /// compute distance of vector i to current query
+    float operator()(idx_t i) final {
+        return query_to_code(codes + i * code_size);
+    }
+
+    float symmetric_dis(idx_t i, idx_t j) override {
+        float accu = 0;
+        for (size_t k = 0; k < quant.d; k++) {
+            accu += quant.reconstruct_component(codes + i * code_size, k) *
+                    quant.reconstruct_component(codes + j * code_size, k);
+        }
+        return accu;
+    }
+
+    float query_to_code(const uint8_t* code) const final {
+        return bias + scale * Dot::dot(code, qw.data(), quant.d);
+    }
+};
+
 /*******************************************************************
  * select_distance_computer: runtime selection of template
  * specialization
@@ -599,4 +685,28 @@ InvertedListScanner* sel0_InvertedListScanner(
     }
 }
 
+/// 8 bit inner product scanners that quantize the query, nullptr for the
+/// other metrics and quantizer types
+template <class Dot>
+InvertedListScanner* sel_InvertedListScanner_int8(
+        MetricType mt,
+        const ScalarQuantizer* sq,
+        const Index* quantizer,
+        bool store_pairs,
+        bool r) {
+    if (mt != METRIC_INNER_PRODUCT) {
+        return nullptr;
+    }
+    switch (sq->qtype) {
+        case QuantizerType::QT_8bit_uniform:
+            return sel2_InvertedListScanner<DCTemplateInt8IP<true, Dot>>(
+                    sq, quantizer, store_pairs, r);
+        case QuantizerType::QT_8bit:
+            return sel2_InvertedListScanner<DCTemplateInt8IP<false, Dot>>(
+                    sq, quantizer, store_pairs, r);
+        default:
+            return nullptr;
+    }
+}
+
 } // namespace faiss
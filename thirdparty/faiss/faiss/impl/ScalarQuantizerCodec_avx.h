@@ -390,6 +390,37 @@ struct DCTemplate_avx<Quantizer, Similarity, 8> : SQDistanceComputer {
     }
 };
 
+/*******************************************************************
+ * DotU8S8_avx: <uint8 codes, int8 weights> with maddubs. Its pairwise
+ * int16 sums must not saturate, so 2 * 255 * qmax stays below 2^15.
+ *******************************************************************/
+
+struct DotU8S8_avx {
+    static constexpr int qmax = 63;
+
+    static int32_t dot(const uint8_t* x, const int8_t* y, size_t d) {
+        const __m256i ones = _mm256_set1_epi16(1);
+        __m256i accu = _mm256_setzero_si256();
+        size_t i = 0;
+        for (; i + 32 <= d; i += 32) {
+            __m256i xi = _mm256_loadu_si256((const __m256i*)(x + i));
+            __m256i yi = _mm256_loadu_si256((const __m256i*)(y + i));
+            __m256i prod16 = _mm256_maddubs_epi16(xi, yi);
+            accu = _mm256_add_epi32(accu, _mm256_madd_epi16(prod16, ones));
+        }
+        __m128i sum = _mm_add_epi32(
+                _mm256_castsi256_si128(accu),
+                _mm256_extracti128_si256(accu, 1));
+        sum = _mm_hadd_epi32(sum, sum);
+        sum = _mm_hadd_epi32(sum, sum);
+        int32_t res = _mm_cvtsi128_si32(sum);
+        for (; i < d; i++) {
+            res += int32_t(x[i]) * y[i];
+        }
+        return res;
+    }
+};
+
 /*******************************************************************
  * DistanceComputerByte: computes distances in the integer domain
  *******************************************************************/
@@ -52,7 +52,7 @@ struct Codec4bit_avx512 : public Codec4bit_avx {
         __m128i c16 = _mm_unpacklo_epi8(
                 _mm_set1_epi64x(c8ev), _mm_set1_epi64x(c8od));
         __m256i c8lo = _mm256_cvtepu8_epi32(c16);
-        __m256i c8hi = _mm256_cvtepu8_epi32(_mm_srli_si128(c16, 4));
+        __m256i c8hi = _mm256_cvtepu8_epi32(_mm_srli_si128(c16, 8));
         __m512i i16 = _mm512_castsi256_si512(c8lo);
         i16 = _mm512_inserti32x8(i16, c8hi, 1);
         __m512 f16 = _mm512_cvtepi32_ps(i16);
@@ -64,25 +64,19 @@ struct Codec4bit_avx512 : public Codec4bit_avx {
 };
 
 struct Codec6bit_avx512 : public Codec6bit_avx {
-    // TODO: can be optimized
+    // 16 components are 12 bytes, each half of them unpacked as by
+    // Codec6bit_avx
     static __m512 decode_16_components(const uint8_t* code, int i) {
-        return _mm512_set_ps
-            (decode_component(code, i + 15),
-             decode_component(code, i + 14),
-             decode_component(code, i + 13),
-             decode_component(code, i + 12),
-             decode_component(code, i + 11),
-             decode_component(code, i + 10),
-             decode_component(code, i + 9),
-             decode_component(code, i + 8),
-             decode_component(code, i + 7),
-             decode_component(code, i + 6),
-             decode_component(code, i + 5),
-             decode_component(code, i + 4),
-             decode_component(code, i + 3),
-             decode_component(code, i + 2),
-             decode_component(code, i + 1),
-             decode_component(code, i + 0));
+        const uint8_t* code16 = code + (i >> 2) * 3;
+        __m256i c8lo = load6((const uint16_t*)code16);
+        __m256i c8hi = load6((const uint16_t*)(code16 + 6));
+        __m512i i16 = _mm512_castsi256_si512(c8lo);
+        i16 = _mm512_inserti32x8(i16, c8hi, 1);
+        __m512 f16 = _mm512_cvtepi32_ps(i16);
+        __m512 half = _mm512_set1_ps(0.5f);
+        f16 = _mm512_add_ps(f16, half);
+        __m512 one_63 = _mm512_set1_ps(1.f / 63.f);
+        return _mm512_mul_ps(f16, one_63);
     }
 };
 
@@ -430,6 +424,35 @@ struct DCTemplate_avx512<Quantizer, Similarity, 16> : SQDistanceComputer {
     }
 };
 
+/*******************************************************************
+ * DotU8S8_avx512: <uint8 codes, int8 weights> with maddubs on 64 bytes,
+ * with the same 7 bit weights as DotU8S8_avx.
+ *******************************************************************/
+
+struct DotU8S8_avx512 {
+    static constexpr int qmax = 63;
+
+    static int32_t dot(const uint8_t* x, const int8_t* y, size_t d) {
+        const __m512i ones = _mm512_set1_epi16(1);
+        __m512i accu = _mm512_setzero_si512();
+        size_t i = 0;
+        for (; i + 64 <= d; i += 64) {
+            __m512i xi = _mm512_loadu_si512((const void*)(x + i));
+            __m512i yi = _mm512_loadu_si512((const void*)(y + i));
+            __m512i prod16 = _mm512_maddubs_epi16(xi, yi);
+            accu = _mm512_add_epi32(accu, _mm512_madd_epi16(prod16, ones));
+        }
+        if (i < d) {
+            __mmask64 mask = (1ULL << (d - i)) - 1;
+            __m512i xi = _mm512_maskz_loadu_epi8(mask, x + i);
+            __m512i yi = _mm512_maskz_loadu_epi8(mask, y + i);
+            __m512i prod16 = _mm512_maddubs_epi16(xi, yi);
+            accu = _mm512_add_epi32(accu, _mm512_madd_epi16(prod16, ones));
+        }
+        return _mm512_reduce_add_epi32(accu);
+    }
+};
+
 /*******************************************************************
  * DistanceComputerByte: computes distances in the integer domain
  *******************************************************************/
@@ -7,6 +7,7 @@
 
 #include <faiss/impl/ScalarQuantizerDC_avx.h>
 #include <faiss/impl/ScalarQuantizerCodec_avx.h>
+#include "simd/hook.h"
 
 namespace faiss {
 
@@ -56,6 +57,12 @@ InvertedListScanner* sq_select_inverted_list_scanner_avx(
         size_t dim,
         bool store_pairs,
         bool by_residual) {
+    if (use_sq_int8_query) {
+        if (auto scanner = sel_InvertedListScanner_int8<DotU8S8_avx>(
+                    mt, sq, quantizer, store_pairs, by_residual)) {
+            return scanner;
+        }
+    }
     if (dim % 8 == 0) {
         return sel0_InvertedListScanner_avx<8>(
                 mt, sq, quantizer, store_pairs, by_residual);
@@ -7,6 +7,7 @@
 
 #include <faiss/impl/ScalarQuantizerDC_avx512.h>
 #include <faiss/impl/ScalarQuantizerCodec_avx512.h>
+#include "simd/hook.h"
 
 namespace faiss {
 
@@ -32,7 +33,7 @@ SQDistanceComputer* sq_get_distance_computer_avx512(
         }
     } else {
         if (dim % 16 == 0) {
-            return select_distance_computer_avx512<SimilarityL2_avx512<16>>(
+            return select_distance_computer_avx512<SimilarityIP_avx512<16>>(
                     qtype, dim, trained);
         } else if (dim % 8 == 0) {
             return select_distance_computer_avx512<SimilarityIP_avx512<8>>(
@@ -64,6 +65,12 @@ InvertedListScanner* sq_select_inverted_list_scanner_avx512(
         size_t dim,
         bool store_pairs,
         bool by_residual) {
+    if (use_sq_int8_query) {
+        if (auto scanner = sel_InvertedListScanner_int8<DotU8S8_avx512>(
+                    mt, sq, quantizer, store_pairs, by_residual)) {
+            return scanner;
+        }
+    }
     if (dim % 16 == 0) {
         return sel0_InvertedListScanner_avx512<16>(
                 mt, sq, quantizer, store_pairs, by_residual);
@@ -33,4 +33,13 @@ InvertedListScanner* sq_select_inverted_list_scanner_avx512(
         bool store_pairs,
         bool by_residual);
 
+/// same as the avx512 one, with VPDPBUSD for the 8 bit inner product
+InvertedListScanner* sq_select_inverted_list_scanner_avx512_vnni(
+        MetricType mt,
+        const ScalarQuantizer* sq,
+        const Index* quantizer,
+        size_t dim,
+        bool store_pairs,
+        bool by_residual);
+
 } // namespace faiss
@@ -0,0 +1,57 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <faiss/impl/ScalarQuantizerCodec_avx512.h>
+#include <faiss/impl/ScalarQuantizerDC_avx512.h>
+#include "simd/hook.h"
+
+namespace faiss {
+
+/*******************************************************************
+ * DotU8S8_avx512_vnni: VPDPBUSD accumulates the uint8 * int8 products
+ * in int32 directly, so the weights use the full int8 range.
+ *******************************************************************/
+
+struct DotU8S8_avx512_vnni {
+    static constexpr int qmax = 127;
+
+    static int32_t dot(const uint8_t* x, const int8_t* y, size_t d) {
+        __m512i accu = _mm512_setzero_si512();
+        size_t i = 0;
+        for (; i + 64 <= d; i += 64) {
+            __m512i xi = _mm512_loadu_si512((const void*)(x + i));
+            __m512i yi = _mm512_loadu_si512((const void*)(y + i));
+            accu = _mm512_dpbusd_epi32(accu, xi, yi);
+        }
+        if (i < d) {
+            __mmask64 mask = (1ULL << (d - i)) - 1;
+            __m512i xi = _mm512_maskz_loadu_epi8(mask, x + i);
+            __m512i yi = _mm512_maskz_loadu_epi8(mask, y + i);
+            accu = _mm512_dpbusd_epi32(accu, xi, yi);
+        }
+        return _mm512_reduce_add_epi32(accu);
+    }
+};
+
+InvertedListScanner* sq_select_inverted_list_scanner_avx512_vnni(
+        MetricType mt,
+        const ScalarQuantizer* sq,
+        const Index* quantizer,
+        size_t dim,
+        bool store_pairs,
+        bool by_residual) {
+    if (use_sq_int8_query) {
+        if (auto scanner = sel_InvertedListScanner_int8<DotU8S8_avx512_vnni>(
+                    mt, sq, quantizer, store_pairs, by_residual)) {
+            return scanner;
+        }
+    }
+    return sq_select_inverted_list_scanner_avx512(
+            mt, sq, quantizer, dim, store_pairs, by_residual);
+}
+
+} // namespace faiss
@@ -29,6 +29,8 @@
 #include <faiss/Index2Layer.h>
 #include <faiss/IndexAdditiveQuantizer.h>
 #include <faiss/IndexFlat.h>
+#include <faiss/IndexFlatHalf.h>
+#include <faiss/IndexFlatInt8.h>
 #include <faiss/IndexHNSW.h>
 #include <faiss/IndexIVF.h>
 #include <faiss/IndexIVFAdditiveQuantizer.h>
@@ -36,6 +38,7 @@
 #include <faiss/IndexIVFPQ.h>
 #include <faiss/IndexIVFPQFastScan.h>
 #include <faiss/IndexIVFPQR.h>
+#include <faiss/IndexIVFRaBitQ.h>
 #include <faiss/IndexIVFSpectralHash.h>
 #include <faiss/IndexLSH.h>
 #include <faiss/IndexLattice.h>
@@ -44,6 +47,7 @@
 #include <faiss/IndexPQFastScan.h>
 #include <faiss/IndexPreTransform.h>
 #include <faiss/IndexRefine.h>
+#include <faiss/IndexScaNN.h>
 #include <faiss/IndexScalarQuantizer.h>
 #include <faiss/MetaIndexes.h>
 #include <faiss/VectorTransform.h>
@@ -183,6 +187,58 @@ static void read_ArrayInvertedLists_sizes(
     }
 }
 
+/* Reads the codes (unless skipped, as the _nm readers do) and the ids of
+ * the lists that follow their sizes. A reader over memory hands out all of
+ * them in place, then the lists are allocated and copied in parallel rather
+ * than one after the other: on a large index that serial copy is most of the
+ * load time. */
+static void read_ArrayInvertedLists_lists(
+        IOReader* f,
+        ArrayInvertedLists* ails,
+        const std::vector<size_t>& sizes,
+        bool with_codes) {
+    size_t code_size = with_codes ? ails->code_size : 0;
+    size_t total = 0;
+    for (size_t n : sizes) {
+        total += n * (code_size + sizeof(idx_t));
+    }
+    const uint8_t* data = total > 0 ? f->borrow(total) : nullptr;
+    if (data == nullptr) {
+        for (size_t i = 0; i < ails->nlist; i++) {
+            size_t n = sizes[i];
+            ails->ids[i].resize(n);
+            if (with_codes) {
+                ails->codes[i].resize(n * code_size);
+            }
+        }
+        for (size_t i = 0; i < ails->nlist; i++) {
+            size_t n = sizes[i];
+            if (n > 0) {
+                if (with_codes) {
+                    READANDCHECK(ails->codes[i].data(), n * code_size);
+                }
+                READANDCHECK(ails->ids[i].data(), n);
+            }
+        }
+        return;
+    }
+    std::vector<size_t> offsets(ails->nlist + 1, 0);
+    for (size_t i = 0; i < ails->nlist; i++) {
+        offsets[i + 1] = offsets[i] + sizes[i] * (code_size + sizeof(idx_t));
+    }
+    int64_t nlist = ails->nlist;
+#pragma omp parallel for schedule(dynamic)
+    for (int64_t i = 0; i < nlist; i++) {
+        size_t n = sizes[i];
+        const uint8_t* src = data + offsets[i];
+        if (with_codes) {
+            ails->codes[i].assign(src, src + n * code_size);
+        }
+        ails->ids[i].resize(n);
+        memcpy(ails->ids[i].data(), src + n * code_size, n * sizeof(idx_t));
+    }
+}
+
 InvertedLists* read_InvertedLists(IOReader* f, int io_flags) {
     uint32_t h;
     READ1(h);
@@ -233,11 +289,11 @@ InvertedLists* read_InvertedLists(IOReader* f, int io_flags) {
                 size_t seg_num = lca->get_segment_num(i);
                 for (size_t j = 0; j < seg_num; j++) {
                     size_t seg_size = lca->get_segment_size(i , j);
-                    size_t seg_off = lca->get_segment_offset(i, j);
-                    READANDCHECK(lca->codes[i][j].data_.data(), seg_size * lca->code_size);
-                    READANDCHECK(lca->ids[i][j].data_.data(), seg_size);
+                    auto segment = lca->get_segment(i, j);
+                    READANDCHECK(segment->codes.get(), seg_size * lca->code_size);
+                    READANDCHECK(segment->ids.get(), seg_size);
                     if (save_norm) {
-                        READANDCHECK(lca->code_norms[i][j].data_.data(), seg_size);
+                        READANDCHECK(segment->code_norms.get(), seg_size);
                     }
                 }
             }
@@ -251,17 +307,7 @@ InvertedLists* read_InvertedLists(IOReader* f, int io_flags) {
         ails->codes.resize(ails->nlist);
         std::vector<size_t> sizes(ails->nlist);
         read_ArrayInvertedLists_sizes(f, sizes);
-        for (size_t i = 0; i < ails->nlist; i++) {
-            ails->ids[i].resize(sizes[i]);
-            ails->codes[i].resize(sizes[i] * ails->code_size);
-        }
-        for (size_t i = 0; i < ails->nlist; i++) {
-            size_t n = ails->ids[i].size();
-            if (n > 0) {
-                READANDCHECK(ails->codes[i].data(), n * ails->code_size);
-                READANDCHECK(ails->ids[i].data(), n);
-            }
-        }
+        read_ArrayInvertedLists_lists(f, ails, sizes, true);
         return ails;
 
     } else if (h == fourcc("ilar") && (io_flags & IO_FLAG_SKIP_IVF_DATA)) {
@@ -310,15 +356,7 @@ InvertedLists *read_InvertedLists_nm (IOReader *f, int io_flags) {
         ails->ids.resize(ails->nlist);
         std::vector<size_t> sizes(ails->nlist);
         read_ArrayInvertedLists_sizes(f, sizes);
-        for (size_t i = 0; i < ails->nlist; i++) {
-            ails->ids[i].resize(sizes[i]);
-        }
-        for (size_t i = 0; i < ails->nlist; i++) {
-            size_t n = ails->ids[i].size();
-            if (n > 0) {
-                READANDCHECK(ails->ids[i].data(), n);
-            }
-        }
+        read_ArrayInvertedLists_lists(f, ails, sizes, false);
         return ails;
     } else if (h == fourcc ("ilar") && (io_flags & IO_FLAG_MMAP)) {
         // then we load it as an OnDiskInvertedLists
@@ -580,7 +618,8 @@ static IndexIVFPQ* read_ivfpq(IOReader* f, uint32_t h, int io_flags) {
 
     if (ivpq->is_trained) {
         // precomputed table not stored. It is cheaper to recompute it
-        ivpq->use_precomputed_table = 0;
+        ivpq->use_precomputed_table =
+                (io_flags & IO_FLAG_SKIP_PRECOMPUTED_TABLE) ? -1 : 0;
         if (ivpq->by_residual)
             ivpq->precompute_table();
         if (ivfpqr) {
@@ -592,6 +631,53 @@ static IndexIVFPQ* read_ivfpq(IOReader* f, uint32_t h, int io_flags) {
     return ivpq;
 }
 
+// Maps the raw vectors of the flat refine index of ScaNN from the file instead
+// of reading them, other refine indexes are read as usual.
+static Index* read_ScaNN_refine(IndexScaNN* idxsn, IOReader* f, int io_flags) {
+    FileIOReader* reader = dynamic_cast<FileIOReader*>(f);
+    if (!(io_flags & IO_FLAG_MMAP) || reader == nullptr) {
+        return read_index(f, io_flags);
+    }
+    FILE* fdesc = reader->f;
+    long o0 = ftell(fdesc);
+    uint32_t h;
+    READ1(h);
+    if (h != fourcc("IxFI") && h != fourcc("IxF2") && h != fourcc("IxFl")) {
+        fseek(fdesc, o0, SEEK_SET);
+        return read_index(f, io_flags);
+    }
+    IndexFlat* idxf;
+    if (h == fourcc("IxFI")) {
+        idxf = new IndexFlatIP();
+    } else if (h == fourcc("IxF2")) {
+        idxf = new IndexFlatL2();
+    } else {
+        idxf = new IndexFlat();
+    }
+    read_index_header(idxf, f);
+    idxf->code_size = idxf->d * sizeof(float);
+    size_t size;
+    READANDCHECK(&size, 1);
+    FAISS_THROW_IF_NOT(size == idxf->ntotal * idxf->d);
+    size_t o = ftell(fdesc);
+    { // do the mmap
+        struct stat buf;
+        int ret = fstat(fileno(fdesc), &buf);
+        FAISS_THROW_IF_NOT_FMT(ret == 0, "fstat failed: %s", strerror(errno));
+        FAISS_THROW_IF_NOT(o + size * sizeof(float) <= buf.st_size);
+        void* ptr = mmap(
+                nullptr, buf.st_size, PROT_READ, MAP_SHARED, fileno(fdesc), 0);
+        FAISS_THROW_IF_NOT_FMT(
+                ptr != MAP_FAILED, "could not mmap: %s", strerror(errno));
+        idxsn->mmap_ptr = ptr;
+        idxsn->mmap_size = buf.st_size;
+        idxsn->mmap_xb = (const float*)((const uint8_t*)ptr + o);
+    }
+    // resume normal reading of file
+    fseek(fdesc, o + size * sizeof(float), SEEK_SET);
+    return idxf;
+}
+
 int read_old_fmt_hack = 0;
 
 Index* read_index(IOReader* f, int io_flags) {
@@ -614,6 +700,23 @@ Index* read_index(IOReader* f, int io_flags) {
                 idxf->codes.size() == idxf->ntotal * idxf->code_size);
         // leak!
         idx = idxf;
+    } else if (h == fourcc("IxFh")) {
+        IndexFlatHalf* idxh = new IndexFlatHalf();
+        read_index_header(idxh, f);
+        READ1(idxh->bf16);
+        idxh->code_size = idxh->d * sizeof(uint16_t);
+        READVECTOR(idxh->codes);
+        FAISS_THROW_IF_NOT(
+                idxh->codes.size() == idxh->ntotal * idxh->code_size);
+        idx = idxh;
+    } else if (h == fourcc("IxF8")) {
+        IndexFlatInt8* idxi = new IndexFlatInt8();
+        read_index_header(idxi, f);
+        idxi->code_size = idxi->d;
+        READVECTOR(idxi->codes);
+        FAISS_THROW_IF_NOT(
+                idxi->codes.size() == idxi->ntotal * idxi->code_size);
+        idx = idxi;
     } else if (h == fourcc("IxHE") || h == fourcc("IxHe")) {
         IndexLSH* idxl = new IndexLSH();
         read_index_header(idxl, f);
@@ -811,6 +914,22 @@ Index* read_index(IOReader* f, int io_flags) {
         READVECTOR(ivsp->trained);
         read_InvertedLists(ivsp, f, io_flags);
         idx = ivsp;
+    } else if (h == fourcc("IwRB")) {
+        IndexIVFRaBitQ* ivrb = new IndexIVFRaBitQ();
+        read_ivf_header(ivrb, f);
+        ivrb->rotation = read_VectorTransform(f);
+        READ1(ivrb->qb);
+        // not stored by write_ivf_header
+        ivrb->code_size = ivrb->sign_size() + 2 * sizeof(float);
+        READVECTOR(ivrb->rotated_centroids);
+        bool has_refine;
+        READ1(has_refine);
+        if (has_refine) {
+            // the refine tier is read in memory, only the lists are mapped
+            ivrb->refine_index = read_index(f, io_flags & ~IO_FLAG_MMAP);
+        }
+        read_InvertedLists(ivrb, f, io_flags);
+        idx = ivrb;
     } else if (
             h == fourcc("IvPQ") || h == fourcc("IvQR") || h == fourcc("IwPQ") ||
             h == fourcc("IwQR")) {
@@ -852,6 +971,15 @@ Index* read_index(IOReader* f, int io_flags) {
         idxrf->own_fields = true;
         idxrf->own_refine_index = true;
         idx = idxrf;
+    } else if (h == fourcc("IxSN")) {
+        IndexScaNN* idxsn = new IndexScaNN();
+        read_index_header(idxsn, f);
+        idxsn->base_index = read_index(f, io_flags);
+        idxsn->refine_index = read_ScaNN_refine(idxsn, f, io_flags);
+        READ1(idxsn->k_factor);
+        idxsn->own_fields = true;
+        idxsn->own_refine_index = true;
+        idx = idxsn;
     } else if (h == fourcc("IxMp") || h == fourcc("IxM2")) {
         bool is_map2 = h == fourcc("IxM2");
         IndexIDMap* idxmap = is_map2 ? new IndexIDMap2() : new IndexIDMap();
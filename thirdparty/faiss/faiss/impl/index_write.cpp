@@ -29,6 +29,8 @@
 #include <faiss/Index2Layer.h>
 #include <faiss/IndexAdditiveQuantizer.h>
 #include <faiss/IndexFlat.h>
+#include <faiss/IndexFlatHalf.h>
+#include <faiss/IndexFlatInt8.h>
 #include <faiss/IndexHNSW.h>
 #include <faiss/IndexIVF.h>
 #include <faiss/IndexIVFAdditiveQuantizer.h>
@@ -36,6 +38,7 @@
 #include <faiss/IndexIVFPQ.h>
 #include <faiss/IndexIVFPQFastScan.h>
 #include <faiss/IndexIVFPQR.h>
+#include <faiss/IndexIVFRaBitQ.h>
 #include <faiss/IndexIVFSpectralHash.h>
 #include <faiss/IndexLSH.h>
 #include <faiss/IndexLattice.h>
@@ -44,6 +47,7 @@
 #include <faiss/IndexPQFastScan.h>
 #include <faiss/IndexPreTransform.h>
 #include <faiss/IndexRefine.h>
+#include <faiss/IndexScaNN.h>
 #include <faiss/IndexScalarQuantizer.h>
 #include <faiss/MetaIndexes.h>
 #include <faiss/VectorTransform.h>
@@ -253,6 +257,24 @@ void write_InvertedLists(const InvertedLists* ils, IOWriter* f) {
                 WRITEANDCHECK(ails->ids[i].data(), n);
             }
         }
+    } else if (
+            const auto& arena = dynamic_cast<const ArenaInvertedLists*>(ils)) {
+        // same layout as an ArrayInvertedLists without the block padding, so
+        // that it loads back either way and can be mmapped
+        uint32_t h = fourcc("ilar");
+        WRITE1(h);
+        WRITE1(arena->nlist);
+        WRITE1(arena->code_size);
+        uint32_t list_type = fourcc("full");
+        WRITE1(list_type);
+        WRITEVECTOR(arena->sizes);
+        for (size_t i = 0; i < arena->nlist; i++) {
+            size_t n = arena->list_size(i);
+            if (n > 0) {
+                WRITEANDCHECK(arena->get_codes(i), n * arena->code_size);
+                WRITEANDCHECK(arena->get_ids(i), n);
+            }
+        }
     } else if (const auto & lca =
                        dynamic_cast<const ConcurrentArrayInvertedLists *>(ils)) {
         uint32_t h = fourcc("ilca");
@@ -297,10 +319,11 @@ void write_InvertedLists(const InvertedLists* ils, IOWriter* f) {
                 size_t seg_num = lca->get_segment_num(i);
                 for (size_t j = 0; j < seg_num; j++) {
                     size_t seg_size = lca->get_segment_size(i, j);
-                    WRITEANDCHECK(lca->codes[i][j].data_.data(), seg_size * lca->code_size);
-                    WRITEANDCHECK(lca->ids[i][j].data_.data(), seg_size);
+                    auto segment = lca->get_segment(i, j);
+                    WRITEANDCHECK(segment->codes.get(), seg_size * lca->code_size);
+                    WRITEANDCHECK(segment->ids.get(), seg_size);
                     if (lca->save_norm) {
-                        WRITEANDCHECK(lca->code_norms[i][j].data_.data(), seg_size);
+                        WRITEANDCHECK(segment->code_norms.get(), seg_size);
                     }
                 }
             }
@@ -490,6 +513,21 @@ void write_index(const Index* idx, IOWriter* f) {
         WRITE1(h);
         write_index_header(idx, f);
         WRITEXBVECTOR(idxf->codes);
+    } else if (
+            const IndexFlatHalf* idxh =
+                    dynamic_cast<const IndexFlatHalf*>(idx)) {
+        uint32_t h = fourcc("IxFh");
+        WRITE1(h);
+        write_index_header(idx, f);
+        WRITE1(idxh->bf16);
+        WRITEVECTOR(idxh->codes);
+    } else if (
+            const IndexFlatInt8* idxi =
+                    dynamic_cast<const IndexFlatInt8*>(idx)) {
+        uint32_t h = fourcc("IxF8");
+        WRITE1(h);
+        write_index_header(idx, f);
+        WRITEVECTOR(idxi->codes);
     } else if (const IndexLSH* idxl = dynamic_cast<const IndexLSH*>(idx)) {
         uint32_t h = fourcc("IxHe");
         WRITE1(h);
@@ -632,6 +670,21 @@ void write_index(const Index* idx, IOWriter* f) {
         WRITE1(ivsp->threshold_type);
         WRITEVECTOR(ivsp->trained);
         write_InvertedLists(ivsp->invlists, f);
+    } else if (
+            const IndexIVFRaBitQ* ivrb =
+                    dynamic_cast<const IndexIVFRaBitQ*>(idx)) {
+        uint32_t h = fourcc("IwRB");
+        WRITE1(h);
+        write_ivf_header(ivrb, f);
+        write_VectorTransform(ivrb->rotation, f);
+        WRITE1(ivrb->qb);
+        WRITEVECTOR(ivrb->rotated_centroids);
+        bool has_refine = ivrb->refine_index != nullptr;
+        WRITE1(has_refine);
+        if (has_refine) {
+            write_index(ivrb->refine_index, f);
+        }
+        write_InvertedLists(ivrb->invlists, f);
     } else if (const IndexIVFPQ* ivpq = dynamic_cast<const IndexIVFPQ*>(idx)) {
         const IndexIVFPQR* ivfpqr = dynamic_cast<const IndexIVFPQR*>(idx);
 
@@ -666,6 +719,28 @@ void write_index(const Index* idx, IOWriter* f) {
         WRITE1(h);
         write_index_header(imiq, f);
         write_ProductQuantizer(&imiq->pq, f);
+    } else if (
+            const IndexScaNN* idxsn = dynamic_cast<const IndexScaNN*>(idx)) {
+        uint32_t h = fourcc("IxSN");
+        WRITE1(h);
+        write_index_header(idxsn, f);
+        write_index(idxsn->base_index, f);
+        if (idxsn->mmap_xb != nullptr) {
+            // the flat refine index of a mapped ScaNN holds no vectors
+            const Index* rf = idxsn->refine_index;
+            uint32_t h = fourcc(
+                    rf->metric_type == METRIC_INNER_PRODUCT ? "IxFI"
+                            : rf->metric_type == METRIC_L2  ? "IxF2"
+                                                            : "IxFl");
+            WRITE1(h);
+            write_index_header(rf, f);
+            size_t size = rf->ntotal * rf->d;
+            WRITEANDCHECK(&size, 1);
+            WRITEANDCHECK(idxsn->mmap_xb, size);
+        } else {
+            write_index(idxsn->refine_index, f);
+        }
+        WRITE1(idxsn->k_factor);
     } else if (
             const IndexRefine* idxrf = dynamic_cast<const IndexRefine*>(idx)) {
         uint32_t h = fourcc("IxRF");
@@ -34,6 +34,10 @@ struct IOReader {
     // return a file number that can be memory-mapped
     virtual int fileno();
 
+    // the next size bytes in place and advance past them, for readers over a
+    // buffer in memory; nullptr (and no advance) when the reader can only copy
+    virtual const uint8_t* borrow(size_t size);
+
     virtual ~IOReader() {}
 };
 
@@ -9,9 +9,15 @@
 
 #include <faiss/invlists/InvertedLists.h>
 
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
 #include <cstdio>
+#include <cstring>
 #include <numeric>
 
+#include <sys/mman.h>
+
 #include <faiss/impl/FaissAssert.h>
 #include <faiss/utils/utils.h>
 
@@ -313,58 +319,80 @@ InvertedLists* ArrayInvertedLists::to_readonly() {
 
 ArrayInvertedLists::~ArrayInvertedLists() {}
 
+ConcurrentArrayInvertedLists::Segment::Segment(
+        size_t segment_size,
+        size_t code_size,
+        bool save_norm)
+        : codes(new uint8_t[segment_size * code_size]),
+          ids(new idx_t[segment_size]),
+          code_norms(save_norm ? new float[segment_size] : nullptr) {}
+
+ConcurrentArrayInvertedLists::SegmentTable::SegmentTable(size_t capacity)
+        : capacity(capacity), segments(new Segment*[capacity]) {}
+
+std::atomic<uint64_t> ConcurrentArrayInvertedLists::writer_lock_waits{0};
+std::atomic<uint64_t> ConcurrentArrayInvertedLists::writer_lock_wait_ns{0};
+
 ConcurrentArrayInvertedLists::ConcurrentArrayInvertedLists(
         size_t nlist,
         size_t code_size,
         size_t segment_size,
         bool snorm)
-        : InvertedLists(nlist, code_size), segment_size(segment_size), save_norm(snorm), list_cur(nlist) {
-    ids.resize(nlist);
-    if (save_norm) {
-        code_norms.resize(nlist);
-    }
-    codes.resize(nlist);
-    for (int i = 0; i < nlist; i++) {
-        list_cur[i].store(0);
-    }
-}
+        : InvertedLists(nlist, code_size),
+          segment_size(segment_size),
+          save_norm(snorm),
+          lists(new List[nlist]) {}
 
 size_t ConcurrentArrayInvertedLists::cal_segment_num(size_t capacity) const {
     return (capacity / segment_size) + (capacity % segment_size != 0);
 }
 
 void ConcurrentArrayInvertedLists::reserve(size_t list_no, size_t capacity) {
-    size_t cur_segment_no = ids[list_no].size();
+    auto& list = lists[list_no];
     size_t target_segment_no = cal_segment_num(capacity);
-
-    for (size_t idx = cur_segment_no; idx < target_segment_no; idx++) {
-        Segment<uint8_t> segment_codes(segment_size, code_size);
-        Segment<idx_t> segment_ids(segment_size, 1);
-        Segment<float> segment_code_norms(segment_size, 1);
-        codes[list_no].emplace_back(std::move(segment_codes));
-        if (save_norm) {
-            code_norms[list_no].emplace_back(std::move(segment_code_norms));
-        }
-        ids[list_no].emplace_back(std::move(segment_ids));
+    if (target_segment_no <= list.segments.size()) {
+        return;
+    }
+    SegmentTable* table = list.table.load(std::memory_order_relaxed);
+    if (table == nullptr || table->capacity < target_segment_no) {
+        size_t capacity = std::max(
+                target_segment_no, table == nullptr ? 1 : 2 * table->capacity);
+        auto grown = std::make_unique<SegmentTable>(capacity);
+        std::copy_n(
+                table == nullptr ? nullptr : table->segments.get(),
+                list.segments.size(),
+                grown->segments.get());
+        table = grown.get();
+        list.tables.emplace_back(std::move(grown));
+    }
+    // the slots written here are beyond the published size, no reader
+    // looks at them until the table and the size are published
+    for (size_t idx = list.segments.size(); idx < target_segment_no; idx++) {
+        list.segments.emplace_back(
+                std::make_unique<Segment>(segment_size, code_size, save_norm));
+        table->segments[idx] = list.segments.back().get();
     }
+    list.table.store(table, std::memory_order_release);
 }
 
 void ConcurrentArrayInvertedLists::shrink_to_fit(size_t list_no, size_t capacity) {
-    size_t cur_segment_no = ids[list_no].size();
+    auto& list = lists[list_no];
     size_t target_segment_no = cal_segment_num(capacity);
-
-    for (size_t idx = cur_segment_no; idx > target_segment_no; idx--) {
-        ids[list_no].pop_back();
-        if (save_norm) {
-            code_norms[list_no].pop_back();
-        }
-        codes[list_no].pop_back();
+    if (target_segment_no < list.segments.size()) {
+        list.segments.resize(target_segment_no);
     }
 }
 
+const ConcurrentArrayInvertedLists::Segment* ConcurrentArrayInvertedLists::
+        get_segment(size_t list_no, size_t segment_no) const {
+    assert(list_no < nlist);
+    return lists[list_no].table.load(std::memory_order_acquire)
+            ->segments[segment_no];
+}
+
 size_t ConcurrentArrayInvertedLists::list_size(size_t list_no) const {
     assert(list_no < nlist);
-    return list_cur[list_no].load();
+    return lists[list_no].size.load(std::memory_order_acquire);
 }
 
 const uint8_t* ConcurrentArrayInvertedLists::get_codes(size_t list_no) const {
@@ -384,83 +412,43 @@ size_t ConcurrentArrayInvertedLists::add_entries(
         return 0;
 
     assert(list_no < nlist);
-    size_t o = list_size(list_no);
+    auto& list = lists[list_no];
+    std::unique_lock<std::mutex> lock(list.writer, std::try_to_lock);
+    if (!lock.owns_lock()) {
+        auto t0 = std::chrono::steady_clock::now();
+        lock.lock();
+        auto wait = std::chrono::steady_clock::now() - t0;
+        writer_lock_waits.fetch_add(1, std::memory_order_relaxed);
+        writer_lock_wait_ns.fetch_add(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(wait)
+                        .count(),
+                std::memory_order_relaxed);
+    }
+    size_t o = list.size.load(std::memory_order_relaxed);
 
     reserve(list_no, o + n_entry);
 
-    int64_t first_id  = o / segment_size;
-    int64_t first_cur = o % segment_size;
-
-    if (first_cur + n_entry <= segment_size) {
-        std::memcpy(&ids[list_no][first_id][first_cur], ids_in, n_entry * sizeof(ids_in[0]));
+    SegmentTable* table = list.table.load(std::memory_order_relaxed);
+    for (size_t done = 0; done < n_entry;) {
+        size_t segment_no = (o + done) / segment_size;
+        size_t segment_off = (o + done) % segment_size;
+        size_t len = std::min(segment_size - segment_off, n_entry - done);
+        Segment* segment = table->segments[segment_no];
+        memcpy(segment->codes.get() + segment_off * code_size,
+               codes_in + done * code_size,
+               len * code_size);
+        memcpy(segment->ids.get() + segment_off,
+               ids_in + done,
+               len * sizeof(ids_in[0]));
         if (save_norm) {
-            std::memcpy(
-                    &code_norms[list_no][first_id][first_cur],
-                    code_norms_in,
-                    n_entry * sizeof(float));
-        }
-        std::memcpy(&codes[list_no][first_id][first_cur], codes_in, n_entry * code_size);
-        list_cur[list_no].fetch_add(n_entry);
-        return o;
-    }
-
-    //process first segment
-    int64_t first_rest = segment_size - first_cur;
-    memcpy(&ids[list_no][first_id][first_cur],
-           ids_in,
-           first_rest * sizeof(ids_in[0]));
-    if (save_norm) {
-        memcpy(&code_norms[list_no][first_id][first_cur],
-           code_norms_in,
-           first_rest * sizeof(float));
-    }
-    memcpy(&codes[list_no][first_id][first_cur],
-           codes_in,
-           first_rest * code_size);
-    list_cur[list_no].fetch_add(first_rest);
-
-    auto rest_entry = n_entry - first_rest;
-    auto entry_cur  = first_rest;
-    auto segment_id = first_id;
-    //process rest segment
-    while (rest_entry > 0) {
-        segment_id = segment_id + 1;
-        if (rest_entry >= segment_size) {
-            memcpy(&codes[list_no][segment_id][0],
-                   codes_in + entry_cur * code_size,
-                   segment_size * code_size);
-            if (save_norm) {
-                memcpy(&code_norms[list_no][segment_id][0],
-                       code_norms_in + entry_cur,
-                       segment_size * sizeof(code_norms_in[0]));
-            }
-            memcpy(&ids[list_no][segment_id][0],
-                   ids_in + entry_cur,
-                   segment_size * sizeof(ids_in[0]));
-            list_cur[list_no].fetch_add(segment_size);
-
-            entry_cur += segment_size;
-            rest_entry -= segment_size;
-        } else {
-            memcpy(&codes[list_no][segment_id][0],
-                   codes_in + entry_cur * code_size,
-                   rest_entry * code_size);
-            if (save_norm) {
-                memcpy(&code_norms[list_no][segment_id][0],
-                       code_norms_in + entry_cur,
-                       rest_entry * sizeof(float));
-            }
-            memcpy(&ids[list_no][segment_id][0],
-                   ids_in + entry_cur,
-                   rest_entry * sizeof(ids_in[0]));
-            list_cur[list_no].fetch_add(rest_entry);
-
-            entry_cur += rest_entry;
-            rest_entry -= rest_entry;
+            memcpy(segment->code_norms.get() + segment_off,
+                   code_norms_in + done,
+                   len * sizeof(float));
         }
+        done += len;
     }
-    assert(entry_cur == n_entry);
-    assert(rest_entry == 0);
+    // publish the entries
+    list.size.store(o + n_entry, std::memory_order_release);
     return o;
 }
 size_t ConcurrentArrayInvertedLists::add_entries_without_codes(
@@ -482,53 +470,22 @@ void ConcurrentArrayInvertedLists::update_entries(
     assert(list_no < nlist);
     assert(n_entry + offset <= list_size(list_no));
 
-    size_t  first_id  = offset / segment_size;
-    int64_t first_cur = offset % segment_size;
-    int64_t first_rest = segment_size - first_cur;
-
-    if (n_entry <= first_rest) {
-        memcpy(&ids[list_no][first_id][first_cur], ids_in, n_entry * sizeof(ids_in[0]));
-        memcpy(&codes[list_no][first_id][first_cur], codes_in, n_entry * code_size);
-        return ;
-    }
-
-    // update first segment
-    memcpy(&ids[list_no][first_id][first_cur],
-           ids_in,
-           first_rest * sizeof(ids_in[0]));
-    memcpy(&codes[list_no][first_id][first_cur],
-           codes_in,
-           first_rest * code_size);
-
-    auto rest_entry = n_entry - first_rest;
-    auto entry_cur = first_rest;
-    auto segment_id = first_id;
-    while (rest_entry > 0) {
-        segment_id = segment_id + 1;
-        if (rest_entry >= segment_size) {
-            memcpy(&codes[list_no][segment_id][0],
-                   codes_in + entry_cur * code_size,
-                   segment_size * code_size);
-            memcpy(&ids[list_no][segment_id][0],
-                   ids_in + entry_cur,
-                   segment_size * sizeof(ids_in[0]));
-
-            entry_cur += segment_size;
-            rest_entry -= segment_size;
-        } else {
-            memcpy(&codes[list_no][segment_id][0],
-                   codes_in + entry_cur * code_size,
-                   rest_entry * code_size);
-            memcpy(&ids[list_no][segment_id][0],
-                   ids_in + entry_cur,
-                   rest_entry * sizeof(ids_in[0]));
-
-            entry_cur += rest_entry;
-            rest_entry -= rest_entry;
-        }
+    auto& list = lists[list_no];
+    std::lock_guard<std::mutex> lock(list.writer);
+    SegmentTable* table = list.table.load(std::memory_order_relaxed);
+    for (size_t done = 0; done < n_entry;) {
+        size_t segment_no = (offset + done) / segment_size;
+        size_t segment_off = (offset + done) % segment_size;
+        size_t len = std::min(segment_size - segment_off, n_entry - done);
+        Segment* segment = table->segments[segment_no];
+        memcpy(segment->codes.get() + segment_off * code_size,
+               codes_in + done * code_size,
+               len * code_size);
+        memcpy(segment->ids.get() + segment_off,
+               ids_in + done,
+               len * sizeof(ids_in[0]));
+        done += len;
     }
-    assert(entry_cur == n_entry);
-    assert(rest_entry == 0);
 }
 InvertedLists* ConcurrentArrayInvertedLists::to_readonly() {
     return InvertedLists::to_readonly();
@@ -539,27 +496,29 @@ InvertedLists* ConcurrentArrayInvertedLists::to_readonly_without_codes() {
 ConcurrentArrayInvertedLists::~ConcurrentArrayInvertedLists() {
 }
 void ConcurrentArrayInvertedLists::resize(size_t list_no, size_t new_size) {
-    size_t o = list_size(list_no);
+    auto& list = lists[list_no];
+    std::lock_guard<std::mutex> lock(list.writer);
+    size_t o = list.size.load(std::memory_order_relaxed);
 
     if (new_size >= o) {
         reserve(list_no, new_size);
-        list_cur[list_no].store(new_size);
+        list.size.store(new_size, std::memory_order_release);
     } else {
-        list_cur[list_no].store(new_size);
+        list.size.store(new_size, std::memory_order_release);
         shrink_to_fit(list_no, new_size);
     }
 
 }
 size_t ConcurrentArrayInvertedLists::get_segment_num(size_t list_no) const {
     assert(list_no < nlist);
-    auto o = list_cur[list_no].load();
+    auto o = list_size(list_no);
     return (o / segment_size) + (o % segment_size != 0);
 }
 size_t ConcurrentArrayInvertedLists::get_segment_size(
         size_t list_no,
         size_t segment_no) const {
     assert(list_no < nlist);
-    auto o = list_cur[list_no].load();
+    auto o = list_size(list_no);
     if (segment_no == 0 && o == 0) {
         return 0;
     }
@@ -576,29 +535,23 @@ size_t ConcurrentArrayInvertedLists::get_segment_offset(
         size_t list_no,
         size_t segment_no) const {
     assert(list_no < nlist);
-    auto o = list_cur[list_no].load();
-    auto seg_o = cal_segment_num(o);
-    assert(segment_no < seg_o);
+    assert(segment_no < cal_segment_num(list_size(list_no)));
     return segment_size * segment_no;
 }
 const uint8_t* ConcurrentArrayInvertedLists::get_codes(
         size_t list_no,
         size_t offset) const {
-    assert(list_no < nlist);
     assert(offset < list_size(list_no));
-    auto segment_no = offset / segment_size;
-    auto segment_off = offset % segment_size;
-    return reinterpret_cast<const uint8_t *>(&(codes[list_no][segment_no][segment_off]));
+    auto segment = get_segment(list_no, offset / segment_size);
+    return segment->codes.get() + (offset % segment_size) * code_size;
 }
 
 const InvertedLists::idx_t* ConcurrentArrayInvertedLists::get_ids(
         size_t list_no,
         size_t offset) const {
-    assert(list_no < nlist);
     assert(offset < list_size(list_no));
-    auto segment_no = offset / segment_size;
-    auto segment_off = offset % segment_size;
-    return reinterpret_cast<const idx_t *>(&(ids[list_no][segment_no][segment_off]));
+    auto segment = get_segment(list_no, offset / segment_size);
+    return segment->ids.get() + offset % segment_size;
 }
 
 
@@ -620,11 +573,9 @@ const float* ConcurrentArrayInvertedLists::get_code_norms(
     if (!save_norm) {
         return nullptr;
     } else {
-        assert(list_no < nlist);
         assert(offset < list_size(list_no));
-        auto segment_no = offset / segment_size;
-        auto segment_off = offset % segment_size;
-        return &(code_norms[list_no][segment_no][segment_off]);
+        auto segment = get_segment(list_no, offset / segment_size);
+        return segment->code_norms.get() + offset % segment_size;
     }
 }
 void ConcurrentArrayInvertedLists::release_code_norms(
@@ -841,6 +792,106 @@ bool ReadOnlyArrayInvertedLists::is_readonly() const {
     return true;
 }
 
+/*****************************************
+ * ArenaInvertedLists implementation
+ ******************************************/
+
+namespace {
+
+size_t round_up(size_t x, size_t align) {
+    return (x + align - 1) / align * align;
+}
+
+} // namespace
+
+ArenaInvertedLists::ArenaInvertedLists(
+        const InvertedLists& other,
+        bool huge_pages)
+        : ReadOnlyInvertedLists(other.nlist, other.code_size),
+          sizes(other.nlist),
+          offsets(other.nlist) {
+    size_t total = 0;
+    for (size_t i = 0; i < nlist; i++) {
+        sizes[i] = other.list_size(i);
+        offsets[i] = total;
+        total += round_up(sizes[i] * code_size, kBlockAlign) +
+                round_up(sizes[i] * sizeof(idx_t), kBlockAlign);
+    }
+    arena_size = round_up(std::max<size_t>(total, 1), kHugePageSize);
+
+    void* ptr = MAP_FAILED;
+#ifdef MAP_HUGETLB
+    if (huge_pages) {
+        // only succeeds if the system has reserved enough huge pages
+        ptr = mmap(nullptr,
+                   arena_size,
+                   PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB,
+                   -1,
+                   0);
+        this->huge_pages = ptr != MAP_FAILED;
+    }
+#endif
+    if (ptr == MAP_FAILED) {
+        ptr = mmap(nullptr,
+                   arena_size,
+                   PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS,
+                   -1,
+                   0);
+        FAISS_THROW_IF_NOT_FMT(
+                ptr != MAP_FAILED,
+                "could not allocate an arena of %zd bytes: %s",
+                arena_size,
+                strerror(errno));
+#ifdef MADV_HUGEPAGE
+        if (huge_pages) {
+            madvise(ptr, arena_size, MADV_HUGEPAGE);
+        }
+#endif
+    }
+    arena = (uint8_t*)ptr;
+
+    for (size_t i = 0; i < nlist; i++) {
+        if (sizes[i] == 0) {
+            continue;
+        }
+        ScopedCodes codes(&other, i);
+        ScopedIds ids(&other, i);
+        memcpy(arena + offsets[i], codes.get(), sizes[i] * code_size);
+        memcpy(const_cast<idx_t*>(get_ids(i)),
+               ids.get(),
+               sizes[i] * sizeof(idx_t));
+    }
+}
+
+size_t ArenaInvertedLists::list_size(size_t list_no) const {
+    FAISS_ASSERT(list_no < nlist);
+    return sizes[list_no];
+}
+
+const uint8_t* ArenaInvertedLists::get_codes(size_t list_no) const {
+    FAISS_ASSERT(list_no < nlist);
+    return arena + offsets[list_no];
+}
+
+const InvertedLists::idx_t* ArenaInvertedLists::get_ids(
+        size_t list_no) const {
+    FAISS_ASSERT(list_no < nlist);
+    return (const idx_t*)(arena + offsets[list_no] +
+                          round_up(sizes[list_no] * code_size, kBlockAlign));
+}
+
+bool ArenaInvertedLists::is_readonly() const {
+    return true;
+}
+
+ArenaInvertedLists::~ArenaInvertedLists() {
+    if (arena) {
+        munmap(arena, arena_size);
+    }
+}
+
 /*****************************************************************
  * Meta-inverted list implementations
  *****************************************************************/
@@ -20,6 +20,7 @@
 #include <atomic>
 #include <set>
 #include <deque>
+#include <mutex>
 #include <faiss/Index.h>
 
 namespace faiss {
@@ -337,30 +338,51 @@ struct ArrayInvertedLists : InvertedLists {
 };
 
 // A Concurrent implementation for inverted lists
+//
+// A list is stored in segments of segment_size entries that never move once
+// allocated. Appends to a list are serialized by its writer mutex and publish
+// the new list size only after the entries are written, so that searches read
+// a consistent prefix of every list without taking locks.
 struct ConcurrentArrayInvertedLists : InvertedLists {
-    template <typename T>
     struct Segment {
-        Segment(size_t segment_size, size_t code_size) : segment_size_(segment_size), code_size_(code_size) {
-            data_.reserve(segment_size_ * code_size_);
-        }
-        T& operator[](Index::idx_t idx) {
-            assert(idx < segment_size_);
-            return data_[idx * code_size_];
-        }
-        const T& operator[](Index::idx_t idx) const {
-            assert(idx < segment_size_);
-            return data_[idx * code_size_];
-        }
-        size_t segment_size_;
-        size_t code_size_;
-        std::vector<T> data_;
+        Segment(size_t segment_size, size_t code_size, bool save_norm);
+        std::unique_ptr<uint8_t[]> codes;
+        std::unique_ptr<idx_t[]> ids;
+        std::unique_ptr<float[]> code_norms;
     };
 
+    /// the segments of a list as seen by readers, replaced by a copy twice
+    /// as large when it is full
+    struct SegmentTable {
+        explicit SegmentTable(size_t capacity);
+        size_t capacity;
+        std::unique_ptr<Segment*[]> segments;
+    };
+
+    struct List {
+        /// number of entries readers can see
+        std::atomic<size_t> size{0};
+        std::atomic<SegmentTable*> table{nullptr};
+        /// owned by the writers: the segments, and the current table with the
+        /// ones it replaced, which readers may still hold
+        std::vector<std::unique_ptr<Segment>> segments;
+        std::vector<std::unique_ptr<SegmentTable>> tables;
+        std::mutex writer;
+    };
+
+    /// appends that found the writer mutex of their list held, and the time
+    /// they waited for it, over all the lists of the process
+    static std::atomic<uint64_t> writer_lock_waits;
+    static std::atomic<uint64_t> writer_lock_wait_ns;
+
     ConcurrentArrayInvertedLists(size_t nlist, size_t code_size, size_t segment_size, bool save_normal);
 
     size_t cal_segment_num(size_t capacity) const;
+    /// reserve and shrink_to_fit are called with the writer mutex of the list
+    /// held, shrinking is not safe alongside readers
     void reserve(size_t list_no, size_t capacity);
     void shrink_to_fit(size_t list_no, size_t capacity);
+    const Segment* get_segment(size_t list_no, size_t segment_no) const;
 
     size_t list_size(size_t list_no) const override;
     const uint8_t* get_codes(size_t list_no) const override;
@@ -409,10 +431,7 @@ struct ConcurrentArrayInvertedLists : InvertedLists {
 
     const size_t segment_size;
     const bool save_norm;
-    std::vector<std::atomic<size_t>> list_cur;
-    std::vector<std::deque<Segment<uint8_t>>> codes;
-    std::vector<std::deque<Segment<idx_t>>> ids;
-    std::vector<std::deque<Segment<float>>> code_norms;
+    std::unique_ptr<List[]> lists;
 };
 
 struct ReadOnlyArrayInvertedLists: InvertedLists {
@@ -509,6 +528,36 @@ struct ReadOnlyInvertedLists : InvertedLists {
     void resize(size_t list_no, size_t new_size) override;
 };
 
+/** All the lists packed into one arena: the codes of a list are followed by
+ * its ids, and every block starts on a cache line. The arena is anonymous
+ * memory, taken from 2MB huge pages when asked to, or else advised to use
+ * transparent huge pages. Serialized as an ArrayInvertedLists.
+ */
+struct ArenaInvertedLists : ReadOnlyInvertedLists {
+    static constexpr size_t kBlockAlign = 64;
+    static constexpr size_t kHugePageSize = size_t(2) << 20;
+
+    uint8_t* arena = nullptr;
+    size_t arena_size = 0;
+    bool huge_pages = false;
+    std::vector<size_t> sizes;   ///< entries of each list
+    std::vector<size_t> offsets; ///< offset of the codes of each list
+
+    /// copies the content of `other`
+    ArenaInvertedLists(const InvertedLists& other, bool huge_pages);
+
+    ArenaInvertedLists(const ArenaInvertedLists&) = delete;
+    ArenaInvertedLists& operator=(const ArenaInvertedLists&) = delete;
+
+    size_t list_size(size_t list_no) const override;
+    const uint8_t* get_codes(size_t list_no) const override;
+    const idx_t* get_ids(size_t list_no) const override;
+
+    bool is_readonly() const override;
+
+    ~ArenaInvertedLists() override;
+};
+
 /// Horizontal stack of inverted lists
 struct HStackInvertedLists : ReadOnlyInvertedLists {
     std::vector<const InvertedLists*> ils;
@@ -11,6 +11,7 @@
 
 #include <pthread.h>
 
+#include <algorithm>
 #include <unordered_set>
 
 #include <sys/mman.h>
@@ -256,7 +257,55 @@ struct OnDiskInvertedLists::OngoingPrefetch {
 
 int OnDiskInvertedLists::OngoingPrefetch::global_cs = 0;
 
+namespace {
+
+/* Asks the kernel to read the lists ahead with madvise(MADV_WILLNEED), the
+ * lists of a batch merged into as few page aligned ranges as possible. The
+ * readahead runs in the background, so the scan of the first lists overlaps
+ * with the reads of the next ones instead of faulting them in one by one. */
+void madvise_lists(
+        const OnDiskInvertedLists& od,
+        const Index::idx_t* list_nos,
+        int n) {
+    static const size_t page_size = sysconf(_SC_PAGESIZE);
+    std::vector<std::pair<size_t, size_t>> ranges;
+    ranges.reserve(n);
+    for (int i = 0; i < n; i++) {
+        Index::idx_t list_no = list_nos[i];
+        if (list_no < 0 || static_cast<size_t>(list_no) >= od.nlist) {
+            continue;
+        }
+        const OnDiskOneList& l = od.lists[list_no];
+        if (l.size == 0) {
+            continue;
+        }
+        // the codes, then the ids after the capacity of the codes
+        size_t end = l.offset + l.capacity * od.code_size +
+                l.size * sizeof(Index::idx_t);
+        end = std::min((end + page_size - 1) / page_size * page_size,
+                       od.totsize);
+        ranges.emplace_back(l.offset / page_size * page_size, end);
+    }
+    std::sort(ranges.begin(), ranges.end());
+    for (size_t i = 0; i < ranges.size();) {
+        size_t begin = ranges[i].first, end = ranges[i].second;
+        for (i++; i < ranges.size() && ranges[i].first <= end; i++) {
+            end = std::max(end, ranges[i].second);
+        }
+        // advisory only, on failure the lists are faulted in by the scan
+        madvise(od.ptr + begin, end - begin, MADV_WILLNEED);
+    }
+}
+
+} // namespace
+
 void OnDiskInvertedLists::prefetch_lists(const idx_t* list_nos, int n) const {
+    // read only lists do not move, the kernel reads them ahead without
+    // taking locks or starting threads for every batch of queries
+    if (read_only && ptr != nullptr) {
+        madvise_lists(*this, list_nos, n);
+        return;
+    }
     pf->prefetch_lists(list_nos, n);
 }
 
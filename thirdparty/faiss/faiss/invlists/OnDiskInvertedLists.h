@@ -55,7 +55,8 @@ struct OnDiskOneList {
  *
  * When it is known that a set of lists will be accessed, it is useful
  * to call prefetch_lists, that launches a set of threads to read the
- * lists in parallel.
+ * lists in parallel. Read only lists, e.g. the mmapped ones of
+ * IO_FLAG_MMAP, are read ahead by the kernel with madvise instead.
  */
 struct OnDiskInvertedLists : InvertedLists {
     using List = OnDiskOneList;
@@ -21,6 +21,7 @@
 #ifndef FAISS_Heap_h
 #define FAISS_Heap_h
 
+#include <algorithm>
 #include <climits>
 #include <cmath>
 #include <cstring>
@@ -266,6 +267,44 @@ inline void heap_addn(
         }
 }
 
+/* Add the elements better than the top of the heap, filtering them without
+ * branches first: the n distances are compared to the top in blocks of
+ * heap_filter_block into a bit mask, only the set bits are tested against
+ * keep(j), which e.g. checks a bitset, and pushed with id id_of(j). Far less
+ * branches than heap_addn when few of the n make it. Returns the number of
+ * pushes. */
+constexpr size_t heap_filter_block = 32;
+
+template <class C, class Keep, class IdOf>
+inline size_t heap_addn_filtered(
+        size_t k,
+        typename C::T* bh_val,
+        typename C::TI* bh_ids,
+        const typename C::T* x,
+        size_t n,
+        Keep keep,
+        IdOf id_of) {
+    size_t nup = 0;
+    for (size_t j0 = 0; j0 < n; j0 += heap_filter_block) {
+        size_t nb = std::min(heap_filter_block, n - j0);
+        typename C::T thresh = bh_val[0];
+        uint32_t mask = 0;
+        for (size_t b = 0; b < nb; b++) {
+            mask |= uint32_t(C::cmp(thresh, x[j0 + b])) << b;
+        }
+        while (mask) {
+            size_t j = j0 + __builtin_ctz(mask);
+            mask &= mask - 1;
+            // the top moved since the mask was made
+            if (keep(j) && C::cmp(bh_val[0], x[j])) {
+                heap_replace_top<C>(k, bh_val, bh_ids, x[j], id_of(j));
+                nup++;
+            }
+        }
+    }
+    return nup;
+}
+
 /* Partial instanciation for heaps with TI = int64_t */
 
 template <typename T>
@@ -16,6 +16,8 @@
 
 #include <omp.h>
 
+#include <type_traits>
+
 #include <faiss/utils/hamming.h>
 #include <faiss/utils/jaccard-inl.h>
 #include <faiss/utils/structure-inl.h>
@@ -349,6 +351,13 @@ void binary_knn_mc(
     }
 }
 
+// the computers of the code sizes without a specialization, which compute a
+// block of codes at once with the batched kernels of the hook
+template <class MetricComputer>
+constexpr bool is_batched_computer =
+        std::is_same_v<MetricComputer, HammingComputerDefault> ||
+        std::is_same_v<MetricComputer, JaccardComputerDefault>;
+
 template <class C, class MetricComputer>
 void binary_knn_hc(
         int bytes_per_code,
@@ -448,6 +457,28 @@ void binary_knn_hc(
                 T dis;
                 T* __restrict bh_val_ = ha->val + i * k;
                 int64_t* __restrict bh_ids_ = ha->ids + i * k;
+                if constexpr (is_batched_computer<MetricComputer>) {
+                    float block_dis[heap_filter_block];
+                    for (size_t jb = j0; jb < j1; jb += heap_filter_block) {
+                        size_t nb = std::min(heap_filter_block, j1 - jb);
+                        uint64_t filtered =
+                                bitset.empty() ? 0 : bitset.block(jb, nb);
+                        if (filtered == (uint64_t(1) << nb) - 1) {
+                            continue;
+                        }
+                        hc.compute_ny(
+                                block_dis, bs2 + jb * bytes_per_code, nb);
+                        for (size_t b = 0; b < nb; b++) {
+                            dis = block_dis[b];
+                            if (!((filtered >> b) & 1) &&
+                                C::cmp(bh_val_[0], dis)) {
+                                faiss::heap_replace_top<C>(
+                                        k, bh_val_, bh_ids_, dis, jb + b);
+                            }
+                        }
+                    }
+                    continue;
+                }
                 for (size_t j = j0; j < j1; j++, bs2_ += bytes_per_code) {
                     if (bitset.empty() || !bitset.test(j)) {
                         dis = hc.compute(bs2_);
@@ -19,6 +19,7 @@
 #include <faiss/impl/AuxIndexStructures.h>
 #include <faiss/utils/Heap.h>
 #include <knowhere/bitsetview.h>
+#include <simd/hook.h>
 #include <stdint.h>
 
 /* The binary distance type */
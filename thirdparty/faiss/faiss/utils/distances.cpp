@@ -115,18 +115,29 @@ void exhaustive_parallel_on_nx(
 #pragma omp parallel
     {
         SingleResultHandler resi(res);
+        float block_dis[heap_filter_block];
 #pragma omp for
         for (int64_t i = 0; i < nx; i++) {
             const float* x_i = x + i * d;
-            const float* y_j = y;
 
             resi.begin(i);
-            for (size_t j = 0; j < ny; j++) {
-                if (bitset.empty() || !bitset.test(j)) {
-                    float ip = dis_compute_func(x_i, y_j, d);
-                    resi.add_result(ip, j);
+            // the distances of a block reach the handler together, which
+            // filters them against its threshold without branches
+            for (size_t j0 = 0; j0 < ny; j0 += heap_filter_block) {
+                size_t nb = std::min(heap_filter_block, ny - j0);
+                // one load of the bitset for the whole block, the blocks
+                // that are all filtered out are skipped
+                uint64_t filtered = bitset.empty() ? 0 : bitset.block(j0, nb);
+                if (filtered == (uint64_t(1) << nb) - 1) {
+                    continue;
+                }
+                auto keep = [&](size_t b) { return !((filtered >> b) & 1); };
+                for (size_t b = 0; b < nb; b++) {
+                    block_dis[b] = keep(b)
+                            ? dis_compute_func(x_i, y + (j0 + b) * d, d)
+                            : 0;
                 }
-                y_j += d;
+                resi.add_results(nb, block_dis, j0, keep);
             }
             resi.end();
         }
@@ -239,14 +250,12 @@ void exhaustive_inner_product_seq(
 #pragma omp for
         for (int64_t i = 0; i < nx; i++) {
             const float* x_i = x + i * d;
-            const float* y_j = y;
             resi.begin(i);
-            for (size_t j = 0; j < ny; j++) {
-                if (bitset.empty() || !bitset.test(j)) {
-                    float ip = fvec_inner_product(x_i, y_j, d);
-                    resi.add_result(ip, j);
-                }
-                y_j += d;
+            // jump over the runs of filtered out ids a word at a time
+            for (size_t j = bitset.empty() ? 0 : bitset.next_unset(0); j < ny;
+                 j = bitset.empty() ? j + 1 : bitset.next_unset(j + 1)) {
+                float ip = fvec_inner_product(x_i, y + j * d, d);
+                resi.add_result(ip, j);
             }
             resi.end();
         }
@@ -271,26 +280,18 @@ void exhaustive_L2sqr_seq(
 #pragma omp for
         for (int64_t i = 0; i < nx; i++) {
             const float* x_i = x + i * d;
-            const float* y_j = y;
             resi.begin(i);
-            for (size_t j = 0; j < ny; j++) {
-                if (bitset.empty() || !bitset.test(j)) {
-                    float disij = fvec_L2sqr(x_i, y_j, d);
-                    resi.add_result(disij, j);
-                }
-                y_j += d;
+            // jump over the runs of filtered out ids a word at a time
+            for (size_t j = bitset.empty() ? 0 : bitset.next_unset(0); j < ny;
+                 j = bitset.empty() ? j + 1 : bitset.next_unset(j + 1)) {
+                float disij = fvec_L2sqr(x_i, y + j * d, d);
+                resi.add_result(disij, j);
             }
             resi.end();
         }
     }
 }
 
-namespace {
-float fvec_cosine(const float* x, const float* y, size_t d) {
-    return fvec_inner_product(x, y, d) / sqrtf(fvec_norm_L2sqr(y, d));
-}
-} // namespace
-
 template <class ResultHandler>
 void exhaustive_cosine_seq(
         const float* x,
@@ -309,20 +310,55 @@ void exhaustive_cosine_seq(
 #pragma omp for
         for (int64_t i = 0; i < nx; i++) {
             const float* x_i = x + i * d;
-            const float* y_j = y;
             resi.begin(i);
-            for (size_t j = 0; j < ny; j++) {
-                if (bitset.empty() || !bitset.test(j)) {
-                    float disij = fvec_cosine(x_i, y_j, d);
-                    resi.add_result(disij, j);
-                }
-                y_j += d;
+            // jump over the runs of filtered out ids a word at a time
+            for (size_t j = bitset.empty() ? 0 : bitset.next_unset(0); j < ny;
+                 j = bitset.empty() ? j + 1 : bitset.next_unset(j + 1)) {
+                float disij = fvec_cosine(x_i, y + j * d, d);
+                resi.add_result(disij, j);
             }
             resi.end();
         }
     }
 }
 
+/* the inner products of the nx rows of x and the ny rows of y,
+ * ip[i * ny + j]. A gemm kernel of the hook (AMX) is single threaded, the
+ * rows of x are split between the threads; sgemm otherwise */
+void inner_products_block(
+        float* ip,
+        const float* x,
+        const float* y,
+        size_t d,
+        size_t nx,
+        size_t ny) {
+    if (fvec_inner_products_gemm != nullptr) {
+        const int64_t bs = 256;
+#pragma omp parallel for if (nx > bs)
+        for (int64_t i0 = 0; i0 < (int64_t)nx; i0 += bs) {
+            size_t i1 = std::min<size_t>(nx, i0 + bs);
+            fvec_inner_products_gemm(
+                    ip + i0 * ny, x + i0 * d, y, d, i1 - i0, ny);
+        }
+        return;
+    }
+    float one = 1, zero = 0;
+    FINTEGER nyi = ny, nxi = nx, di = d;
+    sgemm_("Transpose",
+           "Not transpose",
+           &nyi,
+           &nxi,
+           &di,
+           &one,
+           y,
+           &di,
+           x,
+           &di,
+           &zero,
+           ip,
+           &nyi);
+}
+
 /** Find the nearest neighbors for nx queries in a set of ny vectors */
 template <class ResultHandler>
 void exhaustive_inner_product_blas(
@@ -340,7 +376,7 @@ void exhaustive_inner_product_blas(
     /* block sizes */
     const size_t bs_x = distance_compute_blas_query_bs;
     const size_t bs_y = distance_compute_blas_database_bs;
-    std::unique_ptr<float[]> ip_block(new float[bs_x * bs_y]);
+    std::unique_ptr<float[]> ip_block(new float[std::min(bs_x, nx) * bs_y]);
 
     for (size_t i0 = 0; i0 < nx; i0 += bs_x) {
         size_t i1 = i0 + bs_x;
@@ -354,23 +390,8 @@ void exhaustive_inner_product_blas(
             if (j1 > ny)
                 j1 = ny;
             /* compute the actual dot products */
-            {
-                float one = 1, zero = 0;
-                FINTEGER nyi = j1 - j0, nxi = i1 - i0, di = d;
-                sgemm_("Transpose",
-                       "Not transpose",
-                       &nyi,
-                       &nxi,
-                       &di,
-                       &one,
-                       y + j0 * d,
-                       &di,
-                       x + i0 * d,
-                       &di,
-                       &zero,
-                       ip_block.get(),
-                       &nyi);
-            }
+            inner_products_block(
+                    ip_block.get(), x + i0 * d, y + j0 * d, d, i1 - i0, j1 - j0);
 
             res.add_results(j0, j1, ip_block.get(), bitset);
         }
@@ -399,7 +420,7 @@ void exhaustive_L2sqr_blas(
     const size_t bs_x = distance_compute_blas_query_bs;
     const size_t bs_y = distance_compute_blas_database_bs;
     // const size_t bs_x = 16, bs_y = 16;
-    std::unique_ptr<float[]> ip_block(new float[bs_x * bs_y]);
+    std::unique_ptr<float[]> ip_block(new float[std::min(bs_x, nx) * bs_y]);
     std::unique_ptr<float[]> x_norms(new float[nx]);
     std::unique_ptr<float[]> del2;
 
@@ -424,23 +445,8 @@ void exhaustive_L2sqr_blas(
             if (j1 > ny)
                 j1 = ny;
             /* compute the actual dot products */
-            {
-                float one = 1, zero = 0;
-                FINTEGER nyi = j1 - j0, nxi = i1 - i0, di = d;
-                sgemm_("Transpose",
-                       "Not transpose",
-                       &nyi,
-                       &nxi,
-                       &di,
-                       &one,
-                       y + j0 * d,
-                       &di,
-                       x + i0 * d,
-                       &di,
-                       &zero,
-                       ip_block.get(),
-                       &nyi);
-            }
+            inner_products_block(
+                    ip_block.get(), x + i0 * d, y + j0 * d, d, i1 - i0, j1 - j0);
 #pragma omp parallel for
             for (int64_t i = i0; i < i1; i++) {
                 float* ip_line = ip_block.get() + (i - i0) * (j1 - j0);
@@ -473,6 +479,7 @@ void exhaustive_cosine_blas(
         size_t nx,
         size_t ny,
         ResultHandler& res,
+        const float* y_norms = nullptr,
         const BitsetView bitset = nullptr) {
     // BLAS does not like empty matrices
     if (nx == 0 || ny == 0)
@@ -482,11 +489,18 @@ void exhaustive_cosine_blas(
     const size_t bs_x = distance_compute_blas_query_bs;
     const size_t bs_y = distance_compute_blas_database_bs;
     // const size_t bs_x = 16, bs_y = 16;
-    std::unique_ptr<float[]> ip_block(new float[bs_x * bs_y]);
-    std::unique_ptr<float[]> y_norms(new float[nx]);
+    std::unique_ptr<float[]> ip_block(new float[std::min(bs_x, nx) * bs_y]);
+    std::unique_ptr<float[]> x_norms(new float[std::min(bs_x, nx)]);
     std::unique_ptr<float[]> del2;
 
-    fvec_norms_L2(y_norms.get(), x, d, nx);
+    // neither the queries nor the database vectors need to be normalized,
+    // the inner products are divided by both norms
+    if (!y_norms) {
+        float* y_norms2 = new float[ny];
+        del2.reset(y_norms2);
+        fvec_norms_L2(y_norms2, y, d, ny);
+        y_norms = y_norms2;
+    }
 
     for (size_t i0 = 0; i0 < nx; i0 += bs_x) {
         size_t i1 = i0 + bs_x;
@@ -494,36 +508,25 @@ void exhaustive_cosine_blas(
             i1 = nx;
 
         res.begin_multiple(i0, i1);
+        fvec_norms_L2(x_norms.get(), x + i0 * d, d, i1 - i0);
 
         for (size_t j0 = 0; j0 < ny; j0 += bs_y) {
             size_t j1 = j0 + bs_y;
             if (j1 > ny)
                 j1 = ny;
             /* compute the actual dot products */
-            {
-                float one = 1, zero = 0;
-                FINTEGER nyi = j1 - j0, nxi = i1 - i0, di = d;
-                sgemm_("Transpose",
-                       "Not transpose",
-                       &nyi,
-                       &nxi,
-                       &di,
-                       &one,
-                       y + j0 * d,
-                       &di,
-                       x + i0 * d,
-                       &di,
-                       &zero,
-                       ip_block.get(),
-                       &nyi);
-            }
+            inner_products_block(
+                    ip_block.get(), x + i0 * d, y + j0 * d, d, i1 - i0, j1 - j0);
 #pragma omp parallel for
             for (int64_t i = i0; i < i1; i++) {
                 float* ip_line = ip_block.get() + (i - i0) * (j1 - j0);
+                // a zero query is at 0 from everything
+                float x_norm = x_norms[i - i0];
+                float x_inv_norm = x_norm > 0 ? 1.0f / x_norm : 0.0f;
 
                 for (size_t j = j0; j < j1; j++) {
                     float ip = *ip_line;
-                    float dis = ip / y_norms[j];
+                    float dis = ip * x_inv_norm / y_norms[j];
                     *ip_line = dis;
                     ip_line++;
                 }
@@ -572,23 +575,8 @@ static void knn_jaccard_blas(
             if (j1 > ny)
                 j1 = ny;
             /* compute the actual dot products */
-            {
-                float one = 1, zero = 0;
-                FINTEGER nyi = j1 - j0, nxi = i1 - i0, di = d;
-                sgemm_("Transpose",
-                       "Not transpose",
-                       &nyi,
-                       &nxi,
-                       &di,
-                       &one,
-                       y + j0 * d,
-                       &di,
-                       x + i0 * d,
-                       &di,
-                       &zero,
-                       ip_block,
-                       &nyi);
-            }
+            inner_products_block(
+                    ip_block, x + i0 * d, y + j0 * d, d, i1 - i0, j1 - j0);
 
             /* collect minima */
 #pragma omp parallel for
@@ -700,20 +688,78 @@ void knn_cosine(
         if (nx < distance_compute_blas_threshold) {
             exhaustive_L2sqr_IP_seq(x, y, d, nx, ny, res, fvec_cosine, bitset);
         } else {
-            exhaustive_cosine_blas(x, y, d, nx, ny, res, bitset);
+            exhaustive_cosine_blas(x, y, d, nx, ny, res, nullptr, bitset);
         }
     } else {
         ReservoirResultHandler<CMin<float, int64_t>> res(
                 ha->nh, ha->val, ha->ids, ha->k);
         if (nx < distance_compute_blas_threshold) {
-            exhaustive_L2sqr_IP_seq(
-                    x, y, d, nx, ny, res, fvec_inner_product, bitset);
+            exhaustive_L2sqr_IP_seq(x, y, d, nx, ny, res, fvec_cosine, bitset);
         } else {
-            exhaustive_cosine_blas(x, y, d, nx, ny, res, bitset);
+            exhaustive_cosine_blas(x, y, d, nx, ny, res, nullptr, bitset);
         }
     }
 }
 
+void knn_inner_product_blas(
+        const float* x,
+        const float* y,
+        size_t d,
+        size_t nx,
+        size_t ny,
+        float_minheap_array_t* ha,
+        const BitsetView bitset) {
+    if (ha->k < distance_compute_min_k_reservoir) {
+        HeapResultHandler<CMin<float, int64_t>> res(
+                ha->nh, ha->val, ha->ids, ha->k);
+        exhaustive_inner_product_blas(x, y, d, nx, ny, res, bitset);
+    } else {
+        ReservoirResultHandler<CMin<float, int64_t>> res(
+                ha->nh, ha->val, ha->ids, ha->k);
+        exhaustive_inner_product_blas(x, y, d, nx, ny, res, bitset);
+    }
+}
+
+void knn_L2sqr_blas(
+        const float* x,
+        const float* y,
+        size_t d,
+        size_t nx,
+        size_t ny,
+        float_maxheap_array_t* ha,
+        const float* y_norm2,
+        const BitsetView bitset) {
+    if (ha->k < distance_compute_min_k_reservoir) {
+        HeapResultHandler<CMax<float, int64_t>> res(
+                ha->nh, ha->val, ha->ids, ha->k);
+        exhaustive_L2sqr_blas(x, y, d, nx, ny, res, y_norm2, bitset);
+    } else {
+        ReservoirResultHandler<CMax<float, int64_t>> res(
+                ha->nh, ha->val, ha->ids, ha->k);
+        exhaustive_L2sqr_blas(x, y, d, nx, ny, res, y_norm2, bitset);
+    }
+}
+
+void knn_cosine_blas(
+        const float* x,
+        const float* y,
+        size_t d,
+        size_t nx,
+        size_t ny,
+        float_minheap_array_t* ha,
+        const float* y_norms,
+        const BitsetView bitset) {
+    if (ha->k < distance_compute_min_k_reservoir) {
+        HeapResultHandler<CMin<float, int64_t>> res(
+                ha->nh, ha->val, ha->ids, ha->k);
+        exhaustive_cosine_blas(x, y, d, nx, ny, res, y_norms, bitset);
+    } else {
+        ReservoirResultHandler<CMin<float, int64_t>> res(
+                ha->nh, ha->val, ha->ids, ha->k);
+        exhaustive_cosine_blas(x, y, d, nx, ny, res, y_norms, bitset);
+    }
+}
+
 struct NopDistanceCorrection {
     float operator()(float dis, size_t /*qno*/, size_t /*bno*/) const {
         return dis;
@@ -790,7 +836,7 @@ void range_search_cosine(
     if (nx < distance_compute_blas_threshold) {
         exhaustive_cosine_seq(x, y, d, nx, ny, resh, bitset);
     } else {
-        exhaustive_cosine_blas(x, y, d, nx, ny, resh, bitset);
+        exhaustive_cosine_blas(x, y, d, nx, ny, resh, nullptr, bitset);
     }
 }
 
@@ -199,6 +199,10 @@ void knn_L2sqr(
         const float* y_norm2 = nullptr,
         const BitsetView bitset = nullptr);
 
+/** Return the k nearest neighbors of each of the nx vectors x among the ny
+ * vector y, w.r.t. the cosine similarity. Neither x nor y needs to be
+ * normalized, the distances are divided by both norms.
+ */
 void knn_cosine(
         const float* x,
         const float* y,
@@ -208,6 +212,44 @@ void knn_cosine(
         float_minheap_array_t* ha,
         const BitsetView bitset);
 
+/** Same as knn_inner_product, knn_L2sqr and knn_cosine, always through the
+ * blocked BLAS path whatever nx: the distances of a block of queries to a
+ * block of database vectors come from one sgemm and are merged into the
+ * results before the next block. Meant for callers that split the queries
+ * over their own threads.
+ *
+ * @param y_norms    L2 norms (squared for knn_L2sqr_blas) of the y vectors,
+ *                   nullptr or size ny
+ */
+void knn_inner_product_blas(
+        const float* x,
+        const float* y,
+        size_t d,
+        size_t nx,
+        size_t ny,
+        float_minheap_array_t* ha,
+        const BitsetView bitset = nullptr);
+
+void knn_L2sqr_blas(
+        const float* x,
+        const float* y,
+        size_t d,
+        size_t nx,
+        size_t ny,
+        float_maxheap_array_t* ha,
+        const float* y_norm2 = nullptr,
+        const BitsetView bitset = nullptr);
+
+void knn_cosine_blas(
+        const float* x,
+        const float* y,
+        size_t d,
+        size_t nx,
+        size_t ny,
+        float_minheap_array_t* ha,
+        const float* y_norms = nullptr,
+        const BitsetView bitset = nullptr);
+
 void knn_jaccard(
         const float* x,
         const float* y,
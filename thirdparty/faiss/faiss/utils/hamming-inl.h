@@ -233,8 +233,14 @@ struct HammingComputerDefault {
         this->n = code_size;
     }
 
+    // the code sizes without a specialization go to the simd kernels of the
+    // hook, which take any size
     int compute(const uint8_t* b8) const {
-        return xor_popcnt(a8, b8, n);
+        return bvec_hamming(a8, b8, n);
+    }
+
+    void compute_ny(float* dis, const uint8_t* b8, size_t ny) const {
+        bvec_hamming_ny(dis, a8, b8, n, ny);
     }
 };
 
@@ -451,7 +451,11 @@ struct JaccardComputerDefault {
     }
 
     float compute(const uint8_t* b8) const {
-        return bvec_jaccard(a, b8, n);
+        return bvec_jaccard_dis(a, b8, n);
+    }
+
+    void compute_ny(float* dis, const uint8_t* b8, size_t ny) const {
+        bvec_jaccard_ny(dis, a, b8, n, ny);
     }
 };
 
@@ -407,8 +407,8 @@ namespace faiss {
         }
 
         bool compute(const uint8_t *b8) const {
-            return (is_super ? is_subset(b8, a, n)
-                             : is_subset(a, b8, n));
+            return (is_super ? bvec_is_subset(b8, a, n)
+                             : bvec_is_subset(a, b8, n));
         }
     };
 }
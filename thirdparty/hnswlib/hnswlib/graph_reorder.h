@@ -0,0 +1,230 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace hnswlib {
+
+///////////////////////////////////////////////////////////
+//
+// Locality-improving orderings of a graph. Each function takes the number of
+// nodes and `neighbors(u)`, which returns the out-edges of u as a
+// (pointer, count) pair, and returns `order` with order[new_id] = old_id.
+//
+/////////////////////////////////////////////////////////
+
+enum class ReorderType {
+    NONE = 0,
+    BFS = 1,     // breadth first from the entry point
+    RCM = 2,     // reverse Cuthill-McKee
+    GORDER = 3,  // greedy window based, places nodes next to the ones they share edges with
+};
+
+// BFS from `start`; nodes it does not reach are traversed from the lowest unvisited id.
+template <typename NeighborFn>
+std::vector<uint32_t>
+ReorderBFS(size_t n, uint32_t start, NeighborFn&& neighbors) {
+    std::vector<uint32_t> order;
+    order.reserve(n);
+    std::vector<bool> visited(n, false);
+    size_t scan = 0;
+    uint32_t root = start;
+    while (order.size() < n) {
+        if (visited[root]) {
+            while (visited[scan]) scan++;
+            root = scan;
+        }
+        size_t head = order.size();
+        visited[root] = true;
+        order.push_back(root);
+        while (head < order.size()) {
+            auto [list, size] = neighbors(order[head++]);
+            for (size_t j = 0; j < size; ++j) {
+                if (!visited[list[j]]) {
+                    visited[list[j]] = true;
+                    order.push_back(list[j]);
+                }
+            }
+        }
+    }
+    return order;
+}
+
+// Cuthill-McKee visits every component from a node of minimum degree, enqueueing neighbors by increasing degree,
+// and the order is reversed at the end.
+template <typename NeighborFn>
+std::vector<uint32_t>
+ReorderRCM(size_t n, NeighborFn&& neighbors) {
+    std::vector<uint32_t> degree(n);
+    for (size_t u = 0; u < n; ++u) {
+        degree[u] = neighbors(u).second;
+    }
+    std::vector<uint32_t> by_degree(n);
+    for (size_t u = 0; u < n; ++u) {
+        by_degree[u] = u;
+    }
+    std::stable_sort(by_degree.begin(), by_degree.end(),
+                     [&degree](uint32_t a, uint32_t b) { return degree[a] < degree[b]; });
+
+    std::vector<uint32_t> order;
+    order.reserve(n);
+    std::vector<bool> visited(n, false);
+    std::vector<uint32_t> children;
+    for (auto root : by_degree) {
+        if (visited[root]) {
+            continue;
+        }
+        size_t head = order.size();
+        visited[root] = true;
+        order.push_back(root);
+        while (head < order.size()) {
+            auto [list, size] = neighbors(order[head++]);
+            children.clear();
+            for (size_t j = 0; j < size; ++j) {
+                if (!visited[list[j]]) {
+                    visited[list[j]] = true;
+                    children.push_back(list[j]);
+                }
+            }
+            std::sort(children.begin(), children.end(),
+                      [&degree](uint32_t a, uint32_t b) { return degree[a] < degree[b]; });
+            order.insert(order.end(), children.begin(), children.end());
+        }
+    }
+    std::reverse(order.begin(), order.end());
+    return order;
+}
+
+namespace detail {
+
+// Bucketed priority queue over small integer keys, supporting O(1) increment / decrement (the "unit heap" of
+// Gorder).
+class UnitHeap {
+ public:
+    UnitHeap(size_t n, uint32_t max_key) : key_(n, 0), prev_(n), next_(n), head_(max_key + 1, kNil) {
+        for (size_t v = n; v-- > 0;) {
+            link(v);
+        }
+    }
+
+    void
+    inc(uint32_t v) {
+        if (key_[v] == kRemoved) {
+            return;
+        }
+        unlink(v);
+        key_[v]++;
+        link(v);
+        top_ = std::max(top_, key_[v]);
+    }
+
+    void
+    dec(uint32_t v) {
+        if (key_[v] == kRemoved || key_[v] == 0) {
+            return;
+        }
+        unlink(v);
+        key_[v]--;
+        link(v);
+    }
+
+    uint32_t
+    pop() {
+        while (head_[top_] == kNil) {
+            top_--;
+        }
+        uint32_t v = head_[top_];
+        unlink(v);
+        key_[v] = kRemoved;
+        return v;
+    }
+
+ private:
+    static constexpr uint32_t kNil = UINT32_MAX;
+    static constexpr uint32_t kRemoved = UINT32_MAX;
+
+    void
+    link(uint32_t v) {
+        auto& head = head_[key_[v]];
+        prev_[v] = kNil;
+        next_[v] = head;
+        if (head != kNil) {
+            prev_[head] = v;
+        }
+        head = v;
+    }
+
+    void
+    unlink(uint32_t v) {
+        if (prev_[v] != kNil) {
+            next_[prev_[v]] = next_[v];
+        } else {
+            head_[key_[v]] = next_[v];
+        }
+        if (next_[v] != kNil) {
+            prev_[next_[v]] = prev_[v];
+        }
+    }
+
+    std::vector<uint32_t> key_;
+    std::vector<uint32_t> prev_;
+    std::vector<uint32_t> next_;
+    std::vector<uint32_t> head_;
+    uint32_t top_ = 0;
+};
+
+}  // namespace detail
+
+// Gorder with the neighbor relation only: the next node is the one with the most edges (in either direction) to
+// the last `window` placed nodes. Ties are broken by whichever node was moved into the bucket last.
+template <typename NeighborFn>
+std::vector<uint32_t>
+ReorderGorder(size_t n, NeighborFn&& neighbors, uint32_t window = 5) {
+    // in-edges in CSR form, so that both directions can be walked
+    std::vector<size_t> in_offsets(n + 1, 0);
+    for (size_t u = 0; u < n; ++u) {
+        auto [list, size] = neighbors(u);
+        for (size_t j = 0; j < size; ++j) {
+            in_offsets[list[j] + 1]++;
+        }
+    }
+    for (size_t u = 0; u < n; ++u) {
+        in_offsets[u + 1] += in_offsets[u];
+    }
+    std::vector<uint32_t> in_edges(in_offsets[n]);
+    std::vector<size_t> fill(in_offsets.begin(), in_offsets.end() - 1);
+    for (size_t u = 0; u < n; ++u) {
+        auto [list, size] = neighbors(u);
+        for (size_t j = 0; j < size; ++j) {
+            in_edges[fill[list[j]]++] = u;
+        }
+    }
+
+    // a key counts at most two edges to each of the window + 1 newest nodes
+    detail::UnitHeap heap(n, 2 * (window + 1));
+    auto update = [&](uint32_t u, bool placed) {
+        auto [list, size] = neighbors(u);
+        for (size_t j = 0; j < size; ++j) {
+            placed ? heap.inc(list[j]) : heap.dec(list[j]);
+        }
+        for (size_t j = in_offsets[u]; j < in_offsets[u + 1]; ++j) {
+            placed ? heap.inc(in_edges[j]) : heap.dec(in_edges[j]);
+        }
+    };
+
+    std::vector<uint32_t> order;
+    order.reserve(n);
+    for (size_t i = 0; i < n; ++i) {
+        uint32_t v = heap.pop();
+        order.push_back(v);
+        update(v, true);
+        if (i >= window) {
+            update(order[i - window], false);
+        }
+    }
+    return order;
+}
+
+}  // namespace hnswlib
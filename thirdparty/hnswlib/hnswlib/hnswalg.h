@@ -9,6 +9,13 @@
 #include "common/lru_cache.h"
 #include "io/fileIO.h"
 #include "knowhere/bitsetview.h"
+#include "knowhere/comp/cancellation.h"
+#include "knowhere/comp/memory_usage.h"
+#include "knowhere/comp/payload_allocator.h"
+#include "knowhere/comp/profile_zone.h"
+#include "knowhere/comp/query_stats.h"
+#include "knowhere/comp/scratch.h"
+#include "knowhere/comp/thread_pool.h"
 #include "knowhere/utils.h"
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wunused-variable"
@@ -21,9 +28,18 @@
 
 #include <atomic>
 #include <list>
+#include <numeric>
 #include <random>
+#include <tuple>
 #include <unordered_set>
 
+#include "faiss/IndexAdditiveQuantizer.h"
+#include "faiss/IndexPQ.h"
+#include "faiss/IndexScalarQuantizer.h"
+#include "faiss/impl/ScalarQuantizer.h"
+#include "faiss/impl/ScalarQuantizerOp.h"
+#include "faiss/index_io.h"
+#include "graph_reorder.h"
 #include "hnswlib.h"
 #include "io/FaissIO.h"
 #include "knowhere/config.h"
@@ -42,6 +58,54 @@ typedef unsigned int linklistsizeint;
 constexpr float kHnswSearchKnnBFThreshold = 0.93f;
 constexpr float kHnswSearchRangeBFThreshold = 0.97f;
 constexpr float kAlpha = 0.15f;
+// expansions between two polls of the cancellation token of the thread
+constexpr size_t kCancellationPollPeriod = 16;
+// the ef from which the base layer search keeps its candidates in a NeighborBlockSet
+constexpr size_t kNeighborBlockSetMinEf = 256;
+// fraction of the elements deleted since the last repair that triggers a repair of their neighborhoods
+constexpr float kHnswRepairDeletedThreshold = 0.05f;
+constexpr size_t kCacheLineSize = 64;
+constexpr size_t kMaxPrefetchDataLines = 2;
+// max number of link list lock stripes, a power of two
+constexpr size_t kLinkListLockStripes = 1 << 14;
+// the kept neighbors a candidate of the pruning heuristic is compared to per batched distance call
+constexpr size_t kHeuristicBatch = 8;
+
+// tags of the optional sections saveIndex appends after the link lists
+constexpr int32_t kSectionQuantizer = 1;
+constexpr int32_t kSectionLabels = 2;
+constexpr int32_t kSectionDeleted = 3;
+constexpr int32_t kSectionEntryHubs = 4;
+constexpr int32_t kSectionCodec = 5;
+
+// Test-and-test-and-set spinlock, padded to a cache line so that neighboring stripes do not share one. Link list
+// critical sections are a handful of distance computations, too short to be worth parking a thread for.
+struct alignas(kCacheLineSize) SpinLock {
+    std::atomic<bool> locked_{false};
+
+    void
+    lock() {
+        while (locked_.exchange(true, std::memory_order_acquire)) {
+            while (locked_.load(std::memory_order_relaxed)) {
+#if defined(__SSE__)
+                _mm_pause();
+#elif defined(__aarch64__)
+                asm volatile("yield");
+#endif
+            }
+        }
+    }
+
+    bool
+    try_lock() {
+        return !locked_.load(std::memory_order_relaxed) && !locked_.exchange(true, std::memory_order_acquire);
+    }
+
+    void
+    unlock() {
+        locked_.store(false, std::memory_order_release);
+    }
+};
 
 enum Metric {
     L2 = 0,
@@ -52,6 +116,13 @@ enum Metric {
     UNKNOWN = 100,
 };
 
+// the copy of the vectors a quantized level 0 keeps aside to re-rank its candidates with
+enum class RefineType {
+    NONE = 0,
+    FP16 = 1,
+    FP32 = 2,
+};
+
 template <typename dist_t>
 class HierarchicalNSW : public AlgorithmInterface<dist_t> {
  public:
@@ -66,8 +137,7 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
 
     HierarchicalNSW(SpaceInterface<dist_t>* s, size_t max_elements, size_t M = 16, size_t ef_construction = 200,
                     size_t random_seed = 100)
-        : link_list_locks_(max_elements),
-          link_list_update_locks_(max_update_element_locks),
+        : link_list_update_locks_(max_update_element_locks),
           element_levels_(max_elements) {
         space_ = s;
         if (auto x = dynamic_cast<L2Space*>(s)) {
@@ -85,10 +155,13 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
         }
 
         max_elements_ = max_elements;
+        initLinkListLocks(max_elements_);
 
         num_deleted_ = 0;
         data_size_ = s->get_data_size();
         fstdistfunc_ = s->get_dist_func();
+        fstdistfunc_batch_4_ = s->get_dist_func_batch_4();
+        fstdistfunc_batch_indexed_ = s->get_dist_func_batch_indexed();
         dist_func_param_ = s->get_dist_func_param();
         M_ = M;
         maxM_ = M_;
@@ -105,7 +178,7 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
         // label_offset_ = size_links_level0_ + data_size_;
         offsetLevel0_ = 0;
 
-        data_level0_memory_ = (char*)malloc(max_elements_ * size_data_per_element_);  // NOLINT
+        data_level0_memory_ = allocLevel0(max_elements_ * size_data_per_element_);
         if (data_level0_memory_ == nullptr)
             throw std::runtime_error("Not enough memory");
 
@@ -142,13 +215,15 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
         if (mmap_enabled_) {
             munmap(map_, map_size_);
         } else {
-            free(data_level0_memory_);
+            freeLevel0(data_level0_memory_);
             if (metric_type_ == Metric::COSINE) {
                 free(data_norm_l2_);
             }
+            free(raw_data_);
         }
 
-        for (tableint i = 0; i < cur_element_count; i++) {
+        // mmapped upper link lists point into the map
+        for (tableint i = 0; i < cur_element_count && !upper_links_mapped_; i++) {
             if (element_levels_[i] > 0)
                 free(linkLists_[i]);
         }
@@ -166,7 +241,7 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
     size_t cur_element_count;
     size_t size_data_per_element_;
     size_t size_links_per_element_;
-    size_t num_deleted_;
+    size_t num_deleted_ = 0;
 
     size_t M_;
     size_t maxM_;
@@ -179,7 +254,29 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
     VisitedListPool* visited_list_pool_;
     std::mutex cur_element_count_guard_;
 
-    std::vector<std::mutex> link_list_locks_;
+    // Link lists are guarded by a set of lock stripes rather than one mutex per element. A thread never holds two
+    // stripes at once, so two elements sharing a stripe can not deadlock.
+    mutable std::vector<SpinLock> link_list_locks_ = std::vector<SpinLock>(1);
+    size_t link_list_lock_mask_ = 0;
+
+    SpinLock&
+    linkListLock(tableint internal_id) const {
+        return link_list_locks_[internal_id & link_list_lock_mask_];
+    }
+
+    // One stripe per element up to kLinkListLockStripes, rounded up to a power of two, so that a small index does not
+    // pay for the stripes of a large one. Not thread-safe.
+    void
+    initLinkListLocks(size_t max_elements) {
+        size_t stripes = 1;
+        while (stripes < std::min(max_elements, kLinkListLockStripes)) {
+            stripes <<= 1;
+        }
+        if (stripes != link_list_locks_.size()) {
+            link_list_locks_ = std::vector<SpinLock>(stripes);
+            link_list_lock_mask_ = stripes - 1;
+        }
+    }
 
     // Locks to prevent race condition during update/insert of an element at same time.
     // Note: Locks for additions can also be used to prevent this race condition if the querying of KNN is not exposed
@@ -199,22 +296,313 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
 
     size_t label_offset_;
     DISTFUNC<dist_t> fstdistfunc_;
+    DISTFUNC_BATCH_4<dist_t> fstdistfunc_batch_4_ = nullptr;
+    DISTFUNC_BATCH_INDEXED<dist_t> fstdistfunc_batch_indexed_ = nullptr;
     void* dist_func_param_;
 
     std::default_random_engine level_generator_;
     std::default_random_engine update_probability_generator_;
 
     bool mmap_enabled_{false};
+    bool upper_links_mapped_{false};
     char* map_;
     size_t map_size_;
+    // the range of the mapping the upper link lists are read from, with their sizes in between
+    size_t upper_links_offset_ = 0;
+    size_t upper_links_size_ = 0;
+
+    mutable knowhere::concurrent_cache<uint64_t, tableint> lru_cache;
+
+    // When codec_ is set, level 0 keeps its codes (code_size_ bytes each) instead of the vectors: a faiss scalar,
+    // product or residual quantizer, sq_quantizer_ decodes the scalar one faster. raw_data_ optionally keeps the
+    // vectors in refine_type_ (raw_size_ bytes each) to refine the final candidates with.
+    std::unique_ptr<faiss::Index> codec_;
+    std::unique_ptr<faiss::Quantizer> sq_quantizer_;
+    size_t code_size_ = 0;
+    RefineType refine_type_ = RefineType::NONE;
+    size_t raw_size_ = 0;
+    char* raw_data_ = nullptr;
+
+    // whether every level 0 record is padded to a multiple of kCacheLineSize
+    bool level0_aligned_ = false;
+
+    // When links_compressed_ is set, the level 0 link lists live in links_ rather than in the records, which keep the
+    // vectors or codes alone, see compressLinks. The list of element i starts at links_offsets_[i] with its count,
+    // kLinksWide set if it stores 32-bit ids, two words each; else every neighbor is an int16_t offset from i, which
+    // is what most neighbors fit in once the graph is reordered. The lists are read only then.
+    static constexpr uint16_t kLinksWide = 0x8000;
+    bool links_compressed_ = false;
+    std::vector<uint16_t> links_;
+    std::vector<uint64_t> links_offsets_;
+
+    // internal id -> external label, empty while they are the same, i.e. until the graph is reordered
+    std::vector<labeltype> label_of_;
+    // external label -> internal id, kept along with label_of_
+    std::vector<tableint> internal_of_;
+
+    inline labeltype
+    getExternalLabel(tableint internal_id) const {
+        return label_of_.empty() ? internal_id : label_of_[internal_id];
+    }
+
+    inline tableint
+    getInternalId(labeltype label) const {
+        return internal_of_.empty() ? label : internal_of_[label];
+    }
+
+    void
+    buildInternalIds() {
+        labeltype max_label = 0;
+        for (size_t i = 0; i < cur_element_count; i++) {
+            max_label = std::max(max_label, label_of_[i]);
+        }
+        internal_of_.assign(max_label + 1, 0);
+        for (size_t i = 0; i < cur_element_count; i++) {
+            internal_of_[label_of_[i]] = i;
+        }
+    }
 
-    mutable knowhere::lru_cache<uint64_t, tableint> lru_cache;
+    // tombstones, a bitmap over external labels, empty until the first delete
+    std::vector<uint8_t> deleted_;
+    // tombstones whose neighbors still link to them
+    size_t num_unrepaired_ = 0;
+    // the elements and levels the running repair left without links, see finishRepairDeleted()
+    std::vector<std::pair<tableint, int>> unlinked_;
+    std::mutex unlinked_guard_;
+
+    inline bool
+    isMarkedDeleted(labeltype label) const {
+        return !deleted_.empty() && (deleted_[label >> 3] & (0x1 << (label & 0x7)));
+    }
+
+    // Returns false if `label` is already deleted. Not thread-safe.
+    bool
+    markDeleted(labeltype label) {
+        if (label >= cur_element_count) {
+            throw std::runtime_error("Cannot delete a label that is not in the index");
+        }
+        if (deleted_.empty()) {
+            deleted_.assign((max_elements_ + 7) / 8, 0);
+        }
+        if (isMarkedDeleted(label)) {
+            return false;
+        }
+        deleted_[label >> 3] |= (0x1 << (label & 0x7));
+        num_deleted_++;
+        num_unrepaired_++;
+        return true;
+    }
+
+    // the tombstones as a bitset over the labels, to be merged into the filter of a search
+    knowhere::BitsetView
+    deletedBitset() const {
+        return num_deleted_ == 0 ? knowhere::BitsetView() : knowhere::BitsetView(deleted_.data(), cur_element_count);
+    }
+
+    // elements a search may start from instead of enterpoint_node_, empty if not used
+    std::vector<tableint> entry_hubs_;
+
+    // Use the `n` elements with the highest levels as entry hubs, 0 turns them off.
+    void
+    setEntryHubs(size_t n) {
+        n = std::min(n, cur_element_count);
+        std::vector<tableint> ids(cur_element_count);
+        std::iota(ids.begin(), ids.end(), 0);
+        std::partial_sort(ids.begin(), ids.begin() + n, ids.end(), [this](tableint a, tableint b) {
+            return element_levels_[a] > element_levels_[b] || (element_levels_[a] == element_levels_[b] && a < b);
+        });
+        ids.resize(n);
+        entry_hubs_.swap(ids);
+    }
+
+    // Returns the entry of a query, its distance and the level the descent starts from: the nearest entry hub, or
+    // enterpoint_node_ if it is nearer or there are no hubs. A hub of a low level skips most of the descent.
+    std::tuple<tableint, dist_t, int>
+    getSearchEntry(const void* query_data) const {
+        tableint entry = enterpoint_node_;
+        dist_t dist = calcDistance(query_data, entry);
+        int level = maxlevel_;
+        for (auto hub : entry_hubs_) {
+            dist_t d = calcDistance(query_data, hub);
+            if (d < dist) {
+                entry = hub;
+                dist = d;
+                level = element_levels_[hub];
+            }
+        }
+        knowhere::QueryStats::Current().entry_level = level;
+        return {entry, dist, level};
+    }
+
+    bool
+    needRepairDeleted() const {
+        return num_unrepaired_ > 0 && num_unrepaired_ >= cur_element_count * kHnswRepairDeletedThreshold;
+    }
+
+    // level 0 is always allocated on a cache line boundary, so that padded records start on one too, and on huge
+    // pages when large enough, see knowhere::PayloadAllocator
+    static char*
+    allocLevel0(size_t size) {
+        return (char*)knowhere::PayloadAllocator::Allocate(size, kCacheLineSize);
+    }
+
+    static void
+    freeLevel0(char* data_level0_memory) {
+        knowhere::PayloadAllocator::Free(data_level0_memory);
+    }
+
+    // the bytes of a level 0 record, without its link list when they are compressed
+    size_t
+    level0Stride(size_t payload_size, bool with_links = true) const {
+        size_t stride = (with_links ? size_links_level0_ : 0) + payload_size;
+        if (level0_aligned_) {
+            stride = (stride + kCacheLineSize - 1) / kCacheLineSize * kCacheLineSize;
+        }
+        return stride;
+    }
+
+    // Re-pack level 0 with or without padding every record (link list + vector) to whole cache lines. Aligned records
+    // never straddle an extra line, at the cost of the padding bytes.
+    void
+    setLevel0Aligned(bool aligned) {
+        if (mmap_enabled_ || links_compressed_) {
+            throw std::runtime_error("Can not change the level 0 layout of a mmapped or compressed index");
+        }
+        level0_aligned_ = aligned;
+        size_t size_data_per_element = level0Stride(level0DataSize());
+        if (size_data_per_element == size_data_per_element_) {
+            return;
+        }
+        char* data_level0_memory = allocLevel0(max_elements_ * size_data_per_element);
+        if (data_level0_memory == nullptr)
+            throw std::runtime_error("Not enough memory: setLevel0Aligned failed to allocate level0");
+        size_t record_size = std::min(size_data_per_element, size_data_per_element_);
+        for (size_t i = 0; i < cur_element_count; i++) {
+            memcpy(data_level0_memory + i * size_data_per_element, data_level0_memory_ + i * size_data_per_element_,
+                   record_size);
+        }
+        freeLevel0(data_level0_memory_);
+        data_level0_memory_ = data_level0_memory;
+        size_data_per_element_ = size_data_per_element;
+    }
 
     inline char*
     getDataByInternalId(tableint internal_id) const {
         return (data_level0_memory_ + internal_id * size_data_per_element_ + offsetData_);
     }
 
+    // Number of neighbors whose records are prefetched ahead of the one being computed. Faster distance kernels
+    // leave less time to hide each miss, so the default follows the SIMD level picked by faiss::fvec_hook.
+    size_t
+    getPrefetchDepth(const SearchParam* param) const {
+        if (param != nullptr && param->prefetch_depth_ > 0) {
+            return param->prefetch_depth_;
+        }
+        return faiss::fvec_prefetch_depth;
+    }
+
+    inline void
+    prefetchLevel0(tableint internal_id) const {
+#if defined(USE_PREFETCH)
+        const char* record = data_level0_memory_ + internal_id * size_data_per_element_;
+        _mm_prefetch(record + offsetLevel0_, _MM_HINT_T0);
+        size_t lines = std::min((level0DataSize() + kCacheLineSize - 1) / kCacheLineSize, kMaxPrefetchDataLines);
+        for (size_t i = 0; i < lines; ++i) {
+            _mm_prefetch(record + offsetData_ + i * kCacheLineSize, _MM_HINT_T0);
+        }
+#endif
+    }
+
+    // the bytes of the vector or code of each element in level 0
+    inline size_t
+    level0DataSize() const {
+        return codec_ ? code_size_ : data_size_;
+    }
+
+    inline void
+    decodeCode(const char* code, float* dst) const {
+        if (sq_quantizer_ != nullptr) {
+            sq_quantizer_->decode_vector((const uint8_t*)code, dst);
+        } else {
+            codec_->sa_decode(1, (const uint8_t*)code, dst);
+        }
+    }
+
+    // decode the level 0 code of internal_id into a thread local buffer, `slot` selects one of two buffers
+    inline const float*
+    decodeDataByInternalId(tableint internal_id, int slot) const {
+        thread_local std::vector<float> buffers[2];
+        auto& buffer = buffers[slot];
+        buffer.resize(*(size_t*)dist_func_param_);
+        decodeCode(getDataByInternalId(internal_id), buffer.data());
+        return buffer.data();
+    }
+
+    inline const void*
+    getVectorByInternalId(tableint internal_id, int slot = 0) const {
+        if (codec_ == nullptr) {
+            return getDataByInternalId(internal_id);
+        }
+        return decodeDataByInternalId(internal_id, slot);
+    }
+
+    // the refine copy of internal_id as fp32, fp16 ones are decoded into a thread local buffer
+    inline const void*
+    getRefineVectorByInternalId(tableint internal_id) const {
+        const char* raw = raw_data_ + internal_id * raw_size_;
+        if (refine_type_ == RefineType::FP32) {
+            return raw;
+        }
+        thread_local std::vector<float> buffer;
+        buffer.resize(*(size_t*)dist_func_param_);
+        for (size_t i = 0; i < buffer.size(); ++i) {
+            buffer[i] = faiss::decode_fp16(((const uint16_t*)raw)[i]);
+        }
+        return buffer.data();
+    }
+
+    // copy the original vector of internal_id into dst, it is lossy if a quantized index keeps no fp32 copy
+    void
+    copyRawDataByInternalId(tableint internal_id, char* dst) const {
+        if (codec_ == nullptr) {
+            std::copy_n(getDataByInternalId(internal_id), data_size_, dst);
+        } else if (raw_data_ != nullptr) {
+            std::copy_n((const char*)getRefineVectorByInternalId(internal_id), data_size_, dst);
+        } else {
+            decodeCode(getDataByInternalId(internal_id), (float*)dst);
+        }
+    }
+
+    void
+    setRefineDataByInternalId(tableint internal_id, const void* data_point) {
+        char* raw = raw_data_ + internal_id * raw_size_;
+        if (refine_type_ == RefineType::FP32) {
+            memcpy(raw, data_point, data_size_);
+            return;
+        }
+        for (size_t i = 0; i < *(size_t*)dist_func_param_; ++i) {
+            ((uint16_t*)raw)[i] = faiss::encode_fp16(((const float*)data_point)[i]);
+        }
+    }
+
+    void
+    setDataByInternalId(tableint internal_id, const void* data_point) {
+        if (codec_ == nullptr) {
+            memcpy(getDataByInternalId(internal_id), data_point, data_size_);
+            return;
+        }
+        memset(getDataByInternalId(internal_id), 0, code_size_);
+        codec_->sa_encode(1, (const float*)data_point, (uint8_t*)getDataByInternalId(internal_id));
+        if (raw_data_ != nullptr) {
+            setRefineDataByInternalId(internal_id, data_point);
+        }
+    }
+
+    bool
+    hasRawData() const {
+        return codec_ == nullptr || refine_type_ == RefineType::FP32;
+    }
+
     int
     getRandomLevel(double reverse_size) {
         std::uniform_real_distribution<double> distribution(0.0, 1.0);
@@ -224,7 +612,7 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
 
     inline dist_t
     calcDistance(const tableint id1, const tableint id2) const {
-        dist_t dist = fstdistfunc_(getDataByInternalId(id1), getDataByInternalId(id2), dist_func_param_);
+        dist_t dist = fstdistfunc_(getVectorByInternalId(id1, 0), getVectorByInternalId(id2, 1), dist_func_param_);
         if (metric_type_ == Metric::COSINE) {
             dist /= (data_norm_l2_[id1] * data_norm_l2_[id2]);
         }
@@ -233,13 +621,100 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
 
     inline dist_t
     calcDistance(const void* vec, const tableint id) const {
-        dist_t dist = fstdistfunc_(vec, getDataByInternalId(id), dist_func_param_);
+        dist_t dist = fstdistfunc_(vec, getVectorByInternalId(id), dist_func_param_);
+        if (metric_type_ == Metric::COSINE) {
+            dist /= data_norm_l2_[id];
+        }
+        return dist;
+    }
+
+    // calcDistance for n elements, in one call gathering the rows by id or in groups of 4 when the space has a batched
+    // kernel. The decoded vectors of a quantized index share a slot, so it is not batched.
+    inline void
+    calcDistances(const void* vec, const tableint* ids, size_t n, dist_t* dists) const {
+        size_t i = 0;
+        if (fstdistfunc_batch_indexed_ != nullptr && codec_ == nullptr) {
+            fstdistfunc_batch_indexed_(vec, data_level0_memory_ + offsetData_, ids, n, size_data_per_element_,
+                                       dist_func_param_, dists);
+            if (metric_type_ == Metric::COSINE) {
+                for (size_t j = 0; j < n; ++j) {
+                    dists[j] /= data_norm_l2_[ids[j]];
+                }
+            }
+            return;
+        }
+        if (fstdistfunc_batch_4_ != nullptr && codec_ == nullptr) {
+            for (; i + 4 <= n; i += 4) {
+                fstdistfunc_batch_4_(vec, getDataByInternalId(ids[i]), getDataByInternalId(ids[i + 1]),
+                                     getDataByInternalId(ids[i + 2]), getDataByInternalId(ids[i + 3]), dist_func_param_,
+                                     dists[i], dists[i + 1], dists[i + 2], dists[i + 3]);
+            }
+            if (metric_type_ == Metric::COSINE) {
+                for (size_t j = 0; j < i; ++j) {
+                    dists[j] /= data_norm_l2_[ids[j]];
+                }
+            }
+        }
+        for (; i < n; ++i) {
+            dists[i] = calcDistance(vec, ids[i]);
+        }
+    }
+
+    // calcDistance of internal_id to n elements, batched as above unless level 0 keeps codes
+    inline void
+    calcDistances(tableint internal_id, const tableint* ids, size_t n, dist_t* dists) const {
+        if (codec_ != nullptr) {
+            for (size_t i = 0; i < n; ++i) {
+                dists[i] = calcDistance(internal_id, ids[i]);
+            }
+            return;
+        }
+        calcDistances(getDataByInternalId(internal_id), ids, n, dists);
+        if (metric_type_ == Metric::COSINE) {
+            for (size_t i = 0; i < n; ++i) {
+                dists[i] /= data_norm_l2_[internal_id];
+            }
+        }
+    }
+
+    // distance against the refine copy of the vector when it is kept, otherwise the same as calcDistance
+    inline dist_t
+    calcRefineDistance(const void* vec, const tableint id) const {
+        if (codec_ == nullptr || raw_data_ == nullptr) {
+            return calcDistance(vec, id);
+        }
+        dist_t dist = fstdistfunc_(vec, getRefineVectorByInternalId(id), dist_func_param_);
         if (metric_type_ == Metric::COSINE) {
             dist /= data_norm_l2_[id];
         }
         return dist;
     }
 
+    // the number of the closest candidates of a top k search that are refined, all of them unless refine_k is set
+    size_t
+    getRefineCount(size_t k, const SearchParam* param) const {
+        if (param == nullptr || param->refine_k_ <= 0) {
+            return std::numeric_limits<size_t>::max();
+        }
+        return std::max(k, (size_t)std::ceil(param->refine_k_ * k));
+    }
+
+    // re-rank the closest n level 0 candidates of a quantized index with the refine copy of their vectors, the rest
+    // are dropped
+    void
+    refineCandidates(const void* query_data, std::vector<std::pair<dist_t, tableint>>& candidates, size_t n) const {
+        if (codec_ == nullptr || raw_data_ == nullptr) {
+            return;
+        }
+        if (candidates.size() > n) {
+            candidates.resize(n);
+        }
+        for (auto& candidate : candidates) {
+            candidate.first = calcRefineDistance(query_data, candidate.second);
+        }
+        std::sort(candidates.begin(), candidates.end());
+    }
+
     std::priority_queue<std::pair<dist_t, tableint>, std::vector<std::pair<dist_t, tableint>>, CompareByFirst>
     searchBaseLayer(tableint ep_id, tableint cur_c, int layer) {
         auto& visited = visited_list_pool_->getFreeVisitedList();
@@ -254,7 +729,7 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
         top_candidates.emplace(dist, ep_id);
         lowerBound = dist;
         candidateSet.emplace(-dist, ep_id);
-        visited[ep_id] = true;
+        visited.set(ep_id);
 
         while (!candidateSet.empty()) {
             std::pair<dist_t, tableint> curr_el_pair = candidateSet.top();
@@ -265,7 +740,7 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
 
             tableint curNodeNum = curr_el_pair.second;
 
-            std::unique_lock<std::mutex> lock(link_list_locks_[curNodeNum]);
+            std::unique_lock<SpinLock> lock(linkListLock(curNodeNum));
 
             int* data;  // = (int *)(linkList0_ + curNodeNum * size_links_per_element0_);
             if (layer == 0) {
@@ -284,10 +759,10 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
             for (size_t j = 0; j < size; j++) {
                 tableint candidate_id = *(datal + j);
                 // if (candidate_id == 0) continue;
-                if (visited[candidate_id]) {
+                if (visited.get(candidate_id)) {
                     continue;
                 }
-                visited[candidate_id] = true;
+                visited.set(candidate_id);
 
                 dist_t dist1 = calcDistance(cur_c, candidate_id);
                 if (top_candidates.size() < ef_construction_ || lowerBound > dist1) {
@@ -310,83 +785,163 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
         return top_candidates;
     }
 
-    mutable std::atomic<long> metric_distance_computations;
-    mutable std::atomic<long> metric_hops;
-
+    // With `patience` set, the search stops early once that many expansions in a row have not improved the best `k`
+    // results, so that easy queries do not pay for the whole `ef`.
+    // It also stops, with the candidates it has, once the cancellation token of the thread is cancelled.
     template <bool has_deletions, bool collect_metrics = false>
     std::vector<std::pair<dist_t, tableint>>
     searchBaseLayerST(tableint ep_id, const void* data_point, size_t ef, const knowhere::BitsetView bitset,
+                      size_t prefetch_depth, size_t k = 0, size_t patience = 0,
                       const knowhere::feder::hnsw::FederResultUniq& feder_result = nullptr) const {
+        KNOWHERE_PROFILE_ZONE("hnsw.search_base_layer");
+        // past kNeighborBlockSetMinEf, moving the tail of a flat candidate pool on every insertion costs more than
+        // finding the block of the candidate
+        if (ef >= kNeighborBlockSetMinEf) {
+            return searchBaseLayerST<has_deletions, collect_metrics, NeighborBlockSet>(
+                ep_id, data_point, ef, bitset, prefetch_depth, k, patience, feder_result);
+        }
+        return searchBaseLayerST<has_deletions, collect_metrics, NeighborSet>(ep_id, data_point, ef, bitset,
+                                                                               prefetch_depth, k, patience,
+                                                                               feder_result);
+    }
+
+    template <bool has_deletions, bool collect_metrics, typename Pool>
+    std::vector<std::pair<dist_t, tableint>>
+    searchBaseLayerST(tableint ep_id, const void* data_point, size_t ef, const knowhere::BitsetView bitset,
+                      size_t prefetch_depth, size_t k, size_t patience,
+                      const knowhere::feder::hnsw::FederResultUniq& feder_result) const {
         if (feder_result != nullptr) {
             feder_result->visit_info_.AddLevelVisitRecord(0);
         }
         auto& visited = visited_list_pool_->getFreeVisitedList();
-        NeighborSet retset(ef);
+        // the work of the query goes to the stats of the thread, no counter is shared between the searching threads
+        auto& stats = knowhere::QueryStats::Current();
+        // the candidate pool and the batch buffers come from the scratch of the thread, not from malloc per query
+        knowhere::ScratchArena::Scope scratch;
+        Pool retset(ef, scratch.Alloc<Neighbor>(Pool::storage_size(ef)));
 
-        if (!has_deletions || !bitset.test((int64_t)ep_id)) {
+        if (!has_deletions || !bitset.test((int64_t)getExternalLabel(ep_id))) {
             dist_t dist = calcDistance(data_point, ep_id);
             retset.insert(Neighbor(ep_id, dist, Neighbor::kValid));
         } else {
             retset.insert(Neighbor(ep_id, std::numeric_limits<dist_t>::max(), Neighbor::kInvalid));
         }
 
-        visited[ep_id] = true;
+        visited.set(ep_id);
         float accumulative_alpha = 0.0f;
+        size_t stale_expansions = 0;
+        // the unvisited neighbors of an expansion are gathered first and their distances computed in one batch
+        bool batched = (fstdistfunc_batch_4_ != nullptr || fstdistfunc_batch_indexed_ != nullptr) &&
+                       codec_ == nullptr && feder_result == nullptr;
+        size_t batch_size = batched ? maxM0_ : 0;
+        tableint* batch_ids = scratch.Alloc<tableint>(batch_size);
+        int* batch_status = scratch.Alloc<int>(batch_size);
+        dist_t* batch_dists = scratch.Alloc<dist_t>(batch_size);
+        linklistsizeint* links = scratch.Alloc<linklistsizeint>(links_compressed_ ? maxM0_ + 1 : 0);
+        size_t expansions = 0;
         while (retset.has_next()) {
+            if (++expansions % kCancellationPollPeriod == 0 && knowhere::CancellationToken::CurrentCancelled()) {
+                break;
+            }
             auto [u, d, s] = retset.pop();
-            tableint* list = (tableint*)get_linklist0(u);
+            const tableint* list = getLinks0(u, links);
             int size = list[0];
+            float bound = (patience > 0 && retset.size() >= k) ? retset[k - 1].distance
+                                                               : std::numeric_limits<float>::max();
+            bool improved = false;
 
             if constexpr (collect_metrics) {
-                metric_hops++;
-                metric_distance_computations += size;
+                stats.hops++;
+                stats.distance_computations += size;
             }
-            for (size_t i = 1; i <= size; ++i) {
-#if defined(USE_PREFETCH)
-                if (i + 1 <= size) {
-                    _mm_prefetch(getDataByInternalId(list[i + 1]), _MM_HINT_T0);
-                }
-#endif
-                tableint v = list[i];
-                if (visited[v]) {
-                    if (feder_result != nullptr) {
-                        feder_result->visit_info_.AddVisitRecord(0, u, v, -1.0);
-                        feder_result->id_set_.insert(u);
-                        feder_result->id_set_.insert(v);
+            if (batched) {
+                size_t n = 0;
+                for (size_t i = 1; i <= size; ++i) {
+                    tableint v = list[i];
+                    if (visited.get(v)) {
+                        continue;
                     }
-                    continue;
-                }
-                visited[v] = true;
-                int status = Neighbor::kValid;
-                if (has_deletions && bitset.test((int64_t)v)) {
-                    status = Neighbor::kInvalid;
+                    visited.set(v);
+                    int status = Neighbor::kValid;
+                    if (has_deletions && bitset.test((int64_t)getExternalLabel(v))) {
+                        status = Neighbor::kInvalid;
+                        if constexpr (collect_metrics) {
+                            stats.filtered++;
+                        }
 
-                    accumulative_alpha += kAlpha;
-                    if (accumulative_alpha < 1.0f) {
-                        continue;
+                        accumulative_alpha += kAlpha;
+                        if (accumulative_alpha < 1.0f) {
+                            continue;
+                        }
+                        accumulative_alpha -= 1.0f;
                     }
-                    accumulative_alpha -= 1.0f;
+                    prefetchLevel0(v);
+                    batch_ids[n] = v;
+                    batch_status[n++] = status;
                 }
-                dist_t dist = calcDistance(data_point, v);
-                if (feder_result != nullptr) {
-                    feder_result->visit_info_.AddVisitRecord(0, u, v, dist);
-                    feder_result->id_set_.insert(u);
-                    feder_result->id_set_.insert(v);
+                calcDistances(data_point, batch_ids, n, batch_dists);
+                for (size_t j = 0; j < n; ++j) {
+                    Neighbor nn(batch_ids[j], batch_dists[j], batch_status[j]);
+                    if (retset.insert(nn)) {
+                        improved |= nn.distance < bound;
+                    }
+                }
+            } else {
+                for (size_t i = 1; i <= std::min<size_t>(size, prefetch_depth); ++i) {
+                    prefetchLevel0(list[i]);
                 }
+                for (size_t i = 1; i <= size; ++i) {
+                    if (i + prefetch_depth <= size) {
+                        prefetchLevel0(list[i + prefetch_depth]);
+                    }
+                    tableint v = list[i];
+                    if (visited.get(v)) {
+                        if (feder_result != nullptr) {
+                            feder_result->visit_info_.AddVisitRecord(0, getExternalLabel(u), getExternalLabel(v), -1.0);
+                            feder_result->id_set_.insert(getExternalLabel(u));
+                            feder_result->id_set_.insert(getExternalLabel(v));
+                        }
+                        continue;
+                    }
+                    visited.set(v);
+                    int status = Neighbor::kValid;
+                    if (has_deletions && bitset.test((int64_t)getExternalLabel(v))) {
+                        status = Neighbor::kInvalid;
+                        if constexpr (collect_metrics) {
+                            stats.filtered++;
+                        }
 
-                Neighbor nn(v, dist, status);
-                if (retset.insert(nn)) {
-#if defined(USE_PREFETCH)
-                    _mm_prefetch(get_linklist0(v), _MM_HINT_T0);
-#endif
+                        accumulative_alpha += kAlpha;
+                        if (accumulative_alpha < 1.0f) {
+                            continue;
+                        }
+                        accumulative_alpha -= 1.0f;
+                    }
+                    dist_t dist = calcDistance(data_point, v);
+                    if (feder_result != nullptr) {
+                        feder_result->visit_info_.AddVisitRecord(0, getExternalLabel(u), getExternalLabel(v), dist);
+                        feder_result->id_set_.insert(getExternalLabel(u));
+                        feder_result->id_set_.insert(getExternalLabel(v));
+                    }
+
+                    Neighbor nn(v, dist, status);
+                    if (retset.insert(nn)) {
+                        improved |= nn.distance < bound;
+                        prefetchLinks0(v);
+                    }
+                }
+            }
+            if (patience > 0) {
+                stale_expansions = improved ? 0 : stale_expansions + 1;
+                if (stale_expansions >= patience) {
+                    break;
                 }
             }
         }
 
-        std::vector<std::pair<dist_t, tableint>> ans(retset.size());
-        for (int i = 0; i < retset.size(); ++i) {
-            ans[i] = {retset[i].distance, retset[i].id};
-        }
+        std::vector<std::pair<dist_t, tableint>> ans;
+        ans.reserve(retset.size());
+        retset.for_each([&ans](const Neighbor& nbr) { ans.emplace_back(nbr.distance, nbr.id); });
         return ans;
     }
 
@@ -394,12 +949,28 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
     getNeighborsByHeuristic2(std::priority_queue<std::pair<dist_t, tableint>, std::vector<std::pair<dist_t, tableint>>,
                                                  CompareByFirst>& top_candidates,
                              const size_t M) {
-        std::vector<tableint> return_list;
+        auto selected = selectNeighborsByHeuristic(top_candidates, M);
+        std::vector<tableint> return_list(selected.size());
+        for (size_t i = 0; i < selected.size(); i++) {
+            return_list[i] = selected[i].second;
+        }
+        return return_list;
+    }
+
+    // getNeighborsByHeuristic2 along with the distances of the kept candidates, closest first. A candidate is
+    // compared to the ones kept before it kHeuristicBatch at a time, one batched distance call each, until one of
+    // them is closer to it than the base is.
+    std::vector<std::pair<dist_t, tableint>>
+    selectNeighborsByHeuristic(
+        std::priority_queue<std::pair<dist_t, tableint>, std::vector<std::pair<dist_t, tableint>>, CompareByFirst>&
+            top_candidates,
+        const size_t M) {
+        std::vector<std::pair<dist_t, tableint>> return_list;
 
         if (top_candidates.size() < M) {
             return_list.resize(top_candidates.size());
             for (int i = static_cast<int>(top_candidates.size() - 1); i >= 0; i--) {
-                return_list[i] = top_candidates.top().second;
+                return_list[i] = top_candidates.top();
                 top_candidates.pop();
             }
         } else if (M > 0) {
@@ -411,17 +982,19 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
                 top_candidates.pop();
             }
 
+            std::vector<tableint> ids;
+            ids.reserve(M);
+            dist_t dists[kHeuristicBatch];
             for (std::pair<dist_t, tableint>& current_pair : queue_closest) {
                 bool good = true;
-                for (tableint id : return_list) {
-                    dist_t curdist = calcDistance(id, current_pair.second);
-                    if (curdist < current_pair.first) {
-                        good = false;
-                        break;
-                    }
+                for (size_t i = 0; good && i < ids.size(); i += kHeuristicBatch) {
+                    size_t n = std::min(kHeuristicBatch, ids.size() - i);
+                    calcDistances(current_pair.second, ids.data() + i, n, dists);
+                    good = std::none_of(dists, dists + n, [&](dist_t d) { return d < current_pair.first; });
                 }
                 if (good) {
-                    return_list.push_back(current_pair.second);
+                    return_list.push_back(current_pair);
+                    ids.push_back(current_pair.second);
                     if (return_list.size() >= M) {
                         break;
                     }
@@ -434,27 +1007,61 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
 
     std::vector<std::pair<dist_t, labeltype>>
     getNeighboursWithinRadius(std::vector<std::pair<dist_t, tableint>>& top_candidates, const void* data_point,
-                              float radius, const knowhere::BitsetView bitset) const {
+                              float radius, const knowhere::BitsetView bitset, size_t max_results = 0,
+                              float lower = -std::numeric_limits<float>::infinity()) const {
         std::vector<std::pair<dist_t, labeltype>> result;
+        result.reserve(max_results > 0 ? std::min(max_results, top_candidates.size()) : top_candidates.size());
         auto& visited = visited_list_pool_->getFreeVisitedList();
 
+        // With max_results the results are a heap that keeps the closest of them. Once it is full nothing beyond its
+        // farthest can be a result, the walk then narrows to that bound and no longer expands the nodes past it.
+        float bound = radius;
+        auto add = [&](dist_t dist, tableint id) {
+            if (max_results == 0) {
+                result.emplace_back(dist, getExternalLabel(id));
+                return;
+            }
+            if (dist < lower) {
+                return;
+            }
+            if (result.size() < max_results) {
+                result.emplace_back(dist, getExternalLabel(id));
+                std::push_heap(result.begin(), result.end());
+            } else if (dist < result.front().first) {
+                std::pop_heap(result.begin(), result.end());
+                result.back() = {dist, getExternalLabel(id)};
+                std::push_heap(result.begin(), result.end());
+            }
+            if (result.size() == max_results) {
+                bound = std::min<float>(radius, result.front().first);
+            }
+        };
+
         std::queue<std::pair<dist_t, tableint>> radius_queue;
+        std::vector<linklistsizeint> links(links_compressed_ ? maxM0_ + 1 : 0);
         while (!top_candidates.empty()) {
             auto cand = top_candidates.back();
             top_candidates.pop_back();
-            if (cand.first < radius) {
+            if (cand.first < bound) {
                 radius_queue.push(cand);
-                result.emplace_back(cand.first, cand.second);
+                add(cand.first, cand.second);
             }
-            visited[cand.second] = true;
+            visited.set(cand.second);
         }
 
+        size_t expansions = 0;
         while (!radius_queue.empty()) {
+            if (++expansions % kCancellationPollPeriod == 0 && knowhere::CancellationToken::CurrentCancelled()) {
+                break;
+            }
             auto cur = radius_queue.front();
             radius_queue.pop();
+            if (cur.first >= bound) {
+                continue;
+            }
 
             tableint current_id = cur.second;
-            int* data = (int*)get_linklist0(current_id);
+            const int* data = (const int*)getLinks0(current_id, links.data());
             size_t size = getListCount((linklistsizeint*)data);
 
 #if defined(USE_PREFETCH)
@@ -464,13 +1071,13 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
 #endif
             for (size_t j = 1; j <= size; j++) {
                 int candidate_id = *(data + j);
-                if (!visited[candidate_id]) {
-                    visited[candidate_id] = true;
-                    if (bitset.empty() || !bitset.test((int64_t)candidate_id)) {
+                if (!visited.get(candidate_id)) {
+                    visited.set(candidate_id);
+                    if (bitset.empty() || !bitset.test((int64_t)getExternalLabel(candidate_id))) {
                         dist_t dist = calcDistance(data_point, candidate_id);
-                        if (dist < radius) {
+                        if (dist < bound) {
                             radius_queue.push({dist, candidate_id});
-                            result.emplace_back(dist, candidate_id);
+                            add(dist, candidate_id);
                         }
                     }
                 }
@@ -500,6 +1107,57 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
         return level == 0 ? get_linklist0(internal_id) : get_linklist(internal_id, level);
     };
 
+    // The level 0 list of internal_id laid out as get_linklist0 does, the count then the ids. Compressed lists are
+    // decoded into buffer, of 1 + maxM0_ entries, which is returned then.
+    inline const linklistsizeint*
+    getLinks0(tableint internal_id, linklistsizeint* buffer) const {
+        if (!links_compressed_) {
+            return get_linklist0(internal_id);
+        }
+        decodeLinks0(internal_id, buffer);
+        return buffer;
+    }
+
+    void
+    decodeLinks0(tableint internal_id, linklistsizeint* dst) const {
+        const uint16_t* src = links_.data() + links_offsets_[internal_id];
+        size_t count = src[0] & ~kLinksWide;
+        dst[0] = count;
+        tableint* ids = dst + 1;
+        if (src[0] & kLinksWide) {
+            memcpy(ids, src + 1, count * sizeof(tableint));
+            return;
+        }
+        const int16_t* deltas = (const int16_t*)(src + 1);
+        size_t j = 0;
+#if defined(__SSE2__)
+        // eight offsets at a time: each is paired with itself into a 32-bit lane, the arithmetic shift then leaves it
+        // sign extended
+        __m128i base = _mm_set1_epi32((int)internal_id);
+        for (; j + 8 <= count; j += 8) {
+            __m128i d = _mm_loadu_si128((const __m128i*)(deltas + j));
+            __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(d, d), 16);
+            __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(d, d), 16);
+            _mm_storeu_si128((__m128i*)(ids + j), _mm_add_epi32(base, lo));
+            _mm_storeu_si128((__m128i*)(ids + j + 4), _mm_add_epi32(base, hi));
+        }
+#endif
+        for (; j < count; j++) {
+            ids[j] = internal_id + deltas[j];
+        }
+    }
+
+    inline void
+    prefetchLinks0(tableint internal_id) const {
+#if defined(USE_PREFETCH)
+        if (links_compressed_) {
+            _mm_prefetch((const char*)(links_.data() + links_offsets_[internal_id]), _MM_HINT_T0);
+        } else {
+            _mm_prefetch((const char*)get_linklist0(internal_id), _MM_HINT_T0);
+        }
+#endif
+    }
+
     tableint
     mutuallyConnectNewElement(const void* data_point, tableint cur_c,
                               std::priority_queue<std::pair<dist_t, tableint>, std::vector<std::pair<dist_t, tableint>>,
@@ -507,99 +1165,108 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
                               int level, bool isUpdate) {
         size_t Mcurmax = level ? maxM_ : maxM0_;
 
-        std::vector<tableint> selectedNeighbors(getNeighborsByHeuristic2(top_candidates, M_));
-        if (selectedNeighbors.size() > M_)
+        // the distances of the selected neighbors to cur_c are the ones of the search, not computed again
+        auto selected = selectNeighborsByHeuristic(top_candidates, M_);
+        if (selected.size() > M_)
             throw std::runtime_error("Should be not be more than M_ candidates returned by the heuristic");
+        std::vector<tableint> selectedNeighbors(selected.size());
+        for (size_t idx = 0; idx < selected.size(); idx++) {
+            selectedNeighbors[idx] = selected[idx].second;
+        }
 
         tableint next_closest_entry_point = selectedNeighbors.front();
         {
-            linklistsizeint* ll_cur;
-            if (level == 0)
-                ll_cur = get_linklist0(cur_c);
-            else
-                ll_cur = get_linklist(cur_c, level);
+            std::unique_lock<SpinLock> lock(linkListLock(cur_c));
+            linklistsizeint* ll_cur = get_linklist_at_level(cur_c, level);
+            tableint* data = (tableint*)(ll_cur + 1);
 
-            if (*ll_cur && !isUpdate) {
-                throw std::runtime_error("The newly inserted element should have blank link list");
+            // The new element is reachable through its upper levels before this level is linked, so concurrent
+            // inserts may already have added links back to it. Keep them next to the selected neighbors.
+            std::vector<tableint> links(selectedNeighbors);
+            if (!isUpdate) {
+                size_t sz_link_list_cur = getListCount(ll_cur);
+                for (size_t j = 0; j < sz_link_list_cur; j++) {
+                    if (std::find(selectedNeighbors.begin(), selectedNeighbors.end(), data[j]) ==
+                        selectedNeighbors.end()) {
+                        links.push_back(data[j]);
+                    }
+                }
+                if (links.size() > Mcurmax) {
+                    std::vector<dist_t> dists(links.size());
+                    for (size_t j = 0; j < selected.size(); j++) {
+                        dists[j] = selected[j].first;
+                    }
+                    calcDistances(cur_c, links.data() + selected.size(), links.size() - selected.size(),
+                                  dists.data() + selected.size());
+                    std::priority_queue<std::pair<dist_t, tableint>, std::vector<std::pair<dist_t, tableint>>,
+                                        CompareByFirst>
+                        candidates;
+                    for (size_t j = 0; j < links.size(); j++) {
+                        candidates.emplace(dists[j], links[j]);
+                    }
+                    links = getNeighborsByHeuristic2(candidates, Mcurmax);
+                }
             }
-            setListCount(ll_cur, selectedNeighbors.size());
-            tableint* data = (tableint*)(ll_cur + 1);
-            for (size_t idx = 0; idx < selectedNeighbors.size(); idx++) {
-                if (data[idx] && !isUpdate)
-                    throw std::runtime_error("Possible memory corruption");
-                if (level > element_levels_[selectedNeighbors[idx]])
-                    throw std::runtime_error("Trying to make a link on a non-existent level");
 
-                data[idx] = selectedNeighbors[idx];
+            for (size_t idx = 0; idx < links.size(); idx++) {
+                if (level > element_levels_[links[idx]])
+                    throw std::runtime_error("Trying to make a link on a non-existent level");
+                data[idx] = links[idx];
             }
+            setListCount(ll_cur, links.size());
         }
 
+        // A full list of a neighbor is pruned with its lock released: its links are copied under the lock, their
+        // distances and the heuristic computed without it, and the result written back under the lock again unless
+        // the list changed meanwhile, in which case the pruning starts over from the new list.
+        std::vector<tableint> snapshot;
+        std::vector<tableint> pruned;
+        std::vector<dist_t> dists;
         for (size_t idx = 0; idx < selectedNeighbors.size(); idx++) {
-            std::unique_lock<std::mutex> lock(link_list_locks_[selectedNeighbors[idx]]);
-
-            linklistsizeint* ll_other;
-            if (level == 0)
-                ll_other = get_linklist0(selectedNeighbors[idx]);
-            else
-                ll_other = get_linklist(selectedNeighbors[idx], level);
-
-            size_t sz_link_list_other = getListCount(ll_other);
-
-            if (sz_link_list_other > Mcurmax)
-                throw std::runtime_error("Bad value of sz_link_list_other");
-            if (selectedNeighbors[idx] == cur_c)
+            tableint neighbor = selectedNeighbors[idx];
+            if (neighbor == cur_c)
                 throw std::runtime_error("Trying to connect an element to itself");
-            if (level > element_levels_[selectedNeighbors[idx]])
+            if (level > element_levels_[neighbor])
                 throw std::runtime_error("Trying to make a link on a non-existent level");
-
-            tableint* data = (tableint*)(ll_other + 1);
-
-            bool is_cur_c_present = false;
-            if (isUpdate) {
-                for (size_t j = 0; j < sz_link_list_other; j++) {
-                    if (data[j] == cur_c) {
-                        is_cur_c_present = true;
+            pruned.clear();
+            while (true) {
+                {
+                    std::unique_lock<SpinLock> lock(linkListLock(neighbor));
+                    linklistsizeint* ll_other = get_linklist_at_level(neighbor, level);
+                    size_t sz_link_list_other = getListCount(ll_other);
+                    if (sz_link_list_other > Mcurmax)
+                        throw std::runtime_error("Bad value of sz_link_list_other");
+                    tableint* data = (tableint*)(ll_other + 1);
+
+                    // If cur_c is already present in the neighboring connections of `neighbor` then no need to
+                    // modify any connections or run the heuristics.
+                    if (isUpdate && std::find(data, data + sz_link_list_other, cur_c) != data + sz_link_list_other) {
                         break;
                     }
-                }
-            }
-
-            // If cur_c is already present in the neighboring connections of `selectedNeighbors[idx]` then no need to
-            // modify any connections or run the heuristics.
-            if (!is_cur_c_present) {
-                if (sz_link_list_other < Mcurmax) {
-                    data[sz_link_list_other] = cur_c;
-                    setListCount(ll_other, sz_link_list_other + 1);
-                } else {
-                    // finding the "weakest" element to replace it with the new one
-                    dist_t d_max = calcDistance(cur_c, selectedNeighbors[idx]);
-                    // Heuristic:
-                    std::priority_queue<std::pair<dist_t, tableint>, std::vector<std::pair<dist_t, tableint>>,
-                                        CompareByFirst>
-                        candidates;
-                    candidates.emplace(d_max, cur_c);
-
-                    for (size_t j = 0; j < sz_link_list_other; j++) {
-                        dist_t dist = calcDistance(data[j], selectedNeighbors[idx]);
-                        candidates.emplace(dist, data[j]);
-                    }
-
-                    std::vector<tableint> selected(getNeighborsByHeuristic2(candidates, Mcurmax));
-                    setListCount(ll_other, static_cast<unsigned short int>(selected.size()));
-                    for (size_t i = 0; i < selected.size(); i++) {
-                        data[i] = selected[i];
+                    if (sz_link_list_other < Mcurmax) {
+                        data[sz_link_list_other] = cur_c;
+                        setListCount(ll_other, sz_link_list_other + 1);
+                        break;
                     }
-                    // Nearest K:
-                    /*int indx = -1;
-                    for (int j = 0; j < sz_link_list_other; j++) {
-                        dist_t d = fstdistfunc_(getDataByInternalId(data[j]), getDataByInternalId(rez[idx]),
-                    dist_func_param_); if (d > d_max) { indx = j; d_max = d;
-                        }
+                    if (!pruned.empty() && snapshot.size() == sz_link_list_other &&
+                        std::equal(snapshot.begin(), snapshot.end(), data)) {
+                        std::copy(pruned.begin(), pruned.end(), data);
+                        setListCount(ll_other, static_cast<unsigned short int>(pruned.size()));
+                        break;
                     }
-                    if (indx >= 0) {
-                        data[indx] = cur_c;
-                    } */
+                    snapshot.assign(data, data + sz_link_list_other);
+                }
+
+                dists.resize(snapshot.size());
+                calcDistances(neighbor, snapshot.data(), snapshot.size(), dists.data());
+                std::priority_queue<std::pair<dist_t, tableint>, std::vector<std::pair<dist_t, tableint>>,
+                                    CompareByFirst>
+                    candidates;
+                candidates.emplace(selected[idx].first, cur_c);
+                for (size_t j = 0; j < snapshot.size(); j++) {
+                    candidates.emplace(dists[j], snapshot[j]);
                 }
+                pruned = getNeighborsByHeuristic2(candidates, Mcurmax);
             }
         }
 
@@ -619,18 +1286,22 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
     resizeIndex(size_t new_max_elements) {
         if (new_max_elements < cur_element_count)
             throw std::runtime_error("Cannot resize, max element is less than the current number of elements");
+        if (mmap_enabled_)
+            throw std::runtime_error("Cannot resize an index mapped from file");
+        if (links_compressed_)
+            throw std::runtime_error("Cannot resize an index of compressed links");
 
         delete visited_list_pool_;
         visited_list_pool_ = new VisitedListPool(new_max_elements);
 
         element_levels_.resize(new_max_elements);
 
-        std::vector<std::mutex>(new_max_elements).swap(link_list_locks_);
-
         // Reallocate base layer
-        char* data_level0_memory_new = (char*)realloc(data_level0_memory_, new_max_elements * size_data_per_element_);
+        char* data_level0_memory_new = allocLevel0(new_max_elements * size_data_per_element_);
         if (data_level0_memory_new == nullptr)
             throw std::runtime_error("Not enough memory: resizeIndex failed to allocate base layer");
+        memcpy(data_level0_memory_new, data_level0_memory_, cur_element_count * size_data_per_element_);
+        freeLevel0(data_level0_memory_);
         data_level0_memory_ = data_level0_memory_new;
 
         // for COSINE, resize data_norm_l2_
@@ -641,6 +1312,21 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
             data_norm_l2_ = data_norm_l2_new;
         }
 
+        if (!label_of_.empty()) {
+            label_of_.resize(new_max_elements);
+        }
+
+        if (!deleted_.empty()) {
+            deleted_.resize((new_max_elements + 7) / 8, 0);
+        }
+
+        if (raw_data_ != nullptr) {
+            char* raw_data_new = (char*)realloc(raw_data_, new_max_elements * raw_size_);
+            if (raw_data_new == nullptr)
+                throw std::runtime_error("Not enough memory: resizeIndex failed to allocate raw data");
+            raw_data_ = raw_data_new;
+        }
+
         // Reallocate all other layers
         char** linkLists_new = (char**)realloc(linkLists_, sizeof(void*) * new_max_elements);
         if (linkLists_new == nullptr)
@@ -648,6 +1334,7 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
         linkLists_ = linkLists_new;
 
         max_elements_ = new_max_elements;
+        initLinkListLocks(max_elements_);
     }
 
     void
@@ -657,6 +1344,9 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
         auto input = knowhere::FileReader(location);
         map_size_ = input.size();
         map_ = static_cast<char*>(mmap(nullptr, map_size_, PROT_READ, MAP_SHARED, input.descriptor(), 0));
+        // the index is a section of a knowhere index file when file_size is set, the offsets stay absolute
+        input.seek(cfg.file_offset);
+        size_t end = cfg.file_size != 0 ? cfg.file_offset + cfg.file_size : input.size();
 
         size_t dim;
         readBinaryPOD(input, metric_type_);
@@ -676,6 +1366,8 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
             throw std::runtime_error("Invalid metric type " + std::to_string(metric_type_));
         }
         fstdistfunc_ = space_->get_dist_func();
+        fstdistfunc_batch_4_ = space_->get_dist_func_batch_4();
+        fstdistfunc_batch_indexed_ = space_->get_dist_func_batch_indexed();
         dist_func_param_ = space_->get_dist_func_param();
 
         readBinaryPOD(input, offsetLevel0_);
@@ -687,6 +1379,7 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
             max_elements = max_elements_;
         }
         max_elements_ = max_elements;
+        initLinkListLocks(max_elements_);
         readBinaryPOD(input, size_data_per_element_);
         readBinaryPOD(input, label_offset_);
         readBinaryPOD(input, offsetData_);
@@ -701,8 +1394,6 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
 
         if (cfg.enable_mmap.has_value() && cfg.enable_mmap.value()) {
             mmap_enabled_ = true;
-            // For HNSW, we only mmap the data part, but not the linked lists,
-            // which affects the performance significantly
             data_level0_memory_ = map_ + input.offset();
             input.advance(cur_element_count * size_data_per_element_);
 
@@ -712,7 +1403,7 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
                 input.advance(cur_element_count * sizeof(float));
             }
         } else {
-            data_level0_memory_ = (char*)malloc(max_elements * size_data_per_element_);  // NOLINT
+            data_level0_memory_ = allocLevel0(max_elements * size_data_per_element_);
             input.read(data_level0_memory_, cur_element_count * size_data_per_element_);
 
             // for COSINE, need load data_norm_l2_
@@ -725,7 +1416,6 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
         size_links_per_element_ = maxM_ * sizeof(tableint) + sizeof(linklistsizeint);
 
         size_links_level0_ = maxM0_ * sizeof(tableint) + sizeof(linklistsizeint);
-        std::vector<std::mutex>(max_elements).swap(link_list_locks_);
 
         visited_list_pool_ = new VisitedListPool(max_elements);
 
@@ -736,12 +1426,23 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
         element_levels_ = std::vector<int>(max_elements);
         revSize_ = 1.0 / mult_;
         ef_ = 10;
+        // The upper link lists are mapped in place as well when they start 4 bytes aligned in the map, only the sizes
+        // are walked to find them: each record is a 4 bytes size and lists of 4 bytes ids, so all are aligned then.
+        // Level 0 ahead of them leaves them misaligned when the element size is not a multiple of 4 (binary vectors,
+        // SQ/PQ codes) and the element count is odd, they are copied then.
+        upper_links_offset_ = input.offset();
+        upper_links_mapped_ =
+            mmap_enabled_ && reinterpret_cast<uintptr_t>(map_ + upper_links_offset_) % alignof(tableint) == 0;
         for (size_t i = 0; i < cur_element_count; i++) {
             unsigned int linkListSize;
             readBinaryPOD(input, linkListSize);
             if (linkListSize == 0) {
                 element_levels_[i] = 0;
                 linkLists_[i] = nullptr;
+            } else if (upper_links_mapped_) {
+                element_levels_[i] = linkListSize / size_links_per_element_;
+                linkLists_[i] = map_ + input.offset();
+                input.advance(linkListSize);
             } else {
                 element_levels_[i] = linkListSize / size_links_per_element_;
                 linkLists_[i] = (char*)malloc(linkListSize);
@@ -751,23 +1452,146 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
                 input.read(linkLists_[i], linkListSize);
             }
         }
+        upper_links_size_ = upper_links_mapped_ ? input.offset() - upper_links_offset_ : 0;
+
+        while (static_cast<size_t>(input.offset()) < end) {
+            int32_t section;
+            readBinaryPOD(input, section);
+            if (section == kSectionLabels) {
+                loadLabels(input, max_elements);
+                continue;
+            }
+            if (section == kSectionDeleted) {
+                loadDeleted(input, max_elements);
+                continue;
+            }
+            if (section == kSectionEntryHubs) {
+                loadEntryHubs(input);
+                continue;
+            }
+            if (section == kSectionQuantizer) {
+                loadQuantizer(input);
+            } else if (section == kSectionCodec) {
+                loadCodec(input);
+            } else {
+                throw std::runtime_error("Unknown hnsw index section " + std::to_string(section));
+            }
+            if (refine_type_ != RefineType::NONE && mmap_enabled_) {
+                raw_data_ = map_ + input.offset();
+                input.advance(cur_element_count * raw_size_);
+            } else if (refine_type_ != RefineType::NONE) {
+                raw_data_ = (char*)malloc(max_elements * raw_size_);  // NOLINT
+                if (raw_data_ == nullptr) {
+                    throw std::runtime_error("Not enough memory: loadIndex failed to allocate raw data");
+                }
+                input.read(raw_data_, cur_element_count * raw_size_);
+            }
+        }
+        level0_aligned_ = size_data_per_element_ > size_links_level0_ + level0DataSize();
 
         input.close();
     }
 
+    template <typename Reader>
+    void
+    loadLabels(Reader& input, size_t max_elements) {
+        label_of_.resize(max_elements);
+        input.read((char*)label_of_.data(), cur_element_count * sizeof(labeltype));
+        buildInternalIds();
+    }
+
+    template <typename Reader>
+    void
+    loadDeleted(Reader& input, size_t max_elements) {
+        readBinaryPOD(input, num_deleted_);
+        readBinaryPOD(input, num_unrepaired_);
+        deleted_.assign((max_elements + 7) / 8, 0);
+        input.read((char*)deleted_.data(), (cur_element_count + 7) / 8);
+    }
+
+    template <typename Reader>
+    void
+    loadEntryHubs(Reader& input) {
+        size_t n;
+        readBinaryPOD(input, n);
+        entry_hubs_.resize(n);
+        input.read((char*)entry_hubs_.data(), n * sizeof(tableint));
+    }
+
+    // Read the scalar quantizer section of the indexes saved before kSectionCodec, the fp32 vectors follow it when
+    // they are kept.
+    template <typename Reader>
+    void
+    loadQuantizer(Reader& input) {
+        int32_t qtype;
+        size_t trained_size;
+        bool has_raw;
+        readBinaryPOD(input, qtype);
+        readBinaryPOD(input, trained_size);
+        auto codec = std::make_unique<faiss::IndexScalarQuantizer>(*(size_t*)dist_func_param_,
+                                                                   (faiss::QuantizerType)qtype);
+        if (trained_size > 0) {
+            codec->sq.trained.resize(trained_size);
+            input.read((char*)codec->sq.trained.data(), trained_size * sizeof(float));
+        }
+        codec->is_trained = true;
+        readBinaryPOD(input, has_raw);
+        setCodec(std::move(codec), has_raw ? RefineType::FP32 : RefineType::NONE);
+    }
+
+    // Read the codec section written by saveIndex, the refine copy of the vectors follows it unless it is NONE.
+    template <typename Reader>
+    void
+    loadCodec(Reader& input) {
+        size_t size;
+        int32_t refine_type;
+        readBinaryPOD(input, size);
+        faiss::VectorIOReader reader;
+        reader.data.resize(size);
+        input.read((char*)reader.data.data(), size);
+        readBinaryPOD(input, refine_type);
+        setCodec(std::unique_ptr<faiss::Index>(faiss::read_index(&reader)), (RefineType)refine_type);
+    }
+
+    void
+    setCodec(std::unique_ptr<faiss::Index> codec, RefineType refine_type) {
+        codec_ = std::move(codec);
+        code_size_ = codec_->sa_code_size();
+        auto sq = dynamic_cast<const faiss::IndexScalarQuantizer*>(codec_.get());
+        sq_quantizer_.reset(sq != nullptr ? sq->sq.select_quantizer() : nullptr);
+        refine_type_ = refine_type;
+        raw_size_ = refine_type == RefineType::FP32   ? data_size_
+                    : refine_type == RefineType::FP16 ? *(size_t*)dist_func_param_ * sizeof(uint16_t)
+                                                      : 0;
+    }
+
     void
     saveIndex(knowhere::MemoryIOWriter& output) {
+        saveIndexTo(output);
+    }
+
+    // streams the index into a section of a knowhere index file, the same bytes as into memory
+    void
+    saveIndex(knowhere::SectionIOWriter& output) {
+        saveIndexTo(output);
+    }
+
+    template <typename Writer>
+    void
+    saveIndexTo(Writer& output) {
         // write l2/ip calculator
         writeBinaryPOD(output, metric_type_);
         writeBinaryPOD(output, data_size_);
         writeBinaryPOD(output, *((size_t*)dist_func_param_));
 
+        // compressed links are stored as the records they were compressed from, the format does not change
+        size_t size_data_per_element = links_compressed_ ? level0Stride(level0DataSize()) : size_data_per_element_;
         writeBinaryPOD(output, offsetLevel0_);
         writeBinaryPOD(output, max_elements_);
         writeBinaryPOD(output, cur_element_count);
-        writeBinaryPOD(output, size_data_per_element_);
+        writeBinaryPOD(output, size_data_per_element);
         writeBinaryPOD(output, label_offset_);
-        writeBinaryPOD(output, offsetData_);
+        writeBinaryPOD(output, links_compressed_ ? size_links_level0_ : offsetData_);
         writeBinaryPOD(output, maxlevel_);
         writeBinaryPOD(output, enterpoint_node_);
         writeBinaryPOD(output, maxM_);
@@ -777,7 +1601,11 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
         writeBinaryPOD(output, mult_);
         writeBinaryPOD(output, ef_construction_);
 
-        output.write(data_level0_memory_, cur_element_count * size_data_per_element_);
+        if (links_compressed_) {
+            writeLevel0Records(output, size_data_per_element);
+        } else {
+            output.write(data_level0_memory_, cur_element_count * size_data_per_element_);
+        }
         // for COSINE, need save data_norm_l2_
         if (metric_type_ == Metric::COSINE) {
             output.write(data_norm_l2_, cur_element_count * sizeof(float));
@@ -789,9 +1617,76 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
             if (linkListSize)
                 output.write(linkLists_[i], linkListSize);
         }
+
+        // optional sections go after the link lists, so an index without them keeps the original layout
+        if (codec_ != nullptr) {
+            faiss::VectorIOWriter writer;
+            faiss::write_index(codec_.get(), &writer);
+            writeBinaryPOD(output, kSectionCodec);
+            writeBinaryPOD(output, writer.data.size());
+            output.write(writer.data.data(), writer.data.size());
+            writeBinaryPOD(output, (int32_t)refine_type_);
+            if (raw_data_ != nullptr) {
+                output.write(raw_data_, cur_element_count * raw_size_);
+            }
+        }
+        if (!label_of_.empty()) {
+            writeBinaryPOD(output, kSectionLabels);
+            output.write(label_of_.data(), cur_element_count * sizeof(labeltype));
+        }
+        if (num_deleted_ > 0) {
+            writeBinaryPOD(output, kSectionDeleted);
+            writeBinaryPOD(output, num_deleted_);
+            writeBinaryPOD(output, num_unrepaired_);
+            output.write(deleted_.data(), (cur_element_count + 7) / 8);
+        }
+        if (!entry_hubs_.empty()) {
+            writeBinaryPOD(output, kSectionEntryHubs);
+            writeBinaryPOD(output, entry_hubs_.size());
+            output.write(entry_hubs_.data(), entry_hubs_.size() * sizeof(tableint));
+        }
         // output.close();
     }
 
+    // the level 0 records of an index of compressed links, the links decoded back in front of the data, a block of
+    // records at a time
+    template <typename Writer>
+    void
+    writeLevel0Records(Writer& output, size_t size_data_per_element) const {
+        constexpr size_t kBlockRecords = 1024;
+        std::vector<char> block(kBlockRecords * size_data_per_element);
+        for (size_t first = 0; first < cur_element_count; first += kBlockRecords) {
+            size_t count = std::min(kBlockRecords, cur_element_count - first);
+            std::fill(block.begin(), block.end(), 0);
+            for (size_t i = 0; i < count; i++) {
+                char* record = block.data() + i * size_data_per_element;
+                decodeLinks0(first + i, (linklistsizeint*)(record + offsetLevel0_));
+                memcpy(record + size_links_level0_, getDataByInternalId(first + i), level0DataSize());
+            }
+            output.write(block.data(), count * size_data_per_element);
+        }
+    }
+
+    // Copies the next size bytes of input to dst, a large block in chunks on the build pool: one thread copying
+    // gigabytes of level 0 alone is far from the memory bandwidth.
+    static void
+    readParallel(knowhere::MemoryIOReader& input, void* dst, size_t size) {
+        constexpr size_t kChunk = 4 << 20;
+        auto src = input.borrow(size);
+        if (src == nullptr) {
+            throw std::runtime_error("loadIndex: hnsw index truncated");
+        }
+        if (size <= kChunk) {
+            memcpy(dst, src, size);
+            return;
+        }
+        int64_t chunks = (size + kChunk - 1) / kChunk;
+        knowhere::ThreadPool::GetGlobalBuildThreadPool()->parallel_for(0, chunks, 1, [&](int64_t c) {
+            size_t offset = c * kChunk;
+            memcpy(static_cast<char*>(dst) + offset, src + offset, std::min(kChunk, size - offset));
+        });
+    }
+
     void
     loadIndex(knowhere::MemoryIOReader& input, size_t max_elements_i = 0) {
         // linxj: init with metrictype
@@ -813,6 +1708,8 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
             throw std::runtime_error("Invalid metric type " + std::to_string(metric_type_));
         }
         fstdistfunc_ = space_->get_dist_func();
+        fstdistfunc_batch_4_ = space_->get_dist_func_batch_4();
+        fstdistfunc_batch_indexed_ = space_->get_dist_func_batch_indexed();
         dist_func_param_ = space_->get_dist_func_param();
 
         readBinaryPOD(input, offsetLevel0_);
@@ -824,6 +1721,7 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
             max_elements = max_elements_;
         }
         max_elements_ = max_elements;
+        initLinkListLocks(max_elements_);
         readBinaryPOD(input, size_data_per_element_);
         readBinaryPOD(input, label_offset_);
         readBinaryPOD(input, offsetData_);
@@ -836,23 +1734,22 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
         readBinaryPOD(input, mult_);
         readBinaryPOD(input, ef_construction_);
 
-        data_level0_memory_ = (char*)malloc(max_elements * size_data_per_element_);  // NOLINT
+        data_level0_memory_ = allocLevel0(max_elements * size_data_per_element_);
         if (data_level0_memory_ == nullptr)
             throw std::runtime_error("Not enough memory: loadIndex failed to allocate level0");
-        input.read(data_level0_memory_, cur_element_count * size_data_per_element_);
+        readParallel(input, data_level0_memory_, cur_element_count * size_data_per_element_);
 
         // for COSINE, need load data_norm_l2_
         if (metric_type_ == Metric::COSINE) {
             data_norm_l2_ = (float*)malloc(max_elements * sizeof(float));  // NOLINT
             if (data_norm_l2_ == nullptr)
                 throw std::runtime_error("Not enough memory: loadIndex failed to allocate level0");
-            input.read(data_norm_l2_, cur_element_count * sizeof(float));
+            readParallel(input, data_norm_l2_, cur_element_count * sizeof(float));
         }
 
         size_links_per_element_ = maxM_ * sizeof(tableint) + sizeof(linklistsizeint);
 
         size_links_level0_ = maxM0_ * sizeof(tableint) + sizeof(linklistsizeint);
-        std::vector<std::mutex>(max_elements).swap(link_list_locks_);
 
         visited_list_pool_ = new VisitedListPool(max_elements);
 
@@ -862,25 +1759,261 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
         element_levels_ = std::vector<int>(max_elements);
         revSize_ = 1.0 / mult_;
         ef_ = 10;
+        // Only the walk over the sizes, which finds where the lists are, is serial. The lists are allocated and
+        // copied on the build pool.
+        std::vector<const uint8_t*> link_lists(cur_element_count);
         for (size_t i = 0; i < cur_element_count; i++) {
             unsigned int linkListSize;
             readBinaryPOD(input, linkListSize);
-            if (linkListSize == 0) {
-                element_levels_[i] = 0;
-                linkLists_[i] = nullptr;
+            element_levels_[i] = linkListSize / size_links_per_element_;
+            linkLists_[i] = nullptr;
+            if (linkListSize != 0) {
+                link_lists[i] = input.borrow(linkListSize);
+                if (link_lists[i] == nullptr)
+                    throw std::runtime_error("loadIndex: hnsw index truncated");
+            }
+        }
+        knowhere::ThreadPool::GetGlobalBuildThreadPool()->parallel_for(0, cur_element_count, 4096, [&](int64_t i) {
+            if (element_levels_[i] == 0) {
+                return;
+            }
+            size_t size = element_levels_[i] * size_links_per_element_;
+            auto list = (char*)malloc(size);  // NOLINT
+            if (list == nullptr)
+                throw std::runtime_error("Not enough memory: loadIndex failed to allocate linklist");
+            memcpy(list, link_lists[i], size);
+            linkLists_[i] = list;
+        });
+
+        while (input.rp < input.total) {
+            int32_t section;
+            readBinaryPOD(input, section);
+            if (section == kSectionLabels) {
+                loadLabels(input, max_elements);
+            } else if (section == kSectionDeleted) {
+                loadDeleted(input, max_elements);
+            } else if (section == kSectionEntryHubs) {
+                loadEntryHubs(input);
+            } else if (section == kSectionQuantizer || section == kSectionCodec) {
+                if (section == kSectionQuantizer) {
+                    loadQuantizer(input);
+                } else {
+                    loadCodec(input);
+                }
+                if (refine_type_ != RefineType::NONE) {
+                    raw_data_ = (char*)malloc(max_elements * raw_size_);  // NOLINT
+                    if (raw_data_ == nullptr)
+                        throw std::runtime_error("Not enough memory: loadIndex failed to allocate raw data");
+                    readParallel(input, raw_data_, cur_element_count * raw_size_);
+                }
             } else {
-                element_levels_[i] = linkListSize / size_links_per_element_;
-                linkLists_[i] = (char*)malloc(linkListSize);
-                if (linkLists_[i] == nullptr)
-                    throw std::runtime_error("Not enough memory: loadIndex failed to allocate linklist");
-                input.read(linkLists_[i], linkListSize);
+                throw std::runtime_error("Unknown hnsw index section " + std::to_string(section));
+            }
+        }
+        level0_aligned_ = size_data_per_element_ > size_links_level0_ + level0DataSize();
+    }
+
+    // Renumber internal ids so that graph neighbors get close ids, and thus close level 0 records. External labels
+    // are kept through label_of_ / internal_of_.
+    void
+    reorderGraph(ReorderType type) {
+        if (type == ReorderType::NONE || cur_element_count <= 1) {
+            return;
+        }
+        if (mmap_enabled_ || links_compressed_) {
+            throw std::runtime_error("Can not reorder a mmapped or compressed index");
+        }
+        size_t n = cur_element_count;
+        auto neighbors = [this](uint32_t u) {
+            linklistsizeint* ll = get_linklist0(u);
+            return std::make_pair((const uint32_t*)(ll + 1), (size_t)getListCount(ll));
+        };
+        std::vector<tableint> order;
+        if (type == ReorderType::BFS) {
+            order = ReorderBFS(n, enterpoint_node_, neighbors);
+        } else if (type == ReorderType::RCM) {
+            order = ReorderRCM(n, neighbors);
+        } else {
+            order = ReorderGorder(n, neighbors);
+        }
+        std::vector<tableint> new_of(n);
+        for (size_t i = 0; i < n; i++) {
+            new_of[order[i]] = i;
+        }
+
+        char* data_level0_memory = allocLevel0(max_elements_ * size_data_per_element_);
+        if (data_level0_memory == nullptr)
+            throw std::runtime_error("Not enough memory: reorderGraph failed to allocate level0");
+        for (size_t i = 0; i < n; i++) {
+            memcpy(data_level0_memory + i * size_data_per_element_,
+                   data_level0_memory_ + order[i] * size_data_per_element_, size_data_per_element_);
+        }
+        freeLevel0(data_level0_memory_);
+        data_level0_memory_ = data_level0_memory;
+
+        std::vector<char*> link_lists(linkLists_, linkLists_ + n);
+        std::vector<int> element_levels(element_levels_.begin(), element_levels_.begin() + n);
+        for (size_t i = 0; i < n; i++) {
+            linkLists_[i] = link_lists[order[i]];
+            element_levels_[i] = element_levels[order[i]];
+        }
+        auto renumber = [&new_of, this](linklistsizeint* ll) {
+            tableint* data = (tableint*)(ll + 1);
+            for (size_t j = 0; j < getListCount(ll); j++) {
+                data[j] = new_of[data[j]];
+            }
+        };
+        for (size_t i = 0; i < n; i++) {
+            renumber(get_linklist0(i));
+            for (int level = 1; level <= element_levels_[i]; level++) {
+                renumber(get_linklist(i, level));
+            }
+        }
+
+        if (metric_type_ == Metric::COSINE) {
+            std::vector<float> norms(data_norm_l2_, data_norm_l2_ + n);
+            for (size_t i = 0; i < n; i++) {
+                data_norm_l2_[i] = norms[order[i]];
+            }
+        }
+        if (raw_data_ != nullptr) {
+            std::vector<char> raw_data(raw_data_, raw_data_ + n * raw_size_);
+            for (size_t i = 0; i < n; i++) {
+                memcpy(raw_data_ + i * raw_size_, raw_data.data() + order[i] * raw_size_, raw_size_);
+            }
+        }
+
+        std::vector<labeltype> label_of(max_elements_);
+        for (size_t i = 0; i < n; i++) {
+            label_of[i] = getExternalLabel(order[i]);
+        }
+        label_of_.swap(label_of);
+        buildInternalIds();
+        enterpoint_node_ = new_of[enterpoint_node_];
+        for (auto& hub : entry_hubs_) {
+            hub = new_of[hub];
+        }
+        lru_cache.clear();
+    }
+
+    // Replace the level 0 vectors of a built index with scalar quantizer codes. The graph is built on the original
+    // vectors; `keep_raw` keeps them aside so that search results can be re-ranked exactly.
+    void
+    quantizeLevel0(faiss::QuantizerType qtype, bool keep_raw) {
+        quantizeLevel0(std::make_unique<faiss::IndexScalarQuantizer>(*(size_t*)dist_func_param_, qtype),
+                       keep_raw ? RefineType::FP32 : RefineType::NONE);
+    }
+
+    // Replace the level 0 vectors of a built index with the codes of codec, an untrained faiss index that encodes
+    // with sa_encode, trained here on the vectors of the index. The graph is built on the original vectors;
+    // refine_type keeps a copy of them aside so that search results can be re-ranked.
+    void
+    quantizeLevel0(std::unique_ptr<faiss::Index> codec, RefineType refine_type) {
+        if (codec_ != nullptr || mmap_enabled_ || links_compressed_) {
+            throw std::runtime_error("Level 0 can only be quantized once on a built index");
+        }
+        if (metric_type_ != Metric::L2 && metric_type_ != Metric::INNER_PRODUCT && metric_type_ != Metric::COSINE) {
+            throw std::runtime_error("Level 0 quantization only supports float vectors");
+        }
+        std::vector<float> vectors(cur_element_count * data_size_ / sizeof(float));
+        for (size_t i = 0; i < cur_element_count; i++) {
+            memcpy((char*)vectors.data() + i * data_size_, getDataByInternalId(i), data_size_);
+        }
+        codec->train(cur_element_count, vectors.data());
+
+        size_t code_size = codec->sa_code_size();
+        size_t size_data_per_element = level0Stride(code_size);
+        char* data_level0_memory = allocLevel0(max_elements_ * size_data_per_element);
+        if (data_level0_memory == nullptr)
+            throw std::runtime_error("Not enough memory: quantizeLevel0 failed to allocate level0");
+        for (size_t i = 0; i < cur_element_count; i++) {
+            char* dst = data_level0_memory + i * size_data_per_element;
+            memcpy(dst + offsetLevel0_, get_linklist0(i), size_links_level0_);
+            memset(dst + offsetData_, 0, code_size);
+            codec->sa_encode(1, vectors.data() + i * data_size_ / sizeof(float), (uint8_t*)(dst + offsetData_));
+        }
+
+        setCodec(std::move(codec), refine_type);
+        if (refine_type_ != RefineType::NONE) {
+            raw_data_ = (char*)malloc(max_elements_ * raw_size_);  // NOLINT
+            if (raw_data_ == nullptr) {
+                freeLevel0(data_level0_memory);
+                codec_.reset();
+                sq_quantizer_.reset();
+                refine_type_ = RefineType::NONE;
+                throw std::runtime_error("Not enough memory: quantizeLevel0 failed to allocate raw data");
+            }
+            for (size_t i = 0; i < cur_element_count; i++) {
+                setRefineDataByInternalId(i, vectors.data() + i * data_size_ / sizeof(float));
             }
         }
+        freeLevel0(data_level0_memory_);
+        data_level0_memory_ = data_level0_memory;
+        size_data_per_element_ = size_data_per_element;
+    }
+
+    // Move the level 0 link lists of a built index out of the records into links_, each list as long as its count
+    // rather than maxM0_ ids. Level 0 then keeps the vectors or codes of the elements it has, and the index is read
+    // only: nothing can be added to it nor relaid out, deleted elements are not repaired.
+    void
+    compressLinks() {
+        if (links_compressed_) {
+            return;
+        }
+        if (mmap_enabled_) {
+            throw std::runtime_error("Can not compress the links of a mmapped index");
+        }
+        size_t n = cur_element_count;
+        auto narrow = [this](tableint id, const linklistsizeint* ll) {
+            const tableint* data = (const tableint*)(ll + 1);
+            return std::all_of(data, data + getListCount(ll), [id](tableint v) {
+                int64_t delta = (int64_t)v - id;
+                return delta >= std::numeric_limits<int16_t>::min() && delta <= std::numeric_limits<int16_t>::max();
+            });
+        };
+        std::vector<uint64_t> offsets(n + 1, 0);
+        for (size_t i = 0; i < n; i++) {
+            const linklistsizeint* ll = get_linklist0(i);
+            size_t count = getListCount(ll);
+            offsets[i + 1] = offsets[i] + 1 + (narrow(i, ll) ? count : count * 2);
+        }
+        std::vector<uint16_t> links(offsets[n]);
+        for (size_t i = 0; i < n; i++) {
+            const linklistsizeint* ll = get_linklist0(i);
+            const tableint* data = (const tableint*)(ll + 1);
+            uint16_t count = getListCount(ll);
+            uint16_t* dst = links.data() + offsets[i];
+            if (offsets[i + 1] - offsets[i] == 1u + count) {
+                dst[0] = count;
+                for (size_t j = 0; j < count; j++) {
+                    dst[1 + j] = (uint16_t)(int16_t)((int64_t)data[j] - (int64_t)i);
+                }
+            } else {
+                dst[0] = count | kLinksWide;
+                memcpy(dst + 1, data, count * sizeof(tableint));
+            }
+        }
+
+        size_t payload = level0DataSize();
+        size_t size_data_per_element = level0Stride(payload, false);
+        char* data_level0_memory = allocLevel0(std::max<size_t>(n, 1) * size_data_per_element);
+        if (data_level0_memory == nullptr)
+            throw std::runtime_error("Not enough memory: compressLinks failed to allocate level0");
+        for (size_t i = 0; i < n; i++) {
+            memcpy(data_level0_memory + i * size_data_per_element, getDataByInternalId(i), payload);
+        }
+        freeLevel0(data_level0_memory_);
+        data_level0_memory_ = data_level0_memory;
+        size_data_per_element_ = size_data_per_element;
+        offsetData_ = 0;
+        links_.swap(links);
+        links_offsets_.swap(offsets);
+        links_compressed_ = true;
     }
 
     unsigned short int
-    getListCount(linklistsizeint* ptr) const {
-        return *((unsigned short int*)ptr);
+    getListCount(const linklistsizeint* ptr) const {
+        return *((const unsigned short int*)ptr);
     }
 
     void
@@ -893,10 +2026,145 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
         addPoint(data_point, label, -1);
     }
 
+    // Fills an empty index with a graph built elsewhere, e.g. by CAGRA on a GPU, instead of inserting the points:
+    // every element lives on level 0 only, linked to the first maxM0_ neighbors of its row of graph, degree ids a row.
+    // Ids out of range and self loops are dropped. The entry point is the element closest to the mean.
+    void
+    loadLevel0Graph(const void* data, const uint32_t* graph, size_t rows, size_t degree) {
+        if (rows > max_elements_ || cur_element_count != 0) {
+            throw std::runtime_error("loadLevel0Graph needs an empty index of enough elements");
+        }
+        size_t dim = *(size_t*)dist_func_param_;
+        std::vector<float> mean(dim, 0.0f);
+        for (size_t i = 0; i < rows; ++i) {
+            auto point = (const char*)data + i * data_size_;
+            memset(data_level0_memory_ + i * size_data_per_element_ + offsetLevel0_, 0, size_data_per_element_);
+            setDataByInternalId(i, point);
+            if (metric_type_ == Metric::COSINE) {
+                data_norm_l2_[i] = std::sqrt(faiss::fvec_norm_L2sqr((const float*)point, dim));
+            }
+            element_levels_[i] = 0;
+            linklistsizeint* ll = get_linklist0(i);
+            tableint* links = (tableint*)(ll + 1);
+            size_t n = 0;
+            for (size_t j = 0; j < degree && n < maxM0_; ++j) {
+                auto neighbor = graph[i * degree + j];
+                if (neighbor < rows && neighbor != i) {
+                    links[n++] = neighbor;
+                }
+            }
+            setListCount(ll, n);
+            for (size_t d = 0; d < dim; ++d) {
+                mean[d] += ((const float*)point)[d] / rows;
+            }
+        }
+        tableint entry = 0;
+        float best = std::numeric_limits<float>::max();
+        for (size_t i = 0; i < rows; ++i) {
+            float dist = faiss::fvec_L2sqr(mean.data(), (const float*)data + i * dim, dim);
+            if (dist < best) {
+                best = dist;
+                entry = i;
+            }
+        }
+        cur_element_count = rows;
+        enterpoint_node_ = rows > 0 ? entry : -1;
+        maxlevel_ = rows > 0 ? 0 : -1;
+    }
+
+    // Fills an empty index from an approximate kNN graph of its points, degree ids a row, e.g. from NN-Descent or
+    // CAGRA, rather than searching the neighbors of every insert: the level 0 list of an element is pruned by the
+    // heuristic of the inserts from its kNN and the elements having it in theirs, and only the elements of the upper
+    // levels, one in M, are inserted on those. Labels are the rows, ids out of range and self loops are dropped.
+    void
+    buildFromKnnGraph(const void* data, const uint32_t* graph, size_t rows, size_t degree) {
+        if (rows > max_elements_ || cur_element_count != 0) {
+            throw std::runtime_error("buildFromKnnGraph needs an empty index of enough elements");
+        }
+        if (rows == 0) {
+            return;
+        }
+        auto pool = knowhere::ThreadPool::GetGlobalBuildThreadPool();
+        size_t dim = *(size_t*)dist_func_param_;
+        // the levels are drawn in the order of the rows, the highest first one is the entry point
+        int top = -1;
+        tableint entry = 0;
+        for (size_t i = 0; i < rows; ++i) {
+            element_levels_[i] = getRandomLevel(mult_);
+            if (element_levels_[i] > top) {
+                top = element_levels_[i];
+                entry = i;
+            }
+        }
+        pool->parallel_for(0, rows, 1024, [&](int64_t i) {
+            auto point = (const char*)data + i * data_size_;
+            memset(data_level0_memory_ + i * size_data_per_element_ + offsetLevel0_, 0, size_data_per_element_);
+            setDataByInternalId(i, point);
+            if (metric_type_ == Metric::COSINE) {
+                data_norm_l2_[i] = std::sqrt(faiss::fvec_norm_L2sqr((const float*)point, dim));
+            }
+            if (element_levels_[i] > 0) {
+                linkLists_[i] = (char*)malloc(size_links_per_element_ * element_levels_[i] + 1);
+                if (linkLists_[i] == nullptr) {
+                    throw std::runtime_error("Not enough memory: buildFromKnnGraph failed to allocate linklist");
+                }
+                memset(linkLists_[i], 0, size_links_per_element_ * element_levels_[i] + 1);
+            }
+        });
+        cur_element_count = rows;
+
+        std::vector<std::vector<tableint>> reverse(rows);
+        for (size_t i = 0; i < rows; ++i) {
+            for (size_t j = 0; j < degree; ++j) {
+                auto neighbor = graph[i * degree + j];
+                if (neighbor < rows && neighbor != i) {
+                    reverse[neighbor].push_back(i);
+                }
+            }
+        }
+        pool->parallel_for(0, rows, 64, [&](int64_t i) {
+            std::vector<tableint> ids(reverse[i]);
+            for (size_t j = 0; j < degree; ++j) {
+                auto neighbor = graph[i * degree + j];
+                if (neighbor < rows && neighbor != i) {
+                    ids.push_back(neighbor);
+                }
+            }
+            std::sort(ids.begin(), ids.end());
+            ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+            std::priority_queue<std::pair<dist_t, tableint>, std::vector<std::pair<dist_t, tableint>>, CompareByFirst>
+                candidates;
+            for (auto id : ids) {
+                candidates.emplace(calcDistance(i, id), id);
+            }
+            auto links = getNeighborsByHeuristic2(candidates, maxM0_);
+            linklistsizeint* ll = get_linklist0(i);
+            std::copy(links.begin(), links.end(), (tableint*)(ll + 1));
+            setListCount(ll, links.size());
+        });
+        std::vector<std::vector<tableint>>().swap(reverse);
+
+        enterpoint_node_ = entry;
+        maxlevel_ = top;
+        std::vector<tableint> upper;
+        for (size_t i = 0; i < rows; ++i) {
+            if (element_levels_[i] > 0 && i != entry) {
+                upper.push_back(i);
+            }
+        }
+        pool->parallel_for(0, upper.size(), 1, [&](int64_t i) {
+            auto id = upper[i];
+            linkElement(getDataByInternalId(id), id, entry, top, element_levels_[id], 1);
+        });
+    }
+
     void
     updatePoint(const void* dataPoint, tableint internalId, float updateNeighborProbability) {
+        if (links_compressed_) {
+            throw std::runtime_error("Can not update an index of compressed links");
+        }
         // update the feature vector associated with existing point with new vector
-        memcpy(getDataByInternalId(internalId), dataPoint, data_size_);
+        setDataByInternalId(internalId, dataPoint);
 
         int maxLevelCopy = maxlevel_;
         tableint entryPointCopy = enterpoint_node_;
@@ -959,7 +2227,7 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
                 getNeighborsByHeuristic2(candidates, layer == 0 ? maxM0_ : maxM_);
 
                 {
-                    std::unique_lock<std::mutex> lock(link_list_locks_[neigh]);
+                    std::unique_lock<SpinLock> lock(linkListLock(neigh));
                     linklistsizeint* ll_cur;
                     ll_cur = get_linklist_at_level(neigh, layer);
                     size_t candSize = candidates.size();
@@ -987,7 +2255,7 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
                 while (changed) {
                     changed = false;
                     unsigned int* data;
-                    std::unique_lock<std::mutex> lock(link_list_locks_[currObj]);
+                    std::unique_lock<SpinLock> lock(linkListLock(currObj));
                     data = get_linklist_at_level(currObj, level);
                     int size = getListCount(data);
                     tableint* datal = (tableint*)(data + 1);
@@ -1034,9 +2302,112 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
         }
     }
 
+    // Replace the links of `internal_id` to deleted elements by links to the live neighbors of those elements, pruned
+    // by the construction heuristic. Deleted elements keep their own lists, so that searches can still pass through
+    // them, hence repairing different elements in parallel is safe; searching meanwhile is not, the lists are
+    // rewritten in place. A level left without a live candidate is linked again by finishRepairDeleted().
+    void
+    repairDeletedLinks(tableint internal_id) {
+        if (links_compressed_) {
+            throw std::runtime_error("Can not repair an index of compressed links");
+        }
+        auto is_deleted = [this](tableint id) { return isMarkedDeleted(getExternalLabel(id)); };
+        if (is_deleted(internal_id)) {
+            return;
+        }
+        for (int level = 0; level <= element_levels_[internal_id]; level++) {
+            linklistsizeint* ll = get_linklist_at_level(internal_id, level);
+            size_t size = getListCount(ll);
+            tableint* data = (tableint*)(ll + 1);
+            if (std::none_of(data, data + size, is_deleted)) {
+                continue;
+            }
+
+            std::priority_queue<std::pair<dist_t, tableint>, std::vector<std::pair<dist_t, tableint>>, CompareByFirst>
+                candidates;
+            std::unordered_set<tableint> seen{internal_id};
+            auto add = [&](tableint id) {
+                if (!is_deleted(id) && seen.insert(id).second) {
+                    candidates.emplace(calcDistance(internal_id, id), id);
+                }
+            };
+            for (size_t j = 0; j < size; j++) {
+                if (!is_deleted(data[j])) {
+                    add(data[j]);
+                    continue;
+                }
+                linklistsizeint* ll_deleted = get_linklist_at_level(data[j], level);
+                tableint* data_deleted = (tableint*)(ll_deleted + 1);
+                for (size_t k = 0; k < getListCount(ll_deleted); k++) {
+                    add(data_deleted[k]);
+                }
+            }
+
+            size_t Mcurmax = level ? maxM_ : maxM0_;
+            std::vector<tableint> selected(getNeighborsByHeuristic2(candidates, Mcurmax));
+            if (selected.empty()) {
+                std::unique_lock<std::mutex> lock(unlinked_guard_);
+                unlinked_.emplace_back(internal_id, level);
+            }
+            std::unique_lock<SpinLock> lock(linkListLock(internal_id));
+            for (size_t idx = 0; idx < selected.size(); idx++) {
+                data[idx] = selected[idx];
+            }
+            setListCount(ll, selected.size());
+        }
+    }
+
+    // Call once every element has been repaired. The levels the repair left without links, all the neighbors and
+    // their neighbors deleted, are linked to the nearest live elements found from the entry point, and those link
+    // back to them, else nothing would reach them any more once their deleted neighbors are unreachable too.
+    void
+    finishRepairDeleted() {
+        auto is_deleted = [this](tableint id) { return isMarkedDeleted(getExternalLabel(id)); };
+        for (auto [internal_id, level] : unlinked_) {
+            tableint currObj = enterpoint_node_;
+            if (currObj == internal_id) {
+                continue;
+            }
+            dist_t curdist = calcDistance(internal_id, currObj);
+            for (int l = maxlevel_; l > level; l--) {
+                bool changed = true;
+                while (changed) {
+                    changed = false;
+                    linklistsizeint* ll = get_linklist(currObj, l);
+                    tableint* data = (tableint*)(ll + 1);
+                    for (size_t j = 0; j < getListCount(ll); j++) {
+                        if (data[j] == internal_id) {
+                            continue;
+                        }
+                        dist_t d = calcDistance(internal_id, data[j]);
+                        if (d < curdist) {
+                            curdist = d;
+                            currObj = data[j];
+                            changed = true;
+                        }
+                    }
+                }
+            }
+            auto top_candidates = searchBaseLayer(currObj, internal_id, level);
+            std::priority_queue<std::pair<dist_t, tableint>, std::vector<std::pair<dist_t, tableint>>, CompareByFirst>
+                live_candidates;
+            for (; !top_candidates.empty(); top_candidates.pop()) {
+                auto [dist, id] = top_candidates.top();
+                if (id != internal_id && !is_deleted(id)) {
+                    live_candidates.emplace(dist, id);
+                }
+            }
+            if (!live_candidates.empty()) {
+                mutuallyConnectNewElement(getDataByInternalId(internal_id), internal_id, live_candidates, level, true);
+            }
+        }
+        unlinked_.clear();
+        num_unrepaired_ = 0;
+    }
+
     std::vector<tableint>
     getConnectionsWithLock(tableint internalId, int level) {
-        std::unique_lock<std::mutex> lock(link_list_locks_[internalId]);
+        std::unique_lock<SpinLock> lock(linkListLock(internalId));
         unsigned int* data = get_linklist_at_level(internalId, level);
         int size = getListCount(data);
         std::vector<tableint> result(size);
@@ -1045,31 +2416,102 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
         return result;
     };
 
+    // Links the new element cur_c, of level curlevel, on its levels down to lowest_level: a greedy descent from currObj
+    // on the levels above its own, maxlevelcopy the top one, then the neighbors found by searchBaseLayer on each level.
+    void
+    linkElement(const void* data_point, tableint cur_c, tableint currObj, int maxlevelcopy, int curlevel,
+                int lowest_level) {
+        if (curlevel < maxlevelcopy) {
+            dist_t curdist = calcDistance(cur_c, currObj);
+            for (int level = maxlevelcopy; level > curlevel; level--) {
+                bool changed = true;
+                while (changed) {
+                    changed = false;
+                    unsigned int* data;
+                    std::unique_lock<SpinLock> lock(linkListLock(currObj));
+                    data = get_linklist(currObj, level);
+                    int size = getListCount(data);
+
+                    tableint* datal = (tableint*)(data + 1);
+                    for (int i = 0; i < size; i++) {
+                        tableint cand = datal[i];
+                        if (cand < 0 || cand > max_elements_)
+                            throw std::runtime_error("cand error");
+                        dist_t d = calcDistance(cur_c, cand);
+                        if (d < curdist) {
+                            curdist = d;
+                            currObj = cand;
+                            changed = true;
+                        }
+                    }
+                }
+            }
+        }
+
+        for (int level = std::min(curlevel, maxlevelcopy); level >= lowest_level; level--) {
+            if (level > maxlevelcopy || level < 0)  // possible?
+                throw std::runtime_error("Level error");
+
+            std::priority_queue<std::pair<dist_t, tableint>, std::vector<std::pair<dist_t, tableint>>, CompareByFirst>
+                top_candidates = searchBaseLayer(currObj, cur_c, level);
+            // a concurrent insert may have linked the new element already, it must not become its own neighbor
+            std::priority_queue<std::pair<dist_t, tableint>, std::vector<std::pair<dist_t, tableint>>, CompareByFirst>
+                filtered_candidates;
+            while (!top_candidates.empty()) {
+                if (top_candidates.top().second != cur_c) {
+                    filtered_candidates.push(top_candidates.top());
+                }
+                top_candidates.pop();
+            }
+            if (!filtered_candidates.empty()) {
+                currObj = mutuallyConnectNewElement(data_point, cur_c, filtered_candidates, level, false);
+            }
+        }
+    }
+
     tableint
     addPoint(const void* data_point, labeltype label, int level) {
+        if (links_compressed_) {
+            throw std::runtime_error("Can not add to an index of compressed links");
+        }
         tableint cur_c = label;
         {
             std::unique_lock<std::mutex> templock_curr(cur_element_count_guard_);
             if (cur_element_count >= max_elements_) {
                 throw std::runtime_error("The number of elements exceeds the specified limit");
             };
+            // once reordered, labels no longer follow internal ids, new points just take the next id
+            if (!label_of_.empty()) {
+                cur_c = cur_element_count;
+                label_of_[cur_c] = label;
+                if (label >= internal_of_.size()) {
+                    internal_of_.resize(label + 1);
+                }
+                internal_of_[label] = cur_c;
+            }
             cur_element_count++;
         }
 
-        std::unique_lock<std::mutex> lock_el(link_list_locks_[cur_c]);
         int curlevel = (level > 0) ? level : getRandomLevel(mult_);
 
         element_levels_[cur_c] = curlevel;
 
-        std::unique_lock<std::mutex> templock(global);
-        int maxlevelcopy = maxlevel_;
-        if (curlevel <= maxlevelcopy)
-            templock.unlock();
-        tableint currObj = enterpoint_node_;
-        tableint enterpoint_copy = enterpoint_node_;
+        // Only an insert that raises the max level takes the global lock, and holds it until the new entry point is
+        // linked. enterpoint_node_ is published before maxlevel_, so the entry point read here always has the levels
+        // the max level read here asks for.
+        int maxlevelcopy = __atomic_load_n(&maxlevel_, __ATOMIC_ACQUIRE);
+        tableint currObj = __atomic_load_n(&enterpoint_node_, __ATOMIC_ACQUIRE);
+        std::unique_lock<std::mutex> templock(global, std::defer_lock);
+        if (curlevel > maxlevelcopy) {
+            templock.lock();
+            maxlevelcopy = maxlevel_;
+            currObj = enterpoint_node_;
+            if (curlevel <= maxlevelcopy)
+                templock.unlock();
+        }
 
         memset(data_level0_memory_ + cur_c * size_data_per_element_ + offsetLevel0_, 0, size_data_per_element_);
-        memcpy(getDataByInternalId(cur_c), data_point, data_size_);
+        setDataByInternalId(cur_c, data_point);
 
         if (metric_type_ == Metric::COSINE) {
             data_norm_l2_[cur_c] =
@@ -1084,66 +2526,78 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
         }
 
         if ((signed)currObj != -1) {
-            if (curlevel < maxlevelcopy) {
-                dist_t curdist = calcDistance(cur_c, currObj);
-                for (int level = maxlevelcopy; level > curlevel; level--) {
-                    bool changed = true;
-                    while (changed) {
-                        changed = false;
-                        unsigned int* data;
-                        std::unique_lock<std::mutex> lock(link_list_locks_[currObj]);
-                        data = get_linklist(currObj, level);
-                        int size = getListCount(data);
-
-                        tableint* datal = (tableint*)(data + 1);
-                        for (int i = 0; i < size; i++) {
-                            tableint cand = datal[i];
-                            if (cand < 0 || cand > max_elements_)
-                                throw std::runtime_error("cand error");
-                            dist_t d = calcDistance(cur_c, cand);
-                            if (d < curdist) {
-                                curdist = d;
-                                currObj = cand;
-                                changed = true;
-                            }
-                        }
-                    }
-                }
-            }
-
-            for (int level = std::min(curlevel, maxlevelcopy); level >= 0; level--) {
-                if (level > maxlevelcopy || level < 0)  // possible?
-                    throw std::runtime_error("Level error");
-
-                std::priority_queue<std::pair<dist_t, tableint>, std::vector<std::pair<dist_t, tableint>>,
-                                    CompareByFirst>
-                    top_candidates = searchBaseLayer(currObj, cur_c, level);
-                currObj = mutuallyConnectNewElement(data_point, cur_c, top_candidates, level, false);
-            }
-
-        } else {
-            // Do nothing for the first element
-            enterpoint_node_ = 0;
-            maxlevel_ = curlevel;
+            linkElement(data_point, cur_c, currObj, maxlevelcopy, curlevel, 0);
         }
 
         // Releasing lock for the maximum level
         if (curlevel > maxlevelcopy) {
-            enterpoint_node_ = cur_c;
-            maxlevel_ = curlevel;
+            __atomic_store_n(&enterpoint_node_, cur_c, __ATOMIC_RELEASE);
+            __atomic_store_n(&maxlevel_, curlevel, __ATOMIC_RELEASE);
         }
         return cur_c;
     };
 
+    // the filtered out ratio from which a knn search is cheaper by brute force than through the graph
+    float
+    getKnnBFThreshold(const SearchParam* param) const {
+        return (param && param->filter_threshold_ >= 0.0f) ? param->filter_threshold_ : kHnswSearchKnnBFThreshold;
+    }
+
+    // Calls fn(internal id, label) for the elements the filter keeps. A filter of alive ids is walked directly, the
+    // others are tested element by element.
+    template <typename Fn>
+    void
+    forEachUnfiltered(const knowhere::BitsetView& bitset, Fn&& fn) const {
+        if (auto ids = bitset.alive_ids(); ids != nullptr) {
+            for (size_t i = 0; i < bitset.num_alive_ids() && ids[i] < cur_element_count; ++i) {
+                fn(getInternalId(ids[i]), ids[i]);
+            }
+            for (labeltype label = bitset.size(); label < cur_element_count; ++label) {
+                fn(getInternalId(label), label);
+            }
+            return;
+        }
+        for (tableint id = 0; id < cur_element_count; ++id) {
+            labeltype label = getExternalLabel(id);
+            if (!bitset.test(label)) {
+                fn(id, label);
+            }
+        }
+    }
+
+    // Brute force for a tile of queries. Every surviving vector is loaded once and scored against all the queries
+    // while it is still in cache, instead of one scan of the whole index per query.
+    void
+    searchKnnBFBatch(const void* query_data, size_t nq, size_t k, const knowhere::BitsetView bitset,
+                     dist_t* distances, labeltype* labels) const {
+        std::vector<knowhere::ResultMaxHeap<dist_t, labeltype>> max_heaps(
+            nq, knowhere::ResultMaxHeap<dist_t, labeltype>(k));
+        forEachUnfiltered(bitset, [&](tableint id, labeltype label) {
+            for (size_t q = 0; q < nq; ++q) {
+                max_heaps[q].Push(calcRefineDistance((const char*)query_data + q * data_size_, id), label);
+            }
+        });
+        for (size_t q = 0; q < nq; ++q) {
+            const size_t len = std::min(max_heaps[q].Size(), k);
+            for (size_t i = len; i < k; ++i) {
+                distances[q * k + i] = std::numeric_limits<dist_t>::max();
+                labels[q * k + i] = -1;
+            }
+            for (int64_t i = len - 1; i >= 0; --i) {
+                const auto op = max_heaps[q].Pop();
+                distances[q * k + i] = op.value().first;
+                labels[q * k + i] = op.value().second;
+            }
+        }
+    }
+
     std::vector<std::pair<dist_t, labeltype>>
     searchKnnBF(const void* query_data, size_t k, const knowhere::BitsetView bitset) const {
         knowhere::ResultMaxHeap<dist_t, labeltype> max_heap(k);
-        for (labeltype id = 0; id < cur_element_count; ++id) {
-            if (!bitset.test(id)) {
-                dist_t dist = calcDistance(query_data, id);
-                max_heap.Push(dist, id);
-            }
-        }
+        forEachUnfiltered(bitset, [&](tableint id, labeltype label) {
+            dist_t dist = calcRefineDistance(query_data, id);
+            max_heap.Push(dist, label);
+        });
         const size_t len = std::min(max_heap.Size(), k);
         std::vector<std::pair<dist_t, labeltype>> result(len);
         for (int64_t i = len - 1; i >= 0; --i) {
@@ -1173,7 +2627,7 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
             const auto bs_cnt = bitset.count();
             if (bs_cnt == cur_element_count)
                 return {};
-            if (bs_cnt >= (cur_element_count * kHnswSearchKnnBFThreshold)) {
+            if (bs_cnt >= (cur_element_count * getKnnBFThreshold(param))) {
                 return searchKnnBF(query_data, k, bitset);
             }
         }
@@ -1187,9 +2641,10 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
         }
         // for tuning, do not use cache
         if (param->for_tuning || !lru_cache.try_get(vec_hash, currObj)) {
-            dist_t curdist = calcDistance(query_data, enterpoint_node_);
+            auto [entry, curdist, top_level] = getSearchEntry(query_data);
+            currObj = entry;
 
-            for (int level = maxlevel_; level > 0; level--) {
+            for (int level = top_level; level > 0; level--) {
                 bool changed = true;
                 if (feder_result != nullptr) {
                     feder_result->visit_info_.AddLevelVisitRecord(level);
@@ -1200,8 +2655,8 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
 
                     data = (unsigned int*)get_linklist(currObj, level);
                     int size = getListCount(data);
-                    metric_hops++;
-                    metric_distance_computations += size;
+                    knowhere::QueryStats::Current().hops++;
+                    knowhere::QueryStats::Current().distance_computations += size;
                     tableint* datal = (tableint*)(data + 1);
 #if defined(USE_PREFETCH)
                     for (int i = 0; i < size; ++i) {
@@ -1214,9 +2669,10 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
                             throw std::runtime_error("cand error");
                         dist_t d = calcDistance(query_data, cand);
                         if (feder_result != nullptr) {
-                            feder_result->visit_info_.AddVisitRecord(level, currObj, cand, d);
-                            feder_result->id_set_.insert(currObj);
-                            feder_result->id_set_.insert(cand);
+                            feder_result->visit_info_.AddVisitRecord(level, getExternalLabel(currObj),
+                                                                     getExternalLabel(cand), d);
+                            feder_result->id_set_.insert(getExternalLabel(currObj));
+                            feder_result->id_set_.insert(getExternalLabel(cand));
                         }
 
                         if (d < curdist) {
@@ -1230,34 +2686,270 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
         }
         std::vector<std::pair<dist_t, tableint>> top_candidates;
         size_t ef = param ? param->ef_ : this->ef_;
+        size_t patience = param ? param->early_stop_patience_ : 0;
         if (!bitset.empty()) {
-            top_candidates = searchBaseLayerST<true, true>(currObj, query_data, std::max(ef, k), bitset, feder_result);
+            top_candidates = searchBaseLayerST<true, true>(currObj, query_data, std::max(ef, k), bitset,
+                                                           getPrefetchDepth(param), k, patience, feder_result);
         } else {
-            top_candidates = searchBaseLayerST<false, true>(currObj, query_data, std::max(ef, k), bitset, feder_result);
+            top_candidates = searchBaseLayerST<false, true>(currObj, query_data, std::max(ef, k), bitset,
+                                                            getPrefetchDepth(param), k, patience, feder_result);
         }
+        refineCandidates(query_data, top_candidates, getRefineCount(k, param));
         std::vector<std::pair<dist_t, labeltype>> result;
         size_t len = std::min(k, top_candidates.size());
         result.reserve(len);
         for (int i = 0; i < len; ++i) {
-            result.emplace_back(top_candidates[i].first, (labeltype)top_candidates[i].second);
+            result.emplace_back(top_candidates[i].first, getExternalLabel(top_candidates[i].second));
         }
         if (len > 0) {
-            lru_cache.put(vec_hash, result[0].second);
+            lru_cache.put(vec_hash, top_candidates[0].second);
         }
         return result;
     };
 
+    // Search a tile of `nq` contiguous queries. The greedy descents through the upper levels are interleaved, so
+    // that while one query computes distances, the link list and neighbor vectors of the next queries are being
+    // prefetched. Results are written into `distances` / `labels` (nq * k, closer first), unfilled slots are padded
+    // with label -1 and the max distance.
+    void
+    searchKnnBatch(const void* query_data, size_t nq, size_t k, const knowhere::BitsetView bitset,
+                   const SearchParam* param, dist_t* distances, labeltype* labels) const {
+        auto fill = [&](size_t q, size_t from) {
+            for (size_t i = from; i < k; ++i) {
+                distances[q * k + i] = std::numeric_limits<dist_t>::max();
+                labels[q * k + i] = -1;
+            }
+        };
+        if (cur_element_count == 0) {
+            for (size_t q = 0; q < nq; ++q) {
+                fill(q, 0);
+            }
+            return;
+        }
+
+        size_t dim = *(size_t*)dist_func_param_;
+        bool is_binary = (metric_type_ == Metric::HAMMING || metric_type_ == Metric::JACCARD);
+
+        // do normalize for COSINE metric type
+        std::unique_ptr<float[]> query_data_norm;
+        if (metric_type_ == Metric::COSINE) {
+            query_data_norm = std::make_unique<float[]>(nq * dim);
+            std::copy_n((const float*)query_data, nq * dim, query_data_norm.get());
+            for (size_t q = 0; q < nq; ++q) {
+                knowhere::NormalizeVec(query_data_norm.get() + q * dim, dim);
+            }
+            query_data = query_data_norm.get();
+        }
+        auto get_query = [&](size_t q) { return (const char*)query_data + q * data_size_; };
+
+        // the bitset is shared by the whole tile, so count it only once
+        if (!bitset.empty()) {
+            const auto bs_cnt = bitset.count();
+            if (bs_cnt == cur_element_count) {
+                for (size_t q = 0; q < nq; ++q) {
+                    fill(q, 0);
+                }
+                return;
+            }
+            if (bs_cnt >= (cur_element_count * getKnnBFThreshold(param))) {
+                searchKnnBFBatch(query_data, nq, k, bitset, distances, labels);
+                return;
+            }
+        }
+
+        bool for_tuning = param && param->for_tuning;
+        std::vector<tableint> cur_obj(nq, enterpoint_node_);
+        std::vector<dist_t> cur_dist(nq);
+        std::vector<uint64_t> vec_hash(nq);
+        std::vector<int> top_level(nq);
+        // queries which still walk down the upper levels
+        std::vector<size_t> descending;
+        descending.reserve(nq);
+        for (size_t q = 0; q < nq; ++q) {
+            vec_hash[q] = is_binary ? knowhere::hash_binary_vec((const uint8_t*)get_query(q), dim)
+                                    : knowhere::hash_vec((const float*)get_query(q), dim);
+            // for tuning, do not use cache
+            if (for_tuning || !lru_cache.try_get(vec_hash[q], cur_obj[q])) {
+                std::tie(cur_obj[q], cur_dist[q], top_level[q]) = getSearchEntry(get_query(q));
+                descending.push_back(q);
+            }
+        }
+
+        for (int level = maxlevel_; level > 0; level--) {
+            std::vector<size_t> changed;
+            changed.reserve(descending.size());
+            for (auto q : descending) {
+                if (top_level[q] >= level) {
+                    changed.push_back(q);
+                }
+            }
+            while (!changed.empty()) {
+                size_t n_changed = 0;
+                for (size_t i = 0; i < changed.size(); ++i) {
+#if defined(USE_PREFETCH)
+                    if (i + 2 < changed.size()) {
+                        _mm_prefetch(get_linklist(cur_obj[changed[i + 2]], level), _MM_HINT_T0);
+                    }
+                    if (i + 1 < changed.size()) {
+                        auto next = get_linklist(cur_obj[changed[i + 1]], level);
+                        int next_size = getListCount(next);
+                        tableint* next_datal = (tableint*)(next + 1);
+                        for (int j = 0; j < next_size; ++j) {
+                            _mm_prefetch(getDataByInternalId(next_datal[j]), _MM_HINT_T0);
+                        }
+                    }
+#endif
+                    size_t q = changed[i];
+                    bool improved = false;
+                    unsigned int* data = (unsigned int*)get_linklist(cur_obj[q], level);
+                    int size = getListCount(data);
+                    knowhere::QueryStats::Current().hops++;
+                    knowhere::QueryStats::Current().distance_computations += size;
+                    tableint* datal = (tableint*)(data + 1);
+                    tableint best = cur_obj[q];
+                    for (int j = 0; j < size; j++) {
+                        tableint cand = datal[j];
+                        if (cand < 0 || cand > max_elements_)
+                            throw std::runtime_error("cand error");
+                        dist_t d = calcDistance(get_query(q), cand);
+                        if (d < cur_dist[q]) {
+                            cur_dist[q] = d;
+                            best = cand;
+                            improved = true;
+                        }
+                    }
+                    cur_obj[q] = best;
+                    if (improved) {
+                        changed[n_changed++] = q;
+                    }
+                }
+                changed.resize(n_changed);
+            }
+        }
+
+        size_t ef = std::max(param ? param->ef_ : this->ef_, k);
+        size_t prefetch_depth = getPrefetchDepth(param);
+        size_t patience = param ? param->early_stop_patience_ : 0;
+        for (size_t q = 0; q < nq; ++q) {
+            std::vector<std::pair<dist_t, tableint>> top_candidates;
+            if (!bitset.empty()) {
+                top_candidates = searchBaseLayerST<true, true>(cur_obj[q], get_query(q), ef, bitset, prefetch_depth,
+                                                               k, patience);
+            } else {
+                top_candidates = searchBaseLayerST<false, true>(cur_obj[q], get_query(q), ef, bitset, prefetch_depth,
+                                                                k, patience);
+            }
+            refineCandidates(get_query(q), top_candidates, getRefineCount(k, param));
+            size_t len = std::min(k, top_candidates.size());
+            for (size_t i = 0; i < len; ++i) {
+                distances[q * k + i] = top_candidates[i].first;
+                labels[q * k + i] = getExternalLabel(top_candidates[i].second);
+            }
+            fill(q, len);
+            if (len > 0) {
+                lru_cache.put(vec_hash[q], top_candidates[0].second);
+            }
+        }
+    }
+
+    // The state of a search that goes on where it stopped, for knowhere::IndexIterator: a best-first walk of level 0
+    // from the entry found on the upper levels, of which the candidates and the visited nodes are kept between the
+    // batches. Every node the walk reaches is a result, the ones of the filter excepted.
+    struct IteratorWorkspace {
+        std::unique_ptr<float[]> query_norm;
+        const void* query = nullptr;
+        knowhere::BitsetView bitset;
+        // the nodes to expand, the closest on top
+        std::priority_queue<std::pair<dist_t, tableint>, std::vector<std::pair<dist_t, tableint>>,
+                            std::greater<std::pair<dist_t, tableint>>>
+            candidates;
+        std::unordered_set<tableint> visited;
+        // the buffer compressed link lists are decoded into
+        std::vector<linklistsizeint> links;
+        // the entry, reported by the first expansion
+        bool started = false;
+    };
+
+    std::unique_ptr<IteratorWorkspace>
+    getIteratorWorkspace(const void* query_data, const knowhere::BitsetView bitset) const {
+        auto ws = std::make_unique<IteratorWorkspace>();
+        ws->bitset = bitset;
+        ws->query = query_data;
+        ws->links.resize(links_compressed_ ? maxM0_ + 1 : 0);
+        if (metric_type_ == Metric::COSINE) {
+            ws->query_norm = knowhere::CopyAndNormalizeFloatVec((const float*)query_data, *((size_t*)dist_func_param_));
+            ws->query = ws->query_norm.get();
+        }
+        if (cur_element_count == 0) {
+            return ws;
+        }
+        auto [entry, curdist, top_level] = getSearchEntry(ws->query);
+        for (int level = top_level; level > 0; level--) {
+            bool changed = true;
+            while (changed) {
+                changed = false;
+                auto data = (unsigned int*)get_linklist(entry, level);
+                int size = getListCount(data);
+                tableint* datal = (tableint*)(data + 1);
+                for (int i = 0; i < size; i++) {
+                    dist_t d = calcDistance(ws->query, datal[i]);
+                    if (d < curdist) {
+                        curdist = d;
+                        entry = datal[i];
+                        changed = true;
+                    }
+                }
+            }
+        }
+        ws->candidates.emplace(curdist, entry);
+        ws->visited.insert(entry);
+        return ws;
+    }
+
+    // Expands the closest candidate of the walk, fn(distance, label) for every node it reaches that the filter
+    // keeps. Returns false once there is no candidate left.
+    template <typename Fn>
+    bool
+    iteratorExpand(IteratorWorkspace& ws, Fn&& fn) const {
+        auto report = [&](dist_t dist, tableint id) {
+            labeltype label = getExternalLabel(id);
+            if (ws.bitset.empty() || !ws.bitset.test(label)) {
+                fn(codec_ != nullptr && raw_data_ != nullptr ? calcRefineDistance(ws.query, id) : dist, label);
+            }
+        };
+        if (!ws.started) {
+            ws.started = true;
+            if (!ws.candidates.empty()) {
+                report(ws.candidates.top().first, ws.candidates.top().second);
+            }
+        }
+        if (ws.candidates.empty()) {
+            return false;
+        }
+        tableint current = ws.candidates.top().second;
+        ws.candidates.pop();
+        const linklistsizeint* data = getLinks0(current, ws.links.data());
+        size_t size = getListCount(data);
+        for (size_t j = 1; j <= size; j++) {
+            tableint candidate = *(data + j);
+            if (ws.visited.insert(candidate).second) {
+                dist_t dist = calcDistance(ws.query, candidate);
+                ws.candidates.emplace(dist, candidate);
+                report(dist, candidate);
+            }
+        }
+        return true;
+    }
+
     std::vector<std::pair<dist_t, labeltype>>
     searchRangeBF(const void* query_data, float radius, const knowhere::BitsetView bitset) const {
         std::vector<std::pair<dist_t, labeltype>> result;
-        for (labeltype id = 0; id < cur_element_count; ++id) {
-            if (!bitset.test(id)) {
-                dist_t dist = calcDistance(query_data, id);
-                if (dist < radius) {
-                    result.emplace_back(dist, id);
-                }
+        forEachUnfiltered(bitset, [&](tableint id, labeltype label) {
+            dist_t dist = calcRefineDistance(query_data, id);
+            if (dist < radius) {
+                result.emplace_back(dist, label);
             }
-        }
+        });
         return result;
     }
 
@@ -1297,9 +2989,10 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
         }
         // for tuning, do not use cache
         if (param->for_tuning || !lru_cache.try_get(vec_hash, currObj)) {
-            dist_t curdist = calcDistance(query_data, enterpoint_node_);
+            auto [entry, curdist, top_level] = getSearchEntry(query_data);
+            currObj = entry;
 
-            for (int level = maxlevel_; level > 0; level--) {
+            for (int level = top_level; level > 0; level--) {
                 bool changed = true;
                 if (feder_result != nullptr) {
                     feder_result->visit_info_.AddLevelVisitRecord(level);
@@ -1310,8 +3003,8 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
 
                     data = (unsigned int*)get_linklist(currObj, level);
                     int size = getListCount(data);
-                    metric_hops++;
-                    metric_distance_computations += size;
+                    knowhere::QueryStats::Current().hops++;
+                    knowhere::QueryStats::Current().distance_computations += size;
 
                     tableint* datal = (tableint*)(data + 1);
                     for (int i = 0; i < size; i++) {
@@ -1320,9 +3013,10 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
                             throw std::runtime_error("cand error");
                         dist_t d = calcDistance(query_data, cand);
                         if (feder_result != nullptr) {
-                            feder_result->visit_info_.AddVisitRecord(level, currObj, cand, d);
-                            feder_result->id_set_.insert(currObj);
-                            feder_result->id_set_.insert(cand);
+                            feder_result->visit_info_.AddVisitRecord(level, getExternalLabel(currObj),
+                                                                     getExternalLabel(cand), d);
+                            feder_result->id_set_.insert(getExternalLabel(currObj));
+                            feder_result->id_set_.insert(getExternalLabel(cand));
                         }
                         if (d < curdist) {
                             curdist = d;
@@ -1336,10 +3030,25 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
 
         std::vector<std::pair<dist_t, tableint>> top_candidates;
         size_t ef = param ? param->ef_ : this->ef_;
-        if (!bitset.empty()) {
-            top_candidates = searchBaseLayerST<true, true>(currObj, query_data, ef, bitset, feder_result);
-        } else {
-            top_candidates = searchBaseLayerST<false, true>(currObj, query_data, ef, bitset, feder_result);
+        // With an initial ef, the seeding search starts small and grows (up to ef) only while none of its candidates
+        // is within the radius. The walk from the seeds then follows the frontier as long as it stays inside.
+        size_t cur_ef = ef;
+        if (param && param->range_init_ef_ > 0 && feder_result == nullptr) {
+            cur_ef = std::min(param->range_init_ef_, ef);
+        }
+        while (true) {
+            if (!bitset.empty()) {
+                top_candidates = searchBaseLayerST<true, true>(currObj, query_data, cur_ef, bitset,
+                                                               getPrefetchDepth(param), 0, 0, feder_result);
+            } else {
+                top_candidates = searchBaseLayerST<false, true>(currObj, query_data, cur_ef, bitset,
+                                                                getPrefetchDepth(param), 0, 0, feder_result);
+            }
+            if (cur_ef >= ef || std::any_of(top_candidates.begin(), top_candidates.end(),
+                                            [radius](const auto& cand) { return cand.first < radius; })) {
+                break;
+            }
+            cur_ef = std::min(ef, cur_ef * 4);
         }
 
         if (top_candidates.size() == 0) {
@@ -1348,18 +3057,33 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
             lru_cache.put(vec_hash, top_candidates[0].second);
         }
 
-        return getNeighboursWithinRadius(top_candidates, query_data, radius, bitset);
+        auto result = getNeighboursWithinRadius(top_candidates, query_data, radius, bitset,
+                                                param ? param->range_max_results_ : 0,
+                                                param ? param->range_lower_ : -std::numeric_limits<float>::infinity());
+        if (codec_ != nullptr && raw_data_ != nullptr) {
+            // the radius walk runs on quantized distances, keep only the results that are within it exactly
+            size_t len = 0;
+            for (auto& [dist, label] : result) {
+                dist = calcRefineDistance(query_data, getInternalId(label));
+                if (dist < radius) {
+                    result[len++] = {dist, label};
+                }
+            }
+            result.resize(len);
+        }
+        return result;
     }
 
     void
     checkIntegrity() {
         int connections_checked = 0;
         std::vector<int> inbound_connections_num(cur_element_count, 0);
+        std::vector<linklistsizeint> links(maxM0_ + 1);
         for (int i = 0; i < cur_element_count; i++) {
             for (int l = 0; l <= element_levels_[i]; l++) {
-                linklistsizeint* ll_cur = get_linklist_at_level(i, l);
+                const linklistsizeint* ll_cur = l == 0 ? getLinks0(i, links.data()) : get_linklist(i, l);
                 int size = getListCount(ll_cur);
-                tableint* data = (tableint*)(ll_cur + 1);
+                const tableint* data = (const tableint*)(ll_cur + 1);
                 std::unordered_set<tableint> s;
                 for (int j = 0; j < size; j++) {
                     assert(data[j] > 0);
@@ -1384,22 +3108,88 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
         std::cout << "integrity ok, checked " << connections_checked << " connections\n";
     }
 
-    int64_t
-    cal_size() {
-        int64_t ret = 0;
-        ret += sizeof(*this);
-        ret += sizeof(*space_);
-        ret += visited_list_pool_->size();
-        ret += link_list_locks_.size() * sizeof(std::mutex);
-        ret += element_levels_.size() * sizeof(int);
-        ret += max_elements_ * size_data_per_element_;
-        ret += max_elements_ * sizeof(void*);
-        for (auto i = 0; i < max_elements_; ++i) {
+    // The ranges of the mapping in the order a search reads them: the upper layers it descends first, then level 0
+    // and the norms, then the raw vectors it refines with last.
+    void
+    mappedRegions(std::vector<knowhere::MappedRegion>& regions) const {
+        if (!mmap_enabled_) {
+            return;
+        }
+        if (upper_links_size_ > 0) {
+            regions.push_back({map_ + upper_links_offset_, upper_links_size_});
+        }
+        regions.push_back({data_level0_memory_, cur_element_count * size_data_per_element_});
+        if (metric_type_ == Metric::COSINE) {
+            regions.push_back({data_norm_l2_, cur_element_count * sizeof(float)});
+        }
+        if (raw_data_ != nullptr) {
+            regions.push_back({raw_data_, cur_element_count * raw_size_});
+        }
+    }
+
+    // the bytes of the trained tables of the level 0 codec
+    size_t
+    codebookSize() const {
+        if (auto sq = dynamic_cast<const faiss::IndexScalarQuantizer*>(codec_.get())) {
+            return sq->sq.trained.capacity() * sizeof(float);
+        }
+        if (auto pq = dynamic_cast<const faiss::IndexPQ*>(codec_.get())) {
+            return pq->pq.centroids.capacity() * sizeof(float);
+        }
+        if (auto rq = dynamic_cast<const faiss::IndexResidualQuantizer*>(codec_.get())) {
+            return rq->rq.codebooks.capacity() * sizeof(float);
+        }
+        return 0;
+    }
+
+    // The memory of the index as it is allocated or mapped. A mapped index maps the rows it has, an index in memory
+    // allocates max_elements_ rows of level 0 up front.
+    knowhere::MemoryUsage
+    memoryUsage() const {
+        using knowhere::MemoryUsage;
+        knowhere::MemoryUsage usage;
+        auto residency = mmap_enabled_ ? MemoryUsage::kMmap : MemoryUsage::kHeap;
+        size_t rows = mmap_enabled_ || links_compressed_ ? cur_element_count : max_elements_;
+        // level 0 holds the vectors or their codes after the links of every element, padded when aligned, or alone
+        // when the links are compressed
+        size_t payload = level0DataSize();
+        size_t level0 = rows * size_data_per_element_;
+        if (!mmap_enabled_) {
+            level0 = (level0 + kCacheLineSize - 1) / kCacheLineSize * kCacheLineSize;
+            level0 = knowhere::PayloadAllocator::AllocatedSize(data_level0_memory_, level0);
+        }
+        usage.Add(MemoryUsage::kVectors, residency, rows * payload);
+        usage.Add(MemoryUsage::kGraph, residency, level0 - rows * payload);
+        usage.Add(MemoryUsage::kGraph, MemoryUsage::kHeap,
+                  links_.capacity() * sizeof(uint16_t) + links_offsets_.capacity() * sizeof(uint64_t));
+        if (metric_type_ == Metric::COSINE) {
+            usage.Add(MemoryUsage::kVectors, residency, rows * sizeof(float));
+        }
+        if (raw_data_ != nullptr) {
+            usage.Add(MemoryUsage::kVectors, residency, rows * raw_size_);
+        }
+        if (codec_) {
+            usage.Add(MemoryUsage::kCodebooks, MemoryUsage::kHeap, codebookSize());
+        }
+
+        usage.Add(MemoryUsage::kGraph, MemoryUsage::kHeap, max_elements_ * sizeof(void*));
+        auto upper = upper_links_mapped_ ? MemoryUsage::kMmap : MemoryUsage::kHeap;
+        for (size_t i = 0; i < cur_element_count; ++i) {
             if (element_levels_[i] > 0) {
-                ret += size_links_per_element_ * element_levels_[i];
+                usage.Add(MemoryUsage::kGraph, upper, size_links_per_element_ * element_levels_[i]);
             }
         }
-        return ret;
+
+        usage.Add(MemoryUsage::kCache, MemoryUsage::kHeap, lru_cache.memory_size());
+        usage.Add(MemoryUsage::kScratch, MemoryUsage::kHeap, visited_list_pool_->size());
+
+        usage.Add(MemoryUsage::kOther, MemoryUsage::kHeap,
+                  sizeof(*this) + sizeof(*space_) + link_list_locks_.capacity() * sizeof(SpinLock) +
+                      link_list_update_locks_.capacity() * sizeof(std::mutex) +
+                      element_levels_.capacity() * sizeof(int) + deleted_.capacity() +
+                      entry_hubs_.capacity() * sizeof(tableint) + label_of_.capacity() * sizeof(labeltype) +
+                      internal_of_.capacity() * sizeof(tableint));
+        return usage;
     }
 };
 
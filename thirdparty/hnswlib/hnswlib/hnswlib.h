@@ -2,137 +2,18 @@
 #pragma GCC diagnostic ignored "-Wsign-compare"
 #pragma once
 
-// disable HNSW SIMD implementation, using faiss instead
-#if 0
-#ifndef NO_MANUAL_VECTORIZATION
-#ifdef __SSE__
-#define USE_SSE
-#ifdef __AVX__
-#define USE_AVX
-#ifdef __AVX512F__
-#define USE_AVX512
-#endif
-#endif
-#endif
-#endif
-#endif
-
-#if defined(USE_AVX) || defined(USE_SSE)
-#ifdef _MSC_VER
-#include <intrin.h>
-
-#include <stdexcept>
-
-#include "cpu_x86.h"
-void
-cpu_x86::cpuid(int32_t out[4], int32_t eax, int32_t ecx) {
-    __cpuidex(out, eax, ecx);
-}
-__int64
-xgetbv(unsigned int x) {
-    return _xgetbv(x);
-}
-#else
-#include <cpuid.h>
-#include <stdint.h>
-#include <x86intrin.h>
-void
-cpuid(int32_t cpuInfo[4], int32_t eax, int32_t ecx) {
-    __cpuid_count(eax, ecx, cpuInfo[0], cpuInfo[1], cpuInfo[2], cpuInfo[3]);
-}
-uint64_t
-xgetbv(unsigned int index) {
-    uint32_t eax, edx;
-    __asm__ __volatile__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(index));
-    return ((uint64_t)edx << 32) | eax;
-}
-#endif
-
-#if defined(USE_AVX512)
-#include <immintrin.h>
-#endif
-
-#if defined(__GNUC__)
-#define PORTABLE_ALIGN32 __attribute__((aligned(32)))
-#define PORTABLE_ALIGN64 __attribute__((aligned(64)))
-#else
-#define PORTABLE_ALIGN32 __declspec(align(32))
-#define PORTABLE_ALIGN64 __declspec(align(64))
-#endif
-
-// Adapted from https://github.com/Mysticial/FeatureDetector
-#define _XCR_XFEATURE_ENABLED_MASK 0
-
-bool
-AVXCapable() {
-    int cpuInfo[4];
-
-    // CPU support
-    cpuid(cpuInfo, 0, 0);
-    int nIds = cpuInfo[0];
-
-    bool HW_AVX = false;
-    if (nIds >= 0x00000001) {
-        cpuid(cpuInfo, 0x00000001, 0);
-        HW_AVX = (cpuInfo[2] & ((int)1 << 28)) != 0;
-    }
-
-    // OS support
-    cpuid(cpuInfo, 1, 0);
-
-    bool osUsesXSAVE_XRSTORE = (cpuInfo[2] & (1 << 27)) != 0;
-    bool cpuAVXSuport = (cpuInfo[2] & (1 << 28)) != 0;
-
-    bool avxSupported = false;
-    if (osUsesXSAVE_XRSTORE && cpuAVXSuport) {
-        uint64_t xcrFeatureMask = xgetbv(_XCR_XFEATURE_ENABLED_MASK);
-        avxSupported = (xcrFeatureMask & 0x6) == 0x6;
-    }
-    return HW_AVX && avxSupported;
-}
-
-bool
-AVX512Capable() {
-    if (!AVXCapable())
-        return false;
-
-    int cpuInfo[4];
-
-    // CPU support
-    cpuid(cpuInfo, 0, 0);
-    int nIds = cpuInfo[0];
-
-    bool HW_AVX512F = false;
-    if (nIds >= 0x00000007) {  //  AVX512 Foundation
-        cpuid(cpuInfo, 0x00000007, 0);
-        HW_AVX512F = (cpuInfo[1] & ((int)1 << 16)) != 0;
-    }
-
-    // OS support
-    cpuid(cpuInfo, 1, 0);
-
-    bool osUsesXSAVE_XRSTORE = (cpuInfo[2] & (1 << 27)) != 0;
-    bool cpuAVXSuport = (cpuInfo[2] & (1 << 28)) != 0;
-
-    bool avx512Supported = false;
-    if (osUsesXSAVE_XRSTORE && cpuAVXSuport) {
-        uint64_t xcrFeatureMask = xgetbv(_XCR_XFEATURE_ENABLED_MASK);
-        avx512Supported = (xcrFeatureMask & 0xe6) == 0xe6;
-    }
-    return HW_AVX512F && avx512Supported;
-}
-#endif
-
 #include <knowhere/bitsetview.h>
 #include <knowhere/feder/HNSW.h>
 #include <string.h>
 
 #include <fstream>
 #include <iostream>
+#include <limits>
 #include <queue>
 #include <vector>
 
 #include "io/FaissIO.h"
+#include "simd/hook.h"
 
 namespace hnswlib {
 typedef int64_t labeltype;
@@ -173,6 +54,22 @@ readBinaryPOD(R& in, T& podRef) {
 template <typename MTYPE>
 using DISTFUNC = MTYPE (*)(const void*, const void*, const void*);
 
+// distances between the first vector and the next 4 at once
+template <typename MTYPE>
+using DISTFUNC_BATCH_4 = void (*)(const void*, const void*, const void*, const void*, const void*, const void*, MTYPE&,
+                                  MTYPE&, MTYPE&, MTYPE&);
+
+// distances between the first vector and the n vectors at base + ids[i] * stride bytes, written to the last argument
+template <typename MTYPE>
+using DISTFUNC_BATCH_INDEXED = void (*)(const void*, const char*, const uint32_t*, size_t, size_t, const void*, MTYPE*);
+
+// the param of the float spaces: the dim first, which the index and the distance functions read as a size_t, then
+// the slot of the src/simd kernel for that dim, which KnowhereConfig::SetSimdType rebinds
+struct FloatDistParam {
+    size_t dim;
+    const faiss::fvec_func_ptr* kernel;
+};
+
 template <typename MTYPE>
 class SpaceInterface {
  public:
@@ -186,6 +83,18 @@ class SpaceInterface {
     virtual void*
     get_dist_func_param() = 0;
 
+    // optional, nullptr when the space has no batched kernel
+    virtual DISTFUNC_BATCH_4<MTYPE>
+    get_dist_func_batch_4() {
+        return nullptr;
+    }
+
+    // optional, nullptr when the space has no kernel for the rows gathered by id
+    virtual DISTFUNC_BATCH_INDEXED<MTYPE>
+    get_dist_func_batch_indexed() {
+        return nullptr;
+    }
+
     virtual ~SpaceInterface() {
     }
 };
@@ -193,6 +102,14 @@ class SpaceInterface {
 struct SearchParam {
     size_t ef_;
     bool for_tuning;
+    size_t prefetch_depth_ = 0;       // 0 picks the default of the current SIMD level
+    size_t early_stop_patience_ = 0;  // 0 explores the whole ef
+    float filter_threshold_ = -1.0f;  // filtered out ratio that switches knn to brute force, < 0 for the default
+    size_t range_init_ef_ = 0;        // 0 seeds range search with the whole ef
+    // range search keeps the closest range_max_results_ results at or beyond range_lower_, 0 for all in the radius
+    size_t range_max_results_ = 0;
+    float range_lower_ = -std::numeric_limits<float>::infinity();
+    float refine_k_ = 0.0f;  // a quantized level 0 refines the closest refine_k_ * k candidates, 0 for the whole ef
 };
 
 template <typename dist_t>
@@ -221,6 +138,9 @@ class AlgorithmInterface {
 
     virtual void
     saveIndex(knowhere::MemoryIOWriter& output) = 0;
+
+    virtual void
+    saveIndex(knowhere::SectionIOWriter& output) = 0;
     virtual ~AlgorithmInterface() {
     }
 };
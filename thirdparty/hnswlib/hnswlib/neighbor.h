@@ -1,7 +1,9 @@
 #pragma once
 
 #include <algorithm>
+#include <cstdint>
 #include <cstring>
+#include <vector>
 
 namespace hnswlib {
 
@@ -26,9 +28,23 @@ struct Neighbor {
 
 class NeighborSet {
  public:
-    explicit NeighborSet(size_t capacity = 0) : capacity_(capacity), data_(capacity_ + 1) {
+    explicit NeighborSet(size_t capacity = 0) : capacity_(capacity), storage_(capacity_ + 1), data_(storage_.data()) {
     }
 
+    // on the storage of the caller, which holds storage_size(capacity) neighbors and outlives the set
+    NeighborSet(size_t capacity, Neighbor* data) : capacity_(capacity), data_(data) {
+    }
+
+    static size_t
+    storage_size(size_t capacity) {
+        return capacity + 1;
+    }
+
+    NeighborSet(const NeighborSet&) = delete;
+
+    NeighborSet&
+    operator=(const NeighborSet&) = delete;
+
     bool
     insert(Neighbor nbr) {
         if (size_ == capacity_ && nbr.distance >= data_[size_ - 1].distance) {
@@ -99,11 +115,297 @@ class NeighborSet {
         cur_ = 0;
     }
 
+    // calls func on the neighbors, closest first
+    template <typename Func>
+    void
+    for_each(Func func) const {
+        for (size_t i = 0; i < size_; ++i) {
+            func(data_[i]);
+        }
+    }
+
  private:
     size_t size_ = 0;
     size_t capacity_;
     size_t cur_ = 0;
-    std::vector<Neighbor> data_;
+    std::vector<Neighbor> storage_;
+    Neighbor* data_;
+};
+
+// NeighborSet for large capacities, where moving the tail of the pool on every insertion dominates the search. The
+// neighbors are kept sorted in blocks of up to kBlockSize, ordered by an array of block descriptors: an insertion
+// moves the neighbors of one block only and splits the block in two once it is full, popping an invalid neighbor
+// closes the gap in its block only. Adjacent blocks that hold no more than kBlockSize / 2 neighbors together are
+// merged, which bounds the blocks to about a quarter of the neighbors, see storage_size.
+class NeighborBlockSet {
+ public:
+    static constexpr uint32_t kBlockSize = 32;
+
+    explicit NeighborBlockSet(size_t capacity = 0) : storage_(storage_size(capacity)) {
+        init(capacity, storage_.data());
+    }
+
+    // on the storage of the caller, which holds storage_size(capacity) neighbors and outlives the set
+    NeighborBlockSet(size_t capacity, Neighbor* data) {
+        init(capacity, data);
+    }
+
+    // the neighbors of the blocks, then the block descriptors and the free block slots in the space of neighbors
+    static size_t
+    storage_size(size_t capacity) {
+        size_t blocks = max_blocks(capacity);
+        return blocks * kBlockSize + (blocks * (sizeof(Block) + sizeof(uint32_t)) + sizeof(Neighbor) - 1) /
+                                         sizeof(Neighbor);
+    }
+
+    NeighborBlockSet(const NeighborBlockSet&) = delete;
+
+    NeighborBlockSet&
+    operator=(const NeighborBlockSet&) = delete;
+
+    bool
+    insert(Neighbor nbr) {
+        if (size_ == capacity_ && nbr.distance >= blocks_[n_blocks_ - 1].last) {
+            return false;
+        }
+        if (n_blocks_ == 0) {
+            blocks_[n_blocks_++] = {free_[--n_free_], 0, 0};
+        }
+        // the first block whose last neighbor is farther, or the last block
+        size_t lo = 0, hi = n_blocks_ - 1;
+        while (lo < hi) {
+            size_t mid = (lo + hi) >> 1;
+            if (blocks_[mid].last > nbr.distance) {
+                hi = mid;
+            } else {
+                lo = mid + 1;
+            }
+        }
+        size_t b = lo;
+        // after the neighbors as close, as NeighborSet does; a branchless count over the block
+        const Neighbor* nbrs = block(b);
+        uint32_t pos = 0;
+        for (uint32_t i = 0; i < blocks_[b].count; ++i) {
+            pos += nbrs[i].distance <= nbr.distance;
+        }
+        if (blocks_[b].count == kBlockSize) {
+            split(b);
+            if (pos > kBlockSize / 2) {
+                ++b;
+                pos -= kBlockSize / 2;
+            }
+        }
+        Neighbor* dst = block(b);
+        std::memmove(&dst[pos + 1], &dst[pos], (blocks_[b].count - pos) * sizeof(Neighbor));
+        dst[pos] = nbr;
+        blocks_[b].count++;
+        update_last(b);
+        size_++;
+        if (b < cur_block_ || (b == cur_block_ && pos < cur_pos_)) {
+            cur_block_ = b;
+            cur_pos_ = pos;
+        }
+        if (size_ > capacity_) {
+            remove(n_blocks_ - 1, blocks_[n_blocks_ - 1].count - 1);
+        }
+        return true;
+    }
+
+    Neighbor
+    pop() {
+        auto ret = block(cur_block_)[cur_pos_];
+        if (ret.status == Neighbor::kInvalid) {
+            remove(cur_block_, cur_pos_);
+        } else {
+            block(cur_block_)[cur_pos_].status = Neighbor::kChecked;
+        }
+        while (cur_block_ < n_blocks_) {
+            const Neighbor* nbrs = block(cur_block_);
+            while (cur_pos_ < blocks_[cur_block_].count && nbrs[cur_pos_].status == Neighbor::kChecked) {
+                cur_pos_++;
+            }
+            if (cur_pos_ < blocks_[cur_block_].count) {
+                break;
+            }
+            cur_block_++;
+            cur_pos_ = 0;
+        }
+        return ret;
+    }
+
+    bool
+    has_next() const {
+        return cur_block_ < n_blocks_;
+    }
+
+    size_t
+    size() const {
+        return size_;
+    }
+
+    size_t
+    capacity() const {
+        return capacity_;
+    }
+
+    // walks the blocks, for_each is the way to read all the neighbors
+    const Neighbor&
+    operator[](size_t i) const {
+        size_t b = 0;
+        while (i >= blocks_[b].count) {
+            i -= blocks_[b++].count;
+        }
+        return block(b)[i];
+    }
+
+    void
+    clear() {
+        size_ = 0;
+        n_blocks_ = 0;
+        cur_block_ = 0;
+        cur_pos_ = 0;
+        n_free_ = max_blocks_;
+        for (size_t i = 0; i < max_blocks_; ++i) {
+            free_[i] = max_blocks_ - 1 - i;
+        }
+    }
+
+    template <typename Func>
+    void
+    for_each(Func func) const {
+        for (size_t b = 0; b < n_blocks_; ++b) {
+            const Neighbor* nbrs = block(b);
+            for (uint32_t i = 0; i < blocks_[b].count; ++i) {
+                func(nbrs[i]);
+            }
+        }
+    }
+
+ private:
+    // the blocks are searched by the distance of their last neighbor, kept here rather than read from each block
+    struct Block {
+        uint32_t slot;
+        uint32_t count;
+        float last;
+    };
+
+    // any floor(n / 2) disjoint pairs of adjacent blocks hold more than kBlockSize / 2 neighbors each, of the
+    // capacity + 1 at most, and a split takes one more block
+    static size_t
+    max_blocks(size_t capacity) {
+        return (capacity + 1) / (kBlockSize / 2 + 1) * 2 + 2;
+    }
+
+    void
+    init(size_t capacity, Neighbor* data) {
+        capacity_ = capacity;
+        max_blocks_ = max_blocks(capacity);
+        data_ = data;
+        blocks_ = reinterpret_cast<Block*>(data_ + max_blocks_ * kBlockSize);
+        free_ = reinterpret_cast<uint32_t*>(blocks_ + max_blocks_);
+        clear();
+    }
+
+    Neighbor*
+    block(size_t b) const {
+        return data_ + static_cast<size_t>(blocks_[b].slot) * kBlockSize;
+    }
+
+    void
+    update_last(size_t b) {
+        blocks_[b].last = block(b)[blocks_[b].count - 1].distance;
+    }
+
+    // moves the upper half of the full block b to a new block after it
+    void
+    split(size_t b) {
+        std::memmove(&blocks_[b + 2], &blocks_[b + 1], (n_blocks_ - b - 1) * sizeof(Block));
+        n_blocks_++;
+        blocks_[b + 1] = {free_[--n_free_], kBlockSize / 2, blocks_[b].last};
+        blocks_[b].count = kBlockSize / 2;
+        std::memcpy(block(b + 1), block(b) + kBlockSize / 2, kBlockSize / 2 * sizeof(Neighbor));
+        update_last(b);
+        if (cur_block_ > b) {
+            cur_block_++;
+        } else if (cur_block_ == b && cur_pos_ >= kBlockSize / 2) {
+            cur_block_++;
+            cur_pos_ -= kBlockSize / 2;
+        }
+    }
+
+    // appends block b + 1 to block b
+    void
+    merge(size_t b) {
+        uint32_t count = blocks_[b].count;
+        std::memcpy(block(b) + count, block(b + 1), blocks_[b + 1].count * sizeof(Neighbor));
+        blocks_[b].count += blocks_[b + 1].count;
+        blocks_[b].last = blocks_[b + 1].last;
+        drop_block(b + 1);
+        if (cur_block_ == b + 1) {
+            cur_block_ = b;
+            cur_pos_ += count;
+        } else if (cur_block_ > b + 1) {
+            cur_block_--;
+        }
+    }
+
+    void
+    drop_block(size_t b) {
+        free_[n_free_++] = blocks_[b].slot;
+        std::memmove(&blocks_[b], &blocks_[b + 1], (n_blocks_ - b - 1) * sizeof(Block));
+        n_blocks_--;
+    }
+
+    // removes the neighbor at pos of block b, the cursor then points to the neighbor after it
+    void
+    remove(size_t b, uint32_t pos) {
+        Neighbor* nbrs = block(b);
+        std::memmove(&nbrs[pos], &nbrs[pos + 1], (blocks_[b].count - pos - 1) * sizeof(Neighbor));
+        blocks_[b].count--;
+        size_--;
+        if (cur_block_ == b && cur_pos_ > pos) {
+            cur_pos_--;
+        }
+        if (blocks_[b].count == 0) {
+            drop_block(b);
+            if (cur_block_ > b) {
+                cur_block_--;
+            }
+            cur_pos_ = cur_block_ == b ? 0 : cur_pos_;
+            if (n_blocks_ == 0) {
+                return;
+            }
+            b = std::min(b, n_blocks_ - 1);
+        } else {
+            update_last(b);
+        }
+        while (true) {
+            if (b + 1 < n_blocks_ && blocks_[b].count + blocks_[b + 1].count <= kBlockSize / 2) {
+                merge(b);
+            } else if (b > 0 && blocks_[b - 1].count + blocks_[b].count <= kBlockSize / 2) {
+                merge(--b);
+            } else {
+                break;
+            }
+        }
+        if (cur_block_ < n_blocks_ && cur_pos_ == blocks_[cur_block_].count) {
+            cur_block_++;
+            cur_pos_ = 0;
+        }
+    }
+
+    size_t size_ = 0;
+    size_t capacity_ = 0;
+    size_t max_blocks_ = 0;
+    size_t n_blocks_ = 0;
+    size_t n_free_ = 0;
+    // the first neighbor not checked yet, cur_block_ is n_blocks_ when there is none
+    size_t cur_block_ = 0;
+    uint32_t cur_pos_ = 0;
+    std::vector<Neighbor> storage_;
+    Neighbor* data_ = nullptr;
+    Block* blocks_ = nullptr;
+    uint32_t* free_ = nullptr;
 };
 
 static inline int
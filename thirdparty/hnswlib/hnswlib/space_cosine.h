@@ -5,25 +5,32 @@
 
 namespace hnswlib {
 
+// the kernel of the space param, unrolled for the common dims and rebound by every hook
 static float
-Cosine(const void* pVect1, const void* pVect2, const void* qty_ptr) {
-    return faiss::fvec_inner_product((const float*)pVect1, (const float*)pVect2, *((size_t*)qty_ptr));
+CosineDistanceKernel(const void* pVect1v, const void* pVect2v, const void* param_ptr) {
+    const auto* param = (const FloatDistParam*)param_ptr;
+    return -1.0f * (*param->kernel)((const float*)pVect1v, (const float*)pVect2v, param->dim);
 }
 
-static float
-CosineDistance(const void* pVect1, const void* pVect2, const void* qty_ptr) {
-    return -1.0f * Cosine(pVect1, pVect2, qty_ptr);
+static void
+CosineDistanceBatchIndexed(const void* pVect1v, const char* base, const uint32_t* ids, size_t n, size_t stride,
+                           const void* qty_ptr, float* dists) {
+    faiss::fvec_inner_product_batch_indexed(dists, (const float*)pVect1v, base, ids, n, *((size_t*)qty_ptr), stride);
+    for (size_t i = 0; i < n; i++) {
+        dists[i] = -dists[i];
+    }
 }
 
 class CosineSpace : public SpaceInterface<float> {
     DISTFUNC<float> fstdistfunc_;
     size_t data_size_;
-    size_t dim_;
+    FloatDistParam param_;
 
  public:
     CosineSpace(size_t dim) {
-        fstdistfunc_ = CosineDistance;
-        dim_ = dim;
+        fstdistfunc_ = CosineDistanceKernel;
+        param_.dim = dim;
+        param_.kernel = faiss::fvec_inner_product_slot_for_dim(dim);
         data_size_ = dim * sizeof(float);
     }
 
@@ -39,7 +46,12 @@ class CosineSpace : public SpaceInterface<float> {
 
     void*
     get_dist_func_param() {
-        return &dim_;
+        return &param_;
+    }
+
+    DISTFUNC_BATCH_INDEXED<float>
+    get_dist_func_batch_indexed() override {
+        return CosineDistanceBatchIndexed;
     }
 
     ~CosineSpace() {
@@ -1,14 +1,21 @@
 #pragma once
 
-#include <faiss/utils/binary_distances.h>
-
 #include "hnswlib.h"
+#include "simd/hook.h"
 
 namespace hnswlib {
 
 static float
 Hamming(const void* pVect1v, const void* pVect2v, const void* qty_ptr) {
-    return faiss::xor_popcnt((const uint8_t*)pVect1v, (const uint8_t*)pVect2v, *((size_t*)qty_ptr) / 8);
+    return faiss::bvec_hamming((const uint8_t*)pVect1v, (const uint8_t*)pVect2v, *((size_t*)qty_ptr) / 8);
+}
+
+static void
+HammingBatch4(const void* pVect1v, const void* pVect2v0, const void* pVect2v1, const void* pVect2v2,
+              const void* pVect2v3, const void* qty_ptr, float& dis0, float& dis1, float& dis2, float& dis3) {
+    auto code_size = *((size_t*)qty_ptr) / 8;
+    faiss::bvec_hamming_batch_4((const uint8_t*)pVect1v, (const uint8_t*)pVect2v0, (const uint8_t*)pVect2v1,
+                                (const uint8_t*)pVect2v2, (const uint8_t*)pVect2v3, code_size, dis0, dis1, dis2, dis3);
 }
 
 class HammingSpace : public SpaceInterface<float> {
@@ -38,6 +45,11 @@ class HammingSpace : public SpaceInterface<float> {
         return &dim_;
     }
 
+    DISTFUNC_BATCH_4<float>
+    get_dist_func_batch_4() override {
+        return HammingBatch4;
+    }
+
     ~HammingSpace() {
     }
 };
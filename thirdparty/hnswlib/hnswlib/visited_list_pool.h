@@ -1,6 +1,10 @@
 #pragma once
 
 #include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
 #include <mutex>
 #include <thread>
 #include <unordered_map>
@@ -8,6 +12,52 @@
 
 namespace hnswlib {
 
+typedef unsigned short int vl_type;
+
+///////////////////////////////////////////////////////////
+//
+// Epoch-stamped visited set. An element is visited iff its tag equals the
+// current epoch, so a reset only bumps the epoch; the array is cleared only
+// when the epoch wraps around.
+//
+/////////////////////////////////////////////////////////
+
+class VisitedList {
+ public:
+    explicit VisitedList(size_t numelements) : numelements_(numelements), mass_(new vl_type[numelements]) {
+        std::fill_n(mass_.get(), numelements_, 0);
+    }
+
+    void
+    reset() {
+        cur_v_++;
+        if (cur_v_ == 0) {
+            std::fill_n(mass_.get(), numelements_, 0);
+            cur_v_++;
+        }
+    }
+
+    inline bool
+    get(size_t id) const {
+        return mass_[id] == cur_v_;
+    }
+
+    inline void
+    set(size_t id) {
+        mass_[id] = cur_v_;
+    }
+
+    size_t
+    size() const {
+        return numelements_;
+    }
+
+ private:
+    size_t numelements_;
+    std::unique_ptr<vl_type[]> mass_;
+    vl_type cur_v_ = 0;
+};
+
 ///////////////////////////////////////////////////////////
 //
 // Class for multi-threaded pool-management of VisitedLists
@@ -15,31 +65,52 @@ namespace hnswlib {
 /////////////////////////////////////////////////////////
 
 class VisitedListPool {
+    // Each thread remembers the lists of the last few pools it searched, so the
+    // hot path is a lock-free thread_local lookup. Pool ids are never reused,
+    // hence a stale slot can not alias a list owned by a destroyed pool.
+    struct CacheSlot {
+        uint64_t pool_id = 0;
+        VisitedList* list = nullptr;
+    };
+    static constexpr size_t kCacheSlots = 8;
+
     int numelements;
-    std::unordered_map<std::thread::id, std::vector<bool>> map;
+    uint64_t id_;
+    std::unordered_map<std::thread::id, std::unique_ptr<VisitedList>> map;
     std::mutex mtx;
 
+    static uint64_t
+    next_id() {
+        static std::atomic<uint64_t> id{0};
+        return ++id;
+    }
+
  public:
-    VisitedListPool(int numelements1) {
-        numelements = numelements1;
+    VisitedListPool(int numelements1) : numelements(numelements1), id_(next_id()) {
     }
 
-    std::vector<bool>&
+    VisitedList&
     getFreeVisitedList() {
-        std::unique_lock lk(mtx);
-        auto& res = map[std::this_thread::get_id()];
-        lk.unlock();
-        if (res.size() != numelements) {
-            res.assign(numelements, false);
-        } else {
-            std::fill(res.begin(), res.end(), false);
+        thread_local CacheSlot cache[kCacheSlots];
+        auto& slot = cache[id_ % kCacheSlots];
+        if (slot.pool_id != id_) {
+            std::unique_lock lk(mtx);
+            auto& res = map[std::this_thread::get_id()];
+            if (res == nullptr) {
+                res = std::make_unique<VisitedList>(numelements);
+            }
+            slot.pool_id = id_;
+            slot.list = res.get();
         }
-        return res;
+        slot.list->reset();
+        return *slot.list;
     };
 
     int64_t
     size() {
-        return numelements * (sizeof(std::thread::id) + numelements / 8) + sizeof(*this);
+        std::unique_lock lk(mtx);
+        return map.size() * (sizeof(std::thread::id) + sizeof(VisitedList) + numelements * sizeof(vl_type)) +
+               sizeof(*this);
     }
 };
 }  // namespace hnswlib